@@ -6,7 +6,8 @@ CREATE TABLE device_%deviceid_directories (
 CREATE TABLE device_%deviceid_subdirectories (
   directory INTEGER NOT NULL,
   path TEXT NOT NULL,
-  mtime INTEGER NOT NULL
+  mtime INTEGER NOT NULL,
+  art_candidates BLOB
 );
 
 CREATE TABLE device_%deviceid_songs (
@@ -62,13 +63,22 @@ CREATE TABLE device_%deviceid_songs (
   lyrics TEXT,
 
   originalyear INTEGER,
-  effective_originalyear INTEGER
+  effective_originalyear INTEGER,
+
+  replaygain_track_gain REAL,
+  replaygain_album_gain REAL,
+
+  sortartist TEXT,
+  sortalbumartist TEXT,
+  sortalbum TEXT
 );
 
 CREATE INDEX idx_device_%deviceid_songs_album ON device_%deviceid_songs (album);
 
 CREATE INDEX idx_device_%deviceid_songs_comp_artist ON device_%deviceid_songs (effective_compilation, artist);
 
+CREATE INDEX idx_device_%deviceid_songs_comp_sortartist ON device_%deviceid_songs (effective_compilation, sortartist);
+
 CREATE VIRTUAL TABLE device_%deviceid_fts USING fts3(
   ftstitle, ftsalbum, ftsartist, ftsalbumartist, ftscomposer, ftsperformer, ftsgrouping, ftsgenre, ftscomment,
   tokenize=unicode
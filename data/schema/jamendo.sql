@@ -49,7 +49,14 @@ CREATE TABLE jamendo.songs (
   lyrics TEXT,
 
   originalyear INTEGER,
-  effective_originalyear INTEGER
+  effective_originalyear INTEGER,
+
+  replaygain_track_gain REAL,
+  replaygain_album_gain REAL,
+
+  sortartist TEXT,
+  sortalbumartist TEXT,
+  sortalbum TEXT
 );
 
 CREATE VIRTUAL TABLE jamendo.songs_fts USING fts3(
@@ -59,6 +66,8 @@ CREATE VIRTUAL TABLE jamendo.songs_fts USING fts3(
 
 CREATE INDEX jamendo.idx_jamendo_comp_artist ON songs (effective_compilation, artist);
 
+CREATE INDEX jamendo.idx_jamendo_comp_sortartist ON songs (effective_compilation, sortartist);
+
 CREATE TABLE jamendo.track_ids (
   songs_row_id INTEGER PRIMARY KEY,
   track_id INTEGER
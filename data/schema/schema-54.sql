@@ -0,0 +1,7 @@
+CREATE TABLE acoustid_fingerprints (
+  filename TEXT PRIMARY KEY,
+  mtime INTEGER NOT NULL,
+  fingerprint TEXT NOT NULL
+);
+
+UPDATE schema_version SET version=54;
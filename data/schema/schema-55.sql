@@ -0,0 +1,11 @@
+CREATE TABLE cloud_indexing_queue (
+  service TEXT NOT NULL,
+  url TEXT NOT NULL,
+  mime_type TEXT NOT NULL,
+  download_url TEXT NOT NULL,
+  authorisation TEXT,
+  metadata BLOB NOT NULL,
+  PRIMARY KEY (service, url)
+);
+
+UPDATE schema_version SET version=55;
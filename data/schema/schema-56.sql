@@ -0,0 +1,5 @@
+ALTER TABLE %allsongstables ADD COLUMN replaygain_track_gain REAL;
+
+ALTER TABLE %allsongstables ADD COLUMN replaygain_album_gain REAL;
+
+UPDATE schema_version SET version=56;
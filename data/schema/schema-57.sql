@@ -0,0 +1,14 @@
+CREATE TABLE smart_playlist_searches (
+  search_key TEXT PRIMARY KEY NOT NULL,
+  songs_table TEXT NOT NULL,
+  search BLOB NOT NULL,
+  last_used INTEGER NOT NULL
+);
+
+CREATE TABLE smart_playlist_songs (
+  search_key TEXT NOT NULL,
+  song_id INTEGER NOT NULL,
+  PRIMARY KEY (search_key, song_id)
+);
+
+UPDATE schema_version SET version=57;
@@ -0,0 +1,11 @@
+ALTER TABLE %allsongstables ADD COLUMN sortartist TEXT;
+
+ALTER TABLE %allsongstables ADD COLUMN sortalbumartist TEXT;
+
+ALTER TABLE %allsongstables ADD COLUMN sortalbum TEXT;
+
+CREATE INDEX idx_comp_sortartist ON songs (effective_compilation, sortartist);
+
+CREATE INDEX idx_sortalbum ON songs (sortalbum);
+
+UPDATE schema_version SET version=58;
@@ -0,0 +1,13 @@
+CREATE INDEX idx_unavailable_artist ON songs (unavailable, artist, sortartist, effective_compilation);
+
+CREATE INDEX idx_unavailable_albumartist ON songs (unavailable, effective_albumartist, sortalbumartist, effective_compilation);
+
+CREATE INDEX idx_artist_album ON songs (artist, album, sortalbum, unavailable, effective_compilation);
+
+CREATE INDEX idx_albumartist_album ON songs (effective_albumartist, album, sortalbum, unavailable, effective_compilation);
+
+CREATE INDEX idx_directory ON songs (directory);
+
+CREATE INDEX idx_ctime ON songs (ctime);
+
+UPDATE schema_version SET version=59;
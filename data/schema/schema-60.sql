@@ -0,0 +1,11 @@
+ALTER TABLE icecast_stations ADD COLUMN hash INTEGER NOT NULL DEFAULT 0;
+
+DROP INDEX idx_icecast_genres;
+
+DROP INDEX idx_icecast_name;
+
+CREATE INDEX idx_icecast_genre_name ON icecast_stations (genre, name COLLATE NOCASE);
+
+CREATE INDEX idx_icecast_name ON icecast_stations (name COLLATE NOCASE);
+
+UPDATE schema_version SET version=60;
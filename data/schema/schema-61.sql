@@ -0,0 +1,3 @@
+ALTER TABLE subdirectories ADD COLUMN art_candidates BLOB;
+
+UPDATE schema_version SET version=61;
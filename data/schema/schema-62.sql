@@ -0,0 +1,12 @@
+DROP TABLE magnatune_songs;
+
+DROP TABLE magnatune_songs_fts;
+
+DROP TABLE subsonic_songs;
+
+DROP TABLE subsonic_songs_fts;
+
+UPDATE playlists SET dynamic_playlist_backend = 'magnatune.songs'
+  WHERE dynamic_playlist_backend = 'magnatune_songs';
+
+UPDATE schema_version SET version=62;
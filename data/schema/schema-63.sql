@@ -0,0 +1,3 @@
+CREATE INDEX idx_title_artist_length ON songs (title COLLATE NOCASE, artist COLLATE NOCASE, length);
+
+UPDATE schema_version SET version=63;
@@ -0,0 +1,7 @@
+CREATE TABLE audio_features (
+  filename TEXT PRIMARY KEY,
+  mtime INTEGER NOT NULL,
+  features BLOB NOT NULL
+);
+
+UPDATE schema_version SET version=64;
@@ -24,8 +24,15 @@
 
 #include <cstring>
 
-MediaPipeline::MediaPipeline(int port, quint64 length_msec)
+#include <QFile>
+
+// Enough for the 5 seconds sent in advance, with room to spare.
+const int MediaPipeline::kSharedMemorySize = 4 * 1024 * 1024;  // 4MB
+
+MediaPipeline::MediaPipeline(int port, const QString& socket_path,
+                             quint64 length_msec)
     : port_(port),
+      socket_path_(socket_path),
       length_msec_(length_msec),
       accepting_data_(true),
       pipeline_(nullptr),
@@ -48,9 +55,10 @@ bool MediaPipeline::Init(int sample_rate, int channels) {
   // Create elements
   appsrc_ = GST_APP_SRC(gst_element_factory_make("appsrc", nullptr));
   GstElement* gdppay = gst_element_factory_make("gdppay", nullptr);
-  tcpsink_ = gst_element_factory_make("tcpclientsink", nullptr);
+  sink_ = gst_element_factory_make(
+      socket_path_.isEmpty() ? "tcpclientsink" : "shmsink", nullptr);
 
-  if (!pipeline_ || !appsrc_ || !tcpsink_) {
+  if (!pipeline_ || !appsrc_ || !sink_) {
     if (pipeline_) {
       gst_object_unref(GST_OBJECT(pipeline_));
       pipeline_ = nullptr;
@@ -62,9 +70,9 @@ bool MediaPipeline::Init(int sample_rate, int channels) {
     if (gdppay) {
       gst_object_unref(GST_OBJECT(gdppay));
     }
-    if (tcpsink_) {
-      gst_object_unref(GST_OBJECT(tcpsink_));
-      tcpsink_ = nullptr;
+    if (sink_) {
+      gst_object_unref(GST_OBJECT(sink_));
+      sink_ = nullptr;
     }
     return false;
   }
@@ -72,16 +80,25 @@ bool MediaPipeline::Init(int sample_rate, int channels) {
   // Add elements to the pipeline and link them
   gst_bin_add(GST_BIN(pipeline_), GST_ELEMENT(appsrc_));
   gst_bin_add(GST_BIN(pipeline_), gdppay);
-  gst_bin_add(GST_BIN(pipeline_), tcpsink_);
-  gst_element_link_many(GST_ELEMENT(appsrc_), gdppay, tcpsink_, nullptr);
-
-  // Set the sink's port
-  g_object_set(G_OBJECT(tcpsink_), "host", "127.0.0.1", nullptr);
-  g_object_set(G_OBJECT(tcpsink_), "port", port_, nullptr);
+  gst_bin_add(GST_BIN(pipeline_), sink_);
+  gst_element_link_many(GST_ELEMENT(appsrc_), gdppay, sink_, nullptr);
+
+  if (socket_path_.isEmpty()) {
+    // Set the sink's port
+    g_object_set(G_OBJECT(sink_), "host", "127.0.0.1", nullptr);
+    g_object_set(G_OBJECT(sink_), "port", port_, nullptr);
+  } else {
+    // Clementine's shmsrc connects once it's told the socket is ready, hold
+    // the audio until then.
+    g_object_set(G_OBJECT(sink_), "socket-path",
+                 QFile::encodeName(socket_path_).constData(), nullptr);
+    g_object_set(G_OBJECT(sink_), "shm-size", kSharedMemorySize, nullptr);
+    g_object_set(G_OBJECT(sink_), "wait-for-connection", TRUE, nullptr);
+  }
 
   // Try to send 5 seconds of audio in advance to initially fill Clementine's
   // buffer.
-  g_object_set(G_OBJECT(tcpsink_), "ts-offset", qint64(-5 * kNsecPerSec),
+  g_object_set(G_OBJECT(sink_), "ts-offset", qint64(-5 * kNsecPerSec),
                nullptr);
 
   // We know the time of each buffer
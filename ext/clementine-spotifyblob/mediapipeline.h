@@ -21,16 +21,22 @@
 #ifndef MEDIAPIPELINE_H
 #define MEDIAPIPELINE_H
 
+#include <QString>
 #include <QtGlobal>
 
 #include <gst/gst.h>
 #include <gst/app/gstappsrc.h>
 
+// Sends the audio to Clementine's tcpserversrc on port, or through the
+// shared memory of a shmsink listening on socket_path if it's not empty.
 class MediaPipeline {
  public:
-  MediaPipeline(int port, quint64 length_msec);
+  static const int kSharedMemorySize;
+
+  MediaPipeline(int port, const QString& socket_path, quint64 length_msec);
   ~MediaPipeline();
 
+  const QString& socket_path() const { return socket_path_; }
   bool is_initialised() const { return pipeline_; }
   bool is_accepting_data() const { return accepting_data_; }
   bool Init(int sample_rate, int channels);
@@ -47,13 +53,14 @@ class MediaPipeline {
   Q_DISABLE_COPY(MediaPipeline)
 
   const int port_;
+  const QString socket_path_;
   const quint64 length_msec_;
 
   bool accepting_data_;
 
   GstElement* pipeline_;
   GstAppSrc* appsrc_;
-  GstElement* tcpsink_;
+  GstElement* sink_;
 
   quint64 byte_rate_;
   quint64 offset_bytes_;
@@ -39,13 +39,16 @@
 
 const int SpotifyClient::kSpotifyImageIDSize = 20;
 const int SpotifyClient::kWaveHeaderSize = 44;
+const int SpotifyClient::kPlaylistListDelayMsec = 500;
 
 SpotifyClient::SpotifyClient(QObject* parent)
     : AbstractMessageHandler<pb::spotify::Message>(nullptr, parent),
       api_key_(QByteArray::fromBase64(kSpotifyApiKey)),
       protocol_socket_(new QTcpSocket(this)),
       session_(nullptr),
-      events_timer_(new QTimer(this)) {
+      events_timer_(new QTimer(this)),
+      playlist_list_timer_(new QTimer(this)),
+      pending_prefetch_(nullptr) {
   SetDevice(protocol_socket_);
 
   memset(&spotify_callbacks_, 0, sizeof(spotify_callbacks_));
@@ -97,11 +100,17 @@ SpotifyClient::SpotifyClient(QObject* parent)
   events_timer_->setSingleShot(true);
   connect(events_timer_, SIGNAL(timeout()), SLOT(ProcessEvents()));
 
+  playlist_list_timer_->setSingleShot(true);
+  playlist_list_timer_->setInterval(kPlaylistListDelayMsec);
+  connect(playlist_list_timer_, SIGNAL(timeout()), SLOT(SendPlaylistList()));
+
   connect(protocol_socket_, SIGNAL(disconnected()),
           QCoreApplication::instance(), SLOT(quit()));
 }
 
 SpotifyClient::~SpotifyClient() {
+  ClearPendingPrefetch();
+
   if (session_) {
     sp_session_release(session_);
   }
@@ -169,9 +178,10 @@ void SpotifyClient::LogMessageCallback(sp_session* session, const char* data) {
 
 void SpotifyClient::Search(const pb::spotify::SearchRequest& req) {
   sp_search* search =
-      sp_search_create(session_, req.query().c_str(), 0, req.limit(), 0,
-                       req.limit_album(), 0, 0,  // artists
-                       0, 0,                     // playlists
+      sp_search_create(session_, req.query().c_str(), req.offset(),
+                       req.limit(), req.offset_album(), req.limit_album(),
+                       0, 0,  // artists
+                       0, 0,  // playlists
                        SP_SEARCH_STANDARD, &SearchCompleteCallback, this);
 
   pending_searches_[search] = req;
@@ -282,6 +292,8 @@ void SpotifyClient::MessageArrived(const pb::spotify::Message& message) {
     StartPlayback(message.playback_request());
   } else if (message.has_seek_request()) {
     Seek(message.seek_request().offset_nsec());
+  } else if (message.has_prefetch_request()) {
+    Prefetch(QStringFromStdString(message.prefetch_request().track_uri()));
   } else if (message.has_search_request()) {
     Search(message.search_request());
   } else if (message.has_image_request()) {
@@ -391,14 +403,14 @@ void SpotifyClient::PlaylistAddedCallback(sp_playlistcontainer* pc,
   // Install callbacks on this playlist
   sp_playlist_add_callbacks(playlist, &me->get_playlists_callbacks_, me);
 
-  me->SendPlaylistList();
+  me->SendPlaylistListSoon();
 }
 
 void SpotifyClient::PlaylistMovedCallback(sp_playlistcontainer* pc,
                                           sp_playlist* playlist, int position,
                                           int new_position, void* userdata) {
   SpotifyClient* me = reinterpret_cast<SpotifyClient*>(userdata);
-  me->SendPlaylistList();
+  me->SendPlaylistListSoon();
 }
 
 void SpotifyClient::PlaylistRemovedCallback(sp_playlistcontainer* pc,
@@ -409,10 +421,18 @@ void SpotifyClient::PlaylistRemovedCallback(sp_playlistcontainer* pc,
   // Remove callbacks from this playlist
   sp_playlist_remove_callbacks(playlist, &me->get_playlists_callbacks_, me);
 
-  me->SendPlaylistList();
+  me->SendPlaylistListSoon();
+}
+
+void SpotifyClient::SendPlaylistListSoon() {
+  if (!playlist_list_timer_->isActive()) {
+    playlist_list_timer_->start();
+  }
 }
 
 void SpotifyClient::SendPlaylistList() {
+  playlist_list_timer_->stop();
+
   pb::spotify::Message message;
   pb::spotify::Playlists* response = message.mutable_playlists_updated();
 
@@ -607,7 +627,7 @@ void SpotifyClient::PlaylistStateChangedForGetPlaylists(sp_playlist* pl,
                                                         void* userdata) {
   SpotifyClient* me = reinterpret_cast<SpotifyClient*>(userdata);
 
-  me->SendPlaylistList();
+  me->SendPlaylistListSoon();
 }
 
 void SpotifyClient::AddTracksToPlaylist(
@@ -760,6 +780,7 @@ void SpotifyClient::MetadataUpdatedCallback(sp_session* session) {
        me->pending_playback_requests_) {
     me->TryPlaybackAgain(playback);
   }
+  me->TryPrefetchAgain();
 }
 
 int SpotifyClient::MusicDeliveryCallback(sp_session* session,
@@ -783,6 +804,14 @@ int SpotifyClient::MusicDeliveryCallback(sp_session* session,
       me->media_pipeline_.reset();
       return 0;
     }
+
+    // The shmsink is listening now, Clementine can connect to it.
+    if (!me->media_pipeline_->socket_path().isEmpty()) {
+      pb::spotify::Message message;
+      message.mutable_media_socket_ready()->set_media_socket_path(
+          DataCommaSizeFromQString(me->media_pipeline_->socket_path()));
+      me->SendMessageAsync(message);
+    }
   }
 
   if (!me->media_pipeline_->is_accepting_data()) {
@@ -935,6 +964,40 @@ void SpotifyClient::Seek(qint64 offset_nsec) {
   qLog(Error) << "TODO seeking";
 }
 
+void SpotifyClient::Prefetch(const QString& uri) {
+  ClearPendingPrefetch();
+
+  sp_link* link = sp_link_create_from_string(uri.toUtf8().constData());
+  if (!link) return;
+
+  sp_track* track = sp_link_as_track(link);
+  if (track) {
+    sp_track_add_ref(track);
+    pending_prefetch_ = track;
+  }
+  sp_link_release(link);
+
+  TryPrefetchAgain();
+}
+
+void SpotifyClient::TryPrefetchAgain() {
+  // If the track was not loaded then we have to come back later
+  if (!pending_prefetch_ || !sp_track_is_loaded(pending_prefetch_)) return;
+
+  sp_error error = sp_session_player_prefetch(session_, pending_prefetch_);
+  if (error != SP_ERROR_OK) {
+    qLog(Debug) << "Couldn't prefetch track:" << sp_error_message(error);
+  }
+  ClearPendingPrefetch();
+}
+
+void SpotifyClient::ClearPendingPrefetch() {
+  if (pending_prefetch_) {
+    sp_track_release(pending_prefetch_);
+    pending_prefetch_ = nullptr;
+  }
+}
+
 void SpotifyClient::TryPlaybackAgain(const PendingPlaybackRequest& req) {
   // If the track was not loaded then we have to come back later
   if (!sp_track_is_loaded(req.track_)) {
@@ -955,8 +1018,10 @@ void SpotifyClient::TryPlaybackAgain(const PendingPlaybackRequest& req) {
   }
 
   // Create the media socket
-  media_pipeline_.reset(new MediaPipeline(req.request_.media_port(),
-                                          sp_track_duration(req.track_)));
+  media_pipeline_.reset(new MediaPipeline(
+      req.request_.media_port(),
+      QStringFromStdString(req.request_.media_socket_path()),
+      sp_track_duration(req.track_)));
 
   qLog(Info) << "Starting playback of uri" << req.request_.track_uri().c_str()
              << "to port" << req.request_.media_port();
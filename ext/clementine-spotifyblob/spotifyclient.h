@@ -44,6 +44,7 @@ class SpotifyClient : public AbstractMessageHandler<pb::spotify::Message> {
 
   static const int kSpotifyImageIDSize;
   static const int kWaveHeaderSize;
+  static const int kPlaylistListDelayMsec;
 
   void Init(quint16 port);
 
@@ -53,6 +54,10 @@ class SpotifyClient : public AbstractMessageHandler<pb::spotify::Message> {
 
  private slots:
   void ProcessEvents();
+  // Every playlist changes state while it loads after logging in, so the
+  // list is sent at most once every kPlaylistListDelayMsec instead of once
+  // for each of them.
+  void SendPlaylistListSoon();
 
  private:
   void SendLoginCompleted(bool success, const QString& error,
@@ -127,13 +132,17 @@ class SpotifyClient : public AbstractMessageHandler<pb::spotify::Message> {
       const pb::spotify::RemoveTracksFromPlaylistRequest& req);
   void StartPlayback(const pb::spotify::PlaybackRequest& req);
   void Seek(qint64 offset_nsec);
+  void Prefetch(const QString& uri);
   void LoadImage(const QString& id_b64);
   void BrowseAlbum(const QString& uri);
   void BrowseToplist(const pb::spotify::BrowseToplistRequest& req);
   void SetPlaybackSettings(const pb::spotify::PlaybackSettings& req);
   void SetPaused(const pb::spotify::PauseRequest& req);
 
-  void SendPlaylistList();
+  // Every playlist changes state while it loads after logging in, so the
+  // list is sent at most once every kPlaylistListDelayMsec instead of once
+  // for each of them.
+  void SendPlaylistListSoon();
 
   void ConvertTrack(sp_track* track, pb::spotify::Track* pb);
   void ConvertAlbum(sp_album* album, pb::spotify::Track* pb);
@@ -169,6 +178,8 @@ class SpotifyClient : public AbstractMessageHandler<pb::spotify::Message> {
 
   void TryPlaybackAgain(const PendingPlaybackRequest& req);
   void TryImageAgain(sp_image* image);
+  void TryPrefetchAgain();
+  void ClearPendingPrefetch();
   int GetDownloadProgress(sp_playlist* playlist);
   void SendDownloadProgress(pb::spotify::PlaylistType type, int index,
                             int download_progress);
@@ -185,10 +196,14 @@ class SpotifyClient : public AbstractMessageHandler<pb::spotify::Message> {
   sp_session* session_;
 
   QTimer* events_timer_;
+  QTimer* playlist_list_timer_;
 
   QList<PendingLoadPlaylist> pending_load_playlists_;
   QList<PendingPlaybackRequest> pending_playback_requests_;
   QList<PendingImageRequest> pending_image_requests_;
+  // Only the latest prefetch request matters, and it waits here until its
+  // track's metadata has loaded.  We hold a reference to the track.
+  sp_track* pending_prefetch_;
   QMap<sp_image*, int> image_callbacks_registered_;
   QMap<sp_search*, pb::spotify::SearchRequest> pending_searches_;
   QMap<sp_albumbrowse*, QString> pending_album_browses_;
@@ -22,10 +22,27 @@
 #include <QFileInfo>
 #include <QNetworkAccessManager>
 #include <QTextCodec>
+#include <QThreadStorage>
 #include <QUrl>
 
+#include <functional>
+
+#include "core/concurrentrun.h"
+
+namespace {
+
+// A QNetworkAccessManager can only be used from the thread that created it,
+// so each cloud reader thread gets its own TagReader.
+QThreadStorage<TagReader*> sCloudTagReaders;
+
+}  // namespace
+
+const int TagReaderWorker::kCloudReaderThreads = 2;
+
 TagReaderWorker::TagReaderWorker(QIODevice* socket, QObject* parent)
-    : AbstractMessageHandler<pb::tagreader::Message>(socket, parent) {}
+    : AbstractMessageHandler<pb::tagreader::Message>(socket, parent) {
+  cloud_pool_.setMaxThreadCount(kCloudReaderThreads);
+}
 
 void TagReaderWorker::MessageArrived(const pb::tagreader::Message& message) {
   pb::tagreader::Message reply;
@@ -42,22 +59,42 @@ void TagReaderWorker::MessageArrived(const pb::tagreader::Message& message) {
     tag_reader_.ReadFile(
         QStringFromStdString(message.read_file_request().filename()),
         reply.mutable_read_file_response()->mutable_metadata());
+  } else if (message.has_read_files_request()) {
+    const pb::tagreader::ReadFilesRequest& req = message.read_files_request();
+    pb::tagreader::ReadFilesResponse* response =
+        reply.mutable_read_files_response();
+    for (int i = 0; i < req.filenames_size(); ++i) {
+      tag_reader_.ReadFile(QStringFromStdString(req.filenames(i)),
+                           response->add_metadata());
+    }
   } else if (message.has_save_file_request()) {
-    reply.mutable_save_file_response()->set_success(tag_reader_.SaveFile(
+    pb::tagreader::SaveFileResponse* response =
+        reply.mutable_save_file_response();
+    bool rewrote_file = false;
+    response->set_success(tag_reader_.SaveFile(
         QStringFromStdString(message.save_file_request().filename()),
-        message.save_file_request().metadata()));
+        message.save_file_request().metadata(), &rewrote_file));
+    response->set_rewrote_file(rewrote_file);
   } else if (message.has_save_song_statistics_to_file_request()) {
-    reply.mutable_save_song_statistics_to_file_response()->set_success(
-        tag_reader_.SaveSongStatisticsToFile(
-            QStringFromStdString(
-                message.save_song_statistics_to_file_request().filename()),
-            message.save_song_statistics_to_file_request().metadata()));
+    pb::tagreader::SaveSongStatisticsToFileResponse* response =
+        reply.mutable_save_song_statistics_to_file_response();
+    bool rewrote_file = false;
+    response->set_success(tag_reader_.SaveSongStatisticsToFile(
+        QStringFromStdString(
+            message.save_song_statistics_to_file_request().filename()),
+        message.save_song_statistics_to_file_request().metadata(),
+        &rewrote_file));
+    response->set_rewrote_file(rewrote_file);
   } else if (message.has_save_song_rating_to_file_request()) {
-    reply.mutable_save_song_rating_to_file_response()->set_success(
-        tag_reader_.SaveSongRatingToFile(
-            QStringFromStdString(
-                message.save_song_rating_to_file_request().filename()),
-            message.save_song_rating_to_file_request().metadata()));
+    pb::tagreader::SaveSongRatingToFileResponse* response =
+        reply.mutable_save_song_rating_to_file_response();
+    bool rewrote_file = false;
+    response->set_success(tag_reader_.SaveSongRatingToFile(
+        QStringFromStdString(
+            message.save_song_rating_to_file_request().filename()),
+        message.save_song_rating_to_file_request().metadata(),
+        &rewrote_file));
+    response->set_rewrote_file(rewrote_file);
   } else if (message.has_is_media_file_request()) {
     reply.mutable_is_media_file_response()->set_success(tag_reader_.IsMediaFile(
         QStringFromStdString(message.is_media_file_request().filename())));
@@ -68,23 +105,42 @@ void TagReaderWorker::MessageArrived(const pb::tagreader::Message& message) {
                                                          data.size());
   } else if (message.has_read_cloud_file_request()) {
 #ifdef HAVE_GOOGLE_DRIVE
-    const pb::tagreader::ReadCloudFileRequest& req =
-        message.read_cloud_file_request();
-    if (!tag_reader_.ReadCloudFile(
-             QUrl::fromEncoded(QByteArray(req.download_url().data(),
-                                          req.download_url().size())),
-             QStringFromStdString(req.title()), req.size(),
-             QStringFromStdString(req.mime_type()),
-             QStringFromStdString(req.authorisation_header()),
-             reply.mutable_read_cloud_file_response()->mutable_metadata())) {
-      reply.mutable_read_cloud_file_response()->clear_metadata();
-    }
+    ConcurrentRun::Run<void>(
+        &cloud_pool_,
+        std::bind(&TagReaderWorker::ReadCloudFile, this, message));
+    return;
 #endif
   }
 
   SendReply(message, &reply);
 }
 
+void TagReaderWorker::ReadCloudFile(const pb::tagreader::Message& message) {
+  pb::tagreader::Message reply;
+
+#ifdef HAVE_GOOGLE_DRIVE
+  if (!sCloudTagReaders.hasLocalData()) {
+    sCloudTagReaders.setLocalData(new TagReader);
+  }
+
+  const pb::tagreader::ReadCloudFileRequest& req =
+      message.read_cloud_file_request();
+  if (!sCloudTagReaders.localData()->ReadCloudFile(
+           QUrl::fromEncoded(QByteArray(req.download_url().data(),
+                                        req.download_url().size())),
+           QStringFromStdString(req.title()), req.size(),
+           QStringFromStdString(req.mime_type()),
+           QStringFromStdString(req.authorisation_header()),
+           reply.mutable_read_cloud_file_response()->mutable_metadata())) {
+    reply.mutable_read_cloud_file_response()->clear_metadata();
+  }
+#endif
+
+  // SendReply has to be called from this object's thread.
+  reply.set_id(message.id());
+  SendMessageAsync(reply);
+}
+
 void TagReaderWorker::DeviceClosed() {
   AbstractMessageHandler<pb::tagreader::Message>::DeviceClosed();
 
@@ -18,21 +18,34 @@
 #ifndef TAGREADERWORKER_H
 #define TAGREADERWORKER_H
 
+#include <QThreadPool>
+
 #include "config.h"
 #include "tagreader.h"
 #include "tagreadermessages.pb.h"
 #include "core/messagehandler.h"
 
 class TagReaderWorker : public AbstractMessageHandler<pb::tagreader::Message> {
+  // Local files are read and written in the order the requests arrive, on
+  // this object's thread.  Cloud files can take a long time to download, so
+  // they're read on their own threads and replied to whenever they're done,
+  // without holding up the local requests queued behind them.
+
  public:
   TagReaderWorker(QIODevice* socket, QObject* parent = NULL);
 
+  static const int kCloudReaderThreads;
+
  protected:
   void MessageArrived(const pb::tagreader::Message& message);
   void DeviceClosed();
 
  private:
+  // Runs on one of the cloud_pool_ threads.
+  void ReadCloudFile(const pb::tagreader::Message& message);
+
   TagReader tag_reader_;
+  QThreadPool cloud_pool_;
 };
 
 #endif  // TAGREADERWORKER_H
@@ -20,6 +20,7 @@
 
 #include <functional>
 
+#include <QAtomicInt>
 #include <QFuture>
 #include <QRunnable>
 #include <QThreadPool>
@@ -39,8 +40,29 @@
   ThreadFunctor classes are used to store a functor and its arguments, and
   Run() functions are used for convenience: to directly create a new
   ThreadFunctor object and start it.
+
+  Cancelling the returned future before the task has got a thread means it is
+  never run.  Its result must not be read then.
 */
 
+/*
+  A thread pool that knows how many of the tasks started in it are still
+  waiting for a thread.
+*/
+class CountingThreadPool : public QThreadPool {
+ public:
+  explicit CountingThreadPool(QObject* parent = nullptr)
+      : QThreadPool(parent) {}
+
+  int queue_depth() const { return queued_; }
+
+ private:
+  template <typename ReturnType>
+  friend class ThreadFunctorBase;
+
+  QAtomicInt queued_;
+};
+
 /*
   Base abstract classes ThreadFunctorBase and ThreadFunctor (for void and
   non-void result):
@@ -49,20 +71,35 @@ template <typename ReturnType>
 class ThreadFunctorBase : public QFutureInterface<ReturnType>,
                           public QRunnable {
  public:
-  ThreadFunctorBase() {}
+  ThreadFunctorBase() : counting_pool_(nullptr) {}
 
-  QFuture<ReturnType> Start(QThreadPool* thread_pool) {
+  // Tasks with a higher priority are run first.
+  QFuture<ReturnType> Start(QThreadPool* thread_pool, int priority = 0) {
     this->setRunnable(this);
     this->reportStarted();
     Q_ASSERT(thread_pool);
     QFuture<ReturnType> future = this->future();
-    thread_pool->start(this, 0 /* priority: currently we do not support
-                                  changing the priority. Might be added later
-                                  if needed */);
+    counting_pool_ = dynamic_cast<CountingThreadPool*>(thread_pool);
+    if (counting_pool_) counting_pool_->queued_.ref();
+    thread_pool->start(this, priority);
     return future;
   }
 
-  virtual void run() = 0;
+  void run() {
+    if (counting_pool_) counting_pool_->queued_.deref();
+
+    if (this->isCanceled()) {
+      this->reportFinished();
+      return;
+    }
+    Execute();
+  }
+
+ protected:
+  virtual void Execute() = 0;
+
+ private:
+  CountingThreadPool* counting_pool_;
 };
 
 template <typename ReturnType, typename... Args>
@@ -71,7 +108,7 @@ class ThreadFunctor : public ThreadFunctorBase<ReturnType> {
   ThreadFunctor(std::function<ReturnType(Args...)> function, Args... args)
       : function_(std::bind(function, args...)) {}
 
-  virtual void run() {
+  virtual void Execute() {
     this->reportResult(function_());
     this->reportFinished();
   }
@@ -87,7 +124,7 @@ class ThreadFunctor<void, Args...> : public ThreadFunctorBase<void> {
   ThreadFunctor(std::function<void(Args...)> function, Args... args)
       : function_(std::bind(function, args...)) {}
 
-  virtual void run() {
+  virtual void Execute() {
     function_();
     this->reportFinished();
   }
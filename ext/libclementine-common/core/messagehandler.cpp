@@ -22,16 +22,28 @@
 #include "core/logging.h"
 
 #include <QAbstractSocket>
+#include <QCoreApplication>
+#include <QDataStream>
 #include <QLocalSocket>
 
+const quint32 _MessageHandlerBase::kSharedMemoryThreshold = 16 * 1024;  // 16KB
+const int _MessageHandlerBase::kSharedMemoryRingSize = 8 * 1024 * 1024;  // 8MB
+const quint32 _MessageHandlerBase::kControlFrame = 0x80000000;
+
 _MessageHandlerBase::_MessageHandlerBase(QIODevice* device, QObject* parent)
     : QObject(parent),
       device_(nullptr),
       flush_abstract_socket_(nullptr),
       flush_local_socket_(nullptr),
       reading_protobuf_(false),
+      reading_control_frame_(false),
       expected_length_(0),
-      is_device_closed_(false) {
+      is_device_closed_(false),
+      shared_memory_enabled_(false),
+      write_ring_ready_(false),
+      last_reply_msec_(0) {
+  clock_.start();
+
   if (device) {
     SetDevice(device);
   }
@@ -54,6 +66,41 @@ void _MessageHandlerBase::SetDevice(QIODevice* device) {
   } else {
     qFatal("Unsupported device type passed to _MessageHandlerBase");
   }
+
+  if (shared_memory_enabled_) StartSharedMemory();
+}
+
+void _MessageHandlerBase::SetSharedMemoryEnabled(bool enabled) {
+  shared_memory_enabled_ = enabled;
+  if (!enabled) {
+    // Already sent messages are still read from the ring by the other end.
+    write_ring_ready_ = false;
+    return;
+  }
+
+  if (device_) StartSharedMemory();
+}
+
+void _MessageHandlerBase::StartSharedMemory() {
+  if (write_ring_.is_valid()) {
+    write_ring_ready_ = true;
+    return;
+  }
+
+  const QString key_prefix =
+      QString("messagehandler_%1").arg(QCoreApplication::applicationPid());
+  if (!write_ring_.Create(key_prefix, kSharedMemoryRingSize)) {
+    qLog(Warning) << "Couldn't create shared memory, sending all messages"
+                  << "through the socket:" << write_ring_.error_string();
+    return;
+  }
+
+  // Big messages can be written to the ring once the other end says it has
+  // attached to it.
+  QByteArray control;
+  QDataStream s(&control, QIODevice::WriteOnly);
+  s << quint8(Control_AttachRing) << write_ring_.key();
+  WriteControlFrame(control);
 }
 
 void _MessageHandlerBase::DeviceReadyRead() {
@@ -63,6 +110,8 @@ void _MessageHandlerBase::DeviceReadyRead() {
       QDataStream s(device_);
       s >> expected_length_;
 
+      reading_control_frame_ = expected_length_ & kControlFrame;
+      expected_length_ &= ~kControlFrame;
       reading_protobuf_ = true;
     }
 
@@ -72,7 +121,10 @@ void _MessageHandlerBase::DeviceReadyRead() {
     // Did we get everything?
     if (buffer_.size() == expected_length_) {
       // Parse the message
-      if (!RawMessageArrived(buffer_.data())) {
+      const bool ok = reading_control_frame_
+                          ? ControlFrameArrived(buffer_.data())
+                          : MessageFrameArrived(buffer_.data());
+      if (!ok) {
         qLog(Error) << "Malformed protobuf message";
         device_->close();
         return;
@@ -87,9 +139,91 @@ void _MessageHandlerBase::DeviceReadyRead() {
   }
 }
 
+bool _MessageHandlerBase::MessageFrameArrived(const QByteArray& data) {
+  stats_.messages_received++;
+  stats_.bytes_received += data.size();
+  return RawMessageArrived(data);
+}
+
+bool _MessageHandlerBase::ControlFrameArrived(const QByteArray& data) {
+  QDataStream s(data);
+  quint8 type = 0;
+  s >> type;
+
+  switch (type) {
+    case Control_AttachRing: {
+      QString key;
+      s >> key;
+
+      if (read_ring_.Attach(key)) {
+        QByteArray control;
+        QDataStream reply(&control, QIODevice::WriteOnly);
+        reply << quint8(Control_RingAttached);
+        WriteControlFrame(control);
+      } else {
+        qLog(Warning) << "Couldn't attach to shared memory" << key << ":"
+                      << read_ring_.error_string();
+      }
+
+      // Offer the other end a ring for our messages as well.
+      if (!shared_memory_enabled_) SetSharedMemoryEnabled(true);
+      return true;
+    }
+
+    case Control_RingAttached:
+      qLog(Debug) << "Sending big messages through shared memory";
+      write_ring_ready_ = shared_memory_enabled_;
+      return true;
+
+    case Control_RingMessage: {
+      quint64 position = 0;
+      quint32 length = 0;
+      s >> position >> length;
+
+      QByteArray message;
+      if (s.status() != QDataStream::Ok ||
+          !read_ring_.Read(position, length, &message)) {
+        return false;
+      }
+      return MessageFrameArrived(message);
+    }
+  }
+
+  qLog(Error) << "Unknown control frame type" << type;
+  return false;
+}
+
 void _MessageHandlerBase::WriteMessage(const QByteArray& data) {
+  stats_.messages_sent++;
+  stats_.bytes_sent += data.size();
+
+  if (write_ring_ready_ && quint32(data.size()) >= kSharedMemoryThreshold) {
+    quint64 position = 0;
+    if (write_ring_.Write(data, &position)) {
+      stats_.shared_memory_bytes_sent += data.size();
+
+      QByteArray control;
+      QDataStream s(&control, QIODevice::WriteOnly);
+      s << quint8(Control_RingMessage) << position << quint32(data.size());
+      WriteControlFrame(control);
+      return;
+    }
+
+    // The other end is behind and the ring is full, or the message is bigger
+    // than the whole ring.  The socket still works.
+  }
+
+  WriteFrame(data.length(), data);
+}
+
+void _MessageHandlerBase::WriteControlFrame(const QByteArray& data) {
+  WriteFrame(kControlFrame | data.length(), data);
+}
+
+void _MessageHandlerBase::WriteFrame(quint32 length_field,
+                                     const QByteArray& data) {
   QDataStream s(device_);
-  s << quint32(data.length());
+  s << length_field;
   s.writeRawData(data.data(), data.length());
 
   // Sorry.
@@ -100,6 +234,13 @@ void _MessageHandlerBase::WriteMessage(const QByteArray& data) {
   }
 }
 
+void _MessageHandlerBase::RecordReplyTime(qint64 msec) {
+  last_reply_msec_ = clock_.elapsed();
+  stats_.replies++;
+  stats_.total_reply_msec += msec;
+  stats_.max_reply_msec = qMax(stats_.max_reply_msec, msec);
+}
+
 void _MessageHandlerBase::DeviceClosed() {
   is_device_closed_ = true;
   AbortAll();
@@ -22,6 +22,8 @@
 #define MESSAGEHANDLER_H
 
 #include <QBuffer>
+#include <QElapsedTimer>
+#include <QList>
 #include <QMap>
 #include <QMutex>
 #include <QMutexLocker>
@@ -31,6 +33,7 @@
 
 #include "core/logging.h"
 #include "core/messagereply.h"
+#include "core/sharedmemoryring.h"
 
 class QAbstractSocket;
 class QIODevice;
@@ -39,7 +42,37 @@ class QLocalSocket;
 #define QStringFromStdString(x) QString::fromUtf8(x.data(), x.size())
 #define DataCommaSizeFromQString(x) x.toUtf8().constData(), x.toUtf8().length()
 
+// Counters for the messages that went through one handler.
+struct MessageHandlerStats {
+  MessageHandlerStats()
+      : messages_sent(0),
+        messages_received(0),
+        bytes_sent(0),
+        bytes_received(0),
+        shared_memory_bytes_sent(0),
+        replies(0),
+        total_reply_msec(0),
+        max_reply_msec(0) {}
+
+  qint64 average_reply_msec() const {
+    return replies ? total_reply_msec / replies : 0;
+  }
+
+  quint64 messages_sent;
+  quint64 messages_received;
+  quint64 bytes_sent;
+  quint64 bytes_received;
+  quint64 shared_memory_bytes_sent;
+
+  // Time between sending a request and getting its reply.
+  quint64 replies;
+  qint64 total_reply_msec;
+  qint64 max_reply_msec;
+};
+
 // Reads and writes uint32 length encoded protobufs to a socket.
+// Big messages can be passed through a shared memory ring instead, in which
+// case only their position in the ring is written to the socket.
 // This base QObject is separate from AbstractMessageHandler because moc can't
 // handle templated classes.  Use AbstractMessageHandler instead.
 class _MessageHandlerBase : public QObject {
@@ -55,6 +88,18 @@ class _MessageHandlerBase : public QObject {
   // After this is true, messages cannot be sent to the handler any more.
   bool is_device_closed() const { return is_device_closed_; }
 
+  // Sends messages of at least kSharedMemoryThreshold bytes through a shared
+  // memory ring once the other end has attached to it.  The other end starts
+  // doing the same for its own messages.  Everything goes through the socket
+  // if the ring can't be created or is full.
+  void SetSharedMemoryEnabled(bool enabled);
+
+  // Must be called from my thread.
+  const MessageHandlerStats& stats() const { return stats_; }
+
+  static const quint32 kSharedMemoryThreshold;
+  static const int kSharedMemoryRingSize;
+
  protected slots:
   void WriteMessage(const QByteArray& data);
   void DeviceReadyRead();
@@ -64,6 +109,25 @@ class _MessageHandlerBase : public QObject {
   virtual bool RawMessageArrived(const QByteArray& data) = 0;
   virtual void AbortAll() = 0;
 
+  void RecordReplyTime(qint64 msec);
+
+ private:
+  enum ControlType {
+    Control_AttachRing = 1,
+    Control_RingAttached = 2,
+    Control_RingMessage = 3,
+  };
+
+  // Set in the length of frames that contain a ControlType and its arguments
+  // instead of a protobuf.
+  static const quint32 kControlFrame;
+
+  void StartSharedMemory();
+  void WriteFrame(quint32 length_field, const QByteArray& data);
+  void WriteControlFrame(const QByteArray& data);
+  bool ControlFrameArrived(const QByteArray& data);
+  bool MessageFrameArrived(const QByteArray& data);
+
  protected:
   typedef bool (QAbstractSocket::*FlushAbstractSocket)();
   typedef bool (QLocalSocket::*FlushLocalSocket)();
@@ -73,10 +137,20 @@ class _MessageHandlerBase : public QObject {
   FlushLocalSocket flush_local_socket_;
 
   bool reading_protobuf_;
+  bool reading_control_frame_;
   quint32 expected_length_;
   QBuffer buffer_;
 
   bool is_device_closed_;
+
+  bool shared_memory_enabled_;
+  bool write_ring_ready_;
+  SharedMemoryRing write_ring_;
+  SharedMemoryRing read_ring_;
+
+  QElapsedTimer clock_;
+  qint64 last_reply_msec_;
+  MessageHandlerStats stats_;
 };
 
 // Reads and writes uint32 length encoded MessageType messages to a socket.
@@ -108,6 +182,17 @@ class AbstractMessageHandler : public _MessageHandlerBase {
   // reply on the socket.  Used on the worker side.
   void SendReply(const MessageType& request, MessageType* reply);
 
+  // The number of requests that were sent and haven't had a reply yet.
+  int pending_request_count() const { return pending_replies_.count(); }
+
+  // Milliseconds since the oldest pending request was sent or the last reply
+  // arrived, whichever was later.  0 if there are no pending requests.
+  qint64 msec_since_progress() const;
+
+  // Forgets about all the pending requests without aborting them, and
+  // returns them oldest first.
+  QList<ReplyType*> TakePendingReplies();
+
  protected:
   // Called when a message is received from the socket.
   virtual void MessageArrived(const MessageType& message) {}
@@ -118,6 +203,11 @@ class AbstractMessageHandler : public _MessageHandlerBase {
 
  private:
   QMap<int, ReplyType*> pending_replies_;
+
+  // clock_ times when each pending request was sent.
+  QMap<int, qint64> request_times_;
+  // IDs of the pending requests in the order they were sent.
+  QList<int> request_order_;
 };
 
 template <typename MT>
@@ -144,6 +234,8 @@ void AbstractMessageHandler<MT>::SendMessageAsync(const MessageType& message) {
 template <typename MT>
 void AbstractMessageHandler<MT>::SendRequest(ReplyType* reply) {
   pending_replies_[reply->id()] = reply;
+  request_times_[reply->id()] = clock_.elapsed();
+  request_order_ << reply->id();
   SendMessage(reply->request_message());
 }
 
@@ -154,6 +246,27 @@ void AbstractMessageHandler<MT>::SendReply(const MessageType& request,
   SendMessage(*reply);
 }
 
+template <typename MT>
+qint64 AbstractMessageHandler<MT>::msec_since_progress() const {
+  if (request_order_.isEmpty()) return 0;
+
+  const qint64 oldest_sent = request_times_[request_order_.first()];
+  return clock_.elapsed() - qMax(oldest_sent, last_reply_msec_);
+}
+
+template <typename MT>
+QList<typename AbstractMessageHandler<MT>::ReplyType*>
+AbstractMessageHandler<MT>::TakePendingReplies() {
+  QList<ReplyType*> ret;
+  for (int id : request_order_) {
+    ret << pending_replies_[id];
+  }
+  pending_replies_.clear();
+  request_times_.clear();
+  request_order_.clear();
+  return ret;
+}
+
 template <typename MT>
 bool AbstractMessageHandler<MT>::RawMessageArrived(const QByteArray& data) {
   MessageType message;
@@ -165,6 +278,8 @@ bool AbstractMessageHandler<MT>::RawMessageArrived(const QByteArray& data) {
 
   if (reply) {
     // This is a reply to a message that we created earlier.
+    RecordReplyTime(clock_.elapsed() - request_times_.take(message.id()));
+    request_order_.removeOne(message.id());
     reply->SetReply(message);
   } else {
     MessageArrived(message);
@@ -179,6 +294,8 @@ void AbstractMessageHandler<MT>::AbortAll() {
     reply->Abort();
   }
   pending_replies_.clear();
+  request_times_.clear();
+  request_order_.clear();
 }
 
 #endif  // MESSAGEHANDLER_H
@@ -0,0 +1,125 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Note: this file is licensed under the Apache License instead of GPL because
+// it is used by the Spotify blob which links against libspotify and is not GPL
+// compatible.
+
+#include "sharedmemoryring.h"
+
+#include <cstring>
+
+namespace {
+
+// Copies between a linear buffer and a ring that might wrap around at the end.
+void CopyToRing(char* ring, int capacity, quint64 position, const char* data,
+                int length) {
+  const int start = position % capacity;
+  const int first = qMin(length, capacity - start);
+  memcpy(ring + start, data, first);
+  memcpy(ring, data + first, length - first);
+}
+
+void CopyFromRing(const char* ring, int capacity, quint64 position,
+                  char* data, int length) {
+  const int start = position % capacity;
+  const int first = qMin(length, capacity - start);
+  memcpy(data, ring + start, first);
+  memcpy(data + first, ring, length - first);
+}
+
+}  // namespace
+
+SharedMemoryRing::SharedMemoryRing() : write_position_(0) {}
+
+bool SharedMemoryRing::Create(const QString& key_prefix, int capacity) {
+  forever {
+    memory_.setKey(QString("%1_ring_%2").arg(key_prefix).arg(qrand()));
+    if (memory_.create(sizeof(Header) + capacity)) break;
+
+    // Only try another name if this one was taken.
+    if (memory_.error() != QSharedMemory::AlreadyExists) return false;
+  }
+
+  memory_.lock();
+  header()->capacity = capacity;
+  header()->read_position = 0;
+  memory_.unlock();
+
+  write_position_ = 0;
+  return true;
+}
+
+bool SharedMemoryRing::Attach(const QString& key) {
+  memory_.setKey(key);
+  if (!memory_.attach()) return false;
+
+  if (memory_.size() < int(sizeof(Header)) ||
+      memory_.size() < int(sizeof(Header)) + capacity()) {
+    memory_.detach();
+    return false;
+  }
+  return true;
+}
+
+SharedMemoryRing::Header* SharedMemoryRing::header() const {
+  return reinterpret_cast<Header*>(const_cast<void*>(memory_.constData()));
+}
+
+char* SharedMemoryRing::ring() const {
+  return reinterpret_cast<char*>(header() + 1);
+}
+
+int SharedMemoryRing::capacity() const {
+  return is_valid() ? header()->capacity : 0;
+}
+
+bool SharedMemoryRing::Write(const QByteArray& data, quint64* position) {
+  if (!is_valid()) return false;
+
+  const int cap = capacity();
+  if (data.size() > cap) return false;
+
+  memory_.lock();
+  const quint64 used = write_position_ - header()->read_position;
+  memory_.unlock();
+
+  if (used + data.size() > quint64(cap)) return false;
+
+  // The reader doesn't touch this part of the ring until it has been told
+  // about it, so it doesn't need to be locked.
+  CopyToRing(ring(), cap, write_position_, data.constData(), data.size());
+
+  *position = write_position_;
+  write_position_ += data.size();
+  return true;
+}
+
+bool SharedMemoryRing::Read(quint64 position, quint32 length,
+                            QByteArray* data) {
+  if (!is_valid()) return false;
+
+  const int cap = capacity();
+  if (length > quint32(cap)) return false;
+
+  data->resize(length);
+  CopyFromRing(ring(), cap, position, data->data(), length);
+
+  memory_.lock();
+  header()->read_position = position + length;
+  memory_.unlock();
+  return true;
+}
@@ -0,0 +1,70 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Note: this file is licensed under the Apache License instead of GPL because
+// it is used by the Spotify blob which links against libspotify and is not GPL
+// compatible.
+
+
+#ifndef SHAREDMEMORYRING_H
+#define SHAREDMEMORYRING_H
+
+#include <QByteArray>
+#include <QSharedMemory>
+#include <QString>
+
+// A single producer, single consumer ring buffer of bytes in a shared memory
+// segment.  One process creates the ring and writes messages into it, the
+// other attaches and reads them back in the same order.  The positions of the
+// messages have to be passed from the writer to the reader separately.
+class SharedMemoryRing {
+ public:
+  SharedMemoryRing();
+
+  // Creates a new segment with a unique key starting with key_prefix, big
+  // enough for capacity bytes of messages.  Used by the writer.
+  bool Create(const QString& key_prefix, int capacity);
+
+  // Attaches to a segment created by the other process.  Used by the reader.
+  bool Attach(const QString& key);
+
+  bool is_valid() const { return memory_.isAttached(); }
+  QString key() const { return memory_.key(); }
+  int capacity() const;
+  QString error_string() const { return memory_.errorString(); }
+
+  // Copies data into the ring and sets position to where it starts.  Returns
+  // false if the reader hasn't freed enough space yet.
+  bool Write(const QByteArray& data, quint64* position);
+
+  // Copies length bytes starting at position out of the ring, and frees them
+  // and everything before them.
+  bool Read(quint64 position, quint32 length, QByteArray* data);
+
+ private:
+  struct Header {
+    quint32 capacity;
+    quint64 read_position;
+  };
+
+  Header* header() const;
+  char* ring() const;
+
+  QSharedMemory memory_;
+  quint64 write_position_;
+};
+
+#endif  // SHAREDMEMORYRING_H
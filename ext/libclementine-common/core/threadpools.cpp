@@ -0,0 +1,56 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "threadpools.h"
+
+#include <QThread>
+
+namespace {
+
+Q_GLOBAL_STATIC_WITH_INITIALIZER(CountingThreadPool, interactive_pool, {
+  x->setMaxThreadCount(QThread::idealThreadCount());
+});
+
+// Leaves some of the cores for everything else.
+Q_GLOBAL_STATIC_WITH_INITIALIZER(CountingThreadPool, background_pool, {
+  x->setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+});
+
+// These threads are mostly asleep, so there can be more of them than cores.
+Q_GLOBAL_STATIC_WITH_INITIALIZER(CountingThreadPool, io_pool, {
+  x->setMaxThreadCount(qMax(4, QThread::idealThreadCount()));
+});
+
+}  // namespace
+
+namespace ThreadPools {
+
+CountingThreadPool* Get(Pool pool) {
+  switch (pool) {
+    case Pool_Background:
+      return background_pool();
+    case Pool_IO:
+      return io_pool();
+    case Pool_Interactive:
+    default:
+      return interactive_pool();
+  }
+}
+
+int QueueDepth(Pool pool) { return Get(pool)->queue_depth(); }
+
+}  // namespace ThreadPools
@@ -0,0 +1,59 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREADPOOLS_H
+#define THREADPOOLS_H
+
+#include <functional>
+
+#include "core/concurrentrun.h"
+
+/*
+  Shared thread pools for work that doesn't need a pool of its own, used
+  instead of QThreadPool::globalInstance().  Each kind of work gets its own
+  pool so that hours of background analysis can't hold up a query the user is
+  waiting for.  Work started with QtConcurrent::mapped and friends still ends
+  up in the global pool, which makes it a good place for bulk jobs.
+*/
+namespace ThreadPools {
+
+enum Pool {
+  // Work the user is waiting to see the result of, like library queries and
+  // search results.
+  Pool_Interactive = 0,
+  // Long jobs nobody is waiting for, like finding missing moodbars.
+  Pool_Background,
+  // Work that spends most of its time waiting for a device or the network.
+  Pool_IO,
+};
+
+CountingThreadPool* Get(Pool pool);
+
+// The number of tasks in the pool that are waiting for a thread.
+int QueueDepth(Pool pool);
+
+// Like ConcurrentRun::Run, in one of the shared pools.  Tasks with a higher
+// priority are run first.
+template <typename ReturnType>
+QFuture<ReturnType> Run(Pool pool, std::function<ReturnType()> function,
+                        int priority = 0) {
+  return (new ThreadFunctor<ReturnType>(function))->Start(Get(pool), priority);
+}
+
+}  // namespace ThreadPools
+
+#endif  // THREADPOOLS_H
@@ -0,0 +1,149 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Note: this file is licensed under the Apache License instead of GPL because
+// it is used by the Spotify blob which links against libspotify and is not GPL
+// compatible.
+
+#include "tracing.h"
+
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+#include "logging.h"
+
+namespace tracing {
+
+namespace {
+
+struct Event {
+  const char* name;
+  char phase;  // 'X' for a scope, 'C' for a counter
+  qint64 timestamp_usec;
+  qint64 value;  // How long a scope took
+  quintptr thread;
+};
+
+// Stop recording after this many, so a forgotten trace can't use up all the
+// memory.
+const int kMaxEvents = 1000000;
+
+QAtomicInt sEnabled;
+QMutex sMutex;
+QElapsedTimer sClock;
+QString* sFilename = nullptr;
+QVector<Event>* sEvents = nullptr;
+int sDroppedEvents = 0;
+
+qint64 Now() { return sClock.nsecsElapsed() / 1000; }
+
+quintptr CurrentThread() {
+  return reinterpret_cast<quintptr>(QThread::currentThreadId());
+}
+
+void Record(const Event& event) {
+  QMutexLocker l(&sMutex);
+  if (!sEvents) return;
+
+  if (sEvents->count() >= kMaxEvents) {
+    sDroppedEvents++;
+    return;
+  }
+  sEvents->append(event);
+}
+
+}  // namespace
+
+void Start(const QString& filename) {
+  QMutexLocker l(&sMutex);
+  delete sFilename;
+  delete sEvents;
+  sFilename = new QString(filename);
+  sEvents = new QVector<Event>;
+  sDroppedEvents = 0;
+  sClock.start();
+  sEnabled.fetchAndStoreRelaxed(1);
+}
+
+void Stop() {
+  QVector<Event> events;
+  QString filename;
+  int dropped_events = 0;
+  {
+    QMutexLocker l(&sMutex);
+    if (!sEvents) return;
+
+    sEnabled.fetchAndStoreRelaxed(0);
+    events = *sEvents;
+    filename = *sFilename;
+    dropped_events = sDroppedEvents;
+    delete sEvents;
+    delete sFilename;
+    sEvents = nullptr;
+    sFilename = nullptr;
+  }
+
+  QFile file(filename);
+  if (!file.open(QIODevice::WriteOnly)) {
+    qLog(Warning) << "Couldn't write trace to" << filename;
+    return;
+  }
+
+  const qint64 pid = QCoreApplication::applicationPid();
+
+  QTextStream s(&file);
+  s << "{\"traceEvents\":[";
+  for (int i = 0; i < events.count(); ++i) {
+    const Event& event = events[i];
+    if (i) s << ",";
+    s << "\n{\"name\":\"" << event.name << "\",\"ph\":\"" << event.phase
+      << "\",\"ts\":" << event.timestamp_usec << ",\"pid\":" << pid
+      << ",\"tid\":" << event.thread;
+    if (event.phase == 'X') {
+      s << ",\"dur\":" << event.value << "}";
+    } else {
+      s << ",\"args\":{\"value\":" << event.value << "}}";
+    }
+  }
+  s << "\n]}\n";
+
+  qLog(Info) << "Wrote" << events.count() << "trace events to" << filename;
+  if (dropped_events) {
+    qLog(Warning) << "Dropped" << dropped_events << "trace events";
+  }
+}
+
+bool IsEnabled() { return sEnabled.fetchAndAddRelaxed(0); }
+
+void Counter(const char* name, qint64 value) {
+  Record({name, 'C', Now(), value, CurrentThread()});
+}
+
+ScopedTimer::ScopedTimer(const char* name)
+    : name_(name), start_usec_(IsEnabled() ? Now() : -1) {}
+
+ScopedTimer::~ScopedTimer() {
+  if (start_usec_ < 0 || !IsEnabled()) return;
+  Record({name_, 'X', start_usec_, Now() - start_usec_, CurrentThread()});
+}
+
+}  // namespace tracing
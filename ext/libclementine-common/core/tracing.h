@@ -0,0 +1,84 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Note: this file is licensed under the Apache License instead of GPL because
+// it is used by the Spotify blob which links against libspotify and is not GPL
+// compatible.
+
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <QtGlobal>
+
+class QString;
+
+// Records how long a scope took, as a Chrome trace event:
+//
+//   void LibraryWatcher::ScanSubdirectory(...) {
+//     qTraceScope("LibraryWatcher::ScanSubdirectory");
+//     ...
+//
+// and the value of a counter at this moment:
+//
+//   qTraceCounter("AlbumCoverLoader::tasks", tasks_.count());
+//
+// Names must be string literals, they're stored without copying.  Nothing is
+// recorded until tracing::Start() is called, and building with
+// CLEMENTINE_NO_TRACING removes the macros altogether.
+#ifdef CLEMENTINE_NO_TRACING
+#define qTraceScope(name) \
+  do {                    \
+  } while (false)
+#define qTraceCounter(name, value) \
+  do {                             \
+  } while (false)
+#else
+#define TRACING_CONCAT_INNER(a, b) a##b
+#define TRACING_CONCAT(a, b) TRACING_CONCAT_INNER(a, b)
+#define qTraceScope(name) \
+  tracing::ScopedTimer TRACING_CONCAT(trace_scope_, __LINE__)(name)
+#define qTraceCounter(name, value)                          \
+  do {                                                      \
+    if (tracing::IsEnabled()) tracing::Counter(name, value); \
+  } while (false)
+#endif
+
+namespace tracing {
+
+// Starts recording events.  They're kept in memory and written to filename
+// as trace event JSON, which chrome://tracing can open, by Stop().
+void Start(const QString& filename);
+void Stop();
+
+bool IsEnabled();
+
+void Counter(const char* name, qint64 value);
+
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(const char* name);
+  ~ScopedTimer();
+
+ private:
+  Q_DISABLE_COPY(ScopedTimer)
+
+  const char* name_;
+  qint64 start_usec_;
+};
+
+}  // namespace tracing
+
+#endif  // TRACING_H
@@ -20,6 +20,7 @@
 
 #include <QAtomicInt>
 #include <QCoreApplication>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QLocalServer>
 #include <QLocalSocket>
@@ -28,9 +29,11 @@
 #include <QProcess>
 #include <QQueue>
 #include <QThread>
+#include <QTimer>
 
 #include "core/closure.h"
 #include "core/logging.h"
+#include "core/messagehandler.h"
 
 // Base class containing signals and slots - required because moc doesn't do
 // templated objects.
@@ -40,6 +43,10 @@ class _WorkerPoolBase : public QObject {
  public:
   _WorkerPoolBase(QObject* parent = nullptr);
 
+  // Requests are only sent to workers with fewer than this many requests
+  // pending, the rest wait in the pool's queue.
+  static const int kMaxPendingRequestsPerWorker;
+
 signals:
   // Emitted when a worker failed to start.  This usually happens when the
   // worker wasn't found, or couldn't be executed.
@@ -50,6 +57,8 @@ signals:
   virtual void NewConnection() {}
   virtual void ProcessError(QProcess::ProcessError) {}
   virtual void SendQueuedMessages() {}
+  virtual void WorkerDisconnected() {}
+  virtual void CheckWorkerHealth() {}
 };
 
 // Manages a pool of one or more external processes.  A local socket server is
@@ -80,6 +89,14 @@ class WorkerPool : public _WorkerPoolBase {
   // is appended to this name when creating each server.
   void SetLocalServerName(const QString& local_server_name);
 
+  // Lets the handlers pass big messages through shared memory instead of the
+  // socket.  Defaults to false.
+  void SetSharedMemoryEnabled(bool enabled);
+
+  // Restarts a worker when it has had requests pending for this long without
+  // replying to any of them.  Defaults to 0, which never restarts workers.
+  void SetRequestTimeout(int msec);
+
   // Starts all workers.
   void Start();
 
@@ -88,6 +105,18 @@ class WorkerPool : public _WorkerPoolBase {
   // worker.  Can be called from any thread.
   ReplyType* SendMessageWithReply(MessageType* message);
 
+  // Returns the counters of each connected worker.  Must be called from my
+  // thread.
+  QList<MessageHandlerStats> WorkerStats() const;
+
+  // Returns the number of requests each connected worker hasn't replied to
+  // yet.  Must be called from my thread.
+  QList<int> PendingRequestCounts() const;
+
+  // Returns the number of requests that haven't been sent to a worker yet.
+  // Can be called from any thread.
+  int queued_message_count();
+
  protected:
   // These are all reimplemented slots, they are called on the WorkerPool's
   // thread.
@@ -95,6 +124,8 @@ class WorkerPool : public _WorkerPoolBase {
   void NewConnection();
   void ProcessError(QProcess::ProcessError error);
   void SendQueuedMessages();
+  void WorkerDisconnected();
+  void CheckWorkerHealth();
 
  private:
   struct Worker {
@@ -112,6 +143,11 @@ class WorkerPool : public _WorkerPoolBase {
 
   // Must only ever be called on my thread.
   void StartOneWorker(Worker* worker);
+  void LogStats(const Worker& worker) const;
+
+  // Takes the requests the worker hasn't replied to and puts them back on the
+  // front of the queue, except for the oldest one, which gets aborted.
+  void RequeuePendingRequests(Worker* worker);
 
   template <typename T>
   Worker* FindWorker(T Worker::*member, T value) {
@@ -137,8 +173,9 @@ class WorkerPool : public _WorkerPoolBase {
   // thread
   ReplyType* NewReply(MessageType* message);
 
-  // Returns the next handler, or NULL if there isn't one.  Must be called from
-  // my thread.
+  // Returns the connected handler with the fewest pending requests, or NULL if
+  // they all have kMaxPendingRequestsPerWorker.  Must be called from my
+  // thread.
   HandlerType* NextHandler() const;
 
  private:
@@ -147,6 +184,9 @@ class WorkerPool : public _WorkerPoolBase {
   QString executable_path_;
 
   int worker_count_;
+  bool shared_memory_enabled_;
+  int request_timeout_msec_;
+  QTimer* health_timer_;
   mutable int next_worker_;
   QList<Worker> workers_;
 
@@ -158,7 +198,12 @@ class WorkerPool : public _WorkerPoolBase {
 
 template <typename HandlerType>
 WorkerPool<HandlerType>::WorkerPool(QObject* parent)
-    : _WorkerPoolBase(parent), next_worker_(0), next_id_(0) {
+    : _WorkerPoolBase(parent),
+      shared_memory_enabled_(false),
+      request_timeout_msec_(0),
+      health_timer_(nullptr),
+      next_worker_(0),
+      next_id_(0) {
   worker_count_ = qBound(1, QThread::idealThreadCount() / 2, 2);
   local_server_name_ = qApp->applicationName().toLower();
 
@@ -167,22 +212,47 @@ WorkerPool<HandlerType>::WorkerPool(QObject* parent)
 
 template <typename HandlerType>
 WorkerPool<HandlerType>::~WorkerPool() {
+  // Close every worker's socket first so they all exit at the same time, then
+  // give them all one deadline instead of waiting for each in turn.
   for (const Worker& worker : workers_) {
+    LogStats(worker);
+
     if (worker.local_socket_ && worker.process_) {
       disconnect(worker.process_, SIGNAL(error(QProcess::ProcessError)), this,
                  SLOT(ProcessError(QProcess::ProcessError)));
+      disconnect(worker.local_socket_, SIGNAL(disconnected()), this,
+                 SLOT(WorkerDisconnected()));
 
       // The worker is connected.  Close his socket and wait for him to exit.
       qLog(Debug) << "Closing worker socket";
       worker.local_socket_->close();
-      worker.process_->waitForFinished(500);
     }
+  }
 
+  QElapsedTimer timer;
+  timer.start();
+  for (const Worker& worker : workers_) {
+    if (worker.process_) {
+      worker.process_->waitForFinished(qMax(qint64(0), 500 - timer.elapsed()));
+    }
+  }
+
+  bool terminated = false;
+  for (const Worker& worker : workers_) {
     if (worker.process_ && worker.process_->state() == QProcess::Running) {
       // The worker is still running - kill it.
       qLog(Debug) << "Killing worker process";
       worker.process_->terminate();
-      if (!worker.process_->waitForFinished(500)) {
+      terminated = true;
+    }
+  }
+
+  if (terminated) {
+    timer.restart();
+    for (const Worker& worker : workers_) {
+      if (worker.process_ && worker.process_->state() == QProcess::Running &&
+          !worker.process_->waitForFinished(
+              qMax(qint64(0), 500 - timer.elapsed()))) {
         worker.process_->kill();
       }
     }
@@ -206,6 +276,18 @@ void WorkerPool<HandlerType>::SetLocalServerName(
   local_server_name_ = local_server_name;
 }
 
+template <typename HandlerType>
+void WorkerPool<HandlerType>::SetSharedMemoryEnabled(bool enabled) {
+  Q_ASSERT(workers_.isEmpty());
+  shared_memory_enabled_ = enabled;
+}
+
+template <typename HandlerType>
+void WorkerPool<HandlerType>::SetRequestTimeout(int msec) {
+  Q_ASSERT(workers_.isEmpty());
+  request_timeout_msec_ = msec;
+}
+
 template <typename HandlerType>
 void WorkerPool<HandlerType>::SetExecutableName(
     const QString& executable_name) {
@@ -241,6 +323,13 @@ void WorkerPool<HandlerType>::DoStart() {
     }
   }
 
+  if (request_timeout_msec_ > 0) {
+    health_timer_ = new QTimer(this);
+    health_timer_->setInterval(qMin(request_timeout_msec_, 1000));
+    connect(health_timer_, SIGNAL(timeout()), SLOT(CheckWorkerHealth()));
+    health_timer_->start();
+  }
+
   // Start all the workers
   for (int i = 0; i < worker_count_; ++i) {
     Worker worker;
@@ -254,6 +343,8 @@ template <typename HandlerType>
 void WorkerPool<HandlerType>::StartOneWorker(Worker* worker) {
   Q_ASSERT(QThread::currentThread() == thread());
 
+  LogStats(*worker);
+
   DeleteQObjectPointerLater(&worker->local_server_);
   DeleteQObjectPointerLater(&worker->local_socket_);
   DeleteQObjectPointerLater(&worker->process_);
@@ -309,12 +400,124 @@ void WorkerPool<HandlerType>::NewConnection() {
   worker->local_server_->deleteLater();
   worker->local_server_ = NULL;
 
+  // Connected before the handler, so the pending requests can be requeued
+  // before the handler aborts them.
+  connect(worker->local_socket_, SIGNAL(disconnected()),
+          SLOT(WorkerDisconnected()));
+
   // Create the handler.
   worker->handler_ = new HandlerType(worker->local_socket_, this);
+  worker->handler_->SetSharedMemoryEnabled(shared_memory_enabled_);
 
   SendQueuedMessages();
 }
 
+template <typename HandlerType>
+void WorkerPool<HandlerType>::WorkerDisconnected() {
+  Q_ASSERT(QThread::currentThread() == thread());
+
+  QLocalSocket* socket = qobject_cast<QLocalSocket*>(sender());
+  Worker* worker = FindWorker(&Worker::local_socket_, socket);
+  if (!worker) return;
+
+  // The process will be restarted by ProcessError.
+  RequeuePendingRequests(worker);
+  SendQueuedMessages();
+}
+
+template <typename HandlerType>
+void WorkerPool<HandlerType>::CheckWorkerHealth() {
+  Q_ASSERT(QThread::currentThread() == thread());
+
+  for (typename QList<Worker>::iterator it = workers_.begin();
+       it != workers_.end(); ++it) {
+    Worker* worker = &(*it);
+    if (!worker->handler_ ||
+        worker->handler_->msec_since_progress() < request_timeout_msec_) {
+      continue;
+    }
+
+    qLog(Warning) << "Worker" << worker << "hasn't replied for"
+                  << worker->handler_->msec_since_progress()
+                  << "ms - restarting";
+
+    RequeuePendingRequests(worker);
+
+    // Restart it ourselves instead of in ProcessError.
+    disconnect(worker->process_, SIGNAL(error(QProcess::ProcessError)), this,
+               SLOT(ProcessError(QProcess::ProcessError)));
+    disconnect(worker->local_socket_, SIGNAL(disconnected()), this,
+               SLOT(WorkerDisconnected()));
+    worker->process_->kill();
+    StartOneWorker(worker);
+  }
+
+  SendQueuedMessages();
+}
+
+template <typename HandlerType>
+void WorkerPool<HandlerType>::RequeuePendingRequests(Worker* worker) {
+  if (!worker->handler_) return;
+
+  QList<ReplyType*> replies = worker->handler_->TakePendingReplies();
+  if (replies.isEmpty()) return;
+
+  // The oldest request is probably the one the worker was stuck on or crashed
+  // on, so don't give it to another worker.
+  ReplyType* failed = replies.takeFirst();
+  qLog(Warning) << "Worker" << worker << "failed on request" << failed->id()
+                << "- sending" << replies.count()
+                << "other requests to other workers";
+  failed->Abort();
+
+  QMutexLocker l(&message_queue_mutex_);
+  for (int i = replies.count() - 1; i >= 0; --i) {
+    message_queue_.prepend(replies[i]);
+  }
+}
+
+template <typename HandlerType>
+QList<int> WorkerPool<HandlerType>::PendingRequestCounts() const {
+  Q_ASSERT(QThread::currentThread() == thread());
+
+  QList<int> ret;
+  for (const Worker& worker : workers_) {
+    if (worker.handler_) ret << worker.handler_->pending_request_count();
+  }
+  return ret;
+}
+
+template <typename HandlerType>
+int WorkerPool<HandlerType>::queued_message_count() {
+  QMutexLocker l(&message_queue_mutex_);
+  return message_queue_.count();
+}
+
+template <typename HandlerType>
+void WorkerPool<HandlerType>::LogStats(const Worker& worker) const {
+  if (!worker.handler_) return;
+
+  const MessageHandlerStats& stats = worker.handler_->stats();
+  qLog(Debug) << "Worker" << &worker << "sent" << stats.messages_sent
+              << "messages (" << stats.bytes_sent << "bytes,"
+              << stats.shared_memory_bytes_sent << "through shared memory)"
+              << "and received" << stats.messages_received << "messages ("
+              << stats.bytes_received << "bytes), replies took"
+              << stats.average_reply_msec() << "ms on average and"
+              << stats.max_reply_msec << "ms at most";
+}
+
+template <typename HandlerType>
+QList<MessageHandlerStats> WorkerPool<HandlerType>::WorkerStats() const {
+  Q_ASSERT(QThread::currentThread() == thread());
+
+  QList<MessageHandlerStats> ret;
+  for (const Worker& worker : workers_) {
+    if (worker.handler_) ret << worker.handler_->stats();
+  }
+  return ret;
+}
+
 template <typename HandlerType>
 void WorkerPool<HandlerType>::ProcessError(QProcess::ProcessError error) {
   Q_ASSERT(QThread::currentThread() == thread());
@@ -349,7 +552,11 @@ typename WorkerPool<HandlerType>::ReplyType* WorkerPool<HandlerType>::NewReply(
   const int id = next_id_.fetchAndAddOrdered(1);
   message->set_id(id);
 
-  return new ReplyType(*message);
+  // A worker has room for another request when this one finishes.
+  ReplyType* reply = new ReplyType(*message);
+  connect(reply, SIGNAL(Finished(bool)), this, SLOT(SendQueuedMessages()),
+          Qt::QueuedConnection);
+  return reply;
 }
 
 template <typename HandlerType>
@@ -380,8 +587,8 @@ void WorkerPool<HandlerType>::SendQueuedMessages() {
     HandlerType* handler = NextHandler();
     if (!handler) {
       // No available handlers - put the message on the front of the queue.
+      // It's sent when a worker connects or replies to another request.
       message_queue_.prepend(reply);
-      qLog(Debug) << "No available handlers to process request";
       break;
     }
 
@@ -391,17 +598,25 @@ void WorkerPool<HandlerType>::SendQueuedMessages() {
 
 template <typename HandlerType>
 HandlerType* WorkerPool<HandlerType>::NextHandler() const {
+  int best_index = -1;
+  int best_pending = kMaxPendingRequestsPerWorker;
+
+  // Start after the last worker used, so idle workers take turns.
   for (int i = 0; i < workers_.count(); ++i) {
     const int worker_index = (next_worker_ + i) % workers_.count();
+    const HandlerType* handler = workers_[worker_index].handler_;
 
-    if (workers_[worker_index].handler_ &&
-        !workers_[worker_index].handler_->is_device_closed()) {
-      next_worker_ = (worker_index + 1) % workers_.count();
-      return workers_[worker_index].handler_;
+    if (handler && !handler->is_device_closed() &&
+        handler->pending_request_count() < best_pending) {
+      best_index = worker_index;
+      best_pending = handler->pending_request_count();
     }
   }
 
-  return NULL;
+  if (best_index == -1) return NULL;
+
+  next_worker_ = (best_index + 1) % workers_.count();
+  return workers_[best_index].handler_;
 }
 
 #endif  // WORKERPOOL_H
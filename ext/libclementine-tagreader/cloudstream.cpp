@@ -30,6 +30,8 @@
 namespace {
 static const int kTaglibPrefixCacheBytes = 64 * 1024;  // Should be enough.
 static const int kTaglibSuffixCacheBytes = 8 * 1024;
+static const uint kMinReadAheadBytes = 16 * 1024;
+static const uint kMaxReadAheadBytes = 256 * 1024;
 }
 
 CloudStream::CloudStream(const QUrl& url, const QString& filename,
@@ -43,7 +45,9 @@ CloudStream::CloudStream(const QUrl& url, const QString& filename,
       cursor_(0),
       network_(network),
       cache_(length),
-      num_requests_(0) {}
+      num_requests_(0),
+      bytes_fetched_(0),
+      read_ahead_bytes_(kMinReadAheadBytes) {}
 
 TagLib::FileName CloudStream::name() const { return encoded_filename_.data(); }
 
@@ -85,27 +89,26 @@ void CloudStream::Precache() {
   // to support multipart byte ranges yet so we have to make do with two
   // requests.
 
-  seek(0, TagLib::IOStream::Beginning);
-  readBlock(kTaglibPrefixCacheBytes);
-  seek(kTaglibSuffixCacheBytes, TagLib::IOStream::End);
-  readBlock(kTaglibSuffixCacheBytes);
-  clear();
-}
-
-TagLib::ByteVector CloudStream::readBlock(ulong length) {
-  const uint start = cursor_;
-  const uint end = qMin(cursor_ + length - 1, length_ - 1);
-
-  if (end < start) {
-    return TagLib::ByteVector();
+  if (length_ == 0) {
+    return;
   }
 
-  if (CheckCache(start, end)) {
-    TagLib::ByteVector cached = GetCached(start, end);
-    cursor_ += cached.size();
-    return cached;
+  const uint head_end = qMin(ulong(kTaglibPrefixCacheBytes), length_) - 1;
+  const uint tail_start = length_ > ulong(kTaglibSuffixCacheBytes)
+                              ? length_ - kTaglibSuffixCacheBytes
+                              : 0;
+
+  if (tail_start <= head_end + 1) {
+    // Small file: the two regions touch, so get the whole thing at once.
+    Fetch(0, length_ - 1);
+  } else {
+    Fetch(0, head_end);
+    Fetch(tail_start, length_ - 1);
   }
+  clear();
+}
 
+bool CloudStream::Fetch(uint start, uint end) {
   QNetworkRequest request = QNetworkRequest(url_);
   if (!auth_.isEmpty()) {
     request.setRawHeader("Authorization", auth_.toUtf8());
@@ -128,15 +131,63 @@ TagLib::ByteVector CloudStream::readBlock(ulong length) {
   int code = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
   if (code >= 400) {
     qLog(Debug) << "Error retrieving url to tag:" << url_;
-    return TagLib::ByteVector();
+    return false;
   }
 
   QByteArray data = reply->readAll();
-  TagLib::ByteVector bytes(data.data(), data.size());
-  cursor_ += data.size();
+  bytes_fetched_ += data.size();
+
+  // A server that ignores the Range header sends the whole file instead.
+  const uint offset = code == 200 ? 0 : start;
+  const int size = qMin(ulong(data.size()), length_ - offset);
+  FillCache(offset, TagLib::ByteVector(data.data(), size));
+  return true;
+}
+
+TagLib::ByteVector CloudStream::readBlock(ulong length) {
+  const uint start = cursor_;
+  const uint end = qMin(cursor_ + length - 1, length_ - 1);
+
+  if (end < start) {
+    return TagLib::ByteVector();
+  }
+
+  if (!CheckCache(start, end)) {
+    // Request only the part of the block that isn't cached yet, as one
+    // range, and read ahead past it up to the next cached byte.
+    uint fetch_start = start;
+    while (cache_.test(fetch_start)) {
+      ++fetch_start;
+    }
+    uint fetch_end = end;
+    while (cache_.test(fetch_end)) {
+      --fetch_end;
+    }
+    const uint read_ahead_end =
+        qMin(ulong(fetch_start + read_ahead_bytes_ - 1), length_ - 1);
+    while (fetch_end < read_ahead_end && !cache_.test(fetch_end + 1)) {
+      ++fetch_end;
+    }
+    read_ahead_bytes_ = qMin(read_ahead_bytes_ * 2, kMaxReadAheadBytes);
+
+    if (!Fetch(fetch_start, fetch_end)) {
+      return TagLib::ByteVector();
+    }
+  }
+
+  // Return whatever is contiguous from the cursor, in case the server sent
+  // back less than was asked for.
+  uint cached_end = start;
+  while (cached_end <= end && cache_.test(cached_end)) {
+    ++cached_end;
+  }
+  if (cached_end == start) {
+    return TagLib::ByteVector();
+  }
 
-  FillCache(start, bytes);
-  return bytes;
+  TagLib::ByteVector cached = GetCached(start, cached_end - 1);
+  cursor_ += cached.size();
+  return cached;
 }
 
 void CloudStream::writeBlock(const TagLib::ByteVector&) {
@@ -53,8 +53,11 @@ class CloudStream : public QObject, public TagLib::IOStream {
   }
 
   int num_requests() const { return num_requests_; }
+  qint64 bytes_fetched() const { return bytes_fetched_; }
 
   // Use educated guess to request the bytes that TagLib will probably want.
+  // The head and the tail of the file are fetched with one request each, or
+  // with a single request if they overlap.
   void Precache();
 
  private:
@@ -62,6 +65,10 @@ class CloudStream : public QObject, public TagLib::IOStream {
   void FillCache(int start, TagLib::ByteVector data);
   TagLib::ByteVector GetCached(int start, int end);
 
+  // Fetches bytes [start, end] with a single range request and stores them in
+  // the cache.  Returns false if the request failed.
+  bool Fetch(uint start, uint end);
+
  private slots:
   void SSLErrors(const QList<QSslError>& errors);
 
@@ -77,6 +84,11 @@ class CloudStream : public QObject, public TagLib::IOStream {
 
   google::sparsetable<char> cache_;
   int num_requests_;
+  qint64 bytes_fetched_;
+
+  // How far past a cache miss to read.  Doubles on every miss so a parser
+  // walking through the file sequentially needs few round-trips.
+  uint read_ahead_bytes_;
 };
 
 #endif  // GOOGLEDRIVESTREAM_H
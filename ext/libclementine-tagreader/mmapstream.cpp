@@ -0,0 +1,84 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "mmapstream.h"
+
+MmapStream::MmapStream(const QString& filename)
+    : file_(filename),
+      encoded_filename_(QFile::encodeName(filename)),
+      data_(nullptr),
+      length_(0),
+      cursor_(0) {
+  // Empty files can't be mapped, TagLib can't read them anyway.
+  if (file_.open(QIODevice::ReadOnly) && file_.size() > 0) {
+    data_ = file_.map(0, file_.size());
+    if (data_) length_ = file_.size();
+  }
+}
+
+MmapStream::~MmapStream() {
+  if (data_) file_.unmap(data_);
+}
+
+TagLib::FileName MmapStream::name() const {
+  return encoded_filename_.data();
+}
+
+TagLib::ByteVector MmapStream::readBlock(ulong length) {
+  const long count = qMin(long(length), length_ - cursor_);
+  if (count <= 0) return TagLib::ByteVector();
+
+  TagLib::ByteVector ret(reinterpret_cast<const char*>(data_ + cursor_),
+                         count);
+  cursor_ += count;
+  return ret;
+}
+
+void MmapStream::writeBlock(const TagLib::ByteVector&) {}
+
+void MmapStream::insert(const TagLib::ByteVector&, ulong, ulong) {}
+
+void MmapStream::removeBlock(ulong, ulong) {}
+
+bool MmapStream::readOnly() const { return true; }
+
+bool MmapStream::isOpen() const { return data_ != nullptr; }
+
+void MmapStream::seek(long offset, TagLib::IOStream::Position p) {
+  switch (p) {
+    case TagLib::IOStream::Beginning:
+      cursor_ = offset;
+      break;
+
+    case TagLib::IOStream::Current:
+      cursor_ += offset;
+      break;
+
+    case TagLib::IOStream::End:
+      cursor_ = length_ + offset;
+      break;
+  }
+  cursor_ = qBound(0L, cursor_, length_);
+}
+
+void MmapStream::clear() {}
+
+long MmapStream::tell() const { return cursor_; }
+
+long MmapStream::length() { return length_; }
+
+void MmapStream::truncate(long) {}
@@ -0,0 +1,60 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MMAPSTREAM_H
+#define MMAPSTREAM_H
+
+#include <QByteArray>
+#include <QFile>
+
+#include <taglib/tiostream.h>
+
+// A read-only TagLib stream over a local file that is mapped into memory, so
+// the many small reads and seeks TagLib does while parsing tags don't each
+// cost a system call.  Writes are ignored, use a normal TagLib::FileRef to
+// save tags.
+class MmapStream : public TagLib::IOStream {
+ public:
+  explicit MmapStream(const QString& filename);
+  ~MmapStream();
+
+  // False if the file couldn't be opened or mapped.
+  bool is_mapped() const { return data_ != nullptr; }
+
+  // Taglib::IOStream
+  virtual TagLib::FileName name() const;
+  virtual TagLib::ByteVector readBlock(ulong length);
+  virtual void writeBlock(const TagLib::ByteVector&);
+  virtual void insert(const TagLib::ByteVector&, ulong, ulong);
+  virtual void removeBlock(ulong, ulong);
+  virtual bool readOnly() const;
+  virtual bool isOpen() const;
+  virtual void seek(long offset, TagLib::IOStream::Position p);
+  virtual void clear();
+  virtual long tell() const;
+  virtual long length();
+  virtual void truncate(long);
+
+ private:
+  QFile file_;
+  const QByteArray encoded_filename_;
+  uchar* data_;
+  long length_;
+  long cursor_;
+};
+
+#endif  // MMAPSTREAM_H
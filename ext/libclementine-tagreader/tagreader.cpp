@@ -33,6 +33,8 @@
 #include <commentsframe.h>
 #include <fileref.h>
 #include <flacfile.h>
+#include <flacmetadatablock.h>
+#include <id3v2framefactory.h>
 #include <id3v2tag.h>
 #include <mp4file.h>
 #include <mp4tag.h>
@@ -44,6 +46,7 @@
 #endif
 #include <oggflacfile.h>
 #include <popularimeterframe.h>
+#include <privateframe.h>
 #include <speexfile.h>
 #include <tag.h>
 #include <textidentificationframe.h>
@@ -61,6 +64,7 @@
 #include "core/timeconstants.h"
 #include "fmpsparser.h"
 #include "gmereader.h"
+#include "mmapstream.h"
 
 // Taglib added support for FLAC pictures in 1.7.0
 #if (TAGLIB_MAJOR_VERSION > 1) || \
@@ -68,6 +72,18 @@
 #define TAGLIB_HAS_FLAC_PICTURELIST
 #endif
 
+// And FileRefs that read from an IOStream in 1.11
+#if (TAGLIB_MAJOR_VERSION > 1) || \
+    (TAGLIB_MAJOR_VERSION == 1 && TAGLIB_MINOR_VERSION >= 11)
+#define TAGLIB_HAS_FILEREF_IOSTREAM
+#endif
+
+// And a FrameFactory::createFrame that can be overridden in 1.12
+#if (TAGLIB_MAJOR_VERSION > 1) || \
+    (TAGLIB_MAJOR_VERSION == 1 && TAGLIB_MINOR_VERSION >= 12)
+#define TAGLIB_HAS_VIRTUAL_CREATEFRAME
+#endif
+
 #ifdef HAVE_GOOGLE_DRIVE
 #include "cloudstream.h"
 #endif
@@ -79,8 +95,64 @@ class FileRefFactory {
  public:
   virtual ~FileRefFactory() {}
   virtual TagLib::FileRef* GetFileRef(const QString& filename) = 0;
+  // The returned FileRef can only be used to read tags, and embedded pictures
+  // might not have their data loaded.
+  virtual TagLib::FileRef* GetFileRefForReading(const QString& filename) {
+    return GetFileRef(filename);
+  }
+};
+
+namespace {
+
+#ifdef TAGLIB_HAS_VIRTUAL_CREATEFRAME
+// Stands in for an ID3v2 picture frame without parsing or copying the
+// picture.  ReadFile only needs to know that there is one.
+class PicturePlaceholderFrame : public TagLib::ID3v2::Frame {
+ public:
+  PicturePlaceholderFrame(const TagLib::ByteVector& data, uint version)
+      : Frame(new Header(data, version)) {}
+
+  TagLib::String toString() const { return TagLib::String(); }
+
+ protected:
+  void parseFields(const TagLib::ByteVector&) {}
+  TagLib::ByteVector renderFields() const { return TagLib::ByteVector(); }
 };
 
+class PictureSkippingFrameFactory : public TagLib::ID3v2::FrameFactory {
+ public:
+  TagLib::ID3v2::Frame* createFrame(
+      const TagLib::ByteVector& data,
+      const TagLib::ID3v2::Header* tag_header) const {
+    if (tag_header->majorVersion() >= 3 && data.startsWith("APIC")) {
+      return new PicturePlaceholderFrame(data, tag_header->majorVersion());
+    }
+    return FrameFactory::createFrame(data, tag_header);
+  }
+};
+#else
+typedef TagLib::ID3v2::FrameFactory PictureSkippingFrameFactory;
+#endif
+
+// Owns the stream a FileRef reads from, and destroys it after the FileRef.
+struct MmapStreamHolder {
+  explicit MmapStreamHolder(MmapStream* stream) : stream_(stream) {}
+  std::unique_ptr<MmapStream> stream_;
+};
+
+class MmapFileRef : private MmapStreamHolder, public TagLib::FileRef {
+ public:
+  MmapFileRef(MmapStream* stream, TagLib::File* file)
+      : MmapStreamHolder(stream), TagLib::FileRef(file) {}
+#ifdef TAGLIB_HAS_FILEREF_IOSTREAM
+  explicit MmapFileRef(MmapStream* stream)
+      : MmapStreamHolder(stream),
+        TagLib::FileRef(stream, true, TagLib::AudioProperties::Average) {}
+#endif
+};
+
+}  // namespace
+
 class TagLibFileRefFactory : public FileRefFactory {
  public:
   virtual TagLib::FileRef* GetFileRef(const QString& filename) {
@@ -90,6 +162,30 @@ class TagLibFileRefFactory : public FileRefFactory {
     return new TagLib::FileRef(QFile::encodeName(filename).constData());
 #endif
   }
+
+  virtual TagLib::FileRef* GetFileRefForReading(const QString& filename) {
+    std::unique_ptr<MmapStream> stream(new MmapStream(filename));
+    if (!stream->is_mapped()) return GetFileRef(filename);
+
+    if (filename.endsWith(".mp3", Qt::CaseInsensitive)) {
+      // Big cover pictures are common in MP3s, and are just copied around
+      // for nothing when reading tags.
+      MmapStream* raw_stream = stream.release();
+      return new MmapFileRef(
+          raw_stream,
+          new TagLib::MPEG::File(raw_stream, &frame_factory_, true,
+                                 TagLib::AudioProperties::Average));
+    }
+
+#ifdef TAGLIB_HAS_FILEREF_IOSTREAM
+    std::unique_ptr<MmapFileRef> ref(new MmapFileRef(stream.release()));
+    if (!ref->isNull()) return ref.release();
+#endif
+    return GetFileRef(filename);
+  }
+
+ private:
+  PictureSkippingFrameFactory frame_factory_;
 };
 
 namespace {
@@ -136,7 +232,8 @@ void TagReader::ReadFile(const QString& filename,
   song->set_mtime(info.lastModified().toTime_t());
   song->set_ctime(info.created().toTime_t());
 
-  std::unique_ptr<TagLib::FileRef> fileref(factory_->GetFileRef(filename));
+  std::unique_ptr<TagLib::FileRef> fileref(
+      factory_->GetFileRefForReading(filename));
   if (fileref->isNull()) {
     qLog(Info) << "TagLib hasn't been able to read " << filename << " file";
 
@@ -672,7 +769,8 @@ pb::tagreader::SongMetadata_Type TagReader::GuessFileType(
 }
 
 bool TagReader::SaveFile(const QString& filename,
-                         const pb::tagreader::SongMetadata& song) const {
+                         const pb::tagreader::SongMetadata& song,
+                         bool* rewrote_file) const {
   if (filename.isNull()) return false;
 
   qLog(Debug) << "Saving tags to" << filename;
@@ -733,20 +831,12 @@ bool TagReader::SaveFile(const QString& filename,
     SetVorbisComments(tag, song);
   }
 
-  bool ret = fileref->save();
-#ifdef Q_OS_LINUX
-  if (ret) {
-    // Linux: inotify doesn't seem to notice the change to the file unless we
-    // change the timestamps as well. (this is what touch does)
-    utimensat(0, QFile::encodeName(filename).constData(), nullptr, 0);
-  }
-#endif  // Q_OS_LINUX
-
-  return ret;
+  return SaveFileRef(fileref.get(), filename, rewrote_file);
 }
 
 bool TagReader::SaveSongStatisticsToFile(
-    const QString& filename, const pb::tagreader::SongMetadata& song) const {
+    const QString& filename, const pb::tagreader::SongMetadata& song,
+    bool* rewrote_file) const {
   if (filename.isNull()) return false;
 
   qLog(Debug) << "Saving song statistics tags to" << filename;
@@ -799,19 +889,12 @@ bool TagReader::SaveSongStatisticsToFile(
     return true;
   }
 
-  bool ret = fileref->save();
-#ifdef Q_OS_LINUX
-  if (ret) {
-    // Linux: inotify doesn't seem to notice the change to the file unless we
-    // change the timestamps as well. (this is what touch does)
-    utimensat(0, QFile::encodeName(filename).constData(), nullptr, 0);
-  }
-#endif  // Q_OS_LINUX
-  return ret;
+  return SaveFileRef(fileref.get(), filename, rewrote_file);
 }
 
 bool TagReader::SaveSongRatingToFile(
-    const QString& filename, const pb::tagreader::SongMetadata& song) const {
+    const QString& filename, const pb::tagreader::SongMetadata& song,
+    bool* rewrote_file) const {
   if (filename.isNull()) return false;
 
   qLog(Debug) << "Saving song rating tags to" << filename;
@@ -866,7 +949,129 @@ bool TagReader::SaveSongRatingToFile(
     return true;
   }
 
-  bool ret = fileref->save();
+  return SaveFileRef(fileref.get(), filename, rewrote_file);
+}
+
+namespace {
+
+// How much padding to leave after the tags when a save has to rewrite the
+// file anyway.  Enough for years of play counts and ratings.
+const long kReservedPadding = 64 * 1024;
+
+// The padding TagLib leaves itself when it rewrites a file.
+const long kID3v2MinPadding = 1024;
+const long kFlacMinPadding = 4096;
+
+// Takes up the space that's left as padding on the first of the two saves.
+const char* kPaddingOwner = "Clementine padding";
+const char* kPaddingField = "CLEMENTINE_PADDING";
+
+// TagLib throws away padding that's bigger than 1% of the file, so smaller
+// files get less.  Returns 0 or less if it isn't worth it.
+long ReservablePadding(TagLib::File* file, long min_padding) {
+  const long threshold = qBound(
+      min_padding, static_cast<long>(file->length() / 100), 1024L * 1024L);
+  return qMin(kReservedPadding, threshold - 2 * min_padding);
+}
+
+bool TagOutgrowsPadding(TagLib::MPEG::File* file) {
+  const TagLib::ID3v2::Tag* tag = file->ID3v2Tag();
+  return tag && tag->render().size() > tag->header()->completeTagSize();
+}
+
+// Walks the metadata blocks the same way FLAC::File does to see whether the
+// Vorbis comment still fits in the space its old block and the padding take
+// up.
+bool TagOutgrowsPadding(TagLib::FLAC::File* file) {
+  if (file->hasID3v2Tag()) return false;
+
+  long offset = static_cast<long>(file->find("fLaC"));
+  if (offset < 0) return false;
+  offset += 4;
+
+  long room = 0;
+  bool has_comment = false;
+  forever {
+    file->seek(offset);
+    const TagLib::ByteVector header = file->readBlock(4);
+    if (header.size() != 4) return false;
+
+    const int type = header[0] & 0x7f;
+    const long length = header.toUInt(1U, 3U);
+    if (type == TagLib::FLAC::MetadataBlock::Padding) {
+      room += length + 4;
+    } else if (type == TagLib::FLAC::MetadataBlock::VorbisComment &&
+               !has_comment) {
+      room += length;
+      has_comment = true;
+    }
+
+    offset += length + 4;
+    if (header[0] & 0x80) break;
+  }
+
+  // TagLib needs a header for the new padding block too.
+  const long needed = file->xiphComment(true)->render(false).size() +
+                      (has_comment ? 0 : 4) + 4;
+  return needed >= room;
+}
+
+// Saves once with a placeholder taking up padding bytes, which rewrites the
+// file, then again without it, which fits in place and leaves its space
+// behind as padding.
+bool SaveWithPadding(TagLib::FileRef* fileref, TagLib::ID3v2::Tag* tag,
+                     long padding) {
+  TagLib::ID3v2::PrivateFrame* frame = new TagLib::ID3v2::PrivateFrame;
+  frame->setOwner(kPaddingOwner);
+  frame->setData(TagLib::ByteVector(static_cast<uint>(padding), '\0'));
+  tag->addFrame(frame);
+
+  const bool ret = fileref->save();
+  tag->removeFrame(frame);
+  return ret && fileref->save();
+}
+
+bool SaveWithPadding(TagLib::FileRef* fileref,
+                     TagLib::Ogg::XiphComment* comment, long padding) {
+  comment->addField(kPaddingField, TagLib::String(std::string(padding, ' ')));
+
+  const bool ret = fileref->save();
+  comment->removeFields(kPaddingField);
+  return ret && fileref->save();
+}
+
+}  // namespace
+
+bool TagReader::SaveFileRef(TagLib::FileRef* fileref, const QString& filename,
+                            bool* rewrote_file) {
+  TagLib::File* file = fileref->file();
+  const long original_length = static_cast<long>(file->length());
+
+  bool ret = false;
+  TagLib::MPEG::File* mpeg_file = dynamic_cast<TagLib::MPEG::File*>(file);
+  TagLib::FLAC::File* flac_file = dynamic_cast<TagLib::FLAC::File*>(file);
+  long padding = 0;
+
+  if (mpeg_file && TagOutgrowsPadding(mpeg_file) &&
+      (padding = ReservablePadding(file, kID3v2MinPadding)) > 0) {
+    ret = SaveWithPadding(fileref, mpeg_file->ID3v2Tag(), padding);
+  } else if (flac_file && TagOutgrowsPadding(flac_file) &&
+             (padding = ReservablePadding(file, kFlacMinPadding)) > 0) {
+    ret = SaveWithPadding(fileref, flac_file->xiphComment(), padding);
+  } else {
+    ret = fileref->save();
+  }
+
+  // The tags are written in place whenever they fit, so the file only
+  // changes size when everything after them had to be moved.
+  const bool rewritten =
+      ret && static_cast<long>(file->length()) != original_length;
+  if (rewritten) {
+    qLog(Debug) << "Rewrote all of" << filename << "to fit its tags,"
+                << "leaving" << qMax(0L, padding) << "bytes of extra padding";
+  }
+  if (rewrote_file) *rewrote_file = rewritten;
+
 #ifdef Q_OS_LINUX
   if (ret) {
     // Linux: inotify doesn't seem to notice the change to the file unless we
@@ -874,6 +1079,7 @@ bool TagReader::SaveSongRatingToFile(
     utimensat(0, QFile::encodeName(filename).constData(), nullptr, 0);
   }
 #endif  // Q_OS_LINUX
+
   return ret;
 }
 
@@ -1152,6 +1358,8 @@ bool TagReader::ReadCloudFile(const QUrl& download_url, const QString& title,
     qLog(Warning) << "Total requests for file:" << title
                   << stream->num_requests() << stream->cached_bytes();
   }
+  qLog(Debug) << "Read tags from" << title << "with" << stream->num_requests()
+              << "requests," << stream->bytes_fetched() << "bytes fetched";
 
   if (tag->tag() && !tag->tag()->isEmpty()) {
     song->set_title(tag->tag()->title().toCString(true));
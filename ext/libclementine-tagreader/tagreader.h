@@ -53,15 +53,21 @@ class TagReader {
 
   void ReadFile(const QString& filename,
                 pb::tagreader::SongMetadata* song) const;
+  // The Save functions set rewrote_file, if given, to true when the tags
+  // didn't fit in the space the file already had for them and the whole file
+  // had to be rewritten.
   bool SaveFile(const QString& filename,
-                const pb::tagreader::SongMetadata& song) const;
+                const pb::tagreader::SongMetadata& song,
+                bool* rewrote_file = nullptr) const;
   // Returns false if something went wrong; returns true otherwise (might
   // returns true if the file exists but nothing has been written inside because
   // statistics tag format is not supported for this kind of file)
   bool SaveSongStatisticsToFile(const QString& filename,
-                                const pb::tagreader::SongMetadata& song) const;
+                                const pb::tagreader::SongMetadata& song,
+                                bool* rewrote_file = nullptr) const;
   bool SaveSongRatingToFile(const QString& filename,
-                            const pb::tagreader::SongMetadata& song) const;
+                            const pb::tagreader::SongMetadata& song,
+                            bool* rewrote_file = nullptr) const;
 
   bool IsMediaFile(const QString& filename) const;
   QByteArray LoadEmbeddedArt(const QString& filename) const;
@@ -118,6 +124,11 @@ class TagReader {
   static int ConvertToPOPMRating(const float rating);
   static TagLib::ID3v2::PopularimeterFrame* GetPOPMFrameFromTag(
       TagLib::ID3v2::Tag* tag);
+  // Saves the file in place if its tags still fit.  If the file has to be
+  // rewritten anyway, leaves extra padding after its tags so that the next
+  // saves fit.
+  static bool SaveFileRef(TagLib::FileRef* fileref, const QString& filename,
+                          bool* rewrote_file);
 
   FileRefFactory* factory_;
   QNetworkAccessManager* network_;
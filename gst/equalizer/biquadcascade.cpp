@@ -0,0 +1,209 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "biquadcascade.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// Two doubles that the compiler keeps in one SSE2 or NEON register, and
+// does arithmetic on together.
+typedef double Lanes __attribute__((vector_size(16)));
+
+// The coefficients step this often while they're ramping.
+const int kRampBlock = 32;
+
+}  // namespace
+
+const int BiquadCascade::kRampFrames = 512;
+
+BiquadCascade::BiquadCascade(int bands)
+    : rate_(0),
+      channels_(0),
+      bands_(bands, Band{1000.0, 100.0, 0.0}),
+      current_(bands),
+      target_(bands),
+      step_(bands),
+      ramp_left_(bands, 0),
+      ramping_(0) {
+  assert(bands > 0 && bands <= kMaxBands);
+}
+
+void BiquadCascade::SetFormat(int rate, int channels) {
+  rate_ = rate;
+  channels_ = channels;
+
+  history_.assign((channels + 1) / 2 * bands_.size() * 4, 0.0);
+  for (int i = 0; i < band_count(); ++i) {
+    current_[i] = target_[i] = Compute(bands_[i]);
+    ramp_left_[i] = 0;
+  }
+  ramping_ = 0;
+}
+
+void BiquadCascade::SetBand(int band, double frequency, double bandwidth,
+                            double gain_db) {
+  bands_[band] = Band{frequency, bandwidth, gain_db};
+  if (rate_ > 0) StartRamp(band);
+}
+
+BiquadCascade::Coefficients BiquadCascade::Compute(const Band& band) const {
+  if (rate_ <= 0 || band.gain_db_ == 0.0) return Coefficients{1, 0, 0, 0, 0};
+
+  const double gain = std::pow(10.0, band.gain_db_ / 40.0);
+
+  double omega;
+  if (band.frequency_ / rate_ >= 0.5) {
+    omega = M_PI;
+  } else if (band.frequency_ <= 0.0) {
+    omega = 0.0;
+  } else {
+    omega = 2.0 * M_PI * band.frequency_ / rate_;
+  }
+
+  double bandwidth;
+  if (band.bandwidth_ / rate_ >= 0.5) {
+    bandwidth = M_PI - 0.00001;
+  } else if (band.bandwidth_ <= 0.0) {
+    bandwidth = 0.00001;
+  } else {
+    bandwidth = 2.0 * M_PI * band.bandwidth_ / rate_;
+  }
+
+  const double alpha = std::tan(bandwidth / 2.0);
+  const double a0 = 1.0 + alpha / gain;
+  const double b1 = -2.0 * std::cos(omega) / a0;
+
+  return Coefficients{(1.0 + alpha * gain) / a0, b1,
+                      (1.0 - alpha * gain) / a0, b1,
+                      (1.0 - alpha / gain) / a0};
+}
+
+void BiquadCascade::StartRamp(int band) {
+  const int steps = kRampFrames / kRampBlock;
+  const Coefficients& from = current_[band];
+  target_[band] = Compute(bands_[band]);
+  const Coefficients& to = target_[band];
+
+  step_[band] = Coefficients{
+      (to.b0_ - from.b0_) / steps, (to.b1_ - from.b1_) / steps,
+      (to.b2_ - from.b2_) / steps, (to.a1_ - from.a1_) / steps,
+      (to.a2_ - from.a2_) / steps};
+
+  if (ramp_left_[band] == 0) ramping_++;
+  ramp_left_[band] = steps;
+}
+
+void BiquadCascade::AdvanceRamps() {
+  for (int i = 0; i < band_count(); ++i) {
+    if (ramp_left_[i] == 0) continue;
+
+    Coefficients& c = current_[i];
+    if (--ramp_left_[i] == 0) {
+      ramping_--;
+      c = target_[i];
+
+      // A flat band is skipped from now on.  Its history would have been
+      // zero anyway, so it can start from there when it's used again.
+      if (IsFlat(i)) {
+        for (size_t j = i * 4; j < history_.size(); j += bands_.size() * 4) {
+          std::fill(history_.begin() + j, history_.begin() + j + 4, 0.0);
+        }
+      }
+    } else {
+      const Coefficients& step = step_[i];
+      c.b0_ += step.b0_;
+      c.b1_ += step.b1_;
+      c.b2_ += step.b2_;
+      c.a1_ += step.a1_;
+      c.a2_ += step.a2_;
+    }
+  }
+}
+
+bool BiquadCascade::IsFlat(int band) const {
+  return bands_[band].gain_db_ == 0.0 && ramp_left_[band] == 0;
+}
+
+void BiquadCascade::Process(float* samples, int frames) {
+  if (channels_ <= 0) return;
+
+  while (frames > 0) {
+    const int block = ramping_ ? std::min(frames, kRampBlock) : frames;
+    FilterBlock(samples, block);
+    samples += block * channels_;
+    frames -= block;
+
+    if (ramping_) AdvanceRamps();
+  }
+}
+
+void BiquadCascade::FilterBlock(float* samples, int frames) {
+  int active[kMaxBands];
+  Lanes b0[kMaxBands], b1[kMaxBands], b2[kMaxBands];
+  Lanes a1[kMaxBands], a2[kMaxBands];
+  Lanes z1[kMaxBands], z2[kMaxBands];
+
+  int count = 0;
+  for (int i = 0; i < band_count(); ++i) {
+    if (IsFlat(i)) continue;
+
+    const Coefficients& c = current_[i];
+    b0[count] = Lanes{c.b0_, c.b0_};
+    b1[count] = Lanes{c.b1_, c.b1_};
+    b2[count] = Lanes{c.b2_, c.b2_};
+    a1[count] = Lanes{c.a1_, c.a1_};
+    a2[count] = Lanes{c.a2_, c.a2_};
+    active[count++] = i;
+  }
+  if (count == 0) return;
+
+  for (int channel = 0; channel < channels_; channel += 2) {
+    const bool pair = channel + 1 < channels_;
+    double* history = &history_[channel / 2 * bands_.size() * 4];
+
+    for (int i = 0; i < count; ++i) {
+      std::memcpy(&z1[i], history + active[i] * 4, sizeof(Lanes));
+      std::memcpy(&z2[i], history + active[i] * 4 + 2, sizeof(Lanes));
+    }
+
+    // Transposed direct form II, one band after another, for both channels
+    // at once.
+    float* frame = samples + channel;
+    for (int f = 0; f < frames; ++f, frame += channels_) {
+      Lanes x = {frame[0], pair ? frame[1] : 0.0};
+      for (int i = 0; i < count; ++i) {
+        const Lanes y = b0[i] * x + z1[i];
+        z1[i] = b1[i] * x - a1[i] * y + z2[i];
+        z2[i] = b2[i] * x - a2[i] * y;
+        x = y;
+      }
+
+      frame[0] = x[0];
+      if (pair) frame[1] = x[1];
+    }
+
+    for (int i = 0; i < count; ++i) {
+      std::memcpy(history + active[i] * 4, &z1[i], sizeof(Lanes));
+      std::memcpy(history + active[i] * 4 + 2, &z2[i], sizeof(Lanes));
+    }
+  }
+}
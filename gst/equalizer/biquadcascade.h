@@ -0,0 +1,83 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GST_EQUALIZER_BIQUADCASCADE_H_
+#define GST_EQUALIZER_BIQUADCASCADE_H_
+
+#include <vector>
+
+class BiquadCascade {
+  // A chain of peaking filters, with the same coefficients as the bands of
+  // GStreamer's equalizer-nbands.  Channels are filtered two at a time in
+  // the lanes of one SIMD register, so stereo costs the same as mono.
+  //
+  // When a band changes, its coefficients are moved towards the new ones
+  // over kRampFrames instead of all at once, so dragging a slider doesn't
+  // click.  Bands with no gain are skipped.
+  //
+  // Not thread safe.
+
+ public:
+  explicit BiquadCascade(int bands);
+
+  static const int kMaxBands = 32;
+  static const int kRampFrames;
+
+  int band_count() const { return bands_.size(); }
+
+  // Clears the filters' history.
+  void SetFormat(int rate, int channels);
+  void SetBand(int band, double frequency, double bandwidth, double gain_db);
+
+  // Filters interleaved samples in place.
+  void Process(float* samples, int frames);
+
+ private:
+  struct Band {
+    double frequency_;
+    double bandwidth_;
+    double gain_db_;
+  };
+
+  struct Coefficients {
+    double b0_, b1_, b2_;
+    double a1_, a2_;
+  };
+
+  Coefficients Compute(const Band& band) const;
+  void StartRamp(int band);
+  void AdvanceRamps();
+  bool IsFlat(int band) const;
+  void FilterBlock(float* samples, int frames);
+
+  int rate_;
+  int channels_;
+
+  std::vector<Band> bands_;
+  std::vector<Coefficients> current_;
+  std::vector<Coefficients> target_;
+  std::vector<Coefficients> step_;
+  // Blocks of frames left until each band reaches its target.
+  std::vector<int> ramp_left_;
+  int ramping_;
+
+  // For every pair of channels, each band's two history values, with one
+  // double for each channel.
+  std::vector<double> history_;
+};
+
+#endif  // GST_EQUALIZER_BIQUADCASCADE_H_
@@ -0,0 +1,231 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gstfastequalizer.h"
+
+#include "biquadcascade.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_fastequalizer_debug);
+#define GST_CAT_DEFAULT gst_fastequalizer_debug
+
+#define ALLOWED_CAPS \
+  GST_AUDIO_CAPS_MAKE (GST_AUDIO_NE (F32)) ", " \
+  "layout = (string) interleaved"
+
+/* The same bands as equalizer-10bands, each about an octave wide */
+static const gdouble kDefaultFreqs[GST_FASTEQUALIZER_BANDS] = {
+    29, 59, 119, 237, 474, 947, 1889, 3770, 7523, 15011};
+
+/* Each band has three properties, in this order, starting from 1 */
+enum {
+  PROP_GAIN,
+  PROP_FREQ,
+  PROP_BANDWIDTH,
+  PROPS_PER_BAND
+};
+
+#define gst_fastequalizer_parent_class parent_class
+G_DEFINE_TYPE (GstFastEqualizer, gst_fastequalizer, GST_TYPE_AUDIO_FILTER);
+
+static void gst_fastequalizer_finalize (GObject * object);
+static void gst_fastequalizer_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_fastequalizer_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static GstFlowReturn gst_fastequalizer_transform_ip (GstBaseTransform * trans,
+    GstBuffer * in);
+static gboolean gst_fastequalizer_setup (GstAudioFilter * base,
+    const GstAudioInfo * info);
+
+static void
+gst_fastequalizer_class_init (GstFastEqualizerClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstBaseTransformClass *trans_class = GST_BASE_TRANSFORM_CLASS (klass);
+  GstAudioFilterClass *filter_class = GST_AUDIO_FILTER_CLASS (klass);
+  GstCaps *caps;
+
+  gobject_class->set_property = gst_fastequalizer_set_property;
+  gobject_class->get_property = gst_fastequalizer_get_property;
+  gobject_class->finalize = gst_fastequalizer_finalize;
+
+  trans_class->transform_ip =
+      GST_DEBUG_FUNCPTR (gst_fastequalizer_transform_ip);
+
+  filter_class->setup = GST_DEBUG_FUNCPTR (gst_fastequalizer_setup);
+
+  const GParamFlags flags = GParamFlags (G_PARAM_READWRITE |
+      GST_PARAM_CONTROLLABLE | G_PARAM_STATIC_NICK | G_PARAM_STATIC_BLURB);
+
+  for (int i = 0; i < GST_FASTEQUALIZER_BANDS; ++i) {
+    const guint id = 1 + i * PROPS_PER_BAND;
+    gchar *name;
+
+    name = g_strdup_printf ("band%d", i);
+    g_object_class_install_property (gobject_class, id + PROP_GAIN,
+        g_param_spec_double (name, "Gain", "Gain of the band in dB",
+            -24.0, 12.0, 0.0, flags));
+    g_free (name);
+
+    name = g_strdup_printf ("freq%d", i);
+    g_object_class_install_property (gobject_class, id + PROP_FREQ,
+        g_param_spec_double (name, "Frequency",
+            "Center frequency of the band in Hz",
+            0.0, 100000.0, kDefaultFreqs[i], flags));
+    g_free (name);
+
+    name = g_strdup_printf ("bandwidth%d", i);
+    g_object_class_install_property (gobject_class, id + PROP_BANDWIDTH,
+        g_param_spec_double (name, "Bandwidth",
+            "Difference between the band edges in Hz",
+            0.0, 100000.0, kDefaultFreqs[i], flags));
+    g_free (name);
+  }
+
+  GST_DEBUG_CATEGORY_INIT (gst_fastequalizer_debug, "fastequalizer", 0,
+      "10 band equalizer element");
+
+  gst_element_class_set_static_metadata (element_class, "10 band equalizer",
+      "Filter/Effect/Audio",
+      "Peaking equalizer that filters every channel and band in one pass",
+      "David Sansome <me@davidsansome.com>");
+
+  caps = gst_caps_from_string (ALLOWED_CAPS);
+  gst_audio_filter_class_add_pad_templates (filter_class, caps);
+  gst_caps_unref (caps);
+}
+
+static void
+gst_fastequalizer_init (GstFastEqualizer * equalizer)
+{
+  equalizer->cascade = new BiquadCascade (GST_FASTEQUALIZER_BANDS);
+
+  for (int i = 0; i < GST_FASTEQUALIZER_BANDS; ++i) {
+    equalizer->gains[i] = 0.0;
+    equalizer->freqs[i] = kDefaultFreqs[i];
+    equalizer->bandwidths[i] = kDefaultFreqs[i];
+    equalizer->cascade->SetBand (i, equalizer->freqs[i],
+        equalizer->bandwidths[i], equalizer->gains[i]);
+  }
+
+  g_mutex_init (&equalizer->lock);
+}
+
+static void
+gst_fastequalizer_finalize (GObject * object)
+{
+  GstFastEqualizer *equalizer = GST_FASTEQUALIZER (object);
+
+  delete equalizer->cascade;
+  g_mutex_clear (&equalizer->lock);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_fastequalizer_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstFastEqualizer *equalizer = GST_FASTEQUALIZER (object);
+
+  if (prop_id < 1 || prop_id > GST_FASTEQUALIZER_BANDS * PROPS_PER_BAND) {
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    return;
+  }
+
+  const int band = (prop_id - 1) / PROPS_PER_BAND;
+  g_mutex_lock (&equalizer->lock);
+  switch ((prop_id - 1) % PROPS_PER_BAND) {
+    case PROP_GAIN:
+      equalizer->gains[band] = g_value_get_double (value);
+      break;
+    case PROP_FREQ:
+      equalizer->freqs[band] = g_value_get_double (value);
+      break;
+    case PROP_BANDWIDTH:
+      equalizer->bandwidths[band] = g_value_get_double (value);
+      break;
+  }
+  equalizer->cascade->SetBand (band, equalizer->freqs[band],
+      equalizer->bandwidths[band], equalizer->gains[band]);
+  g_mutex_unlock (&equalizer->lock);
+}
+
+static void
+gst_fastequalizer_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstFastEqualizer *equalizer = GST_FASTEQUALIZER (object);
+
+  if (prop_id < 1 || prop_id > GST_FASTEQUALIZER_BANDS * PROPS_PER_BAND) {
+    G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    return;
+  }
+
+  const int band = (prop_id - 1) / PROPS_PER_BAND;
+  switch ((prop_id - 1) % PROPS_PER_BAND) {
+    case PROP_GAIN:
+      g_value_set_double (value, equalizer->gains[band]);
+      break;
+    case PROP_FREQ:
+      g_value_set_double (value, equalizer->freqs[band]);
+      break;
+    case PROP_BANDWIDTH:
+      g_value_set_double (value, equalizer->bandwidths[band]);
+      break;
+  }
+}
+
+static gboolean
+gst_fastequalizer_setup (GstAudioFilter * base, const GstAudioInfo * info)
+{
+  GstFastEqualizer *equalizer = GST_FASTEQUALIZER (base);
+
+  if (GST_AUDIO_INFO_RATE (info) <= 0 || GST_AUDIO_INFO_CHANNELS (info) <= 0)
+    return FALSE;
+
+  g_mutex_lock (&equalizer->lock);
+  equalizer->cascade->SetFormat (GST_AUDIO_INFO_RATE (info),
+      GST_AUDIO_INFO_CHANNELS (info));
+  g_mutex_unlock (&equalizer->lock);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_fastequalizer_transform_ip (GstBaseTransform * trans, GstBuffer * buffer)
+{
+  GstFastEqualizer *equalizer = GST_FASTEQUALIZER (trans);
+  const gint channels = GST_AUDIO_FILTER_CHANNELS (equalizer);
+
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_GAP) || channels <= 0)
+    return GST_FLOW_OK;
+
+  GstMapInfo map;
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READWRITE))
+    return GST_FLOW_ERROR;
+
+  g_mutex_lock (&equalizer->lock);
+  equalizer->cascade->Process (reinterpret_cast<float*> (map.data),
+      map.size / (sizeof (float) * channels));
+  g_mutex_unlock (&equalizer->lock);
+
+  gst_buffer_unmap (buffer, &map);
+
+  return GST_FLOW_OK;
+}
@@ -0,0 +1,66 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// A 10 band equalizer that does the same as equalizer-nbands with peaking
+// bands, using BiquadCascade.  Each band has "bandN" (the gain in dB),
+// "freqN" and "bandwidthN" properties, N counting from 0.  Only takes
+// interleaved 32-bit float samples, which is what GstEnginePipeline has
+// at that point.
+
+#ifndef GST_EQUALIZER_FASTEQUALIZER_H_
+#define GST_EQUALIZER_FASTEQUALIZER_H_
+
+#include <gst/gst.h>
+#include <gst/audio/gstaudiofilter.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_FASTEQUALIZER            (gst_fastequalizer_get_type())
+#define GST_FASTEQUALIZER(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_FASTEQUALIZER,GstFastEqualizer))
+#define GST_IS_FASTEQUALIZER(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_FASTEQUALIZER))
+#define GST_FASTEQUALIZER_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_FASTEQUALIZER,GstFastEqualizerClass))
+#define GST_IS_FASTEQUALIZER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_FASTEQUALIZER))
+
+#define GST_FASTEQUALIZER_BANDS 10
+
+class BiquadCascade;
+
+struct GstFastEqualizer {
+  GstAudioFilter parent;
+
+  /* properties */
+  gdouble gains[GST_FASTEQUALIZER_BANDS];
+  gdouble freqs[GST_FASTEQUALIZER_BANDS];
+  gdouble bandwidths[GST_FASTEQUALIZER_BANDS];
+
+  /* <private> */
+  BiquadCascade* cascade;
+
+  // Held while the cascade is used, since the properties are set from
+  // other threads.
+  GMutex lock;
+};
+
+struct GstFastEqualizerClass {
+  GstAudioFilterClass parent_class;
+};
+
+GType gst_fastequalizer_get_type (void);
+
+G_END_DECLS
+
+#endif // GST_EQUALIZER_FASTEQUALIZER_H_
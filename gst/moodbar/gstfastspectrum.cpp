@@ -22,6 +22,7 @@
 #include <cstring>
 #include <cmath>
 
+#include <QHash>
 #include <QMutex>
 #include <QMutexLocker>
 
@@ -113,6 +114,7 @@ gst_fastspectrum_class_init (GstFastSpectrumClass * klass)
   gst_caps_unref (caps);
 
   klass->fftw_lock = new QMutex;
+  klass->fftw_plans = new QHash<guint, fftw_plan>;
 }
 
 static void
@@ -144,11 +146,20 @@ gst_fastspectrum_alloc_channel_data (GstFastSpectrum * spectrum)
       G_OBJECT_GET_CLASS(spectrum));
   {
     QMutexLocker l(klass->fftw_lock);
-    spectrum->plan = fftw_plan_dft_r2c_1d(
-        nfft,
-        spectrum->fft_input,
-        spectrum->fft_output,
-        FFTW_ESTIMATE);
+    fftw_plan& plan = (*klass->fftw_plans)[nfft];
+    if (!plan) {
+      // The planner can overwrite the arrays it's given, so it gets its own.
+      // Arrays from fftw_malloc all have the same alignment, so the plan can
+      // be run on any instance's buffers.
+      double* input =
+          reinterpret_cast<double*>(fftw_malloc(sizeof(double) * nfft));
+      fftw_complex* output = reinterpret_cast<fftw_complex*>(
+          fftw_malloc(sizeof(fftw_complex) * (nfft/2+1)));
+      plan = fftw_plan_dft_r2c_1d(nfft, input, output, FFTW_ESTIMATE);
+      fftw_free(input);
+      fftw_free(output);
+    }
+    spectrum->plan = plan;
   }
   spectrum->channel_data_initialised = true;
 }
@@ -156,13 +167,7 @@ gst_fastspectrum_alloc_channel_data (GstFastSpectrum * spectrum)
 static void
 gst_fastspectrum_free_channel_data (GstFastSpectrum * spectrum)
 {
-  GstFastSpectrumClass* klass = reinterpret_cast<GstFastSpectrumClass*>(
-      G_OBJECT_GET_CLASS(spectrum));
   if (spectrum->channel_data_initialised) {
-    {
-      QMutexLocker l(klass->fftw_lock);
-      fftw_destroy_plan(spectrum->plan);
-    }
     fftw_free(spectrum->fft_input);
     fftw_free(spectrum->fft_output);
     delete[] spectrum->input_ring_buffer;
@@ -275,63 +280,74 @@ gst_fastspectrum_stop (GstBaseTransform * trans)
 
 /* mixing data readers */
 
+/* Copies len samples into the ring buffer starting at op.  The copy is split
+ * where the ring buffer wraps around so each part is a plain loop the
+ * compiler can vectorize. */
+template <typename T, bool scaled>
+static inline void
+input_data_mixed (const guint8 * _in, double* out, guint len,
+    double max_value, guint op, guint nfft)
+{
+  const T *in = reinterpret_cast<const T *> (_in);
+
+  while (len > 0) {
+    const guint run = MIN (len, nfft - op);
+    double *dest = out + op;
+
+    for (guint j = 0; j < run; j++) {
+      dest[j] = scaled ? in[j] / max_value : in[j];
+    }
+
+    in += run;
+    len -= run;
+    op = 0;
+  }
+}
+
 static void
 input_data_mixed_float(const guint8* _in, double* out, guint len,
                        double max_value, guint op, guint nfft)
 {
-  guint j, ip = 0;
-  gfloat *in = (gfloat *) _in;
-
-  for (j = 0; j < len; j++) {
-    out[op] = in[ip++];
-    op = (op + 1) % nfft;
-  }
+  input_data_mixed<gfloat, false> (_in, out, len, max_value, op, nfft);
 }
 
 static void
 input_data_mixed_double (const guint8 * _in, double* out, guint len,
     double max_value, guint op, guint nfft)
 {
-  guint j, ip = 0;
-  gdouble *in = (gdouble *) _in;
-
-  for (j = 0; j < len; j++) {
-    out[op] = in[ip++];
-    op = (op + 1) % nfft;
-  }
+  input_data_mixed<gdouble, false> (_in, out, len, max_value, op, nfft);
 }
 
 static void
 input_data_mixed_int32_max (const guint8 * _in, double* out, guint len,
     double max_value, guint op, guint nfft)
 {
-  guint j, ip = 0;
-  gint32 *in = (gint32 *) _in;
-
-  for (j = 0; j < len; j++) {
-    out[op] = in[ip++] / max_value;
-    op = (op + 1) % nfft;
-  }
+  input_data_mixed<gint32, true> (_in, out, len, max_value, op, nfft);
 }
 
 static void
 input_data_mixed_int24_max (const guint8 * _in, double* out, guint len,
     double max_value, guint op, guint nfft)
 {
-  guint j;
+  while (len > 0) {
+    const guint run = MIN (len, nfft - op);
+    double *dest = out + op;
 
-  for (j = 0; j < len; j++) {
+    for (guint j = 0; j < run; j++) {
 #if G_BYTE_ORDER == G_BIG_ENDIAN
-    gint32 value = GST_READ_UINT24_BE (_in);
+      gint32 value = GST_READ_UINT24_BE (_in);
 #else
-    gint32 value = GST_READ_UINT24_LE (_in);
+      gint32 value = GST_READ_UINT24_LE (_in);
 #endif
-    if (value & 0x00800000)
-      value |= 0xff000000;
+      if (value & 0x00800000)
+        value |= 0xff000000;
+
+      dest[j] = value / max_value;
+      _in += 3;
+    }
 
-    out[op] = value / max_value;
-    op = (op + 1) % nfft;
-    _in += 3;
+    len -= run;
+    op = 0;
   }
 }
 
@@ -339,13 +355,7 @@ static void
 input_data_mixed_int16_max (const guint8 * _in, double * out, guint len,
     double max_value, guint op, guint nfft)
 {
-  guint j, ip = 0;
-  gint16 *in = (gint16 *) _in;
-
-  for (j = 0; j < len; j++) {
-    out[op] = in[ip++] / max_value;
-    op = (op + 1) % nfft;
-  }
+  input_data_mixed<gint16, true> (_in, out, len, max_value, op, nfft);
 }
 
 static gboolean
@@ -390,20 +400,24 @@ gst_fastspectrum_run_fft (GstFastSpectrum * spectrum, guint input_pos)
   guint bands = spectrum->bands;
   guint nfft = 2 * bands - 2;
 
-  for (i = 0; i < nfft; i++)
-    spectrum->fft_input[i] =
-        spectrum->input_ring_buffer[(input_pos + i) % nfft];
+  /* Unroll the ring buffer, oldest sample first */
+  memcpy (spectrum->fft_input, spectrum->input_ring_buffer + input_pos,
+      sizeof(double) * (nfft - input_pos));
+  memcpy (spectrum->fft_input + (nfft - input_pos),
+      spectrum->input_ring_buffer, sizeof(double) * input_pos);
 
-  // Should be safe to execute the same plan multiple times in parallel.
-  fftw_execute(spectrum->plan);
+  // The plan is shared, but executing it on new arrays is thread safe.
+  fftw_execute_dft_r2c(spectrum->plan, spectrum->fft_input,
+      spectrum->fft_output);
 
-  gdouble val;
   /* Calculate magnitude in db */
+  const double* output = reinterpret_cast<const double*>(spectrum->fft_output);
+  const double scale = 1.0 / (double(nfft) * nfft);
+  double* magnitude = spectrum->spect_magnitude;
   for (i = 0; i < bands; i++) {
-    val = spectrum->fft_output[i][0] * spectrum->fft_output[i][0];
-    val += spectrum->fft_output[i][1] * spectrum->fft_output[i][1];
-    val /= nfft * nfft;
-    spectrum->spect_magnitude[i] += val;
+    const double re = output[2 * i];
+    const double im = output[2 * i + 1];
+    magnitude[i] += (re * re + im * im) * scale;
   }
 }
 
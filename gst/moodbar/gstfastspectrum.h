@@ -44,6 +44,7 @@ G_BEGIN_DECLS
 #define GST_IS_FASTSPECTRUM_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_FASTSPECTRUM))
 
 class QMutex;
+template <class Key, class T> class QHash;
 
 typedef void (*GstFastSpectrumInputData)(const guint8* in, double* out,
     guint len, double max_value, guint op, guint nfft);
@@ -71,6 +72,8 @@ struct GstFastSpectrum {
   double* fft_input;
   fftw_complex* fft_output;
   double* spect_magnitude;
+  // Shared with every other instance using the same number of bands, so only
+  // ever run with fftw_execute_dft_r2c.
   fftw_plan plan;
 
   guint input_pos;
@@ -87,8 +90,11 @@ struct GstFastSpectrum {
 struct GstFastSpectrumClass {
   GstAudioFilterClass parent_class;
 
-  // Static lock for creating & destroying FFTW plans.
+  // Static lock for creating FFTW plans.
   QMutex* fftw_lock;
+  // Plans keyed on FFT size.  They're created the first time an instance
+  // needs one and kept for as long as the process runs.
+  QHash<guint, fftw_plan>* fftw_plans;
 };
 
 GType gst_fastspectrum_get_type (void);
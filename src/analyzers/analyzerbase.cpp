@@ -30,9 +30,12 @@
 #include <QEvent>
 #include <QPainter>
 #include <QPaintEvent>
+#include <QtConcurrentRun>
 #include <QtDebug>
 
 #include "core/arraysize.h"
+#include "core/closure.h"
+#include "engines/spectrumservice.h"
 
 // INSTRUCTIONS Base2D
 // 1. do anything that depends on height() in init(), Base2D will call it before
@@ -60,11 +63,21 @@ static const int sBarkBands[] = {
 
 static const int sBarkBandCount = arraysize(sBarkBands);
 
+const int Analyzer::Base::kLateFrameLimit = 5;
+const int Analyzer::Base::kOnTimeFrameLimit = 50;
+const int Analyzer::Base::kMaxTimeoutFactor = 4;
+
 Analyzer::Base::Base(QWidget* parent, uint scopeSize)
     : QWidget(parent),
       timeout_(40),  // msec
+      frame_timeout_(timeout_),
+      late_frames_(0),
+      on_time_frames_(0),
       fht_(new FHT(scopeSize)),
       engine_(nullptr),
+      spectrum_(nullptr),
+      listening_exp_(0),
+      spectrum_version_(0),
       lastScope_(512),
       new_frame_(false),
       is_playing_(false),
@@ -73,26 +86,72 @@ Analyzer::Base::Base(QWidget* parent, uint scopeSize)
       bands_(0),
       psychedelic_enabled_(false) {}
 
-void Analyzer::Base::hideEvent(QHideEvent*) { timer_.stop(); }
+Analyzer::Base::~Base() {
+  StopListening();
+  transform_future_.waitForFinished();
+  delete fht_;
+}
+
+void Analyzer::Base::set_engine(EngineBase* engine) {
+  StopListening();
+  engine_ = engine;
+  spectrum_ = engine ? engine->spectrum_service() : nullptr;
+  if (isVisible()) StartListening();
+}
+
+void Analyzer::Base::StartListening() {
+  if (!spectrum_ || listening_exp_) return;
+  listening_exp_ = fht_->sizeExp();
+  spectrum_->AddListener(listening_exp_);
+  spectrum_version_ = 0;
+}
+
+void Analyzer::Base::StopListening() {
+  if (!listening_exp_) return;
+  spectrum_->RemoveListener(listening_exp_);
+  listening_exp_ = 0;
+}
+
+void Analyzer::Base::changeTimeout(uint newTimeout) {
+  timeout_ = newTimeout;
+  late_frames_ = 0;
+  on_time_frames_ = 0;
+  SetFrameTimeout(timeout_);
+}
 
-void Analyzer::Base::showEvent(QShowEvent*) { timer_.start(timeout(), this); }
+void Analyzer::Base::SetFrameTimeout(uint timeout) {
+  frame_timeout_ = timeout;
+  if (timer_.isActive()) {
+    timer_.stop();
+    timer_.start(frame_timeout_, this);
+  }
+}
+
+bool Analyzer::Base::event(QEvent* e) {
+  // Subclasses change the things transform() uses when they're resized
+  if (e->type() == QEvent::Resize) transform_future_.waitForFinished();
+  return QWidget::event(e);
+}
+
+void Analyzer::Base::hideEvent(QHideEvent*) {
+  timer_.stop();
+  StopListening();
+}
+
+void Analyzer::Base::showEvent(QShowEvent*) {
+  StartListening();
+  frame_clock_.invalidate();
+  timer_.start(frame_timeout_, this);
+}
 
 void Analyzer::Base::transform(Scope& scope) {
   // this is a standard transformation that should give
   // an FFT scope that has bands for pretty analyzers
 
-  // NOTE resizing here is redundant as FHT routines only calculate FHT::size()
-  // values
-  // scope.resize( fht_->size() );
-
   QVector<float> aux(fht_->size());
-  if (aux.size() >= scope.size()) {
-    qCopy(scope.begin(), scope.end(), aux.begin());
-  } else {
-    qCopy(scope.begin(), scope.begin() + aux.size(), aux.begin());
-  }
+  qCopy(scope.begin(), scope.begin() + aux.size(), aux.begin());
 
-  fht_->logSpectrum(scope.data(), aux.data());
+  fht_->logSpectrumFromPower2(scope.data(), aux.data());
   fht_->scale(scope.data(), 1.0 / 20);
 
   scope.resize(fht_->size() / 2);  // second half of values are rubbish
@@ -103,26 +162,11 @@ void Analyzer::Base::paintEvent(QPaintEvent* e) {
   p.fillRect(e->rect(), palette().color(QPalette::Window));
 
   switch (engine_->state()) {
-    case Engine::Playing: {
-      const Engine::Scope& thescope = engine_->scope(timeout_);
-      int i = 0;
-
-      // convert to mono here - our built in analyzers need mono, but the
-      // engines provide interleaved pcm
-      for (uint x = 0; static_cast<int>(x) < fht_->size(); ++x) {
-        lastScope_[x] = static_cast<double>(thescope[i] + thescope[i + 1]) /
-                        (2 * (1 << 15));
-        i += 2;
-      }
-
+    case Engine::Playing:
+      // lastScope_ was transformed by the worker thread in timerEvent
       is_playing_ = true;
-      transform(lastScope_);
       analyze(p, lastScope_, new_frame_);
-
-      // scope.resize( fht_->size() );
-
       break;
-    }
     case Engine::Paused:
       is_playing_ = false;
       analyze(p, lastScope_, new_frame_);
@@ -143,8 +187,14 @@ int Analyzer::Base::resizeExponent(int exp) {
     exp = 9;
 
   if (exp != fht_->sizeExp()) {
+    transform_future_.waitForFinished();
     delete fht_;
     fht_ = new FHT(exp);
+
+    if (listening_exp_) {
+      StopListening();
+      StartListening();
+    }
   }
   return exp;
 }
@@ -281,6 +331,61 @@ void Analyzer::Base::timerEvent(QTimerEvent* e) {
   QWidget::timerEvent(e);
   if (e->timerId() != timer_.timerId()) return;
 
+  if (frame_clock_.isValid()) {
+    UpdateFramePacing(frame_clock_.restart());
+  } else {
+    frame_clock_.start();
+  }
+
+  if (listening_exp_ && engine_->state() == Engine::Playing) {
+    // Drop this frame if the last one is still being worked on
+    if (!transform_future_.isFinished()) return;
+
+    // Nothing to transform if the spectrum hasn't moved on, the analyzer can
+    // carry on animating the last one.
+    const quint64 version = spectrum_->Read(listening_exp_, &transform_scope_);
+    if (version == 0 || version == spectrum_version_) {
+      new_frame_ = true;
+      RequestFrame();
+      return;
+    }
+    spectrum_version_ = version;
+
+    transform_future_ = QtConcurrent::run(this, &Base::TransformScope);
+    NewClosure(transform_future_, this, SLOT(TransformFinished()));
+    return;
+  }
+
+  new_frame_ = true;
+  RequestFrame();
+}
+
+void Analyzer::Base::TransformScope() { transform(transform_scope_); }
+
+void Analyzer::Base::TransformFinished() {
+  lastScope_ = transform_scope_;
   new_frame_ = true;
-  update();
+  RequestFrame();
+}
+
+void Analyzer::Base::UpdateFramePacing(qint64 elapsed_msec) {
+  // Timer events arrive late when the GUI event loop is busy (scanning the
+  // library, filling a big playlist...), so back off rather than compete with
+  // the item views.  Frames still being transformed count as late too.
+  const bool late = elapsed_msec > frame_timeout_ * 3 / 2 ||
+                    !transform_future_.isFinished();
+  if (late) {
+    on_time_frames_ = 0;
+    if (++late_frames_ >= kLateFrameLimit &&
+        frame_timeout_ < timeout_ * kMaxTimeoutFactor) {
+      late_frames_ = 0;
+      SetFrameTimeout(qMin(frame_timeout_ * 2, timeout_ * kMaxTimeoutFactor));
+    }
+  } else {
+    late_frames_ = 0;
+    if (++on_time_frames_ >= kOnTimeFrameLimit && frame_timeout_ > timeout_) {
+      on_time_frames_ = 0;
+      SetFrameTimeout(qMax(frame_timeout_ / 2, timeout_));
+    }
+  }
 }
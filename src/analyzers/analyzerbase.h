@@ -35,6 +35,8 @@
 #include "engines/enginebase.h"
 #include <QPixmap>
 #include <QBasicTimer>
+#include <QElapsedTimer>
+#include <QFuture>
 #include <QWidget>
 #include <vector>
 
@@ -59,19 +61,13 @@ class Base : public QWidget {
   Q_OBJECT
 
  public:
-  ~Base() { delete fht_; }
+  ~Base();
 
   uint timeout() const { return timeout_; }
 
-  void set_engine(EngineBase* engine) { engine_ = engine; }
+  void set_engine(EngineBase* engine);
 
-  void changeTimeout(uint newTimeout) {
-    timeout_ = newTimeout;
-    if (timer_.isActive()) {
-      timer_.stop();
-      timer_.start(timeout_, this);
-    }
-  }
+  void changeTimeout(uint newTimeout);
 
   virtual void framerateChanged() {}
   virtual void psychedelicModeChanged(bool);
@@ -79,6 +75,7 @@ class Base : public QWidget {
  protected:
   explicit Base(QWidget*, uint scopeSize = 7);
 
+  bool event(QEvent*);
   void hideEvent(QHideEvent*);
   void showEvent(QShowEvent*);
   void paintEvent(QPaintEvent*);
@@ -92,18 +89,59 @@ class Base : public QWidget {
   void updateBandSize(const int);
   QColor getPsychedelicColor(const Scope&, const int, const int);
   virtual void init() {}
+  // Gets the output of FHT::power2 from the engine's SpectrumService, and
+  // turns it into whatever analyze() wants.
   virtual void transform(Scope&);
   virtual void analyze(QPainter& p, const Scope&, bool new_frame) = 0;
   virtual void demo(QPainter& p);
+  // Called when there's a new frame to show.  Repaints the widget, which
+  // calls analyze() or demo().  Analyzers that don't draw with a QPainter
+  // reimplement this.
+  virtual void RequestFrame() { update(); }
+
+ private slots:
+  void TransformFinished();
+
+ private:
+  // Runs transform() on transform_scope_, in a worker thread.
+  void TransformScope();
+  // Asks the SpectrumService for spectra of fht_'s size while the analyzer
+  // is visible.
+  void StartListening();
+  void StopListening();
+  void UpdateFramePacing(qint64 elapsed_msec);
+  void SetFrameTimeout(uint timeout);
 
  protected:
   static const int kSampleRate =
       44100;  // we shouldn't need to care about ultrasonics
 
+  // How many frames in a row have to be late, or on time, before the frame
+  // timeout is stretched or brought back towards timeout_.
+  static const int kLateFrameLimit;
+  static const int kOnTimeFrameLimit;
+  static const int kMaxTimeoutFactor;
+
   QBasicTimer timer_;
   uint timeout_;
+  // timeout_, stretched while the GUI event loop can't keep up
+  uint frame_timeout_;
+  QElapsedTimer frame_clock_;
+  int late_frames_;
+  int on_time_frames_;
+
+  // The scope is transformed in a worker thread, and copied into lastScope_
+  // when it's done.
+  Scope transform_scope_;
+  QFuture<void> transform_future_;
+
   FHT* fht_;
   EngineBase* engine_;
+  SpectrumService* spectrum_;
+  // The FHT size registered with spectrum_, or 0.
+  int listening_exp_;
+  // Version of the spectrum in lastScope_ or being transformed.
+  quint64 spectrum_version_;
   Scope lastScope_;
 
   bool new_frame_;
@@ -26,6 +26,7 @@
 #include "boomanalyzer.h"
 #include "sonogram.h"
 #include "rainbowanalyzer.h"
+#include "shaderanalyzer.h"
 #include "turbine.h"
 #include "core/logging.h"
 
@@ -81,6 +82,10 @@ AnalyzerContainer::AnalyzerContainer(QWidget* parent)
   AddAnalyzerType<TurbineAnalyzer>();
   AddAnalyzerType<Rainbow::NyanCatAnalyzer>();
   AddAnalyzerType<Rainbow::RainbowDashAnalyzer>();
+  if (QGLFormat::hasOpenGL()) {
+    AddAnalyzerType<ShaderBarAnalyzer>();
+    AddAnalyzerType<ShaderSonogram>();
+  }
 
   connect(mapper_, SIGNAL(mapped(int)), SLOT(ChangeAnalyzer(int)));
   disable_action_ = context_menu_->addAction(tr("No analyzer"), this,
@@ -20,9 +20,207 @@
 /* Original Author:  Melchior FRANZ  <mfranz@kde.org>  2004
 */
 
-#include <cmath>
 #include "fht.h"
 
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FHT_HAVE_X86_KERNELS
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FHT_HAVE_NEON_KERNELS
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// The loops that run over every value of the scope each frame.  n is the
+// number of values in the half spectrum, so the power2 kernels read p[0, 2n).
+struct Kernels {
+  // p[i] *= d
+  void (*scale)(float* p, int n, float d);
+  // d[i] = d[i] * w + s[i] * (1 - w)
+  void (*ewma)(float* d, const float* s, int n, float w);
+  // p[i] = p[i]^2 + p[2n - i]^2 for 0 < i < n
+  void (*power2)(float* p, int n);
+  // p[i] = sqrt(p[i] * d)
+  void (*sqrt)(float* p, int n, float d);
+};
+
+void ScaleScalar(float* p, int n, float d) {
+  for (int i = 0; i < n; ++i) p[i] *= d;
+}
+
+void EwmaScalar(float* d, const float* s, int n, float w) {
+  const float v = 1 - w;
+  for (int i = 0; i < n; ++i) d[i] = d[i] * w + s[i] * v;
+}
+
+void Power2Range(float* p, int begin, int n) {
+  const float* q = p + 2 * n;
+  for (int i = begin; i < n; ++i) p[i] = p[i] * p[i] + q[-i] * q[-i];
+}
+
+void Power2Scalar(float* p, int n) { Power2Range(p, 1, n); }
+
+void SqrtScalar(float* p, int n, float d) {
+  for (int i = 0; i < n; ++i) p[i] = std::sqrt(p[i] * d);
+}
+
+#ifdef FHT_HAVE_X86_KERNELS
+__attribute__((target("sse2"))) void ScaleSse2(float* p, int n, float d) {
+  const __m128 dv = _mm_set1_ps(d);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(p + i, _mm_mul_ps(_mm_loadu_ps(p + i), dv));
+  }
+  ScaleScalar(p + i, n - i, d);
+}
+
+__attribute__((target("sse2"))) void EwmaSse2(float* d, const float* s,
+                                              int n, float w) {
+  const __m128 wv = _mm_set1_ps(w);
+  const __m128 vv = _mm_set1_ps(1 - w);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m128 x = _mm_mul_ps(_mm_loadu_ps(d + i), wv);
+    const __m128 y = _mm_mul_ps(_mm_loadu_ps(s + i), vv);
+    _mm_storeu_ps(d + i, _mm_add_ps(x, y));
+  }
+  EwmaScalar(d + i, s + i, n - i, w);
+}
+
+__attribute__((target("sse2"))) void Power2Sse2(float* p, int n) {
+  // The values written are all below n and the ones read back are above it,
+  // so this works in place.
+  const float* q = p + 2 * n;
+  int i = 1;
+  for (; i + 4 <= n; i += 4) {
+    const __m128 a = _mm_loadu_ps(p + i);
+    __m128 b = _mm_loadu_ps(q - i - 3);
+    b = _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 1, 2, 3));
+    _mm_storeu_ps(p + i, _mm_add_ps(_mm_mul_ps(a, a), _mm_mul_ps(b, b)));
+  }
+  Power2Range(p, i, n);
+}
+
+__attribute__((target("sse2"))) void SqrtSse2(float* p, int n, float d) {
+  const __m128 dv = _mm_set1_ps(d);
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(p + i, _mm_sqrt_ps(_mm_mul_ps(_mm_loadu_ps(p + i), dv)));
+  }
+  SqrtScalar(p + i, n - i, d);
+}
+
+__attribute__((target("avx"))) void ScaleAvx(float* p, int n, float d) {
+  const __m256 dv = _mm256_set1_ps(d);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(p + i, _mm256_mul_ps(_mm256_loadu_ps(p + i), dv));
+  }
+  ScaleScalar(p + i, n - i, d);
+}
+
+__attribute__((target("avx"))) void EwmaAvx(float* d, const float* s, int n,
+                                            float w) {
+  const __m256 wv = _mm256_set1_ps(w);
+  const __m256 vv = _mm256_set1_ps(1 - w);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 x = _mm256_mul_ps(_mm256_loadu_ps(d + i), wv);
+    const __m256 y = _mm256_mul_ps(_mm256_loadu_ps(s + i), vv);
+    _mm256_storeu_ps(d + i, _mm256_add_ps(x, y));
+  }
+  EwmaScalar(d + i, s + i, n - i, w);
+}
+
+__attribute__((target("avx"))) void Power2Avx(float* p, int n) {
+  const float* q = p + 2 * n;
+  int i = 1;
+  for (; i + 8 <= n; i += 8) {
+    const __m256 a = _mm256_loadu_ps(p + i);
+    __m256 b = _mm256_loadu_ps(q - i - 7);
+    b = _mm256_permute2f128_ps(b, b, 1);
+    b = _mm256_permute_ps(b, _MM_SHUFFLE(0, 1, 2, 3));
+    _mm256_storeu_ps(p + i,
+                     _mm256_add_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b)));
+  }
+  Power2Range(p, i, n);
+}
+
+__attribute__((target("avx"))) void SqrtAvx(float* p, int n, float d) {
+  const __m256 dv = _mm256_set1_ps(d);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    _mm256_storeu_ps(p + i,
+                     _mm256_sqrt_ps(_mm256_mul_ps(_mm256_loadu_ps(p + i), dv)));
+  }
+  SqrtScalar(p + i, n - i, d);
+}
+#endif  // FHT_HAVE_X86_KERNELS
+
+#ifdef FHT_HAVE_NEON_KERNELS
+void ScaleNeon(float* p, int n, float d) {
+  int i = 0;
+  for (; i + 4 <= n; i += 4) vst1q_f32(p + i, vmulq_n_f32(vld1q_f32(p + i), d));
+  ScaleScalar(p + i, n - i, d);
+}
+
+void EwmaNeon(float* d, const float* s, int n, float w) {
+  int i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const float32x4_t x = vmulq_n_f32(vld1q_f32(d + i), w);
+    vst1q_f32(d + i, vmlaq_n_f32(x, vld1q_f32(s + i), 1 - w));
+  }
+  EwmaScalar(d + i, s + i, n - i, w);
+}
+
+void Power2Neon(float* p, int n) {
+  const float* q = p + 2 * n;
+  int i = 1;
+  for (; i + 4 <= n; i += 4) {
+    const float32x4_t a = vld1q_f32(p + i);
+    float32x4_t b = vrev64q_f32(vld1q_f32(q - i - 3));
+    b = vcombine_f32(vget_high_f32(b), vget_low_f32(b));
+    vst1q_f32(p + i, vmlaq_f32(vmulq_f32(a, a), b, b));
+  }
+  Power2Range(p, i, n);
+}
+#endif  // FHT_HAVE_NEON_KERNELS
+
+Kernels ChooseKernels() {
+  Kernels ret = {&ScaleScalar, &EwmaScalar, &Power2Scalar, &SqrtScalar};
+
+#ifdef FHT_HAVE_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx")) {
+    Kernels avx = {&ScaleAvx, &EwmaAvx, &Power2Avx, &SqrtAvx};
+    ret = avx;
+  } else if (__builtin_cpu_supports("sse2")) {
+    Kernels sse2 = {&ScaleSse2, &EwmaSse2, &Power2Sse2, &SqrtSse2};
+    ret = sse2;
+  }
+#endif
+
+#ifdef FHT_HAVE_NEON_KERNELS
+  // NEON is part of the target architecture, so there's nothing to check.
+  // Only AArch64 has a vector square root.
+  ret.scale = &ScaleNeon;
+  ret.ewma = &EwmaNeon;
+  ret.power2 = &Power2Neon;
+#endif
+
+  return ret;
+}
+
+const Kernels& SelectedKernels() {
+  static const Kernels kernels = ChooseKernels();
+  return kernels;
+}
+
+}  // namespace
+
 FHT::FHT(int n) : num_((n < 3) ? 0 : 1 << n), exp2_((n < 3) ? -1 : n) {
   if (n > 3) {
     buf_vector_.resize(num_);
@@ -54,15 +252,18 @@ void FHT::makeCasTable(void) {
   }
 }
 
-void FHT::scale(float* p, float d) {
-  for (int i = 0; i < (num_ / 2); i++) *p++ *= d;
-}
+void FHT::scale(float* p, float d) { SelectedKernels().scale(p, num_ / 2, d); }
 
 void FHT::ewma(float* d, float* s, float w) {
-  for (int i = 0; i < (num_ / 2); i++, d++, s++) *d = *d * w + *s * (1 - w);
+  SelectedKernels().ewma(d, s, num_ / 2, w);
 }
 
 void FHT::logSpectrum(float* out, float* p) {
+  power2(p);
+  logSpectrumFromPower2(out, p);
+}
+
+void FHT::logSpectrumFromPower2(float* out, float* p) {
   int n = num_ / 2, i, j, k, *r;
   if (log_vector_.size() < n) {
     log_vector_.resize(n);
@@ -72,7 +273,7 @@ void FHT::logSpectrum(float* out, float* p) {
       *r = j >= n ? n - 1 : j;
     }
   }
-  semiLogSpectrum(p);
+  semiLogFromPower2(p);
   *out++ = *p = *p / 100;
   for (k = i = 1, r = log_(); i < n; i++) {
     j = *r++;
@@ -88,35 +289,38 @@ void FHT::logSpectrum(float* out, float* p) {
 
 void FHT::semiLogSpectrum(float* p) {
   power2(p);
+  semiLogFromPower2(p);
+}
+
+void FHT::semiLogFromPower2(float* p) {
   for (int i = 0; i < (num_ / 2); i++, p++) {
-    float e = 10.0 * log10(sqrt(*p / 2));
+    // 10 * log10(sqrt(x / 2)), without the square root
+    float e = 5.0f * std::log10(*p / 2);
     *p = e < 0 ? 0 : e;
   }
 }
 
-void FHT::spectrum(float* p) {
+void FHT::spectrum(float* p) { spectrum(p, 1.0f); }
+
+void FHT::spectrum(float* p, float factor) {
   power2(p);
-  for (int i = 0; i < (num_ / 2); i++, p++)
-    *p = static_cast<float>(sqrt(*p / 2));
+  spectrumFromPower2(p, factor);
+}
+
+void FHT::spectrumFromPower2(float* p, float factor) {
+  SelectedKernels().sqrt(p, num_ / 2, 0.5f * factor * factor);
 }
 
 void FHT::power(float* p) {
   power2(p);
-  for (int i = 0; i < (num_ / 2); i++) *p++ /= 2;
+  SelectedKernels().scale(p, num_ / 2, 0.5f);
 }
 
 void FHT::power2(float* p) {
   _transform(p, num_, 0);
 
-  *p = static_cast<float>(2 * pow(*p, 2));
-  p++;
-
-  float* q = p + num_ - 2;
-  for (int i = 1; i < (num_ / 2); i++) {
-    *p = static_cast<float>(pow(*p, 2) + pow(*q, 2));
-    p++;
-    q--;
-  }
+  *p = 2 * *p * *p;
+  SelectedKernels().power2(p, num_ / 2);
 }
 
 void FHT::transform(float* p) {
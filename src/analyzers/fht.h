@@ -57,6 +57,8 @@ class FHT {
    */
   void _transform(float*, int, int);
 
+  void semiLogFromPower2(float*);
+
  public:
   /**
   * Prepare transform for data sets with @f$2^n@f$ numbers, whereby @f$n@f$
@@ -87,6 +89,11 @@ class FHT {
    */
   void logSpectrum(float* out, float* p);
 
+  /**
+   * logSpectrum of data that power2 has already been run on.
+   */
+  void logSpectrumFromPower2(float* out, float* p);
+
   /**
    * Semi-logarithmic audio spectrum.
    */
@@ -97,6 +104,16 @@ class FHT {
    */
   void spectrum(float*);
 
+  /**
+   * Fourier spectrum multiplied by factor, in one pass over the data.
+   */
+  void spectrum(float*, float factor);
+
+  /**
+   * spectrum of data that power2 has already been run on.
+   */
+  void spectrumFromPower2(float*, float factor = 1.0f);
+
   /**
    * Calculates a mathematically correct FFT power spectrum.
    * If further scaling is applied later, use power2 instead
@@ -73,7 +73,9 @@ Rainbow::RainbowAnalyzer::RainbowAnalyzer(const RainbowType& rbtype,
   }
 }
 
-void Rainbow::RainbowAnalyzer::transform(Scope& s) { fht_->spectrum(s.data()); }
+void Rainbow::RainbowAnalyzer::transform(Scope& s) {
+  fht_->spectrumFromPower2(s.data());
+}
 
 void Rainbow::RainbowAnalyzer::timerEvent(QTimerEvent* e) {
   if (e->timerId() == timer_id_) {
@@ -0,0 +1,348 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "shaderanalyzer.h"
+
+#include <cmath>
+
+#include <QGLShaderProgram>
+
+#include "core/logging.h"
+
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+
+using Analyzer::Scope;
+
+namespace {
+
+const char* kVertexShader =
+    "attribute vec2 vertex;\n"
+    "varying vec2 position;\n"
+    "void main() {\n"
+    "  position = vertex * 0.5 + 0.5;\n"
+    "  gl_Position = vec4(vertex, 0.0, 1.0);\n"
+    "}\n";
+
+// Covers the whole widget, as a triangle strip.
+const GLfloat kRectangle[] = {-1.0, -1.0, 1.0, -1.0, -1.0, 1.0, 1.0, 1.0};
+
+const char* kHsvFunction =
+    "vec3 hsv(float h, float s, float v) {\n"
+    "  vec3 p = abs(fract(vec3(h) + vec3(1.0, 2.0, 1.0) / 3.0) * 6.0 - 3.0);\n"
+    "  return v * mix(vec3(1.0), clamp(p - 1.0, 0.0, 1.0), s);\n"
+    "}\n";
+
+// How far the bars fall, and how quickly the peaks speed up as they fall,
+// each frame.  As fractions of the height.
+const float kBarFall = 0.02;
+const float kPeakGravity = 0.0005;
+
+const char* kBarShader =
+    "uniform sampler2D data;\n"
+    "uniform vec2 size;\n"
+    "uniform vec4 background;\n"
+    "uniform vec4 foreground;\n"
+    "uniform float bands;\n"
+    "uniform float column_width;\n"
+    "varying vec2 position;\n"
+    "void main() {\n"
+    "  float x = position.x * size.x;\n"
+    "  float band = floor(x / (column_width + 1.0));\n"
+    "  if (band >= bands ||\n"
+    "      x - band * (column_width + 1.0) >= column_width) {\n"
+    "    gl_FragColor = background;\n"
+    "    return;\n"
+    "  }\n"
+    "  vec4 texel = texture2D(data, vec2((band + 0.5) / bands, 0.5));\n"
+    "  if (position.y <= texel.r) {\n"
+    "    gl_FragColor = vec4(mix(foreground.r, 1.0, position.y),\n"
+    "                        foreground.gba);\n"
+    "  } else if (abs(position.y - texel.a) * size.y < 1.0) {\n"
+    "    gl_FragColor = mix(foreground, vec4(1.0), 0.5);\n"
+    "  } else {\n"
+    "    gl_FragColor = background;\n"
+    "  }\n"
+    "}\n";
+
+// The colours are the same as Sonogram's.  The texture holds the square root
+// of each value, so the quiet ones keep some precision, and the hue of the
+// psychedelic colour for the column.
+const char* kSonogramShader =
+    "uniform sampler2D data;\n"
+    "uniform vec2 size;\n"
+    "uniform vec4 background;\n"
+    "uniform float offset;\n"
+    "uniform float rows;\n"
+    "uniform bool psychedelic;\n"
+    "varying vec2 position;\n"
+    "void main() {\n"
+    "  float row = floor(position.y * size.y);\n"
+    "  if (row >= rows) {\n"
+    "    gl_FragColor = background;\n"
+    "    return;\n"
+    "  }\n"
+    "  vec4 texel = texture2D(data, vec2(fract(position.x + offset),\n"
+    "                                    (row + 0.5) / rows));\n"
+    "  float v = texel.r * texel.r;\n"
+    "  float hue = psychedelic ? texel.a : 95.0 / 360.0;\n"
+    "  if (v < 0.005) {\n"
+    "    gl_FragColor = background;\n"
+    "  } else if (v < 0.05) {\n"
+    "    gl_FragColor = vec4(hsv(hue, 1.0, 1.0 - v * 4000.0 / 255.0), 1.0);\n"
+    "  } else if (v < 0.999) {\n"
+    "    hue += (psychedelic ? v : -v) * 90.0 / 360.0;\n"
+    "    gl_FragColor = vec4(hsv(hue, 1.0, 1.0), 1.0);\n"
+    "  } else if (psychedelic) {\n"
+    "    gl_FragColor = vec4(hsv(hue, 1.0, 1.0), 1.0);\n"
+    "  } else {\n"
+    "    gl_FragColor = vec4(1.0, 0.0, 0.0, 1.0);\n"
+    "  }\n"
+    "}\n";
+
+}  // namespace
+
+class ShaderAnalyzer::View : public QGLWidget {
+ public:
+  explicit View(ShaderAnalyzer* analyzer)
+      : QGLWidget(analyzer), analyzer_(analyzer) {}
+
+ protected:
+  void initializeGL() { analyzer_->InitializeGL(); }
+  void resizeGL(int width, int height) { glViewport(0, 0, width, height); }
+  void paintGL() { analyzer_->PaintGL(); }
+
+ private:
+  ShaderAnalyzer* analyzer_;
+};
+
+ShaderAnalyzer::ShaderAnalyzer(QWidget* parent, uint scope_size)
+    : Analyzer::Base(parent, scope_size),
+      view_(new View(this)),
+      program_(nullptr),
+      program_linked_(false),
+      texture_(0) {}
+
+ShaderAnalyzer::~ShaderAnalyzer() {
+  if (texture_) {
+    view_->makeCurrent();
+    glDeleteTextures(1, &texture_);
+  }
+}
+
+void ShaderAnalyzer::RequestFrame() { view_->update(); }
+
+void ShaderAnalyzer::resizeEvent(QResizeEvent* e) {
+  QWidget::resizeEvent(e);
+  view_->resize(size());
+}
+
+void ShaderAnalyzer::InitializeGL() {
+  program_ = new QGLShaderProgram(view_->context(), view_);
+  program_linked_ =
+      program_->addShaderFromSourceCode(QGLShader::Vertex, kVertexShader) &&
+      program_->addShaderFromSourceCode(QGLShader::Fragment,
+                                        FragmentShader()) &&
+      program_->link();
+  if (!program_linked_) {
+    qLog(Warning) << "Couldn't build the analyzer's shaders:"
+                  << program_->log();
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glGenTextures(1, &texture_);
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+void ShaderAnalyzer::PaintGL() {
+  const QColor background = palette().color(QPalette::Background);
+  if (!program_linked_) {
+    view_->qglClearColor(background);
+    glClear(GL_COLOR_BUFFER_BIT);
+    return;
+  }
+
+  glBindTexture(GL_TEXTURE_2D, texture_);
+
+  const QSize texture_size = TextureSize();
+  if (texture_size != texture_size_) {
+    const QByteArray empty(texture_size.width() * texture_size.height() * 2,
+                           0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE_ALPHA, texture_size.width(),
+                 texture_size.height(), 0, GL_LUMINANCE_ALPHA,
+                 GL_UNSIGNED_BYTE, empty.constData());
+    texture_size_ = texture_size;
+  }
+
+  if (new_frame_) {
+    switch (engine_->state()) {
+      case Engine::Playing:
+        is_playing_ = true;
+        UploadFrame(lastScope_);
+        break;
+      case Engine::Paused:
+        // Keep showing the last frame
+        is_playing_ = false;
+        break;
+      default:
+        is_playing_ = false;
+        UploadFrame(Scope(fht_->size() / 2, 0));
+    }
+    new_frame_ = false;
+  }
+
+  program_->bind();
+  program_->setUniformValue("data", 0);
+  program_->setUniformValue("size", QSizeF(view_->size()));
+  program_->setUniformValue("background", background);
+  program_->setUniformValue("foreground",
+                            palette().color(QPalette::Highlight));
+  SetUniforms(program_);
+
+  program_->enableAttributeArray("vertex");
+  program_->setAttributeArray("vertex", kRectangle, 2);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  program_->disableAttributeArray("vertex");
+  program_->release();
+}
+
+const char* ShaderBarAnalyzer::kName =
+    QT_TRANSLATE_NOOP("AnalyzerContainer", "Bar analyzer (OpenGL)");
+
+const int ShaderBarAnalyzer::kColumnWidth = 4;
+
+ShaderBarAnalyzer::ShaderBarAnalyzer(QWidget* parent)
+    : ShaderAnalyzer(parent, 8),
+      band_count_(1),
+      scope_(band_count_),
+      bars_(band_count_),
+      peaks_(band_count_),
+      peak_speeds_(band_count_),
+      texels_(band_count_ * 2, 0),
+      foreground_(palette().color(QPalette::Highlight)) {}
+
+void ShaderBarAnalyzer::resizeEvent(QResizeEvent* e) {
+  ShaderAnalyzer::resizeEvent(e);
+
+  band_count_ = qMax(1, width() / (kColumnWidth + 1));
+  scope_.resize(band_count_);
+  bars_.fill(0.0, band_count_);
+  peaks_.fill(0.0, band_count_);
+  peak_speeds_.fill(0.0, band_count_);
+  texels_.fill(0, band_count_ * 2);
+
+  updateBandSize(band_count_);
+}
+
+QByteArray ShaderBarAnalyzer::FragmentShader() const { return kBarShader; }
+
+QSize ShaderBarAnalyzer::TextureSize() const { return QSize(band_count_, 1); }
+
+void ShaderBarAnalyzer::UploadFrame(const Scope& scope) {
+  Analyzer::interpolate(scope, scope_);
+
+  // On the same log scale as BarAnalyzer
+  static const float kLogMax = std::log10(256.0);
+  for (int i = 0; i < band_count_; ++i) {
+    const float level =
+        std::log10(qBound(0.0f, scope_[i] * 256, 255.0f) + 1) / kLogMax;
+    bars_[i] = qMax(level, bars_[i] - kBarFall);
+
+    if (bars_[i] >= peaks_[i]) {
+      peaks_[i] = bars_[i];
+      peak_speeds_[i] = 0.0;
+    } else {
+      peak_speeds_[i] += kPeakGravity;
+      peaks_[i] = qMax(0.0f, peaks_[i] - peak_speeds_[i]);
+    }
+
+    texels_[i * 2] = quint8(bars_[i] * 255 + 0.5);
+    texels_[i * 2 + 1] = quint8(peaks_[i] * 255 + 0.5);
+  }
+
+  foreground_ = psychedelic_enabled_ ? getPsychedelicColor(scope_, 50, 100)
+                                     : palette().color(QPalette::Highlight);
+
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, band_count_, 1, GL_LUMINANCE_ALPHA,
+                  GL_UNSIGNED_BYTE, texels_.constData());
+}
+
+void ShaderBarAnalyzer::SetUniforms(QGLShaderProgram* program) {
+  program->setUniformValue("foreground", foreground_);
+  program->setUniformValue("bands", GLfloat(band_count_));
+  program->setUniformValue("column_width", GLfloat(kColumnWidth));
+}
+
+const char* ShaderSonogram::kName =
+    QT_TRANSLATE_NOOP("AnalyzerContainer", "Sonogram (OpenGL)");
+
+ShaderSonogram::ShaderSonogram(QWidget* parent)
+    : ShaderAnalyzer(parent, 9), next_column_(0) {}
+
+void ShaderSonogram::resizeEvent(QResizeEvent* e) {
+  ShaderAnalyzer::resizeEvent(e);
+
+  // The texture is cleared when its size changes
+  next_column_ = 0;
+  updateBandSize(fht_->size() / 2);
+}
+
+QByteArray ShaderSonogram::FragmentShader() const {
+  return QByteArray(kHsvFunction) + kSonogramShader;
+}
+
+QSize ShaderSonogram::TextureSize() const {
+  return QSize(qMax(1, width()), fht_->size() / 2);
+}
+
+void ShaderSonogram::UploadFrame(const Scope& scope) {
+  const int rows = fht_->size() / 2;
+  texels_.resize(rows * 2);
+
+  quint8 hue = 0;
+  if (psychedelic_enabled_) {
+    hue = quint8(qMax(0, getPsychedelicColor(scope, 20, 100).hue()) * 255 /
+                 359);
+  }
+
+  for (int i = 0; i < rows; ++i) {
+    const float value = i < int(scope.size()) ? scope[i] : 0.0;
+    texels_[i * 2] = quint8(std::sqrt(qBound(0.0f, value, 1.0f)) * 255 + 0.5);
+    texels_[i * 2 + 1] = hue;
+  }
+
+  glTexSubImage2D(GL_TEXTURE_2D, 0, next_column_, 0, 1, rows,
+                  GL_LUMINANCE_ALPHA, GL_UNSIGNED_BYTE, texels_.constData());
+  next_column_ = (next_column_ + 1) % TextureSize().width();
+}
+
+void ShaderSonogram::SetUniforms(QGLShaderProgram* program) {
+  program->setUniformValue("offset",
+                           GLfloat(next_column_) / TextureSize().width());
+  program->setUniformValue("rows", GLfloat(fht_->size() / 2));
+  program->setUniformValue("psychedelic", GLint(psychedelic_enabled_));
+}
+
+void ShaderSonogram::transform(Scope& scope) {
+  fht_->scale(scope.data(), 1.0 / 256);
+  scope.resize(fht_->size() / 2);
+}
@@ -0,0 +1,128 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANALYZERS_SHADERANALYZER_H_
+#define ANALYZERS_SHADERANALYZER_H_
+
+#include "analyzerbase.h"
+
+class QGLShaderProgram;
+
+class ShaderAnalyzer : public Analyzer::Base {
+  // An analyzer drawn by the graphics card.  Each frame the analyzer writes
+  // what it wants to show into a small texture, only that is uploaded, and
+  // one rectangle is drawn with a fragment shader that turns the texture
+  // into pixels.  That leaves very little for the CPU to do, even at the
+  // higher framerates.
+
+  Q_OBJECT
+
+ public:
+  ~ShaderAnalyzer();
+
+ protected:
+  ShaderAnalyzer(QWidget* parent, uint scope_size);
+
+  void RequestFrame();
+  void resizeEvent(QResizeEvent* e);
+  // Not used, these analyzers draw in the GL widget instead.
+  void analyze(QPainter&, const Analyzer::Scope&, bool) {}
+
+  // The GLSL fragment shader.  It gets the position of the pixel from the
+  // bottom left, between 0 and 1, in "position", the texture in "data", the
+  // widget's size in pixels in "size", and the palette's colours in
+  // "background" and "foreground".
+  virtual QByteArray FragmentShader() const = 0;
+  // The size of the texture.  It's reallocated, and cleared, whenever this
+  // changes.
+  virtual QSize TextureSize() const = 0;
+  // Writes a new frame into the texture with glTexSubImage2D.  The texture
+  // is bound and holds two unsigned bytes, luminance and alpha, per texel.
+  virtual void UploadFrame(const Analyzer::Scope& scope) = 0;
+  // Sets any uniforms of the subclass' own.  The program is bound.
+  virtual void SetUniforms(QGLShaderProgram* program) {}
+
+ private:
+  class View;
+  friend class View;
+
+  void InitializeGL();
+  void PaintGL();
+
+  View* view_;
+  QGLShaderProgram* program_;
+  bool program_linked_;
+  GLuint texture_;
+  QSize texture_size_;
+};
+
+class ShaderBarAnalyzer : public ShaderAnalyzer {
+  // Bars with falling peaks, like BarAnalyzer.
+
+  Q_OBJECT
+
+ public:
+  Q_INVOKABLE ShaderBarAnalyzer(QWidget* parent);
+
+  static const char* kName;
+
+ protected:
+  void resizeEvent(QResizeEvent* e);
+
+  QByteArray FragmentShader() const;
+  QSize TextureSize() const;
+  void UploadFrame(const Analyzer::Scope& scope);
+  void SetUniforms(QGLShaderProgram* program);
+
+ private:
+  static const int kColumnWidth;
+
+  int band_count_;
+  Analyzer::Scope scope_;
+  QVector<float> bars_;
+  QVector<float> peaks_;
+  QVector<float> peak_speeds_;
+  QByteArray texels_;
+  QColor foreground_;
+};
+
+class ShaderSonogram : public ShaderAnalyzer {
+  // Scrolls the spectrum from right to left, like Sonogram.  The texture is
+  // used as a ring of columns, so each frame only one column is uploaded.
+
+  Q_OBJECT
+
+ public:
+  Q_INVOKABLE ShaderSonogram(QWidget* parent);
+
+  static const char* kName;
+
+ protected:
+  void resizeEvent(QResizeEvent* e);
+
+  QByteArray FragmentShader() const;
+  QSize TextureSize() const;
+  void UploadFrame(const Analyzer::Scope& scope);
+  void SetUniforms(QGLShaderProgram* program);
+  void transform(Analyzer::Scope& scope);
+
+ private:
+  int next_column_;
+  QByteArray texels_;
+};
+
+#endif  // ANALYZERS_SHADERANALYZER_H_
@@ -114,7 +114,6 @@ void Sonogram::analyze(QPainter& p, const Scope& s, bool new_frame) {
 }
 
 void Sonogram::transform(Scope& scope) {
-  fht_->power2(scope.data());
   fht_->scale(scope.data(), 1.0 / 256);
   scope.resize(fht_->size() / 2);
 }
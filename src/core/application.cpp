@@ -22,11 +22,18 @@
 
 #include "application.h"
 
+#include <QElapsedTimer>
+
 #include "config.h"
 #include "core/appearance.h"
 #include "core/database.h"
 #include "core/lazy.h"
+#include "core/logging.h"
+#include "core/memorymonitor.h"
 #include "core/player.h"
+#include "core/settingscache.h"
+#include "core/startupscheduler.h"
+#include "core/streamcache.h"
 #include "core/tagreaderclient.h"
 #include "core/taskmanager.h"
 #include "covers/albumcoverloader.h"
@@ -63,11 +70,17 @@
 #endif
 
 bool Application::kIsPortable = false;
+const int Application::kThreadShutdownMsec = 2000;
 
 class ApplicationImpl {
  public:
   ApplicationImpl(Application* app)
-      : tag_reader_client_([=]() {
+      : settings_cache_([=]() {
+          SettingsCache* cache = new SettingsCache(app);
+          app->connect(app, SIGNAL(SettingsChanged()), cache, SLOT(Reload()));
+          return cache;
+        }),
+        tag_reader_client_([=]() {
           TagReaderClient* client = new TagReaderClient(app);
           app->MoveToNewThread(client);
           client->Start();
@@ -141,15 +154,19 @@ class ApplicationImpl {
           return remote;
         }),
         network_remote_helper_([=]() { return new NetworkRemoteHelper(app); }),
+        stream_cache_([=]() { return new StreamCache(app); }),
         scrobbler_([=]() {
 #ifdef HAVE_LIBLASTFM
           return new LastFMService(app, app);
 #else
           return nullptr;
 #endif
-        }) {
+        }),
+        startup_scheduler_([=]() { return new StartupScheduler(app); }),
+        memory_monitor_([=]() { return new MemoryMonitor(app); }) {
   }
 
+  Lazy<SettingsCache> settings_cache_;
   Lazy<TagReaderClient> tag_reader_client_;
   Lazy<Database> database_;
   Lazy<AlbumCoverLoader> album_cover_loader_;
@@ -173,11 +190,20 @@ class ApplicationImpl {
   Lazy<MoodbarController> moodbar_controller_;
   Lazy<NetworkRemote> network_remote_;
   Lazy<NetworkRemoteHelper> network_remote_helper_;
+  Lazy<StreamCache> stream_cache_;
   Lazy<Scrobbler> scrobbler_;
+  Lazy<StartupScheduler> startup_scheduler_;
+  Lazy<MemoryMonitor> memory_monitor_;
 };
 
 Application::Application(QObject* parent)
     : QObject(parent), p_(new ApplicationImpl(this)) {
+  // Before anything reads settings
+  settings_cache();
+
+  // Start the clock
+  startup_scheduler();
+
   // This must be before library_->Init();
   // In the constructor the helper waits for the signal
   // PlaylistManagerInitialized
@@ -185,9 +211,13 @@ Application::Application(QObject* parent)
   // crash when a client connects before the manager is initialized!
   network_remote_helper();
   library()->Init();
+  startup_scheduler()->StageFinished("Library");
 
   // TODO(John Maguire): Make this not a weird singleton.
   tag_reader_client();
+
+  // Starts checking the memory budgets.
+  memory_monitor();
 }
 
 Application::~Application() {
@@ -196,17 +226,32 @@ Application::~Application() {
   // thread, including some device library backends.
   p_->device_manager_.reset();
 
+  // Stop every thread at once, then wait for them together.  They're still
+  // waited for however long they take, since some of them are saving to the
+  // database, but the ones that hold up the exit are logged.
   for (QThread* thread : threads_) {
     thread->quit();
   }
 
+  QElapsedTimer timer;
+  timer.start();
   for (QThread* thread : threads_) {
-    thread->wait();
+    const qint64 remaining = kThreadShutdownMsec - timer.elapsed();
+    if (!thread->wait(qMax(qint64(0), remaining))) {
+      qLog(Warning) << "Waiting for the" << thread->objectName()
+                    << "thread to finish";
+      thread->wait();
+      qLog(Warning) << "The" << thread->objectName() << "thread took"
+                    << timer.elapsed() << "ms to finish";
+    }
   }
+  qLog(Debug) << "Stopped" << threads_.count() << "threads in"
+              << timer.elapsed() << "ms";
 }
 
 void Application::MoveToNewThread(QObject* object) {
   QThread* thread = new QThread(this);
+  thread->setObjectName(object->metaObject()->className());
 
   MoveToThread(object, thread);
 
@@ -291,8 +336,16 @@ NetworkRemote* Application::network_remote() const {
   return p_->network_remote_.get();
 }
 
+MemoryMonitor* Application::memory_monitor() const {
+  return p_->memory_monitor_.get();
+}
+
 Player* Application::player() const { return p_->player_.get(); }
 
+StartupScheduler* Application::startup_scheduler() const {
+  return p_->startup_scheduler_.get();
+}
+
 PlaylistBackend* Application::playlist_backend() const {
   return p_->playlist_backend_.get();
 }
@@ -319,6 +372,14 @@ PodcastUpdater* Application::podcast_updater() const {
 
 Scrobbler* Application::scrobbler() const { return p_->scrobbler_.get(); }
 
+SettingsCache* Application::settings_cache() const {
+  return p_->settings_cache_.get();
+}
+
+StreamCache* Application::stream_cache() const {
+  return p_->stream_cache_.get();
+}
+
 TagReaderClient* Application::tag_reader_client() const {
   return p_->tag_reader_client_.get();
 }
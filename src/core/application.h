@@ -41,6 +41,7 @@ class InternetModel;
 class Library;
 class LibraryBackend;
 class LibraryModel;
+class MemoryMonitor;
 class MoodbarController;
 class MoodbarLoader;
 class NetworkRemote;
@@ -53,6 +54,9 @@ class PodcastDeleter;
 class PodcastDownloader;
 class PodcastUpdater;
 class Scrobbler;
+class SettingsCache;
+class StartupScheduler;
+class StreamCache;
 class TagReaderClient;
 class TaskManager;
 
@@ -62,6 +66,10 @@ class Application : public QObject {
  public:
   static bool kIsPortable;
 
+  // How long threads get to finish on exit before the ones that are holding
+  // it up are logged.
+  static const int kThreadShutdownMsec;
+
   explicit Application(QObject* parent = nullptr);
   ~Application();
 
@@ -83,6 +91,7 @@ class Application : public QObject {
   Library* library() const;
   LibraryBackend* library_backend() const;
   LibraryModel* library_model() const;
+  MemoryMonitor* memory_monitor() const;
   MoodbarController* moodbar_controller() const;
   MoodbarLoader* moodbar_loader() const;
   NetworkRemoteHelper* network_remote_helper() const;
@@ -95,6 +104,9 @@ class Application : public QObject {
   PodcastDownloader* podcast_downloader() const;
   PodcastUpdater* podcast_updater() const;
   Scrobbler* scrobbler() const;
+  SettingsCache* settings_cache() const;
+  StartupScheduler* startup_scheduler() const;
+  StreamCache* stream_cache() const;
   TagReaderClient* tag_reader_client() const;
   TaskManager* task_manager() const;
 
@@ -0,0 +1,65 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cachingurlhandler.h"
+
+#include "core/streamcache.h"
+
+CachingUrlHandler::CachingUrlHandler(UrlHandler* handler, StreamCache* cache,
+                                     QObject* parent)
+    : UrlHandler(parent), handler_(handler), cache_(cache) {
+  handler_->setParent(this);
+  connect(handler_, SIGNAL(AsyncLoadComplete(UrlHandler::LoadResult)),
+          SLOT(HandlerLoadComplete(UrlHandler::LoadResult)));
+}
+
+UrlHandler::LoadResult CachingUrlHandler::StartLoading(const QUrl& url) {
+  return UseCache(handler_->StartLoading(url));
+}
+
+UrlHandler::LoadResult CachingUrlHandler::LoadNext(const QUrl& url) {
+  return UseCache(handler_->LoadNext(url));
+}
+
+void CachingUrlHandler::Prefetch(const QUrl& url) {
+  if (!cache_->LocalUrl(url).isEmpty()) return;
+
+  const LoadResult result = handler_->StartLoading(url);
+  if (result.type_ == LoadResult::TrackAvailable) {
+    cache_->Fetch(url, result.media_url_);
+  }
+}
+
+void CachingUrlHandler::HandlerLoadComplete(
+    const UrlHandler::LoadResult& result) {
+  emit AsyncLoadComplete(UseCache(result));
+}
+
+UrlHandler::LoadResult CachingUrlHandler::UseCache(LoadResult result) {
+  if (result.type_ != LoadResult::TrackAvailable ||
+      result.media_url_.scheme() == "file") {
+    return result;
+  }
+
+  const QUrl local_url = cache_->LocalUrl(result.original_url_);
+  if (!local_url.isEmpty()) {
+    result.media_url_ = local_url;
+  } else {
+    cache_->Fetch(result.original_url_, result.media_url_);
+  }
+  return result;
+}
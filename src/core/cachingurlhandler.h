@@ -0,0 +1,55 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_CACHINGURLHANDLER_H_
+#define CORE_CACHINGURLHANDLER_H_
+
+#include "core/urlhandler.h"
+
+class StreamCache;
+
+// Wraps another service's URL handler and plays tracks from the StreamCache
+// when they are there.  Tracks that aren't are streamed from the server as
+// usual while a copy is downloaded in the background.
+class CachingUrlHandler : public UrlHandler {
+  Q_OBJECT
+
+ public:
+  // Takes ownership of handler.
+  CachingUrlHandler(UrlHandler* handler, StreamCache* cache,
+                    QObject* parent = nullptr);
+
+  QString scheme() const { return handler_->scheme(); }
+  QIcon icon() const { return handler_->icon(); }
+  LoadResult StartLoading(const QUrl& url);
+  LoadResult LoadNext(const QUrl& url);
+  void Prefetch(const QUrl& url);
+  bool CanResolveAhead() const { return handler_->CanResolveAhead(); }
+  void TrackAboutToEnd() { handler_->TrackAboutToEnd(); }
+  void TrackSkipped() { handler_->TrackSkipped(); }
+
+ private slots:
+  void HandlerLoadComplete(const UrlHandler::LoadResult& result);
+
+ private:
+  LoadResult UseCache(LoadResult result);
+
+  UrlHandler* handler_;
+  StreamCache* cache_;
+};
+
+#endif  // CORE_CACHINGURLHANDLER_H_
@@ -68,7 +68,9 @@ const char* CommandlineOptions::kHelpText =
     "      --verbose             %30\n"
     "      --log-levels <levels> %31\n"
     "      --version             %32\n"
-    "  -x, --delete-current      %33\n";
+    "  -x, --delete-current      %33\n"
+    "      --trace <file>        %34\n"
+    "      --headless            %35\n";
 
 const char* CommandlineOptions::kVersionText = "Clementine %1";
 
@@ -85,7 +87,8 @@ CommandlineOptions::CommandlineOptions(int argc, char** argv)
       delete_current_track_(false),
       show_osd_(false),
       toggle_pretty_osd_(false),
-      log_levels_(logging::kDefaultLogLevels) {
+      log_levels_(logging::kDefaultLogLevels),
+      headless_(false) {
 #ifdef Q_OS_DARWIN
   // Remove -psn_xxx option that Mac passes when opened from Finder.
   RemoveArg("-psn", 1);
@@ -138,6 +141,8 @@ bool CommandlineOptions::Parse() {
       {"log-levels", required_argument, 0, LogLevels},
       {"version", no_argument, 0, Version},
       {"delete-current", no_argument, 0, 'x'},
+      {"trace", required_argument, 0, Trace},
+      {"headless", no_argument, 0, Headless},
       {0, 0, 0, 0}};
 
   // Parse the arguments
@@ -183,7 +188,11 @@ bool CommandlineOptions::Parse() {
                      tr("Equivalent to --log-levels *:3"),
                      tr("Comma separated list of class:level, level is 0-3"))
                 .arg(tr("Print out version information"), 
-                     tr("Delete the currently playing song"));
+                     tr("Delete the currently playing song"),
+                     tr("Write timings of slow operations to <file> in "
+                        "Chrome's trace event format"),
+                     tr("Run without a user interface, controlled through "
+                        "the network remote, MPRIS or the command line"));
 
         std::cout << translated_help_text.toLocal8Bit().constData();
         return false;
@@ -244,6 +253,12 @@ bool CommandlineOptions::Parse() {
       case LogLevels:
         log_levels_ = QString(optarg);
         break;
+      case Trace:
+        trace_file_ = QString(optarg);
+        break;
+      case Headless:
+        headless_ = true;
+        break;
       case Version: {
         QString version_text =
             QString(kVersionText).arg(CLEMENTINE_VERSION_DISPLAY);
@@ -76,7 +76,10 @@ class CommandlineOptions {
   QList<QUrl> urls() const { return urls_; }
   QString language() const { return language_; }
   QString log_levels() const { return log_levels_; }
+  QString trace_file() const { return trace_file_; }
   QString playlist_name() const { return playlist_name_; }
+  // Only used by the process that was started with it, so not serialised.
+  bool headless() const { return headless_; }
 
   QByteArray Serialize() const;
   void Load(const QByteArray& serialized);
@@ -95,7 +98,9 @@ class CommandlineOptions {
     Version,
     VolumeIncreaseBy,
     VolumeDecreaseBy,
-    RestartOrPrevious
+    RestartOrPrevious,
+    Trace,
+    Headless
   };
 
   QString tr(const char* source_text);
@@ -119,7 +124,9 @@ class CommandlineOptions {
   bool toggle_pretty_osd_;
   QString language_;
   QString log_levels_;
+  QString trace_file_;
   QString playlist_name_;
+  bool headless_;
 
   QList<QUrl> urls_;
 };
@@ -29,26 +29,39 @@
 #include "utilities.h"
 #include "core/application.h"
 #include "core/logging.h"
+#include "core/song.h"
 #include "core/taskmanager.h"
 
+#include <cstring>
+#include <vector>
+
 #include <boost/scope_exit.hpp>
 
 #include <sqlite3.h>
 
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QLibrary>
 #include <QLibraryInfo>
+#include <QSettings>
 #include <QSqlDriver>
 #include <QSqlQuery>
 #include <QtDebug>
 #include <QThread>
+#include <QTimer>
 #include <QUrl>
 #include <QVariant>
 
 const char* Database::kDatabaseFilename = "clementine.db";
-const int Database::kSchemaVersion = 51;
+const int Database::kSchemaVersion = 64;
 const char* Database::kMagicAllSongsTables = "%allsongstables";
+const char* Database::kSettingsGroup = "Database";
+
+const int Database::kMaintenanceIntervalMsec = 6 * 60 * 60 * 1000;  // 6 hours
+const int Database::kAnalyzeIntervalDays = 7;
+const int Database::kVacuumPagesPerStep = 64;
 
 int Database::sNextConnectionId = 1;
 QMutex Database::sNextConnectionIdMutex;
@@ -105,19 +118,112 @@ int Database::FTSDestroy(sqlite3_tokenizer* tokenizer) {
   return SQLITE_OK;
 }
 
+namespace {
+
+// Character classes of the bytes in UTF-8 text.
+enum ByteClass {
+  Byte_Separator,  // ASCII that isn't a letter or a number
+  Byte_Word,       // ASCII letter or number
+  Byte_NonAscii,   // Part of a multi-byte character
+};
+
+struct ByteTables {
+  ByteTables() {
+    for (int c = 0; c < 256; ++c) {
+      lower[c] = c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+      if (c >= 0x80) {
+        byte_class[c] = Byte_NonAscii;
+      } else if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+                 (c >= 'A' && c <= 'Z')) {
+        byte_class[c] = Byte_Word;
+      } else {
+        byte_class[c] = Byte_Separator;
+      }
+    }
+  }
+
+  char lower[256];
+  unsigned char byte_class[256];
+};
+
+const ByteTables& Tables() {
+  static const ByteTables tables;
+  return tables;
+}
+
+// Checks eight bytes at a time for any with the top bit set.
+bool IsAscii(const char* input, int bytes) {
+  const quint64 kHighBits = Q_UINT64_C(0x8080808080808080);
+
+  int i = 0;
+  for (; i + 8 <= bytes; i += 8) {
+    quint64 word;
+    memcpy(&word, input + i, sizeof(word));
+    if (word & kHighBits) return false;
+  }
+  for (; i < bytes; ++i) {
+    if (input[i] & 0x80) return false;
+  }
+  return true;
+}
+
+}  // namespace
+
 int Database::FTSOpen(sqlite3_tokenizer* pTokenizer, const char* input,
                       int bytes, sqlite3_tokenizer_cursor** cursor) {
   UnicodeTokenizerCursor* new_cursor = new UnicodeTokenizerCursor;
   new_cursor->pTokenizer = pTokenizer;
   new_cursor->position = 0;
 
+  if (bytes < 0) bytes = strlen(input);
+
+  // Almost all tags are ASCII, and ASCII words can be split and lowercased
+  // straight from the bytes.  Only words with other characters in them go
+  // through QString.
+  const ByteTables& tables = Tables();
+  const bool ascii = IsAscii(input, bytes);
+  QList<Token> tokens;
+  int i = 0;
+  while (i < bytes) {
+    const uchar c = input[i];
+    if (tables.byte_class[c] == Byte_Separator) {
+      ++i;
+      continue;
+    }
+
+    const int start = i;
+    bool word_ascii = true;
+    for (; i < bytes; ++i) {
+      const int byte_class = tables.byte_class[uchar(input[i])];
+      if (byte_class == Byte_Separator) break;
+      if (!ascii && byte_class == Byte_NonAscii) word_ascii = false;
+    }
+
+    if (word_ascii) {
+      QString token(i - start, Qt::Uninitialized);
+      QChar* data = token.data();
+      for (int j = start; j < i; ++j) {
+        data[j - start] = QLatin1Char(tables.lower[uchar(input[j])]);
+      }
+      tokens << Token(token, start, i);
+    } else {
+      UnicodeTokenize(input + start, i - start, start, &tokens);
+    }
+  }
+
+  new_cursor->tokens = tokens;
+  *cursor = reinterpret_cast<sqlite3_tokenizer_cursor*>(new_cursor);
+
+  return SQLITE_OK;
+}
+
+void Database::UnicodeTokenize(const char* input, int bytes, int offset,
+                               QList<Token>* tokens) {
   QString str = QString::fromUtf8(input, bytes).toLower();
   QChar* data = str.data();
   // Decompose and strip punctuation.
-  QList<Token> tokens;
   QString token;
-  int start_offset = 0;
-  int offset = 0;
+  int start_offset = offset;
   for (int i = 0; i < str.length(); ++i) {
     QChar c = data[i];
     ushort unicode = c.unicode();
@@ -136,7 +242,7 @@ int Database::FTSOpen(sqlite3_tokenizer* pTokenizer, const char* input,
     if (!data[i].isLetterOrNumber()) {
       // Token finished.
       if (token.length() != 0) {
-        tokens << Token(token, start_offset, offset - 1);
+        *tokens << Token(token, start_offset, offset - 1);
         start_offset = offset;
         token.clear();
       } else {
@@ -152,16 +258,11 @@ int Database::FTSOpen(sqlite3_tokenizer* pTokenizer, const char* input,
 
     if (i == str.length() - 1) {
       if (token.length() != 0) {
-        tokens << Token(token, start_offset, offset);
+        *tokens << Token(token, start_offset, offset);
         token.clear();
       }
     }
   }
-
-  new_cursor->tokens = tokens;
-  *cursor = reinterpret_cast<sqlite3_tokenizer_cursor*>(new_cursor);
-
-  return SQLITE_OK;
 }
 
 int Database::FTSClose(sqlite3_tokenizer_cursor* cursor) {
@@ -212,6 +313,10 @@ Database::Database(Application* app, QObject* parent,
     : QObject(parent),
       app_(app),
       mutex_(QMutex::Recursive),
+      wal_enabled_(false),
+      fts5_available_(false),
+      read_pool_size_(qBound(2, QThread::idealThreadCount(), 8)),
+      read_slots_(read_pool_size_),
       injected_database_name_(database_name),
       query_hash_(0),
       startup_schema_version_(-1) {
@@ -223,8 +328,24 @@ Database::Database(Application* app, QObject* parent,
   directory_ =
       QDir::toNativeSeparators(Utilities::GetConfigPath(Utilities::Path_Root));
 
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  const TuningProfile profile = ResolveTuningProfile(
+      TuningProfile(s.value("tuning_profile", Tuning_Auto).toInt()),
+      Utilities::PhysicalMemory());
+  tuning_ = TuningForProfile(profile);
+  qLog(Debug) << "Database tuning profile" << profile << "mmap_size"
+              << tuning_.mmap_size << "cache_size" << tuning_.cache_size_kib
+              << "KiB";
+
+  // The big catalogues of the internet services have files of their own, so
+  // importing one only locks that file.
   attached_databases_["jamendo"] = AttachedDatabase(
       directory_ + "/jamendo.db", ":/schema/jamendo.sql", false);
+  attached_databases_["magnatune"] = AttachedDatabase(
+      directory_ + "/magnatune.db", ":/schema/magnatune.sql", false);
+  attached_databases_["subsonic"] = AttachedDatabase(
+      directory_ + "/subsonic.db", ":/schema/subsonic.sql", false);
 
   QMutexLocker l(&mutex_);
   Connect();
@@ -261,21 +382,13 @@ QSqlDatabase Database::Connect() {
     return db;
   }
 
+  // Before anything else, so the page size applies to a new database.
+  ApplyTuning(tuning_, db);
+
   // Find Sqlite3 functions in the Qt plugin.
   StaticInit();
 
-  {
-    QSqlQuery set_fts_tokenizer("SELECT fts3_tokenizer(:name, :pointer)", db);
-    set_fts_tokenizer.bindValue(":name", "unicode");
-    set_fts_tokenizer.bindValue(
-        ":pointer", QByteArray(reinterpret_cast<const char*>(&sFTSTokenizer),
-                               sizeof(&sFTSTokenizer)));
-    if (!set_fts_tokenizer.exec()) {
-      qLog(Warning) << "Couldn't register FTS3 tokenizer";
-    }
-    // Implicit invocation of ~QSqlQuery() when leaving the scope
-    // to release any remaining database locks!
-  }
+  RegisterFtsTokenizer(db);
 
   if (db.tables().count() == 0) {
     // Set up initial schema
@@ -283,23 +396,11 @@ QSqlDatabase Database::Connect() {
     UpdateDatabaseSchema(0, db);
   }
 
-  // Attach external databases
-  for (const QString& key : attached_databases_.keys()) {
-    QString filename = attached_databases_[key].filename_;
-
-    if (!injected_database_name_.isNull()) filename = injected_database_name_;
-
-    // Attach the db
-    QSqlQuery q("ATTACH DATABASE :filename AS :alias", db);
-    q.bindValue(":filename", filename);
-    q.bindValue(":alias", key);
-    if (!q.exec()) {
-      qFatal("Couldn't attach external database '%s'",
-             key.toAscii().constData());
-    }
-  }
+  AttachDatabases(db);
 
   if (startup_schema_version_ == -1) {
+    EnableWal(db);
+    fts5_available_ = CheckFts5(db);
     UpdateMainSchema(&db);
   }
 
@@ -323,6 +424,298 @@ QSqlDatabase Database::Connect() {
   return db;
 }
 
+QMutex* Database::Mutex(const QString& database_name) {
+  if (database_name.isEmpty()) return &mutex_;
+
+  QMutexLocker l(&attached_mutexes_mutex_);
+  std::shared_ptr<QMutex>& ret = attached_mutexes_[database_name];
+  if (!ret) ret.reset(new QMutex(QMutex::Recursive));
+  return ret.get();
+}
+
+QString Database::DatabaseForTable(const QString& table) {
+  const int dot = table.indexOf('.');
+  if (dot == -1) return QString();
+
+  const QString ret = table.left(dot);
+  if (ret == "main" || ret == "temp") return QString();
+  return ret;
+}
+
+QSqlDatabase Database::ConnectReadOnly() {
+  if (!wal_enabled_) return Connect();
+
+  QMutexLocker l(&connect_mutex_);
+
+  const QString connection_id =
+      QString("%1_thread_%2_readonly")
+          .arg(connection_id_)
+          .arg(reinterpret_cast<quint64>(QThread::currentThread()));
+
+  // Try to find an existing connection for this thread
+  QSqlDatabase db = QSqlDatabase::database(connection_id);
+  if (db.isOpen()) {
+    return db;
+  }
+
+  db = QSqlDatabase::addDatabase("QSQLITE", connection_id);
+  db.setDatabaseName(directory_ + "/" + kDatabaseFilename);
+  db.setConnectOptions("QSQLITE_OPEN_READONLY");
+
+  if (!db.open()) {
+    app_->AddError("Database: " + db.lastError().text());
+    return db;
+  }
+
+  // The schema was set up by the first read-write connection, we only need
+  // the tokenizer for MATCH queries and the attached databases.
+  ApplyTuning(tuning_, db);
+  RegisterFtsTokenizer(db);
+  AttachDatabases(db);
+
+  return db;
+}
+
+Database::TuningProfile Database::ResolveTuningProfile(
+    TuningProfile profile, quint64 physical_memory) {
+  if (profile != Tuning_Auto) return profile;
+
+  const quint64 kGiB = Q_UINT64_C(1024) * 1024 * 1024;
+  if (physical_memory == 0) return Tuning_Balanced;
+  if (physical_memory < 2 * kGiB) return Tuning_LowMemory;
+  if (physical_memory < 8 * kGiB) return Tuning_Balanced;
+  return Tuning_HighMemory;
+}
+
+Database::Tuning Database::TuningForProfile(TuningProfile profile) {
+  const qint64 kMiB = 1024 * 1024;
+
+  Tuning ret;
+  switch (profile) {
+    case Tuning_LowMemory:
+      // sqlite's own cache size, but no memory-mapping.
+      ret.mmap_size = 0;
+      ret.cache_size_kib = 2 * 1024;
+      ret.page_size = 4096;
+      break;
+
+    case Tuning_Auto:
+    case Tuning_Balanced:
+      ret.mmap_size = 256 * kMiB;
+      ret.cache_size_kib = 16 * 1024;
+      ret.temp_store_in_memory = true;
+      ret.page_size = 4096;
+      break;
+
+    case Tuning_HighMemory:
+      // Enough to map all of a big library.  A 32-bit process doesn't have
+      // the address space for that.
+      ret.mmap_size = sizeof(void*) > 4 ? 2048 * kMiB : 256 * kMiB;
+      ret.cache_size_kib = 64 * 1024;
+      ret.temp_store_in_memory = true;
+      ret.page_size = 8192;
+      break;
+
+    case Tuning_Default:
+      break;
+  }
+  return ret;
+}
+
+void Database::ApplyTuning(const Tuning& tuning, QSqlDatabase& db) {
+  QStringList pragmas;
+  if (tuning.page_size != -1) {
+    pragmas << QString("page_size = %1").arg(tuning.page_size);
+  }
+  if (tuning.mmap_size != -1) {
+    pragmas << QString("mmap_size = %1").arg(tuning.mmap_size);
+  }
+  if (tuning.cache_size_kib != -1) {
+    // Negative sizes are in KiB rather than pages.
+    pragmas << QString("cache_size = -%1").arg(tuning.cache_size_kib);
+  }
+  if (tuning.temp_store_in_memory) {
+    pragmas << "temp_store = MEMORY";
+  }
+
+  for (const QString& pragma : pragmas) {
+    QSqlQuery q(db);
+    if (!q.exec("PRAGMA " + pragma)) {
+      qLog(Warning) << "Couldn't set" << pragma << q.lastError().text();
+    }
+  }
+}
+
+QSqlQuery Database::PreparedQuery(const QString& sql, QSqlDatabase& db) {
+  QMutexLocker l(&prepared_queries_mutex_);
+
+  QHash<QString, QSqlQuery>& queries = prepared_queries_[db.connectionName()];
+  QHash<QString, QSqlQuery>::const_iterator it = queries.constFind(sql);
+  if (it != queries.constEnd()) {
+    return *it;
+  }
+
+  QSqlQuery q(db);
+  if (!q.prepare(sql)) {
+    // Don't cache it, CheckErrors will report the problem when it's exec'd.
+    return q;
+  }
+
+  queries.insert(sql, q);
+  return q;
+}
+
+void Database::ClearPreparedQueries() {
+  QMutexLocker l(&prepared_queries_mutex_);
+  prepared_queries_.clear();
+}
+
+void Database::RegisterFtsTokenizer(QSqlDatabase& db) {
+  QSqlQuery set_fts_tokenizer("SELECT fts3_tokenizer(:name, :pointer)", db);
+  set_fts_tokenizer.bindValue(":name", "unicode");
+  set_fts_tokenizer.bindValue(
+      ":pointer", QByteArray(reinterpret_cast<const char*>(&sFTSTokenizer),
+                             sizeof(&sFTSTokenizer)));
+  if (!set_fts_tokenizer.exec()) {
+    qLog(Warning) << "Couldn't register FTS3 tokenizer";
+  }
+  // Implicit invocation of ~QSqlQuery() when leaving the function
+  // to release any remaining database locks!
+}
+
+void Database::AttachDatabases(QSqlDatabase& db) {
+  // Attach external databases
+  for (const QString& key : attached_databases_.keys()) {
+    QString filename = attached_databases_[key].filename_;
+
+    if (!injected_database_name_.isNull()) filename = injected_database_name_;
+
+    // Attach the db
+    QSqlQuery q("ATTACH DATABASE :filename AS :alias", db);
+    q.bindValue(":filename", filename);
+    q.bindValue(":alias", key);
+    if (!q.exec()) {
+      qFatal("Couldn't attach external database '%s'",
+             key.toAscii().constData());
+    }
+  }
+}
+
+void Database::EnableWal(QSqlDatabase& db) {
+  // In-memory databases used by the tests can't be shared between
+  // connections anyway.
+  if (!injected_database_name_.isNull()) return;
+
+  if (!EnableWal("main", db)) {
+    qLog(Warning) << "Couldn't switch the database to WAL mode, readers will"
+                  << "wait for writers";
+    return;
+  }
+
+  // The attached databases have locks of their own, so their readers can't
+  // wait for their writers on the main database's lock.
+  for (const QString& key : attached_databases_.keys()) {
+    if (attached_databases_[key].is_temporary_) continue;
+    if (!EnableWal(key, db)) {
+      qLog(Warning) << "Couldn't switch attached database" << key
+                    << "to WAL mode";
+    }
+  }
+
+  wal_enabled_ = true;
+  qLog(Info) << "Database is in WAL mode with" << read_pool_size_
+             << "read slots";
+}
+
+bool Database::EnableWal(const QString& database_name, QSqlDatabase& db) {
+  // The journal mode is stored in the database file, so this only does any
+  // work the first time.
+  QSqlQuery q(QString("PRAGMA %1.journal_mode = WAL").arg(database_name), db);
+  if (!q.exec() || !q.next() ||
+      q.value(0).toString().compare("wal", Qt::CaseInsensitive) != 0) {
+    return false;
+  }
+  q.finish();
+
+  // Safe in WAL mode - a power cut can lose the last transactions but can't
+  // corrupt the database.
+  QSqlQuery(QString("PRAGMA %1.synchronous = NORMAL").arg(database_name), db)
+      .exec();
+  return true;
+}
+
+bool Database::CheckFts5(QSqlDatabase& db) {
+  QSqlQuery q("SELECT sqlite_compileoption_used('ENABLE_FTS5')", db);
+  if (!q.exec() || !q.next() || q.value(0).toInt() != 1) {
+    qLog(Info) << "sqlite was built without FTS5, search results won't be"
+               << "ranked";
+    return false;
+  }
+  return true;
+}
+
+bool Database::IsFts5Table(const QString& table, QSqlDatabase& db) {
+  QMutexLocker l(&fts5_tables_mutex_);
+
+  QHash<QString, bool>::const_iterator it = fts5_tables_.constFind(table);
+  if (it != fts5_tables_.constEnd()) return it.value();
+
+  // Tables in attached databases are listed in that database's sqlite_master
+  QString master = "sqlite_master";
+  QString name = table;
+  if (table.contains('.')) {
+    master = table.section('.', 0, 0) + ".sqlite_master";
+    name = table.section('.', 1);
+  }
+
+  QSqlQuery q(db);
+  q.prepare(QString("SELECT sql FROM %1 WHERE type = 'table' AND name = :name")
+                .arg(master));
+  q.bindValue(":name", name);
+  const bool ret = q.exec() && q.next() &&
+                   q.value(0).toString().contains("fts5", Qt::CaseInsensitive);
+
+  fts5_tables_.insert(table, ret);
+  return ret;
+}
+
+void Database::AddReadWait(quint64 wait_us) {
+  QMutexLocker l(&read_statistics_mutex_);
+  read_statistics_.acquisitions++;
+  read_statistics_.total_wait_us += wait_us;
+  read_statistics_.max_wait_us = qMax(read_statistics_.max_wait_us, wait_us);
+}
+
+Database::ReadPoolStatistics Database::read_pool_statistics() {
+  QMutexLocker l(&read_statistics_mutex_);
+  ReadPoolStatistics ret = read_statistics_;
+  ret.pool_size = wal_enabled_ ? read_pool_size_ : 0;
+  return ret;
+}
+
+Database::ReadLocker::ReadLocker(Database* db, const QString& database_name)
+    : db_(db),
+      mutex_(db->wal_enabled_ ? nullptr : db->Mutex(database_name)) {
+  QElapsedTimer timer;
+  timer.start();
+
+  if (mutex_) {
+    mutex_->lock();
+  } else {
+    db_->read_slots_.acquire();
+  }
+
+  db_->AddReadWait(timer.nsecsElapsed() / 1000);
+}
+
+Database::ReadLocker::~ReadLocker() {
+  if (mutex_) {
+    mutex_->unlock();
+  } else {
+    db_->read_slots_.release();
+  }
+}
+
 void Database::UpdateMainSchema(QSqlDatabase* db) {
   // Get the database's schema version
   int schema_version = 0;
@@ -356,7 +749,19 @@ void Database::RecreateAttachedDb(const QString& database_name) {
 
   const QString filename = attached_databases_[database_name].filename_;
 
+  // Every connection is closed below, so nobody can be using any of the
+  // databases.
   QMutexLocker l(&mutex_);
+  QList<std::shared_ptr<QMutex>> attached_mutexes;
+  {
+    QMutexLocker attached_l(&attached_mutexes_mutex_);
+    attached_mutexes = attached_mutexes_.values();
+  }
+  std::vector<std::unique_ptr<QMutexLocker>> attached_lockers;
+  for (const std::shared_ptr<QMutex>& mutex : attached_mutexes) {
+    attached_lockers.emplace_back(new QMutexLocker(mutex.get()));
+  }
+
   {
     QSqlDatabase db(Connect());
 
@@ -375,6 +780,12 @@ void Database::RecreateAttachedDb(const QString& database_name) {
   // We can't just re-attach the database now because it needs to be done for
   // each thread.  Close all the database connections, so each thread will
   // re-attach it when they next connect.
+  ClearPreparedQueries();
+  {
+    // The new database's FTS tables might be a different kind
+    QMutexLocker l(&fts5_tables_mutex_);
+    fts5_tables_.clear();
+  }
   for (const QString& name : QSqlDatabase::connectionNames()) {
     QSqlDatabase::removeDatabase(name);
   }
@@ -423,7 +834,13 @@ void Database::UpdateDatabaseSchema(int version, QSqlDatabase& db) {
   else
     filename = QString(":/schema/schema-%1.sql").arg(version);
 
-  if (version == 31) {
+  if (version == 52 && !fts5_available_) {
+    // Keep the FTS3 tables, LibraryQuery can search either kind.
+    qLog(Info) << "Skipping database schema update" << version
+               << "because sqlite doesn't have FTS5";
+    QSqlQuery q("UPDATE schema_version SET version=52", db);
+    CheckErrors(q);
+  } else if (version == 31) {
     // This version used to do a bad job of converting filenames in the songs
     // table to file:// URLs.  Now we do it properly here instead.
     ScopedTransaction t(&db);
@@ -440,6 +857,39 @@ void Database::UpdateDatabaseSchema(int version, QSqlDatabase& db) {
                 << filename;
     ExecSchemaCommandsFromFile(db, filename, version - 1, true);
     t.Commit();
+  } else if (version == 58) {
+    // The new sort text columns can't be worked out in SQL, so fill them in
+    // here for the songs that are already in the database.
+    ScopedTransaction t(&db);
+
+    qLog(Debug) << "Applying database schema update" << version << "from"
+                << filename;
+    const QStringList song_tables(SongsTables(db, version - 1));
+    ExecSchemaCommandsFromFile(db, filename, version - 1, true);
+
+    for (const QString& table : song_tables) {
+      // The library models never read these from playlists
+      if (table != "playlist_items") FillSortTextColumns(table, db);
+    }
+    t.Commit();
+  } else if (version == 61) {
+    // Devices have subdirectories tables of their own, which the magic songs
+    // tables value doesn't cover.
+    ScopedTransaction t(&db);
+
+    qLog(Debug) << "Applying database schema update" << version << "from"
+                << filename;
+    ExecSchemaCommandsFromFile(db, filename, version - 1, true);
+
+    for (const QString& table : db.tables()) {
+      if (table.startsWith("device_") && table.endsWith("_subdirectories")) {
+        QSqlQuery q(db.exec(
+            QString("ALTER TABLE %1 ADD COLUMN art_candidates BLOB")
+                .arg(table)));
+        if (CheckErrors(q)) qFatal("Unable to update music library database");
+      }
+    }
+    t.Commit();
   } else {
     qLog(Debug) << "Applying database schema update" << version << "from"
                 << filename;
@@ -471,6 +921,31 @@ void Database::UrlEncodeFilenameColumn(const QString& table, QSqlDatabase& db) {
   }
 }
 
+void Database::FillSortTextColumns(const QString& table, QSqlDatabase& db) {
+  QSqlQuery select(
+      QString("SELECT ROWID, artist, effective_albumartist, album FROM %1")
+          .arg(table),
+      db);
+  QSqlQuery update(QString("UPDATE %1 SET sortartist = :sortartist,"
+                           " sortalbumartist = :sortalbumartist,"
+                           " sortalbum = :sortalbum"
+                           " WHERE ROWID = :id").arg(table),
+                   db);
+  select.exec();
+  if (CheckErrors(select)) return;
+  while (select.next()) {
+    update.bindValue(":sortartist",
+                     Song::SortTextForArtist(select.value(1).toString()));
+    update.bindValue(":sortalbumartist",
+                     Song::SortTextForArtist(select.value(2).toString()));
+    update.bindValue(":sortalbum",
+                     Song::SortTextForArtist(select.value(3).toString()));
+    update.bindValue(":id", select.value(0).toInt());
+    update.exec();
+    CheckErrors(update);
+  }
+}
+
 void Database::ExecSchemaCommandsFromFile(QSqlDatabase& db,
                                           const QString& filename,
                                           int schema_version,
@@ -623,6 +1098,132 @@ void Database::DoBackup() {
   if (ok) {
     BackupFile(db.databaseName());
   }
+  l.unlock();
+
+  DoMaintenance();
+}
+
+void Database::DoMaintenance() {
+  // In-memory databases used by the tests don't live long enough to need it.
+  if (!injected_database_name_.isNull()) return;
+
+  QSqlDatabase db(this->Connect());
+
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+
+  const QDateTime now = QDateTime::currentDateTime();
+  const QDateTime last_analyze = s.value("last_analyze").toDateTime();
+  if (!last_analyze.isValid() ||
+      last_analyze.daysTo(now) >= kAnalyzeIntervalDays) {
+    Analyze(db);
+    s.setValue("last_analyze", now);
+  }
+
+  IncrementalVacuum(db);
+
+  QTimer::singleShot(kMaintenanceIntervalMsec, this, SLOT(DoMaintenance()));
+}
+
+int Database::PragmaValue(const QString& pragma, QSqlDatabase& db) {
+  QSqlQuery q(QString("PRAGMA %1").arg(pragma), db);
+  if (!q.exec() || !q.next()) return -1;
+  return q.value(0).toInt();
+}
+
+void Database::Analyze(QSqlDatabase& db) {
+  qLog(Debug) << "Refreshing database statistics";
+
+  QStringList tables = QStringList() << "songs"
+                                     << "playlist_items";
+  QStringList fts_tables;
+  for (const QString& table : tables) {
+    if (db.tables().contains(table + "_fts")) fts_tables << table + "_fts";
+  }
+
+  const int task_id =
+      app_->task_manager()->StartTask(tr("Optimizing database"));
+  const int total = tables.count() + fts_tables.count();
+  int progress = 0;
+
+  // Each step takes the lock on its own so the library and playlists can
+  // still write in between.
+  for (const QString& table : tables) {
+    QMutexLocker l(&mutex_);
+    QSqlQuery q(QString("ANALYZE %1").arg(table), db);
+    q.exec();
+    CheckErrors(q);
+    app_->task_manager()->SetTaskProgress(task_id, ++progress, total);
+  }
+
+  // Merges the segments each insert adds to the full text indexes.  FTS3 and
+  // FTS5 both understand this command.
+  for (const QString& table : fts_tables) {
+    QMutexLocker l(&mutex_);
+    QSqlQuery q(QString("INSERT INTO %1(%1) VALUES('optimize')").arg(table),
+                db);
+    q.exec();
+    CheckErrors(q);
+    app_->task_manager()->SetTaskProgress(task_id, ++progress, total);
+  }
+
+  app_->task_manager()->SetTaskFinished(task_id);
+}
+
+void Database::IncrementalVacuum(QSqlDatabase& db) {
+  const int page_count = PragmaValue("page_count", db);
+  const int free_pages = PragmaValue("freelist_count", db);
+  if (page_count <= 0 || free_pages <= 0) return;
+
+  // 0 - none, 1 - full, 2 - incremental
+  const int auto_vacuum = PragmaValue("auto_vacuum", db);
+
+  if (auto_vacuum == 0) {
+    // Switching to incremental vacuum needs one full VACUUM to rebuild the
+    // file.  Only pay for it once a good part of the file is unused.
+    if (free_pages * 4 < page_count) return;
+
+    qLog(Info) << "Compacting database," << free_pages << "of" << page_count
+               << "pages are unused";
+    const int task_id =
+        app_->task_manager()->StartTask(tr("Compacting database"));
+
+    QMutexLocker l(&mutex_);
+    QSqlQuery("PRAGMA auto_vacuum = INCREMENTAL", db).exec();
+    QSqlQuery q("VACUUM", db);
+    q.exec();
+    CheckErrors(q);
+    ClearPreparedQueries();
+
+    app_->task_manager()->SetTaskFinished(task_id);
+    return;
+  }
+
+  if (auto_vacuum != 2) return;
+
+  qLog(Debug) << "Freeing" << free_pages << "unused database pages";
+  const int task_id =
+      app_->task_manager()->StartTask(tr("Compacting database"));
+
+  int remaining = free_pages;
+  while (remaining > 0) {
+    QMutexLocker l(&mutex_);
+    QSqlQuery q(
+        QString("PRAGMA incremental_vacuum(%1)").arg(kVacuumPagesPerStep), db);
+    if (!q.exec()) break;
+    // The pragma frees a page on every step through its result.
+    while (q.next()) {
+    }
+
+    const int now_free = PragmaValue("freelist_count", db);
+    if (now_free < 0 || now_free >= remaining) break;
+    remaining = now_free;
+
+    app_->task_manager()->SetTaskProgress(task_id, free_pages - remaining,
+                                          free_pages);
+  }
+
+  app_->task_manager()->SetTaskFinished(task_id);
 }
 
 bool Database::OpenDatabase(const QString& filename,
@@ -24,13 +24,19 @@
 #ifndef CORE_DATABASE_H_
 #define CORE_DATABASE_H_
 
+#include <memory>
+
+#include <QHash>
 #include <QMap>
 #include <QMutex>
 #include <QObject>
+#include <QSemaphore>
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QStringList>
 
+#include <boost/noncopyable.hpp>
+
 #include <sqlite3.h>
 
 #include "gtest/gtest_prod.h"
@@ -61,13 +67,112 @@ class Database : public QObject {
     bool is_temporary_;
   };
 
+  // Readers that only SELECT from the database hold one of these instead of
+  // locking Mutex().  When the database is in WAL mode it takes one of
+  // read_pool_size() read slots, so readers run alongside whoever holds
+  // Mutex().  Otherwise it locks Mutex(database_name) like everyone else.
+  class ReadLocker : boost::noncopyable {
+   public:
+    explicit ReadLocker(Database* db,
+                        const QString& database_name = QString());
+    ~ReadLocker();
+
+   private:
+    Database* db_;
+    QMutex* mutex_;
+  };
+
+  // How sqlite is set up on each connection.  Auto picks one of the memory
+  // profiles from how much RAM there is, Default leaves sqlite's defaults.
+  // Stored as "tuning_profile" in kSettingsGroup.
+  enum TuningProfile {
+    Tuning_Auto = 0,
+    Tuning_Default = 1,
+    Tuning_LowMemory = 2,
+    Tuning_Balanced = 3,
+    Tuning_HighMemory = 4,
+  };
+
+  // Values of -1 are left alone.
+  struct Tuning {
+    Tuning()
+        : mmap_size(-1),
+          cache_size_kib(-1),
+          temp_store_in_memory(false),
+          page_size(-1) {}
+
+    qint64 mmap_size;
+    int cache_size_kib;
+    bool temp_store_in_memory;
+    // Only changes databases that don't have any tables yet.
+    int page_size;
+  };
+
+  struct ReadPoolStatistics {
+    ReadPoolStatistics()
+        : pool_size(0), acquisitions(0), total_wait_us(0), max_wait_us(0) {}
+
+    int pool_size;
+    quint64 acquisitions;
+    quint64 total_wait_us;
+    quint64 max_wait_us;
+  };
+
   static const int kSchemaVersion;
   static const char* kDatabaseFilename;
   static const char* kMagicAllSongsTables;
+  static const char* kSettingsGroup;
+
+  // How often DoMaintenance runs while Clementine is open, and how often it
+  // refreshes the query planner statistics.
+  static const int kMaintenanceIntervalMsec;
+  static const int kAnalyzeIntervalDays;
+  // Pages freed by each incremental_vacuum step.  The database is locked
+  // for the duration of a step only.
+  static const int kVacuumPagesPerStep;
 
   QSqlDatabase Connect();
+  // Returns a read-only connection for the current thread.  Use this while
+  // holding a ReadLocker.  Falls back to Connect() if the database isn't in
+  // WAL mode.
+  QSqlDatabase ConnectReadOnly();
   bool CheckErrors(const QSqlQuery& query);
-  QMutex* Mutex() { return &mutex_; }
+  // Held while writing to the database.  Each attached database has a lock
+  // of its own, so a big import into one doesn't hold up writes to the
+  // others.  If you need more than one, take the main database's first.
+  QMutex* Mutex(const QString& database_name = QString());
+  // Returns the name of the attached database a table like "jamendo.songs"
+  // is in, or an empty string if it's in the main database.
+  static QString DatabaseForTable(const QString& table);
+
+  // Returns a query prepared with sql on db.  The statement is compiled the
+  // first time and reused by later calls with the same SQL on the same
+  // connection, so only use this for SQL that doesn't have values pasted into
+  // it.  The returned query shares its statement with the cache: bind every
+  // value before each exec(), and call finish() if you stop before reading
+  // every row so the statement doesn't keep the database locked.
+  QSqlQuery PreparedQuery(const QString& sql, QSqlDatabase& db);
+  void ClearPreparedQueries();
+
+  // Whether sqlite was built with FTS5.  Schema version 52 moves the songs
+  // FTS tables to FTS5 only if it was, so use IsFts5Table to find out what a
+  // particular table is.
+  bool is_fts5_available() const { return fts5_available_; }
+  bool IsFts5Table(const QString& table, QSqlDatabase& db);
+
+  // Resolves Tuning_Auto from the amount of memory, in bytes.  0 means
+  // unknown.
+  static TuningProfile ResolveTuningProfile(TuningProfile profile,
+                                            quint64 physical_memory);
+  static Tuning TuningForProfile(TuningProfile profile);
+  // Sets the PRAGMAs.  Connect() and ConnectReadOnly() do this for every new
+  // connection with tuning().
+  static void ApplyTuning(const Tuning& tuning, QSqlDatabase& db);
+  const Tuning& tuning() const { return tuning_; }
+
+  bool is_wal_enabled() const { return wal_enabled_; }
+  int read_pool_size() const { return read_pool_size_; }
+  ReadPoolStatistics read_pool_statistics();
 
   void RecreateAttachedDb(const QString& database_name);
   void ExecSchemaCommands(QSqlDatabase& db, const QString& schema,
@@ -88,6 +193,9 @@ class Database : public QObject {
 
  public slots:
   void DoBackup();
+  // Refreshes statistics, merges the FTS indexes and gives free pages back to
+  // the filesystem.  Reschedules itself every kMaintenanceIntervalMsec.
+  void DoMaintenance();
 
  private:
   void UpdateMainSchema(QSqlDatabase* db);
@@ -98,12 +206,23 @@ class Database : public QObject {
   void ExecSongTablesCommands(QSqlDatabase& db, const QStringList& song_tables,
                               const QStringList& commands);
 
+  void RegisterFtsTokenizer(QSqlDatabase& db);
+  void AttachDatabases(QSqlDatabase& db);
+  void EnableWal(QSqlDatabase& db);
+  bool EnableWal(const QString& database_name, QSqlDatabase& db);
+  bool CheckFts5(QSqlDatabase& db);
+  void AddReadWait(quint64 wait_us);
+
   void UpdateDatabaseSchema(int version, QSqlDatabase& db);
   void UrlEncodeFilenameColumn(const QString& table, QSqlDatabase& db);
+  void FillSortTextColumns(const QString& table, QSqlDatabase& db);
   QStringList SongsTables(QSqlDatabase& db, int schema_version) const;
   bool IntegrityCheck(QSqlDatabase db);
   void BackupFile(const QString& filename);
   bool OpenDatabase(const QString& filename, sqlite3** connection) const;
+  void Analyze(QSqlDatabase& db);
+  void IncrementalVacuum(QSqlDatabase& db);
+  int PragmaValue(const QString& pragma, QSqlDatabase& db);
 
   Application* app_;
 
@@ -114,6 +233,28 @@ class Database : public QObject {
   QMutex connect_mutex_;
   QMutex mutex_;
 
+  // Attached database name -> its lock.  They're never removed, someone might
+  // still be holding one.
+  QMutex attached_mutexes_mutex_;
+  QMap<QString, std::shared_ptr<QMutex>> attached_mutexes_;
+
+  bool wal_enabled_;
+  bool fts5_available_;
+  Tuning tuning_;
+
+  // FTS table name -> whether it uses FTS5
+  QMutex fts5_tables_mutex_;
+  QHash<QString, bool> fts5_tables_;
+  int read_pool_size_;
+  QSemaphore read_slots_;
+
+  QMutex read_statistics_mutex_;
+  ReadPoolStatistics read_statistics_;
+
+  // Connection name -> SQL -> prepared query
+  QMutex prepared_queries_mutex_;
+  QHash<QString, QHash<QString, QSqlQuery>> prepared_queries_;
+
   // This ID makes the QSqlDatabase name unique to the object as well as the
   // thread
   int connection_id_;
@@ -135,6 +276,8 @@ class Database : public QObject {
   FRIEND_TEST(DatabaseTest, FTSOpenParsesMultipleTokens);
   FRIEND_TEST(DatabaseTest, FTSCursorWorks);
   FRIEND_TEST(DatabaseTest, FTSOpenLeavesCyrillicQueries);
+  FRIEND_TEST(DatabaseTest, FTSOpenSplitsMixedInput);
+  FRIEND_TEST(FTSBenchmark, Tokenize);
 
   // Do static initialisation like loading sqlite functions.
   static void StaticInit();
@@ -164,6 +307,11 @@ class Database : public QObject {
     int end_offset;
   };
 
+  // Splits UTF-8 text that isn't all ASCII into lowercased words with their
+  // accents removed.  offset is the byte offset of input in the whole text.
+  static void UnicodeTokenize(const char* input, int bytes, int offset,
+                              QList<Token>* tokens);
+
   // Based on sqlite3_tokenizer.
   struct UnicodeTokenizer {
     const sqlite3_tokenizer_module* pModule;
@@ -184,6 +332,7 @@ class MemoryDatabase : public Database {
       : Database(app, parent, ":memory:") {}
   ~MemoryDatabase() {
     // Make sure Qt doesn't reuse the same database
+    ClearPreparedQueries();
     QSqlDatabase::removeDatabase(Connect().connectionName());
   }
 };
@@ -87,7 +87,7 @@ void DeleteFiles::ProcessSomeFiles() {
   if (progress_ >= songs_.count()) {
     task_manager_->SetTaskProgress(task_id_, progress_, songs_.count());
 
-    storage_->FinishCopy(songs_with_errors_.isEmpty());
+    storage_->FinishDelete(songs_with_errors_.isEmpty());
 
     task_manager_->SetTaskFinished(task_id_);
 
@@ -105,19 +105,17 @@ void DeleteFiles::ProcessSomeFiles() {
 
   // We process files in batches so we can be cancelled part-way through.
 
+  // Each batch goes to the storage in one go, so it can look the songs up and
+  // update its own database once for all of them.
+  QList<MusicStorage::DeleteJob> jobs;
   const int n = qMin(songs_.count(), progress_ + kBatchSize);
   for (; progress_ < n; ++progress_) {
-    task_manager_->SetTaskProgress(task_id_, progress_, songs_.count());
-
-    const Song& song = songs_[progress_];
-
     MusicStorage::DeleteJob job;
-    job.metadata_ = song;
-
-    if (!storage_->DeleteFromStorage(job)) {
-      songs_with_errors_ << song;
-    }
+    job.metadata_ = songs_[progress_];
+    jobs << job;
   }
+  songs_with_errors_ << storage_->DeleteAllFromStorage(jobs);
+  task_manager_->SetTaskProgress(task_id_, progress_, songs_.count());
 
   QTimer::singleShot(0, this, SLOT(ProcessSomeFiles()));
 }
@@ -0,0 +1,145 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fileexistencechecker.h"
+
+#include <functional>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QMap>
+
+#include "core/concurrentrun.h"
+
+const int FileExistenceChecker::kMaxConcurrentDirectories = 4;
+const int FileExistenceChecker::kMinFilesForListing = 3;
+const int FileExistenceChecker::kCacheLifetimeMsec = 30000;
+const int FileExistenceChecker::kMaxCachedDirectories = 1024;
+
+FileExistenceChecker::FileExistenceChecker() {
+  pool_.setMaxThreadCount(kMaxConcurrentDirectories);
+}
+
+FileExistenceChecker* FileExistenceChecker::Instance() {
+  static FileExistenceChecker instance;
+  return &instance;
+}
+
+QSet<QString> FileExistenceChecker::Missing(const QStringList& filenames) {
+  QSet<QString> ret;
+
+  QMap<QString, QStringList> directories;
+  for (const QString& filename : filenames) {
+    if (filename.isEmpty()) {
+      ret << filename;
+    } else {
+      directories[QFileInfo(filename).absolutePath()] << filename;
+    }
+  }
+
+  QList<QFuture<QStringList>> futures;
+  for (auto it = directories.begin(); it != directories.end(); ++it) {
+    futures << ConcurrentRun::Run<QStringList>(
+        &pool_, std::bind(&FileExistenceChecker::MissingInDirectory, this,
+                          it.key(), it.value()));
+  }
+
+  for (QFuture<QStringList> future : futures) {
+    for (const QString& filename : future.result()) {
+      ret << filename;
+    }
+  }
+  return ret;
+}
+
+QStringList FileExistenceChecker::MissingInDirectory(
+    const QString& path, const QStringList& filenames) {
+  QStringList ret;
+
+  Listing listing;
+  if (!CachedListing(path, &listing)) {
+    if (filenames.count() < kMinFilesForListing) {
+      // A stat each is quicker than listing a big directory for a file or two
+      for (const QString& filename : filenames) {
+        if (!QFile::exists(filename)) ret << filename;
+      }
+      return ret;
+    }
+
+    QDir dir(path);
+    listing.age_.start();
+    listing.exists_ = dir.exists();
+    if (listing.exists_) {
+      listing.names_ = QSet<QString>::fromList(
+          dir.entryList(QDir::AllEntries | QDir::Hidden | QDir::System |
+                        QDir::NoDotAndDotDot));
+    }
+    AddListing(path, listing);
+  }
+
+  if (!listing.exists_) return filenames;
+
+  for (const QString& filename : filenames) {
+    // On case-insensitive filesystems the listing's names might not match the
+    // case the file was added with, so those get a proper check.
+    if (!listing.names_.contains(QFileInfo(filename).fileName()) &&
+        !QFile::exists(filename)) {
+      ret << filename;
+    }
+  }
+  return ret;
+}
+
+bool FileExistenceChecker::CachedListing(const QString& path,
+                                         Listing* listing) {
+  QMutexLocker l(&mutex_);
+
+  auto it = cache_.find(path);
+  if (it == cache_.end()) return false;
+  if (it->age_.hasExpired(kCacheLifetimeMsec)) {
+    cache_.erase(it);
+    return false;
+  }
+
+  *listing = *it;
+  return true;
+}
+
+void FileExistenceChecker::AddListing(const QString& path,
+                                      const Listing& listing) {
+  QMutexLocker l(&mutex_);
+
+  if (cache_.count() >= kMaxCachedDirectories) {
+    for (auto it = cache_.begin(); it != cache_.end();) {
+      if (it->age_.hasExpired(kCacheLifetimeMsec)) {
+        it = cache_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    if (cache_.count() >= kMaxCachedDirectories) cache_.clear();
+  }
+
+  cache_[path] = listing;
+}
+
+void FileExistenceChecker::Clear() {
+  QMutexLocker l(&mutex_);
+  cache_.clear();
+}
@@ -0,0 +1,71 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_FILEEXISTENCECHECKER_H_
+#define CORE_FILEEXISTENCECHECKER_H_
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+
+// Finds which of a lot of local files are missing, for greying out or
+// removing playlist items.  Files are grouped by directory and each directory
+// is listed once instead of every file being stat'ed, which is what takes the
+// time on network filesystems.  A few directories are listed at once, and the
+// listings are kept for a short while so checking several playlists that share
+// directories doesn't list them again.
+class FileExistenceChecker {
+ public:
+  FileExistenceChecker();
+
+  static FileExistenceChecker* Instance();
+
+  static const int kMaxConcurrentDirectories;
+  // Directories with fewer files than this to check get a stat per file.
+  static const int kMinFilesForListing;
+  static const int kCacheLifetimeMsec;
+  static const int kMaxCachedDirectories;
+
+  // Returns the filenames that don't exist.  Blocks until every directory has
+  // been checked, so call it from a worker thread.  Thread-safe.
+  QSet<QString> Missing(const QStringList& filenames);
+
+  // Forgets the cached listings.
+  void Clear();
+
+ private:
+  struct Listing {
+    QElapsedTimer age_;
+    bool exists_;
+    QSet<QString> names_;
+  };
+
+  QStringList MissingInDirectory(const QString& path,
+                                 const QStringList& filenames);
+  bool CachedListing(const QString& path, Listing* listing);
+  void AddListing(const QString& path, const Listing& listing);
+
+  QThreadPool pool_;
+
+  QMutex mutex_;
+  QHash<QString, Listing> cache_;
+};
+
+#endif  // CORE_FILEEXISTENCECHECKER_H_
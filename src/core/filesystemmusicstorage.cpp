@@ -27,6 +27,7 @@
 #include <QDir>
 #include <QFile>
 #include <QUrl>
+#include <QtConcurrentMap>
 
 FilesystemMusicStorage::FilesystemMusicStorage(const QString& root)
     : root_(root) {}
@@ -52,10 +53,29 @@ bool FilesystemMusicStorage::CopyToStorage(const CopyJob& job) {
   if (job.remove_original_)
     return QFile::rename(src.absoluteFilePath(), dest.absoluteFilePath());
   else
-    return QFile::copy(src.absoluteFilePath(), dest.absoluteFilePath());
+    return Utilities::CopyLocalFile(src.absoluteFilePath(),
+                               dest.absoluteFilePath());
 }
 
 bool FilesystemMusicStorage::DeleteFromStorage(const DeleteJob& job) {
+  return RemoveFile(job);
+}
+
+SongList FilesystemMusicStorage::DeleteAllFromStorage(
+    const QList<DeleteJob>& jobs) {
+  // Most of the time goes on waiting for the filesystem, so several files are
+  // removed at once.
+  const QList<bool> results =
+      QtConcurrent::blockingMapped<QList<bool>>(jobs, &RemoveFile);
+
+  SongList ret;
+  for (int i = 0; i < jobs.count(); ++i) {
+    if (!results[i]) ret << jobs[i].metadata_;
+  }
+  return ret;
+}
+
+bool FilesystemMusicStorage::RemoveFile(const DeleteJob& job) {
   QString path = job.metadata_.url().toLocalFile();
   QFileInfo fileInfo(path);
   if (fileInfo.isDir())
@@ -28,11 +28,15 @@ class FilesystemMusicStorage : public virtual MusicStorage {
   ~FilesystemMusicStorage() {}
 
   QString LocalPath() const { return root_; }
+  int MaxConcurrentCopies() const { return 4; }
 
   bool CopyToStorage(const CopyJob& job);
   bool DeleteFromStorage(const DeleteJob& job);
+  SongList DeleteAllFromStorage(const QList<DeleteJob>& jobs);
 
  private:
+  static bool RemoveFile(const DeleteJob& job);
+
   QString root_;
 };
 
@@ -24,6 +24,10 @@
 #include "macfslistener.h"
 #endif
 
+#ifdef Q_OS_LINUX
+#include "linuxfslistener.h"
+#endif
+
 FileSystemWatcherInterface::FileSystemWatcherInterface(QObject* parent)
     : QObject(parent) {}
 
@@ -32,6 +36,8 @@ FileSystemWatcherInterface* FileSystemWatcherInterface::Create(
   FileSystemWatcherInterface* ret;
 #ifdef Q_OS_DARWIN
   ret = new MacFSListener(parent);
+#elif defined(Q_OS_LINUX)
+  ret = new LinuxFSListener(parent);
 #else
   ret = new QtFSListener(parent);
 #endif
@@ -0,0 +1,196 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "headlesscontroller.h"
+
+#include <QSettings>
+
+#include "core/application.h"
+#include "core/closure.h"
+#include "core/commandlineoptions.h"
+#include "core/logging.h"
+#include "core/mimedata.h"
+#include "core/player.h"
+#include "core/timeconstants.h"
+#include "engines/enginebase.h"
+#include "playlist/playlist.h"
+#include "playlist/playlistmanager.h"
+
+namespace {
+// Shared with the MainWindow so the playback status carries over between the
+// two modes.
+const char* kSettingsGroup = "MainWindow";
+}
+
+HeadlessController::HeadlessController(Application* app,
+                                       const CommandlineOptions& options,
+                                       QObject* parent)
+    : QObject(parent),
+      app_(app),
+      saved_playback_state_(Engine::Empty),
+      saved_playback_position_(0) {
+  // There's no sequence or container without widgets.
+  app_->playlist_manager()->Init(app_->library_backend(),
+                                 app_->playlist_backend(), nullptr, nullptr);
+
+  qLog(Debug) << "Initialising player";
+  app_->player()->Init();
+
+  CommandlineOptionsReceived(options);
+  if (!options.contains_play_options()) LoadPlaybackStatus();
+
+  qLog(Debug) << "Started headless";
+}
+
+HeadlessController::~HeadlessController() { SavePlaybackStatus(); }
+
+void HeadlessController::CommandlineOptionsReceived(
+    const QByteArray& serialized_options) {
+  if (serialized_options == "wake up!") {
+    // Old versions of Clementine sent this - just ignore it
+    return;
+  }
+
+  CommandlineOptions options;
+  options.Load(serialized_options);
+
+  // There's no window to show if the options are empty.
+  if (!options.is_empty()) CommandlineOptionsReceived(options);
+}
+
+void HeadlessController::CommandlineOptionsReceived(
+    const CommandlineOptions& options) {
+  switch (options.player_action()) {
+    case CommandlineOptions::Player_Play:
+      if (options.urls().empty()) {
+        app_->player()->Play();
+      }
+      break;
+    case CommandlineOptions::Player_PlayPause:
+      app_->player()->PlayPause();
+      break;
+    case CommandlineOptions::Player_Pause:
+      app_->player()->Pause();
+      break;
+    case CommandlineOptions::Player_Stop:
+      app_->player()->Stop();
+      break;
+    case CommandlineOptions::Player_StopAfterCurrent:
+      app_->player()->StopAfterCurrent();
+      break;
+    case CommandlineOptions::Player_Previous:
+      app_->player()->Previous();
+      break;
+    case CommandlineOptions::Player_Next:
+      app_->player()->Next();
+      break;
+    case CommandlineOptions::Player_RestartOrPrevious:
+      app_->player()->RestartOrPrevious();
+      break;
+
+    case CommandlineOptions::Player_None:
+      break;
+  }
+
+  if (!options.urls().empty()) {
+    MimeData* data = new MimeData;
+    data->setUrls(options.urls());
+    data->override_user_settings_ = true;
+    data->play_now_ =
+        options.player_action() == CommandlineOptions::Player_Play;
+
+    switch (options.url_list_action()) {
+      case CommandlineOptions::UrlList_Load:
+        data->clear_first_ = true;
+        break;
+      case CommandlineOptions::UrlList_Append:
+      case CommandlineOptions::UrlList_None:
+        break;
+      case CommandlineOptions::UrlList_CreateNew:
+        app_->playlist_manager()->New(options.playlist_name());
+        break;
+    }
+
+    app_->playlist_manager()->current()->dropMimeData(
+        data, Qt::CopyAction, -1, 0, QModelIndex());
+    delete data;
+  }
+
+  if (options.set_volume() != -1)
+    app_->player()->SetVolume(options.set_volume());
+
+  if (options.volume_modifier() != 0)
+    app_->player()->SetVolume(app_->player()->GetVolume() +
+                              options.volume_modifier());
+
+  if (options.seek_to() != -1)
+    app_->player()->SeekTo(options.seek_to());
+  else if (options.seek_by() != 0)
+    app_->player()->SeekTo(app_->player()->engine()->position_nanosec() /
+                               kNsecPerSec +
+                           options.seek_by());
+
+  if (options.play_track_at() != -1)
+    app_->player()->PlayAt(options.play_track_at(), Engine::Manual, true);
+}
+
+void HeadlessController::SavePlaybackStatus() {
+  QSettings settings;
+  settings.beginGroup(kSettingsGroup);
+  settings.setValue("playback_state", app_->player()->GetState());
+  if (app_->player()->GetState() == Engine::Playing ||
+      app_->player()->GetState() == Engine::Paused) {
+    settings.setValue(
+        "playback_position",
+        app_->player()->engine()->position_nanosec() / kNsecPerSec);
+  } else {
+    settings.setValue("playback_position", 0);
+  }
+}
+
+void HeadlessController::LoadPlaybackStatus() {
+  QSettings settings;
+  settings.beginGroup(kSettingsGroup);
+  bool resume_playback =
+      settings.value("resume_playback_after_start", false).toBool();
+  saved_playback_state_ = static_cast<Engine::State>(
+      settings.value("playback_state", Engine::Empty).toInt());
+  saved_playback_position_ = settings.value("playback_position", 0).toDouble();
+  if (!resume_playback || saved_playback_state_ == Engine::Empty ||
+      saved_playback_state_ == Engine::Idle) {
+    return;
+  }
+
+  connect(app_->playlist_manager()->active(), SIGNAL(RestoreFinished()),
+          SLOT(ResumePlayback()));
+}
+
+void HeadlessController::ResumePlayback() {
+  qLog(Debug) << "Resuming playback";
+
+  disconnect(app_->playlist_manager()->active(), SIGNAL(RestoreFinished()),
+             this, SLOT(ResumePlayback()));
+
+  if (saved_playback_state_ == Engine::Paused) {
+    NewClosure(app_->player(), SIGNAL(Playing()), app_->player(),
+               SLOT(PlayPause()));
+  }
+
+  app_->player()->Play();
+
+  app_->player()->SeekTo(saved_playback_position_);
+}
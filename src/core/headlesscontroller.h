@@ -0,0 +1,57 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_HEADLESSCONTROLLER_H_
+#define CORE_HEADLESSCONTROLLER_H_
+
+#include <QObject>
+
+#include "engines/engine_fwd.h"
+
+class Application;
+class CommandlineOptions;
+
+// Takes the place of the MainWindow when Clementine is started with
+// --headless.  No widgets are created: the player is controlled through the
+// network remote, MPRIS and the command line of other instances.
+class HeadlessController : public QObject {
+  Q_OBJECT
+
+ public:
+  HeadlessController(Application* app, const CommandlineOptions& options,
+                     QObject* parent = nullptr);
+  ~HeadlessController();
+
+ public slots:
+  void CommandlineOptionsReceived(const QByteArray& serialized_options);
+
+ private slots:
+  void ResumePlayback();
+
+ private:
+  void CommandlineOptionsReceived(const CommandlineOptions& options);
+  void LoadPlaybackStatus();
+  void SavePlaybackStatus();
+
+ private:
+  Application* app_;
+
+  Engine::State saved_playback_state_;
+  double saved_playback_position_;
+};
+
+#endif  // CORE_HEADLESSCONTROLLER_H_
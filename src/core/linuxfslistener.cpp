@@ -0,0 +1,362 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "linuxfslistener.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+
+#include <QFile>
+#include <QSocketNotifier>
+
+#include "core/logging.h"
+
+const int LinuxFSListener::kCoalesceDelayMs = 500;
+const int LinuxFSListener::kWatchBatchSize = 256;
+
+namespace {
+
+const uint32_t kInotifyMask = IN_CREATE | IN_DELETE | IN_MOVE | IN_ATTRIB |
+                              IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF |
+                              IN_ONLYDIR;
+
+#ifdef FAN_REPORT_DIR_FID
+const uint64_t kFanotifyMask = FAN_CREATE | FAN_DELETE | FAN_MOVE |
+                               FAN_CLOSE_WRITE | FAN_ONDIR;
+#endif
+
+quint64 FsidKey(int val0, int val1) {
+  return (quint64(quint32(val0)) << 32) | quint32(val1);
+}
+
+}  // namespace
+
+LinuxFSListener::LinuxFSListener(QObject* parent)
+    : FileSystemWatcherInterface(parent),
+      fanotify_fd_(-1),
+      inotify_fd_(-1),
+      watch_limit_reached_(false),
+      fanotify_notifier_(nullptr),
+      inotify_notifier_(nullptr) {
+  coalesce_timer_.setSingleShot(true);
+  coalesce_timer_.setInterval(kCoalesceDelayMs);
+  connect(&coalesce_timer_, SIGNAL(timeout()), SLOT(EmitChanges()));
+
+  watch_timer_.setSingleShot(true);
+  watch_timer_.setInterval(0);
+  connect(&watch_timer_, SIGNAL(timeout()), SLOT(AddPendingWatches()));
+}
+
+LinuxFSListener::~LinuxFSListener() {
+  for (int fd : mount_fds_) close(fd);
+  if (fanotify_fd_ != -1) close(fanotify_fd_);
+  if (inotify_fd_ != -1) close(inotify_fd_);
+}
+
+void LinuxFSListener::Init() {
+  if (InitFanotify()) {
+    qLog(Info) << "Watching the library with fanotify";
+  } else {
+    qLog(Info) << "Watching the library with inotify";
+  }
+}
+
+bool LinuxFSListener::InitFanotify() {
+#ifdef FAN_REPORT_DIR_FID
+  const int fd = fanotify_init(
+      FAN_CLASS_NOTIF | FAN_REPORT_DIR_FID | FAN_NONBLOCK | FAN_CLOEXEC,
+      O_RDONLY);
+  if (fd == -1) return false;
+
+  // Marking a whole filesystem needs CAP_SYS_ADMIN, and turning the reported
+  // file handles back into paths needs CAP_DAC_READ_SEARCH.  Try both on the
+  // root directory before relying on them.
+  bool allowed = fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+                               kFanotifyMask, AT_FDCWD, "/") == 0;
+  if (allowed) {
+    fanotify_mark(fd, FAN_MARK_REMOVE | FAN_MARK_FILESYSTEM, kFanotifyMask,
+                  AT_FDCWD, "/");
+
+    char buffer[sizeof(file_handle) + MAX_HANDLE_SZ];
+    file_handle* handle = reinterpret_cast<file_handle*>(buffer);
+    handle->handle_bytes = MAX_HANDLE_SZ;
+    int mount_id = 0;
+    const int root_fd = open("/", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    allowed =
+        root_fd != -1 && name_to_handle_at(root_fd, ".", handle, &mount_id,
+                                           0) == 0;
+    if (allowed) {
+      const int handle_fd = open_by_handle_at(root_fd, handle, O_PATH);
+      allowed = handle_fd != -1;
+      if (allowed) close(handle_fd);
+    }
+    if (root_fd != -1) close(root_fd);
+  }
+
+  if (!allowed) {
+    close(fd);
+    return false;
+  }
+
+  fanotify_fd_ = fd;
+  fanotify_notifier_ =
+      new QSocketNotifier(fanotify_fd_, QSocketNotifier::Read, this);
+  connect(fanotify_notifier_, SIGNAL(activated(int)),
+          SLOT(ReadFanotifyEvents()));
+  return true;
+#else
+  return false;
+#endif
+}
+
+void LinuxFSListener::InitInotify() {
+  if (inotify_fd_ != -1) return;
+
+  inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd_ == -1) {
+    qLog(Error) << "Failed to initialise inotify:" << strerror(errno);
+    return;
+  }
+
+  inotify_notifier_ =
+      new QSocketNotifier(inotify_fd_, QSocketNotifier::Read, this);
+  connect(inotify_notifier_, SIGNAL(activated(int)),
+          SLOT(ReadInotifyEvents()));
+}
+
+void LinuxFSListener::AddPath(const QString& path) {
+  if (paths_.contains(path)) return;
+  paths_.insert(path);
+
+  if (fanotify_fd_ != -1 && AddFanotifyMark(path)) return;
+
+  // inotify needs a watch on every directory.  Adding them all at once can
+  // take seconds for a big library, so they're added from the event loop.
+  InitInotify();
+  if (inotify_fd_ == -1 || watch_limit_reached_) return;
+  pending_watches_.insert(path);
+  if (!watch_timer_.isActive()) watch_timer_.start();
+}
+
+bool LinuxFSListener::AddFanotifyMark(const QString& path) {
+#ifdef FAN_REPORT_DIR_FID
+  const QByteArray encoded_path = QFile::encodeName(path);
+
+  struct statfs info;
+  if (statfs(encoded_path.constData(), &info) != 0) return false;
+  const quint64 key = FsidKey(info.f_fsid.__val[0], info.f_fsid.__val[1]);
+  if (mount_fds_.contains(key)) return true;
+
+  if (fanotify_mark(fanotify_fd_, FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+                    kFanotifyMask, AT_FDCWD, encoded_path.constData()) != 0) {
+    qLog(Warning) << "Failed to add a fanotify mark for" << path << ":"
+                  << strerror(errno);
+    return false;
+  }
+
+  const int mount_fd =
+      open(encoded_path.constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (mount_fd == -1) {
+    fanotify_mark(fanotify_fd_, FAN_MARK_REMOVE | FAN_MARK_FILESYSTEM,
+                  kFanotifyMask, AT_FDCWD, encoded_path.constData());
+    return false;
+  }
+
+  mount_fds_[key] = mount_fd;
+  return true;
+#else
+  Q_UNUSED(path)
+  return false;
+#endif
+}
+
+void LinuxFSListener::RemovePath(const QString& path) {
+  paths_.remove(path);
+  pending_watches_.remove(path);
+
+  // fanotify marks cover the whole filesystem, so events for this directory
+  // are just ignored from now on.
+  QHash<QString, int>::iterator it = path_watches_.find(path);
+  if (it != path_watches_.end()) {
+    inotify_rm_watch(inotify_fd_, it.value());
+    watch_paths_.remove(it.value());
+    path_watches_.erase(it);
+  }
+}
+
+void LinuxFSListener::Clear() {
+#ifdef FAN_REPORT_DIR_FID
+  if (fanotify_fd_ != -1) {
+    fanotify_mark(fanotify_fd_, FAN_MARK_FLUSH | FAN_MARK_FILESYSTEM, 0,
+                  AT_FDCWD, nullptr);
+  }
+#endif
+  for (int fd : mount_fds_) close(fd);
+  mount_fds_.clear();
+
+  for (int watch : watch_paths_.keys()) inotify_rm_watch(inotify_fd_, watch);
+  watch_paths_.clear();
+  path_watches_.clear();
+  pending_watches_.clear();
+  watch_timer_.stop();
+  watch_limit_reached_ = false;
+
+  paths_.clear();
+  changed_paths_.clear();
+}
+
+void LinuxFSListener::AddPendingWatches() {
+  for (int i = 0; i < kWatchBatchSize && !pending_watches_.isEmpty(); ++i) {
+    QSet<QString>::iterator it = pending_watches_.begin();
+    const QString path = *it;
+    pending_watches_.erase(it);
+
+    const int watch = inotify_add_watch(
+        inotify_fd_, QFile::encodeName(path).constData(), kInotifyMask);
+    if (watch == -1) {
+      if (errno == ENOSPC) {
+        qLog(Warning) << "Reached the inotify watch limit after"
+                      << watch_paths_.count() << "directories, increase"
+                      << "fs.inotify.max_user_watches to watch the rest";
+        watch_limit_reached_ = true;
+        pending_watches_.clear();
+        return;
+      }
+      continue;
+    }
+
+    watch_paths_[watch] = path;
+    path_watches_[path] = watch;
+  }
+
+  if (!pending_watches_.isEmpty()) watch_timer_.start();
+}
+
+void LinuxFSListener::ReadFanotifyEvents() {
+#ifdef FAN_REPORT_DIR_FID
+  char buffer[8192] __attribute__((aligned(
+      __alignof__(fanotify_event_metadata))));
+
+  forever {
+    ssize_t length = read(fanotify_fd_, buffer, sizeof(buffer));
+    if (length <= 0) break;
+
+    for (const fanotify_event_metadata* event =
+             reinterpret_cast<const fanotify_event_metadata*>(buffer);
+         FAN_EVENT_OK(event, length); event = FAN_EVENT_NEXT(event, length)) {
+      if (event->vers != FANOTIFY_METADATA_VERSION) {
+        qLog(Error) << "Unexpected fanotify metadata version" << event->vers;
+        return;
+      }
+
+      if (event->mask & FAN_Q_OVERFLOW) {
+        qLog(Warning) << "fanotify queue overflowed, rescanning everything";
+        for (const QString& path : paths_) PathChangedDelayed(path);
+        continue;
+      }
+
+      if (event->event_len <= event->metadata_len) continue;
+
+      const QString path = FanotifyEventDirectory(
+          reinterpret_cast<const char*>(event) + event->metadata_len);
+      if (paths_.contains(path)) PathChangedDelayed(path);
+    }
+  }
+#endif
+}
+
+QString LinuxFSListener::FanotifyEventDirectory(const void* data) {
+#ifdef FAN_REPORT_DIR_FID
+  const fanotify_event_info_fid* info =
+      reinterpret_cast<const fanotify_event_info_fid*>(data);
+  if (info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID) return QString();
+
+  const int mount_fd =
+      mount_fds_.value(FsidKey(info->fsid.val[0], info->fsid.val[1]), -1);
+  if (mount_fd == -1) return QString();
+
+  file_handle* handle = reinterpret_cast<file_handle*>(
+      const_cast<unsigned char*>(info->handle));
+  const int fd = open_by_handle_at(mount_fd, handle, O_PATH);
+  // The directory might have been deleted in the meantime.
+  if (fd == -1) return QString();
+
+  char path[PATH_MAX];
+  const ssize_t length =
+      readlink(QString("/proc/self/fd/%1").arg(fd).toLatin1().constData(),
+               path, sizeof(path));
+  close(fd);
+  if (length <= 0) return QString();
+
+  return QFile::decodeName(QByteArray(path, length));
+#else
+  Q_UNUSED(data)
+  return QString();
+#endif
+}
+
+void LinuxFSListener::ReadInotifyEvents() {
+  char buffer[4096] __attribute__((aligned(__alignof__(inotify_event))));
+
+  forever {
+    const ssize_t length = read(inotify_fd_, buffer, sizeof(buffer));
+    if (length <= 0) break;
+
+    for (const char* p = buffer; p < buffer + length;) {
+      const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+      p += sizeof(inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW) {
+        qLog(Warning) << "inotify queue overflowed, rescanning everything";
+        for (const QString& path : watch_paths_) PathChangedDelayed(path);
+        continue;
+      }
+
+      const QString path = watch_paths_.value(event->wd);
+      if (path.isEmpty()) continue;
+
+      if (event->mask & IN_IGNORED) {
+        // The directory was deleted or unmounted and the kernel dropped the
+        // watch.
+        watch_paths_.remove(event->wd);
+        path_watches_.remove(path);
+      }
+      PathChangedDelayed(path);
+    }
+  }
+}
+
+void LinuxFSListener::PathChangedDelayed(const QString& path) {
+  changed_paths_.insert(path);
+  if (!coalesce_timer_.isActive()) coalesce_timer_.start();
+}
+
+void LinuxFSListener::EmitChanges() {
+  const QSet<QString> paths = changed_paths_;
+  changed_paths_.clear();
+
+  for (const QString& path : paths) {
+    qLog(Debug) << "Something changed at:" << path;
+    emit PathChanged(path);
+  }
+}
@@ -0,0 +1,92 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_LINUXFSLISTENER_H_
+#define CORE_LINUXFSLISTENER_H_
+
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+
+#include "filesystemwatcherinterface.h"
+
+class QSocketNotifier;
+
+class LinuxFSListener : public FileSystemWatcherInterface {
+  Q_OBJECT
+
+  // Watches directories with the kernel's notification APIs directly instead
+  // of through QFileSystemWatcher.
+  //
+  // If the process is allowed to, one fanotify mark is placed on each
+  // filesystem that has a watched directory in it, so large libraries don't
+  // need one watch per directory.  Otherwise it falls back to inotify, and
+  // registers the watches a batch at a time from the event loop so adding
+  // tens of thousands of directories doesn't block.  Either way changes are
+  // collected for a short while and each changed directory is reported once.
+
+ public:
+  explicit LinuxFSListener(QObject* parent = nullptr);
+  ~LinuxFSListener();
+
+  static const int kCoalesceDelayMs;
+  static const int kWatchBatchSize;
+
+  void Init();
+  void AddPath(const QString& path);
+  void RemovePath(const QString& path);
+  void Clear();
+
+ private slots:
+  void ReadFanotifyEvents();
+  void ReadInotifyEvents();
+  void AddPendingWatches();
+  void EmitChanges();
+
+ private:
+  bool InitFanotify();
+  void InitInotify();
+  bool AddFanotifyMark(const QString& path);
+  QString FanotifyEventDirectory(const void* info);
+  void PathChangedDelayed(const QString& path);
+
+ private:
+  // Directories that changed since the last time PathChanged was emitted.
+  QSet<QString> changed_paths_;
+  QTimer coalesce_timer_;
+
+  // All directories that were added.
+  QSet<QString> paths_;
+
+  int fanotify_fd_;
+  // fsid of each marked filesystem and an open directory on it, used to turn
+  // the file handles fanotify reports back into paths.
+  QHash<quint64, int> mount_fds_;
+
+  int inotify_fd_;
+  QHash<int, QString> watch_paths_;
+  QHash<QString, int> path_watches_;
+  // Added directories that don't have an inotify watch yet.
+  QSet<QString> pending_watches_;
+  QTimer watch_timer_;
+  bool watch_limit_reached_;
+
+  QSocketNotifier* fanotify_notifier_;
+  QSocketNotifier* inotify_notifier_;
+};
+
+#endif  // CORE_LINUXFSLISTENER_H_
@@ -0,0 +1,94 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "memorymonitor.h"
+
+#include <QSettings>
+
+#include "config.h"
+#include "core/application.h"
+#include "core/logging.h"
+#include "core/network.h"
+#include "covers/albumcoverloader.h"
+#include "globalsearch/globalsearch.h"
+#include "library/librarymodel.h"
+#include "playlist/playlistmanager.h"
+
+#ifdef HAVE_MOODBAR
+#include "moodbar/moodbarloader.h"
+#endif
+
+const char* MemoryMonitor::kSettingsGroup = "MemoryBudgets";
+const int MemoryMonitor::kCheckIntervalMsec = 60 * 1000;  // 1 minute
+
+MemoryMonitor::MemoryMonitor(Application* app, QObject* parent)
+    : QObject(parent), app_(app) {
+  check_timer_.setInterval(kCheckIntervalMsec);
+  connect(&check_timer_, SIGNAL(timeout()), SLOT(Check()));
+  check_timer_.start();
+}
+
+QList<MemoryMonitor::Usage> MemoryMonitor::Measure() const {
+  QList<Usage> ret;
+  auto add = [&ret](const QString& id, const QString& name, qint64 bytes) {
+    Usage usage;
+    usage.id = id;
+    usage.name = name;
+    usage.bytes = bytes;
+    usage.budget_bytes = 0;
+    ret << usage;
+  };
+
+  add("library", "Library model", app_->library_model()->memory_usage());
+  add("playlists", "Playlists and undo stacks",
+      app_->playlist_manager()->memory_usage());
+  add("covers", "Album cover cache",
+      app_->album_cover_loader()->statistics().cache_bytes);
+  add("global_search", "Global search results",
+      app_->global_search()->memory_usage());
+  add("network", "Network cache",
+      ThreadSafeNetworkDiskCache::memory_usage());
+#ifdef HAVE_MOODBAR
+  add("moodbar", "Moodbar index", app_->moodbar_loader()->memory_usage());
+#endif
+
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  for (Usage& usage : ret) {
+    usage.budget_bytes = s.value(usage.id, 0).toLongLong() * 1024 * 1024;
+  }
+
+  return ret;
+}
+
+void MemoryMonitor::Check() {
+  for (const Usage& usage : Measure()) {
+    if (usage.budget_bytes <= 0 || usage.bytes <= usage.budget_bytes) {
+      over_budget_.remove(usage.id);
+      continue;
+    }
+
+    // Only warn when it goes over, not every time it's checked.
+    if (over_budget_.contains(usage.id)) continue;
+    over_budget_.insert(usage.id);
+
+    qLog(Warning) << usage.name << "is using" << usage.bytes / 1024
+                  << "KiB, more than its budget of"
+                  << usage.budget_bytes / 1024 << "KiB";
+    emit BudgetExceeded(usage.name, usage.bytes, usage.budget_bytes);
+  }
+}
@@ -0,0 +1,69 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_MEMORYMONITOR_H_
+#define CORE_MEMORYMONITOR_H_
+
+#include <QList>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+
+class Application;
+
+// Adds up roughly how much memory the big caches and models are holding, so
+// it can be shown in the Console, and logs a warning when one of them goes
+// over its budget.  The numbers count the objects themselves and the images
+// and data in caches, not strings they point to, so they're a lower bound.
+//
+// Budgets are in MiB, under kSettingsGroup with the subsystem's id as the
+// key.  Subsystems without one can grow as much as they like.
+class MemoryMonitor : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit MemoryMonitor(Application* app, QObject* parent = nullptr);
+
+  static const char* kSettingsGroup;
+  static const int kCheckIntervalMsec;
+
+  struct Usage {
+    QString id;
+    QString name;
+    qint64 bytes;
+    // 0 if there isn't one.
+    qint64 budget_bytes;
+  };
+
+  QList<Usage> Measure() const;
+
+ signals:
+  // Emitted once each time a subsystem goes over its budget.
+  void BudgetExceeded(const QString& name, qint64 bytes, qint64 budget_bytes);
+
+ private slots:
+  void Check();
+
+ private:
+  Application* app_;
+  QTimer check_timer_;
+  // Subsystems that were over budget at the last check.
+  QSet<QString> over_budget_;
+};
+
+#endif  // CORE_MEMORYMONITOR_H_
@@ -33,14 +33,13 @@ using std::placeholders::_2;
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/hashed_index.hpp>
-#include <boost/multi_index/ordered_index.hpp>
 
+using boost::multi_index::hashed_non_unique;
 using boost::multi_index::hashed_unique;
 using boost::multi_index::identity;
 using boost::multi_index::indexed_by;
 using boost::multi_index::member;
 using boost::multi_index::multi_index_container;
-using boost::multi_index::ordered_unique;
 using boost::multi_index::tag;
 
 std::size_t hash_value(const QModelIndex& index) { return qHash(index); }
@@ -49,13 +48,15 @@ namespace {
 
 struct Mapping {
   explicit Mapping(const QModelIndex& _source_index) :
-    source_index(_source_index) {}
+    source_index(_source_index), model(_source_index.model()) {}
 
   QModelIndex source_index;
+  const QAbstractItemModel* model;
 };
 
 struct tag_by_source {};
 struct tag_by_pointer {};
+struct tag_by_model {};
 
 }  // namespace
 
@@ -66,7 +67,10 @@ class MergedProxyModelPrivate {
       indexed_by<
           hashed_unique<tag<tag_by_source>,
                         member<Mapping, QModelIndex, &Mapping::source_index> >,
-          ordered_unique<tag<tag_by_pointer>, identity<Mapping*> > > >
+          hashed_unique<tag<tag_by_pointer>, identity<Mapping*> >,
+          hashed_non_unique<
+              tag<tag_by_model>,
+              member<Mapping, const QAbstractItemModel*, &Mapping::model> > > >
       MappingContainer;
 
  public:
@@ -76,6 +80,7 @@ class MergedProxyModelPrivate {
 MergedProxyModel::MergedProxyModel(QObject* parent)
     : QAbstractProxyModel(parent),
       resetting_model_(nullptr),
+      submodels_dirty_(true),
       p_(new MergedProxyModelPrivate) {}
 
 MergedProxyModel::~MergedProxyModel() { DeleteAllMappings(); }
@@ -86,6 +91,39 @@ void MergedProxyModel::DeleteAllMappings() {
   qDeleteAll(begin, end);
 }
 
+void MergedProxyModel::DeleteMappings(const QAbstractItemModel* model) {
+  auto& by_model = p_->mappings_.get<tag_by_model>();
+  const auto range = by_model.equal_range(model);
+
+  // Take them out of the container before deleting them, it still needs to
+  // read the keys while erasing.
+  QList<Mapping*> mappings;
+  for (auto it = range.first; it != range.second; ++it) {
+    mappings << *it;
+  }
+  by_model.erase(range.first, range.second);
+  qDeleteAll(mappings);
+}
+
+void MergedProxyModel::InvalidateSubModels() { submodels_dirty_ = true; }
+
+QAbstractItemModel* MergedProxyModel::SubModelAt(
+    const QModelIndex& source_parent) const {
+  // The merge points are persistent indexes, so they have to be hashed again
+  // whenever a model's rows move around.
+  if (submodels_dirty_) {
+    submodels_.clear();
+    for (auto it = merge_points_.begin(); it != merge_points_.end(); ++it) {
+      // The same as QMap::key(), the first submodel wins.
+      if (!submodels_.contains(it.value())) {
+        submodels_.insert(it.value(), it.key());
+      }
+    }
+    submodels_dirty_ = false;
+  }
+  return submodels_.value(source_parent);
+}
+
 void MergedProxyModel::AddSubModel(const QModelIndex& source_parent,
                                    QAbstractItemModel* submodel) {
   connect(submodel, SIGNAL(modelReset()), this, SLOT(SubModelReset()));
@@ -99,6 +137,7 @@ void MergedProxyModel::AddSubModel(const QModelIndex& source_parent,
           SLOT(RowsRemoved(QModelIndex, int, int)));
   connect(submodel, SIGNAL(dataChanged(QModelIndex, QModelIndex)), this,
           SLOT(DataChanged(QModelIndex, QModelIndex)));
+  ConnectMoveSignals(submodel);
 
   QModelIndex proxy_parent = mapFromSource(source_parent);
   const int rows = submodel->rowCount();
@@ -106,14 +145,16 @@ void MergedProxyModel::AddSubModel(const QModelIndex& source_parent,
   if (rows) beginInsertRows(proxy_parent, 0, rows - 1);
 
   merge_points_.insert(submodel, source_parent);
+  InvalidateSubModels();
 
   if (rows) endInsertRows();
 }
 
 void MergedProxyModel::RemoveSubModel(const QModelIndex& source_parent) {
   // Find the submodel that the parent corresponded to
-  QAbstractItemModel* submodel = merge_points_.key(source_parent);
+  QAbstractItemModel* submodel = SubModelAt(source_parent);
   merge_points_.remove(submodel);
+  InvalidateSubModels();
 
   // The submodel might have been deleted already so we must be careful not
   // to dereference it.
@@ -128,16 +169,7 @@ void MergedProxyModel::RemoveSubModel(const QModelIndex& source_parent) {
   resetting_model_ = nullptr;
 
   // Delete all the mappings that reference the submodel
-  auto it = p_->mappings_.get<tag_by_pointer>().begin();
-  auto end = p_->mappings_.get<tag_by_pointer>().end();
-  while (it != end) {
-    if ((*it)->source_index.model() == submodel) {
-      delete *it;
-      it = p_->mappings_.get<tag_by_pointer>().erase(it);
-    } else {
-      ++it;
-    }
-  }
+  DeleteMappings(submodel);
 }
 
 void MergedProxyModel::setSourceModel(QAbstractItemModel* source_model) {
@@ -160,6 +192,7 @@ void MergedProxyModel::setSourceModel(QAbstractItemModel* source_model) {
                SLOT(LayoutAboutToBeChanged()));
     disconnect(sourceModel(), SIGNAL(layoutChanged()), this,
                SLOT(LayoutChanged()));
+    disconnect(sourceModel(), 0, this, SLOT(InvalidateSubModels()));
   }
 
   QAbstractProxyModel::setSourceModel(source_model);
@@ -178,6 +211,22 @@ void MergedProxyModel::setSourceModel(QAbstractItemModel* source_model) {
   connect(sourceModel(), SIGNAL(layoutAboutToBeChanged()), this,
           SLOT(LayoutAboutToBeChanged()));
   connect(sourceModel(), SIGNAL(layoutChanged()), this, SLOT(LayoutChanged()));
+  ConnectMoveSignals(sourceModel());
+  InvalidateSubModels();
+}
+
+void MergedProxyModel::ConnectMoveSignals(QAbstractItemModel* model) {
+  // These move persistent indexes without going through any of the other
+  // slots.
+  connect(model, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)),
+          this, SLOT(InvalidateSubModels()));
+  connect(model, SIGNAL(columnsInserted(QModelIndex, int, int)), this,
+          SLOT(InvalidateSubModels()));
+  connect(model, SIGNAL(columnsRemoved(QModelIndex, int, int)), this,
+          SLOT(InvalidateSubModels()));
+  connect(model,
+          SIGNAL(columnsMoved(QModelIndex, int, int, QModelIndex, int)), this,
+          SLOT(InvalidateSubModels()));
 }
 
 void MergedProxyModel::SourceModelReset() {
@@ -187,6 +236,7 @@ void MergedProxyModel::SourceModelReset() {
   // Clear the containers
   p_->mappings_.clear();
   merge_points_.clear();
+  InvalidateSubModels();
 
   // Reset the proxy
   reset();
@@ -210,16 +260,7 @@ void MergedProxyModel::SubModelReset() {
   resetting_model_ = nullptr;
 
   // Delete all the mappings that reference the submodel
-  auto it = p_->mappings_.get<tag_by_pointer>().begin();
-  auto end = p_->mappings_.get<tag_by_pointer>().end();
-  while (it != end) {
-    if ((*it)->source_index.model() == submodel) {
-      delete *it;
-      it = p_->mappings_.get<tag_by_pointer>().erase(it);
-    } else {
-      ++it;
-    }
-  }
+  DeleteMappings(submodel);
 
   // "Insert" items from the newly reset submodel
   int count = submodel->rowCount();
@@ -240,6 +281,7 @@ QModelIndex MergedProxyModel::GetActualSourceParent(
 
 void MergedProxyModel::RowsAboutToBeInserted(const QModelIndex& source_parent,
                                              int start, int end) {
+  InvalidateSubModels();
   beginInsertRows(
       mapFromSource(GetActualSourceParent(
           source_parent, static_cast<QAbstractItemModel*>(sender()))),
@@ -247,11 +289,13 @@ void MergedProxyModel::RowsAboutToBeInserted(const QModelIndex& source_parent,
 }
 
 void MergedProxyModel::RowsInserted(const QModelIndex&, int, int) {
+  InvalidateSubModels();
   endInsertRows();
 }
 
 void MergedProxyModel::RowsAboutToBeRemoved(const QModelIndex& source_parent,
                                             int start, int end) {
+  InvalidateSubModels();
   beginRemoveRows(
       mapFromSource(GetActualSourceParent(
           source_parent, static_cast<QAbstractItemModel*>(sender()))),
@@ -259,6 +303,7 @@ void MergedProxyModel::RowsAboutToBeRemoved(const QModelIndex& source_parent,
 }
 
 void MergedProxyModel::RowsRemoved(const QModelIndex&, int, int) {
+  InvalidateSubModels();
   endRemoveRows();
 }
 
@@ -301,7 +346,7 @@ QModelIndex MergedProxyModel::index(int row, int column,
     source_index = sourceModel()->index(row, column, QModelIndex());
   } else {
     QModelIndex source_parent = mapToSource(parent);
-    const QAbstractItemModel* child_model = merge_points_.key(source_parent);
+    const QAbstractItemModel* child_model = SubModelAt(source_parent);
 
     if (child_model)
       source_index = child_model->index(row, column, QModelIndex());
@@ -330,7 +375,7 @@ int MergedProxyModel::rowCount(const QModelIndex& parent) const {
   QModelIndex source_parent = mapToSource(parent);
   if (!IsKnownModel(source_parent.model())) return 0;
 
-  const QAbstractItemModel* child_model = merge_points_.key(source_parent);
+  const QAbstractItemModel* child_model = SubModelAt(source_parent);
   if (child_model) {
     // Query the source model but disregard what it says, so it gets a chance
     // to lazy load
@@ -348,7 +393,7 @@ int MergedProxyModel::columnCount(const QModelIndex& parent) const {
   QModelIndex source_parent = mapToSource(parent);
   if (!IsKnownModel(source_parent.model())) return 0;
 
-  const QAbstractItemModel* child_model = merge_points_.key(source_parent);
+  const QAbstractItemModel* child_model = SubModelAt(source_parent);
   if (child_model) return child_model->columnCount(QModelIndex());
   return source_parent.model()->columnCount(source_parent);
 }
@@ -359,7 +404,7 @@ bool MergedProxyModel::hasChildren(const QModelIndex& parent) const {
   QModelIndex source_parent = mapToSource(parent);
   if (!IsKnownModel(source_parent.model())) return false;
 
-  const QAbstractItemModel* child_model = merge_points_.key(source_parent);
+  const QAbstractItemModel* child_model = SubModelAt(source_parent);
 
   if (child_model)
     return child_model->hasChildren(QModelIndex()) ||
@@ -472,9 +517,8 @@ QAbstractItemModel* MergedProxyModel::GetModel(const QModelIndex& source_index)
   // but without the const_cast
   const QAbstractItemModel* const_model = source_index.model();
   if (const_model == sourceModel()) return sourceModel();
-  for (QAbstractItemModel* submodel : merge_points_.keys()) {
-    if (submodel == const_model) return submodel;
-  }
+  QAbstractItemModel* model = const_cast<QAbstractItemModel*>(const_model);
+  if (merge_points_.contains(model)) return model;
   return nullptr;
 }
 
@@ -484,6 +528,7 @@ void MergedProxyModel::DataChanged(const QModelIndex& top_left,
 }
 
 void MergedProxyModel::LayoutAboutToBeChanged() {
+  InvalidateSubModels();
   old_merge_points_.clear();
   for (QAbstractItemModel* key : merge_points_.keys()) {
     old_merge_points_[key] = merge_points_.value(key);
@@ -491,6 +536,7 @@ void MergedProxyModel::LayoutAboutToBeChanged() {
 }
 
 void MergedProxyModel::LayoutChanged() {
+  InvalidateSubModels();
   for (QAbstractItemModel* key : merge_points_.keys()) {
     if (!old_merge_points_.contains(key)) continue;
 
@@ -23,6 +23,7 @@
 #include <memory>
 
 #include <QAbstractProxyModel>
+#include <QHash>
 
 std::size_t hash_value(const QModelIndex& index);
 
@@ -94,11 +95,17 @@ class MergedProxyModel : public QAbstractProxyModel {
   void LayoutAboutToBeChanged();
   void LayoutChanged();
 
+  void InvalidateSubModels();
+
  private:
   QModelIndex GetActualSourceParent(const QModelIndex& source_parent,
                                     QAbstractItemModel* model) const;
   QAbstractItemModel* GetModel(const QModelIndex& source_index) const;
   void DeleteAllMappings();
+  void DeleteMappings(const QAbstractItemModel* model);
+  void ConnectMoveSignals(QAbstractItemModel* model);
+  // Returns the submodel merged at the item, or nullptr if there isn't one.
+  QAbstractItemModel* SubModelAt(const QModelIndex& source_parent) const;
   bool IsKnownModel(const QAbstractItemModel* model) const;
 
   QMap<QAbstractItemModel*, QPersistentModelIndex> merge_points_;
@@ -106,6 +113,10 @@ class MergedProxyModel : public QAbstractProxyModel {
 
   QMap<QAbstractItemModel*, QModelIndex> old_merge_points_;
 
+  // merge_points_ the other way round, rebuilt when submodels_dirty_ is set.
+  mutable QHash<QModelIndex, QAbstractItemModel*> submodels_;
+  mutable bool submodels_dirty_;
+
   std::unique_ptr<MergedProxyModelPrivate> p_;
 };
 
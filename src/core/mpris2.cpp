@@ -27,6 +27,7 @@
 
 #include <QApplication>
 #include <QDBusConnection>
+#include <QTimer>
 #include <QtConcurrentRun>
 
 #include "config.h"
@@ -82,8 +83,23 @@ namespace mpris {
 const char* Mpris2::kMprisObjectPath = "/org/mpris/MediaPlayer2";
 const char* Mpris2::kServiceName = "org.mpris.MediaPlayer2.clementine";
 const char* Mpris2::kFreedesktopPath = "org.freedesktop.DBus.Properties";
+const char* Mpris2::kPlayerInterface = "org.mpris.MediaPlayer2.Player";
+const int Mpris2::kSeekedIntervalMsec = 250;
+
+Mpris2::Mpris2(Application* app, QObject* parent)
+    : QObject(parent),
+      notification_timer_(new QTimer(this)),
+      seeked_timer_(new QTimer(this)),
+      pending_seek_position_(0),
+      app_(app) {
+  notification_timer_->setSingleShot(true);
+  notification_timer_->setInterval(0);
+  connect(notification_timer_, SIGNAL(timeout()),
+          SLOT(EmitPendingNotifications()));
+
+  seeked_timer_->setSingleShot(true);
+  connect(seeked_timer_, SIGNAL(timeout()), SLOT(EmitSeeked()));
 
-Mpris2::Mpris2(Application* app, QObject* parent) : QObject(parent), app_(app) {
   new Mpris2Root(this);
   new Mpris2TrackList(this);
   new Mpris2Player(this);
@@ -103,7 +119,8 @@ Mpris2::Mpris2(Application* app, QObject* parent) : QObject(parent), app_(app) {
   connect(app_->player()->engine(), SIGNAL(StateChanged(Engine::State)),
           SLOT(EngineStateChanged(Engine::State)));
   connect(app_->player(), SIGNAL(VolumeChanged(int)), SLOT(VolumeChanged()));
-  connect(app_->player(), SIGNAL(Seeked(qlonglong)), SIGNAL(Seeked(qlonglong)));
+  connect(app_->player(), SIGNAL(Seeked(qlonglong)),
+          SLOT(PlayerSeeked(qlonglong)));
 
   connect(app_->playlist_manager(), SIGNAL(PlaylistManagerInitialized()),
           SLOT(PlaylistManagerInitialized()));
@@ -117,6 +134,9 @@ Mpris2::Mpris2(Application* app, QObject* parent) : QObject(parent), app_(app) {
 
 // when PlaylistManager gets it ready, we connect PlaylistSequence with this
 void Mpris2::PlaylistManagerInitialized() {
+  // There's no sequence in headless mode.
+  if (!app_->playlist_manager()->sequence()) return;
+
   connect(app_->playlist_manager()->sequence(),
           SIGNAL(ShuffleModeChanged(PlaylistSequence::ShuffleMode)),
           SLOT(ShuffleModeChanged()));
@@ -128,6 +148,7 @@ void Mpris2::PlaylistManagerInitialized() {
 void Mpris2::EngineStateChanged(Engine::State newState) {
   if (newState != Engine::Playing && newState != Engine::Paused) {
     last_metadata_ = QVariantMap();
+    last_metadata_song_ = Song();
     EmitNotification("Metadata");
   }
 
@@ -147,18 +168,64 @@ void Mpris2::RepeatModeChanged() {
 }
 
 void Mpris2::EmitNotification(const QString& name, const QVariant& val) {
-  EmitNotification(name, val, "org.mpris.MediaPlayer2.Player");
+  EmitNotification(name, val, kPlayerInterface);
 }
 
 void Mpris2::EmitNotification(const QString& name, const QVariant& val,
                               const QString& mprisEntity) {
-  QDBusMessage msg = QDBusMessage::createSignal(
-      kMprisObjectPath, kFreedesktopPath, "PropertiesChanged");
-  QVariantMap map;
-  map.insert(name, val);
-  QVariantList args = QVariantList() << mprisEntity << map << QStringList();
-  msg.setArguments(args);
-  QDBusConnection::sessionBus().send(msg);
+  // A later change to the same property replaces this one.
+  pending_changes_[mprisEntity].insert(name, val);
+  if (!notification_timer_->isActive()) notification_timer_->start();
+}
+
+void Mpris2::EmitPendingNotifications() {
+  QMap<QString, QVariantMap> changes;
+  changes.swap(pending_changes_);
+
+  for (auto it = changes.begin(); it != changes.end(); ++it) {
+    QVariantMap map = it.value();
+
+    if (it.key() == kPlayerInterface) {
+      // Clients already have these values.
+      for (auto prop = map.begin(); prop != map.end();) {
+        if (sent_player_properties_.contains(prop.key()) &&
+            sent_player_properties_[prop.key()] == prop.value()) {
+          prop = map.erase(prop);
+        } else {
+          sent_player_properties_[prop.key()] = prop.value();
+          ++prop;
+        }
+      }
+      if (map.isEmpty()) continue;
+    }
+
+    QDBusMessage msg = QDBusMessage::createSignal(
+        kMprisObjectPath, kFreedesktopPath, "PropertiesChanged");
+    QVariantList args = QVariantList() << it.key() << map << QStringList();
+    msg.setArguments(args);
+    QDBusConnection::sessionBus().send(msg);
+  }
+}
+
+void Mpris2::PlayerSeeked(qlonglong position) {
+  pending_seek_position_ = position;
+
+  // The first seek goes out straight away, later ones are held back until the
+  // interval has passed and only the last position is sent.
+  if (seeked_timer_->isActive()) return;
+
+  const qint64 elapsed =
+      last_seeked_.isValid() ? last_seeked_.elapsed() : kSeekedIntervalMsec;
+  if (elapsed >= kSeekedIntervalMsec) {
+    EmitSeeked();
+  } else {
+    seeked_timer_->start(kSeekedIntervalMsec - elapsed);
+  }
+}
+
+void Mpris2::EmitSeeked() {
+  last_seeked_.start();
+  emit Seeked(pending_seek_position_);
 }
 
 void Mpris2::EmitNotification(const QString& name) {
@@ -296,6 +363,7 @@ void Mpris2::SetLoopStatus(const QString& value) {
     mode = PlaylistSequence::Repeat_Playlist;
   }
 
+  if (!app_->playlist_manager()->sequence()) return;
   app_->playlist_manager()->active()->sequence()->SetRepeatMode(mode);
 }
 
@@ -308,11 +376,14 @@ void Mpris2::SetRate(double rate) {
 }
 
 bool Mpris2::Shuffle() const {
+  if (!app_->playlist_manager()->sequence()) return false;
+
   return app_->playlist_manager()->sequence()->shuffle_mode() !=
          PlaylistSequence::Shuffle_Off;
 }
 
 void Mpris2::SetShuffle(bool enable) {
+  if (!app_->playlist_manager()->sequence()) return;
   app_->playlist_manager()->active()->sequence()->SetShuffleMode(
       enable ? PlaylistSequence::Shuffle_All : PlaylistSequence::Shuffle_Off);
 }
@@ -335,11 +406,22 @@ void Mpris2::CurrentSongChanged(const Song& song) {
 
 // ... and we add the cover information later, when it's available.
 void Mpris2::ArtLoaded(const Song& song, const QString& art_uri) {
+  const QString track_id = current_track_id();
+  if (song == last_metadata_song_ &&
+      song.IsMetadataEqual(last_metadata_song_) &&
+      art_uri == last_metadata_art_uri_ &&
+      track_id == last_metadata_track_id_) {
+    return;
+  }
+  last_metadata_song_ = song;
+  last_metadata_art_uri_ = art_uri;
+  last_metadata_track_id_ = track_id;
+
   last_metadata_ = QVariantMap();
   song.ToXesam(&last_metadata_);
 
   using mpris::AddMetadata;
-  AddMetadata("mpris:trackid", current_track_id(), &last_metadata_);
+  AddMetadata("mpris:trackid", track_id, &last_metadata_);
 
   if (song.rating() != -1.0) {
     AddMetadata("rating", song.rating() * 5, &last_metadata_);
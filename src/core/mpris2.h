@@ -22,6 +22,7 @@
 #ifndef CORE_MPRIS2_H_
 #define CORE_MPRIS2_H_
 
+#include <QElapsedTimer>
 #include <QMetaObject>
 #include <QObject>
 #include <QtDBus>
@@ -32,6 +33,8 @@ class Application;
 class MainWindow;
 class Playlist;
 
+class QTimer;
+
 typedef QList<QVariantMap> TrackMetadata;
 typedef QList<QDBusObjectPath> TrackIds;
 Q_DECLARE_METATYPE(TrackMetadata)
@@ -195,6 +198,9 @@ signals:
 
  private slots:
   void ArtLoaded(const Song& song, const QString& art_uri);
+  void PlayerSeeked(qlonglong position);
+  void EmitSeeked();
+  void EmitPendingNotifications();
   void EngineStateChanged(Engine::State newState);
   void VolumeChanged();
 
@@ -223,8 +229,27 @@ signals:
   static const char* kMprisObjectPath;
   static const char* kServiceName;
   static const char* kFreedesktopPath;
+  static const char* kPlayerInterface;
+  // Seeked is sent at most this often while the user drags the slider.
+  static const int kSeekedIntervalMsec;
 
   QVariantMap last_metadata_;
+  // What last_metadata_ was made from, so it isn't rebuilt for the same song.
+  Song last_metadata_song_;
+  QString last_metadata_art_uri_;
+  QString last_metadata_track_id_;
+
+  // Property changes are sent together once control returns to the event
+  // loop, in one PropertiesChanged signal for each interface.
+  QMap<QString, QVariantMap> pending_changes_;
+  QTimer* notification_timer_;
+  // The last values sent for the player interface, so unchanged ones are left
+  // out.
+  QVariantMap sent_player_properties_;
+
+  QTimer* seeked_timer_;
+  QElapsedTimer last_seeked_;
+  qlonglong pending_seek_position_;
 
   Application* app_;
 };
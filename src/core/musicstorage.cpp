@@ -20,3 +20,11 @@
 #include "musicstorage.h"
 
 MusicStorage::MusicStorage() {}
+
+SongList MusicStorage::DeleteAllFromStorage(const QList<DeleteJob>& jobs) {
+  SongList ret;
+  for (const DeleteJob& job : jobs) {
+    if (!DeleteFromStorage(job)) ret << job.metadata_;
+  }
+  return ret;
+}
@@ -75,11 +75,17 @@ class MusicStorage {
   virtual bool StartCopy(QList<Song::FileType>* supported_types) {
     return true;
   }
+  // How many CopyToStorage() calls may run at the same time, each on its own
+  // thread.  Copies that run in parallel don't report progress.
+  virtual int MaxConcurrentCopies() const { return 1; }
   virtual bool CopyToStorage(const CopyJob& job) = 0;
   virtual void FinishCopy(bool success) {}
 
   virtual void StartDelete() {}
   virtual bool DeleteFromStorage(const DeleteJob& job) = 0;
+  // Deletes several songs, and returns the ones that couldn't be deleted.  By
+  // default they're deleted one at a time with DeleteFromStorage().
+  virtual SongList DeleteAllFromStorage(const QList<DeleteJob>& jobs);
   virtual void FinishDelete(bool success) {}
 
   virtual void Eject() {}
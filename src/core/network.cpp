@@ -19,8 +19,11 @@
 
 #include "network.h"
 
+#include <QBuffer>
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QDir>
+#include <QStringList>
 #include <QNetworkAccessManager>
 #include <QNetworkDiskCache>
 #include <QNetworkReply>
@@ -28,61 +31,153 @@
 #include "core/closure.h"
 #include "utilities.h"
 
+const int ThreadSafeNetworkDiskCache::kShardCount = 8;
+const int ThreadSafeNetworkDiskCache::kMaxMemoryEntryBytes = 64 * 1024;
+const int ThreadSafeNetworkDiskCache::kMemoryBytesPerShard = 1024 * 1024;
+
 QMutex ThreadSafeNetworkDiskCache::sMutex;
-QNetworkDiskCache* ThreadSafeNetworkDiskCache::sCache = nullptr;
+QList<ThreadSafeNetworkDiskCache::Shard*> ThreadSafeNetworkDiskCache::sShards;
+QMap<QIODevice*, ThreadSafeNetworkDiskCache::Shard*>
+    ThreadSafeNetworkDiskCache::sPrepared;
 
 ThreadSafeNetworkDiskCache::ThreadSafeNetworkDiskCache(QObject* parent)
     : QAbstractNetworkCache(parent) {
   QMutexLocker l(&sMutex);
-  if (!sCache) {
-    sCache = new QNetworkDiskCache;
-    sCache->setCacheDirectory(
-        Utilities::GetConfigPath(Utilities::Path_NetworkCache));
+  if (!sShards.isEmpty()) return;
+
+  const QString root = Utilities::GetConfigPath(Utilities::Path_NetworkCache);
+
+  // Remove what was left by the unsharded cache.
+  for (const QString& dir :
+       QDir(root).entryList(QStringList() << "data*" << "prepared",
+                            QDir::Dirs | QDir::NoDotAndDotDot)) {
+    Utilities::RemoveRecursive(root + "/" + dir);
+  }
+
+  for (int i = 0; i < kShardCount; ++i) {
+    Shard* shard = new Shard;
+    shard->cache_ = new QNetworkDiskCache;
+    shard->cache_->setCacheDirectory(root + "/" + QString::number(i));
+    shard->cache_->setMaximumCacheSize(shard->cache_->maximumCacheSize() /
+                                       kShardCount);
+    shard->memory_.setMaxCost(kMemoryBytesPerShard);
+    sShards << shard;
   }
 }
 
+ThreadSafeNetworkDiskCache::Shard* ThreadSafeNetworkDiskCache::ShardFor(
+    const QUrl& url) {
+  return sShards[qHash(url) % kShardCount];
+}
+
 qint64 ThreadSafeNetworkDiskCache::cacheSize() const {
-  QMutexLocker l(&sMutex);
-  return sCache->cacheSize();
+  qint64 ret = 0;
+  for (Shard* shard : sShards) {
+    QMutexLocker l(&shard->mutex_);
+    ret += shard->cache_->cacheSize();
+  }
+  return ret;
+}
+
+qint64 ThreadSafeNetworkDiskCache::memory_usage() {
+  qint64 ret = 0;
+  for (Shard* shard : sShards) {
+    QMutexLocker l(&shard->mutex_);
+    ret += shard->memory_.totalCost();
+  }
+  return ret;
 }
 
 QIODevice* ThreadSafeNetworkDiskCache::data(const QUrl& url) {
-  QMutexLocker l(&sMutex);
-  return sCache->data(url);
+  Shard* shard = ShardFor(url);
+  QMutexLocker l(&shard->mutex_);
+
+  QByteArray data;
+  if (MemoryEntry* cached = shard->memory_.object(url)) {
+    data = cached->data_;
+  } else {
+    QIODevice* device = shard->cache_->data(url);
+    if (!device || device->size() > kMaxMemoryEntryBytes) return device;
+
+    MemoryEntry* entry = new MemoryEntry;
+    entry->meta_data_ = shard->cache_->metaData(url);
+    entry->data_ = device->readAll();
+    delete device;
+
+    data = entry->data_;
+    shard->memory_.insert(url, entry, data.size());
+  }
+
+  QBuffer* buffer = new QBuffer;
+  buffer->setData(data);
+  buffer->open(QIODevice::ReadOnly);
+  return buffer;
 }
 
 void ThreadSafeNetworkDiskCache::insert(QIODevice* device) {
-  QMutexLocker l(&sMutex);
-  sCache->insert(device);
+  Shard* shard = nullptr;
+  {
+    QMutexLocker l(&sMutex);
+    shard = sPrepared.take(device);
+  }
+  if (!shard) return;
+
+  QMutexLocker l(&shard->mutex_);
+  shard->cache_->insert(device);
 }
 
 QNetworkCacheMetaData ThreadSafeNetworkDiskCache::metaData(const QUrl& url) {
-  QMutexLocker l(&sMutex);
-  return sCache->metaData(url);
+  Shard* shard = ShardFor(url);
+  QMutexLocker l(&shard->mutex_);
+  if (MemoryEntry* entry = shard->memory_.object(url)) {
+    return entry->meta_data_;
+  }
+  return shard->cache_->metaData(url);
 }
 
 QIODevice* ThreadSafeNetworkDiskCache::prepare(
     const QNetworkCacheMetaData& metaData) {
-  QMutexLocker l(&sMutex);
-  return sCache->prepare(metaData);
+  Shard* shard = ShardFor(metaData.url());
+  QIODevice* device = nullptr;
+  {
+    QMutexLocker l(&shard->mutex_);
+    shard->memory_.remove(metaData.url());
+    device = shard->cache_->prepare(metaData);
+  }
+
+  if (device) {
+    QMutexLocker l(&sMutex);
+    sPrepared[device] = shard;
+  }
+  return device;
 }
 
 bool ThreadSafeNetworkDiskCache::remove(const QUrl& url) {
-  QMutexLocker l(&sMutex);
-  return sCache->remove(url);
+  Shard* shard = ShardFor(url);
+  QMutexLocker l(&shard->mutex_);
+  shard->memory_.remove(url);
+  return shard->cache_->remove(url);
 }
 
 void ThreadSafeNetworkDiskCache::updateMetaData(
     const QNetworkCacheMetaData& metaData) {
-  QMutexLocker l(&sMutex);
-  sCache->updateMetaData(metaData);
+  Shard* shard = ShardFor(metaData.url());
+  QMutexLocker l(&shard->mutex_);
+  shard->memory_.remove(metaData.url());
+  shard->cache_->updateMetaData(metaData);
 }
 
 void ThreadSafeNetworkDiskCache::clear() {
-  QMutexLocker l(&sMutex);
-  sCache->clear();
+  for (Shard* shard : sShards) {
+    QMutexLocker l(&shard->mutex_);
+    shard->memory_.clear();
+    shard->cache_->clear();
+  }
 }
 
+QMutex NetworkAccessManager::sStatsMutex;
+QMap<QString, NetworkAccessManager::HostStats> NetworkAccessManager::sStats;
+
 NetworkAccessManager::NetworkAccessManager(QObject* parent)
     : QNetworkAccessManager(parent) {
   setCache(new ThreadSafeNetworkDiskCache(this));
@@ -117,7 +212,50 @@ QNetworkReply* NetworkAccessManager::createRequest(
                              QNetworkRequest::PreferCache);
   }
 
-  return QNetworkAccessManager::createRequest(op, new_request, outgoingData);
+  QNetworkReply* reply =
+      QNetworkAccessManager::createRequest(op, new_request, outgoingData);
+
+  const QString host = request.url().host();
+  if (!host.isEmpty()) {
+    const qint64 start_msec = QDateTime::currentMSecsSinceEpoch();
+    NewClosure(reply, SIGNAL(finished()), [reply, host, start_msec]() {
+      RequestFinished(reply, host, start_msec);
+    });
+  }
+
+  return reply;
+}
+
+void NetworkAccessManager::RequestFinished(QNetworkReply* reply,
+                                           const QString& host,
+                                           qint64 start_msec) {
+  QMutexLocker l(&sStatsMutex);
+  HostStats& stats = sStats[host];
+  stats.requests_++;
+  stats.total_msec_ += QDateTime::currentMSecsSinceEpoch() - start_msec;
+  if (reply->error() != QNetworkReply::NoError) stats.failures_++;
+  if (reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool()) {
+    stats.from_cache_++;
+  }
+}
+
+QMap<QString, NetworkAccessManager::HostStats> NetworkAccessManager::Stats() {
+  QMutexLocker l(&sStatsMutex);
+  return sStats;
+}
+
+NetworkAccessManager* NetworkAccessManager::Shared() {
+  static QMutex mutex;
+  static NetworkAccessManager* instance = nullptr;
+
+  QMutexLocker l(&mutex);
+  if (!instance) {
+    instance = new NetworkAccessManager;
+    if (QCoreApplication::instance()) {
+      instance->moveToThread(QCoreApplication::instance()->thread());
+    }
+  }
+  return instance;
 }
 
 NetworkTimeouts::NetworkTimeouts(int timeout_msec, QObject* parent)
@@ -21,17 +21,31 @@
 #define CORE_NETWORK_H_
 
 #include <QAbstractNetworkCache>
+#include <QCache>
+#include <QMap>
 #include <QMutex>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 
+#include "core/qhash_qurl.h"
+
 class QNetworkDiskCache;
 
+// All the instances share one cache on disk.  It's split into shards by URL,
+// each with its own lock, so threads looking up different URLs don't wait for
+// each other.  Small entries are also kept in memory once they've been read.
 class ThreadSafeNetworkDiskCache : public QAbstractNetworkCache {
  public:
   explicit ThreadSafeNetworkDiskCache(QObject* parent);
 
+  static const int kShardCount;
+  // Entries bigger than this are only kept on disk.
+  static const int kMaxMemoryEntryBytes;
+  static const int kMemoryBytesPerShard;
+
   qint64 cacheSize() const;
+  // Bytes of response data held in memory by every shard.
+  static qint64 memory_usage();
   QIODevice* data(const QUrl& url);
   void insert(QIODevice* device);
   QNetworkCacheMetaData metaData(const QUrl& url);
@@ -42,8 +56,26 @@ class ThreadSafeNetworkDiskCache : public QAbstractNetworkCache {
   void clear();
 
  private:
+  struct MemoryEntry {
+    QNetworkCacheMetaData meta_data_;
+    QByteArray data_;
+  };
+
+  struct Shard {
+    Shard() : cache_(nullptr) {}
+
+    QMutex mutex_;
+    QNetworkDiskCache* cache_;
+    QCache<QUrl, MemoryEntry> memory_;
+  };
+
+  static Shard* ShardFor(const QUrl& url);
+
+  // Guards creating the shards, and sPrepared.
   static QMutex sMutex;
-  static QNetworkDiskCache* sCache;
+  static QList<Shard*> sShards;
+  // Which shard each device returned by prepare() has to be inserted into.
+  static QMap<QIODevice*, Shard*> sPrepared;
 };
 
 class NetworkAccessManager : public QNetworkAccessManager {
@@ -52,9 +84,35 @@ class NetworkAccessManager : public QNetworkAccessManager {
  public:
   explicit NetworkAccessManager(QObject* parent = nullptr);
 
+  // What the requests made by every NetworkAccessManager to one host came to.
+  struct HostStats {
+    HostStats() : requests_(0), failures_(0), from_cache_(0), total_msec_(0) {}
+
+    int requests_;
+    int failures_;
+    int from_cache_;
+    qint64 total_msec_;
+  };
+
+  // A manager that lives in the GUI thread and can be shared by everything
+  // there.  Qt keeps a pool of connections to each host per manager, so
+  // services that use this one reuse each other's connections.  It must only
+  // be used from the GUI thread.
+  static NetworkAccessManager* Shared();
+
+  // Keyed by host.
+  static QMap<QString, HostStats> Stats();
+
  protected:
   QNetworkReply* createRequest(Operation op, const QNetworkRequest& request,
                                QIODevice* outgoingData);
+
+ private:
+  static void RequestFinished(QNetworkReply* reply, const QString& host,
+                              qint64 start_msec);
+
+  static QMutex sStatsMutex;
+  static QMap<QString, HostStats> sStats;
 };
 
 class RedirectFollower : public QObject {
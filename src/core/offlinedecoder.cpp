@@ -0,0 +1,229 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "offlinedecoder.h"
+
+#include <QCoreApplication>
+#include <QMap>
+#include <QPair>
+#include <QThread>
+#include <QThreadStorage>
+
+#include "core/logging.h"
+#include "core/signalchecker.h"
+
+namespace {
+
+// Every decoder created by one thread, by (rate, channels).
+struct ThreadDecoders {
+  ~ThreadDecoders() { qDeleteAll(decoders_); }
+
+  QMap<QPair<int, int>, OfflineDecoder*> decoders_;
+};
+
+QThreadStorage<ThreadDecoders*> sThreadDecoders;
+
+}  // namespace
+
+OfflineDecoder::OfflineDecoder(int rate, int channels)
+    : rate_(rate),
+      channels_(channels),
+      pipeline_(nullptr),
+      src_(nullptr),
+      convert_(nullptr),
+      bus_(nullptr),
+      sink_(nullptr),
+      max_bytes_(0),
+      bytes_fed_(0),
+      stopped_(false) {}
+
+OfflineDecoder::~OfflineDecoder() { Cleanup(); }
+
+OfflineDecoder* OfflineDecoder::ForCurrentThread(int rate, int channels) {
+  if (!sThreadDecoders.hasLocalData()) {
+    sThreadDecoders.setLocalData(new ThreadDecoders);
+  }
+
+  OfflineDecoder*& ret =
+      sThreadDecoders.localData()->decoders_[qMakePair(rate, channels)];
+  if (!ret) ret = new OfflineDecoder(rate, channels);
+  return ret;
+}
+
+GstElement* OfflineDecoder::CreateElement(const QString& factory_name) {
+  GstElement* ret =
+      gst_element_factory_make(factory_name.toAscii().constData(), nullptr);
+
+  if (ret) {
+    gst_bin_add(GST_BIN(pipeline_), ret);
+  } else {
+    qLog(Warning) << "Couldn't create the gstreamer element" << factory_name;
+  }
+
+  return ret;
+}
+
+bool OfflineDecoder::Init() {
+  pipeline_ = gst_pipeline_new("offline-decoder");
+  src_ = CreateElement("filesrc");
+  GstElement* decode = CreateElement("decodebin");
+  convert_ = CreateElement("audioconvert");
+  GstElement* resample = CreateElement("audioresample");
+  GstElement* sink = CreateElement("appsink");
+
+  if (!src_ || !decode || !convert_ || !resample || !sink) {
+    Cleanup();
+    return false;
+  }
+
+  // Connect the elements
+  gst_element_link(src_, decode);
+  gst_element_link(convert_, resample);
+
+  GstCaps* caps = gst_caps_new_simple(
+      "audio/x-raw", "format", G_TYPE_STRING, "S16LE", "channels", G_TYPE_INT,
+      channels_, "rate", G_TYPE_INT, rate_, NULL);
+  gst_element_link_filtered(resample, sink, caps);
+  gst_caps_unref(caps);
+
+  GstAppSinkCallbacks callbacks;
+  memset(&callbacks, 0, sizeof(callbacks));
+  callbacks.new_sample = NewBufferCallback;
+  gst_app_sink_set_callbacks(reinterpret_cast<GstAppSink*>(sink), &callbacks,
+                             this, nullptr);
+  g_object_set(G_OBJECT(sink), "sync", FALSE, nullptr);
+
+  CHECKED_GCONNECT(decode, "pad-added", &NewPadCallback, this);
+
+  bus_ = gst_pipeline_get_bus(GST_PIPELINE(pipeline_));
+  return true;
+}
+
+void OfflineDecoder::Cleanup() {
+  if (bus_) {
+    gst_object_unref(bus_);
+    bus_ = nullptr;
+  }
+
+  if (pipeline_) {
+    gst_element_set_state(pipeline_, GST_STATE_NULL);
+    gst_object_unref(pipeline_);
+    pipeline_ = nullptr;
+  }
+
+  src_ = nullptr;
+  convert_ = nullptr;
+}
+
+bool OfflineDecoder::Decode(const QString& filename, int max_length_secs,
+                            int timeout_secs, Sink* sink) {
+  Q_ASSERT(QThread::currentThread() != qApp->thread());
+
+  if (!pipeline_ && !Init()) return false;
+
+  sink_ = sink;
+  max_bytes_ = qint64(max_length_secs) * rate_ * channels_ * sizeof(qint16);
+  bytes_fed_ = 0;
+  stopped_ = false;
+
+  g_object_set(src_, "location", filename.toUtf8().constData(), nullptr);
+  gst_element_set_state(pipeline_, GST_STATE_PLAYING);
+
+  // Wait until EOS or error
+  GstMessage* msg = gst_bus_timed_pop_filtered(
+      bus_, timeout_secs * GST_SECOND,
+      static_cast<GstMessageType>(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+
+  bool success = false;
+  if (!msg) {
+    qLog(Debug) << "Timed out decoding" << filename;
+  } else if (msg->type == GST_MESSAGE_ERROR) {
+    GError* error = nullptr;
+    gchar* debugs = nullptr;
+
+    gst_message_parse_error(msg, &error, &debugs);
+    QString message = QString::fromLocal8Bit(error->message);
+
+    g_error_free(error);
+    free(debugs);
+
+    qLog(Debug) << "Error processing" << filename << ":" << message;
+  } else {
+    success = true;
+  }
+
+  if (msg) gst_message_unref(msg);
+
+  if (success) {
+    // Going back to READY drops this file's decoders but keeps everything
+    // else for the next one.  Anything left on the bus belongs to this file.
+    gst_element_set_state(pipeline_, GST_STATE_READY);
+    gst_bus_set_flushing(bus_, TRUE);
+    gst_bus_set_flushing(bus_, FALSE);
+  } else {
+    Cleanup();
+  }
+
+  sink_ = nullptr;
+  return success;
+}
+
+void OfflineDecoder::NewPadCallback(GstElement*, GstPad* pad, gpointer data) {
+  OfflineDecoder* me = reinterpret_cast<OfflineDecoder*>(data);
+  GstPad* const audiopad = gst_element_get_static_pad(me->convert_, "sink");
+
+  // The previous file's pad, if decodebin didn't remove it already.
+  if (GST_PAD_IS_LINKED(audiopad)) {
+    gst_pad_unlink(GST_PAD_PEER(audiopad), audiopad);
+  }
+
+  gst_pad_link(pad, audiopad);
+  gst_object_unref(audiopad);
+}
+
+GstFlowReturn OfflineDecoder::NewBufferCallback(GstAppSink* app_sink,
+                                                gpointer self) {
+  OfflineDecoder* me = reinterpret_cast<OfflineDecoder*>(self);
+
+  GstSample* sample = gst_app_sink_pull_sample(app_sink);
+  if (!sample) return GST_FLOW_EOS;
+
+  if (!me->stopped_ && me->sink_) {
+    GstBuffer* buffer = gst_sample_get_buffer(sample);
+    GstMapInfo map;
+    gst_buffer_map(buffer, &map, GST_MAP_READ);
+
+    qint64 size = map.size;
+    if (me->max_bytes_) size = qMin(size, me->max_bytes_ - me->bytes_fed_);
+    me->bytes_fed_ += size;
+
+    const bool more = me->sink_->Consume(
+        reinterpret_cast<const char*>(map.data), size);
+    gst_buffer_unmap(buffer, &map);
+
+    // Seeking with a stop position would do this for most formats but not
+    // all of them, and costs a preroll, so we stop the stream ourselves.
+    if (!more || (me->max_bytes_ && me->bytes_fed_ >= me->max_bytes_)) {
+      me->stopped_ = true;
+      gst_element_post_message(GST_ELEMENT(app_sink),
+                               gst_message_new_eos(GST_OBJECT(app_sink)));
+    }
+  }
+
+  gst_sample_unref(sample);
+  return me->stopped_ ? GST_FLOW_EOS : GST_FLOW_OK;
+}
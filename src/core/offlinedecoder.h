@@ -0,0 +1,85 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_OFFLINEDECODER_H_
+#define CORE_OFFLINEDECODER_H_
+
+#include <gst/gst.h>
+#include <gst/app/gstappsink.h>
+
+#include <QString>
+
+#include <boost/noncopyable.hpp>
+
+class OfflineDecoder : boost::noncopyable {
+  // Decodes local files to 16-bit PCM in the calling thread, for jobs that go
+  // through many files one after another.
+  // The GStreamer pipeline is built once and reused for every file by taking
+  // it back to READY, so only typefinding and the decoders that decodebin
+  // plugs in are redone.  After an error or a timeout the pipeline is thrown
+  // away and built again for the next file.
+
+ public:
+  class Sink {
+   public:
+    virtual ~Sink() {}
+
+    // Called from a GStreamer thread with each block of samples.  Return
+    // false to stop decoding this file.
+    virtual bool Consume(const char* data, int size) = 0;
+  };
+
+  OfflineDecoder(int rate, int channels);
+  ~OfflineDecoder();
+
+  // Returns a decoder for the given format that belongs to the calling
+  // thread, creating it the first time.  It's deleted when the thread exits.
+  static OfflineDecoder* ForCurrentThread(int rate, int channels);
+
+  // Decodes filename and passes the samples to sink.  Stops after
+  // max_length_secs seconds of audio (0 for no limit), when the sink returns
+  // false, or after timeout_secs seconds.  This method is blocking, so you
+  // want to call it in another thread.  Returns false if decoding failed or
+  // timed out; the sink may still have been given some data.
+  bool Decode(const QString& filename, int max_length_secs, int timeout_secs,
+              Sink* sink);
+
+ private:
+  bool Init();
+  void Cleanup();
+  GstElement* CreateElement(const QString& factory_name);
+
+  static void NewPadCallback(GstElement*, GstPad* pad, gpointer data);
+  static GstFlowReturn NewBufferCallback(GstAppSink* app_sink, gpointer self);
+
+ private:
+  const int rate_;
+  const int channels_;
+
+  GstElement* pipeline_;
+  GstElement* src_;
+  GstElement* convert_;
+  GstBus* bus_;
+
+  // State for the file being decoded
+  Sink* sink_;
+  qint64 max_bytes_;
+  qint64 bytes_fed_;
+  bool stopped_;
+};
+
+#endif  // CORE_OFFLINEDECODER_H_
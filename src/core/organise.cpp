@@ -28,9 +28,11 @@
 #include <QTimer>
 #include <QThread>
 #include <QUrl>
+#include <QtConcurrentRun>
 
 #include "musicstorage.h"
 #include "taskmanager.h"
+#include "core/closure.h"
 #include "core/logging.h"
 #include "core/tagreaderclient.h"
 #include "core/utilities.h"
@@ -57,6 +59,8 @@ Organise::Organise(TaskManager* task_manager,
       task_count_(songs_info.count()),
       transcode_suffix_(1),
       tasks_complete_(0),
+      max_concurrent_copies_(1),
+      next_copy_id_(0),
       started_(false),
       task_id_(0),
       current_copy_progress_(0) {
@@ -92,6 +96,7 @@ void Organise::ProcessSomeFiles() {
         files_with_errors_ << task.song_info_.song_.url().toLocalFile();
       tasks_pending_.clear();
     }
+    max_concurrent_copies_ = qMax(1, destination_->MaxConcurrentCopies());
     started_ = true;
   }
 
@@ -103,6 +108,10 @@ void Organise::ProcessSomeFiles() {
       transcode_progress_timer_.start(kTranscodeProgressInterval, this);
       return;
     }
+    if (!tasks_copying_.isEmpty()) {
+      // CopyFinished will start us off again
+      return;
+    }
 
     UpdateProgress();
 
@@ -129,6 +138,13 @@ void Organise::ProcessSomeFiles() {
 
     if (tasks_pending_.isEmpty()) break;
 
+    // Wait for a copy to finish if the destination is busy - CopyFinished
+    // will start us off again.
+    if (max_concurrent_copies_ > 1 &&
+        tasks_copying_.count() >= max_concurrent_copies_) {
+      return;
+    }
+
     Task task = tasks_pending_.takeFirst();
     qLog(Info) << "Processing" << task.song_info_.song_.url().toLocalFile();
 
@@ -188,40 +204,74 @@ void Organise::ProcessSomeFiles() {
     job.overwrite_ = overwrite_;
     job.mark_as_listened_ = mark_as_listened_;
     job.remove_original_ = !copy_;
-    job.progress_ = std::bind(&Organise::SetSongProgress, this, _1,
-                              !task.transcoded_filename_.isEmpty());
 
-    if (!destination_->CopyToStorage(job)) {
-      files_with_errors_ << task.song_info_.song_.basefilename();
-    } else {
-      if (job.remove_original_) {
-        // Notify other aspects of system that song has been invalidated
-        QString root = destination_->LocalPath();
-        QFileInfo new_file = QFileInfo(
-             root + "/" + task.song_info_.new_filename_);
-        emit SongPathChanged(song, new_file);
-      }
-      if (job.mark_as_listened_) {
-        emit FileCopied(job.metadata_.id());
-      }
+    if (max_concurrent_copies_ > 1) {
+      // Copy on another thread so this one can carry on handing out work.
+      job.progress_ = [](float) {};
+
+      const int id = next_copy_id_++;
+      tasks_copying_[id] = qMakePair(task, job);
+      QFuture<bool> future = QtConcurrent::run(
+          std::bind(&MusicStorage::CopyToStorage, destination_.get(), job));
+      NewClosure(future, this, SLOT(CopyFinished(int, QFuture<bool>)), id,
+                 future);
+      continue;
     }
 
-    // Clean up the temporary transcoded file
-    if (!task.transcoded_filename_.isEmpty())
-      QFile::remove(task.transcoded_filename_);
-
-    tasks_complete_++;
+    job.progress_ = std::bind(&Organise::SetSongProgress, this, _1,
+                              !task.transcoded_filename_.isEmpty());
+    FinishCopy(task, job, destination_->CopyToStorage(job));
   }
   SetSongProgress(0);
 
   QTimer::singleShot(0, this, SLOT(ProcessSomeFiles()));
 }
 
+void Organise::CopyFinished(int id, QFuture<bool> future) {
+  const QPair<Task, MusicStorage::CopyJob> copy = tasks_copying_.take(id);
+  FinishCopy(copy.first, copy.second, future.result());
+  UpdateProgress();
+
+  QTimer::singleShot(0, this, SLOT(ProcessSomeFiles()));
+}
+
+void Organise::FinishCopy(const Task& task, const MusicStorage::CopyJob& job,
+                          bool success) {
+  if (!success) {
+    files_with_errors_ << task.song_info_.song_.basefilename();
+  } else {
+    if (job.remove_original_) {
+      // Notify other aspects of system that song has been invalidated
+      QString root = destination_->LocalPath();
+      QFileInfo new_file = QFileInfo(
+           root + "/" + task.song_info_.new_filename_);
+      emit SongPathChanged(job.metadata_, new_file);
+    }
+    if (job.mark_as_listened_) {
+      emit FileCopied(job.metadata_.id());
+    }
+  }
+
+  // Clean up the temporary transcoded file
+  if (!task.transcoded_filename_.isEmpty())
+    QFile::remove(task.transcoded_filename_);
+
+  tasks_complete_++;
+}
+
 Song::FileType Organise::CheckTranscode(Song::FileType original_type) const {
+  return TranscodeTarget(destination_.get(), supported_filetypes_,
+                         original_type);
+}
+
+Song::FileType Organise::TranscodeTarget(
+    const MusicStorage* destination,
+    const QList<Song::FileType>& supported_filetypes,
+    Song::FileType original_type) {
   if (original_type == Song::Type_Stream) return Song::Type_Unknown;
 
-  const MusicStorage::TranscodeMode mode = destination_->GetTranscodeMode();
-  const Song::FileType format = destination_->GetTranscodeFormat();
+  const MusicStorage::TranscodeMode mode = destination->GetTranscodeMode();
+  const Song::FileType format = destination->GetTranscodeFormat();
 
   switch (mode) {
     case MusicStorage::Transcode_Never:
@@ -232,8 +282,8 @@ Song::FileType Organise::CheckTranscode(Song::FileType original_type) const {
       return format;
 
     case MusicStorage::Transcode_Unsupported:
-      if (supported_filetypes_.isEmpty() ||
-          supported_filetypes_.contains(original_type))
+      if (supported_filetypes.isEmpty() ||
+          supported_filetypes.contains(original_type))
         return Song::Type_Unknown;
 
       if (format != Song::Type_Unknown) return format;
@@ -241,7 +291,7 @@ Song::FileType Organise::CheckTranscode(Song::FileType original_type) const {
       // The user hasn't visited the device properties page yet to set a
       // preferred format for the device, so we have to pick the best
       // available one.
-      return Transcoder::PickBestFormat(supported_filetypes_);
+      return Transcoder::PickBestFormat(supported_filetypes);
   }
   return Song::Type_Unknown;
 }
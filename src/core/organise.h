@@ -26,13 +26,14 @@
 
 #include <QFileInfo>
 #include <QBasicTimer>
+#include <QFuture>
 #include <QObject>
 #include <QTemporaryFile>
 
+#include "musicstorage.h"
 #include "organiseformat.h"
 #include "transcoder/transcoder.h"
 
-class MusicStorage;
 class TaskManager;
 
 class Organise : public QObject {
@@ -58,6 +59,13 @@ class Organise : public QObject {
 
   void Start();
 
+  // The type a song of original_type has to be transcoded to before it's
+  // copied to destination, or Type_Unknown if it can be copied as it is.
+  static Song::FileType TranscodeTarget(
+      const MusicStorage* destination,
+      const QList<Song::FileType>& supported_filetypes,
+      Song::FileType original_type);
+
  signals:
   void Finished(const QStringList& files_with_errors);
   void FileCopied(int database_id);
@@ -69,6 +77,7 @@ class Organise : public QObject {
  private slots:
   void ProcessSomeFiles();
   void FileTranscoded(const QString& input, const QString& output, bool success);
+  void CopyFinished(int id, QFuture<bool> future);
 
  private:
   void SetSongProgress(float progress, bool transcoded = false);
@@ -88,6 +97,9 @@ class Organise : public QObject {
     Song::FileType new_filetype_;
   };
 
+  void FinishCopy(const Task& task, const MusicStorage::CopyJob& job,
+                  bool success);
+
   QThread* thread_;
   QThread* original_thread_;
   TaskManager* task_manager_;
@@ -110,6 +122,12 @@ class Organise : public QObject {
   QMap<QString, Task> tasks_transcoding_;
   int tasks_complete_;
 
+  // Copies running on other threads, when the destination allows more than
+  // one at once.
+  int max_concurrent_copies_;
+  int next_copy_id_;
+  QMap<int, QPair<Task, MusicStorage::CopyJob>> tasks_copying_;
+
   bool started_;
 
   int task_id_;
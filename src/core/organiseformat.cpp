@@ -81,11 +81,102 @@ OrganiseFormat::OrganiseFormat(const QString& format)
     : format_(format),
       replace_non_ascii_(false),
       replace_spaces_(false),
-      replace_the_(false) {}
+      replace_the_(false) {
+  Compile();
+}
 
 void OrganiseFormat::set_format(const QString& v) {
   format_ = v;
   format_.replace('\\', '/');
+  Compile();
+}
+
+void OrganiseFormat::Compile() {
+  program_.clear();
+
+  QString literal;
+  auto flush_literal = [&]() {
+    if (literal.isEmpty()) return;
+    program_ << Token(Token::Type_Literal, Tag_Unknown, literal);
+    literal.clear();
+  };
+
+  // Matches kTagPattern and kBlockPattern: a tag is a % followed by any
+  // letters, and a block is a { followed by a } with no other braces in
+  // between.
+  bool in_block = false;
+  const int length = format_.length();
+  for (int i = 0; i < length; ++i) {
+    const ushort c = format_[i].unicode();
+
+    if (c == '%') {
+      int end = i + 1;
+      while (end < length) {
+        const ushort next = format_[end].unicode();
+        if ((next < 'a' || next > 'z') && (next < 'A' || next > 'Z')) break;
+        ++end;
+      }
+
+      const QString name = format_.mid(i + 1, end - i - 1);
+      flush_literal();
+      program_ << Token(Token::Type_Tag, Tag(kKnownTags.indexOf(name) + 1));
+      i = end - 1;
+      continue;
+    }
+
+    if (c == '{' && !in_block) {
+      int end = i + 1;
+      while (end < length && format_[end] != '{' && format_[end] != '}') ++end;
+
+      if (end < length && end > i + 1 && format_[end] == '}') {
+        flush_literal();
+        program_ << Token(Token::Type_BlockStart);
+        in_block = true;
+        continue;
+      }
+    } else if (c == '}' && in_block) {
+      flush_literal();
+      program_ << Token(Token::Type_BlockEnd);
+      in_block = false;
+      continue;
+    }
+
+    literal.append(format_[i]);
+  }
+
+  flush_literal();
+}
+
+QString OrganiseFormat::Evaluate(const Song& song) const {
+  QString ret;
+  int block_start = 0;
+  bool block_empty = false;
+
+  for (const Token& token : program_) {
+    switch (token.type_) {
+      case Token::Type_Literal:
+        ret.append(token.literal_);
+        break;
+
+      case Token::Type_Tag: {
+        const QString value = TagValue(token.tag_, song);
+        if (value.isEmpty()) block_empty = true;
+        ret.append(value);
+        break;
+      }
+
+      case Token::Type_BlockStart:
+        block_start = ret.length();
+        block_empty = false;
+        break;
+
+      case Token::Type_BlockEnd:
+        if (block_empty) ret.truncate(block_start);
+        break;
+    }
+  }
+
+  return ret;
 }
 
 bool OrganiseFormat::IsValid() const {
@@ -97,7 +188,7 @@ bool OrganiseFormat::IsValid() const {
 }
 
 QString OrganiseFormat::GetFilenameForSong(const Song& song) const {
-  QString filename = ParseBlock(format_, song);
+  QString filename = Evaluate(song);
 
   if (QFileInfo(filename).completeBaseName().isEmpty()) {
     // Avoid having empty filenames, or filenames with extension only: in this
@@ -109,7 +200,11 @@ QString OrganiseFormat::GetFilenameForSong(const Song& song) const {
         Utilities::PathWithoutFilenameExtension(filename) + song.basefilename();
   }
 
-  if (replace_spaces_) filename.replace(QRegExp("\\s"), "_");
+  if (replace_spaces_) {
+    for (int i = 0; i < filename.length(); ++i) {
+      if (filename[i].isSpace()) filename[i] = '_';
+    }
+  }
 
   if (replace_non_ascii_) {
     QString stripped;
@@ -143,97 +238,85 @@ QString OrganiseFormat::GetFilenameForSong(const Song& song) const {
   return parts.join("/");
 }
 
-QString OrganiseFormat::ParseBlock(QString block, const Song& song,
-                                   bool* any_empty) const {
-  QRegExp tag_regexp(kTagPattern);
-  QRegExp block_regexp(kBlockPattern);
-
-  // Find any blocks first
-  int pos = 0;
-  while ((pos = block_regexp.indexIn(block, pos)) != -1) {
-    // Recursively parse the block
-    bool empty = false;
-    QString value = ParseBlock(block_regexp.cap(1), song, &empty);
-    if (empty) value = "";
-
-    // Replace the block's value
-    block.replace(pos, block_regexp.matchedLength(), value);
-    pos += value.length();
-  }
-
-  // Now look for tags
-  bool empty = false;
-  pos = 0;
-  while ((pos = tag_regexp.indexIn(block, pos)) != -1) {
-    QString value = TagValue(tag_regexp.cap(1), song);
-    if (value.isEmpty()) empty = true;
-
-    block.replace(pos, tag_regexp.matchedLength(), value);
-    pos += value.length();
-  }
-
-  if (any_empty) *any_empty = empty;
-  return block;
-}
-
-QString OrganiseFormat::TagValue(const QString& tag, const Song& song) const {
+QString OrganiseFormat::TagValue(Tag tag, const Song& song) const {
   QString value;
 
-  // TODO(sobkas): What about nice switch statement?
-
-  if (tag == "title")
-    value = song.title();
-  else if (tag == "album")
-    value = song.album();
-  else if (tag == "artist")
-    value = song.artist();
-  else if (tag == "composer")
-    value = song.composer();
-  else if (tag == "performer")
-    value = song.performer();
-  else if (tag == "grouping")
-    value = song.grouping();
-  else if (tag == "lyrics")
-    value = song.lyrics();
-  else if (tag == "genre")
-    value = song.genre();
-  else if (tag == "comment")
-    value = song.comment();
-  else if (tag == "year")
-    value = QString::number(song.year());
-  else if (tag == "originalyear")
-    value = QString::number(song.effective_originalyear());
-  else if (tag == "track")
-    value = QString::number(song.track());
-  else if (tag == "disc")
-    value = QString::number(song.disc());
-  else if (tag == "bpm")
-    value = QString::number(song.bpm());
-  else if (tag == "length")
-    value = QString::number(song.length_nanosec() / kNsecPerSec);
-  else if (tag == "bitrate")
-    value = QString::number(song.bitrate());
-  else if (tag == "samplerate")
-    value = QString::number(song.samplerate());
-  else if (tag == "extension")
-    value = QFileInfo(song.url().toLocalFile()).suffix();
-  else if (tag == "artistinitial") {
-    value = song.effective_albumartist().trimmed();
-    if (replace_the_ && !value.isEmpty())
-      value.replace(QRegExp("^the\\s+", Qt::CaseInsensitive), "");
-    if (!value.isEmpty()) value = value[0].toUpper();
-  } else if (tag == "albumartist") {
-    value = song.is_compilation() ? "Various Artists"
-                                  : song.effective_albumartist();
+  switch (tag) {
+    case Tag_Title:
+      value = song.title();
+      break;
+    case Tag_Album:
+      value = song.album();
+      break;
+    case Tag_Artist:
+      value = song.artist();
+      break;
+    case Tag_Composer:
+      value = song.composer();
+      break;
+    case Tag_Performer:
+      value = song.performer();
+      break;
+    case Tag_Grouping:
+      value = song.grouping();
+      break;
+    case Tag_Lyrics:
+      value = song.lyrics();
+      break;
+    case Tag_Genre:
+      value = song.genre();
+      break;
+    case Tag_Comment:
+      value = song.comment();
+      break;
+    case Tag_Year:
+      value = QString::number(song.year());
+      break;
+    case Tag_OriginalYear:
+      value = QString::number(song.effective_originalyear());
+      break;
+    case Tag_Track:
+      value = QString::number(song.track());
+      break;
+    case Tag_Disc:
+      value = QString::number(song.disc());
+      break;
+    case Tag_Bpm:
+      value = QString::number(song.bpm());
+      break;
+    case Tag_Length:
+      value = QString::number(song.length_nanosec() / kNsecPerSec);
+      break;
+    case Tag_Bitrate:
+      value = QString::number(song.bitrate());
+      break;
+    case Tag_Samplerate:
+      value = QString::number(song.samplerate());
+      break;
+    case Tag_Extension:
+      value = QFileInfo(song.url().toLocalFile()).suffix();
+      break;
+    case Tag_ArtistInitial:
+      value = song.effective_albumartist().trimmed();
+      if (replace_the_ && !value.isEmpty())
+        value.replace(QRegExp("^the\\s+", Qt::CaseInsensitive), "");
+      if (!value.isEmpty()) value = value[0].toUpper();
+      break;
+    case Tag_AlbumArtist:
+      value = song.is_compilation() ? "Various Artists"
+                                    : song.effective_albumartist();
+      break;
+    case Tag_Unknown:
+      break;
   }
 
-  if (replace_the_ && (tag == "artist" || tag == "albumartist"))
+  if (replace_the_ && (tag == Tag_Artist || tag == Tag_AlbumArtist))
     value.replace(QRegExp("^the\\s+", Qt::CaseInsensitive), "");
 
   if (value == "0" || value == "-1") value = "";
 
   // Prepend a 0 to single-digit track numbers
-  if (tag == "track" && value.length() == 1) value.prepend('0');
+  if (tag == Tag_Track && value.length() == 1) value.prepend('0');
 
   // Replace characters that really shouldn't be in paths
   for (int i = 0; i < kInvalidFatCharactersCount; ++i) {
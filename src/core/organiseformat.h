@@ -72,11 +72,53 @@ class OrganiseFormat {
   };
 
  private:
-  QString ParseBlock(QString block, const Song& song,
-                     bool* any_empty = nullptr) const;
-  QString TagValue(const QString& tag, const Song& song) const;
+  // In the same order as kKnownTags.
+  enum Tag {
+    Tag_Unknown = 0,
+    Tag_Title,
+    Tag_Album,
+    Tag_Artist,
+    Tag_ArtistInitial,
+    Tag_AlbumArtist,
+    Tag_Composer,
+    Tag_Track,
+    Tag_Disc,
+    Tag_Bpm,
+    Tag_Year,
+    Tag_Genre,
+    Tag_Comment,
+    Tag_Length,
+    Tag_Bitrate,
+    Tag_Samplerate,
+    Tag_Extension,
+    Tag_Performer,
+    Tag_Grouping,
+    Tag_Lyrics,
+    Tag_OriginalYear,
+  };
+
+  // The format is turned into a list of these whenever it changes, so
+  // organising lots of songs doesn't parse it again for each of them.  The
+  // text between a BlockStart and a BlockEnd is dropped if any of the tags in
+  // it are empty.
+  struct Token {
+    enum Type { Type_Literal, Type_Tag, Type_BlockStart, Type_BlockEnd };
+
+    explicit Token(Type type, Tag tag = Tag_Unknown,
+                   const QString& literal = QString())
+        : type_(type), tag_(tag), literal_(literal) {}
+
+    Type type_;
+    Tag tag_;
+    QString literal_;
+  };
+
+  void Compile();
+  QString Evaluate(const Song& song) const;
+  QString TagValue(Tag tag, const Song& song) const;
 
   QString format_;
+  QList<Token> program_;
   bool replace_non_ascii_;
   bool replace_spaces_;
   bool replace_the_;
@@ -0,0 +1,180 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "playbacktrace.h"
+
+#include <algorithm>
+
+#include <QMutexLocker>
+#include <QVector>
+
+#include "core/logging.h"
+
+const int PlaybackTrace::kMaxTraces = 50;
+
+PlaybackTrace* PlaybackTrace::Instance() {
+  static PlaybackTrace instance;
+  return &instance;
+}
+
+PlaybackTrace::PlaybackTrace() : next_id_(1) { clock_.start(); }
+
+qint64 PlaybackTrace::NowUsec() const { return clock_.nsecsElapsed() / 1000; }
+
+int PlaybackTrace::Begin(const QUrl& url) {
+  QMutexLocker l(&mutex_);
+
+  Trace trace;
+  trace.id_ = next_id_++;
+  trace.url_ = url;
+  trace.started_ = QDateTime::currentDateTime();
+  trace.begin_usec_ = NowUsec();
+  std::fill(trace.start_, trace.start_ + SpanCount, -1);
+  std::fill(trace.end_, trace.end_ + SpanCount, -1);
+
+  traces_ << trace;
+  while (traces_.count() > kMaxTraces) traces_.removeFirst();
+
+  return trace.id_;
+}
+
+int PlaybackTrace::current_id() const {
+  QMutexLocker l(&mutex_);
+  return traces_.isEmpty() ? -1 : traces_.last().id_;
+}
+
+PlaybackTrace::Trace* PlaybackTrace::FindLocked(int trace_id) {
+  if (trace_id <= 0) return nullptr;
+
+  // The trace is nearly always the last one
+  for (int i = traces_.count() - 1; i >= 0; --i) {
+    if (traces_[i].id_ == trace_id) return &traces_[i];
+  }
+  return nullptr;
+}
+
+void PlaybackTrace::StartSpan(int trace_id, Span span) {
+  QMutexLocker l(&mutex_);
+  Trace* trace = FindLocked(trace_id);
+  if (!trace || trace->start_[span] != -1) return;
+
+  trace->start_[span] = NowUsec() - trace->begin_usec_;
+}
+
+void PlaybackTrace::EndSpan(int trace_id, Span span) {
+  QMutexLocker l(&mutex_);
+  Trace* trace = FindLocked(trace_id);
+  if (!trace || trace->start_[span] == -1 || trace->end_[span] != -1) return;
+
+  trace->end_[span] = NowUsec() - trace->begin_usec_;
+
+  if (span == Span_FirstBuffer) {
+    qLog(Debug) << "Playback latency:" << FormatTrace(*trace);
+  }
+}
+
+void PlaybackTrace::Mark(int trace_id, Span span) {
+  StartSpan(trace_id, span);
+  EndSpan(trace_id, span);
+}
+
+QString PlaybackTrace::SpanName(Span span) {
+  switch (span) {
+    case Span_UrlHandler:
+      return "url-handler";
+    case Span_PipelineInit:
+      return "pipeline-init";
+    case Span_DecodeBin:
+      return "decodebin";
+    case Span_Buffering:
+      return "buffering";
+    case Span_StateChange:
+      return "to-playing";
+    case Span_FirstBuffer:
+      return "first-buffer";
+    case SpanCount:
+      break;
+  }
+  return QString();
+}
+
+QString PlaybackTrace::FormatTrace(const Trace& trace) {
+  QStringList spans;
+  for (int i = 0; i < SpanCount; ++i) {
+    if (trace.end_[i] == -1) continue;
+
+    const Span span = Span(i);
+    if (span == Span_FirstBuffer) {
+      // This one is a moment rather than a span
+      spans << QString("%1 at %2ms").arg(SpanName(span)).arg(
+                   trace.end_[i] / 1000.0, 0, 'f', 1);
+    } else {
+      spans << QString("%1 %2ms (at %3ms)")
+                   .arg(SpanName(span))
+                   .arg((trace.end_[i] - trace.start_[i]) / 1000.0, 0, 'f', 1)
+                   .arg(trace.start_[i] / 1000.0, 0, 'f', 1);
+    }
+  }
+
+  return QString("%1 %2: %3")
+      .arg(trace.started_.toString("hh:mm:ss"), trace.url_.toString(),
+           spans.isEmpty() ? "nothing recorded" : spans.join(", "));
+}
+
+QStringList PlaybackTrace::Report() const {
+  QMutexLocker l(&mutex_);
+
+  QStringList ret;
+  for (const Trace& trace : traces_) ret << FormatTrace(trace);
+  return ret;
+}
+
+QString PlaybackTrace::Summary() const {
+  QMutexLocker l(&mutex_);
+
+  QStringList spans;
+  for (int i = 0; i < SpanCount; ++i) {
+    QVector<qint64> durations;
+    for (const Trace& trace : traces_) {
+      if (trace.end_[i] == -1) continue;
+      durations << (i == Span_FirstBuffer ? trace.end_[i]
+                                          : trace.end_[i] - trace.start_[i]);
+    }
+    if (durations.isEmpty()) continue;
+
+    std::nth_element(durations.begin(),
+                     durations.begin() + durations.count() / 2,
+                     durations.end());
+    spans << QString("%1 %2ms (%3 tracks)")
+                 .arg(SpanName(Span(i)))
+                 .arg(durations[durations.count() / 2] / 1000.0, 0, 'f', 1)
+                 .arg(durations.count());
+  }
+
+  if (spans.isEmpty()) return QString();
+  return "median " + spans.join(", ");
+}
+
+PlaybackTrace::ScopedSpan::ScopedSpan(int trace_id, Span span)
+    : trace_id_(trace_id), span_(span) {
+  PlaybackTrace::Instance()->StartSpan(trace_id_, span_);
+}
+
+PlaybackTrace::ScopedSpan::~ScopedSpan() {
+  PlaybackTrace::Instance()->EndSpan(trace_id_, span_);
+}
@@ -0,0 +1,106 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CORE_PLAYBACKTRACE_H_
+#define CORE_PLAYBACKTRACE_H_
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMutex>
+#include <QStringList>
+#include <QUrl>
+
+// Records where the time goes between the player being asked to play a track
+// and the first buffer of it reaching the audio sink.  Each track change
+// starts a new trace, and the player, the engine and its pipelines add spans
+// to it as they go.  The last few traces are kept for the console and the
+// periodic latency log.  Spans can be added from any thread.
+class PlaybackTrace {
+ public:
+  enum Span {
+    Span_UrlHandler = 0,
+    Span_PipelineInit,
+    Span_DecodeBin,
+    Span_Buffering,
+    Span_StateChange,
+    Span_FirstBuffer,
+
+    SpanCount
+  };
+
+  static PlaybackTrace* Instance();
+
+  static const int kMaxTraces;
+
+  // Starts a trace for a new track change and returns its ID.
+  int Begin(const QUrl& url);
+  int current_id() const;
+
+  // Only the first start and end of each span in a trace are recorded.
+  // Traces that have been dropped already are ignored.
+  void StartSpan(int trace_id, Span span);
+  void EndSpan(int trace_id, Span span);
+  // Records a span that starts and ends now.
+  void Mark(int trace_id, Span span);
+
+  // One line per trace, oldest first.
+  QStringList Report() const;
+  // The median duration of each span over the traces that are kept.
+  QString Summary() const;
+
+  static QString SpanName(Span span);
+
+  // Starts a span when it's constructed and ends it when it goes out of
+  // scope.
+  class ScopedSpan {
+   public:
+    ScopedSpan(int trace_id, Span span);
+    ~ScopedSpan();
+
+   private:
+    Q_DISABLE_COPY(ScopedSpan);
+
+    const int trace_id_;
+    const Span span_;
+  };
+
+ private:
+  PlaybackTrace();
+
+  struct Trace {
+    int id_;
+    QUrl url_;
+    QDateTime started_;
+    // Microseconds since the start of the trace, -1 if it didn't happen.
+    qint64 start_[SpanCount];
+    qint64 end_[SpanCount];
+    qint64 begin_usec_;
+  };
+
+  Trace* FindLocked(int trace_id);
+  qint64 NowUsec() const;
+  static QString FormatTrace(const Trace& trace);
+
+  mutable QMutex mutex_;
+  QElapsedTimer clock_;
+  int next_id_;
+  QList<Trace> traces_;
+};
+
+#endif  // CORE_PLAYBACKTRACE_H_
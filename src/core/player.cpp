@@ -37,13 +37,17 @@
 #include "config.h"
 #include "core/application.h"
 #include "core/logging.h"
+#include "core/playbacktrace.h"
+#include "core/settingscache.h"
 #include "core/urlhandler.h"
+#include "core/urlresolver.h"
 #include "engines/enginebase.h"
 #include "engines/gstengine.h"
 #include "library/librarybackend.h"
 #include "playlist/playlist.h"
 #include "playlist/playlistitem.h"
 #include "playlist/playlistmanager.h"
+#include "transcoder/transcodescheduler.h"
 
 #ifdef HAVE_LIBLASTFM
 #include "internet/lastfm/lastfmservice.h"
@@ -52,6 +56,9 @@
 using std::shared_ptr;
 
 const char* Player::kSettingsGroup = "Player";
+const int Player::kPrefetchDelayMsec = 10000;
+const int Player::kResolveAheadDelayMsec = 2000;
+const int Player::kResolveAheadCount = 3;
 
 Player::Player(Application* app, QObject* parent)
     : PlayerInterface(parent),
@@ -64,10 +71,30 @@ Player::Player(Application* app, QObject* parent)
       volume_before_mute_(50),
       last_pressed_previous_(QDateTime::currentDateTime()),
       menu_previousmode_(PreviousBehaviour_DontRestart),
-      seek_step_sec_(10) {
-  settings_.beginGroup("Player");
+      seek_step_sec_(10),
+      stop_play_if_fail_(false),
+      url_resolver_(new UrlResolver(this)),
+      prefetch_timer_(new QTimer(this)),
+      resolve_ahead_timer_(new QTimer(this)),
+      latency_log_timer_(new QTimer(this)) {
+  settings_.reset(SettingsCache::CreateProvider());
+  settings_->set_group("Player");
+
+  prefetch_timer_->setSingleShot(true);
+  prefetch_timer_->setInterval(kPrefetchDelayMsec);
+  connect(prefetch_timer_, SIGNAL(timeout()), SLOT(PrefetchNextItem()));
+
+  resolve_ahead_timer_->setSingleShot(true);
+  resolve_ahead_timer_->setInterval(kResolveAheadDelayMsec);
+  connect(resolve_ahead_timer_, SIGNAL(timeout()),
+          SLOT(ResolveUpcomingItems()));
+
+  connect(latency_log_timer_, SIGNAL(timeout()), SLOT(LogPlaybackLatency()));
+
+  connect(url_resolver_, SIGNAL(LoadComplete(UrlHandler::LoadResult)),
+          SLOT(HandleLoadResult(UrlHandler::LoadResult)));
 
-  SetVolume(settings_.value("volume", 50).toInt());
+  SetVolume(settings_->value("volume", 50).toInt());
 
   connect(engine_.get(), SIGNAL(Error(QString)), SIGNAL(Error(QString)));
 
@@ -89,7 +116,7 @@ void Player::Init() {
   connect(engine_.get(), SIGNAL(MetaData(Engine::SimpleMetaBundle)),
           SLOT(EngineMetadataReceived(Engine::SimpleMetaBundle)));
 
-  engine_->SetVolume(settings_.value("volume", 50).toInt());
+  engine_->SetVolume(settings_->value("volume", 50).toInt());
 
   ReloadSettings();
 
@@ -106,6 +133,15 @@ void Player::ReloadSettings() {
       s.value("menu_previousmode", PreviousBehaviour_DontRestart).toInt());
 
   seek_step_sec_ = s.value("seek_step_sec", 10).toInt();
+  stop_play_if_fail_ = s.value("stop_play_if_fail", false).toBool();
+
+  // Not in the settings dialog - this is for people chasing slow track changes
+  const int latency_log_sec = s.value("latency_log_interval", 0).toInt();
+  if (latency_log_sec > 0) {
+    latency_log_timer_->start(latency_log_sec * 1000);
+  } else {
+    latency_log_timer_->stop();
+  }
 
   s.endGroup();
 
@@ -144,6 +180,10 @@ void Player::HandleLoadResult(const UrlHandler::LoadResult& result) {
         item->SetTemporaryMetadata(song);
         app_->playlist_manager()->active()->InformOfCurrentSongChange();
       }
+      PlaybackTrace::Instance()->EndSpan(
+          PlaybackTrace::Instance()->current_id(),
+          PlaybackTrace::Span_UrlHandler);
+      SetPrecomputedGain(result.media_url_, item->Metadata());
       engine_->Play(
           result.media_url_, stream_change_type_, item->Metadata().has_cue(),
           item->Metadata().beginning_nanosec(), item->Metadata().end_nanosec());
@@ -190,7 +230,8 @@ void Player::NextItem(Engine::TrackChangeFlags change) {
   // If we received too many errors in auto change, with repeat enabled, we stop
   if (change == Engine::Auto) {
     const PlaylistSequence::RepeatMode repeat_mode =
-        active_playlist->sequence()->repeat_mode();
+        active_playlist->sequence() ? active_playlist->sequence()->repeat_mode()
+                                    : PlaylistSequence::Repeat_Off;
     if (repeat_mode != PlaylistSequence::Repeat_Off) {
       if ((repeat_mode == PlaylistSequence::Repeat_Track &&
            nb_errors_received_ >= 3) ||
@@ -236,6 +277,12 @@ bool Player::HandleStopAfter() {
   return false;
 }
 
+void Player::SetPrecomputedGain(const QUrl& url, const Song& song) {
+  if (!song.has_replaygain()) return;
+  engine_->SetPrecomputedGain(url, song.replaygain_track_gain(),
+                              song.replaygain_album_gain());
+}
+
 void Player::TrackEnded() {
   if (HandleStopAfter()) return;
 
@@ -348,6 +395,20 @@ void Player::EngineStateChanged(Engine::State state) {
     nb_errors_received_ = 0;
   }
 
+  // Only prefetch the next track once this one has been playing for a while,
+  // so skipping quickly through a playlist doesn't download everything.
+  if (state == Engine::Playing) {
+    prefetch_timer_->start();
+    resolve_ahead_timer_->start();
+  } else {
+    prefetch_timer_->stop();
+    resolve_ahead_timer_->stop();
+  }
+
+  // Leave a core free for the audio pipeline while anything is playing.
+  TranscodeScheduler::Instance()->SetPlaybackActive(
+      state == Engine::Playing || state == Engine::Paused);
+
   switch (state) {
     case Engine::Paused:
       emit Paused();
@@ -368,7 +429,7 @@ void Player::SetVolume(int value) {
   int old_volume = engine_->volume();
 
   int volume = qBound(0, value, 100);
-  settings_.setValue("volume", volume);
+  settings_->setValue("volume", volume);
   engine_->SetVolume(volume);
 
   if (volume != old_volume) {
@@ -411,9 +472,14 @@ void Player::PlayAt(int index, Engine::TrackChangeFlags change,
     if (url == loading_async_) return;
 
     stream_change_type_ = change;
-    HandleLoadResult(url_handlers_[url.scheme()]->StartLoading(url));
+    PlaybackTrace::Instance()->StartSpan(PlaybackTrace::Instance()->Begin(url),
+                                         PlaybackTrace::Span_UrlHandler);
+    HandleLoadResult(
+        url_resolver_->StartLoading(url_handlers_[url.scheme()], url));
   } else {
     loading_async_ = QUrl();
+    PlaybackTrace::Instance()->Begin(url);
+    SetPrecomputedGain(current_item_->Url(), current_item_->Metadata());
     engine_->Play(current_item_->Url(), change,
                   current_item_->Metadata().has_cue(),
                   current_item_->Metadata().beginning_nanosec(),
@@ -582,8 +648,11 @@ void Player::TrackAboutToEnd() {
   QUrl url = next_item->Url();
 
   // Get the actual track URL rather than the stream URL.
-  if (url_handlers_.contains(url.scheme())) {
-    UrlHandler::LoadResult result = url_handlers_[url.scheme()]->LoadNext(url);
+  UrlHandler::LoadResult result(url);
+  if (url_resolver_->Lookup(url, &result)) {
+    url = result.media_url_;
+  } else if (url_handlers_.contains(url.scheme())) {
+    result = url_handlers_[url.scheme()]->LoadNext(url);
     switch (result.type_) {
       case UrlHandler::LoadResult::NoMoreTracks:
         return;
@@ -597,11 +666,40 @@ void Player::TrackAboutToEnd() {
         break;
     }
   }
+  SetPrecomputedGain(url, next_item->Metadata());
   engine_->StartPreloading(url, next_item->Metadata().has_cue(),
                            next_item->Metadata().beginning_nanosec(),
                            next_item->Metadata().end_nanosec());
 }
 
+void Player::PrefetchNextItem() {
+  Playlist* playlist = app_->playlist_manager()->active();
+  const int next_row = playlist->next_row();
+  if (next_row == -1) return;
+
+  const QUrl url = playlist->item_at(next_row)->Url();
+  if (url_handlers_.contains(url.scheme())) {
+    url_handlers_[url.scheme()]->Prefetch(url);
+  }
+}
+
+void Player::ResolveUpcomingItems() {
+  // Work out the media URLs of the next few streamed tracks while this one
+  // plays, so changing track doesn't have to wait for them.
+  Playlist* playlist = app_->playlist_manager()->active();
+  for (int row : playlist->upcoming_rows(kResolveAheadCount)) {
+    const QUrl url = playlist->item_at(row)->Url();
+    if (url_handlers_.contains(url.scheme())) {
+      url_resolver_->ResolveAhead(url_handlers_[url.scheme()], url);
+    }
+  }
+}
+
+void Player::LogPlaybackLatency() {
+  const QString summary = PlaybackTrace::Instance()->Summary();
+  if (!summary.isEmpty()) qLog(Info) << "Playback latency:" << summary;
+}
+
 void Player::IntroPointReached() { NextInternal(Engine::Intro); }
 
 void Player::ValidSongRequested(const QUrl& url) {
@@ -609,18 +707,14 @@ void Player::ValidSongRequested(const QUrl& url) {
 }
 
 void Player::InvalidSongRequested(const QUrl& url) {
+  // Don't hand out the same broken URL again
+  url_resolver_->ForgetMediaUrl(url);
+
   // first send the notification to others...
   emit SongChangeRequestProcessed(url, false);
   // ... and now when our listeners have completed their processing of the
   // current item we can change the current item by skipping to the next song
-  
-  QSettings s;
-  s.beginGroup(kSettingsGroup);
-
-  bool stop_playback = s.value("stop_play_if_fail", 0).toBool();
-  s.endGroup();
-
-  if (!stop_playback) {
+  if (!stop_play_if_fail_) {
     NextItem(Engine::Auto);
   }
 }
@@ -639,7 +733,7 @@ void Player::RegisterUrlHandler(UrlHandler* handler) {
   connect(handler, SIGNAL(destroyed(QObject*)),
           SLOT(UrlHandlerDestroyed(QObject*)));
   connect(handler, SIGNAL(AsyncLoadComplete(UrlHandler::LoadResult)),
-          SLOT(HandleLoadResult(UrlHandler::LoadResult)));
+          url_resolver_, SLOT(HandlerLoadComplete(UrlHandler::LoadResult)));
 }
 
 void Player::UnregisterUrlHandler(UrlHandler* handler) {
@@ -654,8 +748,9 @@ void Player::UnregisterUrlHandler(UrlHandler* handler) {
   url_handlers_.remove(scheme);
   disconnect(handler, SIGNAL(destroyed(QObject*)), this,
              SLOT(UrlHandlerDestroyed(QObject*)));
-  disconnect(handler, SIGNAL(AsyncLoadComplete(UrlHandler::LoadResult)), this,
-             SLOT(HandleLoadResult(UrlHandler::LoadResult)));
+  disconnect(handler, SIGNAL(AsyncLoadComplete(UrlHandler::LoadResult)),
+             url_resolver_, SLOT(HandlerLoadComplete(UrlHandler::LoadResult)));
+  url_resolver_->RemoveHandler(handler, scheme);
 }
 
 const UrlHandler* Player::HandlerForUrl(const QUrl& url) const {
@@ -672,5 +767,6 @@ void Player::UrlHandlerDestroyed(QObject* object) {
   const QString scheme = url_handlers_.key(handler);
   if (!scheme.isEmpty()) {
     url_handlers_.remove(scheme);
+    url_resolver_->RemoveHandler(handler, scheme);
   }
 }
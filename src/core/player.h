@@ -32,6 +32,7 @@
 #include <QDateTime>
 #include <QObject>
 #include <QSettings>
+#include <QTimer>
 
 #include "config.h"
 #include "core/song.h"
@@ -42,6 +43,8 @@
 
 class Application;
 class Scrobbler;
+class SettingsProvider;
+class UrlResolver;
 
 class PlayerInterface : public QObject {
   Q_OBJECT
@@ -188,14 +191,25 @@ class Player : public PlayerInterface {
   void UrlHandlerDestroyed(QObject* object);
   void HandleLoadResult(const UrlHandler::LoadResult& result);
 
+  void PrefetchNextItem();
+  void ResolveUpcomingItems();
+  void LogPlaybackLatency();
+
  private:
   // Returns true if we were supposed to stop after this track.
   bool HandleStopAfter();
+  // Tells the engine about the gains the library worked out for this song.
+  void SetPrecomputedGain(const QUrl& url, const Song& song);
 
  private:
+  static const int kPrefetchDelayMsec;
+  static const int kResolveAheadDelayMsec;
+  static const int kResolveAheadCount;
+
   Application* app_;
   Scrobbler* lastfm_;
-  QSettings settings_;
+  // Written every time the volume changes, so it goes through the cache.
+  std::unique_ptr<SettingsProvider> settings_;
 
   PlaylistItemPtr current_item_;
 
@@ -205,6 +219,7 @@ class Player : public PlayerInterface {
   int nb_errors_received_;
 
   QMap<QString, UrlHandler*> url_handlers_;
+  UrlResolver* url_resolver_;
 
   QUrl loading_async_;
 
@@ -213,6 +228,11 @@ class Player : public PlayerInterface {
   QDateTime last_pressed_previous_;
   PreviousBehaviour menu_previousmode_;
   int seek_step_sec_;
+  bool stop_play_if_fail_;
+
+  QTimer* prefetch_timer_;
+  QTimer* resolve_ahead_timer_;
+  QTimer* latency_log_timer_;
 };
 
 #endif  // CORE_PLAYER_H_
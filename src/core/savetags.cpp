@@ -0,0 +1,107 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "savetags.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QThread>
+
+#include "core/closure.h"
+#include "core/logging.h"
+#include "core/tagreaderclient.h"
+#include "core/taskmanager.h"
+#include "library/librarybackend.h"
+
+SaveTags::SaveTags(TagReaderClient* tag_reader, TaskManager* task_manager,
+                   LibraryBackend* library)
+    : tag_reader_(tag_reader),
+      task_manager_(task_manager),
+      library_(library),
+      next_song_(0),
+      in_flight_(0),
+      max_in_flight_(QThread::idealThreadCount() * 2),
+      finished_(0),
+      task_id_(0) {}
+
+void SaveTags::Start(const SongList& songs) {
+  songs_ = songs;
+
+  if (songs_.isEmpty()) {
+    FinishAll();
+    return;
+  }
+
+  task_id_ = task_manager_->StartTask(tr("Saving tracks"));
+  task_manager_->SetTaskBlocksLibraryScans(task_id_);
+
+  SaveSomeFiles();
+}
+
+void SaveTags::SaveSomeFiles() {
+  while (in_flight_ < max_in_flight_ && next_song_ < songs_.count()) {
+    const Song& song = songs_[next_song_];
+
+    TagReaderReply* reply =
+        tag_reader_->SaveFile(song.url().toLocalFile(), song);
+    NewClosure(reply, SIGNAL(Finished(bool)), this,
+               SLOT(SaveFinished(TagReaderReply*, int)), reply, next_song_);
+
+    next_song_++;
+    in_flight_++;
+  }
+}
+
+void SaveTags::SaveFinished(TagReaderReply* reply, int index) {
+  reply->deleteLater();
+
+  Song song = songs_[index];
+  in_flight_--;
+  finished_++;
+  task_manager_->SetTaskProgress(task_id_, finished_, songs_.count());
+
+  if (!reply->is_successful() ||
+      !reply->message().save_file_response().success()) {
+    qLog(Warning) << "Failed to write tags to" << song.url();
+    songs_with_errors_ << song;
+  } else if (song.is_library_song()) {
+    // The file's new modification time goes with it, so the library watcher
+    // doesn't read the file again the next time it scans this directory.
+    song.set_mtime(
+        QFileInfo(song.url().toLocalFile()).lastModified().toTime_t());
+    saved_library_songs_ << song;
+  }
+
+  if (finished_ == songs_.count()) {
+    FinishAll();
+  } else {
+    SaveSomeFiles();
+  }
+}
+
+void SaveTags::FinishAll() {
+  if (!saved_library_songs_.isEmpty()) {
+    QMetaObject::invokeMethod(library_, "AddOrUpdateSongs",
+                              Qt::QueuedConnection,
+                              Q_ARG(SongList, saved_library_songs_));
+  }
+
+  if (task_id_) task_manager_->SetTaskFinished(task_id_);
+
+  emit Finished(songs_with_errors_);
+  deleteLater();
+}
@@ -0,0 +1,69 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_SAVETAGS_H_
+#define CORE_SAVETAGS_H_
+
+#include <QObject>
+
+#include "song.h"
+#include "tagreaderclient.h"
+
+class LibraryBackend;
+class TaskManager;
+
+// Writes new metadata to a set of files.  The saves are spread across the
+// tag reader's workers, a few more at a time than there are workers so none
+// of them is left waiting, and progress is shown in the task manager.  Once
+// every file has been written the library's copies of the songs are updated
+// together.  Deletes itself when it's finished.
+class SaveTags : public QObject {
+  Q_OBJECT
+
+ public:
+  SaveTags(TagReaderClient* tag_reader, TaskManager* task_manager,
+           LibraryBackend* library);
+
+  void Start(const SongList& songs);
+
+ signals:
+  void Finished(const SongList& songs_with_errors);
+
+ private slots:
+  void SaveFinished(TagReaderReply* reply, int index);
+
+ private:
+  void SaveSomeFiles();
+  void FinishAll();
+
+  TagReaderClient* tag_reader_;
+  TaskManager* task_manager_;
+  LibraryBackend* library_;
+
+  SongList songs_;
+  int next_song_;
+  int in_flight_;
+  int max_in_flight_;
+  int finished_;
+
+  int task_id_;
+
+  SongList saved_library_songs_;
+  SongList songs_with_errors_;
+};
+
+#endif  // CORE_SAVETAGS_H_
@@ -0,0 +1,196 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "settingscache.h"
+
+#include <QSettings>
+#include <QStringList>
+#include <QTimer>
+
+#include "core/logging.h"
+
+const int SettingsCache::kWriteDelayMsec = 1000;
+
+SettingsCache* SettingsCache::sInstance = nullptr;
+
+SettingsCache::SettingsCache(QObject* parent)
+    : QObject(parent), write_timer_(new QTimer(this)) {
+  sInstance = this;
+
+  write_timer_->setSingleShot(true);
+  write_timer_->setInterval(kWriteDelayMsec);
+  connect(write_timer_, SIGNAL(timeout()), SLOT(Sync()));
+
+  QSettings s;
+  for (const QString& key : s.allKeys()) {
+    values_[key] = s.value(key);
+  }
+  qLog(Debug) << "Loaded" << values_.count() << "settings";
+}
+
+SettingsProvider* SettingsCache::CreateProvider() {
+  if (sInstance) return new CachedSettingsProvider;
+  return new DefaultSettingsProvider;
+}
+
+SettingsCache::~SettingsCache() {
+  Sync();
+  if (sInstance == this) sInstance = nullptr;
+}
+
+QVariant SettingsCache::value(const QString& key,
+                              const QVariant& default_value) const {
+  QReadLocker l(&lock_);
+  return values_.value(key, default_value);
+}
+
+void SettingsCache::setValue(const QString& key, const QVariant& value) {
+  SetValue(key, value, true);
+}
+
+void SettingsCache::remove(const QString& key) {
+  SetValue(key, QVariant(), true);
+}
+
+void SettingsCache::SetValue(const QString& key, const QVariant& value,
+                             bool save) {
+  {
+    QWriteLocker l(&lock_);
+    auto it = values_.find(key);
+    if (it == values_.end() ? !value.isValid() : *it == value) return;
+
+    if (value.isValid()) {
+      values_[key] = value;
+    } else {
+      values_.remove(key);
+    }
+
+    if (save) {
+      // Only the first change since the last write starts the timer.  It
+      // belongs to this object's thread, so it's started with a queued call.
+      if (dirty_.isEmpty()) {
+        QMetaObject::invokeMethod(write_timer_, "start", Qt::QueuedConnection);
+      }
+      dirty_.insert(key);
+    }
+  }
+
+  emit ValueChanged(key, value);
+}
+
+void SettingsCache::Sync() {
+  QHash<QString, QVariant> values;
+  {
+    QWriteLocker l(&lock_);
+    for (const QString& key : dirty_) {
+      values[key] = values_.value(key);
+    }
+    dirty_.clear();
+  }
+  if (values.isEmpty()) return;
+
+  QSettings s;
+  for (auto it = values.constBegin(); it != values.constEnd(); ++it) {
+    if (it.value().isValid()) {
+      s.setValue(it.key(), it.value());
+    } else {
+      s.remove(it.key());
+    }
+  }
+}
+
+void SettingsCache::Reload() {
+  Sync();
+
+  QSettings s;
+  const QStringList keys = s.allKeys();
+
+  QSet<QString> removed;
+  {
+    QReadLocker l(&lock_);
+    removed = QSet<QString>::fromList(values_.keys());
+  }
+
+  for (const QString& key : keys) {
+    removed.remove(key);
+    SetValue(key, s.value(key), false);
+  }
+  for (const QString& key : removed) {
+    SetValue(key, QVariant(), false);
+  }
+}
+
+CachedSettingsProvider::CachedSettingsProvider()
+    : cache_(SettingsCache::Instance()),
+      array_index_(-1),
+      array_size_(0),
+      writing_array_(false) {
+  Q_ASSERT(cache_);
+}
+
+void CachedSettingsProvider::set_group(const char* group) { group_ = group; }
+
+QString CachedSettingsProvider::FullKey(const QString& key) const {
+  QString ret = group_.isEmpty() ? QString() : group_ + "/";
+  if (!array_prefix_.isEmpty()) {
+    ret += array_prefix_ + "/";
+    if (array_index_ != -1) ret += QString::number(array_index_ + 1) + "/";
+  }
+  return ret + key;
+}
+
+QVariant CachedSettingsProvider::value(const QString& key,
+                                       const QVariant& default_value) const {
+  return cache_->value(FullKey(key), default_value);
+}
+
+void CachedSettingsProvider::setValue(const QString& key,
+                                      const QVariant& value) {
+  cache_->setValue(FullKey(key), value);
+}
+
+int CachedSettingsProvider::beginReadArray(const QString& prefix) {
+  array_prefix_ = prefix;
+  array_index_ = -1;
+  writing_array_ = false;
+  return value("size", 0).toInt();
+}
+
+void CachedSettingsProvider::beginWriteArray(const QString& prefix, int size) {
+  array_prefix_ = prefix;
+  array_index_ = -1;
+  array_size_ = qMax(0, size);
+  writing_array_ = true;
+}
+
+void CachedSettingsProvider::setArrayIndex(int i) {
+  array_index_ = i;
+  if (writing_array_) array_size_ = qMax(array_size_, i + 1);
+}
+
+void CachedSettingsProvider::endArray() {
+  if (writing_array_) {
+    // Like QSettings, the size is one more than the highest index written
+    array_index_ = -1;
+    setValue("size", array_size_);
+  }
+
+  array_prefix_.clear();
+  array_index_ = -1;
+  array_size_ = 0;
+  writing_array_ = false;
+}
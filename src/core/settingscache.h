@@ -0,0 +1,111 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_SETTINGSCACHE_H_
+#define CORE_SETTINGSCACHE_H_
+
+#include <QHash>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QVariant>
+
+#include "core/settingsprovider.h"
+
+class QTimer;
+
+class SettingsCache : public QObject {
+  // Every setting, read from QSettings once and then kept in memory, so code
+  // that reads settings often doesn't pay for QSettings' locking and file
+  // checks (or the registry on Windows) each time.  Values written here are
+  // saved to QSettings kWriteDelayMsec later, several at a time.
+  //
+  // Code that still writes to QSettings directly should be followed by
+  // Application::ReloadSettings, which makes the cache read everything again.
+  //
+  // Keys are full QSettings keys, like "Player/stop_play_if_fail".  Thread
+  // safe.
+
+  Q_OBJECT
+
+ public:
+  explicit SettingsCache(QObject* parent = nullptr);
+  ~SettingsCache();
+
+  static const int kWriteDelayMsec;
+
+  static SettingsCache* Instance() { return sInstance; }
+  // A CachedSettingsProvider, or a DefaultSettingsProvider if there's no
+  // cache, like in the tests.
+  static SettingsProvider* CreateProvider();
+
+  QVariant value(const QString& key,
+                 const QVariant& default_value = QVariant()) const;
+  void setValue(const QString& key, const QVariant& value);
+  void remove(const QString& key);
+
+ public slots:
+  // Writes the changed values to QSettings now.
+  void Sync();
+  // Saves any changed values, then reads everything from QSettings again.
+  void Reload();
+
+ signals:
+  // Emitted whenever a value is set, or changes when the cache is reloaded.
+  void ValueChanged(const QString& key, const QVariant& value);
+
+ private:
+  void SetValue(const QString& key, const QVariant& value, bool save);
+
+  static SettingsCache* sInstance;
+
+  mutable QReadWriteLock lock_;
+  QHash<QString, QVariant> values_;
+  QSet<QString> dirty_;
+
+  QTimer* write_timer_;
+};
+
+class CachedSettingsProvider : public SettingsProvider {
+  // A SettingsProvider that reads and writes the SettingsCache.
+
+ public:
+  CachedSettingsProvider();
+
+  void set_group(const char* group);
+
+  QVariant value(const QString& key,
+                 const QVariant& default_value = QVariant()) const;
+  void setValue(const QString& key, const QVariant& value);
+  int beginReadArray(const QString& prefix);
+  void beginWriteArray(const QString& prefix, int size = -1);
+  void setArrayIndex(int i);
+  void endArray();
+
+ private:
+  QString FullKey(const QString& key) const;
+
+  SettingsCache* cache_;
+  QString group_;
+
+  QString array_prefix_;
+  int array_index_;
+  int array_size_;
+  bool writing_array_;
+};
+
+#endif  // CORE_SETTINGSCACHE_H_
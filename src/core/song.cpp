@@ -29,18 +29,22 @@
 #include "song.h"
 
 #include <algorithm>
+#include <utility>
 
+#include <QAtomicInt>
 #include <QCoreApplication>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
 #include <QLatin1Literal>
+#include <QMutex>
+#include <QSet>
 #include <QSharedData>
-#include <QSqlQuery>
 #include <QTextCodec>
 #include <QTime>
 #include <QVariant>
 #include <QtConcurrentRun>
+#include <qnumeric.h>
 
 #ifdef HAVE_LIBLASTFM
 #include "internet/lastfm/fixlastfm.h"
@@ -67,10 +71,12 @@
 #include "core/messagehandler.h"
 #include "core/mpris_common.h"
 #include "core/timeconstants.h"
+#include "core/urlkey.h"
 #include "core/utilities.h"
 #include "covers/albumcoverloader.h"
 #include "engines/enginebase.h"
 #include "gmereader.h"
+#include "library/sqlitequery.h"
 #include "library/sqlrow.h"
 #include "tagreadermessages.pb.h"
 #include "widgets/trackslider.h"
@@ -116,7 +122,12 @@ const QStringList Song::kColumns = QStringList() << "title"
                                                  << "grouping"
                                                  << "lyrics"
                                                  << "originalyear"
-                                                 << "effective_originalyear";
+                                                 << "effective_originalyear"
+                                                 << "replaygain_track_gain"
+                                                 << "replaygain_album_gain"
+                                                 << "sortartist"
+                                                 << "sortalbumartist"
+                                                 << "sortalbum";
 
 const QString Song::kColumnSpec = Song::kColumns.join(", ");
 const QString Song::kBindSpec =
@@ -124,6 +135,76 @@ const QString Song::kBindSpec =
 const QString Song::kUpdateSpec =
     Utilities::Updateify(Song::kColumns).join(", ");
 
+namespace {
+
+// Replaces the columns of kColumns that aren't in columns with NULL, keeping
+// the rest where they are.
+QString ProjectedColumnSpec(const QStringList& columns) {
+  QStringList ret;
+  for (const QString& column : Song::kColumns) {
+    ret << (columns.contains(column) ? column : "NULL");
+  }
+  return ret.join(", ");
+}
+
+const QString kTreeNodeColumnSpec = ProjectedColumnSpec(
+    QStringList() << "title"
+                  << "album"
+                  << "artist"
+                  << "albumartist"
+                  << "track"
+                  << "disc"
+                  << "compilation"
+                  << "directory"
+                  << "filename"
+                  << "sampler"
+                  << "art_automatic"
+                  << "art_manual"
+                  << "filetype"
+                  << "forced_compilation_on"
+                  << "forced_compilation_off"
+                  << "effective_compilation"
+                  << "beginning"
+                  << "length"
+                  << "cue_path"
+                  << "unavailable");
+
+const QString kSearchResultColumnSpec = ProjectedColumnSpec(
+    QStringList() << "title"
+                  << "album"
+                  << "artist"
+                  << "albumartist"
+                  << "composer"
+                  << "track"
+                  << "disc"
+                  << "bpm"
+                  << "year"
+                  << "genre"
+                  << "comment"
+                  << "compilation"
+                  << "bitrate"
+                  << "samplerate"
+                  << "directory"
+                  << "filename"
+                  << "sampler"
+                  << "art_automatic"
+                  << "art_manual"
+                  << "filetype"
+                  << "forced_compilation_on"
+                  << "forced_compilation_off"
+                  << "effective_compilation"
+                  << "beginning"
+                  << "length"
+                  << "cue_path"
+                  << "unavailable"
+                  << "effective_albumartist"
+                  << "performer"
+                  << "grouping"
+                  << "originalyear"
+                  << "effective_originalyear");
+
+}  // namespace
+
 const QStringList Song::kFtsColumns = QStringList() << "ftstitle"
                                                     << "ftsalbum"
                                                     << "ftsartist"
@@ -144,31 +225,76 @@ const QString Song::kFtsUpdateSpec =
 const QString Song::kManuallyUnsetCover = "(unset)";
 const QString Song::kEmbeddedCover = "(embedded)";
 
+namespace {
+
+// Artist, album and genre names are repeated across lots of songs, so songs
+// share one copy of each string from this pool instead of keeping their own.
+class StringPool {
+ public:
+  StringPool() : purge_size_(kMinPurgeSize) {}
+
+  QString Intern(const QString& str);
+
+ private:
+  static const int kMinPurgeSize;
+
+  QMutex mutex_;
+  QSet<QString> strings_;
+  int purge_size_;
+};
+
+const int StringPool::kMinPurgeSize = 1024;
+
+QString StringPool::Intern(const QString& str) {
+  if (str.isEmpty()) return str;
+
+  QMutexLocker l(&mutex_);
+
+  QSet<QString>::const_iterator it = strings_.constFind(str);
+  if (it != strings_.constEnd()) return *it;
+
+  if (strings_.count() >= purge_size_) {
+    // Forget the strings that nothing but the pool is using any more.
+    QSet<QString>::iterator it = strings_.begin();
+    while (it != strings_.end()) {
+      if (it->isDetached())
+        it = strings_.erase(it);
+      else
+        ++it;
+    }
+    purge_size_ = qMax(kMinPurgeSize, strings_.count() * 2);
+  }
+
+  strings_.insert(str);
+  return str;
+}
+
+QString Intern(const QString& str) {
+  static StringPool pool;
+  return pool.Intern(str);
+}
+
+// Counts live Song::Private instances, including the ones made by detaching.
+QAtomicInt sLiveDataCount;
+
+struct LiveDataCounter {
+  LiveDataCounter() { sLiveDataCount.ref(); }
+  LiveDataCounter(const LiveDataCounter&) { sLiveDataCount.ref(); }
+  ~LiveDataCounter() { sLiveDataCount.deref(); }
+};
+
+}  // namespace
+
+// Fields are grouped by size so the compiler doesn't have to pad between
+// them.
 struct Song::Private : public QSharedData {
   Private();
 
-  bool valid_;
   int id_;
-
-  QString title_;
-  QString album_;
-  QString artist_;
-  QString albumartist_;
-  QString composer_;
-  QString performer_;
-  QString grouping_;
-  QString lyrics_;
   int track_;
   int disc_;
-  float bpm_;
   int year_;
   int originalyear_;
-  QString genre_;
-  QString comment_;
-  bool compilation_;             // From the file tag
-  bool sampler_;                 // From the library scanner
-  bool forced_compilation_on_;   // Set by the user
-  bool forced_compilation_off_;  // Set by the user
 
   // A unique album ID
   // Used to distinguish between albums from providers that have multiple
@@ -177,12 +303,43 @@ struct Song::Private : public QSharedData {
   // results.
   int album_id_;
 
+  float bpm_;
   float rating_;
+  float replaygain_track_gain_;
+  float replaygain_album_gain_;
   int playcount_;
   int skipcount_;
   int lastplayed_;
   int score_;
 
+  int bitrate_;
+  int samplerate_;
+
+  int directory_id_;
+  int mtime_;
+  int ctime_;
+  int filesize_;
+  FileType filetype_;
+
+  bool valid_;
+  bool compilation_;             // From the file tag
+  bool sampler_;                 // From the library scanner
+  bool forced_compilation_on_;   // Set by the user
+  bool forced_compilation_off_;  // Set by the user
+
+  // Whether this song was loaded from a file using taglib.
+  bool init_from_file_;
+  // Whether our encoding guesser thinks these tags might be incorrectly
+  // encoded.
+  bool suspicious_tags_;
+
+  // Whether the song does not exist on the file system anymore, but is still
+  // stored in the database so as to remember the user's metadata.
+  bool unavailable_;
+
+  // Whether this was read with a partial Projection.
+  bool partial_;
+
   // The beginning of the song in seconds. In case of single-part media
   // streams, this will equal to 0. In case of multi-part streams on the
   // other hand, this will mark the beginning of a section represented by
@@ -196,16 +353,22 @@ struct Song::Private : public QSharedData {
   // unknown.
   qint64 end_;
 
-  int bitrate_;
-  int samplerate_;
+  QString title_;
+  // These are shared through Intern()
+  QString album_;
+  QString artist_;
+  QString albumartist_;
+  QString composer_;
+  QString performer_;
+  QString grouping_;
+  QString genre_;
+
+  QString lyrics_;
+  QString comment_;
 
-  int directory_id_;
   QUrl url_;
+  UrlKey url_key_;
   QString basefilename_;
-  int mtime_;
-  int ctime_;
-  int filesize_;
-  FileType filetype_;
 
   // If the song has a CUE, this contains it's path.
   QString cue_path_;
@@ -216,39 +379,26 @@ struct Song::Private : public QSharedData {
 
   QImage image_;
 
-  // Whether this song was loaded from a file using taglib.
-  bool init_from_file_;
-  // Whether our encoding guesser thinks these tags might be incorrectly
-  // encoded.
-  bool suspicious_tags_;
-
-  // Whether the song does not exist on the file system anymore, but is still
-  // stored in the database so as to remember the user's metadata.
-  bool unavailable_;
-
   QString etag_;
+
+  LiveDataCounter counter_;
 };
 
 Song::Private::Private()
-    : valid_(false),
-      id_(-1),
+    : id_(-1),
       track_(-1),
       disc_(-1),
-      bpm_(-1),
       year_(-1),
       originalyear_(-1),
-      compilation_(false),
-      sampler_(false),
-      forced_compilation_on_(false),
-      forced_compilation_off_(false),
       album_id_(-1),
+      bpm_(-1),
       rating_(-1.0),
+      replaygain_track_gain_(qQNaN()),
+      replaygain_album_gain_(qQNaN()),
       playcount_(0),
       skipcount_(0),
       lastplayed_(-1),
       score_(0),
-      beginning_(0),
-      end_(-1),
       bitrate_(-1),
       samplerate_(-1),
       directory_id_(-1),
@@ -256,14 +406,24 @@ Song::Private::Private()
       ctime_(-1),
       filesize_(-1),
       filetype_(Type_Unknown),
+      valid_(false),
+      compilation_(false),
+      sampler_(false),
+      forced_compilation_on_(false),
+      forced_compilation_off_(false),
       init_from_file_(false),
       suspicious_tags_(false),
-      unavailable_(false) {}
+      unavailable_(false),
+      partial_(false),
+      beginning_(0),
+      end_(-1) {}
 
 Song::Song() : d(new Private) {}
 
 Song::Song(const Song& other) : d(other.d) {}
 
+Song::Song(Song&& other) : d(std::move(other.d)) {}
+
 Song::~Song() {}
 
 Song& Song::operator=(const Song& other) {
@@ -271,8 +431,14 @@ Song& Song::operator=(const Song& other) {
   return *this;
 }
 
+Song& Song::operator=(Song&& other) {
+  d = std::move(other.d);
+  return *this;
+}
+
 bool Song::is_valid() const { return d->valid_; }
 bool Song::is_unavailable() const { return d->unavailable_; }
+bool Song::is_partial() const { return d->partial_; }
 int Song::id() const { return d->id_; }
 const QString& Song::title() const { return d->title_; }
 const QString& Song::album() const { return d->album_; }
@@ -314,6 +480,15 @@ int Song::score() const { return d->score_; }
 const QString& Song::cue_path() const { return d->cue_path_; }
 bool Song::has_cue() const { return !d->cue_path_.isEmpty(); }
 int Song::album_id() const { return d->album_id_; }
+float Song::replaygain_track_gain() const {
+  return d->replaygain_track_gain_;
+}
+float Song::replaygain_album_gain() const {
+  return d->replaygain_album_gain_;
+}
+bool Song::has_replaygain() const {
+  return !qIsNaN(d->replaygain_track_gain_);
+}
 qint64 Song::beginning_nanosec() const { return d->beginning_; }
 qint64 Song::end_nanosec() const { return d->end_; }
 qint64 Song::length_nanosec() const { return d->end_ - d->beginning_; }
@@ -321,6 +496,7 @@ int Song::bitrate() const { return d->bitrate_; }
 int Song::samplerate() const { return d->samplerate_; }
 int Song::directory_id() const { return d->directory_id_; }
 const QUrl& Song::url() const { return d->url_; }
+const UrlKey& Song::url_key() const { return d->url_key_; }
 const QString& Song::basefilename() const { return d->basefilename_; }
 uint Song::mtime() const { return d->mtime_; }
 uint Song::ctime() const { return d->ctime_; }
@@ -346,19 +522,19 @@ const QImage& Song::image() const { return d->image_; }
 void Song::set_id(int id) { d->id_ = id; }
 void Song::set_valid(bool v) { d->valid_ = v; }
 void Song::set_title(const QString& v) { d->title_ = v; }
-void Song::set_album(const QString& v) { d->album_ = v; }
-void Song::set_artist(const QString& v) { d->artist_ = v; }
-void Song::set_albumartist(const QString& v) { d->albumartist_ = v; }
-void Song::set_composer(const QString& v) { d->composer_ = v; }
-void Song::set_performer(const QString& v) { d->performer_ = v; }
-void Song::set_grouping(const QString& v) { d->grouping_ = v; }
+void Song::set_album(const QString& v) { d->album_ = Intern(v); }
+void Song::set_artist(const QString& v) { d->artist_ = Intern(v); }
+void Song::set_albumartist(const QString& v) { d->albumartist_ = Intern(v); }
+void Song::set_composer(const QString& v) { d->composer_ = Intern(v); }
+void Song::set_performer(const QString& v) { d->performer_ = Intern(v); }
+void Song::set_grouping(const QString& v) { d->grouping_ = Intern(v); }
 void Song::set_lyrics(const QString& v) { d->lyrics_ = v; }
 void Song::set_track(int v) { d->track_ = v; }
 void Song::set_disc(int v) { d->disc_ = v; }
 void Song::set_bpm(float v) { d->bpm_ = v; }
 void Song::set_year(int v) { d->year_ = v; }
 void Song::set_originalyear(int v) { d->originalyear_ = v; }
-void Song::set_genre(const QString& v) { d->genre_ = v; }
+void Song::set_genre(const QString& v) { d->genre_ = Intern(v); }
 void Song::set_comment(const QString& v) { d->comment_ = v; }
 void Song::set_compilation(bool v) { d->compilation_ = v; }
 void Song::set_sampler(bool v) { d->sampler_ = v; }
@@ -384,6 +560,12 @@ void Song::set_playcount(int v) { d->playcount_ = v; }
 void Song::set_skipcount(int v) { d->skipcount_ = v; }
 void Song::set_lastplayed(int v) { d->lastplayed_ = v; }
 void Song::set_score(int v) { d->score_ = qBound(0, v, 100); }
+void Song::set_replaygain_track_gain(float v) {
+  d->replaygain_track_gain_ = v;
+}
+void Song::set_replaygain_album_gain(float v) {
+  d->replaygain_album_gain_ = v;
+}
 void Song::set_cue_path(const QString& v) { d->cue_path_ = v; }
 void Song::set_unavailable(bool v) { d->unavailable_ = v; }
 void Song::set_etag(const QString& etag) { d->etag_ = etag; }
@@ -396,6 +578,7 @@ void Song::set_url(const QUrl& v) {
   } else {
     d->url_ = v;
   }
+  d->url_key_ = UrlKey(d->url_);
 }
 
 void Song::set_basefilename(const QString& v) { d->basefilename_ = v; }
@@ -405,6 +588,18 @@ QString Song::JoinSpec(const QString& table) {
   return Utilities::Prepend(table + ".", kColumns).join(", ");
 }
 
+QString Song::ColumnSpec(Projection projection) {
+  switch (projection) {
+    case Projection_TreeNode:
+      return kTreeNodeColumnSpec;
+    case Projection_SearchResult:
+      return kSearchResultColumnSpec;
+    case Projection_Full:
+      break;
+  }
+  return kColumnSpec;
+}
+
 QString Song::TextForFiletype(FileType type) {
   switch (type) {
     case Song::Type_Asf:
@@ -472,6 +667,38 @@ void Song::SortSongsListAlphabetically(SongList* songs) {
   qSort(songs->begin(), songs->end(), CompareSongsName);
 }
 
+int Song::live_data_count() { return sLiveDataCount.fetchAndAddRelaxed(0); }
+
+int Song::data_size() { return sizeof(Private); }
+
+QString Song::SortText(QString text) {
+  if (text.isEmpty()) return " unknown";
+
+  // Keep the same characters as [\w ] without building a QRegExp each time.
+  text = text.toLower();
+  QString ret;
+  ret.reserve(text.length());
+  for (const QChar& c : text) {
+    if (c.isLetterOrNumber() || c.isMark() || c == '_' || c == ' ') ret += c;
+  }
+
+  return ret;
+}
+
+QString Song::SortTextForArtist(QString artist) {
+  artist = SortText(artist);
+
+  if (artist.startsWith("the ")) {
+    artist = artist.right(artist.length() - 4) + ", the";
+  } else if (artist.startsWith("a ")) {
+    artist = artist.right(artist.length() - 2) + ", a";
+  } else if (artist.startsWith("an ")) {
+    artist = artist.right(artist.length() - 3) + ", an";
+  }
+
+  return artist;
+}
+
 void Song::Init(const QString& title, const QString& artist,
                 const QString& album, qint64 length_nanosec) {
   d->valid_ = true;
@@ -511,19 +738,19 @@ void Song::InitFromProtobuf(const pb::tagreader::SongMetadata& pb) {
   d->init_from_file_ = true;
   d->valid_ = pb.valid();
   d->title_ = QStringFromStdString(pb.title());
-  d->album_ = QStringFromStdString(pb.album());
-  d->artist_ = QStringFromStdString(pb.artist());
-  d->albumartist_ = QStringFromStdString(pb.albumartist());
-  d->composer_ = QStringFromStdString(pb.composer());
-  d->performer_ = QStringFromStdString(pb.performer());
-  d->grouping_ = QStringFromStdString(pb.grouping());
+  d->album_ = Intern(QStringFromStdString(pb.album()));
+  d->artist_ = Intern(QStringFromStdString(pb.artist()));
+  d->albumartist_ = Intern(QStringFromStdString(pb.albumartist()));
+  d->composer_ = Intern(QStringFromStdString(pb.composer()));
+  d->performer_ = Intern(QStringFromStdString(pb.performer()));
+  d->grouping_ = Intern(QStringFromStdString(pb.grouping()));
   d->lyrics_ = QStringFromStdString(pb.lyrics());
   d->track_ = pb.track();
   d->disc_ = pb.disc();
   d->bpm_ = pb.bpm();
   d->year_ = pb.year();
   d->originalyear_ = pb.originalyear();
-  d->genre_ = QStringFromStdString(pb.genre());
+  d->genre_ = Intern(QStringFromStdString(pb.genre()));
   d->comment_ = QStringFromStdString(pb.comment());
   d->compilation_ = pb.compilation();
   d->skipcount_ = pb.skipcount();
@@ -557,7 +784,7 @@ void Song::InitFromProtobuf(const pb::tagreader::SongMetadata& pb) {
 }
 
 void Song::ToProtobuf(pb::tagreader::SongMetadata* pb) const {
-  const QByteArray url(d->url_.toEncoded());
+  const QByteArray& url = d->url_key_.encoded();
 
   pb->set_valid(d->valid_);
   pb->set_title(DataCommaSizeFromQString(d->title_));
@@ -594,7 +821,17 @@ void Song::ToProtobuf(pb::tagreader::SongMetadata* pb) const {
   pb->set_type(static_cast<pb::tagreader::SongMetadata_Type>(d->filetype_));
 }
 
+void Song::InitFromQuery(const SqlRow& q, Projection projection, int col) {
+  InitFromQuery(q, true, col);
+  d->partial_ = projection != Projection_Full;
+}
+
 void Song::InitFromQuery(const SqlRow& q, bool reliable_metadata, int col) {
+  if (q.query()) {
+    InitFromSqliteQuery(*q.query(), reliable_metadata, col);
+    return;
+  }
+
   d->valid_ = true;
   d->init_from_file_ = reliable_metadata;
 
@@ -605,16 +842,16 @@ void Song::InitFromQuery(const SqlRow& q, bool reliable_metadata, int col) {
 
   d->id_ = toint(col + 0);
   d->title_ = tostr(col + 1);
-  d->album_ = tostr(col + 2);
-  d->artist_ = tostr(col + 3);
-  d->albumartist_ = tostr(col + 4);
-  d->composer_ = tostr(col + 5);
+  d->album_ = Intern(tostr(col + 2));
+  d->artist_ = Intern(tostr(col + 3));
+  d->albumartist_ = Intern(tostr(col + 4));
+  d->composer_ = Intern(tostr(col + 5));
   d->track_ = toint(col + 6);
   d->disc_ = toint(col + 7);
   d->bpm_ = tofloat(col + 8);
   d->year_ = toint(col + 9);
   d->originalyear_ = toint(col + 41);
-  d->genre_ = tostr(col + 10);
+  d->genre_ = Intern(tostr(col + 10));
   d->comment_ = tostr(col + 11);
   d->compilation_ = q.value(col + 12).toBool();
 
@@ -658,10 +895,99 @@ void Song::InitFromQuery(const SqlRow& q, bool reliable_metadata, int col) {
   // effective_albumartist = 36
   // etag = 37
 
-  d->performer_ = tostr(col + 38);
-  d->grouping_ = tostr(col + 39);
+  d->performer_ = Intern(tostr(col + 38));
+  d->grouping_ = Intern(tostr(col + 39));
+  d->lyrics_ = tostr(col + 40);
+
+  // originalyear = 41
+  // effective_originalyear = 42
+
+  d->replaygain_track_gain_ =
+      q.value(col + 43).isNull() ? qQNaN() : q.value(col + 43).toFloat();
+  d->replaygain_album_gain_ =
+      q.value(col + 44).isNull() ? qQNaN() : q.value(col + 44).toFloat();
+
+  // sortartist = 45
+  // sortalbumartist = 46
+  // sortalbum = 47
+
+  InitArtManual();
+
+#undef tostr
+#undef toint
+#undef tolonglong
+#undef tofloat
+}
+
+void Song::InitFromSqliteQuery(const SqliteQuery& q, bool reliable_metadata,
+                               int col) {
+  // The same as InitFromQuery, but without converting through QVariant.
+  d->valid_ = true;
+  d->init_from_file_ = reliable_metadata;
+
+#define tostr(n) (q.IsNull(n) ? QString::null : q.String(n))
+#define toint(n) (q.IsNull(n) ? -1 : q.Int(n))
+#define tolonglong(n) (q.IsNull(n) ? -1 : q.LongLong(n))
+#define tofloat(n) (q.IsNull(n) ? -1 : q.Double(n))
+
+  d->id_ = toint(col + 0);
+  d->title_ = tostr(col + 1);
+  d->album_ = Intern(tostr(col + 2));
+  d->artist_ = Intern(tostr(col + 3));
+  d->albumartist_ = Intern(tostr(col + 4));
+  d->composer_ = Intern(tostr(col + 5));
+  d->track_ = toint(col + 6);
+  d->disc_ = toint(col + 7);
+  d->bpm_ = tofloat(col + 8);
+  d->year_ = toint(col + 9);
+  d->originalyear_ = toint(col + 41);
+  d->genre_ = Intern(tostr(col + 10));
+  d->comment_ = tostr(col + 11);
+  d->compilation_ = q.Int(col + 12);
+
+  d->bitrate_ = toint(col + 13);
+  d->samplerate_ = toint(col + 14);
+
+  d->directory_id_ = toint(col + 15);
+  set_url(QUrl::fromEncoded(tostr(col + 16).toUtf8()));
+  d->basefilename_ = QFileInfo(d->url_.toLocalFile()).fileName();
+  d->mtime_ = toint(col + 17);
+  d->ctime_ = toint(col + 18);
+  d->filesize_ = toint(col + 19);
+
+  d->sampler_ = q.Int(col + 20);
+
+  d->art_automatic_ = q.String(col + 21);
+  d->art_manual_ = q.String(col + 22);
+
+  d->filetype_ = FileType(q.Int(col + 23));
+  d->playcount_ = q.Int(col + 24);
+  d->lastplayed_ = toint(col + 25);
+  d->rating_ = tofloat(col + 26);
+
+  d->forced_compilation_on_ = q.Int(col + 27);
+  d->forced_compilation_off_ = q.Int(col + 28);
+
+  d->skipcount_ = q.Int(col + 30);
+  d->score_ = q.Int(col + 31);
+
+  // do not move those statements - beginning must be initialized before
+  // length is!
+  d->beginning_ = q.LongLong(col + 32);
+  set_length_nanosec(tolonglong(col + 33));
+
+  d->cue_path_ = tostr(col + 34);
+  d->unavailable_ = q.Int(col + 35);
+
+  d->performer_ = Intern(tostr(col + 38));
+  d->grouping_ = Intern(tostr(col + 39));
   d->lyrics_ = tostr(col + 40);
 
+  d->replaygain_track_gain_ =
+      q.IsNull(col + 43) ? qQNaN() : float(q.Double(col + 43));
+  d->replaygain_album_gain_ =
+      q.IsNull(col + 44) ? qQNaN() : float(q.Double(col + 44));
+
   InitArtManual();
 
 #undef tostr
@@ -793,6 +1119,7 @@ void Song::InitFromMTP(const LIBMTP_track_t* track, const QString& host) {
   d->composer_ = QString::fromUtf8(track->composer);
   d->genre_ = QString::fromUtf8(track->genre);
   d->url_ = QUrl(QString("mtp://%1/%2").arg(host, track->item_id));
+  d->url_key_ = UrlKey(d->url_);
   d->basefilename_ = QString::number(track->item_id);
 
   d->track_ = track->tracknumber;
@@ -916,94 +1243,102 @@ void Song::MergeFromSimpleMetaBundle(const Engine::SimpleMetaBundle& bundle) {
   if (!bundle.tracknr.isEmpty()) d->track_ = bundle.tracknr.toInt();
 }
 
-void Song::BindToQuery(QSqlQuery* query) const {
+void Song::BindToQuery(SqliteQuery* query) const {
 #define strval(x) (x.isNull() ? "" : x)
 #define intval(x) (x <= 0 ? -1 : x)
 #define notnullintval(x) (x == -1 ? QVariant() : x)
 
-  // Remember to bind these in the same order as kBindSpec
+  // Remember to bind these in the same order as kColumns
 
-  query->bindValue(":title", strval(d->title_));
-  query->bindValue(":album", strval(d->album_));
-  query->bindValue(":artist", strval(d->artist_));
-  query->bindValue(":albumartist", strval(d->albumartist_));
-  query->bindValue(":composer", strval(d->composer_));
-  query->bindValue(":track", intval(d->track_));
-  query->bindValue(":disc", intval(d->disc_));
-  query->bindValue(":bpm", intval(d->bpm_));
-  query->bindValue(":year", intval(d->year_));
-  query->bindValue(":genre", strval(d->genre_));
-  query->bindValue(":comment", strval(d->comment_));
-  query->bindValue(":compilation", d->compilation_ ? 1 : 0);
+  query->AddBindValue(strval(d->title_));
+  query->AddBindValue(strval(d->album_));
+  query->AddBindValue(strval(d->artist_));
+  query->AddBindValue(strval(d->albumartist_));
+  query->AddBindValue(strval(d->composer_));
+  query->AddBindValue(intval(d->track_));
+  query->AddBindValue(intval(d->disc_));
+  query->AddBindValue(intval(d->bpm_));
+  query->AddBindValue(intval(d->year_));
+  query->AddBindValue(strval(d->genre_));
+  query->AddBindValue(strval(d->comment_));
+  query->AddBindValue(d->compilation_ ? 1 : 0);
 
-  query->bindValue(":bitrate", intval(d->bitrate_));
-  query->bindValue(":samplerate", intval(d->samplerate_));
+  query->AddBindValue(intval(d->bitrate_));
+  query->AddBindValue(intval(d->samplerate_));
 
-  query->bindValue(":directory", notnullintval(d->directory_id_));
+  query->AddBindValue(notnullintval(d->directory_id_));
 
   if (Application::kIsPortable &&
       Utilities::UrlOnSameDriveAsClementine(d->url_)) {
-    query->bindValue(
-        ":filename",
+    query->AddBindValue(
         Utilities::GetRelativePathToClementineBin(d->url_).toEncoded());
   } else {
-    query->bindValue(":filename", d->url_.toEncoded());
+    query->AddBindValue(d->url_key_.encoded());
   }
 
-  query->bindValue(":mtime", notnullintval(d->mtime_));
-  query->bindValue(":ctime", notnullintval(d->ctime_));
-  query->bindValue(":filesize", notnullintval(d->filesize_));
+  query->AddBindValue(notnullintval(d->mtime_));
+  query->AddBindValue(notnullintval(d->ctime_));
+  query->AddBindValue(notnullintval(d->filesize_));
+
+  query->AddBindValue(d->sampler_ ? 1 : 0);
+  query->AddBindValue(d->art_automatic_);
+  query->AddBindValue(d->art_manual_);
+
+  query->AddBindValue(d->filetype_);
+  query->AddBindValue(d->playcount_);
+  query->AddBindValue(intval(d->lastplayed_));
+  query->AddBindValue(intval(d->rating_));
 
-  query->bindValue(":sampler", d->sampler_ ? 1 : 0);
-  query->bindValue(":art_automatic", d->art_automatic_);
-  query->bindValue(":art_manual", d->art_manual_);
+  query->AddBindValue(d->forced_compilation_on_ ? 1 : 0);
+  query->AddBindValue(d->forced_compilation_off_ ? 1 : 0);
 
-  query->bindValue(":filetype", d->filetype_);
-  query->bindValue(":playcount", d->playcount_);
-  query->bindValue(":lastplayed", intval(d->lastplayed_));
-  query->bindValue(":rating", intval(d->rating_));
+  query->AddBindValue(is_compilation() ? 1 : 0);
 
-  query->bindValue(":forced_compilation_on", d->forced_compilation_on_ ? 1 : 0);
-  query->bindValue(":forced_compilation_off",
-                   d->forced_compilation_off_ ? 1 : 0);
+  query->AddBindValue(d->skipcount_);
+  query->AddBindValue(d->score_);
 
-  query->bindValue(":effective_compilation", is_compilation() ? 1 : 0);
+  query->AddBindValue(d->beginning_);
+  query->AddBindValue(intval(length_nanosec()));
 
-  query->bindValue(":skipcount", d->skipcount_);
-  query->bindValue(":score", d->score_);
+  query->AddBindValue(d->cue_path_);
+  query->AddBindValue(d->unavailable_ ? 1 : 0);
+  query->AddBindValue(this->effective_albumartist());
 
-  query->bindValue(":beginning", d->beginning_);
-  query->bindValue(":length", intval(length_nanosec()));
+  query->AddBindValue(strval(d->etag_));
 
-  query->bindValue(":cue_path", d->cue_path_);
-  query->bindValue(":unavailable", d->unavailable_ ? 1 : 0);
-  query->bindValue(":effective_albumartist", this->effective_albumartist());
+  query->AddBindValue(strval(d->performer_));
+  query->AddBindValue(strval(d->grouping_));
+  query->AddBindValue(strval(d->lyrics_));
+  query->AddBindValue(intval(d->originalyear_));
+  query->AddBindValue(intval(this->effective_originalyear()));
 
-  query->bindValue(":etag", strval(d->etag_));
+  query->AddBindValue(qIsNaN(d->replaygain_track_gain_)
+                          ? QVariant()
+                          : QVariant(double(d->replaygain_track_gain_)));
+  query->AddBindValue(qIsNaN(d->replaygain_album_gain_)
+                          ? QVariant()
+                          : QVariant(double(d->replaygain_album_gain_)));
 
-  query->bindValue(":performer", strval(d->performer_));
-  query->bindValue(":grouping", strval(d->grouping_));
-  query->bindValue(":lyrics", strval(d->lyrics_));
-  query->bindValue(":originalyear", intval(d->originalyear_));
-  query->bindValue(":effective_originalyear",
-                   intval(this->effective_originalyear()));
+  query->AddBindValue(SortTextForArtist(d->artist_));
+  query->AddBindValue(SortTextForArtist(this->effective_albumartist()));
+  query->AddBindValue(SortTextForArtist(d->album_));
 
 #undef intval
 #undef notnullintval
 #undef strval
 }
 
-void Song::BindToFtsQuery(QSqlQuery* query) const {
-  query->bindValue(":ftstitle", d->title_);
-  query->bindValue(":ftsalbum", d->album_);
-  query->bindValue(":ftsartist", d->artist_);
-  query->bindValue(":ftsalbumartist", d->albumartist_);
-  query->bindValue(":ftscomposer", d->composer_);
-  query->bindValue(":ftsperformer", d->performer_);
-  query->bindValue(":ftsgrouping", d->grouping_);
-  query->bindValue(":ftsgenre", d->genre_);
-  query->bindValue(":ftscomment", d->comment_);
-  query->bindValue(":ftsyear", d->year_);
+void Song::BindToFtsQuery(SqliteQuery* query) const {
+  query->AddBindValue(d->title_);
+  query->AddBindValue(d->album_);
+  query->AddBindValue(d->artist_);
+  query->AddBindValue(d->albumartist_);
+  query->AddBindValue(d->composer_);
+  query->AddBindValue(d->performer_);
+  query->AddBindValue(d->grouping_);
+  query->AddBindValue(d->genre_);
+  query->AddBindValue(d->comment_);
+  query->AddBindValue(d->year_);
 }
 
 #ifdef HAVE_LIBLASTFM
@@ -1109,13 +1444,13 @@ bool Song::IsEditable() const {
 
 bool Song::operator==(const Song& other) const {
   // TODO(Paweł Bara): this isn't working for radios
-  return url() == other.url() &&
+  return url_key() == other.url_key() &&
          beginning_nanosec() == other.beginning_nanosec();
 }
 
 uint qHash(const Song& song) {
   // Should compare the same fields as operator==
-  return qHash(song.url().toString()) ^ qHash(song.beginning_nanosec());
+  return qHash(song.url_key()) ^ qHash(song.beginning_nanosec());
 }
 
 bool Song::IsSimilar(const Song& other) const {
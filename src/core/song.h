@@ -43,8 +43,8 @@ class SongMetadata;
 }  // namespace tagreader
 }  // namespace pb
 
-class QSqlQuery;
 class QUrl;
+class UrlKey;
 
 #ifdef HAVE_LIBGPOD
 struct _Itdb_Track;
@@ -61,11 +61,15 @@ class Track;
 #endif
 
 class SqlRow;
+class SqliteQuery;
 
 class Song {
  public:
   Song();
   Song(const Song& other);
+  // Takes over the other song's data without touching its reference count.
+  // The other song can only be assigned to or destroyed afterwards.
+  Song(Song&& other);
   ~Song();
 
   static const QStringList kColumns;
@@ -83,6 +87,20 @@ class Song {
 
   static QString JoinSpec(const QString& table);
 
+  // Which columns a query reads.  The partial projections still have one
+  // column for each of kColumns, so rows are read the same way, but the ones
+  // the view doesn't show are NULL and SQLite never has to load them.
+  enum Projection {
+    // Every column, for anything that edits or plays the song.
+    Projection_Full,
+    // What the library tree shows and sorts songs by.
+    Projection_TreeNode,
+    // What global search matches, groups and shows, which leaves out lyrics
+    // and the play statistics.
+    Projection_SearchResult,
+  };
+  static QString ColumnSpec(Projection projection);
+
   // Don't change these values - they're stored in the database, and defined
   // in the tag reader protobuf.
   // If a new lossless file is added, also add it to IsFileLossless().
@@ -113,6 +131,18 @@ class Song {
   // Sort songs alphabetically using their pretty title
   static void SortSongsListAlphabetically(QList<Song>* songs);
 
+  // Normalised text the library is sorted by.  These are stored in the
+  // sortartist, sortalbumartist and sortalbum columns, so changing them needs
+  // a schema update that fills those in again.
+  static QString SortText(QString text);
+  static QString SortTextForArtist(QString artist);
+
+  // How many songs' worth of metadata are alive, and the size of each one not
+  // counting the strings and images it points to.  Copies of a Song share
+  // their metadata until one of them is changed.
+  static int live_data_count();
+  static int data_size();
+
   // Constructors
   void Init(const QString& title, const QString& artist, const QString& album,
             qint64 length_nanosec);
@@ -120,6 +150,10 @@ class Song {
             qint64 beginning, qint64 end);
   void InitFromProtobuf(const pb::tagreader::SongMetadata& pb);
   void InitFromQuery(const SqlRow& query, bool reliable_metadata, int col = 0);
+  // Reads a row selected with ColumnSpec(projection).  Songs from the partial
+  // projections are marked partial; LibraryBackend::GetFullSongs loads the
+  // rest of them.
+  void InitFromQuery(const SqlRow& query, Projection projection, int col = 0);
   void InitFromFilePartial(
       const QString& filename);  // Just store the filename: incomplete but fast
   void InitArtManual();  // Check if there is already a art in the cache and
@@ -147,9 +181,10 @@ class Song {
 
   static QString Decode(const QString& tag, const QTextCodec* codec = nullptr);
 
-  // Save
-  void BindToQuery(QSqlQuery* query) const;
-  void BindToFtsQuery(QSqlQuery* query) const;
+  // Save.  The columns are bound to the query's next placeholders in the
+  // order of kColumns or kFtsColumns, rather than by name.
+  void BindToQuery(SqliteQuery* query) const;
+  void BindToFtsQuery(SqliteQuery* query) const;
 #ifdef HAVE_LIBLASTFM
   void ToLastFM(lastfm::Track* track, bool prefer_album_artist) const;
 #endif
@@ -159,6 +194,9 @@ class Song {
   // Simple accessors
   bool is_valid() const;
   bool is_unavailable() const;
+  // Whether this song was read with a partial projection, so some of its
+  // fields are missing.
+  bool is_partial() const;
   int id() const;
 
   const QString& title() const;
@@ -191,6 +229,12 @@ class Song {
   int score() const;
   int album_id() const;
 
+  // Gain in dB from our own loudness analysis, for files without ReplayGain
+  // tags.  NaN if the song hasn't been analysed.
+  float replaygain_track_gain() const;
+  float replaygain_album_gain() const;
+  bool has_replaygain() const;
+
   const QString& cue_path() const;
   bool has_cue() const;
 
@@ -204,6 +248,8 @@ class Song {
 
   int directory_id() const;
   const QUrl& url() const;
+  // Worked out when the URL is set.  Compare these instead of the URLs.
+  const UrlKey& url_key() const;
   const QString& basefilename() const;
   uint mtime() const;
   uint ctime() const;
@@ -286,6 +332,8 @@ class Song {
   void set_skipcount(int v);
   void set_lastplayed(int v);
   void set_score(int v);
+  void set_replaygain_track_gain(float v);
+  void set_replaygain_album_gain(float v);
   void set_cue_path(const QString& v);
   void set_unavailable(bool v);
   void set_etag(const QString& etag);
@@ -308,12 +356,20 @@ class Song {
   QString AlbumKey() const;
 
   Song& operator=(const Song& other);
+  Song& operator=(Song&& other);
 
  private:
+  // Used by InitFromQuery for rows that read straight from the statement.
+  void InitFromSqliteQuery(const SqliteQuery& q, bool reliable_metadata,
+                           int col);
+
   struct Private;
   QSharedDataPointer<Private> d;
 };
 Q_DECLARE_METATYPE(Song);
+// A Song is only a pointer to its shared data, so QList can keep it inline
+// instead of allocating a copy of it for every item.
+Q_DECLARE_TYPEINFO(Song, Q_MOVABLE_TYPE);
 
 typedef QList<Song> SongList;
 Q_DECLARE_METATYPE(QList<Song>);
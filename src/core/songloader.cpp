@@ -32,6 +32,7 @@
 #include <QtDebug>
 
 #include "config.h"
+#include "core/concurrentrun.h"
 #include "core/logging.h"
 #include "core/player.h"
 #include "core/utilities.h"
@@ -39,6 +40,7 @@
 #include "core/song.h"
 #include "core/tagreaderclient.h"
 #include "core/timeconstants.h"
+#include "core/urlkey.h"
 #include "core/waitforsignal.h"
 #include "internet/lastfm/fixlastfm.h"
 #include "internet/core/internetmodel.h"
@@ -61,6 +63,8 @@ using std::placeholders::_1;
 
 QSet<QString> SongLoader::sRawUriSchemes;
 const int SongLoader::kDefaultTimeout = 5000;
+const int SongLoader::kDirectoryThreads = 4;
+const int SongLoader::kDirectoryBatchSize = 64;
 
 SongLoader::SongLoader(LibraryBackendInterface* library, const Player* player,
                        QObject* parent)
@@ -90,6 +94,7 @@ SongLoader::SongLoader(LibraryBackendInterface* library, const Player* player,
   }
 
   timeout_timer_->setSingleShot(true);
+  thread_pool_.setMaxThreadCount(kDirectoryThreads);
 
   connect(timeout_timer_, SIGNAL(timeout()), SLOT(Timeout()));
 }
@@ -129,24 +134,25 @@ SongLoader::Result SongLoader::Load(const QUrl& url) {
   return BlockingLoadRequired;
 }
 
-void SongLoader::LoadFilenamesBlocking() {
-  if (preload_func_) {
-    preload_func_();
+SongLoader::Result SongLoader::LoadFiles(const QList<QUrl>& urls) {
+  if (urls.isEmpty()) return Success;
+
+  QStringList filenames;
+  for (const QUrl& url : urls) {
+    filenames << url.toLocalFile();
   }
+
+  url_ = urls.first();
+  preload_func_ = std::bind(&SongLoader::LoadLocalFilesAsync, this, filenames);
+  return BlockingLoadRequired;
 }
 
-SongLoader::Result SongLoader::LoadLocalPartial(const QString& filename) {
-  qLog(Debug) << "Fast Loading local file" << filename;
-  // First check to see if it's a directory - if so we can load all the songs
-  // inside right away.
-  if (QFileInfo(filename).isDir()) {
-    LoadLocalDirectory(filename);
-    return Success;
+void SongLoader::LoadFilenamesBlocking(const SongSink& sink) {
+  if (preload_func_) {
+    playlist_sink_ = sink;
+    preload_func_();
+    playlist_sink_ = SongSink();
   }
-  Song song;
-  song.InitFromFilePartial(filename);
-  if (song.is_valid()) songs_ << song;
-  return Success;
 }
 
 SongLoader::Result SongLoader::LoadAudioCD() {
@@ -260,11 +266,54 @@ void SongLoader::LoadLocalAsync(const QString& filename) {
 }
 
 void SongLoader::LoadMetadataBlocking() {
+  // Songs that aren't in the library are read in one batch afterwards, so the
+  // tagreader workers get hundreds of files per request instead of one.
+  // The library is searched with one query as well.
+  QList<QUrl> urls;
+  for (const Song& song : songs_) {
+    if (song.filetype() == Song::Type_Unknown) urls << song.url();
+  }
+  const QHash<QByteArray, Song> library_songs = LibrarySongs(urls);
+
+  QList<int> unread_indexes;
+  QStringList unread_filenames;
+
   for (int i = 0; i < songs_.size(); i++) {
-    EffectiveSongLoad(&songs_[i]);
+    Song* song = &songs_[i];
+
+    // Maybe we loaded the metadata already, for example from a cuesheet.
+    if (song->filetype() != Song::Type_Unknown) continue;
+
+    const QByteArray key = song->url().toEncoded();
+    if (library_songs.contains(key)) {
+      *song = library_songs[key];
+    } else {
+      unread_indexes << i;
+      unread_filenames << song->url().toLocalFile();
+    }
+  }
+
+  if (unread_filenames.isEmpty()) return;
+
+  SongList songs_on_disk;
+  TagReaderClient::Instance()->ReadFilesBlocking(unread_filenames,
+                                                 &songs_on_disk);
+
+  for (int i = 0; i < unread_indexes.count(); ++i) {
+    // The tagreader always fills in the URL, so an empty one means the
+    // request failed.  Keep the existing song, the same as ReadFileBlocking
+    // would.
+    const Song& song_on_disk = songs_on_disk[i];
+    if (song_on_disk.url().isEmpty()) continue;
+
+    songs_[unread_indexes[i]] = song_on_disk;
   }
 }
 
+void SongLoader::LoadFirstMetadataBlocking() {
+  if (!songs_.isEmpty()) EffectiveSongLoad(&(*songs_.begin()));
+}
+
 void SongLoader::EffectiveSongLoad(Song* song) {
   if (!song) return;
 
@@ -287,7 +336,13 @@ void SongLoader::EffectiveSongLoad(Song* song) {
 void SongLoader::LoadPlaylist(ParserBase* parser, const QString& filename) {
   QFile file(filename);
   file.open(QIODevice::ReadOnly);
-  songs_ = parser->Load(&file, filename, QFileInfo(filename).path());
+
+  songs_.clear();
+  parser->LoadChunked(&file, filename, QFileInfo(filename).path(),
+                      [this](const SongList& songs) -> bool {
+                        songs_ << songs;
+                        return !playlist_sink_ || playlist_sink_(songs);
+                      });
 }
 
 static bool CompareSongs(const Song& left, const Song& right) {
@@ -304,14 +359,65 @@ static bool CompareSongs(const Song& left, const Song& right) {
 }
 
 void SongLoader::LoadLocalDirectory(const QString& filename) {
-  QDirIterator it(filename, QDir::Files | QDir::NoDotAndDotDot | QDir::Readable,
-                  QDirIterator::Subdirectories);
-
+  // The subdirectories are listed in parallel, but only a few at a time so a
+  // single disk isn't kept seeking between them.
+  QStringList filenames;
+  QList<QFuture<QStringList>> listings;
+  QDirIterator it(filename,
+                  QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Readable);
   while (it.hasNext()) {
-    LoadLocalPartial(it.next());
+    const QString path = it.next();
+    const QFileInfo info = it.fileInfo();
+    if (info.isFile()) {
+      filenames << path;
+    } else if (info.isDir() && !info.isSymLink()) {
+      listings << ConcurrentRun::Run<QStringList>(
+          &thread_pool_, std::bind(&SongLoader::ListFiles, path));
+    }
+  }
+  for (QFuture<QStringList>& listing : listings) {
+    listing.waitForFinished();
+    filenames << listing.result();
   }
 
-  qStableSort(songs_.begin(), songs_.end(), CompareSongs);
+  // Sort while the songs only have URLs, so the order doesn't depend on which
+  // of them are in the library.
+  SongList songs;
+  for (const QString& name : filenames) {
+    Song song;
+    song.set_url(QUrl::fromLocalFile(name));
+    songs << song;
+  }
+  qStableSort(songs.begin(), songs.end(), CompareSongs);
+
+  // Files that are in the library don't need to be opened at all.  The rest
+  // are checked by TagLib in batches on the thread pool.
+  QList<QUrl> urls;
+  for (const Song& song : songs) {
+    urls << song.url();
+  }
+  const QHash<QByteArray, Song> library_songs = LibrarySongs(urls);
+
+  QList<int> miss_indexes;
+  QStringList misses;
+  for (int i = 0; i < songs.count(); ++i) {
+    const QByteArray key = songs[i].url().toEncoded();
+    if (library_songs.contains(key)) {
+      songs[i] = library_songs[key];
+    } else {
+      miss_indexes << i;
+      misses << songs[i].url().toLocalFile();
+    }
+  }
+
+  const SongList checked = CheckFiles(misses);
+  for (int i = 0; i < checked.count(); ++i) {
+    songs[miss_indexes[i]] = checked[i];
+  }
+
+  for (const Song& song : songs) {
+    if (song.is_valid()) songs_ << song;
+  }
 
   // Load the first song: all songs will be loaded async, but we want the first
   // one in our list to be fully loaded, so if the user has the "Start playing
@@ -320,6 +426,123 @@ void SongLoader::LoadLocalDirectory(const QString& filename) {
   if (!songs_.isEmpty()) EffectiveSongLoad(&(*songs_.begin()));
 }
 
+void SongLoader::LoadLocalFilesAsync(const QStringList& filenames) {
+  // Playlists are only streamed when they're loaded on their own, otherwise
+  // their songs wouldn't come first.
+  playlist_sink_ = SongSink();
+
+  // Everything that's in the library is taken from there with one query, so
+  // those files aren't opened at all.
+  QList<QUrl> urls;
+  for (const QString& filename : filenames) {
+    urls << QUrl::fromLocalFile(filename);
+  }
+  const QHash<QByteArray, Song> library_songs = LibrarySongs(urls);
+
+  // The songs of each file, in the same order as the files.
+  QList<SongList> results;
+  QList<int> plain_indexes;
+  QStringList plain_files;
+  for (int i = 0; i < filenames.count(); ++i) {
+    const QString& filename = filenames[i];
+    const QByteArray key = urls[i].toEncoded();
+    results << SongList();
+
+    if (library_songs.contains(key)) {
+      results[i] << library_songs[key];
+      continue;
+    }
+
+    // Directories, playlists and files with a cue sheet are loaded the same
+    // way as a single file.  The rest are most likely audio files, which are
+    // checked together below.
+    const QFileInfo info(filename);
+    if (info.isDir() ||
+        playlist_parser_->ParserForExtension(info.suffix().toLower()) ||
+        QFile::exists(filename.section('.', 0, -2) + ".cue")) {
+      LoadLocalAsync(filename);
+      results[i].swap(songs_);
+      continue;
+    }
+
+    plain_indexes << i;
+    plain_files << filename;
+  }
+
+  const SongList checked = CheckFiles(plain_files);
+  for (int i = 0; i < checked.count(); ++i) {
+    const int index = plain_indexes[i];
+    if (checked[i].is_valid()) {
+      results[index] << checked[i];
+    } else {
+      // TagLib couldn't read it, but it might still be a playlist with an
+      // unusual extension.
+      LoadLocalAsync(filenames[index]);
+      results[index].swap(songs_);
+    }
+  }
+
+  for (const SongList& songs : results) {
+    songs_ << songs;
+  }
+
+  // The first song is loaded completely for the same reason as in
+  // LoadLocalDirectory.
+  if (!songs_.isEmpty()) EffectiveSongLoad(&(*songs_.begin()));
+}
+
+SongList SongLoader::CheckFiles(const QStringList& filenames) {
+  QList<QFuture<SongList>> checks;
+  for (int i = 0; i < filenames.count(); i += kDirectoryBatchSize) {
+    checks << ConcurrentRun::Run<SongList>(
+        &thread_pool_, std::bind(&SongLoader::LoadFilesPartial,
+                                 filenames.mid(i, kDirectoryBatchSize)));
+  }
+
+  SongList ret;
+  for (QFuture<SongList>& check : checks) {
+    check.waitForFinished();
+    ret << check.result();
+  }
+  return ret;
+}
+
+QStringList SongLoader::ListFiles(const QString& path) {
+  QStringList ret;
+  QDirIterator it(path, QDir::Files | QDir::NoDotAndDotDot | QDir::Readable,
+                  QDirIterator::Subdirectories);
+  while (it.hasNext()) {
+    ret << it.next();
+  }
+  return ret;
+}
+
+SongList SongLoader::LoadFilesPartial(const QStringList& filenames) {
+  // Invalid songs are kept, so the results line up with the filenames.
+  SongList ret;
+  for (const QString& filename : filenames) {
+    Song song;
+    song.InitFromFilePartial(filename);
+    ret << song;
+  }
+  return ret;
+}
+
+QHash<QByteArray, Song> SongLoader::LibrarySongs(
+    const QList<QUrl>& urls) const {
+  // Only whole files, the same as GetSongByUrl.  Sections of cue sheets are
+  // loaded separately.
+  QHash<QByteArray, Song> ret;
+  if (urls.isEmpty()) return ret;
+
+  for (const Song& song : library_->GetSongsByUrls(urls)) {
+    if (song.beginning_nanosec() == 0) {
+      ret[song.url_key().encoded()] = song;
+    }
+  }
+  return ret;
+}
+
 void SongLoader::AddAsRawStream() {
   Song song;
   song.set_valid(true);
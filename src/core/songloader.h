@@ -28,6 +28,7 @@
 
 #include <gst/gst.h>
 
+#include <QHash>
 #include <QObject>
 #include <QThreadPool>
 #include <QUrl>
@@ -59,6 +60,14 @@ class SongLoader : public QObject {
   };
 
   static const int kDefaultTimeout;
+  // How many directories are listed at the same time when loading a folder,
+  // and how many files each thread checks at a time.
+  static const int kDirectoryThreads;
+  static const int kDirectoryBatchSize;
+
+  // Receives the songs of a playlist a chunk at a time while it is parsed.
+  // Returning false cancels the load.
+  typedef std::function<bool(const SongList&)> SongSink;
 
   const QUrl& url() const { return url_; }
   const SongList& songs() const { return songs_; }
@@ -69,14 +78,23 @@ class SongLoader : public QObject {
   // If Success is returned the songs are fully loaded. If BlockingLoadRequired
   // is returned LoadFilenamesBlocking() needs to be called next.
   Result Load(const QUrl& url);
+  // Loads several local files, directories or playlists at once.  The library
+  // is searched with one query and the other files are checked in batches, so
+  // this is much quicker than a SongLoader for each of them.  Always returns
+  // BlockingLoadRequired, and playlists aren't passed to the sink.
+  Result LoadFiles(const QList<QUrl>& urls);
   // Loads the files with only filenames. When finished, songs() contains a
   // complete list of all Song objects, but without metadata. This method is
   // blocking, do not call it from the UI thread.
-  void LoadFilenamesBlocking();
+  // If the URL is a playlist, and 'sink' is set, the songs are also handed to
+  // 'sink' as they are parsed, before this method returns.
+  void LoadFilenamesBlocking(const SongSink& sink = SongSink());
   // Completely load songs previously loaded with LoadFilenamesBlocking(). When
   // finished, the Song objects in songs() contain metadata now. This method is
   // blocking, do not call it from the UI thread.
   void LoadMetadataBlocking();
+  // The same as LoadMetadataBlocking(), but only for the first song.
+  void LoadFirstMetadataBlocking();
   Result LoadAudioCD();
 
 signals:
@@ -103,8 +121,18 @@ signals:
   Result LoadLocal(const QString& filename);
   void LoadLocalAsync(const QString& filename);
   void EffectiveSongLoad(Song* song);
-  Result LoadLocalPartial(const QString& filename);
   void LoadLocalDirectory(const QString& filename);
+  void LoadLocalFilesAsync(const QStringList& filenames);
+  // Runs LoadFilesPartial on thread_pool_, kDirectoryBatchSize files at a
+  // time.  The results line up with the filenames.
+  SongList CheckFiles(const QStringList& filenames);
+  // Lists the files in a directory and all its subdirectories.  Run on
+  // thread_pool_ by LoadLocalDirectory.
+  static QStringList ListFiles(const QString& path);
+  // Partially loads the files, leaving out the ones TagLib can't read.
+  static SongList LoadFilesPartial(const QStringList& filenames);
+  // Returns the library's songs for the URLs, keyed by their encoded URL.
+  QHash<QByteArray, Song> LibrarySongs(const QList<QUrl>& urls) const;
   void LoadPlaylist(ParserBase* parser, const QString& filename);
 
   void AddAsRawStream();
@@ -139,6 +167,7 @@ signals:
 
   // For async loads
   std::function<void()> preload_func_;
+  SongSink playlist_sink_;
   int timeout_;
   State state_;
   bool success_;
@@ -151,6 +180,7 @@ signals:
 
   std::shared_ptr<GstElement> pipeline_;
 
+  // Lists and checks the files of directories.
   QThreadPool thread_pool_;
 };
 
@@ -0,0 +1,103 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "startupscheduler.h"
+
+#include <QTimer>
+
+#include "core/logging.h"
+
+StartupScheduler::StartupScheduler(QObject* parent)
+    : QObject(parent),
+      last_stage_msec_(0),
+      started_(false),
+      run_scheduled_(false) {
+  clock_.start();
+}
+
+void StartupScheduler::StageFinished(const QString& name) {
+  Record(name, last_stage_msec_, false);
+  last_stage_msec_ = clock_.elapsed();
+}
+
+void StartupScheduler::Defer(const QString& name,
+                             std::function<void()> task) {
+  deferred_ << qMakePair(name, task);
+
+  if (started_ && !run_scheduled_) {
+    run_scheduled_ = true;
+    QTimer::singleShot(0, this, SLOT(RunNext()));
+  }
+}
+
+void StartupScheduler::Start() {
+  if (started_) return;
+  started_ = true;
+
+  qLog(Debug) << "Critical path finished after" << clock_.elapsed() << "ms,"
+              << deferred_.count() << "tasks deferred";
+
+  run_scheduled_ = true;
+  QTimer::singleShot(0, this, SLOT(RunNext()));
+}
+
+void StartupScheduler::RunNext() {
+  run_scheduled_ = false;
+
+  if (deferred_.isEmpty()) {
+    qLog(Debug) << "Startup finished after" << clock_.elapsed() << "ms";
+    emit Finished();
+    return;
+  }
+
+  const QPair<QString, std::function<void()>> task = deferred_.takeFirst();
+  const qint64 start_msec = clock_.elapsed();
+  task.second();
+  Record(task.first, start_msec, true);
+
+  // Go back to the event loop before the next one, so anything waiting to
+  // paint gets a chance to.  The last pass emits Finished.
+  run_scheduled_ = true;
+  QTimer::singleShot(0, this, SLOT(RunNext()));
+}
+
+void StartupScheduler::Record(const QString& name, qint64 start_msec,
+                              bool deferred) {
+  Stage stage;
+  stage.name_ = name;
+  stage.msec_ = clock_.elapsed() - start_msec;
+  stage.deferred_ = deferred;
+  stages_ << stage;
+
+  qLog(Debug) << (deferred ? "Deferred startup task" : "Startup stage")
+              << name << "took" << stage.msec_ << "ms";
+}
+
+QStringList StartupScheduler::Report() const {
+  QStringList ret;
+  for (const Stage& stage : stages_) {
+    ret << QString("%1%2: %3 ms")
+               .arg(stage.deferred_ ? "(deferred) " : "", stage.name_)
+               .arg(stage.msec_);
+  }
+  if (!started_) {
+    ret << "Still on the critical path";
+  } else if (!deferred_.isEmpty()) {
+    ret << QString("%1 deferred tasks still to run").arg(deferred_.count());
+  }
+  return ret;
+}
@@ -0,0 +1,78 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_STARTUPSCHEDULER_H_
+#define CORE_STARTUPSCHEDULER_H_
+
+#include <functional>
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QStringList>
+
+// Times each stage of startup, and holds back the work that isn't needed to
+// show the main window until the event loop is idle.  The deferred tasks run
+// one at a time so the window keeps painting in between.  Everything here is
+// for the main thread only.
+class StartupScheduler : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit StartupScheduler(QObject* parent = nullptr);
+
+  // Records that a stage of the critical path has finished, taking the time
+  // since the one before it.
+  void StageFinished(const QString& name);
+
+  // Queues task to run after Start().  If Start() was called already it runs
+  // at the next idle moment.
+  void Defer(const QString& name, std::function<void()> task);
+
+  // The critical path is done, starts running the deferred tasks.
+  void Start();
+
+  bool is_finished() const { return started_ && deferred_.isEmpty(); }
+
+  // A line for each stage and deferred task, in the order they ran.
+  QStringList Report() const;
+
+ signals:
+  void Finished();
+
+ private slots:
+  void RunNext();
+
+ private:
+  void Record(const QString& name, qint64 start_msec, bool deferred);
+
+  struct Stage {
+    QString name_;
+    qint64 msec_;
+    bool deferred_;
+  };
+
+  QElapsedTimer clock_;
+  qint64 last_stage_msec_;
+  QList<Stage> stages_;
+  QList<QPair<QString, std::function<void()>>> deferred_;
+  bool started_;
+  bool run_scheduled_;
+};
+
+#endif  // CORE_STARTUPSCHEDULER_H_
@@ -0,0 +1,174 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "streamcache.h"
+
+#include <utime.h>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QNetworkReply>
+#include <QSettings>
+
+#include "core/closure.h"
+#include "core/logging.h"
+#include "core/network.h"
+#include "core/utilities.h"
+
+const char* StreamCache::kSettingsGroup = "StreamCache";
+const int StreamCache::kDefaultMaxSizeMb = 1024;
+const int StreamCache::kMaxConcurrentFetches = 2;
+
+namespace {
+const char* kPartialSuffix = ".part";
+}
+
+StreamCache::StreamCache(QObject* parent)
+    : QObject(parent),
+      network_(new NetworkAccessManager(this)),
+      directory_(Utilities::GetConfigPath(Utilities::Path_StreamCache)),
+      max_size_bytes_(0) {
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  max_size_bytes_ =
+      qint64(s.value("max_size_mb", kDefaultMaxSizeMb).toInt()) * 1024 * 1024;
+
+  QDir dir(directory_);
+  dir.mkpath(".");
+
+  // Clean up downloads that were interrupted last time.
+  for (const QString& filename :
+       dir.entryList(QStringList() << QString("*") + kPartialSuffix,
+                     QDir::Files)) {
+    dir.remove(filename);
+  }
+}
+
+StreamCache::~StreamCache() {
+  for (const Download& download : downloads_.values()) {
+    download.file->remove();
+    delete download.file;
+  }
+}
+
+QString StreamCache::FilenameForUrl(const QUrl& url) const {
+  return directory_ + "/" +
+         QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha1)
+             .toHex();
+}
+
+QUrl StreamCache::LocalUrl(const QUrl& url) {
+  const QString filename = FilenameForUrl(url);
+  if (!QFile::exists(filename)) {
+    return QUrl();
+  }
+
+  // Bump the modification time, which is what RemoveOldFiles() sorts by.
+  utime(QFile::encodeName(filename).constData(), nullptr);
+  return QUrl::fromLocalFile(filename);
+}
+
+void StreamCache::Fetch(const QUrl& url, const QUrl& media_url) {
+  if (max_size_bytes_ <= 0 || fetching_urls_.contains(url) ||
+      QFile::exists(FilenameForUrl(url))) {
+    return;
+  }
+
+  fetching_urls_.insert(url);
+  queued_fetches_ << qMakePair(url, media_url);
+  StartQueuedFetches();
+}
+
+void StreamCache::StartQueuedFetches() {
+  while (downloads_.count() < kMaxConcurrentFetches &&
+         !queued_fetches_.isEmpty()) {
+    const QPair<QUrl, QUrl> fetch = queued_fetches_.takeFirst();
+
+    Download download;
+    download.url = fetch.first;
+    download.file = new QFile(FilenameForUrl(fetch.first) + kPartialSuffix);
+    if (!download.file->open(QIODevice::WriteOnly)) {
+      qLog(Warning) << "Failed to open" << download.file->fileName()
+                    << download.file->errorString();
+      delete download.file;
+      fetching_urls_.remove(fetch.first);
+      continue;
+    }
+
+    qLog(Debug) << "Caching" << fetch.first;
+
+    QNetworkReply* reply = network_->get(QNetworkRequest(fetch.second));
+    downloads_[reply] = download;
+    NewClosure(reply, SIGNAL(readyRead()), this,
+               SLOT(FetchReadyRead(QNetworkReply*)), reply);
+    NewClosure(reply, SIGNAL(finished()), this,
+               SLOT(FetchFinished(QNetworkReply*)), reply);
+  }
+}
+
+void StreamCache::FetchReadyRead(QNetworkReply* reply) {
+  if (!downloads_.contains(reply)) return;
+  downloads_[reply].file->write(reply->readAll());
+}
+
+void StreamCache::FetchFinished(QNetworkReply* reply) {
+  reply->deleteLater();
+  if (!downloads_.contains(reply)) return;
+
+  const Download download = downloads_.take(reply);
+  fetching_urls_.remove(download.url);
+
+  download.file->write(reply->readAll());
+  download.file->close();
+
+  const int code =
+      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  if (reply->error() != QNetworkReply::NoError || code >= 400) {
+    qLog(Warning) << "Failed to cache" << download.url << reply->errorString();
+    download.file->remove();
+  } else {
+    const QString filename = FilenameForUrl(download.url);
+    QFile::remove(filename);
+    download.file->rename(filename);
+    RemoveOldFiles();
+  }
+  delete download.file;
+
+  StartQueuedFetches();
+}
+
+void StreamCache::RemoveOldFiles() {
+  QFileInfoList files =
+      QDir(directory_).entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+
+  qint64 total_size = 0;
+  for (const QFileInfo& info : files) {
+    total_size += info.size();
+  }
+
+  while (total_size > max_size_bytes_ && !files.isEmpty()) {
+    const QFileInfo oldest = files.takeFirst();
+    if (oldest.fileName().endsWith(kPartialSuffix)) {
+      continue;
+    }
+    qLog(Debug) << "Removing" << oldest.fileName() << "from the stream cache";
+    QFile::remove(oldest.filePath());
+    total_size -= oldest.size();
+  }
+}
@@ -0,0 +1,77 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_STREAMCACHE_H_
+#define CORE_STREAMCACHE_H_
+
+#include <QMap>
+#include <QObject>
+#include <QSet>
+#include <QUrl>
+
+class NetworkAccessManager;
+class QFile;
+class QNetworkReply;
+
+// Keeps whole copies of recently streamed tracks on disk, so replaying or
+// seeking in them doesn't have to go back to the server.  Tracks are keyed by
+// their playlist URL (eg. subsonic://id) rather than the URL they were
+// downloaded from, which usually contains credentials.  The least recently
+// used files are removed once the cache grows past its size limit.
+class StreamCache : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit StreamCache(QObject* parent = nullptr);
+  ~StreamCache();
+
+  static const char* kSettingsGroup;
+  static const int kDefaultMaxSizeMb;
+  static const int kMaxConcurrentFetches;
+
+  // Returns a file:// URL for the track if it has been cached completely, or
+  // an empty QUrl if not.
+  QUrl LocalUrl(const QUrl& url);
+
+  // Downloads media_url into the cache, unless url is already cached or being
+  // fetched.
+  void Fetch(const QUrl& url, const QUrl& media_url);
+
+ private slots:
+  void FetchReadyRead(QNetworkReply* reply);
+  void FetchFinished(QNetworkReply* reply);
+
+ private:
+  struct Download {
+    QUrl url;
+    QFile* file;
+  };
+
+  QString FilenameForUrl(const QUrl& url) const;
+  void StartQueuedFetches();
+  void RemoveOldFiles();
+
+  NetworkAccessManager* network_;
+  QString directory_;
+  qint64 max_size_bytes_;
+
+  QMap<QNetworkReply*, Download> downloads_;
+  QList<QPair<QUrl, QUrl>> queued_fetches_;
+  QSet<QUrl> fetching_urls_;
+};
+
+#endif  // CORE_STREAMCACHE_H_
@@ -32,18 +32,32 @@ void StyleSheetLoader::SetStyleSheet(QWidget* widget, const QString& filename) {
 }
 
 void StyleSheetLoader::UpdateStyleSheet(QWidget* widget) {
-  QString filename(filenames_[widget]);
+  const QString contents = StyleSheet(filenames_[widget], widget->palette());
+  if (contents.isEmpty()) return;
 
-  // Load the file
-  QFile file(filename);
-  if (!file.open(QIODevice::ReadOnly)) {
-    qLog(Warning) << "error opening" << filename;
-    return;
+  // Setting a stylesheet repolishes the widget and all its children, even if
+  // it hasn't changed.
+  if (widget->styleSheet() != contents) widget->setStyleSheet(contents);
+}
+
+QString StyleSheetLoader::StyleSheet(const QString& filename,
+                                     const QPalette& p) {
+  const QString key = QString::number(p.cacheKey()) + "/" + filename;
+  QHash<QString, QString>::const_iterator it = stylesheets_.constFind(key);
+  if (it != stylesheets_.constEnd()) return it.value();
+
+  if (!templates_.contains(filename)) {
+    // Load the file
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly)) {
+      qLog(Warning) << "error opening" << filename;
+      return QString();
+    }
+    templates_[filename] = QString(file.readAll());
   }
-  QString contents(file.readAll());
+  QString contents(templates_[filename]);
 
   // Replace %palette-role with actual colours
-  QPalette p(widget->palette());
 
   QColor alt = p.color(QPalette::AlternateBase);
   alt.setAlpha(50);
@@ -79,7 +93,8 @@ void StyleSheetLoader::UpdateStyleSheet(QWidget* widget) {
   contents.replace("darwin", "*");
 #endif
 
-  widget->setStyleSheet(contents);
+  stylesheets_[key] = contents;
+  return contents;
 }
 
 void StyleSheetLoader::ReplaceColor(QString* css, const QString& name,
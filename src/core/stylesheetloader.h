@@ -22,6 +22,7 @@
 #include <QString>
 #include <QPalette>
 #include <QWidget>
+#include <QHash>
 #include <QMap>
 
 class StyleSheetLoader : public QObject {
@@ -39,11 +40,20 @@ class StyleSheetLoader : public QObject {
 
  private:
   void UpdateStyleSheet(QWidget* widget);
+  // Returns the stylesheet in the file with the colours of the palette filled
+  // in, or an empty string if the file can't be read.
+  QString StyleSheet(const QString& filename, const QPalette& palette);
   void ReplaceColor(QString* css, const QString& name, const QPalette& palette,
                     QPalette::ColorRole role) const;
 
  private:
   QMap<QWidget*, QString> filenames_;
+
+  // The contents of each file, and what they become with each palette.
+  // Most widgets share the application's palette, so a file is only read and
+  // filled in once however many widgets use it.
+  QHash<QString, QString> templates_;
+  QHash<QString, QString> stylesheets_;
 };
 
 #endif  // CORE_STYLESHEETLOADER_H_
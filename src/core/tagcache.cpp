@@ -0,0 +1,195 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tagcache.h"
+
+#include <sys/stat.h>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include "core/logging.h"
+
+const int TagCache::kMaxEntries = 250000;
+
+namespace {
+
+const quint32 kFileMagic = 0x54414743;  // "TAGC"
+const quint32 kFileVersion = 1;
+
+}  // namespace
+
+bool TagCache::FileKey::operator==(const FileKey& other) const {
+  return device == other.device && inode == other.inode &&
+         size == other.size && mtime_nsec == other.mtime_nsec;
+}
+
+TagCache::TagCache() : dirty_(false) {}
+
+bool TagCache::StatFile(const QString& filename, FileKey* key) {
+#ifdef Q_OS_WIN32
+  QFileInfo info(filename);
+  if (!info.exists()) return false;
+
+  *key = FileKey();
+  key->size = info.size();
+  key->mtime_nsec = info.lastModified().toMSecsSinceEpoch() * 1000000;
+#else
+  struct stat st;
+  if (stat(QFile::encodeName(filename).constData(), &st) != 0) return false;
+
+  key->device = st.st_dev;
+  key->inode = st.st_ino;
+  key->size = st.st_size;
+#if defined(Q_OS_DARWIN)
+  key->mtime_nsec =
+      qint64(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#elif defined(Q_OS_LINUX)
+  key->mtime_nsec = qint64(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#else
+  key->mtime_nsec = qint64(st.st_mtime) * 1000000000;
+#endif
+#endif
+  return true;
+}
+
+bool TagCache::Lookup(const QString& filename, FileKey* key,
+                      pb::tagreader::SongMetadata* metadata) const {
+  if (!StatFile(filename, key)) return false;
+
+  QMutexLocker l(&mutex_);
+  QHash<QString, Entry>::const_iterator it = entries_.constFind(filename);
+  if (it == entries_.constEnd() || it->key != *key) return false;
+
+  return metadata->ParseFromArray(it->metadata.constData(),
+                                  it->metadata.size());
+}
+
+void TagCache::Insert(const QString& filename, const FileKey& key,
+                      const pb::tagreader::SongMetadata& metadata) {
+  Entry entry;
+  entry.key = key;
+  entry.metadata.resize(metadata.ByteSize());
+  metadata.SerializeToArray(entry.metadata.data(), entry.metadata.size());
+
+  QMutexLocker l(&mutex_);
+  // Files that were deleted or moved are never looked up again, so when the
+  // cache is full just start again rather than tracking which entries are
+  // the oldest.
+  if (entries_.count() >= kMaxEntries && !entries_.contains(filename)) {
+    entries_.clear();
+  }
+  entries_[filename] = entry;
+  dirty_ = true;
+}
+
+void TagCache::Remove(const QString& filename) {
+  QMutexLocker l(&mutex_);
+  if (entries_.remove(filename)) dirty_ = true;
+}
+
+int TagCache::count() const {
+  QMutexLocker l(&mutex_);
+  return entries_.count();
+}
+
+bool TagCache::Load(const QString& path) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) return false;
+
+  QDataStream s(&file);
+  quint32 magic = 0;
+  quint32 version = 0;
+  quint32 count = 0;
+  s >> magic >> version >> count;
+  if (magic != kFileMagic || version != kFileVersion) {
+    qLog(Warning) << "Ignoring tag cache" << path << "with unknown format";
+    return false;
+  }
+
+  QHash<QString, Entry> entries;
+  entries.reserve(count);
+  for (quint32 i = 0; i < count && !s.atEnd(); ++i) {
+    QString filename;
+    Entry entry;
+    s >> filename >> entry.key.device >> entry.key.inode >> entry.key.size >>
+        entry.key.mtime_nsec >> entry.metadata;
+    if (s.status() != QDataStream::Ok) break;
+    entries[filename] = entry;
+  }
+
+  if (s.status() != QDataStream::Ok) {
+    qLog(Warning) << "Tag cache" << path << "is truncated";
+  }
+
+  QMutexLocker l(&mutex_);
+  // Anything read while the file was loading is newer.
+  for (QHash<QString, Entry>::const_iterator it = entries_.constBegin();
+       it != entries_.constEnd(); ++it) {
+    entries[it.key()] = it.value();
+  }
+  entries_ = entries;
+  return true;
+}
+
+bool TagCache::Save(const QString& path) {
+  QHash<QString, Entry> entries;
+  {
+    QMutexLocker l(&mutex_);
+    if (!dirty_) return true;
+    entries = entries_;
+    dirty_ = false;
+  }
+
+  QDir().mkpath(QFileInfo(path).absolutePath());
+
+  // Write a new file and swap it in, so a crash while saving doesn't lose the
+  // old cache.
+  const QString temp_path = path + ".new";
+  QFile file(temp_path);
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qLog(Warning) << "Couldn't save the tag cache to" << temp_path;
+
+    QMutexLocker l(&mutex_);
+    dirty_ = true;
+    return false;
+  }
+
+  QDataStream s(&file);
+  s << kFileMagic << kFileVersion << quint32(entries.count());
+  for (QHash<QString, Entry>::const_iterator it = entries.constBegin();
+       it != entries.constEnd(); ++it) {
+    s << it.key() << it->key.device << it->key.inode << it->key.size
+      << it->key.mtime_nsec << it->metadata;
+  }
+  file.close();
+
+  if (s.status() != QDataStream::Ok || file.error() != QFile::NoError) {
+    qLog(Warning) << "Couldn't save the tag cache to" << temp_path;
+    QFile::remove(temp_path);
+
+    QMutexLocker l(&mutex_);
+    dirty_ = true;
+    return false;
+  }
+
+  QFile::remove(path);
+  return QFile::rename(temp_path, path);
+}
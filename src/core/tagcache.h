@@ -0,0 +1,81 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_TAGCACHE_H_
+#define CORE_TAGCACHE_H_
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+#include "tagreadermessages.pb.h"
+
+// Remembers the tags the tagreader workers read from local files, so a file
+// that hasn't changed since the last read doesn't have to go through TagLib
+// again.  An entry is only used while the file's device, inode, size and
+// modification time are still the same as when it was read.  The cache can be
+// saved to and loaded from disk, and can be used from any thread.
+class TagCache {
+ public:
+  TagCache();
+
+  static const int kMaxEntries;
+
+  struct FileKey {
+    FileKey() : device(0), inode(0), size(0), mtime_nsec(0) {}
+
+    quint64 device;
+    quint64 inode;
+    quint64 size;
+    qint64 mtime_nsec;
+
+    bool operator==(const FileKey& other) const;
+    bool operator!=(const FileKey& other) const { return !(*this == other); }
+  };
+
+  // Returns false if the file doesn't exist.
+  static bool StatFile(const QString& filename, FileKey* key);
+
+  // Fills metadata and returns true if the file hasn't changed since it was
+  // inserted.  The file's current key is returned either way, so it can be
+  // passed to Insert once the file has been read.
+  bool Lookup(const QString& filename, FileKey* key,
+              pb::tagreader::SongMetadata* metadata) const;
+  void Insert(const QString& filename, const FileKey& key,
+              const pb::tagreader::SongMetadata& metadata);
+  void Remove(const QString& filename);
+  int count() const;
+
+  // Entries that were inserted after the cache was last saved are kept.
+  bool Load(const QString& path);
+  // Does nothing if there were no changes since the last save.
+  bool Save(const QString& path);
+
+ private:
+  struct Entry {
+    FileKey key;
+    // A serialised pb::tagreader::SongMetadata.
+    QByteArray metadata;
+  };
+
+  mutable QMutex mutex_;
+  QHash<QString, Entry> entries_;
+  bool dirty_;
+};
+
+#endif  // CORE_TAGCACHE_H_
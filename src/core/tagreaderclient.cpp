@@ -27,20 +27,53 @@
 #include <QThread>
 #include <QUrl>
 
+#include "core/tracing.h"
+#include "core/utilities.h"
+
 const char* TagReaderClient::kWorkerExecutableName = "clementine-tagreader";
+const int TagReaderClient::kReadFilesBatchSize = 32;
+const int TagReaderClient::kSaveCacheDelayMs = 60000;
+const int TagReaderClient::kWorkerTimeoutMs = 60000;
 TagReaderClient* TagReaderClient::sInstance = nullptr;
 
 TagReaderClient::TagReaderClient(QObject* parent)
-    : QObject(parent), worker_pool_(new WorkerPool<HandlerType>(this)) {
+    : QObject(parent),
+      worker_pool_(new WorkerPool<HandlerType>(this)),
+      save_cache_timer_(new QTimer(this)) {
   sInstance = this;
 
   worker_pool_->SetExecutableName(kWorkerExecutableName);
   worker_pool_->SetWorkerCount(QThread::idealThreadCount());
+  worker_pool_->SetSharedMemoryEnabled(true);
+  worker_pool_->SetRequestTimeout(kWorkerTimeoutMs);
   connect(worker_pool_, SIGNAL(WorkerFailedToStart()),
           SLOT(WorkerFailedToStart()));
+
+  save_cache_timer_->setSingleShot(true);
+  save_cache_timer_->setInterval(kSaveCacheDelayMs);
+  connect(save_cache_timer_, SIGNAL(timeout()), SLOT(SaveCache()));
 }
 
-void TagReaderClient::Start() { worker_pool_->Start(); }
+TagReaderClient::~TagReaderClient() { SaveCache(); }
+
+void TagReaderClient::Start() {
+  worker_pool_->Start();
+
+  // The cache can be big, so don't load it on the caller's thread.
+  QMetaObject::invokeMethod(this, "LoadCache", Qt::QueuedConnection);
+}
+
+QString TagReaderClient::CachePath() {
+  return Utilities::GetConfigPath(Utilities::Path_CacheRoot) + "/tagcache";
+}
+
+void TagReaderClient::LoadCache() {
+  if (cache_.Load(CachePath())) {
+    qLog(Debug) << "Loaded" << cache_.count() << "entries from the tag cache";
+  }
+}
+
+void TagReaderClient::SaveCache() { cache_.Save(CachePath()); }
 
 void TagReaderClient::WorkerFailedToStart() {
   qLog(Error) << "The" << kWorkerExecutableName << "executable was not found"
@@ -49,12 +82,129 @@ void TagReaderClient::WorkerFailedToStart() {
 }
 
 TagReaderReply* TagReaderClient::ReadFile(const QString& filename) {
+  return StartRead(QStringList() << filename, true);
+}
+
+TagReaderReply* TagReaderClient::ReadFiles(const QStringList& filenames) {
+  return StartRead(filenames, false);
+}
+
+TagReaderReply* TagReaderClient::StartRead(const QStringList& filenames,
+                                           bool single_file) {
   pb::tagreader::Message message;
-  pb::tagreader::ReadFileRequest* req = message.mutable_read_file_request();
+  if (single_file) {
+    message.mutable_read_file_request()->set_filename(
+        DataCommaSizeFromQString(filenames[0]));
+  } else {
+    pb::tagreader::ReadFilesRequest* req =
+        message.mutable_read_files_request();
+    for (const QString& filename : filenames) {
+      req->add_filenames(DataCommaSizeFromQString(filename));
+    }
+  }
 
-  req->set_filename(DataCommaSizeFromQString(filename));
+  PendingRead read;
+  read.reply_ = new ReplyType(message);
+  read.single_file_ = single_file;
+
+  for (int i = 0; i < filenames.count(); ++i) {
+    TagCache::FileKey key;
+    pb::tagreader::SongMetadata metadata;
+    if (!cache_.Lookup(filenames[i], &key, &metadata)) {
+      read.worker_files_ << filenames[i];
+      read.worker_indices_ << i;
+      read.worker_keys_ << key;
+    }
+    read.metadata_ << metadata;
+  }
 
-  return worker_pool_->SendMessageWithReply(&message);
+  {
+    QMutexLocker l(&queued_reads_mutex_);
+    queued_reads_ << read;
+  }
+  QMetaObject::invokeMethod(this, "StartQueuedReads", Qt::QueuedConnection);
+
+  return read.reply_;
+}
+
+void TagReaderClient::StartQueuedReads() {
+  QList<PendingRead> reads;
+  {
+    QMutexLocker l(&queued_reads_mutex_);
+    reads = queued_reads_;
+    queued_reads_.clear();
+  }
+
+  for (const PendingRead& read : reads) {
+    if (read.worker_files_.isEmpty()) {
+      FinishRead(read);
+      continue;
+    }
+
+    pb::tagreader::Message message;
+    if (read.single_file_) {
+      message.mutable_read_file_request()->set_filename(
+          DataCommaSizeFromQString(read.worker_files_[0]));
+    } else {
+      pb::tagreader::ReadFilesRequest* req =
+          message.mutable_read_files_request();
+      for (const QString& filename : read.worker_files_) {
+        req->add_filenames(DataCommaSizeFromQString(filename));
+      }
+    }
+
+    ReplyType* worker_reply = worker_pool_->SendMessageWithReply(&message);
+    pending_reads_[worker_reply] = read;
+    connect(worker_reply, SIGNAL(Finished(bool)),
+            SLOT(WorkerReadFinished(bool)));
+  }
+}
+
+void TagReaderClient::WorkerReadFinished(bool success) {
+  ReplyType* worker_reply = static_cast<ReplyType*>(sender());
+  worker_reply->deleteLater();
+  if (!pending_reads_.contains(worker_reply)) return;
+
+  PendingRead read = pending_reads_.take(worker_reply);
+  if (!success) {
+    read.reply_->Abort();
+    return;
+  }
+
+  const pb::tagreader::Message& message = worker_reply->message();
+  for (int i = 0; i < read.worker_files_.count(); ++i) {
+    pb::tagreader::SongMetadata* metadata =
+        &read.metadata_[read.worker_indices_[i]];
+    if (read.single_file_) {
+      *metadata = message.read_file_response().metadata();
+    } else if (i < message.read_files_response().metadata_size()) {
+      *metadata = message.read_files_response().metadata(i);
+    }
+
+    // Files that couldn't be read might be readable next time.
+    if (metadata->valid()) {
+      cache_.Insert(read.worker_files_[i], read.worker_keys_[i], *metadata);
+    }
+  }
+
+  FinishRead(read);
+  if (!save_cache_timer_->isActive()) save_cache_timer_->start();
+}
+
+void TagReaderClient::FinishRead(const PendingRead& read) {
+  pb::tagreader::Message message;
+  if (read.single_file_) {
+    *message.mutable_read_file_response()->mutable_metadata() =
+        read.metadata_[0];
+  } else {
+    pb::tagreader::ReadFilesResponse* response =
+        message.mutable_read_files_response();
+    for (const pb::tagreader::SongMetadata& metadata : read.metadata_) {
+      *response->add_metadata() = metadata;
+    }
+  }
+
+  read.reply_->SetReply(message);
 }
 
 TagReaderReply* TagReaderClient::SaveFile(const QString& filename,
@@ -65,6 +215,7 @@ TagReaderReply* TagReaderClient::SaveFile(const QString& filename,
   req->set_filename(DataCommaSizeFromQString(filename));
   metadata.ToProtobuf(req->mutable_metadata());
 
+  cache_.Remove(filename);
   return worker_pool_->SendMessageWithReply(&message);
 }
 
@@ -76,6 +227,7 @@ TagReaderReply* TagReaderClient::UpdateSongStatistics(const Song& metadata) {
   req->set_filename(DataCommaSizeFromQString(metadata.url().toLocalFile()));
   metadata.ToProtobuf(req->mutable_metadata());
 
+  cache_.Remove(metadata.url().toLocalFile());
   return worker_pool_->SendMessageWithReply(&message);
 }
 
@@ -94,6 +246,7 @@ TagReaderReply* TagReaderClient::UpdateSongRating(const Song& metadata) {
   req->set_filename(DataCommaSizeFromQString(metadata.url().toLocalFile()));
   metadata.ToProtobuf(req->mutable_metadata());
 
+  cache_.Remove(metadata.url().toLocalFile());
   return worker_pool_->SendMessageWithReply(&message);
 }
 
@@ -143,6 +296,7 @@ TagReaderReply* TagReaderClient::ReadCloudFile(
 
 void TagReaderClient::ReadFileBlocking(const QString& filename, Song* song) {
   Q_ASSERT(QThread::currentThread() != thread());
+  qTraceScope("TagReaderClient::ReadFileBlocking");
 
   TagReaderReply* reply = ReadFile(filename);
   if (reply->WaitForFinished()) {
@@ -151,6 +305,40 @@ void TagReaderClient::ReadFileBlocking(const QString& filename, Song* song) {
   reply->deleteLater();
 }
 
+void TagReaderClient::ReadFilesBlocking(const QStringList& filenames,
+                                        SongList* songs) {
+  Q_ASSERT(QThread::currentThread() != thread());
+
+  // Send every batch before waiting for any of them, so all the workers are
+  // busy at once.
+  QList<TagReaderReply*> replies;
+  for (int i = 0; i < filenames.count(); i += kReadFilesBatchSize) {
+    replies << ReadFiles(filenames.mid(i, kReadFilesBatchSize));
+  }
+
+  songs->clear();
+  for (TagReaderReply* reply : replies) {
+    const int expected =
+        reply->request_message().read_files_request().filenames_size();
+    const int first = songs->count();
+
+    if (reply->WaitForFinished()) {
+      const pb::tagreader::ReadFilesResponse& response =
+          reply->message().read_files_response();
+      for (int i = 0; i < response.metadata_size() && i < expected; ++i) {
+        Song song;
+        song.InitFromProtobuf(response.metadata(i));
+        songs->append(song);
+      }
+    }
+
+    // Pad with invalid songs if the worker didn't answer.
+    while (songs->count() < first + expected) songs->append(Song());
+
+    reply->deleteLater();
+  }
+}
+
 bool TagReaderClient::SaveFileBlocking(const QString& filename,
                                        const Song& metadata) {
   Q_ASSERT(QThread::currentThread() != thread());
@@ -209,15 +397,22 @@ bool TagReaderClient::IsMediaFileBlocking(const QString& filename) {
 }
 
 QImage TagReaderClient::LoadEmbeddedArtBlocking(const QString& filename) {
+  QImage ret;
+  ret.loadFromData(LoadEmbeddedArtDataBlocking(filename));
+  return ret;
+}
+
+QByteArray TagReaderClient::LoadEmbeddedArtDataBlocking(
+    const QString& filename) {
   Q_ASSERT(QThread::currentThread() != thread());
 
-  QImage ret;
+  QByteArray ret;
 
   TagReaderReply* reply = LoadEmbeddedArt(filename);
   if (reply->WaitForFinished()) {
     const std::string& data_str =
         reply->message().load_embedded_art_response().data();
-    ret.loadFromData(QByteArray(data_str.data(), data_str.size()));
+    ret = QByteArray(data_str.data(), data_str.size());
   }
   reply->deleteLater();
 
@@ -22,11 +22,14 @@
 #define CORE_TAGREADERCLIENT_H_
 
 #include "song.h"
+#include "tagcache.h"
 #include "tagreadermessages.pb.h"
 #include "core/messagehandler.h"
 #include "core/workerpool.h"
 
+#include <QMutex>
 #include <QStringList>
+#include <QTimer>
 
 class QLocalServer;
 class QProcess;
@@ -36,15 +39,33 @@ class TagReaderClient : public QObject {
 
  public:
   explicit TagReaderClient(QObject* parent = nullptr);
+  ~TagReaderClient();
 
   typedef AbstractMessageHandler<pb::tagreader::Message> HandlerType;
   typedef HandlerType::ReplyType ReplyType;
 
   static const char* kWorkerExecutableName;
 
+  // The maximum number of files ReadFilesBlocking puts in each request.
+  // Requests are spread across the workers, so results come back a batch at
+  // a time instead of all at the end.
+  static const int kReadFilesBatchSize;
+
+  // How long after a file is read the tag cache is saved to disk.
+  static const int kSaveCacheDelayMs;
+
+  // A worker that hasn't replied to anything for this long is assumed to be
+  // stuck on a broken file, and is restarted.
+  static const int kWorkerTimeoutMs;
+
   void Start();
 
+  // Files that haven't changed since they were last read are answered from
+  // the tag cache without going to a worker.
   ReplyType* ReadFile(const QString& filename);
+  // Reads several files in one round-trip.  The response contains one
+  // SongMetadata for each filename, in the same order.
+  ReplyType* ReadFiles(const QStringList& filenames);
   ReplyType* SaveFile(const QString& filename, const Song& metadata);
   ReplyType* UpdateSongStatistics(const Song& metadata);
   ReplyType* UpdateSongRating(const Song& metadata);
@@ -58,11 +79,20 @@ class TagReaderClient : public QObject {
   // response.  These block the calling thread with a semaphore, and must NOT
   // be called from the TagReaderClient's thread.
   void ReadFileBlocking(const QString& filename, Song* song);
+  // Reads every file in filenames and replaces the contents of songs with one
+  // Song for each, in the same order.  Songs that couldn't be read are
+  // invalid.
+  void ReadFilesBlocking(const QStringList& filenames, SongList* songs);
   bool SaveFileBlocking(const QString& filename, const Song& metadata);
   bool UpdateSongStatisticsBlocking(const Song& metadata);
   bool UpdateSongRatingBlocking(const Song& metadata);
   bool IsMediaFileBlocking(const QString& filename);
   QImage LoadEmbeddedArtBlocking(const QString& filename);
+  // Returns the embedded image's encoded data, without decoding it.
+  QByteArray LoadEmbeddedArtDataBlocking(const QString& filename);
+
+  // Requests waiting for a free worker.  Can be called from any thread.
+  int queued_request_count() { return worker_pool_->queued_message_count(); }
 
   // TODO(David Sansome): Make this not a singleton
   static TagReaderClient* Instance() { return sInstance; }
@@ -73,12 +103,46 @@ class TagReaderClient : public QObject {
 
  private slots:
   void WorkerFailedToStart();
+  void LoadCache();
+  void SaveCache();
+  void StartQueuedReads();
+  void WorkerReadFinished(bool success);
+
+ private:
+  // A read of one or more files.  The ones that are in the tag cache are
+  // filled in straight away, the rest are sent to a worker.
+  struct PendingRead {
+    ReplyType* reply_;
+    bool single_file_;
+    // One for each file in the request.
+    QList<pb::tagreader::SongMetadata> metadata_;
+    QStringList worker_files_;
+    // Where each of worker_files_ goes in metadata_, and its key for the
+    // cache.
+    QList<int> worker_indices_;
+    QList<TagCache::FileKey> worker_keys_;
+  };
+
+  ReplyType* StartRead(const QStringList& filenames, bool single_file);
+  void FinishRead(const PendingRead& read);
+  static QString CachePath();
 
  private:
   static TagReaderClient* sInstance;
 
   WorkerPool<HandlerType>* worker_pool_;
   QList<pb::tagreader::Message> message_queue_;
+
+  TagCache cache_;
+  QTimer* save_cache_timer_;
+
+  // Reads are started from this object's thread, so callers can connect to
+  // the reply before it finishes.
+  QMutex queued_reads_mutex_;
+  QList<PendingRead> queued_reads_;
+
+  // Reads waiting for a worker, by the worker's reply.
+  QMap<ReplyType*, PendingRead> pending_reads_;
 };
 
 typedef TagReaderClient::ReplyType TagReaderReply;
@@ -20,31 +20,49 @@
 
 #include "taskmanager.h"
 
-TaskManager::TaskManager(QObject* parent) : QObject(parent), next_task_id_(1) {}
+#include <QTimer>
+
+const int TaskManager::kProgressIntervalMsec = 100;
+
+TaskManager::TaskManager(QObject* parent)
+    : QObject(parent),
+      next_task_id_(1),
+      finished_task_count_(0),
+      progress_changed_(0),
+      progress_timer_(new QTimer(this)) {
+  progress_timer_->setSingleShot(true);
+  progress_timer_->setInterval(kProgressIntervalMsec);
+  connect(progress_timer_, SIGNAL(timeout()), SLOT(EmitProgressChanged()));
+}
 
 int TaskManager::StartTask(const QString& name) {
-  Task t;
-  t.name = name;
-  t.progress = 0;
-  t.progress_max = 0;
-  t.blocks_library_scans = false;
+  TaskStatePtr state(new TaskState);
+  state->task.name = name;
+  state->task.progress = 0;
+  state->task.progress_max = 0;
+  state->task.blocks_library_scans = false;
 
   {
-    QMutexLocker l(&mutex_);
-    t.id = next_task_id_++;
-    tasks_[t.id] = t;
+    QWriteLocker l(&lock_);
+    state->task.id = next_task_id_++;
+    tasks_[state->task.id] = state;
   }
 
   emit TasksChanged();
-  return t.id;
+  return state->task.id;
 }
 
 QList<TaskManager::Task> TaskManager::GetTasks() {
   QList<TaskManager::Task> ret;
 
   {
-    QMutexLocker l(&mutex_);
-    ret = tasks_.values();
+    QReadLocker l(&lock_);
+    for (const TaskStatePtr& state : tasks_) {
+      Task t = state->task;
+      t.progress = state->progress.fetchAndAddRelaxed(0);
+      t.progress_max = state->progress_max.fetchAndAddRelaxed(0);
+      ret << t;
+    }
   }
 
   return ret;
@@ -52,11 +70,10 @@ QList<TaskManager::Task> TaskManager::GetTasks() {
 
 void TaskManager::SetTaskBlocksLibraryScans(int id) {
   {
-    QMutexLocker l(&mutex_);
+    QWriteLocker l(&lock_);
     if (!tasks_.contains(id)) return;
 
-    Task& t = tasks_[id];
-    t.blocks_library_scans = true;
+    tasks_[id]->task.blocks_library_scans = true;
   }
 
   emit TasksChanged();
@@ -65,41 +82,55 @@ void TaskManager::SetTaskBlocksLibraryScans(int id) {
 
 void TaskManager::SetTaskProgress(int id, int progress, int max) {
   {
-    QMutexLocker l(&mutex_);
-    if (!tasks_.contains(id)) return;
+    QReadLocker l(&lock_);
+    TaskStatePtr state = tasks_.value(id);
+    if (!state) return;
 
-    Task& t = tasks_[id];
-    t.progress = progress;
-    if (max) t.progress_max = max;
+    state->progress.fetchAndStoreRelaxed(progress);
+    if (max) state->progress_max.fetchAndStoreRelaxed(max);
   }
 
-  emit TasksChanged();
+  ProgressChanged();
 }
 
 void TaskManager::IncreaseTaskProgress(int id, int progress, int max) {
   {
-    QMutexLocker l(&mutex_);
-    if (!tasks_.contains(id)) return;
+    QReadLocker l(&lock_);
+    TaskStatePtr state = tasks_.value(id);
+    if (!state) return;
 
-    Task& t = tasks_[id];
-    t.progress += progress;
-    if (max) t.progress_max = max;
+    state->progress.fetchAndAddRelaxed(progress);
+    if (max) state->progress_max.fetchAndStoreRelaxed(max);
   }
 
-  emit TasksChanged();
+  ProgressChanged();
+}
+
+void TaskManager::ProgressChanged() {
+  // Only the first update since the last signal starts the timer.  The timer
+  // belongs to this object's thread, so it's started with a queued call.
+  if (progress_changed_.testAndSetOrdered(0, 1)) {
+    QMetaObject::invokeMethod(progress_timer_, "start", Qt::QueuedConnection);
+  }
+}
+
+void TaskManager::EmitProgressChanged() {
+  if (progress_changed_.testAndSetOrdered(1, 0)) {
+    emit TasksChanged();
+  }
 }
 
 void TaskManager::SetTaskFinished(int id) {
   bool resume_library_watchers = false;
 
   {
-    QMutexLocker l(&mutex_);
+    QWriteLocker l(&lock_);
     if (!tasks_.contains(id)) return;
 
-    if (tasks_[id].blocks_library_scans) {
+    if (tasks_[id]->task.blocks_library_scans) {
       resume_library_watchers = true;
-      for (const Task& task : tasks_.values()) {
-        if (task.id != id && task.blocks_library_scans) {
+      for (const TaskStatePtr& state : tasks_) {
+        if (state->task.id != id && state->task.blocks_library_scans) {
           resume_library_watchers = false;
           break;
         }
@@ -107,6 +138,7 @@ void TaskManager::SetTaskFinished(int id) {
     }
 
     tasks_.remove(id);
+    finished_task_count_++;
   }
 
   emit TasksChanged();
@@ -114,9 +146,18 @@ void TaskManager::SetTaskFinished(int id) {
 }
 
 int TaskManager::GetTaskProgress(int id) {
-  {
-    QMutexLocker l(&mutex_);
-    if (!tasks_.contains(id)) return 0;
-    return tasks_[id].progress;
-  }
+  QReadLocker l(&lock_);
+  TaskStatePtr state = tasks_.value(id);
+  if (!state) return 0;
+  return state->progress.fetchAndAddRelaxed(0);
+}
+
+int TaskManager::started_task_count() {
+  QReadLocker l(&lock_);
+  return next_task_id_ - 1;
+}
+
+int TaskManager::finished_task_count() {
+  QReadLocker l(&lock_);
+  return finished_task_count_;
 }
@@ -21,16 +21,28 @@
 #ifndef CORE_TASKMANAGER_H_
 #define CORE_TASKMANAGER_H_
 
+#include <memory>
+
+#include <QAtomicInt>
 #include <QMap>
-#include <QMutex>
 #include <QObject>
+#include <QReadWriteLock>
+
+class QTimer;
 
 class TaskManager : public QObject {
+  // Starting and finishing a task emits TasksChanged straight away, but
+  // progress updates only set a flag.  TasksChanged is emitted for them at
+  // most every kProgressIntervalMsec, so jobs that update their progress for
+  // every file don't flood the UI with signals from other threads.
+
   Q_OBJECT
 
  public:
   explicit TaskManager(QObject* parent = nullptr);
 
+  static const int kProgressIntervalMsec;
+
   struct Task {
     int id;
     QString name;
@@ -63,16 +75,40 @@ class TaskManager : public QObject {
   void SetTaskFinished(int id);
   int GetTaskProgress(int id);
 
+  // How many tasks have been started and finished since startup.
+  int started_task_count();
+  int finished_task_count();
+
  signals:
   void TasksChanged();
 
   void PauseLibraryWatchers();
   void ResumeLibraryWatchers();
 
+ private slots:
+  void EmitProgressChanged();
+
  private:
-  QMutex mutex_;
-  QMap<int, Task> tasks_;
+  struct TaskState {
+    Task task;
+
+    // Updated without taking the write lock.
+    QAtomicInt progress;
+    QAtomicInt progress_max;
+  };
+  typedef std::shared_ptr<TaskState> TaskStatePtr;
+
+  void ProgressChanged();
+
+  // Held for writing only while tasks are added or removed, so progress
+  // updates from different threads don't wait for each other.
+  QReadWriteLock lock_;
+  QMap<int, TaskStatePtr> tasks_;
   int next_task_id_;
+  int finished_task_count_;
+
+  QAtomicInt progress_changed_;
+  QTimer* progress_timer_;
 
   Q_DISABLE_COPY(TaskManager);
 };
@@ -0,0 +1,60 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_TRIPLEBUFFER_H_
+#define CORE_TRIPLEBUFFER_H_
+
+#include <QAtomicInt>
+
+// Hands the latest value from one writer thread to one reader thread without
+// either of them waiting for the other.  The writer fills in back() and calls
+// Publish(); the reader calls Update() and then looks at front().  Values the
+// reader didn't get round to are skipped, and neither side ever sees the
+// other's half-written or half-read value.  The three T's are reused, so a T
+// that holds containers keeps their allocations from one value to the next.
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() : back_(0), middle_(1), front_(2) {}
+
+  // Writer thread only.
+  T& back() { return buffers_[back_]; }
+  void Publish() {
+    back_ = middle_.fetchAndStoreOrdered(back_ | kNewFlag) & kIndexMask;
+  }
+
+  // Reader thread only.  Returns true if front() has changed.
+  bool Update() {
+    if (!(middle_.fetchAndAddAcquire(0) & kNewFlag)) return false;
+    front_ = middle_.fetchAndStoreOrdered(front_) & kIndexMask;
+    return true;
+  }
+  const T& front() const { return buffers_[front_]; }
+
+ private:
+  // middle_ is the index of the buffer that isn't being written or read, with
+  // kNewFlag set if it was published after the reader last took one.
+  static const int kIndexMask = 3;
+  static const int kNewFlag = 4;
+
+  T buffers_[3];
+  int back_;
+  QAtomicInt middle_;
+  int front_;
+};
+
+#endif  // CORE_TRIPLEBUFFER_H_
@@ -81,6 +81,20 @@ class UrlHandler : public QObject {
   virtual void TrackAboutToEnd() {}
   virtual void TrackSkipped() {}
 
+  // Called by the player for the next item in the playlist once the current
+  // track has been playing for a while, so the handler can start fetching it.
+  virtual void Prefetch(const QUrl&) {}
+
+  // Whether StartLoading can be called for tracks that aren't about to be
+  // played, and called again for the same track if it takes too long,
+  // without disturbing the track that is playing.
+  virtual bool CanResolveAhead() const { return false; }
+
+  // Whether a result that has expired can still be played while StartLoading
+  // is called again in the background, eg. for radio stations whose playlist
+  // hardly ever changes.  Only used if CanResolveAhead is also true.
+  virtual bool CanUseStaleResult() const { return false; }
+
  signals:
   void AsyncLoadComplete(const UrlHandler::LoadResult& result);
 };
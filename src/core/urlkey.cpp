@@ -0,0 +1,29 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "urlkey.h"
+
+UrlKey::UrlKey(const QUrl& url) : encoded_(url.toEncoded()) {
+  // 64-bit FNV-1a
+  quint64 hash = Q_UINT64_C(14695981039346656037);
+  const char* data = encoded_.constData();
+  for (int i = 0; i < encoded_.size(); ++i) {
+    hash ^= quint8(data[i]);
+    hash *= Q_UINT64_C(1099511628211);
+  }
+  hash_ = hash;
+}
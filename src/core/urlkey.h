@@ -0,0 +1,55 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CORE_URLKEY_H_
+#define CORE_URLKEY_H_
+
+#include <QByteArray>
+#include <QUrl>
+
+// A URL's identity, for comparing and hashing songs by URL.  It's worked out
+// once from the encoded form, which is what the library stores, and keeps a
+// 64-bit hash of it so most comparisons are one integer compare.  Copies
+// share the same bytes, so comparing a song's key with a copy of itself
+// doesn't even have to look at them.
+class UrlKey {
+ public:
+  UrlKey() : hash_(0) {}
+  explicit UrlKey(const QUrl& url);
+
+  bool isEmpty() const { return encoded_.isEmpty(); }
+  quint64 hash() const { return hash_; }
+  // The same as QUrl::toEncoded().
+  const QByteArray& encoded() const { return encoded_; }
+
+  bool operator==(const UrlKey& other) const {
+    return hash_ == other.hash_ &&
+           (encoded_.constData() == other.encoded_.constData() ||
+            encoded_ == other.encoded_);
+  }
+  bool operator!=(const UrlKey& other) const { return !(*this == other); }
+
+ private:
+  QByteArray encoded_;
+  quint64 hash_;
+};
+
+inline uint qHash(const UrlKey& key) {
+  return uint(key.hash() ^ (key.hash() >> 32));
+}
+
+#endif  // CORE_URLKEY_H_
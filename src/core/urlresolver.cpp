@@ -0,0 +1,248 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "urlresolver.h"
+
+#include <QTimer>
+
+#include "core/logging.h"
+
+const int UrlResolver::kCacheExpiryMsec = 15 * 60 * 1000;  // 15 minutes
+const int UrlResolver::kMaxCachedResults = 50;
+const int UrlResolver::kAttemptTimeoutMsec = 5000;
+const int UrlResolver::kMaxAttempts = 3;
+
+namespace {
+const int kTimeoutCheckIntervalMsec = 500;
+}
+
+UrlResolver::UrlResolver(QObject* parent)
+    : QObject(parent), timeout_timer_(new QTimer(this)) {
+  clock_.start();
+
+  timeout_timer_->setInterval(kTimeoutCheckIntervalMsec);
+  connect(timeout_timer_, SIGNAL(timeout()), SLOT(CheckTimeouts()));
+}
+
+UrlHandler::LoadResult UrlResolver::StartLoading(UrlHandler* handler,
+                                                 const QUrl& url) {
+  UrlHandler::LoadResult result(url);
+  if (Lookup(url, &result)) {
+    qLog(Debug) << "Using resolved URL for" << url;
+    return result;
+  }
+
+  // Play an old answer straight away, and resolve it again alongside for
+  // next time.
+  QHash<QUrl, CachedResult>::const_iterator stale = cache_.constFind(url);
+  if (stale != cache_.constEnd() && handler->CanResolveAhead() &&
+      handler->CanUseStaleResult()) {
+    qLog(Debug) << "Using old resolved URL for" << url;
+    result = stale->result_;
+    if (!pending_.contains(url)) Attempt(handler, url, false);
+    return result;
+  }
+
+  // It's being resolved already - wait for that instead of asking again.
+  if (pending_.contains(url)) {
+    pending_[url].wanted_ = true;
+    return UrlHandler::LoadResult(
+        url, UrlHandler::LoadResult::WillLoadAsynchronously);
+  }
+
+  return Attempt(handler, url, true);
+}
+
+void UrlResolver::ResolveAhead(UrlHandler* handler, const QUrl& url) {
+  if (!handler->CanResolveAhead()) return;
+  if (cache_.contains(url) || pending_.contains(url)) return;
+
+  Attempt(handler, url, false);
+}
+
+UrlHandler::LoadResult UrlResolver::Attempt(UrlHandler* handler,
+                                            const QUrl& url, bool wanted) {
+  const UrlHandler::LoadResult result = handler->StartLoading(url);
+
+  switch (result.type_) {
+    case UrlHandler::LoadResult::TrackAvailable:
+      if (handler->CanResolveAhead()) Remember(result);
+      break;
+
+    case UrlHandler::LoadResult::WillLoadAsynchronously: {
+      Pending& pending = pending_[url];
+      pending.handler_ = handler;
+      pending.attempts_ = 1;
+      pending.deadline_ = clock_.elapsed() + kAttemptTimeoutMsec;
+      pending.wanted_ = wanted;
+      outstanding_[url]++;
+
+      // Only handlers that can be asked more than once are timed out.
+      if (handler->CanResolveAhead() && !timeout_timer_->isActive()) {
+        timeout_timer_->start();
+      }
+      break;
+    }
+
+    case UrlHandler::LoadResult::NoMoreTracks:
+      break;
+  }
+
+  return result;
+}
+
+void UrlResolver::HandlerLoadComplete(const UrlHandler::LoadResult& result) {
+  const QUrl& url = result.original_url_;
+
+  QHash<QUrl, int>::iterator outstanding = outstanding_.find(url);
+  if (outstanding == outstanding_.end()) {
+    // Not one of ours, eg. the result of a LoadNext.
+    emit LoadComplete(result);
+    return;
+  }
+  if (--outstanding.value() <= 0) outstanding_.erase(outstanding);
+
+  if (!pending_.contains(url)) {
+    // Another attempt got there first, or we gave up on it.
+    return;
+  }
+
+  const Pending pending = pending_.take(url);
+  if (result.type_ == UrlHandler::LoadResult::TrackAvailable &&
+      pending.handler_->CanResolveAhead()) {
+    Remember(result);
+  }
+
+  if (pending.wanted_) emit LoadComplete(result);
+}
+
+void UrlResolver::CheckTimeouts() {
+  const qint64 now = clock_.elapsed();
+  bool any_left = false;
+
+  for (const QUrl& url : pending_.keys()) {
+    Pending& pending = pending_[url];
+    if (!pending.handler_->CanResolveAhead()) continue;
+    if (pending.deadline_ > now) {
+      any_left = true;
+      continue;
+    }
+
+    if (pending.attempts_ >= kMaxAttempts) {
+      qLog(Warning) << "Giving up resolving" << url << "after"
+                    << pending.attempts_ << "attempts";
+      const bool wanted = pending.wanted_;
+      pending_.remove(url);
+      if (wanted) {
+        emit LoadComplete(UrlHandler::LoadResult(url));
+      }
+      continue;
+    }
+
+    // Ask again and take whichever answer comes back first.
+    qLog(Debug) << "Resolving" << url << "is taking a while, trying again";
+    pending.attempts_++;
+    pending.deadline_ = now + kAttemptTimeoutMsec;
+
+    const UrlHandler::LoadResult result = pending.handler_->StartLoading(url);
+    if (!pending_.contains(url)) continue;
+
+    if (result.type_ == UrlHandler::LoadResult::WillLoadAsynchronously) {
+      outstanding_[url]++;
+      any_left = true;
+    } else {
+      // It answered straight away this time.
+      const bool wanted = pending_.take(url).wanted_;
+      if (result.type_ == UrlHandler::LoadResult::TrackAvailable) {
+        Remember(result);
+      }
+      if (wanted) emit LoadComplete(result);
+    }
+  }
+
+  if (!any_left) timeout_timer_->stop();
+}
+
+bool UrlResolver::Lookup(const QUrl& url,
+                         UrlHandler::LoadResult* result) const {
+  QHash<QUrl, CachedResult>::const_iterator it = cache_.constFind(url);
+  if (it == cache_.constEnd() || it->expires_ <= clock_.elapsed()) {
+    return false;
+  }
+
+  *result = it->result_;
+  return true;
+}
+
+void UrlResolver::Remember(const UrlHandler::LoadResult& result) {
+  const qint64 now = clock_.elapsed();
+
+  if (cache_.count() >= kMaxCachedResults) {
+    // Make room by dropping the expired results, or the oldest one if there
+    // aren't any.
+    QHash<QUrl, CachedResult>::iterator oldest = cache_.end();
+    for (QHash<QUrl, CachedResult>::iterator it = cache_.begin();
+         it != cache_.end();) {
+      if (it->expires_ <= now) {
+        it = cache_.erase(it);
+        continue;
+      }
+      if (oldest == cache_.end() || it->expires_ < oldest->expires_) {
+        oldest = it;
+      }
+      ++it;
+    }
+    if (cache_.count() >= kMaxCachedResults && oldest != cache_.end()) {
+      cache_.erase(oldest);
+    }
+  }
+
+  cache_[result.original_url_] = CachedResult(result, now + kCacheExpiryMsec);
+}
+
+void UrlResolver::ForgetMediaUrl(const QUrl& media_url) {
+  for (QHash<QUrl, CachedResult>::iterator it = cache_.begin();
+       it != cache_.end();) {
+    if (it->result_.media_url_ == media_url) {
+      it = cache_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void UrlResolver::RemoveHandler(UrlHandler* handler, const QString& scheme) {
+  for (QHash<QUrl, Pending>::iterator it = pending_.begin();
+       it != pending_.end();) {
+    if (it->handler_ == handler) {
+      outstanding_.remove(it.key());
+      it = pending_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  for (QHash<QUrl, CachedResult>::iterator it = cache_.begin();
+       it != cache_.end();) {
+    if (it.key().scheme() == scheme) {
+      it = cache_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
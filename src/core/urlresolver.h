@@ -0,0 +1,111 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef CORE_URLRESOLVER_H_
+#define CORE_URLRESOLVER_H_
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QUrl>
+
+#include "core/urlhandler.h"
+
+class QTimer;
+
+// Sits between the Player and the URL handlers.  It remembers the media URLs
+// that handlers returned for a while, so playing a track again or one that
+// was resolved ahead of time doesn't have to wait for the handler.  Handlers
+// that allow it are asked again if they take too long to answer, and the
+// first answer wins.
+class UrlResolver : public QObject {
+  Q_OBJECT
+
+ public:
+  explicit UrlResolver(QObject* parent = nullptr);
+
+  static const int kCacheExpiryMsec;
+  static const int kMaxCachedResults;
+  static const int kAttemptTimeoutMsec;
+  static const int kMaxAttempts;
+
+  // Like UrlHandler::StartLoading, but returns a remembered result straight
+  // away if there is one.  If the result is loaded asynchronously
+  // LoadComplete is emitted once for it later.
+  UrlHandler::LoadResult StartLoading(UrlHandler* handler, const QUrl& url);
+
+  // Starts resolving a track that will be played soon, if the handler
+  // allows it.  Nothing is emitted for the result.
+  void ResolveAhead(UrlHandler* handler, const QUrl& url);
+
+  // Returns true and fills in result if there's a remembered result for url.
+  bool Lookup(const QUrl& url, UrlHandler::LoadResult* result) const;
+
+  // Forgets the results that pointed to this media URL, eg. because it
+  // couldn't be played.
+  void ForgetMediaUrl(const QUrl& media_url);
+
+  // Forgets everything about a handler that's going away.  The scheme is
+  // passed in because the handler might already be destroyed.
+  void RemoveHandler(UrlHandler* handler, const QString& scheme);
+
+ public slots:
+  // Connected to the handlers' AsyncLoadComplete signals.
+  void HandlerLoadComplete(const UrlHandler::LoadResult& result);
+
+ signals:
+  void LoadComplete(const UrlHandler::LoadResult& result);
+
+ private slots:
+  void CheckTimeouts();
+
+ private:
+  struct Pending {
+    UrlHandler* handler_;
+    int attempts_;
+    qint64 deadline_;
+    // Whether the player is waiting for this one, rather than it being
+    // resolved ahead.
+    bool wanted_;
+  };
+
+  struct CachedResult {
+    CachedResult() : result_(QUrl()), expires_(0) {}
+    CachedResult(const UrlHandler::LoadResult& result, qint64 expires)
+        : result_(result), expires_(expires) {}
+
+    UrlHandler::LoadResult result_;
+    qint64 expires_;
+  };
+
+  UrlHandler::LoadResult Attempt(UrlHandler* handler, const QUrl& url,
+                                 bool wanted);
+  void Remember(const UrlHandler::LoadResult& result);
+
+ private:
+  QElapsedTimer clock_;
+  QTimer* timeout_timer_;
+
+  QHash<QUrl, Pending> pending_;
+  // Attempts that haven't answered yet.  Answers that come in after another
+  // attempt for the same URL won are dropped.
+  QHash<QUrl, int> outstanding_;
+  QHash<QUrl, CachedResult> cache_;
+};
+
+#endif  // CORE_URLRESOLVER_H_
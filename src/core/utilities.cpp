@@ -56,6 +56,7 @@
 
 #if defined(Q_OS_UNIX)
 #include <sys/statvfs.h>
+#include <unistd.h>
 #elif defined(Q_OS_WIN32)
 #include <windows.h>
 #include <QProcess>
@@ -67,6 +68,7 @@
 #endif
 #ifdef Q_OS_DARWIN
 #include <sys/resource.h>
+#include <sys/sysctl.h>
 #endif
 
 #ifdef Q_OS_DARWIN
@@ -212,6 +214,24 @@ quint64 FileSystemFreeSpace(const QString& path) {
   return 0;
 }
 
+quint64 PhysicalMemory() {
+#if defined(Q_OS_DARWIN)
+  quint64 ret = 0;
+  size_t size = sizeof(ret);
+  if (sysctlbyname("hw.memsize", &ret, &size, nullptr, 0) == 0) return ret;
+#elif defined(Q_OS_UNIX)
+  const long pages = sysconf(_SC_PHYS_PAGES);
+  const long page_size = sysconf(_SC_PAGE_SIZE);
+  if (pages > 0 && page_size > 0) return quint64(pages) * quint64(page_size);
+#elif defined(Q_OS_WIN32)
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+  if (GlobalMemoryStatusEx(&status)) return status.ullTotalPhys;
+#endif
+
+  return 0;
+}
+
 QString MakeTempDir(const QString template_name) {
   QString path;
   {
@@ -331,6 +351,61 @@ bool Copy(QIODevice* source, QIODevice* destination) {
   return true;
 }
 
+bool CopyLocalFile(const QString& source, const QString& destination) {
+  static const qint64 kBufferSize = 1024 * 1024;  // 1MB
+
+  QFile src(source);
+  QFile dest(destination);
+  if (dest.exists()) return false;
+  if (!src.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) return false;
+  if (!dest.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) return false;
+
+  bool copied = false;
+  bool ok = true;
+
+#if defined(Q_OS_LINUX) && defined(__NR_copy_file_range)
+  // Let the kernel move the data without copying it through userspace.  This
+  // fails straight away with nothing copied on kernels or filesystems that
+  // don't support it, in which case we fall back to reading and writing.
+  qint64 remaining = src.size();
+  qint64 total_copied = 0;
+  while (remaining > 0) {
+    const qint64 count = syscall(__NR_copy_file_range, src.handle(), nullptr,
+                                 dest.handle(), nullptr, remaining, 0);
+    if (count <= 0) break;
+    remaining -= count;
+    total_copied += count;
+  }
+  if (remaining == 0) {
+    copied = true;
+  } else if (total_copied > 0) {
+    ok = false;
+  }
+#endif
+
+  if (!copied && ok) {
+    std::unique_ptr<char[]> buffer(new char[kBufferSize]);
+    forever {
+      const qint64 bytes_read = src.read(buffer.get(), kBufferSize);
+      if (bytes_read == 0) break;
+      if (bytes_read < 0 ||
+          dest.write(buffer.get(), bytes_read) != bytes_read) {
+        ok = false;
+        break;
+      }
+    }
+  }
+
+  dest.close();
+  if (!ok) {
+    dest.remove();
+    return false;
+  }
+
+  dest.setPermissions(src.permissions());
+  return true;
+}
+
 QString ColorToRgba(const QColor& c) {
   return QString("rgba(%1, %2, %3, %4)")
       .arg(c.red())
@@ -383,6 +458,9 @@ QString GetConfigPath(ConfigPath config) {
     case Path_MoodbarCache:
       return GetConfigPath(Path_CacheRoot) + "/moodbarcache";
 
+    case Path_StreamCache:
+      return GetConfigPath(Path_CacheRoot) + "/streamcache";
+
     case Path_GstreamerRegistry:
       return GetConfigPath(Path_Root) +
              QString("/gst-registry-%1-bin")
@@ -53,6 +53,8 @@ QString ColorToRgba(const QColor& color);
 
 quint64 FileSystemCapacity(const QString& path);
 quint64 FileSystemFreeSpace(const QString& path);
+// The amount of RAM in the machine, or 0 if it can't be found out.
+quint64 PhysicalMemory();
 
 QString MakeTempDir(const QString template_name = QString());
 QString GetTemporaryFileName();
@@ -61,6 +63,9 @@ QString SaveToTemporaryFile(const QByteArray& data);
 bool RemoveRecursive(const QString& path);
 bool CopyRecursive(const QString& source, const QString& destination);
 bool Copy(QIODevice* source, QIODevice* destination);
+// Like QFile::copy, but uses copy_file_range() where the kernel supports it
+// and large buffers otherwise.
+bool CopyLocalFile(const QString& source, const QString& destination);
 
 void OpenInFileBrowser(const QList<QUrl>& filenames);
 
@@ -134,6 +139,7 @@ enum ConfigPath {
   Path_LocalSpotifyBlob,
   Path_MoodbarCache,
   Path_CacheRoot,
+  Path_StreamCache,
 };
 QString GetConfigPath(ConfigPath config);
 
@@ -0,0 +1,179 @@
+/* This file is part of Clementine.
+   Copyright 2010-2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "albumcovercache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+
+#include "core/song.h"
+#include "core/utilities.h"
+
+const int AlbumCoverCache::kMemoryCacheSize = 32 * 1024 * 1024;  // 32MB
+const qint64 AlbumCoverCache::kDiskCacheSize = 100 * 1024 * 1024;  // 100MB
+
+namespace {
+
+// Only check the size of the disk cache every so often
+const int kInsertsPerPrune = 100;
+
+}  // namespace
+
+AlbumCoverCache::AlbumCoverCache()
+    : memory_(kMemoryCacheSize),
+      disk_dir_(Utilities::GetConfigPath(Utilities::Path_CacheRoot) +
+                "/covercache"),
+      inserts_since_prune_(0),
+      hits_(0),
+      misses_(0) {
+  QDir().mkpath(disk_dir_);
+}
+
+QString AlbumCoverCache::Key(const AlbumCoverLoaderOptions& options,
+                             const QString& art_path,
+                             const QString& song_filename) {
+  // Unscaled covers are as big as the originals, don't keep those.
+  if (!options.scale_output_image_ || art_path.isEmpty() ||
+      art_path == Song::kManuallyUnsetCover) {
+    return QString();
+  }
+
+  QString source = art_path;
+  QString local_file = art_path;
+  if (art_path == Song::kEmbeddedCover) {
+    if (song_filename.isEmpty()) return QString();
+    source = "embedded:" + song_filename;
+    local_file = song_filename;
+  }
+
+  // Remote covers don't change under the same URL
+  uint mtime = 0;
+  if (!local_file.contains("://")) {
+    const QFileInfo info(local_file);
+    if (!info.exists()) return QString();
+    mtime = info.lastModified().toTime_t();
+  }
+
+  return QString("%1:%2:%3:%4")
+      .arg(options.desired_height_)
+      .arg(options.pad_output_image_ ? 1 : 0)
+      .arg(mtime)
+      .arg(source);
+}
+
+QString AlbumCoverCache::ContentKey(const AlbumCoverLoaderOptions& options,
+                                    const QByteArray& data) {
+  if (!options.scale_output_image_ || data.isEmpty()) return QString();
+
+  return QString("%1:%2:content:%3")
+      .arg(options.desired_height_)
+      .arg(options.pad_output_image_ ? 1 : 0)
+      .arg(QString::fromLatin1(
+          QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex()));
+}
+
+QString AlbumCoverCache::DiskFilename(const QString& key) const {
+  return disk_dir_ + "/" +
+         QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1)
+             .toHex() +
+         ".png";
+}
+
+bool AlbumCoverCache::Find(const QString& key, QImage* image) {
+  if (key.isEmpty()) return false;
+
+  {
+    QMutexLocker l(&mutex_);
+    QImage* cached = memory_.object(key);
+    if (cached) {
+      *image = *cached;
+      ++hits_;
+      return true;
+    }
+  }
+
+  QImage loaded(DiskFilename(key), "PNG");
+
+  QMutexLocker l(&mutex_);
+  if (loaded.isNull()) {
+    ++misses_;
+    return false;
+  }
+
+  memory_.insert(key, new QImage(loaded), loaded.byteCount());
+  *image = loaded;
+  ++hits_;
+  return true;
+}
+
+void AlbumCoverCache::GetHitCounts(int* hits, int* misses) {
+  QMutexLocker l(&mutex_);
+  *hits = hits_;
+  *misses = misses_;
+}
+
+qint64 AlbumCoverCache::memory_usage() {
+  QMutexLocker l(&mutex_);
+  return memory_.totalCost();
+}
+
+void AlbumCoverCache::Insert(const QString& key, const QImage& image) {
+  if (key.isEmpty() || image.isNull()) return;
+
+  bool prune = false;
+  {
+    QMutexLocker l(&mutex_);
+    if (memory_.contains(key)) return;
+    memory_.insert(key, new QImage(image), image.byteCount());
+
+    if (++inserts_since_prune_ >= kInsertsPerPrune) {
+      inserts_since_prune_ = 0;
+      prune = true;
+    }
+  }
+
+  // Write it under a temporary name so a reader never sees half a file
+  const QString filename = DiskFilename(key);
+  if (!QFile::exists(filename)) {
+    const QString temp_filename = filename + ".tmp";
+    if (image.save(temp_filename, "PNG") &&
+        !QFile::rename(temp_filename, filename)) {
+      QFile::remove(temp_filename);
+    }
+  }
+
+  if (prune) PruneDisk();
+}
+
+void AlbumCoverCache::PruneDisk() {
+  QDir dir(disk_dir_);
+  const QFileInfoList files =
+      dir.entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+
+  qint64 total = 0;
+  for (const QFileInfo& info : files) {
+    total += info.size();
+  }
+
+  // Delete the oldest thumbnails first
+  for (const QFileInfo& info : files) {
+    if (total <= kDiskCacheSize) break;
+    if (QFile::remove(info.absoluteFilePath())) total -= info.size();
+  }
+}
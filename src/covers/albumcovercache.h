@@ -0,0 +1,74 @@
+/* This file is part of Clementine.
+   Copyright 2010-2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COVERS_ALBUMCOVERCACHE_H_
+#define COVERS_ALBUMCOVERCACHE_H_
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QString>
+
+#include "albumcoverloaderoptions.h"
+
+// Scaled album covers, shared by everything that loads art through
+// AlbumCoverLoader.  Recently used images are kept in memory, up to
+// kMemoryCacheSize bytes, and every image is also written to a thumbnail
+// directory on disk so it doesn't have to be loaded and scaled again next
+// time.  Safe to use from any thread.
+class AlbumCoverCache {
+ public:
+  AlbumCoverCache();
+
+  static const int kMemoryCacheSize;
+  static const qint64 kDiskCacheSize;
+
+  // Returns the key for the cover at art_path scaled with these options, or
+  // an empty string if the result shouldn't be cached.  Local files and
+  // embedded covers include the file's modification time, so changing the
+  // cover invalidates the entry.
+  static QString Key(const AlbumCoverLoaderOptions& options,
+                     const QString& art_path, const QString& song_filename);
+
+  // Returns the key for an encoded image scaled with these options.  Every
+  // track of an album usually embeds the same picture, this lets them share
+  // one scaled copy.
+  static QString ContentKey(const AlbumCoverLoaderOptions& options,
+                            const QByteArray& data);
+
+  bool Find(const QString& key, QImage* image);
+  void Insert(const QString& key, const QImage& image);
+
+  // How many lookups found an image, in memory or on disk, and how many
+  // didn't.
+  void GetHitCounts(int* hits, int* misses);
+  // Bytes of images held in memory.
+  qint64 memory_usage();
+
+ private:
+  QString DiskFilename(const QString& key) const;
+  void PruneDisk();
+
+  QMutex mutex_;
+  QCache<QString, QImage> memory_;
+  QString disk_dir_;
+  int inserts_since_prune_;
+  int hits_;
+  int misses_;
+};
+
+#endif  // COVERS_ALBUMCOVERCACHE_H_
@@ -30,27 +30,53 @@ const int AlbumCoverExporter::kMaxConcurrentRequests = 3;
 AlbumCoverExporter::AlbumCoverExporter(QObject* parent)
     : QObject(parent),
       thread_pool_(new QThreadPool(this)),
+      no_cover_(0),
       exported_(0),
       skipped_(0),
       all_(0) {
   thread_pool_->setMaxThreadCount(kMaxConcurrentRequests);
 }
 
+AlbumCoverExporter::~AlbumCoverExporter() { qDeleteAll(requests_); }
+
 void AlbumCoverExporter::SetDialogResult(
     const AlbumCoverExport::DialogResult& dialog_result) {
   dialog_result_ = dialog_result;
 }
 
+void AlbumCoverExporter::SetMaxConcurrentRequests(int count) {
+  thread_pool_->setMaxThreadCount(qMax(1, count));
+}
+
 void AlbumCoverExporter::AddExportRequest(Song song) {
-  requests_.append(new CoverExportRunnable(dialog_result_, song));
-  all_ = requests_.count();
+  if (CoverExportRunnable::GetCoverPath(dialog_result_, song).isEmpty()) {
+    no_cover_++;
+  } else {
+    const QString destination =
+        CoverExportRunnable::GetDestinationPath(dialog_result_, song);
+    if (destinations_.contains(destination)) return;
+
+    destinations_.insert(destination);
+    requests_.append(new CoverExportRunnable(dialog_result_, song));
+  }
+  all_ = requests_.count() + no_cover_;
 }
 
-void AlbumCoverExporter::Cancel() { requests_.clear(); }
+void AlbumCoverExporter::Cancel() {
+  qDeleteAll(requests_);
+  requests_.clear();
+}
 
 void AlbumCoverExporter::StartExporting() {
   exported_ = 0;
-  skipped_ = 0;
+  skipped_ = no_cover_;
+  no_cover_ = 0;
+  destinations_.clear();
+
+  if (requests_.isEmpty()) {
+    emit AlbumCoversExportUpdate(exported_, skipped_, all_);
+    return;
+  }
   AddJobsToPool();
 }
 
@@ -25,25 +25,32 @@
 
 #include <QObject>
 #include <QQueue>
+#include <QSet>
 #include <QTimer>
 
 class QThreadPool;
 
 class AlbumCoverExporter : public QObject {
+  // Albums that would export their cover to the same file are only exported
+  // once, and albums without a cover to export are skipped before any jobs
+  // are started.
+
   Q_OBJECT
 
  public:
   explicit AlbumCoverExporter(QObject* parent = nullptr);
-  virtual ~AlbumCoverExporter() {}
+  virtual ~AlbumCoverExporter();
 
   static const int kMaxConcurrentRequests;
 
   void SetDialogResult(const AlbumCoverExport::DialogResult& dialog_result);
+  // How many covers are read and written at the same time.
+  void SetMaxConcurrentRequests(int count);
   void AddExportRequest(Song song);
   void StartExporting();
   void Cancel();
 
-  int request_count() { return requests_.size(); }
+  int request_count() { return all_; }
 
  signals:
   void AlbumCoversExportUpdate(int exported, int skipped, int all);
@@ -57,8 +64,10 @@ class AlbumCoverExporter : public QObject {
   AlbumCoverExport::DialogResult dialog_result_;
 
   QQueue<CoverExportRunnable*> requests_;
+  QSet<QString> destinations_;
   QThreadPool* thread_pool_;
 
+  int no_cover_;
   int exported_;
   int skipped_;
   int all_;
@@ -20,12 +20,22 @@
 
 #include "albumcoverfetcher.h"
 
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
 #include <QTimer>
 
 #include "albumcoverfetchersearch.h"
+#include "core/logging.h"
 #include "core/network.h"
+#include "core/utilities.h"
 
-const int AlbumCoverFetcher::kMaxConcurrentRequests = 5;
+// Requests aren't limited much here any more - each provider limits how many
+// of its own searches can run at once.
+const int AlbumCoverFetcher::kMaxConcurrentRequests = 10;
+const int AlbumCoverFetcher::kNegativeCacheDays = 30;
 
 AlbumCoverFetcher::AlbumCoverFetcher(CoverProviders* cover_providers,
                                      QObject* parent,
@@ -34,17 +44,20 @@ AlbumCoverFetcher::AlbumCoverFetcher(CoverProviders* cover_providers,
       cover_providers_(cover_providers),
       network_(network ? network : new NetworkAccessManager(this)),
       next_id_(0),
-      request_starter_(new QTimer(this)) {
+      request_starter_(new QTimer(this)),
+      negative_cache_loaded_(false) {
   request_starter_->setInterval(1000);
   connect(request_starter_, SIGNAL(timeout()), SLOT(StartRequests()));
 }
 
 quint64 AlbumCoverFetcher::FetchAlbumCover(const QString& artist,
-                                           const QString& album) {
+                                           const QString& album,
+                                           bool skip_known_missing) {
   CoverSearchRequest request;
   request.artist = artist;
   request.album = album;
   request.search = false;
+  request.skip_known_missing = skip_known_missing;
   request.id = next_id_++;
 
   AddRequest(request);
@@ -57,13 +70,43 @@ quint64 AlbumCoverFetcher::SearchForCovers(const QString& artist,
   request.artist = artist;
   request.album = album;
   request.search = true;
+  request.skip_known_missing = false;
   request.id = next_id_++;
 
   AddRequest(request);
   return request.id;
 }
 
+QString AlbumCoverFetcher::AlbumKey(const QString& artist,
+                                    const QString& album) {
+  return artist.toLower() + '\t' + album.toLower();
+}
+
+QString AlbumCoverFetcher::RequestKey(const CoverSearchRequest& req) {
+  return QString(req.search ? "s\t" : "f\t") + AlbumKey(req.artist, req.album);
+}
+
 void AlbumCoverFetcher::AddRequest(const CoverSearchRequest& req) {
+  if (req.skip_known_missing) {
+    LoadNegativeCache();
+    if (known_missing_.contains(AlbumKey(req.artist, req.album))) {
+      // Answer later so the caller has a chance to remember the ID first.
+      if (negative_hits_.isEmpty()) {
+        QTimer::singleShot(0, this, SLOT(SendNegativeHits()));
+      }
+      negative_hits_ << req.id;
+      return;
+    }
+  }
+
+  const QString key = RequestKey(req);
+  if (request_ids_by_key_.contains(key)) {
+    duplicate_ids_.insert(request_ids_by_key_[key], req.id);
+    return;
+  }
+  request_ids_by_key_[key] = req.id;
+  requests_by_id_[req.id] = req;
+
   queued_requests_.enqueue(req);
 
   if (!request_starter_->isActive()) request_starter_->start();
@@ -79,6 +122,11 @@ void AlbumCoverFetcher::Clear() {
     search->deleteLater();
   }
   active_requests_.clear();
+
+  requests_by_id_.clear();
+  request_ids_by_key_.clear();
+  duplicate_ids_.clear();
+  negative_hits_.clear();
 }
 
 void AlbumCoverFetcher::StartRequests() {
@@ -106,6 +154,14 @@ void AlbumCoverFetcher::StartRequests() {
   }
 }
 
+QList<quint64> AlbumCoverFetcher::TakeDuplicates(quint64 request_id) {
+  request_ids_by_key_.remove(RequestKey(requests_by_id_.take(request_id)));
+
+  QList<quint64> ret = duplicate_ids_.values(request_id);
+  duplicate_ids_.remove(request_id);
+  return ret;
+}
+
 void AlbumCoverFetcher::SingleSearchFinished(quint64 request_id,
                                              CoverSearchResults results) {
   AlbumCoverFetcherSearch* search = active_requests_.take(request_id);
@@ -113,6 +169,13 @@ void AlbumCoverFetcher::SingleSearchFinished(quint64 request_id,
 
   search->deleteLater();
   emit SearchFinished(request_id, results, search->statistics());
+
+  // Duplicates didn't cost anything, so they get empty statistics.
+  for (quint64 id : TakeDuplicates(request_id)) {
+    emit SearchFinished(id, results, CoverSearchStatistics());
+  }
+
+  StartRequests();
 }
 
 void AlbumCoverFetcher::SingleCoverFetched(quint64 request_id,
@@ -120,6 +183,101 @@ void AlbumCoverFetcher::SingleCoverFetched(quint64 request_id,
   AlbumCoverFetcherSearch* search = active_requests_.take(request_id);
   if (!search) return;
 
+  if (image.isNull()) {
+    AddToNegativeCache(requests_by_id_[request_id]);
+  }
+
   search->deleteLater();
   emit AlbumCoverFetched(request_id, image, search->statistics());
+
+  CoverSearchStatistics duplicate_statistics;
+  if (image.isNull()) {
+    duplicate_statistics.missing_images_ = 1;
+  } else {
+    duplicate_statistics.chosen_images_ = 1;
+    duplicate_statistics.chosen_width_ = image.width();
+    duplicate_statistics.chosen_height_ = image.height();
+  }
+  for (quint64 id : TakeDuplicates(request_id)) {
+    emit AlbumCoverFetched(id, image, duplicate_statistics);
+  }
+
+  StartRequests();
+}
+
+void AlbumCoverFetcher::SendNegativeHits() {
+  CoverSearchStatistics statistics;
+  statistics.missing_images_ = 1;
+  statistics.known_missing_images_ = 1;
+
+  for (quint64 id : negative_hits_) {
+    emit AlbumCoverFetched(id, QImage(), statistics);
+  }
+  negative_hits_.clear();
+}
+
+QString AlbumCoverFetcher::NegativeCachePath() const {
+  return Utilities::GetConfigPath(Utilities::Path_CacheRoot) + "/nocovers";
+}
+
+void AlbumCoverFetcher::LoadNegativeCache() {
+  if (negative_cache_loaded_) return;
+  negative_cache_loaded_ = true;
+
+  QFile file(NegativeCachePath());
+  if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) return;
+
+  // Each line is "time<tab>artist<tab>album", all lowercase.
+  const uint cutoff =
+      QDateTime::currentDateTime().toTime_t() - kNegativeCacheDays * 24 * 3600;
+  QStringList fresh_lines;
+  bool expired = false;
+
+  QTextStream in(&file);
+  in.setCodec("UTF-8");
+  while (!in.atEnd()) {
+    const QString line = in.readLine();
+    const int tab = line.indexOf('\t');
+    if (tab == -1 || line.left(tab).toUInt() < cutoff) {
+      expired = true;
+      continue;
+    }
+
+    known_missing_.insert(line.mid(tab + 1));
+    fresh_lines << line;
+  }
+  file.close();
+
+  if (!expired) return;
+
+  // Drop the expired entries so the file doesn't grow forever.
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate |
+                 QIODevice::Text)) {
+    qLog(Warning) << "Couldn't rewrite" << file.fileName();
+    return;
+  }
+  QTextStream out(&file);
+  out.setCodec("UTF-8");
+  for (const QString& line : fresh_lines) {
+    out << line << '\n';
+  }
+}
+
+void AlbumCoverFetcher::AddToNegativeCache(const CoverSearchRequest& req) {
+  LoadNegativeCache();
+
+  const QString key = AlbumKey(req.artist, req.album);
+  if (known_missing_.contains(key)) return;
+  known_missing_.insert(key);
+
+  QDir().mkpath(Utilities::GetConfigPath(Utilities::Path_CacheRoot));
+  QFile file(NegativeCachePath());
+  if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+    qLog(Warning) << "Couldn't write to" << file.fileName();
+    return;
+  }
+
+  QTextStream out(&file);
+  out.setCodec("UTF-8");
+  out << QDateTime::currentDateTime().toTime_t() << '\t' << key << '\n';
 }
@@ -29,7 +29,9 @@
 #include <QMetaType>
 #include <QNetworkAccessManager>
 #include <QObject>
+#include <QMultiHash>
 #include <QQueue>
+#include <QSet>
 #include <QUrl>
 
 class QNetworkReply;
@@ -51,6 +53,9 @@ struct CoverSearchRequest {
   // is this only a search request or should we also fetch the first
   // cover that's found?
   bool search;
+
+  // should albums that an earlier fetch found no cover for be skipped?
+  bool skip_known_missing;
 };
 
 // This structure represents a single result of some album's cover search
@@ -86,9 +91,15 @@ class AlbumCoverFetcher : public QObject {
   virtual ~AlbumCoverFetcher() {}
 
   static const int kMaxConcurrentRequests;
+  static const int kNegativeCacheDays;
 
   quint64 SearchForCovers(const QString& artist, const QString& album);
-  quint64 FetchAlbumCover(const QString& artist, const QString& album);
+
+  // If skip_known_missing is set and a previous fetch found no cover for this
+  // album in the last kNegativeCacheDays days, AlbumCoverFetched is emitted
+  // with a null image without asking any providers.
+  quint64 FetchAlbumCover(const QString& artist, const QString& album,
+                          bool skip_known_missing = false);
 
   void Clear();
 
@@ -102,10 +113,19 @@ class AlbumCoverFetcher : public QObject {
   void SingleSearchFinished(quint64, CoverSearchResults results);
   void SingleCoverFetched(quint64, const QImage& cover);
   void StartRequests();
+  void SendNegativeHits();
 
  private:
   void AddRequest(const CoverSearchRequest& req);
 
+  static QString RequestKey(const CoverSearchRequest& req);
+  static QString AlbumKey(const QString& artist, const QString& album);
+  QList<quint64> TakeDuplicates(quint64 request_id);
+
+  QString NegativeCachePath() const;
+  void LoadNegativeCache();
+  void AddToNegativeCache(const CoverSearchRequest& req);
+
   CoverProviders* cover_providers_;
   QNetworkAccessManager* network_;
   quint64 next_id_;
@@ -113,6 +133,16 @@ class AlbumCoverFetcher : public QObject {
   QQueue<CoverSearchRequest> queued_requests_;
   QHash<quint64, AlbumCoverFetcherSearch*> active_requests_;
 
+  // Identical requests made while one is in flight are answered together.
+  QHash<quint64, CoverSearchRequest> requests_by_id_;
+  QHash<QString, quint64> request_ids_by_key_;
+  QMultiHash<quint64, quint64> duplicate_ids_;
+
+  // Albums that a recent fetch didn't find a cover for.
+  bool negative_cache_loaded_;
+  QSet<QString> known_missing_;
+  QList<quint64> negative_hits_;
+
   QTimer* request_starter_;
 };
 
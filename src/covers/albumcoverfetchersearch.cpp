@@ -44,43 +44,89 @@ AlbumCoverFetcherSearch::AlbumCoverFetcherSearch(
     QObject* parent)
     : QObject(parent),
       request_(request),
+      cover_providers_(nullptr),
+      timeout_started_(false),
       image_load_timeout_(new NetworkTimeouts(kImageLoadTimeoutMs, this)),
       network_(network),
-      cancel_requested_(false) {
-  // we will terminate the search after kSearchTimeoutMs miliseconds if we are
-  // not
-  // able to find all of the results before that point in time
-  QTimer::singleShot(kSearchTimeoutMs, this, SLOT(TerminateSearch()));
-}
+      cancel_requested_(false) {}
 
 void AlbumCoverFetcherSearch::TerminateSearch() {
   for (int id : pending_requests_.keys()) {
-    pending_requests_.take(id)->CancelSearch(id);
+    CoverProvider* provider = pending_requests_.take(id);
+    provider->CancelSearch(id);
+    provider->ReleaseSearchSlot();
   }
+  waiting_providers_.clear();
 
   AllProvidersFinished();
 }
 
 void AlbumCoverFetcherSearch::Start(CoverProviders* cover_providers) {
+  cover_providers_ = cover_providers;
+
   for (CoverProvider* provider : cover_providers->List()) {
     connect(provider, SIGNAL(SearchFinished(int, QList<CoverSearchResult>)),
             SLOT(ProviderSearchFinished(int, QList<CoverSearchResult>)));
-    const int id = cover_providers->NextId();
-    const bool success =
-        provider->StartSearch(request_.artist, request_.album, id);
 
-    if (success) {
-      pending_requests_[id] = provider;
-      statistics_.network_requests_made_++;
+    // Providers that are already running as many searches as they allow are
+    // started later, when one of their other searches finishes.
+    if (!provider->TryAcquireSearchSlot()) {
+      waiting_providers_ << provider;
+      connect(provider, SIGNAL(SearchSlotFreed()),
+              SLOT(StartWaitingProviders()), Qt::UniqueConnection);
+      continue;
     }
+
+    StartProvider(provider);
   }
 
   // end this search before it even began if there are no providers...
-  if (pending_requests_.isEmpty()) {
+  if (pending_requests_.isEmpty() && waiting_providers_.isEmpty()) {
     TerminateSearch();
   }
 }
 
+bool AlbumCoverFetcherSearch::StartProvider(CoverProvider* provider) {
+  // we will terminate the search after kSearchTimeoutMs miliseconds if we are
+  // not able to find all of the results before that point in time.  The clock
+  // starts with the first provider, not while we're queued behind others.
+  if (!timeout_started_) {
+    timeout_started_ = true;
+    QTimer::singleShot(kSearchTimeoutMs, this, SLOT(TerminateSearch()));
+  }
+
+  const int id = cover_providers_->NextId();
+  const bool success =
+      provider->StartSearch(request_.artist, request_.album, id);
+
+  if (success) {
+    pending_requests_[id] = provider;
+    statistics_.network_requests_made_++;
+    statistics_.network_requests_by_provider_[provider->name()]++;
+  } else {
+    provider->ReleaseSearchSlot();
+  }
+  return success;
+}
+
+void AlbumCoverFetcherSearch::StartWaitingProviders() {
+  if (cancel_requested_ || waiting_providers_.isEmpty()) return;
+
+  for (int i = 0; i < waiting_providers_.count(); ++i) {
+    CoverProvider* provider = waiting_providers_[i];
+    if (!provider->TryAcquireSearchSlot()) continue;
+
+    waiting_providers_.removeAt(i--);
+    disconnect(provider, SIGNAL(SearchSlotFreed()), this,
+               SLOT(StartWaitingProviders()));
+    StartProvider(provider);
+  }
+
+  if (pending_requests_.isEmpty() && waiting_providers_.isEmpty()) {
+    AllProvidersFinished();
+  }
+}
+
 static bool CompareProviders(const CoverSearchResult& a,
                              const CoverSearchResult& b) {
   return a.provider < b.provider;
@@ -91,6 +137,7 @@ void AlbumCoverFetcherSearch::ProviderSearchFinished(
   if (!pending_requests_.contains(id)) return;
 
   CoverProvider* provider = pending_requests_.take(id);
+  provider->ReleaseSearchSlot();
 
   CoverSearchResults results_copy(results);
   // Set categories on the results
@@ -103,7 +150,7 @@ void AlbumCoverFetcherSearch::ProviderSearchFinished(
   statistics_.total_images_by_provider_[provider->name()]++;
 
   // do we have more providers left?
-  if (!pending_requests_.isEmpty()) {
+  if (!pending_requests_.isEmpty() || !waiting_providers_.isEmpty()) {
     return;
   }
 
@@ -159,6 +206,7 @@ void AlbumCoverFetcherSearch::FetchMoreImages() {
     image_load_timeout_->AddReply(image_reply);
 
     statistics_.network_requests_made_++;
+    statistics_.network_requests_by_provider_[result.provider]++;
   }
 
   if (pending_image_loads_.isEmpty()) {
@@ -248,7 +296,7 @@ void AlbumCoverFetcherSearch::SendBestImage() {
 void AlbumCoverFetcherSearch::Cancel() {
   cancel_requested_ = true;
 
-  if (!pending_requests_.isEmpty()) {
+  if (!pending_requests_.isEmpty() || !waiting_providers_.isEmpty()) {
     TerminateSearch();
   } else if (!pending_image_loads_.isEmpty()) {
     for (RedirectFollower* reply : pending_image_loads_.keys()) {
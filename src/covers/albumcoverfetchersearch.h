@@ -62,8 +62,10 @@ class AlbumCoverFetcherSearch : public QObject {
   void ProviderSearchFinished(int id, const QList<CoverSearchResult>& results);
   void ProviderCoverFetchFinished(RedirectFollower* reply);
   void TerminateSearch();
+  void StartWaitingProviders();
 
  private:
+  bool StartProvider(CoverProvider* provider);
   void AllProvidersFinished();
 
   void FetchMoreImages();
@@ -84,7 +86,13 @@ class AlbumCoverFetcherSearch : public QObject {
   // Complete results (from all of the available providers).
   CoverSearchResults results_;
 
+  CoverProviders* cover_providers_;
   QMap<int, CoverProvider*> pending_requests_;
+
+  // Providers that were busy with other searches when this one started
+  QList<CoverProvider*> waiting_providers_;
+  bool timeout_started_;
+
   QMap<RedirectFollower*, QString> pending_image_loads_;
   NetworkTimeouts* image_load_timeout_;
 
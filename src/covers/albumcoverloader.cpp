@@ -21,9 +21,13 @@
 
 #include "albumcoverloader.h"
 
+#include <QBuffer>
 #include <QPainter>
 #include <QDir>
 #include <QCoreApplication>
+#include <QImageReader>
+#include <QRunnable>
+#include <QThread>
 #include <QUrl>
 #include <QNetworkReply>
 
@@ -32,16 +36,103 @@
 #include "core/logging.h"
 #include "core/network.h"
 #include "core/tagreaderclient.h"
+#include "core/tracing.h"
 #include "core/utilities.h"
 #include "internet/core/internetmodel.h"
 #include "internet/spotify/spotifyservice.h"
 
+const int AlbumCoverLoader::kMaxDecodeThreads = 4;
+
+namespace {
+
+// Decodes and scales one cover in AlbumCoverLoader's decode pool.
+class CoverDecoder : public QRunnable {
+ public:
+  CoverDecoder(QObject* loader, quint64 id,
+               const AlbumCoverLoaderOptions& options,
+               const QString& filename, const QByteArray& data,
+               const QImage& image, std::shared_ptr<QAtomicInt> cancelled)
+      : loader_(loader),
+        id_(id),
+        options_(options),
+        filename_(filename),
+        data_(data),
+        image_(image),
+        cancelled_(cancelled) {}
+
+  void run() {
+    if (*cancelled_) return;
+
+    QImage original = image_;
+    if (original.isNull()) {
+      QBuffer buffer(&data_);
+      QImageReader reader;
+      if (filename_.isEmpty()) {
+        buffer.open(QIODevice::ReadOnly);
+        reader.setDevice(&buffer);
+      } else {
+        reader.setFileName(filename_);
+      }
+
+      // If only a thumbnail is wanted, let the decoder skip most of the
+      // pixels - JPEG can decode at a fraction of its size almost for free.
+      // Leave twice the output size so the smooth scale still has something
+      // to work with.
+      if (options_.scale_output_image_ && !options_.need_original_image_) {
+        const int target = options_.desired_height_ * 2;
+        const QSize size = reader.size();
+        if (size.isValid() &&
+            (size.width() > target || size.height() > target)) {
+          reader.setScaledSize(
+              size.scaled(target, target, Qt::KeepAspectRatio));
+        }
+      }
+
+      original = reader.read();
+    }
+
+    if (*cancelled_) return;
+
+    const QImage scaled =
+        original.isNull() ? QImage()
+                          : AlbumCoverLoader::ScaleAndPad(options_, original);
+
+    QMetaObject::invokeMethod(loader_, "DecodeFinished", Qt::QueuedConnection,
+                              Q_ARG(quint64, id_), Q_ARG(QImage, scaled),
+                              Q_ARG(QImage, original));
+  }
+
+ private:
+  QObject* loader_;
+  quint64 id_;
+  AlbumCoverLoaderOptions options_;
+  QString filename_;
+  QByteArray data_;
+  QImage image_;
+  std::shared_ptr<QAtomicInt> cancelled_;
+};
+
+}  // namespace
+
 AlbumCoverLoader::AlbumCoverLoader(QObject* parent)
     : QObject(parent),
       stop_requested_(false),
       next_id_(1),
       network_(new NetworkAccessManager(this)),
-      connected_spotify_(false) {}
+      connected_spotify_(false) {
+  decode_pool_.setMaxThreadCount(
+      qBound(1, QThread::idealThreadCount(), kMaxDecodeThreads));
+}
+
+AlbumCoverLoader::~AlbumCoverLoader() {
+  {
+    QMutexLocker l(&mutex_);
+    for (const DecodingTask& decoding : decoding_tasks_) {
+      decoding.cancelled->fetchAndStoreRelaxed(1);
+    }
+  }
+  decode_pool_.waitForDone();
+}
 
 QString AlbumCoverLoader::ImageCacheDir() {
   return Utilities::GetConfigPath(Utilities::Path_AlbumCovers);
@@ -49,6 +140,10 @@ QString AlbumCoverLoader::ImageCacheDir() {
 
 void AlbumCoverLoader::CancelTask(quint64 id) {
   QMutexLocker l(&mutex_);
+  if (decoding_tasks_.contains(id)) {
+    decoding_tasks_.take(id).cancelled->fetchAndStoreRelaxed(1);
+    return;
+  }
   for (QQueue<Task>::iterator it = tasks_.begin(); it != tasks_.end(); ++it) {
     if (it->id == id) {
       tasks_.erase(it);
@@ -59,6 +154,11 @@ void AlbumCoverLoader::CancelTask(quint64 id) {
 
 void AlbumCoverLoader::CancelTasks(const QSet<quint64>& ids) {
   QMutexLocker l(&mutex_);
+  for (quint64 id : ids) {
+    if (decoding_tasks_.contains(id)) {
+      decoding_tasks_.take(id).cancelled->fetchAndStoreRelaxed(1);
+    }
+  }
   for (QQueue<Task>::iterator it = tasks_.begin(); it != tasks_.end();) {
     if (ids.contains(it->id)) {
       it = tasks_.erase(it);
@@ -68,6 +168,18 @@ void AlbumCoverLoader::CancelTasks(const QSet<quint64>& ids) {
   }
 }
 
+AlbumCoverLoader::Statistics AlbumCoverLoader::statistics() {
+  Statistics ret;
+  {
+    QMutexLocker l(&mutex_);
+    ret.queued_tasks = tasks_.count();
+    ret.decoding_tasks = decoding_tasks_.count();
+  }
+  cache_.GetHitCounts(&ret.cache_hits, &ret.cache_misses);
+  ret.cache_bytes = cache_.memory_usage();
+  return ret;
+}
+
 quint64 AlbumCoverLoader::LoadImageAsync(const AlbumCoverLoaderOptions& options,
                                          const QString& art_automatic,
                                          const QString& art_manual,
@@ -100,6 +212,7 @@ void AlbumCoverLoader::ProcessTasks() {
       QMutexLocker l(&mutex_);
       if (tasks_.isEmpty()) return;
       task = tasks_.dequeue();
+      qTraceCounter("AlbumCoverLoader::tasks", tasks_.count());
     }
 
     ProcessTask(&task);
@@ -107,6 +220,17 @@ void AlbumCoverLoader::ProcessTasks() {
 }
 
 void AlbumCoverLoader::ProcessTask(Task* task) {
+  qTraceScope("AlbumCoverLoader::ProcessTask");
+
+  // Maybe this cover was loaded and scaled the same way before
+  QImage cached;
+  if (!task->options.need_original_image_ && task->embedded_image.isNull() &&
+      cache_.Find(CacheKey(*task), &cached)) {
+    emit ImageLoaded(task->id, cached);
+    emit ImageLoaded(task->id, cached, cached);
+    return;
+  }
+
   TryLoadResult result = TryLoadImage(*task);
   if (result.started_async) {
     // The image is being loaded from a remote URL, we'll carry on later
@@ -115,15 +239,51 @@ void AlbumCoverLoader::ProcessTask(Task* task) {
   }
 
   if (result.loaded_success) {
-    QImage scaled = ScaleAndPad(task->options, result.image);
-    emit ImageLoaded(task->id, scaled);
-    emit ImageLoaded(task->id, scaled, result.image);
+    TaskFinished(*task, ScaleAndPad(task->options, result.image),
+                 result.image);
     return;
   }
 
   NextState(task);
 }
 
+QString AlbumCoverLoader::CacheKey(const Task& task) const {
+  switch (task.state) {
+    case State_TryingAuto:
+      return AlbumCoverCache::Key(task.options, task.art_automatic,
+                                  task.song_filename);
+    case State_TryingManual:
+      return AlbumCoverCache::Key(task.options, task.art_manual,
+                                  task.song_filename);
+  }
+  return QString();
+}
+
+void AlbumCoverLoader::TaskFinished(const Task& task, const QImage& scaled,
+                                    const QImage& original) {
+  if (task.embedded_image.isNull()) {
+    cache_.Insert(CacheKey(task), scaled);
+  }
+  cache_.Insert(task.content_key, scaled);
+
+  emit ImageLoaded(task.id, scaled);
+  emit ImageLoaded(task.id, scaled, original);
+}
+
+bool AlbumCoverLoader::LoadCachedImage(const AlbumCoverLoaderOptions& options,
+                                       const Song& song, QImage* image) {
+  if (song.art_manual() == Song::kManuallyUnsetCover) return false;
+
+  // Same order as the tasks - a manually set cover that exists wins
+  const QString filename = song.url().toLocalFile();
+  const QString manual_key =
+      AlbumCoverCache::Key(options, song.art_manual(), filename);
+  if (!manual_key.isEmpty()) return cache_.Find(manual_key, image);
+
+  return cache_.Find(
+      AlbumCoverCache::Key(options, song.art_automatic(), filename), image);
+}
+
 void AlbumCoverLoader::NextState(Task* task) {
   if (task->state == State_TryingManual) {
     // Try the automatic one next
@@ -140,9 +300,10 @@ void AlbumCoverLoader::NextState(Task* task) {
 AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(
     const Task& task) {
   // An image embedded in the song itself takes priority
-  if (!task.embedded_image.isNull())
-    return TryLoadResult(false, true,
-                         ScaleAndPad(task.options, task.embedded_image));
+  if (!task.embedded_image.isNull()) {
+    StartDecode(task, QString(), QByteArray(), task.embedded_image);
+    return TryLoadResult(true, false, QImage());
+  }
 
   QString filename;
   switch (task.state) {
@@ -158,13 +319,26 @@ AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(
     return TryLoadResult(false, true, task.options.default_output_image_);
 
   if (filename == Song::kEmbeddedCover && !task.song_filename.isEmpty()) {
-    const QImage taglib_image =
-        TagReaderClient::Instance()->LoadEmbeddedArtBlocking(
+    const QByteArray data =
+        TagReaderClient::Instance()->LoadEmbeddedArtDataBlocking(
             task.song_filename);
 
-    if (!taglib_image.isNull())
-      return TryLoadResult(false, true,
-                           ScaleAndPad(task.options, taglib_image));
+    if (!data.isEmpty()) {
+      // Another track with the same picture might have been scaled already
+      Task content_task(task);
+      content_task.content_key =
+          AlbumCoverCache::ContentKey(task.options, data);
+
+      QImage cached;
+      if (!task.options.need_original_image_ &&
+          cache_.Find(content_task.content_key, &cached)) {
+        TaskFinished(content_task, cached, cached);
+        return TryLoadResult(true, false, QImage());
+      }
+
+      StartDecode(content_task, QString(), data, QImage());
+      return TryLoadResult(true, false, QImage());
+    }
   }
 
   if (filename.toLower().startsWith("http://") ||
@@ -198,10 +372,46 @@ AlbumCoverLoader::TryLoadResult AlbumCoverLoader::TryLoadImage(
     return TryLoadResult(true, false, QImage());
   }
 
-  QImage image(filename);
-  return TryLoadResult(
-      false, !image.isNull(),
-      image.isNull() ? task.options.default_output_image_ : image);
+  if (filename.isEmpty()) {
+    return TryLoadResult(false, false, task.options.default_output_image_);
+  }
+
+  StartDecode(task, filename, QByteArray(), QImage());
+  return TryLoadResult(true, false, QImage());
+}
+
+void AlbumCoverLoader::StartDecode(const Task& task, const QString& filename,
+                                   const QByteArray& data,
+                                   const QImage& image) {
+  DecodingTask decoding;
+  decoding.task = task;
+  decoding.cancelled.reset(new QAtomicInt(0));
+
+  {
+    QMutexLocker l(&mutex_);
+    decoding_tasks_[task.id] = decoding;
+  }
+
+  decode_pool_.start(new CoverDecoder(this, task.id, task.options, filename,
+                                      data, image, decoding.cancelled));
+}
+
+void AlbumCoverLoader::DecodeFinished(quint64 id, const QImage& scaled,
+                                      const QImage& original) {
+  Task task;
+  {
+    QMutexLocker l(&mutex_);
+    // It was cancelled
+    if (!decoding_tasks_.contains(id)) return;
+    task = decoding_tasks_.take(id).task;
+  }
+
+  if (original.isNull()) {
+    NextState(&task);
+    return;
+  }
+
+  TaskFinished(task, scaled, original);
 }
 
 void AlbumCoverLoader::SpotifyImageLoaded(const QString& id,
@@ -209,9 +419,11 @@ void AlbumCoverLoader::SpotifyImageLoaded(const QString& id,
   if (!remote_spotify_tasks_.contains(id)) return;
 
   Task task = remote_spotify_tasks_.take(id);
-  QImage scaled = ScaleAndPad(task.options, image);
-  emit ImageLoaded(task.id, scaled);
-  emit ImageLoaded(task.id, scaled, image);
+  if (image.isNull()) {
+    NextState(&task);
+    return;
+  }
+  StartDecode(task, QString(), QByteArray(), image);
 }
 
 void AlbumCoverLoader::RemoteFetchFinished(QNetworkReply* reply) {
@@ -238,13 +450,8 @@ void AlbumCoverLoader::RemoteFetchFinished(QNetworkReply* reply) {
 
   if (reply->error() == QNetworkReply::NoError) {
     // Try to load the image
-    QImage image;
-    if (image.load(reply, 0)) {
-      QImage scaled = ScaleAndPad(task.options, image);
-      emit ImageLoaded(task.id, scaled);
-      emit ImageLoaded(task.id, scaled, image);
-      return;
-    }
+    StartDecode(task, QString(), reply->readAll(), QImage());
+    return;
   }
 
   NextState(&task);
@@ -21,13 +21,17 @@
 #ifndef COVERS_ALBUMCOVERLOADER_H_
 #define COVERS_ALBUMCOVERLOADER_H_
 
+#include "albumcovercache.h"
 #include "albumcoverloaderoptions.h"
 #include "core/song.h"
 
+#include <memory>
+
 #include <QImage>
 #include <QMutex>
 #include <QObject>
 #include <QQueue>
+#include <QThreadPool>
 #include <QUrl>
 
 class NetworkAccessManager;
@@ -38,6 +42,9 @@ class AlbumCoverLoader : public QObject {
 
  public:
   explicit AlbumCoverLoader(QObject* parent = nullptr);
+  ~AlbumCoverLoader();
+
+  static const int kMaxDecodeThreads;
 
   void Stop() { stop_requested_ = true; }
 
@@ -54,6 +61,23 @@ class AlbumCoverLoader : public QObject {
   void CancelTask(quint64 id);
   void CancelTasks(const QSet<quint64>& ids);
 
+  struct Statistics {
+    int queued_tasks;
+    int decoding_tasks;
+    int cache_hits;
+    int cache_misses;
+    qint64 cache_bytes;
+  };
+
+  // Safe to call from any thread.  Covers being fetched over the network
+  // aren't counted.
+  Statistics statistics();
+
+  // Looks for an already scaled copy of the song's cover in the cache without
+  // loading anything.  Safe to call from any thread.
+  bool LoadCachedImage(const AlbumCoverLoaderOptions& options,
+                       const Song& song, QImage* image);
+
   static QPixmap TryLoadPixmap(const QString& automatic, const QString& manual,
                                const QString& filename = QString());
   static QImage ScaleAndPad(const AlbumCoverLoaderOptions& options,
@@ -67,6 +91,7 @@ class AlbumCoverLoader : public QObject {
   void ProcessTasks();
   void RemoteFetchFinished(QNetworkReply* reply);
   void SpotifyImageLoaded(const QString& url, const QImage& image);
+  void DecodeFinished(quint64 id, const QImage& scaled, const QImage& original);
 
  protected:
   enum State { State_TryingManual, State_TryingAuto, };
@@ -83,6 +108,9 @@ class AlbumCoverLoader : public QObject {
     QImage embedded_image;
     State state;
     int redirects;
+
+    // Cache key of the embedded image's data, if it was loaded from the file.
+    QString content_key;
   };
 
   struct TryLoadResult {
@@ -97,6 +125,15 @@ class AlbumCoverLoader : public QObject {
   void ProcessTask(Task* task);
   void NextState(Task* task);
   TryLoadResult TryLoadImage(const Task& task);
+  QString CacheKey(const Task& task) const;
+
+  // Decodes (from a file or raw data) and scales an image on decode_pool_.
+  // DecodeFinished is called in this thread when it's done.
+  void StartDecode(const Task& task, const QString& filename,
+                   const QByteArray& data, const QImage& image);
+
+  void TaskFinished(const Task& task, const QImage& scaled,
+                    const QImage& original);
 
   bool stop_requested_;
 
@@ -104,13 +141,26 @@ class AlbumCoverLoader : public QObject {
   QQueue<Task> tasks_;
   QMap<QNetworkReply*, Task> remote_tasks_;
   QMap<QString, Task> remote_spotify_tasks_;
+
+  // Tasks being decoded, protected by mutex_.  Setting a task's cancelled
+  // flag tells its decoder to stop early.
+  struct DecodingTask {
+    Task task;
+    std::shared_ptr<QAtomicInt> cancelled;
+  };
+  QMap<quint64, DecodingTask> decoding_tasks_;
   quint64 next_id_;
 
   NetworkAccessManager* network_;
 
   bool connected_spotify_;
 
+  AlbumCoverCache cache_;
+
   static const int kMaxRedirects = 3;
+
+  // Declared last so it's destroyed first, waiting for running decoders.
+  QThreadPool decode_pool_;
 };
 
 #endif  // COVERS_ALBUMCOVERLOADER_H_
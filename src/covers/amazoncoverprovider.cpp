@@ -40,7 +40,7 @@ const char* AmazonCoverProvider::kAssociateTag = "clemmusiplay-20";
 
 AmazonCoverProvider::AmazonCoverProvider(QObject* parent)
     : CoverProvider("Amazon", parent),
-      network_(new NetworkAccessManager(this)) {}
+      network_(NetworkAccessManager::Shared()) {}
 
 bool AmazonCoverProvider::StartSearch(const QString& artist,
                                       const QString& album, int id) {
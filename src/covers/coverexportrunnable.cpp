@@ -19,19 +19,22 @@
 
 #include "coverexportrunnable.h"
 
+#include <QDateTime>
 #include <QFile>
+#include <QFileInfo>
 #include <QUrl>
 
 #include "albumcoverexporter.h"
 #include "core/song.h"
 #include "core/tagreaderclient.h"
+#include "core/utilities.h"
 
 CoverExportRunnable::CoverExportRunnable(
     const AlbumCoverExport::DialogResult& dialog_result, const Song& song)
     : dialog_result_(dialog_result), song_(song) {}
 
 void CoverExportRunnable::run() {
-  QString cover_path = GetCoverPath();
+  QString cover_path = GetCoverPath(dialog_result_, song_);
 
   // manually unset?
   if (cover_path.isEmpty()) {
@@ -45,23 +48,59 @@ void CoverExportRunnable::run() {
   }
 }
 
-QString CoverExportRunnable::GetCoverPath() {
-  if (song_.has_manually_unset_cover()) {
+QString CoverExportRunnable::GetCoverPath(
+    const AlbumCoverExport::DialogResult& dialog_result, const Song& song) {
+  if (song.has_manually_unset_cover()) {
     return QString();
     // Export downloaded covers?
-  } else if (!song_.art_manual().isEmpty() &&
-             dialog_result_.export_downloaded_) {
-    return song_.art_manual();
+  } else if (!song.art_manual().isEmpty() &&
+             dialog_result.export_downloaded_) {
+    return song.art_manual();
     // Export embedded covers?
-  } else if (!song_.art_automatic().isEmpty() &&
-             song_.art_automatic() == Song::kEmbeddedCover &&
-             dialog_result_.export_embedded_) {
-    return song_.art_automatic();
+  } else if (!song.art_automatic().isEmpty() &&
+             song.art_automatic() == Song::kEmbeddedCover &&
+             dialog_result.export_embedded_) {
+    return song.art_automatic();
   } else {
     return QString();
   }
 }
 
+QString CoverExportRunnable::GetDestinationPath(
+    const AlbumCoverExport::DialogResult& dialog_result, const Song& song) {
+  QString cover_path = GetCoverPath(dialog_result, song);
+
+  QString dir = song.url().toLocalFile().section('/', 0, -2);
+  QString extension = cover_path.section('.', -1);
+
+  return dir + '/' + dialog_result.fileName_ + '.' +
+         (cover_path == Song::kEmbeddedCover ? "jpg" : extension);
+}
+
+// Whether new_file already holds this cover, so writing it again would only
+// cost I/O.  Embedded covers count as up to date if they were written after
+// the song last changed.
+bool CoverExportRunnable::IsUpToDate(const QString& cover_path,
+                                     const QString& new_file) const {
+  QFileInfo destination(new_file);
+  if (!destination.exists()) return false;
+
+  if (cover_path == Song::kEmbeddedCover) {
+    QFileInfo source(song_.url().toLocalFile());
+    return source.exists() &&
+           destination.lastModified() >= source.lastModified();
+  }
+
+  QFileInfo source(cover_path);
+  if (!source.exists() || source.size() != destination.size()) return false;
+  if (destination.lastModified() >= source.lastModified()) return true;
+
+  QFile source_file(cover_path);
+  QFile destination_file(new_file);
+  return Utilities::Sha1File(source_file) ==
+         Utilities::Sha1File(destination_file);
+}
+
 // Exports a single album cover using a "save QImage to file" approach.
 // For performance reasons this method will be invoked only if loading
 // and in memory processing of images is necessary for current settings
@@ -70,7 +109,16 @@ QString CoverExportRunnable::GetCoverPath() {
 // - or the "overwrite smaller" mode is used
 // In all other cases, the faster ExportCover() method will be used.
 void CoverExportRunnable::ProcessAndExportCover() {
-  QString cover_path = GetCoverPath();
+  QString cover_path = GetCoverPath(dialog_result_, song_);
+  QString new_file = GetDestinationPath(dialog_result_, song_);
+
+  // If the file exists, do not override!  Checked before the cover is loaded
+  // so it isn't decoded for nothing.
+  if (dialog_result_.overwrite_ == AlbumCoverExport::OverwriteMode_None &&
+      QFile::exists(new_file)) {
+    EmitCoverSkipped();
+    return;
+  }
 
   // either embedded or disk - the one we'll export for the current album
   QImage cover;
@@ -90,10 +138,9 @@ void CoverExportRunnable::ProcessAndExportCover() {
     cover = embedded_cover;
   }
 
-  // load a file cover which iss mandatory if there's no embedded cover
-  disk_cover.load(cover_path);
-
+  // load a file cover which is mandatory if there's no embedded cover
   if (embedded_cover.isNull()) {
+    disk_cover.load(cover_path);
     if (disk_cover.isNull()) {
       EmitCoverSkipped();
       return;
@@ -107,18 +154,6 @@ void CoverExportRunnable::ProcessAndExportCover() {
                          Qt::IgnoreAspectRatio);
   }
 
-  QString dir = song_.url().toLocalFile().section('/', 0, -2);
-  QString extension = cover_path.section('.', -1);
-
-  QString new_file = dir + '/' + dialog_result_.fileName_ + '.' +
-                     (cover_path == Song::kEmbeddedCover ? "jpg" : extension);
-
-  // If the file exists, do not override!
-  if (dialog_result_.overwrite_ == AlbumCoverExport::OverwriteMode_None && QFile::exists(new_file)) {
-    EmitCoverSkipped();
-    return;
-  }
-
   // we're handling overwrite as remove + copy so we need to delete the old file
   // first
   if (QFile::exists(new_file) && dialog_result_.overwrite_ != AlbumCoverExport::OverwriteMode_None) {
@@ -150,13 +185,8 @@ void CoverExportRunnable::ProcessAndExportCover() {
 
 // Exports a single album cover using a "copy file" approach.
 void CoverExportRunnable::ExportCover() {
-  QString cover_path = GetCoverPath();
-
-  QString dir = song_.url().toLocalFile().section('/', 0, -2);
-  QString extension = cover_path.section('.', -1);
-
-  QString new_file = dir + '/' + dialog_result_.fileName_ + '.' +
-                     (cover_path == Song::kEmbeddedCover ? "jpg" : extension);
+  QString cover_path = GetCoverPath(dialog_result_, song_);
+  QString new_file = GetDestinationPath(dialog_result_, song_);
 
   // If the file exists, do not override!
   if (dialog_result_.overwrite_ == AlbumCoverExport::OverwriteMode_None &&
@@ -169,6 +199,10 @@ void CoverExportRunnable::ExportCover() {
   // first
   if (dialog_result_.overwrite_ != AlbumCoverExport::OverwriteMode_None &&
       QFile::exists(new_file)) {
+    if (IsUpToDate(cover_path, new_file)) {
+      EmitCoverSkipped();
+      return;
+    }
     if (!QFile::remove(new_file)) {
       EmitCoverSkipped();
       return;
@@ -185,7 +219,7 @@ void CoverExportRunnable::ExportCover() {
     }
   } else {
     // automatic or manual cover, available in an image file
-    if (!QFile::copy(cover_path, new_file)) {
+    if (!Utilities::CopyLocalFile(cover_path, new_file)) {
       EmitCoverSkipped();
       return;
     }
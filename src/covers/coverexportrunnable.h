@@ -29,6 +29,9 @@
 class AlbumCoverExporter;
 
 class CoverExportRunnable : public QObject, public QRunnable {
+  // Exports one cover file.  AlbumCoverExporter makes one of these for each
+  // destination file, however many albums would be exported to it.
+
   Q_OBJECT
 
  public:
@@ -36,6 +39,14 @@ class CoverExportRunnable : public QObject, public QRunnable {
                       const Song& song);
   virtual ~CoverExportRunnable() {}
 
+  // The cover that would be exported for this song, or an empty string if
+  // there's nothing to export.
+  static QString GetCoverPath(
+      const AlbumCoverExport::DialogResult& dialog_result, const Song& song);
+  // Where the song's cover would be exported to.
+  static QString GetDestinationPath(
+      const AlbumCoverExport::DialogResult& dialog_result, const Song& song);
+
   void run();
 
  signals:
@@ -48,7 +59,7 @@ class CoverExportRunnable : public QObject, public QRunnable {
 
   void ProcessAndExportCover();
   void ExportCover();
-  QString GetCoverPath();
+  bool IsUpToDate(const QString& cover_path, const QString& new_file) const;
 
   AlbumCoverExport::DialogResult dialog_result_;
   Song song_;
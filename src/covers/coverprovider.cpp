@@ -19,5 +19,19 @@
 
 #include "coverprovider.h"
 
+const int CoverProvider::kDefaultMaxConcurrentSearches = 4;
+
 CoverProvider::CoverProvider(const QString& name, QObject* parent)
-    : QObject(parent), name_(name) {}
+    : QObject(parent), name_(name), active_searches_(0) {}
+
+bool CoverProvider::TryAcquireSearchSlot() {
+  if (active_searches_ >= max_concurrent_searches()) return false;
+  active_searches_++;
+  return true;
+}
+
+void CoverProvider::ReleaseSearchSlot() {
+  Q_ASSERT(active_searches_ > 0);
+  active_searches_--;
+  emit SearchSlotFreed();
+}
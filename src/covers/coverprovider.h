@@ -37,9 +37,23 @@ class CoverProvider : public QObject {
  public:
   explicit CoverProvider(const QString& name, QObject* parent);
 
+  static const int kDefaultMaxConcurrentSearches;
+
   // A name (very short description) of this provider, like "last.fm".
   QString name() const { return name_; }
 
+  // How many searches may be running against this service at once, across
+  // every AlbumCoverFetcher.  Override this for services with strict rate
+  // limits.
+  virtual int max_concurrent_searches() const {
+    return kDefaultMaxConcurrentSearches;
+  }
+
+  // Searches take one of the slots above while they run.  SearchSlotFreed is
+  // emitted whenever one is given back.
+  bool TryAcquireSearchSlot();
+  void ReleaseSearchSlot();
+
   // Starts searching for covers matching the given query text.  Returns true
   // if the query has been started, or false if an error occurred.  The provider
   // should remember the ID and emit it along with the result when it finishes.
@@ -50,9 +64,11 @@ class CoverProvider : public QObject {
 
  signals:
   void SearchFinished(int id, const QList<CoverSearchResult>& results);
+  void SearchSlotFreed();
 
  private:
   QString name_;
+  int active_searches_;
 };
 
 #endif  // COVERS_COVERPROVIDER_H_
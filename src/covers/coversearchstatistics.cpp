@@ -24,6 +24,7 @@ CoverSearchStatistics::CoverSearchStatistics()
       bytes_transferred_(0),
       chosen_images_(0),
       missing_images_(0),
+      known_missing_images_(0),
       chosen_width_(0),
       chosen_height_(0) {}
 
@@ -38,9 +39,14 @@ CoverSearchStatistics& CoverSearchStatistics::operator+=(
   for (const QString& key : other.total_images_by_provider_.keys()) {
     total_images_by_provider_[key] += other.total_images_by_provider_[key];
   }
+  for (const QString& key : other.network_requests_by_provider_.keys()) {
+    network_requests_by_provider_[key] +=
+        other.network_requests_by_provider_[key];
+  }
 
   chosen_images_ += other.chosen_images_;
   missing_images_ += other.missing_images_;
+  known_missing_images_ += other.known_missing_images_;
 
   chosen_width_ += other.chosen_width_;
   chosen_height_ += other.chosen_height_;
@@ -32,10 +32,14 @@ struct CoverSearchStatistics {
   quint64 bytes_transferred_;
   QMap<QString, quint64> total_images_by_provider_;
   QMap<QString, quint64> chosen_images_by_provider_;
+  QMap<QString, quint64> network_requests_by_provider_;
 
   quint64 chosen_images_;
   quint64 missing_images_;
 
+  // Albums skipped because an earlier run found no cover for them.
+  quint64 known_missing_images_;
+
   quint64 chosen_width_;
   quint64 chosen_height_;
 
@@ -64,8 +64,21 @@ void CoverSearchStatisticsDialog::Show(
     AddSpacer();
   }
 
+  QStringList request_providers(
+      statistics.network_requests_by_provider_.keys());
+  qSort(request_providers);
+  for (const QString& provider : request_providers) {
+    AddLine(tr("Network requests to %1").arg(provider),
+            QString::number(
+                statistics.network_requests_by_provider_[provider]));
+  }
+
   AddLine(tr("Total network requests made"),
           QString::number(statistics.network_requests_made_));
+  if (statistics.known_missing_images_) {
+    AddLine(tr("Albums known to have no cover"),
+            QString::number(statistics.known_missing_images_));
+  }
   AddLine(tr("Average image size"), statistics.AverageDimensions());
   AddLine(tr("Total bytes transferred"),
           statistics.bytes_transferred_
@@ -19,11 +19,18 @@
 
 #include "currentartloader.h"
 
+#include <functional>
+
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDir>
+#include <QFileInfo>
 #include <QTemporaryFile>
 #include <QUrl>
 
 #include "core/application.h"
+#include "core/closure.h"
+#include "core/threadpools.h"
 #include "covers/albumcoverloader.h"
 #include "playlist/playlistmanager.h"
 #include "ui/iconloader.h"
@@ -32,7 +39,8 @@ CurrentArtLoader::CurrentArtLoader(Application* app, QObject* parent)
     : QObject(parent),
       app_(app),
       temp_file_pattern_(QDir::tempPath() + "/clementine-art-XXXXXX.jpg"),
-      id_(0) {
+      id_(0),
+      saving_(false) {
   options_.scale_output_image_ = false;
   options_.pad_output_image_ = false;
   QIcon nocover = IconLoader::Load("nocover", IconLoader::Other);
@@ -53,32 +61,104 @@ void CurrentArtLoader::LoadArt(const Song& song) {
   id_ = app_->album_cover_loader()->LoadImageAsync(options_, last_song_);
 }
 
+QString CurrentArtLoader::ArtKey(const Song& song, const QImage& image) {
+  // Covers from files are known by their path, the rest by their pixels.
+  // Hashing those is still much cheaper than encoding a JPEG.
+  const QString path =
+      song.art_manual().isEmpty() ? song.art_automatic() : song.art_manual();
+  const QFileInfo info(path);
+  if (path != Song::kEmbeddedCover && info.exists()) {
+    return path + ":" + QString::number(info.lastModified().toTime_t());
+  }
+
+  return QCryptographicHash::hash(
+             QByteArray::fromRawData(
+                 reinterpret_cast<const char*>(image.constBits()),
+                 image.byteCount()),
+             QCryptographicHash::Sha1).toHex();
+}
+
 void CurrentArtLoader::TempArtLoaded(quint64 id, const QImage& image) {
   if (id != id_) return;
   id_ = 0;
 
-  QString uri;
-  QString thumbnail_uri;
-  QImage thumbnail;
-
-  if (!image.isNull()) {
-    temp_art_.reset(new QTemporaryFile(temp_file_pattern_));
-    temp_art_->setAutoRemove(true);
-    temp_art_->open();
-    image.save(temp_art_->fileName(), "JPEG");
-
-    // Scale the image down to make a thumbnail.  It's a bit crap doing it here
-    // since it's the GUI thread, but the alternative is hard.
-    temp_art_thumbnail_.reset(new QTemporaryFile(temp_file_pattern_));
-    temp_art_thumbnail_->open();
-    temp_art_thumbnail_->setAutoRemove(true);
-    thumbnail = image.scaledToHeight(120, Qt::SmoothTransformation);
-    thumbnail.save(temp_art_thumbnail_->fileName(), "JPEG");
-
-    uri = "file://" + temp_art_->fileName();
-    thumbnail_uri = "file://" + temp_art_thumbnail_->fileName();
+  emit ImageLoaded(last_song_, image);
+
+  last_image_ = image;
+  last_key_.clear();
+  pending_image_ = QImage();
+
+  if (image.isNull()) {
+    emit ArtLoaded(last_song_, QString(), image);
+    emit ThumbnailLoaded(last_song_, QString(), QImage());
+    return;
+  }
+
+  last_key_ = ArtKey(last_song_, image);
+  if (last_key_ == art_key_) {
+    // Same cover as last time, the files are already there
+    EmitTempArt();
+    return;
   }
 
-  emit ArtLoaded(last_song_, uri, image);
-  emit ThumbnailLoaded(last_song_, thumbnail_uri, thumbnail);
+  // Already being saved, it'll be emitted when it's done
+  if (saving_ && last_key_ == saving_key_) return;
+
+  pending_image_ = image;
+  pending_key_ = last_key_;
+  if (!saving_) StartSaving();
+}
+
+void CurrentArtLoader::StartSaving() {
+  saving_ = true;
+  saving_key_ = pending_key_;
+  const QImage image = pending_image_;
+  pending_image_ = QImage();
+
+  saving_art_.reset(new QTemporaryFile(temp_file_pattern_));
+  saving_art_->setAutoRemove(true);
+  saving_art_->open();
+
+  saving_art_thumbnail_.reset(new QTemporaryFile(temp_file_pattern_));
+  saving_art_thumbnail_->setAutoRemove(true);
+  saving_art_thumbnail_->open();
+
+  QFuture<QImage> future = ThreadPools::Run<QImage>(
+      ThreadPools::Pool_Interactive,
+      std::bind(&CurrentArtLoader::SaveImages, image,
+                saving_art_->fileName(), saving_art_thumbnail_->fileName()));
+  NewClosure(future, this, SLOT(TempArtSaved(QFuture<QImage>)), future);
+}
+
+QImage CurrentArtLoader::SaveImages(const QImage& image,
+                                    const QString& filename,
+                                    const QString& thumbnail_filename) {
+  image.save(filename, "JPEG");
+
+  QImage thumbnail = image.scaledToHeight(120, Qt::SmoothTransformation);
+  thumbnail.save(thumbnail_filename, "JPEG");
+  return thumbnail;
+}
+
+void CurrentArtLoader::TempArtSaved(QFuture<QImage> future) {
+  saving_ = false;
+
+  temp_art_ = std::move(saving_art_);
+  temp_art_thumbnail_ = std::move(saving_art_thumbnail_);
+  art_key_ = saving_key_;
+  thumbnail_ = future.result();
+
+  // The song changed to one with a different cover while this was saving
+  if (!pending_image_.isNull()) {
+    StartSaving();
+    return;
+  }
+
+  if (id_ == 0 && art_key_ == last_key_) EmitTempArt();
+}
+
+void CurrentArtLoader::EmitTempArt() {
+  emit ArtLoaded(last_song_, "file://" + temp_art_->fileName(), last_image_);
+  emit ThumbnailLoaded(last_song_, "file://" + temp_art_thumbnail_->fileName(),
+                       thumbnail_);
 }
@@ -22,6 +22,8 @@
 
 #include <memory>
 
+#include <QFuture>
+#include <QImage>
 #include <QObject>
 
 #include "core/song.h"
@@ -29,10 +31,14 @@
 
 class Application;
 
-class QImage;
 class QTemporaryFile;
 
 class CurrentArtLoader : public QObject {
+  // Loads the current song's cover and saves it, and a thumbnail, to
+  // temporary files that MPRIS and notifications can point to.  The files are
+  // written on a worker thread, and kept while the songs that follow have the
+  // same cover, so skipping through an album doesn't encode it again.
+
   Q_OBJECT
 
  public:
@@ -46,24 +52,53 @@ class CurrentArtLoader : public QObject {
   void LoadArt(const Song& song);
 
  signals:
+  // Emitted as soon as the image is loaded, before it's saved, for widgets
+  // that don't need a file.
+  void ImageLoaded(const Song& song, const QImage& image);
   void ArtLoaded(const Song& song, const QString& uri, const QImage& image);
   void ThumbnailLoaded(const Song& song, const QString& uri,
                        const QImage& image);
 
  private slots:
   void TempArtLoaded(quint64 id, const QImage& image);
+  void TempArtSaved(QFuture<QImage> future);
 
  private:
+  // Identifies where the image came from, so the same cover is recognised
+  // for the next song.
+  static QString ArtKey(const Song& song, const QImage& image);
+  // Runs on a worker thread.  Returns the thumbnail.
+  static QImage SaveImages(const QImage& image, const QString& filename,
+                           const QString& thumbnail_filename);
+
+  void StartSaving();
+  void EmitTempArt();
+
   Application* app_;
   AlbumCoverLoaderOptions options_;
 
   QString temp_file_pattern_;
 
+  // The files for art_key_.
   std::unique_ptr<QTemporaryFile> temp_art_;
   std::unique_ptr<QTemporaryFile> temp_art_thumbnail_;
+  QString art_key_;
+  QImage thumbnail_;
   quint64 id_;
 
+  // Only one image is saved at a time.  If the song changes again meanwhile,
+  // the newest image waits in pending_image_ and the ones before it are
+  // never saved.
+  bool saving_;
+  QString saving_key_;
+  std::unique_ptr<QTemporaryFile> saving_art_;
+  std::unique_ptr<QTemporaryFile> saving_art_thumbnail_;
+  QImage pending_image_;
+  QString pending_key_;
+
   Song last_song_;
+  QImage last_image_;
+  QString last_key_;
 };
 
 #endif  // COVERS_CURRENTARTLOADER_H_
@@ -37,7 +37,7 @@ static const char* kAlbumCoverUrl =
 
 MusicbrainzCoverProvider::MusicbrainzCoverProvider(QObject* parent)
     : CoverProvider("MusicBrainz", parent),
-      network_(new NetworkAccessManager(this)) {}
+      network_(NetworkAccessManager::Shared()) {}
 
 bool MusicbrainzCoverProvider::StartSearch(const QString& artist,
                                            const QString& album, int id) {
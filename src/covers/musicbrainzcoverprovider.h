@@ -35,6 +35,9 @@ class MusicbrainzCoverProvider : public CoverProvider {
   virtual bool StartSearch(const QString& artist, const QString& album, int id);
   virtual void CancelSearch(int id);
 
+  // MusicBrainz allows about one request a second per client
+  virtual int max_concurrent_searches() const { return 1; }
+
  private slots:
   void ReleaseSearchFinished(QNetworkReply* reply, int id);
   void ImageCheckFinished(int id);
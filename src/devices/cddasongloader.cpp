@@ -18,16 +18,34 @@
 #include <gst/gst.h>
 #include <gst/tag/tag.h>
 
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+
+#include "core/closure.h"
 #include "core/logging.h"
+#include "core/threadpools.h"
 #include "core/timeconstants.h"
+#include "core/utilities.h"
 
 #include "cddasongloader.h"
 
+namespace {
+// Bump this when the cache file format changes.
+const qint32 kCacheFileVersion = 1;
+// Enhanced CDs have this many frames between the audio and the data session.
+const lba_t kDataTrackGap = 11400;
+}  // namespace
+
 CddaSongLoader::CddaSongLoader(const QUrl& url, QObject* parent)
   : QObject(parent),
     url_(url),
-    cdda_(nullptr),
-    cdio_(nullptr) {}
+    cdio_(nullptr),
+    loading_(false),
+    durations_loaded_(false) {}
 
 CddaSongLoader::~CddaSongLoader() {
   if (cdio_) cdio_destroy(cdio_);
@@ -41,73 +59,115 @@ QUrl CddaSongLoader::GetUrlFromTrack(int track_number) const {
   }
 }
 
+SongList CddaSongLoader::PlaceholderSongs(int count) const {
+  SongList songs;
+  for (int track_number = 1; track_number <= count; track_number++) {
+    // Init song
+    Song song;
+    song.set_id(track_number);
+    song.set_valid(true);
+    song.set_filetype(Song::Type_Cdda);
+    song.set_url(GetUrlFromTrack(track_number));
+    song.set_title(QString("Track %1").arg(track_number));
+    song.set_track(track_number);
+    songs << song;
+  }
+  return songs;
+}
+
 void CddaSongLoader::LoadSongs() {
-  QMutexLocker locker(&mutex_load_);
+  if (loading_) return;
+
+  if (cdio_) cdio_destroy(cdio_);
   cdio_ = cdio_open(url_.path().toLocal8Bit().constData(), DRIVER_DEVICE);
   if (cdio_ == nullptr) {
     return;
   }
+
+  loading_ = true;
+  durations_loaded_ = false;
+  pending_metadata_.clear();
+  songs_.clear();
+
+  // libcdio has the TOC as soon as the disc is in, so the tracks can be shown
+  // (and the disc looked up) while GStreamer is still waiting for the drive.
+  const track_t first = cdio_get_first_track_num(cdio_);
+  const track_t count = cdio_get_num_tracks(cdio_);
+  if (first != CDIO_INVALID_TRACK && count != CDIO_INVALID_TRACK) {
+    int audio_tracks = 0;
+    for (track_t track = first; track < first + count; ++track) {
+      if (cdio_get_track_format(cdio_, track) == TRACK_FORMAT_AUDIO) {
+        ++audio_tracks;
+      }
+    }
+    songs_ = PlaceholderSongs(audio_tracks);
+  }
+  if (!songs_.isEmpty()) emit SongsLoaded(songs_);
+
+  discid_ = DiscId(cdio_);
+  if (!discid_.isEmpty()) LoadMetadata(discid_);
+
+  QFutureWatcher<Toc>* watcher = new QFutureWatcher<Toc>(this);
+  NewClosure(watcher, SIGNAL(finished()), [=]() {
+    TocRead(watcher->result());
+    watcher->deleteLater();
+  });
+  watcher->setFuture(ThreadPools::Run<Toc>(
+      ThreadPools::Pool_IO,
+      std::bind(&CddaSongLoader::ReadToc, url_.path())));
+}
+
+CddaSongLoader::Toc CddaSongLoader::ReadToc(const QString& device) {
+  Toc ret;
+
   // Create gstreamer cdda element
   GError* error = nullptr;
-  cdda_ = gst_element_make_from_uri(GST_URI_SRC, "cdda://", nullptr, &error);
+  GstElement* cdda =
+      gst_element_make_from_uri(GST_URI_SRC, "cdda://", nullptr, &error);
   if (error) {
     qLog(Error) << error->code << error->message;
+    g_error_free(error);
   }
-  if (cdda_ == nullptr) {
-    return;
+  if (cdda == nullptr) {
+    return ret;
   }
 
-  if (!url_.isEmpty()) {
-    g_object_set(cdda_, "device", g_strdup(url_.path().toLocal8Bit().constData()),
-                 nullptr);
+  if (!device.isEmpty()) {
+    g_object_set(cdda, "device", device.toLocal8Bit().constData(), nullptr);
   }
-  if (g_object_class_find_property (G_OBJECT_GET_CLASS (cdda_), "paranoia-mode")) {
-    g_object_set (cdda_, "paranoia-mode", 0, NULL);
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (cdda), "paranoia-mode")) {
+    g_object_set (cdda, "paranoia-mode", 0, NULL);
   }
 
   // Change the element's state to ready and paused, to be able to query it
-  if (gst_element_set_state(cdda_, GST_STATE_READY) ==
+  if (gst_element_set_state(cdda, GST_STATE_READY) ==
           GST_STATE_CHANGE_FAILURE ||
-      gst_element_set_state(cdda_, GST_STATE_PAUSED) ==
+      gst_element_set_state(cdda, GST_STATE_PAUSED) ==
           GST_STATE_CHANGE_FAILURE) {
-    gst_element_set_state(cdda_, GST_STATE_NULL);
-    gst_object_unref(GST_OBJECT(cdda_));
-    return;
+    gst_element_set_state(cdda, GST_STATE_NULL);
+    gst_object_unref(GST_OBJECT(cdda));
+    return ret;
   }
 
   // Get number of tracks
   GstFormat fmt = gst_format_get_by_nick("track");
   GstFormat out_fmt = fmt;
   gint64 num_tracks = 0;
-  if (!gst_element_query_duration(cdda_, out_fmt, &num_tracks) ||
+  if (!gst_element_query_duration(cdda, out_fmt, &num_tracks) ||
       out_fmt != fmt) {
     qLog(Error) << "Error while querying cdda GstElement";
-    gst_object_unref(GST_OBJECT(cdda_));
-    return;
+    gst_element_set_state(cdda, GST_STATE_NULL);
+    gst_object_unref(GST_OBJECT(cdda));
+    return ret;
   }
-
-  SongList songs;
-  for (int track_number = 1; track_number <= num_tracks; track_number++) {
-    // Init song
-    Song song;
-    song.set_id(track_number);
-    song.set_valid(true);
-    song.set_filetype(Song::Type_Cdda);
-    song.set_url(
-        GetUrlFromTrack(track_number));
-    song.set_title(QString("Track %1").arg(track_number));
-    song.set_track(track_number);
-    songs << song;
-  }
-  emit SongsLoaded(songs);
-
+  ret.track_count_ = num_tracks;
 
   gst_tag_register_musicbrainz_tags();
 
   GstElement* pipeline = gst_pipeline_new("pipeline");
   GstElement* sink = gst_element_factory_make ("fakesink", NULL);
-  gst_bin_add_many (GST_BIN (pipeline), cdda_, sink, NULL);
-  gst_element_link (cdda_, sink);
+  gst_bin_add_many (GST_BIN (pipeline), cdda, sink, NULL);
+  gst_element_link (cdda, sink);
   gst_element_set_state(pipeline, GST_STATE_READY);
   gst_element_set_state(pipeline, GST_STATE_PAUSED);
 
@@ -132,47 +192,90 @@ void CddaSongLoader::LoadSongs() {
     gst_message_parse_toc (msg_toc, &toc, nullptr);
     if (toc) {
       GList* entries = gst_toc_get_entries(toc);
-      if (entries && songs.size() <= g_list_length (entries)) {
-        int i = 0;
+      if (entries && num_tracks <= g_list_length (entries)) {
         for (GList* node = entries; node != nullptr; node = node->next) {
           GstTocEntry *entry = static_cast<GstTocEntry*>(node->data);
           quint64 duration = 0;
           gint64 start, stop;
           if (gst_toc_entry_get_start_stop_times (entry, &start, &stop))
             duration = stop - start;
-          songs[i++].set_length_nanosec(duration);
+          ret.lengths_nanosec_ << duration;
         }
       }
     }
     gst_message_unref(msg_toc);
   }
-  emit SongsDurationLoaded(songs);
 
-  // Handle TAG message: generate MusicBrainz DiscId
+  // Handle TAG message: get the MusicBrainz DiscId, in case libcdio couldn't
+  // work it out
   if (msg_tag) {
     GstTagList* tags = nullptr;
     gst_message_parse_tag(msg_tag, &tags);
     char* string_mb = nullptr;
     if (gst_tag_list_get_string(tags, GST_TAG_CDDA_MUSICBRAINZ_DISCID,
                                 &string_mb)) {
-      QString musicbrainz_discid(string_mb);
-      qLog(Info) << "MusicBrainz discid: " << musicbrainz_discid;
-
-      MusicBrainzClient* musicbrainz_client = new MusicBrainzClient;
-      connect(musicbrainz_client, SIGNAL(Finished(const QString&, const QString&,
-                                                  MusicBrainzClient::ResultList)),
-              SLOT(AudioCDTagsLoaded(const QString&, const QString&,
-                                     MusicBrainzClient::ResultList)));
-      musicbrainz_client->StartDiscIdRequest(musicbrainz_discid);
+      ret.discid_ = QString(string_mb);
       g_free(string_mb);
-      gst_message_unref(msg_tag);
-      gst_tag_list_free(tags);
     }
+    gst_tag_list_free(tags);
+    gst_message_unref(msg_tag);
   }
 
   gst_element_set_state(pipeline, GST_STATE_NULL);
-  // This will also cause cdda_ to be unref'd.
+  // This will also cause cdda to be unref'd.
   gst_object_unref(pipeline);
+
+  return ret;
+}
+
+void CddaSongLoader::TocRead(const Toc& toc) {
+  loading_ = false;
+
+  if (songs_.isEmpty()) {
+    songs_ = PlaceholderSongs(toc.track_count_);
+    if (songs_.isEmpty()) return;
+    emit SongsLoaded(songs_);
+  }
+
+  for (int i = 0; i < songs_.count() && i < toc.lengths_nanosec_.count();
+       ++i) {
+    songs_[i].set_length_nanosec(toc.lengths_nanosec_[i]);
+  }
+  durations_loaded_ = true;
+  emit SongsDurationLoaded(songs_);
+
+  if (discid_.isEmpty() && !toc.discid_.isEmpty()) {
+    discid_ = toc.discid_;
+    LoadMetadata(discid_);
+  }
+
+  if (!pending_metadata_.isEmpty()) {
+    const SongList songs = pending_metadata_;
+    pending_metadata_.clear();
+    emit SongsMetadataLoaded(songs);
+  }
+}
+
+void CddaSongLoader::LoadMetadata(const QString& discid) {
+  qLog(Info) << "MusicBrainz discid: " << discid;
+
+  QString artist;
+  QString album;
+  MusicBrainzClient::ResultList results;
+  if (LoadCachedMetadata(discid, &artist, &album, &results)) {
+    // Queued so it never arrives before LoadSongs has returned.
+    QMetaObject::invokeMethod(
+        this, "MetadataLoaded", Qt::QueuedConnection,
+        Q_ARG(SongList, MetadataSongs(artist, album, results)));
+    return;
+  }
+
+  MusicBrainzClient* musicbrainz_client = new MusicBrainzClient(this);
+  connect(musicbrainz_client, SIGNAL(Finished(const QString&, const QString&,
+                                              MusicBrainzClient::ResultList)),
+          SLOT(AudioCDTagsLoaded(const QString&, const QString&,
+                                 MusicBrainzClient::ResultList)));
+  musicbrainz_client->StartDiscIdRequest(discid);
 }
 
 void CddaSongLoader::AudioCDTagsLoaded(
@@ -181,8 +284,25 @@ void CddaSongLoader::AudioCDTagsLoaded(
   MusicBrainzClient* musicbrainz_client =
       qobject_cast<MusicBrainzClient*>(sender());
   musicbrainz_client->deleteLater();
-  SongList songs;
   if (results.size() == 0) return;
+
+  SaveCachedMetadata(discid_, artist, album, results);
+  MetadataLoaded(MetadataSongs(artist, album, results));
+}
+
+void CddaSongLoader::MetadataLoaded(const SongList& songs) {
+  // The durations always come first.
+  if (!durations_loaded_) {
+    pending_metadata_ = songs;
+    return;
+  }
+  emit SongsMetadataLoaded(songs);
+}
+
+SongList CddaSongLoader::MetadataSongs(
+    const QString& artist, const QString& album,
+    const MusicBrainzClient::ResultList& results) const {
+  SongList songs;
   int track_number = 1;
   for (const MusicBrainzClient::Result& ret : results) {
     Song song;
@@ -200,17 +320,119 @@ void CddaSongLoader::AudioCDTagsLoaded(
     song.set_url(GetUrlFromTrack(track_number++));
     songs << song;
   }
-  emit SongsMetadataLoaded(songs);
+  return songs;
+}
+
+QString CddaSongLoader::DiscId(CdIo_t* cdio) {
+  const track_t first = cdio_get_first_track_num(cdio);
+  const track_t count = cdio_get_num_tracks(cdio);
+  if (first == CDIO_INVALID_TRACK || count == CDIO_INVALID_TRACK ||
+      count == 0) {
+    return QString();
+  }
+
+  track_t last = first + count - 1;
+  lba_t leadout = cdio_get_track_lba(cdio, CDIO_CDROM_LEADOUT_TRACK);
+
+  // MusicBrainz leaves out the data track at the end of an enhanced CD.
+  if (last > first &&
+      cdio_get_track_format(cdio, last) != TRACK_FORMAT_AUDIO) {
+    leadout = cdio_get_track_lba(cdio, last) - kDataTrackGap;
+    --last;
+  }
+  if (leadout == CDIO_INVALID_LBA) return QString();
+
+  // See https://musicbrainz.org/doc/Disc_ID_Calculation
+  QString toc;
+  toc.sprintf("%02X%02X%08X", uint(first), uint(last), uint(leadout));
+  for (int track = 1; track < 100; ++track) {
+    lba_t offset = 0;
+    if (track >= first && track <= last) {
+      offset = cdio_get_track_lba(cdio, track);
+    }
+    toc += QString().sprintf("%08X", uint(offset));
+  }
+
+  QByteArray id =
+      QCryptographicHash::hash(toc.toAscii(), QCryptographicHash::Sha1)
+          .toBase64();
+  id.replace('+', '.').replace('/', '_').replace('=', '-');
+  return QString::fromAscii(id);
+}
+
+QString CddaSongLoader::CacheFilename(const QString& discid) {
+  return Utilities::GetConfigPath(Utilities::Path_CacheRoot) + "/cdda/" +
+         discid;
+}
+
+bool CddaSongLoader::LoadCachedMetadata(
+    const QString& discid, QString* artist, QString* album,
+    MusicBrainzClient::ResultList* results) {
+  QFile file(CacheFilename(discid));
+  if (!file.open(QIODevice::ReadOnly)) return false;
+
+  QDataStream s(&file);
+  qint32 version = 0;
+  qint32 count = 0;
+  s >> version;
+  if (version != kCacheFileVersion) {
+    file.remove();
+    return false;
+  }
+
+  MusicBrainzClient::ResultList ret;
+  s >> *artist >> *album >> count;
+  for (int i = 0; i < count && s.status() == QDataStream::Ok; ++i) {
+    MusicBrainzClient::Result result;
+    qint32 duration_msec = 0;
+    qint32 track = 0;
+    qint32 year = 0;
+    s >> result.title_ >> result.artist_ >> result.album_ >> duration_msec >>
+        track >> year;
+    result.duration_msec_ = duration_msec;
+    result.track_ = track;
+    result.year_ = year;
+    ret << result;
+  }
+
+  if (s.status() != QDataStream::Ok || ret.isEmpty()) {
+    qLog(Warning) << "Corrupt audio CD cache file" << file.fileName();
+    file.remove();
+    return false;
+  }
+
+  *results = ret;
+  return true;
+}
+
+void CddaSongLoader::SaveCachedMetadata(
+    const QString& discid, const QString& artist, const QString& album,
+    const MusicBrainzClient::ResultList& results) {
+  if (discid.isEmpty()) return;
+
+  QFile file(CacheFilename(discid));
+  if (!QDir().mkpath(QFileInfo(file).path())) return;
+  if (!file.open(QIODevice::WriteOnly)) {
+    qLog(Warning) << "Couldn't write audio CD cache file" << file.fileName();
+    return;
+  }
+
+  QDataStream s(&file);
+  s << kCacheFileVersion << artist << album << qint32(results.count());
+  for (const MusicBrainzClient::Result& result : results) {
+    s << result.title_ << result.artist_ << result.album_
+      << qint32(result.duration_msec_) << qint32(result.track_)
+      << qint32(result.year_);
+  }
 }
 
 bool CddaSongLoader::HasChanged() {
-  if ((cdio_ && cdda_) && cdio_get_media_changed(cdio_) != 1) {
+  if (cdio_ && cdio_get_media_changed(cdio_) != 1) {
     return false;
   }
-  // Check if mutex is already token (i.e. init is already taking place)
-  if (!mutex_load_.tryLock()) {
+  // Don't start again while the disc is still being read
+  if (loading_) {
     return false;
   }
-  mutex_load_.unlock();
   return true;
 }
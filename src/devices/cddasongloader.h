@@ -18,7 +18,6 @@
 #ifndef CDDASONGLOADER_H
 #define CDDASONGLOADER_H
 
-#include <QMutex>
 #include <QObject>
 #include <QUrl>
 
@@ -42,7 +41,10 @@ class CddaSongLoader : public QObject {
   ~CddaSongLoader();
 
   // Load songs.
-  // Signals declared below will be emitted anytime new information will be available.
+  // Signals declared below will be emitted anytime new information will be
+  // available.  SongsLoaded comes straight away with a placeholder for each
+  // track, the others once the disc has been read and MusicBrainz (or the
+  // local cache of what it returned) has answered.
   void LoadSongs();
   bool HasChanged();
 
@@ -54,14 +56,52 @@ class CddaSongLoader : public QObject {
  private slots:
   void AudioCDTagsLoaded(const QString& artist, const QString& album,
       const MusicBrainzClient::ResultList& results);
+  void MetadataLoaded(const SongList& songs);
 
  private:
+  struct Toc {
+    Toc() : track_count_(0) {}
+
+    int track_count_;
+    QList<qint64> lengths_nanosec_;
+    QString discid_;
+  };
+
   QUrl GetUrlFromTrack(int track_number) const;
+  SongList PlaceholderSongs(int count) const;
+  SongList MetadataSongs(const QString& artist, const QString& album,
+                         const MusicBrainzClient::ResultList& results) const;
+
+  // Runs on a worker thread - it takes a while for the drive to spin up.
+  static Toc ReadToc(const QString& device);
+  void TocRead(const Toc& toc);
+
+  // Starts looking up the disc on MusicBrainz, unless it has been looked up
+  // before.
+  void LoadMetadata(const QString& discid);
+
+  // Computes the MusicBrainz disc ID from the TOC libcdio reads, so it doesn't
+  // have to wait for GStreamer.  Empty if the TOC can't be read.
+  static QString DiscId(CdIo_t* cdio);
+
+  static QString CacheFilename(const QString& discid);
+  static bool LoadCachedMetadata(const QString& discid, QString* artist,
+                                 QString* album,
+                                 MusicBrainzClient::ResultList* results);
+  static void SaveCachedMetadata(const QString& discid, const QString& artist,
+                                 const QString& album,
+                                 const MusicBrainzClient::ResultList& results);
 
   QUrl url_;
-  GstElement* cdda_;
   CdIo_t* cdio_;
-  QMutex mutex_load_;
+  bool loading_;
+
+  QString discid_;
+  bool durations_loaded_;
+  SongList songs_;
+  // Metadata that came before the durations, held back so they're always
+  // emitted in the same order.
+  SongList pending_metadata_;
 };
 
 #endif // CDDASONGLOADER_H
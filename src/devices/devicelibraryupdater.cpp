@@ -0,0 +1,83 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "devicelibraryupdater.h"
+
+#include "core/logging.h"
+#include "core/urlkey.h"
+#include "library/librarybackend.h"
+
+const int DeviceLibraryUpdater::kChunkSize = 500;
+
+DeviceLibraryUpdater::DeviceLibraryUpdater(LibraryBackend* backend)
+    : backend_(backend), total_songs_(0), changed_songs_(0) {
+  for (const Song& song : backend_->FindSongsInDirectory(1)) {
+    existing_songs_[KeyForSong(song)] = song;
+  }
+}
+
+QString DeviceLibraryUpdater::KeyForSong(const Song& song) {
+  return song.url().path();
+}
+
+void DeviceLibraryUpdater::AddSong(const Song& song) {
+  total_songs_++;
+
+  Song new_song(song);
+  QHash<QString, Song>::iterator it = existing_songs_.find(KeyForSong(song));
+  if (it != existing_songs_.end()) {
+    const Song old_song = it.value();
+    existing_songs_.erase(it);
+
+    if (old_song.url_key() == song.url_key() &&
+        old_song.IsMetadataEqual(song) &&
+        old_song.mtime() == song.mtime() &&
+        old_song.filesize() == song.filesize() &&
+        old_song.playcount() == song.playcount() &&
+        old_song.skipcount() == song.skipcount() &&
+        old_song.lastplayed() == song.lastplayed()) {
+      return;
+    }
+    new_song.set_id(old_song.id());
+  }
+
+  pending_songs_ << new_song;
+  if (pending_songs_.count() >= kChunkSize) {
+    Flush();
+  }
+}
+
+void DeviceLibraryUpdater::Flush() {
+  if (pending_songs_.isEmpty()) return;
+
+  changed_songs_ += pending_songs_.count();
+  backend_->AddOrUpdateSongs(pending_songs_);
+  pending_songs_.clear();
+}
+
+void DeviceLibraryUpdater::Finish() {
+  Flush();
+
+  if (!existing_songs_.isEmpty()) {
+    backend_->DeleteSongs(existing_songs_.values());
+  }
+
+  qLog(Debug) << "Device library updated:" << total_songs_ << "songs,"
+              << changed_songs_ << "added or changed,"
+              << existing_songs_.count() << "removed";
+  existing_songs_.clear();
+}
@@ -0,0 +1,57 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DEVICELIBRARYUPDATER_H
+#define DEVICELIBRARYUPDATER_H
+
+#include <QHash>
+
+#include "core/song.h"
+
+class LibraryBackend;
+
+// Applies a device's track list to its LibraryBackend while it is being read.
+// The backend still holds the songs from the last time the device was
+// connected, so only tracks that are new or have changed are written, in
+// chunks, and tracks that have gone from the device are deleted at the end.
+class DeviceLibraryUpdater {
+ public:
+  explicit DeviceLibraryUpdater(LibraryBackend* backend);
+
+  static const int kChunkSize;
+
+  void AddSong(const Song& song);
+  void Finish();
+
+  int total_songs() const { return total_songs_; }
+
+ private:
+  // Devices can be given a different host or mount point each time they are
+  // connected, so songs are matched on just the path.
+  static QString KeyForSong(const Song& song);
+
+  void Flush();
+
+  LibraryBackend* backend_;
+  QHash<QString, Song> existing_songs_;
+  SongList pending_songs_;
+
+  int total_songs_;
+  int changed_songs_;
+};
+
+#endif  // DEVICELIBRARYUPDATER_H
@@ -0,0 +1,267 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "devicesync.h"
+
+#include <functional>
+
+#include <QFileInfo>
+#include <QSettings>
+#include <QUrl>
+#include <QtConcurrentRun>
+
+#include "core/closure.h"
+#include "core/deletefiles.h"
+#include "core/logging.h"
+#include "core/organise.h"
+#include "core/taskmanager.h"
+#include "core/utilities.h"
+#include "devices/connecteddevice.h"
+#include "library/librarybackend.h"
+#include "library/librarymodel.h"
+#include "transcoder/transcodecache.h"
+#include "transcoder/transcoder.h"
+#include "ui/organisedialog.h"
+
+const char* DeviceSync::kSettingsGroup = "DeviceSync";
+const char* DeviceSync::kTranscodeCacheDirectory = "devicetranscodes";
+
+DeviceSync::DeviceSync(TaskManager* task_manager,
+                       std::shared_ptr<ConnectedDevice> device,
+                       const OrganiseFormat& format, int playlist_id,
+                       const SongList& songs, QObject* parent)
+    : QObject(parent),
+      task_manager_(task_manager),
+      device_(device),
+      format_(format),
+      playlist_id_(playlist_id),
+      songs_(songs),
+      transcode_cache_(new TranscodeCache(
+          kTranscodeCacheDirectory, QString(),
+          TranscodeScheduler::Priority_Background, this)),
+      transcode_count_(0),
+      transcode_task_id_(0) {
+  connect(transcode_cache_, SIGNAL(Transcoded(QString, QString, bool)),
+          SLOT(FileTranscoded(QString, QString, bool)));
+}
+
+DeviceSync::~DeviceSync() {}
+
+QString DeviceSync::Key(const Song& song) {
+  // Untagged songs fall back to their filename, which only matches on
+  // devices that keep the names they were given.
+  const QString title =
+      song.title().isEmpty()
+          ? Utilities::PathWithoutFilenameExtension(song.basefilename())
+          : song.title();
+
+  return (QStringList() << song.artist().toLower() << song.album().toLower()
+                        << QString::number(qMax(0, song.disc()))
+                        << QString::number(qMax(0, song.track()))
+                        << title.toLower()).join("\t");
+}
+
+DeviceSync::Plan DeviceSync::Diff(const SongList& wanted,
+                                  const SongList& on_device,
+                                  const QSet<QString>& synced_before) {
+  Plan ret;
+
+  QHash<QString, Song> device_songs;
+  for (const Song& song : on_device) {
+    const QString key = Key(song);
+    if (!device_songs.contains(key)) device_songs.insert(key, song);
+  }
+
+  QSet<QString> wanted_keys;
+  for (const Song& song : wanted) {
+    // Only local files can be copied.
+    if (!song.is_valid() || song.url().scheme() != "file") continue;
+
+    const QString key = Key(song);
+    if (wanted_keys.contains(key)) continue;
+    wanted_keys << key;
+    ret.keys_ << key;
+
+    QHash<QString, Song>::const_iterator it = device_songs.constFind(key);
+    if (it == device_songs.constEnd()) {
+      ret.copy_ << song;
+    } else if (it->mtime() > 0 && song.mtime() > it->mtime()) {
+      // Changed since it was copied.  The old copy goes first, since
+      // devices that name files themselves would keep both.
+      ret.copy_ << song;
+      ret.remove_ << *it;
+    } else {
+      ret.unchanged_++;
+    }
+  }
+
+  for (const Song& song : on_device) {
+    const QString key = Key(song);
+    if (synced_before.contains(key) && !wanted_keys.contains(key)) {
+      ret.remove_ << song;
+    }
+  }
+
+  return ret;
+}
+
+void DeviceSync::Start() {
+  // Reading the device's library, and asking it what it can play, can take a
+  // while.
+  QFuture<Plan> future = QtConcurrent::run(
+      std::bind(&DeviceSync::LoadPlan, this, LoadSyncedKeys()));
+  NewClosure(future, [=]() { PlanLoaded(future); });
+}
+
+DeviceSync::Plan DeviceSync::LoadPlan(const QSet<QString>& synced_before) {
+  device_->GetSupportedFiletypes(&supported_filetypes_);
+  return Diff(songs_, device_->model()->backend()->GetAllSongs(),
+              synced_before);
+}
+
+void DeviceSync::PlanLoaded(QFuture<Plan> future) {
+  plan_ = future.result();
+  qLog(Info) << "Syncing playlist" << playlist_id_ << "to"
+             << device_->unique_id() << "-" << plan_.copy_.count()
+             << "to copy," << plan_.remove_.count() << "to delete,"
+             << plan_.unchanged_ << "unchanged";
+
+  if (plan_.remove_.isEmpty()) {
+    StartTranscoding();
+    return;
+  }
+
+  // Delete first, so the space is free for the copies.
+  DeleteFiles* delete_files = new DeleteFiles(task_manager_, device_);
+  connect(delete_files, SIGNAL(Finished(SongList)),
+          SLOT(DeleteFinished(SongList)));
+  delete_files->Start(plan_.remove_);
+}
+
+void DeviceSync::DeleteFinished(const SongList& songs_with_errors) {
+  // Still ours to delete next time.
+  for (const Song& song : songs_with_errors) {
+    remove_failed_keys_ << Key(song);
+  }
+  StartTranscoding();
+}
+
+void DeviceSync::StartTranscoding() {
+  for (const Song& song : plan_.copy_) {
+    const Song::FileType type = Organise::TranscodeTarget(
+        device_.get(), supported_filetypes_, song.filetype());
+
+    // Lossy songs are left to Organise, since there's less to gain from
+    // keeping them.  A cue sheet's sections all share one file.
+    if (type == Song::Type_Unknown || !song.IsFileLossless() ||
+        song.has_cue()) {
+      ready_to_copy_ << song;
+      continue;
+    }
+
+    Song transcoded = song;
+    transcoded.set_filetype(type);
+    transcoding_[song.url().toLocalFile()] = transcoded;
+  }
+
+  transcode_count_ = transcoding_.count();
+  if (transcode_count_ == 0) {
+    MaybeStartCopying();
+    return;
+  }
+
+  transcode_task_id_ =
+      task_manager_->StartTask(tr("Encoding songs for the device"));
+  task_manager_->SetTaskProgress(transcode_task_id_, 0, transcode_count_);
+
+  for (const QString& filename : transcoding_.keys()) {
+    const Song& song = transcoding_[filename];
+    const QString cached = transcode_cache_->Request(
+        filename, Transcoder::PresetForFileType(song.filetype()));
+    if (!cached.isEmpty()) FileTranscoded(filename, cached, true);
+  }
+}
+
+void DeviceSync::FileTranscoded(const QString& input, const QString& output,
+                                bool success) {
+  if (!transcoding_.contains(input)) return;
+  Song song = transcoding_.take(input);
+
+  task_manager_->SetTaskProgress(transcode_task_id_,
+                                 transcode_count_ - transcoding_.count(),
+                                 transcode_count_);
+
+  if (!success) {
+    files_with_errors_ << input;
+  } else {
+    // Copy the encoded file instead, as Organise does with its own.
+    const QFileInfo info(output);
+    song.set_url(QUrl::fromLocalFile(output));
+    song.set_basefilename(Utilities::FiddleFileExtension(song.basefilename(),
+                                                         info.suffix()));
+    song.set_filesize(info.size());
+    ready_to_copy_ << song;
+  }
+
+  if (transcoding_.isEmpty()) {
+    task_manager_->SetTaskFinished(transcode_task_id_);
+    MaybeStartCopying();
+  }
+}
+
+void DeviceSync::MaybeStartCopying() {
+  if (!transcoding_.isEmpty()) return;
+
+  if (ready_to_copy_.isEmpty()) {
+    Finish();
+    return;
+  }
+
+  Organise* organise = new Organise(
+      task_manager_, device_, format_, true, true, false,
+      OrganiseDialog::ComputeNewSongsFilenames(ready_to_copy_, format_),
+      false);
+  connect(organise, SIGNAL(Finished(QStringList)),
+          SLOT(OrganiseFinished(QStringList)));
+  organise->Start();
+}
+
+void DeviceSync::OrganiseFinished(const QStringList& files_with_errors) {
+  files_with_errors_ << files_with_errors;
+  Finish();
+}
+
+void DeviceSync::Finish() {
+  SaveSyncedKeys(plan_.keys_ + remove_failed_keys_);
+
+  emit Finished(files_with_errors_);
+  deleteLater();
+}
+
+QSet<QString> DeviceSync::LoadSyncedKeys() const {
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  s.beginGroup(device_->unique_id());
+  return s.value(QString::number(playlist_id_)).toStringList().toSet();
+}
+
+void DeviceSync::SaveSyncedKeys(const QStringList& keys) const {
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  s.beginGroup(device_->unique_id());
+  s.setValue(QString::number(playlist_id_), keys);
+}
@@ -0,0 +1,129 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DEVICES_DEVICESYNC_H_
+#define DEVICES_DEVICESYNC_H_
+
+#include <memory>
+
+#include <QFuture>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+
+#include "core/organiseformat.h"
+#include "core/song.h"
+
+class ConnectedDevice;
+class TaskManager;
+class TranscodeCache;
+
+// Keeps a device in step with a playlist.  The playlist is compared with the
+// songs in the device's library, and only the songs that are missing from
+// the device, or have changed since they were copied, are copied again.
+// Songs that an earlier sync of the same playlist put on the device, and
+// that have gone from the playlist since, are deleted.  Anything else on the
+// device is left alone.
+//
+// Lossless songs that the device wants in another format are encoded
+// through a TranscodeCache, on as many threads as the TranscodeScheduler
+// allows, so syncing the same playlist to a second device, or again after
+// the device was wiped, doesn't encode them twice.  The copies then go
+// through Organise, which runs several at once when the device can take
+// them.
+//
+// Deletes itself when it has finished.
+class DeviceSync : public QObject {
+  Q_OBJECT
+
+ public:
+  DeviceSync(TaskManager* task_manager, std::shared_ptr<ConnectedDevice> device,
+             const OrganiseFormat& format, int playlist_id,
+             const SongList& songs, QObject* parent = nullptr);
+  ~DeviceSync();
+
+  static const char* kSettingsGroup;
+  static const char* kTranscodeCacheDirectory;
+
+  struct Plan {
+    Plan() : unchanged_(0) {}
+
+    // Songs from the playlist to copy.
+    SongList copy_;
+    // Songs from the device's library to delete.  Includes the old copies of
+    // songs that are copied again because they changed.
+    SongList remove_;
+    // Songs in the playlist that are on the device already.
+    int unchanged_;
+    // The keys of every song in the playlist.
+    QStringList keys_;
+  };
+
+  // Works out what to do.  synced_before are the keys of the songs the last
+  // sync of this playlist left on the device.
+  static Plan Diff(const SongList& wanted, const SongList& on_device,
+                   const QSet<QString>& synced_before);
+
+  // Identifies a song on the device by its tags, since the device's copy has
+  // a different filename, and maybe a different format.
+  static QString Key(const Song& song);
+
+  void Start();
+
+ signals:
+  void Finished(const QStringList& files_with_errors);
+
+ private slots:
+  void DeleteFinished(const SongList& songs_with_errors);
+  void FileTranscoded(const QString& input, const QString& output,
+                      bool success);
+  void OrganiseFinished(const QStringList& files_with_errors);
+
+ private:
+  Plan LoadPlan(const QSet<QString>& synced_before);
+  void PlanLoaded(QFuture<Plan> future);
+  void StartTranscoding();
+  void MaybeStartCopying();
+  void Finish();
+
+  QSet<QString> LoadSyncedKeys() const;
+  void SaveSyncedKeys(const QStringList& keys) const;
+
+ private:
+  TaskManager* task_manager_;
+  std::shared_ptr<ConnectedDevice> device_;
+  const OrganiseFormat format_;
+  const int playlist_id_;
+  const SongList songs_;
+
+  QList<Song::FileType> supported_filetypes_;
+  Plan plan_;
+  QStringList remove_failed_keys_;
+
+  TranscodeCache* transcode_cache_;
+  // Source filename -> the song waiting for it to be encoded, with the type
+  // it's being encoded to.
+  QHash<QString, Song> transcoding_;
+  int transcode_count_;
+  int transcode_task_id_;
+  SongList ready_to_copy_;
+
+  QStringList files_with_errors_;
+};
+
+#endif  // DEVICES_DEVICESYNC_H_
@@ -19,13 +19,26 @@
 #include "devicemanager.h"
 #include "filesystemdevice.h"
 #include "core/application.h"
+#include "core/closure.h"
+#include "core/logging.h"
+#include "core/threadpools.h"
 #include "library/librarybackend.h"
 #include "library/librarymodel.h"
+#include "library/libraryquery.h"
 #include "library/librarywatcher.h"
 
+#include <QDateTime>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QSettings>
 #include <QThread>
+#include <QTimer>
 #include <QtDebug>
 
+const char* FilesystemDevice::kSettingsGroup = "FilesystemDevice";
+const int FilesystemDevice::kSpotCheckSize = 20;
+const int FilesystemDevice::kVerifyScanDelayMsec = 60 * 1000;
+
 FilesystemDevice::FilesystemDevice(const QUrl& url, DeviceLister* lister,
                                    const QString& unique_id,
                                    DeviceManager* manager, Application* app,
@@ -45,7 +58,7 @@ FilesystemDevice::FilesystemDevice(const QUrl& url, DeviceLister* lister,
   watcher_->set_task_manager(app_->task_manager());
 
   connect(backend_, SIGNAL(DirectoryDiscovered(Directory, SubdirectoryList)),
-          watcher_, SLOT(AddDirectory(Directory, SubdirectoryList)));
+          SLOT(DirectoryDiscovered(Directory, SubdirectoryList)));
   connect(backend_, SIGNAL(DirectoryDeleted(Directory)), watcher_,
           SLOT(RemoveDirectory(Directory)));
   connect(watcher_, SIGNAL(NewOrUpdatedSongs(SongList)), backend_,
@@ -73,3 +86,80 @@ FilesystemDevice::~FilesystemDevice() {
   watcher_thread_->exit();
   watcher_thread_->wait();
 }
+
+void FilesystemDevice::DirectoryDiscovered(const Directory& dir,
+                                           const SubdirectoryList& subdirs) {
+  // FAT doesn't keep directory mtimes up to date, so a normal incremental scan
+  // can't be relied on to find what changed, and a full one takes a long time
+  // on a slow stick.  If nothing seems to have been written to the device
+  // since it was last connected its library is used as it is instead.
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  const QString key = QString::number(database_id_);
+  const QString fingerprint = Fingerprint();
+  const bool unchanged = !subdirs.isEmpty() && !fingerprint.isEmpty() &&
+                         s.value(key).toString() == fingerprint;
+  s.setValue(key, fingerprint);
+
+  if (!unchanged) {
+    QMetaObject::invokeMethod(watcher_, "AddDirectory", Qt::QueuedConnection,
+                              Q_ARG(Directory, dir),
+                              Q_ARG(SubdirectoryList, subdirs));
+    return;
+  }
+
+  QFutureWatcher<bool>* check = new QFutureWatcher<bool>(this);
+  NewClosure(check, SIGNAL(finished()), [=]() {
+    check->deleteLater();
+
+    if (!check->result()) {
+      qLog(Info) << "Spot check failed for" << url_ << "- scanning it";
+      QMetaObject::invokeMethod(watcher_, "AddDirectory", Qt::QueuedConnection,
+                                Q_ARG(Directory, dir),
+                                Q_ARG(SubdirectoryList, subdirs));
+      return;
+    }
+
+    qLog(Info) << "Using the cached library for" << url_;
+    QMetaObject::invokeMethod(watcher_, "AddDirectoryWithoutScan",
+                              Qt::QueuedConnection, Q_ARG(Directory, dir),
+                              Q_ARG(SubdirectoryList, subdirs));
+    QTimer::singleShot(kVerifyScanDelayMsec, this, SLOT(VerifyScan()));
+  });
+  check->setFuture(ThreadPools::Run<bool>(
+      ThreadPools::Pool_IO,
+      std::bind(&FilesystemDevice::SpotCheck, backend_)));
+}
+
+void FilesystemDevice::VerifyScan() { watcher_->VerifyScanAsync(); }
+
+QString FilesystemDevice::Fingerprint() const {
+  const quint64 capacity = lister_->DeviceCapacity(unique_id_);
+  if (capacity == 0) return QString();
+
+  return QString("%1/%2").arg(capacity).arg(
+      lister_->DeviceFreeSpace(unique_id_));
+}
+
+bool FilesystemDevice::SpotCheck(LibraryBackend* backend) {
+  LibraryQuery query;
+  query.SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
+  query.SetOrderBy("random()");
+  query.SetLimit(kSpotCheckSize);
+  if (!backend->ExecQuery(&query)) return false;
+
+  while (query.Next()) {
+    Song song;
+    song.InitFromQuery(query, true);
+
+    // The mtime of songs from a cue sheet is the cue sheet's.
+    if (song.has_cue()) continue;
+
+    const QFileInfo info(song.url().toLocalFile());
+    if (!info.exists() || info.size() != song.filesize() ||
+        info.lastModified().toTime_t() != song.mtime()) {
+      return false;
+    }
+  }
+  return true;
+}
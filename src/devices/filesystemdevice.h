@@ -20,8 +20,10 @@
 
 #include "connecteddevice.h"
 #include "core/filesystemmusicstorage.h"
+#include "library/directory.h"
 
 class DeviceManager;
+class LibraryBackend;
 class LibraryWatcher;
 
 class FilesystemDevice : public ConnectedDevice,
@@ -35,10 +37,30 @@ class FilesystemDevice : public ConnectedDevice,
                                bool first_time);
   ~FilesystemDevice();
 
+  static const char* kSettingsGroup;
+  // How many songs are looked at before the library of a device that seems
+  // unchanged is trusted.
+  static const int kSpotCheckSize;
+  // How long after that the whole device is checked in the background.
+  static const int kVerifyScanDelayMsec;
+
   void Init();
 
   static QStringList url_schemes() { return QStringList() << "file"; }
 
+ private slots:
+  void DirectoryDiscovered(const Directory& dir,
+                           const SubdirectoryList& subdirs);
+  void VerifyScan();
+
+ private:
+  // Changes whenever anything is written to the device, as long as the
+  // lister knows its size and free space.  Empty if it doesn't.
+  QString Fingerprint() const;
+  // Returns true if a random sample of the songs in the library are still on
+  // the device with the same size and mtime.
+  static bool SpotCheck(LibraryBackend* backend);
+
  private:
   LibraryWatcher* watcher_;
   QThread* watcher_thread_;
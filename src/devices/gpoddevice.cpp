@@ -25,6 +25,8 @@
 
 #include <QDir>
 #include <QFile>
+#include <QHash>
+#include <QSet>
 #include <QThread>
 #include <QtDebug>
 
@@ -162,14 +164,20 @@ void GPodDevice::FinishCopy(bool success) {
 
 void GPodDevice::StartDelete() { StartCopy(nullptr); }
 
-bool GPodDevice::RemoveTrackFromITunesDb(const QString& path,
-                                         const QString& relative_to) {
+QString GPodDevice::ITunesDbPath(const QString& path,
+                                 const QString& relative_to) {
   QString ipod_filename = path;
   if (!relative_to.isEmpty() && path.startsWith(relative_to))
     ipod_filename.remove(
         0, relative_to.length() + (relative_to.endsWith('/') ? -1 : 0));
 
   ipod_filename.replace('/', ':');
+  return ipod_filename;
+}
+
+bool GPodDevice::RemoveTrackFromITunesDb(const QString& path,
+                                         const QString& relative_to) {
+  const QString ipod_filename = ITunesDbPath(path, relative_to);
 
   // Find the track in the itdb, identify it by its filename
   Itdb_Track* track = nullptr;
@@ -218,6 +226,63 @@ bool GPodDevice::DeleteFromStorage(const DeleteJob& job) {
   return true;
 }
 
+SongList GPodDevice::DeleteAllFromStorage(const QList<DeleteJob>& jobs) {
+  Q_ASSERT(db_);
+
+  // Look the tracks up by their filename once, rather than going through the
+  // whole database and every playlist for each of them.
+  QHash<QString, Itdb_Track*> tracks_by_path;
+  for (GList* tracks = db_->tracks; tracks != nullptr; tracks = tracks->next) {
+    Itdb_Track* track = static_cast<Itdb_Track*>(tracks->data);
+    tracks_by_path[QString(track->ipod_path)] = track;
+  }
+
+  SongList ret;
+  QList<Itdb_Track*> found_tracks;
+  QList<const DeleteJob*> found_jobs;
+  for (const DeleteJob& job : jobs) {
+    const QString path = job.metadata_.url().toLocalFile();
+    Itdb_Track* track = tracks_by_path.take(ITunesDbPath(path, url_.path()));
+    if (!track) {
+      qLog(Warning) << "Couldn't find song" << path << "in iTunesDB";
+      ret << job.metadata_;
+      continue;
+    }
+    found_tracks << track;
+    found_jobs << &job;
+  }
+
+  // Remove the tracks from all playlists
+  const QSet<Itdb_Track*> track_set = QSet<Itdb_Track*>::fromList(found_tracks);
+  for (GList* playlists = db_->playlists; playlists != nullptr;
+       playlists = playlists->next) {
+    Itdb_Playlist* playlist = static_cast<Itdb_Playlist*>(playlists->data);
+
+    QList<Itdb_Track*> members;
+    for (GList* it = playlist->members; it != nullptr; it = it->next) {
+      Itdb_Track* track = static_cast<Itdb_Track*>(it->data);
+      if (track_set.contains(track)) members << track;
+    }
+    for (Itdb_Track* track : members) {
+      itdb_playlist_remove_track(playlist, track);
+    }
+  }
+
+  for (int i = 0; i < found_tracks.count(); ++i) {
+    // Remove the track from the database, this frees the struct too
+    itdb_track_remove(found_tracks[i]);
+
+    const Song& song = found_jobs[i]->metadata_;
+    if (QFile::remove(song.url().toLocalFile())) {
+      songs_to_remove_ << song;
+    } else {
+      ret << song;
+    }
+  }
+
+  return ret;
+}
+
 void GPodDevice::FinishDelete(bool success) {
   WriteDatabase(success);
   ConnectedDevice::FinishDelete(success);
@@ -49,6 +49,7 @@ class GPodDevice : public ConnectedDevice, public virtual MusicStorage {
 
   void StartDelete();
   bool DeleteFromStorage(const DeleteJob& job);
+  SongList DeleteAllFromStorage(const QList<DeleteJob>& jobs);
   void FinishDelete(bool success);
 
  protected slots:
@@ -57,6 +58,8 @@ class GPodDevice : public ConnectedDevice, public virtual MusicStorage {
  protected:
   Itdb_Track* AddTrackToITunesDb(const Song& metadata);
   void AddTrackToModel(Itdb_Track* track, const QString& prefix);
+  // Converts a path on the device to the form used in the iTunesDB.
+  static QString ITunesDbPath(const QString& path, const QString& relative_to);
   bool RemoveTrackFromITunesDb(const QString& path,
                                const QString& relative_to = QString());
   virtual void FinaliseDatabase() {}
@@ -16,6 +16,7 @@
 */
 
 #include "connecteddevice.h"
+#include "devicelibraryupdater.h"
 #include "gpodloader.h"
 #include "core/logging.h"
 #include "core/song.h"
@@ -69,7 +70,11 @@ void GPodLoader::LoadDatabase() {
                              ? QDir::fromNativeSeparators(mount_point_)
                              : path_prefix_;
 
-  SongList songs;
+  // Only the songs that changed since the device was last connected are
+  // written to the database, a chunk at a time.
+  DeviceLibraryUpdater updater(backend_);
+  const int total = g_list_length(db->tracks);
+  int progress = 0;
   for (GList* tracks = db->tracks; tracks != nullptr; tracks = tracks->next) {
     Itdb_Track* track = static_cast<Itdb_Track*>(tracks->data);
 
@@ -78,14 +83,13 @@ void GPodLoader::LoadDatabase() {
     song.set_directory_id(1);
 
     if (type_ != Song::Type_Unknown) song.set_filetype(type_);
-    songs << song;
-  }
-
-  // Need to remove all the existing songs in the database first
-  backend_->DeleteSongs(backend_->FindSongsInDirectory(1));
+    updater.AddSong(song);
 
-  // Add the songs we've just loaded
-  backend_->AddOrUpdateSongs(songs);
+    if (++progress % DeviceLibraryUpdater::kChunkSize == 0) {
+      task_manager_->SetTaskProgress(task_id, progress, total);
+    }
+  }
+  updater.Finish();
 
   moveToThread(original_thread_);
 
@@ -20,6 +20,7 @@
 #include <libmtp.h>
 
 #include "connecteddevice.h"
+#include "devicelibraryupdater.h"
 #include "mtpconnection.h"
 #include "core/song.h"
 #include "core/taskmanager.h"
@@ -57,8 +58,9 @@ bool MtpLoader::TryLoad() {
     return false;
   }
 
-  // Load the list of songs on the device
-  SongList songs;
+  // Load the list of songs on the device, and write the ones that changed
+  // since it was last connected to the database as we go.
+  DeviceLibraryUpdater updater(backend_);
   LIBMTP_track_t* tracks =
       LIBMTP_Get_Tracklisting_With_Callback(dev.device(), nullptr, nullptr);
   while (tracks) {
@@ -67,17 +69,12 @@ bool MtpLoader::TryLoad() {
     Song song;
     song.InitFromMTP(track, url_.host());
     song.set_directory_id(1);
-    songs << song;
+    updater.AddSong(song);
 
     tracks = tracks->next;
     LIBMTP_destroy_track_t(track);
   }
-
-  // Need to remove all the existing songs in the database first
-  backend_->DeleteSongs(backend_->FindSongsInDirectory(1));
-
-  // Add the songs we've just loaded
-  backend_->AddOrUpdateSongs(songs);
+  updater.Finish();
 
   return true;
 }
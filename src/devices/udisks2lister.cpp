@@ -18,6 +18,7 @@
 #include "udisks2lister.h"
 
 #include <QDBusConnection>
+#include <QDBusPendingCallWatcher>
 
 #include "core/logging.h"
 #include "core/utilities.h"
@@ -144,10 +145,28 @@ void Udisks2Lister::Init() {
       udisks2_service_, "/org/freedesktop/UDisks2",
       QDBusConnection::systemBus()));
 
-  QDBusPendingReply<ManagedObjectList> reply =
-      udisks2_interface_->GetManagedObjects();
-  reply.waitForFinished();
+  // Listen for changes first, so nothing is missed while the existing devices
+  // are listed.
+  connect(udisks2_interface_.get(),
+          SIGNAL(InterfacesAdded(QDBusObjectPath, InterfacesAndProperties)),
+          SLOT(DBusInterfaceAdded(QDBusObjectPath, InterfacesAndProperties)));
+  connect(udisks2_interface_.get(),
+          SIGNAL(InterfacesRemoved(QDBusObjectPath, QStringList)),
+          SLOT(DBusInterfaceRemoved(QDBusObjectPath, QStringList)));
+
+  // Don't wait for the reply here: a slow udisks daemon would keep this
+  // thread busy, and the lister couldn't be shut down until it answered.
+  QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(
+      udisks2_interface_->GetManagedObjects(), this);
+  connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+          SLOT(GetManagedObjectsFinished(QDBusPendingCallWatcher*)));
+}
+
+void Udisks2Lister::GetManagedObjectsFinished(
+    QDBusPendingCallWatcher* watcher) {
+  watcher->deleteLater();
 
+  QDBusPendingReply<ManagedObjectList> reply = *watcher;
   if (!reply.isValid()) {
     qLog(Warning) << "Error enumerating udisks2 devices:"
                   << reply.error().name() << reply.error().message();
@@ -155,25 +174,20 @@ void Udisks2Lister::Init() {
     return;
   }
 
-  for (const QDBusObjectPath& path : reply.value().keys()) {
-    auto partition_data = ReadPartitionData(path);
+  // The reply has the properties of every object, so each device can be added
+  // as soon as it's been looked at.
+  const ManagedObjectList objects = reply.value();
+  for (auto it = objects.constBegin(); it != objects.constEnd(); ++it) {
+    const PartitionData partition_data = ReadPartitionData(it.key(), objects);
+    if (partition_data.dbus_path.isEmpty()) continue;
 
-    if (!partition_data.dbus_path.isEmpty()) {
+    const QString id = partition_data.unique_id();
+    {
       QWriteLocker locker(&device_data_lock_);
-      device_data_[partition_data.unique_id()] = partition_data;
+      device_data_[id] = partition_data;
     }
-  }
-
-  for (const auto& id : device_data_.keys()) {
     emit DeviceAdded(id);
   }
-
-  connect(udisks2_interface_.get(),
-          SIGNAL(InterfacesAdded(QDBusObjectPath, InterfacesAndProperties)),
-          SLOT(DBusInterfaceAdded(QDBusObjectPath, InterfacesAndProperties)));
-  connect(udisks2_interface_.get(),
-          SIGNAL(InterfacesRemoved(QDBusObjectPath, QStringList)),
-          SLOT(DBusInterfaceRemoved(QDBusObjectPath, QStringList)));
 }
 
 void Udisks2Lister::DBusInterfaceAdded(
@@ -344,22 +358,61 @@ Udisks2Lister::PartitionData Udisks2Lister::ReadPartitionData(
       result.uuid = block.idUUID();
       result.capacity = drive.size();
 
-      if (!result.label.isEmpty())
-        result.friendly_name = result.label;
-      else
-        result.friendly_name = result.model + " " + result.uuid;
-
       for (const auto& path : filesystem.mountPoints())
         result.mount_paths.push_back(path);
 
-      result.free_space =
-          Utilities::FileSystemFreeSpace(result.mount_paths.at(0));
+      FinishPartitionData(&result);
     }
   }
 
   return result;
 }
 
+Udisks2Lister::PartitionData Udisks2Lister::ReadPartitionData(
+    const QDBusObjectPath& path, const ManagedObjectList& objects) {
+  PartitionData result;
+  const InterfacesAndProperties interfaces = objects.value(path);
+  const QVariantMap filesystem =
+      interfaces.value("org.freedesktop.UDisks2.Filesystem");
+  const QVariantMap block = interfaces.value("org.freedesktop.UDisks2.Block");
+  if (filesystem.isEmpty() || block.isEmpty()) return result;
+
+  const QList<QByteArray> mount_points =
+      qdbus_cast<QList<QByteArray>>(filesystem["MountPoints"]);
+  if (mount_points.isEmpty()) return result;
+
+  const QDBusObjectPath drive_path =
+      qvariant_cast<QDBusObjectPath>(block["Drive"]);
+  const QVariantMap drive = objects.value(drive_path)
+                                .value("org.freedesktop.UDisks2.Drive");
+  if (drive.isEmpty() || !drive["MediaRemovable"].toBool()) return result;
+
+  result.dbus_path = path.path();
+  result.dbus_drive_path = drive_path.path();
+
+  result.serial = drive["Serial"].toString();
+  result.vendor = drive["Vendor"].toString();
+  result.model = drive["Model"].toString();
+
+  result.label = block["IdLabel"].toString();
+  result.uuid = block["IdUUID"].toString();
+  result.capacity = drive["Size"].toULongLong();
+
+  for (const auto& path : mount_points) result.mount_paths.push_back(path);
+
+  FinishPartitionData(&result);
+  return result;
+}
+
+void Udisks2Lister::FinishPartitionData(PartitionData* data) {
+  if (!data->label.isEmpty())
+    data->friendly_name = data->label;
+  else
+    data->friendly_name = data->model + " " + data->uuid;
+
+  data->free_space = Utilities::FileSystemFreeSpace(data->mount_paths.at(0));
+}
+
 QString Udisks2Lister::PartitionData::unique_id() const {
   return QString("Udisks2/%1/%2/%3/%4/%5")
       .arg(serial, vendor, model)
@@ -30,6 +30,7 @@
 
 class OrgFreedesktopDBusObjectManagerInterface;
 class OrgFreedesktopUDisks2JobInterface;
+class QDBusPendingCallWatcher;
 
 class Udisks2Lister : public DeviceLister {
   Q_OBJECT
@@ -58,6 +59,7 @@ class Udisks2Lister : public DeviceLister {
   void Init() override;
 
  private slots:
+  void GetManagedObjectsFinished(QDBusPendingCallWatcher* watcher);
   void DBusInterfaceAdded(const QDBusObjectPath& path,
                           const InterfacesAndProperties& ifaces);
   void DBusInterfaceRemoved(const QDBusObjectPath& path,
@@ -104,6 +106,12 @@ class Udisks2Lister : public DeviceLister {
   };
 
   PartitionData ReadPartitionData(const QDBusObjectPath& path);
+  // The same, but from properties udisks has already sent, without asking it
+  // for anything else.
+  PartitionData ReadPartitionData(const QDBusObjectPath& path,
+                                  const ManagedObjectList& objects);
+  // Sets the fields that don't come from udisks.
+  static void FinishPartitionData(PartitionData* data);
   void HandleFinishedMountJob(
       const Udisks2Lister::PartitionData& partition_data);
   void HandleFinishedUnmountJob(
@@ -0,0 +1,87 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bufferconsumerqueue.h"
+#include "bufferconsumer.h"
+#include "core/logging.h"
+
+const int BufferConsumerQueue::kCapacity = 64;
+const qint64 BufferConsumerQueue::kLateMsec = 100;
+
+BufferConsumerQueue::BufferConsumerQueue(BufferConsumer* consumer,
+                                         int pipeline_id)
+    : consumer_(consumer),
+      pipeline_id_(pipeline_id),
+      ring_(new Entry[kCapacity]),
+      head_(0),
+      tail_(0),
+      stopping_(0),
+      dropped_buffers_(0),
+      late_buffers_(0) {
+  clock_.start();
+}
+
+BufferConsumerQueue::~BufferConsumerQueue() {
+  stopping_.fetchAndStoreOrdered(1);
+  available_.release();
+  wait();
+
+  // Anything the thread didn't get round to
+  const int head = head_.fetchAndAddAcquire(0);
+  for (int tail = tail_; tail != head; tail = (tail + 1) % kCapacity) {
+    gst_buffer_unref(ring_[tail].buffer_);
+  }
+
+  if (dropped_buffers_ != 0 || late_buffers_ != 0) {
+    qLog(Debug) << "Buffer consumer for pipeline" << pipeline_id_ << "dropped"
+                << int(dropped_buffers_) << "buffers, and" << int(late_buffers_)
+                << "were late";
+  }
+}
+
+void BufferConsumerQueue::Push(GstBuffer* buffer) {
+  const int head = head_;
+  const int next = (head + 1) % kCapacity;
+  if (next == tail_.fetchAndAddAcquire(0)) {
+    gst_buffer_unref(buffer);
+    dropped_buffers_.ref();
+    return;
+  }
+
+  ring_[head].buffer_ = buffer;
+  ring_[head].queued_msec_ = clock_.elapsed();
+  head_.fetchAndStoreRelease(next);
+  available_.release();
+}
+
+void BufferConsumerQueue::run() {
+  forever {
+    available_.acquire();
+    if (stopping_.fetchAndAddAcquire(0)) return;
+
+    // The semaphore counts the filled slots, so there's one here.
+    head_.fetchAndAddAcquire(0);
+    const int tail = tail_;
+    const Entry entry = ring_[tail];
+    tail_.fetchAndStoreRelease((tail + 1) % kCapacity);
+
+    if (clock_.elapsed() - entry.queued_msec_ > kLateMsec) {
+      late_buffers_.ref();
+    }
+    consumer_->ConsumeBuffer(entry.buffer_, pipeline_id_);
+  }
+}
@@ -0,0 +1,81 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BUFFERCONSUMERQUEUE_H
+#define BUFFERCONSUMERQUEUE_H
+
+#include <memory>
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QSemaphore>
+#include <QThread>
+
+#include <gst/gstbuffer.h>
+
+class BufferConsumer;
+
+// Hands buffers to one BufferConsumer on a thread of its own, so a slow
+// consumer can't hold up the GStreamer streaming thread.  Buffers are passed
+// through a fixed size single-producer single-consumer ring: Push must only
+// ever be called from one thread at a time, and drops the buffer rather than
+// waiting if the ring is full.
+class BufferConsumerQueue : public QThread {
+ public:
+  BufferConsumerQueue(BufferConsumer* consumer, int pipeline_id);
+  // Stops the thread, so the consumer won't be called again.
+  ~BufferConsumerQueue();
+
+  BufferConsumer* consumer() const { return consumer_; }
+
+  // Takes ownership of the buffer.
+  void Push(GstBuffer* buffer);
+
+  // Buffers thrown away because the ring was full, and buffers that waited in
+  // the ring for longer than kLateMsec.
+  int dropped_buffers() const { return dropped_buffers_; }
+  int late_buffers() const { return late_buffers_; }
+
+  static const int kCapacity;
+  static const qint64 kLateMsec;
+
+ protected:
+  void run();
+
+ private:
+  struct Entry {
+    GstBuffer* buffer_;
+    qint64 queued_msec_;
+  };
+
+  BufferConsumer* consumer_;
+  int pipeline_id_;
+
+  QElapsedTimer clock_;
+
+  // head_ is only written by Push and tail_ only by run().
+  std::unique_ptr<Entry[]> ring_;
+  QAtomicInt head_;
+  QAtomicInt tail_;
+  QSemaphore available_;
+  QAtomicInt stopping_;
+
+  QAtomicInt dropped_buffers_;
+  QAtomicInt late_buffers_;
+};
+
+#endif  // BUFFERCONSUMERQUEUE_H
@@ -33,6 +33,8 @@
 
 #include "engine_fwd.h"
 
+class SpectrumService;
+
 namespace Engine {
 
 typedef std::vector<int16_t> Scope;
@@ -46,6 +48,11 @@ class Base : public QObject {
   virtual bool Init() = 0;
 
   virtual void StartPreloading(const QUrl&, bool, qint64, qint64) {}
+  // Gains in dB from the library's loudness analysis, used if the file at
+  // url turns out to have no ReplayGain tags.  Call before Play or
+  // StartPreloading.
+  virtual void SetPrecomputedGain(const QUrl&, float track_gain_db,
+                                  float album_gain_db) {}
   virtual bool Play(quint64 offset_nanosec) = 0;
   virtual void Stop(bool stop_after = false) = 0;
   virtual void Pause() = 0;
@@ -86,6 +93,9 @@ class Base : public QObject {
   // Simple accessors
   inline uint volume() const { return volume_; }
   virtual const Scope& scope(int chunk_length) { return scope_; }
+  // Spectra of what's playing for the analyzers, or null if the engine can't
+  // provide them.
+  virtual SpectrumService* spectrum_service() { return nullptr; }
   bool is_fadeout_enabled() const { return fadeout_enabled_; }
   bool is_crossfade_enabled() const { return crossfade_enabled_; }
   bool is_autocrossfade_enabled() const { return autocrossfade_enabled_; }
@@ -167,6 +177,17 @@ struct SimpleMetaBundle {
   QString length;
   QString year;
   QString tracknr;
+
+  bool operator==(const SimpleMetaBundle& other) const {
+    return title == other.title && artist == other.artist &&
+           album == other.album && comment == other.comment &&
+           genre == other.genre && bitrate == other.bitrate &&
+           samplerate == other.samplerate && length == other.length &&
+           year == other.year && tracknr == other.tracknr;
+  }
+  bool operator!=(const SimpleMetaBundle& other) const {
+    return !(*this == other);
+  }
 };
 
 }  // namespace
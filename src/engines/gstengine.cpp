@@ -37,6 +37,7 @@
 #include <QTimeLine>
 #include <QDir>
 #include <QtConcurrentRun>
+#include <qnumeric.h>
 
 #include <gst/gst.h>
 #include <gst/pbutils/pbutils.h>
@@ -46,10 +47,13 @@
 #include "gstenginepipeline.h"
 #include "core/closure.h"
 #include "core/logging.h"
+#include "core/playbacktrace.h"
 #include "core/taskmanager.h"
 #include "core/timeconstants.h"
 #include "core/utilities.h"
 
+#include "gst/equalizer/plugin.h"
+
 #ifdef HAVE_MOODBAR
 #include "gst/moodbar/plugin.h"
 #endif
@@ -85,6 +89,10 @@ using std::vector;
 
 const char* GstEngine::kSettingsGroup = "GstEngine";
 const char* GstEngine::kAutoSink = "autoaudiosink";
+const int GstEngine::kDefaultPrerollPipelines = 1;
+const int GstEngine::kDefaultPrerollMemoryMb = 32;
+const int GstEngine::kMaxPrecomputedGains = 16;
+const int GstEngine::kMetaDataCoalesceMsec = 500;
 const char* GstEngine::kHypnotoadPipeline =
     "audiotestsrc wave=6 ! "
     "audioecho intensity=1 delay=50000000 ! "
@@ -100,6 +108,9 @@ GstEngine::GstEngine(TaskManager* task_manager)
     : Engine::Base(),
       task_manager_(task_manager),
       buffering_task_id_(-1),
+      spectrum_service_(new SpectrumService),
+      preroll_pipelines_(kDefaultPrerollPipelines),
+      preroll_memory_bytes_(0),
       latest_buffer_(nullptr),
       equalizer_enabled_(false),
       stereo_balance_(0.0f),
@@ -111,7 +122,16 @@ GstEngine::GstEngine(TaskManager* task_manager)
       buffer_min_fill_(33),
       mono_playback_(false),
       sample_rate_(kAutoSampleRate),
+      direct_output_(false),
+      sink_buffer_duration_nanosec_(0),
+      shared_crossfade_(false),
+      stream_output_(nullptr),
+      stream_format_(StreamFormat_Mp3),
+      stream_bitrate_kbps_(0),
       seek_timer_(new QTimer(this)),
+      clean_play_timer_(new QTimer(this)),
+      metadata_timer_(new QTimer(this)),
+      pending_metadata_pipeline_id_(-1),
       timer_id_(-1),
       next_element_id_(0),
       is_fading_out_to_pause_(false),
@@ -122,6 +142,17 @@ GstEngine::GstEngine(TaskManager* task_manager)
   seek_timer_->setInterval(kSeekDelayNanosec / kNsecPerMsec);
   connect(seek_timer_, SIGNAL(timeout()), SLOT(SeekNow()));
 
+  clean_play_timer_->setSingleShot(true);
+  clean_play_timer_->setInterval(StreamBuffering::kCleanPlayMsec);
+  connect(clean_play_timer_, SIGNAL(timeout()), SLOT(StreamPlayedCleanly()));
+
+  metadata_timer_->setSingleShot(true);
+  metadata_timer_->setInterval(kMetaDataCoalesceMsec);
+  connect(metadata_timer_, SIGNAL(timeout()), SLOT(EmitPendingMetaData()));
+
+  // Fed by every playing pipeline like the other consumers
+  buffer_consumers_ << spectrum_service_.get();
+
   ReloadSettings();
 
 #ifdef Q_OS_DARWIN
@@ -136,6 +167,7 @@ GstEngine::~GstEngine() {
   EnsureInitialised();
 
   current_pipeline_.reset();
+  prerolled_pipelines_.clear();
 
   qDeleteAll(device_finders_);
 
@@ -154,6 +186,8 @@ void GstEngine::InitialiseGstreamer() {
 
   gst_pb_utils_init();
 
+  gstfastequalizer_register_static();
+
 #ifdef HAVE_MOODBAR
   gstfastspectrum_register_static();
 #endif
@@ -228,6 +262,22 @@ void GstEngine::ReloadSettings() {
 
   mono_playback_ = s.value("monoplayback", false).toBool();
   sample_rate_ = s.value("samplerate", kAutoSampleRate).toInt();
+
+  direct_output_ =
+      s.value("directoutput", false).toBool() && SupportsDirectOutput(sink_);
+  sink_buffer_duration_nanosec_ =
+      s.value("sinkbuffer", 0).toLongLong() * kNsecPerMsec;
+
+  shared_crossfade_ = s.value("sharedcrossfade", false).toBool();
+
+  preroll_pipelines_ =
+      s.value("prerollpipelines", kDefaultPrerollPipelines).toInt();
+  preroll_memory_bytes_ =
+      s.value("prerollmemory", kDefaultPrerollMemoryMb).toULongLong() * 1024 *
+      1024;
+
+  // The old pipelines were built with the old settings
+  prerolled_pipelines_.clear();
 }
 
 qint64 GstEngine::position_nanosec() const {
@@ -369,12 +419,103 @@ void GstEngine::StartPreloading(const QUrl& url, bool force_stop_at_end,
   EnsureInitialised();
 
   QUrl gst_url = FixupUrl(url);
+  const qint64 end = force_stop_at_end ? end_nanosec : 0;
+
+  // Slow sources get a pipeline of their own that's ready to go by the time
+  // this one finishes.  Another section of the file that's already playing
+  // is always best carried on in the same pipeline though.
+  if (preroll_pipelines_ > 0 && ShouldPreroll(gst_url) &&
+      !(current_pipeline_ && current_pipeline_->url() == gst_url)) {
+    PrerollPipeline(gst_url, end);
+    return;
+  }
 
   // No crossfading, so we can just queue the new URL in the existing
   // pipeline and get gapless playback (hopefully)
-  if (current_pipeline_)
-    current_pipeline_->SetNextUrl(gst_url, beginning_nanosec,
-                                  force_stop_at_end ? end_nanosec : 0);
+  if (current_pipeline_) {
+    current_pipeline_->SetNextUrl(gst_url, beginning_nanosec, end);
+    current_pipeline_->SetNextFallbackGain(FallbackGain(url));
+  }
+}
+
+void GstEngine::SetPrecomputedGain(const QUrl& url, float track_gain_db,
+                                   float album_gain_db) {
+  // Only the current and next tracks matter, so don't let this grow forever.
+  if (precomputed_gains_.count() >= kMaxPrecomputedGains) {
+    precomputed_gains_.clear();
+  }
+  precomputed_gains_[url] = qMakePair(track_gain_db, album_gain_db);
+}
+
+float GstEngine::FallbackGain(const QUrl& url) const {
+  if (!precomputed_gains_.contains(url)) return 0.0;
+
+  const QPair<float, float> gains = precomputed_gains_.value(url);
+
+  // rg_mode_ 1 is album mode.  Fall back to the track gain if the album
+  // couldn't be measured.
+  const float gain =
+      rg_mode_ == 1 && !qIsNaN(gains.second) ? gains.second : gains.first;
+  return qIsNaN(gain) ? 0.0 : qBound(-60.0f, gain, 60.0f);
+}
+
+bool GstEngine::ShouldPreroll(const QUrl& url) {
+  if (url.scheme() == "file") {
+    // FixupUrl turns files on Windows shares into //host/share/file paths
+    return url.path().startsWith("//");
+  }
+
+  // Spotify playback is started by the server as soon as the decode bin is
+  // created, and the test pipelines don't need it.
+  return url.scheme() != "spotify" && url.scheme() != "hypnotoad" &&
+         url.scheme() != "enterprise";
+}
+
+void GstEngine::PrerollPipeline(const QUrl& url, qint64 end_nanosec) {
+  for (const PrerolledPipeline& prerolled : prerolled_pipelines_) {
+    if (prerolled.pipeline_->url() == url &&
+        prerolled.end_nanosec_ == end_nanosec) {
+      return;
+    }
+  }
+
+  shared_ptr<GstEnginePipeline> pipeline = CreatePipeline();
+  pipeline->set_buffer_max_bytes(preroll_memory_bytes_ / preroll_pipelines_);
+
+  // The other consumers mustn't see the prerolled buffer until it's playing
+  pipeline->RemoveAllBufferConsumers();
+  pipeline->AddBufferConsumer(this);
+  if (!pipeline->InitFromUrl(url, end_nanosec)) return;
+  pipeline->SetState(GST_STATE_PAUSED);
+
+  PrerolledPipeline prerolled;
+  prerolled.pipeline_ = pipeline;
+  prerolled.end_nanosec_ = end_nanosec;
+  prerolled_pipelines_ << prerolled;
+
+  while (prerolled_pipelines_.count() > preroll_pipelines_) {
+    prerolled_pipelines_.removeFirst();
+  }
+}
+
+shared_ptr<GstEnginePipeline> GstEngine::TakePrerolledPipeline(
+    const QUrl& url, qint64 end_nanosec) {
+  for (int i = 0; i < prerolled_pipelines_.count(); ++i) {
+    const PrerolledPipeline& prerolled = prerolled_pipelines_[i];
+    if (prerolled.pipeline_->url() == url &&
+        prerolled.end_nanosec_ == end_nanosec) {
+      shared_ptr<GstEnginePipeline> ret = prerolled.pipeline_;
+      prerolled_pipelines_.removeAt(i);
+
+      // It's playing now, so it can buffer as much as any other pipeline
+      ret->set_buffer_max_bytes(0);
+      for (BufferConsumer* consumer : buffer_consumers_) {
+        ret->AddBufferConsumer(consumer);
+      }
+      return ret;
+    }
+  }
+  return shared_ptr<GstEnginePipeline>();
 }
 
 QUrl GstEngine::FixupUrl(const QUrl& url) {
@@ -398,6 +539,7 @@ bool GstEngine::Load(const QUrl& url, Engine::TrackChangeFlags change,
 
   Engine::Base::Load(url, change, force_stop_at_end, beginning_nanosec,
                      end_nanosec);
+  ResetMetaData();
 
   QUrl gst_url = FixupUrl(url);
 
@@ -418,14 +560,35 @@ bool GstEngine::Load(const QUrl& url, Engine::TrackChangeFlags change,
     return true;
   }
 
-  shared_ptr<GstEnginePipeline> pipeline =
-      CreatePipeline(gst_url, force_stop_at_end ? end_nanosec : 0);
+  const qint64 end = force_stop_at_end ? end_nanosec : 0;
+
+  // Fade the new track in through the current pipeline's mixer if we can.
+  // Tracks that start or stop part way through the file still get their own
+  // pipeline.
+  if (crossfade && shared_crossfade_ && !is_fading_out_to_pause_ &&
+      beginning_nanosec == 0 && end == 0 &&
+      current_pipeline_->CrossfadeTo(gst_url, fadeout_duration_nanosec_)) {
+    current_pipeline_->SetFallbackGain(FallbackGain(url));
+    BufferingFinished();
+    return true;
+  }
+
+  const int trace_id = PlaybackTrace::Instance()->current_id();
+  shared_ptr<GstEnginePipeline> pipeline = TakePrerolledPipeline(gst_url, end);
+  if (pipeline) {
+    pipeline->set_trace_id(trace_id);
+  } else {
+    pipeline = CreatePipeline(gst_url, end, trace_id);
+  }
   if (!pipeline) return false;
+  pipeline->SetFallbackGain(FallbackGain(url));
 
   if (crossfade) StartFadeout();
 
   BufferingFinished();
+  clean_play_timer_->stop();
   current_pipeline_ = pipeline;
+  SetBackgroundHost(current_pipeline_);
 
   SetVolume(volume_);
   SetEqualizerEnabled(equalizer_enabled_);
@@ -501,6 +664,7 @@ void GstEngine::PlayDone(QFuture<GstStateChangeReturn> future,
     if (!redirect_url.isEmpty() && redirect_url != current_pipeline_->url()) {
       qLog(Info) << "Redirecting to" << redirect_url;
       current_pipeline_ = CreatePipeline(redirect_url, end_nanosec_);
+      SetBackgroundHost(current_pipeline_);
       Play(offset_nanosec);
       return;
     }
@@ -508,12 +672,17 @@ void GstEngine::PlayDone(QFuture<GstStateChangeReturn> future,
     // Failure - give up
     qLog(Warning) << "Could not set thread to PLAYING.";
     current_pipeline_.reset();
+    SetBackgroundHost(nullptr);
     BufferingFinished();
     return;
   }
 
   StartTimers();
 
+  if (StreamBuffering::IsStream(current_pipeline_->url())) {
+    clean_play_timer_->start();
+  }
+
   // initial offset
   if (offset_nanosec != 0 || beginning_nanosec_ != 0) {
     Seek(offset_nanosec);
@@ -526,6 +695,8 @@ void GstEngine::PlayDone(QFuture<GstStateChangeReturn> future,
 
 void GstEngine::Stop(bool stop_after) {
   StopTimers();
+  clean_play_timer_->stop();
+  ResetMetaData();
 
   url_ = QUrl();  // To ensure we return Empty from state()
   beginning_nanosec_ = end_nanosec_ = 0;
@@ -544,6 +715,8 @@ void GstEngine::Stop(bool stop_after) {
   if (fadeout_enabled_ && current_pipeline_ && !stop_after) StartFadeout();
 
   current_pipeline_.reset();
+  prerolled_pipelines_.clear();
+  SetBackgroundHost(nullptr);
   BufferingFinished();
   emit StateChanged(Engine::Empty);
 }
@@ -556,6 +729,7 @@ void GstEngine::FadeoutFinished() {
 void GstEngine::FadeoutPauseFinished() {
   fadeout_pause_pipeline_->SetState(GST_STATE_PAUSED);
   current_pipeline_->SetState(GST_STATE_PAUSED);
+  SetBackgroundHost(nullptr);
   emit StateChanged(Engine::Paused);
   StopTimers();
 
@@ -570,6 +744,8 @@ void GstEngine::FadeoutPauseFinished() {
 void GstEngine::Pause() {
   if (!current_pipeline_ || current_pipeline_->is_buffering()) return;
 
+  clean_play_timer_->stop();
+
   // Check if we started a fade out. If it isn't finished yet and the user
   // pressed play, we inverse the fader and resume the playback.
   if (is_fading_out_to_pause_) {
@@ -588,6 +764,7 @@ void GstEngine::Pause() {
       StartFadeoutPause();
     } else {
       current_pipeline_->SetState(GST_STATE_PAUSED);
+      SetBackgroundHost(nullptr);
       emit StateChanged(Engine::Paused);
       StopTimers();
     }
@@ -599,6 +776,7 @@ void GstEngine::Unpause() {
 
   if (current_pipeline_->state() == GST_STATE_PAUSED) {
     current_pipeline_->SetState(GST_STATE_PLAYING);
+    SetBackgroundHost(current_pipeline_);
 
     // Check if we faded out last time. If yes, fade in no matter what the
     // settings say. If we pause with fadeout, deactivate fadeout and resume
@@ -705,6 +883,15 @@ void GstEngine::timerEvent(QTimerEvent* e) {
 
 void GstEngine::HandlePipelineError(int pipeline_id, const QString& message,
                                     int domain, int error_code) {
+  // A prerolled pipeline that fails is just thrown away, and the track gets a
+  // new one when it's loaded.
+  for (int i = 0; i < prerolled_pipelines_.count(); ++i) {
+    if (prerolled_pipelines_[i].pipeline_->id() == pipeline_id) {
+      prerolled_pipelines_.removeAt(i);
+      return;
+    }
+  }
+
   if (!current_pipeline_.get() || current_pipeline_->id() != pipeline_id)
     return;
 
@@ -723,6 +910,7 @@ void GstEngine::HandlePipelineError(int pipeline_id, const QString& message,
   }
 
   current_pipeline_.reset();
+  SetBackgroundHost(nullptr);
 
   BufferingFinished();
   emit StateChanged(Engine::Error);
@@ -751,6 +939,7 @@ void GstEngine::EndOfStreamReached(int pipeline_id, bool has_next_track) {
 
   if (!has_next_track) {
     current_pipeline_.reset();
+    SetBackgroundHost(nullptr);
     BufferingFinished();
   }
   emit TrackEnded();
@@ -761,7 +950,29 @@ void GstEngine::NewMetaData(int pipeline_id,
   if (!current_pipeline_.get() || current_pipeline_->id() != pipeline_id)
     return;
 
-  emit MetaData(bundle);
+  // The newest tags win, and the timer isn't restarted so a station that
+  // never stops sending them still gets through.
+  pending_metadata_ = bundle;
+  pending_metadata_pipeline_id_ = pipeline_id;
+  if (!metadata_timer_->isActive()) metadata_timer_->start();
+}
+
+void GstEngine::EmitPendingMetaData() {
+  if (!current_pipeline_.get() ||
+      current_pipeline_->id() != pending_metadata_pipeline_id_) {
+    return;
+  }
+  if (pending_metadata_ == last_metadata_) return;
+
+  last_metadata_ = pending_metadata_;
+  emit MetaData(last_metadata_);
+}
+
+void GstEngine::ResetMetaData() {
+  metadata_timer_->stop();
+  pending_metadata_pipeline_id_ = -1;
+  pending_metadata_ = Engine::SimpleMetaBundle();
+  last_metadata_ = Engine::SimpleMetaBundle();
 }
 
 GstElement* GstEngine::CreateElement(const QString& factoryName,
@@ -811,7 +1022,7 @@ GstEngine::PluginDetailsList GstEngine::GetPluginList(
   return ret;
 }
 
-shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline() {
+shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline(bool stream_output) {
   EnsureInitialised();
 
   shared_ptr<GstEnginePipeline> ret(new GstEnginePipeline(this));
@@ -821,6 +1032,14 @@ shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline() {
   ret->set_buffer_min_fill(buffer_min_fill_);
   ret->set_mono_playback(mono_playback_);
   ret->set_sample_rate(sample_rate_);
+  ret->set_direct_output(direct_output_);
+  ret->set_sink_buffer_duration_nanosec(sink_buffer_duration_nanosec_);
+  ret->set_shared_crossfade(shared_crossfade_ && !direct_output_);
+  if (stream_output) {
+    QMutexLocker l(&stream_output_mutex_);
+    ret->set_stream_output(stream_output_ != nullptr, stream_format_,
+                           stream_bitrate_kbps_);
+  }
 
   ret->AddBufferConsumer(this);
   for (BufferConsumer* consumer : buffer_consumers_) {
@@ -837,21 +1056,28 @@ shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline() {
   connect(ret.get(), SIGNAL(BufferingProgress(int)),
           SLOT(BufferingProgress(int)));
   connect(ret.get(), SIGNAL(BufferingFinished()), SLOT(BufferingFinished()));
+  connect(ret.get(), SIGNAL(CrossfadeFinished()), SLOT(FadeoutFinished()));
 
   return ret;
 }
 
 shared_ptr<GstEnginePipeline> GstEngine::CreatePipeline(const QUrl& url,
-                                                        qint64 end_nanosec) {
-  shared_ptr<GstEnginePipeline> ret = CreatePipeline();
-
-  if (url.scheme() == "hypnotoad") {
-    ret->InitFromString(kHypnotoadPipeline);
-    return ret;
+                                                        qint64 end_nanosec,
+                                                        int trace_id,
+                                                        bool stream_output) {
+  shared_ptr<GstEnginePipeline> ret = CreatePipeline(stream_output);
+  ret->set_trace_id(trace_id);
+
+  if (buffer_duration_nanosec_ > 0 && StreamBuffering::IsStream(url)) {
+    const StreamBuffering::Params params =
+        stream_buffering_.ParamsForUrl(url, buffer_duration_nanosec_);
+    ret->set_buffer_duration_nanosec(params.duration_nanosec_);
+    // Playback can't start below the level it stops at.
+    ret->set_buffer_high_fill(qMax(params.high_fill_, buffer_min_fill_ + 1));
   }
 
-  if (url.scheme() == "enterprise") {
-    ret->InitFromString(kEnterprisePipeline);
+  if (const char* description = PipelineForUrl(url)) {
+    ret->InitFromString(description);
     return ret;
   }
 
@@ -865,12 +1091,101 @@ void GstEngine::AddBufferConsumer(BufferConsumer* consumer) {
   if (current_pipeline_) current_pipeline_->AddBufferConsumer(consumer);
 }
 
+void GstEngine::SetStreamOutput(BufferConsumer* consumer, StreamFormat format,
+                                int bitrate_kbps) {
+  QMutexLocker l(&stream_output_mutex_);
+  stream_output_ = consumer;
+  stream_format_ = format;
+  stream_bitrate_kbps_ = bitrate_kbps;
+}
+
+void GstEngine::ConsumeStreamBuffer(GstBuffer* buffer, int pipeline_id) {
+  QMutexLocker l(&stream_output_mutex_);
+  if (stream_output_) {
+    stream_output_->ConsumeBuffer(buffer, pipeline_id);
+  } else {
+    gst_buffer_unref(buffer);
+  }
+}
+
 void GstEngine::RemoveBufferConsumer(BufferConsumer* consumer) {
   buffer_consumers_.removeAll(consumer);
   if (current_pipeline_) current_pipeline_->RemoveBufferConsumer(consumer);
 }
 
-int GstEngine::AddBackgroundStream(shared_ptr<GstEnginePipeline> pipeline) {
+int GstEngine::dropped_buffers() const {
+  return current_pipeline_ ? current_pipeline_->dropped_buffers() : 0;
+}
+
+int GstEngine::late_buffers() const {
+  return current_pipeline_ ? current_pipeline_->late_buffers() : 0;
+}
+
+const char* GstEngine::PipelineForUrl(const QUrl& url) {
+  if (url.scheme() == "hypnotoad") return kHypnotoadPipeline;
+  if (url.scheme() == "enterprise") return kEnterprisePipeline;
+  return nullptr;
+}
+
+int GstEngine::AddBackgroundStream(const QUrl& url) {
+  const int stream_id = next_background_stream_id_++;
+  BackgroundStream& stream = background_streams_[stream_id];
+  stream.url_ = url;
+
+  PlaceBackgroundStream(stream_id, &stream);
+  if (stream.branch_id_ == -1 && !stream.pipeline_) {
+    background_streams_.remove(stream_id);
+    return -1;
+  }
+  return stream_id;
+}
+
+void GstEngine::SetBackgroundHost(shared_ptr<GstEnginePipeline> host) {
+  if (host && !host->has_mixer()) host.reset();
+  background_host_ = host;
+
+  for (auto it = background_streams_.begin(); it != background_streams_.end();
+       ++it) {
+    PlaceBackgroundStream(it.key(), &it.value());
+  }
+}
+
+void GstEngine::PlaceBackgroundStream(int id, BackgroundStream* stream) {
+  shared_ptr<GstEnginePipeline> host = background_host_.lock();
+  shared_ptr<GstEnginePipeline> old_host = stream->host_.lock();
+
+  // Already in the right place
+  if (host ? host == old_host : bool(stream->pipeline_)) return;
+
+  if (old_host) old_host->RemoveBackgroundBranch(stream->branch_id_);
+  stream->host_.reset();
+  stream->branch_id_ = -1;
+
+  if (host) {
+    stream->branch_id_ = host->AddBackgroundBranch(stream->url_,
+                                                   stream->volume_);
+    if (stream->branch_id_ != -1) {
+      stream->host_ = host;
+      stream->pipeline_.reset();
+      return;
+    }
+  }
+
+  if (!stream->pipeline_) {
+    stream->pipeline_ = CreateBackgroundPipeline(id, *stream);
+  }
+}
+
+shared_ptr<GstEnginePipeline> GstEngine::CreateBackgroundPipeline(
+    int id, const BackgroundStream& stream) {
+  // Background streams aren't sent to the stream output's listeners
+  shared_ptr<GstEnginePipeline> pipeline =
+      CreatePipeline(stream.url_, 0, -1, false);
+  if (!pipeline) return pipeline;
+
+  pipeline->SetVolume(stream.volume_);
+  pipeline->SetNextUrl(stream.url_, 0, 0);
+
   // We don't want to get metadata messages or end notifications.
   disconnect(pipeline.get(),
              SIGNAL(MetadataFound(int, Engine::SimpleMetaBundle)), this, 0);
@@ -878,38 +1193,38 @@ int GstEngine::AddBackgroundStream(shared_ptr<GstEnginePipeline> pipeline) {
   connect(pipeline.get(), SIGNAL(EndOfStreamReached(int, bool)),
           SLOT(BackgroundStreamFinished()));
 
-  const int stream_id = next_background_stream_id_++;
-  background_streams_[stream_id] = pipeline;
-
   QFuture<GstStateChangeReturn> future = pipeline->SetState(GST_STATE_PLAYING);
-  NewClosure(future, this,
-             SLOT(BackgroundStreamPlayDone(QFuture<GstStateChangeReturn>, int)),
-             future, stream_id);
-  return stream_id;
+  NewClosure(
+      future, this,
+      SLOT(BackgroundStreamPlayDone(QFuture<GstStateChangeReturn>, int, int)),
+      future, id, pipeline->id());
+  return pipeline;
 }
 
 void GstEngine::BackgroundStreamPlayDone(QFuture<GstStateChangeReturn> future,
-                                         int stream_id) {
+                                         int stream_id, int pipeline_id) {
   GstStateChangeReturn ret = future.result();
 
   if (ret == GST_STATE_CHANGE_FAILURE) {
     qLog(Warning) << "Could not set thread to PLAYING.";
-    background_streams_.remove(stream_id);
-  }
-}
 
-int GstEngine::AddBackgroundStream(const QUrl& url) {
-  shared_ptr<GstEnginePipeline> pipeline = CreatePipeline(url, 0);
-  if (!pipeline) {
-    return -1;
+    // The stream might have been mixed into the track since
+    if (background_streams_.contains(stream_id)) {
+      BackgroundStream& stream = background_streams_[stream_id];
+      if (stream.pipeline_ && stream.pipeline_->id() == pipeline_id) {
+        stream.pipeline_.reset();
+      }
+    }
   }
-  pipeline->SetVolume(30);
-  pipeline->SetNextUrl(url, 0, 0);
-  return AddBackgroundStream(pipeline);
 }
 
 void GstEngine::StopBackgroundStream(int id) {
-  background_streams_.remove(id);  // Removes last shared_ptr reference.
+  if (!background_streams_.contains(id)) return;
+
+  // Removes the last shared_ptr reference to its own pipeline, if it has one.
+  const BackgroundStream stream = background_streams_.take(id);
+  shared_ptr<GstEnginePipeline> host = stream.host_.lock();
+  if (host) host->RemoveBackgroundBranch(stream.branch_id_);
 }
 
 void GstEngine::BackgroundStreamFinished() {
@@ -918,12 +1233,24 @@ void GstEngine::BackgroundStreamFinished() {
 }
 
 void GstEngine::SetBackgroundStreamVolume(int id, int volume) {
-  shared_ptr<GstEnginePipeline> pipeline = background_streams_[id];
-  Q_ASSERT(pipeline);
-  pipeline->SetVolume(volume);
+  if (!background_streams_.contains(id)) return;
+  BackgroundStream& stream = background_streams_[id];
+  stream.volume_ = volume;
+
+  shared_ptr<GstEnginePipeline> host = stream.host_.lock();
+  if (host) host->SetBackgroundBranchVolume(stream.branch_id_, volume);
+  if (stream.pipeline_) stream.pipeline_->SetVolume(volume);
 }
 
 void GstEngine::BufferingStarted() {
+  // The current stream ran dry while it was playing, so it gets a bigger
+  // buffer next time, and the clean play starts again.
+  if (current_pipeline_ && sender() == current_pipeline_.get() &&
+      StreamBuffering::IsStream(current_pipeline_->url())) {
+    stream_buffering_.Underrun(current_pipeline_->url());
+    clean_play_timer_->start();
+  }
+
   if (buffering_task_id_ != -1) {
     task_manager_->SetTaskFinished(buffering_task_id_);
   }
@@ -943,6 +1270,15 @@ void GstEngine::BufferingFinished() {
   }
 }
 
+void GstEngine::StreamPlayedCleanly() {
+  if (!current_pipeline_) return;
+  stream_buffering_.PlayedCleanly(current_pipeline_->url());
+}
+
+bool GstEngine::SupportsDirectOutput(const QString& sink) {
+  return sink == "alsasink" || sink == "pulsesink";
+}
+
 GstEngine::OutputDetailsList GstEngine::GetOutputsList() const {
   const_cast<GstEngine*>(this)->EnsureInitialised();
 
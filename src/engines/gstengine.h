@@ -29,12 +29,17 @@
 #include <QFuture>
 #include <QHash>
 #include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QPair>
 #include <QString>
 #include <QStringList>
 #include <QTimerEvent>
 
 #include "bufferconsumer.h"
 #include "enginebase.h"
+#include "spectrumservice.h"
+#include "streambuffering.h"
 #include "core/timeconstants.h"
 
 class QTimer;
@@ -70,10 +75,19 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   };
   typedef QList<OutputDetails> OutputDetailsList;
 
+  enum StreamFormat { StreamFormat_Mp3 = 0, StreamFormat_Opus = 1 };
+
   static const int kAutoSampleRate = -1;
   static const char* kSettingsGroup;
   static const char* kAutoSink;
 
+  // Whether the sink talks to the sound server or hardware closely enough for
+  // direct output to be worthwhile.  Only ALSA and PulseAudio do.
+  static bool SupportsDirectOutput(const QString& sink);
+  // The gst-launch description that plays url, for the URLs that aren't
+  // played through a uridecodebin, or null.
+  static const char* PipelineForUrl(const QUrl& url);
+
   bool Init();
   void EnsureInitialised() { initialising_.waitForFinished(); }
   void InitialiseGstreamer();
@@ -86,6 +100,7 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   qint64 length_nanosec() const;
   Engine::State state() const;
   const Engine::Scope& scope(int chunk_length);
+  SpectrumService* spectrum_service() { return spectrum_service_.get(); }
 
   OutputDetailsList GetOutputsList() const;
 
@@ -97,6 +112,8 @@ class GstEngine : public Engine::Base, public BufferConsumer {
  public slots:
   void StartPreloading(const QUrl& url, bool force_stop_at_end,
                        qint64 beginning_nanosec, qint64 end_nanosec);
+  void SetPrecomputedGain(const QUrl& url, float track_gain_db,
+                          float album_gain_db);
   bool Load(const QUrl&, Engine::TrackChangeFlags change,
             bool force_stop_at_end, quint64 beginning_nanosec,
             qint64 end_nanosec);
@@ -120,6 +137,20 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   void AddBufferConsumer(BufferConsumer* consumer);
   void RemoveBufferConsumer(BufferConsumer* consumer);
 
+  // Buffers dropped by the current pipeline's buffer consumers, or 0 if
+  // nothing is playing.
+  int dropped_buffers() const;
+  int late_buffers() const;
+
+  // Pipelines created after this also encode their audio and give the
+  // encoded buffers to consumer.  A null consumer stops that again, and no
+  // more buffers are given to the old one once this returns.  Can be called
+  // from any thread.
+  void SetStreamOutput(BufferConsumer* consumer, StreamFormat format,
+                       int bitrate_kbps);
+  // Called by the pipelines in their streaming threads
+  void ConsumeStreamBuffer(GstBuffer* buffer, int pipeline_id);
+
 #ifdef Q_OS_DARWIN
   GTlsDatabase* tls_database() const { return tls_database_; }
 #endif
@@ -138,12 +169,14 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   void FadeoutPauseFinished();
   void SeekNow();
   void BackgroundStreamFinished();
-  void BackgroundStreamPlayDone(QFuture<GstStateChangeReturn>, int);
+  void BackgroundStreamPlayDone(QFuture<GstStateChangeReturn>, int, int);
   void PlayDone(QFuture<GstStateChangeReturn> future, const quint64, const int);
 
   void BufferingStarted();
   void BufferingProgress(int percent);
   void BufferingFinished();
+  void StreamPlayedCleanly();
+  void EmitPendingMetaData();
 
  private:
   struct PluginDetails {
@@ -156,18 +189,42 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   PluginDetailsList GetPluginList(const QString& classname) const;
 
   void StartFadeout();
+  void ResetMetaData();
   void StartFadeoutPause();
 
   void StartTimers();
   void StopTimers();
 
-  std::shared_ptr<GstEnginePipeline> CreatePipeline();
+  // stream_output adds the encoder set by SetStreamOutput, if there is one
+  std::shared_ptr<GstEnginePipeline> CreatePipeline(bool stream_output = true);
   std::shared_ptr<GstEnginePipeline> CreatePipeline(const QUrl& url,
-                                                    qint64 end_nanosec);
+                                                    qint64 end_nanosec,
+                                                    int trace_id = -1,
+                                                    bool stream_output = true);
 
   void UpdateScope(int chunk_length);
 
-  int AddBackgroundStream(std::shared_ptr<GstEnginePipeline> pipeline);
+  // Background streams are mixed into the host pipeline if it has a mixer,
+  // and each get a pipeline of their own otherwise.  The host is the current
+  // pipeline unless it's paused or stopped.
+  struct BackgroundStream;
+  void SetBackgroundHost(std::shared_ptr<GstEnginePipeline> host);
+  void PlaceBackgroundStream(int id, BackgroundStream* stream);
+  std::shared_ptr<GstEnginePipeline> CreateBackgroundPipeline(
+      int id, const BackgroundStream& stream);
+
+  // Builds a pipeline for an upcoming track and leaves it PAUSED, so it has
+  // opened its source and prerolled by the time Load asks for it.
+  void PrerollPipeline(const QUrl& url, qint64 end_nanosec);
+  // The gain rgvolume should use for url if it has no tags, in the current
+  // ReplayGain mode.
+  float FallbackGain(const QUrl& url) const;
+
+  std::shared_ptr<GstEnginePipeline> TakePrerolledPipeline(const QUrl& url,
+                                                           qint64 end_nanosec);
+  // Local files are gapless within one pipeline anyway, so only slower
+  // sources get a pipeline of their own.
+  static bool ShouldPreroll(const QUrl& url);
 
   static QUrl FixupUrl(const QUrl& url);
 
@@ -176,6 +233,11 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   static const qint64 kPreloadGapNanosec = 2000 * kNsecPerMsec;     // 2s
   static const qint64 kSeekDelayNanosec = 100 * kNsecPerMsec;       // 100msec
 
+  static const int kDefaultPrerollPipelines;
+  static const int kDefaultPrerollMemoryMb;
+  static const int kMaxPrecomputedGains;
+  static const int kMetaDataCoalesceMsec;
+
   static const char* kHypnotoadPipeline;
   static const char* kEnterprisePipeline;
 
@@ -187,11 +249,25 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   QString sink_;
   QVariant device_;
 
+  // Before the pipelines, so their buffer consumer threads have stopped
+  // using it by the time it's deleted.
+  std::unique_ptr<SpectrumService> spectrum_service_;
+
   std::shared_ptr<GstEnginePipeline> current_pipeline_;
   std::shared_ptr<GstEnginePipeline> fadeout_pipeline_;
   std::shared_ptr<GstEnginePipeline> fadeout_pause_pipeline_;
   QUrl preloaded_url_;
 
+  struct PrerolledPipeline {
+    std::shared_ptr<GstEnginePipeline> pipeline_;
+    qint64 end_nanosec_;
+  };
+
+  // Oldest first, at most preroll_pipelines_ of them.
+  QList<PrerolledPipeline> prerolled_pipelines_;
+  int preroll_pipelines_;
+  quint64 preroll_memory_bytes_;
+
   QList<BufferConsumer*> buffer_consumers_;
 
   GstBuffer* latest_buffer_;
@@ -205,6 +281,8 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   int rg_mode_;
   float rg_preamp_;
   bool rg_compression_;
+  // Track and album gains for the last few URLs we were told about.
+  QMap<QUrl, QPair<float, float>> precomputed_gains_;
 
   qint64 buffer_duration_nanosec_;
 
@@ -213,6 +291,16 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   bool mono_playback_;
   int sample_rate_;
 
+  bool direct_output_;
+  qint64 sink_buffer_duration_nanosec_;
+
+  bool shared_crossfade_;
+
+  QMutex stream_output_mutex_;
+  BufferConsumer* stream_output_;
+  StreamFormat stream_format_;
+  int stream_bitrate_kbps_;
+
   mutable bool can_decode_success_;
   mutable bool can_decode_last_;
 
@@ -221,10 +309,34 @@ class GstEngine : public Engine::Base, public BufferConsumer {
   bool waiting_to_seek_;
   quint64 seek_pos_;
 
+  // Internet radio gets buffer settings that suit each station.  A station
+  // that plays for a while without running dry counts as a clean play.
+  StreamBuffering stream_buffering_;
+  QTimer* clean_play_timer_;
+
+  // Streams often send the same tags again every few seconds, or a few
+  // partial updates in a row, so tags are held for a moment and only passed
+  // on if they're different from the last ones.
+  QTimer* metadata_timer_;
+  int pending_metadata_pipeline_id_;
+  Engine::SimpleMetaBundle pending_metadata_;
+  Engine::SimpleMetaBundle last_metadata_;
+
   int timer_id_;
   int next_element_id_;
 
-  QHash<int, std::shared_ptr<GstEnginePipeline>> background_streams_;
+  struct BackgroundStream {
+    BackgroundStream() : volume_(30), branch_id_(-1) {}
+
+    QUrl url_;
+    int volume_;
+    // Either a branch in host_'s mixer, or pipeline_
+    std::weak_ptr<GstEnginePipeline> host_;
+    int branch_id_;
+    std::shared_ptr<GstEnginePipeline> pipeline_;
+  };
+  std::weak_ptr<GstEnginePipeline> background_host_;
+  QHash<int, BackgroundStream> background_streams_;
 
   bool is_fading_out_to_pause_;
   bool has_faded_out_;
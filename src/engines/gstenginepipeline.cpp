@@ -19,10 +19,13 @@
 
 #include <QCoreApplication>
 #include <QDir>
+#include <QFile>
 #include <QPair>
 #include <QRegExp>
+#include <QThread>
 
 #include "bufferconsumer.h"
+#include "bufferconsumerqueue.h"
 #include "config.h"
 #include "gstelementdeleter.h"
 #include "gstengine.h"
@@ -30,7 +33,9 @@
 #include "core/concurrentrun.h"
 #include "core/logging.h"
 #include "core/mac_startup.h"
+#include "core/playbacktrace.h"
 #include "core/signalchecker.h"
+#include "core/tracing.h"
 #include "core/utilities.h"
 #include "internet/core/internetmodel.h"
 #include "internet/spotify/spotifyserver.h"
@@ -42,6 +47,7 @@ const int GstEnginePipeline::kFaderFudgeMsec = 2000;
 const int GstEnginePipeline::kEqBandCount = 10;
 const int GstEnginePipeline::kEqBandFrequencies[] = {
     60, 170, 310, 600, 1000, 3000, 6000, 12000, 14000, 16000};
+const int GstEnginePipeline::kMixerSampleRate = 44100;
 
 int GstEnginePipeline::sId = 1;
 GstElementDeleter* GstEnginePipeline::sElementDeleter = nullptr;
@@ -52,6 +58,8 @@ GstEnginePipeline::GstEnginePipeline(GstEngine* engine)
       id_(sId++),
       valid_(false),
       sink_(GstEngine::kAutoSink),
+      buffer_consumers_(new BufferConsumerQueueList),
+      buffer_consumers_readers_(0),
       segment_start_(0),
       segment_start_received_(false),
       emit_track_ended_on_stream_start_(false),
@@ -64,11 +72,23 @@ GstEnginePipeline::GstEnginePipeline(GstEngine* engine)
       rg_mode_(0),
       rg_preamp_(0.0),
       rg_compression_(true),
+      rg_fallback_gain_(0.0),
+      next_rg_fallback_gain_(0.0),
       buffer_duration_nanosec_(1 * kNsecPerSec),
       buffer_min_fill_(33),
+      buffer_high_fill_(99),
+      buffer_max_bytes_(0),
       buffering_(false),
+      trace_id_(-1),
+      first_buffer_traced_(0),
       mono_playback_(false),
       sample_rate_(GstEngine::kAutoSampleRate),
+      direct_output_(false),
+      sink_buffer_duration_nanosec_(0),
+      shared_crossfade_(false),
+      stream_output_(false),
+      stream_format_(GstEngine::StreamFormat_Mp3),
+      stream_bitrate_kbps_(0),
       end_offset_nanosec_(-1),
       next_beginning_offset_nanosec_(-1),
       next_end_offset_nanosec_(-1),
@@ -83,20 +103,35 @@ GstEnginePipeline::GstEnginePipeline(GstEngine* engine)
       pipeline_(nullptr),
       uridecodebin_(nullptr),
       audiobin_(nullptr),
+      spotify_src_(nullptr),
       queue_(nullptr),
       audioconvert_(nullptr),
       rgvolume_(nullptr),
       rglimiter_(nullptr),
       audioconvert2_(nullptr),
+      audio_queue_(nullptr),
+      equalizer_preamp_(nullptr),
       equalizer_(nullptr),
+      fast_equalizer_(false),
       stereo_panorama_(nullptr),
       volume_(nullptr),
       audioscale_(nullptr),
-      audiosink_(nullptr) {
+      audiosink_(nullptr),
+      dsp_mutex_(QMutex::Recursive),
+      dsp_relink_pending_(0),
+      mixer_(nullptr),
+      next_branch_id_(1),
+      crossfade_duration_msec_(0),
+      current_fade_(nullptr),
+      current_branch_offset_(0),
+      track_start_nanosec_(0),
+      pending_track_start_nanosec_(-1) {
   if (!sElementDeleter) {
     sElementDeleter = new GstElementDeleter;
   }
 
+  gst_segment_init(&mixer_segment_, GST_FORMAT_TIME);
+
   for (int i = 0; i < kEqBandCount; ++i) eq_band_gains_ << 0;
 }
 
@@ -123,12 +158,47 @@ void GstEnginePipeline::set_buffer_min_fill(int percent) {
   buffer_min_fill_ = percent;
 }
 
+void GstEnginePipeline::set_buffer_high_fill(int percent) {
+  buffer_high_fill_ = percent;
+}
+
+void GstEnginePipeline::set_buffer_max_bytes(quint64 bytes) {
+  buffer_max_bytes_ = bytes;
+  if (queue_) {
+    g_object_set(G_OBJECT(queue_), "max-size-bytes", guint(bytes), nullptr);
+  }
+}
+
 void GstEnginePipeline::set_mono_playback(bool enabled) {
   mono_playback_ = enabled;
 }
 
 void GstEnginePipeline::set_sample_rate(int rate) { sample_rate_ = rate; }
 
+void GstEnginePipeline::set_direct_output(bool enabled) {
+  direct_output_ = enabled;
+}
+
+void GstEnginePipeline::set_sink_buffer_duration_nanosec(
+    qint64 duration_nanosec) {
+  sink_buffer_duration_nanosec_ = duration_nanosec;
+}
+
+void GstEnginePipeline::set_shared_crossfade(bool enabled) {
+  shared_crossfade_ = enabled;
+}
+
+void GstEnginePipeline::set_stream_output(bool enabled, int format,
+                                          int bitrate_kbps) {
+  stream_output_ = enabled;
+  stream_format_ = format;
+  stream_bitrate_kbps_ = bitrate_kbps;
+}
+
+void GstEnginePipeline::set_trace_id(int trace_id) {
+  trace_id_.fetchAndStoreOrdered(trace_id);
+}
+
 bool GstEnginePipeline::ReplaceDecodeBin(GstElement* new_bin) {
   if (!new_bin) return false;
 
@@ -149,21 +219,54 @@ bool GstEnginePipeline::ReplaceDecodeBin(GstElement* new_bin) {
 }
 
 bool GstEnginePipeline::ReplaceDecodeBin(const QUrl& url) {
+  PlaybackTrace::ScopedSpan span(trace_id_.fetchAndAddOrdered(0),
+                                 PlaybackTrace::Span_DecodeBin);
   GstElement* new_bin = nullptr;
 
+  if (spotify_src_) {
+    gst_object_unref(spotify_src_);
+    spotify_src_ = nullptr;
+    spotify_socket_path_.clear();
+  }
+
   if (url.scheme() == "spotify") {
     new_bin = gst_bin_new("spotify_bin");
 
+    // Get the audio through shared memory if we can, instead of copying it
+    // through a TCP socket.
+    GstElementFactory* shm_factory = gst_element_factory_find("shmsrc");
+    const bool use_shm = shm_factory;
+    if (shm_factory) gst_object_unref(shm_factory);
+
     // Create elements
-    GstElement* src = engine_->CreateElement("tcpserversrc", new_bin);
+    GstElement* src =
+        engine_->CreateElement(use_shm ? "shmsrc" : "tcpserversrc", new_bin);
     if (!src) return false;
     GstElement* gdp = engine_->CreateElement("gdpdepay", new_bin);
     if (!gdp) return false;
 
-    // Pick a port number
-    const int port = Utilities::PickUnusedPort();
-    g_object_set(G_OBJECT(src), "host", "127.0.0.1", nullptr);
-    g_object_set(G_OBJECT(src), "port", port, nullptr);
+    int port = 0;
+    if (use_shm) {
+      static int next_socket = 0;
+      spotify_socket_path_ =
+          QString("%1/clementine-spotify-%2-%3")
+              .arg(QDir::tempPath())
+              .arg(QCoreApplication::applicationPid())
+              .arg(next_socket++);
+      g_object_set(G_OBJECT(src), "socket-path",
+                   QFile::encodeName(spotify_socket_path_).constData(),
+                   nullptr);
+
+      // The shmsrc fails if nothing is listening on the socket, so keep it
+      // stopped until the blob has created its shmsink.
+      gst_element_set_locked_state(src, TRUE);
+      spotify_src_ = GST_ELEMENT(gst_object_ref(src));
+    } else {
+      // Pick a port number
+      port = Utilities::PickUnusedPort();
+      g_object_set(G_OBJECT(src), "host", "127.0.0.1", nullptr);
+      g_object_set(G_OBJECT(src), "port", port, nullptr);
+    }
 
     // Link the elements
     gst_element_link(src, gdp);
@@ -176,10 +279,13 @@ bool GstEnginePipeline::ReplaceDecodeBin(const QUrl& url) {
     // Tell spotify to start sending data to us.
     SpotifyServer* spotify_server =
         InternetModel::Service<SpotifyService>()->server();
+    connect(spotify_server, SIGNAL(MediaSocketReady(QString)),
+            SLOT(SpotifyMediaSocketReady(QString)), Qt::UniqueConnection);
     // Need to schedule this in the spotify server's thread
     QMetaObject::invokeMethod(
         spotify_server, "StartPlayback", Qt::QueuedConnection,
-        Q_ARG(QString, url.toString()), Q_ARG(quint16, port));
+        Q_ARG(QString, url.toString()), Q_ARG(quint16, port),
+        Q_ARG(QString, spotify_socket_path_));
   } else {
     new_bin = engine_->CreateElement("uridecodebin");
     if (!new_bin) return false;
@@ -195,6 +301,17 @@ bool GstEnginePipeline::ReplaceDecodeBin(const QUrl& url) {
   return ReplaceDecodeBin(new_bin);
 }
 
+void GstEnginePipeline::SpotifyMediaSocketReady(const QString& socket_path) {
+  if (!spotify_src_ || socket_path != spotify_socket_path_) return;
+
+  qLog(Debug) << "Connecting to Spotify's shared memory at" << socket_path;
+  gst_element_set_locked_state(spotify_src_, FALSE);
+  gst_element_sync_state_with_parent(spotify_src_);
+
+  gst_object_unref(spotify_src_);
+  spotify_src_ = nullptr;
+}
+
 GstElement* GstEnginePipeline::CreateDecodeBinFromString(const char* pipeline) {
   GError* error = nullptr;
   GstElement* bin = gst_parse_bin_from_description(pipeline, TRUE, &error);
@@ -215,6 +332,10 @@ GstElement* GstEnginePipeline::CreateDecodeBinFromString(const char* pipeline) {
 }
 
 bool GstEnginePipeline::Init() {
+  qTraceScope("GstEnginePipeline::Init");
+  PlaybackTrace::ScopedSpan span(trace_id_.fetchAndAddOrdered(0),
+                                 PlaybackTrace::Span_PipelineInit);
+
   // Here we create all the parts of the gstreamer pipeline - from the source
   // to the sink.  The parts of the pipeline are split up into bins:
   //   uri decode bin -> audio bin
@@ -230,8 +351,15 @@ bool GstEnginePipeline::Init() {
   // samples for the scope, the other is kept as float32 and sent to the
   // speaker.
   //   tee1 ! probe_queue ! probe_converter ! <caps16> ! probe_sink
-  //   tee2 ! audio_queue ! equalizer_preamp ! equalizer ! volume ! audioscale
-  //        ! convert ! audiosink
+  //   ( tee3 ! stream_queue ! <encoder> ! stream_sink )
+  //   tee2 ! audio_queue ! ( equalizer_preamp ! equalizer )
+  //        ! ( stereo_panorama ) ! volume ! audioscale ! convert ! audiosink
+  // The equalizer and stereo panorama are only there while they're enabled,
+  // see RelinkDspChain().
+  // With direct output the speaker split is only
+  //   tee2 ! audio_queue ! volume ! convert ! audiosink
+  // The volume element passes buffers through untouched at 100%, and convert
+  // only changes the format if the sink can't take the decoder's.
 
   gst_segment_init(&last_decodebin_segment_, GST_FORMAT_TIME);
 
@@ -264,11 +392,30 @@ bool GstEnginePipeline::Init() {
     }
   }
 
+  if (sink_buffer_duration_nanosec_ > 0 &&
+      g_object_class_find_property(G_OBJECT_GET_CLASS(audiosink_),
+                                   "buffer-time")) {
+    // The sink writes to the device in latency-time sized chunks, so that has
+    // to shrink with the buffer.
+    const gint64 buffer_usec = sink_buffer_duration_nanosec_ / kNsecPerUsec;
+    gint64 latency_usec = 0;
+    g_object_get(G_OBJECT(audiosink_), "latency-time", &latency_usec, nullptr);
+    g_object_set(G_OBJECT(audiosink_), "buffer-time", buffer_usec,
+                 "latency-time", qMin(latency_usec, buffer_usec / 2), nullptr);
+  }
+
+  // With shared crossfades the buffer queue and the replaygain elements are
+  // in each track's own branch instead, see CreateMixerBranch().
+  if (shared_crossfade_) {
+    mixer_ = engine_->CreateElement("audiomixer");
+    if (!mixer_) return false;
+    gst_bin_add(GST_BIN(pipeline_), mixer_);
+  }
+
   // Create all the other elements
-  GstElement* tee, *probe_queue, *probe_converter, *probe_sink, *audio_queue,
-      *convert;
+  GstElement* tee, *probe_queue, *probe_converter, *probe_sink, *convert;
 
-  queue_ = engine_->CreateElement("queue2", audiobin_);
+  if (!mixer_) queue_ = engine_->CreateElement("queue2", audiobin_);
   audioconvert_ = engine_->CreateElement("audioconvert", audiobin_);
   tee = engine_->CreateElement("tee", audiobin_);
 
@@ -276,17 +423,17 @@ bool GstEnginePipeline::Init() {
   probe_converter = engine_->CreateElement("audioconvert", audiobin_);
   probe_sink = engine_->CreateElement("fakesink", audiobin_);
 
-  audio_queue = engine_->CreateElement("queue", audiobin_);
-  equalizer_preamp_ = engine_->CreateElement("volume", audiobin_);
-  equalizer_ = engine_->CreateElement("equalizer-nbands", audiobin_);
-  stereo_panorama_ = engine_->CreateElement("audiopanorama", audiobin_);
+  audio_queue_ = engine_->CreateElement("queue", audiobin_);
+  if (!direct_output_) {
+    audioscale_ = engine_->CreateElement("audioresample", audiobin_);
+    if (!audioscale_) return false;
+  }
   volume_ = engine_->CreateElement("volume", audiobin_);
-  audioscale_ = engine_->CreateElement("audioresample", audiobin_);
   convert = engine_->CreateElement("audioconvert", audiobin_);
 
-  if (!queue_ || !audioconvert_ || !tee || !probe_queue || !probe_converter ||
-      !probe_sink || !audio_queue || !equalizer_preamp_ || !equalizer_ ||
-      !stereo_panorama_ || !volume_ || !audioscale_ || !convert) {
+  if ((!mixer_ && !queue_) || !audioconvert_ || !tee || !probe_queue ||
+      !probe_converter || !probe_sink || !audio_queue_ || !volume_ ||
+      !convert) {
     return false;
   }
 
@@ -297,7 +444,7 @@ bool GstEnginePipeline::Init() {
   GstElement* event_probe = audioconvert_;
   GstElement* convert_sink = tee;
 
-  if (rg_enabled_) {
+  if (rg_enabled_ && !mixer_) {
     rgvolume_ = engine_->CreateElement("rgvolume", audiobin_);
     rglimiter_ = engine_->CreateElement("rglimiter", audiobin_);
     audioconvert2_ = engine_->CreateElement("audioconvert", audiobin_);
@@ -308,16 +455,13 @@ bool GstEnginePipeline::Init() {
       return false;
     }
 
-    // Set replaygain settings
-    g_object_set(G_OBJECT(rgvolume_), "album-mode", rg_mode_, nullptr);
-    g_object_set(G_OBJECT(rgvolume_), "pre-amp", double(rg_preamp_), nullptr);
-    g_object_set(G_OBJECT(rglimiter_), "enabled", int(rg_compression_),
-                 nullptr);
+    SetUpReplayGain();
   }
 
   // Create a pad on the outside of the audiobin and connect it to the pad of
   // the first element.
-  GstPad* pad = gst_element_get_static_pad(queue_, "sink");
+  GstPad* pad =
+      gst_element_get_static_pad(mixer_ ? audioconvert_ : queue_, "sink");
   gst_element_add_pad(audiobin_, gst_ghost_pad_new("sink", pad));
   gst_object_unref(pad);
 
@@ -332,72 +476,20 @@ bool GstEnginePipeline::Init() {
   // Configure the fakesink properly
   g_object_set(G_OBJECT(probe_sink), "sync", TRUE, nullptr);
 
-  // Setting the equalizer bands:
-  //
-  // GStreamer's GstIirEqualizerNBands sets up shelve filters for the first and
-  // last bands as corner cases. That was causing the "inverted slider" bug.
-  // As a workaround, we create two dummy bands at both ends of the spectrum.
-  // This causes the actual first and last adjustable bands to be
-  // implemented using band-pass filters.
-
-  g_object_set(G_OBJECT(equalizer_), "num-bands", 10 + 2, nullptr);
-
-  // Dummy first band (bandwidth 0, cutting below 20Hz):
-  GstObject* first_band = GST_OBJECT(
-      gst_child_proxy_get_child_by_index(GST_CHILD_PROXY(equalizer_), 0));
-  g_object_set(G_OBJECT(first_band), "freq", 20.0, "bandwidth", 0, "gain", 0.0f,
-               nullptr);
-  g_object_unref(G_OBJECT(first_band));
-
-  // Dummy last band (bandwidth 0, cutting over 20KHz):
-  GstObject* last_band = GST_OBJECT(gst_child_proxy_get_child_by_index(
-      GST_CHILD_PROXY(equalizer_), kEqBandCount + 1));
-  g_object_set(G_OBJECT(last_band), "freq", 20000.0, "bandwidth", 0, "gain",
-               0.0f, nullptr);
-  g_object_unref(G_OBJECT(last_band));
-
-  int last_band_frequency = 0;
-  for (int i = 0; i < kEqBandCount; ++i) {
-    const int index_in_eq = i + 1;
-    GstObject* band = GST_OBJECT(gst_child_proxy_get_child_by_index(
-        GST_CHILD_PROXY(equalizer_), index_in_eq));
-
-    const float frequency = kEqBandFrequencies[i];
-    const float bandwidth = frequency - last_band_frequency;
-    last_band_frequency = frequency;
-
-    g_object_set(G_OBJECT(band), "freq", frequency, "bandwidth", bandwidth,
-                 "gain", 0.0f, nullptr);
-    g_object_unref(G_OBJECT(band));
-  }
-
-  // Set the stereo balance.
-  g_object_set(G_OBJECT(stereo_panorama_), "panorama", stereo_balance_,
-               nullptr);
-
-  // Set the buffer duration.  We set this on this queue instead of the
-  // decode bin (in ReplaceDecodeBin()) because setting it on the decode bin
-  // only affects network sources.
-  // Disable the default buffer and byte limits, so we only buffer based on
-  // time.
-  g_object_set(G_OBJECT(queue_), "max-size-buffers", 0, nullptr);
-  g_object_set(G_OBJECT(queue_), "max-size-bytes", 0, nullptr);
-  g_object_set(G_OBJECT(queue_), "max-size-time", buffer_duration_nanosec_,
-               nullptr);
-  g_object_set(G_OBJECT(queue_), "low-percent", buffer_min_fill_, nullptr);
-
-  if (buffer_duration_nanosec_ > 0) {
-    g_object_set(G_OBJECT(queue_), "use-buffering", true, nullptr);
+  if (mixer_) {
+    gst_element_link(audioconvert_, convert_sink);
+  } else {
+    SetUpBufferQueue(queue_);
+    gst_element_link_many(queue_, audioconvert_, convert_sink, nullptr);
   }
-
-  gst_element_link_many(queue_, audioconvert_, convert_sink, nullptr);
   gst_element_link(probe_converter, probe_sink);
 
   // Link the outputs of tee to the queues on each path.
   gst_pad_link(gst_element_get_request_pad(tee, "src_%u"),
                gst_element_get_static_pad(probe_queue, "sink"));
   gst_pad_link(gst_element_get_request_pad(tee, "src_%u"),
-               gst_element_get_static_pad(audio_queue, "sink"));
+               gst_element_get_static_pad(audio_queue_, "sink"));
+  if (stream_output_ && !AddStreamBranch(tee)) return false;
 
   // Link replaygain elements if enabled.
   if (rg_enabled_) {
@@ -410,16 +502,23 @@ bool GstEnginePipeline::Init() {
   gst_element_link_filtered(probe_queue, probe_converter, caps16);
   gst_caps_unref(caps16);
 
-  gst_element_link_many(audio_queue, equalizer_preamp_, equalizer_,
-                        stereo_panorama_, volume_, audioscale_, convert,
-                        nullptr);
+  // Nothing is flowing yet, so the DSP elements can be put in straight away.
+  gst_element_link(audio_queue_, volume_);
+  RelinkDspChain();
+  if (direct_output_) {
+    gst_element_link(volume_, convert);
+  } else {
+    gst_element_link_many(volume_, audioscale_, convert, nullptr);
+  }
 
   // We only limit the media type to raw audio.
   // Let the audio output of the tee autonegotiate the bit depth and format.
   GstCaps* caps = gst_caps_new_empty_simple("audio/x-raw");
 
-  // Add caps for fixed sample rate and mono, but only if requested
-  if (sample_rate_ != GstEngine::kAutoSampleRate && sample_rate_ > 0) {
+  // Add caps for fixed sample rate and mono, but only if requested.  There's
+  // nothing to change the rate with direct output.
+  if (!direct_output_ && sample_rate_ != GstEngine::kAutoSampleRate &&
+      sample_rate_ > 0) {
     gst_caps_set_simple(caps, "rate", G_TYPE_INT, sample_rate_, nullptr);
   }
 
@@ -438,19 +537,187 @@ bool GstEnginePipeline::Init() {
   bus_cb_id_ = gst_bus_add_watch(gst_pipeline_get_bus(GST_PIPELINE(pipeline_)),
                                  BusCallback, this);
 
+  if (mixer_) {
+    gst_element_link(mixer_, audiobin_);
+
+    pad = gst_element_get_static_pad(mixer_, "src");
+    gst_pad_add_probe(
+        pad, static_cast<GstPadProbeType>(GST_PAD_PROBE_TYPE_BUFFER |
+                                          GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM),
+        MixerProbe, this, nullptr);
+    gst_object_unref(pad);
+
+    // Nothing is playing yet, so the first branch can go straight in
+    MixerBranch branch;
+    if (!CreateMixerBranch(1.0, &branch)) return false;
+    SetCurrentBranch(branch);
+    LinkMixerBranch();
+  }
+
   MaybeLinkDecodeToAudio();
 
   return true;
 }
 
+void GstEnginePipeline::SetUpBufferQueue(GstElement* queue) {
+  // Set the buffer duration.  We set this on this queue instead of the
+  // decode bin (in ReplaceDecodeBin()) because setting it on the decode bin
+  // only affects network sources.
+  // Disable the default buffer limit, so we only buffer based on time and
+  // whatever byte limit we were given.
+  g_object_set(G_OBJECT(queue), "max-size-buffers", 0, nullptr);
+  g_object_set(G_OBJECT(queue), "max-size-bytes", guint(buffer_max_bytes_),
+               nullptr);
+  g_object_set(G_OBJECT(queue), "max-size-time", buffer_duration_nanosec_,
+               nullptr);
+  g_object_set(G_OBJECT(queue), "low-percent", buffer_min_fill_, nullptr);
+  g_object_set(G_OBJECT(queue), "high-percent", buffer_high_fill_, nullptr);
+
+  if (buffer_duration_nanosec_ > 0) {
+    g_object_set(G_OBJECT(queue), "use-buffering", true, nullptr);
+  }
+}
+
+void GstEnginePipeline::SetUpReplayGain() {
+  g_object_set(G_OBJECT(rgvolume_), "album-mode", rg_mode_, nullptr);
+  g_object_set(G_OBJECT(rgvolume_), "pre-amp", double(rg_preamp_), nullptr);
+  g_object_set(G_OBJECT(rgvolume_), "fallback-gain", double(rg_fallback_gain_),
+               nullptr);
+  g_object_set(G_OBJECT(rglimiter_), "enabled", int(rg_compression_), nullptr);
+}
+
+bool GstEnginePipeline::AddStreamBranch(GstElement* tee) {
+  // The stream's listeners mustn't be able to hold up local playback, so old
+  // audio is thrown away if the encoder falls behind.
+  GstElement* queue = engine_->CreateElement("queue", audiobin_);
+  GstElement* convert = engine_->CreateElement("audioconvert", audiobin_);
+  GstElement* resample = engine_->CreateElement("audioresample", audiobin_);
+  GstElement* encoder = nullptr;
+  GstElement* mux = nullptr;
+  if (stream_format_ == GstEngine::StreamFormat_Opus) {
+    encoder = engine_->CreateElement("opusenc", audiobin_);
+    mux = engine_->CreateElement("oggmux", audiobin_);
+  } else {
+    encoder = engine_->CreateElement("lamemp3enc", audiobin_);
+  }
+  GstElement* sink = engine_->CreateElement("fakesink", audiobin_);
+
+  if (!queue || !convert || !resample || !encoder || !sink ||
+      (stream_format_ == GstEngine::StreamFormat_Opus && !mux)) {
+    return false;
+  }
+
+  g_object_set(G_OBJECT(queue), "leaky", 2, "max-size-buffers", 0,
+               "max-size-bytes", 0, "max-size-time", kNsecPerSec, nullptr);
+  if (stream_format_ == GstEngine::StreamFormat_Opus) {
+    g_object_set(G_OBJECT(encoder), "bitrate", stream_bitrate_kbps_ * 1000,
+                 nullptr);
+  } else {
+    // target=bitrate and cbr, so listeners can size their own buffers
+    g_object_set(G_OBJECT(encoder), "target", 1, "bitrate",
+                 stream_bitrate_kbps_, "cbr", true, nullptr);
+  }
+
+  // handoff is only emitted while playing, not for the preroll buffer, so a
+  // prerolled pipeline doesn't send anything before it's the current one.
+  // async=false stops the encoder holding up the pipeline's preroll.
+  g_object_set(G_OBJECT(sink), "sync", false, "async", false,
+               "signal-handoffs", true, nullptr);
+  g_signal_connect(G_OBJECT(sink), "handoff",
+                   G_CALLBACK(StreamHandoffCallback), this);
+
+  gst_element_link_many(queue, convert, resample, encoder, nullptr);
+  if (mux) {
+    gst_element_link_many(encoder, mux, sink, nullptr);
+  } else {
+    gst_element_link(encoder, sink);
+  }
+
+  GstPad* tee_pad = gst_element_get_request_pad(tee, "src_%u");
+  GstPad* queue_pad = gst_element_get_static_pad(queue, "sink");
+  gst_pad_link(tee_pad, queue_pad);
+  gst_object_unref(queue_pad);
+  gst_object_unref(tee_pad);
+
+  return true;
+}
+
+void GstEnginePipeline::StreamHandoffCallback(GstElement*, GstBuffer* buf,
+                                              GstPad*, gpointer self) {
+  GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
+
+  // The stream's listeners share the encoded buffer instead of copying it
+  gst_buffer_ref(buf);
+  instance->engine_->ConsumeStreamBuffer(buf, instance->id());
+}
+
+void GstEnginePipeline::SetUpEqualizer() {
+  if (fast_equalizer_) {
+    // Same bands as below, but fastequalizer only has peaking filters so it
+    // doesn't need the dummy ones.
+    int last_band_frequency = 0;
+    for (int i = 0; i < kEqBandCount; ++i) {
+      const float frequency = kEqBandFrequencies[i];
+      const float bandwidth = frequency - last_band_frequency;
+      last_band_frequency = frequency;
+
+      g_object_set(G_OBJECT(equalizer_),
+                   QString("freq%1").arg(i).toAscii().constData(),
+                   gdouble(frequency),
+                   QString("bandwidth%1").arg(i).toAscii().constData(),
+                   gdouble(bandwidth), nullptr);
+    }
+    return;
+  }
+
+  // Setting the equalizer bands:
+  //
+  // GStreamer's GstIirEqualizerNBands sets up shelve filters for the first and
+  // last bands as corner cases. That was causing the "inverted slider" bug.
+  // As a workaround, we create two dummy bands at both ends of the spectrum.
+  // This causes the actual first and last adjustable bands to be
+  // implemented using band-pass filters.
+
+  g_object_set(G_OBJECT(equalizer_), "num-bands", 10 + 2, nullptr);
+
+  // Dummy first band (bandwidth 0, cutting below 20Hz):
+  GstObject* first_band = GST_OBJECT(
+      gst_child_proxy_get_child_by_index(GST_CHILD_PROXY(equalizer_), 0));
+  g_object_set(G_OBJECT(first_band), "freq", 20.0, "bandwidth", 0, "gain", 0.0f,
+               nullptr);
+  g_object_unref(G_OBJECT(first_band));
+
+  // Dummy last band (bandwidth 0, cutting over 20KHz):
+  GstObject* last_band = GST_OBJECT(gst_child_proxy_get_child_by_index(
+      GST_CHILD_PROXY(equalizer_), kEqBandCount + 1));
+  g_object_set(G_OBJECT(last_band), "freq", 20000.0, "bandwidth", 0, "gain",
+               0.0f, nullptr);
+  g_object_unref(G_OBJECT(last_band));
+
+  int last_band_frequency = 0;
+  for (int i = 0; i < kEqBandCount; ++i) {
+    const int index_in_eq = i + 1;
+    GstObject* band = GST_OBJECT(gst_child_proxy_get_child_by_index(
+        GST_CHILD_PROXY(equalizer_), index_in_eq));
+
+    const float frequency = kEqBandFrequencies[i];
+    const float bandwidth = frequency - last_band_frequency;
+    last_band_frequency = frequency;
+
+    g_object_set(G_OBJECT(band), "freq", frequency, "bandwidth", bandwidth,
+                 "gain", 0.0f, nullptr);
+    g_object_unref(G_OBJECT(band));
+  }
+}
+
 void GstEnginePipeline::MaybeLinkDecodeToAudio() {
-  if (!uridecodebin_ || !audiobin_) return;
+  if (!uridecodebin_ || !decode_target()) return;
 
   GstPad* pad = gst_element_get_static_pad(uridecodebin_, "src");
   if (!pad) return;
 
   gst_object_unref(pad);
-  gst_element_link(uridecodebin_, audiobin_);
+  gst_element_link(uridecodebin_, decode_target());
 }
 
 bool GstEnginePipeline::InitFromString(const QString& pipeline) {
@@ -465,7 +732,7 @@ bool GstEnginePipeline::InitFromString(const QString& pipeline) {
   if (!ReplaceDecodeBin(new_bin)) return false;
 
   if (!Init()) return false;
-  return gst_element_link(new_bin, audiobin_);
+  return gst_element_link(new_bin, decode_target());
 }
 
 bool GstEnginePipeline::InitFromUrl(const QUrl& url, qint64 end_nanosec) {
@@ -492,6 +759,8 @@ bool GstEnginePipeline::InitFromUrl(const QUrl& url, qint64 end_nanosec) {
 }
 
 GstEnginePipeline::~GstEnginePipeline() {
+  if (spotify_src_) gst_object_unref(spotify_src_);
+
   if (pipeline_) {
     gst_bus_set_sync_handler(gst_pipeline_get_bus(GST_PIPELINE(pipeline_)),
                              nullptr, nullptr, nullptr);
@@ -499,6 +768,10 @@ GstEnginePipeline::~GstEnginePipeline() {
     gst_element_set_state(pipeline_, GST_STATE_NULL);
     gst_object_unref(GST_OBJECT(pipeline_));
   }
+
+  BufferConsumerQueueList* consumers = buffer_consumers_;
+  qDeleteAll(*consumers);
+  delete consumers;
 }
 
 gboolean GstEnginePipeline::BusCallback(GstBus*, GstMessage* msg,
@@ -722,6 +995,11 @@ void GstEnginePipeline::StateChangedMessageReceived(GstMessage* msg) {
     }
   }
 
+  if (new_state == GST_STATE_PLAYING) {
+    PlaybackTrace::Instance()->EndSpan(trace_id_.fetchAndAddOrdered(0),
+                                       PlaybackTrace::Span_StateChange);
+  }
+
   if (pipeline_is_initialised_ && new_state != GST_STATE_PAUSED &&
       new_state != GST_STATE_PLAYING) {
     pipeline_is_initialised_ = false;
@@ -745,15 +1023,29 @@ void GstEnginePipeline::BufferingMessageReceived(GstMessage* msg) {
   int percent = 0;
   gst_message_parse_buffering(msg, &percent);
 
+  // A new crossfade branch fills its queue before it gets linked into the
+  // mixer, and the old track carries on playing meanwhile.
+  if (mixer_ && !current_branch_.mixer_pad_) {
+    if (percent == 100) {
+      current_branch_.buffered_ = true;
+      if (current_branch_.blocked_) LinkMixerBranch();
+    }
+    return;
+  }
+
   const GstState current_state = state();
 
   if (percent == 0 && current_state == GST_STATE_PLAYING && !buffering_) {
     buffering_ = true;
+    PlaybackTrace::Instance()->StartSpan(trace_id_.fetchAndAddOrdered(0),
+                                         PlaybackTrace::Span_Buffering);
     emit BufferingStarted();
 
     SetState(GST_STATE_PAUSED);
   } else if (percent == 100 && buffering_) {
     buffering_ = false;
+    PlaybackTrace::Instance()->EndSpan(trace_id_.fetchAndAddOrdered(0),
+                                       PlaybackTrace::Span_Buffering);
     emit BufferingFinished();
 
     SetState(GST_STATE_PLAYING);
@@ -766,7 +1058,7 @@ void GstEnginePipeline::NewPadCallback(GstElement*, GstPad* pad,
                                        gpointer self) {
   GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
   GstPad* const audiopad =
-      gst_element_get_static_pad(instance->audiobin_, "sink");
+      gst_element_get_static_pad(instance->decode_target(), "sink");
 
   // Link decodebin's sink pad to audiobin's src pad.
   if (GST_PAD_IS_LINKED(audiopad)) {
@@ -787,6 +1079,14 @@ void GstEnginePipeline::NewPadCallback(GstElement*, GstPad* pad,
       instance->last_decodebin_segment_.position);
   gst_pad_set_offset(pad, running_time);
 
+  if (instance->mixer_) {
+    // The mixer doesn't pass segments on, so work out where this track will
+    // start in the mixer's output.
+    QMutexLocker l(&instance->mixer_mutex_);
+    instance->pending_track_start_nanosec_ = instance->MixerStreamTimeLocked(
+        instance->current_branch_offset_ + running_time);
+  }
+
   // Add a probe to the pad so we can update last_decodebin_segment_.
   gst_pad_add_probe(
       pad, static_cast<GstPadProbeType>(GST_PAD_PROBE_TYPE_BUFFER |
@@ -808,6 +1108,12 @@ GstPadProbeReturn GstEnginePipeline::DecodebinProbe(GstPad* pad,
   GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(data);
   const GstPadProbeType info_type = GST_PAD_PROBE_INFO_TYPE(info);
 
+  // A track that's fading out in the mixer mustn't change the segment the
+  // current one is offset from.
+  if (GST_OBJECT_PARENT(pad) != GST_OBJECT(instance->uridecodebin_)) {
+    return GST_PAD_PROBE_OK;
+  }
+
   if (info_type & GST_PAD_PROBE_TYPE_BUFFER) {
     // The decodebin produced a buffer.  Record its end time, so we can offset
     // the buffers produced by the next decodebin when transitioning to the next
@@ -849,15 +1155,23 @@ GstPadProbeReturn GstEnginePipeline::HandoffCallback(GstPad*,
   GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
   GstBuffer* buf = gst_pad_probe_info_get_buffer(info);
 
-  QList<BufferConsumer*> consumers;
-  {
-    QMutexLocker l(&instance->buffer_consumers_mutex_);
-    consumers = instance->buffer_consumers_;
-  }
-
-  for (BufferConsumer* consumer : consumers) {
+  // The consumers run on their own threads, so all we do here is queue the
+  // buffer for each of them.
+  instance->buffer_consumers_readers_.fetchAndAddOrdered(1);
+  const BufferConsumerQueueList* consumers =
+      instance->buffer_consumers_.fetchAndAddOrdered(0);
+  for (BufferConsumerQueue* consumer : *consumers) {
     gst_buffer_ref(buf);
-    consumer->ConsumeBuffer(buf, instance->id());
+    consumer->Push(buf);
+  }
+  instance->buffer_consumers_readers_.fetchAndAddOrdered(-1);
+
+  // Prerolled pipelines see their first buffer before they're played, so this
+  // is only recorded once the pipeline belongs to a trace.
+  const int trace_id = instance->trace_id_.fetchAndAddOrdered(0);
+  if (trace_id != -1 &&
+      instance->first_buffer_traced_.testAndSetOrdered(0, 1)) {
+    PlaybackTrace::Instance()->Mark(trace_id, PlaybackTrace::Span_FirstBuffer);
   }
 
   // Calculate the end time of this buffer so we can stop playback if it's
@@ -939,6 +1253,9 @@ void GstEnginePipeline::SourceDrainedCallback(GstURIDecodeBin* bin,
                                               gpointer self) {
   GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
 
+  // Ignore tracks that are fading out in the mixer
+  if (GST_ELEMENT(bin) != instance->uridecodebin_) return;
+
   if (instance->has_next_valid_url() &&
       // I'm not sure why, but calling this when previous track is a local song
       // and the next track is a Spotify song is buggy: the Spotify song will
@@ -997,9 +1314,11 @@ void GstEnginePipeline::TransitionToNext() {
 
   url_ = next_url_;
   end_offset_nanosec_ = next_end_offset_nanosec_;
+  SetFallbackGain(next_rg_fallback_gain_);
   next_url_ = QUrl();
   next_beginning_offset_nanosec_ = 0;
   next_end_offset_nanosec_ = 0;
+  next_rg_fallback_gain_ = 0.0;
 
   // This function gets called when the source has been drained, even if the
   // song hasn't finished playing yet.  We'll get a new stream when it really
@@ -1018,7 +1337,15 @@ qint64 GstEnginePipeline::position() const {
     gst_element_query_position(pipeline_, GST_FORMAT_TIME,
                                &last_known_position_ns_);
 
-  return last_known_position_ns_;
+  if (!mixer_) return last_known_position_ns_;
+
+  QMutexLocker l(&mixer_mutex_);
+  if (pending_track_start_nanosec_ != -1 &&
+      last_known_position_ns_ >= pending_track_start_nanosec_) {
+    track_start_nanosec_ = pending_track_start_nanosec_;
+    pending_track_start_nanosec_ = -1;
+  }
+  return qMax(0ll, qint64(last_known_position_ns_) - track_start_nanosec_);
 }
 
 qint64 GstEnginePipeline::length() const {
@@ -1038,6 +1365,11 @@ GstState GstEnginePipeline::state() const {
 }
 
 QFuture<GstStateChangeReturn> GstEnginePipeline::SetState(GstState state) {
+  if (state == GST_STATE_PLAYING) {
+    PlaybackTrace::Instance()->StartSpan(trace_id_.fetchAndAddOrdered(0),
+                                         PlaybackTrace::Span_StateChange);
+  }
+
   if (url_.scheme() == "spotify" && !buffering_) {
     const GstState current_state = this->state();
 
@@ -1071,6 +1403,18 @@ bool GstEnginePipeline::Seek(qint64 nanosec) {
     return true;
   }
 
+  if (mixer_) {
+    // The old track can't follow the seek, so get rid of it now.  The flush
+    // restarts the mixer's output at the new position.
+    FinishCrossfade();
+    // A new track that's still waiting to go in wouldn't get the seek
+    LinkMixerBranch();
+
+    QMutexLocker l(&mixer_mutex_);
+    track_start_nanosec_ = 0;
+    pending_track_start_nanosec_ = -1;
+  }
+
   pending_seek_nanosec_ = -1;
   last_known_position_ns_ = nanosec;
   return gst_element_seek_simple(pipeline_, GST_FORMAT_TIME,
@@ -1078,7 +1422,11 @@ bool GstEnginePipeline::Seek(qint64 nanosec) {
 }
 
 void GstEnginePipeline::SetEqualizerEnabled(bool enabled) {
-  eq_enabled_ = enabled;
+  {
+    QMutexLocker l(&dsp_mutex_);
+    eq_enabled_ = enabled;
+  }
+  UpdateDspChain();
   UpdateEqualizer();
 }
 
@@ -1090,11 +1438,18 @@ void GstEnginePipeline::SetEqualizerParams(int preamp,
 }
 
 void GstEnginePipeline::SetStereoBalance(float value) {
-  stereo_balance_ = value;
+  {
+    QMutexLocker l(&dsp_mutex_);
+    stereo_balance_ = value;
+  }
+  UpdateDspChain();
   UpdateStereoBalance();
 }
 
 void GstEnginePipeline::UpdateEqualizer() {
+  QMutexLocker l(&dsp_mutex_);
+  if (!equalizer_) return;
+
   // Update band gains
   for (int i = 0; i < kEqBandCount; ++i) {
     float gain = eq_enabled_ ? eq_band_gains_[i] : 0.0;
@@ -1103,6 +1458,13 @@ void GstEnginePipeline::UpdateEqualizer() {
     else
       gain *= 0.12;
 
+    if (fast_equalizer_) {
+      g_object_set(G_OBJECT(equalizer_),
+                   QString("band%1").arg(i).toAscii().constData(),
+                   gdouble(gain), nullptr);
+      continue;
+    }
+
     const int index_in_eq = i + 1;
     // Offset because of the first dummy band we created.
     GstObject* band = GST_OBJECT(gst_child_proxy_get_child_by_index(
@@ -1120,12 +1482,124 @@ void GstEnginePipeline::UpdateEqualizer() {
 }
 
 void GstEnginePipeline::UpdateStereoBalance() {
+  QMutexLocker l(&dsp_mutex_);
   if (stereo_panorama_) {
     g_object_set(G_OBJECT(stereo_panorama_), "panorama", stereo_balance_,
                  nullptr);
   }
 }
 
+bool GstEnginePipeline::DspChainIsCurrent() const {
+  QMutexLocker l(&dsp_mutex_);
+  const bool want_equalizer = !direct_output_ && eq_enabled_;
+  const bool want_panorama = !direct_output_ && stereo_balance_ != 0.0f;
+  return want_equalizer == (equalizer_ != nullptr) &&
+         want_panorama == (stereo_panorama_ != nullptr);
+}
+
+void GstEnginePipeline::UpdateDspChain() {
+  // Init puts in whatever is needed if it hasn't run yet
+  if (!audio_queue_ || DspChainIsCurrent()) return;
+
+  // A relink that's already waiting will pick up the new settings
+  if (!dsp_relink_pending_.testAndSetOrdered(0, 1)) return;
+
+  GstPad* pad = gst_element_get_static_pad(audio_queue_, "src");
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_IDLE, &DspRelinkCallback, this,
+                    nullptr);
+  gst_object_unref(pad);
+}
+
+GstPadProbeReturn GstEnginePipeline::DspRelinkCallback(GstPad*,
+                                                       GstPadProbeInfo*,
+                                                       gpointer self) {
+  GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
+  instance->RelinkDspChain();
+  return GST_PAD_PROBE_REMOVE;
+}
+
+GstElement* GstEnginePipeline::AddDspElement(const char* factory_name) {
+  // This can run in a streaming thread where GstEngine::CreateElement isn't
+  // safe to call, so GStreamer names the element itself.
+  GstElement* element = gst_element_factory_make(factory_name, nullptr);
+  if (!element) {
+    qLog(Warning) << "Couldn't create" << factory_name;
+    return nullptr;
+  }
+
+  gst_bin_add(GST_BIN(audiobin_), element);
+  return element;
+}
+
+void GstEnginePipeline::RemoveDspElement(GstElement** element) {
+  if (!*element) return;
+
+  gst_element_set_state(*element, GST_STATE_NULL);
+  gst_bin_remove(GST_BIN(audiobin_), *element);
+  *element = nullptr;
+}
+
+QList<GstElement*> GstEnginePipeline::DspChain() const {
+  QList<GstElement*> ret;
+  ret << audio_queue_;
+  if (equalizer_) ret << equalizer_preamp_ << equalizer_;
+  if (stereo_panorama_) ret << stereo_panorama_;
+  ret << volume_;
+  return ret;
+}
+
+void GstEnginePipeline::RelinkDspChain() {
+  // Runs either from Init or while the audio queue's src pad is idle, so
+  // nothing is passing through the elements being moved.
+  QMutexLocker l(&dsp_mutex_);
+  dsp_relink_pending_.fetchAndStoreOrdered(0);
+  if (DspChainIsCurrent()) return;
+
+  QList<GstElement*> chain = DspChain();
+  for (int i = 0; i + 1 < chain.count(); ++i) {
+    gst_element_unlink(chain[i], chain[i + 1]);
+  }
+
+  QList<GstElement*> added;
+  if (direct_output_ || !eq_enabled_) {
+    RemoveDspElement(&equalizer_preamp_);
+    RemoveDspElement(&equalizer_);
+  } else if (!equalizer_) {
+    equalizer_preamp_ = AddDspElement("volume");
+    // Our own equalizer is faster and doesn't click when the gains change,
+    // but equalizer-nbands will do if it can't be created.
+    equalizer_ = AddDspElement("fastequalizer");
+    fast_equalizer_ = equalizer_ != nullptr;
+    if (!equalizer_) equalizer_ = AddDspElement("equalizer-nbands");
+    if (equalizer_preamp_ && equalizer_) {
+      SetUpEqualizer();
+      added << equalizer_preamp_ << equalizer_;
+    } else {
+      RemoveDspElement(&equalizer_preamp_);
+      RemoveDspElement(&equalizer_);
+    }
+  }
+
+  if (direct_output_ || stereo_balance_ == 0.0f) {
+    RemoveDspElement(&stereo_panorama_);
+  } else if (!stereo_panorama_) {
+    stereo_panorama_ = AddDspElement("audiopanorama");
+    if (stereo_panorama_) added << stereo_panorama_;
+  }
+
+  chain = DspChain();
+  for (int i = 0; i + 1 < chain.count(); ++i) {
+    gst_element_link(chain[i], chain[i + 1]);
+  }
+
+  for (GstElement* element : added) {
+    gst_element_sync_state_with_parent(element);
+  }
+
+  UpdateEqualizer();
+  UpdateStereoBalance();
+}
+
 void GstEnginePipeline::SetVolume(int percent) {
   volume_percent_ = percent;
   UpdateVolume();
@@ -1194,6 +1668,524 @@ void GstEnginePipeline::FaderTimelineFinished() {
   }
 }
 
+bool GstEnginePipeline::CrossfadeTo(const QUrl& url,
+                                    qint64 duration_nanosec) {
+  // Spotify and CDs need more than a new decodebin, see InitFromUrl().
+  if (!mixer_ || url.scheme() == "spotify" || url.scheme() == "cdda" ||
+      url_.scheme() == "spotify") {
+    return false;
+  }
+
+  // Only one track fades out at a time
+  FinishCrossfade();
+
+  MixerBranch branch;
+  if (!CreateMixerBranch(0.0, &branch)) return false;
+
+  MixerBranch old_branch = current_branch_;
+  old_branch.decodebin_ = uridecodebin_;
+  const GstSegment old_segment = last_decodebin_segment_;
+
+  // Clearing uridecodebin_ stops ReplaceDecodeBin() from removing the old one
+  SetCurrentBranch(branch);
+  gst_segment_init(&last_decodebin_segment_, GST_FORMAT_TIME);
+
+  if (!ReplaceDecodeBin(url)) {
+    RemoveMixerBranch(current_branch_);
+    SetCurrentBranch(old_branch);
+    last_decodebin_segment_ = old_segment;
+    return false;
+  }
+
+  fadeout_branch_ = old_branch;
+  crossfade_duration_msec_ = duration_nanosec / kNsecPerMsec;
+
+  url_ = url;
+  end_offset_nanosec_ = 0;
+  next_url_ = QUrl();
+  next_beginning_offset_nanosec_ = 0;
+  next_end_offset_nanosec_ = 0;
+  emit_track_ended_on_stream_start_ = false;
+
+  {
+    // Count the new track from here until we know exactly where it starts
+    QMutexLocker l(&mixer_mutex_);
+    track_start_nanosec_ = gst_segment_to_stream_time(
+        &mixer_segment_, GST_FORMAT_TIME, mixer_segment_.position);
+    pending_track_start_nanosec_ = -1;
+  }
+
+  // Start the branch from the mixer end, so nothing pushes into an element
+  // that isn't running yet.
+  for (int i = current_branch_.elements_.count() - 1; i >= 0; --i) {
+    gst_element_sync_state_with_parent(current_branch_.elements_[i]);
+  }
+  gst_element_sync_state_with_parent(uridecodebin_);
+
+  return true;
+}
+
+bool GstEnginePipeline::CreateMixerBranch(double volume,
+                                          MixerBranch* branch) {
+  GstElement* queue = engine_->CreateElement("queue2");
+  GstElement* convert = engine_->CreateElement("audioconvert");
+  GstElement* rgvolume = nullptr;
+  GstElement* rglimiter = nullptr;
+  GstElement* rgconvert = nullptr;
+  if (rg_enabled_) {
+    rgvolume = engine_->CreateElement("rgvolume");
+    rglimiter = engine_->CreateElement("rglimiter");
+    rgconvert = engine_->CreateElement("audioconvert");
+  }
+  GstElement* resample = engine_->CreateElement("audioresample");
+  GstElement* capsfilter = engine_->CreateElement("capsfilter");
+  GstElement* fade = engine_->CreateElement("volume");
+
+  QList<GstElement*> elements;
+  elements << queue << convert;
+  if (rg_enabled_) elements << rgvolume << rglimiter << rgconvert;
+  elements << resample << capsfilter << fade;
+
+  if (elements.contains(nullptr)) {
+    for (GstElement* element : elements) {
+      if (element) gst_object_unref(GST_OBJECT(element));
+    }
+    return false;
+  }
+
+  for (GstElement* element : elements) {
+    gst_bin_add(GST_BIN(pipeline_), element);
+  }
+  for (int i = 1; i < elements.count(); ++i) {
+    gst_element_link(elements[i - 1], elements[i]);
+  }
+
+  GstCaps* caps = MixerCaps();
+  g_object_set(G_OBJECT(capsfilter), "caps", caps, nullptr);
+  gst_caps_unref(caps);
+
+  SetUpBufferQueue(queue);
+  g_object_set(G_OBJECT(fade), "volume", volume, nullptr);
+
+  branch->id_ = next_branch_id_++;
+  branch->elements_ = elements;
+  branch->queue_ = queue;
+  branch->rgvolume_ = rgvolume;
+  branch->rglimiter_ = rglimiter;
+  branch->rgconvert_ = rgconvert;
+  branch->fade_ = fade;
+  g_object_set_data(G_OBJECT(fade), "clementine-branch-id",
+                    GINT_TO_POINTER(branch->id_));
+
+  GstPad* pad = gst_element_get_static_pad(fade, "src");
+  gst_pad_add_probe(
+      pad, static_cast<GstPadProbeType>(GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM |
+                                        GST_PAD_PROBE_TYPE_EVENT_FLUSH),
+      MixerBranchProbe, this, nullptr);
+  branch->block_probe_id_ =
+      gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM,
+                        MixerBranchBlocked, this, nullptr);
+  gst_object_unref(pad);
+
+  return true;
+}
+
+void GstEnginePipeline::SetCurrentBranch(const MixerBranch& branch) {
+  current_branch_ = branch;
+  uridecodebin_ = branch.decodebin_;
+  queue_ = branch.queue_;
+  rgvolume_ = branch.rgvolume_;
+  rglimiter_ = branch.rglimiter_;
+  audioconvert2_ = branch.rgconvert_;
+  if (rgvolume_) SetUpReplayGain();
+
+  QMutexLocker l(&mixer_mutex_);
+  current_fade_ = branch.fade_;
+}
+
+void GstEnginePipeline::LinkMixerBranch() {
+  if (current_branch_.mixer_pad_) return;
+
+  GstPad* pad = gst_element_get_static_pad(current_branch_.fade_, "src");
+
+  {
+    // Start the track at wherever the mixer has got to
+    QMutexLocker l(&mixer_mutex_);
+    const GstClockTime running_time = MixerRunningTimeLocked();
+
+    current_branch_offset_ = running_time;
+    gst_pad_set_offset(pad, running_time);
+    if (fadeout_branch_.fade_) {
+      pending_track_start_nanosec_ = MixerStreamTimeLocked(running_time);
+    }
+  }
+
+  current_branch_.mixer_pad_ = gst_element_get_request_pad(mixer_, "sink_%u");
+  gst_pad_link(pad, current_branch_.mixer_pad_);
+  gst_pad_remove_probe(pad, current_branch_.block_probe_id_);
+  current_branch_.block_probe_id_ = 0;
+  gst_object_unref(pad);
+
+  if (fadeout_branch_.fade_) {
+    crossfade_timeline_.reset(new QTimeLine(crossfade_duration_msec_, this));
+    connect(crossfade_timeline_.get(), SIGNAL(valueChanged(qreal)),
+            SLOT(CrossfadeTimelineChanged(qreal)));
+    connect(crossfade_timeline_.get(), SIGNAL(finished()),
+            SLOT(CrossfadeTimelineFinished()));
+    crossfade_timeline_->start();
+  }
+}
+
+void GstEnginePipeline::RemoveMixerBranch(const MixerBranch& branch) {
+  // Releasing the mixer pad first wakes up anything blocked pushing into it,
+  // then the elements are stopped from the mixer end back to the decodebin.
+  if (branch.mixer_pad_) {
+    gst_element_release_request_pad(mixer_, branch.mixer_pad_);
+    gst_object_unref(branch.mixer_pad_);
+  }
+
+  for (int i = branch.elements_.count() - 1; i >= 0; --i) {
+    gst_element_set_state(branch.elements_[i], GST_STATE_NULL);
+  }
+  if (branch.decodebin_) {
+    gst_element_set_state(branch.decodebin_, GST_STATE_NULL);
+    gst_bin_remove(GST_BIN(pipeline_), branch.decodebin_);
+  }
+  for (GstElement* element : branch.elements_) {
+    gst_bin_remove(GST_BIN(pipeline_), element);
+  }
+}
+
+GstCaps* GstEnginePipeline::MixerCaps() const {
+  // Every input to the mixer has to be in the same format
+  return gst_caps_new_simple(
+      "audio/x-raw", "format", G_TYPE_STRING, "F32LE", "layout",
+      G_TYPE_STRING, "interleaved", "rate", G_TYPE_INT,
+      sample_rate_ > 0 ? sample_rate_ : kMixerSampleRate, "channels",
+      G_TYPE_INT, 2, nullptr);
+}
+
+GstClockTime GstEnginePipeline::MixerRunningTimeLocked() const {
+  const GstClockTime running_time = gst_segment_to_running_time(
+      &mixer_segment_, GST_FORMAT_TIME, mixer_segment_.position);
+  return running_time == GST_CLOCK_TIME_NONE ? 0 : running_time;
+}
+
+int GstEnginePipeline::AddBackgroundBranch(const QUrl& url,
+                                           int volume_percent) {
+  if (!mixer_) return -1;
+
+  GstElement* convert = engine_->CreateElement("audioconvert");
+  GstElement* resample = engine_->CreateElement("audioresample");
+  GstElement* capsfilter = engine_->CreateElement("capsfilter");
+  GstElement* volume = engine_->CreateElement("volume");
+
+  QList<GstElement*> elements;
+  elements << convert << resample << capsfilter << volume;
+
+  if (elements.contains(nullptr)) {
+    for (GstElement* element : elements) {
+      if (element) gst_object_unref(GST_OBJECT(element));
+    }
+    return -1;
+  }
+
+  for (GstElement* element : elements) {
+    gst_bin_add(GST_BIN(pipeline_), element);
+  }
+  for (int i = 1; i < elements.count(); ++i) {
+    gst_element_link(elements[i - 1], elements[i]);
+  }
+
+  GstCaps* caps = MixerCaps();
+  g_object_set(G_OBJECT(capsfilter), "caps", caps, nullptr);
+  gst_caps_unref(caps);
+
+  const int id = next_branch_id_++;
+  g_object_set_data(G_OBJECT(volume), "clementine-branch-id",
+                    GINT_TO_POINTER(id));
+
+  BackgroundBranch branch;
+  branch.url_ = url;
+  branch.elements_ = elements;
+  branch.volume_ = volume;
+
+  GstPad* pad = gst_element_get_static_pad(volume, "src");
+  gst_pad_add_probe(
+      pad, static_cast<GstPadProbeType>(GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM |
+                                        GST_PAD_PROBE_TYPE_EVENT_FLUSH),
+      BackgroundBranchProbe, this, nullptr);
+  branch.mixer_pad_ = gst_element_get_request_pad(mixer_, "sink_%u");
+  gst_pad_link(pad, branch.mixer_pad_);
+  gst_object_unref(pad);
+
+  background_branches_[id] = branch;
+  SetBackgroundBranchVolume(id, volume_percent);
+
+  if (!StartBackgroundSource(&background_branches_[id])) {
+    RemoveBackgroundBranch(id);
+    return -1;
+  }
+
+  // Start from the mixer end, so nothing pushes into an element that isn't
+  // running yet.
+  for (int i = elements.count() - 1; i >= 0; --i) {
+    gst_element_sync_state_with_parent(elements[i]);
+  }
+  gst_element_sync_state_with_parent(background_branches_[id].source_);
+
+  return id;
+}
+
+bool GstEnginePipeline::StartBackgroundSource(BackgroundBranch* branch) {
+  GstElement* convert = branch->elements_.first();
+  GstElement* source = nullptr;
+
+  const char* description = GstEngine::PipelineForUrl(branch->url_);
+  if (description) {
+    // Not CreateDecodeBinFromString(), a broken background stream isn't an
+    // error in the track.
+    GError* error = nullptr;
+    source = gst_parse_bin_from_description(description, TRUE, &error);
+    if (error) {
+      qLog(Warning) << "Background stream:" << error->message;
+      g_error_free(error);
+      if (source) gst_object_unref(GST_OBJECT(source));
+      return false;
+    }
+    gst_bin_add(GST_BIN(pipeline_), source);
+    gst_element_link(source, convert);
+  } else {
+    source = engine_->CreateElement("uridecodebin");
+    if (!source) return false;
+    g_object_set(G_OBJECT(source), "uri", branch->url_.toEncoded().constData(),
+                 nullptr);
+    gst_bin_add(GST_BIN(pipeline_), source);
+    CHECKED_GCONNECT(G_OBJECT(source), "pad-added", &BackgroundPadCallback,
+                     convert);
+  }
+  branch->source_ = source;
+
+  // Its timestamps start from 0, so line them up with wherever the mixer has
+  // got to.
+  GstPad* pad = gst_element_get_static_pad(branch->volume_, "src");
+  {
+    QMutexLocker l(&mixer_mutex_);
+    gst_pad_set_offset(pad, MixerRunningTimeLocked());
+  }
+  gst_object_unref(pad);
+
+  return true;
+}
+
+void GstEnginePipeline::RestartBackgroundBranch(int id) {
+  if (!background_branches_.contains(id)) return;
+
+  BackgroundBranch& branch = background_branches_[id];
+  gst_element_set_state(branch.source_, GST_STATE_NULL);
+  gst_bin_remove(GST_BIN(pipeline_), branch.source_);
+  branch.source_ = nullptr;
+
+  if (!StartBackgroundSource(&branch)) {
+    RemoveBackgroundBranch(id);
+    return;
+  }
+  gst_element_sync_state_with_parent(branch.source_);
+}
+
+void GstEnginePipeline::RemoveBackgroundBranch(int id) {
+  if (!background_branches_.contains(id)) return;
+  const BackgroundBranch branch = background_branches_.take(id);
+
+  // The same order as RemoveMixerBranch()
+  gst_element_release_request_pad(mixer_, branch.mixer_pad_);
+  gst_object_unref(branch.mixer_pad_);
+
+  for (int i = branch.elements_.count() - 1; i >= 0; --i) {
+    gst_element_set_state(branch.elements_[i], GST_STATE_NULL);
+  }
+  if (branch.source_) {
+    gst_element_set_state(branch.source_, GST_STATE_NULL);
+    gst_bin_remove(GST_BIN(pipeline_), branch.source_);
+  }
+  for (GstElement* element : branch.elements_) {
+    gst_bin_remove(GST_BIN(pipeline_), element);
+  }
+}
+
+void GstEnginePipeline::RemoveBackgroundBranches() {
+  for (int id : background_branches_.keys()) {
+    RemoveBackgroundBranch(id);
+  }
+}
+
+void GstEnginePipeline::SetBackgroundBranchVolume(int id,
+                                                  int volume_percent) {
+  if (!background_branches_.contains(id)) return;
+  g_object_set(G_OBJECT(background_branches_[id].volume_), "volume",
+               double(volume_percent) * 0.01, nullptr);
+}
+
+void GstEnginePipeline::BackgroundPadCallback(GstElement*, GstPad* pad,
+                                              gpointer convert) {
+  GstPad* const sinkpad =
+      gst_element_get_static_pad(GST_ELEMENT(convert), "sink");
+  if (!GST_PAD_IS_LINKED(sinkpad)) gst_pad_link(pad, sinkpad);
+  gst_object_unref(sinkpad);
+}
+
+GstPadProbeReturn GstEnginePipeline::BackgroundBranchProbe(
+    GstPad* pad, GstPadProbeInfo* info, gpointer self) {
+  GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
+  GstEvent* event = gst_pad_probe_info_get_event(info);
+
+  switch (GST_EVENT_TYPE(event)) {
+    case GST_EVENT_FLUSH_START:
+      // The mixer's running time starts from 0 again after a flushing seek
+      gst_pad_set_offset(pad, 0);
+      break;
+
+    case GST_EVENT_EOS: {
+      // Background streams play on until they're removed, and mustn't end
+      // the mixer's stream.
+      const int id = GPOINTER_TO_INT(g_object_get_data(
+          G_OBJECT(GST_OBJECT_PARENT(pad)), "clementine-branch-id"));
+      QMetaObject::invokeMethod(instance, "RestartBackgroundBranch",
+                                Qt::QueuedConnection, Q_ARG(int, id));
+      return GST_PAD_PROBE_DROP;
+    }
+
+    default:
+      break;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+qint64 GstEnginePipeline::MixerStreamTimeLocked(
+    GstClockTime running_time) const {
+  // The mixer only ever plays forwards at normal speed
+  return qint64(running_time) - qint64(mixer_segment_.base) +
+         qint64(mixer_segment_.time);
+}
+
+GstPadProbeReturn GstEnginePipeline::MixerProbe(GstPad*,
+                                                GstPadProbeInfo* info,
+                                                gpointer self) {
+  GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
+  QMutexLocker l(&instance->mixer_mutex_);
+
+  if (GST_PAD_PROBE_INFO_TYPE(info) & GST_PAD_PROBE_TYPE_BUFFER) {
+    // Remember where the mixer's output has got to.  New branches are linked
+    // in from there.
+    GstBuffer* buffer = gst_pad_probe_info_get_buffer(info);
+    GstClockTime timestamp = GST_BUFFER_TIMESTAMP(buffer);
+    if (timestamp != GST_CLOCK_TIME_NONE) {
+      if (GST_BUFFER_DURATION_IS_VALID(buffer)) {
+        timestamp += GST_BUFFER_DURATION(buffer);
+      }
+      instance->mixer_segment_.position = timestamp;
+    }
+  } else {
+    GstEvent* event = gst_pad_probe_info_get_event(info);
+    if (GST_EVENT_TYPE(event) == GST_EVENT_SEGMENT) {
+      gst_event_copy_segment(event, &instance->mixer_segment_);
+    }
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn GstEnginePipeline::MixerBranchProbe(GstPad* pad,
+                                                      GstPadProbeInfo* info,
+                                                      gpointer self) {
+  GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
+  GstEvent* event = gst_pad_probe_info_get_event(info);
+
+  QMutexLocker l(&instance->mixer_mutex_);
+  const bool current =
+      GST_OBJECT_PARENT(pad) == GST_OBJECT(instance->current_fade_);
+
+  switch (GST_EVENT_TYPE(event)) {
+    case GST_EVENT_FLUSH_START:
+      // The mixer's running time starts from 0 again after a flushing seek
+      gst_pad_set_offset(pad, 0);
+      if (current) instance->current_branch_offset_ = 0;
+      break;
+
+    case GST_EVENT_EOS:
+      // The old track ending early mustn't end the mixer's stream before the
+      // new one has been linked in.
+      if (!current) {
+        QMetaObject::invokeMethod(instance, "FinishCrossfade",
+                                  Qt::QueuedConnection);
+        return GST_PAD_PROBE_DROP;
+      }
+
+      // The mixer only ends once all its inputs have, so the background
+      // streams have to go for the end of the track to get through.
+      QMetaObject::invokeMethod(instance, "RemoveBackgroundBranches",
+                                Qt::QueuedConnection);
+      break;
+
+    default:
+      break;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn GstEnginePipeline::MixerBranchBlocked(GstPad* pad,
+                                                        GstPadProbeInfo*,
+                                                        gpointer self) {
+  // The pad stays blocked until the main thread links it to the mixer.
+  GstEnginePipeline* instance = reinterpret_cast<GstEnginePipeline*>(self);
+  const int branch_id = GPOINTER_TO_INT(g_object_get_data(
+      G_OBJECT(GST_OBJECT_PARENT(pad)), "clementine-branch-id"));
+  QMetaObject::invokeMethod(instance, "MixerBranchReady",
+                            Qt::QueuedConnection, Q_ARG(int, branch_id));
+  return GST_PAD_PROBE_OK;
+}
+
+void GstEnginePipeline::MixerBranchReady(int branch_id) {
+  // The branch might have been replaced before it got any audio
+  if (branch_id != current_branch_.id_ || current_branch_.mixer_pad_) return;
+
+  current_branch_.blocked_ = true;
+  if (current_branch_.buffered_ || buffer_duration_nanosec_ <= 0) {
+    LinkMixerBranch();
+  }
+}
+
+void GstEnginePipeline::CrossfadeTimelineChanged(qreal value) {
+  if (fadeout_branch_.fade_) {
+    g_object_set(G_OBJECT(fadeout_branch_.fade_), "volume", 1.0 - value,
+                 nullptr);
+  }
+  g_object_set(G_OBJECT(current_branch_.fade_), "volume", value, nullptr);
+}
+
+void GstEnginePipeline::CrossfadeTimelineFinished() {
+  crossfade_timeline_.reset();
+
+  // Like FaderTimelineFinished(), give the audio server time to play the end
+  // of the old track.
+  crossfade_fudge_timer_.start(kFaderFudgeMsec, this);
+}
+
+void GstEnginePipeline::FinishCrossfade() {
+  if (!fadeout_branch_.fade_) return;
+
+  crossfade_timeline_.reset();
+  crossfade_fudge_timer_.stop();
+
+  RemoveMixerBranch(fadeout_branch_);
+  fadeout_branch_ = MixerBranch();
+  g_object_set(G_OBJECT(current_branch_.fade_), "volume", 1.0, nullptr);
+
+  emit CrossfadeFinished();
+}
+
 void GstEnginePipeline::timerEvent(QTimerEvent* e) {
   if (e->timerId() == fader_fudge_timer_.timerId()) {
     fader_fudge_timer_.stop();
@@ -1201,22 +2193,85 @@ void GstEnginePipeline::timerEvent(QTimerEvent* e) {
     return;
   }
 
+  if (e->timerId() == crossfade_fudge_timer_.timerId()) {
+    crossfade_fudge_timer_.stop();
+    FinishCrossfade();
+    return;
+  }
+
   QObject::timerEvent(e);
 }
 
+GstEnginePipeline::BufferConsumerQueueList*
+GstEnginePipeline::ReplaceBufferConsumers(BufferConsumerQueueList* consumers) {
+  BufferConsumerQueueList* old_consumers =
+      buffer_consumers_.fetchAndStoreOrdered(consumers);
+
+  // A HandoffCallback that started before the swap might still be using the
+  // old list.  They only queue buffers, so this doesn't take long.
+  while (buffer_consumers_readers_.fetchAndAddOrdered(0) != 0) {
+    QThread::yieldCurrentThread();
+  }
+  return old_consumers;
+}
+
 void GstEnginePipeline::AddBufferConsumer(BufferConsumer* consumer) {
   QMutexLocker l(&buffer_consumers_mutex_);
-  buffer_consumers_ << consumer;
+
+  BufferConsumerQueue* queue = new BufferConsumerQueue(consumer, id());
+  queue->start();
+
+  BufferConsumerQueueList* consumers =
+      new BufferConsumerQueueList(*buffer_consumers_);
+  *consumers << queue;
+  delete ReplaceBufferConsumers(consumers);
 }
 
 void GstEnginePipeline::RemoveBufferConsumer(BufferConsumer* consumer) {
   QMutexLocker l(&buffer_consumers_mutex_);
-  buffer_consumers_.removeAll(consumer);
+
+  BufferConsumerQueueList* consumers = new BufferConsumerQueueList;
+  BufferConsumerQueueList removed;
+  for (BufferConsumerQueue* queue : *buffer_consumers_) {
+    if (queue->consumer() == consumer) {
+      removed << queue;
+    } else {
+      *consumers << queue;
+    }
+  }
+  delete ReplaceBufferConsumers(consumers);
+
+  // Stops their threads, so the consumer won't be called after this returns
+  qDeleteAll(removed);
 }
 
 void GstEnginePipeline::RemoveAllBufferConsumers() {
   QMutexLocker l(&buffer_consumers_mutex_);
-  buffer_consumers_.clear();
+
+  BufferConsumerQueueList* old_consumers =
+      ReplaceBufferConsumers(new BufferConsumerQueueList);
+  qDeleteAll(*old_consumers);
+  delete old_consumers;
+}
+
+int GstEnginePipeline::dropped_buffers() {
+  QMutexLocker l(&buffer_consumers_mutex_);
+
+  int ret = 0;
+  for (BufferConsumerQueue* queue : *buffer_consumers_) {
+    ret += queue->dropped_buffers();
+  }
+  return ret;
+}
+
+int GstEnginePipeline::late_buffers() {
+  QMutexLocker l(&buffer_consumers_mutex_);
+
+  int ret = 0;
+  for (BufferConsumerQueue* queue : *buffer_consumers_) {
+    ret += queue->late_buffers();
+  }
+  return ret;
 }
 
 void GstEnginePipeline::SetNextUrl(const QUrl& url, qint64 beginning_nanosec,
@@ -1224,4 +2279,24 @@ void GstEnginePipeline::SetNextUrl(const QUrl& url, qint64 beginning_nanosec,
   next_url_ = url;
   next_beginning_offset_nanosec_ = beginning_nanosec;
   next_end_offset_nanosec_ = end_nanosec;
+  next_rg_fallback_gain_ = 0.0;
+
+  if (url.scheme() == "spotify") {
+    // Spotify tracks can't be queued up in the pipeline, but the blob can
+    // still start loading this one while the current one plays.
+    SpotifyServer* spotify_server =
+        InternetModel::Service<SpotifyService>()->server();
+    // Need to schedule this in the spotify server's thread
+    QMetaObject::invokeMethod(spotify_server, "Prefetch",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, url.toString()));
+  }
+}
+
+void GstEnginePipeline::SetFallbackGain(float gain_db) {
+  rg_fallback_gain_ = gain_db;
+  if (rgvolume_) {
+    g_object_set(G_OBJECT(rgvolume_), "fallback-gain",
+                 double(rg_fallback_gain_), nullptr);
+  }
 }
@@ -20,8 +20,11 @@
 
 #include <memory>
 
+#include <QAtomicInt>
+#include <QAtomicPointer>
 #include <QBasicTimer>
 #include <QFuture>
+#include <QMap>
 #include <QMutex>
 #include <QObject>
 #include <QThreadPool>
@@ -35,6 +38,7 @@
 class GstElementDeleter;
 class GstEngine;
 class BufferConsumer;
+class BufferConsumerQueue;
 
 struct GstQueue;
 struct GstURIDecodeBin;
@@ -54,8 +58,30 @@ class GstEnginePipeline : public QObject {
   void set_replaygain(bool enabled, int mode, float preamp, bool compression);
   void set_buffer_duration_nanosec(qint64 duration_nanosec);
   void set_buffer_min_fill(int percent);
+  // How full the buffer has to be before playback starts or resumes.
+  void set_buffer_high_fill(int percent);
+  // Caps the memory used by the buffer, 0 for no limit.  Unlike the other
+  // setters this can also be changed after Init.
+  void set_buffer_max_bytes(quint64 bytes);
   void set_mono_playback(bool enabled);
   void set_sample_rate(int rate);
+  // Leaves the equalizer, stereo balance and resampler out of the pipeline, so
+  // the samples reach the sink at the decoder's rate and untouched unless the
+  // volume is changed.  The sample rate setting is ignored.
+  void set_direct_output(bool enabled);
+  // The audio sink's own buffer, 0 for the sink's default.
+  void set_sink_buffer_duration_nanosec(qint64 duration_nanosec);
+  // Decodes each track into its own branch in front of a mixer, so
+  // CrossfadeTo can fade between tracks through a single audio bin.  Tracks
+  // are resampled to a common rate for the mixer.
+  void set_shared_crossfade(bool enabled);
+  // Also encodes the audio, before the equalizer and volume, and hands the
+  // encoded buffers to GstEngine::ConsumeStreamBuffer while the pipeline is
+  // playing.
+  void set_stream_output(bool enabled, int format, int bitrate_kbps);
+  // The PlaybackTrace that this pipeline's latency spans are added to, -1 for
+  // none.  Can also be set after Init, when a prerolled pipeline is played.
+  void set_trace_id(int trace_id);
 
   // Creates the pipeline, returns false on error
   bool InitFromUrl(const QUrl& url, qint64 end_nanosec);
@@ -66,6 +92,11 @@ class GstEnginePipeline : public QObject {
   void RemoveBufferConsumer(BufferConsumer* consumer);
   void RemoveAllBufferConsumers();
 
+  // Buffers the consumers' queues have thrown away because they were full or
+  // too old, added up over all the consumers.  Thread-safe.
+  int dropped_buffers();
+  int late_buffers();
+
   // Control the music playback
   QFuture<GstStateChangeReturn> SetState(GstState state);
   Q_INVOKABLE bool Seek(qint64 nanosec);
@@ -77,6 +108,22 @@ class GstEnginePipeline : public QObject {
                   QTimeLine::Direction direction = QTimeLine::Forward,
                   QTimeLine::CurveShape shape = QTimeLine::LinearCurve,
                   bool use_fudge_timer = true);
+  // Starts decoding url in a new branch and fades it in over the current one
+  // once it has produced audio.  The pipeline then belongs to the new track.
+  // CrossfadeFinished is emitted when the old track has been removed.
+  // Returns false if the pipeline wasn't set up for shared crossfades or
+  // can't play url this way.
+  bool CrossfadeTo(const QUrl& url, qint64 duration_nanosec);
+
+  // Background streams can be mixed into the output along with the track,
+  // so they don't need a pipeline and an audio device of their own.  The
+  // stream loops until it's removed.  Only pipelines set up for shared
+  // crossfades have a mixer to do this, AddBackgroundBranch returns -1 for
+  // the others.
+  bool has_mixer() const { return mixer_; }
+  int AddBackgroundBranch(const QUrl& url, int volume_percent);
+  void RemoveBackgroundBranch(int id);
+  void SetBackgroundBranchVolume(int id, int volume_percent);
 
   // If this is set then it will be loaded automatically when playback finishes
   // for gapless playback
@@ -84,6 +131,11 @@ class GstEnginePipeline : public QObject {
                   qint64 end_nanosec);
   bool has_next_valid_url() const { return next_url_.isValid(); }
 
+  // The gain in dB that's applied to the current or next URL if it has no
+  // ReplayGain tags of its own.  SetNextUrl resets the next one to 0.
+  void SetFallbackGain(float gain_db);
+  void SetNextFallbackGain(float gain_db) { next_rg_fallback_gain_ = gain_db; }
+
   // Get information about the music playback
   QUrl url() const { return url_; }
   bool is_valid() const { return valid_; }
@@ -117,6 +169,7 @@ signals:
   void Error(int pipeline_id, const QString& message, int domain,
              int error_code);
   void FaderFinished();
+  void CrossfadeFinished();
 
   void BufferingStarted();
   void BufferingProgress(int percent);
@@ -135,6 +188,18 @@ signals:
   static GstPadProbeReturn EventHandoffCallback(GstPad*, GstPadProbeInfo*,
                                                 gpointer);
   static GstPadProbeReturn DecodebinProbe(GstPad*, GstPadProbeInfo*, gpointer);
+  static GstPadProbeReturn DspRelinkCallback(GstPad*, GstPadProbeInfo*,
+                                             gpointer);
+  static GstPadProbeReturn MixerProbe(GstPad*, GstPadProbeInfo*, gpointer);
+  static GstPadProbeReturn MixerBranchProbe(GstPad*, GstPadProbeInfo*,
+                                            gpointer);
+  static GstPadProbeReturn MixerBranchBlocked(GstPad*, GstPadProbeInfo*,
+                                              gpointer);
+  static GstPadProbeReturn BackgroundBranchProbe(GstPad*, GstPadProbeInfo*,
+                                                 gpointer);
+  static void BackgroundPadCallback(GstElement*, GstPad*, gpointer);
+  static void StreamHandoffCallback(GstElement*, GstBuffer*, GstPad*,
+                                    gpointer);
   static void SourceDrainedCallback(GstURIDecodeBin*, gpointer);
   static void SourceSetupCallback(GstURIDecodeBin*, GParamSpec* pspec,
                                   gpointer);
@@ -150,28 +215,75 @@ signals:
   QString ParseTag(GstTagList* list, const char* tag) const;
 
   bool Init();
+  void SetUpEqualizer();
+  void SetUpBufferQueue(GstElement* queue);
+  void SetUpReplayGain();
+  bool AddStreamBranch(GstElement* tee);
+
+  // Where the decodebin's src pad gets linked to
+  GstElement* decode_target() const { return mixer_ ? queue_ : audiobin_; }
   GstElement* CreateDecodeBinFromString(const char* pipeline);
 
   void UpdateVolume();
   void UpdateEqualizer();
   void UpdateStereoBalance();
+  // The equalizer and stereo panorama are only in the pipeline while they
+  // change the sound.  This puts them in or takes them out, waiting for the
+  // audio queue's src pad to be idle if the pipeline is running.
+  void UpdateDspChain();
+  void RelinkDspChain();
+  bool DspChainIsCurrent() const;
+  // The elements from the audio queue to the volume, in order.
+  QList<GstElement*> DspChain() const;
+  GstElement* AddDspElement(const char* factory_name);
+  void RemoveDspElement(GstElement** element);
+
+  struct MixerBranch;
+  bool CreateMixerBranch(double volume, MixerBranch* branch);
+  void SetCurrentBranch(const MixerBranch& branch);
+  void LinkMixerBranch();
+  void RemoveMixerBranch(const MixerBranch& branch);
+  // The format every input to the mixer is converted to
+  GstCaps* MixerCaps() const;
+  // Where the mixer's output has got to.  Call with mixer_mutex_ held.
+  GstClockTime MixerRunningTimeLocked() const;
+  struct BackgroundBranch;
+  bool StartBackgroundSource(BackgroundBranch* branch);
+  // Stream time of the mixer's output at running_time.  Call with
+  // mixer_mutex_ held.
+  qint64 MixerStreamTimeLocked(GstClockTime running_time) const;
   bool ReplaceDecodeBin(GstElement* new_bin);
   bool ReplaceDecodeBin(const QUrl& url);
 
   void TransitionToNext();
 
+  typedef QList<BufferConsumerQueue*> BufferConsumerQueueList;
+
+  // Swaps in a new list of buffer consumers, and returns the old one once
+  // it's safe to delete.  buffer_consumers_mutex_ must be held.
+  BufferConsumerQueueList* ReplaceBufferConsumers(
+      BufferConsumerQueueList* consumers);
+
   // If the decodebin is special (ie. not really a uridecodebin) then it'll have
   // a src pad immediately and we can link it after everything's created.
   void MaybeLinkDecodeToAudio();
 
  private slots:
   void FaderTimelineFinished();
+  void MixerBranchReady(int branch_id);
+  void RestartBackgroundBranch(int id);
+  void RemoveBackgroundBranches();
+  void CrossfadeTimelineChanged(qreal value);
+  void CrossfadeTimelineFinished();
+  void FinishCrossfade();
+  void SpotifyMediaSocketReady(const QString& socket_path);
 
  private:
   static const int kGstStateTimeoutNanosecs;
   static const int kFaderFudgeMsec;
   static const int kEqBandCount;
   static const int kEqBandFrequencies[];
+  static const int kMixerSampleRate;
 
   static GstElementDeleter* sElementDeleter;
 
@@ -190,8 +302,11 @@ signals:
   QString sink_;
   QVariant device_;
 
-  // These get called when there is a new audio buffer available
-  QList<BufferConsumer*> buffer_consumers_;
+  // These get fed each new audio buffer.  HandoffCallback reads the list
+  // without taking a lock, so it's never changed in place: writers swap in a
+  // new list and wait until no HandoffCallback can still be using the old one.
+  QAtomicPointer<BufferConsumerQueueList> buffer_consumers_;
+  QAtomicInt buffer_consumers_readers_;
   QMutex buffer_consumers_mutex_;
   qint64 segment_start_;
   bool segment_start_received_;
@@ -214,14 +329,29 @@ signals:
   int rg_mode_;
   float rg_preamp_;
   bool rg_compression_;
+  float rg_fallback_gain_;
+  float next_rg_fallback_gain_;
 
   // Buffering
   quint64 buffer_duration_nanosec_;
   int buffer_min_fill_;
+  int buffer_high_fill_;
+  quint64 buffer_max_bytes_;
   bool buffering_;
 
+  // Read from the streaming threads as well
+  QAtomicInt trace_id_;
+  QAtomicInt first_buffer_traced_;
+
   bool mono_playback_;
   int sample_rate_;
+  bool direct_output_;
+  qint64 sink_buffer_duration_nanosec_;
+  bool shared_crossfade_;
+
+  bool stream_output_;
+  int stream_format_;
+  int stream_bitrate_kbps_;
 
   // The URL that is currently playing, and the URL that is to be preloaded
   // when the current track is close to finishing.
@@ -281,19 +411,107 @@ signals:
   GstElement* uridecodebin_;
   GstElement* audiobin_;
 
+  // The shmsrc of a Spotify decodebin, kept stopped until the Spotify blob is
+  // listening on spotify_socket_path_.  Holds a reference.
+  GstElement* spotify_src_;
+  QString spotify_socket_path_;
+
   // Elements in the audiobin.  See comments in Init()'s definition.
   GstElement* queue_;
   GstElement* audioconvert_;
   GstElement* rgvolume_;
   GstElement* rglimiter_;
   GstElement* audioconvert2_;
+  GstElement* audio_queue_;
+  // These three can be added and removed by the streaming thread, so they are
+  // protected by dsp_mutex_.
   GstElement* equalizer_preamp_;
   GstElement* equalizer_;
+  // True if equalizer_ is our own fastequalizer rather than GStreamer's
+  // equalizer-nbands.
+  bool fast_equalizer_;
   GstElement* stereo_panorama_;
   GstElement* volume_;
   GstElement* audioscale_;
   GstElement* audiosink_;
 
+  mutable QMutex dsp_mutex_;
+  QAtomicInt dsp_relink_pending_;
+
+  // With shared crossfades each track is decoded into its own branch
+  //   uridecodebin ! queue2 ! audioconvert
+  //     ! ( rgvolume ! rglimiter ! audioconvert ) ! audioresample ! <caps>
+  //     ! volume ! mixer
+  // and the mixer feeds the audio bin.  uridecodebin_, queue_ and the
+  // replaygain elements above point at the current branch's.
+  struct MixerBranch {
+    MixerBranch()
+        : id_(0),
+          decodebin_(nullptr),
+          queue_(nullptr),
+          rgvolume_(nullptr),
+          rglimiter_(nullptr),
+          rgconvert_(nullptr),
+          fade_(nullptr),
+          mixer_pad_(nullptr),
+          block_probe_id_(0),
+          blocked_(false),
+          buffered_(false) {}
+
+    int id_;
+    GstElement* decodebin_;
+    // From the queue to the fade volume, in order
+    QList<GstElement*> elements_;
+    GstElement* queue_;
+    GstElement* rgvolume_;
+    GstElement* rglimiter_;
+    GstElement* rgconvert_;
+    GstElement* fade_;
+
+    // A new branch is held back at the fade volume's src pad until it has
+    // audio ready and its queue has filled.
+    GstPad* mixer_pad_;
+    gulong block_probe_id_;
+    bool blocked_;
+    bool buffered_;
+  };
+
+  // Background streams are mixed in through
+  //   source ! audioconvert ! audioresample ! <caps> ! volume ! mixer
+  // When the source ends it's replaced with a new one from the same URL.
+  struct BackgroundBranch {
+    BackgroundBranch()
+        : source_(nullptr), volume_(nullptr), mixer_pad_(nullptr) {}
+
+    QUrl url_;
+    GstElement* source_;
+    // From the audioconvert to the volume, in order
+    QList<GstElement*> elements_;
+    GstElement* volume_;
+    GstPad* mixer_pad_;
+  };
+
+  GstElement* mixer_;
+  QMap<int, BackgroundBranch> background_branches_;
+  MixerBranch current_branch_;
+  MixerBranch fadeout_branch_;
+  int next_branch_id_;
+
+  int crossfade_duration_msec_;
+  std::unique_ptr<QTimeLine> crossfade_timeline_;
+  QBasicTimer crossfade_fudge_timer_;
+
+  // Written by the streaming threads.  The mixer's output is one long stream
+  // across all the tracks it played, so the positions of each track start at
+  // track_start_nanosec_.  pending_track_start_nanosec_ takes over once
+  // playback gets there, or is -1.
+  mutable QMutex mixer_mutex_;
+  GstSegment mixer_segment_;
+  GstElement* current_fade_;
+  GstClockTime current_branch_offset_;
+  mutable qint64 track_start_nanosec_;
+  mutable qint64 pending_track_start_nanosec_;
+
   uint bus_cb_id_;
 
   QThreadPool set_state_threadpool_;
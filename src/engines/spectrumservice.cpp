@@ -0,0 +1,131 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "spectrumservice.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <gst/gst.h>
+
+#include "analyzers/fht.h"
+#include "core/timeconstants.h"
+
+const int SpectrumService::kChunkMsec = 20;
+
+SpectrumService::SpectrumService()
+    : mono_(1 << kMaxSizeExp), next_version_(1) {
+  clock_.start();
+}
+
+SpectrumService::~SpectrumService() {}
+
+void SpectrumService::AddListener(int size_exp) {
+  Q_ASSERT(size_exp >= kMinSizeExp && size_exp <= kMaxSizeExp);
+  listeners_[size_exp].ref();
+}
+
+void SpectrumService::RemoveListener(int size_exp) {
+  Q_ASSERT(size_exp >= kMinSizeExp && size_exp <= kMaxSizeExp);
+  listeners_[size_exp].deref();
+}
+
+void SpectrumService::ConsumeBuffer(GstBuffer* buffer, int) {
+  bool listening[kMaxSizeExp + 1] = {};
+  bool any_listening = false;
+  for (int exp = kMinSizeExp; exp <= kMaxSizeExp; ++exp) {
+    listening[exp] = listeners_[exp].fetchAndAddAcquire(0) > 0;
+    any_listening |= listening[exp];
+  }
+
+  const GstClockTime duration = GST_BUFFER_DURATION(buffer);
+  GstMapInfo map;
+  if (!any_listening || !GST_CLOCK_TIME_IS_VALID(duration) || duration == 0 ||
+      !gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+    gst_buffer_unref(buffer);
+    return;
+  }
+
+  // Interleaved 16 bit stereo, the same as Engine::Scope.
+  const int16_t* samples = reinterpret_cast<const int16_t*>(map.data);
+  const int frame_count = map.size / (2 * sizeof(int16_t));
+  const int chunks = qMax(
+      1, qMin(frame_count,
+              static_cast<int>(std::ceil(static_cast<double>(duration) /
+                                         (kChunkMsec * kNsecPerMsec)))));
+  const int chunk_frames = frame_count / chunks;
+
+  Frame& frame = frames_.back();
+  frame.first_version_ = next_version_;
+  frame.start_msec_ = clock_.elapsed();
+  frame.chunk_msec_ = qMax<qint64>(1, duration / kNsecPerMsec / chunks);
+  frame.chunks_ = chunks;
+  next_version_ += chunks;
+
+  for (int exp = kMinSizeExp; exp <= kMaxSizeExp; ++exp) {
+    if (!listening[exp]) {
+      frame.power_[exp].clear();
+      continue;
+    }
+    frame.power_[exp].resize(chunks << (exp - 1));
+    if (!fhts_[exp]) fhts_[exp].reset(new FHT(exp));
+  }
+
+  for (int chunk = 0; chunk < chunks; ++chunk) {
+    const int first = chunk * chunk_frames;
+    const int available = qMin<int>(mono_.size(), frame_count - first);
+    const int16_t* source = samples + first * 2;
+    for (int i = 0; i < available; ++i) {
+      mono_[i] = static_cast<double>(source[i * 2] + source[i * 2 + 1]) /
+                 (2 * (1 << 15));
+    }
+    std::fill(mono_.begin() + available, mono_.end(), 0.0f);
+
+    for (int exp = kMinSizeExp; exp <= kMaxSizeExp; ++exp) {
+      if (!listening[exp]) continue;
+
+      const int size = 1 << exp;
+      scratch_.assign(mono_.begin(), mono_.begin() + size);
+      fhts_[exp]->power2(scratch_.data());
+      std::copy(scratch_.begin(), scratch_.begin() + size / 2,
+                frame.power_[exp].begin() + chunk * size / 2);
+    }
+  }
+
+  gst_buffer_unmap(buffer, &map);
+  gst_buffer_unref(buffer);
+
+  frames_.Publish();
+}
+
+quint64 SpectrumService::Read(int size_exp, std::vector<float>* power) {
+  frames_.Update();
+  const Frame& frame = frames_.front();
+  const std::vector<float>& spectra = frame.power_[size_exp];
+  if (spectra.empty()) return 0;
+
+  // The chunks are played one after another from when the buffer arrived.
+  const int half = 1 << (size_exp - 1);
+  const int chunk = qBound<qint64>(
+      0, (clock_.elapsed() - frame.start_msec_) / frame.chunk_msec_,
+      frame.chunks_ - 1);
+
+  power->resize(half * 2);
+  std::copy(spectra.begin() + chunk * half,
+            spectra.begin() + (chunk + 1) * half, power->begin());
+  return frame.first_version_ + chunk;
+}
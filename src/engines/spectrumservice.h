@@ -0,0 +1,89 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ENGINES_SPECTRUMSERVICE_H_
+#define ENGINES_SPECTRUMSERVICE_H_
+
+#include <memory>
+#include <vector>
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+#include "bufferconsumer.h"
+#include "core/triplebuffer.h"
+
+class FHT;
+
+// Works out the spectrum of the audio being played once, for every analyzer
+// that's showing, instead of each of them converting and transforming the
+// samples itself.  It's fed buffers like any other BufferConsumer, so the
+// work happens on the thread BufferConsumerQueue gives it.
+//
+// Each buffer is split into chunks of about kChunkMsec, and the first
+// 2^kMaxSizeExp stereo frames of each chunk are mixed down to mono and put
+// through FHT::power2, for every FHT size that has a listener.  The chunks of
+// a buffer are published together through a TripleBuffer, and Read() picks
+// the one that's playing now, so the reader never waits for the transforms.
+class SpectrumService : public BufferConsumer {
+ public:
+  SpectrumService();
+  ~SpectrumService();
+
+  static const int kMinSizeExp = 3;
+  static const int kMaxSizeExp = 9;
+  static const int kChunkMsec;
+
+  // Spectra are only worked out for FHT sizes, as powers of two, that have
+  // listeners.  Safe to call from any thread.
+  void AddListener(int size_exp);
+  void RemoveListener(int size_exp);
+
+  // Sets power to FHT::power2 of the current 2^size_exp mono samples, so the
+  // first half of it is filled in.  Returns the spectrum's version, which
+  // goes up by at least one each time there's a new one, or 0 if there isn't
+  // one of this size yet.  Must only be called from one thread.
+  quint64 Read(int size_exp, std::vector<float>* power);
+
+  // BufferConsumer
+  void ConsumeBuffer(GstBuffer* buffer, int pipeline_id);
+
+ private:
+  struct Frame {
+    Frame() : first_version_(0), start_msec_(0), chunk_msec_(1), chunks_(0) {}
+
+    quint64 first_version_;
+    qint64 start_msec_;
+    qint64 chunk_msec_;
+    int chunks_;
+    // The first halves of each chunk's spectrum one after another, for each
+    // size.  Empty for sizes nobody was listening for.
+    std::vector<float> power_[kMaxSizeExp + 1];
+  };
+
+  QElapsedTimer clock_;
+  QAtomicInt listeners_[kMaxSizeExp + 1];
+  TripleBuffer<Frame> frames_;
+
+  // Only used by ConsumeBuffer.
+  std::unique_ptr<FHT> fhts_[kMaxSizeExp + 1];
+  std::vector<float> mono_;
+  std::vector<float> scratch_;
+  quint64 next_version_;
+};
+
+#endif  // ENGINES_SPECTRUMSERVICE_H_
@@ -0,0 +1,106 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "streambuffering.h"
+
+#include <QCryptographicHash>
+#include <QStringList>
+
+#include "core/logging.h"
+#include "core/settingscache.h"
+#include "core/settingsprovider.h"
+
+const char* StreamBuffering::kSettingsGroup = "StreamBuffering";
+const int StreamBuffering::kFastStartPlays = 3;
+const int StreamBuffering::kFastStartFill = 40;
+const int StreamBuffering::kFullFill = 99;
+const int StreamBuffering::kMaxGrowth = 3;
+const int StreamBuffering::kCleanPlayMsec = 60000;
+
+StreamBuffering::StreamBuffering(SettingsProvider* settings)
+    : settings_(settings ? settings : SettingsCache::CreateProvider()) {
+  settings_->set_group(kSettingsGroup);
+}
+
+StreamBuffering::~StreamBuffering() {}
+
+bool StreamBuffering::IsStream(const QUrl& url) {
+  static const QStringList kSchemes = QStringList() << "http"
+                                                    << "https"
+                                                    << "mms"
+                                                    << "mmsh"
+                                                    << "rtsp"
+                                                    << "rtmp";
+  return kSchemes.contains(url.scheme());
+}
+
+QString StreamBuffering::Key(const QUrl& url) {
+  const QByteArray encoded =
+      url.toEncoded(QUrl::RemoveUserInfo | QUrl::RemoveQuery);
+
+  // Settings keys can't contain slashes.
+  return QString::fromLatin1(
+      QCryptographicHash::hash(encoded, QCryptographicHash::Sha1).toHex());
+}
+
+StreamBuffering::History& StreamBuffering::HistoryForKey(const QString& key) {
+  if (!history_.contains(key)) {
+    History& history = history_[key];
+    history.growth_ = settings_->value(key + "/growth", 0).toInt();
+    history.clean_plays_ = settings_->value(key + "/cleanplays", 0).toInt();
+  }
+  return history_[key];
+}
+
+void StreamBuffering::Save(const QString& key) {
+  const History& history = history_[key];
+  settings_->setValue(key + "/growth", history.growth_);
+  settings_->setValue(key + "/cleanplays", history.clean_plays_);
+}
+
+StreamBuffering::Params StreamBuffering::ParamsForUrl(
+    const QUrl& url, qint64 default_duration_nanosec) {
+  const History& history = HistoryForKey(Key(url));
+
+  Params ret;
+  ret.duration_nanosec_ = default_duration_nanosec << history.growth_;
+  ret.high_fill_ =
+      history.clean_plays_ >= kFastStartPlays ? kFastStartFill : kFullFill;
+  return ret;
+}
+
+void StreamBuffering::Underrun(const QUrl& url) {
+  const QString key = Key(url);
+  History& history = HistoryForKey(key);
+
+  history.growth_ = qMin(history.growth_ + 1, kMaxGrowth);
+  history.clean_plays_ = 0;
+  Save(key);
+
+  qLog(Debug) << "Stream ran dry, growing its buffer" << url;
+}
+
+void StreamBuffering::PlayedCleanly(const QUrl& url) {
+  const QString key = Key(url);
+  History& history = HistoryForKey(key);
+
+  history.clean_plays_++;
+  if (history.growth_ > 0 && history.clean_plays_ % kFastStartPlays == 0) {
+    history.growth_--;
+  }
+  Save(key);
+}
@@ -0,0 +1,84 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STREAMBUFFERING_H
+#define STREAMBUFFERING_H
+
+#include <memory>
+
+#include <QHash>
+#include <QString>
+#include <QUrl>
+
+class SettingsProvider;
+
+// Remembers how each internet radio station has behaved, and picks buffer
+// settings for it.  A station that has played cleanly a few times starts
+// playing after a smaller fill, and one that runs dry gets a bigger buffer
+// next time.
+class StreamBuffering {
+ public:
+  explicit StreamBuffering(SettingsProvider* settings = nullptr);
+  ~StreamBuffering();
+
+  static const char* kSettingsGroup;
+
+  // Clean plays before a station starts at kFastStartFill.  The same number
+  // of clean plays shrinks a grown buffer by one step.
+  static const int kFastStartPlays;
+  // How full the buffer has to be, as a percentage, before playback starts or
+  // resumes.  Other stations wait until it's completely full.
+  static const int kFastStartFill;
+  static const int kFullFill;
+  // The buffer doubles on each underrun, up to 2^kMaxGrowth times the
+  // configured size.
+  static const int kMaxGrowth;
+  // How long a station has to play without an underrun to count as clean.
+  static const int kCleanPlayMsec;
+
+  struct Params {
+    qint64 duration_nanosec_;
+    int high_fill_;
+  };
+
+  // Whether the URL is a network stream that this applies to.
+  static bool IsStream(const QUrl& url);
+
+  Params ParamsForUrl(const QUrl& url, qint64 default_duration_nanosec);
+
+  void Underrun(const QUrl& url);
+  void PlayedCleanly(const QUrl& url);
+
+ private:
+  struct History {
+    History() : growth_(0), clean_plays_(0) {}
+
+    int growth_;
+    int clean_plays_;
+  };
+
+  // Query strings often hold listen keys that change, so they're left out.
+  static QString Key(const QUrl& url);
+
+  History& HistoryForKey(const QString& key);
+  void Save(const QString& key);
+
+  std::unique_ptr<SettingsProvider> settings_;
+  QHash<QString, History> history_;
+};
+
+#endif  // STREAMBUFFERING_H
@@ -32,6 +32,40 @@
 const int GlobalSearch::kDelayedSearchTimeoutMs = 200;
 const char* GlobalSearch::kSettingsGroup = "GlobalSearch";
 const int GlobalSearch::kMaxResultsPerEmission = 500;
+const int GlobalSearch::kResultCacheSize = 8;
+const int GlobalSearch::kResultCacheMaxAgeMs = 30000;
+
+namespace {
+
+// True if everything that matches query also matches previous_query, because
+// every word of previous_query is the start of a word in query.  Queries that
+// use column filters or other syntax are never treated as refinements.
+bool IsRefinement(const QString& previous_query, const QString& query) {
+  static const QRegExp kSyntax("[:\"()\\-]");
+  if (previous_query.contains(kSyntax) || query.contains(kSyntax)) {
+    return false;
+  }
+
+  const QStringList previous_tokens =
+      previous_query.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+  const QStringList tokens =
+      query.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+  if (previous_tokens.isEmpty()) return false;
+
+  for (const QString& previous_token : previous_tokens) {
+    bool extended = false;
+    for (const QString& token : tokens) {
+      if (token.startsWith(previous_token, Qt::CaseInsensitive)) {
+        extended = true;
+        break;
+      }
+    }
+    if (!extended) return false;
+  }
+  return true;
+}
+
+}  // namespace
 
 GlobalSearch::GlobalSearch(Application* app, QObject* parent)
     : QObject(parent),
@@ -92,6 +126,7 @@ int GlobalSearch::SearchAsync(const QString& query) {
 
 void GlobalSearch::DoSearchAsync(int id, const QString& query) {
   pending_search_providers_[id] = 0;
+  pending_search_queries_[id] = query;
 
   int timer_id = -1;
 
@@ -103,6 +138,13 @@ void GlobalSearch::DoSearchAsync(int id, const QString& query) {
 
       pending_search_providers_[id]++;
 
+      if (StartCachedSearch(id, query, provider)) continue;
+      providers_[provider].running_results_[id] = SearchProvider::ResultList();
+
+      if (provider->can_fetch_more_results()) {
+        AddMorePages(provider, id, query, true);
+      }
+
       if (provider->wants_delayed_queries()) {
         if (timer_id == -1) {
           timer_id = startTimer(kDelayedSearchTimeoutMs);
@@ -117,13 +159,135 @@ void GlobalSearch::DoSearchAsync(int id, const QString& query) {
   }
 }
 
+bool GlobalSearch::StartCachedSearch(int id, const QString& query,
+                                     SearchProvider* provider) {
+  ProviderData* data = &providers_[provider];
+
+  // Drop results that might be out of date by now.
+  QList<CachedResults>::iterator it = data->cached_results_.begin();
+  while (it != data->cached_results_.end()) {
+    if (it->age_.elapsed() > kResultCacheMaxAgeMs) {
+      it = data->cached_results_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  CachedSearch search;
+  search.id_ = id;
+  search.provider_ = provider;
+
+  bool found = false;
+  for (const CachedResults& cached : data->cached_results_) {
+    if (cached.query_ == query) {
+      search.results_ = cached.results_;
+      found = true;
+      break;
+    }
+  }
+
+  if (!found && provider->can_refine_results()) {
+    // Filter the results of a shorter query instead of searching again.
+    const QStringList tokens =
+        query.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+    for (const CachedResults& cached : data->cached_results_) {
+      if (!IsRefinement(cached.query_, query)) continue;
+
+      for (const SearchProvider::Result& result : cached.results_) {
+        if (provider->ResultMatches(result, tokens)) search.results_ << result;
+      }
+
+      CachedResults refined;
+      refined.query_ = query;
+      refined.results_ = search.results_;
+      refined.age_ = cached.age_;
+      data->cached_results_.prepend(refined);
+      found = true;
+      break;
+    }
+  }
+
+  if (!found) return false;
+
+  // Only the first page is cached, so the next one comes from the provider.
+  if (provider->can_fetch_more_results() && !search.results_.isEmpty()) {
+    AddMorePages(provider, id, query, false);
+  }
+
+  cached_searches_ << search;
+  if (cached_searches_.count() == 1) {
+    QMetaObject::invokeMethod(this, "ServeCachedResults",
+                              Qt::QueuedConnection);
+  }
+  return true;
+}
+
+void GlobalSearch::ServeCachedResults() {
+  const QList<CachedSearch> searches = cached_searches_;
+  cached_searches_.clear();
+
+  for (const CachedSearch& search : searches) {
+    EmitResults(search.id_, search.results_);
+    ProviderFinished(search.id_, search.provider_);
+  }
+}
+
+void GlobalSearch::AddMorePages(SearchProvider* provider, int id,
+                                const QString& query, bool fetching) {
+  QMap<int, MorePages>* more_pages = &providers_[provider].more_pages_;
+
+  MorePages& more = (*more_pages)[id];
+  more.query_ = query;
+  more.fetching_ = fetching;
+
+  // Only recent searches are likely to be scrolled through.
+  while (more_pages->count() > kResultCacheSize) {
+    more_pages->erase(more_pages->begin());
+  }
+}
+
+bool GlobalSearch::FetchMoreAsync(int id) {
+  bool started = false;
+
+  for (SearchProvider* provider : providers_.keys()) {
+    if (!is_provider_usable(provider)) continue;
+
+    QMap<int, MorePages>::iterator it =
+        providers_[provider].more_pages_.find(id);
+    if (it == providers_[provider].more_pages_.end() || it->fetching_) {
+      continue;
+    }
+
+    it->fetching_ = true;
+    it->received_ = 0;
+    pending_search_providers_[id]++;
+    provider->FetchMoreAsync(id, it->query_, it->next_page_++);
+    started = true;
+  }
+
+  return started;
+}
+
 void GlobalSearch::CancelSearch(int id) {
   QMap<int, DelayedSearch>::iterator it;
   for (it = delayed_searches_.begin(); it != delayed_searches_.end(); ++it) {
     if (it.value().id_ == id) {
       killTimer(it.key());
       delayed_searches_.erase(it);
-      return;
+      break;
+    }
+  }
+
+  // Results of a cancelled search might be incomplete, so they can't be
+  // cached.
+  for (SearchProvider* provider : providers_.keys()) {
+    ProviderData* data = &providers_[provider];
+    const bool fetching_more =
+        data->more_pages_.contains(id) && data->more_pages_[id].fetching_;
+    data->more_pages_.remove(id);
+
+    if (data->running_results_.remove(id) || fetching_more) {
+      provider->CancelSearch(id);
     }
   }
 }
@@ -149,6 +313,25 @@ QString GlobalSearch::PixmapCacheKey(const SearchProvider::Result& result)
 
 void GlobalSearch::ResultsAvailableSlot(int id,
                                         SearchProvider::ResultList results) {
+  SearchProvider* provider = static_cast<SearchProvider*>(sender());
+  if (providers_.contains(provider)) {
+    QMap<int, SearchProvider::ResultList>::iterator it =
+        providers_[provider].running_results_.find(id);
+    if (it != providers_[provider].running_results_.end()) {
+      it.value() << results;
+    }
+
+    QMap<int, MorePages>::iterator more =
+        providers_[provider].more_pages_.find(id);
+    if (more != providers_[provider].more_pages_.end()) {
+      more->received_ += results.count();
+    }
+  }
+
+  EmitResults(id, results);
+}
+
+void GlobalSearch::EmitResults(int id, SearchProvider::ResultList results) {
   if (results.isEmpty()) return;
 
   // Limit the number of results that are used from each emission.
@@ -170,15 +353,49 @@ void GlobalSearch::ResultsAvailableSlot(int id,
 }
 
 void GlobalSearch::SearchFinishedSlot(int id) {
+  SearchProvider* provider = static_cast<SearchProvider*>(sender());
+
+  if (providers_.contains(provider)) {
+    ProviderData* data = &providers_[provider];
+
+    QMap<int, MorePages>::iterator more = data->more_pages_.find(id);
+    if (more != data->more_pages_.end()) {
+      if (more->received_ == 0) {
+        data->more_pages_.erase(more);
+      } else {
+        more->fetching_ = false;
+      }
+    }
+
+    QMap<int, SearchProvider::ResultList>::iterator it =
+        data->running_results_.find(id);
+    if (it != data->running_results_.end()) {
+      CachedResults cached;
+      cached.query_ = pending_search_queries_.value(id);
+      cached.results_ = it.value();
+      cached.age_.start();
+      data->running_results_.erase(it);
+
+      data->cached_results_.prepend(cached);
+      while (data->cached_results_.count() > kResultCacheSize) {
+        data->cached_results_.removeLast();
+      }
+    }
+  }
+
+  ProviderFinished(id, provider);
+}
+
+void GlobalSearch::ProviderFinished(int id, SearchProvider* provider) {
   if (!pending_search_providers_.contains(id)) return;
 
-  SearchProvider* provider = static_cast<SearchProvider*>(sender());
   const int remaining = --pending_search_providers_[id];
 
   emit ProviderSearchFinished(id, provider);
   if (remaining == 0) {
     emit SearchFinished(id);
     pending_search_providers_.remove(id);
+    pending_search_queries_.remove(id);
   }
 }
 
@@ -189,18 +406,41 @@ void GlobalSearch::ProviderDestroyedSlot(QObject* object) {
   providers_.remove(provider);
   emit ProviderRemoved(provider);
 
+  QList<CachedSearch>::iterator it = cached_searches_.begin();
+  while (it != cached_searches_.end()) {
+    if (it->provider_ == provider) {
+      it = cached_searches_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
   // We have to abort any pending searches since we can't tell whether they
   // were on this provider.
   for (int id : pending_search_providers_.keys()) {
     emit SearchFinished(id);
   }
   pending_search_providers_.clear();
+  pending_search_queries_.clear();
 }
 
 QList<SearchProvider*> GlobalSearch::providers() const {
   return providers_.keys();
 }
 
+qint64 GlobalSearch::memory_usage() const {
+  qint64 results = 0;
+  for (const ProviderData& data : providers_) {
+    for (const CachedResults& cached : data.cached_results_) {
+      results += cached.results_.count();
+    }
+    for (const SearchProvider::ResultList& running : data.running_results_) {
+      results += running.count();
+    }
+  }
+  return results * (sizeof(SearchProvider::Result) + Song::data_size());
+}
+
 int GlobalSearch::LoadArtAsync(const SearchProvider::Result& result) {
   const int id = next_id_++;
 
@@ -379,3 +619,15 @@ QStringList GlobalSearch::GetSuggestions(int count) {
   }
   return ret;
 }
+
+QString GlobalSearch::GetCorrection(const QString& query) {
+  for (SearchProvider* provider : providers_.keys()) {
+    if (is_provider_enabled(provider) && provider->can_give_corrections()) {
+      const QString correction = provider->GetCorrection(query);
+      if (!correction.isEmpty() && correction != query.toLower()) {
+        return correction;
+      }
+    }
+  }
+  return QString();
+}
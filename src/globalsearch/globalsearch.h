@@ -18,6 +18,7 @@
 #ifndef GLOBALSEARCH_H
 #define GLOBALSEARCH_H
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QPixmapCache>
 
@@ -37,6 +38,8 @@ class GlobalSearch : public QObject {
   static const int kDelayedSearchTimeoutMs;
   static const char* kSettingsGroup;
   static const int kMaxResultsPerEmission;
+  static const int kResultCacheSize;
+  static const int kResultCacheMaxAgeMs;
 
   Application* application() const { return app_; }
 
@@ -49,6 +52,15 @@ class GlobalSearch : public QObject {
   int LoadArtAsync(const SearchProvider::Result& result);
   MimeData* LoadTracks(const SearchProvider::ResultList& results);
   QStringList GetSuggestions(int count);
+  // The first correction any enabled provider has for the query, or an empty
+  // string.
+  QString GetCorrection(const QString& query);
+
+  // Asks the providers that page their results for the next page of a search
+  // that has finished.  The results come through ResultsAvailable and
+  // SearchFinished as before.  Returns false if no provider has anything more
+  // to fetch right now.
+  bool FetchMoreAsync(int id);
 
   void CancelSearch(int id);
   void CancelArt(int id);
@@ -58,6 +70,10 @@ class GlobalSearch : public QObject {
 
   // "enabled" is the user preference.  "usable" is enabled AND logged in.
   QList<SearchProvider*> providers() const;
+
+  // Roughly how many bytes the cached and running results take, not counting
+  // their strings.  Pixmaps are in QPixmapCache, which can't say.
+  qint64 memory_usage() const;
   bool is_provider_enabled(const SearchProvider* provider) const;
   bool is_provider_usable(SearchProvider* provider) const;
 
@@ -84,6 +100,7 @@ signals:
   void DoSearchAsync(int id, const QString& query);
   void ResultsAvailableSlot(int id, SearchProvider::ResultList results);
   void SearchFinishedSlot(int id);
+  void ServeCachedResults();
 
   void ArtLoadedSlot(int id, const QImage& image);
   void AlbumArtLoaded(quint64 id, const QImage& image);
@@ -92,6 +109,12 @@ signals:
 
  private:
   void ConnectProvider(SearchProvider* provider);
+  void EmitResults(int id, SearchProvider::ResultList results);
+  void ProviderFinished(int id, SearchProvider* provider);
+  bool StartCachedSearch(int id, const QString& query,
+                         SearchProvider* provider);
+  void AddMorePages(SearchProvider* provider, int id, const QString& query,
+                    bool fetching);
   void HandleLoadedArt(int id, const QImage& image, SearchProvider* provider);
   void TakeNextQueuedArt(SearchProvider* provider);
   QString PixmapCacheKey(const SearchProvider::Result& result) const;
@@ -110,9 +133,40 @@ signals:
     SearchProvider::Result result_;
   };
 
+  struct CachedResults {
+    QString query_;
+    SearchProvider::ResultList results_;
+    QElapsedTimer age_;
+  };
+
+  struct CachedSearch {
+    int id_;
+    SearchProvider* provider_;
+    SearchProvider::ResultList results_;
+  };
+
+  struct MorePages {
+    MorePages() : next_page_(1), fetching_(false), received_(0) {}
+
+    QString query_;
+    int next_page_;
+    bool fetching_;
+    // Results received for the page being fetched.  A page with nothing on
+    // it is the last.
+    int received_;
+  };
+
   struct ProviderData {
     QList<QueuedArt> queued_art_;
     bool enabled_;
+
+    // Searches that this provider might have more pages of results for.
+    QMap<int, MorePages> more_pages_;
+
+    // Results of this provider's recent searches, newest first.
+    QList<CachedResults> cached_results_;
+    // Results collected so far for searches that haven't finished yet.
+    QMap<int, SearchProvider::ResultList> running_results_;
   };
 
   Application* app_;
@@ -123,6 +177,11 @@ signals:
 
   int next_id_;
   QMap<int, int> pending_search_providers_;
+  QMap<int, QString> pending_search_queries_;
+
+  // Searches answered from cached_results_, emitted from the event loop so
+  // the caller of SearchAsync knows the ID first.
+  QList<CachedSearch> cached_searches_;
 
   QPixmapCache pixmap_cache_;
   QMap<int, QString> pending_art_searches_;
@@ -43,6 +43,10 @@ GlobalSearchModel::GlobalSearchModel(GlobalSearch* engine, QObject* parent)
 void GlobalSearchModel::AddResults(const SearchProvider::ResultList& results) {
   int sort_index = 0;
 
+  // The proxy and the view hear about one insertion per parent, instead of
+  // one per result, and the proxy sorts each lot of new rows once.
+  PendingRows pending;
+
   // Create a divider for this provider if we haven't seen it before.
   SearchProvider* provider = results.first().provider_;
 
@@ -60,7 +64,7 @@ void GlobalSearchModel::AddResults(const SearchProvider::ResultList& results) {
     divider->setData(true, LibraryModel::Role_IsDivider);
     divider->setData(sort_index, Role_ProviderIndex);
     divider->setFlags(Qt::ItemIsEnabled);
-    appendRow(divider);
+    AppendRow(invisibleRootItem(), divider, &pending);
 
     provider_sort_indices_[provider] = sort_index;
   } else {
@@ -75,7 +79,7 @@ void GlobalSearchModel::AddResults(const SearchProvider::ResultList& results) {
       ContainerKey key;
       key.provider_index_ = sort_index;
 
-      parent = BuildContainers(result.metadata_, parent, &key);
+      parent = BuildContainers(result.metadata_, parent, &key, &pending);
     }
 
     // Create the item
@@ -84,13 +88,19 @@ void GlobalSearchModel::AddResults(const SearchProvider::ResultList& results) {
     item->setData(QVariant::fromValue(result), Role_Result);
     item->setData(sort_index, Role_ProviderIndex);
 
-    parent->appendRow(item);
+    AppendRow(parent, item, &pending);
+  }
+
+  for (PendingRows::const_iterator it = pending.constBegin();
+       it != pending.constEnd(); ++it) {
+    it.key()->appendRows(it.value());
   }
 }
 
 QStandardItem* GlobalSearchModel::BuildContainers(const Song& s,
                                                   QStandardItem* parent,
                                                   ContainerKey* key,
+                                                  PendingRows* pending,
                                                   int level) {
   if (level >= 3) {
     return parent;
@@ -182,7 +192,7 @@ QStandardItem* GlobalSearchModel::BuildContainers(const Song& s,
 
   // Find a container for this level
   key->group_[level] = display_text + QString::number(unique_tag);
-  QStandardItem* container = containers_[*key];
+  QStandardItem* container = containers_.value(*key);
   if (!container) {
     container = new QStandardItem(display_text);
     container->setData(key->provider_index_, Role_ProviderIndex);
@@ -199,12 +209,22 @@ QStandardItem* GlobalSearchModel::BuildContainers(const Song& s,
       }
     }
 
-    parent->appendRow(container);
+    AppendRow(parent, container, pending);
     containers_[*key] = container;
   }
 
   // Create the container for the next level.
-  return BuildContainers(s, container, key, level + 1);
+  return BuildContainers(s, container, key, pending, level + 1);
+}
+
+void GlobalSearchModel::AppendRow(QStandardItem* parent, QStandardItem* row,
+                                  PendingRows* pending) {
+  // Items that aren't in the model yet don't notify anyone.
+  if (parent->model()) {
+    (*pending)[parent] << row;
+  } else {
+    parent->appendRow(row);
+  }
 }
 
 void GlobalSearchModel::Clear() {
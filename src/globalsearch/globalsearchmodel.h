@@ -21,6 +21,7 @@
 #include "searchprovider.h"
 #include "library/librarymodel.h"
 
+#include <QHash>
 #include <QStandardItemModel>
 
 class GlobalSearch;
@@ -66,8 +67,15 @@ class GlobalSearchModel : public QStandardItemModel {
   void AddResults(const SearchProvider::ResultList& results);
 
  private:
+  // New rows for parents that are already in the model, by parent.  They're
+  // appended together once the whole batch is built.
+  typedef QHash<QStandardItem*, QList<QStandardItem*>> PendingRows;
+
   QStandardItem* BuildContainers(const Song& metadata, QStandardItem* parent,
-                                 ContainerKey* key, int level = 0);
+                                 ContainerKey* key, PendingRows* pending,
+                                 int level = 0);
+  static void AppendRow(QStandardItem* parent, QStandardItem* row,
+                        PendingRows* pending);
   void GetChildResults(const QStandardItem* item,
                        SearchProvider::ResultList* results,
                        QSet<const QStandardItem*>* visited) const;
@@ -80,7 +88,7 @@ class GlobalSearchModel : public QStandardItemModel {
 
   QMap<SearchProvider*, int> provider_sort_indices_;
   int next_provider_sort_index_;
-  QMap<ContainerKey, QStandardItem*> containers_;
+  QHash<ContainerKey, QStandardItem*> containers_;
 
   QStringList provider_order_;
   bool use_pretty_covers_;
@@ -90,23 +98,20 @@ class GlobalSearchModel : public QStandardItemModel {
 };
 
 inline uint qHash(const GlobalSearchModel::ContainerKey& key) {
-  return qHash(key.provider_index_) ^ qHash(key.group_[0]) ^
-         qHash(key.group_[1]) ^ qHash(key.group_[2]);
+  // Not a plain xor, the same text is often at more than one level.
+  uint ret = qHash(key.provider_index_);
+  for (const QString& group : key.group_) {
+    ret = ret * 31 + qHash(group);
+  }
+  return ret;
 }
 
-inline bool operator<(const GlobalSearchModel::ContainerKey& left,
-                      const GlobalSearchModel::ContainerKey& right) {
-#define CMP(field)                           \
-  if (left.field < right.field) return true; \
-  if (left.field > right.field) return false
-
-  CMP(provider_index_);
-  CMP(group_[0]);
-  CMP(group_[1]);
-  CMP(group_[2]);
-  return false;
-
-#undef CMP
+inline bool operator==(const GlobalSearchModel::ContainerKey& left,
+                       const GlobalSearchModel::ContainerKey& right) {
+  return left.provider_index_ == right.provider_index_ &&
+         left.group_[0] == right.group_[0] &&
+         left.group_[1] == right.group_[1] &&
+         left.group_[2] == right.group_[2];
 }
 
 #endif  // GLOBALSEARCHMODEL_H
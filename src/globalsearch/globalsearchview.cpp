@@ -18,6 +18,7 @@
 #include "globalsearchview.h"
 
 #include <QMenu>
+#include <QScrollBar>
 #include <QSortFilterProxyModel>
 #include <QStandardItem>
 #include <QTimer>
@@ -41,6 +42,7 @@
 #include "library/librarymodel.h"
 #include "library/groupbydialog.h"
 #include "playlist/songmimedata.h"
+#include "widgets/didyoumean.h"
 
 using std::placeholders::_1;
 using std::placeholders::_2;
@@ -87,6 +89,8 @@ GlobalSearchView::GlobalSearchView(Application* app, QWidget* parent)
           SIGNAL(AddToPlaylist(QMimeData*)));
   connect(ui_->results, SIGNAL(FocusOnFilterSignal(QKeyEvent*)),
           SLOT(FocusOnFilter(QKeyEvent*)));
+  connect(ui_->results->verticalScrollBar(), SIGNAL(valueChanged(int)),
+          SLOT(FetchMoreIfScrolledToEnd()));
 
   // Set the appearance of the results list
   ui_->results->setItemDelegate(new GlobalSearchItemDelegate(this));
@@ -120,6 +124,10 @@ GlobalSearchView::GlobalSearchView(Application* app, QWidget* parent)
     suggestion_widgets_ << widget;
   }
 
+  did_you_mean_ = new DidYouMean(ui_->search, this);
+  connect(did_you_mean_, SIGNAL(Accepted(QString)),
+          SLOT(StartSearch(QString)));
+
   // Make it bold
   QFont help_font = ui_->help_text->font();
   help_font.setBold(true);
@@ -295,6 +303,14 @@ void GlobalSearchView::TextEdited(const QString& text) {
   } else {
     last_search_id_ = engine_->SearchAsync(trimmed);
   }
+
+  const QString correction =
+      trimmed.isEmpty() ? QString() : engine_->GetCorrection(trimmed);
+  if (correction.isEmpty()) {
+    did_you_mean_->hide();
+  } else {
+    did_you_mean_->Show(correction);
+  }
 }
 
 void GlobalSearchView::AddResults(int id,
@@ -304,6 +320,17 @@ void GlobalSearchView::AddResults(int id,
   current_model_->AddResults(results);
 }
 
+void GlobalSearchView::FetchMoreIfScrolledToEnd() {
+  if (last_search_id_ == -1) return;
+
+  // Start on the next page a little before the end, so it's usually there by
+  // the time the user gets to it.
+  const QScrollBar* bar = ui_->results->verticalScrollBar();
+  if (bar->maximum() - bar->value() > bar->pageStep() / 2) return;
+
+  engine_->FetchMoreAsync(last_search_id_);
+}
+
 void GlobalSearchView::SwapModels() {
   art_requests_.clear();
 
@@ -26,6 +26,7 @@
 #include <QWidget>
 
 class Application;
+class DidYouMean;
 class GlobalSearchModel;
 class GroupByDialog;
 class SearchProviderStatusWidget;
@@ -74,6 +75,7 @@ signals:
   void SwapModels();
   void TextEdited(const QString& text);
   void AddResults(int id, const SearchProvider::ResultList& results);
+  void FetchMoreIfScrolledToEnd();
   void ArtLoaded(int id, const QPixmap& pixmap);
 
   void FocusOnFilter(QKeyEvent* event);
@@ -125,6 +127,7 @@ signals:
 
   QList<SearchProviderStatusWidget*> provider_status_widgets_;
   QList<SuggestionWidget*> suggestion_widgets_;
+  DidYouMean* did_you_mean_;
 
   QIcon search_icon_;
   QIcon warning_icon_;
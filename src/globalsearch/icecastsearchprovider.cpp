@@ -16,27 +16,45 @@
 */
 
 #include "icecastsearchprovider.h"
-#include "internet/icecast/icecastbackend.h"
 #include "ui/iconloader.h"
 
+const int IcecastSearchProvider::kResultLimit = 4;
+
 IcecastSearchProvider::IcecastSearchProvider(IcecastBackend* backend,
                                              Application* app, QObject* parent)
-    : BlockingSearchProvider(app, parent), backend_(backend) {
+    : BlockingSearchProvider(app, parent),
+      backend_(backend),
+      stations_dirty_(true) {
   Init("Icecast", "icecast", IconLoader::Load("icon_radio", IconLoader::Lastfm),
        DisabledByDefault);
+
+  connect(backend_, SIGNAL(DatabaseReset()), SLOT(DatabaseReset()));
+}
+
+void IcecastSearchProvider::DatabaseReset() {
+  QMutexLocker l(&stations_mutex_);
+  stations_dirty_ = true;
 }
 
 SearchProvider::ResultList IcecastSearchProvider::Search(int id,
                                                          const QString& query) {
-  IcecastBackend::StationList stations = backend_->GetStations(query);
-  ResultList ret;
-
-  for (const IcecastBackend::Station& station : stations) {
-    if (ret.count() > 3) break;
+  Q_UNUSED(id)
+
+  QMutexLocker l(&stations_mutex_);
+  if (stations_dirty_) {
+    stations_ = backend_->GetStations();
+    index_.Clear();
+    for (int i = 0; i < stations_.count(); ++i) {
+      index_.Add(i, stations_[i].name + " " + stations_[i].genre);
+    }
+    stations_dirty_ = false;
+  }
 
+  ResultList ret;
+  for (int index : index_.Search(TokenizeQuery(query), kResultLimit)) {
     Result result(this);
     result.group_automatically_ = false;
-    result.metadata_ = station.ToSong();
+    result.metadata_ = stations_[index].ToSong();
     ret << result;
   }
 
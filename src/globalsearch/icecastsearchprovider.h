@@ -18,19 +18,35 @@
 #ifndef ICECASTSEARCHPROVIDER_H
 #define ICECASTSEARCHPROVIDER_H
 
-#include "searchprovider.h"
+#include <QMutex>
 
-class IcecastBackend;
+#include "searchindex.h"
+#include "searchprovider.h"
+#include "internet/icecast/icecastbackend.h"
 
 class IcecastSearchProvider : public BlockingSearchProvider {
+  Q_OBJECT
+
  public:
   IcecastSearchProvider(IcecastBackend* backend, Application* app,
                         QObject* parent);
 
+  static const int kResultLimit;
+
   ResultList Search(int id, const QString& query);
 
+ private slots:
+  void DatabaseReset();
+
  private:
   IcecastBackend* backend_;
+
+  // The directory is loaded from the database the first time it's searched,
+  // and again after it's been refreshed.
+  QMutex stations_mutex_;
+  IcecastBackend::StationList stations_;
+  SearchIndex index_;
+  bool stations_dirty_;
 };
 
 #endif  // ICECASTSEARCHPROVIDER_H
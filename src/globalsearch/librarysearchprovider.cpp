@@ -16,58 +16,149 @@
 */
 
 #include "librarysearchprovider.h"
+#include "core/application.h"
+#include "core/database.h"
 #include "core/logging.h"
+#include "core/threadpools.h"
 #include "covers/albumcoverloader.h"
 #include "library/librarybackend.h"
 #include "library/libraryquery.h"
 #include "library/sqlrow.h"
 #include "playlist/songmimedata.h"
 
+#include <QElapsedTimer>
 #include <QStack>
 
+#include <functional>
+
 LibrarySearchProvider::LibrarySearchProvider(LibraryBackendInterface* backend,
                                              const QString& name,
                                              const QString& id,
                                              const QIcon& icon,
                                              bool enabled_by_default,
                                              Application* app, QObject* parent)
-    : BlockingSearchProvider(app, parent), backend_(backend) {
-  Hints hints =
-      WantsSerialisedArtQueries | ArtIsInSongMetadata | CanGiveSuggestions;
+    : BlockingSearchProvider(app, parent),
+      backend_(backend),
+      spelling_state_(Spelling_NotBuilt),
+      spelling_generation_(0) {
+  Hints hints = WantsSerialisedArtQueries | ArtIsInSongMetadata |
+                CanGiveSuggestions | CanGiveCorrections | CanRefineResults;
 
   if (!enabled_by_default) {
     hints |= DisabledByDefault;
   }
 
   Init(name, id, icon, hints);
+
+  connect(backend_, SIGNAL(SongsDiscovered(SongList)),
+          SLOT(SongsDiscovered(SongList)), Qt::DirectConnection);
+  connect(backend_, SIGNAL(SongsDeleted(SongList)),
+          SLOT(SongsDeleted(SongList)), Qt::DirectConnection);
+  connect(backend_, SIGNAL(DatabaseReset()), SLOT(DatabaseReset()),
+          Qt::DirectConnection);
+}
+
+void LibrarySearchProvider::SearchAsync(int id, const QString& query) {
+  {
+    QMutexLocker l(&cancel_flags_mutex_);
+    cancel_flags_[id] = QueryCancelFlag(new QAtomicInt(0));
+  }
+  BlockingSearchProvider::SearchAsync(id, query);
 }
 
 SearchProvider::ResultList LibrarySearchProvider::Search(int id,
                                                          const QString& query) {
-  QueryOptions options;
-  options.set_filter(query);
-
-  LibraryQuery q(options);
-  q.SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
-
-  if (!backend_->ExecQuery(&q)) {
-    return ResultList();
+  QueryCancelFlag cancel;
+  {
+    QMutexLocker l(&cancel_flags_mutex_);
+    cancel = cancel_flags_.value(id);
   }
 
-  // Build the result list
   ResultList ret;
-  while (q.Next()) {
-    Result result(this);
-    result.metadata_.InitFromQuery(q, true);
-    ret << result;
+
+  // It might have been cancelled while it was waiting for a thread.
+  if (!SqliteCancelScope::IsCancelled(cancel)) {
+    QueryOptions options;
+    options.set_filter(query);
+
+    LibraryQuery q(options);
+    q.SetColumnSpec("%songs_table.ROWID, " +
+                    Song::ColumnSpec(Song::Projection_SearchResult));
+    q.SetOrderByRelevance(true);
+    q.SetCancelFlag(cancel);
+
+    Database::ReadLocker l(app_->database(),
+                           Database::DatabaseForTable(backend_->songs_table()));
+    if (backend_->ExecReadOnlyQuery(&q)) {
+      // Build the result list
+      while (q.Next()) {
+        Result result(this);
+        result.metadata_.InitFromQuery(q, Song::Projection_SearchResult);
+        ret << result;
+      }
+    }
   }
 
+  QMutexLocker l(&cancel_flags_mutex_);
+  cancel_flags_.remove(id);
   return ret;
 }
 
+void LibrarySearchProvider::CancelSearch(int id) {
+  // GlobalSearch ignores whatever a cancelled search returns, so the query
+  // can stop as soon as it likes.
+  QMutexLocker l(&cancel_flags_mutex_);
+  if (cancel_flags_.contains(id)) cancel_flags_[id]->fetchAndStoreRelaxed(1);
+}
+
+namespace {
+
+// Like the FTS tokenizer, matches tokens against the start of words.
+bool ContainsWordPrefix(const QString& text, const QString& token) {
+  for (int pos = text.indexOf(token, 0, Qt::CaseInsensitive); pos != -1;
+       pos = text.indexOf(token, pos + 1, Qt::CaseInsensitive)) {
+    if (pos == 0 || !text[pos - 1].isLetterOrNumber()) return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+bool LibrarySearchProvider::ResultMatches(const Result& result,
+                                          const QStringList& tokens) const {
+  // The same fields as Song::kFtsColumns.
+  const Song& song = result.metadata_;
+  const QStringList fields = QStringList()
+      << song.title() << song.album() << song.artist() << song.albumartist()
+      << song.composer() << song.performer() << song.grouping()
+      << song.genre() << song.comment()
+      << (song.year() > 0 ? QString::number(song.year()) : QString());
+
+  for (const QString& token : tokens) {
+    bool matched = false;
+    for (const QString& field : fields) {
+      if (ContainsWordPrefix(field, token)) {
+        matched = true;
+        break;
+      }
+    }
+    if (!matched) return false;
+  }
+  return true;
+}
+
 MimeData* LibrarySearchProvider::LoadTracks(const ResultList& results) {
   MimeData* ret = SearchProvider::LoadTracks(results);
-  static_cast<SongMimeData*>(ret)->backend = backend_;
+  SongMimeData* data = static_cast<SongMimeData*>(ret);
+  data->backend = backend_;
+
+  // The results only have what the search shows, so the rest of each song is
+  // loaded when they're added to a playlist.
+  LibraryBackendInterface* backend = backend_;
+  const SongList songs = data->songs;
+  data->song_loader = [backend, songs]() {
+    return backend->GetFullSongs(songs);
+  };
 
   return ret;
 }
@@ -119,3 +210,106 @@ QStringList LibrarySearchProvider::GetSuggestions(int count) {
 
   return ret;
 }
+
+QString LibrarySearchProvider::GetCorrection(const QString& query) {
+  QMutexLocker l(&spelling_mutex_);
+
+  switch (spelling_state_) {
+    case Spelling_NotBuilt:
+      spelling_state_ = Spelling_Building;
+      ThreadPools::Run<void>(
+          ThreadPools::Pool_Background,
+          std::bind(&LibrarySearchProvider::BuildSpellingIndex, this,
+                    spelling_generation_));
+      return QString();
+
+    case Spelling_Building:
+      return QString();
+
+    case Spelling_Ready:
+      return spelling_.Correct(query);
+  }
+  return QString();
+}
+
+void LibrarySearchProvider::BuildSpellingIndex(int generation) {
+  QElapsedTimer timer;
+  timer.start();
+
+  SpellingIndex index;
+
+  // The same as SpellingIndex::SongFields.
+  const QStringList columns = QStringList() << "artist"
+                                            << "albumartist"
+                                            << "album"
+                                            << "title"
+                                            << "composer"
+                                            << "performer"
+                                            << "genre";
+
+  LibraryQuery q;
+  q.SetColumnSpec(columns.join(", "));
+  {
+    Database::ReadLocker l(app_->database(),
+                           Database::DatabaseForTable(backend_->songs_table()));
+    if (backend_->ExecReadOnlyQuery(&q)) {
+      while (q.Next()) {
+        for (int i = 0; i < columns.count(); ++i) {
+          index.AddWords(SpellingIndex::Words(q.Value(i).toString()));
+        }
+      }
+    }
+  }
+
+  QMutexLocker l(&spelling_mutex_);
+  if (generation != spelling_generation_) return;
+
+  index.AddSongs(spelling_added_);
+  index.RemoveSongs(spelling_deleted_);
+  spelling_added_.clear();
+  spelling_deleted_.clear();
+
+  spelling_ = index;
+  spelling_state_ = Spelling_Ready;
+
+  qLog(Debug) << "Built spelling index of" << spelling_.count() << "words for"
+              << name() << "in" << timer.elapsed() << "ms";
+}
+
+void LibrarySearchProvider::SongsDiscovered(const SongList& songs) {
+  QMutexLocker l(&spelling_mutex_);
+  switch (spelling_state_) {
+    case Spelling_NotBuilt:
+      break;
+    case Spelling_Building:
+      spelling_added_ << songs;
+      break;
+    case Spelling_Ready:
+      spelling_.AddSongs(songs);
+      break;
+  }
+}
+
+void LibrarySearchProvider::SongsDeleted(const SongList& songs) {
+  QMutexLocker l(&spelling_mutex_);
+  switch (spelling_state_) {
+    case Spelling_NotBuilt:
+      break;
+    case Spelling_Building:
+      spelling_deleted_ << songs;
+      break;
+    case Spelling_Ready:
+      spelling_.RemoveSongs(songs);
+      break;
+  }
+}
+
+void LibrarySearchProvider::DatabaseReset() {
+  // The index is built again the next time a correction is asked for.
+  QMutexLocker l(&spelling_mutex_);
+  spelling_.Clear();
+  spelling_state_ = Spelling_NotBuilt;
+  spelling_generation_++;
+  spelling_added_.clear();
+  spelling_deleted_.clear();
+}
@@ -18,23 +18,69 @@
 #ifndef LIBRARYSEARCHPROVIDER_H
 #define LIBRARYSEARCHPROVIDER_H
 
+#include <QMap>
+#include <QMutex>
+
 #include "searchprovider.h"
+#include "core/song.h"
+#include "library/spellingindex.h"
+#include "library/sqlitequery.h"
 
 class LibraryBackendInterface;
 
 class LibrarySearchProvider : public BlockingSearchProvider {
+  Q_OBJECT
+
  public:
   LibrarySearchProvider(LibraryBackendInterface* backend, const QString& name,
                         const QString& id, const QIcon& icon,
                         bool enabled_by_default, Application* app,
                         QObject* parent = nullptr);
 
+  void SearchAsync(int id, const QString& query);
   ResultList Search(int id, const QString& query);
+  void CancelSearch(int id);
+  bool ResultMatches(const Result& result, const QStringList& tokens) const;
   MimeData* LoadTracks(const ResultList& results);
   QStringList GetSuggestions(int count);
 
+  // The spelling index is built in the background the first time this is
+  // called, and returns nothing until then.
+  QString GetCorrection(const QString& query);
+
+ private slots:
+  // Called directly from the backend's thread.
+  void SongsDiscovered(const SongList& songs);
+  void SongsDeleted(const SongList& songs);
+  void DatabaseReset();
+
+ private:
+  enum SpellingState {
+    Spelling_NotBuilt,
+    Spelling_Building,
+    Spelling_Ready
+  };
+
+  void BuildSpellingIndex(int generation);
+
  private:
   LibraryBackendInterface* backend_;
+
+  // One for each search from SearchAsync until its query has finished, so
+  // CancelSearch can stop the query while it's running on the worker thread.
+  QMutex cancel_flags_mutex_;
+  QMap<int, QueryCancelFlag> cancel_flags_;
+
+  QMutex spelling_mutex_;
+  SpellingIndex spelling_;
+  SpellingState spelling_state_;
+  // Bumped when the database is reset, so a build that started before then
+  // is thrown away.
+  int spelling_generation_;
+  // Changes to the library while the index is being built, which are applied
+  // to it afterwards.
+  SongList spelling_added_;
+  SongList spelling_deleted_;
 };
 
 #endif  // LIBRARYSEARCHPROVIDER_H
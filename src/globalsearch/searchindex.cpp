@@ -0,0 +1,160 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "searchindex.h"
+
+#include <algorithm>
+#include <iterator>
+
+#include <QPair>
+#include <QRegExp>
+
+const int SearchIndex::kGramLength = 3;
+
+namespace {
+
+bool IsWordBoundary(const QString& text, int pos) {
+  return pos <= 0 || pos >= text.length() || text[pos].isSpace() ||
+         text[pos - 1].isSpace();
+}
+
+}  // namespace
+
+SearchIndex::SearchIndex() {}
+
+void SearchIndex::Clear() {
+  grams_.clear();
+  ids_.clear();
+  texts_.clear();
+}
+
+void SearchIndex::Add(int id, const QString& text) {
+  const int index = texts_.count();
+  const QString lower = text.toLower();
+  ids_ << id;
+  texts_ << lower;
+
+  for (const QString& word :
+       lower.split(QRegExp("\\s+"), QString::SkipEmptyParts)) {
+    for (int start = 0; start < word.length(); ++start) {
+      const int max_length = qMin(kGramLength, word.length() - start);
+      for (int length = 1; length <= max_length; ++length) {
+        PostingList& list = grams_[word.mid(start, length)];
+        if (list.isEmpty() || list.last() != index) list << index;
+      }
+    }
+  }
+}
+
+void SearchIndex::Intersect(const PostingList& other, PostingList* list) {
+  PostingList ret;
+  ret.reserve(qMin(list->count(), other.count()));
+  std::set_intersection(list->constBegin(), list->constEnd(),
+                        other.constBegin(), other.constEnd(),
+                        std::back_inserter(ret));
+  *list = ret;
+}
+
+SearchIndex::PostingList SearchIndex::Candidates(const QString& token) const {
+  if (token.length() <= kGramLength) return grams_.value(token);
+
+  // Every gram of the token must be in the document.  Start with the shortest
+  // list so the intersection shrinks as quickly as possible.
+  QList<const PostingList*> lists;
+  for (int start = 0; start + kGramLength <= token.length(); ++start) {
+    QHash<QString, PostingList>::const_iterator it =
+        grams_.constFind(token.mid(start, kGramLength));
+    if (it == grams_.constEnd()) return PostingList();
+    lists << &it.value();
+  }
+  std::sort(lists.begin(), lists.end(),
+            [](const PostingList* a, const PostingList* b) {
+    return a->count() < b->count();
+  });
+
+  PostingList ret = *lists.first();
+  for (int i = 1; i < lists.count() && !ret.isEmpty(); ++i) {
+    Intersect(*lists[i], &ret);
+  }
+  return ret;
+}
+
+int SearchIndex::Score(int index, const QStringList& tokens) const {
+  const QString& text = texts_[index];
+  int score = 0;
+
+  for (const QString& token : tokens) {
+    int best = 0;
+    for (int pos = text.indexOf(token); pos != -1 && best < 2;
+         pos = text.indexOf(token, pos + 1)) {
+      if (!IsWordBoundary(text, pos)) continue;
+      best = IsWordBoundary(text, pos + token.length()) ? 2 : 1;
+    }
+    score += best;
+  }
+
+  return score;
+}
+
+QList<int> SearchIndex::Search(const QStringList& tokens, int limit) const {
+  QStringList lower_tokens;
+  for (const QString& token : tokens) {
+    if (!token.isEmpty()) lower_tokens << token.toLower();
+  }
+
+  QList<int> ret;
+  if (lower_tokens.isEmpty()) {
+    for (int i = 0; i < ids_.count() && ret.count() != limit; ++i) {
+      ret << ids_[i];
+    }
+    return ret;
+  }
+
+  // Look up the longest token first, it usually has the fewest candidates.
+  std::sort(lower_tokens.begin(), lower_tokens.end(),
+            [](const QString& a, const QString& b) {
+    return a.length() > b.length();
+  });
+
+  PostingList candidates = Candidates(lower_tokens.first());
+  for (int i = 1; i < lower_tokens.count() && !candidates.isEmpty(); ++i) {
+    Intersect(Candidates(lower_tokens[i]), &candidates);
+  }
+
+  // The grams only narrow the candidates down, tokens longer than a gram
+  // still have to be checked against the text.
+  QList<QPair<int, int>> matches;
+  for (int index : candidates) {
+    bool matched = true;
+    for (const QString& token : lower_tokens) {
+      if (!texts_[index].contains(token)) {
+        matched = false;
+        break;
+      }
+    }
+    if (matched) matches << qMakePair(-Score(index, lower_tokens), index);
+  }
+
+  // Highest score first, then the order the documents were added.
+  std::sort(matches.begin(), matches.end());
+
+  for (const QPair<int, int>& match : matches) {
+    if (ret.count() == limit) break;
+    ret << ids_[match.second];
+  }
+  return ret;
+}
@@ -0,0 +1,65 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QVector>
+
+class SearchIndex {
+  // Answers "which documents contain all of these query tokens" without
+  // scanning every document.  Each whitespace separated word of a document is
+  // broken into all of its substrings of up to kGramLength characters, and
+  // every such gram maps to the sorted list of documents containing it.  A
+  // query token is looked up by intersecting the lists of its grams, and the
+  // few remaining candidates are checked with a plain substring match.
+
+ public:
+  SearchIndex();
+
+  static const int kGramLength;
+
+  void Clear();
+  void Add(int id, const QString& text);
+  int count() const { return texts_.count(); }
+
+  // Returns the ids of documents that contain every token, case
+  // insensitively.  Documents where tokens match whole words or the start of
+  // words come first, otherwise documents are returned in the order they were
+  // added.  At most limit ids are returned, or all of them if limit is -1.
+  QList<int> Search(const QStringList& tokens, int limit = -1) const;
+
+ private:
+  typedef QVector<int> PostingList;
+
+  static void Intersect(const PostingList& other, PostingList* list);
+  PostingList Candidates(const QString& token) const;
+  int Score(int index, const QStringList& tokens) const;
+
+ private:
+  // Posting lists hold positions in ids_ and texts_, so they are always
+  // sorted.
+  QHash<QString, PostingList> grams_;
+  QVector<int> ids_;
+  // Lowercase text of each document.
+  QVector<QString> texts_;
+};
+
+#endif  // SEARCHINDEX_H
@@ -19,9 +19,9 @@
 
 #include <QPainter>
 #include <QUrl>
-#include <QtConcurrentRun>
 
 #include "core/closure.h"
+#include "core/threadpools.h"
 #include "internet/core/internetsongmimedata.h"
 #include "playlist/songmimedata.h"
 
@@ -80,7 +80,9 @@ BlockingSearchProvider::BlockingSearchProvider(Application* app,
 
 void BlockingSearchProvider::SearchAsync(int id, const QString& query) {
   QFuture<ResultList> future =
-      QtConcurrent::run(this, &BlockingSearchProvider::Search, id, query);
+      ThreadPools::Run<ResultList>(
+          ThreadPools::Pool_Interactive,
+          std::bind(&BlockingSearchProvider::Search, this, id, query));
   NewClosure(future, this,
              SLOT(BlockingSearchFinished(QFuture<ResultList>, int)), future,
              id);
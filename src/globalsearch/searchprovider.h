@@ -98,7 +98,20 @@ class SearchProvider : public QObject {
     // SongMimeData containing the entire metadata for each result being loaded.
     // Setting this flag will cause a plain MimeData to be created containing
     // only the URLs of the results.
-    MimeDataContainsUrlsOnly = 0x80
+    MimeDataContainsUrlsOnly = 0x80,
+
+    // Indicates that a search returns every item that matches the query, and
+    // that anything matching a query also matches all the shorter queries it
+    // extends.  The results for "radiohead" can then be found by passing the
+    // results for "radio" through ResultMatches instead of searching again.
+    CanRefineResults = 0x100,
+
+    // Indicates that a search only returns the first page of results, and
+    // FetchMoreAsync can be called to get the pages after it.
+    CanFetchMoreResults = 0x200,
+
+    // This provider can suggest a correction for a misspelled query.
+    CanGiveCorrections = 0x400
   };
   Q_DECLARE_FLAGS(Hints, Hint)
 
@@ -121,11 +134,36 @@ class SearchProvider : public QObject {
   bool mime_data_contains_urls_only() const {
     return hints() & MimeDataContainsUrlsOnly;
   }
+  bool can_refine_results() const { return hints() & CanRefineResults; }
+  bool can_fetch_more_results() const {
+    return hints() & CanFetchMoreResults;
+  }
+  bool can_give_corrections() const { return hints() & CanGiveCorrections; }
 
   // Starts a search.  Must emit ResultsAvailable zero or more times and then
   // SearchFinished exactly once, using this ID.
   virtual void SearchAsync(int id, const QString& query) = 0;
 
+  // Stops a search that is no longer needed, if the provider can.  It must
+  // still emit SearchFinished for this ID, but should do so without waiting
+  // for any outstanding network requests.
+  virtual void CancelSearch(int id) {}
+
+  // Starts fetching another page of results for a search that has finished.
+  // The first page, from SearchAsync, is page 0.  Like SearchAsync it must
+  // emit ResultsAvailable zero or more times and then SearchFinished exactly
+  // once, using this ID.  Only called for providers that set the
+  // CanFetchMoreResults hint.
+  virtual void FetchMoreAsync(int id, const QString& query, int page) {}
+
+  // Returns true if a result from an earlier search would also have been
+  // returned for a query with these tokens.  Only called for providers that
+  // set the CanRefineResults hint.
+  virtual bool ResultMatches(const Result& result,
+                             const QStringList& tokens) const {
+    return false;
+  }
+
   // Starts loading an icon for a result that was previously emitted by
   // ResultsAvailable.  Must emit ArtLoaded exactly once with this ID.
   virtual void LoadArtAsync(int id, const Result& result);
@@ -140,6 +178,11 @@ class SearchProvider : public QObject {
   // strings.  Remember to set the CanGiveSuggestions hint.
   virtual QStringList GetSuggestions(int count) { return QStringList(); }
 
+  // Returns the query with its misspelled words corrected, or an empty string
+  // if it looks fine.  Called from the GUI thread as the user types, so it
+  // has to be quick.  Remember to set the CanGiveCorrections hint.
+  virtual QString GetCorrection(const QString& query) { return QString(); }
+
   // If provider needs user login to search and play songs, this method should
   // be reimplemented
   virtual bool IsLoggedIn() { return true; }
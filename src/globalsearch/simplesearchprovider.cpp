@@ -57,29 +57,19 @@ SearchProvider::ResultList SimpleSearchProvider::Search(int id,
 
   has_searched_before_ = true;
 
-  ResultList ret;
-  const QStringList tokens = TokenizeQuery(query);
+  // Safe words match every item, so they don't need to be looked up.
+  QStringList tokens;
+  for (const QString& token : TokenizeQuery(query)) {
+    if (!safe_words_.contains(token, Qt::CaseInsensitive)) tokens << token;
+  }
 
+  ResultList ret;
   QMutexLocker l(&items_mutex_);
-  for (const Item& item : items_) {
-    bool matched = true;
-    for (const QString& token : tokens) {
-      if (!item.keyword_.contains(token, Qt::CaseInsensitive) &&
-          !item.metadata_.title().contains(token, Qt::CaseInsensitive) &&
-          !safe_words_.contains(token, Qt::CaseInsensitive)) {
-        matched = false;
-        break;
-      }
-    }
-
-    if (matched) {
-      Result result(this);
-      result.group_automatically_ = false;
-      result.metadata_ = item.metadata_;
-      ret << result;
-    }
-
-    if (ret.count() >= result_limit_) break;
+  for (int index : index_.Search(tokens, result_limit_)) {
+    Result result(this);
+    result.group_automatically_ = false;
+    result.metadata_ = items_[index].metadata_;
+    ret << result;
   }
 
   return ret;
@@ -88,8 +78,11 @@ SearchProvider::ResultList SimpleSearchProvider::Search(int id,
 void SimpleSearchProvider::SetItems(const ItemList& items) {
   QMutexLocker l(&items_mutex_);
   items_ = items;
-  for (ItemList::iterator it = items_.begin(); it != items_.end(); ++it) {
-    it->metadata_.set_filetype(Song::Type_Stream);
+  index_.Clear();
+  for (int i = 0; i < items_.count(); ++i) {
+    Item& item = items_[i];
+    item.metadata_.set_filetype(Song::Type_Stream);
+    index_.Add(i, item.keyword_ + " " + item.metadata_.title());
   }
 }
 
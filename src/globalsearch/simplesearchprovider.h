@@ -18,6 +18,7 @@
 #ifndef SIMPLESEARCHPROVIDER_H
 #define SIMPLESEARCHPROVIDER_H
 
+#include "searchindex.h"
 #include "searchprovider.h"
 
 class SimpleSearchProvider : public BlockingSearchProvider {
@@ -73,6 +74,8 @@ class SimpleSearchProvider : public BlockingSearchProvider {
 
   QMutex items_mutex_;
   ItemList items_;
+  // Keywords and titles of items_, rebuilt by SetItems.
+  SearchIndex index_;
 
   bool items_dirty_;
   bool has_searched_before_;
@@ -34,7 +34,7 @@ void SoundCloudSearchProvider::Init(SoundCloudService* service) {
   SearchProvider::Init(
       "SoundCloud", "soundcloud", IconLoader::Load("soundcloud", 
       IconLoader::Provider), WantsDelayedQueries | ArtIsProbablyRemote | 
-      CanShowConfig);
+      CanShowConfig | CanFetchMoreResults);
 
   connect(service_, SIGNAL(SimpleSearchResults(int, SongList)),
           SLOT(SearchDone(int, SongList)));
@@ -48,9 +48,25 @@ void SoundCloudSearchProvider::Init(SoundCloudService* service) {
 }
 
 void SoundCloudSearchProvider::SearchAsync(int id, const QString& query) {
-  const int service_id = service_->SimpleSearch(query);
+  FetchMoreAsync(id, query, 0);
+}
+
+void SoundCloudSearchProvider::FetchMoreAsync(int id, const QString& query,
+                                              int page) {
+  const int service_id = service_->SimpleSearch(query, page);
   pending_searches_[service_id] = PendingState(id, TokenizeQuery(query));
-  ;
+}
+
+void SoundCloudSearchProvider::CancelSearch(int id) {
+  const QList<int> service_ids =
+      pending_searches_.keys(PendingState(id, QStringList()));
+  if (service_ids.isEmpty()) return;
+
+  for (int service_id : service_ids) {
+    service_->CancelSimpleSearch(service_id);
+    pending_searches_.remove(service_id);
+  }
+  emit SearchFinished(id);
 }
 
 void SoundCloudSearchProvider::SearchDone(int id, const SongList& songs) {
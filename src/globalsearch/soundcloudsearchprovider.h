@@ -33,6 +33,8 @@ class SoundCloudSearchProvider : public SearchProvider {
 
   // SearchProvider
   void SearchAsync(int id, const QString& query);
+  void FetchMoreAsync(int id, const QString& query, int page);
+  void CancelSearch(int id);
   void LoadArtAsync(int id, const Result& result);
   InternetService* internet_service() { return service_; }
 
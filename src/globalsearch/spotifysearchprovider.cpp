@@ -35,7 +35,7 @@ SpotifySearchProvider::SpotifySearchProvider(Application* app, QObject* parent)
     : SearchProvider(app, parent), server_(nullptr), service_(nullptr) {
   Init("Spotify", "spotify", IconLoader::Load("spotify", IconLoader::Provider),
        WantsDelayedQueries | WantsSerialisedArtQueries | ArtIsProbablyRemote |
-           CanShowConfig | CanGiveSuggestions);
+           CanShowConfig | CanGiveSuggestions | CanFetchMoreResults);
 }
 
 SpotifyServer* SpotifySearchProvider::server() {
@@ -66,6 +66,11 @@ SpotifyServer* SpotifySearchProvider::server() {
 void SpotifySearchProvider::ServerDestroyed() { server_ = nullptr; }
 
 void SpotifySearchProvider::SearchAsync(int id, const QString& query) {
+  FetchMoreAsync(id, query, 0);
+}
+
+void SpotifySearchProvider::FetchMoreAsync(int id, const QString& query,
+                                           int page) {
   SpotifyServer* s = server();
   if (!s) {
     emit SearchFinished(id);
@@ -77,14 +82,24 @@ void SpotifySearchProvider::SearchAsync(int id, const QString& query) {
   state.tokens_ = TokenizeQuery(query);
 
   const QString query_string = state.tokens_.join(" ");
-  s->Search(query_string, kSearchSongLimit, kSearchAlbumLimit);
-  queries_[query_string] = state;
+  const int offset = page * kSearchSongLimit;
+  const int offset_album = page * kSearchAlbumLimit;
+  s->Search(query_string, kSearchSongLimit, kSearchAlbumLimit, offset,
+            offset_album);
+  queries_[QueryKey(query_string, offset)] = state;
+}
+
+QString SpotifySearchProvider::QueryKey(const QString& query, int offset) {
+  return QString::number(offset) + " " + query;
 }
 
 void SpotifySearchProvider::SearchFinishedSlot(
     const pb::spotify::SearchResponse& response) {
-  QString query_string = QString::fromUtf8(response.request().query().c_str());
-  QMap<QString, PendingState>::iterator it = queries_.find(query_string);
+  const QString query_string =
+      QString::fromUtf8(response.request().query().c_str());
+  const int offset_album = response.request().offset_album();
+  QMap<QString, PendingState>::iterator it =
+      queries_.find(QueryKey(query_string, response.request().offset()));
   if (it == queries_.end()) return;
 
   PendingState state = it.value();
@@ -144,8 +159,8 @@ void SpotifySearchProvider::SearchFinishedSlot(
       Result result(this);
       SpotifyService::SongFromProtobuf(album.track(j), &result.metadata_);
 
-      // Just use the album index as an id.
-      result.metadata_.set_album_id(i);
+      // Just use the album index as an id.  Later pages carry on counting.
+      result.metadata_.set_album_id(offset_album + i);
       result.metadata_.set_albumartist(majority_artist);
 
       ret << result;
@@ -31,6 +31,7 @@ class SpotifySearchProvider : public SearchProvider {
   SpotifySearchProvider(Application* app, QObject* parent = nullptr);
 
   void SearchAsync(int id, const QString& query) override;
+  void FetchMoreAsync(int id, const QString& query, int page) override;
   void LoadArtAsync(int id, const Result& result) override;
   QStringList GetSuggestions(int count) override;
 
@@ -48,6 +49,8 @@ class SpotifySearchProvider : public SearchProvider {
 
  private:
   SpotifyServer* server();
+  // Searches for the same query are told apart by where they start.
+  static QString QueryKey(const QString& query, int offset);
 
   void LoadSuggestions();
   void AddSuggestionFromTrack(const pb::spotify::Track& track);
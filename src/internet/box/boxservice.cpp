@@ -102,6 +102,8 @@ void BoxService::ConnectFinished(OAuthenticator* oauth) {
   access_token_ = oauth->access_token();
   expiry_time_ = oauth->expiry_time();
 
+  ResumeIndexing(QString("Bearer %1").arg(access_token_));
+
   if (s.value("name").toString().isEmpty()) {
     QUrl url(kUserInfo);
     QNetworkRequest request(url);
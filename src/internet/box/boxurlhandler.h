@@ -33,6 +33,7 @@ class BoxUrlHandler : public UrlHandler {
   QString scheme() const { return "box"; }
   QIcon icon() const { return IconLoader::Load("box", IconLoader::Provider); }
   LoadResult StartLoading(const QUrl& url);
+  bool CanResolveAhead() const { return true; }
 
  private:
   BoxService* service_;
@@ -22,6 +22,8 @@
 
 #include <QMenu>
 #include <QSortFilterProxyModel>
+#include <QSqlQuery>
+#include <QTimer>
 
 #include "core/application.h"
 #include "core/database.h"
@@ -37,6 +39,9 @@
 #include "playlist/playlist.h"
 #include "ui/iconloader.h"
 
+const int CloudFileService::kMaxConcurrentReads = 4;
+const int CloudFileService::kReadIntervalMsec = 100;
+
 CloudFileService::CloudFileService(Application* app, InternetModel* parent,
                                    const QString& service_name,
                                    const QString& service_id, const QIcon& icon,
@@ -49,9 +54,16 @@ CloudFileService::CloudFileService(Application* app, InternetModel* parent,
       task_manager_(app->task_manager()),
       icon_(icon),
       settings_page_(settings_page),
+      service_id_(service_id),
       indexing_task_id_(-1),
       indexing_task_progress_(0),
-      indexing_task_max_(0) {
+      indexing_task_max_(0),
+      read_timer_(new QTimer(this)),
+      resumed_indexing_(false) {
+  read_timer_->setSingleShot(true);
+  read_timer_->setInterval(kReadIntervalMsec);
+  connect(read_timer_, SIGNAL(timeout()), SLOT(StartQueuedReads()));
+
   library_backend_ = new LibraryBackend;
   library_backend_->moveToThread(app_->database()->thread());
 
@@ -149,7 +161,21 @@ void CloudFileService::MaybeAddFileToDatabase(const Song& metadata,
   if (!ShouldIndexFile(metadata.url(), mime_type)) {
     return;
   }
+  if (queued_urls_.contains(metadata.url())) {
+    return;
+  }
 
+  QueuedFile file;
+  file.metadata = metadata;
+  file.mime_type = mime_type;
+  file.download_url = download_url;
+  file.authorisation = authorisation;
+
+  SaveQueuedFile(file);
+  QueueFile(file);
+}
+
+void CloudFileService::QueueFile(const QueuedFile& file) {
   if (indexing_task_id_ == -1) {
     indexing_task_id_ = task_manager_->StartTask(tr("Indexing %1").arg(name()));
     indexing_task_progress_ = 0;
@@ -159,14 +185,133 @@ void CloudFileService::MaybeAddFileToDatabase(const Song& metadata,
   task_manager_->SetTaskProgress(indexing_task_id_, indexing_task_progress_,
                                  indexing_task_max_);
 
+  indexing_queue_.enqueue(file);
+  queued_urls_.insert(file.metadata.url());
+  StartQueuedReads();
+}
+
+void CloudFileService::StartQueuedReads() {
+  // Start at most one read per interval, and never more than a few at once,
+  // so a large library doesn't flood the service's API.
+  if (read_timer_->isActive() || indexing_queue_.isEmpty() ||
+      pending_tagreader_replies_.count() >= kMaxConcurrentReads) {
+    return;
+  }
+
+  const QueuedFile file = indexing_queue_.dequeue();
   TagReaderClient::ReplyType* reply = app_->tag_reader_client()->ReadCloudFile(
-      download_url, metadata.title(), metadata.filesize(), mime_type,
-      authorisation);
+      file.download_url, file.metadata.title(), file.metadata.filesize(),
+      file.mime_type, file.authorisation);
   pending_tagreader_replies_.append(reply);
 
   NewClosure(reply, SIGNAL(Finished(bool)), this,
              SLOT(ReadTagsFinished(TagReaderClient::ReplyType*, Song)), reply,
-             metadata);
+             file.metadata);
+
+  read_timer_->start();
+}
+
+void CloudFileService::ResumeIndexing(const QString& authorisation) {
+  if (resumed_indexing_) {
+    return;
+  }
+  resumed_indexing_ = true;
+
+  for (QueuedFile file : LoadQueuedFiles()) {
+    if (queued_urls_.contains(file.metadata.url())) {
+      continue;
+    }
+    if (!file.authorisation.isEmpty()) {
+      file.authorisation = authorisation;
+    }
+    qLog(Debug) << "Resuming indexing of" << file.metadata.url();
+    QueueFile(file);
+  }
+}
+
+void CloudFileService::SaveQueuedFile(const QueuedFile& file) {
+  pb::tagreader::SongMetadata metadata_pb;
+  file.metadata.ToProtobuf(&metadata_pb);
+  const std::string metadata = metadata_pb.SerializeAsString();
+
+  Database* db = app_->database();
+  QMutexLocker l(db->Mutex());
+  QSqlDatabase conn(db->Connect());
+
+  QSqlQuery q = db->PreparedQuery(
+      "INSERT OR REPLACE INTO cloud_indexing_queue"
+      " (service, url, mime_type, download_url, authorisation, metadata)"
+      " VALUES (:service, :url, :mime_type, :download_url, :authorisation,"
+      " :metadata)",
+      conn);
+  q.bindValue(":service", service_id_);
+  q.bindValue(":url", file.metadata.url().toEncoded());
+  q.bindValue(":mime_type", file.mime_type);
+  q.bindValue(":download_url", file.download_url.toEncoded());
+  q.bindValue(":authorisation", file.authorisation);
+  q.bindValue(":metadata", QByteArray(metadata.data(), metadata.size()));
+  q.exec();
+  db->CheckErrors(q);
+}
+
+void CloudFileService::RemoveQueuedFile(const QUrl& url) {
+  Database* db = app_->database();
+  QMutexLocker l(db->Mutex());
+  QSqlDatabase conn(db->Connect());
+
+  QSqlQuery q = db->PreparedQuery(
+      "DELETE FROM cloud_indexing_queue"
+      " WHERE service = :service AND url = :url",
+      conn);
+  q.bindValue(":service", service_id_);
+  q.bindValue(":url", url.toEncoded());
+  q.exec();
+  db->CheckErrors(q);
+}
+
+void CloudFileService::ClearQueuedFiles() {
+  Database* db = app_->database();
+  QMutexLocker l(db->Mutex());
+  QSqlDatabase conn(db->Connect());
+
+  QSqlQuery q = db->PreparedQuery(
+      "DELETE FROM cloud_indexing_queue WHERE service = :service", conn);
+  q.bindValue(":service", service_id_);
+  q.exec();
+  db->CheckErrors(q);
+}
+
+QList<CloudFileService::QueuedFile> CloudFileService::LoadQueuedFiles() {
+  QList<QueuedFile> ret;
+
+  Database* db = app_->database();
+  Database::ReadLocker l(db);
+  QSqlDatabase conn(db->ConnectReadOnly());
+
+  QSqlQuery q = db->PreparedQuery(
+      "SELECT mime_type, download_url, authorisation, metadata"
+      " FROM cloud_indexing_queue WHERE service = :service",
+      conn);
+  q.bindValue(":service", service_id_);
+  q.exec();
+  if (db->CheckErrors(q)) return ret;
+
+  while (q.next()) {
+    const QByteArray metadata = q.value(3).toByteArray();
+    pb::tagreader::SongMetadata metadata_pb;
+    if (!metadata_pb.ParseFromArray(metadata.constData(), metadata.size())) {
+      continue;
+    }
+
+    QueuedFile file;
+    file.metadata.InitFromProtobuf(metadata_pb);
+    file.mime_type = q.value(0).toString();
+    file.download_url = QUrl::fromEncoded(q.value(1).toByteArray());
+    file.authorisation = q.value(2).toString();
+    ret << file;
+  }
+  q.finish();
+  return ret;
 }
 
 void CloudFileService::ReadTagsFinished(TagReaderClient::ReplyType* reply,
@@ -181,6 +326,9 @@ void CloudFileService::ReadTagsFinished(TagReaderClient::ReplyType* reply,
   }
 
   pending_tagreader_replies_.removeAt(index_reply);
+  queued_urls_.remove(metadata.url());
+  RemoveQueuedFile(metadata.url());
+  StartQueuedReads();
 
   indexing_task_progress_++;
   if (indexing_task_progress_ == indexing_task_max_) {
@@ -238,6 +386,9 @@ QString CloudFileService::GuessMimeTypeForFile(const QString& filename) const {
 void CloudFileService::AbortReadTagsReplies() {
   qLog(Debug) << "Aborting the read tags replies";
   pending_tagreader_replies_.clear();
+  indexing_queue_.clear();
+  queued_urls_.clear();
+  ClearQueuedFiles();
 
   task_manager_->SetTaskFinished(indexing_task_id_);
   indexing_task_id_ = -1;
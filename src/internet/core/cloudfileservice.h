@@ -25,6 +25,8 @@
 #include <memory>
 
 #include <QMenu>
+#include <QQueue>
+#include <QSet>
 
 #include "core/tagreaderclient.h"
 #include "ui/albumcovermanager.h"
@@ -35,6 +37,7 @@ class LibraryBackend;
 class LibraryModel;
 class NetworkAccessManager;
 class PlaylistManager;
+class QTimer;
 
 class CloudFileService : public InternetService {
   Q_OBJECT
@@ -69,12 +72,20 @@ signals:
   QString GuessMimeTypeForFile(const QString& filename) const;
   void AbortReadTagsReplies();
 
+  // Restarts indexing of the files that were still queued when Clementine
+  // last exited.  Services call this once they are connected, passing their
+  // current authorisation header to replace the one that was saved.
+  void ResumeIndexing(const QString& authorisation);
+
  protected slots:
   void ShowCoverManager();
   void AddToPlaylist(QMimeData* mime);
   void ReadTagsFinished(TagReaderClient::ReplyType* reply,
                         const Song& metadata);
 
+ private slots:
+  void StartQueuedReads();
+
  protected:
   QStandardItem* root_;
   NetworkAccessManager* network_;
@@ -90,12 +101,36 @@ signals:
   QList<TagReaderClient::ReplyType*> pending_tagreader_replies_;
 
  private:
+  struct QueuedFile {
+    Song metadata;
+    QString mime_type;
+    QUrl download_url;
+    QString authorisation;
+  };
+
+  void QueueFile(const QueuedFile& file);
+  void SaveQueuedFile(const QueuedFile& file);
+  void RemoveQueuedFile(const QUrl& url);
+  void ClearQueuedFiles();
+  QList<QueuedFile> LoadQueuedFiles();
+
+  static const int kMaxConcurrentReads;
+  static const int kReadIntervalMsec;
+
   QIcon icon_;
+  const QString service_id_;
   SettingsDialog::Page settings_page_;
 
   int indexing_task_id_;
   int indexing_task_progress_;
   int indexing_task_max_;
+
+  // Files waiting for a tag reader.  They are also saved in the database
+  // until they have been read, so indexing carries on after a restart.
+  QQueue<QueuedFile> indexing_queue_;
+  QSet<QUrl> queued_urls_;
+  QTimer* read_timer_;
+  bool resumed_indexing_;
 };
 
 #endif  // INTERNET_CORE_CLOUDFILESERVICE_H_
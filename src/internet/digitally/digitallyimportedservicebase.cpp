@@ -51,7 +51,7 @@ DigitallyImportedServiceBase::DigitallyImportedServiceBase(
       icon_(icon),
       service_description_(description),
       api_service_name_(api_service_name),
-      network_(new NetworkAccessManager(this)),
+      network_(NetworkAccessManager::Shared()),
       url_handler_(new DigitallyImportedUrlHandler(app, this)),
       premium_audio_type_(2),
       has_premium_(has_premium),
@@ -99,6 +99,8 @@ QByteArray DropboxService::GenerateAuthorisationHeader() {
 }
 
 void DropboxService::RequestFileList() {
+  ResumeIndexing(QString::null);
+
   QSettings s;
   s.beginGroup(kSettingsGroup);
 
@@ -32,6 +32,7 @@ class DropboxUrlHandler : public UrlHandler {
   QString scheme() const { return "dropbox"; }
   QIcon icon() const { return IconLoader::Load("dropbox", IconLoader::Provider); }
   LoadResult StartLoading(const QUrl& url);
+  bool CanResolveAhead() const { return true; }
 
  private:
   DropboxService* service_;
@@ -107,15 +107,9 @@ void GoogleDriveService::ListChangesFinished(
     google_drive::ListChangesResponse* changes_response) {
   changes_response->deleteLater();
 
-  const QString cursor = changes_response->next_cursor();
-  if (is_indexing()) {
-    // Only save the cursor after all the songs have been indexed - that way if
-    // Clementine is closed it'll resume next time.
-    NewClosure(this, SIGNAL(AllIndexingTasksFinished()), this,
-               SLOT(SaveCursor(QString)), cursor);
-  } else {
-    SaveCursor(cursor);
-  }
+  // Files that are still being indexed are saved in the indexing queue, so
+  // the cursor can be moved on straight away.
+  SaveCursor(changes_response->next_cursor());
 }
 
 void GoogleDriveService::SaveCursor(const QString& cursor) {
@@ -140,6 +134,8 @@ void GoogleDriveService::ConnectFinished(
 
   emit Connected();
 
+  ResumeIndexing(QString("Bearer %1").arg(client_->access_token()));
+
   // Find all the changes since the last check.
   CheckForUpdates();
 }
@@ -33,6 +33,7 @@ class GoogleDriveUrlHandler : public UrlHandler {
   QString scheme() const { return "googledrive"; }
   QIcon icon() const { return IconLoader::Load("googledrive", IconLoader::Provider); }
   LoadResult StartLoading(const QUrl& url);
+  bool CanResolveAhead() const { return true; }
 
  private:
   GoogleDriveService* service_;
@@ -21,6 +21,9 @@
 
 #include "icecastbackend.h"
 
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QHash>
 #include <QSqlQuery>
 #include <QVariant>
 
@@ -109,6 +112,9 @@ IcecastBackend::StationList IcecastBackend::GetStations(const QString& filter,
   if (!where_clauses.isEmpty()) {
     sql += " WHERE " + where_clauses.join(" AND ");
   }
+  // Stations are added in any order, so they're sorted here.  This matches an
+  // index.
+  sql += " ORDER BY name COLLATE NOCASE";
   QSqlQuery q(sql, db);
   for (const QString& value : bound_items) {
     q.addBindValue(value);
@@ -139,42 +145,93 @@ bool IcecastBackend::IsEmpty() {
   return !q.next();
 }
 
-void IcecastBackend::ClearAndAddStations(const StationList& stations) {
+bool IcecastBackend::UpdateStations(const StationList& stations) {
+  bool changed = false;
   {
     QMutexLocker l(db_->Mutex());
     QSqlDatabase db = db_->Connect();
     ScopedTransaction t(&db);
 
-    // Remove all existing items
-    QSqlQuery q(QString("DELETE FROM %1").arg(kTableName), db);
+    // What's there already, by name.  Any duplicates are removed.
+    QHash<QString, QPair<qint64, qint64>> existing;  // name -> (rowid, hash)
+    QList<qint64> removed;
+    QSqlQuery q(QString("SELECT ROWID, name, hash FROM %1").arg(kTableName),
+                db);
     q.exec();
-    if (db_->CheckErrors(q)) return;
+    if (db_->CheckErrors(q)) return false;
+    while (q.next()) {
+      const QString name = q.value(1).toString();
+      if (existing.contains(name)) {
+        removed << q.value(0).toLongLong();
+      } else {
+        existing[name] = qMakePair(q.value(0).toLongLong(),
+                                   q.value(2).toLongLong());
+      }
+    }
 
-    q = QSqlQuery(
+    QSqlQuery insert(
         QString(
             "INSERT INTO %1 (name, url, mime_type, bitrate,"
-            "                channels, samplerate, genre)"
+            "                channels, samplerate, genre, hash)"
             " VALUES (:name, :url, :mime_type, :bitrate,"
-            "         :channels, :samplerate, :genre)").arg(kTableName),
+            "         :channels, :samplerate, :genre, :hash)").arg(kTableName),
+        db);
+    QSqlQuery update(
+        QString(
+            "UPDATE %1 SET url = :url, mime_type = :mime_type,"
+            "              bitrate = :bitrate, channels = :channels,"
+            "              samplerate = :samplerate, genre = :genre,"
+            "              hash = :hash"
+            " WHERE ROWID = :id").arg(kTableName),
         db);
 
-    // Add these ones
     for (const Station& station : stations) {
-      q.bindValue(":name", station.name);
-      q.bindValue(":url", station.url);
-      q.bindValue(":mime_type", station.mime_type);
-      q.bindValue(":bitrate", station.bitrate);
-      q.bindValue(":channels", station.channels);
-      q.bindValue(":samplerate", station.samplerate);
-      q.bindValue(":genre", station.genre);
-      q.exec();
-      if (db_->CheckErrors(q)) return;
+      const qint64 hash = station.Hash();
+      QSqlQuery* query = &insert;
+
+      if (existing.contains(station.name)) {
+        const QPair<qint64, qint64> row = existing.take(station.name);
+        if (row.second == hash) continue;
+
+        query = &update;
+        query->bindValue(":id", row.first);
+      } else {
+        query->bindValue(":name", station.name);
+      }
+
+      query->bindValue(":url", station.url);
+      query->bindValue(":mime_type", station.mime_type);
+      query->bindValue(":bitrate", station.bitrate);
+      query->bindValue(":channels", station.channels);
+      query->bindValue(":samplerate", station.samplerate);
+      query->bindValue(":genre", station.genre);
+      query->bindValue(":hash", hash);
+      query->exec();
+      if (db_->CheckErrors(*query)) return false;
+      changed = true;
+    }
+
+    // Anything left over isn't in the directory any more.
+    for (const QPair<qint64, qint64>& row : existing) {
+      removed << row.first;
+    }
+
+    QSqlQuery remove(
+        QString("DELETE FROM %1 WHERE ROWID = :id").arg(kTableName), db);
+    for (qint64 id : removed) {
+      remove.bindValue(":id", id);
+      remove.exec();
+      if (db_->CheckErrors(remove)) return false;
+      changed = true;
     }
 
     t.Commit();
   }
 
-  emit DatabaseReset();
+  if (changed) {
+    emit DatabaseReset();
+  }
+  return true;
 }
 
 Song IcecastBackend::Station::ToSong() const {
@@ -188,3 +245,18 @@ Song IcecastBackend::Station::ToSong() const {
   ret.set_filetype(Song::Type_Stream);
   return ret;
 }
+
+qint64 IcecastBackend::Station::Hash() const {
+  QByteArray data;
+  {
+    QDataStream s(&data, QIODevice::WriteOnly);
+    s << name << url << mime_type << bitrate << channels << samplerate
+      << genre;
+  }
+
+  // The first 8 bytes of the digest are plenty to spot a change.
+  QDataStream s(QCryptographicHash::hash(data, QCryptographicHash::Md5));
+  qint64 ret = 0;
+  s >> ret;
+  return ret;
+}
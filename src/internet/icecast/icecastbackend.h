@@ -48,6 +48,9 @@ class IcecastBackend : public QObject {
     QString genre;
 
     Song ToSong() const;
+    // Changes whenever any of the fields change.  It's stored with the
+    // station so the directory can be compared with what's already there.
+    qint64 Hash() const;
   };
   typedef QList<Station> StationList;
 
@@ -56,7 +59,10 @@ class IcecastBackend : public QObject {
   StationList GetStations(const QString& filter = QString(),
                           const QString& genre = QString());
 
-  void ClearAndAddStations(const StationList& stations);
+  // Makes the table match the given stations, touching only the ones that
+  // were added, changed or removed.  DatabaseReset is only emitted if
+  // something did change.  Returns false on a database error.
+  bool UpdateStations(const StationList& stations);
 
   bool IsEmpty();
 
@@ -28,14 +28,16 @@
 #include <QMultiHash>
 #include <QNetworkReply>
 #include <QRegExp>
-#include <QtConcurrentRun>
+#include <QSettings>
 
 #include "core/application.h"
 #include "core/closure.h"
 #include "core/database.h"
+#include "core/logging.h"
 #include "core/mergedproxymodel.h"
 #include "core/network.h"
 #include "core/taskmanager.h"
+#include "core/threadpools.h"
 #include "globalsearch/globalsearch.h"
 #include "globalsearch/icecastsearchprovider.h"
 #include "internet/core/internetmodel.h"
@@ -49,13 +51,14 @@ using std::sort;
 using std::unique;
 
 const char* IcecastService::kServiceName = "Icecast";
+const char* IcecastService::kSettingsGroup = "Icecast";
 const char* IcecastService::kDirectoryUrl =
     "http://data.clementine-player.org/icecast-directory";
 const char* IcecastService::kHomepage = "http://dir.xiph.org/";
 
 IcecastService::IcecastService(Application* app, InternetModel* parent)
     : InternetService(kServiceName, app, parent, parent),
-      network_(new NetworkAccessManager(this)),
+      network_(NetworkAccessManager::Shared()),
       context_menu_(nullptr),
       backend_(nullptr),
       model_(nullptr),
@@ -108,6 +111,19 @@ void IcecastService::RequestDirectory(const QUrl& url, int task_id) {
   req.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
                    QNetworkRequest::AlwaysNetwork);
 
+  // Only download the directory if it changed since the stations we have.
+  if (!backend_->IsEmpty()) {
+    QSettings s;
+    s.beginGroup(kSettingsGroup);
+    const QByteArray etag = s.value("directory_etag").toByteArray();
+    const QByteArray last_modified =
+        s.value("directory_last_modified").toByteArray();
+    if (!etag.isEmpty()) req.setRawHeader("If-None-Match", etag);
+    if (!last_modified.isEmpty()) {
+      req.setRawHeader("If-Modified-Since", last_modified);
+    }
+  }
+
   QNetworkReply* reply = network_->get(req);
   NewClosure(reply, SIGNAL(finished()), this,
              SLOT(DownloadDirectoryFinished(QNetworkReply*, int)), reply,
@@ -125,11 +141,55 @@ void IcecastService::DownloadDirectoryFinished(QNetworkReply* reply,
     return;
   }
 
-  QFuture<IcecastBackend::StationList> future =
-      QtConcurrent::run(this, &IcecastService::ParseDirectory, reply);
-  NewClosure(future, this, SLOT(ParseDirectoryFinished(
-                               QFuture<IcecastBackend::StationList>, int)),
-             future, task_id);
+  const int status =
+      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  if (reply->error() != QNetworkReply::NoError || status == 304) {
+    // Either it failed, or the stations we have are still current.  Either
+    // way they're left alone.
+    if (status != 304) {
+      qLog(Warning) << "Failed to download the Icecast directory"
+                    << reply->errorString();
+    }
+    reply->deleteLater();
+    app_->task_manager()->SetTaskFinished(task_id);
+    return;
+  }
+
+  const QByteArray etag = reply->rawHeader("ETag");
+  const QByteArray last_modified = reply->rawHeader("Last-Modified");
+
+  // Parsing and storing tens of thousands of stations takes a while.
+  QFuture<bool> future = ThreadPools::Run<bool>(
+      ThreadPools::Pool_Background,
+      std::bind(&IcecastService::UpdateDirectory, reply, backend_));
+  NewClosure(future, this,
+             SLOT(UpdateDirectoryFinished(QFuture<bool>, int, QByteArray,
+                                          QByteArray)),
+             future, task_id, etag, last_modified);
+}
+
+void IcecastService::UpdateDirectoryFinished(QFuture<bool> future,
+                                             int task_id,
+                                             const QByteArray& etag,
+                                             const QByteArray& last_modified) {
+  if (future.result()) {
+    QSettings s;
+    s.beginGroup(kSettingsGroup);
+    s.setValue("directory_etag", etag);
+    s.setValue("directory_last_modified", last_modified);
+  }
+
+  app_->task_manager()->SetTaskFinished(task_id);
+}
+
+bool IcecastService::UpdateDirectory(QIODevice* device,
+                                     IcecastBackend* backend) {
+  IcecastBackend::StationList stations = ParseDirectory(device);
+  // A directory with nothing in it is more likely to be broken than true.
+  if (stations.isEmpty()) return false;
+
+  TidyStations(&stations);
+  return backend->UpdateStations(stations);
 }
 
 namespace {
@@ -188,9 +248,8 @@ QStringList FilterGenres(const QStringList& genres) {
 }
 }  // namespace
 
-void IcecastService::ParseDirectoryFinished(
-    QFuture<IcecastBackend::StationList> future, int task_id) {
-  IcecastBackend::StationList all_stations = future.result();
+void IcecastService::TidyStations(IcecastBackend::StationList* stations) {
+  IcecastBackend::StationList& all_stations = *stations;
   sort(all_stations.begin(), all_stations.end(),
        StationSorter<IcecastBackend::Station>());
   // Remove duplicates by name. These tend to be multiple URLs for the same
@@ -221,13 +280,9 @@ void IcecastService::ParseDirectoryFinished(
     }
   }
 
-  backend_->ClearAndAddStations(all_stations);
-
-  app_->task_manager()->SetTaskFinished(task_id);
 }
 
-IcecastBackend::StationList IcecastService::ParseDirectory(
-    QIODevice* device) const {
+IcecastBackend::StationList IcecastService::ParseDirectory(QIODevice* device) {
   QXmlStreamReader reader(device);
   IcecastBackend::StationList stations;
   while (!reader.atEnd()) {
@@ -238,11 +293,18 @@ IcecastBackend::StationList IcecastService::ParseDirectory(
     }
   }
   device->deleteLater();
+
+  // Half a directory would remove the other half of the stations.
+  if (reader.hasError()) {
+    qLog(Warning) << "Failed to parse the Icecast directory"
+                  << reader.errorString();
+    return IcecastBackend::StationList();
+  }
   return stations;
 }
 
 IcecastBackend::Station IcecastService::ReadStation(
-    QXmlStreamReader* reader) const {
+    QXmlStreamReader* reader) {
   IcecastBackend::Station station;
   while (!reader->atEnd()) {
     reader->readNext();
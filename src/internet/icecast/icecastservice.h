@@ -43,6 +43,7 @@ class IcecastService : public InternetService {
   ~IcecastService();
 
   static const char* kServiceName;
+  static const char* kSettingsGroup;
   static const char* kDirectoryUrl;
   static const char* kHomepage;
 
@@ -62,14 +63,17 @@ class IcecastService : public InternetService {
   void LoadDirectory();
   void Homepage();
   void DownloadDirectoryFinished(QNetworkReply* reply, int task_id);
-  void ParseDirectoryFinished(QFuture<IcecastBackend::StationList> future,
-                              int task_id);
+  void UpdateDirectoryFinished(QFuture<bool> future, int task_id,
+                               const QByteArray& etag,
+                               const QByteArray& last_modified);
 
  private:
   void RequestDirectory(const QUrl& url, int task_id);
   void EnsureMenuCreated();
-  IcecastBackend::StationList ParseDirectory(QIODevice* device) const;
-  IcecastBackend::Station ReadStation(QXmlStreamReader* reader) const;
+  static bool UpdateDirectory(QIODevice* device, IcecastBackend* backend);
+  static IcecastBackend::StationList ParseDirectory(QIODevice* device);
+  static IcecastBackend::Station ReadStation(QXmlStreamReader* reader);
+  static void TidyStations(IcecastBackend::StationList* stations);
 
   QStandardItem* root_;
   NetworkAccessManager* network_;
@@ -36,6 +36,8 @@ class IntergalacticFMUrlHandler : public UrlHandler {
   QString scheme() const;
   QIcon icon() const;
   LoadResult StartLoading(const QUrl& url);
+  bool CanResolveAhead() const { return true; }
+  bool CanUseStaleResult() const { return true; }
 
  private slots:
   void LoadPlaylistFinished();
@@ -27,6 +27,7 @@
 #include <QMenu>
 #include <QMessageBox>
 #include <QNetworkReply>
+#include <QSettings>
 #include <QSortFilterProxyModel>
 #include <QtConcurrentRun>
 #include <QXmlStreamReader>
@@ -74,13 +75,14 @@ const char* JamendoService::kTrackIdsTable = "jamendo.track_ids";
 const char* JamendoService::kTrackIdsColumn = "track_id";
 
 const char* JamendoService::kSettingsGroup = "Jamendo";
+const char* JamendoService::kDirectoryETagKey = "directory_etag";
 
 const int JamendoService::kBatchSize = 10000;
 const int JamendoService::kApproxDatabaseSize = 450000;
 
 JamendoService::JamendoService(Application* app, InternetModel* parent)
     : InternetService(kServiceName, app, parent, parent),
-      network_(new NetworkAccessManager(this)),
+      network_(NetworkAccessManager::Shared()),
       context_menu_(nullptr),
       library_backend_(nullptr),
       library_filter_(nullptr),
@@ -90,8 +92,10 @@ JamendoService::JamendoService(Application* app, InternetModel* parent)
       load_database_task_id_(0),
       total_song_count_(0),
       accepted_download_(false) {
+  // The catalogue is in a database of its own, give it a thread of its own
+  // to write it from too.
   library_backend_ = new LibraryBackend;
-  library_backend_->moveToThread(app_->database()->thread());
+  app_->MoveToNewThread(library_backend_);
   library_backend_->Init(app_->database(), kSongsTable, QString::null,
                          QString::null, kFtsTable);
   connect(library_backend_, SIGNAL(TotalSongCountUpdated(int)),
@@ -189,6 +193,14 @@ void JamendoService::DownloadDirectory() {
   req.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
                    QNetworkRequest::AlwaysNetwork);
 
+  // If we already have the catalogue only download it again if it changed.
+  if (total_song_count_ > 0) {
+    QSettings s;
+    s.beginGroup(kSettingsGroup);
+    const QByteArray etag = s.value(kDirectoryETagKey).toByteArray();
+    if (!etag.isEmpty()) req.setRawHeader("If-None-Match", etag);
+  }
+
   QNetworkReply* reply = network_->get(req);
   connect(reply, SIGNAL(finished()), SLOT(DownloadDirectoryFinished()));
   connect(reply, SIGNAL(downloadProgress(qint64, qint64)),
@@ -213,6 +225,22 @@ void JamendoService::DownloadDirectoryFinished() {
   app_->task_manager()->SetTaskFinished(load_database_task_id_);
   load_database_task_id_ = 0;
 
+  if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() ==
+      304) {
+    qLog(Info) << "Jamendo catalogue hasn't changed";
+    reply->deleteLater();
+    return;
+  }
+
+  if (reply->error() != QNetworkReply::NoError) {
+    qLog(Error) << reply->errorString();
+    reply->deleteLater();
+    return;
+  }
+
+  // Only remembered once the new catalogue has been imported
+  pending_directory_etag_ = reply->rawHeader("ETag");
+
   // TODO(John Maguire): Not leak reply.
   QtIOCompressor* gzip = new QtIOCompressor(reply);
   gzip->setStreamFormat(QtIOCompressor::GzipFormat);
@@ -280,7 +308,8 @@ void JamendoService::ParseDirectory(QIODevice* device) const {
 }
 
 void JamendoService::InsertTrackIds(const TrackIdList& ids) const {
-  QMutexLocker l(library_backend_->db()->Mutex());
+  QMutexLocker l(library_backend_->db()->Mutex(
+      Database::DatabaseForTable(kTrackIdsTable)));
   QSqlDatabase db(library_backend_->db()->Connect());
 
   ScopedTransaction t(&db);
@@ -403,6 +432,11 @@ Song JamendoService::ReadTrack(const QString& artist, const QString& album,
 }
 
 void JamendoService::ParseDirectoryFinished() {
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  s.setValue(kDirectoryETagKey, pending_directory_etag_);
+  pending_directory_etag_.clear();
+
   // show smart playlists
   library_model_->set_show_smart_playlists(true);
   library_model_->Reset();
@@ -70,6 +70,7 @@ class JamendoService : public InternetService {
   static const char* kTrackIdsColumn;
 
   static const char* kSettingsGroup;
+  static const char* kDirectoryETagKey;
 
   static const int kBatchSize;
   static const int kApproxDatabaseSize;
@@ -117,6 +118,7 @@ class JamendoService : public InternetService {
   LibrarySearchProvider* search_provider_;
 
   int load_database_task_id_;
+  QByteArray pending_directory_etag_;
 
   int total_song_count_;
 
@@ -44,6 +44,7 @@
 #include <QMenu>
 #include <QMessageBox>
 #include <QSettings>
+#include <QTimer>
 
 #ifdef HAVE_LIBLASTFM1
 #include <lastfm/RadioStation.h>
@@ -82,9 +83,16 @@ const char* LastFMService::kSecret = "d3072b60ae626be12be69448f5c46e70";
 const char* LastFMService::kAuthLoginUrl =
     "https://www.last.fm/api/auth/?api_key=%1&token=%2";
 
+const int LastFMService::kNowPlayingDelayMsec = 1000;
+const int LastFMService::kMinSubmitRetryMsec = 60 * 1000;         // 1 minute
+const int LastFMService::kMaxSubmitRetryMsec = 2 * 60 * 60 * 1000;  // 2 hours
+
 LastFMService::LastFMService(Application* app, QObject* parent)
     : Scrobbler(parent),
       already_scrobbled_(false),
+      now_playing_timer_(new QTimer(this)),
+      submit_retry_timer_(new QTimer(this)),
+      submit_retry_msec_(kMinSubmitRetryMsec),
       scrobbling_enabled_(false),
       connection_problems_(false),
       app_(app),
@@ -93,6 +101,13 @@ LastFMService::LastFMService(Application* app, QObject* parent)
   lastfm::ws::setScheme(lastfm::ws::Https);
 #endif
 
+  now_playing_timer_->setSingleShot(true);
+  now_playing_timer_->setInterval(kNowPlayingDelayMsec);
+  connect(now_playing_timer_, SIGNAL(timeout()), SLOT(SendNowPlaying()));
+
+  submit_retry_timer_->setSingleShot(true);
+  connect(submit_retry_timer_, SIGNAL(timeout()), SLOT(RetrySubmit()));
+
   ReloadSettings();
 
   // we emit the signal the first time to be sure the buttons are in the right
@@ -206,6 +221,8 @@ void LastFMService::AuthenticateReplyFinished(QNetworkReply* reply) {
 
   // Invalidate the scrobbler - it will get recreated later
   scrobbler_.reset(nullptr);
+  submit_retry_timer_->stop();
+  submit_retry_msec_ = kMinSubmitRetryMsec;
 
   emit AuthenticationComplete(true);
 }
@@ -307,13 +324,14 @@ QString LastFMService::ErrorString(lastfm::ws::Error error) const {
 bool LastFMService::InitScrobbler() {
   if (!IsAuthenticated() || !IsScrobblingEnabled()) return false;
 
-  if (!scrobbler_)
-    scrobbler_.reset(new lastfm::Audioscrobbler(kAudioscrobblerClientId));
+  if (scrobbler_) return true;
+
+  scrobbler_.reset(new lastfm::Audioscrobbler(kAudioscrobblerClientId));
 
 // reemit the signal since the sender is private
 #ifdef HAVE_LIBLASTFM1
   connect(scrobbler_.get(), SIGNAL(scrobblesSubmitted(QList<lastfm::Track>)),
-          SIGNAL(ScrobbleSubmitted()));
+          SLOT(ScrobblesSubmitted()));
   connect(scrobbler_.get(), SIGNAL(nowPlayingError(int, QString)),
           SIGNAL(ScrobbleError(int)));
 #else
@@ -326,7 +344,7 @@ void LastFMService::ScrobblerStatus(int value) {
   switch (value) {
     case 2:
     case 3:
-      emit ScrobbleSubmitted();
+      ScrobblesSubmitted();
       break;
 
     default:
@@ -335,6 +353,43 @@ void LastFMService::ScrobblerStatus(int value) {
   }
 }
 
+void LastFMService::ScrobblesSubmitted() {
+  submit_retry_msec_ = kMinSubmitRetryMsec;
+
+  // Anything that's still in the cache is sent with the next batch.
+  lastfm::compat::ScrobbleCache cache(lastfm::ws::Username);
+  if (cache.tracks().isEmpty()) {
+    submit_retry_timer_->stop();
+  } else {
+    Submit();
+  }
+
+  emit ScrobbleSubmitted();
+}
+
+void LastFMService::Submit() {
+  scrobbler_->submit();
+
+  // If this doesn't succeed it's retried later.  ScrobblesSubmitted stops the
+  // timer again.
+  submit_retry_timer_->start(submit_retry_msec_);
+}
+
+void LastFMService::RetrySubmit() {
+  if (!InitScrobbler()) return;
+
+  lastfm::compat::ScrobbleCache cache(lastfm::ws::Username);
+  if (cache.tracks().isEmpty()) {
+    submit_retry_msec_ = kMinSubmitRetryMsec;
+    return;
+  }
+
+  submit_retry_msec_ = qMin(submit_retry_msec_ * 2, kMaxSubmitRetryMsec);
+  qLog(Debug) << "Retrying submitting" << cache.tracks().count()
+              << "cached scrobbles";
+  Submit();
+}
+
 lastfm::Track LastFMService::TrackFromSong(const Song& song) const {
   if (song.title() == last_track_.title() &&
       song.artist() == last_track_.artist() &&
@@ -365,7 +420,7 @@ void LastFMService::NowPlaying(const Song& song) {
       qLog(Info) << "Scrobbling stream track" << mtrack.title() << "length"
                  << duration_secs;
       scrobbler_->cache(mtrack);
-      scrobbler_->submit();
+      Submit();
 
       emit ScrobbledRadioStream();
     }
@@ -382,6 +437,7 @@ void LastFMService::NowPlaying(const Song& song) {
   if (!lastfm::Scrobble(last_track_).isValid(&invalidity)) {
     // for now just notify this, we can also see the cause
     emit ScrobbleError(-1);
+    now_playing_timer_->stop();
     return;
   }
 #else
@@ -390,7 +446,13 @@ void LastFMService::NowPlaying(const Song& song) {
 // no impact as we get a different error when actually trying to scrobble.
 #endif
 
-  scrobbler_->nowPlaying(mtrack);
+  now_playing_timer_->start();
+}
+
+void LastFMService::SendNowPlaying() {
+  if (!InitScrobbler() || last_track_.isNull()) return;
+
+  scrobbler_->nowPlaying(last_track_);
 }
 
 void LastFMService::Scrobble() {
@@ -403,7 +465,7 @@ void LastFMService::Scrobble() {
 
   // Let's mark a track as cached, useful when the connection is down
   emit ScrobbleError(30);
-  scrobbler_->submit();
+  Submit();
 
   already_scrobbled_ = true;
 }
@@ -40,6 +40,7 @@ class Application;
 class LastFMUrlHandler;
 class NetworkAccessManager;
 class QAction;
+class QTimer;
 class Song;
 
 class LastFMService : public Scrobbler {
@@ -56,6 +57,10 @@ class LastFMService : public Scrobbler {
   static const char* kSecret;
   static const char* kAuthLoginUrl;
 
+  static const int kNowPlayingDelayMsec;
+  static const int kMinSubmitRetryMsec;
+  static const int kMaxSubmitRetryMsec;
+
   void ReloadSettings();
 
   virtual QString Icon() { return ":last.fm/lastfm.png"; }
@@ -99,10 +104,15 @@ signals:
   void UpdateSubscriberStatusFinished(QNetworkReply* reply);
 
   void ScrobblerStatus(int value);
+  void ScrobblesSubmitted();
+
+  void SendNowPlaying();
+  void RetrySubmit();
 
  private:
   QString ErrorString(lastfm::ws::Error error) const;
   bool InitScrobbler();
+  void Submit();
   lastfm::Track TrackFromSong(const Song& song) const;
 
   static QUrl FixupUrl(const QUrl& url);
@@ -113,6 +123,16 @@ signals:
   lastfm::Track next_metadata_;
   bool already_scrobbled_;
 
+  // Now playing updates are sent a little while after the track changes, so
+  // skipping through a playlist only sends the last one.
+  QTimer* now_playing_timer_;
+
+  // liblastfm keeps scrobbles that haven't been submitted in its cache and
+  // sends them in batches.  If a submission doesn't succeed it's retried,
+  // waiting twice as long each time.
+  QTimer* submit_retry_timer_;
+  int submit_retry_msec_;
+
   QUrl last_url_;
 
   bool scrobbling_enabled_;
@@ -43,6 +43,7 @@
 #include "magnatuneurlhandler.h"
 #include "internet/core/internetmodel.h"
 #include "core/application.h"
+#include "core/cachingurlhandler.h"
 #include "core/database.h"
 #include "core/logging.h"
 #include "core/mergedproxymodel.h"
@@ -61,8 +62,9 @@
 
 const char* MagnatuneService::kServiceName = "Magnatune";
 const char* MagnatuneService::kSettingsGroup = "Magnatune";
-const char* MagnatuneService::kSongsTable = "magnatune_songs";
-const char* MagnatuneService::kFtsTable = "magnatune_songs_fts";
+const char* MagnatuneService::kDatabaseETagKey = "database_etag";
+const char* MagnatuneService::kSongsTable = "magnatune.songs";
+const char* MagnatuneService::kFtsTable = "magnatune.songs_fts";
 
 const char* MagnatuneService::kHomepage = "http://magnatune.com";
 const char* MagnatuneService::kDatabaseUrl =
@@ -74,6 +76,8 @@ const char* MagnatuneService::kPartnerId = "clementine";
 const char* MagnatuneService::kDownloadUrl =
     "http://download.magnatune.com/buy/membership_free_dl_xml";
 
+const int MagnatuneService::kBatchSize = 1000;
+
 MagnatuneService::MagnatuneService(Application* app, InternetModel* parent)
     : InternetService(kServiceName, app, parent, parent),
       url_handler_(new MagnatuneUrlHandler(this, this)),
@@ -87,10 +91,11 @@ MagnatuneService::MagnatuneService(Application* app, InternetModel* parent)
       membership_(Membership_None),
       format_(Format_Ogg),
       total_song_count_(0),
-      network_(new NetworkAccessManager(this)) {
-  // Create the library backend in the database thread
+      network_(NetworkAccessManager::Shared()) {
+  // The catalogue is in a database of its own, give it a thread of its own
+  // to write it from too.
   library_backend_ = new LibraryBackend;
-  library_backend_->moveToThread(app_->database()->thread());
+  app_->MoveToNewThread(library_backend_);
   library_backend_->Init(app_->database(), kSongsTable, QString::null,
                          QString::null, kFtsTable);
   library_model_ = new LibraryModel(library_backend_, app_, this);
@@ -104,7 +109,8 @@ MagnatuneService::MagnatuneService(Application* app, InternetModel* parent)
   library_sort_model_->setSortLocaleAware(true);
   library_sort_model_->sort(0);
 
-  app_->player()->RegisterUrlHandler(url_handler_);
+  app_->player()->RegisterUrlHandler(
+      new CachingUrlHandler(url_handler_, app_->stream_cache(), this));
   app_->global_search()->AddProvider(new LibrarySearchProvider(
       library_backend_, tr("Magnatune"), "magnatune",
       IconLoader::Load("magnatune", IconLoader::Provider), 
@@ -154,6 +160,14 @@ void MagnatuneService::ReloadDatabase() {
   request.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
                        QNetworkRequest::AlwaysNetwork);
 
+  // If we already have the catalogue only download it again if it changed.
+  if (total_song_count_ > 0) {
+    QSettings s;
+    s.beginGroup(kSettingsGroup);
+    const QByteArray etag = s.value(kDatabaseETagKey).toByteArray();
+    if (!etag.isEmpty()) request.setRawHeader("If-None-Match", etag);
+  }
+
   QNetworkReply* reply = network_->get(request);
   connect(reply, SIGNAL(finished()), SLOT(ReloadDatabaseFinished()));
 
@@ -164,10 +178,17 @@ void MagnatuneService::ReloadDatabase() {
 
 void MagnatuneService::ReloadDatabaseFinished() {
   QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
+  reply->deleteLater();
 
   app_->task_manager()->SetTaskFinished(load_database_task_id_);
   load_database_task_id_ = 0;
 
+  if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() ==
+      304) {
+    qLog(Info) << "Magnatune catalogue hasn't changed";
+    return;
+  }
+
   if (reply->error() != QNetworkReply::NoError) {
     // TODO(David Sansome): Error handling
     qLog(Error) << reply->errorString();
@@ -197,11 +218,26 @@ void MagnatuneService::ReloadDatabaseFinished() {
         reader.name() == "Track") {
       songs << ReadTrack(reader);
     }
+
+    // Add the songs to the database in batches
+    if (songs.count() >= kBatchSize) {
+      library_backend_->AddOrUpdateSongs(songs);
+      songs.clear();
+    }
   }
 
-  // Add the songs to the database
   library_backend_->AddOrUpdateSongs(songs);
   library_model_->Reset();
+
+  if (reader.hasError()) {
+    qLog(Warning) << "Error parsing Magnatune catalogue"
+                  << reader.errorString();
+    return;
+  }
+
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  s.setValue(kDatabaseETagKey, reply->rawHeader("ETag"));
 }
 
 Song MagnatuneService::ReadTrack(QXmlStreamReader& reader) {
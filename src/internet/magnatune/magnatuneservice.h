@@ -60,6 +60,7 @@ class MagnatuneService : public InternetService {
   static const char* kServiceName;
   static const char* kSettingsGroup;
   static const char* kDatabaseUrl;
+  static const char* kDatabaseETagKey;
   static const char* kSongsTable;
   static const char* kFtsTable;
   static const char* kHomepage;
@@ -68,6 +69,8 @@ class MagnatuneService : public InternetService {
   static const char* kPartnerId;
   static const char* kDownloadUrl;
 
+  static const int kBatchSize;
+
   static QString ReadElementText(QXmlStreamReader& reader);
 
   QStandardItem* CreateRootItem();
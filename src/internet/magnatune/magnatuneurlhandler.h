@@ -32,6 +32,7 @@ class MagnatuneUrlHandler : public UrlHandler {
   QString scheme() const { return "magnatune"; }
   QIcon icon() const { return IconLoader::Load("magnatune", IconLoader::Provider); }
   LoadResult StartLoading(const QUrl& url);
+  bool CanResolveAhead() const { return true; }
 
  private:
   MagnatuneService* service_;
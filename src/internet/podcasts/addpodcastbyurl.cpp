@@ -84,6 +84,10 @@ void AddPodcastByUrl::RequestFinished(PodcastUrlLoaderReply* reply) {
       model()->CreateOpmlContainerItems(reply->opml_results(),
                                         model()->invisibleRootItem());
       break;
+
+    case PodcastUrlLoaderReply::Type_NotModified:
+      // Only conditional loads get this
+      break;
   }
 }
 
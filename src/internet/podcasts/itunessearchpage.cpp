@@ -37,7 +37,7 @@ const char* ITunesSearchPage::kUrlBase =
 ITunesSearchPage::ITunesSearchPage(Application* app, QWidget* parent)
     : AddPodcastPage(app, parent),
       ui_(new Ui_ITunesSearchPage),
-      network_(new NetworkAccessManager(this)) {
+      network_(NetworkAccessManager::Shared()) {
   ui_->setupUi(this);
   connect(ui_->search, SIGNAL(clicked()), SLOT(SearchClicked()));
   setWindowIcon(IconLoader::Load("itunes", IconLoader::Provider));
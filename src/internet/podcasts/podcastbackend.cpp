@@ -19,6 +19,7 @@
 
 #include "podcastbackend.h"
 
+#include <QDataStream>
 #include <QMutexLocker>
 
 #include "core/application.h"
@@ -160,6 +161,35 @@ void PodcastBackend::UpdateEpisodes(const PodcastEpisodeList& episodes) {
   emit EpisodesUpdated(episodes);
 }
 
+void PodcastBackend::UpdateFeedStates(const PodcastList& podcasts) {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+  ScopedTransaction t(&db);
+
+  QSqlQuery q(
+      "UPDATE podcasts"
+      " SET last_updated = :last_updated,"
+      "     last_update_error = :last_update_error,"
+      "     extra = :extra"
+      " WHERE ROWID = :id",
+      db);
+
+  for (const Podcast& podcast : podcasts) {
+    QByteArray extra;
+    QDataStream extra_stream(&extra, QIODevice::WriteOnly);
+    extra_stream << podcast.extra();
+
+    q.bindValue(":last_updated", podcast.last_updated().toTime_t());
+    q.bindValue(":last_update_error", podcast.last_update_error());
+    q.bindValue(":extra", extra);
+    q.bindValue(":id", podcast.database_id());
+    q.exec();
+    db_->CheckErrors(q);
+  }
+
+  t.Commit();
+}
+
 PodcastList PodcastBackend::GetAllSubscriptions() {
   PodcastList ret;
 
@@ -241,6 +271,92 @@ PodcastEpisodeList PodcastBackend::GetEpisodes(int podcast_id) {
   return ret;
 }
 
+PodcastEpisodeList PodcastBackend::GetEpisodes(int podcast_id, int offset,
+                                               int limit,
+                                               bool unlistened_only) {
+  PodcastEpisodeList ret;
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(QString("SELECT ROWID, " + PodcastEpisode::kColumnSpec +
+                      " FROM podcast_episodes"
+                      " WHERE podcast_id = :id"
+                      " %1"
+                      " ORDER BY publication_date DESC"
+                      " LIMIT :limit OFFSET :offset")
+                  .arg(unlistened_only ? "AND listened = 'false'" : ""),
+              db);
+  q.bindValue(":id", podcast_id);
+  q.bindValue(":limit", limit);
+  q.bindValue(":offset", offset);
+  q.exec();
+  if (db_->CheckErrors(q)) return ret;
+
+  while (q.next()) {
+    PodcastEpisode episode;
+    episode.InitFromQuery(q);
+    ret << episode;
+  }
+
+  return ret;
+}
+
+int PodcastBackend::GetUnlistenedEpisodeCount(int podcast_id) {
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(
+      "SELECT COUNT(*) FROM podcast_episodes"
+      " WHERE podcast_id = :id"
+      "   AND listened = 'false'",
+      db);
+  q.bindValue(":id", podcast_id);
+  q.exec();
+  if (db_->CheckErrors(q) || !q.next()) return 0;
+
+  return q.value(0).toInt();
+}
+
+QHash<int, int> PodcastBackend::GetUnlistenedEpisodeCounts() {
+  QHash<int, int> ret;
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(
+      "SELECT podcast_id, COUNT(*) FROM podcast_episodes"
+      " WHERE listened = 'false'"
+      " GROUP BY podcast_id",
+      db);
+  q.exec();
+  if (db_->CheckErrors(q)) return ret;
+
+  while (q.next()) {
+    ret[q.value(0).toInt()] = q.value(1).toInt();
+  }
+
+  return ret;
+}
+
+QHash<int, QSet<QUrl>> PodcastBackend::GetAllEpisodeUrls() {
+  QHash<int, QSet<QUrl>> ret;
+
+  QMutexLocker l(db_->Mutex());
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q("SELECT podcast_id, url FROM podcast_episodes", db);
+  q.exec();
+  if (db_->CheckErrors(q)) return ret;
+
+  while (q.next()) {
+    ret[q.value(0).toInt()].insert(
+        QUrl::fromEncoded(q.value(1).toByteArray()));
+  }
+
+  return ret;
+}
+
 PodcastEpisode PodcastBackend::GetEpisodeById(int id) {
   PodcastEpisode ret;
 
@@ -20,9 +20,12 @@
 #ifndef INTERNET_PODCASTS_PODCASTBACKEND_H_
 #define INTERNET_PODCASTS_PODCASTBACKEND_H_
 
+#include <QHash>
 #include <QObject>
+#include <QSet>
 
 #include "podcast.h"
+#include "core/qhash_qurl.h"
 
 class Application;
 class Database;
@@ -53,11 +56,23 @@ class PodcastBackend : public QObject {
   // Returns podcast episodes that match various keys.  All these queries are
   // indexed.
   PodcastEpisodeList GetEpisodes(int podcast_id);
+  // Returns up to limit episodes of the podcast, newest first, after skipping
+  // the first offset.  A negative limit returns all the rest.
+  PodcastEpisodeList GetEpisodes(int podcast_id, int offset, int limit,
+                                 bool unlistened_only = false);
   PodcastEpisode GetEpisodeById(int id);
   PodcastEpisode GetEpisodeByUrl(const QUrl& url);
   PodcastEpisode GetEpisodeByUrlOrLocalUrl(const QUrl& url);
   PodcastEpisode GetOldestDownloadedListenedEpisode();
 
+  // Returns how many episodes haven't been listened to, either in one podcast
+  // or keyed by the ID of every podcast that has some.
+  int GetUnlistenedEpisodeCount(int podcast_id);
+  QHash<int, int> GetUnlistenedEpisodeCounts();
+
+  // Returns the URLs of every episode, keyed by the ID of their podcast.
+  QHash<int, QSet<QUrl>> GetAllEpisodeUrls();
+
   // Returns a list of episodes that have local data (downloaded=true) but were
   // last listened to before the given QDateTime.  This query is NOT indexed so
   // it involves a full search of the table.
@@ -73,6 +88,10 @@ class PodcastBackend : public QObject {
   // local_url) on episodes that must already exist in the database.
   void UpdateEpisodes(const PodcastEpisodeList& episodes);
 
+  // Saves the fields PodcastUpdater changes (last_updated, last_update_error
+  // and extra) on podcasts that must already exist in the database.
+  void UpdateFeedStates(const PodcastList& podcasts);
+
  signals:
   void SubscriptionAdded(const Podcast& podcast);
   void SubscriptionRemoved(const Podcast& podcast);
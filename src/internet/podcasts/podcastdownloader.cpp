@@ -29,53 +29,187 @@
 #include "core/application.h"
 #include "core/logging.h"
 #include "core/network.h"
+#include "core/player.h"
 #include "core/tagreaderclient.h"
 #include "core/timeconstants.h"
 #include "core/utilities.h"
 #include "library/librarydirectorymodel.h"
 #include "library/librarymodel.h"
+#include "playlist/playlistitem.h"
 #include "podcastbackend.h"
 
 const char* PodcastDownloader::kSettingsGroup = "Podcasts";
+const int PodcastDownloader::kDefaultMaxDownloads = 2;
+const int PodcastDownloader::kThrottleIntervalMsec = 100;
 
-Task::Task(PodcastEpisode episode, QFile* file, PodcastBackend* backend)
-    : file_(file),
+const int Task::kMaxRetries = 5;
+const int Task::kRetryDelayMsec = 5000;
+const int Task::kThrottledReadBufferSize = 64 * 1024;
+
+Task::Task(PodcastEpisode episode, const QString& filename,
+           PodcastBackend* backend)
+    : filename_(filename),
       episode_(episode),
-      req_(QNetworkRequest(episode.url())),
       backend_(backend),
-      network_(new NetworkAccessManager(this)),
-      repl(new RedirectFollower(network_->get(req_))) {
-  connect(repl.get(), SIGNAL(readyRead()), SLOT(reading()));
-  connect(repl.get(), SIGNAL(finished()), SLOT(finishedInternal()));
-  connect(repl.get(), SIGNAL(downloadProgress(qint64, qint64)),
+      network_(nullptr),
+      throttled_(false),
+      response_checked_(false),
+      offset_(0),
+      retries_left_(kMaxRetries) {}
+
+Task::~Task() { StopReply(); }
+
+PodcastEpisode Task::episode() const { return episode_; }
+
+QString Task::PartialFilename() const { return filename_ + ".part"; }
+
+void Task::Start(QNetworkAccessManager* network, bool throttled) {
+  if (repl_) return;
+
+  network_ = network;
+  throttled_ = throttled;
+  response_checked_ = false;
+
+  file_.reset(new QFile(PartialFilename()));
+  if (!file_->open(QIODevice::WriteOnly | QIODevice::Append)) {
+    qLog(Warning) << "Could not open the file" << file_->fileName()
+                  << "for writing";
+    emit ProgressChanged(episode_, PodcastDownload::NotDownloading, 0);
+    emit finished(this);
+    return;
+  }
+  offset_ = file_->size();
+
+  QNetworkRequest req(episode_.url());
+  if (offset_ > 0) {
+    qLog(Info) << "Resuming download of" << episode_.url() << "at byte"
+               << offset_;
+    req.setRawHeader("Range", "bytes=" + QByteArray::number(offset_) + "-");
+  }
+
+  repl_.reset(new RedirectFollower(network_->get(req)));
+  if (throttled_) {
+    repl_->reply()->setReadBufferSize(kThrottledReadBufferSize);
+  }
+  connect(repl_.get(), SIGNAL(readyRead()), SLOT(reading()));
+  connect(repl_.get(), SIGNAL(finished()), SLOT(finishedInternal()));
+  connect(repl_.get(), SIGNAL(downloadProgress(qint64, qint64)),
           SLOT(downloadProgressInternal(qint64, qint64)));
+}
+
+void Task::StopReply() {
+  if (!repl_) return;
+
+  // This might be called from one of the reply's signals, so don't delete
+  // anything straight away.
+  disconnect(repl_.get(), 0, this, 0);
+  repl_->abort();
+  repl_->reply()->deleteLater();
+  repl_.release()->deleteLater();
+}
+
+void Task::Pause() {
+  // Stops a retry that's waiting to happen as well.
+  network_ = nullptr;
+  if (!repl_) return;
+
+  StopReply();
+  file_.reset();
   emit ProgressChanged(episode_, PodcastDownload::Queued, 0);
 }
 
-PodcastEpisode Task::episode() const { return episode_; }
+void Task::SetThrottled(bool throttled) {
+  throttled_ = throttled;
+  if (!repl_) return;
 
-void Task::reading() {
-  qint64 bytes = 0;
-  forever {
-    bytes = repl->bytesAvailable();
-    if (bytes <= 0) break;
+  repl_->reply()->setReadBufferSize(throttled ? kThrottledReadBufferSize : 0);
+  if (!throttled) Read(-1);
+}
 
-    file_->write(repl->reply()->read(bytes));
+bool Task::CheckResponse() {
+  if (response_checked_) return true;
+  response_checked_ = true;
+
+  const int status =
+      repl_->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  if (offset_ > 0 && status != 206) {
+    // The server ignored the Range header and is sending the whole file.
+    if (status == 200) {
+      qLog(Info) << "Server can't resume" << episode_.url()
+                 << "- starting again";
+      file_->resize(0);
+      offset_ = 0;
+      return true;
+    }
+
+    // Probably 416 - the partial file doesn't match what's there now.
+    qLog(Warning) << "Couldn't resume" << episode_.url() << "- HTTP" << status;
+    StopReply();
+    file_->remove();
+    file_.reset();
+    QTimer::singleShot(0, this, SLOT(Retry()));
+    return false;
   }
+
+  return true;
 }
+
+qint64 Task::Read(qint64 max_bytes) {
+  if (!repl_ || !CheckResponse()) return 0;
+
+  qint64 bytes = repl_->bytesAvailable();
+  if (max_bytes >= 0) bytes = qMin(bytes, max_bytes);
+  if (bytes <= 0) return 0;
+
+  file_->write(repl_->reply()->read(bytes));
+  return bytes;
+}
+
+void Task::reading() {
+  if (!throttled_) Read(-1);
+}
+
 void Task::finishedPublic() {
-  disconnect(repl.get(), SIGNAL(readyRead()), 0, 0);
-  disconnect(repl.get(), SIGNAL(downloadProgress(qint64, qint64)), 0, 0);
-  disconnect(repl.get(), SIGNAL(finished()), 0, 0);
+  StopReply();
   emit ProgressChanged(episode_, PodcastDownload::NotDownloading, 0);
   // Delete the file
-  file_->remove();
+  if (file_) {
+    file_->remove();
+  } else {
+    QFile::remove(PartialFilename());
+  }
   emit finished(this);
 }
 
+void Task::Retry() {
+  if (network_) Start(network_, throttled_);
+}
+
 void Task::finishedInternal() {
-  if (repl->error() != QNetworkReply::NoError) {
-    qLog(Warning) << "Error downloading episode:" << repl->errorString();
+  // Whatever a throttled download hasn't read yet is still in the buffer.
+  Read(-1);
+  if (!repl_) {
+    // CheckResponse gave up on this request and is starting a new one.
+    return;
+  }
+
+  const QNetworkReply::NetworkError error = repl_->error();
+  const QString error_string = repl_->errorString();
+  repl_.release()->deleteLater();
+
+  if (error != QNetworkReply::NoError) {
+    // Errors below ProxyConnectionRefusedError are connection problems rather
+    // than the server refusing us, so keep what we have and try again.
+    if (error < QNetworkReply::ProxyConnectionRefusedError &&
+        retries_left_-- > 0) {
+      qLog(Warning) << "Error downloading episode:" << error_string
+                    << "- retrying";
+      file_.reset();
+      QTimer::singleShot(kRetryDelayMsec, this, SLOT(Retry()));
+      return;
+    }
+
+    qLog(Warning) << "Error downloading episode:" << error_string;
     emit ProgressChanged(episode_, PodcastDownload::NotDownloading, 0);
     // Delete the file
     file_->remove();
@@ -83,13 +217,24 @@ void Task::finishedInternal() {
     return;
   }
 
-  qLog(Info) << "Download of" << file_->fileName() << "finished";
+  // Move the finished download into place.
+  file_->close();
+  QFile::remove(filename_);
+  if (!file_->rename(filename_)) {
+    qLog(Warning) << "Could not rename" << file_->fileName() << "to"
+                  << filename_;
+    emit ProgressChanged(episode_, PodcastDownload::NotDownloading, 0);
+    emit finished(this);
+    return;
+  }
+
+  qLog(Info) << "Download of" << filename_ << "finished";
 
   // Tell the database the episode has been updated.  Get it from the DB again
   // in case the listened field changed in the mean time.
   PodcastEpisode episode = episode_;
   episode.set_downloaded(true);
-  episode.set_local_url(QUrl::fromLocalFile(file_->fileName()));
+  episode.set_local_url(QUrl::fromLocalFile(filename_));
   backend_->UpdateEpisodes(PodcastEpisodeList() << episode);
   Podcast podcast =
       backend_->GetSubscriptionById(episode.podcast_database_id());
@@ -98,16 +243,18 @@ void Task::finishedInternal() {
   emit ProgressChanged(episode_, PodcastDownload::Finished, 0);
 
   // I didn't ecountered even a single podcast with a corect metadata
-  TagReaderClient::Instance()->SaveFileBlocking(file_->fileName(), song);
+  TagReaderClient::Instance()->SaveFileBlocking(filename_, song);
   emit finished(this);
 }
 
 void Task::downloadProgressInternal(qint64 received, qint64 total) {
+  // Resumed downloads only report the part that's left.
   if (total <= 0) {
     emit ProgressChanged(episode_, PodcastDownload::Downloading, 0);
   } else {
     emit ProgressChanged(episode_, PodcastDownload::Downloading,
-                         static_cast<float>(received) / total * 100);
+                         static_cast<float>(offset_ + received) /
+                             (offset_ + total) * 100);
   }
 }
 
@@ -117,12 +264,23 @@ PodcastDownloader::PodcastDownloader(Application* app, QObject* parent)
       backend_(app_->podcast_backend()),
       network_(new NetworkAccessManager(this)),
       disallowed_filename_characters_("[^a-zA-Z0-9_~ -]"),
-      auto_download_(false) {
+      auto_download_(false),
+      max_downloads_(kDefaultMaxDownloads),
+      speed_limit_kbps_(0),
+      pause_while_streaming_(false),
+      paused_for_stream_(false),
+      throttle_timer_(new QTimer(this)) {
   connect(backend_, SIGNAL(EpisodesAdded(PodcastEpisodeList)),
           SLOT(EpisodesAdded(PodcastEpisodeList)));
   connect(backend_, SIGNAL(SubscriptionAdded(Podcast)),
           SLOT(SubscriptionAdded(Podcast)));
   connect(app_, SIGNAL(SettingsChanged()), SLOT(ReloadSettings()));
+  connect(app_->player(), SIGNAL(Playing()), SLOT(PlayerStateChanged()));
+  connect(app_->player(), SIGNAL(Paused()), SLOT(PlayerStateChanged()));
+  connect(app_->player(), SIGNAL(Stopped()), SLOT(PlayerStateChanged()));
+
+  throttle_timer_->setInterval(kThrottleIntervalMsec);
+  connect(throttle_timer_, SIGNAL(timeout()), SLOT(ThrottleTimeout()));
 
   ReloadSettings();
 }
@@ -145,6 +303,76 @@ void PodcastDownloader::ReloadSettings() {
 
   auto_download_ = s.value("auto_download", false).toBool();
   download_dir_ = s.value("download_dir", DefaultDownloadDir()).toString();
+  max_downloads_ =
+      qMax(1, s.value("max_downloads", kDefaultMaxDownloads).toInt());
+  speed_limit_kbps_ = s.value("download_speed_limit_kbps", 0).toInt();
+  pause_while_streaming_ = s.value("pause_while_streaming", false).toBool();
+
+  if (is_throttled()) {
+    throttle_timer_->start();
+  } else {
+    throttle_timer_->stop();
+  }
+  for (Task* task : list_tasks_) {
+    task->SetThrottled(is_throttled());
+  }
+
+  PlayerStateChanged();
+  StartQueuedTasks();
+}
+
+void PodcastDownloader::PlayerStateChanged() {
+  PlaylistItemPtr item = app_->player()->GetCurrentItem();
+  const bool streaming = app_->player()->GetState() == Engine::Playing &&
+                         item && item->Url().scheme() != "file";
+  const bool pause = pause_while_streaming_ && streaming;
+  if (pause == paused_for_stream_) return;
+
+  paused_for_stream_ = pause;
+  if (pause) {
+    qLog(Info) << "Pausing podcast downloads while a stream is playing";
+    for (Task* task : list_tasks_) {
+      task->Pause();
+    }
+  } else {
+    StartQueuedTasks();
+  }
+}
+
+void PodcastDownloader::StartQueuedTasks() {
+  if (paused_for_stream_) return;
+
+  int running = 0;
+  for (Task* task : list_tasks_) {
+    if (task->is_running()) running++;
+  }
+
+  // Tasks might finish (and be removed) as soon as they start, so go through
+  // a copy of the list.
+  for (Task* task : QList<Task*>(list_tasks_)) {
+    if (running >= max_downloads_) break;
+    if (task->is_running() || !list_tasks_.contains(task)) continue;
+
+    qLog(Info) << "Downloading" << task->episode().url();
+    task->Start(network_, is_throttled());
+    running++;
+  }
+}
+
+void PodcastDownloader::ThrottleTimeout() {
+  QList<Task*> running;
+  for (Task* task : list_tasks_) {
+    if (task->is_running()) running << task;
+  }
+  if (running.isEmpty()) return;
+
+  // Share this interval's allowance between the running downloads.
+  const qint64 allowance =
+      qint64(speed_limit_kbps_) * 1024 * kThrottleIntervalMsec / 1000;
+  const qint64 share = qMax(qint64(1), allowance / running.count());
+  for (Task* task : running) {
+    task->Read(share);
+  }
 }
 
 QString PodcastDownloader::FilenameForEpisode(const QString& directory,
@@ -170,7 +398,12 @@ QString PodcastDownloader::FilenameForEpisode(const QString& directory,
           directory, base_filename, QString::number(count), file_extension);
     }
 
-    if (!QFile::exists(filename)) {
+    bool queued = false;
+    for (Task* task : list_tasks_) {
+      if (task->filename() == filename) queued = true;
+    }
+
+    if (!queued && !QFile::exists(filename)) {
       return filename;
     }
 
@@ -196,28 +429,27 @@ void PodcastDownloader::DownloadEpisode(const PodcastEpisode& episode) {
       download_dir_ + "/" + SanitiseFilenameComponent(podcast.title());
   const QString filepath = FilenameForEpisode(directory, episode);
 
-  // Open the output file
   QDir().mkpath(directory);
-  QFile* file = new QFile(filepath);
-  if (!file->open(QIODevice::WriteOnly)) {
-    qLog(Warning) << "Could not open the file" << filepath << "for writing";
-    return;
-  }
 
-  Task* task = new Task(episode, file, backend_);
+  Task* task = new Task(episode, filepath, backend_);
 
   list_tasks_ << task;
-  qLog(Info) << "Downloading" << task->episode().url() << "to" << filepath;
+  qLog(Info) << "Queued" << task->episode().url() << "for" << filepath;
   connect(task, SIGNAL(finished(Task*)), SLOT(ReplyFinished(Task*)));
   connect(task, SIGNAL(ProgressChanged(const PodcastEpisode&,
                                        PodcastDownload::State, int)),
           SIGNAL(ProgressChanged(const PodcastEpisode&,
                                  PodcastDownload::State, int)));
+  emit ProgressChanged(episode, PodcastDownload::Queued, 0);
+
+  StartQueuedTasks();
 }
 
 void PodcastDownloader::ReplyFinished(Task* task) {
   list_tasks_.removeAll(task);
-  delete task;
+  task->deleteLater();
+
+  StartQueuedTasks();
 }
 
 QString PodcastDownloader::SanitiseFilenameComponent(const QString& text)
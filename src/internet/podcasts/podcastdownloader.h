@@ -42,6 +42,7 @@ class Application;
 class PodcastBackend;
 
 class QNetworkAccessManager;
+class QTimer;
 
 namespace PodcastDownload {
   enum State { NotDownloading, Queued, Downloading, Finished };
@@ -50,9 +51,33 @@ namespace PodcastDownload {
 class Task : public QObject {
   Q_OBJECT
 
+  // Downloads one episode into filename.  Data is written to a ".part" file
+  // next to it first, and a download that's stopped or loses its connection
+  // continues from the end of that file with an HTTP Range request.
+
  public:
-  Task(PodcastEpisode episode, QFile* file, PodcastBackend* backend);
+  Task(PodcastEpisode episode, const QString& filename,
+       PodcastBackend* backend);
+  ~Task();
+
+  static const int kMaxRetries;
+  static const int kRetryDelayMsec;
+  static const int kThrottledReadBufferSize;
+
   PodcastEpisode episode() const;
+  const QString& filename() const { return filename_; }
+  bool is_running() const { return repl_ != nullptr; }
+
+  // Starts or resumes the download.  If throttled is set, the data is only
+  // read from the network when Read() is called.
+  void Start(QNetworkAccessManager* network, bool throttled);
+  // Stops the download, keeping what's been downloaded so far.
+  void Pause();
+  void SetThrottled(bool throttled);
+
+  // Writes up to max_bytes of the data that has arrived to the file, or all of
+  // it if max_bytes is -1.  Returns the number of bytes written.
+  qint64 Read(qint64 max_bytes);
 
  signals:
   void ProgressChanged(const PodcastEpisode& episode,
@@ -66,23 +91,43 @@ class Task : public QObject {
   void reading();
   void downloadProgressInternal(qint64 received, qint64 total);
   void finishedInternal();
+  void Retry();
+
+ private:
+  QString PartialFilename() const;
+  bool CheckResponse();
+  void StopReply();
 
  private:
+  QString filename_;
   std::unique_ptr<QFile> file_;
   PodcastEpisode episode_;
-  QNetworkRequest req_;
   PodcastBackend* backend_;
-  std::unique_ptr<NetworkAccessManager> network_;
-  std::unique_ptr<RedirectFollower> repl;
+  QNetworkAccessManager* network_;
+  std::unique_ptr<RedirectFollower> repl_;
+
+  bool throttled_;
+  bool response_checked_;
+  // Bytes that were already in the partial file when this request started.
+  qint64 offset_;
+  int retries_left_;
 };
 
 class PodcastDownloader : public QObject {
   Q_OBJECT
 
+  // Downloads are queued and run up to max_downloads at a time, all sharing
+  // one QNetworkAccessManager.  An optional download speed limit is shared
+  // between the running downloads, and they can be paused while a stream is
+  // playing.
+
  public:
   explicit PodcastDownloader(Application* app, QObject* parent = nullptr);
 
   static const char* kSettingsGroup;
+  static const int kDefaultMaxDownloads;
+  static const int kThrottleIntervalMsec;
+
   PodcastEpisodeList EpisodesDownloading(const PodcastEpisodeList& episodes);
   QString DefaultDownloadDir() const;
 
@@ -103,11 +148,17 @@ class PodcastDownloader : public QObject {
 
   void ReplyFinished(Task* task);
 
+  void PlayerStateChanged();
+  void ThrottleTimeout();
+
  private:
   QString FilenameForEpisode(const QString& directory,
                              const PodcastEpisode& episode) const;
   QString SanitiseFilenameComponent(const QString& text) const;
 
+  bool is_throttled() const { return speed_limit_kbps_ > 0; }
+  void StartQueuedTasks();
+
  private:
   Application* app_;
   PodcastBackend* backend_;
@@ -117,7 +168,14 @@ class PodcastDownloader : public QObject {
 
   bool auto_download_;
   QString download_dir_;
+  int max_downloads_;
+  int speed_limit_kbps_;
+  bool pause_while_streaming_;
+  bool paused_for_stream_;
+
+  QTimer* throttle_timer_;
 
+  // Running and queued tasks, in the order they were added
   QList<Task*> list_tasks_;
 };
 
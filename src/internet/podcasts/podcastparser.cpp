@@ -57,7 +57,8 @@ bool PodcastParser::TryMagic(const QByteArray& data) const {
   return str.contains(QRegExp("<rss\\b")) || str.contains(QRegExp("<opml\\b"));
 }
 
-QVariant PodcastParser::Load(QIODevice* device, const QUrl& url) const {
+QVariant PodcastParser::Load(QIODevice* device, const QUrl& url,
+                             const QSet<QUrl>& known_episodes) const {
   QXmlStreamReader reader(device);
 
   while (!reader.atEnd()) {
@@ -66,7 +67,7 @@ QVariant PodcastParser::Load(QIODevice* device, const QUrl& url) const {
         const QStringRef name = reader.name();
         if (name == "rss") {
           Podcast podcast;
-          if (!ParseRss(&reader, &podcast)) {
+          if (!ParseRss(&reader, known_episodes, &podcast)) {
             return QVariant();
           } else {
             podcast.set_url(url);
@@ -93,16 +94,20 @@ QVariant PodcastParser::Load(QIODevice* device, const QUrl& url) const {
   return QVariant();
 }
 
-bool PodcastParser::ParseRss(QXmlStreamReader* reader, Podcast* ret) const {
+bool PodcastParser::ParseRss(QXmlStreamReader* reader,
+                             const QSet<QUrl>& known_episodes,
+                             Podcast* ret) const {
   if (!Utilities::ParseUntilElement(reader, "channel")) {
     return false;
   }
 
-  ParseChannel(reader, ret);
+  ParseChannel(reader, known_episodes, ret);
   return true;
 }
 
-void PodcastParser::ParseChannel(QXmlStreamReader* reader, Podcast* ret) const {
+void PodcastParser::ParseChannel(QXmlStreamReader* reader,
+                                 const QSet<QUrl>& known_episodes,
+                                 Podcast* ret) const {
   while (!reader->atEnd()) {
     QXmlStreamReader::TokenType type = reader->readNext();
     switch (type) {
@@ -128,7 +133,9 @@ void PodcastParser::ParseChannel(QXmlStreamReader* reader, Podcast* ret) const {
                    reader->attributes().value("rel") == "self") {
           ret->set_url(QUrl::fromEncoded(reader->readElementText().toAscii()));
         } else if (name == "item") {
-          ParseItem(reader, ret);
+          // Everything after the first episode we already have is old too,
+          // so don't bother reading the rest of the document.
+          if (!ParseItem(reader, known_episodes, ret)) return;
         } else {
           Utilities::ConsumeCurrentElement(reader);
         }
@@ -194,7 +201,9 @@ void PodcastParser::ParseItunesOwner(QXmlStreamReader* reader,
   }
 }
 
-void PodcastParser::ParseItem(QXmlStreamReader* reader, Podcast* ret) const {
+bool PodcastParser::ParseItem(QXmlStreamReader* reader,
+                              const QSet<QUrl>& known_episodes,
+                              Podcast* ret) const {
   PodcastEpisode episode;
 
   while (!reader->atEnd()) {
@@ -250,18 +259,22 @@ void PodcastParser::ParseItem(QXmlStreamReader* reader, Podcast* ret) const {
       }
 
       case QXmlStreamReader::EndElement:
+        if (known_episodes.contains(episode.url())) {
+          return false;
+        }
         if (!episode.publication_date().isValid()) {
           episode.set_publication_date(QDateTime::currentDateTime());
         }
         if (!episode.url().isEmpty()) {
           ret->add_episode(episode);
         }
-        return;
+        return true;
 
       default:
         break;
     }
   }
+  return true;
 }
 
 bool PodcastParser::ParseOpml(QXmlStreamReader* reader,
@@ -20,9 +20,11 @@
 #ifndef INTERNET_PODCASTS_PODCASTPARSER_H_
 #define INTERNET_PODCASTS_PODCASTPARSER_H_
 
+#include <QSet>
 #include <QStringList>
 
 #include "podcast.h"
+#include "core/qhash_qurl.h"
 
 class OpmlContainer;
 
@@ -46,18 +48,26 @@ class PodcastParser {
   // You should check the type of the returned QVariant to see whether it
   // contains a Podcast or an OpmlContainer.  If the QVariant isNull then an
   // error occurred parsing the XML.
-  QVariant Load(QIODevice* device, const QUrl& url) const;
+  // Feeds list their newest episodes first, so when refreshing a feed pass the
+  // URLs of the episodes you already have in known_episodes: parsing stops at
+  // the first of them, and the Podcast only contains the episodes before it.
+  QVariant Load(QIODevice* device, const QUrl& url,
+                const QSet<QUrl>& known_episodes = QSet<QUrl>()) const;
 
   // Really quick test to see if some data might be supported.  Load() might
   // still return a null QVariant.
   bool TryMagic(const QByteArray& data) const;
 
  private:
-  bool ParseRss(QXmlStreamReader* reader, Podcast* ret) const;
-  void ParseChannel(QXmlStreamReader* reader, Podcast* ret) const;
+  bool ParseRss(QXmlStreamReader* reader, const QSet<QUrl>& known_episodes,
+                Podcast* ret) const;
+  void ParseChannel(QXmlStreamReader* reader,
+                    const QSet<QUrl>& known_episodes, Podcast* ret) const;
   void ParseImage(QXmlStreamReader* reader, Podcast* ret) const;
   void ParseItunesOwner(QXmlStreamReader* reader, Podcast* ret) const;
-  void ParseItem(QXmlStreamReader* reader, Podcast* ret) const;
+  // Returns false if the item was one of known_episodes.
+  bool ParseItem(QXmlStreamReader* reader, const QSet<QUrl>& known_episodes,
+                 Podcast* ret) const;
 
   bool ParseOpml(QXmlStreamReader* reader, OpmlContainer* ret) const;
   void ParseOutline(QXmlStreamReader* reader, OpmlContainer* ret) const;
@@ -47,6 +47,7 @@
 
 const char* PodcastService::kServiceName = "Podcasts";
 const char* PodcastService::kSettingsGroup = "Podcasts";
+const int PodcastService::kEpisodesPerFetch = 100;
 
 class PodcastSortProxyModel : public QSortFilterProxyModel {
  public:
@@ -168,11 +169,9 @@ void PodcastService::CopyToDevice(const QModelIndexList& episode_indexes,
   }
 
   for (const QModelIndex& podcast : podcast_indexes) {
-    for (int i = 0; i < podcast.model()->rowCount(podcast); ++i) {
-      const QModelIndex& index = podcast.child(i, 0);
-      episode_tmp = index.data(Role_Episode).value<PodcastEpisode>();
-      if (episode_tmp.downloaded() && !episode_tmp.listened())
-        episodes << episode_tmp;
+    for (const PodcastEpisode& episode :
+         ShownEpisodes(podcast.data(Role_Podcast).value<Podcast>())) {
+      if (episode.downloaded() && !episode.listened()) episodes << episode;
     }
   }
   for (const PodcastEpisode& episode : episodes) {
@@ -202,11 +201,7 @@ void PodcastService::CancelDownload(const QModelIndexList& episode_indexes,
   }
 
   for (const QModelIndex& podcast : podcast_indexes) {
-    for (int i = 0; i < podcast.model()->rowCount(podcast); ++i) {
-      const QModelIndex& index = podcast.child(i, 0);
-      episode_tmp = index.data(Role_Episode).value<PodcastEpisode>();
-      episodes << episode_tmp;
-    }
+    episodes << ShownEpisodes(podcast.data(Role_Podcast).value<Podcast>());
   }
   episodes = app_->podcast_downloader()->EpisodesDownloading(episodes);
   app_->podcast_downloader()->cancelDownload(episodes);
@@ -231,13 +226,18 @@ void PodcastService::PopulatePodcastList(QStandardItem* parent) {
     default_icon_ = IconLoader::Load("podcast", IconLoader::Provider);
   }
 
+  const QHash<int, int> unlistened_counts =
+      backend_->GetUnlistenedEpisodeCounts();
   for (const Podcast& podcast : backend_->GetAllSubscriptions()) {
-    parent->appendRow(CreatePodcastItem(podcast));
+    parent->appendRow(CreatePodcastItem(
+        podcast, unlistened_counts.value(podcast.database_id())));
   }
 }
 
 void PodcastService::ClearPodcastList(QStandardItem* parent) {
   parent->removeRows(0, parent->rowCount());
+  podcasts_by_database_id_.clear();
+  episodes_by_database_id_.clear();
 }
 
 void PodcastService::UpdatePodcastText(QStandardItem* item,
@@ -352,33 +352,15 @@ void PodcastService::UpdatePodcastText(QStandardItem* item,
   }
 }
 
-QStandardItem* PodcastService::CreatePodcastItem(const Podcast& podcast) {
+QStandardItem* PodcastService::CreatePodcastItem(const Podcast& podcast,
+                                                 int unlistened_count) {
   QStandardItem* item = new QStandardItem;
 
-  // Add the episodes in this podcast and gather aggregate stats.
-  int unlistened_count = 0;
-  qint64 number = 0;
-  for (const PodcastEpisode& episode :
-       backend_->GetEpisodes(podcast.database_id())) {
-    if (!episode.listened()) {
-      unlistened_count++;
-    }
-
-    if (episode.listened() && hide_listened_) {
-      continue;
-    } else {
-      item->appendRow(CreatePodcastEpisodeItem(episode));
-      ++number;
-    }
-
-    if ((number >= show_episodes_) && (show_episodes_ != 0)) {
-      break;
-    }
-  }
-
   item->setIcon(default_icon_);
   item->setData(Type_Podcast, InternetModel::Role_Type);
   item->setData(QVariant::fromValue(podcast), Role_Podcast);
+  // The episodes are loaded when the podcast is expanded.
+  item->setData(true, InternetModel::Role_CanLazyLoad);
   item->setFlags(Qt::ItemIsEnabled | Qt::ItemIsDragEnabled |
                  Qt::ItemIsSelectable);
   UpdatePodcastText(item, unlistened_count);
@@ -411,6 +393,91 @@ QStandardItem* PodcastService::CreatePodcastEpisodeItem(
   return item;
 }
 
+void PodcastService::FetchMoreEpisodes(QStandardItem* item) {
+  const Podcast podcast = item->data(Role_Podcast).value<Podcast>();
+
+  int limit = kEpisodesPerFetch;
+  if (show_episodes_ > 0) {
+    limit = qMin<qint64>(limit, show_episodes_ - item->rowCount());
+  }
+
+  PodcastEpisodeList episodes;
+  if (limit > 0) {
+    episodes = backend_->GetEpisodes(podcast.database_id(), item->rowCount(),
+                                     limit, hide_listened_);
+  }
+
+  QList<QStandardItem*> items;
+  for (const PodcastEpisode& episode : episodes) {
+    // Episodes that arrived after the podcast was expanded are there already.
+    if (!episodes_by_database_id_.contains(episode.database_id())) {
+      items << CreatePodcastEpisodeItem(episode);
+    }
+  }
+  item->appendRows(items);
+
+  // A short page was the last one.
+  item->setData(limit > 0 && episodes.count() == limit,
+                InternetModel::Role_CanLazyLoad);
+}
+
+PodcastEpisodeList PodcastService::ShownEpisodes(const Podcast& podcast) const {
+  if (!podcast.is_valid()) return PodcastEpisodeList();
+  const int limit = show_episodes_ > 0 ? static_cast<int>(show_episodes_) : -1;
+  return backend_->GetEpisodes(podcast.database_id(), 0, limit, hide_listened_);
+}
+
+void PodcastService::AddEpisodeItem(QStandardItem* parent,
+                                    const PodcastEpisode& episode) {
+  // Podcasts that haven't been expanded yet pick it up when they are.
+  if (parent->rowCount() == 0 &&
+      parent->data(InternetModel::Role_CanLazyLoad).toBool()) {
+    return;
+  }
+  if (hide_listened_ && episode.listened()) return;
+  if (episodes_by_database_id_.contains(episode.database_id())) return;
+
+  parent->appendRow(CreatePodcastEpisodeItem(episode));
+  TrimEpisodeItems(parent);
+}
+
+void PodcastService::RemoveEpisodeItem(QStandardItem* item) {
+  QStandardItem* parent = item->parent();
+  episodes_by_database_id_.remove(
+      item->data(Role_Episode).value<PodcastEpisode>().database_id());
+  parent->removeRow(item->row());
+
+  // There's room for an older episode now.
+  if (show_episodes_ > 0) {
+    parent->setData(true, InternetModel::Role_CanLazyLoad);
+  }
+}
+
+void PodcastService::TrimEpisodeItems(QStandardItem* parent) {
+  // Drop the oldest episodes beyond the number the settings say to show.
+  while (show_episodes_ > 0 && parent->rowCount() > show_episodes_) {
+    int oldest = 0;
+    QDateTime oldest_date;
+    for (int i = 0; i < parent->rowCount(); ++i) {
+      const QDateTime date = parent->child(i)
+                                 ->data(Role_Episode)
+                                 .value<PodcastEpisode>()
+                                 .publication_date();
+      if (i == 0 || date < oldest_date) {
+        oldest = i;
+        oldest_date = date;
+      }
+    }
+    RemoveEpisodeItem(parent->child(oldest));
+  }
+}
+
+void PodcastService::UpdateUnlistenedCount(QStandardItem* item) {
+  const Podcast podcast = item->data(Role_Podcast).value<Podcast>();
+  UpdatePodcastText(item,
+                    backend_->GetUnlistenedEpisodeCount(podcast.database_id()));
+}
+
 void PodcastService::ShowContextMenu(const QPoint& global_pos) {
   if (!context_menu_) {
     context_menu_ = new QMenu;
@@ -593,7 +660,8 @@ void PodcastService::SubscriptionAdded(const Podcast& podcast) {
   // added it.
   QStandardItem* item = podcasts_by_database_id_[podcast.database_id()];
   if (!item) {
-    item = CreatePodcastItem(podcast);
+    item = CreatePodcastItem(
+        podcast, backend_->GetUnlistenedEpisodeCount(podcast.database_id()));
     model_->appendRow(item);
   }
 
@@ -619,63 +687,54 @@ void PodcastService::SubscriptionRemoved(const Podcast& podcast) {
 }
 
 void PodcastService::EpisodesAdded(const PodcastEpisodeList& episodes) {
-  QSet<int> seen_podcast_ids;
+  QSet<QStandardItem*> changed_podcasts;
 
   for (const PodcastEpisode& episode : episodes) {
-    const int database_id = episode.podcast_database_id();
-    QStandardItem* parent = podcasts_by_database_id_[database_id];
+    QStandardItem* parent =
+        podcasts_by_database_id_.value(episode.podcast_database_id());
     if (!parent) continue;
 
-    parent->appendRow(CreatePodcastEpisodeItem(episode));
-    if (!seen_podcast_ids.contains(database_id)) {
-      // Update the unlistened count text once for each podcast
-      int unlistened_count = 0;
-      for (const PodcastEpisode& episode : backend_->GetEpisodes(database_id)) {
-        if (!episode.listened()) {
-          unlistened_count++;
-        }
-      }
+    AddEpisodeItem(parent, episode);
+    changed_podcasts.insert(parent);
+  }
 
-      UpdatePodcastText(parent, unlistened_count);
-      seen_podcast_ids.insert(database_id);
-    }
-    const Podcast podcast = parent->data(Role_Podcast).value<Podcast>();
-    ReloadPodcast(podcast);
+  // Update the unlistened count text once for each podcast
+  for (QStandardItem* parent : changed_podcasts) {
+    UpdateUnlistenedCount(parent);
   }
 }
 
 void PodcastService::EpisodesUpdated(const PodcastEpisodeList& episodes) {
-  QSet<int> seen_podcast_ids;
-  QMap<int, Podcast> podcasts_map;
+  QSet<QStandardItem*> changed_podcasts;
 
   for (const PodcastEpisode& episode : episodes) {
-    const int podcast_database_id = episode.podcast_database_id();
-    QStandardItem* item = episodes_by_database_id_[episode.database_id()];
-    QStandardItem* parent = podcasts_by_database_id_[podcast_database_id];
-    if (!item || !parent) continue;
-    // Update the episode data on the item, and update the item's text.
-    item->setData(QVariant::fromValue(episode), Role_Episode);
-    UpdateEpisodeText(item);
+    QStandardItem* parent =
+        podcasts_by_database_id_.value(episode.podcast_database_id());
+    if (!parent) continue;
+    changed_podcasts.insert(parent);
 
-    // Update the parent podcast's text too.
-    if (!seen_podcast_ids.contains(podcast_database_id)) {
-      // Update the unlistened count text once for each podcast
-      int unlistened_count = 0;
-      for (const PodcastEpisode& episode :
-           backend_->GetEpisodes(podcast_database_id)) {
-        if (!episode.listened()) {
-          unlistened_count++;
-        }
+    QStandardItem* item = episodes_by_database_id_.value(episode.database_id());
+    if (!item) {
+      // Hidden episodes come back when they're marked as new.
+      if (hide_listened_ && !episode.listened()) {
+        AddEpisodeItem(parent, episode);
       }
+      continue;
+    }
 
-      UpdatePodcastText(parent, unlistened_count);
-      seen_podcast_ids.insert(podcast_database_id);
+    if (hide_listened_ && episode.listened()) {
+      RemoveEpisodeItem(item);
+      continue;
     }
-    const Podcast podcast = parent->data(Role_Podcast).value<Podcast>();
-    podcasts_map[podcast.database_id()] = podcast;
+
+    // Update the episode data on the item, and update the item's text.
+    item->setData(QVariant::fromValue(episode), Role_Episode);
+    UpdateEpisodeText(item);
   }
-  for (const Podcast& podcast_tmp : podcasts_map.values()) {
-    ReloadPodcast(podcast_tmp);
+
+  // Update the unlistened count text once for each podcast
+  for (QStandardItem* parent : changed_podcasts) {
+    UpdateUnlistenedCount(parent);
   }
 }
 
@@ -696,12 +755,13 @@ void PodcastService::DeleteDownloadedData() {
 void PodcastService::DownloadProgressChanged(const PodcastEpisode& episode,
                                              PodcastDownload::State state,
                                              int percent) {
-  QStandardItem* item = episodes_by_database_id_[episode.database_id()];
-  QStandardItem* item2 = podcasts_by_database_id_[episode.podcast_database_id()];
-  if (!item || !item2) return;
+  // The episode might not have been loaded into the model.
+  QStandardItem* item = episodes_by_database_id_.value(episode.database_id());
+  QStandardItem* item2 =
+      podcasts_by_database_id_.value(episode.podcast_database_id());
 
-  UpdateEpisodeText(item, state, percent);
-  UpdatePodcastText(item2, state, percent);
+  if (item) UpdateEpisodeText(item, state, percent);
+  if (item2) UpdatePodcastText(item2, state, percent);
 }
 
 void PodcastService::ShowConfig() {
@@ -765,10 +825,7 @@ void PodcastService::SetListened(const QModelIndexList& episode_indexes,
   }
 
   for (const QModelIndex& podcast : podcast_indexes) {
-    for (int i = 0; i < podcast.model()->rowCount(podcast); ++i) {
-      const QModelIndex& index = podcast.child(i, 0);
-      episodes << index.data(Role_Episode).value<PodcastEpisode>();
-    }
+    episodes << ShownEpisodes(podcast.data(Role_Podcast).value<Podcast>());
   }
 
   // Update each one with the new state and maybe the listened time.
@@ -815,13 +872,3 @@ void PodcastService::SubscribeAndShow(const QVariant& podcast_or_opml) {
     add_podcast_dialog_->ShowWithOpml(podcast_or_opml.value<OpmlContainer>());
   }
 }
-
-void PodcastService::ReloadPodcast(const Podcast& podcast) {
-  if (!(hide_listened_ || (show_episodes_ > 0))) {
-    return;
-  }
-  QStandardItem* item = podcasts_by_database_id_[podcast.database_id()];
-
-  model_->invisibleRootItem()->removeRow(item->row());
-  model_->invisibleRootItem()->appendRow(CreatePodcastItem(podcast));
-}
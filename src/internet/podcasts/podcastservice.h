@@ -47,6 +47,8 @@ class PodcastService : public InternetService {
 
   static const char* kServiceName;
   static const char* kSettingsGroup;
+  // How many episodes a podcast loads at a time when it's expanded.
+  static const int kEpisodesPerFetch;
 
   enum Type {
     Type_AddPodcast = InternetModel::TypeCount,
@@ -67,13 +69,17 @@ class PodcastService : public InternetService {
   // contains an OPML file then this displays it in the Add Podcast dialog.
   void SubscribeAndShow(const QVariant& podcast_or_opml);
 
+  // Adds the next page of a podcast's episodes to its item.
+  void FetchMoreEpisodes(QStandardItem* item);
+  // Returns the episodes a podcast's item shows once they're all loaded.
+  PodcastEpisodeList ShownEpisodes(const Podcast& podcast) const;
+
  public slots:
   void AddPodcast();
   void FileCopied(int database_id);
 
  private slots:
   void UpdateSelectedPodcast();
-  void ReloadPodcast(const Podcast& podcast);
   void RemoveSelectedPodcast();
   void DownloadSelectedEpisode();
   void DeleteDownloadedData();
@@ -115,8 +121,13 @@ class PodcastService : public InternetService {
       PodcastDownload::State state = PodcastDownload::NotDownloading,
       int percent = 0);
 
-  QStandardItem* CreatePodcastItem(const Podcast& podcast);
+  QStandardItem* CreatePodcastItem(const Podcast& podcast,
+                                   int unlistened_count);
   QStandardItem* CreatePodcastEpisodeItem(const PodcastEpisode& episode);
+  void AddEpisodeItem(QStandardItem* parent, const PodcastEpisode& episode);
+  void RemoveEpisodeItem(QStandardItem* item);
+  void TrimEpisodeItems(QStandardItem* parent);
+  void UpdateUnlistenedCount(QStandardItem* item);
 
   QModelIndex MapToMergedModel(const QModelIndex& index) const;
 
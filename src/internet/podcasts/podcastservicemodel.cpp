@@ -21,8 +21,22 @@
 #include "internet/podcasts/podcastservicemodel.h"
 #include "playlist/songmimedata.h"
 
-PodcastServiceModel::PodcastServiceModel(QObject* parent)
-    : QStandardItemModel(parent) {}
+PodcastServiceModel::PodcastServiceModel(PodcastService* service)
+    : QStandardItemModel(service), service_(service) {}
+
+bool PodcastServiceModel::hasChildren(const QModelIndex& parent) const {
+  if (parent.data(InternetModel::Role_CanLazyLoad).toBool()) return true;
+  return QStandardItemModel::hasChildren(parent);
+}
+
+bool PodcastServiceModel::canFetchMore(const QModelIndex& parent) const {
+  return parent.data(InternetModel::Role_CanLazyLoad).toBool();
+}
+
+void PodcastServiceModel::fetchMore(const QModelIndex& parent) {
+  if (!canFetchMore(parent)) return;
+  service_->FetchMoreEpisodes(itemFromIndex(parent));
+}
 
 QMimeData* PodcastServiceModel::mimeData(const QModelIndexList& indexes) const {
   SongMimeData* data = new SongMimeData;
@@ -75,14 +89,9 @@ void PodcastServiceModel::MimeDataForPodcast(const QModelIndex& index,
     podcast = podcast_variant.value<Podcast>();
   }
 
-  // Add each child episode
-  const int children = index.model()->rowCount(index);
-  for (int i = 0; i < children; ++i) {
-    QVariant episode_variant =
-        index.child(i, 0).data(PodcastService::Role_Episode);
-    if (!episode_variant.isValid()) continue;
-
-    PodcastEpisode episode(episode_variant.value<PodcastEpisode>());
+  // Add each episode it shows, including the ones that haven't been loaded
+  // into the model yet.
+  for (const PodcastEpisode& episode : service_->ShownEpisodes(podcast)) {
     Song song = episode.ToSong(podcast);
 
     data->songs << song;
@@ -22,21 +22,30 @@
 
 #include <QStandardItemModel>
 
+class PodcastService;
 class SongMimeData;
 
 class PodcastServiceModel : public QStandardItemModel {
   Q_OBJECT
 
  public:
-  explicit PodcastServiceModel(QObject* parent = nullptr);
+  explicit PodcastServiceModel(PodcastService* service);
 
   QMimeData* mimeData(const QModelIndexList& indexes) const;
 
+  // Podcasts load their episodes a page at a time when they're expanded.
+  bool hasChildren(const QModelIndex& parent = QModelIndex()) const;
+  bool canFetchMore(const QModelIndex& parent) const;
+  void fetchMore(const QModelIndex& parent);
+
  private:
   void MimeDataForPodcast(const QModelIndex& index, SongMimeData* data,
                           QList<QUrl>* urls) const;
   void MimeDataForEpisode(const QModelIndex& index, SongMimeData* data,
                           QList<QUrl>* urls) const;
+
+ private:
+  PodcastService* service_;
 };
 
 #endif  // INTERNET_PODCASTS_PODCASTSERVICEMODEL_H_
@@ -78,6 +78,13 @@ void PodcastSettingsPage::Load() {
       s.value("download_dir", default_download_dir).toString()));
 
   ui_->auto_download->setChecked(s.value("auto_download", false).toBool());
+  ui_->max_downloads->setValue(
+      s.value("max_downloads", PodcastDownloader::kDefaultMaxDownloads)
+          .toInt());
+  ui_->download_speed_limit->setValue(
+      s.value("download_speed_limit_kbps", 0).toInt());
+  ui_->pause_while_streaming->setChecked(
+      s.value("pause_while_streaming", false).toBool());
   ui_->hide_listened->setChecked(s.value("hide_listened", false).toBool());
   ui_->delete_after->setValue(s.value("delete_after", 0).toInt() / kSecsPerDay);
   ui_->show_episodes->setValue(s.value("show_episodes", 0).toInt());
@@ -103,6 +110,9 @@ void PodcastSettingsPage::Save() {
   s.setValue("download_dir",
              QDir::fromNativeSeparators(ui_->download_dir->text()));
   s.setValue("auto_download", ui_->auto_download->isChecked());
+  s.setValue("max_downloads", ui_->max_downloads->value());
+  s.setValue("download_speed_limit_kbps", ui_->download_speed_limit->value());
+  s.setValue("pause_while_streaming", ui_->pause_while_streaming->isChecked());
   s.setValue("hide_listened", ui_->hide_listened->isChecked());
   s.setValue("delete_after", ui_->delete_after->value() * kSecsPerDay);
   s.setValue("show_episodes", ui_->show_episodes->value());
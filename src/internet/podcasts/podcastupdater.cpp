@@ -31,6 +31,14 @@
 #include "podcasturlloader.h"
 
 const char* PodcastUpdater::kSettingsGroup = "Podcasts";
+const int PodcastUpdater::kMaxConcurrentUpdates = 6;
+
+namespace {
+// Cache validators from the last time each feed was fetched, kept in the
+// podcast's extra data.
+const char* kEtagKey = "http_etag";
+const char* kLastModifiedKey = "http_last_modified";
+}  // namespace
 
 PodcastUpdater::PodcastUpdater(Application* app, QObject* parent)
     : QObject(parent),
@@ -38,7 +46,8 @@ PodcastUpdater::PodcastUpdater(Application* app, QObject* parent)
       update_interval_secs_(0),
       update_timer_(new QTimer(this)),
       loader_(new PodcastUrlLoader(this)),
-      pending_replies_(0) {
+      pending_replies_(0),
+      active_replies_(0) {
   connect(app_, SIGNAL(SettingsChanged()), SLOT(ReloadSettings()));
   connect(update_timer_, SIGNAL(timeout()), SLOT(UpdateAllPodcastsNow()));
   connect(app_->podcast_backend(), SIGNAL(SubscriptionAdded(Podcast)),
@@ -108,70 +117,139 @@ void PodcastUpdater::SubscriptionAdded(const Podcast& podcast) {
 }
 
 void PodcastUpdater::UpdatePodcastNow(const Podcast& podcast) {
-  PodcastUrlLoaderReply* reply = loader_->Load(podcast.url());
-  NewClosure(reply, SIGNAL(Finished(bool)), this,
-             SLOT(PodcastLoaded(PodcastUrlLoaderReply*, Podcast, bool)), reply,
-             podcast, false);
+  StartUpdate(podcast, false);
 }
 
 void PodcastUpdater::UpdateAllPodcastsNow() {
+  if (pending_replies_ > 0) {
+    // The last update hasn't finished yet.
+    return;
+  }
+
+  // Read every episode URL up front, rather than once per podcast as each
+  // reply arrives.
+  known_episodes_ = app_->podcast_backend()->GetAllEpisodeUrls();
+
   for (const Podcast& podcast :
        app_->podcast_backend()->GetAllSubscriptions()) {
-    PodcastUrlLoaderReply* reply = loader_->Load(podcast.url());
-    NewClosure(reply, SIGNAL(Finished(bool)), this,
-               SLOT(PodcastLoaded(PodcastUrlLoaderReply*, Podcast, bool)),
-               reply, podcast, true);
-
+    queued_podcasts_.enqueue(podcast);
     pending_replies_++;
   }
+
+  StartQueuedUpdates();
+}
+
+void PodcastUpdater::StartQueuedUpdates() {
+  while (active_replies_ < kMaxConcurrentUpdates &&
+         !queued_podcasts_.isEmpty()) {
+    StartUpdate(queued_podcasts_.dequeue(), true);
+  }
+}
+
+void PodcastUpdater::StartUpdate(const Podcast& podcast, bool one_of_many) {
+  PodcastUrlLoaderReply* reply;
+  if (one_of_many) {
+    // Only ask for the feed if it changed, and only parse the new episodes.
+    reply = loader_->Load(podcast.url(), podcast.extra(kEtagKey).toByteArray(),
+                          podcast.extra(kLastModifiedKey).toByteArray(),
+                          known_episodes_.value(podcast.database_id()));
+    active_replies_++;
+  } else {
+    reply = loader_->Load(podcast.url());
+  }
+
+  NewClosure(reply, SIGNAL(Finished(bool)), this,
+             SLOT(PodcastLoaded(PodcastUrlLoaderReply*, Podcast, bool)), reply,
+             podcast, one_of_many);
+}
+
+void PodcastUpdater::FinishFullUpdate() {
+  // Add everything in one transaction, so the GUI only has to update once.
+  if (!new_episodes_.isEmpty()) {
+    app_->podcast_backend()->AddEpisodes(&new_episodes_);
+  }
+  app_->podcast_backend()->UpdateFeedStates(updated_podcasts_);
+
+  qLog(Info) << "Added" << new_episodes_.count() << "new episodes for"
+             << updated_podcasts_.count() << "podcasts";
+
+  new_episodes_.clear();
+  updated_podcasts_.clear();
+  known_episodes_.clear();
+
+  // Save this time as being the last sucessful update and restart the timer.
+  last_full_update_ = QDateTime::currentDateTime();
+  SaveSettings();
+  RestartTimer();
 }
 
 void PodcastUpdater::PodcastLoaded(PodcastUrlLoaderReply* reply,
                                    const Podcast& podcast, bool one_of_many) {
   reply->deleteLater();
 
-  if (one_of_many) {
-    if (--pending_replies_ == 0) {
-      // This was the last reply we were waiting for.  Save this time as being
-      // the last sucessful update and restart the timer.
-      last_full_update_ = QDateTime::currentDateTime();
-      SaveSettings();
-      RestartTimer();
-    }
-  }
+  Podcast updated_podcast(podcast);
+  updated_podcast.set_last_updated(QDateTime::currentDateTime());
+  updated_podcast.set_last_update_error(reply->error_text());
+
+  PodcastEpisodeList new_episodes;
 
   if (!reply->is_success()) {
     qLog(Warning) << "Error fetching podcast at" << podcast.url() << ":"
                   << reply->error_text();
-    return;
-  }
-
-  if (reply->result_type() != PodcastUrlLoaderReply::Type_Podcast) {
+  } else if (reply->result_type() == PodcastUrlLoaderReply::Type_NotModified) {
+    qLog(Debug) << "Podcast at" << podcast.url() << "hasn't changed";
+  } else if (reply->result_type() != PodcastUrlLoaderReply::Type_Podcast) {
     qLog(Warning) << "The URL" << podcast.url()
                   << "no longer contains a podcast";
-    return;
-  }
+  } else {
+    updated_podcast.set_extra(kEtagKey, reply->etag());
+    updated_podcast.set_extra(kLastModifiedKey, reply->last_modified());
+
+    // Get the episode URLs we had for this podcast already.
+    QSet<QUrl> existing_urls;
+    if (one_of_many) {
+      existing_urls = known_episodes_.take(podcast.database_id());
+    } else {
+      for (const PodcastEpisode& episode :
+           app_->podcast_backend()->GetEpisodes(podcast.database_id())) {
+        existing_urls.insert(episode.url());
+      }
+    }
 
-  // Get the episode URLs we had for this podcast already.
-  QSet<QUrl> existing_urls;
-  for (const PodcastEpisode& episode :
-       app_->podcast_backend()->GetEpisodes(podcast.database_id())) {
-    existing_urls.insert(episode.url());
+    // Add any new episodes
+    for (const Podcast& reply_podcast : reply->podcast_results()) {
+      for (const PodcastEpisode& episode : reply_podcast.episodes()) {
+        if (!existing_urls.contains(episode.url())) {
+          PodcastEpisode episode_copy(episode);
+          episode_copy.set_podcast_database_id(podcast.database_id());
+          new_episodes.append(episode_copy);
+          existing_urls.insert(episode.url());
+        }
+      }
+    }
   }
 
-  // Add any new episodes
-  PodcastEpisodeList new_episodes;
-  for (const Podcast& reply_podcast : reply->podcast_results()) {
-    for (const PodcastEpisode& episode : reply_podcast.episodes()) {
-      if (!existing_urls.contains(episode.url())) {
-        PodcastEpisode episode_copy(episode);
-        episode_copy.set_podcast_database_id(podcast.database_id());
-        new_episodes.append(episode_copy);
-      }
+  if (!one_of_many) {
+    if (!new_episodes.isEmpty()) {
+      app_->podcast_backend()->AddEpisodes(&new_episodes);
+    }
+    if (updated_podcast.is_valid()) {
+      app_->podcast_backend()->UpdateFeedStates(PodcastList()
+                                                << updated_podcast);
     }
+    qLog(Info) << "Added" << new_episodes.count() << "new episodes for"
+               << podcast.url();
+    return;
   }
 
-  app_->podcast_backend()->AddEpisodes(&new_episodes);
-  qLog(Info) << "Added" << new_episodes.count() << "new episodes for"
-             << podcast.url();
+  new_episodes_.append(new_episodes);
+  updated_podcasts_.append(updated_podcast);
+
+  active_replies_--;
+  if (--pending_replies_ == 0) {
+    // This was the last reply we were waiting for.
+    FinishFullUpdate();
+  } else {
+    StartQueuedUpdates();
+  }
 }
@@ -21,10 +21,15 @@
 #define INTERNET_PODCASTS_PODCASTUPDATER_H_
 
 #include <QDateTime>
+#include <QHash>
 #include <QObject>
+#include <QQueue>
+#include <QSet>
+
+#include "podcast.h"
+#include "core/qhash_qurl.h"
 
 class Application;
-class Podcast;
 class PodcastUrlLoader;
 class PodcastUrlLoaderReply;
 
@@ -39,6 +44,7 @@ class PodcastUpdater : public QObject {
   explicit PodcastUpdater(Application* app, QObject* parent = nullptr);
 
   static const char* kSettingsGroup;
+  static const int kMaxConcurrentUpdates;
 
  public slots:
   void UpdateAllPodcastsNow();
@@ -55,6 +61,10 @@ class PodcastUpdater : public QObject {
   void RestartTimer();
   void SaveSettings();
 
+  void StartUpdate(const Podcast& podcast, bool one_of_many);
+  void StartQueuedUpdates();
+  void FinishFullUpdate();
+
  private:
   Application* app_;
 
@@ -64,6 +74,14 @@ class PodcastUpdater : public QObject {
   QTimer* update_timer_;
   PodcastUrlLoader* loader_;
   int pending_replies_;
+
+  // A full update only fetches kMaxConcurrentUpdates feeds at once, and adds
+  // everything it finds to the database together at the end.
+  QQueue<Podcast> queued_podcasts_;
+  int active_replies_;
+  QHash<int, QSet<QUrl>> known_episodes_;
+  PodcastEpisodeList new_episodes_;
+  PodcastList updated_podcasts_;
 };
 
 #endif  // INTERNET_PODCASTS_PODCASTUPDATER_H_
@@ -31,7 +31,7 @@ const int PodcastUrlLoader::kMaxRedirects = 5;
 
 PodcastUrlLoader::PodcastUrlLoader(QObject* parent)
     : QObject(parent),
-      network_(new NetworkAccessManager(this)),
+      network_(NetworkAccessManager::Shared()),
       parser_(new PodcastParser),
       html_link_re_("<link (.*)>"),
       html_link_rel_re_("rel\\s*=\\s*['\"]?\\s*alternate"),
@@ -91,6 +91,12 @@ PodcastUrlLoaderReply* PodcastUrlLoader::Load(const QString& url_text) {
 }
 
 PodcastUrlLoaderReply* PodcastUrlLoader::Load(const QUrl& url) {
+  return Load(url, QByteArray(), QByteArray(), QSet<QUrl>());
+}
+
+PodcastUrlLoaderReply* PodcastUrlLoader::Load(
+    const QUrl& url, const QByteArray& etag, const QByteArray& last_modified,
+    const QSet<QUrl>& known_episodes) {
   // Create a reply
   PodcastUrlLoaderReply* reply = new PodcastUrlLoaderReply(url, this);
 
@@ -98,6 +104,9 @@ PodcastUrlLoaderReply* PodcastUrlLoader::Load(const QUrl& url) {
   RequestState* state = new RequestState;
   state->redirects_remaining_ = kMaxRedirects + 1;
   state->reply_ = reply;
+  state->etag_ = etag;
+  state->last_modified_ = last_modified;
+  state->known_episodes_ = known_episodes;
 
   // Start the first request
   NextRequest(url, state);
@@ -123,6 +132,12 @@ void PodcastUrlLoader::NextRequest(const QUrl& url, RequestState* state) {
   QNetworkRequest req(url);
   req.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
                    QNetworkRequest::AlwaysNetwork);
+  if (!state->etag_.isEmpty()) {
+    req.setRawHeader("If-None-Match", state->etag_);
+  }
+  if (!state->last_modified_.isEmpty()) {
+    req.setRawHeader("If-Modified-Since", state->last_modified_);
+  }
   QNetworkReply* network_reply = network_->get(req);
 
   NewClosure(network_reply, SIGNAL(finished()), this,
@@ -150,6 +165,12 @@ void PodcastUrlLoader::RequestFinished(RequestState* state,
 
   const QVariant http_status =
       reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+  if (http_status.toInt() == 304) {
+    state->reply_->set_validators(state->etag_, state->last_modified_);
+    state->reply_->SetNotModified();
+    delete state;
+    return;
+  }
   if (http_status.isValid() && http_status.toInt() != 200) {
     SendErrorAndDelete(
         QString("HTTP %1: %2")
@@ -165,7 +186,10 @@ void PodcastUrlLoader::RequestFinished(RequestState* state,
   const QString content_type =
       reply->header(QNetworkRequest::ContentTypeHeader).toString();
   if (parser_->SupportsContentType(content_type)) {
-    const QVariant ret = parser_->Load(reply, reply->url());
+    const QVariant ret =
+        parser_->Load(reply, reply->url(), state->known_episodes_);
+    state->reply_->set_validators(reply->rawHeader("ETag"),
+                                  reply->rawHeader("Last-Modified"));
 
     if (ret.canConvert<Podcast>()) {
       state->reply_->SetFinished(PodcastList() << ret.value<Podcast>());
@@ -226,6 +250,12 @@ void PodcastUrlLoaderReply::SetFinished(const OpmlContainer& results) {
   emit Finished(true);
 }
 
+void PodcastUrlLoaderReply::SetNotModified() {
+  result_type_ = Type_NotModified;
+  finished_ = true;
+  emit Finished(true);
+}
+
 void PodcastUrlLoaderReply::SetFinished(const QString& error_text) {
   error_text_ = error_text;
   finished_ = true;
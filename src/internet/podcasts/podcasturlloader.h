@@ -22,9 +22,11 @@
 
 #include <QObject>
 #include <QRegExp>
+#include <QSet>
 
 #include "opmlcontainer.h"
 #include "podcast.h"
+#include "core/qhash_qurl.h"
 
 class PodcastParser;
 
@@ -37,7 +39,9 @@ class PodcastUrlLoaderReply : public QObject {
  public:
   PodcastUrlLoaderReply(const QUrl& url, QObject* parent);
 
-  enum ResultType { Type_Podcast, Type_Opml };
+  // Type_NotModified is only returned by conditional loads, when the server
+  // says the feed hasn't changed since it was last fetched.
+  enum ResultType { Type_Podcast, Type_Opml, Type_NotModified };
 
   const QUrl& url() const { return url_; }
   bool is_finished() const { return finished_; }
@@ -48,9 +52,20 @@ class PodcastUrlLoaderReply : public QObject {
   const PodcastList& podcast_results() const { return podcast_results_; }
   const OpmlContainer& opml_results() const { return opml_results_; }
 
+  // The cache validators the server sent with the feed, to pass to the next
+  // conditional load.
+  const QByteArray& etag() const { return etag_; }
+  const QByteArray& last_modified() const { return last_modified_; }
+  void set_validators(const QByteArray& etag,
+                      const QByteArray& last_modified) {
+    etag_ = etag;
+    last_modified_ = last_modified;
+  }
+
   void SetFinished(const QString& error_text);
   void SetFinished(const PodcastList& results);
   void SetFinished(const OpmlContainer& results);
+  void SetNotModified();
 
  signals:
   void Finished(bool success);
@@ -63,6 +78,9 @@ class PodcastUrlLoaderReply : public QObject {
   ResultType result_type_;
   PodcastList podcast_results_;
   OpmlContainer opml_results_;
+
+  QByteArray etag_;
+  QByteArray last_modified_;
 };
 
 class PodcastUrlLoader : public QObject {
@@ -77,6 +95,13 @@ class PodcastUrlLoader : public QObject {
   PodcastUrlLoaderReply* Load(const QString& url_text);
   PodcastUrlLoaderReply* Load(const QUrl& url);
 
+  // Reloads a feed that was loaded before.  The request is conditional on
+  // the etag and last_modified validators from the last reply, and only
+  // episodes newer than the first of known_episodes in the feed are parsed.
+  PodcastUrlLoaderReply* Load(const QUrl& url, const QByteArray& etag,
+                              const QByteArray& last_modified,
+                              const QSet<QUrl>& known_episodes);
+
   // Both the FixPodcastUrl functions replace common podcatcher URL schemes
   // like itpc:// or zune:// with their http:// equivalents.  The QString
   // overload also cleans up user-entered text a bit - stripping whitespace and
@@ -88,6 +113,10 @@ class PodcastUrlLoader : public QObject {
   struct RequestState {
     int redirects_remaining_;
     PodcastUrlLoaderReply* reply_;
+
+    QByteArray etag_;
+    QByteArray last_modified_;
+    QSet<QUrl> known_episodes_;
   };
 
   typedef QPair<QString, QString> QuickPrefix;
@@ -48,6 +48,7 @@ static const char* kFileUrl = "/api2/repos/%1/file/";
 static const char* kFileContentUrl = "/api2/repos/%1/file/detail/";
 
 static const int kMaxTries = 10;
+static const int kMaxConcurrentListings = 4;
 }  // namespace
 
 SeafileService::SeafileService(Application* app, InternetModel* parent)
@@ -57,6 +58,8 @@ SeafileService::SeafileService(Application* app, InternetModel* parent)
       indexing_task_id_(-1),
       indexing_task_max_(0),
       indexing_task_progress_(0),
+      running_listings_(0),
+      listing_failed_(false),
       changing_libary_(false) {
   QSettings s;
   s.beginGroup(kSettingsGroup);
@@ -70,6 +73,12 @@ SeafileService::SeafileService(Application* app, InternetModel* parent)
     stream >> tree_;
   }
 
+  QByteArray roots_bytes = s.value("library_roots").toByteArray();
+  if (!roots_bytes.isEmpty()) {
+    QDataStream stream(&roots_bytes, QIODevice::ReadOnly);
+    stream >> library_roots_;
+  }
+
   app->player()->RegisterUrlHandler(new SeafileUrlHandler(this, this));
 
   connect(&tree_, SIGNAL(ToAdd(QString, QString, SeafileTree::Entry)), this,
@@ -95,8 +104,10 @@ void SeafileService::ForgetCredentials() {
 
   s.remove("access_token");
   s.remove("tree");
+  s.remove("library_roots");
   access_token_.clear();
   tree_.Clear();
+  library_roots_.clear();
 
   server_.clear();
 }
@@ -161,6 +172,7 @@ void SeafileService::GetLibrariesFinished(QNetworkReply* reply) {
 
   // key : id, value : name
   QMap<QString, QString> libraries;
+  server_roots_.clear();
   QByteArray data = reply->readAll();
   QJson::Parser parser;
   QList<QVariant> repos = parser.parse(data).toList();
@@ -174,6 +186,7 @@ void SeafileService::GetLibrariesFinished(QNetworkReply* reply) {
     // (not supported yet)
     if (!libraries.contains(repo_id) && !repo["encrypted"].toBool()) {
       libraries.insert(repo_id, repo_name);
+      server_roots_.insert(repo_id, repo["root"].toString());
     }
   }
 
@@ -211,6 +224,7 @@ void SeafileService::ChangeLibrary(const QString& new_library) {
 
 void SeafileService::Connect() {
   if (has_credentials()) {
+    ResumeIndexing(QString("Token %1").arg(access_token_));
     UpdateLibraries();
   } else {
     ShowSettingsDialog();
@@ -225,6 +239,10 @@ void SeafileService::UpdateLibraries() {
 
   indexing_task_id_ =
       app_->task_manager()->StartTask(tr("Building Seafile index..."));
+  indexing_task_max_ = 0;
+  indexing_task_progress_ = 0;
+  listing_failed_ = false;
+  libraries_checked_.clear();
 
   connect(this, SIGNAL(GetLibrariesFinishedSignal(QMap<QString, QString>)),
           this, SLOT(UpdateLibrariesInProgress(QMap<QString, QString>)));
@@ -264,6 +282,14 @@ void SeafileService::UpdateLibrariesInProgress(
 
     // Need to check this library ?
     if (library_to_update == "all" || library.key() == library_to_update) {
+      // Nothing in it has changed since the last update
+      const QString root = server_roots_.value(library.key());
+      if (!root.isEmpty() && root == library_roots_.value(library.key()) &&
+          tree_.FindLibrary(library.key())) {
+        continue;
+      }
+
+      libraries_checked_ << library.key();
       FetchAndCheckFolderItems(
           SeafileTree::Entry(library.value(), library.key(),
                              SeafileTree::Entry::LIBRARY),
@@ -280,9 +306,7 @@ void SeafileService::UpdateLibrariesInProgress(
 
   // If we didn't do anything, set the task finished
   if (indexing_task_max_ == 0) {
-    app_->task_manager()->SetTaskFinished(indexing_task_id_);
-    indexing_task_id_ = -1;
-    UpdatingLibrariesFinishedSignal();
+    FinishUpdatingLibraries();
   }
 }
 
@@ -299,20 +323,25 @@ QNetworkReply* SeafileService::PrepareFetchFolderItems(const QString& library,
 }
 
 void SeafileService::FetchAndCheckFolderItems(const SeafileTree::Entry& library,
-                                              const QString& path) {
+                                              const QString& path,
+                                              const QString& dir_id) {
   StartTaskInProgress();
 
-  QNetworkReply* reply = PrepareFetchFolderItems(library.id(), path);
-  NewClosure(reply, SIGNAL(finished()), this,
-             SLOT(FetchAndCheckFolderItemsFinished(
-                 QNetworkReply*, SeafileTree::Entry, QString)),
-             reply, library, path);
+  FolderListing listing;
+  listing.library_ = library;
+  listing.path_ = path;
+  listing.dir_id_ = dir_id;
+  listing.add_recursively_ = false;
+  QueueFolderListing(listing);
 }
 
 void SeafileService::FetchAndCheckFolderItemsFinished(
     QNetworkReply* reply, const SeafileTree::Entry& library,
-    const QString& path) {
-  if (!CheckReply(&reply)) {
+    const QString& path, const QString& dir_id) {
+  const bool success = CheckReply(&reply);
+  FolderListingFinished(success);
+
+  if (!success) {
     qLog(Warning)
         << "Something wrong with the reply... (FetchFolderItemsToList)";
     FinishedTaskInProgress();
@@ -347,6 +376,17 @@ void SeafileService::FetchAndCheckFolderItemsFinished(
 
   tree_.CheckEntries(entries, library, path);
 
+  // The directory is up to date now
+  if (!dir_id.isEmpty()) {
+    SeafileTree::TreeItem* item =
+        tree_.FindFromAbsolutePath(library.id(), path);
+    if (item) {
+      SeafileTree::Entry entry = item->entry();
+      entry.set_id(dir_id);
+      item->set_entry(entry);
+    }
+  }
+
   FinishedTaskInProgress();
 }
 
@@ -354,17 +394,21 @@ void SeafileService::AddRecursivelyFolderItems(const QString& library,
                                                const QString& path) {
   StartTaskInProgress();
 
-  QNetworkReply* reply = PrepareFetchFolderItems(library, path);
-  NewClosure(
-      reply, SIGNAL(finished()), this,
-      SLOT(AddRecursivelyFolderItemsFinished(QNetworkReply*, QString, QString)),
-      reply, library, path);
+  FolderListing listing;
+  listing.library_ =
+      SeafileTree::Entry("", library, SeafileTree::Entry::LIBRARY);
+  listing.path_ = path;
+  listing.add_recursively_ = true;
+  QueueFolderListing(listing);
 }
 
 void SeafileService::AddRecursivelyFolderItemsFinished(QNetworkReply* reply,
                                                        const QString& library,
                                                        const QString& path) {
-  if (!CheckReply(&reply)) {
+  const bool success = CheckReply(&reply);
+  FolderListingFinished(success);
+
+  if (!success) {
     qLog(Warning) << "Something wrong with the reply... (FetchFolderItems)";
     FinishedTaskInProgress();
     return;
@@ -409,6 +453,39 @@ void SeafileService::AddRecursivelyFolderItemsFinished(QNetworkReply* reply,
   FinishedTaskInProgress();
 }
 
+void SeafileService::QueueFolderListing(const FolderListing& listing) {
+  queued_listings_.enqueue(listing);
+  StartQueuedListings();
+}
+
+void SeafileService::StartQueuedListings() {
+  while (running_listings_ < kMaxConcurrentListings &&
+         !queued_listings_.isEmpty()) {
+    const FolderListing listing = queued_listings_.dequeue();
+    const QString library = listing.library_.id();
+    running_listings_++;
+
+    QNetworkReply* reply = PrepareFetchFolderItems(library, listing.path_);
+    if (listing.add_recursively_) {
+      NewClosure(reply, SIGNAL(finished()), this,
+                 SLOT(AddRecursivelyFolderItemsFinished(QNetworkReply*,
+                                                        QString, QString)),
+                 reply, library, listing.path_);
+    } else {
+      NewClosure(reply, SIGNAL(finished()), this,
+                 SLOT(FetchAndCheckFolderItemsFinished(
+                     QNetworkReply*, SeafileTree::Entry, QString, QString)),
+                 reply, listing.library_, listing.path_, listing.dir_id_);
+    }
+  }
+}
+
+void SeafileService::FolderListingFinished(bool success) {
+  running_listings_--;
+  if (!success) listing_failed_ = true;
+  StartQueuedListings();
+}
+
 QNetworkReply* SeafileService::PrepareFetchContentForFile(
     const QString& library, const QString& filepath) {
   QUrl content_url(server_ + QString(kFileContentUrl).arg(library));
@@ -556,7 +633,7 @@ void SeafileService::UpdateEntry(const QString& library, const QString& path,
 
     FetchAndCheckFolderItems(
         SeafileTree::Entry("", library, SeafileTree::Entry::LIBRARY),
-        entry_path);
+        entry_path, entry.is_dir() ? entry.id() : QString());
   }
 }
 
@@ -568,6 +645,7 @@ void SeafileService::DeleteEntry(const QString& library, const QString& path,
     SeafileTree::TreeItem* item = tree_.FindLibrary(library);
     files_to_delete = tree_.GetRecursiveFilesOfDir("/", item);
     tree_.DeleteLibrary(library);
+    library_roots_.remove(library);
   } else {
     if (entry.is_dir()) {
       SeafileTree::TreeItem* item =
@@ -656,15 +734,28 @@ void SeafileService::StartTaskInProgress() {
 void SeafileService::FinishedTaskInProgress() {
   indexing_task_progress_++;
   if (indexing_task_progress_ == indexing_task_max_) {
-    task_manager_->SetTaskFinished(indexing_task_id_);
-    indexing_task_id_ = -1;
-    UpdatingLibrariesFinishedSignal();
+    FinishUpdatingLibraries();
   } else {
     task_manager_->SetTaskProgress(indexing_task_id_, indexing_task_progress_,
                                    indexing_task_max_);
   }
 }
 
+void SeafileService::FinishUpdatingLibraries() {
+  // If a listing failed, some directories weren't checked, so look at these
+  // libraries again next time.
+  if (!listing_failed_) {
+    for (const QString& library : libraries_checked_) {
+      library_roots_[library] = server_roots_.value(library);
+    }
+  }
+  libraries_checked_.clear();
+
+  task_manager_->SetTaskFinished(indexing_task_id_);
+  indexing_task_id_ = -1;
+  emit UpdatingLibrariesFinishedSignal();
+}
+
 SeafileService::~SeafileService() {
   // Save the tree !
   QSettings s;
@@ -675,4 +766,9 @@ SeafileService::~SeafileService() {
   stream << tree_;
 
   s.setValue("tree", tree_byte);
+
+  QByteArray roots_bytes;
+  QDataStream roots_stream(&roots_bytes, QIODevice::WriteOnly);
+  roots_stream << library_roots_;
+  s.setValue("library_roots", roots_bytes);
 }
@@ -48,7 +48,9 @@
 #include "internet/core/cloudfileservice.h"
 
 #include <QDateTime>
+#include <QMap>
 #include <QMutex>
+#include <QQueue>
 
 #include "seafiletree.h"
 
@@ -94,7 +96,8 @@ signals:
 
   void FetchAndCheckFolderItemsFinished(QNetworkReply* reply,
                                         const SeafileTree::Entry& library,
-                                        const QString& path);
+                                        const QString& path,
+                                        const QString& dir_id);
 
   // Add recursively the content of a folder from a library
   void AddRecursivelyFolderItemsFinished(QNetworkReply* reply,
@@ -125,10 +128,26 @@ signals:
 
   void UpdateLibraries();
 
+  // dir_id is the directory's new id on the server, if we know it.  It's
+  // saved in the tree once the directory has been checked, so an unchanged
+  // directory isn't listed again next time.
   void FetchAndCheckFolderItems(const SeafileTree::Entry& library,
-                                const QString& path);
+                                const QString& path,
+                                const QString& dir_id = QString());
   void AddRecursivelyFolderItems(const QString& library, const QString& path);
 
+  // Directory listings are queued and at most kMaxConcurrentListings are
+  // fetched at once.
+  struct FolderListing {
+    SeafileTree::Entry library_;
+    QString path_;
+    QString dir_id_;
+    bool add_recursively_;
+  };
+  void QueueFolderListing(const FolderListing& listing);
+  void StartQueuedListings();
+  void FolderListingFinished(bool success);
+
   QNetworkReply* PrepareFetchFolderItems(const QString& library,
                                          const QString& path);
   QNetworkReply* PrepareFetchContentForFile(const QString& library,
@@ -146,6 +165,7 @@ signals:
 
   void StartTaskInProgress();
   void FinishedTaskInProgress();
+  void FinishUpdatingLibraries();
 
   SeafileTree tree_;
   QString access_token_;
@@ -156,6 +176,17 @@ signals:
   int indexing_task_max_;
   int indexing_task_progress_;
 
+  QQueue<FolderListing> queued_listings_;
+  int running_listings_;
+  bool listing_failed_;
+
+  // The root directory id of each library, from the server's list of
+  // libraries and as of the last complete update.  A library whose root
+  // hasn't changed doesn't need to be checked at all.
+  QMap<QString, QString> server_roots_;
+  QMap<QString, QString> library_roots_;
+  QStringList libraries_checked_;
+
   bool changing_libary_;
 };
 
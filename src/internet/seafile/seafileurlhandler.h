@@ -32,6 +32,7 @@ class SeafileUrlHandler : public UrlHandler {
   QString scheme() const { return "seafile"; }
   QIcon icon() const { return IconLoader::Load("seafile", IconLoader::Provider); }
   LoadResult StartLoading(const QUrl& url);
+  bool CanResolveAhead() const { return true; }
 
  private:
   SeafileService* service_;
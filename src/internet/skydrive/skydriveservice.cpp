@@ -92,6 +92,8 @@ void SkydriveService::ConnectFinished(OAuthenticator* oauth) {
   access_token_ = oauth->access_token();
   expiry_time_ = oauth->expiry_time();
 
+  ResumeIndexing(QString::null);
+
   QUrl url(kLiveUserInfo);
   QNetworkRequest request(url);
   AddAuthorizationHeader(&request);
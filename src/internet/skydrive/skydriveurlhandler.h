@@ -33,6 +33,7 @@ class SkydriveUrlHandler : public UrlHandler {
   QString scheme() const { return "skydrive"; }
   QIcon icon() const { return IconLoader::Load("skydrive", IconLoader::Provider); }
   LoadResult StartLoading(const QUrl& url);
+  bool CanResolveAhead() const { return true; }
 
  private:
   SkydriveService* service_;
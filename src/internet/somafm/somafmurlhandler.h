@@ -35,6 +35,8 @@ class SomaFMUrlHandler : public UrlHandler {
   QString scheme() const;
   QIcon icon() const;
   LoadResult StartLoading(const QUrl& url);
+  bool CanResolveAhead() const { return true; }
+  bool CanUseStaleResult() const { return true; }
 
  private slots:
   void LoadPlaylistFinished();
@@ -61,7 +61,7 @@ const char* SoundCloudService::kHomepage = "http://soundcloud.com/";
 
 const int SoundCloudService::kSearchDelayMsec = 400;
 const int SoundCloudService::kSongSearchLimit = 100;
-const int SoundCloudService::kSongSimpleSearchLimit = 100;
+const int SoundCloudService::kSongSimpleSearchLimit = 50;
 
 typedef QPair<QString, QString> Param;
 
@@ -73,7 +73,7 @@ SoundCloudService::SoundCloudService(Application* app, InternetModel* parent)
       user_playlists_(nullptr),
       user_activities_(nullptr),
       user_favorites_(nullptr),
-      network_(new NetworkAccessManager(this)),
+      network_(NetworkAccessManager::Shared()),
       context_menu_(nullptr),
       search_box_(new SearchBoxWidget(this)),
       search_delay_(new QTimer(this)),
@@ -351,18 +351,27 @@ void SoundCloudService::ClearSearchResults() {
   }
 }
 
-int SoundCloudService::SimpleSearch(const QString& text) {
+int SoundCloudService::SimpleSearch(const QString& text, int page) {
   QList<Param> parameters;
-  parameters << Param("q", text) << Param("limit", QString::number(kSongSimpleSearchLimit));
+  parameters << Param("q", text)
+             << Param("limit", QString::number(kSongSimpleSearchLimit))
+             << Param("offset", QString::number(page * kSongSimpleSearchLimit));
   QNetworkReply* reply = CreateRequest("tracks", parameters);
   const int id = next_pending_search_id_++;
+  simple_search_replies_[id] = reply;
   NewClosure(reply, SIGNAL(finished()), this,
              SLOT(SimpleSearchFinished(QNetworkReply*, int)), reply, id);
   return id;
 }
 
+void SoundCloudService::CancelSimpleSearch(int id) {
+  QNetworkReply* reply = simple_search_replies_.take(id);
+  if (reply) reply->abort();
+}
+
 void SoundCloudService::SimpleSearchFinished(QNetworkReply* reply, int id) {
   reply->deleteLater();
+  if (!simple_search_replies_.remove(id)) return;
 
   SongList songs = ExtractSongs(ExtractResult(reply));
   emit SimpleSearchResults(id, songs);
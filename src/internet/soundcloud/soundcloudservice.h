@@ -50,7 +50,11 @@ class SoundCloudService : public InternetService {
   bool IsLoggedIn();
   void Logout();
 
-  int SimpleSearch(const QString& query);
+  // Pages after the first one skip the tracks that were on the earlier ones.
+  int SimpleSearch(const QString& query, int page = 0);
+  // Aborts a search started by SimpleSearch.  SimpleSearchResults won't be
+  // emitted for it.
+  void CancelSimpleSearch(int id);
 
   static const char* kServiceName;
   static const char* kSettingsGroup;
@@ -126,6 +130,8 @@ class SoundCloudService : public InternetService {
   int next_pending_search_id_;
   int next_retrieve_playlist_id_;
 
+  QMap<int, QNetworkReply*> simple_search_replies_;
+
   QMap<int, PlaylistInfo> pending_playlists_requests_;
 
   QByteArray api_key_;
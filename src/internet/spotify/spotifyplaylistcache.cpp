@@ -0,0 +1,77 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "spotifyplaylistcache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+
+#include "core/logging.h"
+#include "core/utilities.h"
+
+namespace {
+// Bump this when the file format changes.
+const qint32 kFileVersion = 1;
+}  // namespace
+
+SpotifyPlaylistCache::SpotifyPlaylistCache()
+    : directory_(Utilities::GetConfigPath(Utilities::Path_CacheRoot) +
+                 "/spotifyplaylists") {}
+
+QString SpotifyPlaylistCache::Filename(const QString& key) const {
+  const QByteArray hash = QCryptographicHash::hash(
+      (username_ + '\n' + key).toUtf8(), QCryptographicHash::Sha1);
+  return directory_ + "/" + QString::fromAscii(hash.toHex());
+}
+
+bool SpotifyPlaylistCache::Load(
+    const QString& key, pb::spotify::LoadPlaylistResponse* response) const {
+  QFile file(Filename(key));
+  if (!file.open(QIODevice::ReadOnly)) return false;
+
+  QDataStream s(&file);
+  qint32 version = 0;
+  QByteArray data;
+  s >> version >> data;
+
+  if (version != kFileVersion || s.status() != QDataStream::Ok ||
+      !response->ParseFromArray(data.constData(), data.size())) {
+    qLog(Warning) << "Corrupt Spotify playlist cache file" << file.fileName();
+    file.remove();
+    return false;
+  }
+  return true;
+}
+
+void SpotifyPlaylistCache::Save(
+    const QString& key,
+    const pb::spotify::LoadPlaylistResponse& response) const {
+  if (!QDir().mkpath(directory_)) return;
+
+  QFile file(Filename(key));
+  if (!file.open(QIODevice::WriteOnly)) {
+    qLog(Warning) << "Couldn't write Spotify playlist cache file"
+                  << file.fileName();
+    return;
+  }
+
+  const std::string data = response.SerializeAsString();
+  QDataStream s(&file);
+  s << kFileVersion << QByteArray(data.data(), data.size());
+}
@@ -0,0 +1,49 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INTERNET_SPOTIFY_SPOTIFYPLAYLISTCACHE_H_
+#define INTERNET_SPOTIFY_SPOTIFYPLAYLISTCACHE_H_
+
+#include <QString>
+
+#include "spotifymessages.pb.h"
+
+// Keeps the tracks of Spotify playlists on disk between sessions, so a
+// playlist can be shown and played as soon as it's expanded, while the
+// Spotify blob loads its current tracks in the background.  Each user's
+// playlists are kept apart.
+class SpotifyPlaylistCache {
+ public:
+  SpotifyPlaylistCache();
+
+  void set_username(const QString& username) { username_ = username; }
+
+  // Returns false if there's nothing for this playlist.  The key is the
+  // playlist's URI, or something fixed for the starred and inbox playlists.
+  bool Load(const QString& key,
+            pb::spotify::LoadPlaylistResponse* response) const;
+  void Save(const QString& key,
+            const pb::spotify::LoadPlaylistResponse& response) const;
+
+ private:
+  QString Filename(const QString& key) const;
+
+  QString directory_;
+  QString username_;
+};
+
+#endif  // INTERNET_SPOTIFY_SPOTIFYPLAYLISTCACHE_H_
@@ -49,6 +49,8 @@ int SpotifyServer::server_port() const { return server_->serverPort(); }
 void SpotifyServer::NewConnection() {
   QTcpSocket* socket = server_->nextPendingConnection();
   SetDevice(socket);
+  // Images and search results can be big, pass them through shared memory.
+  SetSharedMemoryEnabled(true);
 
   qLog(Info) << "Connection from port" << socket->peerPort();
 
@@ -141,6 +143,9 @@ void SpotifyServer::MessageArrived(const pb::spotify::Message& message) {
     }
   } else if (message.has_playback_error()) {
     emit PlaybackError(QStringFromStdString(message.playback_error().error()));
+  } else if (message.has_media_socket_ready()) {
+    emit MediaSocketReady(QStringFromStdString(
+        message.media_socket_ready().media_socket_path()));
   } else if (message.has_search_response()) {
     emit SearchResults(message.search_response());
   } else if (message.has_image_response()) {
@@ -260,12 +265,16 @@ void SpotifyServer::RemoveSongsFromPlaylist(
   SendOrQueueMessage(message);
 }
 
-void SpotifyServer::StartPlayback(const QString& uri, quint16 port) {
+void SpotifyServer::StartPlayback(const QString& uri, quint16 port,
+                                  const QString& socket_path) {
   pb::spotify::Message message;
   pb::spotify::PlaybackRequest* req = message.mutable_playback_request();
 
   req->set_track_uri(DataCommaSizeFromQString(uri));
   req->set_media_port(port);
+  if (!socket_path.isEmpty()) {
+    req->set_media_socket_path(DataCommaSizeFromQString(socket_path));
+  }
   SendOrQueueMessage(message);
 }
 
@@ -277,13 +286,24 @@ void SpotifyServer::Seek(qint64 offset_nsec) {
   SendOrQueueMessage(message);
 }
 
-void SpotifyServer::Search(const QString& text, int limit, int limit_album) {
+void SpotifyServer::Prefetch(const QString& uri) {
+  pb::spotify::Message message;
+  pb::spotify::PrefetchRequest* req = message.mutable_prefetch_request();
+
+  req->set_track_uri(DataCommaSizeFromQString(uri));
+  SendOrQueueMessage(message);
+}
+
+void SpotifyServer::Search(const QString& text, int limit, int limit_album,
+                           int offset, int offset_album) {
   pb::spotify::Message message;
   pb::spotify::SearchRequest* req = message.mutable_search_request();
 
   req->set_query(DataCommaSizeFromQString(text));
   req->set_limit(limit);
   req->set_limit_album(limit_album);
+  req->set_offset(offset);
+  req->set_offset_album(offset_album);
   SendOrQueueMessage(message);
 }
 
@@ -53,7 +53,8 @@ class SpotifyServer : public AbstractMessageHandler<pb::spotify::Message> {
   void RemoveSongsFromUserPlaylist(int playlist_index,
                                    const QList<int>& songs_indices_to_remove);
   void RemoveSongsFromStarred(const QList<int>& songs_indices_to_remove);
-  void Search(const QString& text, int limit, int limit_album = 0);
+  void Search(const QString& text, int limit, int limit_album = 0,
+              int offset = 0, int offset_album = 0);
   void LoadImage(const QString& id);
   void AlbumBrowse(const QString& uri);
   void SetPlaybackSettings(pb::spotify::Bitrate bitrate,
@@ -64,8 +65,13 @@ class SpotifyServer : public AbstractMessageHandler<pb::spotify::Message> {
   int server_port() const;
 
  public slots:
-  void StartPlayback(const QString& uri, quint16 port);
+  // If socket_path is set the audio is sent through shared memory, and
+  // MediaSocketReady is emitted when it can be read.
+  void StartPlayback(const QString& uri, quint16 port,
+                     const QString& socket_path = QString());
   void Seek(qint64 offset_nsec);
+  // Asks libspotify to start loading the next track before it's played.
+  void Prefetch(const QString& uri);
 
 signals:
   void LoginCompleted(bool success, const QString& error,
@@ -76,6 +82,7 @@ signals:
   void InboxLoaded(const pb::spotify::LoadPlaylistResponse& response);
   void UserPlaylistLoaded(const pb::spotify::LoadPlaylistResponse& response);
   void PlaybackError(const QString& message);
+  void MediaSocketReady(const QString& socket_path);
   void SearchResults(const pb::spotify::SearchResponse& response);
   void ImageLoaded(const QString& id, const QImage& image);
   void SyncPlaylistProgress(const pb::spotify::SyncPlaylistProgress& progress);
@@ -140,18 +140,23 @@ void SpotifyService::LazyPopulate(QStandardItem* item) {
     case Type_SearchResults:
       break;
 
+    // Playlists show what they had last time straight away, so they can be
+    // played or dragged, and are refreshed when the blob has loaded them.
     case Type_InboxPlaylist:
       EnsureServerCreated();
+      FillPlaylistFromCache(item);
       server_->LoadInbox();
       break;
 
     case Type_StarredPlaylist:
       EnsureServerCreated();
+      FillPlaylistFromCache(item);
       server_->LoadStarred();
       break;
 
     case InternetModel::Type_UserPlaylist:
       EnsureServerCreated();
+      FillPlaylistFromCache(item);
       server_->LoadUserPlaylist(item->data(Role_UserPlaylistIndex).toInt());
       break;
 
@@ -306,6 +311,7 @@ void SpotifyService::EnsureServerCreated(const QString& username,
     login_password = QString();
   }
 
+  playlist_cache_.set_username(login_username);
   server_->Login(login_username, login_password, bitrate_,
                  volume_normalisation_);
 
@@ -441,12 +447,10 @@ void SpotifyService::PlaylistsUpdated(const pb::spotify::Playlists& response) {
   // Create starred and inbox playlists if they're not here already
   if (!search_) {
     InitSearch();
-  } else {
-    // Always reset starred playlist
-    // TODO: might be improved by including starred playlist in the response,
-    // and reloading it only when needed, like other playlists.
-    starred_->removeRows(0, starred_->rowCount());
-    LazyPopulate(starred_);
+  } else if (!starred_->data(InternetModel::Role_CanLazyLoad).toBool()) {
+    // The starred playlist isn't in the response, so reload it whenever
+    // anything changes - but only if it's been loaded already.
+    server_->LoadStarred();
   }
 
   // Don't do anything if the playlists haven't changed since last time.
@@ -480,12 +484,11 @@ void SpotifyService::PlaylistsUpdated(const pb::spotify::Playlists& response) {
                   InternetModel::Role_PlayBehaviour);
     item->setData(QUrl(QStringFromStdString(msg.uri())),
                   InternetModel::Role_Url);
+    item->setData(msg.nb_tracks(), Role_TrackCount);
 
+    // The tracks are only loaded when the playlist is expanded or played.
     root_->appendRow(item);
     playlists_ << item;
-
-    // Preload the playlist items so that drag & drop works immediately.
-    LazyPopulate(item);
   }
 }
 
@@ -507,7 +510,7 @@ bool SpotifyService::DoPlaylistsDiffer(
       return true;
     }
 
-    if (msg.nb_tracks() != item->rowCount()) {
+    if (msg.nb_tracks() != item->data(Role_TrackCount).toInt()) {
       return true;
     }
   }
@@ -519,6 +522,7 @@ void SpotifyService::InboxLoaded(
     const pb::spotify::LoadPlaylistResponse& response) {
   if (inbox_) {
     FillPlaylist(inbox_, response);
+    playlist_cache_.Save(PlaylistCacheKey(inbox_), response);
   }
 }
 
@@ -526,6 +530,7 @@ void SpotifyService::StarredLoaded(
     const pb::spotify::LoadPlaylistResponse& response) {
   if (starred_) {
     FillPlaylist(starred_, response);
+    playlist_cache_.Save(PlaylistCacheKey(starred_), response);
   }
 }
 
@@ -552,6 +557,7 @@ void SpotifyService::UserPlaylistLoaded(
       PlaylistBySpotifyIndex(response.request().user_playlist_index());
   if (item) {
     FillPlaylist(item, response);
+    playlist_cache_.Save(PlaylistCacheKey(item), response);
   }
 }
 
@@ -576,6 +582,32 @@ void SpotifyService::FillPlaylist(
   FillPlaylist(item, response.track());
 }
 
+void SpotifyService::FillPlaylistFromCache(QStandardItem* item) {
+  if (item->hasChildren()) return;
+
+  pb::spotify::LoadPlaylistResponse response;
+  if (!playlist_cache_.Load(PlaylistCacheKey(item), &response)) return;
+
+  // User playlists that have changed length since are out of date.
+  const QVariant track_count = item->data(Role_TrackCount);
+  if (track_count.isValid() && track_count.toInt() != response.track_size()) {
+    return;
+  }
+
+  FillPlaylist(item, response.track());
+}
+
+QString SpotifyService::PlaylistCacheKey(const QStandardItem* item) const {
+  switch (item->data(InternetModel::Role_Type).toInt()) {
+    case Type_StarredPlaylist:
+      return "starred";
+    case Type_InboxPlaylist:
+      return "inbox";
+    default:
+      return item->data(InternetModel::Role_Url).toUrl().toString();
+  }
+}
+
 void SpotifyService::SongFromProtobuf(const pb::spotify::Track& track,
                                       Song* song) {
   song->set_rating(track.starred() ? 1.0 : 0.0);
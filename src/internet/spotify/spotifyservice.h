@@ -24,6 +24,7 @@
 
 #include "internet/core/internetmodel.h"
 #include "internet/core/internetservice.h"
+#include "internet/spotify/spotifyplaylistcache.h"
 #include "spotifymessages.pb.h"
 
 #include <QProcess>
@@ -51,6 +52,8 @@ class SpotifyService : public InternetService {
 
   enum Role {
     Role_UserPlaylistIndex = InternetModel::RoleCount,
+    // How many tracks a user playlist had in the last list of playlists.
+    Role_TrackCount,
   };
 
   // Values are persisted - don't change.
@@ -112,6 +115,9 @@ class SpotifyService : public InternetService {
       const google::protobuf::RepeatedPtrField<pb::spotify::Track>& tracks);
   void FillPlaylist(QStandardItem* item,
                     const pb::spotify::LoadPlaylistResponse& response);
+  // Shows the tracks the playlist had last time, if they're in the cache.
+  void FillPlaylistFromCache(QStandardItem* item);
+  QString PlaylistCacheKey(const QStandardItem* item) const;
   void AddSongsToUserPlaylist(int playlist_index,
                               const QList<QUrl>& songs_urls);
   void AddSongsToStarred(const QList<QUrl>& songs_urls);
@@ -165,6 +171,7 @@ class SpotifyService : public InternetService {
   QStandardItem* inbox_;
   QStandardItem* toplist_;
   QList<QStandardItem*> playlists_;
+  SpotifyPlaylistCache playlist_cache_;
 
   int login_task_id_;
   QString pending_search_;
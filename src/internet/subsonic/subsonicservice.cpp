@@ -31,6 +31,7 @@
 #include <QXmlStreamReader>
 
 #include "core/application.h"
+#include "core/cachingurlhandler.h"
 #include "core/closure.h"
 #include "core/database.h"
 #include "core/logging.h"
@@ -55,10 +56,11 @@ const char* SubsonicService::kSettingsGroup = "Subsonic";
 const char* SubsonicService::kApiVersion = "1.8.0";
 const char* SubsonicService::kApiClientName = "Clementine";
 
-const char* SubsonicService::kSongsTable = "subsonic_songs";
-const char* SubsonicService::kFtsTable = "subsonic_songs_fts";
+const char* SubsonicService::kSongsTable = "subsonic.songs";
+const char* SubsonicService::kFtsTable = "subsonic.songs_fts";
 
 const int SubsonicService::kMaxRedirects = 10;
+const int SubsonicService::kDefaultConcurrentRequests = 8;
 
 SubsonicService::SubsonicService(Application* app, InternetModel* parent)
     : InternetService(kServiceName, app, parent, parent),
@@ -76,12 +78,15 @@ SubsonicService::SubsonicService(Application* app, InternetModel* parent)
       login_state_(LoginState_OtherError),
       redirect_count_(0),
       is_ampache_(false) {
-  app_->player()->RegisterUrlHandler(url_handler_);
+  app_->player()->RegisterUrlHandler(
+      new CachingUrlHandler(url_handler_, app_->stream_cache(), this));
 
   connect(scanner_, SIGNAL(ScanFinished()), SLOT(ReloadDatabaseFinished()));
 
+  // The catalogue is in a database of its own, give it a thread of its own
+  // to write it from too.
   library_backend_ = new LibraryBackend;
-  library_backend_->moveToThread(app_->database()->thread());
+  app_->MoveToNewThread(library_backend_);
   library_backend_->Init(app_->database(), kSongsTable, QString::null,
                          QString::null, kFtsTable);
   connect(library_backend_, SIGNAL(TotalSongCountUpdated(int)),
@@ -134,6 +139,9 @@ SubsonicService::SubsonicService(Application* app, InternetModel* parent)
   context_menu_ = new QMenu;
   context_menu_->addActions(GetPlaylistActions());
   context_menu_->addSeparator();
+  context_menu_->addAction(IconLoader::Load("view-refresh", IconLoader::Base),
+                           tr("Update catalogue"), this,
+                           SLOT(UpdateDatabase()));
   context_menu_->addAction(IconLoader::Load("view-refresh", IconLoader::Base),
                            tr("Refresh catalogue"), this,
                            SLOT(ReloadDatabase()));
@@ -165,8 +173,8 @@ void SubsonicService::LazyPopulate(QStandardItem* item) {
       library_model_->Init();
       if (login_state() != LoginState_Loggedin) {
         ShowConfig();
-      } else if (total_song_count_ == 0 && !load_database_task_id_) {
-        ReloadDatabase();
+      } else if (!load_database_task_id_) {
+        UpdateDatabase();
       }
       model()->merged_model()->AddSubModel(item->index(), library_sort_model_);
       break;
@@ -196,6 +204,9 @@ void SubsonicService::ReloadSettings() {
   password_ = s.value("password").toString();
   usesslv3_ = s.value("usesslv3").toBool();
   verifycert_ = s.value("verifycert", true).toBool();
+  scanner_->set_max_concurrent_requests(
+      qMax(1, s.value("max_concurrent_requests", kDefaultConcurrentRequests)
+                  .toInt()));
 
   Login();
 }
@@ -288,19 +299,80 @@ void SubsonicService::ReloadDatabase() {
   scanner_->Scan();
 }
 
+void SubsonicService::UpdateDatabase() {
+  QSettings s;
+  s.beginGroup(kSettingsGroup);
+  const QDateTime last_sync = s.value("last_sync").toDateTime();
+
+  if (total_song_count_ == 0 || !last_sync.isValid()) {
+    ReloadDatabase();
+    return;
+  }
+
+  if (!load_database_task_id_) {
+    load_database_task_id_ =
+        app_->task_manager()->StartTask(tr("Updating Subsonic library"));
+  }
+  scanner_->ScanChanges(last_sync);
+}
+
 void SubsonicService::ReloadDatabaseFinished() {
   app_->task_manager()->SetTaskFinished(load_database_task_id_);
   load_database_task_id_ = 0;
 
-  library_backend_->DeleteAll();
-  library_backend_->AddOrUpdateSongs(scanner_->GetSongs());
-  library_model_->Reset();
+  // Work out what actually changed, so existing songs keep their IDs and the
+  // library model only hears about the differences.
+  QHash<QUrl, Song> existing;
+  for (const Song& song : library_backend_->GetAllSongs()) {
+    existing[song.url()] = song;
+  }
+
+  SongList changed;
+  for (Song song : scanner_->GetSongs()) {
+    QHash<QUrl, Song>::iterator it = existing.find(song.url());
+    if (it != existing.end()) {
+      const Song old_song = it.value();
+      existing.erase(it);
+
+      if (old_song.IsMetadataEqual(song) &&
+          old_song.playcount() == song.playcount() &&
+          old_song.filesize() == song.filesize()) {
+        continue;
+      }
+      song.set_id(old_song.id());
+    }
+    changed << song;
+  }
+
+  // Only a complete listing of the server tells us which songs have gone.
+  if (!scanner_->is_incremental() && scanner_->succeeded() &&
+      !existing.isEmpty()) {
+    library_backend_->DeleteSongs(existing.values());
+  }
+  if (!changed.isEmpty()) {
+    library_backend_->AddOrUpdateSongs(changed);
+  }
+
+  qLog(Debug) << "Subsonic sync:" << changed.count() << "songs added or"
+              << "updated," << scanner_->GetSongs().count() << "fetched";
+
+  if (scanner_->succeeded()) {
+    QSettings s;
+    s.beginGroup(kSettingsGroup);
+    s.setValue("last_sync", scanner_->started());
+  }
 }
 
 void SubsonicService::OnLoginStateChanged(
     SubsonicService::LoginState newstate) {
   // TODO(Alan Briolat): library refresh logic?
-  if (newstate != LoginState_Loggedin) library_backend_->DeleteAll();
+  if (newstate != LoginState_Loggedin) {
+    library_backend_->DeleteAll();
+
+    QSettings s;
+    s.beginGroup(kSettingsGroup);
+    s.remove("last_sync");
+  }
 }
 
 void SubsonicService::OnPingFinished(QNetworkReply* reply) {
@@ -406,16 +478,25 @@ void SubsonicService::UpdateServer(const QString& server) {
 }
 
 const int SubsonicLibraryScanner::kAlbumChunkSize = 500;
-const int SubsonicLibraryScanner::kConcurrentRequests = 8;
 const int SubsonicLibraryScanner::kCoverArtSize = 1024;
 
 SubsonicLibraryScanner::SubsonicLibraryScanner(SubsonicService* service,
                                                QObject* parent)
-    : QObject(parent), service_(service), scanning_(false) {}
+    : QObject(parent),
+      service_(service),
+      scanning_(false),
+      succeeded_(false),
+      max_concurrent_requests_(SubsonicService::kDefaultConcurrentRequests) {}
 
 SubsonicLibraryScanner::~SubsonicLibraryScanner() {}
 
-void SubsonicLibraryScanner::Scan() {
+void SubsonicLibraryScanner::Scan() { StartScan(QDateTime()); }
+
+void SubsonicLibraryScanner::ScanChanges(const QDateTime& since) {
+  StartScan(since);
+}
+
+void SubsonicLibraryScanner::StartScan(const QDateTime& since) {
   if (scanning_) {
     return;
   }
@@ -424,6 +505,48 @@ void SubsonicLibraryScanner::Scan() {
   pending_requests_.clear();
   songs_.clear();
   scanning_ = true;
+  succeeded_ = true;
+  since_ = since;
+  started_ = QDateTime::currentDateTime();
+
+  if (is_incremental()) {
+    GetIndexes();
+  } else {
+    GetAlbumList(0);
+  }
+}
+
+void SubsonicLibraryScanner::OnGetIndexesFinished(QNetworkReply* reply) {
+  reply->deleteLater();
+
+  QXmlStreamReader reader(reply);
+  reader.readNextStartElement();
+
+  if (reader.name() != "subsonic-response") {
+    ParsingError("Not a subsonic-response. Aborting scan.");
+    return;
+  }
+
+  if (reader.attributes().value("status") != "ok") {
+    ParsingError("Response status not ok. Aborting scan.");
+    return;
+  }
+
+  reader.readNextStartElement();
+  if (reader.name() != "indexes") {
+    ParsingError("indexes tag expected. Aborting scan.");
+    return;
+  }
+
+  // The server leaves the indexes element empty if nothing has changed since
+  // ifModifiedSince.
+  if (!reader.readNextStartElement()) {
+    qLog(Debug) << "Subsonic library unchanged since" << since_;
+    scanning_ = false;
+    emit ScanFinished();
+    return;
+  }
+
   GetAlbumList(0);
 }
 
@@ -459,6 +582,7 @@ void SubsonicLibraryScanner::OnGetAlbumListFinished(QNetworkReply* reply,
   }
 
   int albums_added = 0;
+  bool reached_old_albums = false;
   if (!skip_read_albums) {
     reader.readNextStartElement();
     if (reader.name() != "albumList2") {
@@ -472,24 +596,39 @@ void SubsonicLibraryScanner::OnGetAlbumListFinished(QNetworkReply* reply,
         return;
       }
 
+      if (is_incremental()) {
+        // Albums are listed newest first, so everything after the first one
+        // that was already there at the last sync is old too.
+        QDateTime created = QDateTime::fromString(
+            reader.attributes().value("created").toString().left(19),
+            Qt::ISODate);
+        created.setTimeSpec(Qt::UTC);
+        if (created.isValid() && created < since_) {
+          reached_old_albums = true;
+          break;
+        }
+      }
+
       album_queue_ << reader.attributes().value("id").toString();
       albums_added++;
       reader.skipCurrentElement();
     }
   }
 
-  if (albums_added > 0) {
+  if (albums_added > 0 && !reached_old_albums) {
     // Non-empty reply means potentially more albums to fetch
     GetAlbumList(offset + kAlbumChunkSize);
   } else if (album_queue_.size() == 0) {
-    // Empty reply and no albums means an empty Subsonic server
+    // Empty reply and no albums means an empty Subsonic server, or no new
+    // albums
     scanning_ = false;
     emit ScanFinished();
   } else {
     // Empty reply but we have some albums, time to start fetching songs
     // Start up the maximum number of concurrent requests, finished requests get
     // replaced with new ones
-    for (int i = 0; i < kConcurrentRequests && !album_queue_.empty(); ++i) {
+    for (int i = 0; i < max_concurrent_requests_ && !album_queue_.empty();
+         ++i) {
       GetAlbum(album_queue_.dequeue());
     }
   }
@@ -574,9 +713,18 @@ void SubsonicLibraryScanner::OnGetAlbumFinished(QNetworkReply* reply) {
   }
 }
 
+void SubsonicLibraryScanner::GetIndexes() {
+  QUrl url = service_->BuildRequestUrl("getIndexes");
+  url.addQueryItem("ifModifiedSince",
+                   QString::number(since_.toMSecsSinceEpoch()));
+  QNetworkReply* reply = service_->Send(url);
+  NewClosure(reply, SIGNAL(finished()), this,
+             SLOT(OnGetIndexesFinished(QNetworkReply*)), reply);
+}
+
 void SubsonicLibraryScanner::GetAlbumList(int offset) {
   QUrl url = service_->BuildRequestUrl("getAlbumList2");
-  url.addQueryItem("type", "alphabeticalByName");
+  url.addQueryItem("type", is_incremental() ? "newest" : "alphabeticalByName");
   url.addQueryItem("size", QString::number(kAlbumChunkSize));
   url.addQueryItem("offset", QString::number(offset));
   QNetworkReply* reply = service_->Send(url);
@@ -599,5 +747,6 @@ void SubsonicLibraryScanner::GetAlbum(const QString& id) {
 void SubsonicLibraryScanner::ParsingError(const QString& message) {
   qLog(Warning) << "Subsonic parsing error: " << message;
   scanning_ = false;
+  succeeded_ = false;
   emit ScanFinished();
 }
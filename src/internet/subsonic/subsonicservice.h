@@ -22,6 +22,7 @@
 #ifndef INTERNET_SUBSONIC_SUBSONICSERVICE_H_
 #define INTERNET_SUBSONIC_SUBSONICSERVICE_H_
 
+#include <QDateTime>
 #include <QQueue>
 
 #include "internet/core/internetmodel.h"
@@ -124,6 +125,7 @@ class SubsonicService : public InternetService {
 
   static const int kMaxRedirects;
   static const int kCoverArtSize;
+  static const int kDefaultConcurrentRequests;
 
 
 signals:
@@ -164,7 +166,11 @@ signals:
 
  private slots:
   void UpdateTotalSongCount(int count);
+  // Fetches the whole library from the server.
   void ReloadDatabase();
+  // Fetches only the albums added since the last sync, falling back to a full
+  // reload if there hasn't been one yet.
+  void UpdateDatabase();
   void ReloadDatabaseFinished();
   void OnLoginStateChanged(SubsonicService::LoginState newstate);
   void OnPingFinished(QNetworkReply* reply);
@@ -180,29 +186,53 @@ class SubsonicLibraryScanner : public QObject {
                                   QObject* parent = nullptr);
   ~SubsonicLibraryScanner();
 
+  // Lists every album on the server.
   void Scan();
+  // Lists only the albums created after since.  The artist indexes are
+  // checked first with ifModifiedSince, so nothing else is requested if the
+  // server hasn't changed.
+  void ScanChanges(const QDateTime& since);
+
   const SongList& GetSongs() const { return songs_; }
+  bool is_incremental() const { return since_.isValid(); }
+  // False if the server returned an error part way through the scan.
+  bool succeeded() const { return succeeded_; }
+  // When the current scan was started, suitable for the next ScanChanges().
+  const QDateTime& started() const { return started_; }
+
+  void set_max_concurrent_requests(int count) {
+    max_concurrent_requests_ = count;
+  }
 
   static const int kAlbumChunkSize;
-  static const int kConcurrentRequests;
   static const int kCoverArtSize;
 
 signals:
   void ScanFinished();
 
  private slots:
-  // Step 1: use getAlbumList2 type=alphabeticalByName to list all albums
+  // Step 0 (incremental only): use getIndexes ifModifiedSince=? to find out
+  // whether anything changed
+  void OnGetIndexesFinished(QNetworkReply* reply);
+  // Step 1: use getAlbumList2 type=alphabeticalByName to list all albums, or
+  // type=newest to list recently added albums
   void OnGetAlbumListFinished(QNetworkReply* reply, int offset);
   // Step 2: use getAlbum id=? to list all songs for each album
   void OnGetAlbumFinished(QNetworkReply* reply);
 
  private:
+  void StartScan(const QDateTime& since);
+  void GetIndexes();
   void GetAlbumList(int offset);
   void GetAlbum(const QString& id);
   void ParsingError(const QString& message);
 
   SubsonicService* service_;
   bool scanning_;
+  bool succeeded_;
+  int max_concurrent_requests_;
+  QDateTime since_;
+  QDateTime started_;
   QQueue<QString> album_queue_;
   QSet<QNetworkReply*> pending_requests_;
   SongList songs_;
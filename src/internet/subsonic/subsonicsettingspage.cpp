@@ -65,6 +65,9 @@ void SubsonicSettingsPage::Load() {
   ui_->password->setText(s.value("password").toString());
   ui_->usesslv3->setChecked(s.value("usesslv3").toBool());
   ui_->verifycert->setChecked(s.value("verifycert", true).toBool());
+  ui_->max_concurrent_requests->setValue(
+      s.value("max_concurrent_requests",
+              SubsonicService::kDefaultConcurrentRequests).toInt());
 
   // If the settings are complete, SubsonicService will have used them already
   // and
@@ -83,6 +86,8 @@ void SubsonicSettingsPage::Save() {
   s.setValue("password", ui_->password->text());
   s.setValue("usesslv3", ui_->usesslv3->isChecked());
   s.setValue("verifycert", ui_->verifycert->isChecked());
+  s.setValue("max_concurrent_requests",
+             ui_->max_concurrent_requests->value());
 }
 
 void SubsonicSettingsPage::LoginStateChanged(
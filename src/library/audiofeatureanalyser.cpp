@@ -0,0 +1,329 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "audiofeatureanalyser.h"
+
+#include <cmath>
+#include <limits>
+
+#include <QtConcurrentMap>
+#include <QVector>
+
+#include "librarybackend.h"
+#include "analyzers/fht.h"
+#include "core/closure.h"
+#include "core/logging.h"
+#include "core/offlinedecoder.h"
+#include "core/taskmanager.h"
+#include "core/threadpools.h"
+#include "moodbar/moodbarbuilder.h"
+
+namespace {
+
+const int kDecodeRate = 22050;
+const int kDecodeChannels = 1;
+const int kMaxLengthSecs = 120;
+const int kTimeoutSecs = 120;
+
+// Frames of 1024 samples, about 46ms, that overlap by half.
+const int kFftExp = 10;
+const int kFrameSize = 1 << kFftExp;
+const int kHopSize = kFrameSize / 2;
+const double kFramesPerSec = double(kDecodeRate) / kHopSize;
+
+// Quieter frames don't count towards the spectrum or the loudness.
+const double kSilence = -60.0;
+// About five seconds that aren't silent.
+const int kMinFrames = 200;
+
+const int kBarkBands = AudioFeatureAnalyser::kDimensions - 4;
+
+quint8 Quantise(double value, double min, double max) {
+  return quint8(qBound(0.0, (value - min) / (max - min), 1.0) * 255 + 0.5);
+}
+
+class FeatureExtractor : public OfflineDecoder::Sink {
+  // Works out the features of 16-bit mono PCM at kDecodeRate.  Stops the
+  // decoder early if cancelled becomes non-zero.
+
+ public:
+  explicit FeatureExtractor(QAtomicInt* cancelled)
+      : cancelled_(cancelled),
+        fht_(kFftExp),
+        window_(kFrameSize),
+        frame_(kFrameSize),
+        magnitudes_(kFrameSize / 2),
+        previous_(kFrameSize / 2, 0.0),
+        bands_(kBarkBands),
+        band_sums_(kBarkBands, 0.0),
+        loud_frames_(0),
+        loudness_sum_(0.0),
+        loudness_squares_(0.0),
+        flux_sum_(0.0),
+        magnitude_sum_(0.0) {
+    Q_ASSERT(MoodbarBuilder::kBarkBandCount == kBarkBands);
+    bark_.Init(kFrameSize / 2, kDecodeRate);
+
+    for (int i = 0; i < kFrameSize; ++i) {
+      window_[i] = 0.5 - 0.5 * std::cos(2 * M_PI * i / (kFrameSize - 1));
+    }
+  }
+
+  bool Consume(const char* data, int size) override {
+    const qint16* samples = reinterpret_cast<const qint16*>(data);
+    const int count = size / sizeof(qint16);
+
+    for (int i = 0; i < count; ++i) {
+      pending_ << samples[i] / 32768.0f;
+      if (pending_.count() == kFrameSize) {
+        ProcessFrame();
+        pending_.remove(0, kHopSize);
+      }
+    }
+
+    return !is_cancelled();
+  }
+
+  bool is_cancelled() const {
+    return cancelled_ && cancelled_->fetchAndAddRelaxed(0);
+  }
+
+  QByteArray Features() const {
+    if (loud_frames_ < kMinFrames) return QByteArray();
+
+    QByteArray ret(AudioFeatureAnalyser::kDimensions, 0);
+    int i = 0;
+
+    // The shape of the spectrum, in bels relative to the average band, so it
+    // doesn't depend on how loud the song is.
+    double mean = 0.0;
+    for (double sum : band_sums_) {
+      mean += sum / loud_frames_ / kBarkBands;
+    }
+    for (double sum : band_sums_) {
+      ret[i++] = Quantise(sum / loud_frames_ - mean, -4.0, 4.0);
+    }
+
+    const double loudness = loudness_sum_ / loud_frames_;
+    const double variance =
+        loudness_squares_ / loud_frames_ - loudness * loudness;
+
+    ret[i++] = Quantise(Tempo(), 60.0, 200.0);
+    ret[i++] = Quantise(loudness, kSilence, 0.0);
+    ret[i++] = Quantise(std::sqrt(qMax(0.0, variance)), 0.0, 20.0);
+    ret[i++] = Quantise(flux_sum_ / magnitude_sum_, 0.0, 0.5);
+
+    return ret;
+  }
+
+ private:
+  void ProcessFrame() {
+    double energy = 0.0;
+    for (int i = 0; i < kFrameSize; ++i) {
+      energy += pending_[i] * pending_[i];
+      frame_[i] = pending_[i] * window_[i];
+    }
+
+    // How much louder each bin got since the last frame.  Beats show up as
+    // peaks in this.
+    fht_.spectrum(frame_.data());
+    double flux = 0.0;
+    double total = 0.0;
+    for (int i = 0; i < kFrameSize / 2; ++i) {
+      magnitudes_[i] = frame_[i];
+      flux += qMax(0.0, magnitudes_[i] - previous_[i]);
+      total += magnitudes_[i];
+      previous_[i] = magnitudes_[i];
+    }
+    onsets_ << flux;
+
+    const double loudness = 10.0 * std::log10(energy / kFrameSize + 1e-12);
+    if (loudness < kSilence) return;
+
+    loud_frames_++;
+    loudness_sum_ += loudness;
+    loudness_squares_ += loudness * loudness;
+    flux_sum_ += flux;
+    magnitude_sum_ += total;
+
+    bark_.BarkBands(magnitudes_.constData(), magnitudes_.count(),
+                    bands_.data());
+    for (int i = 0; i < kBarkBands; ++i) {
+      band_sums_[i] += std::log10(bands_[i] + 1e-9);
+    }
+  }
+
+  double Tempo() const {
+    // The lag between frames at which the onsets line up best with
+    // themselves, out of the ones that 60 to 200 bpm would give.
+    const int min_lag = int(kFramesPerSec * 60 / 200);
+    const int max_lag = int(kFramesPerSec * 60 / 60 + 0.5);
+    const int count = onsets_.count();
+    if (count <= max_lag * 2) return 0.0;
+
+    double mean = 0.0;
+    for (double onset : onsets_) mean += onset / count;
+
+    int best_lag = 0;
+    double best = -std::numeric_limits<double>::max();
+    for (int lag = min_lag; lag <= max_lag; ++lag) {
+      double sum = 0.0;
+      for (int i = 0; i + lag < count; ++i) {
+        sum += (onsets_[i] - mean) * (onsets_[i + lag] - mean);
+      }
+      sum /= count - lag;
+      if (sum > best) {
+        best = sum;
+        best_lag = lag;
+      }
+    }
+    return best_lag ? 60 * kFramesPerSec / best_lag : 0.0;
+  }
+
+  QAtomicInt* cancelled_;
+
+  FHT fht_;
+  MoodbarBuilder bark_;
+  QVector<float> window_;
+  QVector<float> pending_;
+  QVector<float> frame_;
+  QVector<double> magnitudes_;
+  QVector<double> previous_;
+  QVector<double> bands_;
+
+  QVector<double> band_sums_;
+  QVector<double> onsets_;
+  int loud_frames_;
+  double loudness_sum_;
+  double loudness_squares_;
+  double flux_sum_;
+  double magnitude_sum_;
+};
+
+struct AnalyseSongFunctor {
+  typedef bool result_type;
+
+  AnalyseSongFunctor(LibraryBackend* backend, QAtomicInt* cancelled)
+      : backend_(backend), cancelled_(cancelled) {}
+  bool operator()(const Song& song) const {
+    const QByteArray features = AudioFeatureAnalyser::AnalyseFile(
+        song.url().toLocalFile(), cancelled_);
+    if (features.isEmpty()) return false;
+
+    backend_->SaveAudioFeatures(song, features);
+    return true;
+  }
+
+  LibraryBackend* backend_;
+  QAtomicInt* cancelled_;
+};
+
+SongList LoadSongs(LibraryBackend* backend) {
+  return backend->GetSongsWithoutAudioFeatures();
+}
+
+}  // namespace
+
+AudioFeatureAnalyser::AudioFeatureAnalyser(LibraryBackend* backend,
+                                           TaskManager* task_manager,
+                                           QObject* parent)
+    : QObject(parent),
+      backend_(backend),
+      task_manager_(task_manager),
+      task_id_(-1),
+      watcher_(nullptr),
+      cancelled_(0),
+      songs_done_(0) {}
+
+AudioFeatureAnalyser::~AudioFeatureAnalyser() { Cancel(); }
+
+void AudioFeatureAnalyser::Start() {
+  if (is_running()) return;
+
+  task_id_ = task_manager_->StartTask(tr("Analysing songs for similar tracks"));
+
+  QFuture<SongList> future = ThreadPools::Run<SongList>(
+      ThreadPools::Pool_Background, std::bind(&LoadSongs, backend_));
+  NewClosure(future, this, SLOT(SongsLoaded(QFuture<SongList>)), future);
+}
+
+void AudioFeatureAnalyser::SongsLoaded(QFuture<SongList> future) {
+  if (!is_running()) return;
+
+  songs_ = future.result();
+  songs_done_ = 0;
+  qLog(Info) << "Analysing audio features of" << songs_.count() << "songs";
+
+  if (songs_.isEmpty()) {
+    AllSongsAnalysed();
+    return;
+  }
+
+  watcher_ = new QFutureWatcher<bool>(this);
+  connect(watcher_, SIGNAL(resultReadyAt(int)), SLOT(SongAnalysed(int)));
+  connect(watcher_, SIGNAL(finished()), SLOT(AllSongsAnalysed()));
+  cancelled_ = 0;
+  watcher_->setFuture(
+      QtConcurrent::mapped(songs_, AnalyseSongFunctor(backend_, &cancelled_)));
+}
+
+void AudioFeatureAnalyser::SongAnalysed(int index) {
+  if (!watcher_ || index >= songs_.count()) return;
+
+  songs_done_++;
+  task_manager_->SetTaskProgress(task_id_, songs_done_, songs_.count());
+}
+
+void AudioFeatureAnalyser::AllSongsAnalysed() {
+  if (watcher_) {
+    watcher_->deleteLater();
+    watcher_ = nullptr;
+  }
+  songs_.clear();
+
+  if (is_running()) {
+    task_manager_->SetTaskFinished(task_id_);
+    task_id_ = -1;
+  }
+}
+
+void AudioFeatureAnalyser::Cancel() {
+  if (watcher_) {
+    // Stop the songs that are being decoded as well as the queued ones.
+    cancelled_ = 1;
+    watcher_->disconnect(this);
+    watcher_->cancel();
+    watcher_->waitForFinished();
+  }
+  AllSongsAnalysed();
+}
+
+QByteArray AudioFeatureAnalyser::AnalyseFile(const QString& filename,
+                                             QAtomicInt* cancelled) {
+  FeatureExtractor extractor(cancelled);
+  if (extractor.is_cancelled()) return QByteArray();
+
+  OfflineDecoder* decoder =
+      OfflineDecoder::ForCurrentThread(kDecodeRate, kDecodeChannels);
+  if (!decoder->Decode(filename, kMaxLengthSecs, kTimeoutSecs, &extractor)) {
+    qLog(Warning) << "Couldn't decode" << filename << "to analyse it";
+    return QByteArray();
+  }
+  if (extractor.is_cancelled()) return QByteArray();
+
+  return extractor.Features();
+}
@@ -0,0 +1,83 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARY_AUDIOFEATUREANALYSER_H_
+#define LIBRARY_AUDIOFEATUREANALYSER_H_
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QObject>
+
+#include "core/song.h"
+
+class LibraryBackend;
+class TaskManager;
+
+class AudioFeatureAnalyser : public QObject {
+  // Describes how library songs sound, so the "similar tracks" dynamic
+  // playlist can find songs that sound alike without going to the network.
+  // Files are decoded with OfflineDecoder on the global thread pool, and the
+  // features are saved in the database as they're worked out.
+  //
+  // The features are kDimensions bytes: the average level of each of the
+  // moodbar's Bark bands relative to the others, then the tempo, the
+  // loudness, how much the loudness varies, and how much the spectrum changes
+  // from one moment to the next.
+
+  Q_OBJECT
+
+ public:
+  AudioFeatureAnalyser(LibraryBackend* backend, TaskManager* task_manager,
+                       QObject* parent = nullptr);
+  ~AudioFeatureAnalyser();
+
+  static const int kDimensions = 28;
+
+  bool is_running() const { return task_id_ != -1; }
+
+  // Works out the features of one file.  This method is blocking, so you
+  // want to call it in another thread.  Returns an empty array if the file
+  // couldn't be decoded, is too short or is silent, or once cancelled is
+  // non-zero.
+  static QByteArray AnalyseFile(const QString& filename,
+                                QAtomicInt* cancelled = nullptr);
+
+ public slots:
+  // Analyses every library song that doesn't have features yet, or has
+  // changed since they were worked out.
+  void Start();
+  void Cancel();
+
+ private slots:
+  void SongsLoaded(QFuture<SongList> future);
+  void SongAnalysed(int index);
+  void AllSongsAnalysed();
+
+ private:
+  LibraryBackend* backend_;
+  TaskManager* task_manager_;
+
+  int task_id_;
+  SongList songs_;
+  QFutureWatcher<bool>* watcher_;
+  QAtomicInt cancelled_;
+  int songs_done_;
+};
+
+#endif  // LIBRARY_AUDIOFEATUREANALYSER_H_
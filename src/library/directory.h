@@ -21,6 +21,7 @@
 #include <QList>
 #include <QString>
 #include <QMetaType>
+#include <QSize>
 
 class QSqlQuery;
 
@@ -39,12 +40,25 @@ Q_DECLARE_METATYPE(Directory)
 typedef QList<Directory> DirectoryList;
 Q_DECLARE_METATYPE(DirectoryList)
 
+// An image in a subdirectory that could be the album art of its songs.  The
+// size is remembered so picking the best one next time doesn't mean reading
+// all of them again.  It's invalid if it was never needed.
+struct ArtCandidate {
+  ArtCandidate() : mtime(0) {}
+
+  QString path;
+  uint mtime;
+  QSize size;
+};
+typedef QList<ArtCandidate> ArtCandidateList;
+
 struct Subdirectory {
   Subdirectory() : directory_id(-1), mtime(0) {}
 
   int directory_id;
   QString path;
   uint mtime;
+  ArtCandidateList art_candidates;
 };
 Q_DECLARE_METATYPE(Subdirectory)
 
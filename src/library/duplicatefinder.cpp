@@ -0,0 +1,251 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "duplicatefinder.h"
+
+#include <functional>
+
+#include <QtConcurrentMap>
+
+#include "librarybackend.h"
+#include "core/closure.h"
+#include "core/logging.h"
+#include "core/taskmanager.h"
+#include "core/threadpools.h"
+#include "core/timeconstants.h"
+#include "musicbrainz/chromaprinter.h"
+#include "musicbrainz/tagfetcher.h"
+
+const qint64 DuplicateFinder::kLengthToleranceNanosec = 3 * kNsecPerSec;
+const float DuplicateFinder::kMinFingerprintSimilarity = 0.85;
+
+namespace {
+
+struct ConfirmGroupFunctor {
+  typedef QList<SongList> result_type;
+
+  ConfirmGroupFunctor(Database* db, QAtomicInt* cancelled)
+      : db_(db), cancelled_(cancelled) {}
+  QList<SongList> operator()(const SongList& group) const {
+    return DuplicateFinder::ConfirmGroup(db_, group, cancelled_);
+  }
+
+  Database* db_;
+  QAtomicInt* cancelled_;
+};
+
+QList<SongList> LoadGroups(LibraryBackend* backend) {
+  return DuplicateFinder::GroupCandidates(backend->GetDuplicateCandidates(
+      DuplicateFinder::kLengthToleranceNanosec));
+}
+
+bool IsSameName(const Song& a, const Song& b) {
+  return a.title().compare(b.title(), Qt::CaseInsensitive) == 0 &&
+         a.artist().compare(b.artist(), Qt::CaseInsensitive) == 0;
+}
+
+bool NameAndLengthLessThan(const Song& a, const Song& b) {
+  const int title = a.title().compare(b.title(), Qt::CaseInsensitive);
+  if (title != 0) return title < 0;
+  const int artist = a.artist().compare(b.artist(), Qt::CaseInsensitive);
+  if (artist != 0) return artist < 0;
+  return a.length_nanosec() < b.length_nanosec();
+}
+
+bool BitrateGreaterThan(const Song& a, const Song& b) {
+  return a.bitrate() > b.bitrate();
+}
+
+void AddGroup(SongList group, QList<SongList>* groups) {
+  if (group.count() < 2) return;
+  qStableSort(group.begin(), group.end(), BitrateGreaterThan);
+  *groups << group;
+}
+
+}  // namespace
+
+DuplicateFinder::DuplicateFinder(LibraryBackend* backend, Database* db,
+                                 TaskManager* task_manager, QObject* parent)
+    : QObject(parent),
+      backend_(backend),
+      db_(db),
+      task_manager_(task_manager),
+      task_id_(-1),
+      watcher_(nullptr),
+      cancelled_(0),
+      songs_done_(0),
+      songs_total_(0) {}
+
+DuplicateFinder::~DuplicateFinder() { Cancel(); }
+
+QList<SongList> DuplicateFinder::GroupCandidates(const SongList& songs) {
+  // The backend already returns them in this order, apart from titles that
+  // only differ in the case of non-ASCII letters.
+  SongList sorted(songs);
+  qStableSort(sorted.begin(), sorted.end(), NameAndLengthLessThan);
+
+  QList<SongList> ret;
+  SongList group;
+  for (const Song& song : sorted) {
+    if (!group.isEmpty() &&
+        (!IsSameName(group.first(), song) ||
+         song.length_nanosec() - group.first().length_nanosec() >
+             kLengthToleranceNanosec)) {
+      AddGroup(group, &ret);
+      group.clear();
+    }
+    group << song;
+  }
+  AddGroup(group, &ret);
+
+  return ret;
+}
+
+QList<SongList> DuplicateFinder::ConfirmGroup(Database* db,
+                                              const SongList& group,
+                                              QAtomicInt* cancelled) {
+  QList<SongList> matches;
+  QList<QString> fingerprints;
+
+  for (const Song& song : group) {
+    if (cancelled && *cancelled) return QList<SongList>();
+
+    const QString fingerprint = TagFetcher::GetFingerprint(db, song);
+    if (fingerprint.isEmpty()) {
+      qLog(Warning) << "Couldn't fingerprint" << song.url().toLocalFile();
+      continue;
+    }
+
+    // Songs are compared with the first song of each match so far.
+    int i = 0;
+    for (; i < matches.count(); ++i) {
+      if (Chromaprinter::Similarity(fingerprints[i], fingerprint) >=
+          kMinFingerprintSimilarity) {
+        break;
+      }
+    }
+    if (i == matches.count()) {
+      matches << SongList();
+      fingerprints << fingerprint;
+    }
+    matches[i] << song;
+  }
+
+  QList<SongList> ret;
+  for (const SongList& match : matches) {
+    if (match.count() >= 2) ret << match;
+  }
+  return ret;
+}
+
+void DuplicateFinder::Start(bool use_fingerprints) {
+  if (is_running()) return;
+
+  task_id_ = task_manager_->StartTask(tr("Finding duplicate songs"));
+
+  QFutureWatcher<QList<SongList>>* watcher =
+      new QFutureWatcher<QList<SongList>>(this);
+  NewClosure(watcher, SIGNAL(finished()), [=]() {
+    CandidatesGrouped(watcher->result(), use_fingerprints);
+    watcher->deleteLater();
+  });
+  watcher->setFuture(ThreadPools::Run<QList<SongList>>(
+      ThreadPools::Pool_Background, std::bind(&LoadGroups, backend_)));
+}
+
+void DuplicateFinder::CandidatesGrouped(const QList<SongList>& groups,
+                                        bool use_fingerprints) {
+  if (!is_running()) return;
+
+  groups_ = groups;
+  qLog(Info) << "Found" << groups_.count() << "groups of possible duplicates";
+
+  if (!use_fingerprints || groups_.isEmpty()) {
+    confirmed_.clear();
+    for (const SongList& group : groups_) {
+      confirmed_ << (QList<SongList>() << group);
+    }
+    Finish();
+    return;
+  }
+
+  songs_done_ = 0;
+  songs_total_ = 0;
+  for (const SongList& group : groups_) {
+    songs_total_ += group.count();
+  }
+  confirmed_ = QVector<QList<SongList>>(groups_.count());
+
+  watcher_ = new QFutureWatcher<QList<SongList>>(this);
+  connect(watcher_, SIGNAL(resultReadyAt(int)), SLOT(GroupConfirmed(int)));
+  connect(watcher_, SIGNAL(finished()), SLOT(AllGroupsConfirmed()));
+  cancelled_ = 0;
+  watcher_->setFuture(
+      QtConcurrent::mapped(groups_, ConfirmGroupFunctor(db_, &cancelled_)));
+}
+
+void DuplicateFinder::GroupConfirmed(int index) {
+  if (!watcher_ || index >= groups_.count()) return;
+
+  confirmed_[index] = watcher_->resultAt(index);
+
+  songs_done_ += groups_[index].count();
+  task_manager_->SetTaskProgress(task_id_, songs_done_, songs_total_);
+}
+
+void DuplicateFinder::AllGroupsConfirmed() {
+  if (watcher_) {
+    watcher_->deleteLater();
+    watcher_ = nullptr;
+  }
+  Finish();
+}
+
+void DuplicateFinder::Finish() {
+  QList<SongList> results;
+  for (const QList<SongList>& groups : confirmed_) {
+    results << groups;
+  }
+  groups_.clear();
+  confirmed_.clear();
+
+  if (is_running()) {
+    task_manager_->SetTaskFinished(task_id_);
+    task_id_ = -1;
+    emit Finished(results);
+  }
+}
+
+void DuplicateFinder::Cancel() {
+  if (watcher_) {
+    // Stop the groups that are being fingerprinted as well as the queued
+    // ones.
+    cancelled_ = 1;
+    watcher_->disconnect(this);
+    watcher_->cancel();
+    watcher_->waitForFinished();
+    watcher_->deleteLater();
+    watcher_ = nullptr;
+  }
+  groups_.clear();
+  confirmed_.clear();
+
+  if (is_running()) {
+    task_manager_->SetTaskFinished(task_id_);
+    task_id_ = -1;
+  }
+}
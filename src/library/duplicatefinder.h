@@ -0,0 +1,97 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARY_DUPLICATEFINDER_H_
+#define LIBRARY_DUPLICATEFINDER_H_
+
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QVector>
+
+#include "core/song.h"
+
+class Database;
+class LibraryBackend;
+class TaskManager;
+
+class DuplicateFinder : public QObject {
+  // Finds songs that are in the library more than once.  Songs are grouped by
+  // title and artist, ignoring case, and by length, using an index so only
+  // the songs that have a possible duplicate are loaded.  The groups can then
+  // be checked by comparing the songs' Chromaprint fingerprints, which are
+  // cached in the database, so a different recording with the same name
+  // isn't reported.
+
+  Q_OBJECT
+
+ public:
+  DuplicateFinder(LibraryBackend* backend, Database* db,
+                  TaskManager* task_manager, QObject* parent = nullptr);
+  ~DuplicateFinder();
+
+  // Songs whose lengths are further apart than this aren't duplicates.
+  static const qint64 kLengthToleranceNanosec;
+  // How alike the fingerprints of two songs have to be, see
+  // Chromaprinter::Similarity.
+  static const float kMinFingerprintSimilarity;
+
+  bool is_running() const { return task_id_ != -1; }
+
+  // Splits songs into groups with the same title and artist, and lengths
+  // that are close to the first song's.  Songs without a duplicate are left
+  // out, and the highest bitrate comes first in each group.
+  static QList<SongList> GroupCandidates(const SongList& songs);
+
+  // Splits a group into the songs whose fingerprints match.  This method is
+  // blocking, so you want to call it in another thread.  Gives up and returns
+  // nothing once cancelled is non-zero.
+  static QList<SongList> ConfirmGroup(Database* db, const SongList& group,
+                                      QAtomicInt* cancelled = nullptr);
+
+ public slots:
+  void Start(bool use_fingerprints);
+  void Cancel();
+
+ signals:
+  void Finished(const QList<SongList>& groups);
+
+ private slots:
+  void GroupConfirmed(int index);
+  void AllGroupsConfirmed();
+
+ private:
+  void CandidatesGrouped(const QList<SongList>& groups,
+                         bool use_fingerprints);
+  void Finish();
+
+ private:
+  LibraryBackend* backend_;
+  Database* db_;
+  TaskManager* task_manager_;
+
+  int task_id_;
+  QList<SongList> groups_;
+  QVector<QList<SongList>> confirmed_;
+  QFutureWatcher<QList<SongList>>* watcher_;
+  QAtomicInt cancelled_;
+  int songs_done_;
+  int songs_total_;
+};
+
+#endif  // LIBRARY_DUPLICATEFINDER_H_
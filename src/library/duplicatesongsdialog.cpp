@@ -0,0 +1,104 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "duplicatesongsdialog.h"
+#include "ui_duplicatesongsdialog.h"
+
+#include <QSet>
+
+#include "duplicatefinder.h"
+#include "library.h"
+#include "playlist/songmimedata.h"
+
+DuplicateSongsDialog::DuplicateSongsDialog(Library* library, QWidget* parent)
+    : QDialog(parent), ui_(new Ui_DuplicateSongsDialog), library_(library) {
+  ui_->setupUi(this);
+
+  connect(ui_->find, SIGNAL(clicked()), SLOT(Find()));
+  connect(ui_->add_to_playlist, SIGNAL(clicked()),
+          SLOT(AddSelectedToPlaylist()));
+  connect(ui_->groups, SIGNAL(itemDoubleClicked(QTreeWidgetItem*, int)),
+          SLOT(AddSelectedToPlaylist()));
+  connect(ui_->groups, SIGNAL(itemSelectionChanged()), SLOT(UpdateButtons()));
+
+  connect(library_->duplicate_finder(), SIGNAL(Finished(QList<SongList>)),
+          SLOT(Finished(QList<SongList>)));
+}
+
+DuplicateSongsDialog::~DuplicateSongsDialog() {}
+
+void DuplicateSongsDialog::Find() {
+  ui_->find->setEnabled(false);
+  library_->duplicate_finder()->Start(ui_->use_fingerprints->isChecked());
+}
+
+void DuplicateSongsDialog::Finished(const QList<SongList>& groups) {
+  ui_->find->setEnabled(true);
+  ui_->groups->clear();
+
+  QList<QTreeWidgetItem*> items;
+  for (const SongList& group : groups) {
+    QTreeWidgetItem* group_item = new QTreeWidgetItem;
+    group_item->setText(0, group.first().PrettyTitleWithArtist());
+
+    for (const Song& song : group) {
+      QTreeWidgetItem* item = new QTreeWidgetItem(group_item);
+      item->setText(0, song.PrettyTitle());
+      item->setText(1, song.PrettyLength());
+      item->setText(2, tr("%1 kbps").arg(song.bitrate()));
+      item->setText(3, song.url().toLocalFile());
+      item->setData(0, Role_Song, QVariant::fromValue(song));
+    }
+    items << group_item;
+  }
+
+  ui_->groups->addTopLevelItems(items);
+  ui_->groups->expandAll();
+  ui_->groups->resizeColumnToContents(0);
+}
+
+void DuplicateSongsDialog::UpdateButtons() {
+  ui_->add_to_playlist->setEnabled(!ui_->groups->selectedItems().isEmpty());
+}
+
+void DuplicateSongsDialog::AddSelectedToPlaylist() {
+  // A selected group stands for all its songs.
+  QList<QTreeWidgetItem*> items;
+  for (QTreeWidgetItem* item : ui_->groups->selectedItems()) {
+    if (item->parent()) {
+      items << item;
+    } else {
+      for (int i = 0; i < item->childCount(); ++i) {
+        items << item->child(i);
+      }
+    }
+  }
+
+  SongList songs;
+  QSet<QTreeWidgetItem*> seen;
+  for (QTreeWidgetItem* item : items) {
+    if (seen.contains(item)) continue;
+    seen.insert(item);
+    songs << item->data(0, Role_Song).value<Song>();
+  }
+  if (songs.isEmpty()) return;
+
+  SongMimeData* data = new SongMimeData;
+  data->backend = library_->backend();
+  data->songs = songs;
+  emit AddToPlaylist(data);
+}
@@ -0,0 +1,58 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DUPLICATESONGSDIALOG_H
+#define DUPLICATESONGSDIALOG_H
+
+#include <QDialog>
+
+#include <memory>
+
+#include "core/song.h"
+
+class Library;
+class QMimeData;
+class Ui_DuplicateSongsDialog;
+
+// Shows the groups of duplicate songs found by the library's
+// DuplicateFinder, so they can be added to a playlist and dealt with there.
+class DuplicateSongsDialog : public QDialog {
+  Q_OBJECT
+
+ public:
+  DuplicateSongsDialog(Library* library, QWidget* parent = nullptr);
+  ~DuplicateSongsDialog();
+
+  enum Role {
+    Role_Song = Qt::UserRole + 1,
+  };
+
+ signals:
+  void AddToPlaylist(QMimeData* data);
+
+ private slots:
+  void Find();
+  void Finished(const QList<SongList>& groups);
+  void UpdateButtons();
+  void AddSelectedToPlaylist();
+
+ private:
+  std::unique_ptr<Ui_DuplicateSongsDialog> ui_;
+  Library* library_;
+};
+
+#endif  // DUPLICATESONGSDIALOG_H
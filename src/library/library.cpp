@@ -17,14 +17,18 @@
 
 #include "library.h"
 
+#include "audiofeatureanalyser.h"
+#include "duplicatefinder.h"
 #include "librarymodel.h"
 #include "librarybackend.h"
+#include "replaygainanalyser.h"
 #include "core/application.h"
 #include "core/database.h"
 #include "core/player.h"
 #include "core/tagreaderclient.h"
 #include "core/taskmanager.h"
 #include "core/thread.h"
+#include "core/utilities.h"
 #include "smartplaylists/generator.h"
 #include "smartplaylists/querygenerator.h"
 #include "smartplaylists/search.h"
@@ -34,6 +38,8 @@ const char* Library::kDirsTable = "directories";
 const char* Library::kSubdirsTable = "subdirectories";
 const char* Library::kFtsTable = "songs_fts";
 
+const int Library::kMaxFileWritesInFlight = 2;
+
 Library::Library(Application* app, QObject* parent)
     : QObject(parent),
       app_(app),
@@ -41,8 +47,12 @@ Library::Library(Application* app, QObject* parent)
       model_(nullptr),
       watcher_(nullptr),
       watcher_thread_(nullptr),
+      replaygain_analyser_(nullptr),
+      duplicate_finder_(nullptr),
+      audio_feature_analyser_(nullptr),
       save_statistics_in_files_(false),
-      save_ratings_in_files_(false) {
+      save_ratings_in_files_(false),
+      file_writes_in_flight_(0) {
   backend_ = new LibraryBackend;
   backend()->moveToThread(app->database()->thread());
 
@@ -56,6 +66,15 @@ Library::Library(Application* app, QObject* parent)
   using smart_playlists::SearchTerm;
 
   model_ = new LibraryModel(backend_, app_, this);
+  model_->set_snapshot_filename(
+      Utilities::GetConfigPath(Utilities::Path_CacheRoot) +
+      "/library.snapshot");
+  replaygain_analyser_ =
+      new ReplayGainAnalyser(backend_, app_->task_manager(), this);
+  duplicate_finder_ = new DuplicateFinder(backend_, app_->database(),
+                                          app_->task_manager(), this);
+  audio_feature_analyser_ =
+      new AudioFeatureAnalyser(backend_, app_->task_manager(), this);
   model_->set_show_smart_playlists(true);
   model_->set_default_smart_playlists(
       LibraryModel::DefaultGenerators()
@@ -171,6 +190,10 @@ void Library::IncrementalScan() { watcher_->IncrementalScanAsync(); }
 
 void Library::FullScan() { watcher_->FullScanAsync(); }
 
+void Library::AnalyseLoudness() { replaygain_analyser_->Start(); }
+
+void Library::AnalyseAudioFeatures() { audio_feature_analyser_->Start(); }
+
 void Library::PauseWatcher() { watcher_->SetRescanPausedAsync(true); }
 
 void Library::ResumeWatcher() { watcher_->SetRescanPausedAsync(false); }
@@ -227,16 +250,49 @@ void Library::CurrentSongChanged(const Song& song) {
 
 void Library::SongsRatingChanged(const SongList& songs) {
   if (save_ratings_in_files_) {
-    app_->tag_reader_client()->UpdateSongsRating(
-        FilterCurrentWMASong(songs, &queued_rating_));
+    QueueFileWrites(FilterCurrentWMASong(songs, &queued_rating_),
+                    &pending_rating_writes_);
   }
 }
 
 void Library::SongsStatisticsChanged(const SongList& songs) {
   if (save_statistics_in_files_) {
-    app_->tag_reader_client()->UpdateSongsStatistics(
-        FilterCurrentWMASong(songs, &queued_statistics_));
+    QueueFileWrites(FilterCurrentWMASong(songs, &queued_statistics_),
+                    &pending_statistics_writes_);
+  }
+}
+
+void Library::QueueFileWrites(const SongList& songs, QMap<QUrl, Song>* queue) {
+  for (const Song& song : songs) {
+    (*queue)[song.url()] = song;
   }
+  WriteQueuedFiles();
+}
+
+void Library::WriteQueuedFiles() {
+  while (file_writes_in_flight_ < kMaxFileWritesInFlight) {
+    TagReaderReply* reply = nullptr;
+    if (!pending_rating_writes_.isEmpty()) {
+      const Song song = pending_rating_writes_.take(
+          pending_rating_writes_.firstKey());
+      reply = app_->tag_reader_client()->UpdateSongRating(song);
+    } else if (!pending_statistics_writes_.isEmpty()) {
+      const Song song = pending_statistics_writes_.take(
+          pending_statistics_writes_.firstKey());
+      reply = app_->tag_reader_client()->UpdateSongStatistics(song);
+    } else {
+      return;
+    }
+
+    file_writes_in_flight_++;
+    connect(reply, SIGNAL(Finished(bool)), SLOT(FileWriteFinished()));
+    connect(reply, SIGNAL(Finished(bool)), reply, SLOT(deleteLater()));
+  }
+}
+
+void Library::FileWriteFinished() {
+  file_writes_in_flight_--;
+  WriteQueuedFiles();
 }
 
 SongList Library::FilterCurrentWMASong(SongList songs, Song* queued) {
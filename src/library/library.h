@@ -19,16 +19,20 @@
 #define LIBRARY_H
 
 #include <QHash>
+#include <QMap>
 #include <QObject>
 #include <QUrl>
 
 #include "core/song.h"
 
 class Application;
+class AudioFeatureAnalyser;
 class Database;
+class DuplicateFinder;
 class LibraryBackend;
 class LibraryModel;
 class LibraryWatcher;
+class ReplayGainAnalyser;
 class TaskManager;
 class Thread;
 
@@ -44,10 +48,14 @@ class Library : public QObject {
   static const char* kSubdirsTable;
   static const char* kFtsTable;
 
+  // How many tag writes are sent to the tag reader at once.
+  static const int kMaxFileWritesInFlight;
+
   void Init();
 
   LibraryBackend* backend() const { return backend_; }
   LibraryModel* model() const { return model_; }
+  DuplicateFinder* duplicate_finder() const { return duplicate_finder_; }
 
   QString full_rescan_reason(int schema_version) const {
     return full_rescan_revisions_.value(schema_version, QString());
@@ -63,6 +71,12 @@ class Library : public QObject {
 
   void FullScan();
 
+  // Works out gains in the background for songs that don't have them yet.
+  void AnalyseLoudness();
+  // Works out the features that "similar tracks" dynamic playlists use, for
+  // songs that don't have them yet.
+  void AnalyseAudioFeatures();
+
  private slots:
   void IncrementalScan();
 
@@ -71,8 +85,12 @@ class Library : public QObject {
   void CurrentSongChanged(const Song& song);
   void Stopped();
 
+  void WriteQueuedFiles();
+  void FileWriteFinished();
+
  private:
   SongList FilterCurrentWMASong(SongList songs, Song* queued);
+  void QueueFileWrites(const SongList& songs, QMap<QUrl, Song>* queue);
 
  private:
   Application* app_;
@@ -82,6 +100,10 @@ class Library : public QObject {
   LibraryWatcher* watcher_;
   Thread* watcher_thread_;
 
+  ReplayGainAnalyser* replaygain_analyser_;
+  DuplicateFinder* duplicate_finder_;
+  AudioFeatureAnalyser* audio_feature_analyser_;
+
   bool save_statistics_in_files_;
   bool save_ratings_in_files_;
 
@@ -92,6 +114,14 @@ class Library : public QObject {
   Song queued_statistics_;
   Song queued_rating_;
 
+  // Ratings and statistics waiting to be written to the files, by URL.  A
+  // newer change to the same file replaces the one waiting, so bulk edits
+  // only rewrite each file once per kind, and only a few are written at a
+  // time so the tag reader stays free for everything else.
+  QMap<QUrl, Song> pending_rating_writes_;
+  QMap<QUrl, Song> pending_statistics_writes_;
+  int file_writes_in_flight_;
+
   // DB schema versions which should trigger a full library rescan (each of
   // those with a short reason why).
   QHash<int, QString> full_rescan_revisions_;
@@ -17,23 +17,96 @@
 
 #include "librarybackend.h"
 #include "libraryquery.h"
+#include "similarityindex.h"
+#include "sqlitequery.h"
 #include "sqlrow.h"
 #include "core/application.h"
 #include "core/database.h"
 #include "core/scopedtransaction.h"
 #include "core/tagreaderclient.h"
+#include "core/tracing.h"
 #include "core/utilities.h"
 #include "smartplaylists/search.h"
 
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDateTime>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFileInfo>
+#include <QMap>
 #include <QSettings>
 #include <QVariant>
 #include <QtDebug>
 
 const char* LibraryBackend::kSettingsGroup = "LibraryBackend";
+const int LibraryBackend::kMaxTransactionMsec = 20;
+const int LibraryBackend::kMaterializedSearchMaxAgeSecs =
+    60 * 60 * 24 * 30;  // 30 days
+
+namespace {
+
+// Changed songs are checked against the materialized searches this many at a
+// time, to keep the generated SQL short.
+const int kMaterializedUpdateBatchSize = 500;
+
+QString MaterializedSongsSql(const QString& key) {
+  return "ROWID IN (SELECT song_id FROM smart_playlist_songs"
+         " WHERE search_key = '" + key + "')";
+}
+
+// Whether the sort value a comes after b in the search's sort order, i.e.
+// the results got worse when the last one changed from b to a.
+bool SortsAfter(const QVariant& a, const QVariant& b,
+                const smart_playlists::Search& search) {
+  using smart_playlists::Search;
+  using smart_playlists::SearchTerm;
+
+  if (a.isNull() || b.isNull()) return a.isNull() != b.isNull();
+
+  int cmp = 0;
+  if (SearchTerm::TypeOf(search.sort_field_) == SearchTerm::Type_Text) {
+    cmp = QString::compare(a.toString(), b.toString());
+  } else if (a.toDouble() != b.toDouble()) {
+    cmp = a.toDouble() < b.toDouble() ? -1 : 1;
+  }
+  return search.sort_type_ == Search::Sort_FieldAsc ? cmp > 0 : cmp < 0;
+}
+
+QVariant SerializeArtCandidates(const ArtCandidateList& candidates) {
+  if (candidates.isEmpty()) return QVariant(QVariant::ByteArray);
+
+  QByteArray ret;
+  QDataStream s(&ret, QIODevice::WriteOnly);
+  s << qint32(candidates.count());
+  for (const ArtCandidate& candidate : candidates) {
+    s << candidate.path << quint32(candidate.mtime) << candidate.size;
+  }
+  return ret;
+}
+
+ArtCandidateList DeserializeArtCandidates(const QByteArray& data) {
+  ArtCandidateList ret;
+  if (data.isEmpty()) return ret;
+
+  QDataStream s(data);
+  qint32 count = 0;
+  s >> count;
+  for (int i = 0; i < count && s.status() == QDataStream::Ok; ++i) {
+    ArtCandidate candidate;
+    quint32 mtime = 0;
+    s >> candidate.path >> mtime >> candidate.size;
+    candidate.mtime = mtime;
+    ret << candidate;
+  }
+
+  // Better to read every image again than to trust half of a list.
+  if (s.status() != QDataStream::Ok) ret.clear();
+  return ret;
+}
+
+}  // namespace
 
 const char* LibraryBackend::kNewScoreSql =
     "case when playcount <= 0 then (%1 * 100 + score) / 2"
@@ -43,18 +116,51 @@ const char* LibraryBackend::kNewScoreSql =
 
 LibraryBackend::LibraryBackend(QObject* parent)
     : LibraryBackendInterface(parent),
+      db_(nullptr),
+      songs_mutex_(nullptr),
       save_statistics_in_file_(false),
-      save_ratings_in_file_(false) {}
+      save_ratings_in_file_(false),
+      statistics_loaded_(false),
+      snapshot_loaded_(false),
+      materialized_searches_loaded_(false),
+      query_cache_generation_(0) {}
 
 void LibraryBackend::Init(Database* db, const QString& songs_table,
                           const QString& dirs_table,
                           const QString& subdirs_table,
                           const QString& fts_table) {
   db_ = db;
+  songs_mutex_ = db->Mutex(Database::DatabaseForTable(songs_table));
   songs_table_ = songs_table;
   dirs_table_ = dirs_table;
   subdirs_table_ = subdirs_table;
   fts_table_ = fts_table;
+
+  // Queued so the searches are updated after the change has been committed
+  // and everyone else has been told about it.
+  connect(this, SIGNAL(SongsDiscovered(SongList)),
+          SLOT(UpdateMaterializedSearches(SongList)), Qt::QueuedConnection);
+  connect(this, SIGNAL(SongsDeleted(SongList)),
+          SLOT(UpdateMaterializedSearches(SongList)), Qt::QueuedConnection);
+  connect(this, SIGNAL(SongsStatisticsChanged(SongList)),
+          SLOT(UpdateMaterializedSearches(SongList)), Qt::QueuedConnection);
+  connect(this, SIGNAL(SongsRatingChanged(SongList)),
+          SLOT(UpdateMaterializedSearches(SongList)), Qt::QueuedConnection);
+  connect(this, SIGNAL(DatabaseReset()), SLOT(ResetMaterializedSearches()),
+          Qt::QueuedConnection);
+
+  // Direct, so the cache is cleared before anyone else hears about the
+  // change and looks the artists up again.
+  connect(this, SIGNAL(SongsDiscovered(SongList)),
+          SLOT(InvalidateQueryCache()), Qt::DirectConnection);
+  connect(this, SIGNAL(SongsDeleted(SongList)), SLOT(InvalidateQueryCache()),
+          Qt::DirectConnection);
+  connect(this, SIGNAL(DatabaseReset()), SLOT(InvalidateQueryCache()),
+          Qt::DirectConnection);
+}
+
+QString LibraryBackend::database_name() const {
+  return Database::DatabaseForTable(songs_table_);
 }
 
 void LibraryBackend::LoadDirectoriesAsync() {
@@ -67,36 +173,62 @@ void LibraryBackend::UpdateTotalSongCountAsync() {
 }
 
 void LibraryBackend::IncrementPlayCountAsync(int id) {
-  metaObject()->invokeMethod(this, "IncrementPlayCount", Qt::QueuedConnection,
-                             Q_ARG(int, id));
+  QueueStatisticsUpdates(StatisticsUpdateList()
+                         << StatisticsUpdate(StatisticsUpdate::PlayCount, id));
 }
 
 void LibraryBackend::IncrementSkipCountAsync(int id, float progress) {
-  metaObject()->invokeMethod(this, "IncrementSkipCount", Qt::QueuedConnection,
-                             Q_ARG(int, id), Q_ARG(float, progress));
+  QueueStatisticsUpdates(
+      StatisticsUpdateList()
+      << StatisticsUpdate(StatisticsUpdate::SkipCount, id, progress));
 }
 
 void LibraryBackend::ResetStatisticsAsync(int id) {
-  metaObject()->invokeMethod(this, "ResetStatistics", Qt::QueuedConnection,
-                             Q_ARG(int, id));
+  QueueStatisticsUpdates(StatisticsUpdateList()
+                         << StatisticsUpdate(StatisticsUpdate::Reset, id));
 }
 
 void LibraryBackend::UpdateSongRatingAsync(int id, float rating) {
-  metaObject()->invokeMethod(this, "UpdateSongRating", Qt::QueuedConnection,
-                             Q_ARG(int, id), Q_ARG(float, rating));
+  UpdateSongsRatingAsync(QList<int>() << id, rating);
 }
 
 void LibraryBackend::UpdateSongsRatingAsync(const QList<int>& ids,
                                             float rating) {
-  metaObject()->invokeMethod(this, "UpdateSongsRating", Qt::QueuedConnection,
-                             Q_ARG(const QList<int>&, ids),
-                             Q_ARG(float, rating));
+  StatisticsUpdateList updates;
+  for (int id : ids) {
+    updates << StatisticsUpdate(StatisticsUpdate::Rating, id, rating);
+  }
+  QueueStatisticsUpdates(updates);
+}
+
+void LibraryBackend::QueueStatisticsUpdates(
+    const StatisticsUpdateList& updates) {
+  if (updates.isEmpty()) return;
+
+  QMutexLocker l(&pending_updates_mutex_);
+  const bool flush_scheduled = !pending_updates_.isEmpty();
+  pending_updates_ << updates;
+
+  // Anything queued before the flush runs is written along with these.
+  if (!flush_scheduled) {
+    metaObject()->invokeMethod(this, "FlushStatisticsUpdates",
+                               Qt::QueuedConnection);
+  }
+}
+
+void LibraryBackend::FlushStatisticsUpdates() {
+  StatisticsUpdateList updates;
+  {
+    QMutexLocker l(&pending_updates_mutex_);
+    updates.swap(pending_updates_);
+  }
+  ApplyStatisticsUpdates(updates);
 }
 
 void LibraryBackend::LoadDirectories() {
   DirectoryList dirs = GetAllDirectories();
 
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
   for (const Directory& dir : dirs) {
@@ -106,7 +238,7 @@ void LibraryBackend::LoadDirectories() {
 
 void LibraryBackend::ChangeDirPath(int id, const QString& old_path,
                                    const QString& new_path) {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
   ScopedTransaction t(&db);
 
@@ -151,7 +283,7 @@ void LibraryBackend::ChangeDirPath(int id, const QString& old_path,
 }
 
 DirectoryList LibraryBackend::GetAllDirectories() {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
   DirectoryList ret;
@@ -171,16 +303,18 @@ DirectoryList LibraryBackend::GetAllDirectories() {
 }
 
 SubdirectoryList LibraryBackend::SubdirsInDirectory(int id) {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db = db_->Connect();
   return SubdirsInDirectory(id, db);
 }
 
 SubdirectoryList LibraryBackend::SubdirsInDirectory(int id, QSqlDatabase& db) {
-  QSqlQuery q(QString(
-                  "SELECT path, mtime FROM %1"
-                  " WHERE directory = :dir").arg(subdirs_table_),
-              db);
+  QSqlQuery q = db_->PreparedQuery(QString(
+                                       "SELECT path, mtime, art_candidates"
+                                       " FROM %1"
+                                       " WHERE directory = :dir")
+                                       .arg(subdirs_table_),
+                                   db);
   q.bindValue(":dir", id);
   q.exec();
   if (db_->CheckErrors(q)) return SubdirectoryList();
@@ -191,6 +325,7 @@ SubdirectoryList LibraryBackend::SubdirsInDirectory(int id, QSqlDatabase& db) {
     subdir.directory_id = id;
     subdir.path = q.value(0).toString();
     subdir.mtime = q.value(1).toUInt();
+    subdir.art_candidates = DeserializeArtCandidates(q.value(2).toByteArray());
     subdirs << subdir;
   }
 
@@ -198,17 +333,98 @@ SubdirectoryList LibraryBackend::SubdirsInDirectory(int id, QSqlDatabase& db) {
 }
 
 void LibraryBackend::UpdateTotalSongCount() {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  emit TotalSongCountUpdated(statistics().song_count);
+}
 
-  QSqlQuery q(QString("SELECT COUNT(*) FROM %1 WHERE unavailable = 0")
-                  .arg(songs_table_),
+LibraryBackend::Statistics LibraryBackend::statistics() {
+  QMutexLocker l(songs_mutex_);
+  if (!statistics_loaded_) {
+    QSqlDatabase db(db_->Connect());
+    LoadStatistics(db);
+  }
+  return statistics_;
+}
+
+void LibraryBackend::LoadStatistics(QSqlDatabase& db) {
+  QSqlQuery q(QString(
+                  "SELECT artist, album, COUNT(*), SUM(length), SUM(filesize)"
+                  " FROM %1 WHERE unavailable = 0"
+                  " GROUP BY artist, album").arg(songs_table_),
               db);
   q.exec();
   if (db_->CheckErrors(q)) return;
-  if (!q.next()) return;
 
-  emit TotalSongCountUpdated(q.value(0).toInt());
+  Statistics statistics;
+  while (q.next()) {
+    const int count = q.value(2).toInt();
+    statistics.song_count += count;
+    statistics.total_length_nanosec += q.value(3).toLongLong();
+    statistics.total_filesize += q.value(4).toLongLong();
+    statistics.artist_song_count[q.value(0).toString()] += count;
+    statistics.album_song_count[q.value(1).toString()] += count;
+  }
+
+  statistics_ = statistics;
+  statistics_loaded_ = true;
+}
+
+LibrarySnapshot LibraryBackend::snapshot() {
+  QMutexLocker l(songs_mutex_);
+  if (!snapshot_loaded_) {
+    QSqlDatabase db(db_->Connect());
+    LoadSnapshot(db);
+  }
+  return snapshot_;
+}
+
+void LibraryBackend::LoadSnapshot(QSqlDatabase& db) {
+  SqliteQuery q(db, QString(
+                        "SELECT ROWID, artist, album, year, length, rating"
+                        " FROM %1 WHERE unavailable = 0").arg(songs_table_));
+  if (!q.Exec()) return;
+
+  LibrarySnapshot snapshot;
+  while (q.Next()) {
+    Song song;
+    song.set_id(q.Int(0));
+    song.set_artist(q.String(1));
+    song.set_album(q.String(2));
+    song.set_year(q.IsNull(3) ? -1 : q.Int(3));
+    song.set_length_nanosec(q.IsNull(4) ? -1 : q.LongLong(4));
+    song.set_rating(q.IsNull(5) ? -1 : q.Double(5));
+    snapshot.Add(song);
+  }
+  if (q.has_error()) return;
+
+  snapshot_ = snapshot;
+  snapshot_loaded_ = true;
+}
+
+void LibraryBackend::AddToStatistics(const Song& song, int sign) {
+  if (song.is_unavailable()) return;
+
+  if (snapshot_loaded_) {
+    if (sign > 0) {
+      snapshot_.Add(song);
+    } else {
+      snapshot_.Remove(song.id());
+    }
+  }
+
+  if (!statistics_loaded_) return;
+
+  statistics_.song_count += sign;
+  statistics_.total_length_nanosec += sign * song.length_nanosec();
+  statistics_.total_filesize += sign * song.filesize();
+
+  // Drop the entries that reach zero so the maps don't grow forever.
+  int& artist_count = statistics_.artist_song_count[song.artist()];
+  artist_count += sign;
+  if (artist_count <= 0) statistics_.artist_song_count.remove(song.artist());
+
+  int& album_count = statistics_.album_song_count[song.album()];
+  album_count += sign;
+  if (album_count <= 0) statistics_.album_song_count.remove(song.album());
 }
 
 void LibraryBackend::AddDirectory(const QString& path) {
@@ -222,7 +438,7 @@ void LibraryBackend::AddDirectory(const QString& path) {
     qLog(Debug) << "db_path" << db_path;
   }
 
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
   QSqlQuery q(QString(
@@ -241,7 +457,7 @@ void LibraryBackend::AddDirectory(const QString& path) {
 }
 
 void LibraryBackend::RemoveDirectory(const Directory& dir) {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
   // Remove songs first
@@ -269,10 +485,10 @@ void LibraryBackend::RemoveDirectory(const Directory& dir) {
 }
 
 SongList LibraryBackend::FindSongsInDirectory(int id) {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery q(
+  QSqlQuery q = db_->PreparedQuery(
       QString("SELECT ROWID, " + Song::kColumnSpec +
               " FROM %1 WHERE directory = :directory").arg(songs_table_),
       db);
@@ -300,7 +516,7 @@ void LibraryBackend::SongPathChanged(const Song& song,
 }
 
 void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
   QSqlQuery find_query(
       QString(
@@ -308,12 +524,14 @@ void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
           " WHERE directory = :id AND path = :path").arg(subdirs_table_),
       db);
   QSqlQuery add_query(QString(
-                          "INSERT INTO %1 (directory, path, mtime)"
-                          " VALUES (:id, :path, :mtime)").arg(subdirs_table_),
+                          "INSERT INTO %1 (directory, path, mtime,"
+                          " art_candidates)"
+                          " VALUES (:id, :path, :mtime, :art_candidates)")
+                          .arg(subdirs_table_),
                       db);
   QSqlQuery update_query(
       QString(
-          "UPDATE %1 SET mtime = :mtime"
+          "UPDATE %1 SET mtime = :mtime, art_candidates = :art_candidates"
           " WHERE directory = :id AND path = :path").arg(subdirs_table_),
       db);
   QSqlQuery delete_query(
@@ -337,8 +555,11 @@ void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
       find_query.exec();
       if (db_->CheckErrors(find_query)) continue;
 
+      const QVariant art_candidates =
+          SerializeArtCandidates(subdir.art_candidates);
       if (find_query.next()) {
         update_query.bindValue(":mtime", subdir.mtime);
+        update_query.bindValue(":art_candidates", art_candidates);
         update_query.bindValue(":id", subdir.directory_id);
         update_query.bindValue(":path", subdir.path);
         update_query.exec();
@@ -347,6 +568,7 @@ void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
         add_query.bindValue(":id", subdir.directory_id);
         add_query.bindValue(":path", subdir.path);
         add_query.bindValue(":mtime", subdir.mtime);
+        add_query.bindValue(":art_candidates", art_candidates);
         add_query.exec();
         db_->CheckErrors(add_query);
       }
@@ -356,103 +578,168 @@ void LibraryBackend::AddOrUpdateSubdirs(const SubdirectoryList& subdirs) {
 }
 
 void LibraryBackend::AddOrUpdateSongs(const SongList& songs) {
-  QMutexLocker l(db_->Mutex());
-  QSqlDatabase db(db_->Connect());
+  qTraceScope("LibraryBackend::AddOrUpdateSongs");
+
+  // Songs are written in a series of short transactions rather than one big
+  // one, and the database mutex is released between them so LibraryModel and
+  // friends never wait behind a whole scan batch.  FTS rows are written
+  // afterwards in the same way.
+  SongList fts_added;
+  SongList fts_updated;
+
+  int next = 0;
+  while (next < songs.count()) {
+    next = AddOrUpdateSongsChunk(songs, next, &fts_added, &fts_updated);
+  }
 
-  QSqlQuery check_dir(
-      QString("SELECT ROWID FROM %1 WHERE ROWID = :id").arg(dirs_table_), db);
-  QSqlQuery add_song(QString("INSERT INTO %1 (" + Song::kColumnSpec +
-                             ")"
-                             " VALUES (" +
-                             Song::kBindSpec + ")").arg(songs_table_),
-                     db);
-  QSqlQuery update_song(QString("UPDATE %1 SET " + Song::kUpdateSpec +
-                                " WHERE ROWID = :id").arg(songs_table_),
-                        db);
-  QSqlQuery add_song_fts(
-      QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec +
-              ")"
-              " VALUES (:id, " +
-              Song::kFtsBindSpec + ")").arg(fts_table_),
-      db);
-  QSqlQuery update_song_fts(QString("UPDATE %1 SET " + Song::kFtsUpdateSpec +
-                                    " WHERE ROWID = :id").arg(fts_table_),
-                            db);
+  next = 0;
+  while (next < fts_added.count()) {
+    next = UpdateFtsChunk(fts_added, next, false);
+  }
 
-  ScopedTransaction transaction(&db);
+  next = 0;
+  while (next < fts_updated.count()) {
+    next = UpdateFtsChunk(fts_updated, next, true);
+  }
+
+  UpdateTotalSongCountAsync();
+}
 
+int LibraryBackend::AddOrUpdateSongsChunk(const SongList& songs, int first,
+                                          SongList* fts_added,
+                                          SongList* fts_updated) {
   SongList added_songs;
   SongList deleted_songs;
+  int next = first;
 
-  for (const Song& song : songs) {
-    // Do a sanity check first - make sure the song's directory still exists
-    // This is to fix a possible race condition when a directory is removed
-    // while LibraryWatcher is scanning it.
-    if (!dirs_table_.isEmpty()) {
-      check_dir.bindValue(":id", song.directory_id());
-      check_dir.exec();
-      if (db_->CheckErrors(check_dir)) continue;
-
-      if (!check_dir.next()) continue;  // Directory didn't exist
-    }
+  {
+    QMutexLocker l(songs_mutex_);
+    QSqlDatabase db(db_->Connect());
 
-    if (song.id() == -1) {
-      // Create
+    QSqlQuery check_dir = db_->PreparedQuery(
+        QString("SELECT ROWID FROM %1 WHERE ROWID = :id").arg(dirs_table_), db);
+    // Songs are bound by position, it's much quicker than by name for all
+    // their columns.
+    SqliteQuery add_song(db, QString("INSERT INTO %1 (" + Song::kColumnSpec +
+                                     ")"
+                                     " VALUES (" +
+                                     Song::kBindSpec + ")").arg(songs_table_));
+    SqliteQuery update_song(
+        db, QString("UPDATE %1 SET " + Song::kUpdateSpec + " WHERE ROWID = :id")
+                .arg(songs_table_));
+
+    ScopedTransaction transaction(&db);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // Always make progress, even if a single song takes longer than the
+    // budget.
+    while (next < songs.count() &&
+           (next == first || timer.elapsed() < kMaxTransactionMsec)) {
+      const Song& song = songs[next++];
+
+      // Do a sanity check first - make sure the song's directory still exists
+      // This is to fix a possible race condition when a directory is removed
+      // while LibraryWatcher is scanning it.
+      if (!dirs_table_.isEmpty()) {
+        check_dir.bindValue(":id", song.directory_id());
+        check_dir.exec();
+        if (db_->CheckErrors(check_dir)) continue;
+
+        const bool dir_exists = check_dir.next();
+        check_dir.finish();
+        if (!dir_exists) continue;  // Directory didn't exist
+      }
 
-      // Insert the row and create a new ID
-      song.BindToQuery(&add_song);
-      add_song.exec();
-      if (db_->CheckErrors(add_song)) continue;
+      if (song.id() == -1) {
+        // Create
 
-      // Get the new ID
-      const int id = add_song.lastInsertId().toInt();
+        // Insert the row and create a new ID
+        song.BindToQuery(&add_song);
+        if (!add_song.Run()) continue;
 
-      // Add to the FTS index
-      add_song_fts.bindValue(":id", id);
-      song.BindToFtsQuery(&add_song_fts);
-      add_song_fts.exec();
-      if (db_->CheckErrors(add_song_fts)) continue;
+        // Get the new ID
+        const int id = add_song.last_insert_id();
 
-      Song copy(song);
-      copy.set_id(id);
-      added_songs << copy;
-    } else {
-      // Get the previous song data first
-      Song old_song(GetSongById(song.id()));
-      if (!old_song.is_valid()) continue;
-
-      // Update
-      song.BindToQuery(&update_song);
-      update_song.bindValue(":id", song.id());
-      update_song.exec();
-      if (db_->CheckErrors(update_song)) continue;
-
-      song.BindToFtsQuery(&update_song_fts);
-      update_song_fts.bindValue(":id", song.id());
-      update_song_fts.exec();
-      if (db_->CheckErrors(update_song_fts)) continue;
-
-      deleted_songs << old_song;
-      added_songs << song;
+        Song copy(song);
+        copy.set_id(id);
+        added_songs << copy;
+        *fts_added << copy;
+        compilation_albums_to_update_.insert(song.album());
+        AddToStatistics(copy, 1);
+      } else {
+        // Get the previous song data first
+        Song old_song(GetSongById(song.id(), db));
+        if (!old_song.is_valid()) continue;
+
+        // Update
+        song.BindToQuery(&update_song);
+        update_song.AddBindValue(song.id());
+        if (!update_song.Run()) continue;
+
+        deleted_songs << old_song;
+        added_songs << song;
+        *fts_updated << song;
+        compilation_albums_to_update_.insert(old_song.album());
+        compilation_albums_to_update_.insert(song.album());
+        AddToStatistics(old_song, -1);
+        AddToStatistics(song, 1);
+      }
     }
-  }
 
-  transaction.Commit();
+    transaction.Commit();
+  }
 
   if (!deleted_songs.isEmpty()) emit SongsDeleted(deleted_songs);
 
   if (!added_songs.isEmpty()) emit SongsDiscovered(added_songs);
 
-  UpdateTotalSongCountAsync();
+  return next;
+}
+
+int LibraryBackend::UpdateFtsChunk(const SongList& songs, int first,
+                                   bool update) {
+  QMutexLocker l(songs_mutex_);
+  QSqlDatabase db(db_->Connect());
+
+  SqliteQuery q(
+      db, update ? QString("UPDATE %1 SET " + Song::kFtsUpdateSpec +
+                           " WHERE ROWID = :id").arg(fts_table_)
+                 : QString("INSERT INTO %1 (ROWID, " + Song::kFtsColumnSpec +
+                           ")"
+                           " VALUES (:id, " +
+                           Song::kFtsBindSpec + ")").arg(fts_table_));
+
+  ScopedTransaction transaction(&db);
+
+  QElapsedTimer timer;
+  timer.start();
+
+  int next = first;
+  while (next < songs.count() &&
+         (next == first || timer.elapsed() < kMaxTransactionMsec)) {
+    const Song& song = songs[next++];
+
+    // The ID comes first when inserting and last when updating
+    if (!update) q.AddBindValue(song.id());
+    song.BindToFtsQuery(&q);
+    if (update) q.AddBindValue(song.id());
+    q.Run();
+  }
+
+  transaction.Commit();
+  return next;
 }
 
 void LibraryBackend::UpdateMTimesOnly(const SongList& songs) {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery q(QString("UPDATE %1 SET mtime = :mtime WHERE ROWID = :id")
-                  .arg(songs_table_),
-              db);
+  QSqlQuery q = db_->PreparedQuery(
+      QString("UPDATE %1 SET mtime = :mtime WHERE ROWID = :id")
+          .arg(songs_table_),
+      db);
 
   ScopedTransaction transaction(&db);
   for (const Song& song : songs) {
@@ -462,15 +749,19 @@ void LibraryBackend::UpdateMTimesOnly(const SongList& songs) {
     db_->CheckErrors(q);
   }
   transaction.Commit();
+
+  // Nothing is emitted for these, but searches can use the modification time.
+  metaObject()->invokeMethod(this, "UpdateMaterializedSearches",
+                             Qt::QueuedConnection, Q_ARG(SongList, songs));
 }
 
 void LibraryBackend::DeleteSongs(const SongList& songs) {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery remove(
+  QSqlQuery remove = db_->PreparedQuery(
       QString("DELETE FROM %1 WHERE ROWID = :id").arg(songs_table_), db);
-  QSqlQuery remove_fts(
+  QSqlQuery remove_fts = db_->PreparedQuery(
       QString("DELETE FROM %1 WHERE ROWID = :id").arg(fts_table_), db);
 
   ScopedTransaction transaction(&db);
@@ -482,6 +773,9 @@ void LibraryBackend::DeleteSongs(const SongList& songs) {
     remove_fts.bindValue(":id", song.id());
     remove_fts.exec();
     db_->CheckErrors(remove_fts);
+
+    compilation_albums_to_update_.insert(song.album());
+    AddToStatistics(song, -1);
   }
   transaction.Commit();
 
@@ -492,19 +786,30 @@ void LibraryBackend::DeleteSongs(const SongList& songs) {
 
 void LibraryBackend::MarkSongsUnavailable(const SongList& songs,
                                           bool unavailable) {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery remove(QString("UPDATE %1 SET unavailable = %2 WHERE ROWID = :id")
-                       .arg(songs_table_)
-                       .arg(int(unavailable)),
-                   db);
+  QSqlQuery remove = db_->PreparedQuery(
+      QString("UPDATE %1 SET unavailable = %2 WHERE ROWID = :id")
+          .arg(songs_table_)
+          .arg(int(unavailable)),
+      db);
 
   ScopedTransaction transaction(&db);
   for (const Song& song : songs) {
     remove.bindValue(":id", song.id());
     remove.exec();
-    db_->CheckErrors(remove);
+    if (db_->CheckErrors(remove)) continue;
+
+    compilation_albums_to_update_.insert(song.album());
+
+    // Songs that were already in the state they're being put in don't change
+    // the totals.
+    if (song.is_unavailable() != unavailable) {
+      Song available(song);
+      available.set_unavailable(false);
+      AddToStatistics(available, unavailable ? -1 : 1);
+    }
   }
   transaction.Commit();
 
@@ -512,19 +817,68 @@ void LibraryBackend::MarkSongsUnavailable(const SongList& songs,
   UpdateTotalSongCountAsync();
 }
 
+QString LibraryBackend::QueryCacheKey(const QStringList& parts,
+                                     const QueryOptions& opt) {
+  if (!opt.filter().isEmpty() || opt.max_age() != -1) return QString();
+  return QStringList(parts + QStringList(QString::number(opt.query_mode())))
+      .join(QChar(0));
+}
+
+template <typename T>
+bool LibraryBackend::LookUpQueryCache(const QString& key,
+                                      const QHash<QString, T>& cache,
+                                      T* result, int* generation) {
+  QMutexLocker l(&query_cache_mutex_);
+  *generation = query_cache_generation_;
+
+  if (key.isEmpty()) return false;
+  typename QHash<QString, T>::const_iterator it = cache.find(key);
+  if (it == cache.end()) return false;
+
+  *result = it.value();
+  return true;
+}
+
+template <typename T>
+void LibraryBackend::StoreInQueryCache(const QString& key, int generation,
+                                       const T& result,
+                                       QHash<QString, T>* cache) {
+  QMutexLocker l(&query_cache_mutex_);
+  // If the library changed while the query ran, the result might be from
+  // before the change.
+  if (key.isEmpty() || generation != query_cache_generation_) return;
+  cache->insert(key, result);
+}
+
+void LibraryBackend::InvalidateQueryCache() {
+  QMutexLocker l(&query_cache_mutex_);
+  query_cache_generation_++;
+  string_list_cache_.clear();
+  album_list_cache_.clear();
+}
+
 QStringList LibraryBackend::GetAll(const QString& column,
                                    const QueryOptions& opt) {
+  const QString key = QueryCacheKey(QStringList() << "all" << column, opt);
+  QStringList ret;
+  int generation;
+  if (LookUpQueryCache(key, string_list_cache_, &ret, &generation)) {
+    return ret;
+  }
+
   LibraryQuery query(opt);
   query.SetColumnSpec("DISTINCT " + column);
   query.AddCompilationRequirement(false);
 
-  QMutexLocker l(db_->Mutex());
-  if (!ExecQuery(&query)) return QStringList();
+  {
+    QMutexLocker l(songs_mutex_);
+    if (!ExecQuery(&query)) return QStringList();
+  }
 
-  QStringList ret;
   while (query.Next()) {
     ret << query.Value(0).toString();
   }
+  StoreInQueryCache(key, generation, ret, &string_list_cache_);
   return ret;
 }
 
@@ -533,6 +887,14 @@ QStringList LibraryBackend::GetAllArtists(const QueryOptions& opt) {
 }
 
 QStringList LibraryBackend::GetAllArtistsWithAlbums(const QueryOptions& opt) {
+  const QString key =
+      QueryCacheKey(QStringList() << "artists-with-albums", opt);
+  QStringList ret;
+  int generation;
+  if (LookUpQueryCache(key, string_list_cache_, &ret, &generation)) {
+    return ret;
+  }
+
   // Albums with 'albumartist' field set:
   LibraryQuery query(opt);
   query.SetColumnSpec("DISTINCT albumartist");
@@ -547,7 +909,7 @@ QStringList LibraryBackend::GetAllArtistsWithAlbums(const QueryOptions& opt) {
   query2.AddWhere("albumartist", "", "=");
 
   {
-    QMutexLocker l(db_->Mutex());
+    QMutexLocker l(songs_mutex_);
     if (!ExecQuery(&query) || !ExecQuery(&query2)) {
       return QStringList();
     }
@@ -561,7 +923,9 @@ QStringList LibraryBackend::GetAllArtistsWithAlbums(const QueryOptions& opt) {
     artists << query2.Value(0).toString();
   }
 
-  return QStringList(artists.toList());
+  ret = artists.toList();
+  StoreInQueryCache(key, generation, ret, &string_list_cache_);
+  return ret;
 }
 
 LibraryBackend::AlbumList LibraryBackend::GetAllAlbums(
@@ -598,7 +962,7 @@ SongList LibraryBackend::GetSongs(const QString& artist, const QString& album,
 
 SongList LibraryBackend::ExecLibraryQuery(LibraryQuery* query) {
   query->SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   if (!ExecQuery(query)) return SongList();
 
   SongList ret;
@@ -611,13 +975,13 @@ SongList LibraryBackend::ExecLibraryQuery(LibraryQuery* query) {
 }
 
 Song LibraryBackend::GetSongById(int id) {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
   return GetSongById(id, db);
 }
 
 SongList LibraryBackend::GetSongsById(const QList<int>& ids) {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
   QStringList str_ids;
@@ -629,16 +993,37 @@ SongList LibraryBackend::GetSongsById(const QList<int>& ids) {
 }
 
 SongList LibraryBackend::GetSongsById(const QStringList& ids) {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
   return GetSongsById(ids, db);
 }
 
+SongList LibraryBackend::GetFullSongs(const SongList& songs) {
+  QStringList ids;
+  for (const Song& song : songs) {
+    if (song.is_partial()) ids << QString::number(song.id());
+  }
+  if (ids.isEmpty()) return songs;
+
+  QMap<int, Song> full_songs;
+  for (const Song& song : GetSongsById(ids)) {
+    full_songs[song.id()] = song;
+  }
+
+  // Songs that have gone from the library since are left as they were.
+  SongList ret;
+  ret.reserve(songs.count());
+  for (const Song& song : songs) {
+    ret << (song.is_partial() ? full_songs.value(song.id(), song) : song);
+  }
+  return ret;
+}
+
 SongList LibraryBackend::GetSongsByForeignId(const QStringList& ids,
                                              const QString& table,
                                              const QString& column) {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
   QString in = ids.join(",");
@@ -666,9 +1051,22 @@ SongList LibraryBackend::GetSongsByForeignId(const QStringList& ids,
 }
 
 Song LibraryBackend::GetSongById(int id, QSqlDatabase& db) {
-  SongList list = GetSongsById(QStringList() << QString::number(id), db);
-  if (list.isEmpty()) return Song();
-  return list.first();
+  QSqlQuery q = db_->PreparedQuery(QString("SELECT ROWID, " +
+                                           Song::kColumnSpec +
+                                           " FROM %1"
+                                           " WHERE ROWID = :id")
+                                       .arg(songs_table_),
+                                   db);
+  q.bindValue(":id", id);
+  q.exec();
+  if (db_->CheckErrors(q)) return Song();
+
+  Song song;
+  if (q.next()) {
+    song.InitFromQuery(q, true);
+  }
+  q.finish();
+  return song;
 }
 
 SongList LibraryBackend::GetSongsById(const QStringList& ids,
@@ -721,6 +1119,51 @@ SongList LibraryBackend::GetSongsByUrl(const QUrl& url) {
   return songlist;
 }
 
+SongList LibraryBackend::GetSongsByUrls(const QList<QUrl>& urls) {
+  if (urls.isEmpty()) return SongList();
+
+  QMutexLocker l(songs_mutex_);
+  QSqlDatabase db(db_->Connect());
+  ScopedTransaction t(&db);
+
+  // Put the filenames in a temporary table and join against it, one query per
+  // URL is slow for big playlists.
+  QSqlQuery create(db);
+  create.exec("CREATE TEMP TABLE IF NOT EXISTS url_lookup (filename TEXT)");
+  if (db_->CheckErrors(create)) return SongList();
+
+  QSqlQuery clear(db);
+  clear.exec("DELETE FROM temp.url_lookup");
+  if (db_->CheckErrors(clear)) return SongList();
+
+  QSqlQuery insert(db);
+  insert.prepare("INSERT INTO temp.url_lookup (filename) VALUES (:filename)");
+  for (const QUrl& url : urls) {
+    insert.bindValue(":filename", url.toEncoded());
+    insert.exec();
+    if (db_->CheckErrors(insert)) return SongList();
+  }
+
+  QSqlQuery q(db);
+  q.exec(QString("SELECT ROWID, " + Song::kColumnSpec +
+                 " FROM %1"
+                 " WHERE filename IN (SELECT filename FROM temp.url_lookup)")
+             .arg(songs_table_));
+  if (db_->CheckErrors(q)) return SongList();
+
+  SongList ret;
+  while (q.next()) {
+    Song song;
+    song.InitFromQuery(q, true);
+    ret << song;
+  }
+  q.finish();
+
+  clear.exec("DELETE FROM temp.url_lookup");
+  t.Commit();
+  return ret;
+}
+
 LibraryBackend::AlbumList LibraryBackend::GetCompilationAlbums(
     const QueryOptions& opt) {
   return GetAlbums(QString(), QString(), true, opt);
@@ -733,7 +1176,7 @@ SongList LibraryBackend::GetCompilationSongs(const QString& album,
   query.AddCompilationRequirement(true);
   query.AddWhere("album", album);
 
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   if (!ExecQuery(&query)) return SongList();
 
   SongList ret;
@@ -746,42 +1189,51 @@ SongList LibraryBackend::GetCompilationSongs(const QString& album,
 }
 
 void LibraryBackend::UpdateCompilations() {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
-  // Look for albums that have songs by more than one 'effective album artist'
-  // in the same
-  // directory
+  QSet<QString> albums;
+  albums.swap(compilation_albums_to_update_);
 
-  QSqlQuery q(
+  // Songs that don't have an album field set are never compilations
+  albums.remove(QString());
+  if (albums.isEmpty()) return;
+
+  // Look for albums that have songs by more than one 'effective album artist'
+  // in the same directory.  Only the albums that have changed are looked at,
+  // each one with the album index.
+  QSqlQuery q = db_->PreparedQuery(
       QString(
-          "SELECT effective_albumartist, album, filename, sampler "
-          "FROM %1 WHERE unavailable = 0 ORDER BY album").arg(songs_table_),
+          "SELECT effective_albumartist, filename, sampler "
+          "FROM %1 WHERE album = :album AND unavailable = 0").arg(songs_table_),
       db);
-  q.exec();
-  if (db_->CheckErrors(q)) return;
 
   QMap<QString, CompilationInfo> compilation_info;
-  while (q.next()) {
-    QString artist = q.value(0).toString();
-    QString album = q.value(1).toString();
-    QString filename = q.value(2).toString();
-    bool sampler = q.value(3).toBool();
-
-    // Ignore songs that don't have an album field set
-    if (album.isEmpty()) continue;
-
-    // Find the directory the song is in
-    int last_separator = filename.lastIndexOf('/');
-    if (last_separator == -1) continue;
+  for (const QString& album : albums) {
+    q.bindValue(":album", album);
+    q.exec();
+    if (db_->CheckErrors(q)) {
+      compilation_albums_to_update_ += albums;
+      return;
+    }
 
-    CompilationInfo& info = compilation_info[album];
-    info.artists.insert(artist);
-    info.directories.insert(filename.left(last_separator));
-    if (sampler)
-      info.has_samplers = true;
-    else
-      info.has_not_samplers = true;
+    while (q.next()) {
+      QString artist = q.value(0).toString();
+      QString filename = q.value(1).toString();
+      bool sampler = q.value(2).toBool();
+
+      // Find the directory the song is in
+      int last_separator = filename.lastIndexOf('/');
+      if (last_separator == -1) continue;
+
+      CompilationInfo& info = compilation_info[album];
+      info.artists.insert(artist);
+      info.directories.insert(filename.left(last_separator));
+      if (sampler)
+        info.has_samplers = true;
+      else
+        info.has_not_samplers = true;
+    }
   }
 
   // Now mark the songs that we think are in compilations
@@ -864,7 +1316,18 @@ LibraryBackend::AlbumList LibraryBackend::GetAlbums(const QString& artist,
                                                     const QString& album_artist,
                                                     bool compilation,
                                                     const QueryOptions& opt) {
+  // Null and empty artists mean different things, so they're told apart by
+  // the first character.
+  const QString key = QueryCacheKey(
+      QStringList() << "albums" << (compilation ? "c" : "")
+                    << (artist.isNull() ? "-" : "=" + artist)
+                    << (album_artist.isNull() ? "-" : "=" + album_artist),
+      opt);
   AlbumList ret;
+  int generation;
+  if (LookUpQueryCache(key, album_list_cache_, &ret, &generation)) {
+    return ret;
+  }
 
   LibraryQuery query(opt);
   query.SetColumnSpec(
@@ -883,7 +1346,7 @@ LibraryBackend::AlbumList LibraryBackend::GetAlbums(const QString& artist,
   }
 
   {
-    QMutexLocker l(db_->Mutex());
+    QMutexLocker l(songs_mutex_);
     if (!ExecQuery(&query)) return ret;
   }
 
@@ -913,6 +1376,7 @@ LibraryBackend::AlbumList LibraryBackend::GetAlbums(const QString& artist,
     last_album_artist = info.album_artist;
   }
 
+  StoreInQueryCache(key, generation, ret, &album_list_cache_);
   return ret;
 }
 
@@ -933,7 +1397,7 @@ LibraryBackend::Album LibraryBackend::GetAlbumArt(const QString& artist,
   }
   query.AddWhere("album", album);
 
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   if (!ExecQuery(&query)) return ret;
 
   if (query.Next()) {
@@ -959,7 +1423,7 @@ void LibraryBackend::UpdateManualAlbumArt(const QString& artist,
                                           const QString& albumartist,
                                           const QString& album,
                                           const QString& art) {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
   // Get the songs before they're updated
@@ -1023,7 +1487,7 @@ void LibraryBackend::UpdateManualAlbumArt(const QString& artist,
 
 void LibraryBackend::ForceCompilation(const QString& album,
                                       const QList<QString>& artists, bool on) {
-  QMutexLocker l(db_->Mutex());
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
   SongList deleted_songs, added_songs;
 
@@ -1078,12 +1542,23 @@ void LibraryBackend::ForceCompilation(const QString& album,
 }
 
 bool LibraryBackend::ExecQuery(LibraryQuery* q) {
-  return !db_->CheckErrors(q->Exec(db_->Connect(), songs_table_, fts_table_));
+  qTraceScope("LibraryBackend::ExecQuery");
+  QSqlDatabase db(db_->Connect());
+  return q->Exec(db, songs_table_, fts_table_,
+                 db_->IsFts5Table(fts_table_, db));
 }
 
-SongList LibraryBackend::FindSongs(const smart_playlists::Search& search) {
-  QMutexLocker l(db_->Mutex());
+bool LibraryBackend::ExecReadOnlyQuery(LibraryQuery* q) {
+  QSqlDatabase db(db_->ConnectReadOnly());
+  return q->Exec(db, songs_table_, fts_table_,
+                 db_->IsFts5Table(fts_table_, db));
+}
+
+SongList LibraryBackend::FindSongs(const smart_playlists::Search& search,
+                                   const QueryCancelFlag& cancel) {
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
+  SqliteCancelScope cancel_scope(db, cancel);
 
   // Build the query
   QString sql = search.ToSql(songs_table());
@@ -1092,6 +1567,7 @@ SongList LibraryBackend::FindSongs(const smart_playlists::Search& search) {
   SongList ret;
   QSqlQuery query(sql, db);
   query.exec();
+  if (SqliteCancelScope::IsCancelled(cancel)) return ret;
   if (db_->CheckErrors(query)) return ret;
 
   // Read the results
@@ -1103,6 +1579,295 @@ SongList LibraryBackend::FindSongs(const smart_playlists::Search& search) {
   return ret;
 }
 
+QVector<int> LibraryBackend::FindSongIds(
+    const smart_playlists::Search& search, const QueryCancelFlag& cancel) {
+  QMutexLocker l(songs_mutex_);
+  QSqlDatabase db(db_->Connect());
+  SqliteCancelScope cancel_scope(db, cancel);
+
+  QVector<int> ret;
+  QSqlQuery query(search.ToIdSql(songs_table()), db);
+  query.setForwardOnly(true);
+  query.exec();
+  if (SqliteCancelScope::IsCancelled(cancel)) return ret;
+  if (db_->CheckErrors(query)) return ret;
+
+  while (query.next()) {
+    ret << query.value(0).toInt();
+  }
+  return ret;
+}
+
+int LibraryBackend::CountSongs(const smart_playlists::Search& search,
+                               const QueryCancelFlag& cancel) {
+  QMutexLocker l(songs_mutex_);
+  QSqlDatabase db(db_->Connect());
+  SqliteCancelScope cancel_scope(db, cancel);
+
+  QSqlQuery query(search.ToCountSql(songs_table()), db);
+  query.exec();
+  if (SqliteCancelScope::IsCancelled(cancel)) return -1;
+  if (db_->CheckErrors(query) || !query.next()) return -1;
+
+  return query.value(0).toInt();
+}
+
+SongList LibraryBackend::FindSongsMaterialized(
+    const smart_playlists::Search& search) {
+  // Dynamic playlists page through the results, which the table can't do.
+  if (!search.can_materialize() || search.first_item_ ||
+      !search.id_not_in_.isEmpty()) {
+    return FindSongs(search);
+  }
+
+  QByteArray data;
+  {
+    QDataStream s(&data, QIODevice::WriteOnly);
+    s << search;
+  }
+  const QString key = QCryptographicHash::hash(songs_table_.toUtf8() + data,
+                                               QCryptographicHash::Sha1)
+                          .toHex();
+
+  QMutexLocker l(db_->Mutex());
+  QMutexLocker songs_l(songs_mutex_);
+  QSqlDatabase db(db_->Connect());
+  LoadMaterializedSearches(db);
+
+  const uint now = QDateTime::currentDateTime().toTime_t();
+  if (!materialized_searches_.contains(key)) {
+    ScopedTransaction t(&db);
+
+    QSqlQuery q(db);
+    q.prepare(
+        "INSERT INTO smart_playlist_searches"
+        " (search_key, songs_table, search, last_used)"
+        " VALUES (:key, :songs_table, :search, :last_used)");
+    q.bindValue(":key", key);
+    q.bindValue(":songs_table", songs_table_);
+    q.bindValue(":search", data);
+    q.bindValue(":last_used", now);
+    q.exec();
+    if (db_->CheckErrors(q)) return FindSongs(search);
+
+    FillMaterializedSearch(key, search, db);
+    t.Commit();
+
+    materialized_searches_[key] = data;
+  } else {
+    QSqlQuery q(db);
+    q.prepare(
+        "UPDATE smart_playlist_searches SET last_used = :last_used"
+        " WHERE search_key = :key");
+    q.bindValue(":last_used", now);
+    q.bindValue(":key", key);
+    q.exec();
+    db_->CheckErrors(q);
+  }
+
+  SongList ret;
+  QSqlQuery query(search.ToSortedSql("ROWID, " + Song::kColumnSpec,
+                                     songs_table_, MaterializedSongsSql(key)),
+                  db);
+  query.exec();
+  if (db_->CheckErrors(query)) return ret;
+
+  while (query.next()) {
+    Song song;
+    song.InitFromQuery(query, true);
+    ret << song;
+  }
+  return ret;
+}
+
+void LibraryBackend::LoadMaterializedSearches(QSqlDatabase& db) {
+  if (materialized_searches_loaded_) return;
+  materialized_searches_loaded_ = true;
+
+  const uint cutoff = QDateTime::currentDateTime().toTime_t() -
+                      kMaterializedSearchMaxAgeSecs;
+
+  ScopedTransaction t(&db);
+
+  QSqlQuery q(db);
+  q.prepare(
+      "DELETE FROM smart_playlist_songs WHERE search_key IN ("
+      " SELECT search_key FROM smart_playlist_searches"
+      " WHERE songs_table = :songs_table AND last_used < :cutoff)");
+  q.bindValue(":songs_table", songs_table_);
+  q.bindValue(":cutoff", cutoff);
+  q.exec();
+  if (db_->CheckErrors(q)) return;
+
+  q = QSqlQuery(db);
+  q.prepare(
+      "DELETE FROM smart_playlist_searches"
+      " WHERE songs_table = :songs_table AND last_used < :cutoff");
+  q.bindValue(":songs_table", songs_table_);
+  q.bindValue(":cutoff", cutoff);
+  q.exec();
+  if (db_->CheckErrors(q)) return;
+
+  t.Commit();
+
+  q = QSqlQuery(db);
+  q.prepare(
+      "SELECT search_key, search FROM smart_playlist_searches"
+      " WHERE songs_table = :songs_table");
+  q.bindValue(":songs_table", songs_table_);
+  q.exec();
+  if (db_->CheckErrors(q)) return;
+
+  while (q.next()) {
+    materialized_searches_[q.value(0).toString()] = q.value(1).toByteArray();
+  }
+}
+
+void LibraryBackend::FillMaterializedSearch(
+    const QString& key, const smart_playlists::Search& search,
+    QSqlDatabase& db) {
+  QSqlQuery q(db);
+  q.prepare("DELETE FROM smart_playlist_songs WHERE search_key = :key");
+  q.bindValue(":key", key);
+  q.exec();
+  if (db_->CheckErrors(q)) return;
+
+  q = QSqlQuery(
+      "INSERT INTO smart_playlist_songs (search_key, song_id) " +
+          search.ToSortedSql("'" + key + "', ROWID", songs_table_),
+      db);
+  q.exec();
+  db_->CheckErrors(q);
+}
+
+QVariant LibraryBackend::MaterializedSearchCutoff(
+    const QString& key, const smart_playlists::Search& search, int* count,
+    QSqlDatabase& db) {
+  using smart_playlists::Search;
+  using smart_playlists::SearchTerm;
+
+  const QString column = SearchTerm::FieldColumnName(search.sort_field_);
+  const QString last =
+      search.sort_type_ == Search::Sort_FieldAsc ? "MAX" : "MIN";
+
+  QSqlQuery q(QString("SELECT COUNT(*), %1(%2) FROM %3 WHERE %4")
+                  .arg(last, column, songs_table_, MaterializedSongsSql(key)),
+              db);
+  q.exec();
+  if (db_->CheckErrors(q) || !q.next()) {
+    *count = 0;
+    return QVariant();
+  }
+
+  *count = q.value(0).toInt();
+  return q.value(1);
+}
+
+void LibraryBackend::UpdateMaterializedSearch(
+    const QString& key, const smart_playlists::Search& search,
+    const QString& ids, QSqlDatabase& db) {
+  const bool limited = search.limit_ != -1;
+
+  int old_count = 0;
+  QVariant old_cutoff;
+  if (limited) {
+    old_cutoff = MaterializedSearchCutoff(key, search, &old_count, db);
+  }
+
+  // Forget about the changed songs and add back the ones that still match.
+  // Only the best limit_ of them can end up in the results.
+  QSqlQuery q(db);
+  q.prepare(
+      "DELETE FROM smart_playlist_songs"
+      " WHERE search_key = :key AND song_id IN (" + ids + ")");
+  q.bindValue(":key", key);
+  q.exec();
+  if (db_->CheckErrors(q)) return;
+
+  q = QSqlQuery(
+      "INSERT INTO smart_playlist_songs (search_key, song_id) " +
+          search.ToSortedSql("'" + key + "', ROWID", songs_table_,
+                             "ROWID IN (" + ids + ")"),
+      db);
+  q.exec();
+  if (db_->CheckErrors(q)) return;
+
+  if (!limited) return;
+
+  // Drop whatever got pushed out of the results.
+  q = QSqlQuery(
+      "DELETE FROM smart_playlist_songs WHERE search_key = '" + key +
+          "' AND song_id NOT IN (" +
+          search.ToSortedSql("ROWID", songs_table_,
+                             MaterializedSongsSql(key)) + ")",
+      db);
+  q.exec();
+  if (db_->CheckErrors(q)) return;
+
+  // The songs that didn't change and aren't in the table were all worse than
+  // the old last result.  They only belong in the results now if some of the
+  // results went away or got worse than that, and then the only way to find
+  // them is to run the whole search again.
+  if (old_count < search.limit_) return;
+
+  int new_count = 0;
+  const QVariant new_cutoff =
+      MaterializedSearchCutoff(key, search, &new_count, db);
+  if (new_count < search.limit_ || SortsAfter(new_cutoff, old_cutoff, search)) {
+    FillMaterializedSearch(key, search, db);
+  }
+}
+
+void LibraryBackend::UpdateMaterializedSearches(const SongList& songs) {
+  if (songs.isEmpty()) return;
+
+  QMutexLocker l(db_->Mutex());
+  QMutexLocker songs_l(songs_mutex_);
+  QSqlDatabase db(db_->Connect());
+  LoadMaterializedSearches(db);
+  if (materialized_searches_.isEmpty()) return;
+
+  QList<smart_playlists::Search> searches;
+  for (const QByteArray& data : materialized_searches_) {
+    smart_playlists::Search search;
+    QDataStream s(data);
+    s >> search;
+    searches << search;
+  }
+  const QStringList keys = materialized_searches_.keys();
+
+  ScopedTransaction t(&db);
+  for (int i = 0; i < songs.count(); i += kMaterializedUpdateBatchSize) {
+    QStringList id_list;
+    for (const Song& song : songs.mid(i, kMaterializedUpdateBatchSize)) {
+      id_list << QString::number(song.id());
+    }
+    const QString ids = id_list.join(",");
+
+    for (int j = 0; j < keys.count(); ++j) {
+      UpdateMaterializedSearch(keys[j], searches[j], ids, db);
+    }
+  }
+  t.Commit();
+}
+
+void LibraryBackend::ResetMaterializedSearches() {
+  QMutexLocker l(db_->Mutex());
+  QMutexLocker songs_l(songs_mutex_);
+  QSqlDatabase db(db_->Connect());
+  LoadMaterializedSearches(db);
+
+  ScopedTransaction t(&db);
+  for (auto it = materialized_searches_.constBegin();
+       it != materialized_searches_.constEnd(); ++it) {
+    smart_playlists::Search search;
+    QDataStream s(it.value());
+    s >> search;
+    FillMaterializedSearch(it.key(), search, db);
+  }
+  t.Commit();
+}
+
 SongList LibraryBackend::GetAllSongs() {
   // Get all the songs!
   return FindSongs(smart_playlists::Search(
@@ -1111,102 +1876,287 @@ SongList LibraryBackend::GetAllSongs() {
       smart_playlists::SearchTerm::Field_Artist, -1));
 }
 
-void LibraryBackend::IncrementPlayCount(int id) {
-  if (id == -1) return;
-
-  QMutexLocker l(db_->Mutex());
+SongList LibraryBackend::GetSongsWithoutReplayGain() {
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery q(QString(
-                  "UPDATE %1 SET playcount = playcount + 1,"
-                  "              lastplayed = :now,"
-                  "              score = " +
-                  QString(kNewScoreSql).arg("1.0") +
-                  " WHERE ROWID = :id").arg(songs_table_),
+  QSqlQuery q(QString("SELECT ROWID, " + Song::kColumnSpec +
+                      " FROM %1"
+                      " WHERE replaygain_track_gain IS NULL"
+                      " AND unavailable = 0 AND filetype NOT IN (%2, %3)"
+                      " AND (cue_path IS NULL OR cue_path = '')"
+                      " ORDER BY effective_albumartist, album, directory")
+                  .arg(songs_table_)
+                  .arg(Song::Type_Stream)
+                  .arg(Song::Type_Cdda),
               db);
-  q.bindValue(":now", QDateTime::currentDateTime().toTime_t());
-  q.bindValue(":id", id);
   q.exec();
-  if (db_->CheckErrors(q)) return;
+  if (db_->CheckErrors(q)) return SongList();
 
-  Song new_song = GetSongById(id, db);
-  emit SongsStatisticsChanged(SongList() << new_song);
+  SongList ret;
+  while (q.next()) {
+    Song song;
+    song.InitFromQuery(q, true);
+    ret << song;
+  }
+  return ret;
 }
 
-void LibraryBackend::IncrementSkipCount(int id, float progress) {
-  if (id == -1) return;
-  progress = qBound(0.0f, progress, 1.0f);
+SongList LibraryBackend::GetDuplicateCandidates(
+    qint64 length_tolerance_nanosec) {
+  QMutexLocker l(songs_mutex_);
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q(db);
+  q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec +
+                    " FROM %1"
+                    " WHERE unavailable = 0 AND title != ''"
+                    " AND EXISTS (SELECT 1 FROM %1 AS other"
+                    "  WHERE other.title = %1.title COLLATE NOCASE"
+                    "  AND other.artist = %1.artist COLLATE NOCASE"
+                    "  AND other.ROWID != %1.ROWID"
+                    "  AND other.unavailable = 0"
+                    "  AND abs(other.length - %1.length) <= :tolerance)"
+                    " ORDER BY title COLLATE NOCASE, artist COLLATE NOCASE,"
+                    " length")
+                .arg(songs_table_));
+  q.bindValue(":tolerance", length_tolerance_nanosec);
+  q.exec();
+  if (db_->CheckErrors(q)) return SongList();
 
+  SongList ret;
+  while (q.next()) {
+    Song song;
+    song.InitFromQuery(q, true);
+    ret << song;
+  }
+  return ret;
+}
+
+SongList LibraryBackend::GetSongsWithoutAudioFeatures() {
   QMutexLocker l(db_->Mutex());
+  QMutexLocker songs_l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery q(QString(
-                  "UPDATE %1 SET skipcount = skipcount + 1,"
-                  "              score = " +
-                  QString(kNewScoreSql).arg(progress) +
-                  " WHERE ROWID = :id").arg(songs_table_),
-              db);
-  q.bindValue(":id", id);
+  QSqlQuery q(db);
+  q.prepare(QString("SELECT ROWID, " + Song::kColumnSpec +
+                    " FROM %1"
+                    " WHERE unavailable = 0 AND filetype NOT IN (%2, %3)"
+                    " AND (cue_path IS NULL OR cue_path = '')"
+                    " AND NOT EXISTS (SELECT 1 FROM audio_features"
+                    "  WHERE audio_features.filename = %1.filename"
+                    "  AND audio_features.mtime = %1.mtime)")
+                .arg(songs_table_)
+                .arg(Song::Type_Stream)
+                .arg(Song::Type_Cdda));
   q.exec();
-  if (db_->CheckErrors(q)) return;
+  if (db_->CheckErrors(q)) return SongList();
 
-  Song new_song = GetSongById(id, db);
-  emit SongsStatisticsChanged(SongList() << new_song);
+  SongList ret;
+  while (q.next()) {
+    Song song;
+    song.InitFromQuery(q, true);
+    ret << song;
+  }
+  return ret;
 }
 
-void LibraryBackend::ResetStatistics(int id) {
-  if (id == -1) return;
-
+void LibraryBackend::SaveAudioFeatures(const Song& song,
+                                       const QByteArray& features) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery q(QString(
-                  "UPDATE %1 SET playcount = 0, skipcount = 0,"
-                  "              lastplayed = -1, score = 0"
-                  " WHERE ROWID = :id").arg(songs_table_),
-              db);
-  q.bindValue(":id", id);
+  QSqlQuery q = db_->PreparedQuery(
+      "INSERT OR REPLACE INTO audio_features (filename, mtime, features)"
+      " VALUES (:filename, :mtime, :features)",
+      db);
+  q.bindValue(":filename", song.url().toEncoded());
+  q.bindValue(":mtime", song.mtime());
+  q.bindValue(":features", features);
   q.exec();
-  if (db_->CheckErrors(q)) return;
+  db_->CheckErrors(q);
+}
+
+void LibraryBackend::LoadAudioFeatures(SimilarityIndex* index) {
+  {
+    QMutexLocker l(db_->Mutex());
+    QMutexLocker songs_l(songs_mutex_);
+    QSqlDatabase db(db_->Connect());
+
+    QSqlQuery q(db);
+    q.prepare(QString("SELECT %1.ROWID, audio_features.features"
+                      " FROM audio_features"
+                      " JOIN %1 ON %1.filename = audio_features.filename"
+                      " AND %1.mtime = audio_features.mtime"
+                      " WHERE %1.unavailable = 0")
+                  .arg(songs_table_));
+    q.exec();
+    if (db_->CheckErrors(q)) return;
 
-  Song new_song = GetSongById(id, db);
-  emit SongsStatisticsChanged(SongList() << new_song);
+    while (q.next()) {
+      index->Add(q.value(0).toInt(), q.value(1).toByteArray());
+    }
+  }
+
+  index->Build();
 }
 
-void LibraryBackend::UpdateSongRating(int id, float rating) {
-  if (id == -1) return;
+void LibraryBackend::UpdateReplayGain(const SongList& songs) {
+  if (songs.isEmpty()) return;
+
+  QMutexLocker l(songs_mutex_);
+  QSqlDatabase db(db_->Connect());
+
+  QSqlQuery q = db_->PreparedQuery(
+      QString(
+          "UPDATE %1 SET replaygain_track_gain = :track_gain,"
+          "              replaygain_album_gain = :album_gain"
+          " WHERE ROWID = :id").arg(songs_table_),
+      db);
+
+  QStringList id_str_list;
+  ScopedTransaction transaction(&db);
+  for (const Song& song : songs) {
+    q.bindValue(":track_gain", song.replaygain_track_gain());
+    q.bindValue(":album_gain", song.replaygain_album_gain());
+    q.bindValue(":id", song.id());
+    q.exec();
+    if (db_->CheckErrors(q)) return;
+    id_str_list << QString::number(song.id());
+  }
+  transaction.Commit();
+
+  emit SongsReplayGainChanged(GetSongsById(id_str_list, db));
+}
+
+void LibraryBackend::IncrementPlayCount(int id) {
+  ApplyStatisticsUpdates(StatisticsUpdateList()
+                         << StatisticsUpdate(StatisticsUpdate::PlayCount, id));
+}
+
+void LibraryBackend::IncrementSkipCount(int id, float progress) {
+  ApplyStatisticsUpdates(
+      StatisticsUpdateList()
+      << StatisticsUpdate(StatisticsUpdate::SkipCount, id, progress));
+}
 
-  QList<int> id_list;
-  id_list << id;
-  UpdateSongsRating(id_list, rating);
+void LibraryBackend::ResetStatistics(int id) {
+  ApplyStatisticsUpdates(StatisticsUpdateList()
+                         << StatisticsUpdate(StatisticsUpdate::Reset, id));
+}
+
+void LibraryBackend::UpdateSongRating(int id, float rating) {
+  UpdateSongsRating(QList<int>() << id, rating);
 }
 
 void LibraryBackend::UpdateSongsRating(const QList<int>& id_list,
                                        float rating) {
-  if (id_list.isEmpty()) return;
+  StatisticsUpdateList updates;
+  for (int id : id_list) {
+    updates << StatisticsUpdate(StatisticsUpdate::Rating, id, rating);
+  }
+  ApplyStatisticsUpdates(updates);
+}
 
-  QMutexLocker l(db_->Mutex());
+void LibraryBackend::ApplyStatisticsUpdates(
+    const StatisticsUpdateList& updates) {
+  if (updates.isEmpty()) return;
+  qTraceScope("LibraryBackend::ApplyStatisticsUpdates");
+
+  QMutexLocker l(songs_mutex_);
   QSqlDatabase db(db_->Connect());
 
-  QStringList id_str_list;
-  for (int i : id_list) {
-    id_str_list << QString::number(i);
+  QSqlQuery play = db_->PreparedQuery(
+      QString(
+          "UPDATE %1 SET playcount = playcount + 1,"
+          "              lastplayed = :now,"
+          "              score = " +
+          QString(kNewScoreSql).arg("1.0") +
+          " WHERE ROWID = :id").arg(songs_table_),
+      db);
+  QSqlQuery reset = db_->PreparedQuery(
+      QString(
+          "UPDATE %1 SET playcount = 0, skipcount = 0,"
+          "              lastplayed = -1, score = 0"
+          " WHERE ROWID = :id").arg(songs_table_),
+      db);
+  QSqlQuery rating = db_->PreparedQuery(
+      QString(
+          "UPDATE %1 SET rating = :rating"
+          " WHERE ROWID = :id").arg(songs_table_),
+      db);
+
+  const uint now = QDateTime::currentDateTime().toTime_t();
+  QStringList statistics_ids;
+  QStringList rating_ids;
+  QSet<int> seen_statistics;
+  QSet<int> seen_rating;
+
+  ScopedTransaction transaction(&db);
+  for (const StatisticsUpdate& update : updates) {
+    if (update.id == -1) continue;
+
+    // The skip progress appears twice in the score, so it's put straight
+    // into the SQL rather than bound.
+    QSqlQuery skip(db);
+    QSqlQuery* q = nullptr;
+    switch (update.type) {
+      case StatisticsUpdate::PlayCount:
+        q = &play;
+        q->bindValue(":now", now);
+        break;
+      case StatisticsUpdate::SkipCount:
+        q = &skip;
+        q->prepare(QString(
+                       "UPDATE %1 SET skipcount = skipcount + 1,"
+                       "              score = " +
+                       QString(kNewScoreSql)
+                           .arg(qBound(0.0f, update.value, 1.0f)) +
+                       " WHERE ROWID = :id").arg(songs_table_));
+        break;
+      case StatisticsUpdate::Reset:
+        q = &reset;
+        break;
+      case StatisticsUpdate::Rating:
+        q = &rating;
+        q->bindValue(":rating", update.value);
+        break;
+    }
+    q->bindValue(":id", update.id);
+    q->exec();
+    if (db_->CheckErrors(*q)) return;
+
+    if (update.type == StatisticsUpdate::Rating) {
+      if (!seen_rating.contains(update.id)) {
+        seen_rating.insert(update.id);
+        rating_ids << QString::number(update.id);
+      }
+    } else if (!seen_statistics.contains(update.id)) {
+      seen_statistics.insert(update.id);
+      statistics_ids << QString::number(update.id);
+    }
+  }
+  transaction.Commit();
+
+  if (snapshot_loaded_) {
+    for (const StatisticsUpdate& update : updates) {
+      if (update.type == StatisticsUpdate::Rating) {
+        snapshot_.SetRating(update.id, update.value);
+      }
+    }
+  }
+
+  if (!statistics_ids.isEmpty()) {
+    emit SongsStatisticsChanged(GetSongsById(statistics_ids, db));
+  }
+  if (!rating_ids.isEmpty()) {
+    emit SongsRatingChanged(GetSongsById(rating_ids, db));
   }
-  QString ids = id_str_list.join(",");
-  QSqlQuery q(QString(
-                  "UPDATE %1 SET rating = :rating"
-                  " WHERE ROWID IN (%2)").arg(songs_table_, ids),
-              db);
-  q.bindValue(":rating", rating);
-  q.exec();
-  if (db_->CheckErrors(q)) return;
-  SongList new_song_list = GetSongsById(id_str_list, db);
-  emit SongsRatingChanged(new_song_list);
 }
 
 void LibraryBackend::DeleteAll() {
   {
-    QMutexLocker l(db_->Mutex());
+    QMutexLocker l(songs_mutex_);
     QSqlDatabase db(db_->Connect());
     ScopedTransaction t(&db);
 
@@ -1219,6 +2169,11 @@ void LibraryBackend::DeleteAll() {
     if (db_->CheckErrors(q)) return;
 
     t.Commit();
+
+    statistics_ = Statistics();
+    statistics_loaded_ = true;
+    snapshot_.Clear();
+    snapshot_loaded_ = true;
   }
 
   emit DatabaseReset();
@@ -18,16 +18,23 @@
 #ifndef LIBRARYBACKEND_H
 #define LIBRARYBACKEND_H
 
+#include <QHash>
+#include <QMap>
+#include <QMutex>
 #include <QObject>
 #include <QSet>
+#include <QSqlQuery>
 #include <QUrl>
+#include <QVector>
 #include <QFileInfo>
 
 #include "directory.h"
 #include "libraryquery.h"
+#include "librarysnapshot.h"
 #include "core/song.h"
 
 class Database;
+class SimilarityIndex;
 
 namespace smart_playlists {
 class Search;
@@ -117,11 +124,21 @@ class LibraryBackendInterface : public QObject {
   // Using default beginning value is suitable when searching for single-section
   // songs.
   virtual Song GetSongByUrl(const QUrl& url, qint64 beginning = 0) = 0;
+  // Returns all sections of all songs with any of the given filenames, in one
+  // query.
+  virtual SongList GetSongsByUrls(const QList<QUrl>& urls) = 0;
+  // Returns the songs with every column loaded, looking up the ones that were
+  // read with a partial Song::Projection again.  Keeps the songs in order.
+  virtual SongList GetFullSongs(const SongList& songs) = 0;
 
   virtual void AddDirectory(const QString& path) = 0;
   virtual void RemoveDirectory(const Directory& dir) = 0;
 
   virtual bool ExecQuery(LibraryQuery* q) = 0;
+  // Like ExecQuery, but on a read-only connection that doesn't contend with
+  // writers.  The caller should hold a Database::ReadLocker while it reads
+  // the results.
+  virtual bool ExecReadOnlyQuery(LibraryQuery* q) { return ExecQuery(q); }
 };
 
 class LibraryBackend : public LibraryBackendInterface {
@@ -130,11 +147,27 @@ class LibraryBackend : public LibraryBackendInterface {
  public:
   static const char* kSettingsGroup;
 
+  // Running totals over the available songs in the library.
+  struct Statistics {
+    Statistics() : song_count(0), total_length_nanosec(0), total_filesize(0) {}
+
+    int song_count;
+    qint64 total_length_nanosec;
+    qint64 total_filesize;
+
+    // Number of songs by artist and by album name.
+    QHash<QString, int> artist_song_count;
+    QHash<QString, int> album_song_count;
+  };
+
   Q_INVOKABLE LibraryBackend(QObject* parent = nullptr);
   void Init(Database* db, const QString& songs_table, const QString& dirs_table,
             const QString& subdirs_table, const QString& fts_table);
 
   Database* db() const { return db_; }
+  // The attached database the songs tables are in, or an empty string for the
+  // main database.  Pass it to Database::ReadLocker.
+  QString database_name() const;
 
   QString songs_table() const { return songs_table_; }
   QString dirs_table() const { return dirs_table_; }
@@ -179,20 +212,57 @@ class LibraryBackend : public LibraryBackendInterface {
   Song GetSongById(int id);
   SongList GetSongsById(const QList<int>& ids);
   SongList GetSongsById(const QStringList& ids);
+  SongList GetFullSongs(const SongList& songs);
   SongList GetSongsByForeignId(const QStringList& ids, const QString& table,
                                const QString& column);
 
   SongList GetSongsByUrl(const QUrl& url);
   Song GetSongByUrl(const QUrl& url, qint64 beginning = 0);
+  SongList GetSongsByUrls(const QList<QUrl>& urls);
 
   void AddDirectory(const QString& path);
   void RemoveDirectory(const Directory& dir);
 
   bool ExecQuery(LibraryQuery* q);
+  bool ExecReadOnlyQuery(LibraryQuery* q);
   SongList ExecLibraryQuery(LibraryQuery* query);
-  SongList FindSongs(const smart_playlists::Search& search);
+  // Both return what they found so far if they're cancelled.
+  SongList FindSongs(const smart_playlists::Search& search,
+                     const QueryCancelFlag& cancel = QueryCancelFlag());
+  QVector<int> FindSongIds(const smart_playlists::Search& search,
+                           const QueryCancelFlag& cancel = QueryCancelFlag());
+  // How many songs match, ignoring the search's limit.  Returns -1 on error
+  // or if it's cancelled.
+  int CountSongs(const smart_playlists::Search& search,
+                 const QueryCancelFlag& cancel = QueryCancelFlag());
+  // Like FindSongs, but keeps the results in the database and updates them
+  // as songs change, so running the same search again doesn't have to look
+  // at the whole library.  Falls back to FindSongs for searches whose
+  // results depend on the current time or are random.
+  SongList FindSongsMaterialized(const smart_playlists::Search& search);
   SongList GetAllSongs();
 
+  // Local songs that the loudness analysis hasn't looked at yet, sorted so
+  // that the tracks of each album are next to each other.  Sections of CUE
+  // sheets aren't included because they can't be decoded on their own.
+  SongList GetSongsWithoutReplayGain();
+
+  // Available songs that have the same title and artist, ignoring case, as
+  // another song whose length is within length_tolerance_nanosec of theirs.
+  // They're sorted by title, artist and length, which is the order of the
+  // index the query uses, so nothing has to be sorted in memory.
+  SongList GetDuplicateCandidates(qint64 length_tolerance_nanosec);
+
+  // Local songs whose audio features haven't been worked out, or were worked
+  // out before the file last changed.  See AudioFeatureAnalyser.
+  SongList GetSongsWithoutAudioFeatures();
+  // Can be called from any thread.
+  void SaveAudioFeatures(const Song& song, const QByteArray& features);
+  // Adds the features of every available song to the index, and builds it.
+  void LoadAudioFeatures(SimilarityIndex* index);
+
+  // These are queued and written together, in one transaction, the next time
+  // the backend's thread gets to them.  Can be called from any thread.
   void IncrementPlayCountAsync(int id);
   void IncrementSkipCountAsync(int id, float progress);
   void ResetStatisticsAsync(int id);
@@ -201,6 +271,14 @@ class LibraryBackend : public LibraryBackendInterface {
 
   void DeleteAll();
 
+  // The totals are kept up to date as songs are added, changed and removed,
+  // so this only reads the database the first time it's called.
+  Statistics statistics();
+
+  // A copy of the snapshot of the available songs, kept up to date like the
+  // statistics.  Cheap to call.
+  LibrarySnapshot snapshot();
+
  public slots:
   void LoadDirectories();
   void UpdateTotalSongCount();
@@ -209,6 +287,8 @@ class LibraryBackend : public LibraryBackendInterface {
   void DeleteSongs(const SongList& songs);
   void MarkSongsUnavailable(const SongList& songs, bool unavailable = true);
   void AddOrUpdateSubdirs(const SubdirectoryList& subdirs);
+  // Works out again whether the albums of songs that were added, changed or
+  // removed since the last call are compilations.
   void UpdateCompilations();
   void UpdateManualAlbumArt(const QString& artist, const QString& albumartist,
                             const QString& album, const QString& art);
@@ -219,9 +299,15 @@ class LibraryBackend : public LibraryBackendInterface {
   void ResetStatistics(int id);
   void UpdateSongRating(int id, float rating);
   void UpdateSongsRating(const QList<int>& id_list, float rating);
+  // Saves the track and album gains of these songs.  Emits
+  // SongsReplayGainChanged.
+  void UpdateReplayGain(const SongList& songs);
   // Tells the library model that a song path has changed
   void SongPathChanged(const Song& song, const QFileInfo& new_file);
 
+ private slots:
+  void FlushStatisticsUpdates();
+
 signals:
   void DirectoryDiscovered(const Directory& dir,
                            const SubdirectoryList& subdirs);
@@ -231,10 +317,19 @@ signals:
   void SongsDeleted(const SongList& songs);
   void SongsStatisticsChanged(const SongList& songs);
   void SongsRatingChanged(const SongList& songs);
+  void SongsReplayGainChanged(const SongList& songs);
   void DatabaseReset();
 
   void TotalSongCountUpdated(int total);
 
+ private slots:
+  // Checks the songs against every materialized search of this songs table
+  // and adds or removes them from the results.
+  void UpdateMaterializedSearches(const SongList& songs);
+  void ResetMaterializedSearches();
+  // Connected directly, so it runs as soon as the change is committed.
+  void InvalidateQueryCache();
+
  private:
   struct CompilationInfo {
     CompilationInfo() : has_samplers(false), has_not_samplers(false) {}
@@ -248,6 +343,21 @@ signals:
 
   static const char* kNewScoreSql;
 
+  // AddOrUpdateSongs commits in transactions that last roughly this long, so
+  // readers are never blocked on the database mutex for longer.
+  static const int kMaxTransactionMsec;
+
+  // Materialized searches that haven't been used for this long are dropped.
+  static const int kMaterializedSearchMaxAgeSecs;
+
+  // Writes songs from index first onwards until the time budget runs out.
+  // Returns the index of the first song that wasn't written.  The songs that
+  // were written are appended to fts_added or fts_updated so their FTS rows
+  // can be written afterwards by UpdateFtsChunk.
+  int AddOrUpdateSongsChunk(const SongList& songs, int first,
+                            SongList* fts_added, SongList* fts_updated);
+  int UpdateFtsChunk(const SongList& songs, int first, bool update);
+
   void UpdateCompilations(QSqlQuery& find_songs, QSqlQuery& update,
                           SongList& deleted_songs, SongList& added_songs,
                           const QString& album, int sampler);
@@ -256,17 +366,98 @@ signals:
                       const QueryOptions& opt = QueryOptions());
   SubdirectoryList SubdirsInDirectory(int id, QSqlDatabase& db);
 
+  // The key GetAll, GetAllArtistsWithAlbums and GetAlbums store their results
+  // under, or an empty string if they shouldn't be cached.  Results that
+  // depend on a filter or the current time aren't.
+  static QString QueryCacheKey(const QStringList& parts,
+                               const QueryOptions& opt);
+  // Returns false if there's nothing cached under key, and otherwise sets
+  // result.  Either way generation is set, to pass to StoreInQueryCache.
+  template <typename T>
+  bool LookUpQueryCache(const QString& key, const QHash<QString, T>& cache,
+                        T* result, int* generation);
+  // Only stores the result if the library hasn't changed since generation.
+  template <typename T>
+  void StoreInQueryCache(const QString& key, int generation, const T& result,
+                         QHash<QString, T>* cache);
+
+  // A change to one song's statistics or rating.
+  struct StatisticsUpdate {
+    enum Type { PlayCount, SkipCount, Reset, Rating };
+
+    StatisticsUpdate(Type type, int id, float value = 0.0)
+        : type(type), id(id), value(value) {}
+
+    Type type;
+    int id;
+    float value;  // The skip progress or the rating.
+  };
+  typedef QList<StatisticsUpdate> StatisticsUpdateList;
+
+  void QueueStatisticsUpdates(const StatisticsUpdateList& updates);
+  // Applies the updates in order in one transaction, then emits
+  // SongsStatisticsChanged and SongsRatingChanged once each.
+  void ApplyStatisticsUpdates(const StatisticsUpdateList& updates);
+
+  // These must be called with songs_mutex_ held.  AddToStatistics adds the
+  // song to the totals and the snapshot, or removes it if sign is -1.
+  // Unavailable songs are ignored.
+  void LoadStatistics(QSqlDatabase& db);
+  void LoadSnapshot(QSqlDatabase& db);
+  void AddToStatistics(const Song& song, int sign);
+
   Song GetSongById(int id, QSqlDatabase& db);
   SongList GetSongsById(const QStringList& ids, QSqlDatabase& db);
 
+  void LoadMaterializedSearches(QSqlDatabase& db);
+  void FillMaterializedSearch(const QString& key,
+                              const smart_playlists::Search& search,
+                              QSqlDatabase& db);
+  void UpdateMaterializedSearch(const QString& key,
+                                const smart_playlists::Search& search,
+                                const QString& ids, QSqlDatabase& db);
+  QVariant MaterializedSearchCutoff(const QString& key,
+                                    const smart_playlists::Search& search,
+                                    int* count, QSqlDatabase& db);
+
  private:
   Database* db_;
+  // Held while writing to the songs tables.  It's the lock of the database
+  // they're in, so it's only db_->Mutex() for the main database's tables.
+  // The materialized searches are in the main database, anything that
+  // touches them takes db_->Mutex() first.
+  QMutex* songs_mutex_;
   QString songs_table_;
   QString dirs_table_;
   QString subdirs_table_;
   QString fts_table_;
   bool save_statistics_in_file_;
   bool save_ratings_in_file_;
+
+  // Albums UpdateCompilations needs to look at, protected by songs_mutex_.
+  QSet<QString> compilation_albums_to_update_;
+
+  // Protected by songs_mutex_.  The totals are only updated once they've
+  // been loaded.
+  bool statistics_loaded_;
+  Statistics statistics_;
+  bool snapshot_loaded_;
+  LibrarySnapshot snapshot_;
+
+  // Updates from the Async functions, waiting for FlushStatisticsUpdates.
+  QMutex pending_updates_mutex_;
+  StatisticsUpdateList pending_updates_;
+
+  // Serialized searches by key, loaded from the database on first use.
+  bool materialized_searches_loaded_;
+  QMap<QString, QByteArray> materialized_searches_;
+
+  // Results of the artist and album lookups by QueryCacheKey.  The generation
+  // goes up each time they're cleared.
+  QMutex query_cache_mutex_;
+  int query_cache_generation_;
+  QHash<QString, QStringList> string_list_cache_;
+  QHash<QString, AlbumList> album_list_cache_;
 };
 
 #endif  // LIBRARYBACKEND_H
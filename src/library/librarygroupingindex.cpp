@@ -0,0 +1,73 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "librarygroupingindex.h"
+
+#include <algorithm>
+
+#include <QStringList>
+
+LibraryGroupingIndex::Node::~Node() {
+  qDeleteAll(children_);
+  delete compilations_;
+}
+
+LibraryGroupingIndex::Node* LibraryGroupingIndex::Node::Child(
+    const QString& key, const QVariantList& columns) {
+  Node*& child = children_[key];
+  if (!child) {
+    child = new Node;
+    child->columns_ = columns;
+  }
+  return child;
+}
+
+LibraryGroupingIndex::Node* LibraryGroupingIndex::Node::Compilations() {
+  if (!compilations_) compilations_ = new Node;
+  return compilations_;
+}
+
+void LibraryGroupingIndex::Node::Sort() {
+  QStringList keys = children_.keys();
+  std::sort(keys.begin(), keys.end());
+
+  sorted_children_.clear();
+  sorted_children_.reserve(keys.count());
+  for (const QString& key : keys) {
+    Node* child = children_[key];
+    child->Sort();
+    sorted_children_ << child;
+  }
+
+  if (compilations_) compilations_->Sort();
+}
+
+bool LibraryGroupingIndex::Children(const Path& path, SqlRowList* rows,
+                                    bool* create_va) const {
+  const Node* node = &root_;
+  for (const PathElement& element : path) {
+    node = element.compilations ? node->compilations_
+                                : node->children_.value(element.key);
+    if (!node) return false;
+  }
+
+  for (const Node* child : node->sorted_children_) {
+    *rows << SqlRow(child->columns_);
+  }
+  *create_va = node->compilations_ != nullptr;
+  return true;
+}
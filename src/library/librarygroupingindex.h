@@ -0,0 +1,82 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARYGROUPINGINDEX_H
+#define LIBRARYGROUPINGINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QVariantList>
+
+#include <boost/noncopyable.hpp>
+
+#include "sqlrow.h"
+
+// The containers of every level of a grouping, built in memory from one pass
+// over the songs so LibraryModel doesn't need a query for each container it
+// populates.  Each container is identified by a key that LibraryModel makes
+// from the container's columns, and remembers those columns so it can be
+// turned back into an SqlRow.
+class LibraryGroupingIndex : boost::noncopyable {
+ public:
+  struct PathElement {
+    PathElement(const QString& key = QString(), bool compilations = false)
+        : key(key), compilations(compilations) {}
+
+    QString key;
+    // The "Various artists" container.  The key isn't used.
+    bool compilations;
+  };
+  typedef QList<PathElement> Path;
+
+  class Node : boost::noncopyable {
+   public:
+    Node() : compilations_(nullptr) {}
+    ~Node();
+
+    // Returns the child with this key, creating it with these columns if
+    // there isn't one yet.
+    Node* Child(const QString& key, const QVariantList& columns);
+    Node* Compilations();
+
+   private:
+    friend class LibraryGroupingIndex;
+
+    void Sort();
+
+    QVariantList columns_;
+    QHash<QString, Node*> children_;
+    // children_ sorted by key, filled in by LibraryGroupingIndex::Finish.
+    QList<Node*> sorted_children_;
+    Node* compilations_;
+  };
+
+  Node* root() { return &root_; }
+
+  // Call once all the songs have been added.
+  void Finish() { root_.Sort(); }
+
+  // Returns false if there's no container at the path, for example because
+  // it was added to the library after the index was built.
+  bool Children(const Path& path, SqlRowList* rows, bool* create_va) const;
+
+ private:
+  Node root_;
+};
+
+#endif  // LIBRARYGROUPINGINDEX_H
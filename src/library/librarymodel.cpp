@@ -18,17 +18,19 @@
 #include "librarymodel.h"
 
 #include <functional>
+#include <memory>
 
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QFuture>
 #include <QIODevice>
 #include <QMetaEnum>
-#include <QNetworkCacheMetaData>
-#include <QNetworkDiskCache>
 #include <QPixmapCache>
 #include <QSettings>
 #include <QStringList>
 #include <QUrl>
-#include <QtConcurrentRun>
 
 #include "librarybackend.h"
 #include "libraryitem.h"
@@ -36,9 +38,11 @@
 #include "libraryview.h"
 #include "sqlrow.h"
 #include "core/application.h"
+#include "core/closure.h"
 #include "core/database.h"
 #include "core/logging.h"
 #include "core/taskmanager.h"
+#include "core/threadpools.h"
 #include "core/utilities.h"
 #include "covers/albumcoverloader.h"
 #include "playlist/songmimedata.h"
@@ -62,7 +66,7 @@ const char* LibraryModel::kSmartPlaylistsSettingsGroup =
 const char* LibraryModel::kSavedGroupingsSettingsGroup = "SavedGroupings";
 const int LibraryModel::kSmartPlaylistsVersion = 4;
 const int LibraryModel::kPrettyCoverSize = 32;
-const qint64 LibraryModel::kIconCacheSize = 100000000;  //~100MB
+const int LibraryModel::kSnapshotVersion = 1;
 
 static bool IsArtistGroupBy(const LibraryModel::GroupBy by) {
   return by == LibraryModel::GroupBy_Artist ||
@@ -82,12 +86,17 @@ LibraryModel::LibraryModel(LibraryBackend* backend, Application* app,
       show_smart_playlists_(false),
       show_various_artists_(true),
       total_song_count_(0),
+      grouping_index_stale_(false),
+      smart_playlist_node_(nullptr),
       artist_icon_(IconLoader::Load("x-clementine-artist", IconLoader::Base)),
       album_icon_(IconLoader::Load("x-clementine-album", IconLoader::Base)),
       playlists_dir_icon_(IconLoader::Load("folder-sound", IconLoader::Base)),
       playlist_icon_(IconLoader::Load("x-clementine-albums", IconLoader::Base)),
-      icon_cache_(new QNetworkDiskCache(this)),
       init_task_id_(-1),
+      tree_generation_(0),
+      update_id_(0),
+      async_populate_(false),
+      next_populate_id_(0),
       use_pretty_covers_(false),
       show_dividers_(true) {
   root_->lazy_loaded = true;
@@ -103,10 +112,6 @@ LibraryModel::LibraryModel(LibraryBackend* backend, Application* app,
   connect(app_->album_cover_loader(), SIGNAL(ImageLoaded(quint64, QImage)),
           SLOT(AlbumArtLoaded(quint64, QImage)));
 
-  icon_cache_->setCacheDirectory(
-      Utilities::GetConfigPath(Utilities::Path_CacheRoot) + "/pixmapcache");
-  icon_cache_->setMaximumCacheSize(LibraryModel::kIconCacheSize);
-
   QIcon nocover = IconLoader::Load("nocover", IconLoader::Other);
   no_cover_icon_ = nocover.pixmap(nocover.availableSizes().last()).scaled(
                            kPrettyCoverSize, kPrettyCoverSize,
@@ -128,7 +133,10 @@ LibraryModel::LibraryModel(LibraryBackend* backend, Application* app,
   backend_->UpdateTotalSongCountAsync();
 }
 
-LibraryModel::~LibraryModel() { delete root_; }
+LibraryModel::~LibraryModel() {
+  SaveSnapshot();
+  delete root_;
+}
 
 void LibraryModel::set_pretty_covers(bool use_pretty_covers) {
   if (use_pretty_covers != use_pretty_covers_) {
@@ -158,6 +166,11 @@ void LibraryModel::SaveGrouping(QString name) {
 
 void LibraryModel::Init(bool async) {
   if (async) {
+    if (PaintSnapshot()) {
+      UpdateAsync();
+      return;
+    }
+
     // Show a loading indicator in the model.
     LibraryItem* loading =
         new LibraryItem(LibraryItem::Type_LoadingIndicator, root_);
@@ -174,7 +187,117 @@ void LibraryModel::Init(bool async) {
   }
 }
 
+qint64 LibraryModel::memory_usage() const {
+  qint64 items = song_nodes_.count() + divider_nodes_.count();
+  for (int i = 0; i < 3; ++i) items += container_nodes_[i].count();
+
+  // Containers have a Song too, it's just mostly empty.
+  return items * (sizeof(LibraryItem) + Song::data_size());
+}
+
+void LibraryModel::set_snapshot_filename(const QString& filename) {
+  snapshot_filename_ = filename;
+  saved_snapshot_.reset();
+
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly)) return;
+
+  std::unique_ptr<Snapshot> snapshot(new Snapshot);
+  QDataStream s(&file);
+  qint32 version = 0;
+  s >> version;
+
+  if (version == kSnapshotVersion) {
+    qint32 total_song_count = 0;
+    qint32 count = 0;
+    s >> snapshot->grouping >> snapshot->show_various_artists >>
+        total_song_count >> snapshot->top_level.create_va >> count;
+    snapshot->total_song_count = total_song_count;
+
+    for (int i = 0; i < count && s.status() == QDataStream::Ok; ++i) {
+      QList<QVariant> values;
+      s >> values;
+      snapshot->top_level.rows << SqlRow(values);
+    }
+  }
+
+  if (version != kSnapshotVersion || s.status() != QDataStream::Ok) {
+    qLog(Warning) << "Ignoring corrupt library snapshot" << filename;
+    file.remove();
+    return;
+  }
+
+  saved_snapshot_ = std::move(snapshot);
+}
+
+void LibraryModel::SaveSnapshot() const {
+  if (snapshot_filename_.isEmpty() || !top_level_snapshot_) return;
+
+  QFile file(snapshot_filename_);
+  if (!QDir().mkpath(QFileInfo(file).absolutePath()) ||
+      !file.open(QIODevice::WriteOnly)) {
+    qLog(Warning) << "Couldn't write library snapshot" << snapshot_filename_;
+    return;
+  }
+
+  const Snapshot& snapshot = *top_level_snapshot_;
+  QDataStream s(&file);
+  s << qint32(kSnapshotVersion) << snapshot.grouping
+    << snapshot.show_various_artists << qint32(total_song_count_)
+    << snapshot.top_level.create_va << qint32(snapshot.top_level.rows.count());
+  for (const SqlRow& row : snapshot.top_level.rows) {
+    s << row.values();
+  }
+}
+
+bool LibraryModel::IsUnfiltered() const {
+  return query_options_.filter().isEmpty() &&
+         query_options_.max_age() == -1 &&
+         query_options_.query_mode() == QueryOptions::QueryMode_All;
+}
+
+void LibraryModel::RememberTopLevel(const QueryResult& result) {
+  // Whatever is in the snapshot file is out of date now.
+  saved_snapshot_.reset();
+
+  // Songs at the top level would make the snapshot as big as the library.
+  if (snapshot_filename_.isEmpty() || group_by_[0] == GroupBy_None ||
+      !IsUnfiltered()) {
+    return;
+  }
+
+  top_level_snapshot_.reset(new Snapshot);
+  top_level_snapshot_->grouping = group_by_;
+  top_level_snapshot_->show_various_artists = show_various_artists_;
+  top_level_snapshot_->top_level.rows = result.rows;
+  top_level_snapshot_->top_level.create_va = result.create_va;
+}
+
+bool LibraryModel::PaintSnapshot() {
+  std::unique_ptr<Snapshot> snapshot(std::move(saved_snapshot_));
+  if (!snapshot || snapshot->grouping != group_by_ ||
+      snapshot->show_various_artists != show_various_artists_ ||
+      !IsUnfiltered()) {
+    return false;
+  }
+
+  BeginReset();
+  root_->lazy_loaded = true;
+  PostQuery(root_, snapshot->top_level, false);
+  endResetModel();
+
+  if (snapshot->total_song_count >= 0) {
+    TotalSongCountUpdatedSlot(snapshot->total_song_count);
+  }
+  return true;
+}
+
 void LibraryModel::SongsDiscovered(const SongList& songs) {
+  grouping_index_.reset();
+  grouping_index_stale_ = true;
+
+  song_nodes_.reserve(song_nodes_.size() + songs.count());
+
   for (const Song& song : songs) {
     // Sanity check to make sure we don't add songs that are outside the user's
     // filter
@@ -392,11 +515,16 @@ QString LibraryModel::DividerDisplayText(GroupBy type,
 }
 
 void LibraryModel::SongsDeleted(const SongList& songs) {
+  grouping_index_.reset();
+  grouping_index_stale_ = true;
+
   // Delete the actual song nodes first, keeping track of each parent so we
   // might check to see if they're empty later.
   QSet<LibraryItem*> parents;
   for (const Song& song : songs) {
     if (song_nodes_.contains(song.id())) {
+      tree_generation_++;
+
       LibraryItem* node = song_nodes_[song.id()];
 
       if (node->parent != root_) parents << node->parent;
@@ -439,6 +567,7 @@ void LibraryModel::SongsDeleted(const SongList& songs) {
         node->parent->compilation_artist_node_ = nullptr;
       else
         container_nodes_[node->container_level].remove(node->key);
+      populating_.remove(node);
 
       // It was empty - delete it
       beginRemoveRows(ItemToIndex(node->parent), node->row, node->row);
@@ -447,7 +576,10 @@ void LibraryModel::SongsDeleted(const SongList& songs) {
     }
   }
 
-  // Delete empty dividers
+  DeleteEmptyDividers(divider_keys);
+}
+
+void LibraryModel::DeleteEmptyDividers(const QSet<QString>& divider_keys) {
   for (const QString& divider_key : divider_keys) {
     if (!divider_nodes_.contains(divider_key)) continue;
 
@@ -493,24 +625,23 @@ QVariant LibraryModel::AlbumIcon(const QModelIndex& index) {
     return cached_pixmap;
   }
 
-  // Try to load it from the disk cache
-  std::unique_ptr<QIODevice> cache(icon_cache_->data(QUrl(cache_key)));
-  if (cache) {
-    QImage cached_pixmap;
-    if (cached_pixmap.load(cache.get(), "XPM")) {
-      QPixmapCache::insert(cache_key, QPixmap::fromImage(cached_pixmap));
-      return QPixmap::fromImage(cached_pixmap);
-    }
-  }
-
   // Maybe we're loading a pixmap already?
   if (pending_cache_keys_.contains(cache_key)) {
     return no_cover_icon_;
   }
 
-  // No art is cached and we're not loading it already.  Load art for the first
-  // Song in the album.
-  SongList songs = GetChildSongs(index);
+  // Use the art for the first Song in the album.  The cover loader's cache
+  // might have it already scaled, otherwise load it.
+  SongList songs = GetChildTreeSongs(index);
+  QImage cached_image;
+  if (!songs.isEmpty() &&
+      app_->album_cover_loader()->LoadCachedImage(
+          cover_loader_options_, songs.first(), &cached_image)) {
+    QPixmap pixmap = QPixmap::fromImage(cached_image);
+    QPixmapCache::insert(cache_key, pixmap);
+    return pixmap;
+  }
+
   if (!songs.isEmpty()) {
     const quint64 id = app_->album_cover_loader()->LoadImageAsync(
         cover_loader_options_, songs.first());
@@ -537,19 +668,6 @@ void LibraryModel::AlbumArtLoaded(quint64 id, const QImage& image) {
     QPixmapCache::insert(cache_key, QPixmap::fromImage(image));
   }
 
-  // If we have a valid cover not already in the disk cache
-  std::unique_ptr<QIODevice> cached_img(icon_cache_->data(QUrl(cache_key)));
-  if (!cached_img && !image.isNull()) {
-    QNetworkCacheMetaData item_metadata;
-    item_metadata.setSaveToDisk(true);
-    item_metadata.setUrl(QUrl(cache_key));
-    QIODevice* cache = icon_cache_->prepare(item_metadata);
-    if (cache) {
-      image.save(cache, "XPM");
-      icon_cache_->insert(cache);
-    }
-  }
-
   const QModelIndex index = ItemToIndex(item);
   emit dataChanged(index, index);
 }
@@ -668,31 +786,75 @@ bool LibraryModel::HasCompilations(const LibraryQuery& query) {
   q.AddCompilationRequirement(true);
   q.SetLimit(1);
 
-  QMutexLocker l(backend_->db()->Mutex());
-  if (!backend_->ExecQuery(&q)) return false;
+  Database::ReadLocker l(backend_->db(), backend_->database_name());
+  if (!backend_->ExecReadOnlyQuery(&q)) return false;
 
   return q.Next();
 }
 
-LibraryModel::QueryResult LibraryModel::RunQuery(LibraryItem* parent) {
+LibraryModel::QueryResult LibraryModel::RunQuery(
+    LibraryItem* parent, const QueryCancelFlag& cancel) {
+  LibraryQuery q(query_options_);
+  q.SetCancelFlag(cancel);
+  LibraryGroupingIndex::Path path;
+  GroupBy child_type = PrepareQuery(parent, &q, &path);
+
+  // Populating the top level means the tree is being reset, so the index is
+  // built again too.
   QueryResult result;
+  if (parent == root_) {
+    std::shared_ptr<LibraryGroupingIndex> index =
+        BuildGroupingIndex(query_options_, group_by_, cancel);
+    result = RunPreparedQuery(q, child_type, index, path);
+    result.grouping_index = index;
+  } else {
+    result = RunPreparedQuery(q, child_type, grouping_index_, path);
+  }
+
+  // The index might be missing containers too, so it's not enough to look at
+  // whether the last query finished.
+  result.cancelled = SqliteCancelScope::IsCancelled(cancel);
+  return result;
+}
 
+LibraryModel::GroupBy LibraryModel::PrepareQuery(
+    LibraryItem* parent, LibraryQuery* q, LibraryGroupingIndex::Path* path) {
   // Information about what we want the children to be
   int child_level = parent == root_ ? 0 : parent->container_level + 1;
   GroupBy child_type = child_level >= 3 ? GroupBy_None : group_by_[child_level];
 
   // Initialise the query.  child_type says what type of thing we want (artists,
   // songs, etc.)
-  LibraryQuery q(query_options_);
-  InitQuery(child_type, &q);
+  InitQuery(child_type, q);
 
   // Walk up through the item's parents adding filters as necessary
   LibraryItem* p = parent;
   while (p && p->type == LibraryItem::Type_Container) {
-    FilterQuery(group_by_[p->container_level], p, &q);
+    const GroupBy type = group_by_[p->container_level];
+    FilterQuery(type, p, q);
+
+    if (IsCompilationArtistNode(p)) {
+      path->prepend(LibraryGroupingIndex::PathElement(QString(), true));
+    } else {
+      path->prepend(LibraryGroupingIndex::PathElement(GroupingKey(type, p)));
+    }
     p = p->parent;
   }
 
+  return child_type;
+}
+
+LibraryModel::QueryResult LibraryModel::RunPreparedQuery(
+    LibraryQuery q, GroupBy child_type,
+    std::shared_ptr<LibraryGroupingIndex> index,
+    LibraryGroupingIndex::Path path) {
+  QueryResult result;
+
+  if (index && child_type != GroupBy_None &&
+      index->Children(path, &result.rows, &result.create_va)) {
+    return result;
+  }
+
   // Artists GroupBy is special - we don't want compilation albums appearing
   if (IsArtistGroupBy(child_type)) {
     // Add the special Various artists node
@@ -705,18 +867,78 @@ LibraryModel::QueryResult LibraryModel::RunQuery(LibraryItem* parent) {
   }
 
   // Execute the query
-  QMutexLocker l(backend_->db()->Mutex());
-  if (!backend_->ExecQuery(&q)) return result;
+  Database::ReadLocker l(backend_->db(), backend_->database_name());
+  if (!backend_->ExecReadOnlyQuery(&q)) return result;
 
   while (q.Next()) {
-    result.rows << SqlRow(q);
+    result.rows << SqlRow(q).Detached();
   }
   return result;
 }
 
+std::shared_ptr<LibraryGroupingIndex> LibraryModel::BuildGroupingIndex(
+    const QueryOptions& options, const Grouping& grouping,
+    const QueryCancelFlag& cancel) const {
+  // The columns of every level, then whether the song is a compilation.
+  QStringList columns;
+  QList<int> first_columns;
+  int levels = 0;
+  for (; levels < 3 && grouping[levels] != GroupBy_None; ++levels) {
+    first_columns << columns.count();
+    columns << GroupByColumns(grouping[levels]);
+  }
+  if (levels == 0) return std::shared_ptr<LibraryGroupingIndex>();
+
+  const int compilation_column = columns.count();
+  first_columns << compilation_column;
+  columns << "effective_compilation";
+
+  LibraryQuery q(options);
+  q.SetColumnSpec(columns.join(", "));
+  q.SetCancelFlag(cancel);
+
+  Database::ReadLocker l(backend_->db(), backend_->database_name());
+  if (!backend_->ExecReadOnlyQuery(&q)) {
+    return std::shared_ptr<LibraryGroupingIndex>();
+  }
+
+  std::shared_ptr<LibraryGroupingIndex> index(new LibraryGroupingIndex);
+  while (q.Next()) {
+    const bool compilation = q.Value(compilation_column).toBool();
+
+    LibraryGroupingIndex::Node* node = index->root();
+    for (int i = 0; i < levels; ++i) {
+      const GroupBy type = grouping[i];
+
+      // Like RunPreparedQuery, compilations only go in the Various artists
+      // node.
+      if (IsArtistGroupBy(type) && compilation) {
+        if (!show_various_artists_) break;
+        node = node->Compilations();
+        continue;
+      }
+
+      QVariantList values;
+      for (int column = first_columns[i]; column < first_columns[i + 1];
+           ++column) {
+        values << q.Value(column);
+      }
+      node = node->Child(GroupingKey(type, SqlRow(values)), values);
+    }
+  }
+
+  index->Finish();
+  return index;
+}
+
 void LibraryModel::PostQuery(LibraryItem* parent,
                              const LibraryModel::QueryResult& result,
                              bool signal) {
+  if (result.grouping_index && !grouping_index_stale_) {
+    grouping_index_ = result.grouping_index;
+  }
+  if (parent == root_) RememberTopLevel(result);
+
   // Information about what we want the children to be
   int child_level = parent == root_ ? 0 : parent->container_level + 1;
   GroupBy child_type = child_level >= 3 ? GroupBy_None : group_by_[child_level];
@@ -725,6 +947,12 @@ void LibraryModel::PostQuery(LibraryItem* parent,
     CreateCompilationArtistNode(signal, parent);
   }
 
+  if (child_type == GroupBy_None)
+    song_nodes_.reserve(song_nodes_.size() + result.rows.count());
+  else
+    container_nodes_[child_level].reserve(
+        container_nodes_[child_level].size() + result.rows.count());
+
   // Step through the results
   for (const SqlRow& row : result.rows) {
     // Create the item - it will get inserted into the model here
@@ -741,23 +969,122 @@ void LibraryModel::PostQuery(LibraryItem* parent,
 
 void LibraryModel::LazyPopulate(LibraryItem* parent, bool signal) {
   if (parent->lazy_loaded) return;
+
+  // Don't wait for a populate that's running in the background, its result
+  // will be ignored.
+  if (populating_.remove(parent)) RemoveLoadingIndicator(parent);
+
   parent->lazy_loaded = true;
 
   QueryResult result = RunQuery(parent);
   PostQuery(parent, result, signal);
 }
 
+void LibraryModel::LazyPopulateAsync(LibraryItem* parent, bool show_loading) {
+  if (parent->lazy_loaded || populating_.contains(parent)) return;
+
+  const int populate_id = next_populate_id_++;
+  populating_[parent] = populate_id;
+
+  if (show_loading) {
+    LibraryItem* loading = new LibraryItem(LibraryItem::Type_LoadingIndicator);
+    loading->display_text = tr("Loading...");
+    loading->lazy_loaded = true;
+    loading->InsertNotify(parent);
+  }
+
+  // The query has to be built here because it looks at the tree.
+  LibraryQuery q(query_options_);
+  LibraryGroupingIndex::Path path;
+  GroupBy child_type = PrepareQuery(parent, &q, &path);
+
+  const int update_id = update_id_;
+  QFuture<QueryResult> future =
+      ThreadPools::Run<QueryResult>(
+          ThreadPools::Pool_Interactive,
+          std::bind(&LibraryModel::RunPreparedQuery, this, q, child_type,
+                    grouping_index_, path));
+  NewClosure(future, [=]() {
+    LazyPopulateAsyncFinished(parent, populate_id, update_id, future.result());
+  });
+}
+
+void LibraryModel::LazyPopulateAsyncFinished(LibraryItem* parent,
+                                             int populate_id, int update_id,
+                                             const QueryResult& result) {
+  // The item was deleted, reset or populated some other way since.
+  if (populating_.value(parent, -1) != populate_id) return;
+  populating_.remove(parent);
+
+  const bool show_loading = RemoveLoadingIndicator(parent);
+
+  // The filter or grouping changed while the query was running, so try again
+  // with a new query.
+  if (update_id != update_id_) {
+    LazyPopulateAsync(parent, show_loading);
+    return;
+  }
+
+  parent->lazy_loaded = true;
+  PostQuery(parent, result, true);
+}
+
+bool LibraryModel::RemoveLoadingIndicator(LibraryItem* parent) {
+  for (LibraryItem* child : parent->children) {
+    if (child->type == LibraryItem::Type_LoadingIndicator) {
+      beginRemoveRows(ItemToIndex(parent), child->row, child->row);
+      parent->Delete(child->row);
+      endRemoveRows();
+      return true;
+    }
+  }
+  return false;
+}
+
+void LibraryModel::fetchMore(const QModelIndex& parent) {
+  LibraryItem* item = IndexToItem(parent);
+  if (item->lazy_loaded) return;
+
+  if (async_populate_)
+    LazyPopulateAsync(item, true);
+  else
+    LazyPopulate(item);
+}
+
+void LibraryModel::PrefetchAsync(const QModelIndex& index) {
+  LibraryItem* item = IndexToItem(index);
+  if (item && item->type == LibraryItem::Type_Container)
+    LazyPopulateAsync(item, false);
+}
+
 void LibraryModel::ResetAsync() {
+  // Any update that's still running is about to be thrown away.
+  update_id_++;
+  CancelQueries(&update_cancel_);
+
+  // So is an earlier reset.  It gets dropped when it finishes, and this one
+  // puts the tree together instead.
+  CancelQueries(&reset_cancel_);
+  reset_cancel_.reset(new QAtomicInt(0));
+
   QFuture<LibraryModel::QueryResult> future =
-      QtConcurrent::run(this, &LibraryModel::RunQuery, root_);
+      ThreadPools::Run<QueryResult>(
+          ThreadPools::Pool_Interactive,
+          std::bind(&LibraryModel::RunQuery, this, root_, reset_cancel_));
   NewClosure(future, this,
              SLOT(ResetAsyncQueryFinished(QFuture<LibraryModel::QueryResult>)),
              future);
 }
 
+void LibraryModel::CancelQueries(QueryCancelFlag* flag) {
+  if (*flag) (*flag)->fetchAndStoreRelaxed(1);
+  flag->reset();
+}
+
 void LibraryModel::ResetAsyncQueryFinished(
     QFuture<LibraryModel::QueryResult> future) {
   const struct QueryResult result = future.result();
+  if (result.cancelled) return;
 
   BeginReset();
   root_->lazy_loaded = true;
@@ -772,14 +1099,238 @@ void LibraryModel::ResetAsyncQueryFinished(
   endResetModel();
 }
 
+void LibraryModel::UpdateAsync(int first_changed_level) {
+  // Smart playlists are only shown when there's no filter, and it's not worth
+  // special casing adding or removing them here.
+  const bool want_smart_playlists =
+      show_smart_playlists_ && query_options_.filter().isEmpty();
+
+  // The index was built for the old options or grouping.  A new one comes
+  // back with the update.
+  grouping_index_.reset();
+  grouping_index_stale_ = false;
+
+  // Nothing is worth keeping if the tree is still being loaded for the first
+  // time or if the top level is going to be different.
+  if (init_task_id_ != -1 || first_changed_level <= 0 ||
+      want_smart_playlists != (smart_playlist_node_ != nullptr)) {
+    ResetAsync();
+    return;
+  }
+
+  CancelQueries(&update_cancel_);
+  update_cancel_.reset(new QAtomicInt(0));
+
+  // Build a query for every node that's been populated.  This walks the tree
+  // breadth first, so parents always come before their children.
+  QList<UpdateQuery> queries;
+  QList<LibraryItem*> parents;
+  parents << root_;
+  for (int i = 0; i < parents.count(); ++i) {
+    LibraryItem* parent = parents[i];
+    const int child_level = parent == root_ ? 0 : parent->container_level + 1;
+
+    UpdateQuery update;
+    update.parent = parent;
+    update.query = LibraryQuery(query_options_);
+    update.query.SetCancelFlag(update_cancel_);
+    update.child_type = PrepareQuery(parent, &update.query, &update.path);
+    queries << update;
+
+    // The children are going to be replaced, so don't look inside them.
+    if (child_level >= first_changed_level) continue;
+
+    for (LibraryItem* child : parent->children) {
+      if (child->type == LibraryItem::Type_Container && child->lazy_loaded)
+        parents << child;
+    }
+  }
+
+  const int update_id = ++update_id_;
+  const int tree_generation = tree_generation_;
+
+  QFuture<QList<QueryResult> > future =
+      ThreadPools::Run<QList<QueryResult> >(
+          ThreadPools::Pool_Interactive,
+          std::bind(&LibraryModel::RunUpdateQueries, this, queries,
+                    query_options_, group_by_, update_cancel_));
+  NewClosure(future, [=]() {
+    UpdateAsyncQueryFinished(update_id, tree_generation, first_changed_level,
+                             queries, future.result());
+  });
+}
+
+QList<LibraryModel::QueryResult> LibraryModel::RunUpdateQueries(
+    QList<UpdateQuery> queries, QueryOptions options, Grouping grouping,
+    QueryCancelFlag cancel) {
+  std::shared_ptr<LibraryGroupingIndex> index =
+      BuildGroupingIndex(options, grouping, cancel);
+
+  QList<QueryResult> ret;
+  for (const UpdateQuery& update : queries) {
+    ret << RunPreparedQuery(update.query, update.child_type, index,
+                            update.path);
+  }
+  if (!ret.isEmpty()) ret[0].grouping_index = index;
+  return ret;
+}
+
+void LibraryModel::UpdateAsyncQueryFinished(
+    int update_id, int tree_generation, int first_changed_level,
+    const QList<UpdateQuery>& queries, const QList<QueryResult>& results) {
+  // Another update or a reset was started after this one.
+  if (update_id != update_id_) return;
+
+  // The new index is only any good if no songs changed while it was built.
+  if (!results.isEmpty() && tree_generation == tree_generation_ &&
+      !grouping_index_stale_) {
+    grouping_index_ = results[0].grouping_index;
+  }
+
+  // Some of the items we made queries for have been deleted since.
+  if (tree_generation != tree_generation_) {
+    ResetAsync();
+    return;
+  }
+
+  QSet<LibraryItem*> removed;
+  QSet<QString> divider_keys;
+  for (int i = 0; i < queries.count(); ++i) {
+    LibraryItem* parent = queries[i].parent;
+
+    // It went away along with one of its parents.
+    if (removed.contains(parent)) continue;
+
+    const int child_level = parent == root_ ? 0 : parent->container_level + 1;
+    UpdateChildren(parent, results[i], child_level >= first_changed_level,
+                   &removed, &divider_keys);
+  }
+
+  DeleteEmptyDividers(divider_keys);
+
+  // Don't give album art to items that aren't there any more.
+  if (removed.isEmpty()) return;
+  QMap<quint64, ItemAndCacheKey>::iterator it = pending_art_.begin();
+  while (it != pending_art_.end()) {
+    if (removed.contains(it->first)) {
+      pending_cache_keys_.remove(it->second);
+      it = pending_art_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+static QString UpdateKey(const LibraryItem* item) {
+  if (item->type == LibraryItem::Type_Song)
+    return QString::number(item->metadata.id());
+  return item->key;
+}
+
+void LibraryModel::UpdateChildren(LibraryItem* parent,
+                                  const QueryResult& result, bool replace,
+                                  QSet<LibraryItem*>* removed,
+                                  QSet<QString>* divider_keys) {
+  const int child_level = parent == root_ ? 0 : parent->container_level + 1;
+  GroupBy child_type = child_level >= 3 ? GroupBy_None : group_by_[child_level];
+
+  // Work out the keys of the children we should have.  Songs are matched on
+  // their ID, containers on their key.
+  QStringList keys;
+  for (const SqlRow& row : result.rows) {
+    if (child_type == GroupBy_None) {
+      keys << QString::number(row.value(0).toInt());
+    } else {
+      std::unique_ptr<LibraryItem> item(
+          ItemFromQuery(child_type, false, false, nullptr, row, child_level));
+      keys << item->key;
+    }
+  }
+  const QSet<QString> wanted_keys = keys.toSet();
+  if (parent == root_) RememberTopLevel(result);
+
+  // Remove the children that aren't wanted any more.  Going backwards keeps
+  // the rows of the ones we haven't looked at yet valid.
+  QSet<QString> existing_keys;
+  for (int row = parent->children.count() - 1; row >= 0; --row) {
+    LibraryItem* child = parent->children[row];
+    if (child->type != LibraryItem::Type_Container &&
+        child->type != LibraryItem::Type_Song)
+      continue;
+
+    if (!replace) {
+      if (IsCompilationArtistNode(child)) {
+        if (result.create_va) continue;
+      } else if (wanted_keys.contains(UpdateKey(child))) {
+        existing_keys << UpdateKey(child);
+        continue;
+      }
+    }
+
+    if (child_level == 0) *divider_keys << DividerKey(child_type, child);
+    RemoveChild(child, removed);
+  }
+
+  // Add the new ones
+  if (result.create_va && parent->compilation_artist_node_ == nullptr) {
+    CreateCompilationArtistNode(true, parent);
+  }
+
+  for (int i = 0; i < result.rows.count(); ++i) {
+    if (existing_keys.contains(keys[i])) continue;
+
+    LibraryItem* item = ItemFromQuery(child_type, true, child_level == 0,
+                                      parent, result.rows[i], child_level);
+    if (child_type == GroupBy_None)
+      song_nodes_[item->metadata.id()] = item;
+    else
+      container_nodes_[child_level][item->key] = item;
+  }
+}
+
+void LibraryModel::RemoveChild(LibraryItem* item,
+                               QSet<LibraryItem*>* removed) {
+  LibraryItem* parent = item->parent;
+
+  ForgetItem(item, removed);
+  if (IsCompilationArtistNode(item)) parent->compilation_artist_node_ = nullptr;
+
+  beginRemoveRows(ItemToIndex(parent), item->row, item->row);
+  parent->Delete(item->row);
+  endRemoveRows();
+}
+
+void LibraryModel::ForgetItem(LibraryItem* item, QSet<LibraryItem*>* removed) {
+  for (LibraryItem* child : item->children) ForgetItem(child, removed);
+  removed->insert(item);
+  populating_.remove(item);
+
+  // Another item might have the same key, so only remove the entry if it's
+  // pointing at this one.
+  if (item->type == LibraryItem::Type_Song) {
+    if (song_nodes_.value(item->metadata.id()) == item)
+      song_nodes_.remove(item->metadata.id());
+  } else if (item->type == LibraryItem::Type_Container &&
+             item->container_level >= 0 && item->container_level < 3) {
+    QHash<QString, LibraryItem*>& nodes =
+        container_nodes_[item->container_level];
+    if (nodes.value(item->key) == item) nodes.remove(item->key);
+  }
+}
+
 void LibraryModel::BeginReset() {
   beginResetModel();
+  tree_generation_++;
+  grouping_index_.reset();
+  grouping_index_stale_ = false;
   delete root_;
   song_nodes_.clear();
   container_nodes_[0].clear();
   container_nodes_[1].clear();
   container_nodes_[2].clear();
   divider_nodes_.clear();
+  sort_text_cache_.clear();
+  populating_.clear();
   pending_art_.clear();
   smart_playlist_node_ = nullptr;
 
@@ -803,52 +1354,126 @@ void LibraryModel::Reset() {
 
 void LibraryModel::InitQuery(GroupBy type, LibraryQuery* q) {
   // Say what type of thing we want to get back from the database.
+  if (type == GroupBy_None) {
+    q->SetColumnSpec("%songs_table.ROWID, " +
+                     Song::ColumnSpec(Song::Projection_TreeNode));
+  } else {
+    q->SetColumnSpec("DISTINCT " + GroupByColumns(type).join(", "));
+  }
+}
+
+QStringList LibraryModel::GroupByColumns(GroupBy type) {
   switch (type) {
     case GroupBy_Artist:
-      q->SetColumnSpec("DISTINCT artist");
-      break;
+      return QStringList() << "artist"
+                           << "sortartist";
     case GroupBy_Album:
-      q->SetColumnSpec("DISTINCT album");
-      break;
+      return QStringList() << "album"
+                           << "sortalbum";
     case GroupBy_Composer:
-      q->SetColumnSpec("DISTINCT composer");
-      break;
+      return QStringList() << "composer";
     case GroupBy_Performer:
-      q->SetColumnSpec("DISTINCT performer");
-      break;
+      return QStringList() << "performer";
     case GroupBy_Disc:
-      q->SetColumnSpec("DISTINCT disc");
-      break;
+      return QStringList() << "disc";
     case GroupBy_Grouping:
-      q->SetColumnSpec("DISTINCT grouping");
-      break;
+      return QStringList() << "grouping";
     case GroupBy_YearAlbum:
-      q->SetColumnSpec("DISTINCT year, album, grouping");
-      break;
+      return QStringList() << "year"
+                           << "album"
+                           << "grouping";
     case GroupBy_OriginalYearAlbum:
-      q->SetColumnSpec("DISTINCT year, originalyear, album, grouping");
-      break;
+      return QStringList() << "year"
+                           << "originalyear"
+                           << "album"
+                           << "grouping";
     case GroupBy_Year:
-      q->SetColumnSpec("DISTINCT year");
-      break;
+      return QStringList() << "year";
     case GroupBy_OriginalYear:
-      q->SetColumnSpec("DISTINCT effective_originalyear");
-      break;
+      return QStringList() << "effective_originalyear";
     case GroupBy_Genre:
-      q->SetColumnSpec("DISTINCT genre");
-      break;
+      return QStringList() << "genre";
     case GroupBy_AlbumArtist:
-      q->SetColumnSpec("DISTINCT effective_albumartist");
-      break;
+      return QStringList() << "effective_albumartist"
+                           << "sortalbumartist";
     case GroupBy_Bitrate:
-      q->SetColumnSpec("DISTINCT bitrate");
+      return QStringList() << "bitrate";
+    case GroupBy_FileType:
+      return QStringList() << "filetype";
+    case GroupBy_None:
       break;
+  }
+  return QStringList();
+}
+
+QStringList LibraryModel::SortColumns(GroupBy type) {
+  switch (type) {
+    case GroupBy_Artist:
+      return QStringList() << "sortartist";
+    case GroupBy_Album:
+      return QStringList() << "sortalbum";
+    case GroupBy_AlbumArtist:
+      return QStringList() << "sortalbumartist";
+    case GroupBy_YearAlbum:
+      return QStringList() << "year"
+                           << "grouping"
+                           << "album";
+    case GroupBy_OriginalYearAlbum:
+      return QStringList() << "effective_originalyear"
+                           << "grouping"
+                           << "album";
+    case GroupBy_OriginalYear:
+      return QStringList() << "effective_originalyear";
     case GroupBy_None:
-      q->SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
       break;
+    default:
+      return GroupByColumns(type);
+  }
+  return QStringList();
+}
+
+QString LibraryModel::GroupingKey(GroupBy type, const SqlRow& row) {
+  // Has to tell apart the same containers that FilterQuery does.
+  switch (type) {
+    case GroupBy_YearAlbum:
+      return (QStringList() << QString::number(row.value(0).toInt())
+                            << row.value(1).toString()
+                            << row.value(2).toString())
+          .join(QString(QChar(0)));
+    case GroupBy_OriginalYearAlbum:
+      return (QStringList() << QString::number(row.value(0).toInt())
+                            << QString::number(row.value(1).toInt())
+                            << row.value(2).toString()
+                            << row.value(3).toString())
+          .join(QString(QChar(0)));
+    case GroupBy_Year:
+    case GroupBy_OriginalYear:
+    case GroupBy_Bitrate:
+      return QString::number(qMax(0, row.value(0).toInt()));
+    case GroupBy_Disc:
     case GroupBy_FileType:
-      q->SetColumnSpec("DISTINCT filetype");
-      break;
+      return QString::number(row.value(0).toInt());
+    default:
+      return row.value(0).toString();
+  }
+}
+
+QString LibraryModel::GroupingKey(GroupBy type, const LibraryItem* item) {
+  const Song& metadata = item->metadata;
+  switch (type) {
+    case GroupBy_YearAlbum:
+      return (QStringList() << QString::number(metadata.year())
+                            << metadata.album() << metadata.grouping())
+          .join(QString(QChar(0)));
+    case GroupBy_OriginalYearAlbum:
+      return (QStringList() << QString::number(metadata.year())
+                            << QString::number(metadata.originalyear())
+                            << metadata.album() << metadata.grouping())
+          .join(QString(QChar(0)));
+    case GroupBy_FileType:
+      return QString::number(int(metadata.filetype()));
+    default:
+      return item->key;
   }
 }
 
@@ -953,9 +1578,15 @@ LibraryItem* LibraryModel::ItemFromQuery(GroupBy type, bool signal,
 
   switch (type) {
     case GroupBy_Artist:
+    case GroupBy_Album:
+    case GroupBy_AlbumArtist:
+      // The sort text was stored with the song, see InitQuery
       item->key = row.value(0).toString();
       item->display_text = TextOrUnknown(item->key);
-      item->sort_text = SortTextForArtist(item->key);
+      item->sort_text = row.value(1).toString();
+      if (item->sort_text.isEmpty()) {
+        item->sort_text = CachedSortTextForArtist(item->key);
+      }
       break;
 
     case GroupBy_YearAlbum:
@@ -996,11 +1627,9 @@ LibraryItem* LibraryModel::ItemFromQuery(GroupBy type, bool signal,
     case GroupBy_Performer:
     case GroupBy_Grouping:
     case GroupBy_Genre:
-    case GroupBy_Album:
-    case GroupBy_AlbumArtist:
       item->key = row.value(0).toString();
       item->display_text = TextOrUnknown(item->key);
-      item->sort_text = SortTextForArtist(item->key);
+      item->sort_text = CachedSortTextForArtist(item->key);
       break;
 
     case GroupBy_Disc:
@@ -1021,7 +1650,7 @@ LibraryItem* LibraryModel::ItemFromQuery(GroupBy type, bool signal,
       break;
 
     case GroupBy_None:
-      item->metadata.InitFromQuery(row, true);
+      item->metadata.InitFromQuery(row, Song::Projection_TreeNode);
       item->key = item->metadata.title();
       item->display_text = item->metadata.TitleWithCompilationArtist();
       item->sort_text = SortTextForSong(item->metadata);
@@ -1046,7 +1675,7 @@ LibraryItem* LibraryModel::ItemFromSong(GroupBy type, bool signal,
     case GroupBy_Artist:
       item->key = s.artist();
       item->display_text = TextOrUnknown(item->key);
-      item->sort_text = SortTextForArtist(item->key);
+      item->sort_text = CachedSortTextForArtist(item->key);
       break;
 
     case GroupBy_YearAlbum:
@@ -1094,7 +1723,7 @@ LibraryItem* LibraryModel::ItemFromSong(GroupBy type, bool signal,
     case GroupBy_AlbumArtist:
       if (item->key.isNull()) item->key = s.effective_albumartist();
       item->display_text = TextOrUnknown(item->key);
-      item->sort_text = SortTextForArtist(item->key);
+      item->sort_text = CachedSortTextForArtist(item->key);
       break;
 
     case GroupBy_Disc:
@@ -1166,29 +1795,19 @@ QString LibraryModel::PrettyYearAlbum(int year, const QString& album) {
   return QString::number(year) + " - " + TextOrUnknown(album);
 }
 
-QString LibraryModel::SortText(QString text) {
-  if (text.isEmpty()) {
-    text = " unknown";
-  } else {
-    text = text.toLower();
-  }
-  text = text.remove(QRegExp("[^\\w ]"));
-
-  return text;
-}
+QString LibraryModel::SortText(QString text) { return Song::SortText(text); }
 
 QString LibraryModel::SortTextForArtist(QString artist) {
-  artist = SortText(artist);
+  return Song::SortTextForArtist(artist);
+}
 
-  if (artist.startsWith("the ")) {
-    artist = artist.right(artist.length() - 4) + ", the";
-  } else if (artist.startsWith("a ")) {
-    artist = artist.right(artist.length() - 2) + ", a";
-  } else if (artist.startsWith("an ")) {
-    artist = artist.right(artist.length() - 3) + ", an";
-  }
+QString LibraryModel::CachedSortTextForArtist(const QString& artist) {
+  QHash<QString, QString>::const_iterator it = sort_text_cache_.find(artist);
+  if (it != sort_text_cache_.end()) return it.value();
 
-  return artist;
+  const QString ret = SortTextForArtist(artist);
+  sort_text_cache_.insert(artist, ret);
+  return ret;
 }
 
 QString LibraryModel::SortTextForNumber(int number) {
@@ -1236,22 +1855,126 @@ QMimeData* LibraryModel::mimeData(const QModelIndexList& indexes) const {
   }
 
   SongMimeData* data = new SongMimeData;
-  QList<QUrl> urls;
-  QSet<int> song_ids;
-
   data->backend = backend_;
+  LibraryBackend* backend = backend_;
 
+  QList<LibraryQuery> queries;
+  SongList songs;
   for (const QModelIndex& index : indexes) {
-    GetChildSongs(IndexToItem(index), &urls, &data->songs, &song_ids);
+    LibraryItem* item = IndexToItem(index);
+    if (item->type == LibraryItem::Type_Container) {
+      queries << const_cast<LibraryModel*>(this)->ChildSongsQuery(item);
+    } else if (item->type == LibraryItem::Type_Song) {
+      songs << item->metadata;
+    }
+  }
+
+  if (queries.isEmpty()) {
+    QList<QUrl> urls;
+    for (const Song& song : songs) urls << song.url();
+
+    data->songs = songs;
+    data->setUrls(urls);
+    data->name_for_new_playlist_ =
+        PlaylistManager::GetNameForNewPlaylist(data->songs);
+
+    // The tree only has some of each song, so the rest is loaded when
+    // they're dropped.
+    data->song_loader = [backend, songs]() {
+      return backend->GetFullSongs(songs);
+    };
+    return data;
   }
 
-  data->setUrls(urls);
-  data->name_for_new_playlist_ =
-      PlaylistManager::GetNameForNewPlaylist(data->songs);
+  // Finding the songs under a container means populating everything below
+  // it, which can take seconds for a big artist.  Look them up only when
+  // they're dropped instead, and on a worker thread.
+  data->song_loader = [backend, queries, songs]() {
+    SongList ret = backend->GetFullSongs(songs);
+    QSet<int> song_ids;
+    for (const Song& song : songs) song_ids << song.id();
+
+    Database::ReadLocker l(backend->db(), backend->database_name());
+    for (LibraryQuery q : queries) {
+      if (!backend->ExecReadOnlyQuery(&q)) continue;
+
+      while (q.Next()) {
+        Song song;
+        song.InitFromQuery(q, true);
+        if (song_ids.contains(song.id())) continue;
+
+        song_ids << song.id();
+        ret << song;
+      }
+    }
+    return ret;
+  };
+
+  // Name the playlist after the artist and album the container is in
+  if (indexes.count() == 1) {
+    QString artist;
+    QString album;
+    for (LibraryItem* p = IndexToItem(indexes.first());
+         p && p->type == LibraryItem::Type_Container; p = p->parent) {
+      switch (group_by_[p->container_level]) {
+        case GroupBy_Artist:
+        case GroupBy_AlbumArtist:
+          artist = IsCompilationArtistNode(p) ? tr("Various artists")
+                                              : TextOrUnknown(p->key);
+          break;
+        case GroupBy_Album:
+          album = TextOrUnknown(p->key);
+          break;
+        case GroupBy_YearAlbum:
+        case GroupBy_OriginalYearAlbum:
+          album = TextOrUnknown(p->metadata.album());
+          break;
+        default:
+          break;
+      }
+    }
+
+    if (!artist.isEmpty() && !album.isEmpty()) {
+      data->name_for_new_playlist_ = artist + " - " + album;
+    } else {
+      data->name_for_new_playlist_ = artist.isEmpty() ? album : artist;
+    }
+  }
 
   return data;
 }
 
+LibraryQuery LibraryModel::ChildSongsQuery(LibraryItem* item) {
+  LibraryQuery q(query_options_);
+  InitQuery(GroupBy_None, &q);
+  // These songs go into playlists, so they need every column.
+  q.SetColumnSpec("%songs_table.ROWID, " + Song::kColumnSpec);
+
+  for (LibraryItem* p = item; p && p->type == LibraryItem::Type_Container;
+       p = p->parent) {
+    FilterQuery(group_by_[p->container_level], p, &q);
+  }
+
+  // Sort the songs by each level of containers below item, then the way
+  // songs are sorted within a container.
+  QStringList order_by;
+  for (int level = item->container_level + 1;
+       level < 3 && group_by_[level] != GroupBy_None; ++level) {
+    const GroupBy type = group_by_[level];
+    // The Various artists node comes first
+    if (show_various_artists_ && IsArtistGroupBy(type)) {
+      order_by << "effective_compilation DESC";
+    }
+    order_by << SortColumns(type);
+  }
+  order_by << "disc"
+           << "track"
+           << "filename";
+  q.SetOrderBy(order_by.join(", "));
+
+  return q;
+}
+
 bool LibraryModel::CompareItems(const LibraryItem* a,
                                 const LibraryItem* b) const {
   QVariant left(data(a, LibraryModel::Role_SortText));
@@ -1297,26 +2020,35 @@ SongList LibraryModel::GetChildSongs(const QModelIndexList& indexes) const {
   for (const QModelIndex& index : indexes) {
     GetChildSongs(IndexToItem(index), &dontcare, &ret, &song_ids);
   }
-  return ret;
+  return backend_->GetFullSongs(ret);
 }
 
 SongList LibraryModel::GetChildSongs(const QModelIndex& index) const {
   return GetChildSongs(QModelIndexList() << index);
 }
 
+SongList LibraryModel::GetChildTreeSongs(const QModelIndex& index) const {
+  QList<QUrl> dontcare;
+  SongList ret;
+  QSet<int> song_ids;
+
+  GetChildSongs(IndexToItem(index), &dontcare, &ret, &song_ids);
+  return ret;
+}
+
 void LibraryModel::SetFilterAge(int age) {
   query_options_.set_max_age(age);
-  ResetAsync();
+  UpdateAsync();
 }
 
 void LibraryModel::SetFilterText(const QString& text) {
   query_options_.set_filter(text);
-  ResetAsync();
+  UpdateAsync();
 }
 
 void LibraryModel::SetFilterQueryMode(QueryOptions::QueryMode query_mode) {
   query_options_.set_query_mode(query_mode);
-  ResetAsync();
+  UpdateAsync();
 }
 
 bool LibraryModel::canFetchMore(const QModelIndex& parent) const {
@@ -1327,9 +2059,19 @@ bool LibraryModel::canFetchMore(const QModelIndex& parent) const {
 }
 
 void LibraryModel::SetGroupBy(const Grouping& g) {
+  // Levels above the first one that changed can be kept as they are.
+  int first_changed_level = 0;
+  while (first_changed_level < 3 &&
+         g[first_changed_level] == group_by_[first_changed_level])
+    first_changed_level++;
+
   group_by_ = g;
 
-  ResetAsync();
+  // The first time there's a grouping the top level can be shown straight
+  // away from the snapshot, and then updated like any other change.
+  if (PaintSnapshot()) first_changed_level = 3;
+
+  UpdateAsync(first_changed_level);
   emit GroupingChanged(g);
 }
 
@@ -1505,6 +2247,9 @@ GeneratorPtr LibraryModel::CreateGenerator(const QModelIndex& index) const {
 }
 
 void LibraryModel::TotalSongCountUpdatedSlot(int count) {
+  // The real count is better than the one in the snapshot.
+  if (saved_snapshot_) saved_snapshot_->total_song_count = -1;
+
   total_song_count_ = count;
   emit TotalSongCountUpdated(count);
 }
@@ -18,10 +18,13 @@
 #ifndef LIBRARYMODEL_H
 #define LIBRARYMODEL_H
 
+#include <memory>
+
 #include <QAbstractItemModel>
+#include <QHash>
 #include <QIcon>
-#include <QNetworkDiskCache>
 
+#include "librarygroupingindex.h"
 #include "libraryitem.h"
 #include "libraryquery.h"
 #include "librarywatcher.h"
@@ -58,7 +61,7 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   static const char* kSavedGroupingsSettingsGroup;
   static const int kSmartPlaylistsVersion;
   static const int kPrettyCoverSize;
-  static const qint64 kIconCacheSize;
+  static const int kSnapshotVersion;
 
   enum Role {
     Role_Type = Qt::UserRole + 1,
@@ -110,10 +113,15 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   };
 
   struct QueryResult {
-    QueryResult() : create_va(false) {}
+    QueryResult() : create_va(false), cancelled(false) {}
 
     SqlRowList rows;
     bool create_va;
+    // The query was stopped part way through, so the rows are incomplete.
+    bool cancelled;
+
+    // Set if the query that populated the top level also built a new index.
+    std::shared_ptr<LibraryGroupingIndex> grouping_index;
   };
 
   LibraryBackend* backend() const { return backend_; }
@@ -133,15 +141,36 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
     show_various_artists_ = show_various_artists;
   }
 
+  // When this is set fetchMore populates nodes in a background thread and
+  // shows a loading item until it's finished.  Everything else that needs a
+  // node's children still gets them straight away.
+  void set_async_populate(bool async_populate) {
+    async_populate_ = async_populate;
+  }
+  bool async_populate() const { return async_populate_; }
+
+  // Where the top level of the tree is saved when the model is destroyed.
+  // The top level saved last time is shown as soon as the model is
+  // initialised or given its grouping, before any queries have run, and
+  // the queries then patch it up.  Call before Init() or SetGroupBy().
+  void set_snapshot_filename(const QString& filename);
+
   // Get information about the library
   void GetChildSongs(LibraryItem* item, QList<QUrl>* urls, SongList* songs,
                      QSet<int>* song_ids) const;
+  // These load the whole of each song from the database.
   SongList GetChildSongs(const QModelIndex& index) const;
   SongList GetChildSongs(const QModelIndexList& indexes) const;
+  // The songs as the tree has them, with only the Song::Projection_TreeNode
+  // fields.  Doesn't touch the database for songs that are loaded already.
+  SongList GetChildTreeSongs(const QModelIndex& index) const;
 
   // Might be accurate
   int total_song_count() const { return total_song_count_; }
 
+  // Roughly how many bytes the loaded items take, not counting their strings.
+  qint64 memory_usage() const;
+
   // Smart playlists
   smart_playlists::GeneratorPtr CreateGenerator(const QModelIndex& index) const;
   void AddGenerator(smart_playlists::GeneratorPtr gen);
@@ -155,6 +184,11 @@ class LibraryModel : public SimpleTreeModel<LibraryItem> {
   QStringList mimeTypes() const;
   QMimeData* mimeData(const QModelIndexList& indexes) const;
   bool canFetchMore(const QModelIndex& parent) const;
+  void fetchMore(const QModelIndex& parent);
+
+  // Starts populating a node in the background without showing a loading
+  // item, so its children are ready by the time it gets expanded.
+  void PrefetchAsync(const QModelIndex& index);
 
   // Whether or not to use album cover art, if it exists, in the library view
   void set_pretty_covers(bool use_pretty_covers);
@@ -192,6 +226,7 @@ signals:
  protected:
   void LazyPopulate(LibraryItem* item) { LazyPopulate(item, true); }
   void LazyPopulate(LibraryItem* item, bool signal);
+  void LazyPopulateAsync(LibraryItem* item, bool show_loading);
 
  private slots:
   // From LibraryBackend
@@ -203,19 +238,90 @@ signals:
   // Called after ResetAsync
   void ResetAsyncQueryFinished(QFuture<LibraryModel::QueryResult> future);
 
+  // Re-runs the queries behind every node that's already been populated and
+  // patches the tree with the differences, so the view keeps its expansion
+  // state.  Children below first_changed_level are replaced wholesale.
+  void UpdateAsync(int first_changed_level = 3);
+
   void AlbumArtLoaded(quint64 id, const QImage& image);
 
  private:
   // Provides some optimisations for loading the list of items in the root.
   // This gets called a lot when filtering the playlist, so it's nice to be
   // able to do it in a background thread.
-  QueryResult RunQuery(LibraryItem* parent);
+  QueryResult RunQuery(LibraryItem* parent,
+                       const QueryCancelFlag& cancel = QueryCancelFlag());
   void PostQuery(LibraryItem* parent, const QueryResult& result, bool signal);
 
+  // RunQuery split in two, so the query can be built from the tree on the GUI
+  // thread and executed somewhere else.  Containers are looked up in the
+  // index if there is one, the query is only run for songs or if the index
+  // doesn't know about the parent.
+  GroupBy PrepareQuery(LibraryItem* parent, LibraryQuery* q,
+                       LibraryGroupingIndex::Path* path);
+  QueryResult RunPreparedQuery(LibraryQuery q, GroupBy child_type,
+                               std::shared_ptr<LibraryGroupingIndex> index,
+                               LibraryGroupingIndex::Path path);
+
+  // Reads the containers of every level of the grouping with one query.
+  // Can be called from any thread.
+  std::shared_ptr<LibraryGroupingIndex> BuildGroupingIndex(
+      const QueryOptions& options, const Grouping& grouping,
+      const QueryCancelFlag& cancel = QueryCancelFlag()) const;
+
+  // Stops whatever was given the flag, and clears it.
+  static void CancelQueries(QueryCancelFlag* flag);
+
+  // Used by UpdateAsync
+  struct UpdateQuery {
+    LibraryItem* parent;
+    GroupBy child_type;
+    LibraryQuery query;
+    LibraryGroupingIndex::Path path;
+  };
+  // The index is rebuilt first, and returned with the first result.
+  QList<QueryResult> RunUpdateQueries(QList<UpdateQuery> queries,
+                                      QueryOptions options, Grouping grouping,
+                                      QueryCancelFlag cancel);
+  void UpdateAsyncQueryFinished(int update_id, int tree_generation,
+                                int first_changed_level,
+                                const QList<UpdateQuery>& queries,
+                                const QList<QueryResult>& results);
+  void UpdateChildren(LibraryItem* parent, const QueryResult& result,
+                      bool replace, QSet<LibraryItem*>* removed,
+                      QSet<QString>* divider_keys);
+  void RemoveChild(LibraryItem* item, QSet<LibraryItem*>* removed);
+  void ForgetItem(LibraryItem* item, QSet<LibraryItem*>* removed);
+
+  // Used by LazyPopulateAsync
+  void LazyPopulateAsyncFinished(LibraryItem* parent, int populate_id,
+                                 int update_id, const QueryResult& result);
+  bool RemoveLoadingIndicator(LibraryItem* parent);
+  void DeleteEmptyDividers(const QSet<QString>& divider_keys);
+
   bool HasCompilations(const LibraryQuery& query);
 
   void BeginReset();
 
+  // The top level of the tree for one grouping, see set_snapshot_filename.
+  struct Snapshot {
+    Snapshot() : show_various_artists(true), total_song_count(-1) {}
+
+    Grouping grouping;
+    bool show_various_artists;
+    int total_song_count;
+    QueryResult top_level;
+  };
+
+  bool IsUnfiltered() const;
+  // Called with every result that makes up the whole top level.
+  void RememberTopLevel(const QueryResult& result);
+  // Fills in the top level from the saved snapshot if it's for the current
+  // grouping.  Only works once, and not after anything else has filled in
+  // the top level.
+  bool PaintSnapshot();
+  void SaveSnapshot() const;
+
   // Functions for working with queries and creating items.
   // When the model is reset or when a node is lazy-loaded the Library
   // constructs a database query to populate the items.  Filters are added
@@ -224,6 +330,18 @@ signals:
   static void InitQuery(GroupBy type, LibraryQuery* q);
   void FilterQuery(GroupBy type, LibraryItem* item, LibraryQuery* q);
 
+  // The columns InitQuery asks for to get containers of this type.
+  static QStringList GroupByColumns(GroupBy type);
+  // The columns that put containers of this type in the order they're shown.
+  static QStringList SortColumns(GroupBy type);
+  // Finds every song under item, in the order they appear in the tree,
+  // without populating anything.  The query can be run on any thread.
+  LibraryQuery ChildSongsQuery(LibraryItem* item);
+  // Identifies a container in the grouping index.  Containers that
+  // FilterQuery would filter on the same values get the same key.
+  static QString GroupingKey(GroupBy type, const SqlRow& row);
+  static QString GroupingKey(GroupBy type, const LibraryItem* item);
+
   // Items can be created either from a query that's been run to populate a
   // node, or by a spontaneous SongsDiscovered emission from the backend.
   LibraryItem* ItemFromQuery(GroupBy type, bool signal, bool create_divider,
@@ -248,6 +366,7 @@ signals:
   void FinishItem(GroupBy type, bool signal, bool create_divider,
                   LibraryItem* parent, LibraryItem* item);
 
+  QString CachedSortTextForArtist(const QString& artist);
   QString DividerKey(GroupBy type, LibraryItem* item) const;
   QString DividerDisplayText(GroupBy type, const QString& key) const;
 
@@ -270,14 +389,25 @@ signals:
   QueryOptions query_options_;
   Grouping group_by_;
 
+  // Built for the current options and grouping when the tree is reset or
+  // updated, and dropped when songs change because it doesn't follow them.
+  std::shared_ptr<LibraryGroupingIndex> grouping_index_;
+  // Set when songs change after an index started being built.
+  bool grouping_index_stale_;
+
   // Keyed on database ID
-  QMap<int, LibraryItem*> song_nodes_;
+  QHash<int, LibraryItem*> song_nodes_;
 
   // Keyed on whatever the key is for that level - artist, album, year, etc.
-  QMap<QString, LibraryItem*> container_nodes_[3];
+  QHash<QString, LibraryItem*> container_nodes_[3];
 
   // Keyed on a letter, a year, a century, etc.
-  QMap<QString, LibraryItem*> divider_nodes_;
+  QHash<QString, LibraryItem*> divider_nodes_;
+
+  // SortTextForArtist results keyed on the text they were made from.  Most
+  // keys are repeated across lots of items, so this saves running the same
+  // strings through it again.  Cleared on reset.
+  QHash<QString, QString> sort_text_cache_;
 
   // Only applies if smart playlists are set to on
   LibraryItem* smart_playlist_node_;
@@ -290,13 +420,35 @@ signals:
   QIcon playlists_dir_icon_;
   QIcon playlist_icon_;
 
-  QNetworkDiskCache* icon_cache_;
 
   int init_task_id_;
 
+  // Bumped whenever items are deleted from the tree behind UpdateAsync's
+  // back, which means the items it queried for might not exist any more.
+  int tree_generation_;
+  // Bumped by every UpdateAsync and ResetAsync, only the latest one counts.
+  int update_id_;
+  // Set when the reset or update that's running is superseded, so its
+  // queries stop instead of running to the end for nothing.
+  QueryCancelFlag reset_cancel_;
+  QueryCancelFlag update_cancel_;
+
+  bool async_populate_;
+  // Items that are being populated in the background, mapped to the ID of
+  // the populate that's running for them.  Items are taken out of here when
+  // they're deleted, so a result for an item that isn't in here is ignored.
+  QHash<LibraryItem*, int> populating_;
+  int next_populate_id_;
+
   bool use_pretty_covers_;
   bool show_dividers_;
 
+  QString snapshot_filename_;
+  // Read from the snapshot file, and dropped once the top level is filled in.
+  std::unique_ptr<Snapshot> saved_snapshot_;
+  // The last top level that was read without a filter, to be saved.
+  std::unique_ptr<Snapshot> top_level_snapshot_;
+
   AlbumCoverLoaderOptions cover_loader_options_;
 
   typedef QPair<LibraryItem*, QString> ItemAndCacheKey;
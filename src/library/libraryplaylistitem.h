@@ -35,6 +35,7 @@ class LibraryPlaylistItem : public PlaylistItem {
   QUrl Url() const;
 
   bool IsLocalLibraryItem() const { return true; }
+  bool IsSongsTableItem() const { return true; }
 
  protected:
   QVariant DatabaseValue(DatabaseColumn column) const;
@@ -16,6 +16,7 @@
 */
 
 #include "libraryquery.h"
+#include "sqlitequery.h"
 #include "core/song.h"
 
 #include <QtDebug>
@@ -24,8 +25,25 @@
 
 QueryOptions::QueryOptions() : max_age_(-1), query_mode_(QueryMode_All) {}
 
+// FTS5 is a lot stricter about its query syntax than FTS3, so every word gets
+// quoted.  Like in FTS3 the column filter only applies to the first word and
+// only the last word is a prefix.
+static QString Fts5Term(const QString& column, const QString& text) {
+  QStringList words;
+  for (QString word : text.split(' ', QString::SkipEmptyParts)) {
+    words << "\"" + word.replace('"', "\"\"") + "\"";
+  }
+  if (words.isEmpty()) return QString();
+
+  words.last() += "*";
+  return column.toLower() + words.join(" ");
+}
+
 LibraryQuery::LibraryQuery(const QueryOptions& options)
-    : include_unavailable_(false), join_with_fts_(false), limit_(-1) {
+    : include_unavailable_(false),
+      join_with_fts_(false),
+      order_by_relevance_(false),
+      limit_(-1) {
   if (!options.filter().isEmpty()) {
     // We need to munge the filter text a little bit to get it to work as
     // expected with sqlite's FTS3:
@@ -37,33 +55,34 @@ LibraryQuery::LibraryQuery(const QueryOptions& options)
     QStringList tokens(
         options.filter().split(QRegExp("\\s+"), QString::SkipEmptyParts));
     QString query;
+    QStringList fts5_query;
     for (QString token : tokens) {
       token.remove('(');
       token.remove(')');
       token.remove('"');
       token.replace('-', ' ');
 
+      QString column;
       if (token.contains(':')) {
         // Only prefix fts if the token is a valid column name.
         if (Song::kFtsColumns.contains("fts" + token.section(':', 0, 0),
                                        Qt::CaseInsensitive)) {
           // Account for multiple colons.
-          QString columntoken =
-              token.section(':', 0, 0, QString::SectionIncludeTrailingSep);
-          QString subtoken = token.section(':', 1, -1);
-          subtoken.replace(":", " ");
-          subtoken = subtoken.trimmed();
-          query += "fts" + columntoken + subtoken + "* ";
-        } else {
-          token.replace(":", " ");
-          token = token.trimmed();
-          query += token + "* ";
+          column = "fts" + token.section(':', 0, 0,
+                                         QString::SectionIncludeTrailingSep);
+          token = token.section(':', 1, -1);
         }
-      } else {
-        query += token + "* ";
+        token.replace(":", " ");
+        token = token.trimmed();
       }
+
+      query += column + token + "* ";
+      const QString fts5_term = Fts5Term(column, token);
+      if (!fts5_term.isEmpty()) fts5_query << fts5_term;
     }
+    fts5_match_ = fts5_query.join(" ");
 
+    // This has to stay the first bound value, see Exec()
     where_clauses_ << "fts.%fts_table_noprefix MATCH ?";
     bound_values_ << query;
     join_with_fts_ = true;
@@ -138,8 +157,8 @@ void LibraryQuery::AddCompilationRequirement(bool compilation) {
                         .arg(compilation ? 1 : 0);
 }
 
-QSqlQuery LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
-                             const QString& fts_table) {
+bool LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
+                        const QString& fts_table, bool fts5) {
   QString sql;
 
   if (join_with_fts_) {
@@ -158,7 +177,15 @@ QSqlQuery LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
 
   if (!where_clauses.isEmpty()) sql += " WHERE " + where_clauses.join(" AND ");
 
-  if (!order_by_.isEmpty()) sql += " ORDER BY " + order_by_;
+  QStringList order_by;
+  if (order_by_relevance_ && join_with_fts_ && fts5) {
+    // bm25 scores better matches lower.  The weights are in the order of
+    // Song::kFtsColumns: title, album, artist, albumartist, composer,
+    // performer, grouping, genre, comment, year.
+    order_by << "bm25(fts, 10.0, 5.0, 8.0, 6.0, 2.0, 2.0, 1.0, 1.0, 0.5, 1.0)";
+  }
+  if (!order_by_.isEmpty()) order_by << order_by_;
+  if (!order_by.isEmpty()) sql += " ORDER BY " + order_by.join(", ");
 
   if (limit_ != -1) sql += " LIMIT " + QString::number(limit_);
 
@@ -166,20 +193,26 @@ QSqlQuery LibraryQuery::Exec(QSqlDatabase db, const QString& songs_table,
   sql.replace("%fts_table_noprefix", fts_table.section('.', -1, -1));
   sql.replace("%fts_table", fts_table);
 
-  query_ = QSqlQuery(sql, db);
+  query_.reset(new SqliteQuery(db, sql));
+  query_->set_cancel_flag(cancel_flag_);
 
   // Bind values
-  for (const QVariant& value : bound_values_) {
-    query_.addBindValue(value);
+  for (int i = 0; i < bound_values_.count(); ++i) {
+    if (i == 0 && join_with_fts_ && fts5) {
+      query_->AddBindValue(fts5_match_);
+    } else {
+      query_->AddBindValue(bound_values_[i]);
+    }
   }
 
-  query_.exec();
-  return query_;
+  return query_->Exec();
 }
 
-bool LibraryQuery::Next() { return query_.next(); }
+bool LibraryQuery::Next() { return query_ && query_->Next(); }
 
-QVariant LibraryQuery::Value(int column) const { return query_.value(column); }
+QVariant LibraryQuery::Value(int column) const {
+  return query_->Value(column);
+}
 
 bool QueryOptions::Matches(const Song& song) const {
   if (max_age_ != -1) {
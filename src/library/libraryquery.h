@@ -18,12 +18,16 @@
 #ifndef LIBRARYQUERY_H
 #define LIBRARYQUERY_H
 
+#include <memory>
+
 #include <QString>
 #include <QVariant>
-#include <QSqlQuery>
+#include <QSqlDatabase>
 #include <QStringList>
 #include <QVariantList>
 
+#include "sqlitequery.h"
+
 class Song;
 class LibraryBackend;
 
@@ -85,27 +89,46 @@ class LibraryQuery {
   void SetIncludeUnavailable(bool include_unavailable) {
     include_unavailable_ = include_unavailable;
   }
+  // Puts the songs that match the filter best first.  Only has an effect if
+  // there's a filter and the FTS table uses FTS5.
+  void SetOrderByRelevance(bool order_by_relevance) {
+    order_by_relevance_ = order_by_relevance;
+  }
+
+  // Setting the flag from another thread stops the query once it's running.
+  // Next() then returns false as if there were no more rows.
+  void SetCancelFlag(const QueryCancelFlag& flag) { cancel_flag_ = flag; }
 
-  QSqlQuery Exec(QSqlDatabase db, const QString& songs_table,
-                 const QString& fts_table);
+  // fts5 says whether fts_table is an FTS5 table, which needs a differently
+  // formatted MATCH expression.  Returns false and logs the error if the
+  // query couldn't be run.
+  bool Exec(QSqlDatabase db, const QString& songs_table,
+            const QString& fts_table, bool fts5 = false);
   bool Next();
   QVariant Value(int column) const;
 
-  operator const QSqlQuery&() const { return query_; }
+  // Only valid after Exec.
+  const SqliteQuery& query() const { return *query_; }
 
  private:
   QString GetInnerQuery();
 
   bool include_unavailable_;
   bool join_with_fts_;
+  bool order_by_relevance_;
+  // The filter as an FTS5 MATCH expression.  The FTS3 one is the first bound
+  // value.
+  QString fts5_match_;
   QString column_spec_;
   QString order_by_;
   QStringList where_clauses_;
   QVariantList bound_values_;
   int limit_;
   bool duplicates_only_;
+  QueryCancelFlag cancel_flag_;
 
-  QSqlQuery query_;
+  // Shared so the query can be copied before it's run.
+  std::shared_ptr<SqliteQuery> query_;
 };
 
 #endif  // LIBRARYQUERY_H
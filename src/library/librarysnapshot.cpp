@@ -0,0 +1,127 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "librarysnapshot.h"
+#include "core/song.h"
+
+int LibrarySnapshot::ArtistId(const QString& artist) const {
+  return artist_index_.value(artist, -1);
+}
+
+int LibrarySnapshot::AlbumId(const QString& album) const {
+  return album_index_.value(album, -1);
+}
+
+QVector<int> LibrarySnapshot::SongIdsByArtist(int artist_id) const {
+  return SongIdsWhere(ids_, artist_ids_, artist_id);
+}
+
+QVector<int> LibrarySnapshot::SongIdsByAlbum(int album_id) const {
+  return SongIdsWhere(ids_, album_ids_, album_id);
+}
+
+QVector<int> LibrarySnapshot::SongIdsWhere(const QVector<int>& ids,
+                                           const QVector<int>& column,
+                                           int value) {
+  QVector<int> ret;
+  if (value == -1) return ret;
+
+  // A plain loop over raw pointers, so the compiler can vectorize the
+  // comparisons.
+  const int* values = column.constData();
+  const int count = column.count();
+  for (int i = 0; i < count; ++i) {
+    if (values[i] == value) ret << ids[i];
+  }
+  return ret;
+}
+
+QHash<int, int> LibrarySnapshot::SongCountByYear() const {
+  QHash<int, int> ret;
+  const int* years = years_.constData();
+  const int count = years_.count();
+  for (int i = 0; i < count; ++i) {
+    ret[years[i]]++;
+  }
+  return ret;
+}
+
+int LibrarySnapshot::Intern(const QString& name, QVector<QString>* names,
+                            QHash<QString, int>* ids) {
+  QHash<QString, int>::const_iterator it = ids->constFind(name);
+  if (it != ids->constEnd()) return it.value();
+
+  const int id = names->count();
+  names->append(name);
+  ids->insert(name, id);
+  return id;
+}
+
+void LibrarySnapshot::Add(const Song& song) {
+  const int artist_id = Intern(song.artist(), &artists_, &artist_index_);
+  const int album_id = Intern(song.album(), &albums_, &album_index_);
+
+  int row = IndexOf(song.id());
+  if (row == -1) {
+    row = ids_.count();
+    index_.insert(song.id(), row);
+
+    ids_.append(song.id());
+    artist_ids_.append(artist_id);
+    album_ids_.append(album_id);
+    years_.append(song.year());
+    lengths_nanosec_.append(song.length_nanosec());
+    ratings_.append(song.rating());
+  } else {
+    artist_ids_[row] = artist_id;
+    album_ids_[row] = album_id;
+    years_[row] = song.year();
+    lengths_nanosec_[row] = song.length_nanosec();
+    ratings_[row] = song.rating();
+  }
+}
+
+void LibrarySnapshot::Remove(int song_id) {
+  const int row = IndexOf(song_id);
+  if (row == -1) return;
+
+  const int last = ids_.count() - 1;
+  if (row != last) {
+    ids_[row] = ids_[last];
+    artist_ids_[row] = artist_ids_[last];
+    album_ids_[row] = album_ids_[last];
+    years_[row] = years_[last];
+    lengths_nanosec_[row] = lengths_nanosec_[last];
+    ratings_[row] = ratings_[last];
+    index_[ids_[row]] = row;
+  }
+
+  ids_.resize(last);
+  artist_ids_.resize(last);
+  album_ids_.resize(last);
+  years_.resize(last);
+  lengths_nanosec_.resize(last);
+  ratings_.resize(last);
+  index_.remove(song_id);
+}
+
+void LibrarySnapshot::SetRating(int song_id, float rating) {
+  const int row = IndexOf(song_id);
+  if (row != -1) ratings_[row] = rating;
+}
+
+void LibrarySnapshot::Clear() { *this = LibrarySnapshot(); }
@@ -0,0 +1,90 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARYSNAPSHOT_H
+#define LIBRARYSNAPSHOT_H
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+class Song;
+
+// A copy of a few fields of every available song in the library, stored one
+// array per field so scans over a field only touch that field's memory.
+// Artists and albums are stored as ids into a table of names.
+//
+// The rows aren't in any particular order.  Copies are cheap: the arrays are
+// implicitly shared, so a copy only costs anything once one of the two is
+// changed.
+class LibrarySnapshot {
+ public:
+  LibrarySnapshot() {}
+
+  int count() const { return ids_.count(); }
+
+  const QVector<int>& ids() const { return ids_; }
+  const QVector<int>& artist_ids() const { return artist_ids_; }
+  const QVector<int>& album_ids() const { return album_ids_; }
+  const QVector<int>& years() const { return years_; }
+  const QVector<qint64>& lengths_nanosec() const { return lengths_nanosec_; }
+  const QVector<float>& ratings() const { return ratings_; }
+
+  // Returns -1 if no song has ever had this artist or album.
+  int ArtistId(const QString& artist) const;
+  int AlbumId(const QString& album) const;
+  QString Artist(int artist_id) const { return artists_.value(artist_id); }
+  QString Album(int album_id) const { return albums_.value(album_id); }
+
+  // Returns the row of the song, or -1 if it isn't in the snapshot.
+  int IndexOf(int song_id) const { return index_.value(song_id, -1); }
+
+  QVector<int> SongIdsByArtist(int artist_id) const;
+  QVector<int> SongIdsByAlbum(int album_id) const;
+  QHash<int, int> SongCountByYear() const;
+
+  // Add replaces the song's row if it's already there.  Remove moves the
+  // last row into the removed one.
+  void Add(const Song& song);
+  void Remove(int song_id);
+  void SetRating(int song_id, float rating);
+  void Clear();
+
+ private:
+  static QVector<int> SongIdsWhere(const QVector<int>& ids,
+                                   const QVector<int>& column, int value);
+  static int Intern(const QString& name, QVector<QString>* names,
+                    QHash<QString, int>* ids);
+
+  QVector<int> ids_;
+  QVector<int> artist_ids_;
+  QVector<int> album_ids_;
+  QVector<int> years_;
+  QVector<qint64> lengths_nanosec_;
+  QVector<float> ratings_;
+
+  // Song id to row.
+  QHash<int, int> index_;
+
+  // Names are never removed, so ids stay valid.
+  QVector<QString> artists_;
+  QHash<QString, int> artist_index_;
+  QVector<QString> albums_;
+  QHash<QString, int> album_index_;
+};
+
+#endif  // LIBRARYSNAPSHOT_H
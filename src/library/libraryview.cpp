@@ -18,6 +18,7 @@
 #include "libraryview.h"
 
 #include <QPainter>
+#include <QScrollBar>
 #include <QContextMenuEvent>
 #include <QHelpEvent>
 #include <QMenu>
@@ -25,6 +26,7 @@
 #include <QSet>
 #include <QSettings>
 #include <QSortFilterProxyModel>
+#include <QTimer>
 #include <QToolTip>
 #include <QWhatsThis>
 
@@ -41,14 +43,18 @@
 #include "core/utilities.h"
 #include "devices/devicemanager.h"
 #include "devices/devicestatefiltermodel.h"
+#include "musicbrainz/tagfetcher.h"
 #include "smartplaylists/wizard.h"
 #include "ui/iconloader.h"
 #include "ui/organisedialog.h"
 #include "ui/organiseerrordialog.h"
+#include "ui/trackselectiondialog.h"
 
 using smart_playlists::Wizard;
 
 const char* LibraryView::kSettingsGroup = "LibraryView";
+const int LibraryView::kPrefetchDelayMsec = 250;
+const int LibraryView::kMaxPrefetch = 20;
 
 LibraryItemDelegate::LibraryItemDelegate(QObject* parent)
     : QStyledItemDelegate(parent) {}
@@ -174,7 +180,8 @@ LibraryView::LibraryView(QWidget* parent)
       filter_(nullptr),
       total_song_count_(-1),
       context_menu_(nullptr),
-      is_in_keyboard_search_(false) {
+      is_in_keyboard_search_(false),
+      prefetch_timer_(new QTimer(this)) {
   QIcon nocover = IconLoader::Load("nocover", IconLoader::Other);
   nomusic_ = nocover.pixmap(nocover.availableSizes().last());
   setItemDelegate(new LibraryItemDelegate(this));
@@ -186,6 +193,15 @@ LibraryView::LibraryView(QWidget* parent)
   setSelectionMode(QAbstractItemView::ExtendedSelection);
 
   setStyleSheet("QTreeView::item{padding-top:1px;}");
+
+  // Wait until scrolling stops before deciding what to prefetch
+  prefetch_timer_->setSingleShot(true);
+  prefetch_timer_->setInterval(kPrefetchDelayMsec);
+  connect(prefetch_timer_, SIGNAL(timeout()), SLOT(PrefetchVisible()));
+  connect(verticalScrollBar(), SIGNAL(valueChanged(int)), prefetch_timer_,
+          SLOT(start()));
+  connect(this, SIGNAL(expanded(QModelIndex)), prefetch_timer_,
+          SLOT(start()));
 }
 
 LibraryView::~LibraryView() {}
@@ -209,7 +225,7 @@ void LibraryView::SaveFocus() {
     case LibraryItem::Type_Song: {
       QModelIndex index =
           qobject_cast<QSortFilterProxyModel*>(model())->mapToSource(current);
-      SongList songs = app_->library_model()->GetChildSongs(index);
+      SongList songs = app_->library_model()->GetChildTreeSongs(index);
       if (!songs.isEmpty()) {
         last_selected_song_ = songs.last();
         last_selected_text_ = songs.last().title();
@@ -252,7 +268,12 @@ void LibraryView::RestoreFocus() {
       last_selected_song_.url().isEmpty()) {
     return;
   }
+
+  // This needs to look at the children of each node straight away.
+  const bool async_populate = app_->library_model()->async_populate();
+  app_->library_model()->set_async_populate(false);
   RestoreLevelFocus();
+  app_->library_model()->set_async_populate(async_populate);
 }
 
 bool LibraryView::RestoreLevelFocus(const QModelIndex& parent) {
@@ -268,7 +289,7 @@ bool LibraryView::RestoreLevelFocus(const QModelIndex& parent) {
         if (!last_selected_song_.url().isEmpty()) {
           QModelIndex index = qobject_cast<QSortFilterProxyModel*>(model())
                                   ->mapToSource(current);
-          SongList songs = app_->library_model()->GetChildSongs(index);
+          SongList songs = app_->library_model()->GetChildTreeSongs(index);
           for (const Song& song : songs) {
             if (song == last_selected_song_) {
               setCurrentIndex(current);
@@ -320,9 +341,42 @@ void LibraryView::ReloadSettings() {
 
 void LibraryView::SetApplication(Application* app) {
   app_ = app;
+  app_->library_model()->set_async_populate(true);
   ReloadSettings();
 }
 
+void LibraryView::reset() {
+  if (!app_) {
+    AutoExpandingTreeView::reset();
+    return;
+  }
+
+  // Expanding nodes after a reset depends on knowing how many children they
+  // have, so they can't be populated in the background.
+  const bool async_populate = app_->library_model()->async_populate();
+  app_->library_model()->set_async_populate(false);
+  AutoExpandingTreeView::reset();
+  app_->library_model()->set_async_populate(async_populate);
+
+  prefetch_timer_->start();
+}
+
+void LibraryView::PrefetchVisible() {
+  QSortFilterProxyModel* proxy =
+      qobject_cast<QSortFilterProxyModel*>(model());
+  if (!app_ || !proxy) return;
+
+  int count = 0;
+  for (QModelIndex index = indexAt(QPoint(0, 0));
+       index.isValid() && count < kMaxPrefetch; index = indexBelow(index)) {
+    if (visualRect(index).top() > viewport()->height()) break;
+    if (isExpanded(index) || !proxy->canFetchMore(index)) continue;
+
+    app_->library_model()->PrefetchAsync(proxy->mapToSource(index));
+    count++;
+  }
+}
+
 void LibraryView::SetFilter(LibraryFilterWidget* filter) { filter_ = filter; }
 
 void LibraryView::TotalSongCountUpdated(int count) {
@@ -428,6 +482,9 @@ void LibraryView::contextMenuEvent(QContextMenuEvent* e) {
     edit_tracks_ = context_menu_->addAction(
         IconLoader::Load("edit-rename", IconLoader::Base),
         tr("Edit tracks information..."), this, SLOT(EditTracks()));
+    auto_complete_tags_ = context_menu_->addAction(
+        IconLoader::Load("musicbrainz", IconLoader::Provider),
+        tr("Complete tags automatically..."), this, SLOT(AutoCompleteTags()));
     show_in_browser_ = context_menu_->addAction(
         IconLoader::Load("document-open-folder", IconLoader::Base),
         tr("Show in file browser..."), this, SLOT(ShowInBrowser()));
@@ -521,6 +578,8 @@ void LibraryView::contextMenuEvent(QContextMenuEvent* e) {
   // edit_track element
   edit_track_->setVisible(!smart_playlists_only && (regular_editable <= 1));
   edit_track_->setEnabled(regular_editable == 1);
+  auto_complete_tags_->setVisible(!smart_playlists_only);
+  auto_complete_tags_->setEnabled(regular_editable > 0);
 
   // only when no smart playlists selected
   organise_->setVisible(regular_elements_only);
@@ -706,6 +765,37 @@ void LibraryView::EditTracks() {
   edit_tag_dialog_->show();
 }
 
+void LibraryView::AutoCompleteTags() {
+  // Any number of songs can be selected here, up to the whole library.
+  // Fingerprints are cached in the database, so songs that were looked up
+  // before don't have to be decoded again.
+  if (!tag_fetcher_) {
+    tag_fetcher_.reset(new TagFetcher(app_->database()));
+    track_selection_dialog_.reset(new TrackSelectionDialog);
+    track_selection_dialog_->set_save_on_close(true);
+
+    connect(tag_fetcher_.get(), SIGNAL(ResultAvailable(Song, SongList)),
+            track_selection_dialog_.get(),
+            SLOT(FetchTagFinished(Song, SongList)), Qt::QueuedConnection);
+    connect(tag_fetcher_.get(), SIGNAL(Progress(Song, QString)),
+            track_selection_dialog_.get(),
+            SLOT(FetchTagProgress(Song, QString)));
+    connect(track_selection_dialog_.get(), SIGNAL(finished(int)),
+            tag_fetcher_.get(), SLOT(Cancel()));
+  }
+
+  SongList songs;
+  for (const Song& song : GetSelectedSongs()) {
+    if (song.IsEditable()) songs << song;
+  }
+  if (songs.isEmpty()) return;
+
+  track_selection_dialog_->Init(songs);
+  tag_fetcher_->StartFetch(songs);
+
+  track_selection_dialog_->show();
+}
+
 void LibraryView::CopyToDevice() {
   if (!organise_dialog_)
     // Don't notify song has been replaced if copying to device, so
@@ -29,8 +29,11 @@
 class Application;
 class LibraryFilterWidget;
 class OrganiseDialog;
+class TagFetcher;
+class TrackSelectionDialog;
 
 class QMimeData;
+class QTimer;
 
 namespace smart_playlists {
 class Wizard;
@@ -57,6 +60,8 @@ class LibraryView : public AutoExpandingTreeView {
   ~LibraryView();
 
   static const char* kSettingsGroup;
+  static const int kPrefetchDelayMsec;
+  static const int kMaxPrefetch;
 
   // Returns Songs currently selected in the library view. Please note that the
   // selection is recursive meaning that if for example an album is selected
@@ -88,7 +93,14 @@ signals:
   void mouseReleaseEvent(QMouseEvent* e);
   void contextMenuEvent(QContextMenuEvent* e);
 
+  // AutoExpandingTreeView
+  void reset();
+
  private slots:
+  // Populates the collapsed nodes that are visible in the view, in case
+  // they're expanded next.
+  void PrefetchVisible();
+
   void Load();
   void AddToPlaylist();
   void AddToPlaylistEnqueue();
@@ -98,6 +110,7 @@ signals:
   void CopyToDevice();
   void Delete();
   void EditTracks();
+  void AutoCompleteTags();
   void ShowInBrowser();
   void ShowInVarious();
   void NoShowInVarious();
@@ -139,6 +152,7 @@ signals:
   QAction* delete_;
   QAction* edit_track_;
   QAction* edit_tracks_;
+  QAction* auto_complete_tags_;
   QAction* show_in_browser_;
   QAction* show_in_various_;
   QAction* no_show_in_various_;
@@ -151,9 +165,13 @@ signals:
 
   std::unique_ptr<OrganiseDialog> organise_dialog_;
   std::unique_ptr<EditTagDialog> edit_tag_dialog_;
+  std::unique_ptr<TagFetcher> tag_fetcher_;
+  std::unique_ptr<TrackSelectionDialog> track_selection_dialog_;
 
   bool is_in_keyboard_search_;
 
+  QTimer* prefetch_timer_;
+
   // Save focus
   Song last_selected_song_;
   QString last_selected_container_;
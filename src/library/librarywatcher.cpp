@@ -18,15 +18,20 @@
 #include "librarywatcher.h"
 
 #include "librarybackend.h"
+#include "core/concurrentrun.h"
 #include "core/filesystemwatcherinterface.h"
 #include "core/logging.h"
 #include "core/tagreaderclient.h"
 #include "core/taskmanager.h"
+#include "core/tracing.h"
 #include "core/utilities.h"
 #include "playlistparsers/cueparser.h"
 
 #include <QDateTime>
 #include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QImageReader>
 #include <QtDebug>
 #include <QThread>
 #include <QDateTime>
@@ -46,11 +51,41 @@
 namespace {
 static const char *kNoMediaFile = ".nomedia";
 static const char *kNoMusicFile   = ".nomusic";
+
+// Reads just the image's header if the format allows it.  Images that can't
+// be read at all are 0x0, so they're never picked and aren't tried again.
+QSize ReadImageSize(const QString& path) {
+  QImageReader reader(path);
+  QSize size = reader.size();
+  if (!size.isValid()) size = reader.read().size();
+  return size.isValid() ? size : QSize(0, 0);
+}
+
+// Copies the sizes of the images that haven't changed since they were last
+// looked at.
+void CopyKnownArtSizes(const ArtCandidateList& known,
+                       ArtCandidateList* candidates) {
+  if (known.isEmpty()) return;
+
+  QHash<QString, const ArtCandidate*> known_by_path;
+  for (const ArtCandidate& candidate : known) {
+    known_by_path[candidate.path] = &candidate;
+  }
+
+  for (ArtCandidate& candidate : *candidates) {
+    const ArtCandidate* old = known_by_path.value(candidate.path);
+    if (old && old->mtime == candidate.mtime) candidate.size = old->size;
+  }
+}
 }
 
 QStringList LibraryWatcher::sValidImages;
 
 const char* LibraryWatcher::kSettingsGroup = "LibraryWatcher";
+const int LibraryWatcher::kTagReadWindow = 64;
+const int LibraryWatcher::kTagReadBatchSize = 16;
+const int LibraryWatcher::kStatThreads = 16;
+const int LibraryWatcher::kStatBatchSize = 64;
 
 LibraryWatcher::LibraryWatcher(QObject* parent)
     : QObject(parent),
@@ -67,6 +102,8 @@ LibraryWatcher::LibraryWatcher(QObject* parent)
   rescan_timer_->setInterval(1000);
   rescan_timer_->setSingleShot(true);
 
+  stat_thread_pool_.setMaxThreadCount(kStatThreads);
+
   if (sValidImages.isEmpty()) {
     sValidImages << "jpg"
                  << "png"
@@ -89,7 +126,8 @@ LibraryWatcher::ScanTransaction::ScanTransaction(LibraryWatcher* watcher,
       ignores_mtime_(ignores_mtime),
       watcher_(watcher),
       cached_songs_dirty_(true),
-      known_subdirs_dirty_(true) {
+      known_subdirs_dirty_(true),
+      deferred_watches_(nullptr) {
   QString description;
   if (watcher_->device_name_.isEmpty())
     description = tr("Updating library");
@@ -101,6 +139,13 @@ LibraryWatcher::ScanTransaction::ScanTransaction(LibraryWatcher* watcher,
 }
 
 LibraryWatcher::ScanTransaction::~ScanTransaction() {
+  // Any tag reads still in flight belong to files we didn't get round to.
+  // Their replies must outlive the response from the worker.
+  for (TagReaderReply* reply : tag_read_refs_.keys()) {
+    QObject::connect(reply, SIGNAL(Finished(bool)), reply, SLOT(deleteLater()));
+    if (reply->is_finished()) reply->deleteLater();
+  }
+
   // If we're stopping then don't commit the transaction
   if (watcher_->stop_requested_) return;
 
@@ -119,7 +164,9 @@ LibraryWatcher::ScanTransaction::~ScanTransaction() {
 
   watcher_->task_manager_->SetTaskFinished(task_id_);
 
-  if (watcher_->monitor_) {
+  if (deferred_watches_) {
+    *deferred_watches_ << new_subdirs;
+  } else if (watcher_->monitor_) {
     // Watch the new subdirectories
     for (const Subdirectory& subdir : new_subdirs) {
       watcher_->AddWatch(watcher_->watched_dirs_[dir_], subdir.path);
@@ -137,6 +184,65 @@ void LibraryWatcher::ScanTransaction::AddToProgressMax(int n) {
   watcher_->task_manager_->SetTaskProgress(task_id_, progress_, progress_max_);
 }
 
+void LibraryWatcher::ScanTransaction::QueueTagRead(const QString& file) {
+  tag_read_queue_ << file;
+  FillTagReadWindow();
+}
+
+void LibraryWatcher::ScanTransaction::FillTagReadWindow() {
+  while (pending_tag_reads_.count() < kTagReadWindow &&
+         !tag_read_queue_.isEmpty()) {
+    QStringList batch;
+    while (batch.count() < kTagReadBatchSize &&
+           pending_tag_reads_.count() + batch.count() < kTagReadWindow &&
+           !tag_read_queue_.isEmpty()) {
+      const QString file = tag_read_queue_.takeFirst();
+      if (!pending_tag_reads_.contains(file) && !batch.contains(file)) {
+        batch << file;
+      }
+    }
+    if (batch.isEmpty()) continue;
+
+    TagReaderReply* reply = TagReaderClient::Instance()->ReadFiles(batch);
+    tag_read_refs_[reply] = batch.count();
+    for (int i = 0; i < batch.count(); ++i) {
+      PendingTagRead pending;
+      pending.reply = reply;
+      pending.index = i;
+      pending_tag_reads_[batch[i]] = pending;
+    }
+  }
+}
+
+void LibraryWatcher::ScanTransaction::ReadFile(const QString& file,
+                                               Song* song) {
+  if (!pending_tag_reads_.contains(file)) {
+    // Not queued, or queued but not sent yet.
+    tag_read_queue_.removeOne(file);
+    TagReaderClient::Instance()->ReadFileBlocking(file, song);
+    FillTagReadWindow();
+    return;
+  }
+
+  const PendingTagRead pending = pending_tag_reads_.take(file);
+
+  // Keep the workers busy while we wait for this one.
+  FillTagReadWindow();
+
+  if (pending.reply->WaitForFinished()) {
+    const pb::tagreader::ReadFilesResponse& response =
+        pending.reply->message().read_files_response();
+    if (pending.index < response.metadata_size()) {
+      song->InitFromProtobuf(response.metadata(pending.index));
+    }
+  }
+
+  if (--tag_read_refs_[pending.reply] == 0) {
+    tag_read_refs_.remove(pending.reply);
+    pending.reply->deleteLater();
+  }
+}
+
 SongList LibraryWatcher::ScanTransaction::FindSongsInSubdirectory(
     const QString& path) {
   if (cached_songs_dirty_) {
@@ -184,6 +290,17 @@ SubdirectoryList LibraryWatcher::ScanTransaction::GetImmediateSubdirs(
   return ret;
 }
 
+ArtCandidateList LibraryWatcher::ScanTransaction::KnownArtCandidates(
+    const QString& path) {
+  if (known_subdirs_dirty_)
+    SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
+
+  for (const Subdirectory& subdir : known_subdirs_) {
+    if (subdir.path == path) return subdir.art_candidates;
+  }
+  return ArtCandidateList();
+}
+
 SubdirectoryList LibraryWatcher::ScanTransaction::GetAllSubdirs() {
   if (known_subdirs_dirty_)
     SetKnownSubdirs(watcher_->backend_->SubdirsInDirectory(dir_));
@@ -219,10 +336,23 @@ void LibraryWatcher::AddDirectory(const Directory& dir,
   emit CompilationsNeedUpdating();
 }
 
+void LibraryWatcher::AddDirectoryWithoutScan(const Directory& dir,
+                                             const SubdirectoryList& subdirs) {
+  watched_dirs_[dir.id] = dir;
+
+  if (monitor_) {
+    for (const Subdirectory& subdir : subdirs) {
+      AddWatch(dir, subdir.path);
+    }
+  }
+}
+
 void LibraryWatcher::ScanSubdirectory(const QString& path,
                                       const Subdirectory& subdir,
                                       ScanTransaction* t,
                                       bool force_noincremental) {
+  qTraceScope("LibraryWatcher::ScanSubdirectory");
+
   QFileInfo path_info(path);
   QDir      path_dir(path);
 
@@ -251,7 +381,7 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
     return;
   }
 
-  QMap<QString, QStringList> album_art;
+  ArtCandidateList art_candidates;
   QStringList files_on_disk;
   SubdirectoryList my_new_subdirs;
 
@@ -290,20 +420,42 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
       }
     } else {
       QString ext_part(ExtensionPart(child));
-      QString dir_part(DirectoryPart(child));
 
-      if (sValidImages.contains(ext_part))
-        album_art[dir_part] << child;
-      else if (!child_info.isHidden())
+      if (sValidImages.contains(ext_part)) {
+        ArtCandidate candidate;
+        candidate.path = child;
+        candidate.mtime = child_info.lastModified().toTime_t();
+        art_candidates << candidate;
+      } else if (!child_info.isHidden()) {
         files_on_disk << child;
+      }
     }
   }
 
   if (stop_requested_) return;
 
+  // Choose the album art for the songs in this directory.  Only the images
+  // that are new or have changed since the last scan need to be read.
+  CopyKnownArtSizes(t->KnownArtCandidates(path), &art_candidates);
+  const QString image =
+      files_on_disk.isEmpty() ? QString() : PickBestImage(&art_candidates);
+
   // Ask the database for a list of files in this directory
   SongList songs_in_db = t->FindSongsInSubdirectory(path);
 
+  // Start reading the tags of the files we know we'll have to read: ones that
+  // aren't in the database yet, or every file on a full rescan.  Files with a
+  // cue sheet are read through the cue parser instead.
+  for (const QString& file : files_on_disk) {
+    if (GetMtimeForCue(NoExtensionPart(file) + ".cue")) continue;
+
+    Song matching_song;
+    const bool in_db = FindSongByPath(songs_in_db, file, &matching_song);
+    if (!in_db || (t->ignores_mtime() && !matching_song.has_cue())) {
+      t->QueueTagRead(file);
+    }
+  }
+
   QSet<QString> cues_processed;
 
   // Now compare the list from the database with the list of files on disk
@@ -343,7 +495,6 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
           cue_deleted || cue_added;
 
       // Also want to look to see whether the album art has changed
-      QString image = ImageForSong(file, album_art);
       if ((matching_song.art_automatic().isEmpty() && !image.isEmpty()) ||
           (!matching_song.art_automatic().isEmpty() &&
            !matching_song.has_embedded_cover() &&
@@ -371,17 +522,17 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
     } else {
       // The song is on disk but not in the DB
       SongList song_list =
-          ScanNewFile(file, path, matching_cue, &cues_processed);
+          ScanNewFile(file, path, matching_cue, &cues_processed, t);
 
       if (song_list.isEmpty()) {
         continue;
       }
 
       qLog(Debug) << file << "created";
-      // choose an image for the song(s)
-      QString image = ImageForSong(file, album_art);
 
-      for (Song song : song_list) {
+      // The list is the only thing holding these songs, so they can be
+      // changed without copying them.
+      for (Song& song : song_list) {
         song.set_directory_id(t->dir());
         if (song.art_automatic().isEmpty()) song.set_art_automatic(image);
 
@@ -405,6 +556,7 @@ void LibraryWatcher::ScanSubdirectory(const QString& path,
   updated_subdir.mtime =
       path_info.exists() ? path_info.lastModified().toTime_t() : 0;
   updated_subdir.path = path;
+  updated_subdir.art_candidates = art_candidates;
 
   if (subdir.directory_id == -1)
     t->new_subdirs << updated_subdir;
@@ -439,7 +591,8 @@ void LibraryWatcher::UpdateCueAssociatedSongs(const QString& file,
   QSet<int> used_ids;
 
   // update every song that's in the cue and library
-  for (Song cue_song : cue_parser_->Load(&cue, matching_cue, path)) {
+  SongList cue_songs = cue_parser_->Load(&cue, matching_cue, path);
+  for (Song& cue_song : cue_songs) {
     cue_song.set_directory_id(t->dir());
 
     Song matching = sections_map[cue_song.beginning_nanosec()];
@@ -480,7 +633,7 @@ void LibraryWatcher::UpdateNonCueAssociatedSong(const QString& file,
 
   Song song_on_disk;
   song_on_disk.set_directory_id(t->dir());
-  TagReaderClient::Instance()->ReadFileBlocking(file, &song_on_disk);
+  t->ReadFile(file, &song_on_disk);
 
   if (song_on_disk.is_valid()) {
     PreserveUserSetData(file, image, matching_song, &song_on_disk, t);
@@ -489,7 +642,8 @@ void LibraryWatcher::UpdateNonCueAssociatedSong(const QString& file,
 
 SongList LibraryWatcher::ScanNewFile(const QString& file, const QString& path,
                                      const QString& matching_cue,
-                                     QSet<QString>* cues_processed) {
+                                     QSet<QString>* cues_processed,
+                                     ScanTransaction* t) {
   SongList song_list;
 
   uint matching_cue_mtime = GetMtimeForCue(matching_cue);
@@ -520,7 +674,7 @@ SongList LibraryWatcher::ScanNewFile(const QString& file, const QString& path,
     // it's a normal media file
   } else {
     Song song;
-    TagReaderClient::Instance()->ReadFileBlocking(file, &song);
+    t->ReadFile(file, &song);
 
     if (song.is_valid()) {
       song_list << song;
@@ -543,6 +697,13 @@ void LibraryWatcher::PreserveUserSetData(const QString& file,
 
   out->MergeUserSetData(matching_song);
 
+  // Keep the loudness analysis if it looks like only the tags were edited.
+  if (!out->has_replaygain() &&
+      matching_song.length_nanosec() == out->length_nanosec()) {
+    out->set_replaygain_track_gain(matching_song.replaygain_track_gain());
+    out->set_replaygain_album_gain(matching_song.replaygain_album_gain());
+  }
+
   // The song was deleted from the database (e.g. due to an unmounted
   // filesystem), but has been restored.
   if (matching_song.is_unavailable()) {
@@ -647,20 +808,23 @@ void LibraryWatcher::RescanPathsNow() {
   emit CompilationsNeedUpdating();
 }
 
-QString LibraryWatcher::PickBestImage(const QStringList& images) {
+QString LibraryWatcher::PickBestImage(ArtCandidateList* images) {
+  if (images->isEmpty()) return QString();
+  if (images->count() == 1) return images->first().path;
+
   // This is used when there is more than one image in a directory.
   // Pick the biggest image that matches the most important filter
 
-  QStringList filtered;
+  QList<ArtCandidate*> filtered;
 
   for (const QString& filter_text : best_image_filters_) {
     // the images in the images list are represented by a full path,
     // so we need to isolate just the filename
-    for (const QString& image : images) {
-      QFileInfo file_info(image);
+    for (ArtCandidate& image : *images) {
+      QFileInfo file_info(image.path);
       QString filename(file_info.fileName());
       if (filename.contains(filter_text, Qt::CaseInsensitive))
-        filtered << image;
+        filtered << &image;
     }
 
     /* We assume the filters are give in the order best to worst, so
@@ -671,42 +835,25 @@ QString LibraryWatcher::PickBestImage(const QStringList& images) {
 
   if (filtered.isEmpty()) {
     // the filter was too restrictive, just use the original list
-    filtered = images;
+    for (ArtCandidate& image : *images) filtered << &image;
   }
 
   int biggest_size = 0;
   QString biggest_path;
 
-  for (const QString& path : filtered) {
-    QImage image(path);
-    if (image.isNull()) continue;
+  for (ArtCandidate* image : filtered) {
+    if (!image->size.isValid()) image->size = ReadImageSize(image->path);
 
-    int size = image.width() * image.height();
+    int size = image->size.width() * image->size.height();
     if (size > biggest_size) {
       biggest_size = size;
-      biggest_path = path;
+      biggest_path = image->path;
     }
   }
 
   return biggest_path;
 }
 
-QString LibraryWatcher::ImageForSong(const QString& path,
-                                     QMap<QString, QStringList>& album_art) {
-  QString dir(DirectoryPart(path));
-
-  if (album_art.contains(dir)) {
-    if (album_art[dir].count() == 1)
-      return album_art[dir][0];
-    else {
-      QString best_image = PickBestImage(album_art[dir]);
-      album_art[dir] = QStringList() << best_image;
-      return best_image;
-    }
-  }
-  return QString();
-}
-
 void LibraryWatcher::ReloadSettingsAsync() {
   QMetaObject::invokeMethod(this, "ReloadSettings", Qt::QueuedConnection);
 }
@@ -718,6 +865,8 @@ void LibraryWatcher::ReloadSettings() {
   s.beginGroup(kSettingsGroup);
   scan_on_startup_ = s.value("startup_scan", true).toBool();
   monitor_ = s.value("monitor", true).toBool();
+  scan_thread_pool_.setMaxThreadCount(qMax(
+      1, s.value("scan_threads", QThread::idealThreadCount()).toInt()));
 
   best_image_filters_.clear();
   QStringList filters =
@@ -759,22 +908,133 @@ void LibraryWatcher::FullScanAsync() {
   QMetaObject::invokeMethod(this, "FullScanNow", Qt::QueuedConnection);
 }
 
+void LibraryWatcher::VerifyScanAsync() {
+  QMetaObject::invokeMethod(this, "VerifyScanNow", Qt::QueuedConnection);
+}
+
 void LibraryWatcher::IncrementalScanNow() { PerformScan(true, false); }
 
 void LibraryWatcher::FullScanNow() { PerformScan(false, true); }
 
-void LibraryWatcher::PerformScan(bool incremental, bool ignore_mtimes) {
+void LibraryWatcher::VerifyScanNow() {
   for (const Directory& dir : watched_dirs_.values()) {
-    ScanTransaction transaction(this, dir.id, incremental, ignore_mtimes);
-    SubdirectoryList subdirs(transaction.GetAllSubdirs());
+    if (stop_requested_) return;
+
+    ScanTransaction transaction(this, dir.id, true);
+    const SubdirectoryList subdirs(transaction.GetAllSubdirs());
     transaction.AddToProgressMax(subdirs.count());
 
     for (const Subdirectory& subdir : subdirs) {
       if (stop_requested_) return;
+      ScanSubdirectory(subdir.path, subdir, &transaction, true);
+    }
+  }
+
+  emit CompilationsNeedUpdating();
+}
+
+void LibraryWatcher::PerformScan(bool incremental, bool ignore_mtimes) {
+  const QList<Directory> dirs = watched_dirs_.values();
+
+  if (dirs.count() < 2 || scan_thread_pool_.maxThreadCount() < 2) {
+    for (const Directory& dir : dirs) {
+      if (stop_requested_) return;
+      ScanDirectory(dir, incremental, ignore_mtimes, false);
+    }
+  } else {
+    // Scan each directory in its own transaction on the thread pool.  This
+    // thread blocks until they have all finished, so watched_dirs_ can't
+    // change underneath them.
+    QList<QFuture<SubdirectoryList>> futures;
+    for (const Directory& dir : dirs) {
+      futures << ConcurrentRun::Run<SubdirectoryList>(
+          &scan_thread_pool_, std::bind(&LibraryWatcher::ScanDirectory, this,
+                                        dir, incremental, ignore_mtimes, true));
+    }
 
-      ScanSubdirectory(subdir.path, subdir, &transaction);
+    for (int i = 0; i < futures.count(); ++i) {
+      futures[i].waitForFinished();
+      if (stop_requested_ || !monitor_) continue;
+
+      for (const Subdirectory& subdir : futures[i].result()) {
+        AddWatch(dirs[i], subdir.path);
+      }
     }
+
+    if (stop_requested_) return;
   }
 
   emit CompilationsNeedUpdating();
 }
+
+SubdirectoryList LibraryWatcher::ScanDirectory(const Directory& dir,
+                                               bool incremental,
+                                               bool ignore_mtimes,
+                                               bool defer_watches) {
+  SubdirectoryList new_subdirs;
+
+  ScanTransaction transaction(this, dir.id, incremental, ignore_mtimes);
+  if (defer_watches) transaction.set_deferred_watches(&new_subdirs);
+
+  QElapsedTimer timer;
+  timer.start();
+
+  SubdirectoryList subdirs(transaction.GetAllSubdirs());
+  const int known_count = subdirs.count();
+  const qint64 load_msec = timer.restart();
+
+  // Most subdirectories won't have changed since the last scan, so look at
+  // all their mtimes at once and only descend into the ones that did.
+  if (incremental && !ignore_mtimes) subdirs = ChangedSubdirs(subdirs);
+  const qint64 stat_msec = timer.restart();
+
+  transaction.AddToProgressMax(subdirs.count());
+
+  for (const Subdirectory& subdir : subdirs) {
+    if (stop_requested_) break;
+
+    ScanSubdirectory(subdir.path, subdir, &transaction);
+  }
+
+  qLog(Info) << "Scanned" << dir.path << "- loaded" << known_count
+             << "subdirectories in" << load_msec << "ms, checked mtimes in"
+             << stat_msec << "ms, scanned" << subdirs.count() << "in"
+             << timer.elapsed() << "ms";
+
+  return new_subdirs;
+}
+
+SubdirectoryList LibraryWatcher::ChangedSubdirs(
+    const SubdirectoryList& subdirs) {
+  QList<QFuture<QVector<uint>>> futures;
+  for (int i = 0; i < subdirs.count(); i += kStatBatchSize) {
+    QStringList paths;
+    for (int j = i; j < qMin(i + kStatBatchSize, subdirs.count()); ++j) {
+      paths << subdirs[j].path;
+    }
+    futures << ConcurrentRun::Run<QVector<uint>>(
+        &stat_thread_pool_, std::bind(&LibraryWatcher::ReadMtimes, paths));
+  }
+
+  SubdirectoryList ret;
+  for (int i = 0; i < futures.count(); ++i) {
+    futures[i].waitForFinished();
+    const QVector<uint> mtimes = futures[i].result();
+    for (int j = 0; j < mtimes.count(); ++j) {
+      const Subdirectory& subdir = subdirs[i * kStatBatchSize + j];
+      if (subdir.mtime != mtimes[j]) ret << subdir;
+    }
+  }
+  return ret;
+}
+
+QVector<uint> LibraryWatcher::ReadMtimes(const QStringList& paths) {
+  // The same check as ScanSubdirectory, a directory that's gone has an invalid
+  // mtime and is scanned to remove its songs.
+  QVector<uint> ret;
+  ret.reserve(paths.count());
+  for (const QString& path : paths) {
+    ret << QFileInfo(path).lastModified().toTime_t();
+  }
+  return ret;
+}
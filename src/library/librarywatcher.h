@@ -20,11 +20,14 @@
 
 #include "directory.h"
 #include "core/song.h"
+#include "core/tagreaderclient.h"
 
 #include <QHash>
 #include <QObject>
 #include <QStringList>
 #include <QMap>
+#include <QThreadPool>
+#include <QVector>
 
 class QFileSystemWatcher;
 class QTimer;
@@ -52,6 +55,10 @@ class LibraryWatcher : public QObject {
 
   void IncrementalScanAsync();
   void FullScanAsync();
+  // Looks in every subdirectory whatever its mtime, for filesystems like FAT
+  // that don't keep directory mtimes up to date.  Only files that changed are
+  // read again.
+  void VerifyScanAsync();
   void SetRescanPausedAsync(bool pause);
   void ReloadSettingsAsync();
 
@@ -71,6 +78,10 @@ signals:
  public slots:
   void ReloadSettings();
   void AddDirectory(const Directory& dir, const SubdirectoryList& subdirs);
+  // Like AddDirectory, but trusts the subdirectories that are already in the
+  // database and only starts watching them.
+  void AddDirectoryWithoutScan(const Directory& dir,
+                               const SubdirectoryList& subdirs);
   void RemoveDirectory(const Directory& dir);
   void SetRescanPaused(bool pause);
 
@@ -94,11 +105,30 @@ signals:
     bool HasSeenSubdir(const QString& path);
     void SetKnownSubdirs(const SubdirectoryList& subdirs);
     SubdirectoryList GetImmediateSubdirs(const QString& path);
+    // The images found in the subdirectory the last time it was scanned.
+    ArtCandidateList KnownArtCandidates(const QString& path);
     SubdirectoryList GetAllSubdirs();
 
     void AddToProgress(int n = 1);
     void AddToProgressMax(int n);
 
+    // Queues a file to have its tags read in the background.  Files are sent
+    // to the clementine-tagreader workers kTagReadBatchSize at a time, and up
+    // to kTagReadWindow files are kept in flight at once so every worker has
+    // something to do while we walk the directory.  Files should be read back
+    // with ReadFile() in the same order.
+    void QueueTagRead(const QString& file);
+    // Reads the tags of a file, using a request started by QueueTagRead() if
+    // there is one, otherwise blocking on a new request.
+    void ReadFile(const QString& file, Song* song);
+
+    // If set, the new subdirectories are appended to this list when the
+    // transaction is committed instead of being watched straight away.  Used
+    // when the transaction is running on a thread other than the watcher's.
+    void set_deferred_watches(SubdirectoryList* list) {
+      deferred_watches_ = list;
+    }
+
     int dir() const { return dir_; }
     bool is_incremental() const { return incremental_; }
     bool ignores_mtime() const { return ignores_mtime_; }
@@ -114,6 +144,8 @@ signals:
     ScanTransaction(const ScanTransaction&) {}
     ScanTransaction& operator=(const ScanTransaction&) { return *this; }
 
+    void FillTagReadWindow();
+
     int task_id_;
     int progress_;
     int progress_max_;
@@ -135,12 +167,25 @@ signals:
 
     SubdirectoryList known_subdirs_;
     bool known_subdirs_dirty_;
+
+    struct PendingTagRead {
+      TagReaderReply* reply;
+      int index;
+    };
+
+    QStringList tag_read_queue_;
+    QHash<QString, PendingTagRead> pending_tag_reads_;
+    // Number of files in pending_tag_reads_ still waiting on each reply.
+    QHash<TagReaderReply*, int> tag_read_refs_;
+
+    SubdirectoryList* deferred_watches_;
   };
 
  private slots:
   void DirectoryChanged(const QString& path);
   void IncrementalScanNow();
   void FullScanNow();
+  void VerifyScanNow();
   void RescanPathsNow();
   void ScanSubdirectory(const QString& path, const Subdirectory& subdir,
                         ScanTransaction* t, bool force_noincremental = false);
@@ -150,13 +195,21 @@ signals:
                              Song* out);
   inline static QString NoExtensionPart(const QString& fileName);
   inline static QString ExtensionPart(const QString& fileName);
-  inline static QString DirectoryPart(const QString& fileName);
-  QString PickBestImage(const QStringList& images);
-  QString ImageForSong(const QString& path,
-                       QMap<QString, QStringList>& album_art);
+  // Reads the sizes of the images it needs to compare that aren't known yet,
+  // and stores them in the list.
+  QString PickBestImage(ArtCandidateList* images);
   void AddWatch(const Directory& dir, const QString& path);
   uint GetMtimeForCue(const QString& cue_path);
   void PerformScan(bool incremental, bool ignore_mtimes);
+  // Scans every subdirectory of one library directory.  Can be run on a
+  // thread from scan_thread_pool_, in which case the subdirectories that need
+  // to be watched are returned instead of being added to the watcher.
+  SubdirectoryList ScanDirectory(const Directory& dir, bool incremental,
+                                 bool ignore_mtimes, bool defer_watches);
+  // Returns the subdirectories whose mtime on disk is different from the one
+  // in the database.  The stats are done in batches on stat_thread_pool_.
+  SubdirectoryList ChangedSubdirs(const SubdirectoryList& subdirs);
+  static QVector<uint> ReadMtimes(const QStringList& paths);
 
   // Updates the sections of a cue associated and altered (according to mtime)
   // media file during a scan.
@@ -180,7 +233,7 @@ signals:
   // has many sections (like a CUE related media file).
   SongList ScanNewFile(const QString& file, const QString& path,
                        const QString& matching_cue,
-                       QSet<QString>* cues_processed);
+                       QSet<QString>* cues_processed, ScanTransaction* t);
 
  private:
   LibraryBackend* backend_;
@@ -201,6 +254,13 @@ signals:
   bool scan_on_startup_;
   bool monitor_;
 
+  // Library directories are independent of each other, so a full or
+  // incremental scan runs one ScanTransaction per directory on this pool.
+  QThreadPool scan_thread_pool_;
+  // Incremental scans stat every subdirectory up front.  On network
+  // filesystems each stat is a round trip, so several are kept in flight.
+  QThreadPool stat_thread_pool_;
+
   QMap<int, Directory> watched_dirs_;
   QTimer* rescan_timer_;
   QMap<int, QStringList>
@@ -212,6 +272,11 @@ signals:
   CueParser* cue_parser_;
 
   static QStringList sValidImages;
+
+  static const int kTagReadWindow;
+  static const int kTagReadBatchSize;
+  static const int kStatThreads;
+  static const int kStatBatchSize;
 };
 
 inline QString LibraryWatcher::NoExtensionPart(const QString& fileName) {
@@ -223,8 +288,5 @@ inline QString LibraryWatcher::ExtensionPart(const QString& fileName) {
              ? fileName.mid(fileName.lastIndexOf('.') + 1).toLower()
              : "";
 }
-inline QString LibraryWatcher::DirectoryPart(const QString& fileName) {
-  return fileName.section('/', 0, -2);
-}
 
 #endif  // LIBRARYWATCHER_H
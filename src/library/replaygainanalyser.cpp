@@ -0,0 +1,355 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "replaygainanalyser.h"
+
+#include <cmath>
+
+#include <QtConcurrentMap>
+#include <QVector>
+#include <qnumeric.h>
+
+#include "librarybackend.h"
+#include "core/closure.h"
+#include "core/logging.h"
+#include "core/offlinedecoder.h"
+#include "core/taskmanager.h"
+#include "core/threadpools.h"
+
+const float ReplayGainAnalyser::kReferenceLoudness = -18.0;
+
+namespace {
+
+// The K-weighting filter coefficients in BS.1770 are given for 48kHz, so
+// that's what we ask the decoder for.
+const int kDecodeRate = 48000;
+const int kDecodeChannels = 2;
+const int kTimeoutSecs = 600;
+
+// Loudness is measured over 400ms blocks that overlap by 75%.
+const int kSubBlockFrames = kDecodeRate / 10;
+const int kSubBlocksPerBlock = 4;
+
+// Blocks are kept in a histogram rather than a list so albums can be measured
+// by adding the histograms of their tracks together.  Each bin is 0.1 LU
+// wide, starting at the absolute gate.
+const double kAbsoluteGate = -70.0;
+const double kRelativeGate = -10.0;
+const int kBinsPerLu = 10;
+const int kBinCount = 100 * kBinsPerLu;
+
+double EnergyToLoudness(double energy) {
+  return -0.691 + 10.0 * std::log10(energy);
+}
+
+struct Biquad {
+  Biquad(double b0, double b1, double b2, double a1, double a2)
+      : b0_(b0), b1_(b1), b2_(b2), a1_(a1), a2_(a2), z1_(0), z2_(0) {}
+
+  double Process(double in) {
+    const double out = b0_ * in + z1_;
+    z1_ = b1_ * in - a1_ * out + z2_;
+    z2_ = b2_ * in - a2_ * out;
+    return out;
+  }
+
+  double b0_, b1_, b2_, a1_, a2_;
+  double z1_, z2_;
+};
+
+struct LoudnessHistogram {
+  LoudnessHistogram() : count_(kBinCount, 0), energy_(kBinCount, 0.0) {}
+
+  void AddBlock(double energy) {
+    const double loudness = EnergyToLoudness(energy);
+    if (loudness < kAbsoluteGate) return;
+
+    const int bin = qMin(kBinCount - 1,
+                         int((loudness - kAbsoluteGate) * kBinsPerLu));
+    count_[bin]++;
+    energy_[bin] += energy;
+  }
+
+  void Add(const LoudnessHistogram& other) {
+    for (int i = 0; i < kBinCount; ++i) {
+      count_[i] += other.count_[i];
+      energy_[i] += other.energy_[i];
+    }
+  }
+
+  // Returns the gated integrated loudness in LUFS, or NaN if there was
+  // nothing louder than the absolute gate.
+  double IntegratedLoudness() const {
+    const double ungated = MeanLoudness(0);
+    if (qIsNaN(ungated)) return ungated;
+
+    const double gate = ungated + kRelativeGate;
+    const int first_bin =
+        qMax(0, int(std::ceil((gate - kAbsoluteGate) * kBinsPerLu)));
+    return MeanLoudness(first_bin);
+  }
+
+  double MeanLoudness(int first_bin) const {
+    qint64 count = 0;
+    double energy = 0.0;
+    for (int i = first_bin; i < kBinCount; ++i) {
+      count += count_[i];
+      energy += energy_[i];
+    }
+    if (count == 0) return qQNaN();
+    return EnergyToLoudness(energy / count);
+  }
+
+  QVector<int> count_;
+  QVector<double> energy_;
+};
+
+class LoudnessMeter : public OfflineDecoder::Sink {
+  // Measures the loudness of 16-bit stereo PCM at kDecodeRate.  Stops the
+  // decoder early if cancelled becomes non-zero.
+
+ public:
+  explicit LoudnessMeter(QAtomicInt* cancelled)
+      : cancelled_(cancelled),
+        channel_(0),
+        frames_(0),
+        energy_(0.0),
+        sub_blocks_seen_(0) {
+    for (int i = 0; i < kDecodeChannels; ++i) {
+      shelf_ << Biquad(1.53512485958697, -2.69169618940638, 1.19839281085285,
+                       -1.69065929318241, 0.73248077421585);
+      highpass_ << Biquad(1.0, -2.0, 1.0, -1.99004745483398,
+                          0.99007225036621);
+    }
+    for (int i = 0; i < kSubBlocksPerBlock; ++i) sub_blocks_[i] = 0.0;
+  }
+
+  const LoudnessHistogram& histogram() const { return histogram_; }
+
+  bool Consume(const char* data, int size) override {
+    const qint16* samples = reinterpret_cast<const qint16*>(data);
+    const int count = size / sizeof(qint16);
+
+    for (int i = 0; i < count; ++i) {
+      const double filtered = highpass_[channel_].Process(
+          shelf_[channel_].Process(samples[i] / 32768.0));
+      energy_ += filtered * filtered;
+
+      if (++channel_ < kDecodeChannels) continue;
+      channel_ = 0;
+
+      if (++frames_ == kSubBlockFrames) {
+        frames_ = 0;
+        FinishSubBlock();
+      }
+    }
+
+    return !is_cancelled();
+  }
+
+  bool is_cancelled() const {
+    return cancelled_ && cancelled_->fetchAndAddRelaxed(0);
+  }
+
+ private:
+  void FinishSubBlock() {
+    sub_blocks_[sub_blocks_seen_++ % kSubBlocksPerBlock] = energy_;
+    energy_ = 0.0;
+
+    if (sub_blocks_seen_ >= kSubBlocksPerBlock) {
+      double block_energy = 0.0;
+      for (int i = 0; i < kSubBlocksPerBlock; ++i) {
+        block_energy += sub_blocks_[i];
+      }
+      histogram_.AddBlock(block_energy /
+                          (kSubBlockFrames * kSubBlocksPerBlock));
+    }
+  }
+
+  QAtomicInt* cancelled_;
+
+  QList<Biquad> shelf_;
+  QList<Biquad> highpass_;
+
+  // State for the sub-block being filled
+  int channel_;
+  int frames_;
+  double energy_;
+
+  // The energy of the last kSubBlocksPerBlock sub-blocks
+  int sub_blocks_seen_;
+  double sub_blocks_[kSubBlocksPerBlock];
+
+  LoudnessHistogram histogram_;
+};
+
+struct AnalyseAlbumFunctor {
+  typedef SongList result_type;
+
+  explicit AnalyseAlbumFunctor(QAtomicInt* cancelled)
+      : cancelled_(cancelled) {}
+  SongList operator()(const SongList& songs) const {
+    return ReplayGainAnalyser::AnalyseAlbum(songs, cancelled_);
+  }
+
+  QAtomicInt* cancelled_;
+};
+
+SongList LoadSongs(LibraryBackend* backend) {
+  return backend->GetSongsWithoutReplayGain();
+}
+
+bool IsSameAlbum(const Song& a, const Song& b) {
+  return !a.album().isEmpty() && a.album() == b.album() &&
+         a.effective_albumartist() == b.effective_albumartist() &&
+         a.directory_id() == b.directory_id();
+}
+
+}  // namespace
+
+ReplayGainAnalyser::ReplayGainAnalyser(LibraryBackend* backend,
+                                       TaskManager* task_manager,
+                                       QObject* parent)
+    : QObject(parent),
+      backend_(backend),
+      task_manager_(task_manager),
+      task_id_(-1),
+      watcher_(nullptr),
+      cancelled_(0),
+      songs_done_(0),
+      songs_total_(0) {}
+
+ReplayGainAnalyser::~ReplayGainAnalyser() { Cancel(); }
+
+void ReplayGainAnalyser::Start() {
+  if (is_running()) return;
+
+  task_id_ = task_manager_->StartTask(tr("Analysing loudness"));
+
+  QFuture<SongList> future = ThreadPools::Run<SongList>(
+      ThreadPools::Pool_Background, std::bind(&LoadSongs, backend_));
+  NewClosure(future, this, SLOT(SongsLoaded(QFuture<SongList>)), future);
+}
+
+void ReplayGainAnalyser::SongsLoaded(QFuture<SongList> future) {
+  if (!is_running()) return;
+
+  const SongList songs = future.result();
+
+  albums_.clear();
+  for (const Song& song : songs) {
+    if (albums_.isEmpty() || !IsSameAlbum(albums_.last().last(), song)) {
+      albums_ << SongList();
+    }
+    albums_.last() << song;
+  }
+
+  songs_done_ = 0;
+  songs_total_ = songs.count();
+  qLog(Info) << "Analysing loudness of" << songs_total_ << "songs in"
+             << albums_.count() << "albums";
+
+  if (albums_.isEmpty()) {
+    AllAlbumsAnalysed();
+    return;
+  }
+
+  watcher_ = new QFutureWatcher<SongList>(this);
+  connect(watcher_, SIGNAL(resultReadyAt(int)), SLOT(AlbumAnalysed(int)));
+  connect(watcher_, SIGNAL(finished()), SLOT(AllAlbumsAnalysed()));
+  cancelled_ = 0;
+  watcher_->setFuture(
+      QtConcurrent::mapped(albums_, AnalyseAlbumFunctor(&cancelled_)));
+}
+
+void ReplayGainAnalyser::AlbumAnalysed(int index) {
+  if (!watcher_ || index >= albums_.count()) return;
+
+  const SongList results = watcher_->resultAt(index);
+  if (!results.isEmpty()) {
+    QMetaObject::invokeMethod(backend_, "UpdateReplayGain",
+                              Qt::QueuedConnection,
+                              Q_ARG(SongList, results));
+  }
+
+  songs_done_ += albums_[index].count();
+  task_manager_->SetTaskProgress(task_id_, songs_done_, songs_total_);
+}
+
+void ReplayGainAnalyser::AllAlbumsAnalysed() {
+  if (watcher_) {
+    watcher_->deleteLater();
+    watcher_ = nullptr;
+  }
+  albums_.clear();
+
+  if (is_running()) {
+    task_manager_->SetTaskFinished(task_id_);
+    task_id_ = -1;
+  }
+}
+
+void ReplayGainAnalyser::Cancel() {
+  if (watcher_) {
+    // Stop the albums that are being decoded as well as the queued ones.
+    cancelled_ = 1;
+    watcher_->disconnect(this);
+    watcher_->cancel();
+    watcher_->waitForFinished();
+  }
+  AllAlbumsAnalysed();
+}
+
+SongList ReplayGainAnalyser::AnalyseAlbum(const SongList& songs,
+                                          QAtomicInt* cancelled) {
+  OfflineDecoder* decoder =
+      OfflineDecoder::ForCurrentThread(kDecodeRate, kDecodeChannels);
+
+  SongList ret;
+  LoudnessHistogram album;
+
+  for (const Song& song : songs) {
+    const QString filename = song.url().toLocalFile();
+
+    LoudnessMeter meter(cancelled);
+    if (meter.is_cancelled()) return SongList();
+
+    if (!decoder->Decode(filename, 0, kTimeoutSecs, &meter)) {
+      qLog(Warning) << "Couldn't decode" << filename << "to analyse loudness";
+      continue;
+    }
+    if (meter.is_cancelled()) return SongList();
+
+    const double loudness = meter.histogram().IntegratedLoudness();
+    if (qIsNaN(loudness)) {
+      qLog(Debug) << filename << "is silent";
+      continue;
+    }
+
+    Song analysed(song);
+    analysed.set_replaygain_track_gain(kReferenceLoudness - loudness);
+    ret << analysed;
+    album.Add(meter.histogram());
+  }
+
+  const double album_loudness = album.IntegratedLoudness();
+  for (Song& song : ret) {
+    song.set_replaygain_album_gain(kReferenceLoudness - album_loudness);
+  }
+
+  return ret;
+}
@@ -0,0 +1,81 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARY_REPLAYGAINANALYSER_H_
+#define LIBRARY_REPLAYGAINANALYSER_H_
+
+#include <QAtomicInt>
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+
+#include "core/song.h"
+
+class LibraryBackend;
+class TaskManager;
+
+class ReplayGainAnalyser : public QObject {
+  // Works out track and album gains for library songs that don't have them
+  // yet, by measuring their EBU R128 integrated loudness.  Files are decoded
+  // with OfflineDecoder on the global thread pool, one album per worker, and
+  // the results are saved in the library so the engine can use them when it
+  // sets up a pipeline for a file without ReplayGain tags.
+
+  Q_OBJECT
+
+ public:
+  ReplayGainAnalyser(LibraryBackend* backend, TaskManager* task_manager,
+                     QObject* parent = nullptr);
+  ~ReplayGainAnalyser();
+
+  // The loudness that gains bring songs to, in LUFS.  This is the ReplayGain
+  // 2.0 reference level.
+  static const float kReferenceLoudness;
+
+  bool is_running() const { return task_id_ != -1; }
+
+  // Works out the gains for the songs of one album, and returns the ones that
+  // could be decoded.  This method is blocking, so you want to call it in
+  // another thread.  Gives up and returns nothing once cancelled is non-zero.
+  static SongList AnalyseAlbum(const SongList& songs,
+                               QAtomicInt* cancelled = nullptr);
+
+ public slots:
+  // Analyses every library song that doesn't have gains yet.  Songs that
+  // couldn't be decoded are tried again next time.
+  void Start();
+  void Cancel();
+
+ private slots:
+  void SongsLoaded(QFuture<SongList> future);
+  void AlbumAnalysed(int index);
+  void AllAlbumsAnalysed();
+
+ private:
+  LibraryBackend* backend_;
+  TaskManager* task_manager_;
+
+  int task_id_;
+  QList<SongList> albums_;
+  QFutureWatcher<SongList>* watcher_;
+  QAtomicInt cancelled_;
+  int songs_done_;
+  int songs_total_;
+};
+
+#endif  // LIBRARY_REPLAYGAINANALYSER_H_
@@ -0,0 +1,164 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "similarityindex.h"
+
+#include <algorithm>
+#include <random>
+#include <utility>
+
+#include "audiofeatureanalyser.h"
+
+const int SimilarityIndex::kBitsPerTable = 12;
+const int SimilarityIndex::kTables = 8;
+
+namespace {
+
+const int kDimensions = AudioFeatureAnalyser::kDimensions;
+
+// A search that finds fewer than this many times the songs it was asked for
+// measures every song instead.
+const int kMinCandidatesPerResult = 4;
+
+// The same hyperplanes every time, so results don't change from one run to
+// the next.
+const unsigned kSeed = 1;
+
+}  // namespace
+
+SimilarityIndex::SimilarityIndex() {}
+
+void SimilarityIndex::Add(int id, const QByteArray& features) {
+  if (features.size() != kDimensions || rows_.contains(id)) return;
+
+  rows_[id] = ids_.count();
+  ids_ << id;
+  for (int i = 0; i < kDimensions; ++i) {
+    features_ << quint8(features[i]);
+  }
+}
+
+void SimilarityIndex::Build() {
+  mean_ = QVector<float>(kDimensions, 0.0);
+  for (int row = 0; row < ids_.count(); ++row) {
+    const quint8* features = Row(row);
+    for (int i = 0; i < kDimensions; ++i) {
+      mean_[i] += features[i];
+    }
+  }
+  if (!ids_.isEmpty()) {
+    for (int i = 0; i < kDimensions; ++i) {
+      mean_[i] /= ids_.count();
+    }
+  }
+
+  std::mt19937 random(kSeed);
+  std::normal_distribution<float> normal;
+  normals_.resize(kTables * kBitsPerTable * kDimensions);
+  for (int i = 0; i < normals_.count(); ++i) {
+    normals_[i] = normal(random);
+  }
+
+  buckets_ = QVector<QHash<quint32, QVector<int>>>(kTables);
+  for (int row = 0; row < ids_.count(); ++row) {
+    for (int table = 0; table < kTables; ++table) {
+      buckets_[table][Hash(table, Row(row))] << row;
+    }
+  }
+}
+
+QByteArray SimilarityIndex::Features(int id) const {
+  if (!rows_.contains(id)) return QByteArray();
+  return QByteArray(reinterpret_cast<const char*>(Row(rows_[id])),
+                    kDimensions);
+}
+
+const quint8* SimilarityIndex::Row(int row) const {
+  return features_.constData() + row * kDimensions;
+}
+
+quint32 SimilarityIndex::Hash(int table, const quint8* features) const {
+  const float* normal =
+      normals_.constData() + table * kBitsPerTable * kDimensions;
+
+  quint32 ret = 0;
+  for (int bit = 0; bit < kBitsPerTable; ++bit) {
+    float dot = 0.0;
+    for (int i = 0; i < kDimensions; ++i) {
+      dot += *(normal++) * (features[i] - mean_[i]);
+    }
+    if (dot > 0) ret |= 1 << bit;
+  }
+  return ret;
+}
+
+int SimilarityIndex::Distance(const quint8* a, const quint8* b) {
+  int ret = 0;
+  for (int i = 0; i < kDimensions; ++i) {
+    const int diff = int(a[i]) - int(b[i]);
+    ret += diff * diff;
+  }
+  return ret;
+}
+
+QList<int> SimilarityIndex::Nearest(const QByteArray& features, int count,
+                                    const QSet<int>& exclude) const {
+  if (features.size() != kDimensions || count <= 0 || buckets_.isEmpty()) {
+    return QList<int>();
+  }
+  const quint8* query = reinterpret_cast<const quint8*>(features.constData());
+
+  // Look in the query's own bucket in each table, and in the buckets whose
+  // hashes are one bit different.
+  QSet<int> candidates;
+  for (int table = 0; table < kTables; ++table) {
+    const quint32 hash = Hash(table, query);
+    for (int bit = -1; bit < kBitsPerTable; ++bit) {
+      const quint32 probe = bit == -1 ? hash : hash ^ (1 << bit);
+      auto it = buckets_[table].constFind(probe);
+      if (it == buckets_[table].constEnd()) continue;
+
+      for (int row : *it) {
+        if (!exclude.contains(ids_[row])) candidates.insert(row);
+      }
+    }
+  }
+
+  QVector<std::pair<int, int>> distances;
+  if (candidates.count() < count * kMinCandidatesPerResult) {
+    distances.reserve(ids_.count());
+    for (int row = 0; row < ids_.count(); ++row) {
+      if (exclude.contains(ids_[row])) continue;
+      distances << std::make_pair(Distance(query, Row(row)), row);
+    }
+  } else {
+    distances.reserve(candidates.count());
+    for (int row : candidates) {
+      distances << std::make_pair(Distance(query, Row(row)), row);
+    }
+  }
+
+  count = qMin(count, distances.count());
+  std::partial_sort(distances.begin(), distances.begin() + count,
+                    distances.end());
+
+  QList<int> ret;
+  for (int i = 0; i < count; ++i) {
+    ret << ids_[distances[i].second];
+  }
+  return ret;
+}
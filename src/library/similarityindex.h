@@ -0,0 +1,73 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARY_SIMILARITYINDEX_H_
+#define LIBRARY_SIMILARITYINDEX_H_
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <QVector>
+
+class SimilarityIndex {
+  // Finds the songs whose audio features (see AudioFeatureAnalyser) are
+  // nearest to some given features.  The features are kept in one flat
+  // array, and every song is hashed into a few tables by which side of some
+  // random hyperplanes its features fall on.  A search only measures the
+  // distance to the songs that share a bucket with the query in one of the
+  // tables, or are in a bucket next to it, so it doesn't have to look at the
+  // whole library.  If that doesn't turn up enough songs, every song is
+  // measured.
+
+ public:
+  SimilarityIndex();
+
+  // How many random hyperplanes each table uses.
+  static const int kBitsPerTable;
+  static const int kTables;
+
+  // Features that aren't AudioFeatureAnalyser::kDimensions bytes long are
+  // ignored.  Call Build once all the songs have been added.
+  void Add(int id, const QByteArray& features);
+  void Build();
+
+  int count() const { return ids_.count(); }
+  bool Contains(int id) const { return rows_.contains(id); }
+  QByteArray Features(int id) const;
+
+  // Returns up to count IDs, nearest first, leaving out the ones in exclude.
+  QList<int> Nearest(const QByteArray& features, int count,
+                     const QSet<int>& exclude = QSet<int>()) const;
+
+ private:
+  const quint8* Row(int row) const;
+  quint32 Hash(int table, const quint8* features) const;
+  static int Distance(const quint8* a, const quint8* b);
+
+ private:
+  QVector<int> ids_;
+  QHash<int, int> rows_;
+  QVector<quint8> features_;
+
+  // The hyperplanes go through the mean of all the features.
+  QVector<float> mean_;
+  QVector<float> normals_;
+  QVector<QHash<quint32, QVector<int>>> buckets_;
+};
+
+#endif  // LIBRARY_SIMILARITYINDEX_H_
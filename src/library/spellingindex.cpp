@@ -0,0 +1,234 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "spellingindex.h"
+
+#include <QVarLengthArray>
+
+#include <algorithm>
+
+const int SpellingIndex::kMinWordLength = 3;
+
+SpellingIndex::SpellingIndex() : live_words_(0) {}
+
+void SpellingIndex::Clear() {
+  nodes_.clear();
+  words_.clear();
+  live_words_ = 0;
+}
+
+QStringList SpellingIndex::Words(const QString& text) {
+  QStringList ret;
+  QString word;
+
+  for (const QChar& c : text) {
+    if (c.isLetterOrNumber()) {
+      word.append(c.toLower());
+      continue;
+    }
+    if (word.length() >= kMinWordLength) ret << word;
+    word.clear();
+  }
+  if (word.length() >= kMinWordLength) ret << word;
+
+  return ret;
+}
+
+void SpellingIndex::AddSongs(const SongList& songs) {
+  for (const Song& song : songs) {
+    AddSong(song, 1);
+  }
+}
+
+void SpellingIndex::RemoveSongs(const SongList& songs) {
+  for (const Song& song : songs) {
+    AddSong(song, -1);
+  }
+}
+
+void SpellingIndex::AddSong(const Song& song, int count) {
+  for (const QString& field : SongFields(song)) {
+    AddWords(Words(field), count);
+  }
+}
+
+QStringList SpellingIndex::SongFields(const Song& song) {
+  return QStringList() << song.artist() << song.albumartist() << song.album()
+                       << song.title() << song.composer() << song.performer()
+                       << song.genre();
+}
+
+void SpellingIndex::AddWords(const QStringList& words, int count) {
+  for (const QString& word : words) {
+    AddWord(word, count);
+  }
+}
+
+void SpellingIndex::AddWord(const QString& word, int count) {
+  QMap<QString, int>::const_iterator it = words_.constFind(word);
+  if (it != words_.constEnd()) {
+    Node& node = nodes_[it.value()];
+    const bool was_live = node.count_ > 0;
+    node.count_ = qMax(0, node.count_ + count);
+
+    if (was_live != (node.count_ > 0)) {
+      live_words_ += was_live ? -1 : 1;
+    }
+    return;
+  }
+
+  if (count <= 0) return;
+
+  Node node;
+  node.word_ = word;
+  node.count_ = count;
+  const int index = nodes_.count();
+
+  if (index != 0) {
+    // Walk down to the first node that has no child at our distance.
+    int parent = 0;
+    forever {
+      const int distance = Distance(word, nodes_[parent].word_);
+      QVector<QPair<int, int>>& children = nodes_[parent].children_;
+
+      int next = -1;
+      for (const QPair<int, int>& child : children) {
+        if (child.first == distance) {
+          next = child.second;
+          break;
+        }
+      }
+
+      if (next == -1) {
+        children << qMakePair(distance, index);
+        break;
+      }
+      parent = next;
+    }
+  }
+
+  nodes_ << node;
+  words_[word] = index;
+  live_words_++;
+}
+
+bool SpellingIndex::Contains(const QString& word) const {
+  QMap<QString, int>::const_iterator it = words_.constFind(word);
+  return it != words_.constEnd() && nodes_[it.value()].count_ > 0;
+}
+
+bool SpellingIndex::StartsKnownWord(const QString& prefix) const {
+  for (QMap<QString, int>::const_iterator it = words_.lowerBound(prefix);
+       it != words_.constEnd() && it.key().startsWith(prefix); ++it) {
+    if (nodes_[it.value()].count_ > 0) return true;
+  }
+  return false;
+}
+
+int SpellingIndex::MaxDistance(const QString& word) {
+  return word.length() <= 4 ? 1 : 2;
+}
+
+int SpellingIndex::Distance(const QString& a, const QString& b) {
+  // Levenshtein distance, keeping one row of the table.
+  const int a_length = a.length();
+  const int b_length = b.length();
+
+  QVarLengthArray<int, 64> row(b_length + 1);
+  for (int j = 0; j <= b_length; ++j) row[j] = j;
+
+  for (int i = 1; i <= a_length; ++i) {
+    int diagonal = row[0];
+    row[0] = i;
+
+    for (int j = 1; j <= b_length; ++j) {
+      const int above = row[j];
+      const int cost = a[i - 1] == b[j - 1] ? 0 : 1;
+      row[j] = std::min({above + 1, row[j - 1] + 1, diagonal + cost});
+      diagonal = above;
+    }
+  }
+
+  return row[b_length];
+}
+
+QString SpellingIndex::Nearest(const QString& word) const {
+  if (nodes_.isEmpty() || word.length() < kMinWordLength) return QString();
+
+  int best = -1;
+  int best_distance = MaxDistance(word);
+
+  QVarLengthArray<int, 256> stack;
+  stack.append(0);
+
+  while (!stack.isEmpty()) {
+    const Node& node = nodes_[stack.last()];
+    stack.removeLast();
+
+    const int distance = Distance(word, node.word_);
+    if (node.count_ > 0 && distance <= best_distance) {
+      const Node* best_node = best == -1 ? nullptr : &nodes_[best];
+      if (!best_node || distance < best_distance ||
+          node.count_ > best_node->count_ ||
+          (node.count_ == best_node->count_ &&
+           node.word_ < best_node->word_)) {
+        best = &node - nodes_.constData();
+        best_distance = distance;
+      }
+    }
+
+    // Anything within best_distance of word is within best_distance of
+    // distance from this node.
+    for (const QPair<int, int>& child : node.children_) {
+      if (qAbs(child.first - distance) <= best_distance) {
+        stack.append(child.second);
+      }
+    }
+  }
+
+  return best == -1 ? QString() : nodes_[best].word_;
+}
+
+QString SpellingIndex::Correct(const QString& query) const {
+  QStringList parts = query.simplified().split(' ', QString::SkipEmptyParts);
+  bool changed = false;
+
+  for (QString& part : parts) {
+    // Leave alone anything that isn't a plain word, like "artist:foo", and
+    // numbers, which are probably years or track numbers.
+    const QString word = part.toLower();
+    if (word.length() < kMinWordLength ||
+        std::any_of(word.begin(), word.end(),
+                    [](const QChar& c) { return !c.isLetterOrNumber(); }) ||
+        std::all_of(word.begin(), word.end(),
+                    [](const QChar& c) { return c.isDigit(); })) {
+      continue;
+    }
+
+    // The last word is usually still being typed, so a word is fine if it
+    // starts any known word.
+    if (StartsKnownWord(word)) continue;
+
+    const QString nearest = Nearest(word);
+    if (!nearest.isEmpty()) {
+      part = nearest;
+      changed = true;
+    }
+  }
+
+  return changed ? parts.join(" ") : QString();
+}
@@ -0,0 +1,96 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LIBRARY_SPELLINGINDEX_H_
+#define LIBRARY_SPELLINGINDEX_H_
+
+#include <QMap>
+#include <QPair>
+#include <QStringList>
+#include <QVector>
+
+#include "core/song.h"
+
+class SpellingIndex {
+  // Suggests corrections for misspelled search queries from the words in the
+  // artists, albums and titles of some songs, and the other fields the library
+  // search looks at apart from comments.  The words are kept in a BK-tree:
+  // every word is a node, and its children are keyed by their edit distance
+  // from it.  The triangle inequality means a lookup only has to follow the
+  // children whose key is close to the query's distance from the node, so
+  // only a small part of the tree is ever compared against the query.
+  //
+  // Each word counts how many times it was added, so songs can be removed
+  // again.  Words that drop to zero stay in the tree, since a BK-tree can't
+  // lose nodes, but are no longer suggested.
+  //
+  // Not thread safe.
+
+ public:
+  SpellingIndex();
+
+  // Words shorter than this are neither indexed nor corrected.
+  static const int kMinWordLength;
+
+  void Clear();
+  void AddSongs(const SongList& songs);
+  void RemoveSongs(const SongList& songs);
+  void AddWords(const QStringList& words, int count = 1);
+
+  // The number of distinct words that are currently suggested.
+  int count() const { return live_words_; }
+  bool Contains(const QString& word) const;
+
+  // Returns the known word nearest to word, preferring the more common word
+  // when there's a tie, or an empty string if there is none close enough.
+  QString Nearest(const QString& word) const;
+
+  // Returns the query with each word that doesn't start any known word
+  // replaced by its nearest known word.  Returns an empty string if the query
+  // is fine as it is or nothing could be corrected.
+  QString Correct(const QString& query) const;
+
+  // Splits text into lowercase words of kMinWordLength or more letters and
+  // digits.
+  static QStringList Words(const QString& text);
+  // The fields of a song whose words are indexed.
+  static QStringList SongFields(const Song& song);
+
+  static int Distance(const QString& a, const QString& b);
+
+ private:
+  struct Node {
+    QString word_;
+    int count_;
+    // Each child is (distance from word_, node index).
+    QVector<QPair<int, int>> children_;
+  };
+
+  static int MaxDistance(const QString& word);
+  void AddSong(const Song& song, int count);
+  void AddWord(const QString& word, int count);
+  bool StartsKnownWord(const QString& prefix) const;
+
+ private:
+  QVector<Node> nodes_;
+  // Node index of every word in the tree, sorted so that words starting with
+  // a prefix can be found.
+  QMap<QString, int> words_;
+  int live_words_;
+};
+
+#endif  // LIBRARY_SPELLINGINDEX_H_
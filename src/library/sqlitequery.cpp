@@ -0,0 +1,259 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sqlitequery.h"
+#include "core/logging.h"
+
+#include <sqlite3.h>
+
+#include <QSqlDriver>
+
+namespace {
+
+// How many virtual machine instructions sqlite runs between checks of the
+// cancel flag.
+const int kCancelCheckInterval = 1000;
+
+sqlite3* SqliteHandle(QSqlDatabase db) {
+  QVariant handle = db.driver()->handle();
+  if (!handle.isValid() || qstrcmp(handle.typeName(), "sqlite3*") != 0) {
+    return nullptr;
+  }
+  return *static_cast<sqlite3**>(handle.data());
+}
+
+}  // namespace
+
+SqliteCancelScope::SqliteCancelScope(QSqlDatabase db,
+                                     const QueryCancelFlag& flag)
+    : handle_(SqliteHandle(db)), flag_(flag) {
+  Install();
+}
+
+SqliteCancelScope::SqliteCancelScope(sqlite3* handle,
+                                     const QueryCancelFlag& flag)
+    : handle_(handle), flag_(flag) {
+  Install();
+}
+
+void SqliteCancelScope::Install() {
+  if (!handle_ || !flag_) return;
+  sqlite3_progress_handler(handle_, kCancelCheckInterval, &ProgressHandler,
+                           flag_.get());
+}
+
+SqliteCancelScope::~SqliteCancelScope() {
+  if (!handle_ || !flag_) return;
+  sqlite3_progress_handler(handle_, 0, nullptr, nullptr);
+}
+
+int SqliteCancelScope::ProgressHandler(void* flag) {
+  // Non-zero makes sqlite abandon the statement.
+  return static_cast<QAtomicInt*>(flag)->fetchAndAddRelaxed(0);
+}
+
+SqliteQuery::SqliteQuery(QSqlDatabase db, const QString& sql)
+    : db_(db),
+      sql_(sql),
+      handle_(nullptr),
+      stmt_(nullptr),
+      next_bind_index_(1),
+      has_error_(false),
+      cancelled_(false) {
+  handle_ = SqliteHandle(db_);
+  if (!handle_) {
+    has_error_ = true;
+    qLog(Error) << "Not an sqlite database:" << db_.connectionName();
+    return;
+  }
+
+  const int ret = sqlite3_prepare16_v2(handle_, sql_.utf16(),
+                                       sql_.size() * sizeof(QChar), &stmt_,
+                                       nullptr);
+  if (ret != SQLITE_OK) ReportError("prepare");
+}
+
+SqliteQuery::~SqliteQuery() {
+  // Harmless to call with a nullptr statement.
+  sqlite3_finalize(stmt_);
+}
+
+void SqliteQuery::AddBindValue(const QVariant& value) {
+  Bind(next_bind_index_++, value);
+}
+
+void SqliteQuery::BindValue(const QString& placeholder,
+                            const QVariant& value) {
+  if (!stmt_) return;
+  Bind(sqlite3_bind_parameter_index(stmt_, placeholder.toUtf8().constData()),
+       value);
+}
+
+void SqliteQuery::Bind(int index, const QVariant& value) {
+  if (!stmt_ || index <= 0) return;
+
+  int ret = SQLITE_OK;
+  if (value.isNull()) {
+    ret = sqlite3_bind_null(stmt_, index);
+  } else {
+    switch (value.type()) {
+      case QVariant::Bool:
+      case QVariant::Int:
+      case QVariant::UInt:
+      case QVariant::LongLong:
+      case QVariant::ULongLong:
+        ret = sqlite3_bind_int64(stmt_, index, value.toLongLong());
+        break;
+
+      case QVariant::Double:
+        ret = sqlite3_bind_double(stmt_, index, value.toDouble());
+        break;
+
+      case QVariant::ByteArray: {
+        const QByteArray data = value.toByteArray();
+        ret = sqlite3_bind_blob(stmt_, index, data.constData(), data.size(),
+                                SQLITE_TRANSIENT);
+        break;
+      }
+
+      default: {
+        const QString text = value.toString();
+        ret = sqlite3_bind_text16(stmt_, index, text.utf16(),
+                                  text.size() * sizeof(QChar),
+                                  SQLITE_TRANSIENT);
+        break;
+      }
+    }
+  }
+
+  if (ret != SQLITE_OK) ReportError("bind");
+}
+
+bool SqliteQuery::Exec() {
+  if (!stmt_) return false;
+  sqlite3_reset(stmt_);
+  cancelled_ = false;
+  return !has_error_;
+}
+
+bool SqliteQuery::Next() {
+  if (!stmt_ || has_error_ || cancelled_) return false;
+
+  // Checked here too, so a query that was cancelled before it got going
+  // doesn't return any rows.
+  if (SqliteCancelScope::IsCancelled(cancel_flag_)) {
+    cancelled_ = true;
+    return false;
+  }
+
+  int ret;
+  {
+    SqliteCancelScope scope(handle_, cancel_flag_);
+    ret = sqlite3_step(stmt_);
+  }
+
+  switch (ret) {
+    case SQLITE_ROW:
+      return true;
+    case SQLITE_DONE:
+      return false;
+    case SQLITE_INTERRUPT:
+      if (cancel_flag_) {
+        cancelled_ = true;
+        return false;
+      }
+    // fallthrough
+    default:
+      ReportError("step");
+      return false;
+  }
+}
+
+bool SqliteQuery::Run() {
+  if (!stmt_) return false;
+
+  bool ok = !has_error_;
+  if (ok) {
+    const int ret = sqlite3_step(stmt_);
+    if (ret != SQLITE_DONE && ret != SQLITE_ROW) {
+      ReportError("step");
+      ok = false;
+    }
+  }
+
+  // An error only fails this run, not the ones after it.
+  sqlite3_reset(stmt_);
+  next_bind_index_ = 1;
+  has_error_ = false;
+  return ok;
+}
+
+qint64 SqliteQuery::last_insert_id() const {
+  return handle_ ? sqlite3_last_insert_rowid(handle_) : -1;
+}
+
+int SqliteQuery::column_count() const {
+  return stmt_ ? sqlite3_column_count(stmt_) : 0;
+}
+
+bool SqliteQuery::IsNull(int column) const {
+  return sqlite3_column_type(stmt_, column) == SQLITE_NULL;
+}
+
+int SqliteQuery::Int(int column) const {
+  return sqlite3_column_int(stmt_, column);
+}
+
+qint64 SqliteQuery::LongLong(int column) const {
+  return sqlite3_column_int64(stmt_, column);
+}
+
+double SqliteQuery::Double(int column) const {
+  return sqlite3_column_double(stmt_, column);
+}
+
+QString SqliteQuery::String(int column) const {
+  // The text has to be fetched before its length.
+  const void* text = sqlite3_column_text16(stmt_, column);
+  if (!text) return QString();
+
+  return QString(static_cast<const QChar*>(text),
+                 sqlite3_column_bytes16(stmt_, column) / sizeof(QChar));
+}
+
+QVariant SqliteQuery::Value(int column) const {
+  switch (sqlite3_column_type(stmt_, column)) {
+    case SQLITE_INTEGER:
+      return LongLong(column);
+    case SQLITE_FLOAT:
+      return Double(column);
+    case SQLITE_BLOB:
+      return QByteArray(
+          static_cast<const char*>(sqlite3_column_blob(stmt_, column)),
+          sqlite3_column_bytes(stmt_, column));
+    case SQLITE_NULL:
+      return QVariant();
+    default:
+      return String(column);
+  }
+}
+
+void SqliteQuery::ReportError(const char* what) {
+  has_error_ = true;
+  qLog(Error) << "db error:" << what << sqlite3_errmsg(handle_);
+  qLog(Error) << "faulty query:" << sql_;
+}
@@ -0,0 +1,119 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SQLITEQUERY_H
+#define SQLITEQUERY_H
+
+#include <memory>
+
+#include <QAtomicInt>
+#include <QSqlDatabase>
+#include <QString>
+#include <QVariant>
+
+#include <boost/noncopyable.hpp>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// Shared between the thread that runs a query and the one that wants to stop
+// it.  Setting it to 1 from any thread makes the query finish early.
+typedef std::shared_ptr<QAtomicInt> QueryCancelFlag;
+
+// While one of these is in scope, any statement running on the connection
+// stops with SQLITE_INTERRUPT soon after the flag is set.  This is used
+// instead of sqlite3_interrupt() because the connection might already have
+// moved on to somebody else's query by the time the flag is set, and this
+// way only statements stepped inside the scope are affected.  sqlite keeps
+// one progress handler per connection, so scopes can't be nested.
+class SqliteCancelScope : boost::noncopyable {
+ public:
+  SqliteCancelScope(QSqlDatabase db, const QueryCancelFlag& flag);
+  SqliteCancelScope(sqlite3* handle, const QueryCancelFlag& flag);
+  ~SqliteCancelScope();
+
+  static bool IsCancelled(const QueryCancelFlag& flag) {
+    return flag && flag->fetchAndAddRelaxed(0);
+  }
+
+ private:
+  void Install();
+  static int ProgressHandler(void* flag);
+
+  sqlite3* handle_;
+  QueryCancelFlag flag_;
+};
+
+// A forward-only query that steps the sqlite statement itself instead of
+// going through QSqlQuery.  QSqlQuery copies every column of every row into a
+// QVariant, which is most of the cost of loading a lot of songs.  The typed
+// accessors here read the column straight from the statement.
+//
+// The database must be an sqlite connection opened by Database.  Errors are
+// logged.
+class SqliteQuery : boost::noncopyable {
+ public:
+  SqliteQuery(QSqlDatabase db, const QString& sql);
+  ~SqliteQuery();
+
+  // Binds the next ? placeholder, or a named one like :id.
+  void AddBindValue(const QVariant& value);
+  void BindValue(const QString& placeholder, const QVariant& value);
+
+  // Returns false if the statement couldn't be prepared.  Rows are fetched
+  // by Next().
+  bool Exec();
+  bool Next();
+
+  // Runs a statement that doesn't return rows, like an INSERT, and resets it
+  // so the next set of values can be bound.  Returns false on error.
+  bool Run();
+  qint64 last_insert_id() const;
+
+  // Once the flag is set Next() returns false as if there were no more rows,
+  // and cancelled() returns true.  Nothing is logged.
+  void set_cancel_flag(const QueryCancelFlag& flag) { cancel_flag_ = flag; }
+  bool cancelled() const { return cancelled_; }
+
+  bool has_error() const { return has_error_; }
+  int column_count() const;
+
+  bool IsNull(int column) const;
+  int Int(int column) const;
+  qint64 LongLong(int column) const;
+  double Double(int column) const;
+  QString String(int column) const;
+
+  // Like QSqlQuery::value.  Slower than the typed accessors.
+  QVariant Value(int column) const;
+
+ private:
+  void Bind(int index, const QVariant& value);
+  void ReportError(const char* what);
+
+  QSqlDatabase db_;
+  QString sql_;
+  sqlite3* handle_;
+  sqlite3_stmt* stmt_;
+  int next_bind_index_;
+  bool has_error_;
+
+  QueryCancelFlag cancel_flag_;
+  bool cancelled_;
+};
+
+#endif  // SQLITEQUERY_H
@@ -16,14 +16,22 @@
 */
 
 #include "libraryquery.h"
+#include "sqlitequery.h"
 #include "sqlrow.h"
 
 #include <QSqlQuery>
 #include <QSqlRecord>
 
-SqlRow::SqlRow(const QSqlQuery& query) { Init(query); }
+SqlRow::SqlRow() : query_(nullptr) {}
 
-SqlRow::SqlRow(const LibraryQuery& query) { Init(query); }
+SqlRow::SqlRow(const QSqlQuery& query) : query_(nullptr) { Init(query); }
+
+SqlRow::SqlRow(const LibraryQuery& query) : query_(&query.query()) {}
+
+SqlRow::SqlRow(const SqliteQuery& query) : query_(&query) {}
+
+SqlRow::SqlRow(const QList<QVariant>& columns)
+    : query_(nullptr), columns_(columns) {}
 
 void SqlRow::Init(const QSqlQuery& query) {
   int rows = query.record().count();
@@ -31,3 +39,20 @@ void SqlRow::Init(const QSqlQuery& query) {
     columns_ << query.value(i);
   }
 }
+
+QVariant SqlRow::value(int i) const {
+  return query_ ? query_->Value(i) : columns_[i];
+}
+
+QList<QVariant> SqlRow::values() const { return Detached().columns_; }
+
+SqlRow SqlRow::Detached() const {
+  if (!query_) return *this;
+
+  SqlRow ret;
+  const int columns = query_->column_count();
+  for (int i = 0; i < columns; ++i) {
+    ret.columns_ << query_->Value(i);
+  }
+  return ret;
+}
@@ -24,20 +24,36 @@
 class QSqlQuery;
 
 class LibraryQuery;
+class SqliteQuery;
 
 class SqlRow {
  public:
-  // WARNING: Implicit construction from QSqlQuery and LibraryQuery.
+  // WARNING: Implicit construction from QSqlQuery, LibraryQuery and
+  // SqliteQuery.
   SqlRow(const QSqlQuery& query);
+  // Rows made from a LibraryQuery or a SqliteQuery don't copy anything.  They
+  // read from the query's current row, so they're only valid until it moves
+  // on.  Use Detached() to keep one.
   SqlRow(const LibraryQuery& query);
+  SqlRow(const SqliteQuery& query);
+  // A row holding these values.
+  explicit SqlRow(const QList<QVariant>& columns);
 
-  const QVariant& value(int i) const { return columns_[i]; }
+  QVariant value(int i) const;
+  QList<QVariant> values() const;
+
+  // The query this row reads from, or nullptr if the row holds a copy.
+  const SqliteQuery* query() const { return query_; }
+
+  // Returns a copy of the row that stays valid after the query moves on.
+  SqlRow Detached() const;
 
  private:
   SqlRow();
 
   void Init(const QSqlQuery& query);
 
+  const SqliteQuery* query_;
   QList<QVariant> columns_;
 };
 
@@ -47,6 +47,7 @@
 #include "core/commandlineoptions.h"
 #include "core/crashreporting.h"
 #include "core/database.h"
+#include "core/headlesscontroller.h"
 #include "core/logging.h"
 #include "core/mac_startup.h"
 #include "core/metatypes.h"
@@ -54,6 +55,7 @@
 #include "core/networkproxyfactory.h"
 #include "core/potranslator.h"
 #include "core/song.h"
+#include "core/tracing.h"
 #include "core/ubuntuunityhack.h"
 #include "core/utilities.h"
 #include "engines/enginebase.h"
@@ -297,6 +299,9 @@ int main(int argc, char* argv[]) {
     // full QApplication so it works without an X server
     if (!options.Parse()) return 1;
     logging::SetLevels(options.log_levels());
+    if (!options.trace_file().isEmpty()) {
+      tracing::Start(options.trace_file());
+    }
 
     if (a.isRunning()) {
       if (options.is_empty()) {
@@ -332,7 +337,9 @@ int main(int argc, char* argv[]) {
 
   IncreaseFDLimit();
 
-  QtSingleApplication a(argc, argv);
+  // In headless mode QApplication is created without the GUI so nothing
+  // needs a display.
+  QtSingleApplication a(argc, argv, !options.headless());
 
 #ifdef HAVE_LIBLASTFM
   lastfm::ws::ApiKey = LastFMService::kApiKey;
@@ -442,37 +449,49 @@ int main(int argc, char* argv[]) {
   QNetworkProxyFactory::setApplicationProxyFactory(
       NetworkProxyFactory::Instance());
 
-#ifdef Q_OS_LINUX
-  // In 11.04 Ubuntu decided that the system tray should be reserved for certain
-  // whitelisted applications.  Clementine will override this setting and insert
-  // itself into the list of whitelisted apps.
-  UbuntuUnityHack hack;
-#endif  // Q_OS_LINUX
-
-  // Create the tray icon and OSD
-  std::unique_ptr<SystemTrayIcon> tray_icon(
-      SystemTrayIcon::CreateSystemTrayIcon());
-  OSD osd(tray_icon.get(), &app);
-
 #ifdef HAVE_DBUS
   mpris::Mpris mpris(&app);
 #endif
 
-  // Window
-  MainWindow w(&app, tray_icon.get(), &osd, options);
+  std::unique_ptr<SystemTrayIcon> tray_icon;
+  std::unique_ptr<OSD> osd;
+  std::unique_ptr<MainWindow> w;
+  std::unique_ptr<HeadlessController> headless;
+
+  if (options.headless()) {
+    headless.reset(new HeadlessController(&app, options));
+    QObject::connect(&a, SIGNAL(messageReceived(QByteArray)), headless.get(),
+                     SLOT(CommandlineOptionsReceived(QByteArray)));
+  } else {
+#ifdef Q_OS_LINUX
+    // In 11.04 Ubuntu decided that the system tray should be reserved for
+    // certain whitelisted applications.  Clementine will override this setting
+    // and insert itself into the list of whitelisted apps.
+    UbuntuUnityHack hack;
+#endif  // Q_OS_LINUX
+
+    // Create the tray icon and OSD
+    tray_icon.reset(SystemTrayIcon::CreateSystemTrayIcon());
+    osd.reset(new OSD(tray_icon.get(), &app));
+
+    // Window
+    w.reset(new MainWindow(&app, tray_icon.get(), osd.get(), options));
 #ifdef Q_OS_DARWIN
-  mac::EnableFullScreen(w);
+    mac::EnableFullScreen(*w);
 #endif  // Q_OS_DARWIN
+#ifdef HAVE_DBUS
+    QObject::connect(&mpris, SIGNAL(RaiseMainWindow()), w.get(),
+                     SLOT(Raise()));
+#endif
+    QObject::connect(&a, SIGNAL(messageReceived(QByteArray)), w.get(),
+                     SLOT(CommandlineOptionsReceived(QByteArray)));
+  }
 #ifdef HAVE_GIO
   ScanGIOModulePath();
 #endif
-#ifdef HAVE_DBUS
-  QObject::connect(&mpris, SIGNAL(RaiseMainWindow()), &w, SLOT(Raise()));
-#endif
-  QObject::connect(&a, SIGNAL(messageReceived(QByteArray)), &w,
-                   SLOT(CommandlineOptionsReceived(QByteArray)));
 
   int ret = a.exec();
+  tracing::Stop();
 
 #ifdef Q_OS_LINUX
   // The nvidia driver would cause Clementine (or any application that used
@@ -30,6 +30,8 @@ static const int sBarkBandCount = arraysize(sBarkBands);
 
 }  // namespace
 
+const int MoodbarBuilder::kBarkBandCount = sBarkBandCount;
+
 MoodbarBuilder::MoodbarBuilder() : bands_(0), rate_hz_(0) {}
 
 int MoodbarBuilder::BandFrequency(int band) const {
@@ -54,13 +56,13 @@ void MoodbarBuilder::Init(int bands, int rate_hz) {
   }
 }
 
-void MoodbarBuilder::AddFrame(const double* magnitudes, int size) {
+bool MoodbarBuilder::BarkBands(const double* magnitudes, int size,
+                               double* bands) const {
   if (size > barkband_table_.length()) {
-    return;
+    return false;
   }
 
   // Calculate total magnitudes for different bark bands.
-  double bands[sBarkBandCount];
   for (int i = 0; i < sBarkBandCount; ++i) {
     bands[i] = 0.0;
   }
@@ -68,6 +70,14 @@ void MoodbarBuilder::AddFrame(const double* magnitudes, int size) {
   for (int i = 0; i < size; ++i) {
     bands[barkband_table_[i]] += magnitudes[i];
   }
+  return true;
+}
+
+void MoodbarBuilder::AddFrame(const double* magnitudes, int size) {
+  double bands[sBarkBandCount];
+  if (!BarkBands(magnitudes, size, bands)) {
+    return;
+  }
 
   // Now divide the bark bands into thirds and compute their total amplitudes.
   double rgb[] = {0, 0, 0};
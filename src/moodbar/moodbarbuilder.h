@@ -25,10 +25,17 @@ class MoodbarBuilder {
  public:
   MoodbarBuilder();
 
+  static const int kBarkBandCount;
+
   void Init(int bands, int rate_hz);
   void AddFrame(const double* magnitudes, int size);
   QByteArray Finish(int width);
 
+  // Adds up the magnitudes of one frame of the spectrum into kBarkBandCount
+  // bands, the way AddFrame does before working out the colours.  Returns
+  // false if there are more magnitudes than Init was told about.
+  bool BarkBands(const double* magnitudes, int size, double* bands) const;
+
  private:
   struct Rgb {
     Rgb() : r(0), g(0), b(0) {}
@@ -22,6 +22,7 @@
 #include "core/closure.h"
 #include "core/logging.h"
 #include "core/player.h"
+#include "core/song.h"
 #include "playlist/playlistmanager.h"
 
 MoodbarController::MoodbarController(Application* app, QObject* parent)
@@ -29,6 +30,15 @@ MoodbarController::MoodbarController(Application* app, QObject* parent)
   connect(app_->playlist_manager(), SIGNAL(CurrentSongChanged(Song)),
           SLOT(CurrentSongChanged(Song)));
   connect(app_->player(), SIGNAL(Stopped()), SLOT(PlaybackStopped()));
+
+  // This isn't created until after startup, when a song might be playing
+  // already.  Load its moodbar once whoever created us has connected to
+  // CurrentMoodbarDataChanged.
+  PlaylistItemPtr item = app_->player()->GetCurrentItem();
+  if (item && app_->player()->GetState() != Engine::Empty) {
+    QMetaObject::invokeMethod(this, "CurrentSongChanged", Qt::QueuedConnection,
+                              Q_ARG(Song, item->Metadata()));
+  }
 }
 
 void MoodbarController::CurrentSongChanged(const Song& song) {
@@ -40,16 +50,20 @@ void MoodbarController::CurrentSongChanged(const Song& song) {
   switch (result) {
     case MoodbarLoader::CannotLoad:
       emit CurrentMoodbarDataChanged(QByteArray());
+      emit CurrentWaveformDataChanged(QByteArray());
       break;
 
     case MoodbarLoader::Loaded:
       emit CurrentMoodbarDataChanged(data);
+      emit CurrentWaveformDataChanged(
+          app_->moodbar_loader()->LoadWaveform(song.url()));
       break;
 
     case MoodbarLoader::WillLoadAsync:
       // Emit an empty array for now so the GUI reverts to a normal progress
       // bar.  Our slot will be called when the data is actually loaded.
       emit CurrentMoodbarDataChanged(QByteArray());
+      emit CurrentWaveformDataChanged(QByteArray());
 
       NewClosure(pipeline, SIGNAL(Finished(bool)), this,
                  SLOT(AsyncLoadComplete(MoodbarPipeline*, QUrl)), pipeline,
@@ -60,6 +74,7 @@ void MoodbarController::CurrentSongChanged(const Song& song) {
 
 void MoodbarController::PlaybackStopped() {
   emit CurrentMoodbarDataChanged(QByteArray());
+  emit CurrentWaveformDataChanged(QByteArray());
 }
 
 void MoodbarController::AsyncLoadComplete(MoodbarPipeline* pipeline,
@@ -81,4 +96,5 @@ void MoodbarController::AsyncLoadComplete(MoodbarPipeline* pipeline,
   }
 
   emit CurrentMoodbarDataChanged(pipeline->data());
+  emit CurrentWaveformDataChanged(pipeline->waveform());
 }
@@ -34,6 +34,8 @@ class MoodbarController : public QObject {
 
 signals:
   void CurrentMoodbarDataChanged(const QByteArray& data);
+  // See WaveformBuilder for the format.  Empty if there's no waveform.
+  void CurrentWaveformDataChanged(const QByteArray& data);
 
  private slots:
   void CurrentSongChanged(const Song& song);
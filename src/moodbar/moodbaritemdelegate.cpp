@@ -27,6 +27,7 @@
 
 #include <QApplication>
 #include <QPainter>
+#include <QPixmapCache>
 #include <QSettings>
 #include <QSortFilterProxyModel>
 #include <QtConcurrentRun>
@@ -86,17 +87,30 @@ QPixmap MoodbarItemDelegate::PixmapForIndex(const QModelIndex& index,
   data->indexes_.insert(index);
   data->desired_size_ = size;
 
+  QPixmap cached_pixmap;
   switch (data->state_) {
     case Data::State_CannotLoad:
     case Data::State_LoadingData:
     case Data::State_LoadingColors:
-    case Data::State_LoadingImage:
       return data->pixmap_;
 
+    case Data::State_LoadingImage:
     case Data::State_Loaded:
       // Is the pixmap the right size?
-      if (data->pixmap_.size() != size) {
-        StartLoadingImage(url, data);
+      if (data->pixmap_.size() == size) {
+        return data->pixmap_;
+      }
+
+      // Maybe it was rendered at this size before, or by another view.
+      if (QPixmapCache::find(PixmapCacheKey(url, size), &cached_pixmap)) {
+        data->pixmap_ = cached_pixmap;
+      } else if (data->state_ == Data::State_Loaded) {
+        if (data->colors_.isEmpty()) {
+          // The pixmap came from the cache, so the colors were never loaded.
+          StartLoadingData(url, data);
+        } else {
+          StartLoadingImage(url, data);
+        }
       }
 
       return data->pixmap_;
@@ -105,6 +119,14 @@ QPixmap MoodbarItemDelegate::PixmapForIndex(const QModelIndex& index,
       break;
   }
 
+  // Scrolling back to a song that fell out of data_ shouldn't mean loading
+  // it all again.
+  if (QPixmapCache::find(PixmapCacheKey(url, size), &cached_pixmap)) {
+    data->pixmap_ = cached_pixmap;
+    data->state_ = Data::State_Loaded;
+    return cached_pixmap;
+  }
+
   // We have to start loading the data from scratch.
   StartLoadingData(url, data);
 
@@ -135,6 +157,15 @@ void MoodbarItemDelegate::StartLoadingData(const QUrl& url, Data* data) {
   }
 }
 
+QString MoodbarItemDelegate::PixmapCacheKey(const QUrl& url,
+                                            const QSize& size) const {
+  return QString("moodbar:%1:%2x%3:%4")
+      .arg(style_)
+      .arg(size.width())
+      .arg(size.height())
+      .arg(url.toString());
+}
+
 bool MoodbarItemDelegate::RemoveFromCacheIfIndexesInvalid(const QUrl& url,
                                                           Data* data) {
   for (const QPersistentModelIndex& index : data->indexes_) {
@@ -235,6 +266,9 @@ void MoodbarItemDelegate::ImageLoaded(const QUrl& url, QFuture<QImage> future) {
 
   data->pixmap_ = QPixmap::fromImage(image);
   data->state_ = Data::State_Loaded;
+  if (!data->pixmap_.isNull()) {
+    QPixmapCache::insert(PixmapCacheKey(url, image.size()), data->pixmap_);
+  }
 
   Playlist* playlist = view_->playlist();
   const QSortFilterProxyModel* filter = playlist->proxy();
@@ -71,6 +71,9 @@ class MoodbarItemDelegate : public QItemDelegate {
 
  private:
   QPixmap PixmapForIndex(const QModelIndex& index, const QSize& size);
+  // Rendered pixmaps go in QPixmapCache as well, so they're shared between
+  // playlist views and outlive the entries in data_.
+  QString PixmapCacheKey(const QUrl& url, const QSize& size) const;
   void StartLoadingData(const QUrl& url, Data* data);
   void StartLoadingColors(const QUrl& url, const QByteArray& bytes, Data* data);
   void StartLoadingImage(const QUrl& url, Data* data);
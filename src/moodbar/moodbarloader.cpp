@@ -23,6 +23,7 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QNetworkDiskCache>
+#include <QSettings>
 #include <QTimer>
 #include <QThread>
 #include <QUrl>
@@ -31,8 +32,12 @@
 #include "core/application.h"
 #include "core/closure.h"
 #include "core/logging.h"
+#include "core/player.h"
 #include "core/qhash_qurl.h"
+#include "core/threadpools.h"
 #include "core/utilities.h"
+#include "library/librarybackend.h"
+#include "library/libraryquery.h"
 
 #ifdef Q_OS_WIN32
 #include <windows.h>
@@ -40,17 +45,30 @@
 
 MoodbarLoader::MoodbarLoader(Application* app, QObject* parent)
     : QObject(parent),
+      app_(app),
       cache_(new QNetworkDiskCache(this)),
       thread_(new QThread(this)),
-      kMaxActiveRequests(qMax(1, QThread::idealThreadCount() / 2)),
+      max_active_requests_(qMax(1, QThread::idealThreadCount() / 2)),
+      precomputing_library_(false),
       save_alongside_originals_(false),
-      disable_moodbar_calculation_(false) {
+      disable_moodbar_calculation_(false),
+      precompute_library_(false) {
+  // The old per-URL cache is only read from now, so moodbars calculated by
+  // earlier versions aren't lost.  New data goes into the store.
   cache_->setCacheDirectory(
       Utilities::GetConfigPath(Utilities::Path_MoodbarCache));
   cache_->setMaximumCacheSize(60 * 1024 *
                               1024);  // 60MB - enough for 20,000 moodbars
 
+  const QString cache_root =
+      Utilities::GetConfigPath(Utilities::Path_CacheRoot);
+  QDir().mkpath(cache_root);
+  store_.Open(cache_root + "/" + MoodbarStore::kFilename);
+  waveform_store_.Open(cache_root + "/" + MoodbarStore::kWaveformFilename);
+
   connect(app, SIGNAL(SettingsChanged()), SLOT(ReloadSettings()));
+  connect(app->player(), SIGNAL(Paused()), SLOT(MaybeTakeNextRequest()));
+  connect(app->player(), SIGNAL(Stopped()), SLOT(MaybeTakeNextRequest()));
   ReloadSettings();
 }
 
@@ -66,6 +84,18 @@ void MoodbarLoader::ReloadSettings() {
       s.value("save_alongside_originals", false).toBool();
 
   disable_moodbar_calculation_ = !s.value("calculate", true).toBool();
+  max_active_requests_ =
+      qMax(1, s.value("workers", QThread::idealThreadCount() / 2).toInt());
+
+  precompute_library_ = s.value("precompute_library", false).toBool();
+  if (!precompute_library_) {
+    background_requests_.clear();
+  } else if (!precomputing_library_) {
+    // Give the library a moment to finish loading before scanning it.
+    precomputing_library_ = true;
+    QTimer::singleShot(30000, this, SLOT(PrecomputeLibrary()));
+  }
+
   MaybeTakeNextRequest();
 }
 
@@ -94,6 +124,22 @@ MoodbarLoader::Result MoodbarLoader::Load(const QUrl& url, QByteArray* data,
     return WillLoadAsync;
   }
 
+  if (LoadExisting(url, data)) {
+    return Loaded;
+  }
+
+  // There was no existing file, analyze the audio file and create one.
+  MoodbarPipeline* pipeline = CreatePipeline(url);
+  background_requests_.removeAll(url);
+  queued_requests_ << url;
+
+  MaybeTakeNextRequest();
+
+  *async_pipeline = pipeline;
+  return WillLoadAsync;
+}
+
+bool MoodbarLoader::LoadExisting(const QUrl& url, QByteArray* data) {
   // Check if a mood file exists for this file already
   const QString filename(url.toLocalFile());
 
@@ -102,46 +148,76 @@ MoodbarLoader::Result MoodbarLoader::Load(const QUrl& url, QByteArray* data,
     if (f.open(QIODevice::ReadOnly)) {
       qLog(Info) << "Loading moodbar data from" << possible_mood_file;
       *data = f.readAll();
-      return Loaded;
+      return true;
     }
   }
 
-  // Maybe it exists in the cache?
+  // Maybe it exists in the store?
+  const quint64 key = MoodbarStore::Fingerprint(filename);
+  if (key && store_.Find(key, data)) {
+    qLog(Info) << "Loading stored moodbar data for" << filename;
+    return true;
+  }
+
+  // Or in the cache left by an older version?
   std::unique_ptr<QIODevice> cache_device(cache_->data(url));
   if (cache_device) {
     qLog(Info) << "Loading cached moodbar data for" << filename;
     *data = cache_device->readAll();
     if (!data->isEmpty()) {
-      return Loaded;
+      if (key) store_.Insert(key, *data);
+      return true;
     }
   }
 
+  return false;
+}
+
+QByteArray MoodbarLoader::LoadWaveform(const QUrl& url) const {
+  QByteArray ret;
+  if (url.scheme() != "file") return ret;
+
+  const quint64 key = MoodbarStore::Fingerprint(url.toLocalFile());
+  if (key) waveform_store_.Find(key, &ret);
+  return ret;
+}
+
+qint64 MoodbarLoader::memory_usage() const {
+  return store_.memory_usage() + waveform_store_.memory_usage();
+}
+
+MoodbarPipeline* MoodbarLoader::CreatePipeline(const QUrl& url) {
   if (!thread_->isRunning()) thread_->start(QThread::IdlePriority);
 
-  // There was no existing file, analyze the audio file and create one.
   MoodbarPipeline* pipeline = new MoodbarPipeline(url);
   pipeline->moveToThread(thread_);
   NewClosure(pipeline, SIGNAL(Finished(bool)), this,
              SLOT(RequestFinished(MoodbarPipeline*, QUrl)), pipeline, url);
 
   requests_[url] = pipeline;
-  queued_requests_ << url;
-
-  MaybeTakeNextRequest();
-
-  *async_pipeline = pipeline;
-  return WillLoadAsync;
+  return pipeline;
 }
 
 void MoodbarLoader::MaybeTakeNextRequest() {
   Q_ASSERT(QThread::currentThread() == qApp->thread());
 
-  if (active_requests_.count() >= kMaxActiveRequests ||
-      queued_requests_.isEmpty() || disable_moodbar_calculation_) {
+  if (active_requests_.count() >= max_active_requests_ ||
+      disable_moodbar_calculation_) {
+    return;
+  }
+
+  QUrl url;
+  if (!queued_requests_.isEmpty()) {
+    url = queued_requests_.takeFirst();
+  } else if (!background_requests_.isEmpty() &&
+             app_->player()->GetState() != Engine::Playing) {
+    // Library precompute requests don't compete with playback for the disk.
+    url = background_requests_.takeFirst();
+    CreatePipeline(url);
+  } else {
     return;
   }
 
-  const QUrl url = queued_requests_.takeFirst();
   active_requests_ << url;
 
   qLog(Info) << "Creating moodbar data for" << url.toLocalFile();
@@ -155,14 +231,13 @@ void MoodbarLoader::RequestFinished(MoodbarPipeline* request, const QUrl& url) {
     qLog(Info) << "Moodbar data generated successfully for"
                << url.toLocalFile();
 
-    // Save the data in the cache
-    QNetworkCacheMetaData metadata;
-    metadata.setUrl(url);
-
-    QIODevice* cache_file = cache_->prepare(metadata);
-    if (cache_file) {
-      cache_file->write(request->data());
-      cache_->insert(cache_file);
+    // Save the data in the store
+    const quint64 key = MoodbarStore::Fingerprint(url.toLocalFile());
+    if (key) {
+      store_.Insert(key, request->data());
+      if (!request->waveform().isEmpty()) {
+        waveform_store_.Insert(key, request->waveform());
+      }
     }
 
     // Save the data alongside the original as well if we're configured to.
@@ -194,3 +269,65 @@ void MoodbarLoader::RequestFinished(MoodbarPipeline* request, const QUrl& url) {
 
   MaybeTakeNextRequest();
 }
+
+void MoodbarLoader::PrecomputeLibrary() {
+  if (!precompute_library_) {
+    precomputing_library_ = false;
+    return;
+  }
+
+  QFuture<QList<QUrl>> future =
+      ThreadPools::Run<QList<QUrl>>(
+          ThreadPools::Pool_Background,
+          std::bind(&MoodbarLoader::FindMissingMoodbars,
+                    app_->library_backend(), store_.keys()));
+  NewClosure(future, this,
+             SLOT(MissingMoodbarsFound(QFuture<QList<QUrl>>)), future);
+}
+
+void MoodbarLoader::MissingMoodbarsFound(QFuture<QList<QUrl>> future) {
+  precomputing_library_ = false;
+  if (!precompute_library_) return;
+
+  background_requests_.clear();
+  for (const QUrl& url : future.result()) {
+    if (!requests_.contains(url)) background_requests_ << url;
+  }
+
+  qLog(Info) << "Precomputing moodbars for" << background_requests_.count()
+             << "library files";
+
+  // Fill every free worker, not just one.
+  for (int i = active_requests_.count(); i < max_active_requests_; ++i) {
+    MaybeTakeNextRequest();
+  }
+}
+
+QList<QUrl> MoodbarLoader::FindMissingMoodbars(LibraryBackend* backend,
+                                               const QSet<quint64>& known) {
+  QList<QUrl> ret;
+
+  LibraryQuery q;
+  q.SetColumnSpec("filename");
+  if (!backend->ExecReadOnlyQuery(&q)) return ret;
+
+  while (q.Next()) {
+    const QUrl url = QUrl::fromEncoded(q.Value(0).toByteArray());
+    if (url.scheme() != "file") continue;
+
+    const QString filename = url.toLocalFile();
+    bool has_mood_file = false;
+    for (const QString& mood_filename : MoodFilenames(filename)) {
+      if (QFile::exists(mood_filename)) {
+        has_mood_file = true;
+        break;
+      }
+    }
+    if (has_mood_file) continue;
+
+    const quint64 key = MoodbarStore::Fingerprint(filename);
+    if (key && !known.contains(key)) ret << url;
+  }
+
+  return ret;
+}
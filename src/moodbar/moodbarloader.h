@@ -18,14 +18,18 @@
 #ifndef MOODBARLOADER_H
 #define MOODBARLOADER_H
 
+#include <QFuture>
 #include <QMap>
 #include <QObject>
 #include <QSet>
+#include <QUrl>
+
+#include "moodbarstore.h"
 
 class QNetworkDiskCache;
-class QUrl;
 
 class Application;
+class LibraryBackend;
 class MoodbarPipeline;
 
 class MoodbarLoader : public QObject {
@@ -50,6 +54,13 @@ class MoodbarLoader : public QObject {
 
   Result Load(const QUrl& url, QByteArray* data,
               MoodbarPipeline** async_pipeline);
+  // The waveform made along with url's moodbar, once Load has returned
+  // Loaded.  Empty if there isn't one, for example if the moodbar came from a
+  // .mood file or an older version.
+  QByteArray LoadWaveform(const QUrl& url) const;
+
+  // Roughly how many bytes the moodbar and waveform indexes take.
+  qint64 memory_usage() const;
 
  private slots:
   void ReloadSettings();
@@ -57,21 +68,40 @@ class MoodbarLoader : public QObject {
   void RequestFinished(MoodbarPipeline* request, const QUrl& filename);
   void MaybeTakeNextRequest();
 
+  void PrecomputeLibrary();
+  void MissingMoodbarsFound(QFuture<QList<QUrl>> future);
+
  private:
   static QStringList MoodFilenames(const QString& song_filename);
+  bool LoadExisting(const QUrl& url, QByteArray* data);
+  MoodbarPipeline* CreatePipeline(const QUrl& url);
+
+  // Returns the library's local files that don't have moodbar data yet.
+  // Runs in a worker thread.
+  static QList<QUrl> FindMissingMoodbars(LibraryBackend* backend,
+                                         const QSet<quint64>& known);
 
  private:
+  Application* app_;
   QNetworkDiskCache* cache_;
+  MoodbarStore store_;
+  MoodbarStore waveform_store_;
   QThread* thread_;
 
-  const int kMaxActiveRequests;
+  int max_active_requests_;
 
   QMap<QUrl, MoodbarPipeline*> requests_;
   QList<QUrl> queued_requests_;
   QSet<QUrl> active_requests_;
 
+  // Library files waiting for the background precompute.  These only start
+  // when nothing else is queued and nothing is playing.
+  QList<QUrl> background_requests_;
+  bool precomputing_library_;
+
   bool save_alongside_originals_;
   bool disable_moodbar_calculation_;
+  bool precompute_library_;
 };
 
 #endif  // MOODBARLOADER_H
@@ -26,11 +26,13 @@
 #include "core/timeconstants.h"
 #include "core/utilities.h"
 #include "moodbar/moodbarbuilder.h"
+#include "moodbar/waveformbuilder.h"
 
 #include "gst/moodbar/gstfastspectrum.h"
 
 bool MoodbarPipeline::sIsAvailable = false;
 const int MoodbarPipeline::kBands = 128;
+const int MoodbarPipeline::kWidth = 1000;
 
 MoodbarPipeline::MoodbarPipeline(const QUrl& local_filename)
     : QObject(nullptr),
@@ -90,9 +92,16 @@ void MoodbarPipeline::Start() {
     return;
   }
 
-  // Join them together
-  if (!gst_element_link(convert_element_, spectrum) ||
-      !gst_element_link(spectrum, fakesink)) {
+  // Join them together.  The spectrum takes floats as well as anything else,
+  // and the waveform is simpler to work out from them.
+  GstCaps* caps = gst_caps_new_simple("audio/x-raw", "format", G_TYPE_STRING,
+                                      "F32LE", nullptr);
+  const bool linked =
+      gst_element_link_filtered(convert_element_, spectrum, caps) &&
+      gst_element_link(spectrum, fakesink);
+  gst_caps_unref(caps);
+
+  if (!linked) {
     qLog(Error) << "Failed to link elements";
     pipeline_ = nullptr;
     emit Finished(false);
@@ -100,6 +109,13 @@ void MoodbarPipeline::Start() {
   }
 
   builder_.reset(new MoodbarBuilder);
+  waveform_builder_.reset(new WaveformBuilder);
+
+  // The waveform sees the same buffers as the spectrum
+  GstPad* pad = gst_element_get_static_pad(spectrum, "sink");
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, WaveformProbe, this,
+                    nullptr);
+  gst_object_unref(pad);
 
   // Set properties
   g_object_set(decodebin, "uri", local_filename_.toEncoded().constData(),
@@ -155,6 +171,22 @@ void MoodbarPipeline::NewPadCallback(GstElement*, GstPad* pad, gpointer data) {
   self->builder_->Init(kBands, rate);
 }
 
+GstPadProbeReturn MoodbarPipeline::WaveformProbe(GstPad*,
+                                                 GstPadProbeInfo* info,
+                                                 gpointer data) {
+  MoodbarPipeline* self = reinterpret_cast<MoodbarPipeline*>(data);
+  GstBuffer* buffer = gst_pad_probe_info_get_buffer(info);
+
+  GstMapInfo map;
+  if (gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+    self->waveform_builder_->AddSamples(
+        reinterpret_cast<const float*>(map.data), map.size / sizeof(float));
+    gst_buffer_unmap(buffer, &map);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
 GstBusSyncReply MoodbarPipeline::BusCallbackSync(GstBus*, GstMessage* msg,
                                                  gpointer data) {
   MoodbarPipeline* self = reinterpret_cast<MoodbarPipeline*>(data);
@@ -178,9 +210,13 @@ GstBusSyncReply MoodbarPipeline::BusCallbackSync(GstBus*, GstMessage* msg,
 void MoodbarPipeline::Stop(bool success) {
   success_ = success;
   if (builder_ != nullptr) {
-    data_ = builder_->Finish(1000);
+    data_ = builder_->Finish(kWidth);
     builder_.reset();
   }
+  if (waveform_builder_ != nullptr) {
+    waveform_ = waveform_builder_->Finish(kWidth);
+    waveform_builder_.reset();
+  }
 
   emit Finished(success);
 }
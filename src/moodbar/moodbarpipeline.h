@@ -27,8 +27,10 @@
 #include <memory>
 
 class MoodbarBuilder;
+class WaveformBuilder;
 
-// Creates moodbar data for a single local music file.
+// Creates moodbar data for a single local music file, and a waveform summary
+// from the same decode.
 class MoodbarPipeline : public QObject {
   Q_OBJECT
 
@@ -40,6 +42,8 @@ class MoodbarPipeline : public QObject {
 
   bool success() const { return success_; }
   const QByteArray& data() const { return data_; }
+  // See WaveformBuilder
+  const QByteArray& waveform() const { return waveform_; }
 
  public slots:
   void Start();
@@ -56,6 +60,8 @@ class MoodbarPipeline : public QObject {
 
   static void NewPadCallback(GstElement*, GstPad* pad, gpointer data);
   static GstFlowReturn NewBufferCallback(GstAppSink* app_sink, gpointer self);
+  static GstPadProbeReturn WaveformProbe(GstPad*, GstPadProbeInfo*,
+                                         gpointer self);
   static gboolean BusCallback(GstBus*, GstMessage* msg, gpointer data);
   static GstBusSyncReply BusCallbackSync(GstBus*, GstMessage* msg,
                                          gpointer data);
@@ -63,15 +69,18 @@ class MoodbarPipeline : public QObject {
  private:
   static bool sIsAvailable;
   static const int kBands;
+  static const int kWidth;
 
   QUrl local_filename_;
   GstElement* pipeline_;
   GstElement* convert_element_;
 
   std::unique_ptr<MoodbarBuilder> builder_;
+  std::unique_ptr<WaveformBuilder> waveform_builder_;
 
   bool success_;
   QByteArray data_;
+  QByteArray waveform_;
 };
 
 #endif  // MOODBARPIPELINE_H
@@ -0,0 +1,172 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "moodbarstore.h"
+
+#include <cstring>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFileInfo>
+
+#include "core/logging.h"
+
+const char* MoodbarStore::kFilename = "moodbars.db";
+const char* MoodbarStore::kWaveformFilename = "waveforms.db";
+
+const char MoodbarStore::kMagic[] = "CLMOOD01";
+const int MoodbarStore::kMagicLength = 8;
+const int MoodbarStore::kRecordHeaderLength =
+    sizeof(quint64) + sizeof(quint32);
+
+namespace {
+
+// How much of the start and end of each file goes into its fingerprint
+const int kFingerprintChunkSize = 4096;
+
+}  // namespace
+
+MoodbarStore::MoodbarStore() : map_(nullptr), map_size_(0) {}
+
+MoodbarStore::~MoodbarStore() {
+  if (map_) file_.unmap(map_);
+}
+
+bool MoodbarStore::Open(const QString& filename) {
+  file_.setFileName(filename);
+  if (!file_.open(QIODevice::ReadWrite)) {
+    qLog(Warning) << "Couldn't open moodbar store" << filename
+                  << file_.errorString();
+    return false;
+  }
+
+  if (file_.size() < kMagicLength) {
+    file_.resize(0);
+    file_.write(kMagic, kMagicLength);
+    file_.flush();
+  }
+
+  Remap();
+  if (!map_ || memcmp(map_, kMagic, kMagicLength) != 0) {
+    qLog(Warning) << "Not a moodbar store, starting a new one" << filename;
+    if (map_) file_.unmap(map_);
+    map_ = nullptr;
+    file_.resize(0);
+    file_.write(kMagic, kMagicLength);
+    file_.flush();
+    Remap();
+    if (!map_) return false;
+  }
+
+  // Read the index.  A record cut short by a crash is thrown away.
+  qint64 offset = kMagicLength;
+  while (offset + kRecordHeaderLength <= map_size_) {
+    quint64 key;
+    quint32 length;
+    memcpy(&key, map_ + offset, sizeof(key));
+    memcpy(&length, map_ + offset + sizeof(key), sizeof(length));
+
+    const qint64 data_offset = offset + kRecordHeaderLength;
+    if (data_offset + length > map_size_) break;
+
+    Entry entry;
+    entry.offset_ = data_offset;
+    entry.length_ = length;
+    index_[key] = entry;
+
+    offset = data_offset + length;
+  }
+
+  if (offset != map_size_) {
+    qLog(Warning) << "Truncating damaged moodbar store" << filename;
+    file_.unmap(map_);
+    map_ = nullptr;
+    file_.resize(offset);
+    Remap();
+  }
+
+  qLog(Debug) << "Opened moodbar store with" << index_.count() << "entries";
+  return true;
+}
+
+void MoodbarStore::Remap() {
+  if (map_) file_.unmap(map_);
+  map_size_ = file_.size();
+  map_ = file_.map(0, map_size_);
+}
+
+quint64 MoodbarStore::Fingerprint(const QString& filename) {
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly)) return 0;
+
+  const QFileInfo info(file);
+  QByteArray header;
+  QDataStream s(&header, QIODevice::WriteOnly);
+  s << info.size() << info.lastModified().toTime_t();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(header);
+  hash.addData(file.read(kFingerprintChunkSize));
+  if (file.size() > kFingerprintChunkSize * 2) {
+    file.seek(file.size() - kFingerprintChunkSize);
+  }
+  hash.addData(file.read(kFingerprintChunkSize));
+
+  quint64 ret;
+  memcpy(&ret, hash.result().constData(), sizeof(ret));
+  return ret == 0 ? 1 : ret;
+}
+
+bool MoodbarStore::Find(quint64 key, QByteArray* data) const {
+  auto it = index_.find(key);
+  if (it == index_.end() || !map_) return false;
+
+  *data = QByteArray(reinterpret_cast<const char*>(map_ + it->offset_),
+                     it->length_);
+  return true;
+}
+
+void MoodbarStore::Insert(quint64 key, const QByteArray& data) {
+  if (!file_.isOpen() || index_.contains(key)) return;
+
+  const quint32 length = data.length();
+  const qint64 offset = file_.size();
+  file_.seek(offset);
+  file_.write(reinterpret_cast<const char*>(&key), sizeof(key));
+  file_.write(reinterpret_cast<const char*>(&length), sizeof(length));
+  file_.write(data);
+  file_.flush();
+
+  Entry entry;
+  entry.offset_ = offset + kRecordHeaderLength;
+  entry.length_ = length;
+  index_[key] = entry;
+
+  Remap();
+}
+
+QSet<quint64> MoodbarStore::keys() const {
+  return QSet<quint64>::fromList(index_.keys());
+}
+
+qint64 MoodbarStore::memory_usage() const {
+  // Each QHash node has a next pointer and the hash as well as the key and
+  // value, and there's a bucket pointer for every slot.
+  return qint64(index_.count()) *
+             (sizeof(void*) + sizeof(uint) + sizeof(quint64) + sizeof(Entry)) +
+         qint64(index_.capacity()) * sizeof(void*);
+}
@@ -0,0 +1,77 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MOODBARSTORE_H
+#define MOODBARSTORE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+// A single append-only file of moodbar data, read through a memory map.
+// Entries are keyed by a fingerprint of the audio file's contents and
+// modification time rather than by its path, so moving or renaming a file
+// doesn't mean its moodbar has to be calculated again.
+//
+// On disk it's a header followed by records of
+//   quint64 key, quint32 length, length bytes of moodbar data
+// Only the key index is held in memory.
+class MoodbarStore {
+ public:
+  MoodbarStore();
+  ~MoodbarStore();
+
+  static const char* kFilename;
+  // Waveforms are kept in a store of their own, under the same keys.
+  static const char* kWaveformFilename;
+
+  // Returns false if the file couldn't be opened or created.
+  bool Open(const QString& filename);
+
+  // Returns 0 if the file can't be read.  Safe to call from any thread.
+  static quint64 Fingerprint(const QString& filename);
+
+  bool Find(quint64 key, QByteArray* data) const;
+  void Insert(quint64 key, const QByteArray& data);
+
+  QSet<quint64> keys() const;
+
+  // Roughly how many bytes the index takes.  The mapped file is paged in and
+  // out by the kernel so it isn't counted.
+  qint64 memory_usage() const;
+
+ private:
+  struct Entry {
+    qint64 offset_;
+    int length_;
+  };
+
+  void Remap();
+
+  static const char kMagic[];
+  static const int kMagicLength;
+  static const int kRecordHeaderLength;
+
+  QFile file_;
+  uchar* map_;
+  qint64 map_size_;
+  QHash<quint64, Entry> index_;
+};
+
+#endif  // MOODBARSTORE_H
@@ -0,0 +1,72 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "waveformbuilder.h"
+
+#include <cmath>
+
+const int WaveformBuilder::kFrameSamples = 4096;
+
+WaveformBuilder::WaveformBuilder() {}
+
+void WaveformBuilder::AddSamples(const float* samples, int count) {
+  for (int i = 0; i < count; ++i) {
+    const float value = std::fabs(samples[i]);
+    current_.peak_ = qMax(current_.peak_, value);
+    current_.sum_squares_ += double(value) * value;
+
+    if (++current_.count_ == kFrameSamples) {
+      frames_ << current_;
+      current_ = Frame();
+    }
+  }
+}
+
+QByteArray WaveformBuilder::Finish(int width) {
+  if (current_.count_) {
+    frames_ << current_;
+    current_ = Frame();
+  }
+
+  QByteArray ret;
+  if (frames_.isEmpty()) return ret;
+
+  ret.resize(width * 2);
+  char* data = ret.data();
+
+  for (int i = 0; i < width; ++i) {
+    int start = i * frames_.count() / width;
+    int end = (i + 1) * frames_.count() / width;
+    if (start == end) {
+      end = start + 1;
+    }
+
+    Frame bucket;
+    for (int j = start; j < end; ++j) {
+      const Frame& frame = frames_[j];
+      bucket.peak_ = qMax(bucket.peak_, frame.peak_);
+      bucket.sum_squares_ += frame.sum_squares_;
+      bucket.count_ += frame.count_;
+    }
+
+    const double rms = std::sqrt(bucket.sum_squares_ / bucket.count_);
+    *(data++) = qBound(0, int(bucket.peak_ * 255), 255);
+    *(data++) = qBound(0, int(rms * 255), 255);
+  }
+
+  return ret;
+}
@@ -0,0 +1,63 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WAVEFORMBUILDER_H
+#define WAVEFORMBUILDER_H
+
+#include <QByteArray>
+#include <QList>
+
+// Summarises a track's loudness for the track slider, from the same decoded
+// samples that MoodbarBuilder gets the spectrum of.
+//
+// The data is one pair of bytes per bucket, the peak then the RMS level, each
+// scaled from 0 to 255.
+class WaveformBuilder {
+ public:
+  WaveformBuilder();
+
+  // Interleaved float samples, from -1.0 to 1.0.  Called from the streaming
+  // thread.
+  void AddSamples(const float* samples, int count);
+  QByteArray Finish(int width);
+
+  static int BucketCount(const QByteArray& data) { return data.size() / 2; }
+  static float Peak(const QByteArray& data, int bucket) {
+    return quint8(data[bucket * 2]) / 255.0;
+  }
+  static float Rms(const QByteArray& data, int bucket) {
+    return quint8(data[bucket * 2 + 1]) / 255.0;
+  }
+
+ private:
+  struct Frame {
+    Frame() : peak_(0), sum_squares_(0), count_(0) {}
+
+    float peak_;
+    double sum_squares_;
+    int count_;
+  };
+
+  // Samples are collected into frames of this many, and the frames are shared
+  // out between the buckets once the length of the track is known.
+  static const int kFrameSamples;
+
+  QList<Frame> frames_;
+  Frame current_;
+};
+
+#endif  // WAVEFORMBUILDER_H
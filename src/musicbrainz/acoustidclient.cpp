@@ -20,6 +20,7 @@
 #include <QCoreApplication>
 #include <QNetworkReply>
 #include <QStringList>
+#include <QTimer>
 
 #include <qjson/parser.h>
 
@@ -32,39 +33,96 @@ const char* AcoustidClient::kClientId = "qsZGpeLx";
 const char* AcoustidClient::kUrl = "http://api.acoustid.org/v2/lookup";
 const int AcoustidClient::kDefaultTimeout = 5000;  // msec
 
+// Acoustid allows three requests a second per client.
+const int AcoustidClient::kMaxBatchSize = 20;
+const int AcoustidClient::kRequestIntervalMsec = 334;
+
 AcoustidClient::AcoustidClient(QObject* parent)
     : QObject(parent),
       network_(new NetworkAccessManager(this)),
-      timeouts_(new NetworkTimeouts(kDefaultTimeout, this)) {}
+      timeouts_(new NetworkTimeouts(kDefaultTimeout, this)),
+      batch_timer_(new QTimer(this)) {
+  batch_timer_->setInterval(kRequestIntervalMsec);
+  connect(batch_timer_, SIGNAL(timeout()), SLOT(SendNextBatch()));
+}
 
 void AcoustidClient::SetTimeout(int msec) { timeouts_->SetTimeout(msec); }
 
 void AcoustidClient::Start(int id, const QString& fingerprint,
                            int duration_msec) {
-  typedef QPair<QString, QString> Param;
+  Lookup lookup;
+  lookup.id_ = id;
+  lookup.fingerprint_ = fingerprint;
+  lookup.duration_msec_ = duration_msec;
+  queued_lookups_ << lookup;
+
+  // Wait one interval before the first batch so fingerprints that finish
+  // around the same time share a request.
+  if (!batch_timer_->isActive()) batch_timer_->start();
+}
 
-  QList<Param> parameters;
-  parameters << Param("format", "json") << Param("client", kClientId)
-             << Param("duration", QString::number(duration_msec / kMsecPerSec))
-             << Param("meta", "recordingids+sources")
-             << Param("fingerprint", fingerprint);
+void AcoustidClient::SendNextBatch() {
+  if (queued_lookups_.isEmpty()) {
+    batch_timer_->stop();
+    return;
+  }
+
+  QUrl params;
+  params.addQueryItem("format", "json");
+  params.addQueryItem("client", kClientId);
+  params.addQueryItem("meta", "recordingids+sources");
+
+  QList<int> ids;
+  for (int i = 0; i < kMaxBatchSize && !queued_lookups_.isEmpty(); ++i) {
+    const Lookup lookup = queued_lookups_.takeFirst();
+    const QString n = QString::number(i);
+    params.addQueryItem("duration." + n,
+                        QString::number(lookup.duration_msec_ / kMsecPerSec));
+    params.addQueryItem("fingerprint." + n, lookup.fingerprint_);
+    ids << lookup.id_;
+  }
 
-  QUrl url(kUrl);
-  url.setQueryItems(parameters);
-  QNetworkRequest req(url);
+  // The fingerprints are too big to put in the URL, so they're POSTed.
+  QNetworkRequest req((QUrl(kUrl)));
+  req.setHeader(QNetworkRequest::ContentTypeHeader,
+                "application/x-www-form-urlencoded");
 
-  QNetworkReply* reply = network_->get(req);
+  QNetworkReply* reply = network_->post(req, params.encodedQuery());
   NewClosure(reply, SIGNAL(finished()), this,
-             SLOT(RequestFinished(QNetworkReply*, int)), reply, id);
-  requests_[id] = reply;
+             SLOT(RequestFinished(QNetworkReply*)), reply);
+  requests_[reply] = ids;
 
   timeouts_->AddReply(reply);
 }
 
-void AcoustidClient::Cancel(int id) { delete requests_.take(id); }
+void AcoustidClient::Cancel(int id) {
+  for (int i = 0; i < queued_lookups_.count(); ++i) {
+    if (queued_lookups_[i].id_ == id) {
+      queued_lookups_.removeAt(i);
+      return;
+    }
+  }
+
+  for (auto it = requests_.begin(); it != requests_.end(); ++it) {
+    if (!it.value().contains(id)) continue;
+
+    // Other songs might be sharing this request, so only abort it if this
+    // was the last one.  -1 keeps the positions of the others intact.
+    it.value()[it.value().indexOf(id)] = -1;
+    if (it.value().count(-1) == it.value().count()) {
+      QNetworkReply* reply = it.key();
+      requests_.erase(it);
+      delete reply;
+    }
+    return;
+  }
+}
 
 void AcoustidClient::CancelAll() {
-  qDeleteAll(requests_.values());
+  queued_lookups_.clear();
+  batch_timer_->stop();
+
+  qDeleteAll(requests_.keys());
   requests_.clear();
 }
 
@@ -84,36 +142,50 @@ struct IdSource {
 };
 }
 
-void AcoustidClient::RequestFinished(QNetworkReply* reply, int request_id) {
+void AcoustidClient::RequestFinished(QNetworkReply* reply) {
   reply->deleteLater();
-  requests_.remove(request_id);
+  const QList<int> ids = requests_.take(reply);
 
-  if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() !=
-      200) {
-    emit Finished(request_id, QStringList());
-    return;
-  }
+  QMap<int, QStringList> results_by_id;
 
-  QJson::Parser parser;
-  bool ok = false;
-  QVariantMap result = parser.parse(reply, &ok).toMap();
-  if (!ok) {
-    emit Finished(request_id, QStringList());
-    return;
+  if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() ==
+      200) {
+    QJson::Parser parser;
+    bool ok = false;
+    QVariantMap result = parser.parse(reply, &ok).toMap();
+
+    if (ok && result["status"].toString() == "ok") {
+      if (result.contains("fingerprints")) {
+        // One entry for each fingerprint, with the index it was sent with.
+        for (const QVariant& v : result["fingerprints"].toList()) {
+          QVariantMap fingerprint = v.toMap();
+          const int index = fingerprint["index"].toInt();
+          if (index < 0 || index >= ids.count()) continue;
+
+          results_by_id[ids[index]] =
+              ParseResults(fingerprint["results"].toList());
+        }
+      } else if (ids.count() == 1) {
+        results_by_id[ids[0]] = ParseResults(result["results"].toList());
+      }
+    } else {
+      qLog(Warning) << "Acoustid lookup failed:"
+                    << result["error"].toMap()["message"].toString();
+    }
   }
 
-  QString status = result["status"].toString();
-  if (status != "ok") {
-    emit Finished(request_id, QStringList());
-    return;
+  for (int id : ids) {
+    if (id == -1) continue;
+    emit Finished(id, results_by_id[id]);
   }
+}
 
+QStringList AcoustidClient::ParseResults(const QVariantList& results) {
   // Get the results:
   // -in a first step, gather ids and their corresponding number of sources
   // -then sort results by number of sources (the results are originally
   //  unsorted but results with more sources are likely to be more accurate)
   // -keep only the ids, as sources where useful only to sort the results
-  QVariantList results = result["results"].toList();
 
   // List of <id, nb of sources> pairs
   QList<IdSource> id_source_list;
@@ -133,10 +205,9 @@ void AcoustidClient::RequestFinished(QNetworkReply* reply, int request_id) {
 
   qStableSort(id_source_list);
 
-  QList<QString> id_list;
+  QStringList id_list;
   for (const IdSource& is : id_source_list) {
     id_list << is.id_;
   }
-
-  emit Finished(request_id, id_list);
+  return id_list;
 }
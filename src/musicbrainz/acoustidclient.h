@@ -18,13 +18,16 @@
 #ifndef ACOUSTIDCLIENT_H
 #define ACOUSTIDCLIENT_H
 
+#include <QList>
 #include <QMap>
 #include <QObject>
+#include <QVariant>
 
 class NetworkTimeouts;
 
 class QNetworkAccessManager;
 class QNetworkReply;
+class QTimer;
 
 class AcoustidClient : public QObject {
   Q_OBJECT
@@ -43,8 +46,10 @@ class AcoustidClient : public QObject {
   // Network requests will be aborted after this interval.
   void SetTimeout(int msec);
 
-  // Starts a request and returns immediately.  Finished() will be emitted
-  // later with the same ID.
+  // Queues a request and returns immediately.  Finished() will be emitted
+  // later with the same ID.  Requests queued close together are sent to
+  // Acoustid in batches of up to kMaxBatchSize fingerprints, no more often
+  // than once every kRequestIntervalMsec.
   void Start(int id, const QString& fingerprint, int duration_msec);
 
   // Cancels the request with the given ID.  Finished() will never be emitted
@@ -59,16 +64,31 @@ signals:
   void Finished(int id, const QStringList& mbid_list);
 
  private slots:
-  void RequestFinished(QNetworkReply* reply, int id);
+  void SendNextBatch();
+  void RequestFinished(QNetworkReply* reply);
 
  private:
+  struct Lookup {
+    int id_;
+    QString fingerprint_;
+    int duration_msec_;
+  };
+
+  static QStringList ParseResults(const QVariantList& results);
+
   static const char* kClientId;
   static const char* kUrl;
   static const int kDefaultTimeout;
+  static const int kMaxBatchSize;
+  static const int kRequestIntervalMsec;
 
   QNetworkAccessManager* network_;
   NetworkTimeouts* timeouts_;
-  QMap<int, QNetworkReply*> requests_;
+  QTimer* batch_timer_;
+
+  QList<Lookup> queued_lookups_;
+  // The IDs whose fingerprints were sent in each request, in order.
+  QMap<QNetworkReply*, QList<int>> requests_;
 };
 
 #endif  // ACOUSTIDCLIENT_H
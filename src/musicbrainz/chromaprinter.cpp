@@ -17,121 +17,69 @@
 
 #include "chromaprinter.h"
 
-#include <QCoreApplication>
-#include <QDir>
-#include <QEventLoop>
-#include <QThread>
+#include <bitset>
+#include <cstring>
+
 #include <QtDebug>
 #include <QTime>
+#include <QVector>
 
 #include <chromaprint.h>
 
 #include "core/logging.h"
-#include "core/signalchecker.h"
 
 static const int kDecodeRate = 11025;
 static const int kDecodeChannels = 1;
 static const int kPlayLengthSecs = 30;
 static const int kTimeoutSecs = 10;
 
-Chromaprinter::Chromaprinter(const QString& filename)
-    : filename_(filename), convert_element_(nullptr) {}
-
-Chromaprinter::~Chromaprinter() {}
+// Each item in a raw fingerprint covers about an eighth of a second, so this
+// allows for up to two seconds of extra silence at the start of a file.
+static const int kMaxOffset = 16;
+static const int kMinOverlap = 40;
 
-GstElement* Chromaprinter::CreateElement(const QString& factory_name,
-                                         GstElement* bin) {
-  GstElement* ret = gst_element_factory_make(
-      factory_name.toAscii().constData(), factory_name.toAscii().constData());
+static QVector<quint32> DecodeFingerprint(const QString& fingerprint) {
+  QByteArray encoded = fingerprint.toLatin1();
+  int size = 0;
+  int algorithm = 0;
 
-  if (ret && bin) gst_bin_add(GST_BIN(bin), ret);
+#if CHROMAPRINT_VERSION_MAJOR >= 1 && CHROMAPRINT_VERSION_MINOR >= 4
+  u_int32_t *raw = nullptr;
+#else
+  void *raw = nullptr;
+#endif
 
-  if (!ret) {
-    qLog(Warning) << "Couldn't create the gstreamer element" << factory_name;
+  if (encoded.isEmpty() ||
+      !chromaprint_decode_fingerprint(encoded.data(), encoded.size(), &raw,
+                                      &size, &algorithm, 1)) {
+    return QVector<quint32>();
   }
 
+  QVector<quint32> ret(size);
+  memcpy(ret.data(), raw, size * sizeof(quint32));
+  chromaprint_dealloc(raw);
   return ret;
 }
 
-QString Chromaprinter::CreateFingerprint() {
-  Q_ASSERT(QThread::currentThread() != qApp->thread());
+Chromaprinter::Chromaprinter(const QString& filename) : filename_(filename) {}
 
-  buffer_.open(QIODevice::WriteOnly);
-
-  GstElement* pipeline = gst_pipeline_new("pipeline");
-  GstElement* src = CreateElement("filesrc", pipeline);
-  GstElement* decode = CreateElement("decodebin", pipeline);
-  GstElement* convert = CreateElement("audioconvert", pipeline);
-  GstElement* resample = CreateElement("audioresample", pipeline);
-  GstElement* sink = CreateElement("appsink", pipeline);
+Chromaprinter::~Chromaprinter() {}
 
-  if (!src || !decode || !convert || !resample || !sink) {
-    return QString();
-  }
+bool Chromaprinter::Consume(const char* data, int size) {
+  buffer_.write(data, size);
+  return true;
+}
 
-  convert_element_ = convert;
-
-  // Connect the elements
-  gst_element_link_many(src, decode, nullptr);
-  gst_element_link_many(convert, resample, nullptr);
-
-  // Chromaprint expects mono 16-bit ints at a sample rate of 11025Hz.
-  GstCaps* caps = gst_caps_new_simple(
-      "audio/x-raw", "format", G_TYPE_STRING, "S16LE", "channels", G_TYPE_INT,
-      kDecodeChannels, "rate", G_TYPE_INT, kDecodeRate, NULL);
-  gst_element_link_filtered(resample, sink, caps);
-  gst_caps_unref(caps);
-
-  GstAppSinkCallbacks callbacks;
-  memset(&callbacks, 0, sizeof(callbacks));
-  callbacks.new_sample = NewBufferCallback;
-  gst_app_sink_set_callbacks(reinterpret_cast<GstAppSink*>(sink), &callbacks,
-                             this, nullptr);
-  g_object_set(G_OBJECT(sink), "sync", FALSE, nullptr);
-  g_object_set(G_OBJECT(sink), "emit-signals", TRUE, nullptr);
-
-  // Set the filename
-  g_object_set(src, "location", filename_.toUtf8().constData(), nullptr);
-
-  // Connect signals
-  GstBus* bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
-  CHECKED_GCONNECT(decode, "pad-added", &NewPadCallback, this);
-
-  // Play only first x seconds
-  gst_element_set_state(pipeline, GST_STATE_PAUSED);
-  // wait for state change before seeking
-  gst_element_get_state(pipeline, nullptr, nullptr, kTimeoutSecs * GST_SECOND);
-  gst_element_seek(pipeline, 1.0, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH,
-                   GST_SEEK_TYPE_SET, 0 * GST_SECOND, GST_SEEK_TYPE_SET,
-                   kPlayLengthSecs * GST_SECOND);
+QString Chromaprinter::CreateFingerprint() {
+  buffer_.open(QIODevice::WriteOnly);
 
   QTime time;
   time.start();
 
-  // Start playing
-  gst_element_set_state(pipeline, GST_STATE_PLAYING);
-
-  // Wait until EOS or error
-  GstMessage* msg = gst_bus_timed_pop_filtered(
-      bus, kTimeoutSecs * GST_SECOND,
-      static_cast<GstMessageType>(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
-
-  if (msg != nullptr) {
-    if (msg->type == GST_MESSAGE_ERROR) {
-      // Report error
-      GError* error = nullptr;
-      gchar* debugs = nullptr;
-
-      gst_message_parse_error(msg, &error, &debugs);
-      QString message = QString::fromLocal8Bit(error->message);
-
-      g_error_free(error);
-      free(debugs);
-
-      qLog(Debug) << "Error processing" << filename_ << ":" << message;
-    }
-    gst_message_unref(msg);
-  }
+  // Chromaprint expects mono 16-bit ints at a sample rate of 11025Hz, and
+  // only needs the first x seconds.
+  OfflineDecoder::ForCurrentThread(kDecodeRate, kDecodeChannels)
+      ->Decode(filename_, kPlayLengthSecs, kTimeoutSecs, this);
 
   int decode_time = time.restart();
 
@@ -176,40 +124,27 @@ QString Chromaprinter::CreateFingerprint() {
   qLog(Debug) << "Decode time:" << decode_time
               << "Codegen time:" << codegen_time;
 
-  // Cleanup
-  callbacks.new_sample = nullptr;
-  gst_object_unref(bus);
-  gst_element_set_state(pipeline, GST_STATE_NULL);
-  gst_object_unref(pipeline);
-
   return fingerprint;
 }
 
-void Chromaprinter::NewPadCallback(GstElement*, GstPad* pad, gpointer data) {
-  Chromaprinter* instance = reinterpret_cast<Chromaprinter*>(data);
-  GstPad* const audiopad =
-      gst_element_get_static_pad(instance->convert_element_, "sink");
-
-  if (GST_PAD_IS_LINKED(audiopad)) {
-    qLog(Warning) << "audiopad is already linked, unlinking old pad";
-    gst_pad_unlink(audiopad, GST_PAD_PEER(audiopad));
+float Chromaprinter::Similarity(const QString& fingerprint1,
+                                const QString& fingerprint2) {
+  const QVector<quint32> a = DecodeFingerprint(fingerprint1);
+  const QVector<quint32> b = DecodeFingerprint(fingerprint2);
+
+  float best = 0.0;
+  for (int offset = -kMaxOffset; offset <= kMaxOffset; ++offset) {
+    const int start_a = qMax(0, offset);
+    const int start_b = qMax(0, -offset);
+    const int overlap = qMin(a.count() - start_a, b.count() - start_b);
+    if (overlap < kMinOverlap) continue;
+
+    int different_bits = 0;
+    for (int i = 0; i < overlap; ++i) {
+      const quint32 diff = a[start_a + i] ^ b[start_b + i];
+      different_bits += std::bitset<32>(diff).count();
+    }
+    best = qMax(best, 1.0f - float(different_bits) / (overlap * 32));
   }
-
-  gst_pad_link(pad, audiopad);
-  gst_object_unref(audiopad);
-}
-
-GstFlowReturn Chromaprinter::NewBufferCallback(GstAppSink* app_sink,
-                                               gpointer self) {
-  Chromaprinter* me = reinterpret_cast<Chromaprinter*>(self);
-
-  GstSample* sample = gst_app_sink_pull_sample(app_sink);
-  GstBuffer* buffer = gst_sample_get_buffer(sample);
-  GstMapInfo map;
-  gst_buffer_map(buffer, &map, GST_MAP_READ);
-  me->buffer_.write(reinterpret_cast<const char*>(map.data), map.size);
-  gst_buffer_unmap(buffer, &map);
-  gst_buffer_unref(buffer);
-
-  return GST_FLOW_OK;
+  return best;
 }
@@ -18,19 +18,19 @@
 #ifndef CHROMAPRINTER_H
 #define CHROMAPRINTER_H
 
-#include <gst/gst.h>
-#include <gst/app/gstappsink.h>
-
 #include <QBuffer>
 #include <QString>
 
-class Chromaprinter {
+#include "core/offlinedecoder.h"
+
+class Chromaprinter : private OfflineDecoder::Sink {
   // Creates a Chromaprint fingerprint from a song.
   // Uses GStreamer to open and decode the file as PCM data and passes this
   // to Chromaprint's code generator. The generated code can be used to identify
   // a song via Acoustid.
   // You should create one Chromaprinter for each file you want to fingerprint.
-  // This class works well with QtConcurrentMap.
+  // This class works well with QtConcurrentMap: each worker thread keeps its
+  // own OfflineDecoder, so the pipeline is reused from one file to the next.
 
  public:
   Chromaprinter(const QString& filename);
@@ -41,18 +41,20 @@ class Chromaprinter {
   // could be created.
   QString CreateFingerprint();
 
- private:
-  GstElement* CreateElement(const QString& factory_name,
-                            GstElement* bin = nullptr);
+  // Compares two fingerprints made by CreateFingerprint, allowing for one of
+  // them to start a little later than the other.  Returns the fraction of
+  // bits that are the same where they overlap, from 0.5 for unrelated audio to
+  // 1.0 for the same recording.
+  static float Similarity(const QString& fingerprint1,
+                          const QString& fingerprint2);
 
-  static void NewPadCallback(GstElement*, GstPad* pad, gpointer data);
-  static GstFlowReturn NewBufferCallback(GstAppSink* app_sink, gpointer self);
+ private:
+  // OfflineDecoder::Sink
+  bool Consume(const char* data, int size) override;
 
  private:
   QString filename_;
 
-  GstElement* convert_element_;
-
   QBuffer buffer_;
 };
 
@@ -20,15 +20,33 @@
 #include "acoustidclient.h"
 #include "chromaprinter.h"
 #include "musicbrainzclient.h"
+#include "core/database.h"
 #include "core/timeconstants.h"
 
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QSqlQuery>
 #include <QUrl>
 #include <QtConcurrentMap>
 
-TagFetcher::TagFetcher(QObject* parent)
+namespace {
+
+struct FingerprintSong {
+  typedef QString result_type;
+
+  explicit FingerprintSong(Database* db) : db_(db) {}
+  QString operator()(const Song& song) const {
+    return TagFetcher::GetFingerprint(db_, song);
+  }
+
+  Database* db_;
+};
+
+}  // namespace
+
+TagFetcher::TagFetcher(Database* db, QObject* parent)
     : QObject(parent),
+      db_(db),
       fingerprint_watcher_(nullptr),
       acoustid_client_(new AcoustidClient(this)),
       musicbrainz_client_(new MusicBrainzClient(this)) {
@@ -39,8 +57,54 @@ TagFetcher::TagFetcher(QObject* parent)
           SLOT(TagsFetched(int, MusicBrainzClient::ResultList)));
 }
 
-QString TagFetcher::GetFingerprint(const Song& song) {
-  return Chromaprinter(song.url().toLocalFile()).CreateFingerprint();
+QString TagFetcher::GetFingerprint(Database* db, const Song& song) {
+  if (db) {
+    const QString cached = LoadFingerprint(db, song);
+    if (!cached.isEmpty()) return cached;
+  }
+
+  const QString fingerprint =
+      Chromaprinter(song.url().toLocalFile()).CreateFingerprint();
+
+  if (db && !fingerprint.isEmpty()) {
+    SaveFingerprint(db, song, fingerprint);
+  }
+  return fingerprint;
+}
+
+QString TagFetcher::LoadFingerprint(Database* db, const Song& song) {
+  Database::ReadLocker l(db);
+  QSqlDatabase conn(db->ConnectReadOnly());
+
+  QSqlQuery q = db->PreparedQuery(
+      "SELECT fingerprint FROM acoustid_fingerprints"
+      " WHERE filename = :filename AND mtime = :mtime",
+      conn);
+  q.bindValue(":filename", song.url().toEncoded());
+  q.bindValue(":mtime", song.mtime());
+  q.exec();
+  if (db->CheckErrors(q) || !q.next()) return QString();
+
+  const QString ret = q.value(0).toString();
+  q.finish();
+  return ret;
+}
+
+void TagFetcher::SaveFingerprint(Database* db, const Song& song,
+                                 const QString& fingerprint) {
+  QMutexLocker l(db->Mutex());
+  QSqlDatabase conn(db->Connect());
+
+  QSqlQuery q = db->PreparedQuery(
+      "INSERT OR REPLACE INTO acoustid_fingerprints"
+      " (filename, mtime, fingerprint)"
+      " VALUES (:filename, :mtime, :fingerprint)",
+      conn);
+  q.bindValue(":filename", song.url().toEncoded());
+  q.bindValue(":mtime", song.mtime());
+  q.bindValue(":fingerprint", fingerprint);
+  q.exec();
+  db->CheckErrors(q);
 }
 
 void TagFetcher::StartFetch(const SongList& songs) {
@@ -48,7 +112,8 @@ void TagFetcher::StartFetch(const SongList& songs) {
 
   songs_ = songs;
 
-  QFuture<QString> future = QtConcurrent::mapped(songs_, GetFingerprint);
+  QFuture<QString> future =
+      QtConcurrent::mapped(songs_, FingerprintSong(db_));
   fingerprint_watcher_ = new QFutureWatcher<QString>(this);
   fingerprint_watcher_->setFuture(future);
   connect(fingerprint_watcher_, SIGNAL(resultReadyAt(int)),
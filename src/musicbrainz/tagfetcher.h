@@ -25,18 +25,25 @@
 #include <QObject>
 
 class AcoustidClient;
+class Database;
 
 class TagFetcher : public QObject {
   Q_OBJECT
 
   // High level interface to Fingerprinter, AcoustidClient and
   // MusicBrainzClient.
+  // If a database is given, fingerprints are kept in it so songs only have to
+  // be decoded again once their file changes.
 
  public:
-  TagFetcher(QObject* parent = nullptr);
+  TagFetcher(Database* db = nullptr, QObject* parent = nullptr);
 
   void StartFetch(const SongList& songs);
 
+  // Returns the cached fingerprint for the song, or creates one and caches
+  // it.  This method is blocking, so call it in another thread.
+  static QString GetFingerprint(Database* db, const Song& song);
+
  public slots:
   void Cancel();
 
@@ -51,8 +58,11 @@ signals:
   void TagsFetched(int index, const MusicBrainzClient::ResultList& result);
 
  private:
-  static QString GetFingerprint(const Song& song);
+  static QString LoadFingerprint(Database* db, const Song& song);
+  static void SaveFingerprint(Database* db, const Song& song,
+                              const QString& fingerprint);
 
+  Database* db_;
   QFutureWatcher<QString>* fingerprint_watcher_;
   AcoustidClient* acoustid_client_;
   MusicBrainzClient* musicbrainz_client_;
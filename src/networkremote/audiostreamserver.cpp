@@ -0,0 +1,294 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "audiostreamserver.h"
+
+#include <QHostAddress>
+#include <QNetworkProxy>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include "core/logging.h"
+#include "networkremote/networkremote.h"
+
+const quint16 AudioStreamServer::kDefaultPort = 5501;
+const int AudioStreamServer::kDefaultBitrateKbps = 128;
+const int AudioStreamServer::kDefaultMaxClients = 8;
+const int AudioStreamServer::kMaxQueuedBuffers = 512;
+const qint64 AudioStreamServer::kMaxSocketBytes = 64 * 1024;  // in Bytes
+
+AudioStreamServer::AudioStreamServer(GstEngine* engine, QObject* parent)
+    : QObject(parent),
+      engine_(engine),
+      format_(GstEngine::StreamFormat_Mp3),
+      max_clients_(kDefaultMaxClients),
+      only_non_public_ip_(true),
+      last_buffer_was_header_(false),
+      pipeline_id_(-1),
+      deliver_scheduled_(false) {}
+
+AudioStreamServer::~AudioStreamServer() { Stop(); }
+
+void AudioStreamServer::Start(quint16 port, GstEngine::StreamFormat format,
+                              int bitrate_kbps, int max_clients,
+                              bool only_non_public_ip) {
+  Stop();
+
+  format_ = format;
+  max_clients_ = max_clients;
+  only_non_public_ip_ = only_non_public_ip;
+
+  server_.reset(new QTcpServer);
+  server_ipv6_.reset(new QTcpServer);
+  connect(server_.get(), SIGNAL(newConnection()), SLOT(AcceptConnection()));
+  connect(server_ipv6_.get(), SIGNAL(newConnection()),
+          SLOT(AcceptConnection()));
+
+  server_->setProxy(QNetworkProxy::NoProxy);
+  server_ipv6_->setProxy(QNetworkProxy::NoProxy);
+
+  if (!server_->listen(QHostAddress::Any, port)) {
+    qLog(Warning) << "Couldn't listen for audio stream clients on port"
+                  << port << server_->errorString();
+  }
+  server_ipv6_->listen(QHostAddress::AnyIPv6, port);
+
+  engine_->SetStreamOutput(this, format, bitrate_kbps);
+
+  qLog(Info) << "Streaming audio on port" << port;
+}
+
+void AudioStreamServer::Stop() {
+  if (!server_) return;
+
+  // No more buffers come in once this returns
+  engine_->SetStreamOutput(nullptr, format_, 0);
+
+  server_.reset();
+  server_ipv6_.reset();
+
+  for (Client* client : QList<Client*>(clients_)) {
+    RemoveClient(client);
+  }
+  ClearStreamHeaders();
+
+  QMutexLocker l(&pending_mutex_);
+  for (GstBuffer* buffer : pending_) {
+    gst_buffer_unref(buffer);
+  }
+  pending_.clear();
+  pipeline_id_ = -1;
+}
+
+void AudioStreamServer::ConsumeBuffer(GstBuffer* buffer, int pipeline_id) {
+  QMutexLocker l(&pending_mutex_);
+
+  if (pipeline_id < pipeline_id_) {
+    gst_buffer_unref(buffer);
+    return;
+  }
+  pipeline_id_ = pipeline_id;
+
+  // Don't let them pile up if this thread is busy
+  pending_ << buffer;
+  while (pending_.count() > kMaxQueuedBuffers) {
+    gst_buffer_unref(pending_.takeFirst());
+  }
+
+  if (!deliver_scheduled_) {
+    deliver_scheduled_ = true;
+    QMetaObject::invokeMethod(this, "DeliverBuffers", Qt::QueuedConnection);
+  }
+}
+
+void AudioStreamServer::DeliverBuffers() {
+  QList<GstBuffer*> buffers;
+  {
+    QMutexLocker l(&pending_mutex_);
+    buffers.swap(pending_);
+    deliver_scheduled_ = false;
+  }
+
+  for (GstBuffer* buffer : buffers) {
+    // Each new Ogg stream starts with a new set of headers
+    if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_HEADER)) {
+      if (!last_buffer_was_header_) ClearStreamHeaders();
+      stream_headers_ << gst_buffer_ref(buffer);
+      last_buffer_was_header_ = true;
+    } else {
+      last_buffer_was_header_ = false;
+    }
+
+    for (Client* client : clients_) {
+      if (client->streaming_) QueueBuffer(client, buffer);
+    }
+    gst_buffer_unref(buffer);
+  }
+
+  for (Client* client : clients_) {
+    if (client->streaming_) WriteQueued(client);
+  }
+}
+
+void AudioStreamServer::AcceptConnection() {
+  QTcpServer* server = qobject_cast<QTcpServer*>(sender());
+  QTcpSocket* socket = server->nextPendingConnection();
+  if (!socket) return;
+
+  if (only_non_public_ip_ &&
+      !NetworkRemote::IpIsPrivate(socket->peerAddress())) {
+    qLog(Info) << "Got an audio stream connection from public ip"
+               << socket->peerAddress().toString();
+    socket->close();
+    socket->deleteLater();
+    return;
+  }
+
+  Client* client = new Client;
+  client->socket_ = socket;
+  clients_ << client;
+
+  connect(socket, SIGNAL(readyRead()), SLOT(ClientReadyRead()));
+  connect(socket, SIGNAL(bytesWritten(qint64)), SLOT(ClientBytesWritten()));
+  connect(socket, SIGNAL(disconnected()), SLOT(ClientDisconnected()));
+}
+
+void AudioStreamServer::ClientReadyRead() {
+  Client* client = FindClient(sender());
+  if (!client) return;
+
+  if (client->streaming_) {
+    // Nothing else is expected from a listener
+    client->socket_->readAll();
+    return;
+  }
+
+  client->request_.append(client->socket_->readAll());
+  if (!client->request_.contains("\r\n\r\n")) {
+    if (client->request_.size() > 8192) RemoveClient(client);
+    return;
+  }
+
+  const QList<QByteArray> request_line =
+      client->request_.left(client->request_.indexOf("\r\n")).split(' ');
+  if (request_line.count() < 2 || request_line[0] != "GET") {
+    client->socket_->write(
+        "HTTP/1.0 405 Method Not Allowed\r\nAllow: GET\r\n\r\n");
+    client->socket_->disconnectFromHost();
+    return;
+  }
+
+  int streaming_clients = 0;
+  for (Client* other : clients_) {
+    if (other->streaming_) ++streaming_clients;
+  }
+  if (streaming_clients >= max_clients_) {
+    client->socket_->write("HTTP/1.0 503 Service Unavailable\r\n\r\n");
+    client->socket_->disconnectFromHost();
+    return;
+  }
+
+  StartStreaming(client);
+}
+
+void AudioStreamServer::StartStreaming(Client* client) {
+  QByteArray response = "HTTP/1.0 200 OK\r\n";
+  response += "Content-Type: ";
+  response +=
+      format_ == GstEngine::StreamFormat_Opus ? "audio/ogg" : "audio/mpeg";
+  response += "\r\n";
+  response += "Cache-Control: no-cache\r\n";
+  response += "icy-name: Clementine\r\n";
+  response += "\r\n";
+
+  client->socket_->write(response);
+  client->request_.clear();
+  client->streaming_ = true;
+
+  qLog(Info) << "Streaming audio to"
+             << client->socket_->peerAddress().toString();
+
+  for (GstBuffer* header : stream_headers_) {
+    QueueBuffer(client, header);
+  }
+  WriteQueued(client);
+}
+
+void AudioStreamServer::QueueBuffer(Client* client, GstBuffer* buffer) {
+  client->queue_.enqueue(gst_buffer_ref(buffer));
+
+  // A listener that can't keep up loses the oldest audio rather than holding
+  // on to more and more of it.
+  while (client->queue_.count() > kMaxQueuedBuffers) {
+    gst_buffer_unref(client->queue_.dequeue());
+  }
+}
+
+void AudioStreamServer::WriteQueued(Client* client) {
+  while (!client->queue_.isEmpty() &&
+         client->socket_->bytesToWrite() < kMaxSocketBytes) {
+    GstBuffer* buffer = client->queue_.dequeue();
+
+    GstMapInfo map;
+    if (gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+      client->socket_->write(reinterpret_cast<const char*>(map.data),
+                             map.size);
+      gst_buffer_unmap(buffer, &map);
+    }
+    gst_buffer_unref(buffer);
+  }
+}
+
+void AudioStreamServer::ClientBytesWritten() {
+  Client* client = FindClient(sender());
+  if (client && client->streaming_) WriteQueued(client);
+}
+
+void AudioStreamServer::ClientDisconnected() {
+  Client* client = FindClient(sender());
+  if (client) RemoveClient(client);
+}
+
+AudioStreamServer::Client* AudioStreamServer::FindClient(
+    QObject* socket) const {
+  for (Client* client : clients_) {
+    if (client->socket_ == socket) return client;
+  }
+  return nullptr;
+}
+
+void AudioStreamServer::RemoveClient(Client* client) {
+  clients_.removeAll(client);
+
+  for (GstBuffer* buffer : client->queue_) {
+    gst_buffer_unref(buffer);
+  }
+
+  client->socket_->disconnect(this);
+  client->socket_->abort();
+  client->socket_->deleteLater();
+  delete client;
+}
+
+void AudioStreamServer::ClearStreamHeaders() {
+  for (GstBuffer* buffer : stream_headers_) {
+    gst_buffer_unref(buffer);
+  }
+  stream_headers_.clear();
+  last_buffer_was_header_ = false;
+}
@@ -0,0 +1,114 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef AUDIOSTREAMSERVER_H
+#define AUDIOSTREAMSERVER_H
+
+#include <memory>
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+
+#include "engines/bufferconsumer.h"
+#include "engines/gstengine.h"
+
+class QTcpServer;
+class QTcpSocket;
+
+// Serves the audio that's playing over HTTP, so other players on the network
+// can listen along.  The playback pipelines encode the audio once, see
+// GstEngine::SetStreamOutput, and every listener is sent the same buffers.
+class AudioStreamServer : public QObject, public BufferConsumer {
+  Q_OBJECT
+
+ public:
+  static const quint16 kDefaultPort;
+  static const int kDefaultBitrateKbps;
+  static const int kDefaultMaxClients;
+
+  // How many encoded buffers each listener can fall behind by before the
+  // oldest ones are dropped.
+  static const int kMaxQueuedBuffers;
+  // How much is handed to a listener's socket at a time.
+  static const qint64 kMaxSocketBytes;
+
+  explicit AudioStreamServer(GstEngine* engine, QObject* parent = nullptr);
+  ~AudioStreamServer();
+
+  // Listens on port and starts encoding tracks from the next one that's
+  // played.  Clients outside the local network are turned away if
+  // only_non_public_ip is set.
+  void Start(quint16 port, GstEngine::StreamFormat format, int bitrate_kbps,
+             int max_clients, bool only_non_public_ip);
+  void Stop();
+
+  // BufferConsumer.  Called from the pipelines' streaming threads.
+  void ConsumeBuffer(GstBuffer* buffer, int pipeline_id);
+
+ private slots:
+  void AcceptConnection();
+  void ClientReadyRead();
+  void ClientBytesWritten();
+  void ClientDisconnected();
+  void DeliverBuffers();
+
+ private:
+  struct Client {
+    Client() : socket_(nullptr), streaming_(false) {}
+
+    QTcpSocket* socket_;
+    QByteArray request_;
+    bool streaming_;
+    QQueue<GstBuffer*> queue_;
+  };
+
+  Client* FindClient(QObject* socket) const;
+  void RemoveClient(Client* client);
+  void StartStreaming(Client* client);
+  void QueueBuffer(Client* client, GstBuffer* buffer);
+  void WriteQueued(Client* client);
+  void ClearStreamHeaders();
+
+  GstEngine* engine_;
+  std::unique_ptr<QTcpServer> server_;
+  std::unique_ptr<QTcpServer> server_ipv6_;
+
+  GstEngine::StreamFormat format_;
+  int max_clients_;
+  bool only_non_public_ip_;
+
+  QList<Client*> clients_;
+
+  // Codec headers that every new listener needs before the audio.  Only Ogg
+  // has any.
+  QList<GstBuffer*> stream_headers_;
+  bool last_buffer_was_header_;
+
+  // Filled by ConsumeBuffer and handed out to the clients by DeliverBuffers.
+  // Only the newest pipeline's buffers are sent, so a track that's fading out
+  // goes quiet on the stream as soon as the next one starts.
+  QMutex pending_mutex_;
+  QList<GstBuffer*> pending_;
+  int pipeline_id_;
+  bool deliver_scheduled_;
+};
+
+#endif  // AUDIOSTREAMSERVER_H
@@ -58,12 +58,13 @@ IncomingDataParser::IncomingDataParser(Application* app) : app_(app) {
           SLOT(SetActivePlaylist(int)));
   connect(this, SIGNAL(ShuffleCurrent()), app_->playlist_manager(),
           SLOT(ShuffleCurrent()));
-  connect(this, SIGNAL(SetRepeatMode(PlaylistSequence::RepeatMode)),
-          app_->playlist_manager()->sequence(),
-          SLOT(SetRepeatMode(PlaylistSequence::RepeatMode)));
-  connect(this, SIGNAL(SetShuffleMode(PlaylistSequence::ShuffleMode)),
-          app_->playlist_manager()->sequence(),
-          SLOT(SetShuffleMode(PlaylistSequence::ShuffleMode)));
+  // There's no sequence in headless mode.
+  if (PlaylistSequence* sequence = app_->playlist_manager()->sequence()) {
+    connect(this, SIGNAL(SetRepeatMode(PlaylistSequence::RepeatMode)),
+            sequence, SLOT(SetRepeatMode(PlaylistSequence::RepeatMode)));
+    connect(this, SIGNAL(SetShuffleMode(PlaylistSequence::ShuffleMode)),
+            sequence, SLOT(SetShuffleMode(PlaylistSequence::ShuffleMode)));
+  }
   connect(this, SIGNAL(InsertUrls(int, const QList<QUrl>&, int, bool, bool)),
           app_->playlist_manager(),
           SLOT(InsertUrls(int, const QList<QUrl>&, int, bool, bool)));
@@ -114,7 +115,7 @@ void IncomingDataParser::Parse(const pb::remote::Message& msg) {
       SendPlaylists(msg);
       break;
     case pb::remote::REQUEST_PLAYLIST_SONGS:
-      GetPlaylistSongs(msg);
+      GetPlaylistSongs(msg, client);
       break;
     case pb::remote::SET_VOLUME:
       emit SetVolume(msg.request_set_volume().volume());
@@ -180,7 +181,9 @@ void IncomingDataParser::Parse(const pb::remote::Message& msg) {
       client->song_sender()->SendSongs(msg.request_download_songs());
       break;
     case pb::remote::SONG_OFFER_RESPONSE:
-      client->song_sender()->ResponseSongOffer(msg.response_song_offer().accepted());
+      client->song_sender()->ResponseSongOffer(
+          msg.response_song_offer().accepted(),
+          msg.response_song_offer().offset());
       break;
     case pb::remote::GET_LIBRARY:
       emit SendLibrary(client);
@@ -191,13 +194,32 @@ void IncomingDataParser::Parse(const pb::remote::Message& msg) {
     case pb::remote::GLOBAL_SEARCH:
       GlobalSearch(client, msg);
       break;
+    case pb::remote::GET_LIBRARY_CHANGES:
+      emit SendLibraryChanges(
+          client,
+          QStringFromStdString(msg.request_library_changes().library_epoch()),
+          msg.request_library_changes().library_revision());
+      break;
+    case pb::remote::GET_ART:
+      emit SendArt(client,
+                   QStringFromStdString(msg.request_art().art_hash()));
+      break;
     default:
       break;
   }
 }
 
-void IncomingDataParser::GetPlaylistSongs(const pb::remote::Message& msg) {
-  emit SendPlaylistSongs(msg.request_playlist_songs().id());
+void IncomingDataParser::GetPlaylistSongs(const pb::remote::Message& msg,
+                                          RemoteClient* client) {
+  const pb::remote::RequestPlaylistSongs& request =
+      msg.request_playlist_songs();
+
+  if (request.has_limit()) {
+    emit SendPlaylistSongsPage(client, request.id(), request.offset(),
+                               request.limit());
+  } else {
+    emit SendPlaylistSongs(request.id());
+  }
 }
 
 void IncomingDataParser::ChangeSong(const pb::remote::Message& msg) {
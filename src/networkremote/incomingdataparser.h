@@ -25,6 +25,8 @@ class IncomingDataParser : public QObject {
   void SendAllPlaylists();
   void SendAllActivePlaylists();
   void SendPlaylistSongs(int id);
+  void SendPlaylistSongsPage(RemoteClient* client, int id, int offset,
+                             int limit);
   void Open(int id);
   void Close(int id);
   void GetLyrics();
@@ -52,6 +54,9 @@ class IncomingDataParser : public QObject {
   void RemoveSongs(int id, const QList<int>& indices);
   void SeekTo(int seconds);
   void SendLibrary(RemoteClient* client);
+  void SendLibraryChanges(RemoteClient* client, const QString& epoch,
+                          qint64 revision);
+  void SendArt(RemoteClient* client, const QString& hash);
   void RateCurrentSong(double);
 
   void DoGlobalSearch(QString, RemoteClient*);
@@ -61,7 +66,7 @@ class IncomingDataParser : public QObject {
   bool close_connection_;
   MainWindow::PlaylistAddBehaviour doubleclick_playlist_addmode_;
 
-  void GetPlaylistSongs(const pb::remote::Message& msg);
+  void GetPlaylistSongs(const pb::remote::Message& msg, RemoteClient* client);
   void ChangeSong(const pb::remote::Message& msg);
   void SetRepeatMode(const pb::remote::Repeat& repeat);
   void SetShuffleMode(const pb::remote::Shuffle& shuffle);
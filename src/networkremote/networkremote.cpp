@@ -24,18 +24,31 @@
 #include <QTcpServer>
 
 #include "core/logging.h"
+#include "core/player.h"
 #include "covers/currentartloader.h"
+#include "engines/gstengine.h"
+#include "networkremote/audiostreamserver.h"
 #include "networkremote/incomingdataparser.h"
 #include "networkremote/outgoingdatacreator.h"
+#include "networkremote/remoteclient.h"
 #include "networkremote/zeroconf.h"
 #include "playlist/playlistmanager.h"
+#include "transcoder/transcodecache.h"
 
 const char* NetworkRemote::kSettingsGroup = "NetworkRemote";
 const quint16 NetworkRemote::kDefaultServerPort = 5500;
 const char* NetworkRemote::kTranscoderSettingPostfix = "/NetworkRemote";
+const char* NetworkRemote::kTranscodeCacheDirectory = "remotetranscodes";
 
 NetworkRemote::NetworkRemote(Application* app, QObject* parent)
-    : QObject(parent), signals_connected_(false), app_(app) {}
+    : QObject(parent),
+      signals_connected_(false),
+      stream_audio_(false),
+      stream_port_(AudioStreamServer::kDefaultPort),
+      stream_format_(GstEngine::StreamFormat_Mp3),
+      stream_bitrate_(AudioStreamServer::kDefaultBitrateKbps),
+      stream_max_clients_(AudioStreamServer::kDefaultMaxClients),
+      app_(app) {}
 
 NetworkRemote::~NetworkRemote() { StopServer(); }
 
@@ -49,6 +62,18 @@ void NetworkRemote::ReadSettings() {
   // Use only non public ips must be true be default
   only_non_public_ip_ = s.value("only_non_public_ip", true).toBool();
 
+  stream_audio_ = s.value("stream_audio", false).toBool();
+  stream_port_ =
+      s.value("stream_port", AudioStreamServer::kDefaultPort).toInt();
+  stream_format_ =
+      s.value("stream_format", GstEngine::StreamFormat_Mp3).toInt();
+  stream_bitrate_ =
+      s.value("stream_bitrate", AudioStreamServer::kDefaultBitrateKbps)
+          .toInt();
+  stream_max_clients_ =
+      s.value("stream_max_clients", AudioStreamServer::kDefaultMaxClients)
+          .toInt();
+
   s.endGroup();
 }
 
@@ -57,6 +82,14 @@ void NetworkRemote::SetupServer() {
   server_ipv6_.reset(new QTcpServer());
   incoming_data_parser_.reset(new IncomingDataParser(app_));
   outgoing_data_creator_.reset(new OutgoingDataCreator(app_));
+  // A remote client is waiting for these, so don't queue them behind a
+  // library conversion.
+  transcode_cache_.reset(new TranscodeCache(
+      kTranscodeCacheDirectory, kTranscoderSettingPostfix,
+      TranscodeScheduler::Priority_Interactive));
+
+  GstEngine* engine = qobject_cast<GstEngine*>(app_->player()->engine());
+  if (engine) audio_stream_server_.reset(new AudioStreamServer(engine));
 
   outgoing_data_creator_->SetClients(&clients_);
 
@@ -79,6 +112,10 @@ void NetworkRemote::StartServer() {
   }
   // Check if user desires to start a network remote server
   ReadSettings();
+
+  // The audio stream doesn't need the remote itself to be on
+  StartAudioStream();
+
   if (!use_remote_) {
     qLog(Info) << "Network Remote deactivated";
     return;
@@ -100,7 +137,18 @@ void NetworkRemote::StartServer() {
   }
 }
 
+void NetworkRemote::StartAudioStream() {
+  if (!audio_stream_server_ || !stream_audio_) return;
+
+  qLog(Info) << "Starting audio stream";
+  audio_stream_server_->Start(
+      stream_port_, GstEngine::StreamFormat(stream_format_), stream_bitrate_,
+      stream_max_clients_, only_non_public_ip_);
+}
+
 void NetworkRemote::StopServer() {
+  if (audio_stream_server_) audio_stream_server_->Stop();
+
   if (server_->isListening()) {
     outgoing_data_creator_.get()->DisconnectAllClients();
     server_->close();
@@ -130,6 +178,10 @@ void NetworkRemote::AcceptConnection() {
             outgoing_data_creator_.get(), SLOT(SendAllActivePlaylists()));
     connect(incoming_data_parser_.get(), SIGNAL(SendPlaylistSongs(int)),
             outgoing_data_creator_.get(), SLOT(SendPlaylistSongs(int)));
+    connect(incoming_data_parser_.get(),
+            SIGNAL(SendPlaylistSongsPage(RemoteClient*, int, int, int)),
+            outgoing_data_creator_.get(),
+            SLOT(SendPlaylistSongsPage(RemoteClient*, int, int, int)));
 
     connect(app_->playlist_manager(), SIGNAL(ActiveChanged(Playlist*)),
             outgoing_data_creator_.get(), SLOT(ActiveChanged(Playlist*)));
@@ -150,20 +202,30 @@ void NetworkRemote::AcceptConnection() {
     connect(app_->player()->engine(), SIGNAL(StateChanged(Engine::State)),
             outgoing_data_creator_.get(), SLOT(StateChanged(Engine::State)));
 
-    connect(app_->playlist_manager()->sequence(),
-            SIGNAL(RepeatModeChanged(PlaylistSequence::RepeatMode)),
-            outgoing_data_creator_.get(),
-            SLOT(SendRepeatMode(PlaylistSequence::RepeatMode)));
-    connect(app_->playlist_manager()->sequence(),
-            SIGNAL(ShuffleModeChanged(PlaylistSequence::ShuffleMode)),
-            outgoing_data_creator_.get(),
-            SLOT(SendShuffleMode(PlaylistSequence::ShuffleMode)));
+    // There's no sequence in headless mode.
+    if (PlaylistSequence* sequence = app_->playlist_manager()->sequence()) {
+      connect(sequence,
+              SIGNAL(RepeatModeChanged(PlaylistSequence::RepeatMode)),
+              outgoing_data_creator_.get(),
+              SLOT(SendRepeatMode(PlaylistSequence::RepeatMode)));
+      connect(sequence,
+              SIGNAL(ShuffleModeChanged(PlaylistSequence::ShuffleMode)),
+              outgoing_data_creator_.get(),
+              SLOT(SendShuffleMode(PlaylistSequence::ShuffleMode)));
+    }
 
     connect(incoming_data_parser_.get(), SIGNAL(GetLyrics()),
             outgoing_data_creator_.get(), SLOT(GetLyrics()));
 
     connect(incoming_data_parser_.get(), SIGNAL(SendLibrary(RemoteClient*)),
             outgoing_data_creator_.get(), SLOT(SendLibrary(RemoteClient*)));
+    connect(incoming_data_parser_.get(),
+            SIGNAL(SendLibraryChanges(RemoteClient*, QString, qint64)),
+            outgoing_data_creator_.get(),
+            SLOT(SendLibraryChanges(RemoteClient*, QString, qint64)));
+    connect(incoming_data_parser_.get(),
+            SIGNAL(SendArt(RemoteClient*, QString)),
+            outgoing_data_creator_.get(), SLOT(SendArt(RemoteClient*, QString)));
 
     connect(incoming_data_parser_.get(),
             SIGNAL(DoGlobalSearch(QString, RemoteClient*)),
@@ -204,7 +266,8 @@ bool NetworkRemote::IpIsPrivate(const QHostAddress& address) {
 void NetworkRemote::CreateRemoteClient(QTcpSocket* client_socket) {
   if (client_socket) {
     // Add the client to the list
-    RemoteClient* client = new RemoteClient(app_, client_socket);
+    RemoteClient* client =
+        new RemoteClient(app_, client_socket, transcode_cache_.get());
     clients_.push_back(client);
 
     // Connect the signal to parse data
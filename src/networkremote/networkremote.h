@@ -7,6 +7,7 @@
 #include <QObject>
 
 class Application;
+class AudioStreamServer;
 class IncomingDataParser;
 class OutgoingDataCreator;
 class QHostAddress;
@@ -14,6 +15,7 @@ class QImage;
 class QTcpServer;
 class QTcpSocket;
 class RemoteClient;
+class TranscodeCache;
 
 class NetworkRemote : public QObject {
   Q_OBJECT
@@ -21,10 +23,13 @@ class NetworkRemote : public QObject {
   static const char* kSettingsGroup;
   static const quint16 kDefaultServerPort;
   static const char* kTranscoderSettingPostfix;
+  static const char* kTranscodeCacheDirectory;
 
   explicit NetworkRemote(Application* app, QObject* parent = nullptr);
   ~NetworkRemote();
 
+  static bool IpIsPrivate(const QHostAddress& address);
+
  public slots:
   void SetupServer();
   void StartServer();
@@ -38,11 +43,20 @@ class NetworkRemote : public QObject {
   std::unique_ptr<QTcpServer> server_ipv6_;
   std::unique_ptr<IncomingDataParser> incoming_data_parser_;
   std::unique_ptr<OutgoingDataCreator> outgoing_data_creator_;
+  std::unique_ptr<TranscodeCache> transcode_cache_;
+  std::unique_ptr<AudioStreamServer> audio_stream_server_;
 
   quint16 port_;
   bool use_remote_;
   bool only_non_public_ip_;
   bool signals_connected_;
+
+  bool stream_audio_;
+  quint16 stream_port_;
+  int stream_format_;
+  int stream_bitrate_;
+  int stream_max_clients_;
+
   Application* app_;
 
   QList<RemoteClient*> clients_;
@@ -50,7 +64,7 @@ class NetworkRemote : public QObject {
   void StopServer();
   void ReadSettings();
   void CreateRemoteClient(QTcpSocket* client_socket);
-  bool IpIsPrivate(const QHostAddress& address);
+  void StartAudioStream();
 };
 
 #endif  // NETWORKREMOTE_H
@@ -19,8 +19,14 @@
 
 #include <cmath>
 
+#include <QCryptographicHash>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+
 #include "networkremote.h"
+#include "core/closure.h"
 #include "core/logging.h"
+#include "core/threadpools.h"
 #include "core/timeconstants.h"
 #include "core/utilities.h"
 #include "globalsearch/librarysearchprovider.h"
@@ -29,19 +35,34 @@
 
 #include <QSqlDatabase>
 #include <QSqlQuery>
+#include <QUuid>
 #include "core/database.h"
 
 const quint32 OutgoingDataCreator::kFileChunkSize = 100000;  // in Bytes
+const int OutgoingDataCreator::kLibraryChangesChunkSize = 1000;  // in Songs
+const int OutgoingDataCreator::kBroadcastIntervalMsec = 50;
+const int OutgoingDataCreator::kArtMaxSize = 1000;
+const int OutgoingDataCreator::kArtCacheBytes = 8 * 1024 * 1024;
 
 OutgoingDataCreator::OutgoingDataCreator(Application* app)
     : app_(app),
+      art_pending_(false),
       aww_(false),
       ultimate_reader_(new UltimateLyricsReader(this)),
-      fetcher_(new SongInfoFetcher(this)) {
+      fetcher_(new SongInfoFetcher(this)),
+      library_epoch_(QUuid::createUuid().toString()),
+      library_revision_(0),
+      art_cache_(kArtCacheBytes) {
   // Create Keep Alive Timer
   keep_alive_timer_ = new QTimer(this);
   connect(keep_alive_timer_, SIGNAL(timeout()), this, SLOT(SendKeepAlive()));
   keep_alive_timeout_ = 10000;
+
+  // State updates are collected and sent together at most this often
+  broadcast_timer_ = new QTimer(this);
+  broadcast_timer_->setSingleShot(true);
+  broadcast_timer_->setInterval(kBroadcastIntervalMsec);
+  connect(broadcast_timer_, SIGNAL(timeout()), SLOT(SendPendingBroadcasts()));
 }
 
 OutgoingDataCreator::~OutgoingDataCreator() {}
@@ -71,6 +92,16 @@ void OutgoingDataCreator::SetClients(QList<RemoteClient*>* clients) {
 
   CheckEnabledProviders();
 
+  // Track library changes for incremental syncs
+  connect(app_->library_backend(), SIGNAL(SongsDiscovered(SongList)),
+          SLOT(LibrarySongsChanged(SongList)));
+  connect(app_->library_backend(), SIGNAL(SongsStatisticsChanged(SongList)),
+          SLOT(LibrarySongsChanged(SongList)));
+  connect(app_->library_backend(), SIGNAL(SongsRatingChanged(SongList)),
+          SLOT(LibrarySongsChanged(SongList)));
+  connect(app_->library_backend(), SIGNAL(SongsDeleted(SongList)),
+          SLOT(LibrarySongsDeleted(SongList)));
+
   // Setup global search
   app_->global_search()->ReloadSettings();
 
@@ -144,30 +175,73 @@ SongInfoProvider* OutgoingDataCreator::ProviderByName(
   return nullptr;
 }
 
+QList<RemoteClient*> OutgoingDataCreator::ConnectedClients() {
+  QList<RemoteClient*> ret;
+
+  // Iterate over a copy, disconnected clients are removed as we go
+  for (RemoteClient* client : QList<RemoteClient*>(*clients_)) {
+    // Check if the client is still active
+    if (client->State() != QTcpSocket::ConnectedState) {
+      clients_->removeAll(client);
+      delete client;
+      continue;
+    }
+
+    // Do not send data to downloaders
+    if (!client->isDownloader()) ret << client;
+  }
+
+  return ret;
+}
+
 void OutgoingDataCreator::SendDataToClients(pb::remote::Message* msg) {
   // Check if we have clients to send data to
   if (clients_->empty()) {
     return;
   }
 
-  for (RemoteClient* client : *clients_) {
-    // Do not send data to downloaders
-    if (client->isDownloader()) {
-      if (client->State() != QTcpSocket::ConnectedState) {
-        clients_->removeAt(clients_->indexOf(client));
-        delete client;
-      }
-      continue;
-    }
+  // Serialize once, however many clients there are
+  const QByteArray data = RemoteClient::SerializeMessage(msg);
+  for (RemoteClient* client : ConnectedClients()) {
+    client->SendSerializedData(data);
+  }
+}
 
-    // Check if the client is still active
-    if (client->State() == QTcpSocket::ConnectedState) {
-      client->SendData(msg);
-    } else {
-      clients_->removeAt(clients_->indexOf(client));
-      delete client;
+void OutgoingDataCreator::SendStateToClients(pb::remote::Message* msg) {
+  if (clients_->empty()) {
+    return;
+  }
+
+  // A newer message of the same type supersedes one that wasn't sent yet
+  pending_broadcasts_[msg->type()] = RemoteClient::SerializeMessage(msg);
+  if (!broadcast_timer_->isActive()) broadcast_timer_->start();
+}
+
+void OutgoingDataCreator::SendPendingBroadcasts() { FlushBroadcasts(true); }
+
+void OutgoingDataCreator::FlushBroadcasts(bool drop_if_backed_up) {
+  broadcast_timer_->stop();
+
+  const QSet<int> playlists = pending_playlists_;
+  pending_playlists_.clear();
+  for (int id : playlists) {
+    SendPlaylistSongs(id);
+  }
+
+  if (pending_broadcasts_.isEmpty()) return;
+
+  const QList<RemoteClient*> clients = ConnectedClients();
+  for (auto it = pending_broadcasts_.constBegin();
+       it != pending_broadcasts_.constEnd(); ++it) {
+    for (RemoteClient* client : clients) {
+      if (drop_if_backed_up) {
+        client->SendStateData(pb::remote::MsgType(it.key()), it.value());
+      } else {
+        client->SendSerializedData(it.value());
+      }
     }
   }
+  pending_broadcasts_.clear();
 }
 
 void OutgoingDataCreator::SendClementineInfo() {
@@ -221,7 +295,7 @@ void OutgoingDataCreator::SendAllPlaylists() {
   for (const PlaylistBackend::Playlist& p :
        app_->playlist_backend()->GetAllPlaylists()) {
     bool playlist_open = app_->playlist_manager()->IsPlaylistOpen(p.id);
-    int item_count = playlist_open ? app_playlists.at(p.id)->rowCount() : 0;
+    int item_count = playlist_open ? app_playlists.at(p.id)->item_count() : 0;
 
     // Create a new playlist
     pb::remote::Playlist* playlist = playlists->add_playlist();
@@ -257,7 +331,7 @@ void OutgoingDataCreator::SendAllActivePlaylists() {
     playlist->set_name(DataCommaSizeFromQString(playlist_name));
     playlist->set_id(p->id());
     playlist->set_active((p->id() == active_playlist));
-    playlist->set_item_count(p->rowCount());
+    playlist->set_item_count(p->item_count());
     playlist->set_closed(false);
   }
 
@@ -295,7 +369,7 @@ void OutgoingDataCreator::SendFirstData(bool send_playlist_songs) {
     qLog(Info) << "No current item found!";
   }
 
-  CurrentSongChanged(current_song_, current_uri_, current_image_);
+  SendSongMetadata();
 
   // then the current volume
   VolumeChanged(app_->player()->GetVolume());
@@ -318,8 +392,16 @@ void OutgoingDataCreator::SendFirstData(bool send_playlist_songs) {
   }
 
   // Send the current random and repeat mode
-  SendShuffleMode(app_->playlist_manager()->sequence()->shuffle_mode());
-  SendRepeatMode(app_->playlist_manager()->sequence()->repeat_mode());
+  if (PlaylistSequence* sequence = app_->playlist_manager()->sequence()) {
+    SendShuffleMode(sequence->shuffle_mode());
+    SendRepeatMode(sequence->repeat_mode());
+  } else {
+    SendShuffleMode(PlaylistSequence::Shuffle_Off);
+    SendRepeatMode(PlaylistSequence::Repeat_Off);
+  }
+
+  // Make sure the state above goes out before we say we're done
+  FlushBroadcasts(false);
 
   // We send all first data
   pb::remote::Message msg;
@@ -334,27 +416,138 @@ void OutgoingDataCreator::CurrentSongChanged(const Song& song,
   current_uri_ = uri;
 
   if (!aww_) {
-    current_image_ = img;
+    // The art changes with the cover, not only with the song.
+    SetCurrentImage(img, QString("%1\n%2\n%3").arg(song.url().toString(),
+                                                   song.art_automatic(),
+                                                   song.art_manual()));
+  }
+
+  SendSongMetadata();
+}
+
+void OutgoingDataCreator::SetCurrentImage(const QImage& image,
+                                          const QString& key) {
+  current_image_ = image;
+  current_art_key_ = key;
+  current_art_hash_.clear();
+  art_pending_ = false;
+  if (image.isNull()) return;
+
+  if (QString* hash = art_hashes_.object(key)) {
+    if (art_cache_.contains(*hash)) {
+      current_art_hash_ = *hash;
+      return;
+    }
+  }
+
+  // Scaling and compressing a big cover takes a while, so it's done on a
+  // worker thread and the metadata waits for it.
+  art_pending_ = true;
+  QFutureWatcher<EncodedArt>* watcher = new QFutureWatcher<EncodedArt>(this);
+  NewClosure(watcher, SIGNAL(finished()), [=]() {
+    ArtEncoded(key, watcher->result());
+    watcher->deleteLater();
+  });
+  watcher->setFuture(ThreadPools::Run<EncodedArt>(
+      ThreadPools::Pool_Interactive,
+      std::bind(&OutgoingDataCreator::EncodeArt, image)));
+}
+
+OutgoingDataCreator::EncodedArt OutgoingDataCreator::EncodeArt(
+    const QImage& image) {
+  QImage small;
+  // Check if we resize the image
+  if (image.width() > kArtMaxSize || image.height() > kArtMaxSize) {
+    small = image.scaled(kArtMaxSize, kArtMaxSize, Qt::KeepAspectRatio);
+  } else {
+    small = image;
   }
 
+  // Read the image in a buffer and compress it
+  EncodedArt ret;
+  QBuffer buf(&ret.data_);
+  buf.open(QIODevice::WriteOnly);
+  small.save(&buf, "JPG");
+  buf.close();
+
+  ret.hash_ =
+      QCryptographicHash::hash(ret.data_, QCryptographicHash::Sha1).toHex();
+  return ret;
+}
+
+void OutgoingDataCreator::ArtEncoded(const QString& key,
+                                     const EncodedArt& art) {
+  if (!art.data_.isEmpty()) {
+    art_cache_.insert(art.hash_, new QByteArray(art.data_), art.data_.size());
+    art_hashes_.insert(key, new QString(art.hash_));
+  }
+
+  // The song might have changed while this was being encoded.
+  if (!art_pending_ || key != current_art_key_) return;
+
+  art_pending_ = false;
+  if (!art.data_.isEmpty()) current_art_hash_ = art.hash_;
   SendSongMetadata();
 }
 
 void OutgoingDataCreator::SendSongMetadata() {
+  // It's sent once the art has been encoded.
+  if (art_pending_) return;
+
   // Create the message
   pb::remote::Message msg;
   msg.set_type(pb::remote::CURRENT_METAINFO);
 
   // If there is no song, create an empty node, otherwise fill it with data
   int i = app_->playlist_manager()->active()->current_row();
-  CreateSong(current_song_, current_image_, i,
-             msg.mutable_response_current_metadata()->mutable_song_metadata());
+  pb::remote::SongMetadata* song_metadata =
+      msg.mutable_response_current_metadata()->mutable_song_metadata();
+  CreateSong(current_song_, i, song_metadata);
 
-  SendDataToClients(&msg);
+  if (!current_song_.is_valid() || current_art_hash_.isEmpty()) {
+    SendDataToClients(&msg);
+    return;
+  }
+
+  // Clients that asked for it get a reference to the art instead of the art
+  // itself.  Each version is only serialized if someone needs it.
+  QByteArray with_hash;
+  QByteArray with_art;
+  for (RemoteClient* client : ConnectedClients()) {
+    if (client->artByHash()) {
+      if (with_hash.isEmpty()) {
+        song_metadata->clear_art();
+        song_metadata->set_art_hash(
+            DataCommaSizeFromQString(current_art_hash_));
+        with_hash = RemoteClient::SerializeMessage(&msg);
+      }
+      client->SendSerializedData(with_hash);
+    } else {
+      if (with_art.isEmpty()) {
+        const QByteArray* art = art_cache_.object(current_art_hash_);
+        song_metadata->clear_art_hash();
+        if (art) song_metadata->set_art(art->constData(), art->size());
+        with_art = RemoteClient::SerializeMessage(&msg);
+      }
+      client->SendSerializedData(with_art);
+    }
+  }
 }
 
-void OutgoingDataCreator::CreateSong(const Song& song, const QImage& art,
-                                     const int index,
+void OutgoingDataCreator::SendArt(RemoteClient* client, const QString& hash) {
+  pb::remote::Message msg;
+  msg.set_type(pb::remote::ART);
+  pb::remote::ResponseArt* response = msg.mutable_response_art();
+  response->set_art_hash(DataCommaSizeFromQString(hash));
+
+  if (const QByteArray* art = art_cache_.object(hash)) {
+    response->set_art(art->constData(), art->size());
+  }
+
+  client->SendData(&msg);
+}
+
+void OutgoingDataCreator::CreateSong(const Song& song, const int index,
                                      pb::remote::SongMetadata* song_metadata) {
   if (song.is_valid()) {
     song_metadata->set_id(song.id());
@@ -382,45 +575,53 @@ void OutgoingDataCreator::CreateSong(const Song& song, const QImage& art,
     song_metadata->set_art_manual(DataCommaSizeFromQString(song.art_manual()));
     song_metadata->set_type(
         static_cast< ::pb::remote::SongMetadata_Type>(song.filetype()));
-
-    // Append coverart
-    if (!art.isNull()) {
-      QImage small;
-      // Check if we resize the image
-      if (art.width() > 1000 || art.height() > 1000) {
-        small = art.scaled(1000, 1000, Qt::KeepAspectRatio);
-      } else {
-        small = art;
-      }
-
-      // Read the image in a buffer and compress it
-      QByteArray data;
-      QBuffer buf(&data);
-      buf.open(QIODevice::WriteOnly);
-      small.save(&buf, "JPG");
-
-      // Append the Data in the protocol buffer
-      song_metadata->set_art(data.constData(), data.size());
-    }
   }
 }
 
 void OutgoingDataCreator::VolumeChanged(int volume) {
   // Create the message
-  pb::remote::Message msg;
+  pb::remote::Message& msg = state_message_;
+  msg.Clear();
   msg.set_type(pb::remote::SET_VOLUME);
   msg.mutable_request_set_volume()->set_volume(volume);
-  SendDataToClients(&msg);
+  SendStateToClients(&msg);
 }
 
 void OutgoingDataCreator::SendPlaylistSongs(int id) {
-  // Get the PlaylistQByteArray(data.data(), data.size()
+  BuildPlaylistSongs(nullptr, id, 0, -1);
+}
+
+void OutgoingDataCreator::SendPlaylistSongsPage(RemoteClient* client, int id,
+                                                int offset, int limit) {
+  BuildPlaylistSongs(client, id, qMax(0, offset), qMax(0, limit));
+}
+
+void OutgoingDataCreator::BuildPlaylistSongs(RemoteClient* client, int id,
+                                             int offset, int limit) {
   Playlist* playlist = app_->playlist_manager()->playlist(id);
   if (!playlist) {
     qLog(Info) << "Could not find playlist with id = " << id;
     return;
   }
 
+  // Take a snapshot of the songs here, the messages are built on a worker
+  // thread so big playlists don't block the GUI.
+  const SongList song_list = playlist->GetAllSongs();
+  const int generation = client ? 0 : ++playlist_generations_[id];
+
+  QFuture<QByteArray> future = QtConcurrent::run(
+      &OutgoingDataCreator::SerializePlaylistSongs, id,
+      song_list.mid(offset, limit), offset, song_list.count());
+  NewClosure(future, this,
+             SLOT(PlaylistSongsBuilt(QFuture<QByteArray>, RemoteClient*, int,
+                                     int)),
+             future, client, id, generation);
+}
+
+QByteArray OutgoingDataCreator::SerializePlaylistSongs(int id,
+                                                       const SongList& songs,
+                                                       int offset,
+                                                       int total_count) {
   // Create the message and the playlist
   pb::remote::Message msg;
   msg.set_type(pb::remote::PLAYLIST_SONGS);
@@ -428,29 +629,50 @@ void OutgoingDataCreator::SendPlaylistSongs(int id) {
   // Create the Response message
   pb::remote::ResponsePlaylistSongs* pb_response_playlist_songs =
       msg.mutable_response_playlist_songs();
+  pb_response_playlist_songs->set_offset(offset);
+  pb_response_playlist_songs->set_total_count(total_count);
 
   // Create a new playlist
   pb::remote::Playlist* pb_playlist =
       pb_response_playlist_songs->mutable_requested_playlist();
   pb_playlist->set_id(id);
 
-  // Send all songs
-  int index = 0;
-  SongList song_list = playlist->GetAllSongs();
-  QListIterator<Song> it(song_list);
-  QImage null_img;
-  while (it.hasNext()) {
-    Song song = it.next();
+  // Send the songs
+  int index = offset;
+  for (const Song& song : songs) {
     pb::remote::SongMetadata* pb_song = pb_response_playlist_songs->add_songs();
-    CreateSong(song, null_img, index, pb_song);
+    CreateSong(song, index, pb_song);
     ++index;
   }
-  SendDataToClients(&msg);
+
+  return RemoteClient::SerializeMessage(&msg);
+}
+
+void OutgoingDataCreator::PlaylistSongsBuilt(QFuture<QByteArray> future,
+                                             RemoteClient* client, int id,
+                                             int generation) {
+  if (!client) {
+    // Superseded by a newer copy of the playlist
+    if (generation != playlist_generations_.value(id)) return;
+
+    for (RemoteClient* c : ConnectedClients()) {
+      c->SendSerializedData(future.result());
+    }
+    return;
+  }
+
+  // The client might have gone away while the page was built
+  if (clients_->contains(client) &&
+      client->State() == QTcpSocket::ConnectedState) {
+    client->SendSerializedData(future.result());
+  }
 }
 
 void OutgoingDataCreator::PlaylistChanged(Playlist* playlist) {
-  // If a playlist changed, then send the new songs to the client
-  SendPlaylistSongs(playlist->id());
+  // If a playlist changed, then send the new songs to the client.  A burst of
+  // changes to the same playlist is only sent once.
+  pending_playlists_.insert(playlist->id());
+  if (!broadcast_timer_->isActive()) broadcast_timer_->start();
 }
 
 void OutgoingDataCreator::StateChanged(Engine::State state) {
@@ -511,7 +733,7 @@ void OutgoingDataCreator::SendRepeatMode(PlaylistSequence::RepeatMode mode) {
       break;
   }
 
-  SendDataToClients(&msg);
+  SendStateToClients(&msg);
 }
 
 void OutgoingDataCreator::SendShuffleMode(PlaylistSequence::ShuffleMode mode) {
@@ -523,6 +745,9 @@ void OutgoingDataCreator::SendShuffleMode(PlaylistSequence::ShuffleMode mode) {
       msg.mutable_shuffle()->set_shuffle_mode(pb::remote::Shuffle_Off);
       break;
     case PlaylistSequence::Shuffle_All:
+    // The remote doesn't know about the weighted modes
+    case PlaylistSequence::Shuffle_ByRating:
+    case PlaylistSequence::Shuffle_ByPlayCount:
       msg.mutable_shuffle()->set_shuffle_mode(pb::remote::Shuffle_All);
       break;
     case PlaylistSequence::Shuffle_InsideAlbum:
@@ -533,7 +758,7 @@ void OutgoingDataCreator::SendShuffleMode(PlaylistSequence::ShuffleMode mode) {
       break;
   }
 
-  SendDataToClients(&msg);
+  SendStateToClients(&msg);
 }
 
 void OutgoingDataCreator::SendKeepAlive() {
@@ -543,7 +768,8 @@ void OutgoingDataCreator::SendKeepAlive() {
 }
 
 void OutgoingDataCreator::UpdateTrackPosition() {
-  pb::remote::Message msg;
+  pb::remote::Message& msg = state_message_;
+  msg.Clear();
   msg.set_type(pb::remote::UPDATE_TRACK_POSITION);
 
   int position = std::floor(
@@ -557,7 +783,7 @@ void OutgoingDataCreator::UpdateTrackPosition() {
 
   last_track_position_ = position;
 
-  SendDataToClients(&msg);
+  SendStateToClients(&msg);
 }
 
 void OutgoingDataCreator::DisconnectAllClients() {
@@ -594,6 +820,12 @@ void OutgoingDataCreator::SendLyrics(int id,
 }
 
 void OutgoingDataCreator::SendLibrary(RemoteClient* client) {
+  // Anything that changes while the copy is made is sent again by the next
+  // incremental sync, which is harmless.
+  const qint64 revision = library_revision_;
+  const LibraryBackend::Statistics statistics =
+      app_->library_backend()->statistics();
+
   // Get a temporary file name
   QString temp_file_name = Utilities::GetTemporaryFileName();
 
@@ -603,13 +835,17 @@ void OutgoingDataCreator::SendLibrary(RemoteClient* client) {
 
   app_->database()->AttachDatabaseOnDbConnection("songs_export", adb, db);
 
-  // Copy the content of the song table to this temporary database
-  QSqlQuery q(QString(
-                  "create table songs_export.songs as SELECT * FROM songs "
-                  "where unavailable = 0;"),
-              db);
+  // Copy the content of the song table to this temporary database.  This only
+  // reads from the library, so it can run while the library is being updated.
+  {
+    Database::ReadLocker l(app_->database());
+    QSqlQuery q(QString(
+                    "create table songs_export.songs as SELECT * FROM songs "
+                    "where unavailable = 0;"),
+                db);
 
-  if (app_->database()->CheckErrors(q)) return;
+    if (app_->database()->CheckErrors(q)) return;
+  }
 
   // Detach the database
   app_->database()->DetachDatabase("songs_export");
@@ -643,6 +879,11 @@ void OutgoingDataCreator::SendLibrary(RemoteClient* client) {
     chunk->set_size(file.size());
     chunk->set_data(data.data(), data.size());
     chunk->set_file_hash(sha1.data(), sha1.size());
+    chunk->set_library_epoch(DataCommaSizeFromQString(library_epoch_));
+    chunk->set_library_revision(revision);
+    chunk->set_song_count(statistics.song_count);
+    chunk->set_total_length_nanosec(statistics.total_length_nanosec);
+    chunk->set_total_file_size(statistics.total_filesize);
 
     // Send data directly to the client
     client->SendData(&msg);
@@ -658,11 +899,80 @@ void OutgoingDataCreator::SendLibrary(RemoteClient* client) {
   file.remove();
 }
 
+void OutgoingDataCreator::LibrarySongsChanged(const SongList& songs) {
+  RecordLibraryChanges(songs, false);
+}
+
+void OutgoingDataCreator::LibrarySongsDeleted(const SongList& songs) {
+  RecordLibraryChanges(songs, true);
+}
+
+void OutgoingDataCreator::RecordLibraryChanges(const SongList& songs,
+                                               bool deleted) {
+  // Only the latest change to each song is kept, so this never grows past the
+  // number of songs that have been in the library.
+  library_revision_++;
+  for (const Song& song : songs) {
+    LibraryChange& change = library_changes_[song.id()];
+    change.revision_ = library_revision_;
+    change.deleted_ = deleted;
+  }
+}
+
+void OutgoingDataCreator::SendLibraryChanges(RemoteClient* client,
+                                             const QString& epoch,
+                                             qint64 revision) {
+  pb::remote::Message msg;
+  msg.set_type(pb::remote::LIBRARY_CHANGES);
+  pb::remote::ResponseLibraryChanges* response =
+      msg.mutable_response_library_changes();
+  response->set_library_epoch(DataCommaSizeFromQString(library_epoch_));
+  response->set_library_revision(library_revision_);
+
+  if (epoch != library_epoch_ || revision > library_revision_) {
+    response->set_full_sync_required(true);
+    response->set_last_chunk(true);
+    client->SendData(&msg);
+    return;
+  }
+
+  QList<int> changed_ids;
+  for (auto it = library_changes_.constBegin();
+       it != library_changes_.constEnd(); ++it) {
+    if (it->revision_ <= revision) continue;
+
+    if (it->deleted_) {
+      response->add_deleted_song_ids(it.key());
+    } else {
+      changed_ids << it.key();
+    }
+  }
+
+  // Deletions go in the first message, changed songs are looked up and sent
+  // a chunk at a time.
+  for (int i = 0; i < changed_ids.count(); i += kLibraryChangesChunkSize) {
+    const SongList songs = app_->library_backend()->GetSongsById(
+        changed_ids.mid(i, kLibraryChangesChunkSize));
+    for (const Song& song : songs) {
+      CreateSong(song, -1, response->add_changed_songs());
+    }
+
+    if (i + kLibraryChangesChunkSize < changed_ids.count()) {
+      client->SendData(&msg);
+      response->clear_changed_songs();
+      response->clear_deleted_song_ids();
+    }
+  }
+
+  response->set_last_chunk(true);
+  client->SendData(&msg);
+}
+
 void OutgoingDataCreator::EnableKittens(bool aww) { aww_ = aww; }
 
 void OutgoingDataCreator::SendKitten(const QImage& kitten) {
   if (aww_) {
-    current_image_ = kitten;
+    SetCurrentImage(kitten, QString::number(kitten.cacheKey()));
     SendSongMetadata();
   }
 }
@@ -695,7 +1005,6 @@ void OutgoingDataCreator::ResultsAvailable(
 
   GlobalSearchRequest search_request = global_search_result_map_.value(id);
   RemoteClient* client = search_request.client_;
-  QImage null_img;
 
   pb::remote::Message msg;
   pb::remote::ResponseGlobalSearch* response =
@@ -717,7 +1026,7 @@ void OutgoingDataCreator::ResultsAvailable(
 
   for (const SearchProvider::Result& result : results) {
     pb::remote::SongMetadata* pb_song = response->add_song_metadata();
-    CreateSong(result.metadata_, null_img, 0, pb_song);
+    CreateSong(result.metadata_, 0, pb_song);
   }
 
   client->SendData(&msg);
@@ -3,12 +3,16 @@
 
 #include <memory>
 
+#include <QCache>
+#include <QFuture>
 #include <QTcpSocket>
+#include <QHash>
 #include <QImage>
 #include <QList>
 #include <QTimer>
 #include <QMap>
 #include <QQueue>
+#include <QSet>
 
 #include "core/player.h"
 #include "core/application.h"
@@ -47,11 +51,18 @@ class OutgoingDataCreator : public QObject {
   ~OutgoingDataCreator();
 
   static const quint32 kFileChunkSize;
+  static const int kLibraryChangesChunkSize;
+  static const int kBroadcastIntervalMsec;
+  // Bigger art is scaled down before it's sent.
+  static const int kArtMaxSize;
+  // How many bytes of encoded art are kept for GET_ART.
+  static const int kArtCacheBytes;
 
   void SetClients(QList<RemoteClient*>* clients);
 
-  static void CreateSong(const Song& song, const QImage& art, const int index,
-                  pb::remote::SongMetadata* song_metadata);
+  // Fills in everything but the art, SendSongMetadata adds that.
+  static void CreateSong(const Song& song, const int index,
+                         pb::remote::SongMetadata* song_metadata);
 
  public slots:
   void SendClementineInfo();
@@ -59,6 +70,8 @@ class OutgoingDataCreator : public QObject {
   void SendAllActivePlaylists();
   void SendFirstData(bool send_playlist_songs);
   void SendPlaylistSongs(int id);
+  void SendPlaylistSongsPage(RemoteClient* client, int id, int offset,
+                             int limit);
   void PlaylistChanged(Playlist*);
   void VolumeChanged(int volume);
   void PlaylistAdded(int id, const QString& name, bool favorite);
@@ -78,22 +91,50 @@ class OutgoingDataCreator : public QObject {
   void GetLyrics();
   void SendLyrics(int id, const SongInfoFetcher::Result& result);
   void SendLibrary(RemoteClient* client);
+  void SendLibraryChanges(RemoteClient* client, const QString& epoch,
+                          qint64 revision);
   void EnableKittens(bool aww);
   void SendKitten(const QImage& kitten);
+  void SendArt(RemoteClient* client, const QString& hash);
 
   void DoGlobalSearch(const QString& query, RemoteClient* client);
   void ResultsAvailable(int id, const SearchProvider::ResultList& results);
   void SearchFinished(int id);
 
+ private slots:
+  void SendPendingBroadcasts();
+  void PlaylistSongsBuilt(QFuture<QByteArray> future, RemoteClient* client,
+                          int id, int generation);
+  void LibrarySongsChanged(const SongList& songs);
+  void LibrarySongsDeleted(const SongList& songs);
+
  private:
+  // The most recent change to a library song, for incremental syncs.
+  struct LibraryChange {
+    qint64 revision_;
+    bool deleted_;
+  };
+  // Art scaled to kArtMaxSize and compressed, and the hash clients ask for it
+  // by.
+  struct EncodedArt {
+    QString hash_;
+    QByteArray data_;
+  };
+
   Application* app_;
   QList<RemoteClient*>* clients_;
   Song current_song_;
   QString current_uri_;
   QImage current_image_;
+  // The hash of current_image_'s encoded art.  Empty while it's being
+  // encoded, the metadata is sent once it's done.
+  QString current_art_key_;
+  QString current_art_hash_;
+  bool art_pending_;
   Engine::State last_state_;
   QTimer* keep_alive_timer_;
   QTimer* track_position_timer_;
+  QTimer* broadcast_timer_;
   int keep_alive_timeout_;
   int last_track_position_;
   bool aww_;
@@ -105,8 +146,42 @@ class OutgoingDataCreator : public QObject {
 
   QMap<int, GlobalSearchRequest> global_search_result_map_;
 
+  // Revisions only mean anything within one run - the epoch tells clients
+  // when they're talking to a different one.
+  QString library_epoch_;
+  qint64 library_revision_;
+  QHash<int, LibraryChange> library_changes_;
+
+  // State updates waiting for the next broadcast, newest message of each
+  // type only, and playlists whose songs need sending again.
+  QMap<int, QByteArray> pending_broadcasts_;
+  QSet<int> pending_playlists_;
+
+  // Reused for the position and volume updates, which are sent often enough
+  // that building a new message each time shows up.
+  pb::remote::Message state_message_;
+
+  // Bumped every time a playlist's songs are broadcast, so an older build
+  // finishing late doesn't overwrite a newer one.
+  QMap<int, int> playlist_generations_;
+
+  // Encoded art by hash, and the hash by the song and size it was encoded
+  // for, so reconnects and repeated songs don't encode it again.
+  QCache<QString, QByteArray> art_cache_;
+  QCache<QString, QString> art_hashes_;
+
+  QList<RemoteClient*> ConnectedClients();
   void SendDataToClients(pb::remote::Message* msg);
+  void SendStateToClients(pb::remote::Message* msg);
+  void BuildPlaylistSongs(RemoteClient* client, int id, int offset, int limit);
+  static QByteArray SerializePlaylistSongs(int id, const SongList& songs,
+                                           int offset, int total_count);
+  void FlushBroadcasts(bool drop_if_backed_up);
+  void RecordLibraryChanges(const SongList& songs, bool deleted);
   void SetEngineState(pb::remote::ResponseClementineInfo* msg);
+  void SetCurrentImage(const QImage& image, const QString& key);
+  void ArtEncoded(const QString& key, const EncodedArt& art);
+  static EncodedArt EncodeArt(const QImage& image);
   void CheckEnabledProviders();
   SongInfoProvider* ProviderByName(const QString& name) const;
 };
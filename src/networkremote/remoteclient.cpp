@@ -20,21 +20,26 @@
 #include "remoteclient.h"
 #include "networkremote.h"
 
-#include <QDataStream>
 #include <QSettings>
+#include <QtEndian>
 
-RemoteClient::RemoteClient(Application* app, QTcpSocket* client)
+const qint64 RemoteClient::kMaxStateBacklog = 64 * 1024;  // in Bytes
+// Receiving more than 128mb is very unlikely
+const quint32 RemoteClient::kMaxMessageLength = 128 * 1024 * 1024;
+
+RemoteClient::RemoteClient(Application* app, QTcpSocket* client,
+                           TranscodeCache* transcode_cache)
     : app_(app),
       downloader_(false),
+      art_by_hash_(false),
       client_(client),
-      song_sender_(new SongSender(app, this)) {
-  // Open the buffer
-  buffer_.setData(QByteArray());
-  buffer_.open(QIODevice::ReadWrite);
-  reading_protobuf_ = false;
+      song_sender_(new SongSender(app, this, transcode_cache)) {
+  buffer_.reserve(4096);
 
   // Connect to the slot IncomingData when receiving data
   connect(client, SIGNAL(readyRead()), this, SLOT(IncomingData()));
+  connect(client, SIGNAL(bytesWritten(qint64)), SIGNAL(BytesWritten(qint64)));
+  connect(client, SIGNAL(bytesWritten(qint64)), SLOT(FlushPendingState()));
 
   // Check if we use auth code
   QSettings s;
@@ -62,48 +67,50 @@ RemoteClient::~RemoteClient() {
 void RemoteClient::setDownloader(bool downloader) { downloader_ = downloader; }
 
 void RemoteClient::IncomingData() {
-  while (client_->bytesAvailable()) {
-    if (!reading_protobuf_) {
-      // If we have less than 4 byte, we cannot read the length. Wait for more data
-      if (client_->bytesAvailable() < 4) {
-        break;
-      }
-      // Read the length of the next message
-      QDataStream s(client_);
-      s >> expected_length_;
-
-      // Receiving more than 128mb is very unlikely
-      // Flush the data and disconnect the client
-      if (expected_length_ > 134217728) {
-        qLog(Debug) << "Received invalid data, disconnect client";
-        qLog(Debug) << "expected_length_ =" << expected_length_;
-        client_->close();
-        return;
-      }
-
-      reading_protobuf_ = true;
+  // Append everything the socket has to the end of the buffer
+  const int old_size = buffer_.size();
+  const qint64 available = client_->bytesAvailable();
+  if (available <= 0) return;
+
+  buffer_.resize(old_size + available);
+  const qint64 read = client_->read(buffer_.data() + old_size, available);
+  buffer_.resize(old_size + qMax(read, qint64(0)));
+
+  // Parse every complete message where it is in the buffer
+  const int header = sizeof(quint32);
+  int pos = 0;
+  while (buffer_.size() - pos >= header) {
+    const quint32 length = qFromBigEndian<quint32>(
+        reinterpret_cast<const uchar*>(buffer_.constData() + pos));
+
+    // Flush the data and disconnect the client
+    if (length > kMaxMessageLength) {
+      qLog(Debug) << "Received invalid data, disconnect client";
+      qLog(Debug) << "length =" << length;
+      buffer_.clear();
+      client_->close();
+      return;
     }
 
-    // Read some of the message
-    buffer_.write(client_->read(expected_length_ - buffer_.size()));
+    if (quint32(buffer_.size() - pos - header) < length) break;
 
-    // Did we get everything?
-    if (buffer_.size() == expected_length_) {
-      // Parse the message
-      ParseMessage(buffer_.data());
+    ParseMessage(buffer_.constData() + pos + header, length);
+    pos += header + length;
 
-      // Clear the buffer
-      buffer_.close();
-      buffer_.setData(QByteArray());
-      buffer_.open(QIODevice::ReadWrite);
-      reading_protobuf_ = false;
+    // The message might have disconnected the client
+    if (client_->state() != QAbstractSocket::ConnectedState) {
+      buffer_.clear();
+      return;
     }
   }
+
+  // Only the start of the next message is left, move it to the front
+  if (pos) buffer_.remove(0, pos);
 }
 
-void RemoteClient::ParseMessage(const QByteArray& data) {
-  pb::remote::Message msg;
-  if (!msg.ParseFromArray(data.constData(), data.size())) {
+void RemoteClient::ParseMessage(const char* data, int size) {
+  pb::remote::Message& msg = message_;
+  if (!msg.ParseFromArray(data, size)) {
     qLog(Info) << "Couldn't parse data";
     return;
   }
@@ -119,6 +126,7 @@ void RemoteClient::ParseMessage(const QByteArray& data) {
 
   if (msg.type() == pb::remote::CONNECT) {
     setDownloader(msg.request_connect().downloader());
+    art_by_hash_ = msg.request_connect().art_by_hash();
     qDebug() << "Downloader" << downloader_;
   }
 
@@ -156,25 +164,30 @@ void RemoteClient::DisconnectClient(pb::remote::ReasonDisconnect reason) {
   client_->close();
 }
 
-// Sends data to client without check if authenticated
-void RemoteClient::SendDataToClient(pb::remote::Message* msg) {
+QByteArray RemoteClient::SerializeMessage(pb::remote::Message* msg) {
   // Set the default version
   msg->set_version(msg->default_instance().version());
 
+  // Serialize the message straight into one buffer behind its length, so
+  // file chunks aren't copied again on the way to the socket.
+  const int length = msg->ByteSize();
+  QByteArray data(sizeof(qint32) + length, Qt::Uninitialized);
+  qToBigEndian<qint32>(length, reinterpret_cast<uchar*>(data.data()));
+  msg->SerializeWithCachedSizesToArray(
+      reinterpret_cast<google::protobuf::uint8*>(data.data()) +
+      sizeof(qint32));
+  return data;
+}
+
+// Sends data to client without check if authenticated
+void RemoteClient::SendDataToClient(pb::remote::Message* msg) {
+  WriteData(SerializeMessage(msg));
+}
+
+void RemoteClient::WriteData(const QByteArray& data) {
   // Check if we are still connected
   if (client_->state() == QTcpSocket::ConnectedState) {
-    // Serialize the message
-    std::string data = msg->SerializeAsString();
-
-    // write the length of the data first
-    QDataStream s(client_);
-    s << qint32(data.length());
-    if (downloader_) {
-      // Don't use QDataSteam for large files
-      client_->write(data.data(), data.length());
-    } else {
-      s.writeRawData(data.data(), data.length());
-    }
+    client_->write(data);
 
     // Do NOT flush data here! If the client is already disconnected, it
     // causes a SIGPIPE termination!!!
@@ -191,4 +204,32 @@ void RemoteClient::SendData(pb::remote::Message* msg) {
   }
 }
 
+void RemoteClient::SendSerializedData(const QByteArray& data) {
+  if (authenticated_) {
+    WriteData(data);
+  }
+}
+
+void RemoteClient::SendStateData(pb::remote::MsgType type,
+                                 const QByteArray& data) {
+  if (!authenticated_) return;
+
+  if (client_->bytesToWrite() < kMaxStateBacklog && pending_state_.isEmpty()) {
+    WriteData(data);
+  } else {
+    // Replaces any older message of the same type that wasn't sent yet
+    pending_state_[type] = data;
+  }
+}
+
+void RemoteClient::FlushPendingState() {
+  if (pending_state_.isEmpty() || client_->bytesToWrite() >= kMaxStateBacklog)
+    return;
+
+  for (const QByteArray& data : pending_state_) {
+    WriteData(data);
+  }
+  pending_state_.clear();
+}
+
 QAbstractSocket::SocketState RemoteClient::State() { return client_->state(); }
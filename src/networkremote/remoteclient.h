@@ -3,7 +3,8 @@
 
 #include <QAbstractSocket>
 #include <QTcpSocket>
-#include <QBuffer>
+#include <QByteArray>
+#include <QMap>
 
 #include "songsender.h"
 
@@ -13,29 +14,51 @@
 class RemoteClient : public QObject {
   Q_OBJECT
  public:
-  RemoteClient(Application* app, QTcpSocket* client);
+  RemoteClient(Application* app, QTcpSocket* client,
+               TranscodeCache* transcode_cache);
   ~RemoteClient();
 
+  static const qint64 kMaxStateBacklog;
+  static const quint32 kMaxMessageLength;
+
+  // Serializes a message with its length prefix, ready to be written to any
+  // number of clients.
+  static QByteArray SerializeMessage(pb::remote::Message* msg);
+
   // This method checks if client is authenticated before sending the data
   void SendData(pb::remote::Message* msg);
+  void SendSerializedData(const QByteArray& data);
+
+  // Like SendSerializedData, but for messages that only carry the latest
+  // value of something, like the volume.  If the socket is backed up, only
+  // the newest message of each type is kept and the older ones are dropped.
+  void SendStateData(pb::remote::MsgType type, const QByteArray& data);
   QAbstractSocket::SocketState State();
   void setDownloader(bool downloader);
   bool isDownloader() { return downloader_; }
+  // Whether the client wants songs to carry an art hash instead of the art.
+  bool artByHash() const { return art_by_hash_; }
   void DisconnectClient(pb::remote::ReasonDisconnect reason);
 
   SongSender* song_sender() { return song_sender_; }
 
+  // Bytes queued on the socket that the OS hasn't accepted yet
+  qint64 BytesToWrite() const { return client_->bytesToWrite(); }
+
  private slots:
   void IncomingData();
+  void FlushPendingState();
 
 signals:
   void Parse(const pb::remote::Message& msg);
+  void BytesWritten(qint64 bytes);
 
  private:
-  void ParseMessage(const QByteArray& data);
+  void ParseMessage(const char* data, int size);
 
   // Sends data to client without check if authenticated
   void SendDataToClient(pb::remote::Message* msg);
+  void WriteData(const QByteArray& data);
 
   Application* app_;
 
@@ -44,12 +67,19 @@ signals:
   bool authenticated_;
   bool allow_downloads_;
   bool downloader_;
+  bool art_by_hash_;
 
   QTcpSocket* client_;
-  bool reading_protobuf_;
-  quint32 expected_length_;
-  QBuffer buffer_;
+
+  // Bytes read from the socket that don't make a whole message yet.  Messages
+  // are parsed straight out of this buffer into message_, and both are reused
+  // so small requests don't allocate every time.
+  QByteArray buffer_;
+  pb::remote::Message message_;
   SongSender* song_sender_;
+
+  // State messages held back while the socket is backed up
+  QMap<int, QByteArray> pending_state_;
 };
 
 #endif  // REMOTECLIENT_H
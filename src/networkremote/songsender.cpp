@@ -17,6 +17,7 @@
 
 #include "songsender.h"
 
+#include <QCryptographicHash>
 #include <QFileInfo>
 
 #include "core/application.h"
@@ -27,14 +28,18 @@
 #include "networkremote/outgoingdatacreator.h"
 #include "networkremote/remoteclient.h"
 #include "playlist/playlistitem.h"
+#include "transcoder/transcodecache.h"
 
 const quint32 SongSender::kFileChunkSize = 100000;  // in Bytes
+const qint64 SongSender::kMaxBytesToWrite = 4 * kFileChunkSize;
 
-SongSender::SongSender(Application* app, RemoteClient* client)
+SongSender::SongSender(Application* app, RemoteClient* client,
+                       TranscodeCache* transcode_cache)
     : app_(app),
       client_(client),
-      transcoder_(
-          new Transcoder(this, NetworkRemote::kTranscoderSettingPostfix)) {
+      transcode_cache_(transcode_cache),
+      total_transcode_(0),
+      waiting_for_transcode_(false) {
   QSettings s;
   s.beginGroup(NetworkRemote::kSettingsGroup);
 
@@ -43,7 +48,7 @@ SongSender::SongSender(Application* app, RemoteClient* client)
   // Load preset
   QString last_output_format =
       s.value("last_output_format", "audio/x-vorbis").toString();
-  QList<TranscoderPreset> presets = transcoder_->GetAllPresets();
+  QList<TranscoderPreset> presets = Transcoder::GetAllPresets();
   for (int i = 0; i < presets.count(); ++i) {
     if (last_output_format == presets.at(i).codec_mimetype_) {
       transcoder_preset_ = presets.at(i);
@@ -52,20 +57,12 @@ SongSender::SongSender(Application* app, RemoteClient* client)
   }
   qLog(Debug) << "Transcoder preset" << transcoder_preset_.codec_mimetype_;
 
-  connect(transcoder_, SIGNAL(JobComplete(QString, QString, bool)),
+  connect(transcode_cache_, SIGNAL(Transcoded(QString, QString, bool)),
           SLOT(TranscodeJobComplete(QString, QString, bool)));
-  connect(transcoder_, SIGNAL(AllJobsComplete()), SLOT(StartTransfer()));
-
-  total_transcode_ = 0;
+  connect(client_, SIGNAL(BytesWritten(qint64)), SLOT(SendNextChunks()));
 }
 
-SongSender::~SongSender() {
-  disconnect(transcoder_, SIGNAL(JobComplete(QString, QString, bool)), this,
-             SLOT(TranscodeJobComplete(QString, QString, bool)));
-  disconnect(transcoder_, SIGNAL(AllJobsComplete()), this,
-             SLOT(StartTransfer()));
-  transcoder_->Cancel();
-}
+SongSender::~SongSender() { FinishTransfer(); }
 
 void SongSender::SendSongs(const pb::remote::RequestDownloadSongs& request) {
   Song current_song;
@@ -98,35 +95,51 @@ void SongSender::SendSongs(const pb::remote::RequestDownloadSongs& request) {
 
   if (transcode_lossless_files_) {
     TranscodeLosslessFiles();
-  } else {
-    StartTransfer();
   }
+
+  // Files are offered as soon as they're ready, without waiting for the rest
+  // of the queue to be transcoded.
+  StartTransfer();
 }
 
 void SongSender::TranscodeLosslessFiles() {
+  total_transcode_ = 0;
+
   for (DownloadItem item : download_queue_) {
     // Check only lossless files
     if (!item.song_.IsFileLossless()) continue;
 
-    // Add the file to the transcoder
     QString local_file = item.song_.url().toLocalFile();
-
-    transcoder_->AddTemporaryJob(local_file, transcoder_preset_);
-
-    qLog(Debug) << "transcoding" << local_file;
+    if (transcoder_map_.contains(local_file) ||
+        pending_transcodes_.contains(local_file)) {
+      continue;
+    }
     total_transcode_++;
+
+    // The cache might already have it from an earlier download
+    const QString output =
+        transcode_cache_->Request(local_file, transcoder_preset_);
+    if (!output.isEmpty()) {
+      transcoder_map_.insert(local_file, output);
+    } else {
+      qLog(Debug) << "transcoding" << local_file;
+      pending_transcodes_.insert(
+          local_file,
+          transcode_cache_->CacheFilename(local_file, transcoder_preset_));
+    }
   }
 
-  if (total_transcode_ > 0) {
-    transcoder_->Start();
+  if (!pending_transcodes_.isEmpty()) {
     SendTranscoderStatus();
-  } else {
-    StartTransfer();
   }
 }
 
 void SongSender::TranscodeJobComplete(const QString& input,
                                       const QString& output, bool success) {
+  // The cache is shared with other clients, so this might not be ours
+  if (pending_transcodes_.value(input) != output) return;
+  pending_transcodes_.remove(input);
+
   qLog(Debug) << input << "transcoded to" << output << success;
 
   // If it wasn't successful send original file
@@ -135,6 +148,12 @@ void SongSender::TranscodeJobComplete(const QString& input,
   }
 
   SendTranscoderStatus();
+
+  if (waiting_for_transcode_ && !download_queue_.isEmpty() &&
+      download_queue_.head().song_.url().toLocalFile() == input) {
+    waiting_for_transcode_ = false;
+    OfferNextSong();
+  }
 }
 
 void SongSender::SendTranscoderStatus() {
@@ -144,15 +163,13 @@ void SongSender::SendTranscoderStatus() {
 
   pb::remote::ResponseTranscoderStatus* status =
       msg.mutable_response_transcoder_status();
-  status->set_processed(transcoder_map_.count());
+  status->set_processed(total_transcode_ - pending_transcodes_.count());
   status->set_total(total_transcode_);
 
   client_->SendData(&msg);
 }
 
 void SongSender::StartTransfer() {
-  total_transcode_ = 0;
-
   // Send total file size & file count
   SendTotalFileSize();
 
@@ -193,13 +210,21 @@ void SongSender::OfferNextSong() {
   } else {
     // Get the item and send the single song
     DownloadItem item = download_queue_.head();
+    QString local_file = item.song_.url().toLocalFile();
+
+    // Hold the offer back until its transcode is done
+    if (pending_transcodes_.contains(local_file)) {
+      waiting_for_transcode_ = true;
+      return;
+    }
+    local_file = transcoder_map_.value(local_file, local_file);
 
     msg.set_type(pb::remote::SONG_FILE_CHUNK);
     pb::remote::ResponseSongFileChunk* chunk =
         msg.mutable_response_song_file_chunk();
 
     // Open the file
-    QFile file(item.song_.url().toLocalFile());
+    QFile file(local_file);
 
     // Song offer is chunk no 0
     chunk->set_chunk_count(0);
@@ -208,105 +233,151 @@ void SongSender::OfferNextSong() {
     chunk->set_file_number(item.song_no_);
     chunk->set_size(file.size());
 
-    OutgoingDataCreator::CreateSong(item.song_, QImage(), -1,
+    OutgoingDataCreator::CreateSong(item.song_, -1,
                                     chunk->mutable_song_metadata());
   }
 
   client_->SendData(&msg);
 }
 
-void SongSender::ResponseSongOffer(bool accepted) {
-  if (download_queue_.isEmpty()) return;
+void SongSender::ResponseSongOffer(bool accepted, qint64 offset) {
+  if (download_queue_.isEmpty() || transfer_.active_) return;
 
   // Get the item and send the single song
   DownloadItem item = download_queue_.dequeue();
-  if (accepted) SendSingleSong(item);
+  if (accepted) SendSingleSong(item, offset);
 
-  // And offer the next song
-  OfferNextSong();
+  // And offer the next song once this one has been sent
+  if (!transfer_.active_) OfferNextSong();
 }
 
-void SongSender::SendSingleSong(DownloadItem download_item) {
+void SongSender::SendSingleSong(DownloadItem download_item, qint64 offset) {
   // Only local files!!!
   if (!(download_item.song_.url().scheme() == "file")) return;
 
   QString local_file = download_item.song_.url().toLocalFile();
-  bool is_transcoded = transcoder_map_.contains(local_file);
+  transfer_.is_transcoded_ = transcoder_map_.contains(local_file);
 
-  if (is_transcoded) {
+  if (transfer_.is_transcoded_) {
     local_file = transcoder_map_.take(local_file);
   }
 
-  // Open the file
-  QFile file(local_file);
+  transfer_.file_.setFileName(local_file);
+  if (!transfer_.file_.open(QIODevice::ReadOnly)) {
+    qLog(Warning) << "Couldn't open" << local_file << "for sending";
+    return;
+  }
+
+  // Map the file if we can so the chunks and the hash are read straight from
+  // the page cache.  Fall back to reading it if it won't map.
+  const qint64 size = transfer_.file_.size();
+  transfer_.map_ = size > 0 ? transfer_.file_.map(0, size) : nullptr;
 
   // Get sha1 for file
-  QByteArray sha1 = Utilities::Sha1File(file).toHex();
-  qLog(Debug) << "sha1 for file" << local_file << "=" << sha1;
+  if (transfer_.map_) {
+    transfer_.sha1_ =
+        QCryptographicHash::hash(
+            QByteArray::fromRawData(
+                reinterpret_cast<const char*>(transfer_.map_), size),
+            QCryptographicHash::Sha1).toHex();
+  } else {
+    transfer_.sha1_ = Utilities::Sha1File(transfer_.file_).toHex();
+    transfer_.file_.open(QIODevice::ReadOnly);
+  }
+  qLog(Debug) << "sha1 for file" << local_file << "=" << transfer_.sha1_;
+
+  // Calculate the number of chunks
+  transfer_.chunk_count_ = qRound((size / kFileChunkSize) + 0.5);
+
+  // Resume on a chunk boundary so the chunk numbers stay the same as in the
+  // interrupted download.
+  offset = qBound(Q_INT64_C(0), offset, size);
+  transfer_.chunk_number_ = offset / kFileChunkSize + 1;
+  transfer_.offset_ = (transfer_.chunk_number_ - 1) * kFileChunkSize;
+  if (!transfer_.map_) transfer_.file_.seek(transfer_.offset_);
 
-  file.open(QIODevice::ReadOnly);
+  transfer_.item_ = download_item;
+  transfer_.first_chunk_ = true;
+  transfer_.active_ = true;
+
+  SendNextChunks();
+}
+
+void SongSender::SendNextChunks() {
+  while (transfer_.active_ && client_->BytesToWrite() < kMaxBytesToWrite) {
+    if (client_->State() != QAbstractSocket::ConnectedState ||
+        transfer_.offset_ >= transfer_.file_.size()) {
+      FinishTransfer();
+      OfferNextSong();
+      return;
+    }
+
+    SendChunk();
+  }
+}
+
+void SongSender::SendChunk() {
+  const qint64 size = transfer_.file_.size();
+  const int length = qMin<qint64>(kFileChunkSize, size - transfer_.offset_);
 
-  QByteArray data;
   pb::remote::Message msg;
   pb::remote::ResponseSongFileChunk* chunk =
       msg.mutable_response_song_file_chunk();
   msg.set_type(pb::remote::SONG_FILE_CHUNK);
 
-  QImage null_image;
-
-  // Calculate the number of chunks
-  int chunk_count = qRound((file.size() / kFileChunkSize) + 0.5);
-  int chunk_number = 1;
-
-  while (!file.atEnd()) {
-    // Read file chunk
-    data = file.read(kFileChunkSize);
-
-    // Set chunk data
-    chunk->set_chunk_count(chunk_count);
-    chunk->set_chunk_number(chunk_number);
-    chunk->set_file_count(download_item.song_count_);
-    chunk->set_file_number(download_item.song_no_);
-    chunk->set_size(file.size());
+  // Set chunk data
+  chunk->set_chunk_count(transfer_.chunk_count_);
+  chunk->set_chunk_number(transfer_.chunk_number_);
+  chunk->set_file_count(transfer_.item_.song_count_);
+  chunk->set_file_number(transfer_.item_.song_no_);
+  chunk->set_size(size);
+  chunk->set_offset(transfer_.offset_);
+  chunk->set_file_hash(transfer_.sha1_.data(), transfer_.sha1_.size());
+
+  if (transfer_.map_) {
+    chunk->set_data(transfer_.map_ + transfer_.offset_, length);
+  } else {
+    const QByteArray data = transfer_.file_.read(length);
     chunk->set_data(data.data(), data.size());
-    chunk->set_file_hash(sha1.data(), sha1.size());
-
-    // On the first chunk send the metadata, so the client knows
-    // what file it receives.
-    if (chunk_number == 1) {
-      int i = app_->playlist_manager()->active()->current_row();
-      pb::remote::SongMetadata* song_metadata =
-          msg.mutable_response_song_file_chunk()->mutable_song_metadata();
-      OutgoingDataCreator::CreateSong(download_item.song_, null_image, i,
-                                      song_metadata);
-
-      // if the file was transcoded, we have to change the filename and filesize
-      if (is_transcoded) {
-        song_metadata->set_file_size(file.size());
-        QString basefilename = download_item.song_.basefilename();
-        QFileInfo info(basefilename);
-        basefilename.replace("." + info.suffix(),
-                             "." + transcoder_preset_.extension_);
-        song_metadata->set_filename(DataCommaSizeFromQString(basefilename));
-      }
+  }
+
+  // On the first chunk send the metadata, so the client knows
+  // what file it receives.
+  if (transfer_.first_chunk_) {
+    int i = app_->playlist_manager()->active()->current_row();
+    pb::remote::SongMetadata* song_metadata = chunk->mutable_song_metadata();
+    OutgoingDataCreator::CreateSong(transfer_.item_.song_, i, song_metadata);
+
+    // if the file was transcoded, we have to change the filename and filesize
+    if (transfer_.is_transcoded_) {
+      song_metadata->set_file_size(size);
+      QString basefilename = transfer_.item_.song_.basefilename();
+      QFileInfo info(basefilename);
+      basefilename.replace("." + info.suffix(),
+                           "." + transcoder_preset_.extension_);
+      song_metadata->set_filename(DataCommaSizeFromQString(basefilename));
     }
+    transfer_.first_chunk_ = false;
+  }
+
+  // Send data directly to the client
+  client_->SendData(&msg);
 
-    // Send data directly to the client
-    client_->SendData(&msg);
+  transfer_.offset_ += length;
+  transfer_.chunk_number_++;
+}
 
-    // Clear working data
-    chunk->Clear();
-    data.clear();
+void SongSender::FinishTransfer() {
+  if (!transfer_.active_) return;
+  transfer_.active_ = false;
 
-    chunk_number++;
+  if (transfer_.map_) {
+    transfer_.file_.unmap(transfer_.map_);
+    transfer_.map_ = nullptr;
   }
 
-  // If the file was transcoded, delete the temporary one
-  if (is_transcoded) {
-    file.remove();
-  } else {
-    file.close();
-  }
+  // Transcoded files stay in the cache for the next download
+  transfer_.file_.close();
 }
 
 void SongSender::SendAlbum(const Song& song) {
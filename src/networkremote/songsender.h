@@ -1,6 +1,7 @@
 #ifndef SONGSENDER_H
 #define SONGSENDER_H
 
+#include <QFile>
 #include <QMap>
 #include <QQueue>
 #include <QUrl>
@@ -12,7 +13,7 @@
 
 class Application;
 class RemoteClient;
-class Transcoder;
+class TranscodeCache;
 
 struct DownloadItem {
   Song song_;
@@ -25,32 +26,64 @@ struct DownloadItem {
 class SongSender : public QObject {
   Q_OBJECT
  public:
-  SongSender(Application* app, RemoteClient* client);
+  SongSender(Application* app, RemoteClient* client,
+             TranscodeCache* transcode_cache);
   ~SongSender();
 
   static const quint32 kFileChunkSize;
+  static const qint64 kMaxBytesToWrite;
 
  public slots:
   void SendSongs(const pb::remote::RequestDownloadSongs& request);
-  void ResponseSongOffer(bool accepted);
+  void ResponseSongOffer(bool accepted, qint64 offset = 0);
 
  private slots:
   void TranscodeJobComplete(const QString& input, const QString& output, bool success);
   void StartTransfer();
+  void SendNextChunks();
 
  private:
   Application* app_;
   RemoteClient* client_;
 
   TranscoderPreset transcoder_preset_;
-  Transcoder* transcoder_;
+  TranscodeCache* transcode_cache_;
   bool transcode_lossless_files_;
 
   QQueue<DownloadItem> download_queue_;
   QMap<QString, QString> transcoder_map_;
   int total_transcode_;
 
-  void SendSingleSong(DownloadItem download_item);
+  // Lossless files still being transcoded -> their expected output.  The
+  // queue is offered in order and stops at the first of these until it's
+  // ready, while later files keep transcoding in the background.
+  QMap<QString, QString> pending_transcodes_;
+  bool waiting_for_transcode_;
+
+  // The song currently being streamed.  Chunks are only sent while the
+  // socket's write buffer is below kMaxBytesToWrite, and more are sent as it
+  // drains, so a whole file is never held in memory at once.
+  struct Transfer {
+    Transfer() : active_(false), is_transcoded_(false), map_(nullptr),
+                 offset_(0), chunk_number_(0), chunk_count_(0),
+                 first_chunk_(true), item_(Song(), 0, 0) {}
+
+    bool active_;
+    bool is_transcoded_;
+    QFile file_;
+    uchar* map_;
+    qint64 offset_;
+    int chunk_number_;
+    int chunk_count_;
+    bool first_chunk_;
+    QByteArray sha1_;
+    DownloadItem item_;
+  };
+  Transfer transfer_;
+
+  void SendSingleSong(DownloadItem download_item, qint64 offset);
+  void SendChunk();
+  void FinishTransfer();
   void SendAlbum(const Song& song);
   void SendPlaylist(int playlist_id);
   void SendUrls(const pb::remote::RequestDownloadSongs& request);
@@ -18,6 +18,8 @@
 #include "playlist.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <functional>
 #include <memory>
 #include <unordered_map>
@@ -27,11 +29,14 @@
 #include <QCoreApplication>
 #include <QDirIterator>
 #include <QFileInfo>
-#include <QLinkedList>
+#include <QFutureWatcher>
+#include <QHash>
 #include <QMimeData>
 #include <QMutableListIterator>
 #include <QSortFilterProxyModel>
+#include <QThread>
 #include <QUndoStack>
+#include <QVector>
 #include <QtConcurrentRun>
 #include <QtDebug>
 
@@ -46,10 +51,12 @@
 #include "songplaylistitem.h"
 #include "core/application.h"
 #include "core/closure.h"
+#include "core/fileexistencechecker.h"
 #include "core/logging.h"
-#include "core/qhash_qurl.h"
 #include "core/tagreaderclient.h"
+#include "core/threadpools.h"
 #include "core/timeconstants.h"
+#include "core/urlkey.h"
 #include "internet/jamendo/jamendoplaylistitem.h"
 #include "internet/jamendo/jamendoservice.h"
 #include "internet/magnatune/magnatuneplaylistitem.h"
@@ -67,8 +74,6 @@
 #include "smartplaylists/generatorinserter.h"
 #include "smartplaylists/generatormimedata.h"
 
-using std::placeholders::_1;
-using std::placeholders::_2;
 using std::shared_ptr;
 using std::unordered_map;
 
@@ -93,6 +98,7 @@ const char* Playlist::kWriteMetadata = "write_metadata";
 
 const int Playlist::kUndoStackSize = 20;
 const int Playlist::kUndoItemLimit = 500;
+const int Playlist::kRestoreFirstRows = 100;
 
 const qint64 Playlist::kMinScrobblePointNsecs = 31ll * kNsecPerSec;
 const qint64 Playlist::kMaxScrobblePointNsecs = 240ll * kNsecPerSec;
@@ -119,7 +125,12 @@ Playlist::Playlist(PlaylistBackend* backend, TaskManager* task_manager,
       ignore_sorting_(false),
       undo_stack_(new QUndoStack(this)),
       special_type_(special_type),
-      cancel_restore_(false) {
+      cancel_restore_(false),
+      restoring_(false),
+      save_after_restore_(false),
+      hibernated_(false),
+      hibernated_item_count_(0),
+      hibernated_length_(0) {
   undo_stack_->setUndoLimit(kUndoStackSize);
 
   connect(this, SIGNAL(rowsInserted(const QModelIndex&, int, int)),
@@ -127,7 +138,32 @@ Playlist::Playlist(PlaylistBackend* backend, TaskManager* task_manager,
   connect(this, SIGNAL(rowsRemoved(const QModelIndex&, int, int)),
           SIGNAL(PlaylistChanged()));
 
-  Restore();
+  // These have to be connected before the proxy's own connections so the
+  // snapshot is up to date by the time it filters the changed rows.
+  connect(this, SIGNAL(dataChanged(QModelIndex, QModelIndex)),
+          SLOT(FilterSnapshotDataChanged(QModelIndex, QModelIndex)));
+  connect(this, SIGNAL(rowsInserted(QModelIndex, int, int)),
+          SLOT(FilterSnapshotRowsInserted(QModelIndex, int, int)));
+  connect(this, SIGNAL(rowsRemoved(QModelIndex, int, int)),
+          SLOT(FilterSnapshotRowsRemoved(QModelIndex, int, int)));
+  connect(this, SIGNAL(layoutChanged()), SLOT(ClearFilterSnapshot()));
+  connect(this, SIGNAL(modelReset()), SLOT(ClearFilterSnapshot()));
+
+  connect(this, SIGNAL(dataChanged(QModelIndex, QModelIndex)),
+          SLOT(InvalidateAlbumGroups()));
+  connect(this, SIGNAL(rowsInserted(QModelIndex, int, int)),
+          SLOT(InvalidateAlbumGroups()));
+  connect(this, SIGNAL(rowsRemoved(QModelIndex, int, int)),
+          SLOT(InvalidateAlbumGroups()));
+  connect(this, SIGNAL(layoutChanged()), SLOT(InvalidateAlbumGroups()));
+  connect(this, SIGNAL(modelReset()), SLOT(InvalidateAlbumGroups()));
+
+  connect(this, SIGNAL(rowsInserted(QModelIndex, int, int)),
+          SLOT(InvalidateItemRows()));
+  connect(this, SIGNAL(rowsRemoved(QModelIndex, int, int)),
+          SLOT(InvalidateItemRows()));
+  connect(this, SIGNAL(layoutChanged()), SLOT(InvalidateItemRows()));
+  connect(this, SIGNAL(modelReset()), SLOT(InvalidateItemRows()));
 
   proxy_->setSourceModel(this);
   queue_->setSourceModel(this);
@@ -453,16 +489,25 @@ void Playlist::ShuffleModeChanged(PlaylistSequence::ShuffleMode mode) {
   ReshuffleIndices();
 }
 
+PlaylistSequence::RepeatMode Playlist::repeat_mode() const {
+  return playlist_sequence_ ? playlist_sequence_->repeat_mode()
+                            : PlaylistSequence::Repeat_Off;
+}
+
+PlaylistSequence::ShuffleMode Playlist::shuffle_mode() const {
+  return playlist_sequence_ ? playlist_sequence_->shuffle_mode()
+                            : PlaylistSequence::Shuffle_Off;
+}
+
 bool Playlist::FilterContainsVirtualIndex(int i) const {
   if (i < 0 || i >= virtual_items_.count()) return false;
 
-  return proxy_->filterAcceptsRow(virtual_items_[i], QModelIndex());
+  return proxy_->filterAcceptsRow(virtual_items_.at(i), QModelIndex());
 }
 
 int Playlist::NextVirtualIndex(int i, bool ignore_repeat_track) const {
-  PlaylistSequence::RepeatMode repeat_mode = playlist_sequence_->repeat_mode();
-  PlaylistSequence::ShuffleMode shuffle_mode =
-      playlist_sequence_->shuffle_mode();
+  PlaylistSequence::RepeatMode repeat_mode = this->repeat_mode();
+  PlaylistSequence::ShuffleMode shuffle_mode = this->shuffle_mode();
   bool album_only = repeat_mode == PlaylistSequence::Repeat_Album ||
                     shuffle_mode == PlaylistSequence::Shuffle_InsideAlbum;
 
@@ -482,7 +527,7 @@ int Playlist::NextVirtualIndex(int i, bool ignore_repeat_track) const {
     // the selected to be skipped
     while (i < virtual_items_.count() &&
            (!FilterContainsVirtualIndex(i) ||
-            item_at(virtual_items_[i])->GetShouldSkip())) {
+            item_at(virtual_items_.at(i))->GetShouldSkip())) {
       ++i;
     }
     return i;
@@ -491,10 +536,10 @@ int Playlist::NextVirtualIndex(int i, bool ignore_repeat_track) const {
   // We need to advance i until we get something else on the same album
   Song last_song = current_item_metadata();
   for (int j = i + 1; j < virtual_items_.count(); ++j) {
-    if (item_at(virtual_items_[j])->GetShouldSkip()) {
+    if (item_at(virtual_items_.at(j))->GetShouldSkip()) {
       continue;
     }
-    Song this_song = item_at(virtual_items_[j])->Metadata();
+    Song this_song = item_at(virtual_items_.at(j))->Metadata();
     if (((last_song.is_compilation() && this_song.is_compilation()) ||
          last_song.artist() == this_song.artist()) &&
         last_song.album() == this_song.album() &&
@@ -508,9 +553,8 @@ int Playlist::NextVirtualIndex(int i, bool ignore_repeat_track) const {
 }
 
 int Playlist::PreviousVirtualIndex(int i, bool ignore_repeat_track) const {
-  PlaylistSequence::RepeatMode repeat_mode = playlist_sequence_->repeat_mode();
-  PlaylistSequence::ShuffleMode shuffle_mode =
-      playlist_sequence_->shuffle_mode();
+  PlaylistSequence::RepeatMode repeat_mode = this->repeat_mode();
+  PlaylistSequence::ShuffleMode shuffle_mode = this->shuffle_mode();
   bool album_only = repeat_mode == PlaylistSequence::Repeat_Album ||
                     shuffle_mode == PlaylistSequence::Shuffle_InsideAlbum;
 
@@ -527,7 +571,7 @@ int Playlist::PreviousVirtualIndex(int i, bool ignore_repeat_track) const {
 
     // Decrement i until we find any track that is in the filter
     while (i >= 0 && (!FilterContainsVirtualIndex(i) ||
-                      item_at(virtual_items_[i])->GetShouldSkip()))
+                      item_at(virtual_items_.at(i))->GetShouldSkip()))
       --i;
     return i;
   }
@@ -535,10 +579,10 @@ int Playlist::PreviousVirtualIndex(int i, bool ignore_repeat_track) const {
   // We need to decrement i until we get something else on the same album
   Song last_song = current_item_metadata();
   for (int j = i - 1; j >= 0; --j) {
-    if (item_at(virtual_items_[j])->GetShouldSkip()) {
+    if (item_at(virtual_items_.at(j))->GetShouldSkip()) {
       continue;
     }
-    Song this_song = item_at(virtual_items_[j])->Metadata();
+    Song this_song = item_at(virtual_items_.at(j))->Metadata();
     if (((last_song.is_compilation() && this_song.is_compilation()) ||
          last_song.artist() == this_song.artist()) &&
         last_song.album() == this_song.album() &&
@@ -562,7 +606,7 @@ int Playlist::next_row(bool ignore_repeat_track) const {
   if (next_virtual_index >= virtual_items_.count()) {
     // We've gone off the end of the playlist.
 
-    switch (playlist_sequence_->repeat_mode()) {
+    switch (repeat_mode()) {
       case PlaylistSequence::Repeat_Off:
       case PlaylistSequence::Repeat_Intro:
         return -1;
@@ -580,7 +624,24 @@ int Playlist::next_row(bool ignore_repeat_track) const {
   if (next_virtual_index < 0 || next_virtual_index >= virtual_items_.count())
     return -1;
 
-  return virtual_items_[next_virtual_index];
+  return virtual_items_.at(next_virtual_index);
+}
+
+QList<int> Playlist::upcoming_rows(int count) const {
+  QList<int> ret;
+  for (int i = 0; i < queue_->ItemCount() && ret.count() < count; ++i) {
+    ret << queue_->mapToSource(queue_->index(i, 0)).row();
+  }
+
+  int virtual_index = current_virtual_index_;
+  while (ret.count() < count) {
+    virtual_index = NextVirtualIndex(virtual_index, true);
+    if (virtual_index < 0 || virtual_index >= virtual_items_.count()) break;
+
+    const int row = virtual_items_.at(virtual_index);
+    if (!ret.contains(row)) ret << row;
+  }
+  return ret;
 }
 
 int Playlist::previous_row(bool ignore_repeat_track) const {
@@ -589,7 +650,7 @@ int Playlist::previous_row(bool ignore_repeat_track) const {
   if (prev_virtual_index < 0) {
     // We've gone off the beginning of the playlist.
 
-    switch (playlist_sequence_->repeat_mode()) {
+    switch (repeat_mode()) {
       case PlaylistSequence::Repeat_Off:
         return -1;
       case PlaylistSequence::Repeat_Track:
@@ -606,7 +667,7 @@ int Playlist::previous_row(bool ignore_repeat_track) const {
   // Still off the beginning?  Then just give up
   if (prev_virtual_index < 0) return -1;
 
-  return virtual_items_[prev_virtual_index];
+  return virtual_items_.at(prev_virtual_index);
 }
 
 int Playlist::dynamic_history_length() const {
@@ -643,8 +704,7 @@ void Playlist::set_current_row(int i, bool is_stopping) {
     ReshuffleIndices();
 
     // Bring the one we've been asked to play to the start of the list
-    virtual_items_.takeAt(virtual_items_.indexOf(i));
-    virtual_items_.prepend(i);
+    virtual_items_.MoveTo(i, 0);
     current_virtual_index_ = 0;
   } else if (is_shuffled_) {
     current_virtual_index_ = virtual_items_.indexOf(i);
@@ -745,23 +805,20 @@ bool Playlist::dropMimeData(const QMimeData* data, Qt::DropAction action,
 
   if (const SongMimeData* song_data = qobject_cast<const SongMimeData*>(data)) {
     // Dragged from a library
-    // We want to check if these songs are from the actual local file backend,
-    // if they are we treat them differently.
-    if (song_data->backend &&
-        song_data->backend->songs_table() == Library::kSongsTable)
-      InsertSongItems<LibraryPlaylistItem>(song_data->songs, row, play_now,
-                                           enqueue_now, enqueue_next_now);
-    else if (song_data->backend &&
-             song_data->backend->songs_table() == MagnatuneService::kSongsTable)
-      InsertSongItems<MagnatunePlaylistItem>(song_data->songs, row, play_now,
-                                             enqueue_now, enqueue_next_now);
-    else if (song_data->backend &&
-             song_data->backend->songs_table() == JamendoService::kSongsTable)
-      InsertSongItems<JamendoPlaylistItem>(song_data->songs, row, play_now,
-                                           enqueue_now, enqueue_next_now);
-    else
-      InsertSongItems<SongPlaylistItem>(song_data->songs, row, play_now,
-                                        enqueue_now, enqueue_next_now);
+    if (song_data->song_loader) {
+      // The songs haven't been looked up yet
+      LibraryBackendInterface* backend = song_data->backend;
+      QFuture<SongList> future = QtConcurrent::run(song_data->song_loader);
+      NewClosure(future, [=]() {
+        // The playlist might have changed while we were waiting
+        const int pos = row > rowCount() ? -1 : row;
+        InsertBackendSongs(backend, future.result(), pos, play_now,
+                           enqueue_now, enqueue_next_now);
+      });
+    } else {
+      InsertBackendSongs(song_data->backend, song_data->songs, row, play_now,
+                         enqueue_now, enqueue_next_now);
+    }
   } else if (const InternetMimeData* internet_data =
                  qobject_cast<const InternetMimeData*>(data)) {
     // Dragged from the Internet pane
@@ -841,6 +898,26 @@ bool Playlist::dropMimeData(const QMimeData* data, Qt::DropAction action,
   return true;
 }
 
+void Playlist::InsertBackendSongs(LibraryBackendInterface* backend,
+                                  const SongList& songs, int pos,
+                                  bool play_now, bool enqueue,
+                                  bool enqueue_next) {
+  // We want to check if these songs are from the actual local file backend,
+  // if they are we treat them differently.
+  if (backend && backend->songs_table() == Library::kSongsTable)
+    InsertSongItems<LibraryPlaylistItem>(songs, pos, play_now, enqueue,
+                                         enqueue_next);
+  else if (backend && backend->songs_table() == MagnatuneService::kSongsTable)
+    InsertSongItems<MagnatunePlaylistItem>(songs, pos, play_now, enqueue,
+                                           enqueue_next);
+  else if (backend && backend->songs_table() == JamendoService::kSongsTable)
+    InsertSongItems<JamendoPlaylistItem>(songs, pos, play_now, enqueue,
+                                         enqueue_next);
+  else
+    InsertSongItems<SongPlaylistItem>(songs, pos, play_now, enqueue,
+                                      enqueue_next);
+}
+
 void Playlist::InsertUrls(const QList<QUrl>& urls, int pos, bool play_now,
                           bool enqueue, bool enqueue_next) {
   SongLoaderInserter* inserter = new SongLoaderInserter(
@@ -871,7 +948,7 @@ void Playlist::InsertSmartPlaylist(GeneratorPtr generator, int pos,
 
 void Playlist::TurnOnDynamicPlaylist(GeneratorPtr gen) {
   dynamic_playlist_ = gen;
-  playlist_sequence_->SetUsingDynamicPlaylist(true);
+  if (playlist_sequence_) playlist_sequence_->SetUsingDynamicPlaylist(true);
   ShuffleModeChanged(PlaylistSequence::Shuffle_Off);
   emit DynamicModeChanged(true);
   Save();
@@ -882,59 +959,35 @@ void Playlist::MoveItemWithoutUndo(int source, int dest) {
 }
 
 void Playlist::MoveItemsWithoutUndo(const QList<int>& source_rows, int pos) {
-  layoutAboutToBeChanged();
-  PlaylistItemList moved_items;
-
   if (pos < 0) {
     pos = items_.count();
   }
 
-  // Take the items out of the list first, keeping track of whether the
-  // insertion point changes
-  int offset = 0;
+  // Work out where the insertion point ends up once the items are taken out
   int start = pos;
   for (int source_row : source_rows) {
-    moved_items << items_.takeAt(source_row - offset);
-    if (pos > source_row) {
-      start--;
-    }
-    offset++;
+    if (pos > source_row) start--;
   }
 
-  // Put the items back in
-  for (int i = start; i < start + moved_items.count(); ++i) {
-    moved_items[i - start]->RemoveForegroundColor(kDynamicHistoryPriority);
-    items_.insert(i, moved_items[i - start]);
+  // The moved items go in a block at start, everything else keeps its order
+  // around them.
+  QVector<int> old_to_new(items_.count(), -1);
+  for (int i = 0; i < source_rows.count(); ++i) {
+    old_to_new[source_rows[i]] = start + i;
+    items_[source_rows[i]]->RemoveForegroundColor(kDynamicHistoryPriority);
   }
 
-  // Update persistent indexes
-  for (const QModelIndex& pidx : persistentIndexList()) {
-    const int dest_offset = source_rows.indexOf(pidx.row());
-    if (dest_offset != -1) {
-      // This index was moved
-      changePersistentIndex(
-          pidx, index(start + dest_offset, pidx.column(), QModelIndex()));
-    } else {
-      int d = 0;
-      for (int source_row : source_rows) {
-        if (pidx.row() > source_row) d--;
-      }
-      if (pidx.row() + d >= start) d += source_rows.count();
-
-      changePersistentIndex(
-          pidx, index(pidx.row() + d, pidx.column(), QModelIndex()));
-    }
+  int next = 0;
+  for (int row = 0; row < old_to_new.count(); ++row) {
+    if (old_to_new[row] != -1) continue;
+    if (next == start) next += source_rows.count();
+    old_to_new[row] = next++;
   }
-  current_virtual_index_ = virtual_items_.indexOf(current_row());
 
-  layoutChanged();
-  Save();
+  MoveRowsWithoutUndo(old_to_new);
 }
 
 void Playlist::MoveItemsWithoutUndo(int start, const QList<int>& dest_rows) {
-  layoutAboutToBeChanged();
-  PlaylistItemList moved_items;
-
   int pos = start;
   for (int dest_row : dest_rows) {
     if (dest_row < pos) start--;
@@ -944,35 +997,39 @@ void Playlist::MoveItemsWithoutUndo(int start, const QList<int>& dest_rows) {
     start = items_.count() - dest_rows.count();
   }
 
-  // Take the items out of the list first
-  for (int i = 0; i < dest_rows.count(); i++)
-    moved_items << items_.takeAt(start);
+  // The block at start goes back to dest_rows, everything else fills in the
+  // gaps in order.
+  QVector<int> old_to_new(items_.count(), -1);
+  QVector<bool> taken(items_.count(), false);
+  for (int i = 0; i < dest_rows.count(); ++i) {
+    old_to_new[start + i] = dest_rows[i];
+    taken[dest_rows[i]] = true;
+  }
 
-  // Put the items back in
-  int offset = 0;
-  for (int dest_row : dest_rows) {
-    items_.insert(dest_row, moved_items[offset]);
-    offset++;
+  int next = 0;
+  for (int row = 0; row < old_to_new.count(); ++row) {
+    if (old_to_new[row] != -1) continue;
+    while (taken[next]) ++next;
+    old_to_new[row] = next++;
   }
 
-  // Update persistent indexes
-  for (const QModelIndex& pidx : persistentIndexList()) {
-    if (pidx.row() >= start && pidx.row() < start + dest_rows.count()) {
-      // This index was moved
-      const int i = pidx.row() - start;
-      changePersistentIndex(pidx,
-                            index(dest_rows[i], pidx.column(), QModelIndex()));
-    } else {
-      int d = 0;
-      if (pidx.row() >= start + dest_rows.count()) d -= dest_rows.count();
+  MoveRowsWithoutUndo(old_to_new);
+}
 
-      for (int dest_row : dest_rows) {
-        if (pidx.row() + d > dest_row) d++;
-      }
+void Playlist::MoveRowsWithoutUndo(const QVector<int>& old_to_new) {
+  layoutAboutToBeChanged();
 
-      changePersistentIndex(
-          pidx, index(pidx.row() + d, pidx.column(), QModelIndex()));
-    }
+  // Build the new list in one pass rather than taking and inserting items one
+  // at a time, which is quadratic in the number of rows moved.
+  QVector<PlaylistItemPtr> new_items(items_.count());
+  for (int row = 0; row < old_to_new.count(); ++row) {
+    new_items[old_to_new[row]] = items_[row];
+  }
+  items_ = new_items.toList();
+
+  for (const QModelIndex& pidx : persistentIndexList()) {
+    changePersistentIndex(
+        pidx, index(old_to_new[pidx.row()], pidx.column(), QModelIndex()));
   }
   current_virtual_index_ = virtual_items_.indexOf(current_row());
 
@@ -984,6 +1041,9 @@ void Playlist::InsertItems(const PlaylistItemList& itemsIn, int pos,
                            bool play_now, bool enqueue, bool enqueue_next) {
   if (itemsIn.isEmpty()) return;
 
+  // pos refers to the items that are in the database
+  Wake();
+
   PlaylistItemList items = itemsIn;
 
   // exercise vetoes
@@ -1049,10 +1109,18 @@ void Playlist::InsertItemsWithoutUndo(const PlaylistItemList& items, int pos,
   const int end = start + items.count() - 1;
 
   beginInsertRows(QModelIndex(), start, end);
+
+  // Splice the new items in all at once rather than shifting the tail of the
+  // list once per item.
+  if (start == items_.count()) {
+    items_.append(items);
+  } else {
+    items_ = items_.mid(0, start) + items + items_.mid(start);
+  }
+  virtual_items_.Resize(items_.count());
+
   for (int i = start; i <= end; ++i) {
     PlaylistItemPtr item = items[i - start];
-    items_.insert(i, item);
-    virtual_items_ << virtual_items_.count();
 
     if (item->type() == "Library") {
       int id = item->Metadata().id();
@@ -1159,50 +1227,51 @@ void Playlist::InsertInternetItems(InternetService* service,
 
 void Playlist::UpdateItems(const SongList& songs) {
   qLog(Debug) << "Updating playlist with new tracks' info";
-  // We first convert our songs list into a linked list (a 'real' list),
-  // because removals are faster with QLinkedList.
-  // Next, we walk through the list of playlist's items then the list of songs
-  // we want to update: if an item corresponds to the song (we rely on URL for
-  // this), we update the item with the new metadata, then we remove song from
-  // our list because we will not need to check it again.
-  // And we also update undo actions.
-  QLinkedList<Song> songs_list;
-  for (const Song& song : songs) songs_list.append(song);
-
-  for (int i = 0; i < items_.size(); i++) {
-    // Update current items list
-    QMutableLinkedListIterator<Song> it(songs_list);
-    while (it.hasNext()) {
-      const Song& song = it.next();
-      PlaylistItemPtr& item = items_[i];
-      if (item->Metadata().url() == song.url() &&
-          (item->Metadata().filetype() == Song::Type_Unknown ||
-           // Stream may change and may need to be updated too
-           item->Metadata().filetype() == Song::Type_Stream ||
-           // And CD tracks as well (tags are loaded in a second step)
-           item->Metadata().filetype() == Song::Type_Cdda)) {
-        PlaylistItemPtr new_item;
-        if (song.is_library_song()) {
-          new_item = PlaylistItemPtr(new LibraryPlaylistItem(song));
-          library_items_by_id_.insertMulti(song.id(), new_item);
-        } else {
-          new_item = PlaylistItemPtr(new SongPlaylistItem(song));
-        }
-        items_[i] = new_item;
-        emit dataChanged(index(i, 0), index(i, ColumnCount - 1));
-        // Also update undo actions
-        for (int i = 0; i < undo_stack_->count(); i++) {
-          QUndoCommand* undo_action =
-              const_cast<QUndoCommand*>(undo_stack_->command(i));
-          PlaylistUndoCommands::InsertItems* undo_action_insert =
-              dynamic_cast<PlaylistUndoCommands::InsertItems*>(undo_action);
-          if (undo_action_insert) {
-            bool found_and_updated = undo_action_insert->UpdateItem(new_item);
-            if (found_and_updated) break;
-          }
-        }
-        it.remove();
-        break;
+  // Each song updates the first item with the same URL that doesn't have its
+  // metadata yet, so the songs are looked up by URL while walking through the
+  // playlist's items once.  Undo actions are updated as well.
+  QHash<UrlKey, QList<Song>> songs_by_url;
+  for (const Song& song : songs) songs_by_url[song.url_key()] << song;
+
+  for (int i = 0; i < items_.size() && !songs_by_url.isEmpty(); i++) {
+    const Song& metadata = items_[i]->Metadata();
+    if (metadata.filetype() != Song::Type_Unknown &&
+        // Stream may change and may need to be updated too
+        metadata.filetype() != Song::Type_Stream &&
+        // And CD tracks as well (tags are loaded in a second step)
+        metadata.filetype() != Song::Type_Cdda) {
+      continue;
+    }
+
+    QHash<UrlKey, QList<Song>>::iterator it =
+        songs_by_url.find(metadata.url_key());
+    if (it == songs_by_url.end()) continue;
+
+    const Song song = it->takeFirst();
+    if (it->isEmpty()) songs_by_url.erase(it);
+
+    PlaylistItemPtr new_item;
+    if (song.is_library_song()) {
+      new_item = PlaylistItemPtr(new LibraryPlaylistItem(song));
+      library_items_by_id_.insertMulti(song.id(), new_item);
+    } else {
+      new_item = PlaylistItemPtr(new SongPlaylistItem(song));
+    }
+    if (!item_rows_.isEmpty()) {
+      item_rows_.remove(items_[i].get());
+      item_rows_[new_item.get()] = i;
+    }
+    items_[i] = new_item;
+    emit dataChanged(index(i, 0), index(i, ColumnCount - 1));
+    // Also update undo actions
+    for (int j = 0; j < undo_stack_->count(); j++) {
+      QUndoCommand* undo_action =
+          const_cast<QUndoCommand*>(undo_stack_->command(j));
+      PlaylistUndoCommands::InsertItems* undo_action_insert =
+          dynamic_cast<PlaylistUndoCommands::InsertItems*>(undo_action);
+      if (undo_action_insert) {
+        bool found_and_updated = undo_action_insert->UpdateItem(new_item);
+        if (found_and_updated) break;
       }
     }
   }
@@ -1245,98 +1314,270 @@ QMimeData* Playlist::mimeData(const QModelIndexList& indexes) const {
   return data;
 }
 
-bool Playlist::CompareItems(int column, Qt::SortOrder order,
-                            shared_ptr<PlaylistItem> _a,
-                            shared_ptr<PlaylistItem> _b) {
-  shared_ptr<PlaylistItem> a = order == Qt::AscendingOrder ? _a : _b;
-  shared_ptr<PlaylistItem> b = order == Qt::AscendingOrder ? _b : _a;
+namespace {
+
+// Below this many rows a plain single-threaded sort is quicker than farming
+// chunks out to other threads.
+const int kParallelSortRows = 10000;
+
+void StableSortChunk(std::function<bool(int, int)> less_than, int* begin,
+                     int* end) {
+  std::stable_sort(begin, end, less_than);
+}
+
+void MergeChunks(std::function<bool(int, int)> less_than, int* begin,
+                 int* middle, int* end) {
+  std::inplace_merge(begin, middle, end, less_than);
+}
+
+// Stable sorts rows with a merge sort: the chunks are sorted on separate
+// threads, then merged pairwise until there's only one left.
+void ParallelStableSort(std::function<bool(int, int)> less_than,
+                        QVector<int>* rows) {
+  const int count = rows->count();
+  const int chunks = qMin(QThread::idealThreadCount(),
+                          count / (kParallelSortRows / 2));
+  if (chunks < 2) {
+    std::stable_sort(rows->begin(), rows->end(), less_than);
+    return;
+  }
 
-#define cmp(field) return a->Metadata().field() < b->Metadata().field()
-#define strcmp(field)                                                 \
-  return QString::localeAwareCompare(a->Metadata().field().toLower(), \
-                                     b->Metadata().field().toLower()) < 0;
+  int* data = rows->data();
+  QVector<int> bounds;
+  for (int i = 0; i <= chunks; ++i) bounds << int(qint64(count) * i / chunks);
+
+  QList<QFuture<void>> futures;
+  for (int i = 0; i < chunks; ++i) {
+    futures << QtConcurrent::run(&StableSortChunk, less_than,
+                                 data + bounds[i], data + bounds[i + 1]);
+  }
+  for (QFuture<void>& future : futures) future.waitForFinished();
+
+  while (bounds.count() > 2) {
+    QVector<int> merged_bounds;
+    futures.clear();
+    for (int i = 0; i + 2 < bounds.count(); i += 2) {
+      futures << QtConcurrent::run(&MergeChunks, less_than, data + bounds[i],
+                                   data + bounds[i + 1], data + bounds[i + 2]);
+      merged_bounds << bounds[i];
+    }
+    if (bounds.count() % 2 == 0) merged_bounds << bounds[bounds.count() - 2];
+    merged_bounds << bounds.last();
+    for (QFuture<void>& future : futures) future.waitForFinished();
+    bounds = merged_bounds;
+  }
+}
+
+// Stable sorts rows by keys[row].  keys is indexed by row number.
+template <typename T, typename LessThan>
+void StableSortRows(const QVector<T>& keys, Qt::SortOrder order,
+                    LessThan less_than, QVector<int>* rows) {
+  if (order == Qt::AscendingOrder) {
+    ParallelStableSort([&](int a, int b) {
+      return less_than(keys[a], keys[b]);
+    }, rows);
+  } else {
+    ParallelStableSort([&](int a, int b) {
+      return less_than(keys[b], keys[a]);
+    }, rows);
+  }
+}
+
+#if defined(Q_OS_UNIX) && !defined(Q_OS_DARWIN)
+// QString::localeAwareCompare uses strcoll here, so the same order can be
+// had by transforming each string once with strxfrm and comparing the bytes.
+typedef QByteArray CollationKey;
+
+CollationKey MakeCollationKey(const QString& text) {
+  const QByteArray local = text.toLocal8Bit();
+  const size_t length = strxfrm(nullptr, local.constData(), 0);
+  QByteArray ret(int(length), Qt::Uninitialized);
+  strxfrm(ret.data(), local.constData(), length + 1);
+  return ret;
+}
+
+bool CollationLessThan(const CollationKey& a, const CollationKey& b) {
+  return a < b;
+}
+#else
+typedef QString CollationKey;
+
+CollationKey MakeCollationKey(const QString& text) { return text; }
+
+bool CollationLessThan(const CollationKey& a, const CollationKey& b) {
+  return QString::localeAwareCompare(a, b) < 0;
+}
+#endif
+
+void MakeCollationKeys(const QString* text, CollationKey* keys,
+                       const int* begin, const int* end) {
+  for (const int* row = begin; row != end; ++row) {
+    keys[*row] = MakeCollationKey(text[*row]);
+  }
+}
+
+// Sorts rows case-insensitively in the user's locale.  The collation keys are
+// worked out on several threads when there are a lot of them.
+void LocaleAwareSortRows(const QVector<QString>& text, Qt::SortOrder order,
+                         QVector<int>* rows) {
+  QVector<CollationKey> keys(text.count());
+  const int count = rows->count();
+  const int chunks = qMin(QThread::idealThreadCount(),
+                          count / (kParallelSortRows / 2));
+  const int* data = rows->constData();
+
+  QList<QFuture<void>> futures;
+  for (int i = 1; i < chunks; ++i) {
+    futures << QtConcurrent::run(&MakeCollationKeys, text.constData(),
+                                 keys.data(),
+                                 data + qint64(count) * i / chunks,
+                                 data + qint64(count) * (i + 1) / chunks);
+  }
+  MakeCollationKeys(text.constData(), keys.data(), data,
+                    data + (chunks < 2 ? count : count / chunks));
+  for (QFuture<void>& future : futures) future.waitForFinished();
+
+  StableSortRows(keys, order, CollationLessThan, rows);
+}
+
+template <typename T>
+bool LessThan(const T& a, const T& b) {
+  return a < b;
+}
+
+}  // namespace
+
+void Playlist::SortRows(int column, Qt::SortOrder order,
+                        QVector<int>* rows) const {
+  // Text columns are compared case-insensitively in the user's locale
+  QVector<QString> text;
+  auto sort_by_text = [&](const QString& (Song::*getter)() const) {
+    text.resize(items_.count());
+    for (int row : *rows) {
+      text[row] = (items_[row]->Metadata().*getter)().toLower();
+    }
+    LocaleAwareSortRows(text, order, rows);
+  };
+
+  // Everything else is compared as a number
+  QVector<double> numbers;
+  auto sort_by_number = [&](std::function<double(const Song&)> getter) {
+    numbers.resize(items_.count());
+    for (int row : *rows) numbers[row] = getter(items_[row]->Metadata());
+    StableSortRows(numbers, order, LessThan<double>, rows);
+  };
+
+#define number(field) \
+  sort_by_number([](const Song& song) { return double(song.field()); })
 
   switch (column) {
     case Column_Title:
-      strcmp(title);
+      sort_by_text(&Song::title);
+      break;
     case Column_Artist:
-      strcmp(artist);
+      sort_by_text(&Song::artist);
+      break;
     case Column_Album:
-      strcmp(album);
-    case Column_Length:
-      cmp(length_nanosec);
-    case Column_Track:
-      cmp(track);
-    case Column_Disc:
-      cmp(disc);
-    case Column_Year:
-      cmp(year);
-    case Column_OriginalYear:
-      cmp(originalyear);
+      sort_by_text(&Song::album);
+      break;
     case Column_Genre:
-      strcmp(genre);
+      sort_by_text(&Song::genre);
+      break;
     case Column_AlbumArtist:
-      strcmp(playlist_albumartist);
+      sort_by_text(&Song::playlist_albumartist);
+      break;
     case Column_Composer:
-      strcmp(composer);
+      sort_by_text(&Song::composer);
+      break;
     case Column_Performer:
-      strcmp(performer);
+      sort_by_text(&Song::performer);
+      break;
     case Column_Grouping:
-      strcmp(grouping);
+      sort_by_text(&Song::grouping);
+      break;
+    case Column_Comment:
+      sort_by_text(&Song::comment);
+      break;
 
+    case Column_Length:
+      number(length_nanosec);
+      break;
+    case Column_Track:
+      number(track);
+      break;
+    case Column_Disc:
+      number(disc);
+      break;
+    case Column_Year:
+      number(year);
+      break;
+    case Column_OriginalYear:
+      number(originalyear);
+      break;
     case Column_Rating:
-      cmp(rating);
+      number(rating);
+      break;
     case Column_PlayCount:
-      cmp(playcount);
+      number(playcount);
+      break;
     case Column_SkipCount:
-      cmp(skipcount);
+      number(skipcount);
+      break;
     case Column_LastPlayed:
-      cmp(lastplayed);
+      number(lastplayed);
+      break;
     case Column_Score:
-      cmp(score);
-
+      number(score);
+      break;
     case Column_BPM:
-      cmp(bpm);
+      number(bpm);
+      break;
     case Column_Bitrate:
-      cmp(bitrate);
+      number(bitrate);
+      break;
     case Column_Samplerate:
-      cmp(samplerate);
-    case Column_Filename:
-      return (QString::localeAwareCompare(a->Url().path().toLower(),
-                                          b->Url().path().toLower()) < 0);
-    case Column_BaseFilename:
-      cmp(basefilename);
+      number(samplerate);
+      break;
     case Column_Filesize:
-      cmp(filesize);
+      number(filesize);
+      break;
     case Column_Filetype:
-      cmp(filetype);
+      number(filetype);
+      break;
     case Column_DateModified:
-      cmp(mtime);
+      number(mtime);
+      break;
     case Column_DateCreated:
-      cmp(ctime);
+      number(ctime);
+      break;
 
-    case Column_Comment:
-      strcmp(comment);
+    case Column_Filename:
+      text.resize(items_.count());
+      for (int row : *rows) text[row] = items_[row]->Url().path().toLower();
+      LocaleAwareSortRows(text, order, rows);
+      break;
+    case Column_BaseFilename:
+      text.resize(items_.count());
+      for (int row : *rows) text[row] = items_[row]->Metadata().basefilename();
+      StableSortRows(text, order, LessThan<QString>, rows);
+      break;
     case Column_Source:
-      cmp(url);
+      text.resize(items_.count());
+      for (int row : *rows) {
+        text[row] = items_[row]->Metadata().url().toString();
+      }
+      StableSortRows(text, order, LessThan<QString>, rows);
+      break;
   }
 
-#undef cmp
-#undef strcmp
-
-  return false;
+#undef number
 }
 
-bool Playlist::ComparePathDepths(Qt::SortOrder order,
-                                 shared_ptr<PlaylistItem> _a,
-                                 shared_ptr<PlaylistItem> _b) {
-  shared_ptr<PlaylistItem> a = order == Qt::AscendingOrder ? _a : _b;
-  shared_ptr<PlaylistItem> b = order == Qt::AscendingOrder ? _b : _a;
-
-  int a_dir_level = a->Url().path().count('/');
-  int b_dir_level = b->Url().path().count('/');
-
-  return a_dir_level < b_dir_level;
+void Playlist::SortRowsByPathDepth(Qt::SortOrder order,
+                                   QVector<int>* rows) const {
+  QVector<int> depths(items_.count());
+  for (int row : *rows) depths[row] = items_[row]->Url().path().count('/');
+  StableSortRows(depths, order, LessThan<int>, rows);
 }
 
 QString Playlist::column_name(Column column) {
@@ -1427,34 +1668,38 @@ QString Playlist::abbreviated_column_name(Column column) {
 void Playlist::sort(int column, Qt::SortOrder order) {
   if (ignore_sorting_) return;
 
-  PlaylistItemList new_items(items_);
-  PlaylistItemList::iterator begin = new_items.begin();
+  int first = 0;
   if (dynamic_playlist_ && current_item_index_.isValid())
-    begin += current_item_index_.row() + 1;
+    first = current_item_index_.row() + 1;
+
+  // Sort row numbers rather than the items themselves, so each item's sort
+  // key is only worked out once per pass.
+  QVector<int> rows;
+  rows.reserve(items_.count() - first);
+  for (int i = first; i < items_.count(); ++i) rows << i;
 
   if (column == Column_Album) {
     // When sorting by album, also take into account discs and tracks.
-    qStableSort(begin, new_items.end(), std::bind(&Playlist::CompareItems,
-                                                  Column_Track, order, _1, _2));
-    qStableSort(begin, new_items.end(),
-                std::bind(&Playlist::CompareItems, Column_Disc, order, _1, _2));
-    qStableSort(begin, new_items.end(), std::bind(&Playlist::CompareItems,
-                                                  Column_Album, order, _1, _2));
+    SortRows(Column_Track, order, &rows);
+    SortRows(Column_Disc, order, &rows);
+    SortRows(Column_Album, order, &rows);
   } else if (column == Column_Filename) {
     // When sorting by full paths we also expect a hierarchical order. This
     // returns a breath-first ordering of paths.
-    qStableSort(
-        begin, new_items.end(),
-        std::bind(&Playlist::CompareItems, Column_Filename, order, _1, _2));
-    qStableSort(begin, new_items.end(),
-                std::bind(&Playlist::ComparePathDepths, order, _1, _2));
+    SortRows(Column_Filename, order, &rows);
+    SortRowsByPathDepth(order, &rows);
   } else {
-    qStableSort(begin, new_items.end(),
-                std::bind(&Playlist::CompareItems, column, order, _1, _2));
+    SortRows(column, order, &rows);
   }
 
+  // Rows before the first sorted one stay where they are
+  QVector<int> new_rows;
+  new_rows.reserve(items_.count());
+  for (int i = 0; i < first; ++i) new_rows << i;
+  new_rows << rows;
+
   undo_stack_->push(
-      new PlaylistUndoCommands::SortItems(this, column, order, new_items));
+      new PlaylistUndoCommands::SortItems(this, column, order, new_rows));
 
   ReshuffleIndices();
 }
@@ -1465,7 +1710,8 @@ void Playlist::ReOrderWithoutUndo(const PlaylistItemList& new_items) {
   PlaylistItemList old_items = items_;
   items_ = new_items;
 
-  QMap<const PlaylistItem*, int> new_rows;
+  QHash<const PlaylistItem*, int> new_rows;
+  new_rows.reserve(new_items.length());
   for (int i = 0; i < new_items.length(); ++i) {
     new_rows[new_items[i].get()] = i;
   }
@@ -1482,6 +1728,27 @@ void Playlist::ReOrderWithoutUndo(const PlaylistItemList& new_items) {
   Save();
 }
 
+void Playlist::ReOrderWithoutUndo(const QVector<int>& new_rows) {
+  layoutAboutToBeChanged();
+
+  PlaylistItemList old_items = items_;
+  QVector<int> old_to_new(new_rows.count());
+  for (int i = 0; i < new_rows.count(); ++i) {
+    items_[i] = old_items[new_rows[i]];
+    old_to_new[new_rows[i]] = i;
+  }
+
+  for (const QModelIndex& idx : persistentIndexList()) {
+    changePersistentIndex(
+        idx, index(old_to_new[idx.row()], idx.column(), idx.parent()));
+  }
+
+  layoutChanged();
+
+  emit PlaylistChanged();
+  Save();
+}
+
 void Playlist::Playing() { SetCurrentIsPaused(false); }
 
 void Playlist::Paused() { SetCurrentIsPaused(true); }
@@ -1498,31 +1765,131 @@ void Playlist::SetCurrentIsPaused(bool paused) {
                 index(current_item_index_.row(), ColumnCount - 1));
 }
 
+const FilterColumnSnapshot& Playlist::filter_snapshot(
+    const QSet<int>& columns) const {
+  if (filter_snapshot_.isEmpty()) filter_snapshot_.resize(ColumnCount);
+
+  for (int column : columns) {
+    if (filter_snapshot_columns_.contains(column)) continue;
+
+    QVector<QString>& texts = filter_snapshot_[column];
+    texts.resize(items_.count());
+    for (int row = 0; row < items_.count(); ++row) {
+      texts[row] = data(index(row, column)).toString().toLower();
+    }
+    filter_snapshot_columns_ << column;
+  }
+
+  return filter_snapshot_;
+}
+
+void Playlist::FilterSnapshotDataChanged(const QModelIndex& top_left,
+                                         const QModelIndex& bottom_right) {
+  for (int column : filter_snapshot_columns_) {
+    QVector<QString>& texts = filter_snapshot_[column];
+    for (int row = top_left.row(); row <= bottom_right.row(); ++row) {
+      texts[row] = data(index(row, column)).toString().toLower();
+    }
+  }
+}
+
+void Playlist::FilterSnapshotRowsInserted(const QModelIndex&, int start,
+                                          int end) {
+  for (int column : filter_snapshot_columns_) {
+    QVector<QString>& texts = filter_snapshot_[column];
+    texts.insert(start, end - start + 1, QString());
+    for (int row = start; row <= end; ++row) {
+      texts[row] = data(index(row, column)).toString().toLower();
+    }
+  }
+}
+
+void Playlist::FilterSnapshotRowsRemoved(const QModelIndex&, int start,
+                                         int end) {
+  for (int column : filter_snapshot_columns_) {
+    filter_snapshot_[column].remove(start, end - start + 1);
+  }
+}
+
+void Playlist::ClearFilterSnapshot() {
+  // Rows have moved around, so build the columns again when they're next
+  // needed
+  filter_snapshot_.clear();
+  filter_snapshot_columns_.clear();
+}
+
 void Playlist::Save() const {
-  if (!backend_ || is_loading_) return;
+  // A hibernated playlist is already in the database
+  if (!backend_ || is_loading_ || hibernated_) return;
+
+  // Saving a partly restored playlist would lose the rest of its items
+  if (restoring_) {
+    save_after_restore_ = true;
+    return;
+  }
 
   backend_->SavePlaylistAsync(id_, items_, last_played_row(),
                               dynamic_playlist_);
 }
 
-void Playlist::Restore() {
+void Playlist::Restore(int first_rows) {
   if (!backend_) return;
 
   items_.clear();
-  virtual_items_.clear();
+  virtual_items_.Clear();
   library_items_by_id_.clear();
 
   cancel_restore_ = false;
-  QFuture<QList<PlaylistItemPtr>> future =
-      QtConcurrent::run(backend_, &PlaylistBackend::GetPlaylistItems, id_);
+  restoring_ = true;
+
+  // Load enough to fill the view now, and the rest in the background
+  int offset = 0;
+  if (first_rows != 0) {
+    PlaylistItemList items = backend_->GetPlaylistItems(id_, 0, first_rows);
+    offset = items.count();
+    InsertRestoredItems(items, 0);
+  }
+
+  QFuture<QList<PlaylistItemPtr>> future = QtConcurrent::run(
+      backend_, &PlaylistBackend::GetPlaylistItems, id_, offset, -1);
   NewClosure(future, this, SLOT(ItemsLoaded(QFuture<PlaylistItemList>)),
              future);
 }
 
-void Playlist::ItemsLoaded(QFuture<PlaylistItemList> future) {
-  if (cancel_restore_) return;
+bool Playlist::Hibernate() {
+  if (!backend_ || hibernated_ || restoring_ || is_loading_) return false;
+
+  // The playing and queued items are referred to by their indexes
+  if (current_row() != -1 || !queue_->is_empty()) return false;
+
+  hibernated_item_count_ = items_.count();
+  hibernated_length_ = GetTotalLength();
+
+  beginResetModel();
+  items_.clear();
+  virtual_items_.Clear();
+  library_items_by_id_.clear();
+  endResetModel();
+
+  undo_stack_->clear();
+  hibernated_ = true;
+  return true;
+}
 
-  PlaylistItemList items = future.result();
+void Playlist::Wake(int first_rows) {
+  if (!hibernated_) return;
+
+  hibernated_ = false;
+  Restore(first_rows);
+}
+
+int Playlist::item_count() const {
+  return hibernated_ ? hibernated_item_count_ : items_.count();
+}
+
+void Playlist::InsertRestoredItems(const PlaylistItemList& items_in,
+                                   int pos) {
+  PlaylistItemList items = items_in;
 
   // backend returns empty elements for library items which it couldn't
   // match (because they got deleted); we don't need those
@@ -1536,8 +1903,23 @@ void Playlist::ItemsLoaded(QFuture<PlaylistItemList> future) {
   }
 
   is_loading_ = true;
-  InsertItems(items, 0);
+  InsertItems(items, pos);
   is_loading_ = false;
+}
+
+void Playlist::ItemsLoaded(QFuture<PlaylistItemList> future) {
+  if (!cancel_restore_) {
+    // Anything loaded up front is already at the start of the playlist
+    InsertRestoredItems(future.result(), items_.isEmpty() ? 0 : -1);
+  }
+
+  restoring_ = false;
+  if (save_after_restore_) {
+    save_after_restore_ = false;
+    Save();
+  }
+
+  if (cancel_restore_) return;
 
   PlaylistBackend::Playlist p = backend_->GetPlaylist(id_);
 
@@ -1574,13 +1956,15 @@ void Playlist::ItemsLoaded(QFuture<PlaylistItemList> future) {
 
   // should we gray out deleted songs asynchronously on startup?
   if (s.value("greyoutdeleted", false).toBool()) {
-    QtConcurrent::run(this, &Playlist::InvalidateDeletedSongs);
+    InvalidateDeletedSongs();
   }
 }
 
 static bool DescendingIntLessThan(int a, int b) { return a > b; }
 
 void Playlist::RemoveItemsWithoutUndo(const QList<int>& indicesIn) {
+  Wake();
+
   // Sort the indices descending because removing elements 'backwards'
   // is easier - indices don't 'move' in the process.
   QList<int> indices = indicesIn;
@@ -1656,11 +2040,10 @@ PlaylistItemList Playlist::RemoveItemsWithoutUndo(int row, int count) {
   beginRemoveRows(QModelIndex(), row, row + count - 1);
 
   // Remove items
-  PlaylistItemList ret;
-  for (int i = 0; i < count; ++i) {
-    PlaylistItemPtr item(items_.takeAt(row));
-    ret << item;
+  PlaylistItemList ret = items_.mid(row, count);
+  items_.erase(items_.begin() + row, items_.begin() + row + count);
 
+  for (PlaylistItemPtr item : ret) {
     if (item->type() == "Library") {
       int id = item->Metadata().id();
       if (id != -1) {
@@ -1671,15 +2054,7 @@ PlaylistItemList Playlist::RemoveItemsWithoutUndo(int row, int count) {
 
   endRemoveRows();
 
-  QList<int>::iterator it = virtual_items_.begin();
-  int i = 0;
-  while (it != virtual_items_.end()) {
-    if (*it >= items_.count())
-      it = virtual_items_.erase(it);
-    else
-      ++it;
-    ++i;
-  }
+  virtual_items_.Resize(items_.count());
 
   // Reset current_virtual_index_
   if (current_row() == -1)
@@ -1739,7 +2114,7 @@ void Playlist::ClearStreamMetadata() {
 }
 
 bool Playlist::stop_after_current() const {
-  PlaylistSequence::RepeatMode repeat_mode = playlist_sequence_->repeat_mode();
+  PlaylistSequence::RepeatMode repeat_mode = this->repeat_mode();
   if (repeat_mode == PlaylistSequence::Repeat_OneByOne) {
     return true;
   }
@@ -1797,6 +2172,10 @@ void Playlist::Clear() {
   // If loading songs from session restore async, don't insert them
   cancel_restore_ = true;
 
+  // Nothing has to be loaded just to be thrown away, Save() will empty the
+  // playlist in the database
+  hibernated_ = false;
+
   const int count = items_.count();
 
   if (count > kUndoItemLimit) {
@@ -1943,94 +2322,93 @@ void Playlist::Shuffle() {
   undo_stack_->push(new PlaylistUndoCommands::ShuffleItems(this, new_items));
 }
 
-namespace {
-bool AlbumShuffleComparator(const QMap<QString, int>& album_key_positions,
-                            const QMap<int, QString>& album_keys, int left,
-                            int right) {
-  const int left_pos = album_key_positions[album_keys[left]];
-  const int right_pos = album_key_positions[album_keys[right]];
-
-  if (left_pos == right_pos) return left < right;
-  return left_pos < right_pos;
-}
-}
 
 void Playlist::ReshuffleIndices() {
   if (!playlist_sequence_) {
     return;
   }
 
-  if (playlist_sequence_->shuffle_mode() == PlaylistSequence::Shuffle_Off) {
+  const PlaylistSequence::ShuffleMode mode = playlist_sequence_->shuffle_mode();
+  if (mode == PlaylistSequence::Shuffle_Off) {
     // No shuffling - sort the virtual item list normally.
-    std::sort(virtual_items_.begin(), virtual_items_.end());
+    virtual_items_.Sort();
     if (current_row() != -1)
       current_virtual_index_ = virtual_items_.indexOf(current_row());
     return;
   }
 
-  // If the user is already playing a song, advance the begin iterator to
-  // only shuffle items that haven't been played yet.
-  QList<int>::iterator begin = virtual_items_.begin();
-  QList<int>::iterator end = virtual_items_.end();
-  if (current_virtual_index_ != -1)
-    std::advance(begin, current_virtual_index_ + 1);
+  // If the user is already playing a song, only shuffle items that haven't
+  // been played yet.  The items are only shuffled as they're needed, so this
+  // is cheap even for huge playlists.
+  const int first = current_virtual_index_ + 1;
 
-  switch (playlist_sequence_->shuffle_mode()) {
+  switch (mode) {
     case PlaylistSequence::Shuffle_Off:
       // Handled above.
       break;
 
     case PlaylistSequence::Shuffle_All:
     case PlaylistSequence::Shuffle_InsideAlbum:
-      std::random_shuffle(begin, end);
+      virtual_items_.Shuffle(first);
+      break;
+
+    case PlaylistSequence::Shuffle_ByRating:
+    case PlaylistSequence::Shuffle_ByPlayCount:
+      virtual_items_.Shuffle(first, ShuffleWeights(mode));
       break;
 
     case PlaylistSequence::Shuffle_Albums: {
-      QMap<int, QString> album_keys;  // real index -> key
-      QSet<QString> album_key_set;    // unique keys
-
-      // Find all the unique albums in the playlist
-      for (QList<int>::iterator it = begin; it != end; ++it) {
-        const int index = *it;
-        const QString key = items_[index]->Metadata().AlbumKey();
-        album_keys[index] = key;
-        album_key_set << key;
-      }
+      // If the user is currently playing a song, or one is selected, force
+      // its album to be first.
+      const QVector<int>& groups = AlbumGroups();
+      virtual_items_.ShuffleGroups(
+          first, groups, current_row() != -1 ? groups[current_row()] : -1);
+      break;
+    }
+  }
+}
 
-      // Shuffle them
-      QStringList shuffled_album_keys = album_key_set.toList();
-      std::random_shuffle(shuffled_album_keys.begin(),
-                          shuffled_album_keys.end());
-
-      // If the user is currently playing a song, force its album to be first
-      // Or if the song was not playing but it was selected, force its album
-      // to be first.
-      if (current_virtual_index_ != -1 || current_row() != -1) {
-        const QString key = items_[current_row()]->Metadata().AlbumKey();
-        const int pos = shuffled_album_keys.indexOf(key);
-        if (pos >= 1) {
-          std::swap(shuffled_album_keys[0], shuffled_album_keys[pos]);
-        }
-      }
+const QVector<int>& Playlist::AlbumGroups() {
+  if (album_groups_.count() == items_.count()) return album_groups_;
 
-      // Create album key -> position mapping for fast lookup
-      QMap<QString, int> album_key_positions;
-      for (int i = 0; i < shuffled_album_keys.count(); ++i) {
-        album_key_positions[shuffled_album_keys[i]] = i;
-      }
+  QHash<QString, int> groups_by_key;
+  album_groups_.resize(items_.count());
+  for (int i = 0; i < items_.count(); ++i) {
+    const QString key = items_[i]->Metadata().AlbumKey();
+    QHash<QString, int>::const_iterator it = groups_by_key.constFind(key);
+    if (it == groups_by_key.constEnd()) {
+      it = groups_by_key.insert(key, groups_by_key.count());
+    }
+    album_groups_[i] = it.value();
+  }
+  return album_groups_;
+}
 
-      // Sort the virtual items
-      std::stable_sort(begin, end,
-                       std::bind(AlbumShuffleComparator, album_key_positions,
-                                 album_keys, _1, _2));
+void Playlist::InvalidateAlbumGroups() { album_groups_.clear(); }
 
-      break;
+QVector<double> Playlist::ShuffleWeights(
+    PlaylistSequence::ShuffleMode mode) const {
+  QVector<double> weights(items_.count());
+  for (int i = 0; i < items_.count(); ++i) {
+    const Song& song = items_[i]->Metadata();
+    if (mode == PlaylistSequence::Shuffle_ByRating) {
+      // Unrated tracks count as three stars, and even a one star track gets
+      // played sometimes.
+      const float rating = song.rating() < 0 ? 0.5 : song.rating();
+      weights[i] = 1.0 + 4.0 * rating;
+    } else {
+      // Logarithmic so a few tracks with huge play counts don't drown out
+      // the rest of the playlist.
+      weights[i] = 1.0 + std::log1p(qMax(0, song.playcount()));
     }
   }
+  return weights;
 }
 
 void Playlist::set_sequence(PlaylistSequence* v) {
   playlist_sequence_ = v;
+  if (!v) return;
+
   connect(v, SIGNAL(ShuffleModeChanged(PlaylistSequence::ShuffleMode)),
           SLOT(ShuffleModeChanged(PlaylistSequence::ShuffleMode)));
 
@@ -2040,6 +2418,8 @@ void Playlist::set_sequence(PlaylistSequence* v) {
 QSortFilterProxyModel* Playlist::proxy() const { return proxy_; }
 
 SongList Playlist::GetAllSongs() const {
+  if (hibernated_) return backend_->GetPlaylistSongs(id_);
+
   SongList ret;
   for (PlaylistItemPtr item : items_) {
     ret << item->Metadata();
@@ -2050,6 +2430,8 @@ SongList Playlist::GetAllSongs() const {
 PlaylistItemList Playlist::GetAllItems() const { return items_; }
 
 quint64 Playlist::GetTotalLength() const {
+  if (hibernated_) return hibernated_length_;
+
   quint64 ret = 0;
   for (PlaylistItemPtr item : items_) {
     quint64 length = item->Metadata().length_nanosec();
@@ -2093,14 +2475,24 @@ void Playlist::QueueLayoutChanged() {
 }
 
 void Playlist::ItemChanged(PlaylistItemPtr item) {
-  for (int row = 0; row < items_.count(); ++row) {
-    if (items_[row] == item) {
-      emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
-      return;
+  const int row = RowOfItem(item.get());
+  if (row != -1) {
+    emit dataChanged(index(row, 0), index(row, ColumnCount - 1));
+  }
+}
+
+int Playlist::RowOfItem(const PlaylistItem* item) const {
+  if (item_rows_.isEmpty() && !items_.isEmpty()) {
+    item_rows_.reserve(items_.count());
+    for (int row = 0; row < items_.count(); ++row) {
+      item_rows_[items_[row].get()] = row;
     }
   }
+  return item_rows_.value(item, -1);
 }
 
+void Playlist::InvalidateItemRows() { item_rows_.clear(); }
+
 void Playlist::InformOfCurrentSongChange() {
   emit dataChanged(index(current_item_index_.row(), 0),
                    index(current_item_index_.row(), ColumnCount - 1));
@@ -2114,41 +2506,101 @@ void Playlist::InformOfCurrentSongChange() {
 }
 
 void Playlist::InvalidateDeletedSongs() {
-  QList<int> invalidated_rows;
+  PlaylistItemList items;
+  QStringList filenames;
+
+  for (PlaylistItemPtr item : items_) {
+    const Song song = item->Metadata();
+    if (!song.is_stream()) {
+      items << item;
+      filenames << song.url().toLocalFile();
+    }
+  }
+
+  if (items.isEmpty()) return;
+
+  QFutureWatcher<QSet<QString>>* watcher =
+      new QFutureWatcher<QSet<QString>>(this);
+  NewClosure(watcher, SIGNAL(finished()), [=]() {
+    DeletedSongsChecked(items, watcher->result());
+    watcher->deleteLater();
+  });
+  watcher->setFuture(ThreadPools::Run<QSet<QString>>(
+      ThreadPools::Pool_IO,
+      std::bind(&FileExistenceChecker::Missing,
+                FileExistenceChecker::Instance(), filenames)));
+}
+
+void Playlist::DeletedSongsChecked(const PlaylistItemList& items,
+                                   const QSet<QString>& missing) {
+  QHash<PlaylistItem*, bool> exists;
+  for (PlaylistItemPtr item : items) {
+    exists[item.get()] =
+        !missing.contains(item->Metadata().url().toLocalFile());
+  }
+
+  // Rows might have been added, moved or removed while the files were being
+  // checked.
+  int first_row = -1;
+  int last_row = -1;
+  QList<int> restored_rows;
 
   for (int row = 0; row < items_.count(); ++row) {
     PlaylistItemPtr item = items_[row];
-    Song song = item->Metadata();
-
-    if (!song.is_stream()) {
-      bool exists = QFile::exists(song.url().toLocalFile());
-
-      if (!exists && !item->HasForegroundColor(kInvalidSongPriority)) {
-        // gray out the song if it's not there
-        item->SetForegroundColor(kInvalidSongPriority, kInvalidSongColor);
-        invalidated_rows.append(row);
-      } else if (exists && item->HasForegroundColor(kInvalidSongPriority)) {
-        item->RemoveForegroundColor(kInvalidSongPriority);
-        invalidated_rows.append(row);
-      }
+    auto it = exists.find(item.get());
+    if (it == exists.end()) continue;
+
+    const bool greyed_out = item->HasForegroundColor(kInvalidSongPriority);
+    if (!*it && !greyed_out) {
+      // gray out the song if it's not there
+      item->SetForegroundColor(kInvalidSongPriority, kInvalidSongColor);
+    } else if (*it && greyed_out) {
+      item->RemoveForegroundColor(kInvalidSongPriority);
+      restored_rows << row;
+    } else {
+      continue;
     }
+
+    if (first_row == -1) first_row = row;
+    last_row = row;
   }
 
-  ReloadItems(invalidated_rows);
+  if (first_row == -1) return;
+
+  // The files that came back might have changed while they were gone.
+  for (int row : restored_rows) {
+    item_at(row)->Reload();
+  }
+
+  // One update for all the rows, instead of one for each.
+  emit dataChanged(index(first_row, 0), index(last_row, ColumnCount - 1));
+  if (current_row() >= first_row && current_row() <= last_row) {
+    InformOfCurrentSongChange();
+  }
+
+  Save();
 }
 
 void Playlist::RemoveDeletedSongs() {
-  QList<int> rows_to_remove;
+  QList<int> rows;
+  QStringList filenames;
 
   for (int row = 0; row < items_.count(); ++row) {
-    PlaylistItemPtr item = items_[row];
-    Song song = item->Metadata();
-
-    if (!song.is_stream() && !QFile::exists(song.url().toLocalFile())) {
-      rows_to_remove.append(row);
+    const Song song = items_[row]->Metadata();
+    if (!song.is_stream()) {
+      rows << row;
+      filenames << song.url().toLocalFile();
     }
   }
 
+  const QSet<QString> missing =
+      FileExistenceChecker::Instance()->Missing(filenames);
+
+  QList<int> rows_to_remove;
+  for (int i = 0; i < rows.count(); ++i) {
+    if (missing.contains(filenames[i])) rows_to_remove << rows[i];
+  }
+
   removeRows(rows_to_remove);
 }
 
@@ -20,14 +20,18 @@
 
 #include <QAbstractItemModel>
 #include <QList>
+#include <QVector>
 
+#include "playlistfilterparser.h"
 #include "playlistitem.h"
 #include "playlistsequence.h"
+#include "shuffleorder.h"
 #include "core/tagreaderclient.h"
 #include "core/song.h"
 #include "smartplaylists/generator_fwd.h"
 
 class LibraryBackend;
+class LibraryBackendInterface;
 class PlaylistBackend;
 class PlaylistFilter;
 class Queue;
@@ -73,6 +77,7 @@ class Playlist : public QAbstractListModel {
   friend class PlaylistUndoCommands::RemoveItems;
   friend class PlaylistUndoCommands::MoveItems;
   friend class PlaylistUndoCommands::ReOrderItems;
+  friend class PlaylistUndoCommands::SortItems;
 
  public:
   Playlist(PlaylistBackend* backend, TaskManager* task_manager,
@@ -161,12 +166,13 @@ class Playlist : public QAbstractListModel {
   static const int kUndoStackSize;
   static const int kUndoItemLimit;
 
+  // How many rows Restore() loads straight away when asked to show the
+  // playlist before the rest has been loaded.
+  static const int kRestoreFirstRows;
+
   static const qint64 kMinScrobblePointNsecs;
   static const qint64 kMaxScrobblePointNsecs;
 
-  static bool CompareItems(int column, Qt::SortOrder order, PlaylistItemPtr a,
-                           PlaylistItemPtr b);
-
   static QString column_name(Column column);
   static QString abbreviated_column_name(Column column);
 
@@ -174,9 +180,29 @@ class Playlist : public QAbstractListModel {
   static bool set_column_value(Song& song, Column column,
                                const QVariant& value);
 
+  // The lowercased display text of the given columns for every row, for
+  // PlaylistFilter.  Columns are built the first time they're asked for and
+  // then kept up to date as rows change.
+  const FilterColumnSnapshot& filter_snapshot(const QSet<int>& columns) const;
+
   // Persistence
   void Save() const;
-  void Restore();
+  // Loads the items from the database in the background.  If first_rows is
+  // non-zero then that many are loaded straight away, or all of them if it's
+  // -1.  RestoreFinished() is emitted once everything has been loaded.
+  void Restore(int first_rows = 0);
+  bool is_restoring() const { return restoring_; }
+
+  // Drops the items and the undo history to save memory, keeping only how
+  // many items there were and their total length.  Returns false if the
+  // playlist is in use and can't be hibernated.
+  bool Hibernate();
+  // Loads the items of a hibernated playlist again with Restore().
+  void Wake(int first_rows = -1);
+  bool is_hibernated() const { return hibernated_; }
+  // The same as rowCount(), except that it is still right while the playlist
+  // is hibernated.
+  int item_count() const;
 
   // Accessors
   QSortFilterProxyModel* proxy() const;
@@ -192,6 +218,9 @@ class Playlist : public QAbstractListModel {
   int last_played_row() const;
   int next_row(bool ignore_repeat_track = false) const;
   int previous_row(bool ignore_repeat_track = false) const;
+  // Up to count rows that will be played after the current one, starting
+  // with the queued ones.  Doesn't go round again when repeating.
+  QList<int> upcoming_rows(int count) const;
 
   const QModelIndex current_index() const;
 
@@ -265,9 +294,10 @@ class Playlist : public QAbstractListModel {
   // This returns true if this playlist had current item when the method was
   // invoked.
   bool ApplyValidityOnCurrentSong(const QUrl& url, bool valid);
-  // Grays out and reloads all deleted songs in all playlists. Also, "ungreys"
-  // those songs
-  // which were once deleted but now got restored somehow.
+  // Grays out all deleted songs in all playlists. Also, "ungreys" and reloads
+  // those songs which were once deleted but now got restored somehow.  The
+  // files are checked in a worker thread and the rows are updated together
+  // when they're all done.
   void InvalidateDeletedSongs();
   // Removes from the playlist all local files that don't exist anymore.
   void RemoveDeletedSongs();
@@ -310,9 +340,6 @@ class Playlist : public QAbstractListModel {
   bool removeRows(int row, int count,
                   const QModelIndex& parent = QModelIndex());
 
-  static bool ComparePathDepths(Qt::SortOrder, PlaylistItemPtr,
-                                PlaylistItemPtr);
-
  public slots:
   void set_current_row(int index, bool is_stopping = false);
   void Paused();
@@ -366,6 +393,9 @@ signals:
   int NextVirtualIndex(int i, bool ignore_repeat_track) const;
   int PreviousVirtualIndex(int i, bool ignore_repeat_track) const;
   bool FilterContainsVirtualIndex(int i) const;
+  // Both off if there's no sequence, which is the case in headless mode.
+  PlaylistSequence::RepeatMode repeat_mode() const;
+  PlaylistSequence::ShuffleMode shuffle_mode() const;
   void TurnOnDynamicPlaylist(smart_playlists::GeneratorPtr gen);
 
   void InsertInternetItems(const InternetModel* model,
@@ -375,9 +405,18 @@ signals:
   template <typename T>
   void InsertSongItems(const SongList& songs, int pos, bool play_now,
                        bool enqueue, bool enqueue_next = false);
+  // Picks the right type of item for songs from backend.
+  void InsertBackendSongs(LibraryBackendInterface* backend,
+                          const SongList& songs, int pos, bool play_now,
+                          bool enqueue, bool enqueue_next);
 
   void InsertDynamicItems(int count);
 
+  // Stable sorts rows, which are indices into items_, by the given column.
+  void SortRows(int column, Qt::SortOrder order, QVector<int>* rows) const;
+  void SortRowsByPathDepth(Qt::SortOrder order, QVector<int>* rows) const;
+  void InsertRestoredItems(const PlaylistItemList& items, int pos);
+
   // Modify the playlist without changing the undo stack.  These are used by
   // our friends in PlaylistUndoCommands
   void InsertItemsWithoutUndo(const PlaylistItemList& items, int pos,
@@ -386,13 +425,28 @@ signals:
   void MoveItemsWithoutUndo(const QList<int>& source_rows, int pos);
   void MoveItemWithoutUndo(int source, int dest);
   void MoveItemsWithoutUndo(int start, const QList<int>& dest_rows);
+  // old_to_new[i] is the row the item at row i should move to.
+  void MoveRowsWithoutUndo(const QVector<int>& old_to_new);
   void ReOrderWithoutUndo(const PlaylistItemList& new_items);
+  // new_rows[i] is the row of the item that should end up at row i.
+  void ReOrderWithoutUndo(const QVector<int>& new_rows);
 
   void RemoveItemsNotInQueue();
 
+  // Album of each row, numbered from 0, for shuffling albums.  Worked out
+  // again only after the playlist has changed.
+  const QVector<int>& AlbumGroups();
+  // How likely each row is to be picked by a weighted shuffle mode.
+  QVector<double> ShuffleWeights(PlaylistSequence::ShuffleMode mode) const;
+  // Returns -1 if the item isn't in the playlist.
+  int RowOfItem(const PlaylistItem* item) const;
+
   // Removes rows with given indices from this playlist.
   bool removeRows(QList<int>& rows);
 
+  void DeletedSongsChecked(const PlaylistItemList& items,
+                           const QSet<QString>& missing);
+
  private slots:
   void TracksAboutToBeDequeued(const QModelIndex&, int begin, int end);
   void TracksDequeued();
@@ -402,6 +456,16 @@ signals:
                         const QPersistentModelIndex& index);
   void ItemReloadComplete(const QPersistentModelIndex& index);
   void ItemsLoaded(QFuture<PlaylistItemList> future);
+
+  void FilterSnapshotDataChanged(const QModelIndex& top_left,
+                                 const QModelIndex& bottom_right);
+  void FilterSnapshotRowsInserted(const QModelIndex& parent, int start,
+                                  int end);
+  void FilterSnapshotRowsRemoved(const QModelIndex& parent, int start,
+                                 int end);
+  void ClearFilterSnapshot();
+  void InvalidateAlbumGroups();
+  void InvalidateItemRows();
   void SongInsertVetoListenerDestroyed();
 
  private:
@@ -419,8 +483,10 @@ signals:
   bool favorite_;
 
   PlaylistItemList items_;
-  QList<int> virtual_items_;  // Contains the indices into items_ in the order
-                              // that they will be played.
+  // Contains the indices into items_ in the order that they will be played.
+  // Mutable because it's shuffled as it's read.
+  mutable ShuffleOrder virtual_items_;
+  QVector<int> album_groups_;
   // A map of library ID to playlist item - for fast lookups when library
   // items change.
   QMultiMap<int, PlaylistItemPtr> library_items_by_id_;
@@ -453,6 +519,22 @@ signals:
 
   // Cancel async restore if songs are already replaced
   bool cancel_restore_;
+
+  // The row of every item, so ItemChanged() doesn't have to search for it.
+  // Built the first time it's needed after rows have been added, removed or
+  // moved.
+  mutable QHash<const PlaylistItem*, int> item_rows_;
+
+  mutable FilterColumnSnapshot filter_snapshot_;
+  mutable QSet<int> filter_snapshot_columns_;
+
+  // Saving is put off until every item has been restored
+  bool restoring_;
+  mutable bool save_after_restore_;
+
+  bool hibernated_;
+  int hibernated_item_count_;
+  quint64 hibernated_length_;
 };
 
 // QDataStream& operator <<(QDataStream&, const Playlist*);
@@ -23,7 +23,10 @@
 #include <QFile>
 #include <QHash>
 #include <QMutexLocker>
+#include <QSet>
 #include <QSqlQuery>
+#include <QtConcurrentRun>
+#include <QVector>
 #include <QtDebug>
 
 #include "core/application.h"
@@ -31,7 +34,9 @@
 #include "core/logging.h"
 #include "core/scopedtransaction.h"
 #include "core/song.h"
+#include "core/urlkey.h"
 #include "library/librarybackend.h"
+#include "library/sqlitequery.h"
 #include "library/sqlrow.h"
 #include "playlist/songplaylistitem.h"
 #include "playlistparsers/cueparser.h"
@@ -44,6 +49,19 @@ using smart_playlists::GeneratorPtr;
 
 const int PlaylistBackend::kSongTableJoins = 4;
 
+namespace {
+
+// Whether a row stored with metadata "saved" is still up to date.
+bool IsDatabaseMetadataEqual(const Song& current, const Song& saved) {
+  return current.url_key() == saved.url_key() &&
+         current.IsMetadataEqual(saved) &&
+         current.playcount() == saved.playcount() &&
+         current.skipcount() == saved.skipcount() &&
+         current.lastplayed() == saved.lastplayed();
+}
+
+}  // namespace
+
 PlaylistBackend::PlaylistBackend(Application* app, QObject* parent)
     : QObject(parent), app_(app), db_(app_->database()) {}
 
@@ -110,7 +128,7 @@ PlaylistBackend::Playlist PlaylistBackend::GetPlaylist(int id) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery q(
+  QSqlQuery q = db_->PreparedQuery(
       "SELECT ROWID, name, last_played, dynamic_playlist_type,"
       "       dynamic_playlist_data, dynamic_playlist_backend,"
       "       special_type, ui_path, is_favorite"
@@ -133,11 +151,14 @@ PlaylistBackend::Playlist PlaylistBackend::GetPlaylist(int id) {
   p.special_type = q.value(6).toString();
   p.ui_path = q.value(7).toString();
   p.favorite = q.value(8).toBool();
+  q.finish();
 
   return p;
 }
 
-QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
+std::unique_ptr<SqliteQuery> PlaylistBackend::GetPlaylistRows(int playlist,
+                                                              int offset,
+                                                              int limit) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
@@ -152,59 +173,140 @@ QSqlQuery PlaylistBackend::GetPlaylistRows(int playlist) {
                   "       p.ROWID, " +
                   Song::JoinSpec("p") +
                   ","
-                  "       p.type, p.radio_service"
+                  "       p.type, p.radio_service, p.position"
                   " FROM playlist_items AS p"
                   " LEFT JOIN songs"
                   "    ON p.library_id = songs.ROWID"
-                  " LEFT JOIN magnatune_songs"
+                  " LEFT JOIN magnatune.songs AS magnatune_songs"
                   "    ON p.library_id = magnatune_songs.ROWID"
                   " LEFT JOIN jamendo.songs AS jamendo_songs"
                   "    ON p.library_id = jamendo_songs.ROWID"
-                  " WHERE p.playlist = :playlist";
-  QSqlQuery q(db);
-  // Forward iterations only may be faster
-  q.setForwardOnly(true);
-  q.prepare(query);
-  q.bindValue(":playlist", playlist);
-  q.exec();
+                  " WHERE p.playlist = :playlist"
+                  " ORDER BY p.position, p.ROWID"
+                  " LIMIT :limit OFFSET :offset";
+  std::unique_ptr<SqliteQuery> q(new SqliteQuery(db, query));
+  q->BindValue(":playlist", playlist);
+  q->BindValue(":limit", limit);
+  q->BindValue(":offset", offset);
+  q->Exec();
 
   return q;
 }
 
-QList<PlaylistItemPtr> PlaylistBackend::GetPlaylistItems(int playlist) {
-  QSqlQuery q = GetPlaylistRows(playlist);
+QList<PlaylistItemPtr> PlaylistBackend::GetPlaylistItems(int playlist,
+                                                         int offset,
+                                                         int limit) {
+  std::unique_ptr<SqliteQuery> q = GetPlaylistRows(playlist, offset, limit);
   // Note that as this only accesses the query, not the db, we don't need the
   // mutex.
-  if (db_->CheckErrors(q)) return QList<PlaylistItemPtr>();
+  if (q->has_error()) return QList<PlaylistItemPtr>();
 
   // it's probable that we'll have a few songs associated with the
   // same CUE so we're caching results of parsing CUEs
   std::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
   QList<PlaylistItemPtr> playlistitems;
-  while (q.next()) {
-    playlistitems << NewPlaylistItemFromQuery(SqlRow(q), state_ptr);
+  SavedRowList saved_rows;
+
+  const int playlist_song_column = (Song::kColumns.count() + 1) * 3;
+  const int position_column =
+      (Song::kColumns.count() + 1) * kSongTableJoins + 2;
+
+  QSet<QString> cue_paths;
+
+  while (q->Next()) {
+    SqlRow row(*q);
+    PlaylistItemPtr item = NewPlaylistItemFromRow(row);
+    playlistitems << item;
+
+    if (item && item->type() == "File" && item->Metadata().has_cue()) {
+      cue_paths << item->Metadata().cue_path();
+    }
+
+    // Remember what the row contains so the next save can skip it if the
+    // item hasn't changed.  RestoreCueData might update the item later, so
+    // the stored metadata is read from the row rather than from the item.
+    SavedRow saved;
+    saved.item = item;
+    saved.rowid = row.value(playlist_song_column).toInt();
+    saved.position = row.value(position_column).toDouble();
+    if (item && !item->IsSongsTableItem()) {
+      saved.metadata.InitFromQuery(row, false, playlist_song_column);
+    }
+    saved_rows << saved;
+  }
+
+  // CUE sheets are parsed in parallel up front, then every item can be
+  // restored from the cache.
+  QList<QFuture<void>> cue_futures;
+  for (const QString& cue_path : cue_paths) {
+    cue_futures << QtConcurrent::run(this, &PlaylistBackend::LoadCue,
+                                     cue_path, state_ptr);
+  }
+  for (QFuture<void> future : cue_futures) {
+    future.waitForFinished();
+  }
+
+  for (int i = 0; i < playlistitems.count(); ++i) {
+    if (!playlistitems[i]) continue;
+
+    PlaylistItemPtr item = RestoreCueData(playlistitems[i], state_ptr);
+    if (item != playlistitems[i]) {
+      playlistitems[i] = item;
+      saved_rows[i].item = item;
+    }
   }
+
+  InitSavedRows(playlist, saved_rows, offset,
+                limit == -1 || saved_rows.count() < limit);
   return playlistitems;
 }
 
+void PlaylistBackend::InitSavedRows(int playlist, const SavedRowList& rows,
+                                    int offset, bool complete) {
+  QMutexLocker l(&saved_rows_mutex_);
+
+  if (offset == 0) {
+    // If the playlist has been saved since these rows were read then the
+    // saved state is newer than ours.
+    if (saved_rows_.contains(playlist)) return;
+
+    saved_rows_[playlist] = rows;
+    if (!complete) partially_loaded_ << playlist;
+  } else if (partially_loaded_.contains(playlist) &&
+             saved_rows_[playlist].count() == offset) {
+    // This is the next part of a playlist being loaded in pieces
+    saved_rows_[playlist].append(rows);
+    if (complete) partially_loaded_.remove(playlist);
+  }
+}
+
 QList<Song> PlaylistBackend::GetPlaylistSongs(int playlist) {
-  QSqlQuery q = GetPlaylistRows(playlist);
+  std::unique_ptr<SqliteQuery> q = GetPlaylistRows(playlist, 0, -1);
   // Note that as this only accesses the query, not the db, we don't need the
   // mutex.
-  if (db_->CheckErrors(q)) return QList<Song>();
+  if (q->has_error()) return QList<Song>();
 
   // it's probable that we'll have a few songs associated with the
   // same CUE so we're caching results of parsing CUEs
   std::shared_ptr<NewSongFromQueryState> state_ptr(new NewSongFromQueryState());
   QList<Song> songs;
-  while (q.next()) {
-    songs << NewSongFromQuery(SqlRow(q), state_ptr);
+  while (q->Next()) {
+    songs << NewSongFromQuery(SqlRow(*q), state_ptr);
   }
   return songs;
 }
 
 PlaylistItemPtr PlaylistBackend::NewPlaylistItemFromQuery(
     const SqlRow& row, std::shared_ptr<NewSongFromQueryState> state) {
+  PlaylistItemPtr item = NewPlaylistItemFromRow(row);
+  if (item) {
+    return RestoreCueData(item, state);
+  } else {
+    return item;
+  }
+}
+
+PlaylistItemPtr PlaylistBackend::NewPlaylistItemFromRow(const SqlRow& row) {
   // The song tables get joined first, plus one each for the song ROWIDs
   const int playlist_row = (Song::kColumns.count() + 1) * kSongTableJoins;
 
@@ -212,10 +314,8 @@ PlaylistItemPtr PlaylistBackend::NewPlaylistItemFromQuery(
       PlaylistItem::NewFromType(row.value(playlist_row).toString()));
   if (item) {
     item->InitFromQuery(row);
-    return RestoreCueData(item, state);
-  } else {
-    return item;
   }
+  return item;
 }
 
 Song PlaylistBackend::NewSongFromQuery(
@@ -232,8 +332,6 @@ PlaylistItemPtr PlaylistBackend::RestoreCueData(
   if (item->type() != "File") {
     return item;
   }
-  CueParser cue_parser(app_->library_backend());
-
   Song song = item->Metadata();
   // we're only interested in .cue songs here
   if (!song.has_cue()) {
@@ -247,21 +345,7 @@ PlaylistItemPtr PlaylistBackend::RestoreCueData(
     return item;
   }
 
-  SongList song_list;
-  {
-    QMutexLocker locker(&state->mutex_);
-
-    if (!state->cached_cues_.contains(cue_path)) {
-      QFile cue(cue_path);
-      cue.open(QIODevice::ReadOnly);
-
-      song_list =
-          cue_parser.Load(&cue, cue_path, QDir(cue_path.section('/', 0, -2)));
-      state->cached_cues_[cue_path] = song_list;
-    } else {
-      song_list = state->cached_cues_[cue_path];
-    }
-  }
+  const SongList song_list = LoadCue(cue_path, state);
 
   for (const Song& from_list : song_list) {
     if (from_list.url().toEncoded() == song.url().toEncoded() &&
@@ -277,6 +361,30 @@ PlaylistItemPtr PlaylistBackend::RestoreCueData(
   return item;
 }
 
+SongList PlaylistBackend::LoadCue(
+    const QString& cue_path, std::shared_ptr<NewSongFromQueryState> state) {
+  {
+    QMutexLocker locker(&state->mutex_);
+    if (state->cached_cues_.contains(cue_path)) {
+      return state->cached_cues_[cue_path];
+    }
+  }
+
+  // Parse without holding the lock so other CUE sheets can be parsed at the
+  // same time.  If two threads race on the same file they'll both get the
+  // same result.
+  CueParser cue_parser(app_->library_backend());
+  QFile cue(cue_path);
+  cue.open(QIODevice::ReadOnly);
+
+  const SongList song_list =
+      cue_parser.Load(&cue, cue_path, QDir(cue_path.section('/', 0, -2)));
+
+  QMutexLocker locker(&state->mutex_);
+  state->cached_cues_[cue_path] = song_list;
+  return song_list;
+}
+
 void PlaylistBackend::SavePlaylistAsync(int playlist,
                                         const PlaylistItemList& items,
                                         int last_played, GeneratorPtr dynamic) {
@@ -293,16 +401,30 @@ void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
 
   qLog(Debug) << "Saving playlist" << playlist;
 
-  QSqlQuery clear("DELETE FROM playlist_items WHERE playlist = :playlist", db);
-  QSqlQuery insert(
+  QSqlQuery clear = db_->PreparedQuery(
+      "DELETE FROM playlist_items WHERE playlist = :playlist", db);
+  QSqlQuery remove = db_->PreparedQuery(
+      "DELETE FROM playlist_items WHERE ROWID = :rowid", db);
+  QSqlQuery move = db_->PreparedQuery(
+      "UPDATE playlist_items SET position = :position WHERE ROWID = :rowid",
+      db);
+  // These are bound by position, it's much quicker than by name for all the
+  // song's columns.
+  SqliteQuery insert(
+      db,
       "INSERT INTO playlist_items"
-      " (playlist, type, library_id, radio_service, " +
+      " (playlist, position, type, library_id, radio_service, " +
           Song::kColumnSpec +
           ")"
-          " VALUES (:playlist, :type, :library_id, :radio_service, " +
-          Song::kBindSpec + ")",
-      db);
-  QSqlQuery update(
+          " VALUES (:playlist, :position, :type, :library_id,"
+          " :radio_service, " +
+          Song::kBindSpec + ")");
+  SqliteQuery insert_id(
+      db,
+      "INSERT INTO playlist_items"
+      " (playlist, position, type, library_id, radio_service)"
+      " VALUES (:playlist, :position, :type, :library_id, :radio_service)");
+  QSqlQuery update = db_->PreparedQuery(
       "UPDATE playlists SET "
       "   last_played=:last_played,"
       "   dynamic_playlist_type=:dynamic_type,"
@@ -311,20 +433,97 @@ void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
       " WHERE ROWID=:playlist",
       db);
 
-  ScopedTransaction transaction(&db);
+  QMutexLocker saved_locker(&saved_rows_mutex_);
+  const SavedRowList old_rows = saved_rows_.value(playlist);
 
-  // Clear the existing items in the playlist
-  clear.bindValue(":playlist", playlist);
-  clear.exec();
-  if (db_->CheckErrors(clear)) return;
+  // Match each item with the row it was stored in last time.  If the item's
+  // metadata has changed since then it gets a new row.
+  QMultiHash<PlaylistItem*, int> old_rows_by_item;
+  old_rows_by_item.reserve(old_rows.count());
+  for (int i = old_rows.count() - 1; i >= 0; --i) {
+    old_rows_by_item.insert(old_rows[i].item.get(), i);
+  }
 
-  // Save the new ones
+  QList<int> old_index;
+  QVector<bool> row_kept(old_rows.count(), false);
+  int kept_count = 0;
   for (PlaylistItemPtr item : items) {
-    insert.bindValue(":playlist", playlist);
-    item->BindToQuery(&insert);
+    int index = -1;
+    QMultiHash<PlaylistItem*, int>::iterator it =
+        old_rows_by_item.find(item.get());
+    if (it != old_rows_by_item.end()) {
+      if (item->IsSongsTableItem() ||
+          IsDatabaseMetadataEqual(item->DatabaseSongMetadata(),
+                                  old_rows[it.value()].metadata)) {
+        index = it.value();
+        row_kept[index] = true;
+        kept_count++;
+      }
+      old_rows_by_item.erase(it);
+    }
+    old_index << index;
+  }
 
-    insert.exec();
-    db_->CheckErrors(insert);
+  ScopedTransaction transaction(&db);
+
+  QList<double> positions;
+  if (kept_count == 0) {
+    // Nothing can be kept so clear the existing items in the playlist
+    clear.bindValue(":playlist", playlist);
+    clear.exec();
+    if (db_->CheckErrors(clear)) return;
+
+    for (int i = 0; i < items.count(); ++i) positions << i;
+  } else {
+    // Remove the rows of items that aren't in the playlist any more
+    for (int i = 0; i < old_rows.count(); ++i) {
+      if (row_kept[i]) continue;
+      remove.bindValue(":rowid", old_rows[i].rowid);
+      remove.exec();
+      if (db_->CheckErrors(remove)) return;
+    }
+
+    AssignPositions(old_index, old_rows, &positions);
+  }
+
+  // Move the items that are left and save the new ones
+  SavedRowList new_rows;
+  new_rows.reserve(items.count());
+  for (int i = 0; i < items.count(); ++i) {
+    PlaylistItemPtr item = items[i];
+
+    SavedRow row;
+    row.item = item;
+    row.position = positions[i];
+    if (!item->IsSongsTableItem()) {
+      row.metadata = item->DatabaseSongMetadata();
+    }
+
+    if (old_index[i] != -1) {
+      const SavedRow& old_row = old_rows[old_index[i]];
+      row.rowid = old_row.rowid;
+
+      if (old_row.position != row.position) {
+        move.bindValue(":position", row.position);
+        move.bindValue(":rowid", row.rowid);
+        move.exec();
+        if (db_->CheckErrors(move)) return;
+      }
+    } else {
+      SqliteQuery& q = item->IsSongsTableItem() ? insert_id : insert;
+      q.AddBindValue(playlist);
+      q.AddBindValue(row.position);
+      if (item->IsSongsTableItem()) {
+        item->BindIdToQuery(&q);
+      } else {
+        item->BindToQuery(&q);
+      }
+
+      if (!q.Run()) continue;
+      row.rowid = q.last_insert_id();
+    }
+
+    new_rows << row;
   }
 
   // Update the last played track number
@@ -343,6 +542,89 @@ void PlaylistBackend::SavePlaylist(int playlist, const PlaylistItemList& items,
   if (db_->CheckErrors(update)) return;
 
   transaction.Commit();
+  saved_rows_[playlist] = new_rows;
+  partially_loaded_.remove(playlist);
+}
+
+void PlaylistBackend::AssignPositions(const QList<int>& old_index,
+                                      const SavedRowList& old_rows,
+                                      QList<double>* positions) {
+  const int count = old_index.count();
+
+  // Find the longest run of kept rows that are still in the same order.
+  // Those keep their positions and everything else is fitted in between.
+  QList<int> tails;
+  QVector<int> previous(count, -1);
+  for (int i = 0; i < count; ++i) {
+    if (old_index[i] == -1) continue;
+    const double position = old_rows[old_index[i]].position;
+
+    int lower = 0;
+    int upper = tails.count();
+    while (lower < upper) {
+      const int middle = (lower + upper) / 2;
+      if (old_rows[old_index[tails[middle]]].position < position) {
+        lower = middle + 1;
+      } else {
+        upper = middle;
+      }
+    }
+
+    if (lower > 0) previous[i] = tails[lower - 1];
+    if (lower == tails.count()) {
+      tails << i;
+    } else {
+      tails[lower] = i;
+    }
+  }
+
+  QVector<bool> anchored(count, false);
+  for (int i = tails.isEmpty() ? -1 : tails.last(); i != -1; i = previous[i]) {
+    anchored[i] = true;
+  }
+
+  QVector<double> ret(count);
+  bool have_lower = false;
+  double lower = 0;
+  for (int i = 0; i < count;) {
+    if (anchored[i]) {
+      lower = ret[i] = old_rows[old_index[i]].position;
+      have_lower = true;
+      ++i;
+      continue;
+    }
+
+    int end = i;
+    while (end < count && !anchored[end]) ++end;
+    const int gap = end - i;
+
+    double upper = end < count ? old_rows[old_index[end]].position : 0;
+    if (!have_lower && end == count) {
+      lower = -1;
+      upper = gap;
+    } else if (!have_lower) {
+      lower = upper - gap - 1;
+    } else if (end == count) {
+      upper = lower + gap + 1;
+    }
+
+    const double step = (upper - lower) / (gap + 1);
+    for (int j = 0; j < gap; ++j) {
+      ret[i + j] = lower + step * (j + 1);
+    }
+    i = end;
+  }
+
+  // Fall back to renumbering everything if we ran out of room between two
+  // positions.
+  for (int i = 1; i < count; ++i) {
+    if (ret[i] <= ret[i - 1]) {
+      for (int j = 0; j < count; ++j) ret[j] = j;
+      break;
+    }
+  }
+
+  *positions = ret.toList();
 }
 
 int PlaylistBackend::CreatePlaylist(const QString& name,
@@ -350,7 +632,7 @@ int PlaylistBackend::CreatePlaylist(const QString& name,
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
 
-  QSqlQuery q(
+  QSqlQuery q = db_->PreparedQuery(
       "INSERT INTO playlists (name, special_type)"
       " VALUES (:name, :special_type)",
       db);
@@ -365,8 +647,10 @@ int PlaylistBackend::CreatePlaylist(const QString& name,
 void PlaylistBackend::RemovePlaylist(int id) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
-  QSqlQuery delete_playlist("DELETE FROM playlists WHERE ROWID=:id", db);
-  QSqlQuery delete_items("DELETE FROM playlist_items WHERE playlist=:id", db);
+  QSqlQuery delete_playlist =
+      db_->PreparedQuery("DELETE FROM playlists WHERE ROWID=:id", db);
+  QSqlQuery delete_items =
+      db_->PreparedQuery("DELETE FROM playlist_items WHERE playlist=:id", db);
 
   delete_playlist.bindValue(":id", id);
   delete_items.bindValue(":id", id);
@@ -380,12 +664,17 @@ void PlaylistBackend::RemovePlaylist(int id) {
   if (db_->CheckErrors(delete_items)) return;
 
   transaction.Commit();
+
+  QMutexLocker saved_locker(&saved_rows_mutex_);
+  saved_rows_.remove(id);
+  partially_loaded_.remove(id);
 }
 
 void PlaylistBackend::RenamePlaylist(int id, const QString& new_name) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
-  QSqlQuery q("UPDATE playlists SET name=:name WHERE ROWID=:id", db);
+  QSqlQuery q =
+      db_->PreparedQuery("UPDATE playlists SET name=:name WHERE ROWID=:id", db);
   q.bindValue(":name", new_name);
   q.bindValue(":id", id);
 
@@ -396,8 +685,8 @@ void PlaylistBackend::RenamePlaylist(int id, const QString& new_name) {
 void PlaylistBackend::FavoritePlaylist(int id, bool is_favorite) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
-  QSqlQuery q("UPDATE playlists SET is_favorite=:is_favorite WHERE ROWID=:id",
-              db);
+  QSqlQuery q = db_->PreparedQuery(
+      "UPDATE playlists SET is_favorite=:is_favorite WHERE ROWID=:id", db);
   q.bindValue(":is_favorite", is_favorite ? 1 : 0);
   q.bindValue(":id", id);
 
@@ -414,7 +703,8 @@ void PlaylistBackend::SetPlaylistOrder(const QList<int>& ids) {
   q.exec();
   if (db_->CheckErrors(q)) return;
 
-  q = QSqlQuery("UPDATE playlists SET ui_order=:index WHERE ROWID=:id", db);
+  q = db_->PreparedQuery(
+      "UPDATE playlists SET ui_order=:index WHERE ROWID=:id", db);
   for (int i = 0; i < ids.count(); ++i) {
     q.bindValue(":index", i);
     q.bindValue(":id", ids[i]);
@@ -428,7 +718,8 @@ void PlaylistBackend::SetPlaylistOrder(const QList<int>& ids) {
 void PlaylistBackend::SetPlaylistUiPath(int id, const QString& path) {
   QMutexLocker l(db_->Mutex());
   QSqlDatabase db(db_->Connect());
-  QSqlQuery q("UPDATE playlists SET ui_path=:path WHERE ROWID=:id", db);
+  QSqlQuery q = db_->PreparedQuery(
+      "UPDATE playlists SET ui_path=:path WHERE ROWID=:id", db);
 
   ScopedTransaction transaction(&db);
 
@@ -18,16 +18,20 @@
 #ifndef PLAYLISTBACKEND_H
 #define PLAYLISTBACKEND_H
 
+#include <memory>
+
 #include <QHash>
 #include <QList>
 #include <QMutex>
 #include <QObject>
+#include <QSet>
 
 #include "playlistitem.h"
 #include "smartplaylists/generator_fwd.h"
 
 class Application;
 class Database;
+class SqliteQuery;
 
 class PlaylistBackend : public QObject {
   Q_OBJECT
@@ -60,7 +64,9 @@ class PlaylistBackend : public QObject {
   PlaylistList GetAllFavoritePlaylists();
   PlaylistBackend::Playlist GetPlaylist(int id);
 
-  QList<PlaylistItemPtr> GetPlaylistItems(int playlist);
+  // Loads limit items starting at offset, or all of them if limit is -1.
+  QList<PlaylistItemPtr> GetPlaylistItems(int playlist, int offset = 0,
+                                          int limit = -1);
   QList<Song> GetPlaylistSongs(int playlist);
 
   void SetPlaylistOrder(const QList<int>& ids);
@@ -86,14 +92,37 @@ class PlaylistBackend : public QObject {
     QMutex mutex_;
   };
 
-  QSqlQuery GetPlaylistRows(int playlist);
+  // A row in playlist_items as it was last read or written.  The item is
+  // kept alive so its address can't be reused by a different item.
+  struct SavedRow {
+    SavedRow() : rowid(-1), position(0) {}
+
+    PlaylistItemPtr item;
+    int rowid;
+    double position;
+    Song metadata;
+  };
+  typedef QList<SavedRow> SavedRowList;
+
+  // The rows are read straight from the statement, without copying them.
+  std::unique_ptr<SqliteQuery> GetPlaylistRows(int playlist, int offset,
+                                               int limit);
+  void InitSavedRows(int playlist, const SavedRowList& rows, int offset,
+                     bool complete);
+
+  static void AssignPositions(const QList<int>& old_index,
+                              const SavedRowList& old_rows,
+                              QList<double>* positions);
 
   Song NewSongFromQuery(const SqlRow& row,
                         std::shared_ptr<NewSongFromQueryState> state);
   PlaylistItemPtr NewPlaylistItemFromQuery(
       const SqlRow& row, std::shared_ptr<NewSongFromQueryState> state);
+  PlaylistItemPtr NewPlaylistItemFromRow(const SqlRow& row);
   PlaylistItemPtr RestoreCueData(PlaylistItemPtr item,
                                  std::shared_ptr<NewSongFromQueryState> state);
+  SongList LoadCue(const QString& cue_path,
+                   std::shared_ptr<NewSongFromQueryState> state);
 
   enum GetPlaylistsFlags {
     GetPlaylists_OpenInUi = 1,
@@ -104,6 +133,13 @@ class PlaylistBackend : public QObject {
 
   Application* app_;
   Database* db_;
+
+  // What's in the database for each playlist, so SavePlaylist only has to
+  // write the rows that changed since the last save.
+  QMutex saved_rows_mutex_;
+  QHash<int, SavedRowList> saved_rows_;
+  // Playlists whose saved rows are still being read in pieces.
+  QSet<int> partially_loaded_;
 };
 
 #endif  // PLAYLISTBACKEND_H
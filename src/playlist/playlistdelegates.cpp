@@ -17,6 +17,7 @@
 
 #include "playlistdelegates.h"
 
+#include <QApplication>
 #include <QDateTime>
 #include <QDir>
 #include <QFuture>
@@ -52,6 +53,7 @@ const int QueuedItemDelegate::kQueueOpacitySteps = 10;
 const float QueuedItemDelegate::kQueueOpacityLowerBound = 0.4;
 
 const int PlaylistDelegateBase::kMinHeight = 19;
+const int PlaylistDelegateBase::kMaxCachedTexts = 10000;
 
 QueuedItemDelegate::QueuedItemDelegate(QObject* parent, int indicator_column)
     : QStyledItemDelegate(parent), indicator_column_(indicator_column) {}
@@ -60,7 +62,12 @@ void QueuedItemDelegate::paint(QPainter* painter,
                                const QStyleOptionViewItem& option,
                                const QModelIndex& index) const {
   QStyledItemDelegate::paint(painter, option, index);
+  DrawQueueIndicator(painter, option, index);
+}
 
+void QueuedItemDelegate::DrawQueueIndicator(QPainter* painter,
+                                            const QStyleOptionViewItem& option,
+                                            const QModelIndex& index) const {
   if (index.column() == indicator_column_) {
     bool ok = false;
     const int queue_pos = index.data(Playlist::Role_QueuePosition).toInt(&ok);
@@ -130,7 +137,12 @@ PlaylistDelegateBase::PlaylistDelegateBase(QObject* parent,
                                            const QString& suffix)
     : QueuedItemDelegate(parent),
       view_(qobject_cast<QTreeView*>(parent)),
-      suffix_(suffix) {}
+      suffix_(suffix) {
+  if (view_) {
+    connect(view_->header(), SIGNAL(sectionResized(int, int, int)),
+            SLOT(InvalidateTextCache()));
+  }
+}
 
 QString PlaylistDelegateBase::displayText(const QVariant& value,
                                           const QLocale&) const {
@@ -169,7 +181,9 @@ QSize PlaylistDelegateBase::sizeHint(const QStyleOptionViewItem& option,
 void PlaylistDelegateBase::paint(QPainter* painter,
                                  const QStyleOptionViewItem& option,
                                  const QModelIndex& index) const {
-  QueuedItemDelegate::paint(painter, Adjusted(option, index), index);
+  const QStyleOptionViewItemV4 adjusted = Adjusted(option, index);
+  PaintCell(painter, adjusted, index);
+  DrawQueueIndicator(painter, adjusted, index);
 
   // Stop after indicator
   if (index.column() == Playlist::Column_Title) {
@@ -182,6 +196,101 @@ void PlaylistDelegateBase::paint(QPainter* painter,
   }
 }
 
+void PlaylistDelegateBase::PaintCell(QPainter* painter,
+                                     const QStyleOptionViewItem& option,
+                                     const QModelIndex& index) const {
+  QStyleOptionViewItemV4 opt(option);
+  initStyleOption(&opt, index);
+
+  const QWidget* widget = opt.widget;
+  QStyle* style = widget ? widget->style() : QApplication::style();
+
+  // The style would elide and lay out the text again on every repaint, even
+  // when only the glow around the current track changed.  Let it draw
+  // everything else, and draw the text laid out earlier on top.
+  const QString text = opt.text;
+  const QRect text_rect =
+      style->subElementRect(QStyle::SE_ItemViewItemText, &opt, widget);
+  opt.text = QString();
+  style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, widget);
+
+  if (text.isEmpty() || (opt.state & QStyle::State_Editing)) return;
+
+  // The same margin and colours that QCommonStyle uses.
+  const int margin =
+      style->pixelMetric(QStyle::PM_FocusFrameHMargin, 0, widget) + 1;
+  const QRect rect = text_rect.adjusted(margin, 0, -margin, 0);
+  const QStaticText& static_text = LayOutText(index, text, opt, rect.width());
+
+  QPalette::ColorGroup group = opt.state & QStyle::State_Enabled
+                                   ? QPalette::Normal
+                                   : QPalette::Disabled;
+  if (group == QPalette::Normal && !(opt.state & QStyle::State_Active)) {
+    group = QPalette::Inactive;
+  }
+
+  painter->save();
+  painter->setPen(opt.palette.color(group, opt.state & QStyle::State_Selected
+                                               ? QPalette::HighlightedText
+                                               : QPalette::Text));
+  painter->setFont(opt.font);
+  painter->drawStaticText(
+      QStyle::alignedRect(opt.direction, opt.displayAlignment,
+                          static_text.size().toSize(), rect).topLeft(),
+      static_text);
+  painter->restore();
+}
+
+const QStaticText& PlaylistDelegateBase::LayOutText(
+    const QModelIndex& index, const QString& text,
+    const QStyleOptionViewItemV4& option, int width) const {
+  WatchModel(index.model());
+  if (text_cache_.count() >= kMaxCachedTexts) text_cache_.clear();
+
+  // The text is checked as well, because the cache is only cleared by signals
+  // from the model, and the row numbers of the cells can change in between.
+  const quint64 key = quint64(index.row()) << 32 | quint32(index.column());
+  CachedText& cached = text_cache_[key];
+  if (cached.width != width || cached.text != text ||
+      cached.font != option.font) {
+    cached.text = text;
+    cached.font = option.font;
+    cached.width = width;
+
+    QString line = text;
+    line.replace('\n', ' ');
+    cached.static_text.setText(QFontMetrics(option.font).elidedText(
+        line, option.textElideMode, width));
+    cached.static_text.prepare(QTransform(), option.font);
+  }
+  return cached.static_text;
+}
+
+void PlaylistDelegateBase::WatchModel(const QAbstractItemModel* model) const {
+  if (model == text_cache_model_) return;
+
+  PlaylistDelegateBase* self = const_cast<PlaylistDelegateBase*>(this);
+  if (text_cache_model_) {
+    disconnect(text_cache_model_, 0, self, SLOT(InvalidateTextCache()));
+  }
+  text_cache_model_ = const_cast<QAbstractItemModel*>(model);
+  text_cache_.clear();
+  if (!model) return;
+
+  connect(model, SIGNAL(dataChanged(QModelIndex, QModelIndex)), self,
+          SLOT(InvalidateTextCache()));
+  connect(model, SIGNAL(rowsInserted(QModelIndex, int, int)), self,
+          SLOT(InvalidateTextCache()));
+  connect(model, SIGNAL(rowsRemoved(QModelIndex, int, int)), self,
+          SLOT(InvalidateTextCache()));
+  connect(model, SIGNAL(rowsMoved(QModelIndex, int, int, QModelIndex, int)),
+          self, SLOT(InvalidateTextCache()));
+  connect(model, SIGNAL(layoutChanged()), self, SLOT(InvalidateTextCache()));
+  connect(model, SIGNAL(modelReset()), self, SLOT(InvalidateTextCache()));
+}
+
+void PlaylistDelegateBase::InvalidateTextCache() { text_cache_.clear(); }
+
 QStyleOptionViewItemV4 PlaylistDelegateBase::Adjusted(
     const QStyleOptionViewItem& option, const QModelIndex& index) const {
   if (!view_) return option;
@@ -23,7 +23,10 @@
 #include "widgets/ratingwidget.h"
 
 #include <QCompleter>
+#include <QHash>
 #include <QPixmapCache>
+#include <QPointer>
+#include <QStaticText>
 #include <QStringListModel>
 #include <QStyledItemDelegate>
 #include <QTreeView>
@@ -41,6 +44,10 @@ class QueuedItemDelegate : public QStyledItemDelegate {
 
   int queue_indicator_size(const QModelIndex& index) const;
 
+ protected:
+  void DrawQueueIndicator(QPainter* painter, const QStyleOptionViewItem& option,
+                          const QModelIndex& index) const;
+
  private:
   static const int kQueueBoxBorder;
   static const int kQueueBoxCornerRadius;
@@ -72,9 +79,40 @@ class PlaylistDelegateBase : public QueuedItemDelegate {
   bool helpEvent(QHelpEvent* event, QAbstractItemView* view,
                  const QStyleOptionViewItem& option, const QModelIndex& index);
 
+ private slots:
+  void InvalidateTextCache();
+
  protected:
+  // Paints the cell the same way QStyledItemDelegate would, except that the
+  // text is drawn from text_cache_ instead of being laid out by the style.
+  void PaintCell(QPainter* painter, const QStyleOptionViewItem& option,
+                 const QModelIndex& index) const;
+
   QTreeView* view_;
   QString suffix_;
+
+ private:
+  // The text of one cell, elided to fit and laid out.
+  struct CachedText {
+    CachedText() : width(-1) { static_text.setTextFormat(Qt::PlainText); }
+
+    QString text;
+    QFont font;
+    int width;
+    QStaticText static_text;
+  };
+
+  static const int kMaxCachedTexts;
+
+  const QStaticText& LayOutText(const QModelIndex& index, const QString& text,
+                                const QStyleOptionViewItemV4& option,
+                                int width) const;
+  void WatchModel(const QAbstractItemModel* model) const;
+
+  // Keyed by the row and column.  Cleared when the model changes or when a
+  // column is resized.
+  mutable QHash<quint64, CachedText> text_cache_;
+  mutable QPointer<QAbstractItemModel> text_cache_model_;
 };
 
 class LengthItemDelegate : public PlaylistDelegateBase {
@@ -18,12 +18,18 @@
 #include "playlistfilter.h"
 #include "playlistfilterparser.h"
 
+#include <QFuture>
+#include <QThread>
+#include <QtConcurrentRun>
 #include <QtDebug>
 
+const int PlaylistFilter::kParallelFilterRows = 10000;
+
 PlaylistFilter::PlaylistFilter(QObject* parent)
     : QSortFilterProxyModel(parent),
       filter_tree_(new NopFilter),
-      query_hash_(0) {
+      query_hash_(0),
+      accepted_rows_valid_(false) {
   setDynamicSortFilter(true);
 
   column_names_["title"] = Playlist::Column_Title;
@@ -61,6 +67,31 @@ void PlaylistFilter::sort(int column, Qt::SortOrder order) {
   sourceModel()->sort(column, order);
 }
 
+void PlaylistFilter::setSourceModel(QAbstractItemModel* source_model) {
+  // Connected before QSortFilterProxyModel's own connections, so the cached
+  // answers are gone before it filters the changed rows again.
+  connect(source_model, SIGNAL(dataChanged(QModelIndex, QModelIndex)),
+          SLOT(InvalidateAcceptedRows()));
+  connect(source_model, SIGNAL(rowsInserted(QModelIndex, int, int)),
+          SLOT(InvalidateAcceptedRows()));
+  connect(source_model, SIGNAL(rowsRemoved(QModelIndex, int, int)),
+          SLOT(InvalidateAcceptedRows()));
+  connect(source_model, SIGNAL(layoutChanged()),
+          SLOT(InvalidateAcceptedRows()));
+  connect(source_model, SIGNAL(modelReset()), SLOT(InvalidateAcceptedRows()));
+
+  QSortFilterProxyModel::setSourceModel(source_model);
+}
+
+void PlaylistFilter::InvalidateAcceptedRows() {
+  accepted_rows_valid_ = false;
+  accepted_rows_.clear();
+}
+
+const Playlist* PlaylistFilter::playlist() const {
+  return static_cast<const Playlist*>(sourceModel());
+}
+
 bool PlaylistFilter::filterAcceptsRow(int row,
                                       const QModelIndex& parent) const {
   QString filter = filterRegExp().pattern();
@@ -71,9 +102,61 @@ bool PlaylistFilter::filterAcceptsRow(int row,
     FilterParser p(filter, column_names_, numerical_columns_);
     filter_tree_.reset(p.parse());
 
+    filter_columns_.clear();
+    filter_tree_->columns(&filter_columns_);
     query_hash_ = hash;
+
+    // We're about to be asked about every row, so answer for all of them at
+    // once.
+    UpdateAcceptedRows();
+  }
+
+  if (filter_tree_->type() == FilterTree::Nop) return true;
+
+  if (accepted_rows_valid_ && row < accepted_rows_.count()) {
+    return accepted_rows_[row];
   }
 
   // Test the row
-  return filter_tree_->accept(row, parent, sourceModel());
+  return filter_tree_->accept(row,
+                              playlist()->filter_snapshot(filter_columns_));
+}
+
+void PlaylistFilter::UpdateAcceptedRows() const {
+  accepted_rows_valid_ = false;
+  accepted_rows_.clear();
+  if (filter_tree_->type() == FilterTree::Nop) return;
+
+  // Build the snapshot here rather than in the worker threads
+  const FilterColumnSnapshot* snapshot =
+      &playlist()->filter_snapshot(filter_columns_);
+  const int count = playlist()->rowCount();
+
+  accepted_rows_.resize(count);
+  bool* accepted = accepted_rows_.data();
+
+  const int chunks =
+      count < kParallelFilterRows ? 1 : qMax(1, QThread::idealThreadCount());
+  if (chunks == 1) {
+    AcceptRows(snapshot, 0, count, accepted);
+  } else {
+    QList<QFuture<void>> futures;
+    for (int i = 0; i < chunks; ++i) {
+      futures << QtConcurrent::run(this, &PlaylistFilter::AcceptRows, snapshot,
+                                   count * i / chunks,
+                                   count * (i + 1) / chunks, accepted);
+    }
+    for (QFuture<void> future : futures) {
+      future.waitForFinished();
+    }
+  }
+
+  accepted_rows_valid_ = true;
+}
+
+void PlaylistFilter::AcceptRows(const FilterColumnSnapshot* snapshot,
+                                int begin, int end, bool* accepted) const {
+  for (int row = begin; row < end; ++row) {
+    accepted[row] = filter_tree_->accept(row, *snapshot);
+  }
 }
@@ -24,8 +24,9 @@
 #include "playlist.h"
 
 #include <QSet>
+#include <QVector>
 
-class FilterTree;
+#include "playlistfilterparser.h"
 
 class PlaylistFilter : public QSortFilterProxyModel {
   Q_OBJECT
@@ -34,17 +35,35 @@ class PlaylistFilter : public QSortFilterProxyModel {
   PlaylistFilter(QObject* parent = nullptr);
   ~PlaylistFilter();
 
+  static const int kParallelFilterRows;
+
   // QAbstractItemModel
   void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
 
   // QSortFilterProxyModel
+  void setSourceModel(QAbstractItemModel* source_model);
   // public so Playlist::NextVirtualIndex and friends can get at it
   bool filterAcceptsRow(int source_row, const QModelIndex& source_parent) const;
 
+ private slots:
+  void InvalidateAcceptedRows();
+
+ private:
+  const Playlist* playlist() const;
+  void UpdateAcceptedRows() const;
+  void AcceptRows(const FilterColumnSnapshot* snapshot, int begin, int end,
+                  bool* accepted) const;
+
  private:
   // Mutable because they're modified from filterAcceptsRow() const
   mutable QScopedPointer<FilterTree> filter_tree_;
   mutable uint query_hash_;
+  mutable QSet<int> filter_columns_;
+
+  // The filter's answer for every row, worked out in one go when the filter
+  // text changes.  Thrown away as soon as the playlist changes.
+  mutable QVector<bool> accepted_rows_;
+  mutable bool accepted_rows_valid_;
 
   QMap<QString, int> column_names_;
   QSet<int> numerical_columns_;
@@ -19,8 +19,6 @@
 #include "playlist.h"
 #include "core/logging.h"
 
-#include <QAbstractItemModel>
-
 class SearchTermComparator {
  public:
   virtual ~SearchTermComparator() {}
@@ -186,16 +184,17 @@ class FilterTerm : public FilterTree {
  public:
   explicit FilterTerm(SearchTermComparator* comparator,
                       const QList<int>& columns)
-      : cmp_(comparator), columns_(columns) {}
+      : cmp_(comparator), columns_(columns.toSet().toList()) {}
 
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
+  virtual bool accept(int row, const FilterColumnSnapshot& columns) const {
     for (int i : columns_) {
-      QModelIndex idx(model->index(row, i, parent));
-      if (cmp_->Matches(idx.data().toString().toLower())) return true;
+      if (cmp_->Matches(columns[i][row])) return true;
     }
     return false;
   }
+  virtual void columns(QSet<int>* columns) const {
+    for (int i : columns_) columns->insert(i);
+  }
   virtual FilterType type() { return Term; }
 
  private:
@@ -210,11 +209,10 @@ class FilterColumnTerm : public FilterTree {
   FilterColumnTerm(int column, SearchTermComparator* comparator)
       : col(column), cmp_(comparator) {}
 
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
-    QModelIndex idx(model->index(row, col, parent));
-    return cmp_->Matches(idx.data().toString().toLower());
+  virtual bool accept(int row, const FilterColumnSnapshot& columns) const {
+    return cmp_->Matches(columns[col][row]);
   }
+  virtual void columns(QSet<int>* columns) const { columns->insert(col); }
   virtual FilterType type() { return Column; }
 
  private:
@@ -226,10 +224,10 @@ class NotFilter : public FilterTree {
  public:
   explicit NotFilter(const FilterTree* inv) : child_(inv) {}
 
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
-    return !child_->accept(row, parent, model);
+  virtual bool accept(int row, const FilterColumnSnapshot& columns) const {
+    return !child_->accept(row, columns);
   }
+  virtual void columns(QSet<int>* columns) const { child_->columns(columns); }
   virtual FilterType type() { return Not; }
 
  private:
@@ -240,13 +238,15 @@ class OrFilter : public FilterTree {
  public:
   ~OrFilter() { qDeleteAll(children_); }
   virtual void add(FilterTree* child) { children_.append(child); }
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
+  virtual bool accept(int row, const FilterColumnSnapshot& columns) const {
     for (FilterTree* child : children_) {
-      if (child->accept(row, parent, model)) return true;
+      if (child->accept(row, columns)) return true;
     }
     return false;
   }
+  virtual void columns(QSet<int>* columns) const {
+    for (FilterTree* child : children_) child->columns(columns);
+  }
   FilterType type() { return Or; }
 
  private:
@@ -257,13 +257,15 @@ class AndFilter : public FilterTree {
  public:
   virtual ~AndFilter() { qDeleteAll(children_); }
   virtual void add(FilterTree* child) { children_.append(child); }
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
+  virtual bool accept(int row, const FilterColumnSnapshot& columns) const {
     for (FilterTree* child : children_) {
-      if (!child->accept(row, parent, model)) return false;
+      if (!child->accept(row, columns)) return false;
     }
     return true;
   }
+  virtual void columns(QSet<int>* columns) const {
+    for (FilterTree* child : children_) child->columns(columns);
+  }
   FilterType type() { return And; }
 
  private:
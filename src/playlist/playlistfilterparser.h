@@ -19,18 +19,22 @@
 #define PLAYLISTFILTERPARSER_H
 
 #include <QMap>
-#include <QModelIndex>
 #include <QSet>
 #include <QString>
+#include <QVector>
 
-class QAbstractItemModel;
+// The lowercased display text of the playlist's columns, indexed by column
+// and then by row.  Only the columns a filter reads need to be filled in.
+typedef QVector<QVector<QString>> FilterColumnSnapshot;
 
 // structure for filter parse tree
 class FilterTree {
  public:
   virtual ~FilterTree() {}
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const = 0;
+  // Safe to call from any thread, as long as the snapshot isn't changing.
+  virtual bool accept(int row, const FilterColumnSnapshot& columns) const = 0;
+  // Adds the columns this filter reads to the set.
+  virtual void columns(QSet<int>* columns) const {}
   enum FilterType { Nop = 0, Or, And, Not, Column, Term };
   virtual FilterType type() = 0;
 };
@@ -38,8 +42,7 @@ class FilterTree {
 // trivial filter that accepts *anything*
 class NopFilter : public FilterTree {
  public:
-  virtual bool accept(int row, const QModelIndex& parent,
-                      const QAbstractItemModel* const model) const {
+  virtual bool accept(int row, const FilterColumnSnapshot& columns) const {
     return true;
   }
   virtual FilterType type() { return Nop; }
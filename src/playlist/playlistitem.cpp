@@ -26,12 +26,21 @@
 #include "internet/core/internetplaylistitem.h"
 #include "library/library.h"
 #include "library/libraryplaylistitem.h"
+#include "library/sqlitequery.h"
 
-#include <QSqlQuery>
 #include <QtConcurrentRun>
 #include <QtDebug>
 
-PlaylistItem::~PlaylistItem() {}
+QAtomicInt PlaylistItem::sLiveCount;
+
+PlaylistItem::PlaylistItem(const QString& type)
+    : should_skip_(false), type_(type) {
+  sLiveCount.ref();
+}
+
+PlaylistItem::~PlaylistItem() { sLiveCount.deref(); }
+
+int PlaylistItem::live_count() { return sLiveCount.fetchAndAddRelaxed(0); }
 
 PlaylistItem* PlaylistItem::NewFromType(const QString& type) {
   if (type == "Library") return new LibraryPlaylistItem(type);
@@ -57,14 +66,17 @@ PlaylistItem* PlaylistItem::NewFromSongsTable(const QString& table,
   return nullptr;
 }
 
-void PlaylistItem::BindToQuery(QSqlQuery* query) const {
-  query->bindValue(":type", type());
-  query->bindValue(":library_id", DatabaseValue(Column_LibraryId));
-  query->bindValue(":radio_service", DatabaseValue(Column_InternetService));
-
+void PlaylistItem::BindToQuery(SqliteQuery* query) const {
+  BindIdToQuery(query);
   DatabaseSongMetadata().BindToQuery(query);
 }
 
+void PlaylistItem::BindIdToQuery(SqliteQuery* query) const {
+  query->AddBindValue(type());
+  query->AddBindValue(DatabaseValue(Column_LibraryId));
+  query->AddBindValue(DatabaseValue(Column_InternetService));
+}
+
 void PlaylistItem::SetTemporaryMetadata(const Song& metadata) {
   temp_metadata_ = metadata;
   temp_metadata_.set_filetype(Song::Type_Stream);
@@ -20,6 +20,7 @@
 
 #include <memory>
 
+#include <QAtomicInt>
 #include <QFuture>
 #include <QMap>
 #include <QMetaType>
@@ -29,13 +30,17 @@
 #include "core/song.h"
 
 class QAction;
+class SqliteQuery;
 class SqlRow;
 
 class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
  public:
-  PlaylistItem(const QString& type) : should_skip_(false), type_(type) {}
+  PlaylistItem(const QString& type);
   virtual ~PlaylistItem();
 
+  // How many playlist items are alive.  Can be called from any thread.
+  static int live_count();
+
   static PlaylistItem* NewFromType(const QString& type);
   static PlaylistItem* NewFromSongsTable(const QString& table,
                                          const Song& song);
@@ -61,7 +66,15 @@ class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
   virtual QList<QAction*> actions() { return QList<QAction*>(); }
 
   virtual bool InitFromQuery(const SqlRow& query) = 0;
-  void BindToQuery(QSqlQuery* query) const;
+  // Binds the type, library_id and radio_service columns, and the song for
+  // BindToQuery(), to the query's next placeholders.
+  void BindToQuery(SqliteQuery* query) const;
+  void BindIdToQuery(SqliteQuery* query) const;
+
+  // Items from a songs table are restored by joining on their library ID, so
+  // playlist_items only needs to store the ID and not the whole song.
+  virtual bool IsSongsTableItem() const { return false; }
+  virtual Song DatabaseSongMetadata() const { return Song(); }
   virtual void Reload() {}
   QFuture<void> BackgroundReload();
 
@@ -106,7 +119,6 @@ class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
   virtual QVariant DatabaseValue(DatabaseColumn) const {
     return QVariant(QVariant::String);
   }
-  virtual Song DatabaseSongMetadata() const { return Song(); }
 
   QString type_;
 
@@ -114,6 +126,9 @@ class PlaylistItem : public std::enable_shared_from_this<PlaylistItem> {
 
   QMap<short, QColor> background_colors_;
   QMap<short, QColor> foreground_colors_;
+
+ private:
+  static QAtomicInt sLiveCount;
 };
 typedef std::shared_ptr<PlaylistItem> PlaylistItemPtr;
 typedef QList<PlaylistItemPtr> PlaylistItemList;
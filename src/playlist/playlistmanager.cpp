@@ -16,9 +16,12 @@
 */
 
 #include "core/application.h"
+#include "core/closure.h"
 #include "core/logging.h"
 #include "core/player.h"
 #include "core/songloader.h"
+#include "core/taskmanager.h"
+#include "core/threadpools.h"
 #include "core/utilities.h"
 #include "library/librarybackend.h"
 #include "library/libraryplaylistitem.h"
@@ -31,15 +34,20 @@
 #include "queue.h"
 #include "smartplaylists/generator.h"
 
+#include <QDateTime>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QFuture>
 #include <QMessageBox>
+#include <QTimer>
 #include <QtConcurrentRun>
 #include <QtDebug>
 
 using smart_playlists::GeneratorPtr;
 
+const int PlaylistManager::kHibernateAfterMsec = 10 * 60 * 1000;  // 10 mins
+const int PlaylistManager::kHibernateCheckIntervalMsec = 60 * 1000;
+
 PlaylistManager::PlaylistManager(Application* app, QObject* parent)
     : PlaylistManagerInterface(app, parent),
       app_(app),
@@ -49,13 +57,25 @@ PlaylistManager::PlaylistManager(Application* app, QObject* parent)
       parser_(nullptr),
       playlist_container_(nullptr),
       current_(-1),
-      active_(-1) {
+      active_(-1),
+      hibernate_timer_(new QTimer(this)) {
+  hibernate_timer_->setInterval(kHibernateCheckIntervalMsec);
+  connect(hibernate_timer_, SIGNAL(timeout()),
+          SLOT(HibernateInactivePlaylists()));
+
   connect(app_->player(), SIGNAL(Paused()), SLOT(SetActivePaused()));
   connect(app_->player(), SIGNAL(Playing()), SLOT(SetActivePlaying()));
   connect(app_->player(), SIGNAL(Stopped()), SLOT(SetActiveStopped()));
 }
 
 PlaylistManager::~PlaylistManager() {
+  for (const PendingSave& save : pending_saves_) {
+    save.cancelled_->fetchAndStoreRelaxed(1);
+  }
+  for (PendingSave& save : pending_saves_) {
+    save.future_.waitForFinished();
+  }
+
   for (const Data& data : playlists_.values()) {
     delete data.p;
   }
@@ -77,6 +97,8 @@ void PlaylistManager::Init(LibraryBackend* library_backend,
           SLOT(SongsDiscovered(SongList)));
   connect(library_backend_, SIGNAL(SongsRatingChanged(SongList)),
           SLOT(SongsDiscovered(SongList)));
+  connect(library_backend_, SIGNAL(SongsReplayGainChanged(SongList)),
+          SLOT(SongsDiscovered(SongList)));
 
   for (const PlaylistBackend::Playlist& p :
        playlist_backend->GetAllOpenPlaylists()) {
@@ -84,11 +106,27 @@ void PlaylistManager::Init(LibraryBackend* library_backend,
   }
 
   // If no playlist exists then make a new one
-  if (playlists_.isEmpty()) New(tr("Playlist"));
+  if (playlists_.isEmpty()) {
+    New(tr("Playlist"));
+  } else {
+    RestorePlaylists();
+  }
+
+  hibernate_timer_->start();
 
   emit PlaylistManagerInitialized();
 }
 
+void PlaylistManager::RestorePlaylists() {
+  // Fill the view of the current playlist straight away, then load the rest
+  // of that and all the other playlists in the background.
+  current()->Restore(Playlist::kRestoreFirstRows);
+
+  for (const Data& data : playlists_.values()) {
+    if (data.p != current()) data.p->Restore();
+  }
+}
+
 QList<Playlist*> PlaylistManager::GetAllPlaylists() const {
   QList<Playlist*> result;
 
@@ -121,11 +159,15 @@ Playlist* PlaylistManager::AddPlaylist(int id, const QString& name,
   connect(ret, SIGNAL(Error(QString)), SIGNAL(Error(QString)));
   connect(ret, SIGNAL(PlayRequested(QModelIndex)),
           SIGNAL(PlayRequested(QModelIndex)));
-  connect(playlist_container_->view(),
-          SIGNAL(ColumnAlignmentChanged(ColumnAlignmentMap)), ret,
-          SLOT(SetColumnAlignment(ColumnAlignmentMap)));
+  // There's no container in headless mode.
+  if (playlist_container_) {
+    connect(playlist_container_->view(),
+            SIGNAL(ColumnAlignmentChanged(ColumnAlignmentMap)), ret,
+            SLOT(SetColumnAlignment(ColumnAlignmentMap)));
+  }
 
   playlists_[id] = Data(ret, name);
+  playlists_[id].last_used_msec = QDateTime::currentMSecsSinceEpoch();
 
   emit PlaylistAdded(id, name, favorite);
 
@@ -178,7 +220,7 @@ void PlaylistManager::Load(const QString& filename) {
 void PlaylistManager::Save(int id, const QString& filename,
                            Playlist::Path path_type) {
   if (playlists_.contains(id)) {
-    parser_->Save(playlist(id)->GetAllSongs(), filename, path_type);
+    SaveSongs(playlist(id)->GetAllSongs(), filename, path_type);
   } else {
     // Playlist is not in the playlist manager: probably save action was
     // triggered
@@ -194,7 +236,66 @@ void PlaylistManager::Save(int id, const QString& filename,
 void PlaylistManager::ItemsLoadedForSavePlaylist(QFuture<SongList> future,
                                                  const QString& filename,
                                                  Playlist::Path path_type) {
-  parser_->Save(future.result(), filename, path_type);
+  SaveSongs(future.result(), filename, path_type);
+}
+
+namespace {
+
+bool SavePlaylistFile(PlaylistParser* parser, TaskManager* task_manager,
+                      int task_id, const SongList& songs,
+                      const QString& filename, Playlist::Path path_type,
+                      QSharedPointer<QAtomicInt> cancelled) {
+  const int total = songs.count();
+  const bool ret = parser->Save(songs, filename, path_type, [=](int written) {
+    task_manager->SetTaskProgress(task_id, written, total);
+    return cancelled->fetchAndAddRelaxed(0) == 0;
+  });
+  task_manager->SetTaskFinished(task_id);
+  return ret;
+}
+
+}  // namespace
+
+void PlaylistManager::SaveSongs(const SongList& songs, const QString& filename,
+                                Playlist::Path path_type) {
+  // The songs are a copy of the playlist as it is now, so it can carry on
+  // changing while it's written.
+  CancelSave(filename);
+
+  const int task_id = app_->task_manager()->StartTask(
+      tr("Saving playlist %1").arg(QFileInfo(filename).fileName()));
+
+  PendingSave save;
+  save.cancelled_.reset(new QAtomicInt(0));
+  save.future_ = ThreadPools::Run<bool>(
+      ThreadPools::Pool_IO,
+      std::bind(&SavePlaylistFile, parser_, app_->task_manager(), task_id,
+                songs, filename, path_type, save.cancelled_));
+  pending_saves_[filename] = save;
+
+  NewClosure(save.future_, this,
+             SLOT(PlaylistSaved(QFuture<bool>, QString)), save.future_,
+             filename);
+}
+
+void PlaylistManager::CancelSave(const QString& filename) {
+  if (!pending_saves_.contains(filename)) return;
+
+  PendingSave save = pending_saves_.take(filename);
+  save.cancelled_->fetchAndStoreRelaxed(1);
+  // Wait for it to stop so the two saves don't both write the file.
+  save.future_.waitForFinished();
+}
+
+void PlaylistManager::PlaylistSaved(QFuture<bool> future,
+                                    const QString& filename) {
+  if (pending_saves_.contains(filename) &&
+      pending_saves_[filename].future_ == future) {
+    pending_saves_.remove(filename);
+    if (!future.result()) {
+      qLog(Warning) << "Failed to save playlist" << filename;
+    }
+  }
 }
 
 void PlaylistManager::SaveWithUI(int id, const QString& playlist_name) {
@@ -335,7 +436,16 @@ void PlaylistManager::OneOfPlaylistsChanged() {
 
 void PlaylistManager::SetCurrentPlaylist(int id) {
   Q_ASSERT(playlists_.contains(id));
+
+  // The playlist being left was in use until now
+  const qint64 now = QDateTime::currentMSecsSinceEpoch();
+  if (playlists_.contains(current_)) {
+    playlists_[current_].last_used_msec = now;
+  }
+  playlists_[id].last_used_msec = now;
+
   current_ = id;
+  current()->Wake(Playlist::kRestoreFirstRows);
   emit CurrentChanged(current());
   UpdateSummaryText();
 }
@@ -347,10 +457,13 @@ void PlaylistManager::SetActivePlaylist(int id) {
   // setting the new one
   if (active_ != -1 && active_ != id) active()->set_current_row(-1);
 
+  // Rows are about to be played by index, so they all have to be loaded
+  playlist(id)->Wake();
+
   active_ = id;
   emit ActiveChanged(active());
 
-  sequence_->SetUsingDynamicPlaylist(active()->is_dynamic());
+  if (sequence_) sequence_->SetUsingDynamicPlaylist(active()->is_dynamic());
 }
 
 void PlaylistManager::SetActiveToCurrent() {
@@ -403,6 +516,7 @@ void PlaylistManager::Enque(int id, int i) {
 
   Q_ASSERT(playlists_.contains(id));
 
+  playlist(id)->Wake();
   dummyIndexList.append(playlist(id)->index(i, 0));
   playlist(id)->queue()->ToggleTracks(dummyIndexList);
 }
@@ -440,6 +554,21 @@ void PlaylistManager::UpdateSummaryText() {
   emit SummaryTextChanged(summary);
 }
 
+void PlaylistManager::HibernateInactivePlaylists() {
+  const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+  for (QMap<int, Data>::iterator it = playlists_.begin();
+       it != playlists_.end(); ++it) {
+    if (it.key() == current_ || it.key() == active_) continue;
+    if (now - it->last_used_msec < kHibernateAfterMsec) continue;
+
+    if (it->p->Hibernate()) {
+      qLog(Debug) << "Hibernated playlist" << it.key();
+      it->selection = QItemSelection();
+    }
+  }
+}
+
 void PlaylistManager::SelectionChanged(const QItemSelection& selection) {
   playlists_[current_id()].selection = selection;
   UpdateSummaryText();
@@ -508,6 +637,11 @@ void PlaylistManager::RemoveCurrentSong() {
   active()->removeRows(active()->current_index().row(), 1);
 }
 
+qint64 PlaylistManager::memory_usage() const {
+  return qint64(PlaylistItem::live_count()) *
+         (sizeof(PlaylistItem) + Song::data_size());
+}
+
 void PlaylistManager::InvalidateDeletedSongs() {
   for (Playlist* playlist : GetAllPlaylists()) {
     playlist->InvalidateDeletedSongs();
@@ -563,7 +697,7 @@ void PlaylistManager::Open(int id) {
     return;
   }
 
-  AddPlaylist(p.id, p.name, p.special_type, p.ui_path, p.favorite);
+  AddPlaylist(p.id, p.name, p.special_type, p.ui_path, p.favorite)->Restore();
 }
 
 void PlaylistManager::SetCurrentOrOpen(int id) {
@@ -18,11 +18,14 @@
 #ifndef PLAYLISTMANAGER_H
 #define PLAYLISTMANAGER_H
 
+#include <QAtomicInt>
 #include <QColor>
+#include <QFuture>
 #include <QItemSelection>
 #include <QMap>
 #include <QObject>
 #include <QSettings>
+#include <QSharedPointer>
 
 #include "core/song.h"
 #include "playlist.h"
@@ -37,6 +40,7 @@ class PlaylistSequence;
 class TaskManager;
 
 class QModelIndex;
+class QTimer;
 class QUrl;
 
 class PlaylistManagerInterface : public QObject {
@@ -142,6 +146,11 @@ class PlaylistManager : public PlaylistManagerInterface {
   PlaylistManager(Application* app, QObject* parent = nullptr);
   ~PlaylistManager();
 
+  // Playlists that haven't been current for this long are hibernated, unless
+  // they are the active playlist.
+  static const int kHibernateAfterMsec;
+  static const int kHibernateCheckIntervalMsec;
+
   int current_id() const { return current_; }
   int active_id() const { return active_; }
 
@@ -151,6 +160,10 @@ class PlaylistManager : public PlaylistManagerInterface {
 
   // Returns the collection of playlists managed by this PlaylistManager.
   QList<Playlist*> GetAllPlaylists() const;
+  // Roughly how many bytes every playlist item takes, including the ones
+  // kept by undo stacks, not counting their strings.  Songs that share their
+  // data with the library are counted twice.
+  qint64 memory_usage() const;
   // Grays out and reloads all deleted songs in all playlists.
   void InvalidateDeletedSongs();
   // Removes all deleted songs from all playlists.
@@ -184,7 +197,10 @@ class PlaylistManager : public PlaylistManagerInterface {
   void New(const QString& name, const SongList& songs = SongList(),
            const QString& special_type = QString());
   void Load(const QString& filename);
+  // Writes the playlist in the background.  Saving to the same file again
+  // before that's finished stops the first save.
   void Save(int id, const QString& filename, Playlist::Path path_type);
+  void CancelSave(const QString& filename);
   // Display a file dialog to let user choose a file before saving the file
   void SaveWithUI(int id, const QString& playlist_name);
   void Rename(int id, const QString& new_name);
@@ -239,23 +255,35 @@ class PlaylistManager : public PlaylistManagerInterface {
 
   void OneOfPlaylistsChanged();
   void UpdateSummaryText();
+  void HibernateInactivePlaylists();
   void SongsDiscovered(const SongList& songs);
   void ItemsLoadedForSavePlaylist(QFuture<SongList> future,
                                   const QString& filename,
                                   Playlist::Path path_type);
+  void PlaylistSaved(QFuture<bool> future, const QString& filename);
 
  private:
   Playlist* AddPlaylist(int id, const QString& name,
                         const QString& special_type, const QString& ui_path,
                         bool favorite);
+  void RestorePlaylists();
+  void SaveSongs(const SongList& songs, const QString& filename,
+                 Playlist::Path path_type);
 
  private:
   struct Data {
     Data(Playlist* _p = nullptr, const QString& _name = QString())
-        : p(_p), name(_name) {}
+        : p(_p), name(_name), last_used_msec(0) {}
     Playlist* p;
     QString name;
     QItemSelection selection;
+    qint64 last_used_msec;
+  };
+
+  struct PendingSave {
+    // Set to non-zero to stop the save.
+    QSharedPointer<QAtomicInt> cancelled_;
+    QFuture<bool> future_;
   };
 
   Application* app_;
@@ -270,6 +298,11 @@ class PlaylistManager : public PlaylistManagerInterface {
 
   int current_;
   int active_;
+
+  QTimer* hibernate_timer_;
+
+  // key = filename
+  QMap<QString, PendingSave> pending_saves_;
 };
 
 #endif  // PLAYLISTMANAGER_H
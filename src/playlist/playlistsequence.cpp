@@ -17,6 +17,7 @@
 
 #include "playlistsequence.h"
 #include "ui_playlistsequence.h"
+#include "core/settingscache.h"
 #include "ui/iconloader.h"
 
 #include <QMenu>
@@ -30,7 +31,7 @@ const char* PlaylistSequence::kSettingsGroup = "PlaylistSequence";
 PlaylistSequence::PlaylistSequence(QWidget* parent, SettingsProvider* settings)
     : QWidget(parent),
       ui_(new Ui_PlaylistSequence),
-      settings_(settings ? settings : new DefaultSettingsProvider),
+      settings_(settings ? settings : SettingsCache::CreateProvider()),
       repeat_menu_(new QMenu(this)),
       shuffle_menu_(new QMenu(this)),
       loading_(false),
@@ -66,6 +67,8 @@ PlaylistSequence::PlaylistSequence(QWidget* parent, SettingsProvider* settings)
   shuffle_group->addAction(ui_->action_shuffle_all);
   shuffle_group->addAction(ui_->action_shuffle_inside_album);
   shuffle_group->addAction(ui_->action_shuffle_albums);
+  shuffle_group->addAction(ui_->action_shuffle_by_rating);
+  shuffle_group->addAction(ui_->action_shuffle_by_playcount);
   shuffle_menu_->addActions(shuffle_group->actions());
   ui_->shuffle->setMenu(shuffle_menu_);
 
@@ -135,6 +138,8 @@ void PlaylistSequence::ShuffleActionTriggered(QAction* action) {
   if (action == ui_->action_shuffle_all) mode = Shuffle_All;
   if (action == ui_->action_shuffle_inside_album) mode = Shuffle_InsideAlbum;
   if (action == ui_->action_shuffle_albums) mode = Shuffle_Albums;
+  if (action == ui_->action_shuffle_by_rating) mode = Shuffle_ByRating;
+  if (action == ui_->action_shuffle_by_playcount) mode = Shuffle_ByPlayCount;
 
   SetShuffleMode(mode);
 }
@@ -187,6 +192,12 @@ void PlaylistSequence::SetShuffleMode(ShuffleMode mode) {
     case Shuffle_Albums:
       ui_->action_shuffle_albums->setChecked(true);
       break;
+    case Shuffle_ByRating:
+      ui_->action_shuffle_by_rating->setChecked(true);
+      break;
+    case Shuffle_ByPlayCount:
+      ui_->action_shuffle_by_playcount->setChecked(true);
+      break;
   }
 
   if (mode != shuffle_mode_) {
@@ -230,6 +241,12 @@ void PlaylistSequence::CycleShuffleMode() {
       mode = Shuffle_Albums;
       break;
     case Shuffle_Albums:
+      mode = Shuffle_ByRating;
+      break;
+    case Shuffle_ByRating:
+      mode = Shuffle_ByPlayCount;
+      break;
+    case Shuffle_ByPlayCount:
       break;
   }
 
@@ -48,6 +48,8 @@ class PlaylistSequence : public QWidget {
     Shuffle_All = 1,
     Shuffle_InsideAlbum = 2,
     Shuffle_Albums = 3,
+    Shuffle_ByRating = 4,
+    Shuffle_ByPlayCount = 5,
   };
 
   static const char* kSettingsGroup;
@@ -17,6 +17,7 @@
 
 #include "playlistundocommands.h"
 #include "playlist.h"
+#include "core/urlkey.h"
 
 namespace PlaylistUndoCommands {
 
@@ -44,7 +45,7 @@ void InsertItems::undo() {
 bool InsertItems::UpdateItem(const PlaylistItemPtr& updated_item) {
   for (int i = 0; i < items_.size(); i++) {
     PlaylistItemPtr item = items_[i];
-    if (item->Metadata().url() == updated_item->Metadata().url()) {
+    if (item->Metadata().url_key() == updated_item->Metadata().url_key()) {
       items_[i] = updated_item;
       return true;
     }
@@ -72,7 +73,23 @@ void RemoveItems::undo() {
 
 bool RemoveItems::mergeWith(const QUndoCommand* other) {
   const RemoveItems* remove_command = static_cast<const RemoveItems*>(other);
-  ranges_.append(remove_command->ranges_);
+
+  for (const Range& range : remove_command->ranges_) {
+    // Removing a selection from the bottom up, or the same row over and over,
+    // gives ranges that touch the last one.  Those are the same as one bigger
+    // range, which is much quicker to undo and redo.
+    Range& last = ranges_.last();
+    if (range.pos_ + range.count_ == last.pos_) {
+      last.pos_ = range.pos_;
+      last.count_ += range.count_;
+      last.items_ = range.items_ + last.items_;
+    } else if (range.pos_ == last.pos_) {
+      last.count_ += range.count_;
+      last.items_ += range.items_;
+    } else {
+      ranges_ << range;
+    }
+  }
 
   int sum = 0;
   for (const Range& range : ranges_) sum += range.count_;
@@ -82,13 +99,32 @@ bool RemoveItems::mergeWith(const QUndoCommand* other) {
 }
 
 MoveItems::MoveItems(Playlist* playlist, const QList<int>& source_rows, int pos)
-    : Base(playlist), source_rows_(source_rows), pos_(pos) {
+    : Base(playlist), pos_(pos) {
   setText(tr("move %n songs", "", source_rows.count()));
+
+  for (int row : source_rows) {
+    if (!source_ranges_.isEmpty()) {
+      Range& last = source_ranges_.last();
+      if (last.start_ + last.count_ == row) {
+        last.count_++;
+        continue;
+      }
+    }
+    source_ranges_ << Range(row, 1);
+  }
 }
 
-void MoveItems::redo() { playlist_->MoveItemsWithoutUndo(source_rows_, pos_); }
+QList<int> MoveItems::SourceRows() const {
+  QList<int> ret;
+  for (const Range& range : source_ranges_) {
+    for (int i = 0; i < range.count_; ++i) ret << range.start_ + i;
+  }
+  return ret;
+}
+
+void MoveItems::redo() { playlist_->MoveItemsWithoutUndo(SourceRows(), pos_); }
 
-void MoveItems::undo() { playlist_->MoveItemsWithoutUndo(pos_, source_rows_); }
+void MoveItems::undo() { playlist_->MoveItemsWithoutUndo(pos_, SourceRows()); }
 
 ReOrderItems::ReOrderItems(Playlist* playlist,
                            const PlaylistItemList& new_items)
@@ -99,11 +135,19 @@ void ReOrderItems::undo() { playlist_->ReOrderWithoutUndo(old_items_); }
 void ReOrderItems::redo() { playlist_->ReOrderWithoutUndo(new_items_); }
 
 SortItems::SortItems(Playlist* playlist, int column, Qt::SortOrder order,
-                     const PlaylistItemList& new_items)
-    : ReOrderItems(playlist, new_items), column_(column), order_(order) {
+                     const QVector<int>& new_rows)
+    : Base(playlist), column_(column), order_(order), new_rows_(new_rows) {
   setText(tr("sort songs"));
 }
 
+void SortItems::undo() {
+  QVector<int> old_rows(new_rows_.count());
+  for (int i = 0; i < new_rows_.count(); ++i) old_rows[new_rows_[i]] = i;
+  playlist_->ReOrderWithoutUndo(old_rows);
+}
+
+void SortItems::redo() { playlist_->ReOrderWithoutUndo(new_rows_); }
+
 ShuffleItems::ShuffleItems(Playlist* playlist,
                            const PlaylistItemList& new_items)
     : ReOrderItems(playlist, new_items) {
@@ -20,6 +20,7 @@
 
 #include <QUndoCommand>
 #include <QCoreApplication>
+#include <QVector>
 
 #include "playlistitem.h"
 
@@ -88,7 +89,17 @@ class MoveItems : public Base {
   void redo();
 
  private:
-  QList<int> source_rows_;
+  // source_rows as runs of consecutive rows, so moving a big selection
+  // doesn't keep every row number on the undo stack.
+  struct Range {
+    Range(int start, int count) : start_(start), count_(count) {}
+    int start_;
+    int count_;
+  };
+
+  QList<int> SourceRows() const;
+
+  QList<Range> source_ranges_;
   int pos_;
 };
 
@@ -104,14 +115,19 @@ class ReOrderItems : public Base {
   PlaylistItemList new_items_;
 };
 
-class SortItems : public ReOrderItems {
+// Stores only the permutation, rather than two copies of the item list.
+class SortItems : public Base {
  public:
   SortItems(Playlist* playlist, int column, Qt::SortOrder order,
-            const PlaylistItemList& new_items);
+            const QVector<int>& new_rows);
+
+  void undo();
+  void redo();
 
  private:
   int column_;
   Qt::SortOrder order_;
+  QVector<int> new_rows_;
 };
 
 class ShuffleItems : public ReOrderItems {
@@ -137,6 +137,8 @@ PlaylistView::PlaylistView(QWidget* parent)
   header_->setMovable(true);
   setStyle(style_);
   setMouseTracking(true);
+  // Every row is one line of text, so there's no need to measure them all
+  setUniformRowHeights(true);
 
   QIcon currenttrack_play =
       IconLoader::Load("currenttrack_play", IconLoader::Other);
@@ -193,8 +195,8 @@ void PlaylistView::SetApplication(Application* app) {
   Q_ASSERT(app);
   app_ = app;
   connect(app_->current_art_loader(),
-          SIGNAL(ArtLoaded(const Song&, const QString&, const QImage&)),
-          SLOT(CurrentSongChanged(const Song&, const QString&, const QImage&)));
+          SIGNAL(ImageLoaded(const Song&, const QImage&)),
+          SLOT(CurrentSongChanged(const Song&, const QImage&)));
   connect(app_->player(), SIGNAL(Paused()), SLOT(StopGlowing()));
   connect(app_->player(), SIGNAL(Playing()), SLOT(StartGlowing()));
   connect(app_->player(), SIGNAL(Stopped()), SLOT(StopGlowing()));
@@ -426,6 +428,7 @@ void PlaylistView::ReloadBarPixmaps() {
   currenttrack_bar_left_ = LoadBarPixmap(":currenttrack_bar_left.png");
   currenttrack_bar_mid_ = LoadBarPixmap(":currenttrack_bar_mid.png");
   currenttrack_bar_right_ = LoadBarPixmap(":currenttrack_bar_right.png");
+  currenttrack_bar_strip_.clear();
 }
 
 QList<QPixmap> PlaylistView::LoadBarPixmap(const QString& filename) {
@@ -454,6 +457,29 @@ QList<QPixmap> PlaylistView::LoadBarPixmap(const QString& filename) {
   return ret;
 }
 
+void PlaylistView::UpdateBarStrip(const QSize& size) {
+  currenttrack_bar_strip_.clear();
+
+  QRect middle(QPoint(0, 0), size);
+  middle.setLeft(middle.left() + currenttrack_bar_left_[0].width());
+  middle.setRight(middle.right() - currenttrack_bar_right_[0].width());
+
+  for (int i = 0; i < kGlowIntensitySteps; ++i) {
+    QPixmap strip(size);
+    strip.fill(Qt::transparent);
+
+    QPainter p(&strip);
+    p.drawPixmap(0, 0, currenttrack_bar_left_[i]);
+    p.drawPixmap(
+        strip.rect().topRight() - currenttrack_bar_right_[0].rect().topRight(),
+        currenttrack_bar_right_[i]);
+    p.drawPixmap(middle, currenttrack_bar_mid_[i]);
+    p.end();
+
+    currenttrack_bar_strip_ << strip;
+  }
+}
+
 void PlaylistView::drawTree(QPainter* painter, const QRegion& region) const {
   const_cast<PlaylistView*>(this)->current_paint_region_ = region;
   QTreeView::drawTree(painter, region);
@@ -470,7 +496,6 @@ void PlaylistView::drawRow(QPainter* painter,
 
   if (is_current) {
     const_cast<PlaylistView*>(this)->last_current_item_ = index;
-    const_cast<PlaylistView*>(this)->last_glow_rect_ = opt.rect;
 
     int step = glow_intensity_step_;
     if (step >= kGlowIntensitySteps)
@@ -483,20 +508,17 @@ void PlaylistView::drawRow(QPainter* painter,
       const_cast<PlaylistView*>(this)->ReloadBarPixmaps();
     }
 
-    QRect middle(opt.rect);
-    middle.setLeft(middle.left() + currenttrack_bar_left_[0].width());
-    middle.setRight(middle.right() - currenttrack_bar_right_[0].width());
-
     // Selection
     if (selectionModel()->isSelected(index))
       painter->fillRect(opt.rect, opt.palette.color(QPalette::Highlight));
 
-    // Draw the bar
-    painter->drawPixmap(opt.rect.topLeft(), currenttrack_bar_left_[step]);
-    painter->drawPixmap(
-        opt.rect.topRight() - currenttrack_bar_right_[0].rect().topRight(),
-        currenttrack_bar_right_[step]);
-    painter->drawPixmap(middle, currenttrack_bar_mid_[step]);
+    // Draw the bar.  Its parts are put together once for each row size, so a
+    // step of the animation is one blit instead of scaling the middle again.
+    if (currenttrack_bar_strip_.isEmpty() ||
+        currenttrack_bar_strip_[0].size() != opt.rect.size()) {
+      const_cast<PlaylistView*>(this)->UpdateBarStrip(opt.rect.size());
+    }
+    painter->drawPixmap(opt.rect.topLeft(), currenttrack_bar_strip_[step]);
 
     // Draw the play icon
     QPoint play_pos(currenttrack_bar_left_[0].width() / 3 * 2,
@@ -567,7 +589,14 @@ void PlaylistView::timerEvent(QTimerEvent* event) {
 void PlaylistView::GlowIntensityChanged() {
   glow_intensity_step_ = (glow_intensity_step_ + 1) % (kGlowIntensitySteps * 2);
 
-  viewport()->update(last_glow_rect_);
+  // Repaint only the current row, and only if it can be seen.  The row is as
+  // wide as the viewport so drawRow can use its cached pixmap.
+  if (!last_current_item_.isValid() || window()->isMinimized()) return;
+
+  const QRect item_rect = visualRect(last_current_item_);
+  const QRect row_rect(0, item_rect.top(), viewport()->width(),
+                       item_rect.height());
+  if (row_rect.intersects(viewport()->rect())) viewport()->update(row_rect);
 }
 
 void PlaylistView::StopGlowing() {
@@ -1281,7 +1310,7 @@ void PlaylistView::CopyCurrentSongToClipboard() const {
   QApplication::clipboard()->setMimeData(mime_data);
 }
 
-void PlaylistView::CurrentSongChanged(const Song& song, const QString& uri,
+void PlaylistView::CurrentSongChanged(const Song& song,
                                       const QImage& song_art) {
   if (current_song_cover_art_ == song_art) return;
 
@@ -101,8 +101,7 @@ class PlaylistView : public QTreeView {
   void SetColumnAlignment(int section, Qt::Alignment alignment);
 
   void CopyCurrentSongToClipboard() const;
-  void CurrentSongChanged(const Song& new_song, const QString& uri,
-                          const QImage& cover_art);
+  void CurrentSongChanged(const Song& new_song, const QImage& cover_art);
   void PlayerStopped();
 
 signals:
@@ -162,6 +161,7 @@ signals:
  private:
   void ReloadBarPixmaps();
   QList<QPixmap> LoadBarPixmap(const QString& filename);
+  void UpdateBarStrip(const QSize& size);
   void UpdateCachedCurrentRowPixmap(QStyleOptionViewItemV4 option,
                                     const QModelIndex& index);
 
@@ -223,8 +223,7 @@ signals:
   bool currently_glowing_;
   QBasicTimer glow_timer_;
   int glow_intensity_step_;
-  QModelIndex last_current_item_;
-  QRect last_glow_rect_;
+  QPersistentModelIndex last_current_item_;
 
   RatingItemDelegate* rating_delegate_;
 
@@ -236,6 +235,9 @@ signals:
   QList<QPixmap> currenttrack_bar_left_;
   QList<QPixmap> currenttrack_bar_mid_;
   QList<QPixmap> currenttrack_bar_right_;
+  // The three parts above put together at the size of the current row, one
+  // pixmap for each step of the glow.
+  QList<QPixmap> currenttrack_bar_strip_;
   QPixmap currenttrack_play_;
   QPixmap currenttrack_pause_;
 
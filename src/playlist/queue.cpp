@@ -19,6 +19,7 @@
 
 #include <QBuffer>
 #include <QMimeData>
+#include <QSet>
 #include <QtDebug>
 
 #include "core/utilities.h"
@@ -26,29 +27,38 @@
 const char* Queue::kRowsMimetype = "application/x-clementine-queue-rows";
 
 Queue::Queue(Playlist* parent)
-    : QAbstractProxyModel(parent), playlist_(parent), total_length_ns_(0) {
+    : QAbstractProxyModel(parent),
+      playlist_(parent),
+      total_length_ns_(0),
+      source_positions_dirty_(false) {
   connect(this, SIGNAL(ItemCountChanged(int)), SLOT(UpdateTotalLength()));
   connect(this, SIGNAL(TotalLengthChanged(quint64)), SLOT(UpdateSummaryText()));
 
   UpdateSummaryText();
 }
 
+const QHash<int, int>& Queue::SourcePositions() const {
+  if (source_positions_dirty_) {
+    source_positions_.clear();
+    source_positions_.reserve(source_indexes_.count());
+    for (int i = 0; i < source_indexes_.count(); ++i) {
+      source_positions_.insert(source_indexes_[i].row(), i);
+    }
+    source_positions_dirty_ = false;
+  }
+  return source_positions_;
+}
+
 QModelIndex Queue::mapFromSource(const QModelIndex& source_index) const {
   if (!source_index.isValid()) return QModelIndex();
 
-  const int source_row = source_index.row();
-  for (int i = 0; i < source_indexes_.count(); ++i) {
-    if (source_indexes_[i].row() == source_row)
-      return index(i, source_index.column());
-  }
-  return QModelIndex();
+  const int position = SourcePositions().value(source_index.row(), -1);
+  if (position == -1) return QModelIndex();
+  return index(position, source_index.column());
 }
 
 bool Queue::ContainsSourceRow(int source_row) const {
-  for (int i = 0; i < source_indexes_.count(); ++i) {
-    if (source_indexes_[i].row() == source_row) return true;
-  }
-  return false;
+  return SourcePositions().contains(source_row);
 }
 
 QModelIndex Queue::mapToSource(const QModelIndex& proxy_index) const {
@@ -65,6 +75,10 @@ void Queue::setSourceModel(QAbstractItemModel* source_model) {
                SLOT(SourceLayoutChanged()));
     disconnect(sourceModel(), SIGNAL(layoutChanged()), this,
                SLOT(SourceLayoutChanged()));
+    disconnect(sourceModel(), SIGNAL(rowsInserted(QModelIndex, int, int)),
+               this, SLOT(SourceRowsChanged()));
+    disconnect(sourceModel(), SIGNAL(modelReset()), this,
+               SLOT(SourceRowsChanged()));
   }
 
   QAbstractProxyModel::setSourceModel(source_model);
@@ -75,6 +89,11 @@ void Queue::setSourceModel(QAbstractItemModel* source_model) {
           SLOT(SourceLayoutChanged()));
   connect(sourceModel(), SIGNAL(layoutChanged()), this,
           SLOT(SourceLayoutChanged()));
+  connect(sourceModel(), SIGNAL(rowsInserted(QModelIndex, int, int)), this,
+          SLOT(SourceRowsChanged()));
+  connect(sourceModel(), SIGNAL(modelReset()), this,
+          SLOT(SourceRowsChanged()));
+  source_positions_dirty_ = true;
 }
 
 void Queue::SourceDataChanged(const QModelIndex& top_left,
@@ -89,16 +108,38 @@ void Queue::SourceDataChanged(const QModelIndex& top_left,
 }
 
 void Queue::SourceLayoutChanged() {
+  // The rows of the queued items might have moved
+  source_positions_dirty_ = true;
+
+  QList<int> invalid_rows;
   for (int i = 0; i < source_indexes_.count(); ++i) {
-    if (!source_indexes_[i].isValid()) {
-      beginRemoveRows(QModelIndex(), i, i);
-      source_indexes_.removeAt(i);
-      endRemoveRows();
+    if (!source_indexes_[i].isValid()) invalid_rows << i;
+  }
+  RemoveProxyRows(invalid_rows);
+
+  emit ItemCountChanged(this->ItemCount());
+}
+
+void Queue::SourceRowsChanged() { source_positions_dirty_ = true; }
+
+void Queue::RemoveProxyRows(QList<int> proxy_rows) {
+  // Remove from the end so the rows still to go don't move
+  qSort(proxy_rows.begin(), proxy_rows.end(), qGreater<int>());
 
-      --i;
+  int i = 0;
+  while (i < proxy_rows.count()) {
+    const int last = proxy_rows[i];
+    int first = last;
+    for (++i; i < proxy_rows.count() && proxy_rows[i] >= first - 1; ++i) {
+      first = qMin(first, proxy_rows[i]);
     }
+
+    beginRemoveRows(QModelIndex(), first, last);
+    source_indexes_.erase(source_indexes_.begin() + first,
+                          source_indexes_.begin() + last + 1);
+    source_positions_dirty_ = true;
+    endRemoveRows();
   }
-  emit ItemCountChanged(this->ItemCount());
 }
 
 QModelIndex Queue::index(int row, int column, const QModelIndex& parent) const {
@@ -143,35 +184,44 @@ QVariant Queue::data(const QModelIndex& proxy_index, int role) const {
 }
 
 void Queue::ToggleTracks(const QModelIndexList& source_indexes) {
+  // Work out what to do with every track first, so the queue is only changed
+  // once for each run of rows rather than once for each track.
+  QList<int> dequeue_rows;
+  QModelIndexList enqueue_indexes;
+  QSet<int> seen_source_rows;
   for (const QModelIndex& source_index : source_indexes) {
-    QModelIndex proxy_index = mapFromSource(source_index);
-    if (proxy_index.isValid()) {
-      // Dequeue the track
-      const int row = proxy_index.row();
-      beginRemoveRows(QModelIndex(), row, row);
-      source_indexes_.removeAt(row);
-      endRemoveRows();
+    if (seen_source_rows.contains(source_index.row())) continue;
+    seen_source_rows.insert(source_index.row());
+
+    const int row = PositionOf(source_index);
+    if (row != -1) {
+      dequeue_rows << row;
     } else {
-      // Enqueue the track
-      const int row = source_indexes_.count();
-      beginInsertRows(QModelIndex(), row, row);
+      enqueue_indexes << source_index;
+    }
+  }
+
+  RemoveProxyRows(dequeue_rows);
+
+  if (!enqueue_indexes.isEmpty()) {
+    const int row = source_indexes_.count();
+    beginInsertRows(QModelIndex(), row, row + enqueue_indexes.count() - 1);
+    for (const QModelIndex& source_index : enqueue_indexes) {
       source_indexes_ << QPersistentModelIndex(source_index);
-      endInsertRows();
     }
+    source_positions_dirty_ = true;
+    endInsertRows();
   }
 }
 
 void Queue::InsertFirst(const QModelIndexList& source_indexes) {
+  // Tracks already in the queue are removed to be reinserted at the start
+  QList<int> dequeue_rows;
   for (const QModelIndex& source_index : source_indexes) {
-    QModelIndex proxy_index = mapFromSource(source_index);
-    if (proxy_index.isValid()) {
-      // Already in the queue, so remove it to be reinserted later
-      const int row = proxy_index.row();
-      beginRemoveRows(QModelIndex(), row, row);
-      source_indexes_.removeAt(row);
-      endRemoveRows();
-    }
+    const int row = PositionOf(source_index);
+    if (row != -1) dequeue_rows << row;
   }
+  RemoveProxyRows(dequeue_rows);
 
   const int rows = source_indexes.count();
   // Enqueue the tracks at the beginning
@@ -181,6 +231,7 @@ void Queue::InsertFirst(const QModelIndexList& source_indexes) {
     source_indexes_.insert(offset, QPersistentModelIndex(source_index));
     offset++;
   }
+  source_positions_dirty_ = true;
   endInsertRows();
 }
 
@@ -230,6 +281,7 @@ void Queue::Clear() {
 
   beginRemoveRows(QModelIndex(), 0, source_indexes_.count() - 1);
   source_indexes_.clear();
+  source_positions_dirty_ = true;
   endRemoveRows();
 }
 
@@ -251,6 +303,7 @@ void Queue::Move(const QList<int>& proxy_rows, int pos) {
   for (int i = start; i < start + moved_items.count(); ++i) {
     source_indexes_.insert(i, moved_items[i - start]);
   }
+  source_positions_dirty_ = true;
 
   // Update persistent indexes
   for (const QModelIndex& pidx : persistentIndexList()) {
@@ -348,6 +401,7 @@ bool Queue::dropMimeData(const QMimeData* data, Qt::DropAction action, int row,
       for (int i = 0; i < source_indexes.count(); ++i) {
         source_indexes_.insert(insert_point + i, source_indexes[i]);
       }
+      source_positions_dirty_ = true;
       endInsertRows();
     }
   }
@@ -376,6 +430,7 @@ int Queue::TakeNext() {
 
   beginRemoveRows(QModelIndex(), 0, 0);
   int ret = source_indexes_.takeFirst().row();
+  source_positions_dirty_ = true;
   endRemoveRows();
 
   return ret;
@@ -392,16 +447,6 @@ void Queue::Remove(QList<int>& proxy_rows) {
 
   // reflects immediately changes in the playlist
   layoutAboutToBeChanged();
-
-  int removed_rows = 0;
-  for (int row : proxy_rows) {
-    // after the first row, the row number needs to be updated
-    const int real_row = row - removed_rows;
-    beginRemoveRows(QModelIndex(), real_row, real_row);
-    source_indexes_.removeAt(real_row);
-    endRemoveRows();
-    removed_rows++;
-  }
-
+  RemoveProxyRows(proxy_rows);
   layoutChanged();
 }
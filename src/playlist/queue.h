@@ -21,6 +21,7 @@
 #include "playlist.h"
 
 #include <QAbstractProxyModel>
+#include <QHash>
 
 class Queue : public QAbstractProxyModel {
   Q_OBJECT
@@ -80,12 +81,25 @@ class Queue : public QAbstractProxyModel {
   void SourceDataChanged(const QModelIndex& top_left,
                          const QModelIndex& bottom_right);
   void SourceLayoutChanged();
+  void SourceRowsChanged();
   void UpdateTotalLength();
 
  private:
+  // Source row -> position in the queue.  The playlist asks for the queue
+  // position of every row it paints, so this saves a scan of the queue each
+  // time.  Built again from source_indexes_ the first time it's needed after
+  // either the queue or the playlist changes.
+  const QHash<int, int>& SourcePositions() const;
+
+  // Removes the rows in runs of consecutive rows.
+  void RemoveProxyRows(QList<int> proxy_rows);
+
   QList<QPersistentModelIndex> source_indexes_;
   const Playlist* playlist_;
   quint64 total_length_ns_;
+
+  mutable QHash<int, int> source_positions_;
+  mutable bool source_positions_dirty_;
 };
 
 #endif  // QUEUE_H
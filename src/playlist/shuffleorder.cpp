@@ -0,0 +1,232 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "shuffleorder.h"
+
+#include <algorithm>
+#include <numeric>
+#include <utility>
+
+#include <QDateTime>
+#include <QHash>
+
+const int ShuffleOrder::kMaxRejections = 16;
+
+ShuffleOrder::ShuffleOrder()
+    : placed_(0),
+      shuffling_(false),
+      random_(QDateTime::currentMSecsSinceEpoch()) {}
+
+int ShuffleOrder::at(int position) {
+  while (shuffling_ && placed_ <= position) {
+    Swap(placed_, positions_[PickRow(placed_)]);
+    ++placed_;
+  }
+  return rows_[position];
+}
+
+int ShuffleOrder::indexOf(int row) const {
+  if (row < 0 || row >= positions_.count()) return -1;
+  return positions_[row];
+}
+
+void ShuffleOrder::Clear() {
+  rows_.clear();
+  positions_.clear();
+  weights_.clear();
+  alias_probability_.clear();
+  alias_.clear();
+  placed_ = 0;
+  shuffling_ = false;
+}
+
+void ShuffleOrder::Resize(int count) {
+  const int old_count = rows_.count();
+  if (count == old_count) return;
+
+  if (count < old_count) {
+    int placed = 0;
+    QVector<int> rows;
+    rows.reserve(count);
+    for (int i = 0; i < old_count; ++i) {
+      if (rows_[i] >= count) continue;
+      if (i < placed_) ++placed;
+      rows << rows_[i];
+    }
+    rows_ = rows;
+    placed_ = placed;
+  } else {
+    rows_.reserve(count);
+    for (int row = old_count; row < count; ++row) rows_ << row;
+  }
+
+  positions_.resize(count);
+  for (int i = 0; i < count; ++i) positions_[rows_[i]] = i;
+
+  if (!shuffling_) placed_ = count;
+  if (!weights_.isEmpty()) {
+    weights_.resize(count);
+    for (int row = old_count; row < count; ++row) weights_[row] = 1.0;
+    BuildAliasTable();
+  }
+}
+
+void ShuffleOrder::Sort() {
+  const int count = rows_.count();
+  std::iota(rows_.begin(), rows_.end(), 0);
+  std::iota(positions_.begin(), positions_.end(), 0);
+  placed_ = count;
+  shuffling_ = false;
+  weights_.clear();
+  BuildAliasTable();
+}
+
+void ShuffleOrder::Shuffle(int first, const QVector<double>& weights) {
+  placed_ = qBound(0, first, rows_.count());
+  shuffling_ = true;
+  weights_ = weights.count() == rows_.count() ? weights : QVector<double>();
+  BuildAliasTable();
+}
+
+void ShuffleOrder::ShuffleGroups(int first, const QVector<int>& groups,
+                                 int first_group) {
+  const int count = rows_.count();
+  first = qBound(0, first, count);
+  shuffling_ = false;
+  weights_.clear();
+  BuildAliasTable();
+
+  // Give each group of the remaining rows a random slot
+  QVector<int> slot_groups;
+  QHash<int, int> group_slots;
+  for (int i = first; i < count; ++i) {
+    const int group = groups[rows_[i]];
+    if (!group_slots.contains(group)) {
+      group_slots[group] = -1;
+      slot_groups << group;
+    }
+  }
+  std::shuffle(slot_groups.begin(), slot_groups.end(), random_);
+
+  const int first_slot = slot_groups.indexOf(first_group);
+  if (first_slot >= 1) std::swap(slot_groups[0], slot_groups[first_slot]);
+  for (int i = 0; i < slot_groups.count(); ++i) {
+    group_slots[slot_groups[i]] = i;
+  }
+
+  // Put the rows in their slots, going through them in playlist order
+  QVector<QVector<int>> buckets(slot_groups.count());
+  for (int row = 0; row < count; ++row) {
+    if (positions_[row] < first) continue;
+    buckets[group_slots[groups[row]]] << row;
+  }
+
+  int position = first;
+  for (const QVector<int>& bucket : buckets) {
+    for (int row : bucket) {
+      rows_[position] = row;
+      positions_[row] = position;
+      ++position;
+    }
+  }
+  placed_ = count;
+}
+
+void ShuffleOrder::MoveTo(int row, int position) {
+  // Anything before the position has to be in place first, or it would be
+  // shuffled over the row later.
+  at(position);
+  Swap(position, positions_[row]);
+}
+
+void ShuffleOrder::Swap(int a, int b) {
+  if (a == b) return;
+  std::swap(rows_[a], rows_[b]);
+  positions_[rows_[a]] = a;
+  positions_[rows_[b]] = b;
+}
+
+int ShuffleOrder::PickRow(int position) {
+  if (!alias_.isEmpty()) {
+    std::uniform_real_distribution<double> coin(0.0, 1.0);
+
+    // Most rows haven't been placed yet at the start of the order, so a
+    // row from the alias table is usually good on the first go.  Towards the
+    // end it's quicker to pick one of the remaining rows directly.
+    for (int i = 0; i < kMaxRejections; ++i) {
+      const int index = RandomIndex(0, alias_.count());
+      const int row =
+          coin(random_) < alias_probability_[index] ? index : alias_[index];
+      if (positions_[row] >= position) return row;
+    }
+  }
+
+  return rows_[RandomIndex(position, rows_.count())];
+}
+
+void ShuffleOrder::BuildAliasTable() {
+  alias_probability_.clear();
+  alias_.clear();
+  if (weights_.isEmpty()) return;
+
+  const int count = weights_.count();
+  double total = 0.0;
+  for (double weight : weights_) total += qMax(0.0, weight);
+  if (total <= 0.0) return;
+
+  // Vose's alias method
+  alias_probability_.resize(count);
+  alias_.resize(count);
+
+  QVector<double> scaled(count);
+  QVector<int> small;
+  QVector<int> large;
+  for (int i = 0; i < count; ++i) {
+    scaled[i] = qMax(0.0, weights_[i]) * count / total;
+    (scaled[i] < 1.0 ? small : large) << i;
+  }
+
+  while (!small.isEmpty() && !large.isEmpty()) {
+    const int less = small.takeLast();
+    const int more = large.last();
+
+    alias_probability_[less] = scaled[less];
+    alias_[less] = more;
+
+    scaled[more] += scaled[less] - 1.0;
+    if (scaled[more] < 1.0) {
+      large.removeLast();
+      small << more;
+    }
+  }
+
+  // Whatever is left over is 1 give or take rounding errors
+  for (int i : large) {
+    alias_probability_[i] = 1.0;
+    alias_[i] = i;
+  }
+  for (int i : small) {
+    alias_probability_[i] = 1.0;
+    alias_[i] = i;
+  }
+}
+
+int ShuffleOrder::RandomIndex(int begin, int end) {
+  std::uniform_int_distribution<int> distribution(begin, end - 1);
+  return distribution(random_);
+}
@@ -0,0 +1,91 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SHUFFLEORDER_H
+#define SHUFFLEORDER_H
+
+#include <random>
+
+#include <QVector>
+
+// The order the rows of a playlist are played in.
+//
+// Shuffling is lazy: the rows after the first shuffled position are only put
+// in place with Fisher-Yates as they're asked for, so shuffling again costs
+// O(1) and every step through the order costs O(1).  Weighted shuffles pick
+// each row with a probability proportional to its weight from an alias table,
+// skipping rows that have already been placed.
+class ShuffleOrder {
+ public:
+  ShuffleOrder();
+
+  int count() const { return rows_.count(); }
+  bool isEmpty() const { return rows_.isEmpty(); }
+
+  // Returns the row that is played at this position.
+  int at(int position);
+  // Returns the position of this row, or -1 if it isn't in the order.
+  int indexOf(int row) const;
+
+  void Clear();
+
+  // Drops the rows from count onwards and appends any new rows at the end,
+  // keeping the order of the others.
+  void Resize(int count);
+
+  // Puts every row back in playlist order.
+  void Sort();
+
+  // Shuffles the rows from position first onwards.  weights has one entry
+  // per row; rows with higher weights come up sooner.  An empty vector
+  // shuffles uniformly.
+  void Shuffle(int first, const QVector<double>& weights = QVector<double>());
+
+  // Puts the rows from position first onwards in groups, with the groups in
+  // a random order and the rows of each group in playlist order.  groups has
+  // the group of every row.  first_group is put first if it's not -1.
+  void ShuffleGroups(int first, const QVector<int>& groups, int first_group);
+
+  // Swaps row into this position.
+  void MoveTo(int row, int position);
+
+ private:
+  void Swap(int a, int b);
+  int PickRow(int position);
+  void BuildAliasTable();
+  int RandomIndex(int begin, int end);
+
+ private:
+  static const int kMaxRejections;
+
+  QVector<int> rows_;       // position -> row
+  QVector<int> positions_;  // row -> position
+
+  // Rows before this position are in their final place.  The ones after it
+  // haven't been shuffled yet if shuffling_ is set.
+  int placed_;
+  bool shuffling_;
+
+  QVector<double> weights_;
+  QVector<double> alias_probability_;
+  QVector<int> alias_;
+
+  std::mt19937 random_;
+};
+
+#endif  // SHUFFLEORDER_H
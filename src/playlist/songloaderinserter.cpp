@@ -47,24 +47,33 @@ void SongLoaderInserter::Load(Playlist* destination, int row, bool play_now,
 
   connect(destination, SIGNAL(destroyed()), SLOT(DestinationDestroyed()));
   connect(this, SIGNAL(PreloadFinished()), SLOT(InsertSongs()));
+  connect(this, SIGNAL(ChunkLoaded(SongList)), SLOT(InsertChunk(SongList)));
   connect(this, SIGNAL(EffectiveLoadFinished(const SongList&)), destination,
           SLOT(UpdateItems(const SongList&)));
 
-  for (const QUrl& url : urls) {
-    SongLoader* loader = new SongLoader(library_, player_, this);
-
-    SongLoader::Result ret = loader->Load(url);
-
-    if (ret == SongLoader::BlockingLoadRequired) {
-      pending_.append(loader);
+  // Local files next to each other share a loader, so the library is searched
+  // once for all of them and their tags are read in batches.
+  QList<QUrl> local_files;
+  for (int i = 0; i <= urls.count(); ++i) {
+    if (i < urls.count() && urls[i].scheme() == "file") {
+      local_files << urls[i];
       continue;
     }
 
-    if (ret == SongLoader::Success)
-      songs_ << loader->songs();
-    else
-      emit Error(tr("Error loading %1").arg(url.toString()));
-    delete loader;
+    if (local_files.count() > 1) {
+      SongLoader* loader = new SongLoader(library_, player_, this);
+      AddLoader(loader, loader->LoadFiles(local_files));
+    } else if (local_files.count() == 1) {
+      // On its own it might be a playlist, which is shown while it's parsed.
+      SongLoader* loader = new SongLoader(library_, player_, this);
+      AddLoader(loader, loader->Load(local_files.first()));
+    }
+    local_files.clear();
+
+    if (i < urls.count()) {
+      SongLoader* loader = new SongLoader(library_, player_, this);
+      AddLoader(loader, loader->Load(urls[i]));
+    }
   }
 
   if (pending_.isEmpty()) {
@@ -75,6 +84,20 @@ void SongLoaderInserter::Load(Playlist* destination, int row, bool play_now,
   }
 }
 
+void SongLoaderInserter::AddLoader(SongLoader* loader,
+                                   SongLoader::Result result) {
+  if (result == SongLoader::BlockingLoadRequired) {
+    pending_.append(loader);
+    return;
+  }
+
+  if (result == SongLoader::Success)
+    songs_ << loader->songs();
+  else
+    emit Error(tr("Error loading %1").arg(loader->url().toString()));
+  delete loader;
+}
+
 // Load audio CD tracks:
 // First, we add tracks (without metadata) into the playlist
 // In the meantime, MusicBrainz will be queried to get songs' metadata.
@@ -101,7 +124,14 @@ void SongLoaderInserter::LoadAudioCD(Playlist* destination, int row,
   // Songs will be loaded later: see AudioCDTracksLoaded and AudioCDTagsLoaded slots
 }
 
-void SongLoaderInserter::DestinationDestroyed() { destination_ = nullptr; }
+void SongLoaderInserter::DestinationDestroyed() {
+  destination_ = nullptr;
+  cancelled_.fetchAndStoreRelaxed(1);
+}
+
+bool SongLoaderInserter::is_cancelled() {
+  return cancelled_.fetchAndAddRelaxed(0);
+}
 
 void SongLoaderInserter::AudioCDTracksLoaded(SongLoader* loader) {
   songs_ = loader->songs();
@@ -119,13 +149,21 @@ void SongLoaderInserter::AudioCDTagsLoaded(bool success) {
   deleteLater();
 }
 
-void SongLoaderInserter::InsertSongs() {
+void SongLoaderInserter::InsertSongs() { InsertChunk(songs_); }
+
+void SongLoaderInserter::InsertChunk(const SongList& songs) {
+  if (songs.isEmpty()) return;
+
   // Insert songs (that haven't been completely loaded) to allow user to see
   // and play them while not loaded completely
   if (destination_) {
-    destination_->InsertSongsOrLibraryItems(songs_, row_, play_now_, enqueue_,
+    destination_->InsertSongsOrLibraryItems(songs, row_, play_now_, enqueue_,
                                             enqueue_next_);
   }
+
+  // Later chunks go after this one, and only the first one starts playing.
+  if (row_ != -1) row_ += songs.count();
+  play_now_ = false;
 }
 
 void SongLoaderInserter::AsyncLoad() {
@@ -136,15 +174,38 @@ void SongLoaderInserter::AsyncLoad() {
                                  pending_.count());
   for (int i = 0; i < pending_.count(); ++i) {
     SongLoader* loader = pending_[i];
-    loader->LoadFilenamesBlocking();
+
+    // Playlists hand over their songs while they're parsed, so the start of a
+    // huge one is shown straight away.  Songs from earlier URLs go first to
+    // keep the order.  Chunks played next would end up queued in reverse
+    // order, so those are inserted all at once instead.
+    int streamed = 0;
+    SongLoader::SongSink sink;
+    if (!enqueue_next_) {
+      sink = [this, &streamed](const SongList& songs) -> bool {
+        if (is_cancelled()) return false;
+        songs_ << songs;
+        streamed += songs.count();
+        emit ChunkLoaded(songs_);
+        songs_.clear();
+        return true;
+      };
+    }
+    loader->LoadFilenamesBlocking(sink);
+    if (is_cancelled()) {
+      task_manager_->SetTaskFinished(async_load_id);
+      deleteLater();
+      return;
+    }
+
     task_manager_->SetTaskProgress(async_load_id, ++async_progress);
     if (i == 0) {
       // Load everything from the first song.  It'll start playing as soon as
       // we emit PreloadFinished, so it needs to have the duration set to show
       // properly in the UI.
-      loader->LoadMetadataBlocking();
+      loader->LoadFirstMetadataBlocking();
     }
-    songs_ << loader->songs();
+    songs_ << loader->songs().mid(streamed);
   }
   task_manager_->SetTaskFinished(async_load_id);
   emit PreloadFinished();
@@ -154,12 +215,9 @@ void SongLoaderInserter::AsyncLoad() {
   async_load_id = task_manager_->StartTask(tr("Loading tracks info"));
   task_manager_->SetTaskProgress(async_load_id, async_progress, songs_.count());
   SongList songs;
-  for (int i = 0; i < pending_.count(); ++i) {
-    SongLoader* loader = pending_[i];
-    if (i != 0) {
-      // We already did this earlier for the first song.
-      loader->LoadMetadataBlocking();
-    }
+  for (SongLoader* loader : pending_) {
+    // The first song was loaded earlier, and is skipped here.
+    loader->LoadMetadataBlocking();
     songs << loader->songs();
     task_manager_->SetTaskProgress(async_load_id, songs.count());
   }
@@ -18,16 +18,17 @@
 #ifndef SONGLOADERINSERTER_H
 #define SONGLOADERINSERTER_H
 
+#include <QAtomicInt>
 #include <QList>
 #include <QObject>
 #include <QUrl>
 
 #include "core/song.h"
+#include "core/songloader.h"
 
 class LibraryBackendInterface;
 class Player;
 class Playlist;
-class SongLoader;
 class TaskManager;
 
 class QModelIndex;
@@ -47,6 +48,8 @@ class SongLoaderInserter : public QObject {
  signals:
   void Error(const QString& message);
   void PreloadFinished();
+  // Part of a playlist that was parsed before the rest, in order.
+  void ChunkLoaded(const SongList& songs);
   void EffectiveLoadFinished(const SongList& songs);
 
  private slots:
@@ -54,9 +57,13 @@ class SongLoaderInserter : public QObject {
   void AudioCDTracksLoaded(SongLoader* loader);
   void AudioCDTagsLoaded(bool success);
   void InsertSongs();
+  void InsertChunk(const SongList& songs);
 
  private:
+  // Keeps the loader for AsyncLoad, or takes its songs and deletes it.
+  void AddLoader(SongLoader* loader, SongLoader::Result result);
   void AsyncLoad();
+  bool is_cancelled();
 
  private:
   TaskManager* task_manager_;
@@ -69,6 +76,9 @@ class SongLoaderInserter : public QObject {
 
   SongList songs_;
 
+  // Set when the destination goes away, to stop parsing playlists early.
+  QAtomicInt cancelled_;
+
   QList<SongLoader*> pending_;
   LibraryBackendInterface* library_;
   const Player* player_;
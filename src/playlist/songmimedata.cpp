@@ -0,0 +1,49 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "songmimedata.h"
+
+#include <QStringList>
+#include <QUrl>
+
+namespace {
+const char* kUriListMimeType = "text/uri-list";
+}  // namespace
+
+QStringList SongMimeData::formats() const {
+  QStringList ret = MimeData::formats();
+  if (song_loader && !ret.contains(kUriListMimeType)) {
+    ret << kUriListMimeType;
+  }
+  return ret;
+}
+
+QVariant SongMimeData::retrieveData(const QString& mimetype,
+                                    QVariant::Type type) const {
+  if (song_loader && mimetype == kUriListMimeType) {
+    // Only other applications ask for the URLs, so they have to wait while
+    // the songs are looked up.
+    if (loaded_urls_.isEmpty()) {
+      for (const Song& song : song_loader()) {
+        loaded_urls_ << song.url();
+      }
+    }
+    return loaded_urls_;
+  }
+
+  return MimeData::retrieveData(mimetype, type);
+}
@@ -18,6 +18,8 @@
 #ifndef SONGMIMEDATA_H
 #define SONGMIMEDATA_H
 
+#include <functional>
+
 #include <QMimeData>
 
 #include "core/mimedata.h"
@@ -33,6 +35,21 @@ class SongMimeData : public MimeData {
 
   LibraryBackendInterface* backend;
   SongList songs;
+
+  // Set instead of songs by models that would have to run a lot of queries to
+  // find them.  The playlist calls it on a worker thread when the data is
+  // dropped.
+  std::function<SongList()> song_loader;
+
+  // QMimeData
+  QStringList formats() const;
+
+ protected:
+  // QMimeData
+  QVariant retrieveData(const QString& mimetype, QVariant::Type type) const;
+
+ private:
+  mutable QList<QVariant> loaded_urls_;
 };
 
 #endif  // SONGMIMEDATA_H
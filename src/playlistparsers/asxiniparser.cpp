@@ -30,7 +30,7 @@ bool AsxIniParser::TryMagic(const QByteArray& data) const {
 
 SongList AsxIniParser::Load(QIODevice* device, const QString& playlist_path,
                             const QDir& dir) const {
-  SongList ret;
+  QStringList refs;
 
   while (!device->atEnd()) {
     QString line = QString::fromUtf8(device->readLine()).trimmed();
@@ -39,24 +39,30 @@ SongList AsxIniParser::Load(QIODevice* device, const QString& playlist_path,
     QString value = line.mid(equals + 1);
 
     if (key.startsWith("ref")) {
-      Song song = LoadSong(value, 0, dir);
-      if (song.is_valid()) {
-        ret << song;
-      }
+      refs << value;
     }
   }
 
+  SongList ret;
+  for (const Song& song : LoadSongs(refs, dir)) {
+    if (song.is_valid()) {
+      ret << song;
+    }
+  }
   return ret;
 }
 
-void AsxIniParser::Save(const SongList& songs, QIODevice* device,
-                        const QDir& dir, Playlist::Path path_type) const {
+bool AsxIniParser::Save(const SongList& songs, QIODevice* device,
+                        const QDir& dir, Playlist::Path path_type,
+                        const SaveMonitor& monitor) const {
   QTextStream s(device);
   s << "[Reference]" << endl;
 
   int n = 1;
   for (const Song& song : songs) {
     s << "Ref" << n << "=" << URLOrFilename(song.url(), dir, path_type) << endl;
+    if (!ContinueSave(monitor, n)) return false;
     ++n;
   }
+  return true;
 }
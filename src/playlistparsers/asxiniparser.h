@@ -33,8 +33,9 @@ class AsxIniParser : public ParserBase {
 
   SongList Load(QIODevice* device, const QString& playlist_path = "",
                 const QDir& dir = QDir()) const;
-  void Save(const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
-            Playlist::Path path_type = Playlist::Path_Automatic) const;
+  bool Save(const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
+            Playlist::Path path_type = Playlist::Path_Automatic,
+            const SaveMonitor& monitor = SaveMonitor()) const;
 };
 
 #endif  // ASXINIPARSER_H
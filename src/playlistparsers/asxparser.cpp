@@ -69,17 +69,32 @@ SongList ASXParser::Load(QIODevice* device, const QString& playlist_path,
     return ret;
   }
 
+  QStringList refs;
+  SongList entries;
   while (!reader.atEnd() && Utilities::ParseUntilElement(&reader, "entry")) {
-    Song song = ParseTrack(&reader, dir);
-    if (song.is_valid()) {
-      ret << song;
+    QString ref;
+    entries << ParseTrack(&reader, &ref);
+    refs << ref;
+  }
+
+  SongList songs = LoadSongs(refs, dir);
+  for (int i = 0; i < songs.count(); ++i) {
+    Song* song = &songs[i];
+
+    // Override metadata with what was in the playlist
+    song->set_title(entries[i].title());
+    song->set_artist(entries[i].artist());
+    song->set_album(entries[i].album());
+
+    if (song->is_valid()) {
+      ret << *song;
     }
   }
   return ret;
 }
 
-Song ASXParser::ParseTrack(QXmlStreamReader* reader, const QDir& dir) const {
-  QString title, artist, album, ref;
+Song ASXParser::ParseTrack(QXmlStreamReader* reader, QString* ref) const {
+  QString title, artist, album;
 
   while (!reader->atEnd()) {
     QXmlStreamReader::TokenType type = reader->readNext();
@@ -88,7 +103,7 @@ Song ASXParser::ParseTrack(QXmlStreamReader* reader, const QDir& dir) const {
       case QXmlStreamReader::StartElement: {
         QStringRef name = reader->name();
         if (name == "ref") {
-          ref = reader->attributes().value("href").toString();
+          *ref = reader->attributes().value("href").toString();
         } else if (name == "title") {
           title = reader->readElementText();
         } else if (name == "author") {
@@ -108,17 +123,16 @@ Song ASXParser::ParseTrack(QXmlStreamReader* reader, const QDir& dir) const {
   }
 
 return_song:
-  Song song = LoadSong(ref, 0, dir);
-
-  // Override metadata with what was in the playlist
+  Song song;
   song.set_title(title);
   song.set_artist(artist);
   song.set_album(album);
   return song;
 }
 
-void ASXParser::Save(const SongList& songs, QIODevice* device, const QDir&,
-                     Playlist::Path path_type) const {
+bool ASXParser::Save(const SongList& songs, QIODevice* device, const QDir&,
+                     Playlist::Path path_type,
+                     const SaveMonitor& monitor) const {
   QXmlStreamWriter writer(device);
   writer.setAutoFormatting(true);
   writer.setAutoFormattingIndent(2);
@@ -126,7 +140,9 @@ void ASXParser::Save(const SongList& songs, QIODevice* device, const QDir&,
   {
     StreamElement asx("asx", &writer);
     writer.writeAttribute("version", "3.0");
+    int n = 0;
     for (const Song& song : songs) {
+      if (!ContinueSave(monitor, n++)) return false;
       StreamElement entry("entry", &writer);
       writer.writeTextElement("title", song.title());
       {
@@ -139,6 +155,7 @@ void ASXParser::Save(const SongList& songs, QIODevice* device, const QDir&,
     }
   }
   writer.writeEndDocument();
+  return true;
 }
 
 bool ASXParser::TryMagic(const QByteArray& data) const {
@@ -33,11 +33,13 @@ class ASXParser : public XMLParser {
 
   SongList Load(QIODevice* device, const QString& playlist_path = "",
                 const QDir& dir = QDir()) const;
-  void Save(const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
-            Playlist::Path path_type = Playlist::Path_Automatic) const;
+  bool Save(const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
+            Playlist::Path path_type = Playlist::Path_Automatic,
+            const SaveMonitor& monitor = SaveMonitor()) const;
 
  private:
-  Song ParseTrack(QXmlStreamReader* reader, const QDir& dir) const;
+  // Returns the metadata in the playlist, and sets the track's location.
+  Song ParseTrack(QXmlStreamReader* reader, QString* location) const;
 };
 
 #endif
@@ -19,18 +19,21 @@
 #include "core/logging.h"
 #include "core/timeconstants.h"
 
+#include <algorithm>
+
 #include <QBuffer>
 #include <QDateTime>
 #include <QFileInfo>
+#include <QMutexLocker>
 #include <QStringBuilder>
-#include <QRegExp>
 #include <QTextCodec>
 #include <QTextStream>
 #include <QtDebug>
 
-const char* CueParser::kFileLineRegExp =
-    "(\\S+)\\s+(?:\"([^\"]+)\"|(\\S+))\\s*(?:\"([^\"]+)\"|(\\S+))?";
-const char* CueParser::kIndexRegExp = "(\\d{2,3}):(\\d{2}):(\\d{2})";
+const int CueParser::kMaxCachedCues = 1000;
+
+QMutex CueParser::sParsedCuesMutex;
+QCache<QString, CueParser::ParsedCue> CueParser::sParsedCues(kMaxCachedCues);
 
 const char* CueParser::kPerformer = "performer";
 const char* CueParser::kTitle = "title";
@@ -51,17 +54,81 @@ SongList CueParser::Load(QIODevice* device, const QString& playlist_path,
                          const QDir& dir) const {
   SongList ret;
 
+  // Library scans and playlist restores load the same .cue files over and
+  // over, so the parsed entries are kept until the file changes.
+  const QFileInfo cue_info(playlist_path);
+  ParsedCue cue;
+  if (!FindParsedCue(cue_info, &cue)) {
+    cue.entries = ParseEntries(device, dir.absolutePath(), &cue.files);
+    StoreParsedCue(cue_info, cue);
+  }
+  const QList<CueEntry>& entries = cue.entries;
+
+  QDateTime cue_mtime = cue_info.lastModified();
+
+  // Most .cue files have all their tracks in one media file, so each file is
+  // only read once.
+  QHash<QString, Song> files_read;
+
+  // finalize parsing songs
+  for (int i = 0; i < entries.length(); i++) {
+    const CueEntry& entry = entries.at(i);
+    const QString file = QDir::isAbsolutePath(entry.file)
+                             ? entry.file
+                             : dir.absoluteFilePath(entry.file);
+
+    Song song;
+    LoadSong(file, IndexToMarker(entry.index), dir, &song, &files_read);
+
+    // cue song has mtime equal to qMax(media_file_mtime, cue_sheet_mtime)
+    if (cue_mtime.isValid()) {
+      song.set_mtime(qMax(cue_mtime.toTime_t(), song.mtime()));
+    }
+    song.set_cue_path(playlist_path);
+
+    // overwrite the stuff, we may have read from the file or library, using
+    // the current .cue metadata
+
+    // set track number only in single-file mode
+    if (cue.files == 1) {
+      song.set_track(i + 1);
+    }
+
+    // the last TRACK for every FILE gets it's 'end' marker from the media
+    // file's
+    // length
+    if (i + 1 < entries.size() &&
+        entries.at(i).file == entries.at(i + 1).file) {
+      // incorrect indices?
+      if (!UpdateSong(entry, entries.at(i + 1).index, &song)) {
+        continue;
+      }
+    } else {
+      // incorrect index?
+      if (!UpdateLastSong(entry, &song)) {
+        continue;
+      }
+    }
+
+    ret << song;
+  }
+
+  return ret;
+}
+
+QList<CueParser::CueEntry> CueParser::ParseEntries(QIODevice* device,
+                                                   const QString& dir_path,
+                                                   int* files) const {
+  QList<CueEntry> entries;
+  *files = 0;
+
   QTextStream text_stream(device);
   text_stream.setCodec(QTextCodec::codecForUtfText(
       device->peek(1024), QTextCodec::codecForName("UTF-8")));
 
-  QString dir_path = dir.absolutePath();
   // read the first line already
   QString line = text_stream.readLine();
 
-  QList<CueEntry> entries;
-  int files = 0;
-
   // -- whole file
   while (!text_stream.atEnd()) {
     QString album_artist;
@@ -99,9 +166,7 @@ SongList CueParser::Load(QIODevice* device, const QString& playlist_path,
 
         // FILE
       } else if (line_name == kFile) {
-        file = QDir::isAbsolutePath(line_value)
-                   ? line_value
-                   : dir.absoluteFilePath(line_value);
+        file = line_value;
 
         if (splitted.size() > 2) {
           file_type = splitted[2];
@@ -128,7 +193,7 @@ SongList CueParser::Load(QIODevice* device, const QString& playlist_path,
         
         // end of the header -> go into the track mode
       } else if (line_name == kTrack) {
-        files++;
+        (*files)++;
         break;
       }
 
@@ -138,7 +203,7 @@ SongList CueParser::Load(QIODevice* device, const QString& playlist_path,
     if (line.isNull()) {
       qLog(Warning) << "the .cue file from " << dir_path
                     << " defines no tracks!";
-      return ret;
+      return QList<CueEntry>();
     }
 
     // if this is a data file, all of it's tracks will be ignored
@@ -220,64 +285,69 @@ SongList CueParser::Load(QIODevice* device, const QString& playlist_path,
     }
   }
 
-  QDateTime cue_mtime = QFileInfo(playlist_path).lastModified();
+  return entries;
+}
 
-  // finalize parsing songs
-  for (int i = 0; i < entries.length(); i++) {
-    CueEntry entry = entries.at(i);
+bool CueParser::FindParsedCue(const QFileInfo& info, ParsedCue* cue) {
+  const QDateTime mtime = info.lastModified();
+  if (!mtime.isValid()) return false;
 
-    Song song = LoadSong(entry.file, IndexToMarker(entry.index), dir);
+  QMutexLocker l(&sParsedCuesMutex);
+  const ParsedCue* cached = sParsedCues.object(info.absoluteFilePath());
+  if (!cached || cached->mtime != mtime.toTime_t() ||
+      cached->size != info.size()) {
+    return false;
+  }
 
-    // cue song has mtime equal to qMax(media_file_mtime, cue_sheet_mtime)
-    if (cue_mtime.isValid()) {
-      song.set_mtime(qMax(cue_mtime.toTime_t(), song.mtime()));
-    }
-    song.set_cue_path(playlist_path);
+  *cue = *cached;
+  return true;
+}
 
-    // overwrite the stuff, we may have read from the file or library, using
-    // the current .cue metadata
+void CueParser::StoreParsedCue(const QFileInfo& info, const ParsedCue& cue) {
+  const QDateTime mtime = info.lastModified();
+  if (!mtime.isValid()) return;
 
-    // set track number only in single-file mode
-    if (files == 1) {
-      song.set_track(i + 1);
-    }
+  ParsedCue* cached = new ParsedCue(cue);
+  cached->mtime = mtime.toTime_t();
+  cached->size = info.size();
 
-    // the last TRACK for every FILE gets it's 'end' marker from the media
-    // file's
-    // length
-    if (i + 1 < entries.size() &&
-        entries.at(i).file == entries.at(i + 1).file) {
-      // incorrect indices?
-      if (!UpdateSong(entry, entries.at(i + 1).index, &song)) {
-        continue;
-      }
-    } else {
-      // incorrect index?
-      if (!UpdateLastSong(entry, &song)) {
+  QMutexLocker l(&sParsedCuesMutex);
+  sParsedCues.insert(info.absoluteFilePath(), cached);
+}
+
+// Splits the raw .cue line into its keyword and up to two values, getting rid
+// of all the unnecessary whitespaces and quoting.  Lines with more parts than
+// that aren't understood, so an empty list is returned for them.
+QStringList CueParser::SplitCueLine(const QString& line) const {
+  QStringList ret;
+  const QChar* p = line.constData();
+  const QChar* end = p + line.size();
+
+  forever {
+    while (p != end && p->isSpace()) ++p;
+    if (p == end) break;
+    if (ret.size() == 3) return QStringList();
+
+    // A quoted value, unless the quotes are empty or never closed, in which
+    // case they're just part of the value.
+    if (*p == '"' && !ret.isEmpty()) {
+      const QChar* close = std::find(p + 1, end, QChar('"'));
+      if (close != end && close != p + 1) {
+        ret << QString(p + 1, close - p - 1);
+        p = close + 1;
         continue;
       }
     }
 
-    ret << song;
+    const QChar* start = p;
+    while (p != end && !p->isSpace()) ++p;
+    ret << QString(start, p - start);
   }
 
+  if (ret.size() < 2) return QStringList();
   return ret;
 }
 
-// This and the kFileLineRegExp do most of the "dirty" work, namely: splitting
-// the raw .cue
-// line into logical parts and getting rid of all the unnecessary whitespaces
-// and quoting.
-QStringList CueParser::SplitCueLine(const QString& line) const {
-  QRegExp line_regexp(kFileLineRegExp);
-  if (!line_regexp.exactMatch(line.trimmed())) {
-    return QStringList();
-  }
-
-  // let's remove the empty entries while we're at it
-  return line_regexp.capturedTexts().filter(QRegExp(".+")).mid(1, -1);
-}
-
 // Updates the song with data from the .cue entry. This one mustn't be used for
 // the
 // last song in the .cue file.
@@ -333,21 +403,30 @@ bool CueParser::UpdateLastSong(const CueEntry& entry, Song* song) const {
 }
 
 qint64 CueParser::IndexToMarker(const QString& index) const {
-  QRegExp index_regexp(kIndexRegExp);
-  if (!index_regexp.exactMatch(index)) {
+  // mm:ss:ff, where minutes may have three digits.
+  const QStringList splitted = index.split(':');
+  if (splitted.count() != 3 || splitted[0].length() < 2 ||
+      splitted[0].length() > 3 || splitted[1].length() != 2 ||
+      splitted[2].length() != 2) {
     return -1;
   }
+  for (const QString& part : splitted) {
+    for (const QChar& c : part) {
+      if (!c.isDigit()) return -1;
+    }
+  }
 
-  QStringList splitted = index_regexp.capturedTexts().mid(1, -1);
   qlonglong frames = splitted.at(0).toLongLong() * 60 * 75 +
                      splitted.at(1).toLongLong() * 75 +
                      splitted.at(2).toLongLong();
   return (frames * kNsecPerSec) / 75;
 }
 
-void CueParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
-                     Playlist::Path path_type) const {
+bool CueParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
+                     Playlist::Path path_type,
+                     const SaveMonitor& monitor) const {
   // TODO
+  return true;
 }
 
 // Looks for a track starting with one of the .cue's keywords.
@@ -20,7 +20,10 @@
 
 #include "parserbase.h"
 
-#include <QRegExp>
+#include <QCache>
+#include <QMutex>
+
+class QFileInfo;
 
 // This parser will try to detect the real encoding of a .cue file but there's
 // a great chance it will fail so it's probably best to assume that the parser
@@ -29,8 +32,8 @@ class CueParser : public ParserBase {
   Q_OBJECT
 
  public:
-  static const char* kFileLineRegExp;
-  static const char* kIndexRegExp;
+  // How many parsed .cue files are kept in memory, for all the parsers.
+  static const int kMaxCachedCues;
 
   static const char* kPerformer;
   static const char* kTitle;
@@ -54,12 +57,14 @@ class CueParser : public ParserBase {
 
   SongList Load(QIODevice* device, const QString& playlist_path = "",
                 const QDir& dir = QDir()) const;
-  void Save(const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
-            Playlist::Path path_type = Playlist::Path_Automatic) const;
+  bool Save(const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
+            Playlist::Path path_type = Playlist::Path_Automatic,
+            const SaveMonitor& monitor = SaveMonitor()) const;
 
  private:
   // A single TRACK entry in .cue file.
   struct CueEntry {
+    // As it's written in the FILE line, possibly relative.
     QString file;
 
     QString index;
@@ -100,12 +105,33 @@ class CueParser : public ParserBase {
     }
   };
 
+  // The entries of a .cue file, and when it was last changed.
+  struct ParsedCue {
+    ParsedCue() : mtime(0), size(-1), files(0) {}
+
+    uint mtime;
+    qint64 size;
+    QList<CueEntry> entries;
+    int files;
+  };
+
+  QList<CueEntry> ParseEntries(QIODevice* device, const QString& dir_path,
+                               int* files) const;
+
+  // Look up and store parsed .cue files by their path.  They're checked
+  // against the file's mtime and size, so changed files are parsed again.
+  static bool FindParsedCue(const QFileInfo& info, ParsedCue* cue);
+  static void StoreParsedCue(const QFileInfo& info, const ParsedCue& cue);
+
   bool UpdateSong(const CueEntry& entry, const QString& next_index,
                   Song* song) const;
   bool UpdateLastSong(const CueEntry& entry, Song* song) const;
 
   QStringList SplitCueLine(const QString& line) const;
   qint64 IndexToMarker(const QString& index) const;
+
+  static QMutex sParsedCuesMutex;
+  static QCache<QString, ParsedCue> sParsedCues;
 };
 
 #endif  // CUEPARSER_H
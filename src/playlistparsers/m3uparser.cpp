@@ -30,6 +30,18 @@ M3UParser::M3UParser(LibraryBackendInterface* library, QObject* parent)
 SongList M3UParser::Load(QIODevice* device, const QString& playlist_path,
                          const QDir& dir) const {
   SongList ret;
+  LoadChunked(device, playlist_path, dir,
+              [&ret](const SongList& songs) -> bool {
+                ret << songs;
+                return true;
+              });
+  return ret;
+}
+
+bool M3UParser::LoadChunked(QIODevice* device, const QString& playlist_path,
+                            const QDir& dir, const SongSink& sink) const {
+  QStringList locations;
+  QList<Metadata> metadata;
 
   M3UType type = STANDARD;
   Metadata current_metadata;
@@ -57,19 +69,16 @@ SongList M3UParser::Load(QIODevice* device, const QString& playlist_path,
         }
       }
     } else if (!line.isEmpty()) {
-      Song song = LoadSong(line, 0, dir);
-      if (!current_metadata.title.isEmpty()) {
-        song.set_title(current_metadata.title);
-      }
-      if (!current_metadata.artist.isEmpty()) {
-        song.set_artist(current_metadata.artist);
-      }
-      if (current_metadata.length > 0) {
-        song.set_length_nanosec(current_metadata.length);
-      }
-      ret << song;
+      locations << line;
+      metadata << current_metadata;
 
       current_metadata = Metadata();
+
+      if (locations.count() == kChunkSize) {
+        if (!sink(LoadEntries(locations, metadata, dir))) return false;
+        locations.clear();
+        metadata.clear();
+      }
     }
     if (buffer.atEnd()) {
       break;
@@ -77,6 +86,26 @@ SongList M3UParser::Load(QIODevice* device, const QString& playlist_path,
     line = QString::fromUtf8(buffer.readLine()).trimmed();
   }
 
+  return locations.isEmpty() || sink(LoadEntries(locations, metadata, dir));
+}
+
+SongList M3UParser::LoadEntries(const QStringList& locations,
+                                const QList<Metadata>& metadata,
+                                const QDir& dir) const {
+  SongList ret = LoadSongs(locations, dir);
+  for (int i = 0; i < ret.count(); ++i) {
+    Song* song = &ret[i];
+    if (!metadata[i].title.isEmpty()) {
+      song->set_title(metadata[i].title);
+    }
+    if (!metadata[i].artist.isEmpty()) {
+      song->set_artist(metadata[i].artist);
+    }
+    if (metadata[i].length > 0) {
+      song->set_length_nanosec(metadata[i].length);
+    }
+  }
+
   return ret;
 }
 
@@ -104,8 +133,9 @@ bool M3UParser::ParseMetadata(const QString& line,
   return true;
 }
 
-void M3UParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
-                     Playlist::Path path_type) const {
+bool M3UParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
+                     Playlist::Path path_type,
+                     const SaveMonitor& monitor) const {
   device->write("#EXTM3U\n");
 
   QSettings s;
@@ -113,7 +143,9 @@ void M3UParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
   bool writeMetadata = s.value(Playlist::kWriteMetadata, true).toBool();
   s.endGroup();
 
+  int n = 0;
   for (const Song& song : songs) {
+    if (!ContinueSave(monitor, n++)) return false;
     if (song.url().isEmpty()) {
       continue;
     }
@@ -127,6 +159,7 @@ void M3UParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
     device->write(URLOrFilename(song.url(), dir, path_type).toUtf8());
     device->write("\n");
   }
+  return true;
 }
 
 bool M3UParser::TryMagic(const QByteArray& data) const {
@@ -41,8 +41,11 @@ class M3UParser : public ParserBase {
 
   SongList Load(QIODevice* device, const QString& playlist_path = "",
                 const QDir& dir = QDir()) const;
-  void Save(const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
-            Playlist::Path path_type = Playlist::Path_Automatic) const;
+  bool LoadChunked(QIODevice* device, const QString& playlist_path,
+                   const QDir& dir, const SongSink& sink) const;
+  bool Save(const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
+            Playlist::Path path_type = Playlist::Path_Automatic,
+            const SaveMonitor& monitor = SaveMonitor()) const;
 
  private:
   enum M3UType {
@@ -60,6 +63,11 @@ class M3UParser : public ParserBase {
 
   bool ParseMetadata(const QString& line, Metadata* metadata) const;
 
+  // Loads the songs at the locations and overrides their metadata with the
+  // extended info, if there was any.
+  SongList LoadEntries(const QStringList& locations,
+                       const QList<Metadata>& metadata, const QDir& dir) const;
+
   FRIEND_TEST(M3UParserTest, ParsesMetadata);
   FRIEND_TEST(M3UParserTest, ParsesTrackLocation);
   FRIEND_TEST(M3UParserTest, ParsesTrackLocationRelative);
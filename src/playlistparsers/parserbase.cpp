@@ -17,20 +17,29 @@
 
 #include "parserbase.h"
 #include "core/tagreaderclient.h"
+#include "core/urlkey.h"
 #include "library/librarybackend.h"
 #include "library/libraryquery.h"
 #include "library/sqlrow.h"
 #include "playlist/playlist.h"
 
+#include <QHash>
 #include <QUrl>
 
 ParserBase::ParserBase(LibraryBackendInterface* library, QObject* parent)
     : QObject(parent), library_(library) {}
 
-void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
-                          const QDir& dir, Song* song) const {
+const int ParserBase::kChunkSize = 250;
+
+bool ParserBase::LoadChunked(QIODevice* device, const QString& playlist_path,
+                             const QDir& dir, const SongSink& sink) const {
+  return sink(Load(device, playlist_path, dir));
+}
+
+QString ParserBase::ParseLocation(const QString& filename_or_url,
+                                  const QDir& dir, Song* song) const {
   if (filename_or_url.isEmpty()) {
-    return;
+    return QString();
   }
 
   QString filename = filename_or_url;
@@ -43,7 +52,7 @@ void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
       song->set_url(QUrl::fromUserInput(filename_or_url));
       song->set_filetype(Song::Type_Stream);
       song->set_valid(true);
-      return;
+      return QString();
     }
   }
 
@@ -62,6 +71,17 @@ void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
     filename = QFileInfo(filename).canonicalFilePath();
   }
 
+  return filename;
+}
+
+void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
+                          const QDir& dir, Song* song,
+                          QHash<QString, Song>* files_read) const {
+  const QString filename = ParseLocation(filename_or_url, dir, song);
+  if (filename.isEmpty()) {
+    return;
+  }
+
   const QUrl url = QUrl::fromLocalFile(filename);
 
   // Search in the library
@@ -74,6 +94,12 @@ void ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
   // disk.
   if (library_song.is_valid()) {
     *song = library_song;
+  } else if (files_read) {
+    if (!files_read->contains(filename)) {
+      TagReaderClient::Instance()->ReadFileBlocking(filename,
+                                                    &(*files_read)[filename]);
+    }
+    *song = files_read->value(filename);
   } else {
     TagReaderClient::Instance()->ReadFileBlocking(filename, song);
   }
@@ -86,6 +112,67 @@ Song ParserBase::LoadSong(const QString& filename_or_url, qint64 beginning,
   return song;
 }
 
+SongList ParserBase::LoadSongs(const QStringList& filenames_or_urls,
+                               const QDir& dir) const {
+  SongList ret;
+  QStringList filenames;
+  QList<int> file_indices;
+
+  for (const QString& filename_or_url : filenames_or_urls) {
+    Song song;
+    const QString filename = ParseLocation(filename_or_url, dir, &song);
+    if (!filename.isEmpty()) {
+      filenames << filename;
+      file_indices << ret.count();
+    }
+    ret << song;
+  }
+
+  if (filenames.isEmpty()) return ret;
+
+  // Search in the library
+  QHash<QByteArray, Song> library_songs;
+  if (library_) {
+    QList<QUrl> urls;
+    for (const QString& filename : filenames) {
+      urls << QUrl::fromLocalFile(filename);
+    }
+    for (const Song& song : library_->GetSongsByUrls(urls)) {
+      if (song.beginning_nanosec() == 0) {
+        library_songs[song.url_key().encoded()] = song;
+      }
+    }
+  }
+
+  // Load metadata from disk for the ones that weren't found
+  QStringList misses;
+  QList<int> miss_indices;
+  for (int i = 0; i < filenames.count(); ++i) {
+    const QByteArray key = QUrl::fromLocalFile(filenames[i]).toEncoded();
+    if (library_songs.contains(key)) {
+      ret[file_indices[i]] = library_songs[key];
+    } else {
+      misses << filenames[i];
+      miss_indices << file_indices[i];
+    }
+  }
+
+  if (!misses.isEmpty()) {
+    SongList read;
+    TagReaderClient::Instance()->ReadFilesBlocking(misses, &read);
+    for (int i = 0; i < miss_indices.count() && i < read.count(); ++i) {
+      ret[miss_indices[i]] = read[i];
+    }
+  }
+
+  return ret;
+}
+
+bool ParserBase::ContinueSave(const SaveMonitor& monitor, int written) {
+  if (!monitor || written % kChunkSize != 0) return true;
+  return monitor(written);
+}
+
 QString ParserBase::URLOrFilename(const QUrl& url, const QDir& dir,
                                   Playlist::Path path_type) const {
   if (url.scheme() != "file") return url.toString();
@@ -93,6 +180,16 @@ QString ParserBase::URLOrFilename(const QUrl& url, const QDir& dir,
   const QString filename = url.toLocalFile();
 
   if (path_type != Playlist::Path_Absolute && QDir::isAbsolutePath(filename)) {
+    // Most files in a playlist are usually somewhere under its directory, and
+    // their relative path is just the rest of the filename.  That's much
+    // cheaper than QDir::relativeFilePath.
+    const QString prefix = dir.absolutePath();
+    if (filename.length() > prefix.length() + 1 &&
+        filename.startsWith(prefix) && filename[prefix.length()] == '/' &&
+        !filename.contains("/./") && !filename.contains("/../")) {
+      return filename.mid(prefix.length() + 1);
+    }
+
     const QString relative = dir.relativeFilePath(filename);
 
     if (!relative.startsWith("../") || path_type == Playlist::Path_Relative)
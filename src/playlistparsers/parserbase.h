@@ -18,8 +18,11 @@
 #ifndef PARSERBASE_H
 #define PARSERBASE_H
 
-#include <QObject>
+#include <functional>
+
 #include <QDir>
+#include <QHash>
+#include <QObject>
 
 #include "core/song.h"
 #include "playlist/playlist.h"
@@ -51,21 +54,56 @@ class ParserBase : public QObject {
   // from the parser's point of view).
   virtual SongList Load(QIODevice* device, const QString& playlist_path = "",
                         const QDir& dir = QDir()) const = 0;
-  virtual void Save(
+
+  // Receives the songs of a playlist in order, a chunk at a time.  Returning
+  // false stops the parser.
+  typedef std::function<bool(const SongList&)> SongSink;
+
+  // Like Load, but hands the songs to 'sink' in chunks of kChunkSize as they
+  // are loaded, so the start of a huge playlist can be shown while the rest
+  // is still being parsed.  Returns false if the sink cancelled the load.
+  // The default implementation hands over everything Load returns at once.
+  virtual bool LoadChunked(QIODevice* device, const QString& playlist_path,
+                           const QDir& dir, const SongSink& sink) const;
+
+  // Told how many songs have been written every kChunkSize songs while a
+  // playlist is saved.  Returning false stops the save.
+  typedef std::function<bool(int)> SaveMonitor;
+
+  // Writes the songs to the device.  Returns false if the monitor stopped it
+  // before the end, in which case what has been written is incomplete.
+  virtual bool Save(
       const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
-      Playlist::Path path_type = Playlist::Path_Automatic) const = 0;
+      Playlist::Path path_type = Playlist::Path_Automatic,
+      const SaveMonitor& monitor = SaveMonitor()) const = 0;
 
  protected:
+  static const int kChunkSize;
+
+  // Parsers call this after writing each song.  Returns false if the save
+  // should stop.
+  static bool ContinueSave(const SaveMonitor& monitor, int written);
+
   // Loads a song.  If filename_or_url is a URL (with a scheme other than
   // "file") then it is set on the song and the song marked as a stream.
   // If it is a filename or a file:// URL then it is made absolute and canonical
   // and set as a file:// url on the song.  Also sets the song's metadata by
   // searching in the Library, or loading from the file as a fallback.
   // This function should always be used when loading a playlist.
+  // If 'files_read' is given, the metadata loaded from files is kept in it by
+  // filename, and used again when the same file is loaded another time.
   Song LoadSong(const QString& filename_or_url, qint64 beginning,
                 const QDir& dir) const;
   void LoadSong(const QString& filename_or_url, qint64 beginning,
-                const QDir& dir, Song* song) const;
+                const QDir& dir, Song* song,
+                QHash<QString, Song>* files_read = nullptr) const;
+
+  // Loads many songs the same way as LoadSong, and returns them in the same
+  // order.  The songs in the library are found with one query, and the rest
+  // are read by the tag reader workers in parallel.  Parsers should collect
+  // all their entries first and load them with this.
+  SongList LoadSongs(const QStringList& filenames_or_urls,
+                     const QDir& dir) const;
 
   // If the URL is a file:// URL then returns its path, absolute or relative to
   // the directory depending on the path_type option.
@@ -75,6 +113,11 @@ class ParserBase : public QObject {
                         Playlist::Path path_type) const;
 
  private:
+  // Sets the URL of a stream on the song and returns an empty string, or
+  // returns the absolute, canonical filename of a local file.
+  QString ParseLocation(const QString& filename_or_url, const QDir& dir,
+                        Song* song) const;
+
   LibraryBackendInterface* library_;
 };
 
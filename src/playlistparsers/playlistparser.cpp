@@ -150,20 +150,41 @@ SongList PlaylistParser::LoadFromDevice(QIODevice* device,
   return parser->Load(device, path_hint, dir_hint);
 }
 
-void PlaylistParser::Save(const SongList& songs, const QString& filename,
-                          Playlist::Path path_type) const {
+bool PlaylistParser::Save(const SongList& songs, const QString& filename,
+                          Playlist::Path path_type,
+                          const ParserBase::SaveMonitor& monitor) const {
   QFileInfo info(filename);
 
   // Find a parser that supports this file extension
   ParserBase* parser = ParserForExtension(info.suffix());
   if (!parser) {
     qLog(Warning) << "Unknown filetype:" << filename;
-    return;
+    return false;
   }
 
-  // Open the file
-  QFile file(filename);
-  file.open(QIODevice::WriteOnly);
+  // Write to a temporary file next to the real one, and only replace the
+  // real one once the whole playlist is there.
+  const QString temp_filename = filename + ".part";
+  QFile file(temp_filename);
+  if (!file.open(QIODevice::WriteOnly)) {
+    qLog(Warning) << "Failed to open" << temp_filename << "for writing";
+    return false;
+  }
+
+  const bool finished =
+      parser->Save(songs, &file, info.absolutePath(), path_type, monitor);
+  file.close();
 
-  return parser->Save(songs, &file, info.absolutePath(), path_type);
+  if (!finished || file.error() != QFile::NoError) {
+    file.remove();
+    return false;
+  }
+
+  QFile::remove(filename);
+  if (!file.rename(filename)) {
+    qLog(Warning) << "Failed to rename" << temp_filename << "to" << filename;
+    file.remove();
+    return false;
+  }
+  return true;
 }
@@ -22,9 +22,9 @@
 #include <QObject>
 
 #include "core/song.h"
+#include "parserbase.h"
 #include "playlist/playlist.h"
 
-class ParserBase;
 class LibraryBackendInterface;
 
 class PlaylistParser : public QObject {
@@ -52,8 +52,12 @@ class PlaylistParser : public QObject {
   SongList LoadFromDevice(QIODevice* device,
                           const QString& path_hint = QString(),
                           const QDir& dir_hint = QDir()) const;
-  void Save(const SongList& songs, const QString& filename,
-            Playlist::Path) const;
+
+  // Returns false if the playlist couldn't be written, or the monitor stopped
+  // it first.  Either way the file that was there before is left alone.
+  bool Save(const SongList& songs, const QString& filename, Playlist::Path,
+            const ParserBase::SaveMonitor& monitor =
+                ParserBase::SaveMonitor()) const;
 
  private:
   QString FilterForParser(const ParserBase* parser,
@@ -28,6 +28,7 @@ PLSParser::PLSParser(LibraryBackendInterface* library, QObject* parent)
 SongList PLSParser::Load(QIODevice* device, const QString& playlist_path,
                          const QDir& dir) const {
   QMap<int, Song> songs;
+  QMap<int, QString> locations;
   QRegExp n_re("\\d+$");
 
   while (!device->atEnd()) {
@@ -40,14 +41,7 @@ SongList PLSParser::Load(QIODevice* device, const QString& playlist_path,
     int n = n_re.cap(0).toInt();
 
     if (key.startsWith("file")) {
-      Song song = LoadSong(value, 0, dir);
-
-      // Use the title and length we've already loaded if any
-      if (!songs[n].title().isEmpty()) song.set_title(songs[n].title());
-      if (songs[n].length_nanosec() != -1)
-        song.set_length_nanosec(songs[n].length_nanosec());
-
-      songs[n] = song;
+      locations[n] = value;
     } else if (key.startsWith("title")) {
       songs[n].set_title(value);
     } else if (key.startsWith("length")) {
@@ -58,11 +52,26 @@ SongList PLSParser::Load(QIODevice* device, const QString& playlist_path,
     }
   }
 
+  const QList<int> numbers = locations.keys();
+  const SongList loaded = LoadSongs(locations.values(), dir);
+  for (int i = 0; i < numbers.count(); ++i) {
+    const int n = numbers[i];
+    Song song = loaded[i];
+
+    // Use the title and length we've already loaded if any
+    if (!songs[n].title().isEmpty()) song.set_title(songs[n].title());
+    if (songs[n].length_nanosec() != -1)
+      song.set_length_nanosec(songs[n].length_nanosec());
+
+    songs[n] = song;
+  }
+
   return songs.values();
 }
 
-void PLSParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
-                     Playlist::Path path_type) const {
+bool PLSParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
+                     Playlist::Path path_type,
+                     const SaveMonitor& monitor) const {
   QTextStream s(device);
   s << "[playlist]" << endl;
   s << "Version=2" << endl;
@@ -74,8 +83,10 @@ void PLSParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
       << endl;
     s << "Title" << n << "=" << song.title() << endl;
     s << "Length" << n << "=" << song.length_nanosec() / kNsecPerSec << endl;
+    if (!ContinueSave(monitor, n)) return false;
     ++n;
   }
+  return true;
 }
 
 bool PLSParser::TryMagic(const QByteArray& data) const {
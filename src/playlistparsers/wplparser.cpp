@@ -38,14 +38,21 @@ SongList WplParser::Load(QIODevice* device, const QString& playlist_path,
     return ret;
   }
 
+  QStringList sources;
   while (!reader.atEnd() && Utilities::ParseUntilElement(&reader, "seq")) {
-    ParseSeq(dir, &reader, &ret);
+    ParseSeq(&reader, &sources);
+  }
+
+  for (const Song& song : LoadSongs(sources, dir)) {
+    if (song.is_valid()) {
+      ret << song;
+    }
   }
   return ret;
 }
 
-void WplParser::ParseSeq(const QDir& dir, QXmlStreamReader* reader,
-                         SongList* songs) const {
+void WplParser::ParseSeq(QXmlStreamReader* reader,
+                         QStringList* sources) const {
   while (!reader->atEnd()) {
     QXmlStreamReader::TokenType type = reader->readNext();
     switch (type) {
@@ -54,10 +61,7 @@ void WplParser::ParseSeq(const QDir& dir, QXmlStreamReader* reader,
         if (name == "media") {
           QStringRef src = reader->attributes().value("src");
           if (!src.isEmpty()) {
-            Song song = LoadSong(src.toString(), 0, dir);
-            if (song.is_valid()) {
-              songs->append(song);
-            }
+            sources->append(src.toString());
           }
         } else {
           Utilities::ConsumeCurrentElement(reader);
@@ -76,8 +80,9 @@ void WplParser::ParseSeq(const QDir& dir, QXmlStreamReader* reader,
   }
 }
 
-void WplParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
-                     Playlist::Path path_type) const {
+bool WplParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
+                     Playlist::Path path_type,
+                     const SaveMonitor& monitor) const {
   QXmlStreamWriter writer(device);
   writer.setAutoFormatting(true);
   writer.setAutoFormattingIndent(2);
@@ -96,13 +101,16 @@ void WplParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
     StreamElement body("body", &writer);
     {
       StreamElement seq("seq", &writer);
+      int n = 0;
       for (const Song& song : songs) {
+        if (!ContinueSave(monitor, n++)) return false;
         writer.writeStartElement("media");
         writer.writeAttribute("src", URLOrFilename(song.url(), dir, path_type));
         writer.writeEndElement();
       }
     }
   }
+  return true;
 }
 
 void WplParser::WriteMeta(const QString& name, const QString& content,
@@ -32,12 +32,12 @@ class WplParser : public XMLParser {
 
   SongList Load(QIODevice* device, const QString& playlist_path,
                 const QDir& dir) const;
-  void Save(const SongList& songs, QIODevice* device, const QDir& dir,
-            Playlist::Path path_type = Playlist::Path_Automatic) const;
+  bool Save(const SongList& songs, QIODevice* device, const QDir& dir,
+            Playlist::Path path_type = Playlist::Path_Automatic,
+            const SaveMonitor& monitor = SaveMonitor()) const;
 
  private:
-  void ParseSeq(const QDir& dir, QXmlStreamReader* reader,
-                SongList* songs) const;
+  void ParseSeq(QXmlStreamReader* reader, QStringList* sources) const;
   void WriteMeta(const QString& name, const QString& content,
                  QXmlStreamWriter* writer) const;
 };
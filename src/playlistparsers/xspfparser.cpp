@@ -34,24 +34,66 @@ XSPFParser::XSPFParser(LibraryBackendInterface* library, QObject* parent)
 SongList XSPFParser::Load(QIODevice* device, const QString& playlist_path,
                           const QDir& dir) const {
   SongList ret;
+  LoadChunked(device, playlist_path, dir,
+              [&ret](const SongList& songs) -> bool {
+                ret << songs;
+                return true;
+              });
+  return ret;
+}
 
+bool XSPFParser::LoadChunked(QIODevice* device, const QString& playlist_path,
+                             const QDir& dir, const SongSink& sink) const {
   QXmlStreamReader reader(device);
   if (!Utilities::ParseUntilElement(&reader, "playlist") ||
       !Utilities::ParseUntilElement(&reader, "trackList")) {
-    return ret;
+    return true;
   }
 
+  // The reader pulls from the device as it goes, so each chunk is handed over
+  // before the rest of the file is parsed.
+  QStringList locations;
+  SongList tracks;
   while (!reader.atEnd() && Utilities::ParseUntilElement(&reader, "track")) {
-    Song song = ParseTrack(&reader, dir);
-    if (song.is_valid()) {
-      ret << song;
+    QString location;
+    tracks << ParseTrack(&reader, &location);
+    locations << location;
+
+    if (locations.count() == kChunkSize) {
+      if (!sink(LoadTracks(locations, tracks, dir))) return false;
+      locations.clear();
+      tracks.clear();
+    }
+  }
+
+  return locations.isEmpty() || sink(LoadTracks(locations, tracks, dir));
+}
+
+SongList XSPFParser::LoadTracks(const QStringList& locations,
+                                const SongList& tracks,
+                                const QDir& dir) const {
+  SongList ret;
+  SongList songs = LoadSongs(locations, dir);
+  for (int i = 0; i < songs.count(); ++i) {
+    Song* song = &songs[i];
+
+    // Override metadata with what was in the playlist
+    song->set_title(tracks[i].title());
+    song->set_artist(tracks[i].artist());
+    song->set_album(tracks[i].album());
+    song->set_length_nanosec(tracks[i].length_nanosec());
+    song->set_track(tracks[i].track());
+
+    if (song->is_valid()) {
+      ret << *song;
     }
   }
   return ret;
 }
 
-Song XSPFParser::ParseTrack(QXmlStreamReader* reader, const QDir& dir) const {
-  QString title, artist, album, location;
+Song XSPFParser::ParseTrack(QXmlStreamReader* reader,
+                            QString* location) const {
+  QString title, artist, album;
   qint64 nanosec = -1;
   int track_num = -1;
 
@@ -61,7 +103,7 @@ Song XSPFParser::ParseTrack(QXmlStreamReader* reader, const QDir& dir) const {
       case QXmlStreamReader::StartElement: {
         QStringRef name = reader->name();
         if (name == "location") {
-          location = reader->readElementText();
+          *location = reader->readElementText();
         } else if (name == "title") {
           title = reader->readElementText();
         } else if (name == "creator") {
@@ -100,9 +142,7 @@ Song XSPFParser::ParseTrack(QXmlStreamReader* reader, const QDir& dir) const {
   }
 
 return_song:
-  Song song = LoadSong(location, 0, dir);
-
-  // Override metadata with what was in the playlist
+  Song song;
   song.set_title(title);
   song.set_artist(artist);
   song.set_album(album);
@@ -111,8 +151,9 @@ return_song:
   return song;
 }
 
-void XSPFParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
-                      Playlist::Path path_type) const {
+bool XSPFParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
+                      Playlist::Path path_type,
+                      const SaveMonitor& monitor) const {
   QFileInfo file;
   QXmlStreamWriter writer(device);
   writer.setAutoFormatting(true);
@@ -128,7 +169,9 @@ void XSPFParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
   s.endGroup();
 
   StreamElement tracklist("trackList", &writer);
+  int n = 0;
   for (const Song& song : songs) {
+    if (!ContinueSave(monitor, n++)) return false;
     QString filename_or_url = URLOrFilename(song.url(), dir, path_type);
 
     StreamElement track("track", &writer);
@@ -177,6 +220,7 @@ void XSPFParser::Save(const SongList& songs, QIODevice* device, const QDir& dir,
     }
   }
   writer.writeEndDocument();
+  return true;
 }
 
 bool XSPFParser::TryMagic(const QByteArray& data) const {
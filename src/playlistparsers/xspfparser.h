@@ -38,11 +38,20 @@ class XSPFParser : public XMLParser {
 
   SongList Load(QIODevice* device, const QString& playlist_path = "",
                 const QDir& dir = QDir()) const;
-  void Save(const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
-            Playlist::Path path_type = Playlist::Path_Automatic) const;
+  bool LoadChunked(QIODevice* device, const QString& playlist_path,
+                   const QDir& dir, const SongSink& sink) const;
+  bool Save(const SongList& songs, QIODevice* device, const QDir& dir = QDir(),
+            Playlist::Path path_type = Playlist::Path_Automatic,
+            const SaveMonitor& monitor = SaveMonitor()) const;
 
  private:
-  Song ParseTrack(QXmlStreamReader* reader, const QDir& dir) const;
+  // Returns the metadata in the playlist, and sets the track's location.
+  Song ParseTrack(QXmlStreamReader* reader, QString* location) const;
+
+  // Loads the songs at the locations and overrides their metadata with what
+  // was in the playlist.  Invalid songs are left out.
+  SongList LoadTracks(const QStringList& locations, const SongList& tracks,
+                      const QDir& dir) const;
 };
 
 #endif
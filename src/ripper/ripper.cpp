@@ -44,14 +44,17 @@ Ripper::Ripper(QObject* parent)
       cancel_requested_(false),
       finished_success_(0),
       finished_failed_(0),
+      ripping_complete_(false),
+      tracks_ripped_(0),
       files_tagged_(0) {
   cdio_ = cdio_open(NULL, DRIVER_UNKNOWN);
 
-  connect(this, SIGNAL(RippingComplete()), transcoder_, SLOT(Start()));
+  // Rip() runs in another thread, so these are queued.
+  connect(this, SIGNAL(TrackRipped(int, QString)),
+          SLOT(TranscodeTrack(int, QString)));
+  connect(this, SIGNAL(RippingComplete()), SLOT(AllTracksRipped()));
   connect(transcoder_, SIGNAL(JobComplete(QString, QString, bool)),
           SLOT(TranscodingJobComplete(QString, QString, bool)));
-  connect(transcoder_, SIGNAL(AllJobsComplete()),
-          SLOT(AllTranscodingJobsComplete()));
   connect(transcoder_, SIGNAL(LogLine(QString)), SLOT(LogLine(QString)));
 }
 
@@ -128,6 +131,12 @@ void Ripper::Start() {
     QMutexLocker l(&mutex_);
     cancel_requested_ = false;
   }
+  temporary_directory_ = Utilities::MakeTempDir() + "/";
+  finished_success_ = 0;
+  finished_failed_ = 0;
+  ripping_complete_ = false;
+  tracks_ripped_ = 0;
+  files_tagged_ = 0;
   SetupProgressInterval();
 
   qLog(Debug) << "Ripping" << AddedTracks() << "tracks.";
@@ -144,6 +153,18 @@ void Ripper::Cancel() {
   emit(Cancelled());
 }
 
+void Ripper::TranscodeTrack(int index, const QString& temporary_filename) {
+  tracks_ripped_++;
+
+  TrackInformation& track = tracks_[index];
+  track.temporary_filename = temporary_filename;
+  transcoder_->AddJob(track.temporary_filename, track.preset,
+                      track.transcoded_filename);
+  transcoder_->Start();
+}
+
+void Ripper::AllTracksRipped() { ripping_complete_ = true; }
+
 void Ripper::TranscodingJobComplete(const QString& input, const QString& output,
                                     bool success) {
   if (success)
@@ -152,23 +173,22 @@ void Ripper::TranscodingJobComplete(const QString& input, const QString& output,
     finished_failed_++;
   UpdateProgress();
 
+  // The wav file isn't needed any more.
+  QFile::remove(input);
+
   // The the transcoder does not overwrite files. Instead, it changes
   // the name of the output file. We need to update the transcoded
   // filename for the corresponding track so that we tag the correct
-  // file later on.
+  // file.
   for (QList<TrackInformation>::iterator it = tracks_.begin();
        it != tracks_.end(); ++it) {
     if (it->temporary_filename == input) {
       it->transcoded_filename = output;
+      TagFile(*it);
     }
   }
 }
 
-void Ripper::AllTranscodingJobsComplete() {
-  RemoveTemporaryDirectory();
-  TagFiles();
-}
-
 void Ripper::LogLine(const QString& message) { qLog(Debug) << message; }
 
 /*
@@ -219,22 +239,18 @@ void Ripper::WriteWAVHeader(QFile* stream, int32_t i_bytecount) {
 }
 
 void Ripper::Rip() {
-  temporary_directory_ = Utilities::MakeTempDir() + "/";
-  finished_success_ = 0;
-  finished_failed_ = 0;
-
   // Set up progress bar
   UpdateProgress();
 
-  for (QList<TrackInformation>::iterator it = tracks_.begin();
-       it != tracks_.end(); ++it) {
+  for (int i = 0; i < tracks_.count(); ++i) {
+    const int track_number = tracks_.at(i).track_number;
     QString filename =
-        QString("%1%2.wav").arg(temporary_directory_).arg(it->track_number);
+        QString("%1%2.wav").arg(temporary_directory_).arg(track_number);
     QFile destination_file(filename);
     destination_file.open(QIODevice::WriteOnly);
 
-    lsn_t i_first_lsn = cdio_get_track_lsn(cdio_, it->track_number);
-    lsn_t i_last_lsn = cdio_get_track_last_lsn(cdio_, it->track_number);
+    lsn_t i_first_lsn = cdio_get_track_lsn(cdio_, track_number);
+    lsn_t i_last_lsn = cdio_get_track_last_lsn(cdio_, track_number);
     WriteWAVHeader(&destination_file,
                    (i_last_lsn - i_first_lsn + 1) * CDIO_CD_FRAMESIZE_RAW);
 
@@ -256,12 +272,12 @@ void Ripper::Rip() {
         break;
       }
     }
+    destination_file.close();
     finished_success_++;
     UpdateProgress();
 
-    it->temporary_filename = filename;
-    transcoder_->AddJob(it->temporary_filename, it->preset,
-                        it->transcoded_filename);
+    // Start encoding this track while the next one is read.
+    emit(TrackRipped(i, filename));
   }
   emit(RippingComplete());
 }
@@ -290,33 +306,31 @@ void Ripper::RemoveTemporaryDirectory() {
   temporary_directory_.clear();
 }
 
-void Ripper::TagFiles() {
-  files_tagged_ = 0;
-  for (const TrackInformation& track : tracks_) {
-    Song song;
-    song.InitFromFilePartial(track.transcoded_filename);
-    song.set_track(track.track_number);
-    song.set_title(track.title);
-    song.set_album(album_.album);
-    song.set_artist(album_.artist);
-    song.set_genre(album_.genre);
-    song.set_year(album_.year);
-    song.set_disc(album_.disc);
-    song.set_filetype(album_.type);
-
-    TagReaderReply* reply =
-        TagReaderClient::Instance()->SaveFile(song.url().toLocalFile(), song);
-    NewClosure(reply, SIGNAL(Finished(bool)), this,
-               SLOT(FileTagged(TagReaderReply*)), reply);
-  }
+void Ripper::TagFile(const TrackInformation& track) {
+  Song song;
+  song.InitFromFilePartial(track.transcoded_filename);
+  song.set_track(track.track_number);
+  song.set_title(track.title);
+  song.set_album(album_.album);
+  song.set_artist(album_.artist);
+  song.set_genre(album_.genre);
+  song.set_year(album_.year);
+  song.set_disc(album_.disc);
+  song.set_filetype(album_.type);
+
+  TagReaderReply* reply =
+      TagReaderClient::Instance()->SaveFile(song.url().toLocalFile(), song);
+  NewClosure(reply, SIGNAL(Finished(bool)), this,
+             SLOT(FileTagged(TagReaderReply*)), reply);
 }
 
 void Ripper::FileTagged(TagReaderReply* reply) {
   files_tagged_++;
   qLog(Debug) << "Tagged" << files_tagged_ << "of" << tracks_.length()
               << "files";
-  if (files_tagged_ == tracks_.length()) {
+  if (ripping_complete_ && files_tagged_ == tracks_ripped_) {
     qLog(Debug) << "CD ripper finished.";
+    RemoveTemporaryDirectory();
     emit(Finished());
   }
 
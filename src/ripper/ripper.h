@@ -29,7 +29,9 @@
 class QFile;
 
 // Rips selected tracks from an audio CD, transcodes them to a chosen
-// format, and finally tags the files with the supplied metadata.
+// format, and finally tags the files with the supplied metadata.  Each track
+// is handed to the transcoder as soon as it has been read, so the drive reads
+// the next track while the previous ones are being encoded and tagged.
 //
 // Usage: Add tracks with AddTrack() and album metadata with
 // SetAlbumInformation(). Then start the ripper with Start(). The ripper
@@ -71,6 +73,8 @@ signals:
   void Cancelled();
   void ProgressInterval(int min, int max);
   void Progress(int progress);
+  // Emitted from the ripping thread.
+  void TrackRipped(int index, const QString& temporary_filename);
   void RippingComplete();
 
  public slots:
@@ -78,9 +82,10 @@ signals:
   void Cancel();
 
  private slots:
+  void TranscodeTrack(int index, const QString& temporary_filename);
+  void AllTracksRipped();
   void TranscodingJobComplete(const QString& input, const QString& output,
                               bool success);
-  void AllTranscodingJobsComplete();
   void LogLine(const QString& message);
   void FileTagged(TagReaderReply* reply);
 
@@ -117,7 +122,7 @@ signals:
   void SetupProgressInterval();
   void UpdateProgress();
   void RemoveTemporaryDirectory();
-  void TagFiles();
+  void TagFile(const TrackInformation& track);
 
   CdIo_t* cdio_;
   Transcoder* transcoder_;
@@ -126,6 +131,9 @@ signals:
   QMutex mutex_;
   int finished_success_;
   int finished_failed_;
+  // Only touched in the main thread.
+  bool ripping_complete_;
+  int tracks_ripped_;
   int files_tagged_;
   QList<TrackInformation> tracks_;
   AlbumInformation album_;
@@ -17,6 +17,7 @@
 
 #include "generator.h"
 #include "querygenerator.h"
+#include "similargenerator.h"
 #include "core/logging.h"
 #include "internet/jamendo/jamendodynamicplaylist.h"
 #include "internet/subsonic/subsonicdynamicplaylist.h"
@@ -34,6 +35,8 @@ Generator::Generator() : QObject(nullptr), backend_(nullptr) {}
 GeneratorPtr Generator::Create(const QString& type) {
   if (type == "Query")
     return GeneratorPtr(new QueryGenerator);
+  else if (type == "Similar")
+    return GeneratorPtr(new SimilarGenerator);
   else if (type == "Jamendo")
     return GeneratorPtr(new JamendoDynamicPlaylist);
   else if (type == "Subsonic") {
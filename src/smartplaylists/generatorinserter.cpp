@@ -17,10 +17,9 @@
 
 #include "smartplaylists/generatorinserter.h"
 
-#include <QtConcurrentRun>
-
 #include "core/closure.h"
 #include "core/taskmanager.h"
+#include "core/threadpools.h"
 #include "playlist/playlist.h"
 #include "smartplaylists/generator.h"
 
@@ -57,7 +56,9 @@ void GeneratorInserter::Load(Playlist* destination, int row, bool play_now,
   connect(generator.get(), SIGNAL(Error(QString)), SIGNAL(Error(QString)));
 
   QFuture<PlaylistItemList> future =
-      QtConcurrent::run(Generate, generator, dynamic_count);
+      ThreadPools::Run<PlaylistItemList>(
+          ThreadPools::Pool_Interactive,
+          std::bind(&Generate, generator, dynamic_count));
   NewClosure(future, this, SLOT(Finished(QFuture<PlaylistItemList>)), future);
 }
 
@@ -18,28 +18,47 @@
 #include "querygenerator.h"
 #include "library/librarybackend.h"
 
+#include <QMap>
 #include <QtDebug>
 
+#include "core/logging.h"
+
 namespace smart_playlists {
 
-QueryGenerator::QueryGenerator() : dynamic_(false), current_pos_(0) {}
+const int QueryGenerator::kMaxSampleAgeMsec = 10 * 60 * 1000;  // 10 minutes
+
+QueryGenerator::QueryGenerator()
+    : dynamic_(false),
+      materialized_(false),
+      current_pos_(0),
+      sampler_loaded_(false) {}
 
 QueryGenerator::QueryGenerator(const QString& name, const Search& search,
                                bool dynamic)
-    : search_(search), dynamic_(dynamic), current_pos_(0) {
+    : search_(search),
+      dynamic_(dynamic),
+      materialized_(false),
+      current_pos_(0),
+      sampler_loaded_(false) {
   set_name(name);
 }
 
 void QueryGenerator::Load(const Search& search) {
   search_ = search;
   dynamic_ = false;
+  materialized_ = false;
   current_pos_ = 0;
+  sampler_loaded_ = false;
 }
 
 void QueryGenerator::Load(const QByteArray& data) {
   QDataStream s(data);
   s >> search_;
   s >> dynamic_;
+  // Older versions didn't save this.
+  materialized_ = false;
+  if (!s.atEnd()) s >> materialized_;
+  sampler_loaded_ = false;
 }
 
 QByteArray QueryGenerator::Save() const {
@@ -47,6 +66,7 @@ QByteArray QueryGenerator::Save() const {
   QDataStream s(&ret, QIODevice::WriteOnly);
   s << search_;
   s << dynamic_;
+  s << materialized_;
 
   return ret;
 }
@@ -54,10 +74,17 @@ QByteArray QueryGenerator::Save() const {
 PlaylistItemList QueryGenerator::Generate() {
   previous_ids_.clear();
   current_pos_ = 0;
+  sampler_ = RandomSampler();
+  sampler_loaded_ = false;
   return GenerateMore(0);
 }
 
 PlaylistItemList QueryGenerator::GenerateMore(int count) {
+  const int limit = count ? count : search_.limit_;
+  if (search_.sort_type_ == Search::Sort_Random && limit > 0) {
+    return GenerateRandom(limit);
+  }
+
   Search search_copy = search_;
   search_copy.id_not_in_ = previous_ids_;
   if (count) {
@@ -69,7 +96,14 @@ PlaylistItemList QueryGenerator::GenerateMore(int count) {
     current_pos_ += search_copy.limit_;
   }
 
-  SongList songs = backend_->FindSongs(search_copy);
+  // The first page of a materialized search comes straight from the table of
+  // results the library keeps up to date.
+  const bool materialized = materialized_ && count == 0 &&
+                            search_copy.first_item_ == 0 &&
+                            search_copy.id_not_in_.isEmpty();
+  SongList songs = materialized ? backend_->FindSongsMaterialized(search_copy)
+                                : backend_->FindSongs(search_copy,
+                                                      cancel_flag_);
   PlaylistItemList items;
   for (const Song& song : songs) {
     items << PlaylistItemPtr(PlaylistItem::NewFromSongsTable(
@@ -82,4 +116,38 @@ PlaylistItemList QueryGenerator::GenerateMore(int count) {
   return items;
 }
 
+PlaylistItemList QueryGenerator::GenerateRandom(int count) {
+  if (!sampler_loaded_ || sampler_age_.elapsed() > kMaxSampleAgeMsec) {
+    sampler_.SetIds(backend_->FindSongIds(search_, cancel_flag_));
+    sampler_loaded_ = true;
+    sampler_age_.start();
+    qLog(Debug) << "Sampling from" << sampler_.id_count() << "songs";
+  }
+  sampler_.set_history_size(GetDynamicFuture() + GetDynamicHistory());
+
+  const QList<int> ids = sampler_.Take(count);
+  if (ids.isEmpty()) return PlaylistItemList();
+
+  // The songs come back in ROWID order, so put them back in the order they
+  // were picked.
+  QMap<int, Song> songs_by_id;
+  for (const Song& song : backend_->GetSongsById(ids)) {
+    songs_by_id[song.id()] = song;
+  }
+
+  PlaylistItemList items;
+  for (int id : ids) {
+    if (!songs_by_id.contains(id)) {
+      // The song has gone from the library since we loaded the IDs.
+      sampler_loaded_ = false;
+      continue;
+    }
+
+    items << PlaylistItemPtr(PlaylistItem::NewFromSongsTable(
+                 backend_->songs_table(), songs_by_id[id]));
+    sampler_.MarkUsed(id);
+  }
+  return items;
+}
+
 }  // namespace
@@ -18,8 +18,12 @@
 #ifndef QUERYPLAYLISTGENERATOR_H
 #define QUERYPLAYLISTGENERATOR_H
 
+#include <QElapsedTimer>
+
 #include "generator.h"
+#include "randomsampler.h"
 #include "search.h"
+#include "library/sqlitequery.h"
 
 namespace smart_playlists {
 
@@ -39,16 +43,37 @@ class QueryGenerator : public Generator {
   PlaylistItemList GenerateMore(int count);
   bool is_dynamic() const { return dynamic_; }
   void set_dynamic(bool dynamic) { dynamic_ = dynamic; }
+  // Materialized searches keep their results in the library database, where
+  // they are updated as the library changes.
+  bool is_materialized() const { return materialized_; }
+  void set_materialized(bool materialized) { materialized_ = materialized; }
+
+  // Lets another thread stop the library query that Generate is waiting for.
+  // Whatever it found so far is returned.
+  void set_cancel_flag(const QueryCancelFlag& flag) { cancel_flag_ = flag; }
 
   Search search() const { return search_; }
   int GetDynamicFuture() { return search_.limit_; }
 
  private:
+  // Random searches with a limit pick IDs from a RandomSampler instead of
+  // asking SQLite to sort the whole table every time.
+  PlaylistItemList GenerateRandom(int count);
+
+  static const int kMaxSampleAgeMsec;
+
   Search search_;
   bool dynamic_;
+  bool materialized_;
+  QueryCancelFlag cancel_flag_;
 
   QList<int> previous_ids_;
   int current_pos_;
+
+  RandomSampler sampler_;
+  bool sampler_loaded_;
+  // The IDs are loaded again after a while so new songs get a chance.
+  QElapsedTimer sampler_age_;
 };
 
 }  // namespace
@@ -151,6 +151,11 @@ int QueryWizardPlugin::CreatePages(QWizard* wizard, int finish_page_id) {
           SLOT(UpdateSortPreview()));
   connect(sort_ui_->random, SIGNAL(toggled(bool)), SLOT(UpdateSortPreview()));
 
+  // Random playlists are different every time so they can't be kept
+  connect(sort_ui_->random, SIGNAL(toggled(bool)), sort_ui_->materialized,
+          SLOT(setDisabled(bool)));
+  sort_ui_->materialized->setDisabled(sort_ui_->random->isChecked());
+
   // Configure the page text
   search_page_->setTitle(tr("Search terms"));
   search_page_->setSubTitle(
@@ -201,11 +206,15 @@ void QueryWizardPlugin::SetGenerator(GeneratorPtr g) {
     sort_ui_->limit_limit->setChecked(true);
     sort_ui_->limit_value->setValue(search.limit_);
   }
+
+  sort_ui_->materialized->setChecked(gen->is_materialized());
 }
 
 GeneratorPtr QueryWizardPlugin::CreateGenerator() const {
   std::shared_ptr<QueryGenerator> gen(new QueryGenerator);
   gen->Load(MakeSearch());
+  gen->set_materialized(sort_ui_->materialized->isEnabled() &&
+                        sort_ui_->materialized->isChecked());
 
   return std::static_pointer_cast<Generator>(gen);
 }
@@ -0,0 +1,83 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "randomsampler.h"
+
+#include <utility>
+
+#include <QDateTime>
+
+namespace smart_playlists {
+
+RandomSampler::RandomSampler()
+    : pos_(0),
+      history_size_(0),
+      random_(QDateTime::currentMSecsSinceEpoch()) {}
+
+void RandomSampler::SetIds(const QVector<int>& ids) {
+  ids_ = ids;
+  pos_ = 0;
+}
+
+void RandomSampler::set_history_size(int size) {
+  history_size_ = size;
+  while (history_.count() > history_size_) {
+    recent_.clearBit(history_.dequeue());
+  }
+}
+
+QList<int> RandomSampler::Take(int count) {
+  QList<int> ret;
+
+  // Don't go round more than once looking for IDs that weren't used recently.
+  int attempts = ids_.count();
+  while (ret.count() < count && attempts-- > 0) {
+    if (pos_ >= ids_.count()) pos_ = 0;
+
+    std::swap(ids_[pos_], ids_[RandomIndex(pos_, ids_.count())]);
+    const int id = ids_[pos_++];
+
+    if (WasUsedRecently(id) || ret.contains(id)) continue;
+    ret << id;
+  }
+
+  return ret;
+}
+
+void RandomSampler::MarkUsed(int id) {
+  if (id < 0 || history_size_ <= 0) return;
+  if (WasUsedRecently(id)) return;
+
+  if (id >= recent_.size()) recent_.resize(qMax(id + 1, recent_.size() * 2));
+  recent_.setBit(id);
+  history_.enqueue(id);
+
+  while (history_.count() > history_size_) {
+    recent_.clearBit(history_.dequeue());
+  }
+}
+
+bool RandomSampler::WasUsedRecently(int id) const {
+  return id >= 0 && id < recent_.size() && recent_.testBit(id);
+}
+
+int RandomSampler::RandomIndex(int begin, int end) {
+  std::uniform_int_distribution<int> distribution(begin, end - 1);
+  return distribution(random_);
+}
+
+}  // namespace smart_playlists
@@ -0,0 +1,73 @@
+/* This file is part of Clementine.
+   Copyright 2012, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SMARTPLAYLISTS_RANDOMSAMPLER_H_
+#define SMARTPLAYLISTS_RANDOMSAMPLER_H_
+
+#include <random>
+
+#include <QBitArray>
+#include <QList>
+#include <QQueue>
+#include <QVector>
+
+namespace smart_playlists {
+
+class RandomSampler {
+  // Picks random song IDs out of a fixed set without going back to the
+  // database.  The set is shuffled lazily with Fisher-Yates, so every ID comes
+  // up once before any of them comes up again, and drawing n IDs costs O(n).
+  // IDs that were used recently are skipped, so a new pass through the set
+  // doesn't repeat the songs at the end of the last one.
+
+ public:
+  RandomSampler();
+
+  // Replaces the set of IDs to pick from.  The recently used IDs are kept.
+  void SetIds(const QVector<int>& ids);
+  int id_count() const { return ids_.count(); }
+
+  // How many of the last used IDs are skipped.
+  void set_history_size(int size);
+
+  // Returns up to count IDs that haven't been used recently.  Fewer are
+  // returned if there aren't enough of them.
+  QList<int> Take(int count);
+
+  // Remembers that this ID has been used.
+  void MarkUsed(int id);
+  bool WasUsedRecently(int id) const;
+
+ private:
+  int RandomIndex(int begin, int end);
+
+ private:
+  QVector<int> ids_;
+  // IDs before this position have been taken in the current pass.
+  int pos_;
+
+  int history_size_;
+  QQueue<int> history_;
+  // Indexed by ID, set for the IDs in history_.
+  QBitArray recent_;
+
+  std::mt19937 random_;
+};
+
+}  // namespace smart_playlists
+
+#endif  // SMARTPLAYLISTS_RANDOMSAMPLER_H_
@@ -44,8 +44,75 @@ void Search::Reset() {
 }
 
 QString Search::ToSql(const QString& songs_table) const {
-  QString sql = "SELECT ROWID," + Song::kColumnSpec + " FROM " + songs_table;
+  QString sql = "SELECT ROWID," + Song::kColumnSpec + " FROM " + songs_table +
+                WhereSql(true) + OrderAndLimitSql();
+  qLog(Debug) << sql;
+
+  return sql;
+}
+
+QString Search::ToIdSql(const QString& songs_table,
+                        const QString& extra_where) const {
+  QString sql = "SELECT ROWID FROM " + songs_table + WhereSql(false);
+  if (!extra_where.isEmpty()) sql += " AND (" + extra_where + ")";
+  qLog(Debug) << sql;
+
+  return sql;
+}
+
+QString Search::ToCountSql(const QString& songs_table) const {
+  QString sql = "SELECT count(*) FROM " + songs_table + WhereSql(false);
+  qLog(Debug) << sql;
+
+  return sql;
+}
+
+QString Search::ToSortedSql(const QString& columns, const QString& songs_table,
+                            const QString& extra_where) const {
+  QString sql = "SELECT " + columns + " FROM " + songs_table + WhereSql(false);
+  if (!extra_where.isEmpty()) sql += " AND (" + extra_where + ")";
+  sql += OrderAndLimitSql();
+  qLog(Debug) << sql;
 
+  return sql;
+}
+
+bool Search::can_materialize() const {
+  if (sort_type_ == Sort_Random) return false;
+
+  // Results of searches relative to the current time change on their own.
+  for (const SearchTerm& term : terms_) {
+    if (term.operator_ == SearchTerm::Op_NumericDate ||
+        term.operator_ == SearchTerm::Op_NumericDateNot ||
+        term.operator_ == SearchTerm::Op_RelativeDate) {
+      return false;
+    }
+  }
+  return true;
+}
+
+QString Search::OrderAndLimitSql() const {
+  QString sql;
+
+  // Add sort by
+  if (sort_type_ == Sort_Random) {
+    sql += " ORDER BY random()";
+  } else {
+    sql += " ORDER BY " + SearchTerm::FieldColumnName(sort_field_) +
+           (sort_type_ == Sort_FieldAsc ? " ASC" : " DESC");
+  }
+
+  // Add limit
+  if (first_item_) {
+    sql += QString(" LIMIT %1 OFFSET %2").arg(limit_).arg(first_item_);
+  } else if (limit_ != -1) {
+    sql += " LIMIT " + QString::number(limit_);
+  }
+
+  return sql;
+}
+
+QString Search::WhereSql(bool restrict_ids) const {
   // Add search terms
   QStringList where_clauses;
   QStringList term_where_clauses;
@@ -59,7 +126,7 @@ QString Search::ToSql(const QString& songs_table) const {
   }
 
   // Restrict the IDs of songs if we're making a dynamic playlist
-  if (!id_not_in_.isEmpty()) {
+  if (restrict_ids && !id_not_in_.isEmpty()) {
     QString numbers;
     for (int id : id_not_in_) {
       numbers += (numbers.isEmpty() ? "" : ",") + QString::number(id);
@@ -72,27 +139,7 @@ QString Search::ToSql(const QString& songs_table) const {
   // unmounted.
   where_clauses << "unavailable = 0";
 
-  if (!where_clauses.isEmpty()) {
-    sql += " WHERE " + where_clauses.join(" AND ");
-  }
-
-  // Add sort by
-  if (sort_type_ == Sort_Random) {
-    sql += " ORDER BY random()";
-  } else {
-    sql += " ORDER BY " + SearchTerm::FieldColumnName(sort_field_) +
-           (sort_type_ == Sort_FieldAsc ? " ASC" : " DESC");
-  }
-
-  // Add limit
-  if (first_item_) {
-    sql += QString(" LIMIT %1 OFFSET %2").arg(limit_).arg(first_item_);
-  } else if (limit_ != -1) {
-    sql += " LIMIT " + QString::number(limit_);
-  }
-  qLog(Debug) << sql;
-
-  return sql;
+  return " WHERE " + where_clauses.join(" AND ");
 }
 
 bool Search::is_valid() const {
@@ -53,6 +53,28 @@ class Search {
 
   void Reset();
   QString ToSql(const QString& songs_table) const;
+
+  // Returns a query for the ROWIDs of all the songs that match, ignoring the
+  // sort order, the limit and id_not_in_.  extra_where is an SQL condition
+  // the songs have to match as well.
+  QString ToIdSql(const QString& songs_table,
+                  const QString& extra_where = QString()) const;
+
+  // Returns a query for the number of songs that match, ignoring the limit.
+  QString ToCountSql(const QString& songs_table) const;
+
+  // Like ToSql, but selects the given columns, ignores id_not_in_ and adds
+  // extra_where.
+  QString ToSortedSql(const QString& columns, const QString& songs_table,
+                      const QString& extra_where = QString()) const;
+
+  // Whether the results only change when songs in the library change, so
+  // they can be kept in the database and updated incrementally.
+  bool can_materialize() const;
+
+ private:
+  QString WhereSql(bool restrict_ids) const;
+  QString OrderAndLimitSql() const;
 };
 
 }  // namespace
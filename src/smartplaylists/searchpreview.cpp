@@ -18,17 +18,25 @@
 #include "searchpreview.h"
 #include "ui_searchpreview.h"
 
-#include <memory>
+#include <QFutureWatcher>
+#include <QTimer>
 
-#include <QtConcurrentRun>
-
-#include "querygenerator.h"
+#include "core/closure.h"
+#include "core/threadpools.h"
+#include "library/librarybackend.h"
 #include "playlist/playlist.h"
+#include "playlist/playlistitem.h"
 
 namespace smart_playlists {
 
+const int SearchPreview::kUpdateDelayMsec = 300;
+
 SearchPreview::SearchPreview(QWidget* parent)
-    : QWidget(parent), ui_(new Ui_SmartPlaylistSearchPreview), model_(nullptr) {
+    : QWidget(parent),
+      ui_(new Ui_SmartPlaylistSearchPreview),
+      model_(nullptr),
+      update_timer_(new QTimer(this)),
+      search_pending_(false) {
   ui_->setupUi(this);
 
   // Prevent editing songs and saving settings (like header columns and
@@ -40,9 +48,16 @@ SearchPreview::SearchPreview(QWidget* parent)
   bold_font.setBold(true);
   ui_->preview_label->setFont(bold_font);
   ui_->busy_container->hide();
+
+  update_timer_->setInterval(kUpdateDelayMsec);
+  update_timer_->setSingleShot(true);
+  connect(update_timer_, SIGNAL(timeout()), SLOT(StartPendingSearch()));
 }
 
-SearchPreview::~SearchPreview() { delete ui_; }
+SearchPreview::~SearchPreview() {
+  if (cancel_) cancel_->fetchAndStoreRelaxed(1);
+  delete ui_;
+}
 
 void SearchPreview::set_application(Application* app) {
   ui_->tree->SetApplication(app);
@@ -58,73 +73,105 @@ void SearchPreview::set_library(LibraryBackend* backend) {
 }
 
 void SearchPreview::Update(const Search& search) {
-  if (search == last_search_) {
-    // This search was the same as the last one we did
+  pending_search_ = search;
+  search_pending_ = true;
+  update_timer_->start();
+}
+
+void SearchPreview::showEvent(QShowEvent* e) {
+  // There might have been a search waiting while we were hidden
+  StartPendingSearch();
+
+  QWidget::showEvent(e);
+}
+
+void SearchPreview::StartPendingSearch() {
+  if (!search_pending_ || isHidden()) return;
+
+  if (cancel_) {
+    // Nobody's going to look at the results of the running one now.
+    // SearchFinished comes back here when it's stopped.
+    cancel_->fetchAndStoreRelaxed(1);
     return;
   }
 
-  if (generator_ || isHidden()) {
-    // It's busy generating something already, or the widget isn't visible
-    pending_search_ = search;
+  search_pending_ = false;
+  if (pending_search_ == last_search_) {
+    // This search was the same as the last one we did
     return;
   }
 
-  RunSearch(search);
+  RunSearch(pending_search_);
 }
 
-void SearchPreview::showEvent(QShowEvent* e) {
-  if (pending_search_.is_valid() && !generator_) {
-    // There was a search waiting while we were hidden, so run it now
-    RunSearch(pending_search_);
-    pending_search_ = Search();
-  }
+SearchPreview::PreviewResult SearchPreview::RunPreview(
+    LibraryBackend* backend, Search search, QueryCancelFlag cancel) {
+  PreviewResult ret;
 
-  QWidget::showEvent(e);
-}
+  // Counting doesn't have to sort anything or read the songs.
+  int total = backend->CountSongs(search, cancel);
+  if (total == -1) return ret;
+  if (search.limit_ != -1) total = qMin(total, search.limit_);
+  ret.total = total;
 
-PlaylistItemList DoRunSearch(GeneratorPtr gen) { return gen->Generate(); }
+  search.limit_ = qMin(total, Generator::kDefaultLimit);
+  if (search.limit_ > 0) ret.songs = backend->FindSongs(search, cancel);
+  return ret;
+}
 
 void SearchPreview::RunSearch(const Search& search) {
-  generator_.reset(new QueryGenerator);
-  generator_->set_library(backend_);
-  std::dynamic_pointer_cast<QueryGenerator>(generator_)->Load(search);
+  cancel_.reset(new QAtomicInt(0));
 
   ui_->busy_container->show();
   ui_->count_label->hide();
-  QFuture<PlaylistItemList> future = QtConcurrent::run(DoRunSearch, generator_);
-  NewClosure(future, this, SLOT(SearchFinished(QFuture<PlaylistItemList>)),
-             future);
+
+  QFutureWatcher<PreviewResult>* watcher =
+      new QFutureWatcher<PreviewResult>(this);
+  NewClosure(watcher, SIGNAL(finished()), [=]() {
+    SearchFinished(search, watcher->result());
+    watcher->deleteLater();
+  });
+  watcher->setFuture(ThreadPools::Run<PreviewResult>(
+      ThreadPools::Pool_Interactive,
+      std::bind(&SearchPreview::RunPreview, backend_, search, cancel_)));
 }
 
-void SearchPreview::SearchFinished(QFuture<PlaylistItemList> future) {
-  last_search_ =
-      std::dynamic_pointer_cast<QueryGenerator>(generator_)->search();
-  generator_.reset();
+void SearchPreview::SearchFinished(const Search& search,
+                                   const PreviewResult& result) {
+  // A cancelled search only found some of its songs, so it doesn't count as
+  // done even if the pending search is the same one again.
+  const bool cancelled = SqliteCancelScope::IsCancelled(cancel_);
+  cancel_.reset();
 
-  if (pending_search_.is_valid() && pending_search_ != last_search_) {
-    // There was another search done while we were running - throw away these
-    // results and do that one now instead
-    RunSearch(pending_search_);
-    pending_search_ = Search();
+  if (cancelled) {
+    StartPendingSearch();
     return;
   }
+  last_search_ = search;
 
-  PlaylistItemList all_items = future.result();
-  PlaylistItemList displayed_items = all_items.mid(0, Generator::kDefaultLimit);
+  PlaylistItemList items;
+  for (const Song& song : result.songs) {
+    items << PlaylistItemPtr(
+        PlaylistItem::NewFromSongsTable(backend_->songs_table(), song));
+  }
 
   model_->Clear();
-  model_->InsertItems(displayed_items);
+  model_->InsertItems(items);
 
-  if (displayed_items.count() < all_items.count()) {
+  const int total = qMax(result.total, items.count());
+  if (items.count() < total) {
     ui_->count_label->setText(tr("%1 songs found (showing %2)")
-                                  .arg(all_items.count())
-                                  .arg(displayed_items.count()));
+                                  .arg(total)
+                                  .arg(items.count()));
   } else {
-    ui_->count_label->setText(tr("%1 songs found").arg(all_items.count()));
+    ui_->count_label->setText(tr("%1 songs found").arg(total));
   }
 
   ui_->busy_container->hide();
   ui_->count_label->show();
+
+  // Something else might have been asked for while this one was running.
+  StartPendingSearch();
 }
 
 }  // namespace
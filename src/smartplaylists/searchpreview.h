@@ -19,14 +19,15 @@
 #define SMARTPLAYLISTSEARCHPREVIEW_H
 
 #include "search.h"
-#include "smartplaylists/generator_fwd.h"
+#include "core/song.h"
+#include "library/sqlitequery.h"
 
-#include <QFuture>
 #include <QWidget>
 
 class Application;
 class LibraryBackend;
 class Playlist;
+class QTimer;
 class Ui_SmartPlaylistSearchPreview;
 
 namespace smart_playlists {
@@ -41,16 +42,35 @@ class SearchPreview : public QWidget {
   void set_application(Application* app);
   void set_library(LibraryBackend* backend);
 
+  // Edits come in quick succession while the user is typing, so the search
+  // is only run once they've stopped for a moment.
   void Update(const Search& search);
 
+  // How long Update waits for another edit.
+  static const int kUpdateDelayMsec;
+
  protected:
   void showEvent(QShowEvent*);
 
  private:
+  // Only the songs that are shown are fetched.  The rest are just counted.
+  struct PreviewResult {
+    PreviewResult() : total(-1) {}
+
+    SongList songs;
+    int total;
+  };
+
+  static PreviewResult RunPreview(LibraryBackend* backend, Search search,
+                                  QueryCancelFlag cancel);
+
   void RunSearch(const Search& search);
+  void SearchFinished(const Search& search, const PreviewResult& result);
 
  private slots:
-  void SearchFinished(QFuture<PlaylistItemList> future);
+  // Runs the latest search from Update, unless the widget is hidden or
+  // another search is still running.  Either way it's tried again later.
+  void StartPendingSearch();
 
  private:
   Ui_SmartPlaylistSearchPreview* ui_;
@@ -59,9 +79,13 @@ class SearchPreview : public QWidget {
   LibraryBackend* backend_;
   Playlist* model_;
 
+  QTimer* update_timer_;
+  bool search_pending_;
   Search pending_search_;
   Search last_search_;
-  GeneratorPtr generator_;
+  // Only set while a search is running.  It's set to 1 when a newer search
+  // makes the running one pointless.
+  QueryCancelFlag cancel_;
 };
 
 }  // namespace
@@ -0,0 +1,128 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "similargenerator.h"
+#include "library/librarybackend.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QMap>
+#include <QSet>
+
+#include "core/logging.h"
+
+namespace smart_playlists {
+
+const int SimilarGenerator::kChoices = 10;
+
+SimilarGenerator::SimilarGenerator()
+    : seed_id_(-1),
+      index_loaded_(false),
+      random_(QDateTime::currentMSecsSinceEpoch()) {}
+
+SimilarGenerator::SimilarGenerator(const QString& name, int seed_id)
+    : seed_id_(seed_id),
+      index_loaded_(false),
+      random_(QDateTime::currentMSecsSinceEpoch()) {
+  set_name(name);
+}
+
+void SimilarGenerator::Load(const QByteArray& data) {
+  QDataStream s(data);
+  s >> seed_id_;
+  index_loaded_ = false;
+}
+
+QByteArray SimilarGenerator::Save() const {
+  QByteArray ret;
+  QDataStream s(&ret, QIODevice::WriteOnly);
+  s << seed_id_;
+
+  return ret;
+}
+
+bool SimilarGenerator::LoadIndex() {
+  if (index_loaded_) return !seed_features_.isEmpty();
+
+  index_ = SimilarityIndex();
+  backend_->LoadAudioFeatures(&index_);
+  index_loaded_ = true;
+  qLog(Debug) << "Loaded the audio features of" << index_.count() << "songs";
+
+  seed_features_ = index_.Features(seed_id_);
+  if (seed_features_.isEmpty()) {
+    emit Error(tr("This song hasn't been analysed yet.  Choose \"Analyse "
+                  "library songs for similar tracks\" from the Tools menu "
+                  "first."));
+    return false;
+  }
+  if (last_features_.isEmpty()) last_features_ = seed_features_;
+  return true;
+}
+
+PlaylistItemList SimilarGenerator::Generate() {
+  previous_ids_.clear();
+  previous_ids_ << seed_id_;
+  last_features_.clear();
+  return GenerateMore(GetDynamicFuture());
+}
+
+PlaylistItemList SimilarGenerator::GenerateMore(int count) {
+  if (!LoadIndex()) return PlaylistItemList();
+
+  QList<int> ids;
+  for (int i = 0; i < count; ++i) {
+    // Halfway between the seed and the last song picked.
+    QByteArray query(seed_features_.size(), 0);
+    for (int j = 0; j < query.size(); ++j) {
+      query[j] = (quint8(seed_features_[j]) + quint8(last_features_[j])) / 2;
+    }
+
+    const QList<int> nearest = index_.Nearest(
+        query, kChoices, QSet<int>::fromList(previous_ids_ + ids));
+    if (nearest.isEmpty()) break;
+
+    // The nearer songs are more likely to be picked.
+    std::uniform_int_distribution<int> dist(0, nearest.count() - 1);
+    const int id = nearest[qMin(dist(random_), dist(random_))];
+
+    ids << id;
+    last_features_ = index_.Features(id);
+  }
+
+  // The songs come back in ROWID order, so put them back in the order they
+  // were picked.
+  QMap<int, Song> songs_by_id;
+  for (const Song& song : backend_->GetSongsById(ids)) {
+    songs_by_id[song.id()] = song;
+  }
+
+  PlaylistItemList items;
+  for (int id : ids) {
+    if (!songs_by_id.contains(id)) continue;
+
+    items << PlaylistItemPtr(PlaylistItem::NewFromSongsTable(
+                 backend_->songs_table(), songs_by_id[id]));
+    previous_ids_ << id;
+
+    if (previous_ids_.count() > GetDynamicFuture() + GetDynamicHistory())
+      previous_ids_.removeFirst();
+  }
+  return items;
+}
+
+}  // namespace
@@ -0,0 +1,69 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SMARTPLAYLISTS_SIMILARGENERATOR_H_
+#define SMARTPLAYLISTS_SIMILARGENERATOR_H_
+
+#include <random>
+
+#include "generator.h"
+#include "library/similarityindex.h"
+
+namespace smart_playlists {
+
+class SimilarGenerator : public Generator {
+  // A dynamic playlist of library songs that sound like a seed song, using
+  // the features from AudioFeatureAnalyser.  Each song is picked near both
+  // the seed and the song before it, so the playlist can wander a little
+  // without losing the seed's character.
+
+ public:
+  SimilarGenerator();
+  SimilarGenerator(const QString& name, int seed_id);
+
+  // Songs are picked at random from this many of the nearest.
+  static const int kChoices;
+
+  QString type() const { return "Similar"; }
+
+  void Load(const QByteArray& data);
+  QByteArray Save() const;
+
+  PlaylistItemList Generate();
+  PlaylistItemList GenerateMore(int count);
+  bool is_dynamic() const { return true; }
+
+ private:
+  bool LoadIndex();
+
+  int seed_id_;
+
+  // The whole library's features are loaded the first time songs are
+  // picked, after that picking only takes a search of the index.
+  SimilarityIndex index_;
+  bool index_loaded_;
+
+  QByteArray seed_features_;
+  QByteArray last_features_;
+  QList<int> previous_ids_;
+
+  std::mt19937 random_;
+};
+
+}  // namespace
+
+#endif  // SMARTPLAYLISTS_SIMILARGENERATOR_H_
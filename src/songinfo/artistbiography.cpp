@@ -52,6 +52,11 @@ ArtistBiography::ArtistBiography() : network_(new NetworkAccessManager) {}
 
 ArtistBiography::~ArtistBiography() {}
 
+QString ArtistBiography::CacheKey(const Song& metadata) const {
+  if (metadata.artist().isEmpty()) return QString();
+  return metadata.artist() + "\n" + GetLocale();
+}
+
 void ArtistBiography::FetchInfo(int id, const Song& metadata) {
   if (metadata.artist().isEmpty()) {
     emit Finished(id);
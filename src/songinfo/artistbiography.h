@@ -33,6 +33,7 @@ class ArtistBiography : public SongInfoProvider {
   ~ArtistBiography();
 
   void FetchInfo(int id, const Song& metadata) override;
+  QString CacheKey(const Song& metadata) const override;
 
  private:
   void FetchWikipediaImages(int id, const QString& title,
@@ -29,7 +29,7 @@ const char* SongInfoBase::kSettingsGroup = "SongInfo";
 
 SongInfoBase::SongInfoBase(QWidget* parent)
     : QWidget(parent),
-      network_(new NetworkAccessManager(this)),
+      network_(NetworkAccessManager::Shared()),
       fetcher_(new SongInfoFetcher(this)),
       current_request_id_(-1),
       scroll_area_(new QScrollArea),
@@ -118,6 +118,13 @@ void SongInfoBase::SongChanged(const Song& metadata) {
 
 void SongInfoBase::SongFinished() { dirty_ = false; }
 
+void SongInfoBase::NextSongChanged(const Song& metadata) {
+  // Don't go fetching things for a pane nobody is looking at.
+  if (isVisible() && metadata.is_valid()) {
+    fetcher_->PrefetchInfo(metadata);
+  }
+}
+
 void SongInfoBase::showEvent(QShowEvent* e) {
   if (dirty_) {
     MaybeUpdate(queued_metadata_);
@@ -45,6 +45,8 @@ class SongInfoBase : public QWidget {
  public slots:
   void SongChanged(const Song& metadata);
   void SongFinished();
+  // Called with the song that will probably be played after the current one.
+  void NextSongChanged(const Song& metadata);
   virtual void ReloadSettings();
 
 signals:
@@ -0,0 +1,105 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "songinfocache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+
+#include "core/logging.h"
+#include "core/utilities.h"
+
+const int SongInfoCache::kMaxAgeSecs = 60 * 60 * 24 * 7;  // 1 week
+
+namespace {
+// Bump this when the file format changes.
+const qint32 kFileVersion = 1;
+}  // namespace
+
+SongInfoCache::SongInfoCache()
+    : directory_(Utilities::GetConfigPath(Utilities::Path_CacheRoot) +
+                 "/songinfo") {}
+
+QString SongInfoCache::Filename(const QString& provider,
+                                const QString& key) const {
+  const QByteArray hash = QCryptographicHash::hash(
+      (provider + '\n' + key).toUtf8(), QCryptographicHash::Sha1);
+  return directory_ + "/" + QString::fromAscii(hash.toHex());
+}
+
+bool SongInfoCache::Load(const QString& provider, const QString& key,
+                         Entry* entry) const {
+  QFile file(Filename(provider, key));
+  if (!file.open(QIODevice::ReadOnly)) return false;
+
+  QDataStream s(&file);
+  qint32 version = 0;
+  uint saved_time = 0;
+  s >> version >> saved_time;
+  if (version != kFileVersion ||
+      QDateTime::currentDateTime().toTime_t() - saved_time >
+          uint(kMaxAgeSecs)) {
+    file.remove();
+    return false;
+  }
+
+  Entry ret;
+  qint32 section_count = 0;
+  s >> ret.images_ >> section_count;
+  for (int i = 0; i < section_count && s.status() == QDataStream::Ok; ++i) {
+    Section section;
+    qint32 type = 0;
+    qint32 relevance = 0;
+    s >> section.id_ >> section.title_ >> section.icon_ >> type >> relevance >>
+        section.html_;
+    section.type_ = type;
+    section.relevance_ = relevance;
+    ret.sections_ << section;
+  }
+
+  if (s.status() != QDataStream::Ok) {
+    qLog(Warning) << "Corrupt song info cache file" << file.fileName();
+    file.remove();
+    return false;
+  }
+
+  *entry = ret;
+  return true;
+}
+
+void SongInfoCache::Save(const QString& provider, const QString& key,
+                         const Entry& entry) const {
+  if (!QDir().mkpath(directory_)) return;
+
+  QFile file(Filename(provider, key));
+  if (!file.open(QIODevice::WriteOnly)) {
+    qLog(Warning) << "Couldn't write song info cache file" << file.fileName();
+    return;
+  }
+
+  QDataStream s(&file);
+  s << kFileVersion << QDateTime::currentDateTime().toTime_t() << entry.images_
+    << qint32(entry.sections_.count());
+  for (const Section& section : entry.sections_) {
+    s << section.id_ << section.title_ << section.icon_
+      << qint32(section.type_) << qint32(section.relevance_) << section.html_;
+  }
+}
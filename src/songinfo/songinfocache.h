@@ -0,0 +1,65 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef SONGINFOCACHE_H
+#define SONGINFOCACHE_H
+
+#include <QIcon>
+#include <QList>
+#include <QString>
+#include <QUrl>
+
+// Keeps what song info providers found on disk for a while, so the same
+// artist's biography or the same song's lyrics aren't downloaded again every
+// time.  Only sections that are plain text can be stored - the rest are
+// widgets.
+class SongInfoCache {
+ public:
+  SongInfoCache();
+
+  static const int kMaxAgeSecs;
+
+  struct Section {
+    Section() : type_(0), relevance_(0) {}
+
+    QString id_;
+    QString title_;
+    QIcon icon_;
+    int type_;
+    int relevance_;
+    QString html_;
+  };
+
+  struct Entry {
+    QList<QUrl> images_;
+    QList<Section> sections_;
+  };
+
+  // Returns false if there's nothing for this provider and key or if it's
+  // too old.
+  bool Load(const QString& provider, const QString& key, Entry* entry) const;
+  void Save(const QString& provider, const QString& key,
+            const Entry& entry) const;
+
+ private:
+  QString Filename(const QString& provider, const QString& key) const;
+
+  QString directory_;
+};
+
+#endif  // SONGINFOCACHE_H
@@ -17,17 +17,27 @@
 
 #include "songinfofetcher.h"
 #include "songinfoprovider.h"
+#include "songinfotextview.h"
 #include "core/logging.h"
 
+#include <algorithm>
+
+#include <QDateTime>
+#include <QSettings>
 #include <QSignalMapper>
 #include <QTimer>
 
+const char* SongInfoFetcher::kStatsSettingsKey = "SongInfo/provider_stats";
+
 SongInfoFetcher::SongInfoFetcher(QObject* parent)
     : QObject(parent),
+      racing_enabled_(true),
       timeout_timer_mapper_(new QSignalMapper(this)),
       timeout_duration_(kDefaultTimeoutDuration),
       next_id_(1) {
   connect(timeout_timer_mapper_, SIGNAL(mapped(int)), SLOT(Timeout(int)));
+
+  LoadStats();
 }
 
 void SongInfoFetcher::AddProvider(SongInfoProvider* provider) {
@@ -41,7 +51,28 @@ void SongInfoFetcher::AddProvider(SongInfoProvider* provider) {
           Qt::QueuedConnection);
 }
 
+void SongInfoFetcher::AddRacingProvider(SongInfoProvider* provider) {
+  AddProvider(provider);
+  racing_providers_ << provider;
+}
+
 int SongInfoFetcher::FetchInfo(const Song& metadata) {
+  return StartFetch(metadata, false);
+}
+
+void SongInfoFetcher::PrefetchInfo(const Song& metadata) {
+  prefetch_metadata_ = metadata;
+  MaybeStartPrefetch();
+}
+
+void SongInfoFetcher::MaybeStartPrefetch() {
+  if (!prefetch_metadata_.is_valid() || !waiting_for_.isEmpty()) return;
+
+  StartFetch(prefetch_metadata_, true);
+  prefetch_metadata_ = Song();
+}
+
+int SongInfoFetcher::StartFetch(const Song& metadata, bool prefetch) {
   const int id = next_id_++;
   results_[id] = Result();
   timeout_timers_[id] = new QTimer(this);
@@ -53,25 +84,153 @@ int SongInfoFetcher::FetchInfo(const Song& metadata) {
   connect(timeout_timers_[id], SIGNAL(timeout()), timeout_timer_mapper_,
           SLOT(map()));
 
+  if (prefetch) prefetch_ids_ << id;
+
+  QList<SongInfoProvider*>& waiting_for = waiting_for_[id];
+  QList<SongInfoCache::Entry> cached;
+  QList<SongInfoProvider*> racers;
   for (SongInfoProvider* provider : providers_) {
-    if (provider->is_enabled()) {
-      waiting_for_[id].append(provider);
-      provider->FetchInfo(id, metadata);
+    if (!provider->is_enabled()) continue;
+
+    const QString key = provider->CacheKey(metadata);
+    if (!key.isEmpty()) {
+      SongInfoCache::Entry entry;
+      if (cache_.Load(provider->name(), key, &entry)) {
+        cached << entry;
+        continue;
+      }
+      pending_cache_[id][provider].key_ = key;
+    } else if (prefetch) {
+      // Nothing would be kept.
+      continue;
+    }
+
+    if (racing_enabled_ && racing_providers_.contains(provider)) {
+      racers << provider;
+      continue;
     }
+
+    waiting_for.append(provider);
+    provider->FetchInfo(id, metadata);
+  }
+
+  // No need to race if the cache had lyrics already.
+  bool cached_lyrics = false;
+  for (const SongInfoCache::Entry& entry : cached) {
+    for (const SongInfoCache::Section& section : entry.sections_) {
+      if (section.type_ == CollapsibleInfoPane::Data::Type_Lyrics) {
+        cached_lyrics = true;
+      }
+    }
+  }
+
+  if (!racers.isEmpty() && !cached_lyrics) {
+    std::stable_sort(racers.begin(), racers.end(),
+                     [this](SongInfoProvider* a, SongInfoProvider* b) {
+      return stats_.value(a->name()).Score() > stats_.value(b->name()).Score();
+    });
+
+    racing_metadata_[id] = metadata;
+    racing_queue_[id] = racers;
+    for (int i = 0; i < kMaxRacingRequests && !racing_queue_[id].isEmpty();
+         ++i) {
+      StartRacer(id, racing_queue_[id].takeFirst());
+    }
+  }
+
+  // The caller needs the ID before any results arrive.
+  if (!cached.isEmpty() || waiting_for.isEmpty()) {
+    cached_results_[id] = prefetch ? QList<SongInfoCache::Entry>() : cached;
+    QTimer::singleShot(0, this, SLOT(AddCachedResults()));
   }
   return id;
 }
 
+void SongInfoFetcher::AddCachedResults() {
+  for (int id : cached_results_.keys()) {
+    const QList<SongInfoCache::Entry> entries = cached_results_.take(id);
+    if (!results_.contains(id)) continue;
+
+    for (const SongInfoCache::Entry& entry : entries) {
+      results_[id].images_ << entry.images_;
+
+      for (const SongInfoCache::Section& section : entry.sections_) {
+        SongInfoTextView* editor = new SongInfoTextView;
+        // The HTML was taken from a SongInfoTextView, so it's already been
+        // through SetHtml.
+        editor->setHtml(section.html_);
+
+        CollapsibleInfoPane::Data data;
+        data.id_ = section.id_;
+        data.title_ = section.title_;
+        data.icon_ = section.icon_;
+        data.type_ = CollapsibleInfoPane::Data::Type(section.type_);
+        data.relevance_ = section.relevance_;
+        data.contents_ = editor;
+        data.content_object_ = nullptr;
+
+        results_[id].info_ << data;
+        emit InfoResultReady(id, data);
+      }
+    }
+
+    if (waiting_for_.value(id).isEmpty()) {
+      FetchFinished(id);
+    }
+  }
+}
+
 void SongInfoFetcher::ImageReady(int id, const QUrl& url) {
   if (!results_.contains(id)) return;
   results_[id].images_ << url;
+
+  SongInfoProvider* provider = qobject_cast<SongInfoProvider*>(sender());
+  if (pending_cache_.value(id).contains(provider)) {
+    pending_cache_[id][provider].entry_.images_ << url;
+  }
 }
 
 void SongInfoFetcher::InfoReady(int id, const CollapsibleInfoPane::Data& data) {
   if (!results_.contains(id)) return;
+
+  // Racing providers that were cancelled might still send something.
+  SongInfoProvider* provider = qobject_cast<SongInfoProvider*>(sender());
+  if (racing_providers_.contains(provider) &&
+      !waiting_for_.value(id).contains(provider)) {
+    delete data.contents_;
+    return;
+  }
+
   results_[id].info_ << data;
 
   if (!waiting_for_.contains(id)) return;
+  if (pending_cache_.value(id).contains(provider)) {
+    SongInfoTextView* editor = qobject_cast<SongInfoTextView*>(data.contents_);
+    if (editor) {
+      SongInfoCache::Section section;
+      section.id_ = data.id_;
+      section.title_ = data.title_;
+      section.icon_ = data.icon_;
+      section.type_ = data.type_;
+      section.relevance_ = data.relevance_;
+      section.html_ = editor->toHtml();
+      pending_cache_[id][provider].entry_.sections_ << section;
+    } else {
+      // Widgets can't be saved, so nothing from this provider is.
+      pending_cache_[id].remove(provider);
+    }
+  }
+
+  // Got lyrics, so there's no need to keep looking.
+  if (data.type_ == CollapsibleInfoPane::Data::Type_Lyrics &&
+      racing_started_.contains(id)) {
+    if (racing_started_[id].contains(provider)) {
+      RecordRace(id, provider, true);
+    }
+    CancelRacers(id, provider);
+  }
+
+  if (prefetch_ids_.contains(id)) return;
   emit InfoResultReady(id, data);
 }
 
@@ -82,11 +241,30 @@ void SongInfoFetcher::ProviderFinished(int id) {
   SongInfoProvider* provider = qobject_cast<SongInfoProvider*>(sender());
   if (!waiting_for_[id].contains(provider)) return;
 
+  if (pending_cache_.value(id).contains(provider)) {
+    const PendingCacheEntry pending = pending_cache_[id].take(provider);
+
+    // Don't remember that there was nothing - it might have been a network
+    // error.
+    if (!pending.entry_.images_.isEmpty() ||
+        !pending.entry_.sections_.isEmpty()) {
+      cache_.Save(provider->name(), pending.key_, pending.entry_);
+    }
+  }
+
   waiting_for_[id].removeAll(provider);
-  if (waiting_for_[id].isEmpty()) {
-    emit ResultReady(id, results_.take(id));
-    waiting_for_.remove(id);
-    delete timeout_timers_.take(id);
+
+  if (racing_started_.value(id).contains(provider)) {
+    // It didn't find anything.
+    RecordRace(id, provider, false);
+  }
+  if (racing_providers_.contains(provider) &&
+      !racing_queue_.value(id).isEmpty()) {
+    StartRacer(id, racing_queue_[id].takeFirst());
+  }
+
+  if (waiting_for_[id].isEmpty() && !cached_results_.contains(id)) {
+    FetchFinished(id);
   }
 }
 
@@ -94,16 +272,99 @@ void SongInfoFetcher::Timeout(int id) {
   if (!results_.contains(id)) return;
   if (!waiting_for_.contains(id)) return;
 
-  // Emit the results that we have already
-  emit ResultReady(id, results_.take(id));
-
   // Cancel any providers that we're still waiting for
   for (SongInfoProvider* provider : waiting_for_[id]) {
     qLog(Info) << "Request timed out from info provider" << provider->name();
     provider->Cancel(id);
   }
-  waiting_for_.remove(id);
 
-  // Remove the timer
+  // Emit the results that we have already
+  FetchFinished(id);
+}
+
+void SongInfoFetcher::FetchFinished(int id) {
+  const Result result = results_.take(id);
+  waiting_for_.remove(id);
+  pending_cache_.remove(id);
+  cached_results_.remove(id);
+  racing_queue_.remove(id);
+  racing_started_.remove(id);
+  racing_metadata_.remove(id);
   delete timeout_timers_.take(id);
+
+  if (prefetch_ids_.remove(id)) {
+    // Nobody is going to show these.
+    for (const CollapsibleInfoPane::Data& data : result.info_) {
+      delete data.contents_;
+    }
+  } else {
+    emit ResultReady(id, result);
+  }
+
+  MaybeStartPrefetch();
+}
+
+void SongInfoFetcher::StartRacer(int id, SongInfoProvider* provider) {
+  waiting_for_[id].append(provider);
+  racing_started_[id][provider] = QDateTime::currentMSecsSinceEpoch();
+  provider->FetchInfo(id, racing_metadata_[id]);
+}
+
+void SongInfoFetcher::CancelRacers(int id, SongInfoProvider* winner) {
+  racing_queue_.remove(id);
+
+  for (SongInfoProvider* provider : racing_started_.take(id).keys()) {
+    if (provider == winner) continue;
+
+    provider->Cancel(id);
+    waiting_for_[id].removeAll(provider);
+    if (pending_cache_.contains(id)) pending_cache_[id].remove(provider);
+  }
+}
+
+void SongInfoFetcher::RecordRace(int id, SongInfoProvider* provider,
+                                 bool hit) {
+  const qint64 started = racing_started_[id].take(provider);
+
+  ProviderStats& stats = stats_[provider->name()];
+  stats.requests_++;
+  if (hit) stats.hits_++;
+  stats.total_msec_ += QDateTime::currentMSecsSinceEpoch() - started;
+
+  SaveStats();
+}
+
+double SongInfoFetcher::ProviderStats::Score() const {
+  // Providers that haven't been tried much get the benefit of the doubt.
+  const double hit_rate = (hits_ + 1.0) / (requests_ + 2.0);
+  const double mean_msec = (total_msec_ + 1000.0) / (requests_ + 1.0);
+  return hit_rate / mean_msec;
+}
+
+void SongInfoFetcher::LoadStats() {
+  QSettings s;
+  const QVariantMap saved = s.value(kStatsSettingsKey).toMap();
+  for (QVariantMap::const_iterator it = saved.constBegin();
+       it != saved.constEnd(); ++it) {
+    const QVariantList values = it.value().toList();
+    if (values.count() != 3) continue;
+
+    ProviderStats stats;
+    stats.requests_ = values[0].toInt();
+    stats.hits_ = values[1].toInt();
+    stats.total_msec_ = values[2].toLongLong();
+    stats_[it.key()] = stats;
+  }
+}
+
+void SongInfoFetcher::SaveStats() const {
+  QVariantMap saved;
+  for (QMap<QString, ProviderStats>::const_iterator it = stats_.constBegin();
+       it != stats_.constEnd(); ++it) {
+    saved[it.key()] = QVariantList() << it->requests_ << it->hits_
+                                     << it->total_msec_;
+  }
+
+  QSettings s;
+  s.setValue(kStatsSettingsKey, saved);
 }
@@ -20,9 +20,11 @@
 
 #include <QMap>
 #include <QObject>
+#include <QSet>
 #include <QUrl>
 
 #include "collapsibleinfopane.h"
+#include "songinfocache.h"
 #include "core/song.h"
 
 class SongInfoProvider;
@@ -41,10 +43,23 @@ class SongInfoFetcher : public QObject {
   };
 
   static const int kDefaultTimeoutDuration = 25000;  // msec
+  static const int kMaxRacingRequests = 4;
+  static const char* kStatsSettingsKey;
 
   void AddProvider(SongInfoProvider* provider);
+  // Racing providers all look for lyrics.  When racing is enabled the ones
+  // that have found lyrics fastest in the past are asked first, a few at a
+  // time, and the rest are cancelled as soon as any provider finds some.
+  void AddRacingProvider(SongInfoProvider* provider);
+  void set_racing_enabled(bool enabled) { racing_enabled_ = enabled; }
+
   int FetchInfo(const Song& metadata);
 
+  // Fetches info that can be cached for a song that's likely to be played
+  // next, so it's ready when it starts.  Waits until nothing else is being
+  // fetched, since providers can only cope with one request at a time.
+  void PrefetchInfo(const Song& metadata);
+
   QList<SongInfoProvider*> providers() const { return providers_; }
 
 signals:
@@ -56,14 +71,63 @@ signals:
   void InfoReady(int id, const CollapsibleInfoPane::Data& data);
   void ProviderFinished(int id);
   void Timeout(int id);
+  void AddCachedResults();
+
+ private:
+  struct ProviderStats {
+    ProviderStats() : requests_(0), hits_(0), total_msec_(0) {}
+
+    // Lyrics found per millisecond spent waiting.
+    double Score() const;
+
+    int requests_;
+    int hits_;
+    qint64 total_msec_;
+  };
+
+  int StartFetch(const Song& metadata, bool prefetch);
+  void FetchFinished(int id);
+  void MaybeStartPrefetch();
+
+  void StartRacer(int id, SongInfoProvider* provider);
+  void CancelRacers(int id, SongInfoProvider* winner);
+  void RecordRace(int id, SongInfoProvider* provider, bool hit);
+  void LoadStats();
+  void SaveStats() const;
 
  private:
   QList<SongInfoProvider*> providers_;
+  QList<SongInfoProvider*> racing_providers_;
+  bool racing_enabled_;
 
   QMap<int, Result> results_;
   QMap<int, QList<SongInfoProvider*> > waiting_for_;
   QMap<int, QTimer*> timeout_timers_;
 
+  SongInfoCache cache_;
+  // What each provider has returned so far, for the providers that have a
+  // cache key.  A provider is dropped from here if it returns a section that
+  // can't be cached.
+  struct PendingCacheEntry {
+    QString key_;
+    SongInfoCache::Entry entry_;
+  };
+  QMap<int, QMap<SongInfoProvider*, PendingCacheEntry> > pending_cache_;
+  // Results from the cache that are added after FetchInfo has returned.
+  QMap<int, QList<SongInfoCache::Entry> > cached_results_;
+
+  QSet<int> prefetch_ids_;
+  Song prefetch_metadata_;
+
+  // Racing providers that haven't been started yet, best first.
+  QMap<int, QList<SongInfoProvider*> > racing_queue_;
+  // When each racing provider that's still running was started, in msec
+  // since the epoch.
+  QMap<int, QMap<SongInfoProvider*, qint64> > racing_started_;
+  QMap<int, Song> racing_metadata_;
+  // Keyed on provider name, saved in the settings.
+  QMap<QString, ProviderStats> stats_;
+
   QSignalMapper* timeout_timer_mapper_;
   int timeout_duration_;
 
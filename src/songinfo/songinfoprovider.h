@@ -35,6 +35,11 @@ class SongInfoProvider : public QObject {
 
   virtual QString name() const;
 
+  // What FetchInfo finds for a song is kept in SongInfoFetcher's cache under
+  // this key, so it has to include everything FetchInfo looks at.  Providers
+  // that return an empty key aren't cached.
+  virtual QString CacheKey(const Song& metadata) const { return QString(); }
+
   bool is_enabled() const { return enabled_; }
   void set_enabled(bool enabled) { enabled_ = enabled; }
 
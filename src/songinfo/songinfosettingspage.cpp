@@ -59,6 +59,10 @@ void SongInfoSettingsPage::Load() {
       s.value("font_size", SongInfoTextView::kDefaultFontSize).toReal());
   s.endGroup();
 
+  s.beginGroup(SongInfoView::kSettingsGroup);
+  ui_->race_lyrics->setChecked(s.value("race_lyrics", true).toBool());
+  s.endGroup();
+
   QList<const UltimateLyricsProvider*> providers =
       dialog()->song_info_view()->lyric_providers();
 
@@ -88,6 +92,7 @@ void SongInfoSettingsPage::Save() {
     if (item->checkState() == Qt::Checked) search_order << item->text();
   }
   s.setValue("search_order", search_order);
+  s.setValue("race_lyrics", ui_->race_lyrics->isChecked());
   s.endGroup();
 }
 
@@ -53,7 +53,7 @@ SongInfoView::~SongInfoView() {}
 
 void SongInfoView::UltimateLyricsParsed(QFuture<ProviderList> future) {
   for (SongInfoProvider* provider : future.result()) {
-    fetcher_->AddProvider(provider);
+    fetcher_->AddRacingProvider(provider);
   }
 
   ultimate_reader_.reset();
@@ -129,6 +129,8 @@ void SongInfoView::ReloadSettings() {
     }
   }
 
+  fetcher_->set_racing_enabled(s.value("race_lyrics", true).toBool());
+
   SongInfoBase::ReloadSettings();
 }
 
@@ -35,7 +35,7 @@ const int SongKickConcertWidget::kStaticMapHeight = 100;
 SongKickConcertWidget::SongKickConcertWidget(QWidget* parent)
     : QWidget(parent),
       ui_(new Ui_SongKickConcertWidget),
-      network_(new NetworkAccessManager(this)) {
+      network_(NetworkAccessManager::Shared()) {
   ui_->setupUi(this);
 
   // Hide the map by default
@@ -23,13 +23,14 @@
 
 #include <QCoreApplication>
 #include <QNetworkReply>
+#include <QStringList>
 #include <QTextCodec>
 #include <QThread>
 
 const int UltimateLyricsProvider::kRedirectLimit = 5;
 
 UltimateLyricsProvider::UltimateLyricsProvider()
-    : network_(new NetworkAccessManager(this)),
+    : network_(NetworkAccessManager::Shared()),
       relevance_(0),
       redirect_count_(0),
       url_hop_(false) {}
@@ -59,6 +60,25 @@ void UltimateLyricsProvider::FetchInfo(int id, const Song& metadata) {
   connect(reply, SIGNAL(finished()), SLOT(LyricsFetched()));
 }
 
+QString UltimateLyricsProvider::CacheKey(const Song& metadata) const {
+  // Everything ReplaceFields uses.
+  return (QStringList() << metadata.artist() << metadata.album()
+                        << metadata.title() << metadata.PrettyYear()
+                        << QString::number(metadata.track()))
+      .join("\n");
+}
+
+void UltimateLyricsProvider::Cancel(int id) {
+  for (QNetworkReply* reply : requests_.keys(id)) {
+    requests_.remove(reply);
+    disconnect(reply, nullptr, this, nullptr);
+    reply->abort();
+    reply->deleteLater();
+  }
+
+  if (requests_.isEmpty()) url_hop_ = false;
+}
+
 void UltimateLyricsProvider::LyricsFetched() {
   QNetworkReply* reply = qobject_cast<QNetworkReply*>(sender());
   if (!reply) {
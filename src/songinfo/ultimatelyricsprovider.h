@@ -60,6 +60,8 @@ class UltimateLyricsProvider : public SongInfoProvider {
   int relevance() const { return relevance_; }
 
   void FetchInfo(int id, const Song& metadata);
+  QString CacheKey(const Song& metadata) const;
+  void Cancel(int id);
 
  private slots:
   void LyricsFetched();
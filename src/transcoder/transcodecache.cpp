@@ -0,0 +1,137 @@
+/* This file is part of Clementine.
+   Copyright 2012, Andreas Muttscheller <asfa194@gmail.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "transcodecache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+
+#include "core/logging.h"
+#include "core/utilities.h"
+
+const qint64 TranscodeCache::kMaxCacheSize = 1024 * 1024 * 1024;  // 1GB
+
+namespace {
+
+const char* kPartialSuffix = ".part";
+
+}  // namespace
+
+TranscodeCache::TranscodeCache(const QString& directory,
+                               const QString& settings_postfix,
+                               TranscodeScheduler::Priority priority,
+                               QObject* parent)
+    : QObject(parent),
+      transcoder_(new Transcoder(this, settings_postfix)),
+      cache_dir_(Utilities::GetConfigPath(Utilities::Path_CacheRoot) + "/" +
+                 directory) {
+  QDir().mkpath(cache_dir_);
+  transcoder_->set_priority(priority);
+
+  // Throw away anything left over from a job that didn't finish.
+  QDir dir(cache_dir_);
+  for (const QString& name :
+       dir.entryList(QStringList() << QString("*") + kPartialSuffix,
+                     QDir::Files)) {
+    dir.remove(name);
+  }
+
+  connect(transcoder_, SIGNAL(JobComplete(QString, QString, bool)),
+          SLOT(JobComplete(QString, QString, bool)));
+}
+
+TranscodeCache::~TranscodeCache() {
+  transcoder_->Cancel();
+  for (const QString& partial : pending_.keys()) {
+    QFile::remove(partial);
+  }
+}
+
+QString TranscodeCache::CacheFilename(const QString& input,
+                                      const TranscoderPreset& preset) const {
+  // Keyed by the file's identity rather than its contents - hashing a whole
+  // FLAC would take about as long as transcoding it.
+  const QFileInfo info(input);
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(info.canonicalFilePath().toUtf8());
+  hash.addData(QByteArray::number(info.size()));
+  hash.addData(QByteArray::number(info.lastModified().toTime_t()));
+  hash.addData(preset.codec_mimetype_.toUtf8());
+  hash.addData(preset.muxer_mimetype_.toUtf8());
+
+  return cache_dir_ + "/" + hash.result().toHex() + "." + preset.extension_;
+}
+
+QString TranscodeCache::Request(const QString& input,
+                                const TranscoderPreset& preset) {
+  const QString filename = CacheFilename(input, preset);
+
+  if (QFile::exists(filename)) return filename;
+
+  if (pending_.values().contains(filename)) return QString();
+
+  const QString partial = filename + kPartialSuffix;
+  QFile::remove(partial);
+  pending_[partial] = filename;
+
+  qLog(Debug) << "Transcoding" << input << "to" << filename;
+  transcoder_->AddJob(input, preset, partial);
+  transcoder_->Start();
+  return QString();
+}
+
+void TranscodeCache::JobComplete(const QString& input, const QString& output,
+                                 bool success) {
+  if (!pending_.contains(output)) return;
+  const QString filename = pending_.take(output);
+
+  if (success) {
+    success = QFile::rename(output, filename);
+  }
+  if (!success) {
+    QFile::remove(output);
+  }
+
+  emit Transcoded(input, filename, success);
+
+  if (success) Prune();
+}
+
+void TranscodeCache::Prune() {
+  QDir dir(cache_dir_);
+  QFileInfoList files =
+      dir.entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+
+  qint64 total = 0;
+  for (const QFileInfo& info : files) {
+    total += info.size();
+  }
+
+  // Delete the oldest encodes first.  A file that's still being sent stays
+  // readable on Unix, and just fails to delete on Windows.
+  for (const QFileInfo& info : files) {
+    if (total <= kMaxCacheSize) break;
+    if (info.fileName().endsWith(kPartialSuffix)) continue;
+
+    if (QFile::remove(info.absoluteFilePath())) {
+      total -= info.size();
+    }
+  }
+}
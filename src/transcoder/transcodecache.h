@@ -0,0 +1,69 @@
+/* This file is part of Clementine.
+   Copyright 2012, Andreas Muttscheller <asfa194@gmail.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRANSCODER_TRANSCODECACHE_H_
+#define TRANSCODER_TRANSCODECACHE_H_
+
+#include <QHash>
+#include <QObject>
+
+#include "transcoder/transcoder.h"
+
+// Transcoded copies of lossless files, kept in a directory under the cache
+// root.  The network remote has one for downloads, shared by every connected
+// client, and device syncs have another.  Files are named after a hash of
+// the source file and the preset, so the same album requested twice - or by
+// two phones - is only encoded once.
+class TranscodeCache : public QObject {
+  Q_OBJECT
+
+ public:
+  // The transcoder's settings are read with settings_postfix, like
+  // Transcoder's.
+  TranscodeCache(const QString& directory, const QString& settings_postfix,
+                 TranscodeScheduler::Priority priority,
+                 QObject* parent = nullptr);
+  ~TranscodeCache();
+
+  static const qint64 kMaxCacheSize;
+
+  // Where the transcoded copy of input for this preset lives, or will live.
+  QString CacheFilename(const QString& input,
+                        const TranscoderPreset& preset) const;
+
+  // Returns the cached filename if input has already been transcoded with
+  // this preset.  Otherwise starts transcoding it, unless that's already
+  // happening, returns an empty string and emits Transcoded() later.
+  QString Request(const QString& input, const TranscoderPreset& preset);
+
+ signals:
+  void Transcoded(const QString& input, const QString& output, bool success);
+
+ private slots:
+  void JobComplete(const QString& input, const QString& output, bool success);
+
+ private:
+  void Prune();
+
+  Transcoder* transcoder_;
+  QString cache_dir_;
+
+  // Partial output filename -> final filename, for jobs still running
+  QHash<QString, QString> pending_;
+};
+
+#endif  // TRANSCODER_TRANSCODECACHE_H_
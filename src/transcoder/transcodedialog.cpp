@@ -51,6 +51,7 @@ TranscodeDialog::TranscodeDialog(QWidget* parent)
       log_dialog_(new QDialog(this)),
       transcoder_(new Transcoder(this)),
       queued_(0),
+      outputs_per_file_(1),
       finished_success_(0),
       finished_failed_(0) {
   ui_->setupUi(this);
@@ -64,10 +65,13 @@ TranscodeDialog::TranscodeDialog(QWidget* parent)
   // Get presets
   QList<TranscoderPreset> presets = Transcoder::GetAllPresets();
   qSort(presets.begin(), presets.end(), ComparePresetsByName);
+  ui_->second_format->addItem(tr("Nothing else"),
+                              QVariant::fromValue(TranscoderPreset()));
   for (const TranscoderPreset& preset : presets) {
-    ui_->format->addItem(
-        QString("%1 (.%2)").arg(preset.name_, preset.extension_),
-        QVariant::fromValue(preset));
+    const QString text =
+        QString("%1 (.%2)").arg(preset.name_, preset.extension_);
+    ui_->format->addItem(text, QVariant::fromValue(preset));
+    ui_->second_format->addItem(text, QVariant::fromValue(preset));
   }
 
   // Load settings
@@ -86,6 +90,18 @@ TranscodeDialog::TranscodeDialog(QWidget* parent)
     }
   }
 
+  // The second format is empty if there isn't one.
+  QString last_second_format =
+      s.value("last_second_output_format").toString();
+  for (int i = 1; i < ui_->second_format->count(); ++i) {
+    if (last_second_format == ui_->second_format->itemData(i)
+                                  .value<TranscoderPreset>()
+                                  .codec_mimetype_) {
+      ui_->second_format->setCurrentIndex(i);
+      break;
+    }
+  }
+
   // Add a start button
   start_button_ = ui_->button_box->addButton(tr("Start transcoding"),
                                              QDialogButtonBox::ActionRole);
@@ -140,21 +156,37 @@ void TranscodeDialog::Start() {
   QAbstractItemModel* file_model = ui_->files->model();
   TranscoderPreset preset = ui_->format->itemData(ui_->format->currentIndex())
                                 .value<TranscoderPreset>();
+  TranscoderPreset second_preset =
+      ui_->second_format->itemData(ui_->second_format->currentIndex())
+          .value<TranscoderPreset>();
+
+  // Each file is only decoded once, however many formats it's written in.
+  QList<TranscoderPreset> presets;
+  presets << preset;
+  if (second_preset.type_ != Song::Type_Unknown &&
+      second_preset.type_ != preset.type_) {
+    presets << second_preset;
+  }
+  outputs_per_file_ = presets.count();
 
   // Add jobs to the transcoder
   for (int i = 0; i < file_model->rowCount(); ++i) {
     QFileInfo input_fileinfo(
         file_model->index(i, 0).data(Qt::UserRole).toString());
-    QString output_filename = GetOutputFileName(input_fileinfo, preset);
-    transcoder_->AddJob(input_fileinfo.filePath(), preset, output_filename);
+    QStringList output_filenames;
+    for (const TranscoderPreset& p : presets) {
+      output_filenames << GetOutputFileName(input_fileinfo, p);
+    }
+    transcoder_->AddJob(input_fileinfo.filePath(), presets, output_filenames);
   }
 
   // Set up the progressbar
   ui_->progress_bar->setValue(0);
-  ui_->progress_bar->setMaximum(file_model->rowCount() * 100);
+  ui_->progress_bar->setMaximum(file_model->rowCount() * outputs_per_file_ *
+                                100);
 
   // Reset the UI
-  queued_ = file_model->rowCount();
+  queued_ = file_model->rowCount() * outputs_per_file_;
   finished_success_ = 0;
   finished_failed_ = 0;
   UpdateStatusText();
@@ -166,6 +198,8 @@ void TranscodeDialog::Start() {
   QSettings s;
   s.beginGroup(kSettingsGroup);
   s.setValue("last_output_format", preset.codec_mimetype_);
+  s.setValue("last_second_output_format",
+             presets.count() > 1 ? second_preset.codec_mimetype_ : QString());
 }
 
 void TranscodeDialog::Cancel() {
@@ -188,9 +222,10 @@ void TranscodeDialog::JobComplete(const QString& input, const QString& output,
 void TranscodeDialog::UpdateProgress() {
   int progress = (finished_success_ + finished_failed_) * 100;
 
+  // Every output of a file progresses together.
   QMap<QString, float> current_jobs = transcoder_->GetProgress();
   for (float value : current_jobs.values()) {
-    progress += qBound(0, int(value * 100), 99);
+    progress += qBound(0, int(value * 100), 99) * outputs_per_file_;
   }
 
   ui_->progress_bar->setValue(progress);
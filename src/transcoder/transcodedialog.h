@@ -78,7 +78,10 @@ class TranscodeDialog : public QDialog {
   QString last_import_dir_;
 
   Transcoder* transcoder_;
+  // Counted per output file.
   int queued_;
+  // Each input is written in this many formats.
+  int outputs_per_file_;
   int finished_success_;
   int finished_failed_;
 };
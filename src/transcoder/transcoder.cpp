@@ -28,6 +28,7 @@
 
 #include "core/logging.h"
 #include "core/signalchecker.h"
+#include "core/timeconstants.h"
 #include "core/utilities.h"
 
 using std::shared_ptr;
@@ -186,8 +187,10 @@ Transcoder::JobFinishedEvent::JobFinishedEvent(JobState* state, bool success)
 
 void Transcoder::JobState::PostFinished(bool success) {
   if (success) {
-    emit parent_->LogLine(tr("Successfully written %1")
-                              .arg(QDir::toNativeSeparators(job_.output)));
+    for (const Output& output : job_.outputs) {
+      emit parent_->LogLine(tr("Successfully written %1").arg(
+          QDir::toNativeSeparators(output.filename)));
+    }
   }
 
   QCoreApplication::postEvent(parent_,
@@ -197,6 +200,7 @@ void Transcoder::JobState::PostFinished(bool success) {
 Transcoder::Transcoder(QObject* parent, const QString& settings_postfix)
     : QObject(parent),
       max_threads_(QThread::idealThreadCount()),
+      priority_(TranscodeScheduler::Priority_Background),
       settings_postfix_(settings_postfix) {
   if (JobFinishedEvent::sEventType == -1)
     JobFinishedEvent::sEventType = QEvent::registerEventType();
@@ -275,40 +279,63 @@ Song::FileType Transcoder::PickBestFormat(QList<Song::FileType> supported) {
   return supported[0];
 }
 
-void Transcoder::AddJob(const QString& input, const TranscoderPreset& preset,
-                        const QString& output) {
-  Job job;
-  job.input = input;
-  job.preset = preset;
-
+QString Transcoder::OutputFilename(const QString& input,
+                                   const TranscoderPreset& preset,
+                                   const QString& output,
+                                   const QStringList& taken) {
   // Use the supplied filename if there was one, otherwise take the file
   // extension off the input filename and append the correct one.
-  if (!output.isEmpty())
-    job.output = output;
-  else
-    job.output = input.section('.', 0, -2) + '.' + preset.extension_;
+  QString ret = output;
+  if (ret.isEmpty()) ret = input.section('.', 0, -2) + '.' + preset.extension_;
 
   // Never overwrite existing files
-  if (QFile::exists(job.output)) {
+  if (QFile::exists(ret) || taken.contains(ret)) {
     for (int i = 0;; ++i) {
       QString new_filename =
-          QString("%1.%2.%3").arg(job.output.section('.', 0, -2)).arg(i).arg(
+          QString("%1.%2.%3").arg(ret.section('.', 0, -2)).arg(i).arg(
               preset.extension_);
-      if (!QFile::exists(new_filename)) {
-        job.output = new_filename;
+      if (!QFile::exists(new_filename) && !taken.contains(new_filename)) {
+        ret = new_filename;
         break;
       }
     }
   }
+  return ret;
+}
+
+void Transcoder::AddJob(const QString& input, const TranscoderPreset& preset,
+                        const QString& output) {
+  AddJob(input, QList<TranscoderPreset>() << preset,
+         output.isEmpty() ? QStringList() : QStringList(output));
+}
+
+void Transcoder::AddJob(const QString& input,
+                        const QList<TranscoderPreset>& presets,
+                        const QStringList& outputs) {
+  Job job;
+  job.input = input;
+
+  QStringList taken;
+  for (int i = 0; i < presets.count(); ++i) {
+    Output output;
+    output.preset = presets[i];
+    output.filename = OutputFilename(input, presets[i], outputs.value(i),
+                                     taken);
+    taken << output.filename;
+    job.outputs << output;
+  }
 
   queued_jobs_ << job;
 }
 
 void Transcoder::AddTemporaryJob(const QString &input, const TranscoderPreset &preset) {
+  Output output;
+  output.filename = Utilities::GetTemporaryFileName();
+  output.preset = preset;
+
   Job job;
   job.input = input;
-  job.output = Utilities::GetTemporaryFileName();
-  job.preset = preset;
+  job.outputs << output;
 
   queued_jobs_ << job;
 }
@@ -324,6 +351,13 @@ void Transcoder::Start() {
   }
 }
 
+void Transcoder::StartQueuedJobs() {
+  forever {
+    StartJobStatus status = MaybeStartNextJob();
+    if (status == AllThreadsBusy || status == NoMoreJobs) break;
+  }
+}
+
 Transcoder::StartJobStatus Transcoder::MaybeStartNextJob() {
   if (current_jobs_.count() >= max_threads()) return AllThreadsBusy;
   if (queued_jobs_.isEmpty()) {
@@ -334,20 +368,33 @@ Transcoder::StartJobStatus Transcoder::MaybeStartNextJob() {
     return NoMoreJobs;
   }
 
+  TranscodeScheduler* scheduler = TranscodeScheduler::Instance();
+  if (!scheduler->TryAcquire(this, priority_)) {
+    // We'll be told when it's our turn.
+    return AllThreadsBusy;
+  }
+
   Job job = queued_jobs_.takeFirst();
   if (StartJob(job)) {
     return StartedSuccessfully;
   }
 
-  emit JobComplete(job.input, job.output, false);
+  scheduler->Release();
+  EmitJobComplete(job, false);
   return FailedToStart;
 }
 
+void Transcoder::EmitJobComplete(const Job& job, bool success) {
+  for (const Output& output : job.outputs) {
+    emit JobComplete(job.input, output.filename, success);
+  }
+}
+
 void Transcoder::NewPadCallback(GstElement*, GstPad* pad,
                                 gpointer data) {
   JobState* state = reinterpret_cast<JobState*>(data);
   GstPad* const audiopad =
-      gst_element_get_static_pad(state->convert_element_, "sink");
+      gst_element_get_static_pad(state->decoded_element_, "sink");
 
   if (GST_PAD_IS_LINKED(audiopad)) {
     qLog(Debug) << "audiopad is already linked, unlinking old pad";
@@ -391,44 +438,38 @@ void Transcoder::JobState::ReportError(GstMessage* msg) {
       QDir::toNativeSeparators(job_.input), message));
 }
 
-bool Transcoder::StartJob(const Job& job) {
-  shared_ptr<JobState> state(new JobState(job, this));
-
-  emit LogLine(tr("Starting %1").arg(QDir::toNativeSeparators(job.input)));
+GstElement* Transcoder::CreateOutputBin(const Output& output, int index,
+                                        GstElement* pipeline) {
+  const TranscoderPreset& preset = output.preset;
 
-  // Create the pipeline.
-  // This should be a scoped_ptr, but scoped_ptr doesn't support custom
-  // destructors.
-  state->pipeline_ = gst_pipeline_new("pipeline");
-  if (!state->pipeline_) return false;
+  // Each output gets its own bin so the elements' names don't clash.
+  GstElement* bin =
+      gst_bin_new(QString("output%1").arg(index).toAscii().constData());
+  gst_bin_add(GST_BIN(pipeline), bin);
 
-  // Create all the elements
-  GstElement* src = CreateElement("filesrc", state->pipeline_);
-  GstElement* decode = CreateElement("decodebin", state->pipeline_);
-  GstElement* convert = CreateElement("audioconvert", state->pipeline_);
-  GstElement* resample = CreateElement("audioresample", state->pipeline_);
+  GstElement* convert = CreateElement("audioconvert", bin);
+  GstElement* resample = CreateElement("audioresample", bin);
   GstElement* codec = CreateElementForMimeType(
-      "Codec/Encoder/Audio", job.preset.codec_mimetype_, state->pipeline_);
-  GstElement* muxer = CreateElementForMimeType(
-      "Codec/Muxer", job.preset.muxer_mimetype_, state->pipeline_);
-  GstElement* sink = CreateElement("filesink", state->pipeline_);
+      "Codec/Encoder/Audio", preset.codec_mimetype_, bin);
+  GstElement* muxer =
+      CreateElementForMimeType("Codec/Muxer", preset.muxer_mimetype_, bin);
+  GstElement* sink = CreateElement("filesink", bin);
 
-  if (!src || !decode || !convert || !sink) return false;
+  if (!convert || !resample || !sink) return nullptr;
 
-  if (!codec && !job.preset.codec_mimetype_.isEmpty()) {
+  if (!codec && !preset.codec_mimetype_.isEmpty()) {
     LogLine(tr("Couldn't find an encoder for %1, check you have the correct "
-               "GStreamer plugins installed").arg(job.preset.codec_mimetype_));
-    return false;
+               "GStreamer plugins installed").arg(preset.codec_mimetype_));
+    return nullptr;
   }
 
-  if (!muxer && !job.preset.muxer_mimetype_.isEmpty()) {
+  if (!muxer && !preset.muxer_mimetype_.isEmpty()) {
     LogLine(tr("Couldn't find a muxer for %1, check you have the correct "
-               "GStreamer plugins installed").arg(job.preset.muxer_mimetype_));
-    return false;
+               "GStreamer plugins installed").arg(preset.muxer_mimetype_));
+    return nullptr;
   }
 
   // Join them together
-  gst_element_link(src, decode);
   if (codec && muxer)
     gst_element_link_many(convert, resample, codec, muxer, sink, nullptr);
   else if (codec)
@@ -436,12 +477,58 @@ bool Transcoder::StartJob(const Job& job) {
   else if (muxer)
     gst_element_link_many(convert, resample, muxer, sink, nullptr);
 
-  // Set properties
+  g_object_set(sink, "location", output.filename.toUtf8().constData(),
+               nullptr);
+
+  GstPad* pad = gst_element_get_static_pad(convert, "sink");
+  gst_element_add_pad(bin, gst_ghost_pad_new("sink", pad));
+  gst_object_unref(GST_OBJECT(pad));
+
+  return bin;
+}
+
+bool Transcoder::StartJob(const Job& job) {
+  shared_ptr<JobState> state(new JobState(job, this));
+
+  emit LogLine(tr("Starting %1").arg(QDir::toNativeSeparators(job.input)));
+
+  // Create the pipeline.
+  // This should be a scoped_ptr, but scoped_ptr doesn't support custom
+  // destructors.
+  state->pipeline_ = gst_pipeline_new("pipeline");
+  if (!state->pipeline_) return false;
+
+  // Create all the elements
+  GstElement* src = CreateElement("filesrc", state->pipeline_);
+  GstElement* decode = CreateElement("decodebin", state->pipeline_);
+  if (!src || !decode || job.outputs.isEmpty()) return false;
+
+  gst_element_link(src, decode);
   g_object_set(src, "location", job.input.toUtf8().constData(), nullptr);
-  g_object_set(sink, "location", job.output.toUtf8().constData(), nullptr);
+
+  if (job.outputs.count() == 1) {
+    state->decoded_element_ =
+        CreateOutputBin(job.outputs[0], 0, state->pipeline_);
+    if (!state->decoded_element_) return false;
+  } else {
+    // Decode once and give the audio to every encoder.  Each branch needs a
+    // queue, or the tee would wait for one branch to preroll before the
+    // others get any data.
+    GstElement* tee = CreateElement("tee", state->pipeline_);
+    if (!tee) return false;
+
+    for (int i = 0; i < job.outputs.count(); ++i) {
+      GstElement* queue = CreateElement("queue", state->pipeline_,
+                                        QString("queue%1").arg(i));
+      GstElement* bin = CreateOutputBin(job.outputs[i], i, state->pipeline_);
+      if (!queue || !bin) return false;
+
+      gst_element_link_many(tee, queue, bin, nullptr);
+    }
+    state->decoded_element_ = tee;
+  }
 
   // Set callbacks
-  state->convert_element_ = convert;
 
   CHECKED_GCONNECT(decode, "pad-added", &NewPadCallback, state.get());
   gst_bus_set_sync_handler(gst_pipeline_get_bus(GST_PIPELINE(state->pipeline_)),
@@ -449,6 +536,7 @@ bool Transcoder::StartJob(const Job& job) {
 
   // Start the pipeline
   gst_element_set_state(state->pipeline_, GST_STATE_PLAYING);
+  state->timer_.start();
 
   // GStreamer now transcodes in another thread, so we can return now and do
   // something else.  Keep the JobState object around.  It'll post an event
@@ -481,8 +569,27 @@ bool Transcoder::event(QEvent* e) {
       return true;
     }
 
-    QString input = (*it)->job_.input;
-    QString output = (*it)->job_.output;
+    const Job job = (*it)->job_;
+    const QString& input = job.input;
+
+    if (finished_event->success_) {
+      // Report how much faster than realtime the job ran, so it's easy to
+      // see how much the other jobs and playback are slowing things down.
+      gint64 duration = 0;
+      const qint64 elapsed_msec = (*it)->timer_.elapsed();
+      if (elapsed_msec > 0 &&
+          gst_element_query_duration((*it)->pipeline_, GST_FORMAT_TIME,
+                                     &duration) &&
+          duration > 0) {
+        const double factor =
+            double(duration / kNsecPerMsec) / double(elapsed_msec);
+        qLog(Debug) << "Transcoded" << input << "at" << factor
+                    << "x realtime";
+        emit LogLine(tr("Transcoded %1 at %2x realtime")
+                         .arg(QDir::toNativeSeparators(input))
+                         .arg(factor, 0, 'f', 1));
+      }
+    }
 
     // Remove event handlers from the gstreamer pipeline so they don't get
     // called after the pipeline is shutting down
@@ -492,9 +599,10 @@ bool Transcoder::event(QEvent* e) {
 
     // Remove it from the list - this will also destroy the GStreamer pipeline
     current_jobs_.erase(it);
+    TranscodeScheduler::Instance()->Release();
 
-    // Emit the finished signal
-    emit JobComplete(input, output, finished_event->success_);
+    // Emit the finished signals
+    EmitJobComplete(job, finished_event->success_);
 
     // Start some more jobs
     MaybeStartNextJob();
@@ -508,8 +616,12 @@ bool Transcoder::event(QEvent* e) {
 void Transcoder::Cancel() {
   // Remove all pending jobs
   queued_jobs_.clear();
+  TranscodeScheduler::Instance()->RemoveWaiter(this);
+
+  StopRunningJobs();
+}
 
-  // Stop the running ones
+void Transcoder::StopRunningJobs() {
   JobStateList::iterator it = current_jobs_.begin();
   while (it != current_jobs_.end()) {
     shared_ptr<JobState> state(*it);
@@ -529,6 +641,7 @@ void Transcoder::Cancel() {
 
     // Remove the job, this destroys the GStreamer pipeline too
     it = current_jobs_.erase(it);
+    TranscodeScheduler::Instance()->Release();
   }
 }
 
@@ -25,9 +25,11 @@
 #include <QObject>
 #include <QStringList>
 #include <QEvent>
+#include <QElapsedTimer>
 #include <QMetaType>
 
 #include "core/song.h"
+#include "transcoder/transcodescheduler.h"
 
 struct TranscoderPreset {
   TranscoderPreset() : type_(Song::Type_Unknown) {}
@@ -48,6 +50,7 @@ class Transcoder : public QObject {
 
  public:
   Transcoder(QObject* parent = nullptr, const QString& settings_postfix = "");
+  ~Transcoder();
 
   static TranscoderPreset PresetForFileType(Song::FileType type);
   static QList<TranscoderPreset> GetAllPresets();
@@ -56,8 +59,21 @@ class Transcoder : public QObject {
   int max_threads() const { return max_threads_; }
   void set_max_threads(int count) { max_threads_ = count; }
 
+  // Jobs also need a slot from the process-wide TranscodeScheduler before
+  // they start; interactive ones are given slots first.
+  TranscodeScheduler::Priority priority() const { return priority_; }
+  void set_priority(TranscodeScheduler::Priority priority) {
+    priority_ = priority;
+  }
+
   void AddJob(const QString& input, const TranscoderPreset& preset,
               const QString& output = QString());
+  // Decodes the input once and encodes it with each of the presets, into the
+  // matching output.  Outputs that aren't given are named as above.
+  // JobComplete is emitted once for each output, but GetProgress has one
+  // entry for the whole job.
+  void AddJob(const QString& input, const QList<TranscoderPreset>& presets,
+              const QStringList& outputs = QStringList());
   void AddTemporaryJob(const QString& input, const TranscoderPreset& preset);
 
   QMap<QString, float> GetProgress() const;
@@ -75,12 +91,21 @@ signals:
  protected:
   bool event(QEvent* e);
 
+ private slots:
+  // Called by the TranscodeScheduler when a slot becomes free.
+  void StartQueuedJobs();
+
  private:
+  // A file for a job to write, and how to encode it.
+  struct Output {
+    QString filename;
+    TranscoderPreset preset;
+  };
+
   // The description of a file to transcode - lives in the main thread.
   struct Job {
     QString input;
-    QString output;
-    TranscoderPreset preset;
+    QList<Output> outputs;
   };
 
   // State held by a job and shared across gstreamer callbacks - lives in the
@@ -90,7 +115,7 @@ signals:
         : job_(job),
           parent_(parent),
           pipeline_(nullptr),
-          convert_element_(nullptr) {}
+          decoded_element_(nullptr) {}
     ~JobState();
 
     void PostFinished(bool success);
@@ -99,7 +124,10 @@ signals:
     Job job_;
     Transcoder* parent_;
     GstElement* pipeline_;
-    GstElement* convert_element_;
+    // Where decodebin's audio goes: the only output's bin, or a tee that
+    // feeds all of them.
+    GstElement* decoded_element_;
+    QElapsedTimer timer_;
   };
 
   // Event passed from a GStreamer callback to the Transcoder when a job
@@ -122,6 +150,19 @@ signals:
 
   StartJobStatus MaybeStartNextJob();
   bool StartJob(const Job& job);
+  void StopRunningJobs();
+  // Emits JobComplete for each of the job's outputs.
+  void EmitJobComplete(const Job& job, bool success);
+
+  // Never overwrites an existing file, or one of the other outputs.
+  static QString OutputFilename(const QString& input,
+                                const TranscoderPreset& preset,
+                                const QString& output,
+                                const QStringList& taken);
+  // Creates a bin in the pipeline that converts, encodes and writes one
+  // output, with a "sink" ghost pad.
+  GstElement* CreateOutputBin(const Output& output, int index,
+                              GstElement* pipeline);
 
   GstElement* CreateElement(const QString& factory_name,
                             GstElement* bin = nullptr,
@@ -139,6 +180,7 @@ signals:
   typedef QList<std::shared_ptr<JobState>> JobStateList;
 
   int max_threads_;
+  TranscodeScheduler::Priority priority_;
   QList<Job> queued_jobs_;
   JobStateList current_jobs_;
   QString settings_postfix_;
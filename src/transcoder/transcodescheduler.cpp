@@ -0,0 +1,105 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "transcodescheduler.h"
+
+#include <QMetaObject>
+#include <QThread>
+
+#include "transcoder.h"
+
+TranscodeScheduler* TranscodeScheduler::Instance() {
+  static TranscodeScheduler instance;
+  return &instance;
+}
+
+TranscodeScheduler::TranscodeScheduler()
+    : ideal_thread_count_(qMax(1, QThread::idealThreadCount())),
+      playback_active_(false),
+      running_jobs_(0) {}
+
+int TranscodeScheduler::CapacityLocked(Priority priority) const {
+  int capacity = ideal_thread_count_;
+  if (playback_active_) capacity--;
+  if (priority == Priority_Interactive) capacity++;
+  return qMax(1, capacity);
+}
+
+bool TranscodeScheduler::TryAcquire(Transcoder* transcoder,
+                                    Priority priority) {
+  QMutexLocker l(&mutex_);
+
+  bool more_important_waiting = false;
+  for (QMap<Transcoder*, Priority>::const_iterator it = waiters_.constBegin();
+       it != waiters_.constEnd(); ++it) {
+    if (it.key() != transcoder && it.value() > priority) {
+      more_important_waiting = true;
+      break;
+    }
+  }
+
+  if (!more_important_waiting && running_jobs_ < CapacityLocked(priority)) {
+    running_jobs_++;
+    waiters_.remove(transcoder);
+    return true;
+  }
+
+  waiters_[transcoder] = priority;
+  return false;
+}
+
+void TranscodeScheduler::Release() {
+  QMutexLocker l(&mutex_);
+  running_jobs_ = qMax(0, running_jobs_ - 1);
+  WakeWaitersLocked();
+}
+
+void TranscodeScheduler::RemoveWaiter(Transcoder* transcoder) {
+  QMutexLocker l(&mutex_);
+  waiters_.remove(transcoder);
+}
+
+void TranscodeScheduler::SetPlaybackActive(bool active) {
+  QMutexLocker l(&mutex_);
+  if (playback_active_ == active) return;
+  playback_active_ = active;
+  WakeWaitersLocked();
+}
+
+int TranscodeScheduler::running_jobs() const {
+  QMutexLocker l(&mutex_);
+  return running_jobs_;
+}
+
+void TranscodeScheduler::WakeWaitersLocked() {
+  // Wake the most important waiter for each free slot.  Each one calls
+  // TryAcquire() again from its own thread, so it's fine if a slot has been
+  // taken by someone else by then.
+  int free_slots = CapacityLocked(Priority_Interactive) - running_jobs_;
+  while (free_slots-- > 0 && !waiters_.isEmpty()) {
+    QMap<Transcoder*, Priority>::iterator best = waiters_.begin();
+    for (QMap<Transcoder*, Priority>::iterator it = waiters_.begin();
+         it != waiters_.end(); ++it) {
+      if (it.value() > best.value()) best = it;
+    }
+
+    Transcoder* transcoder = best.key();
+    waiters_.erase(best);
+    QMetaObject::invokeMethod(transcoder, "StartQueuedJobs",
+                              Qt::QueuedConnection);
+  }
+}
@@ -0,0 +1,68 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRANSCODESCHEDULER_H
+#define TRANSCODESCHEDULER_H
+
+#include <QMap>
+#include <QMutex>
+
+class Transcoder;
+
+// Shares a fixed number of pipeline slots between every Transcoder in the
+// process, so a background conversion, an organise job and a remote download
+// running at the same time don't each start a pipeline per core.  One core is
+// left free while music is playing.  Transcoders waiting for a slot are woken
+// in priority order.
+class TranscodeScheduler {
+ public:
+  enum Priority {
+    Priority_Background = 0,
+    Priority_Interactive = 1,
+  };
+
+  static TranscodeScheduler* Instance();
+
+  // Takes a slot for a new pipeline if one is free and nothing more important
+  // is waiting.  Otherwise the transcoder is remembered, and its
+  // StartQueuedJobs() slot is invoked later when a slot frees up.
+  // Interactive jobs may use one slot more than background ones so they don't
+  // have to wait behind a long conversion.
+  bool TryAcquire(Transcoder* transcoder, Priority priority);
+  void Release();
+
+  // Forgets about a transcoder that no longer wants a slot.
+  void RemoveWaiter(Transcoder* transcoder);
+
+  void SetPlaybackActive(bool active);
+
+  int running_jobs() const;
+
+ private:
+  TranscodeScheduler();
+
+  int CapacityLocked(Priority priority) const;
+  void WakeWaitersLocked();
+
+  mutable QMutex mutex_;
+  const int ideal_thread_count_;
+  bool playback_active_;
+  int running_jobs_;
+  QMap<Transcoder*, Priority> waiters_;
+};
+
+#endif  // TRANSCODESCHEDULER_H
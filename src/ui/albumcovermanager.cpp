@@ -48,11 +48,13 @@
 #include <QMessageBox>
 #include <QPainter>
 #include <QProgressBar>
+#include <QScrollBar>
 #include <QSettings>
 #include <QShortcut>
 #include <QTimer>
 
 const char* AlbumCoverManager::kSettingsGroup = "CoverManager";
+const int AlbumCoverManager::kLoadCoversDelayMsec = 100;
 
 AlbumCoverManager::AlbumCoverManager(Application* app,
                                      LibraryBackend* library_backend,
@@ -77,10 +79,17 @@ AlbumCoverManager::AlbumCoverManager(Application* app,
       progress_bar_(new QProgressBar(this)),
       abort_progress_(new QPushButton(this)),
       jobs_(0),
-      library_backend_(library_backend) {
+      library_backend_(library_backend),
+      load_covers_timer_(new QTimer(this)) {
   ui_->setupUi(this);
   ui_->albums->set_cover_manager(this);
 
+  load_covers_timer_->setSingleShot(true);
+  load_covers_timer_->setInterval(kLoadCoversDelayMsec);
+  connect(load_covers_timer_, SIGNAL(timeout()), SLOT(LoadVisibleCovers()));
+  connect(ui_->albums->verticalScrollBar(), SIGNAL(valueChanged(int)),
+          load_covers_timer_, SLOT(start()));
+
   // Icons
   ui_->action_fetch->setIcon(IconLoader::Load("download", IconLoader::Base));
   ui_->export_covers->setIcon(
@@ -195,6 +204,9 @@ void AlbumCoverManager::Init() {
     // Sensible default size for the artists view
     ui_->splitter->setSizes(QList<int>() << 200 << width() - 200);
   }
+  cover_exporter_->SetMaxConcurrentRequests(
+      s.value("export_threads", AlbumCoverExporter::kMaxConcurrentRequests)
+          .toInt());
 
   connect(app_->album_cover_loader(), SIGNAL(ImageLoaded(quint64, QImage)),
           SLOT(CoverImageLoaded(quint64, QImage)));
@@ -338,13 +350,11 @@ void AlbumCoverManager::ArtistChanged(QListWidgetItem* current) {
       item->setToolTip(info.album_name);
     }
 
+    // The cover itself is loaded once the item is scrolled near the viewport
     if (!info.art_automatic.isEmpty() || !info.art_manual.isEmpty()) {
-      quint64 id = app_->album_cover_loader()->LoadImageAsync(
-          cover_loader_options_, info.art_automatic, info.art_manual,
-          info.first_url.toLocalFile());
       item->setData(Role_PathAutomatic, info.art_automatic);
       item->setData(Role_PathManual, info.art_manual);
-      cover_loading_tasks_[id] = item;
+      item->setData(Role_CoverPending, true);
     }
   }
 
@@ -355,13 +365,59 @@ void AlbumCoverManager::CoverImageLoaded(quint64 id, const QImage& image) {
   if (!cover_loading_tasks_.contains(id)) return;
 
   QListWidgetItem* item = cover_loading_tasks_.take(id);
+  item->setData(Role_CoverPending, false);
 
-  if (image.isNull()) return;
-
-  item->setIcon(QPixmap::fromImage(image));
+  if (!image.isNull()) item->setIcon(QPixmap::fromImage(image));
   UpdateFilter();
 }
 
+bool AlbumCoverManager::IsNearViewport(const QListWidgetItem* item,
+                                       const QRect& rect) const {
+  return !item->isHidden() &&
+         ui_->albums->visualItemRect(item).intersects(rect);
+}
+
+void AlbumCoverManager::LoadVisibleCovers() {
+  // Load the covers of albums that are visible or within a page of the
+  // viewport, and stop loading the ones that have been scrolled away from.
+  const QRect viewport = ui_->albums->viewport()->rect();
+  const QRect near_viewport =
+      viewport.adjusted(0, -viewport.height(), 0, viewport.height());
+
+  QSet<QListWidgetItem*> loading;
+  QSet<quint64> cancelled;
+  for (auto it = cover_loading_tasks_.begin();
+       it != cover_loading_tasks_.end();) {
+    QListWidgetItem* item = it.value();
+    if (item->data(Role_CoverPending).toBool() &&
+        !IsNearViewport(item, near_viewport)) {
+      cancelled << it.key();
+      it = cover_loading_tasks_.erase(it);
+    } else {
+      loading << item;
+      ++it;
+    }
+  }
+
+  if (!cancelled.isEmpty()) {
+    app_->album_cover_loader()->CancelTasks(cancelled);
+  }
+
+  for (int i = 0; i < ui_->albums->count(); ++i) {
+    QListWidgetItem* item = ui_->albums->item(i);
+    if (!item->data(Role_CoverPending).toBool() || loading.contains(item) ||
+        !IsNearViewport(item, near_viewport)) {
+      continue;
+    }
+
+    quint64 id = app_->album_cover_loader()->LoadImageAsync(
+        cover_loader_options_, item->data(Role_PathAutomatic).toString(),
+        item->data(Role_PathManual).toString(),
+        item->data(Role_FirstUrl).toUrl().toLocalFile());
+    cover_loading_tasks_[id] = item;
+  }
+}
+
 void AlbumCoverManager::UpdateFilter() {
   const QString filter = ui_->filter->text().toLower();
   const bool hide_with_covers = filter_without_covers_->isChecked();
@@ -392,6 +448,9 @@ void AlbumCoverManager::UpdateFilter() {
 
   ui_->total_albums->setText(QString::number(total_count));
   ui_->without_cover->setText(QString::number(without_cover));
+
+  // Hiding items moves the others into view
+  load_covers_timer_->start();
 }
 
 bool AlbumCoverManager::ShouldHide(const QListWidgetItem& item,
@@ -430,7 +489,8 @@ void AlbumCoverManager::FetchAlbumCovers() {
     if (ItemHasCover(*item)) continue;
 
     quint64 id = cover_fetcher_->FetchAlbumCover(
-        EffectiveAlbumArtistName(*item), item->data(Role_AlbumName).toString());
+        EffectiveAlbumArtistName(*item), item->data(Role_AlbumName).toString(),
+        true);
     cover_fetching_tasks_[id] = item;
     jobs_++;
   }
@@ -491,6 +551,10 @@ void AlbumCoverManager::UpdateStatusText() {
 }
 
 bool AlbumCoverManager::eventFilter(QObject* obj, QEvent* event) {
+  if (obj == ui_->albums && event->type() == QEvent::Resize) {
+    load_covers_timer_->start();
+  }
+
   if (obj == ui_->albums && event->type() == QEvent::ContextMenu) {
     context_menu_items_ = ui_->albums->selectedItems();
     if (context_menu_items_.isEmpty()) return false;
@@ -582,6 +646,7 @@ void AlbumCoverManager::UpdateCoverInList(QListWidgetItem* item,
   quint64 id = app_->album_cover_loader()->LoadImageAsync(cover_loader_options_,
                                                           QString(), cover);
   item->setData(Role_PathManual, cover);
+  item->setData(Role_CoverPending, false);
   cover_loading_tasks_[id] = item;
 }
 
@@ -667,6 +732,7 @@ void AlbumCoverManager::UnsetCover() {
   for (QListWidgetItem* current : context_menu_items_) {
     current->setIcon(no_cover_item_icon_);
     current->setData(Role_PathManual, cover);
+    current->setData(Role_CoverPending, false);
 
     // don't save the first one twice
     if (current != item) {
@@ -763,6 +829,7 @@ void AlbumCoverManager::SaveAndSetCover(QListWidgetItem* item,
   quint64 id = app_->album_cover_loader()->LoadImageAsync(cover_loader_options_,
                                                           QString(), path);
   item->setData(Role_PathManual, path);
+  item->setData(Role_CoverPending, false);
   cover_loading_tasks_[id] = item;
 }
 
@@ -855,5 +922,7 @@ QImage AlbumCoverManager::GenerateNoCoverImage(
 }
 
 bool AlbumCoverManager::ItemHasCover(const QListWidgetItem& item) const {
+  // Covers that haven't been scrolled into view yet still count
+  if (item.data(Role_CoverPending).toBool()) return true;
   return item.icon().cacheKey() != no_cover_item_icon_.cacheKey();
 }
@@ -43,6 +43,7 @@ class QMenu;
 class QNetworkAccessManager;
 class QPushButton;
 class QProgressBar;
+class QTimer;
 
 class AlbumCoverManager : public QMainWindow {
   Q_OBJECT
@@ -80,6 +81,7 @@ signals:
  private slots:
   void ArtistChanged(QListWidgetItem* current);
   void CoverImageLoaded(quint64 id, const QImage& image);
+  void LoadVisibleCovers();
   void UpdateFilter();
   void FetchAlbumCovers();
   void ExportCovers();
@@ -119,6 +121,7 @@ signals:
     Role_PathAutomatic,
     Role_PathManual,
     Role_FirstUrl,
+    Role_CoverPending,
   };
 
   enum HideCovers {
@@ -148,7 +151,11 @@ signals:
                   HideCovers hide) const;
   void SaveAndSetCover(QListWidgetItem* item, const QImage& image);
 
+  bool IsNearViewport(const QListWidgetItem* item, const QRect& rect) const;
+
  private:
+  static const int kLoadCoversDelayMsec;
+
   Ui_CoverManager* ui_;
   Application* app_;
 
@@ -187,6 +194,9 @@ signals:
 
   LibraryBackend* library_backend_;
 
+  // Batches the cover loads while the album view is scrolled or resized
+  QTimer* load_covers_timer_;
+
   FRIEND_TEST(AlbumCoverManagerTest, HidesItemsWithCover);
   FRIEND_TEST(AlbumCoverManagerTest, HidesItemsWithoutCover);
   FRIEND_TEST(AlbumCoverManagerTest, HidesItemsWithFilter);
@@ -1,23 +1,45 @@
 #include "console.h"
 
 #include <QFont>
+#include <QPixmapCache>
 #include <QScrollBar>
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlRecord>
+#include <QTextDocument>
 
 #include "core/application.h"
 #include "core/database.h"
+#include "core/memorymonitor.h"
+#include "core/playbacktrace.h"
+#include "core/player.h"
+#include "core/startupscheduler.h"
+#include "core/tagreaderclient.h"
+#include "core/taskmanager.h"
+#include "covers/albumcoverloader.h"
+#include "engines/gstengine.h"
+#include "playlist/playlistitem.h"
+
+const int Console::kCountersUpdateMsec = 1000;
 
 Console::Console(Application* app, QWidget* parent)
-    : QDialog(parent), app_(app) {
+    : QDialog(parent), app_(app), last_finished_task_count_(0) {
   ui_.setupUi(this);
   connect(ui_.run, SIGNAL(clicked()), SLOT(RunQuery()));
+  connect(ui_.latency, SIGNAL(clicked()), SLOT(ShowPlaybackLatency()));
+  connect(ui_.startup, SIGNAL(clicked()), SLOT(ShowStartupTimes()));
+  connect(ui_.performance, SIGNAL(toggled(bool)),
+          SLOT(PerformanceToggled(bool)));
+
+  ui_.counters->hide();
+  counters_timer_.setInterval(kCountersUpdateMsec);
+  connect(&counters_timer_, SIGNAL(timeout()), SLOT(UpdateCounters()));
 
   QFont font("Monospace");
   font.setStyleHint(QFont::TypeWriter);
 
   ui_.output->setFont(font);
+  ui_.counters->setFont(font);
   ui_.query->setFont(font);
 }
 
@@ -45,3 +67,116 @@ void Console::RunQuery() {
   ui_.output->verticalScrollBar()->setValue(
       ui_.output->verticalScrollBar()->maximum());
 }
+
+void Console::ShowPlaybackLatency() {
+  const PlaybackTrace* trace = PlaybackTrace::Instance();
+
+  ui_.output->append("<b>&gt; playback latency</b>");
+  for (const QString& line : trace->Report()) {
+    ui_.output->append(Qt::escape(line));
+  }
+  const QString summary = trace->Summary();
+  if (!summary.isEmpty()) ui_.output->append(summary);
+
+  ui_.output->verticalScrollBar()->setValue(
+      ui_.output->verticalScrollBar()->maximum());
+}
+
+void Console::ShowStartupTimes() {
+  ui_.output->append("<b>&gt; startup times</b>");
+  for (const QString& line : app_->startup_scheduler()->Report()) {
+    ui_.output->append(Qt::escape(line));
+  }
+
+  ui_.output->verticalScrollBar()->setValue(
+      ui_.output->verticalScrollBar()->maximum());
+}
+
+void Console::PerformanceToggled(bool enabled) {
+  ui_.counters->setVisible(enabled);
+  if (!enabled) {
+    counters_timer_.stop();
+    return;
+  }
+
+  last_finished_task_count_ = app_->task_manager()->finished_task_count();
+  counters_elapsed_.start();
+  counters_timer_.start();
+  UpdateCounters();
+}
+
+void Console::UpdateCounters() {
+  QStringList lines;
+
+  const Database::ReadPoolStatistics db =
+      app_->database()->read_pool_statistics();
+  lines << QString("Database read connections: %1, %2 acquired")
+               .arg(db.pool_size)
+               .arg(db.acquisitions);
+  lines << QString("  waited %1 ms in total, %2 ms at most")
+               .arg(db.total_wait_us / 1000.0, 0, 'f', 1)
+               .arg(db.max_wait_us / 1000.0, 0, 'f', 1);
+
+  TagReaderClient* tag_reader = TagReaderClient::Instance();
+  if (tag_reader) {
+    lines << QString("Tag reader requests queued: %1")
+                 .arg(tag_reader->queued_request_count());
+  }
+
+  const AlbumCoverLoader::Statistics covers =
+      app_->album_cover_loader()->statistics();
+  const int lookups = covers.cache_hits + covers.cache_misses;
+  lines << QString("Album cover tasks: %1 queued, %2 decoding")
+               .arg(covers.queued_tasks)
+               .arg(covers.decoding_tasks);
+  lines << QString("  cache hit rate %1% of %2 lookups")
+               .arg(lookups ? covers.cache_hits * 100.0 / lookups : 0.0, 0,
+                    'f', 1)
+               .arg(lookups);
+
+  GstEngine* engine = qobject_cast<GstEngine*>(app_->player()->engine());
+  if (engine) {
+    lines << QString("Audio buffers dropped: %1, late: %2")
+                 .arg(engine->dropped_buffers())
+                 .arg(engine->late_buffers());
+  }
+
+  TaskManager* task_manager = app_->task_manager();
+  const int finished = task_manager->finished_task_count();
+  const qint64 elapsed_msec = counters_elapsed_.restart();
+  const double tasks_per_sec =
+      elapsed_msec ? (finished - last_finished_task_count_) * 1000.0 /
+                         elapsed_msec
+                   : 0.0;
+  last_finished_task_count_ = finished;
+  lines << QString("Tasks: %1 started, %2 finished, %3 per second")
+               .arg(task_manager->started_task_count())
+               .arg(finished)
+               .arg(tasks_per_sec, 0, 'f', 1);
+
+  // Strings and images aren't counted, these are only the objects themselves.
+  const int songs = Song::live_data_count();
+  const int items = PlaylistItem::live_count();
+  lines << QString("Song data: %1 (%2 KiB)")
+               .arg(songs)
+               .arg(qint64(songs) * Song::data_size() / 1024);
+  lines << QString("Playlist items: %1 (%2 KiB)")
+               .arg(items)
+               .arg(qint64(items) * sizeof(PlaylistItem) / 1024);
+
+  lines << "Memory:";
+  for (const MemoryMonitor::Usage& usage :
+       app_->memory_monitor()->Measure()) {
+    QString line =
+        QString("  %1: %2 KiB").arg(usage.name).arg(usage.bytes / 1024);
+    if (usage.budget_bytes > 0) {
+      line += QString(" of %1 KiB").arg(usage.budget_bytes / 1024);
+    }
+    lines << line;
+  }
+  // Qt4 can't say how much of this is in use.
+  lines << QString("  Pixmap cache limit: %1 KiB")
+               .arg(QPixmapCache::cacheLimit());
+
+  ui_.counters->setPlainText(lines.join("\n"));
+}
@@ -2,6 +2,8 @@
 #define CONSOLE_H
 
 #include <QDialog>
+#include <QElapsedTimer>
+#include <QTimer>
 
 #include "ui_console.h"
 
@@ -14,10 +16,22 @@ class Console : public QDialog {
 
  private slots:
   void RunQuery();
+  void ShowPlaybackLatency();
+  void ShowStartupTimes();
+  void PerformanceToggled(bool enabled);
+  void UpdateCounters();
 
  private:
+  static const int kCountersUpdateMsec;
+
   Ui::Console ui_;
   Application* app_;
+
+  // While the performance panel is shown it's refreshed by this timer.  The
+  // last update's finished task count is kept to work out the throughput.
+  QTimer counters_timer_;
+  QElapsedTimer counters_elapsed_;
+  int last_finished_task_count_;
 };
 
 #endif  // CONSOLE_H
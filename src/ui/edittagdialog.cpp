@@ -33,7 +33,9 @@
 
 #include "core/application.h"
 #include "core/logging.h"
+#include "core/savetags.h"
 #include "core/tagreaderclient.h"
+#include "core/taskmanager.h"
 #include "core/utilities.h"
 #include "covers/albumcoverloader.h"
 #include "covers/coverproviders.h"
@@ -57,10 +59,13 @@ EditTagDialog::EditTagDialog(Application* app, QWidget* parent)
       album_cover_choice_controller_(new AlbumCoverChoiceController(this)),
       loading_(false),
       ignore_edits_(false),
-      tag_fetcher_(new TagFetcher(this)),
+      tag_fetcher_(new TagFetcher(app->database(), this)),
       cover_art_id_(0),
       cover_art_is_set_(false),
       results_dialog_(new TrackSelectionDialog(this)) {
+  // The full size cover is shown when the art is clicked
+  cover_options_.need_original_image_ = true;
+
   QIcon nocover = IconLoader::Load("nocover", IconLoader::Other);
   cover_options_.default_output_image_ =
       AlbumCoverLoader::ScaleAndPad(cover_options_,
@@ -693,30 +698,32 @@ void EditTagDialog::ButtonClicked(QAbstractButton* button) {
   }
 }
 
-void EditTagDialog::SaveData(const QList<Data>& data) {
-  for (int i = 0; i < data.count(); ++i) {
-    const Data& ref = data[i];
-    if (ref.current_.IsMetadataEqual(ref.original_)) continue;
-
-    if (!TagReaderClient::Instance()->SaveFileBlocking(
-            ref.current_.url().toLocalFile(), ref.current_)) {
-      emit Error(tr("An error occurred writing metadata to '%1'")
-                     .arg(ref.current_.url().toLocalFile()));
-    }
-  }
-}
-
 void EditTagDialog::accept() {
   // Show the loading indicator
   if (!SetLoading(tr("Saving tracks") + "...")) return;
 
+  SongList songs;
+  for (const Data& data : data_) {
+    if (!data.current_.IsMetadataEqual(data.original_)) {
+      songs << data.current_;
+    }
+  }
+
   // Save tags in the background
-  QFuture<void> future =
-      QtConcurrent::run(this, &EditTagDialog::SaveData, data_);
-  NewClosure(future, this, SLOT(AcceptFinished()));
-}
+  SaveTags* save_tags = new SaveTags(app_->tag_reader_client(),
+                                     app_->task_manager(),
+                                     app_->library_backend());
+  connect(save_tags, SIGNAL(Finished(SongList)),
+          SLOT(AcceptFinished(SongList)));
+  save_tags->Start(songs);
+}
+
+void EditTagDialog::AcceptFinished(const SongList& songs_with_errors) {
+  for (const Song& song : songs_with_errors) {
+    emit Error(tr("An error occurred writing metadata to '%1'")
+                   .arg(song.url().toLocalFile()));
+  }
 
-void EditTagDialog::AcceptFinished() {
   if (!SetLoading(QString())) return;
 
   QDialog::accept();
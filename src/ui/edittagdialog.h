@@ -84,7 +84,7 @@ signals:
 
  private slots:
   void SetSongsFinished(QFuture<QList<EditTagDialog::Data>> future);
-  void AcceptFinished();
+  void AcceptFinished(const SongList& songs_with_errors);
 
   void SelectionChanged();
   void FieldValueEdited();
@@ -140,7 +140,6 @@ signals:
 
   // Called by QtConcurrentRun
   QList<Data> LoadData(const SongList& songs) const;
-  void SaveData(const QList<Data>& data);
 
  private:
   Ui_EditTagDialog* ui_;
@@ -23,12 +23,15 @@
 
 #include <QtDebug>
 #include <QDir>
+#include <QDirIterator>
 #include <QSettings>
 
 QList<int> IconLoader::sizes_;
 QString IconLoader::custom_icon_path_;
 QList<QString> IconLoader::icon_sub_path_;
 bool IconLoader::use_sys_icons_;
+QSet<QString> IconLoader::files_;
+QHash<QString, QIcon> IconLoader::cache_;
 
 void IconLoader::Init() {
   sizes_.clear();
@@ -39,9 +42,38 @@ void IconLoader::Init() {
   QSettings settings;
   settings.beginGroup(Appearance::kSettingsGroup);
   use_sys_icons_ = settings.value("b_use_sys_icons", false).toBool();
+
+  cache_.clear();
+  files_.clear();
+  for (int type = Base; type <= Other; ++type) {
+    // The Lastfm and Other icons aren't in size subdirectories, and Other's
+    // are in the root of the resources.
+    const bool recursive = type == Base || type == Provider;
+    ListFiles(custom_icon_path_ + icon_sub_path_.at(type), recursive);
+    ListFiles(":" + icon_sub_path_.at(type), recursive);
+  }
+}
+
+void IconLoader::ListFiles(const QString& path, bool recursive) {
+  QDirIterator it(path, QDir::Files, recursive ? QDirIterator::Subdirectories
+                                               : QDirIterator::NoIteratorFlags);
+  while (it.hasNext()) {
+    files_.insert(it.next());
+  }
 }
 
 QIcon IconLoader::Load(const QString& name, const IconType& icontype) {
+  // Most icons are asked for by more than one widget.
+  const QString key = QString::number(icontype) + "/" + name;
+  QHash<QString, QIcon>::const_iterator it = cache_.constFind(key);
+  if (it != cache_.constEnd()) return it.value();
+
+  const QIcon ret = LoadUncached(name, icontype);
+  cache_.insert(key, ret);
+  return ret;
+}
+
+QIcon IconLoader::LoadUncached(const QString& name, const IconType& icontype) {
   QIcon ret;
   // If the icon name is empty
   if (name.isEmpty()) {
@@ -62,24 +94,22 @@ QIcon IconLoader::Load(const QString& name, const IconType& icontype) {
   case Provider: {
     const QString custom_icon_location = custom_icon_path_
         + icon_sub_path_.at(icontype);
-    if (QDir(custom_icon_location).exists()) {
-      // Try to load icons from the custom icon location initially
-      const QString locate(custom_icon_location + "/%1x%2/%3.png");
-      for (int size : sizes_) {
-        QString filename_custom(locate.arg(size).arg(size).arg(name));
+    // Try to load icons from the custom icon location initially
+    const QString locate(custom_icon_location + "/%1x%2/%3.png");
+    for (int size : sizes_) {
+      QString filename_custom(locate.arg(size).arg(size).arg(name));
 
-        if (QFile::exists(filename_custom)) ret.addFile(filename_custom,
+      if (files_.contains(filename_custom)) ret.addFile(filename_custom,
                                                         QSize(size, size));
-      }
-      if (!ret.isNull()) return ret;
     }
+    if (!ret.isNull()) return ret;
 
     // Otherwise use our fallback theme
     const QString path(":" + icon_sub_path_.at(icontype) + "/%1x%2/%3.png");
     for (int size : sizes_) {
       QString filename(path.arg(size).arg(size).arg(name));
 
-      if (QFile::exists(filename)) ret.addFile(filename, QSize(size, size));
+      if (files_.contains(filename)) ret.addFile(filename, QSize(size, size));
     }
     break;
   }
@@ -89,20 +119,18 @@ QIcon IconLoader::Load(const QString& name, const IconType& icontype) {
     // lastfm icons location
     const QString custom_fm_other_icon_location = custom_icon_path_
         + icon_sub_path_.at(icontype);
-    if (QDir(custom_fm_other_icon_location).exists()) {
-      // Try to load icons from the custom icon location initially
-      const QString locate_file(
-          custom_fm_other_icon_location + "/" + name + ".png");
+    // Try to load icons from the custom icon location initially
+    const QString locate_file(
+        custom_fm_other_icon_location + "/" + name + ".png");
 
-      if (QFile::exists(locate_file)) ret.addFile(locate_file);
-      if (!ret.isNull()) return ret;
-    }
+    if (files_.contains(locate_file)) ret.addFile(locate_file);
+    if (!ret.isNull()) return ret;
 
     // Otherwise use our fallback theme
     const QString path_file(":" + icon_sub_path_.at(icontype)
         + "/" + name + ".png");
 
-    if (QFile::exists(path_file)) ret.addFile(path_file);
+    if (files_.contains(path_file)) ret.addFile(path_file);
     break;
   }
 
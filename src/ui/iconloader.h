@@ -19,7 +19,9 @@
 #ifndef ICONLOADER_H
 #define ICONLOADER_H
 
+#include <QHash>
 #include <QIcon>
+#include <QSet>
 
 class IconLoader {
  public:
@@ -30,16 +32,25 @@ class IconLoader {
     Other = 3
   };
 
+  // Must be called again when the icon settings change.
   static void Init();
   static QIcon Load(const QString& name, const IconType& icontype);
 
  private:
   IconLoader() {}
 
+  static QIcon LoadUncached(const QString& name, const IconType& icontype);
+  // Lists the files in the icon directories, so looking for an icon doesn't
+  // have to ask the filesystem about every size of it.
+  static void ListFiles(const QString& path, bool recursive);
+
   static QList<int> sizes_;
   static QString custom_icon_path_;
   static QList<QString> icon_sub_path_;
   static bool use_sys_icons_;
+
+  static QSet<QString> files_;
+  static QHash<QString, QIcon> cache_;
 };
 
 #endif  // ICONLOADER_H
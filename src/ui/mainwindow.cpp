@@ -25,6 +25,7 @@
 #include <QDir>
 #include <QFileDialog>
 #include <QFileSystemModel>
+#include <QInputDialog>
 #include <QLinearGradient>
 #include <QMenu>
 #include <QMessageBox>
@@ -57,12 +58,14 @@
 #include "core/network.h"
 #include "core/player.h"
 #include "core/songloader.h"
+#include "core/startupscheduler.h"
 #include "core/stylesheetloader.h"
 #include "core/taskmanager.h"
 #include "core/timeconstants.h"
 #include "core/utilities.h"
 #include "devices/devicemanager.h"
 #include "devices/devicestatefiltermodel.h"
+#include "devices/devicesync.h"
 #include "devices/deviceview.h"
 #include "devices/deviceviewcontainer.h"
 #include "engines/enginebase.h"
@@ -76,6 +79,7 @@
 #include "internet/internetradio/savedradio.h"
 #include "internet/magnatune/magnatuneservice.h"
 #include "internet/podcasts/podcastservice.h"
+#include "library/duplicatesongsdialog.h"
 #include "library/groupbydialog.h"
 #include "library/library.h"
 #include "library/librarybackend.h"
@@ -99,6 +103,7 @@
 #endif
 #include "smartplaylists/generator.h"
 #include "smartplaylists/generatormimedata.h"
+#include "smartplaylists/similargenerator.h"
 #include "songinfo/artistinfoview.h"
 #include "songinfo/songinfoview.h"
 #include "songinfo/streamdiscoverer.h"
@@ -213,6 +218,12 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
         manager->SetPlaylistManager(app->playlist_manager());
         return manager;
       }),
+      duplicate_songs_dialog_([=]() {
+        DuplicateSongsDialog* dialog = new DuplicateSongsDialog(app->library());
+        connect(dialog, SIGNAL(AddToPlaylist(QMimeData*)), this,
+                SLOT(AddToPlaylist(QMimeData*)));
+        return dialog;
+      }),
       playlist_menu_(new QMenu(this)),
       playlist_add_to_another_(nullptr),
       playlistitem_actions_separator_(nullptr),
@@ -225,6 +236,7 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
       doubleclick_playmode_(PlayBehaviour_IfStopped),
       menu_playmode_(PlayBehaviour_IfStopped) {
   qLog(Debug) << "Starting";
+  StartupScheduler* startup = app_->startup_scheduler();
 
   connect(app, SIGNAL(ErrorAdded(QString)), SLOT(ShowErrorDialog(QString)));
   connect(app, SIGNAL(SettingsDialogRequested(SettingsDialog::Page)),
@@ -297,11 +309,14 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
   connect(track_slider_timer_, SIGNAL(timeout()),
           SLOT(UpdateTrackSliderPosition()));
 
+  startup->StageFinished("Main window widgets");
+
   // Start initialising the player
   qLog(Debug) << "Initialising player";
   app_->player()->Init();
   background_streams_ = new BackgroundStreams(app_->player()->engine(), this);
   background_streams_->LoadStreams();
+  startup->StageFinished("Player");
 
   // Models
   qLog(Debug) << "Creating models";
@@ -318,9 +333,13 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
 
   library_view_->view()->setModel(library_sort_model_);
   library_view_->view()->SetApplication(app_);
-  internet_view_->SetApplication(app_);
-  device_view_->SetApplication(app_);
   playlist_list_->SetApplication(app_);
+  startup->StageFinished("Library and playlist models");
+
+  // This creates all the internet services.  They have to be there before the
+  // playlists are loaded, so their items and URL handlers work.
+  internet_view_->SetApplication(app_);
+  startup->StageFinished("Internet services");
 
   // Icons
   qLog(Debug) << "Creating UI";
@@ -404,6 +423,7 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
   connect(file_view_, SIGNAL(CopyToDevice(QList<QUrl>)),
           SLOT(CopyFilesToDevice(QList<QUrl>)));
   file_view_->SetTaskManager(app_->task_manager());
+  file_view_->SetLibraryBackend(app_->library_backend());
 
   // Action connections
   connect(ui_->action_next_track, SIGNAL(triggered()), app_->player(),
@@ -471,6 +491,12 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
           SLOT(IncrementalScan()));
   connect(ui_->action_full_library_scan, SIGNAL(triggered()), app_->library(),
           SLOT(FullScan()));
+  connect(ui_->action_analyse_loudness, SIGNAL(triggered()), app_->library(),
+          SLOT(AnalyseLoudness()));
+  connect(ui_->action_find_duplicates, SIGNAL(triggered()),
+          SLOT(ShowDuplicateSongsDialog()));
+  connect(ui_->action_analyse_audio_features, SIGNAL(triggered()),
+          app_->library(), SLOT(AnalyseAudioFeatures()));
   connect(ui_->action_queue_manager, SIGNAL(triggered()),
           SLOT(ShowQueueManager()));
   connect(ui_->action_add_files_to_transcoder, SIGNAL(triggered()),
@@ -690,6 +716,9 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
   search_for_album_ = playlist_menu_->addAction(
       IconLoader::Load("system-search", IconLoader::Base),
       tr("Search for album"), this, SLOT(SearchForAlbum()));
+  playlist_play_similar_ = playlist_menu_->addAction(
+      IconLoader::Load("media-playlist-shuffle", IconLoader::Base),
+      tr("Play similar tracks"), this, SLOT(PlaySimilar()));
   playlist_menu_->addSeparator();
   playlist_menu_->addAction(ui_->action_remove_from_playlist);
   playlist_undoredo_ = playlist_menu_->addSeparator();
@@ -728,6 +757,9 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
   playlist_menu_->addAction(ui_->action_shuffle);
   playlist_menu_->addAction(ui_->action_remove_duplicates);
   playlist_menu_->addAction(ui_->action_remove_unavailable);
+  playlist_sync_to_device_ = playlist_menu_->addAction(
+      IconLoader::Load("multimedia-player-ipod-mini-blue", IconLoader::Base),
+      tr("Sync playlist to device..."), this, SLOT(PlaylistSyncToDevice()));
 
 #ifdef Q_OS_DARWIN
   ui_->action_shuffle->setShortcut(QKeySequence());
@@ -740,11 +772,23 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
   connect(ui_->playlist, SIGNAL(UndoRedoActionsChanged(QAction*, QAction*)),
           SLOT(PlaylistUndoRedoChanged(QAction*, QAction*)));
 
-  playlist_copy_to_device_->setDisabled(
-      app_->device_manager()->connected_devices_model()->rowCount() == 0);
-  connect(app_->device_manager()->connected_devices_model(),
-          SIGNAL(IsEmptyChanged(bool)), playlist_copy_to_device_,
-          SLOT(setDisabled(bool)));
+  // Looking for devices can take a while, and nothing needs them before the
+  // window is up.
+  playlist_copy_to_device_->setDisabled(true);
+  playlist_sync_to_device_->setDisabled(true);
+  startup->Defer("Devices", [this]() {
+    device_view_->SetApplication(app_);
+    const bool no_devices =
+        app_->device_manager()->connected_devices_model()->rowCount() == 0;
+    playlist_copy_to_device_->setDisabled(no_devices);
+    playlist_sync_to_device_->setDisabled(no_devices);
+    connect(app_->device_manager()->connected_devices_model(),
+            SIGNAL(IsEmptyChanged(bool)), playlist_copy_to_device_,
+            SLOT(setDisabled(bool)));
+    connect(app_->device_manager()->connected_devices_model(),
+            SIGNAL(IsEmptyChanged(bool)), playlist_sync_to_device_,
+            SLOT(setDisabled(bool)));
+  });
 
   // Global search shortcut
   QAction* global_search_action = new QAction(this);
@@ -902,10 +946,17 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
 
   ui_->track_slider->SetApplication(app);
 #ifdef HAVE_MOODBAR
-  // Moodbar connections
-  connect(app_->moodbar_controller(),
-          SIGNAL(CurrentMoodbarDataChanged(QByteArray)),
-          ui_->track_slider->moodbar_style(), SLOT(SetMoodbarData(QByteArray)));
+  // Moodbar connections.  The controller catches up with the song that's
+  // playing when it's created.
+  startup->Defer("Moodbar", [this]() {
+    connect(app_->moodbar_controller(),
+            SIGNAL(CurrentMoodbarDataChanged(QByteArray)),
+            ui_->track_slider->moodbar_style(),
+            SLOT(SetMoodbarData(QByteArray)));
+    connect(app_->moodbar_controller(),
+            SIGNAL(CurrentWaveformDataChanged(QByteArray)),
+            ui_->track_slider, SLOT(SetWaveformData(QByteArray)));
+  });
 #endif
 
   // Now playing widget
@@ -925,6 +976,8 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
   // connect(ui_->action_console, SIGNAL(triggered()), SLOT(ShowConsole()));
   NowPlayingWidgetPositionChanged(ui_->now_playing->show_above_status_bar());
 
+  startup->StageFinished("Actions and connections");
+
   // Load theme
   // This is tricky: we need to save the default/system palette now, before
   // loading user preferred theme (which will overide it), to be able to restore
@@ -934,10 +987,13 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
   StyleSheetLoader* css_loader = new StyleSheetLoader(this);
   css_loader->SetStyleSheet(this, ":mainwindow.css");
 
+  startup->StageFinished("Theme");
+
   // Load playlists
   app_->playlist_manager()->Init(app_->library_backend(),
                                  app_->playlist_backend(),
                                  ui_->playlist_sequence, ui_->playlist);
+  startup->StageFinished("Playlists");
 
   // This connection must be done after the playlists have been initialized.
   connect(this, SIGNAL(StopAfterToggled(bool)), osd_,
@@ -1051,13 +1107,20 @@ MainWindow::MainWindow(Application* app, SystemTrayIcon* tray_icon, OSD* osd,
       new WiimotedevShortcuts(osd_, this, app_->player()));
 #endif
 
-  CheckFullRescanRevisions();
+  startup->StageFinished("Settings");
+
+  startup->Defer("Full rescan check",
+                 [this]() { CheckFullRescanRevisions(); });
 
   CommandlineOptionsReceived(options);
 
   if (!options.contains_play_options()) LoadPlaybackStatus();
+  startup->StageFinished("Playback status");
 
   qLog(Debug) << "Started";
+
+  // Everything else waits until the window has had a chance to paint
+  startup->Start();
 }
 
 MainWindow::~MainWindow() {
@@ -1186,6 +1249,15 @@ void MainWindow::SongChanged(const Song& song) {
   setWindowTitle(song.PrettyTitleWithArtist());
   tray_icon_->SetProgress(0);
 
+  // Let the info panes get ready for the next song.
+  Playlist* playlist = app_->playlist_manager()->active();
+  const int next_row = playlist->next_row();
+  if (next_row != -1) {
+    const Song next_song = playlist->item_at(next_row)->Metadata();
+    song_info_view_->NextSongChanged(next_song);
+    artist_info_view_->NextSongChanged(next_song);
+  }
+
 #ifdef HAVE_LIBLASTFM
   if (ui_->action_toggle_scrobbling->isVisible())
     SetToggleScrobblingIcon(app_->scrobbler()->IsScrobblingEnabled());
@@ -1752,6 +1824,12 @@ void MainWindow::PlaylistRightClick(const QPoint& global_pos,
 
   search_for_artist_->setVisible(all == 1);
   search_for_album_->setVisible(all == 1);
+  playlist_play_similar_->setVisible(
+      all == 1 && source_index.isValid() &&
+      app_->playlist_manager()
+          ->current()
+          ->item_at(source_index.row())
+          ->IsLocalLibraryItem());
 
   if (in_queue == 1 && not_in_queue == 0)
     playlist_queue_->setText(tr("Dequeue track"));
@@ -2561,6 +2639,57 @@ void MainWindow::PlaylistCopyToDevice() {
   }
 }
 
+void MainWindow::PlaylistSyncToDevice() {
+  DeviceStateFilterModel* devices =
+      app_->device_manager()->connected_devices_model();
+
+  QStringList names;
+  for (int i = 0; i < devices->rowCount(); ++i) {
+    names << devices->index(i, 0).data().toString();
+  }
+  if (names.isEmpty()) return;
+
+  bool ok = false;
+  const QString name = QInputDialog::getItem(
+      this, tr("Sync playlist to device"),
+      tr("Copy the songs in this playlist that aren't on the device yet, and "
+         "delete the ones that were synced before but aren't in the playlist "
+         "any more:"),
+      names, 0, false, &ok);
+  if (!ok) return;
+
+  const QModelIndex index =
+      devices->mapToSource(devices->index(names.indexOf(name), 0));
+  std::shared_ptr<ConnectedDevice> device =
+      app_->device_manager()->GetConnectedDevice(index.row());
+  if (!device) return;
+
+  // Name the files the way the organise dialog was last told to.
+  QSettings s;
+  s.beginGroup(OrganiseDialog::kSettingsGroup);
+  OrganiseFormat format(
+      s.value("format", OrganiseDialog::kDefaultFormat).toString());
+  format.set_replace_non_ascii(s.value("replace_ascii", false).toBool());
+  format.set_replace_spaces(s.value("replace_spaces", false).toBool());
+  format.set_replace_the(s.value("replace_the", false).toBool());
+
+  Playlist* playlist = app_->playlist_manager()->current();
+  DeviceSync* sync =
+      new DeviceSync(app_->task_manager(), device, format, playlist->id(),
+                     playlist->GetAllSongs());
+  connect(sync, SIGNAL(Finished(QStringList)),
+          SLOT(DeviceSyncFinished(QStringList)));
+  sync->Start();
+}
+
+void MainWindow::DeviceSyncFinished(const QStringList& files_with_errors) {
+  if (files_with_errors.isEmpty()) return;
+
+  OrganiseErrorDialog* dialog = new OrganiseErrorDialog(this);
+  dialog->Show(OrganiseErrorDialog::Type_Copy, files_with_errors);
+  // It deletes itself when the user closes it
+}
+
 void MainWindow::SearchForArtist() {
   PlaylistItemPtr item(
       app_->playlist_manager()->current()->item_at(playlist_menu_index_.row()));
@@ -2581,6 +2710,23 @@ void MainWindow::SearchForAlbum() {
   }
 }
 
+void MainWindow::PlaySimilar() {
+  PlaylistItemPtr item(
+      app_->playlist_manager()->current()->item_at(playlist_menu_index_.row()));
+  Song song = item->Metadata();
+  if (song.id() == -1) return;
+
+  smart_playlists::GeneratorPtr gen(new smart_playlists::SimilarGenerator(
+      tr("Similar to %1").arg(song.PrettyTitleWithArtist()), song.id()));
+  gen->set_library(app_->library_backend());
+
+  smart_playlists::GeneratorMimeData* data =
+      new smart_playlists::GeneratorMimeData(gen);
+  data->open_in_new_playlist_ = true;
+  data->name_for_new_playlist_ = gen->name();
+  AddToPlaylist(data);
+}
+
 void MainWindow::ChangeLibraryQueryMode(QAction* action) {
   if (action == library_show_duplicates_) {
     library_view_->filter()->SetQueryMode(QueryOptions::QueryMode_Duplicates);
@@ -2686,6 +2832,10 @@ void MainWindow::CheckFullRescanRevisions() {
 
 void MainWindow::ShowQueueManager() { queue_manager_->show(); }
 
+void MainWindow::ShowDuplicateSongsDialog() {
+  duplicate_songs_dialog_->show();
+}
+
 void MainWindow::ShowVisualisations() {
 #ifdef ENABLE_VISUALISATIONS
   if (!visualisation_) {
@@ -2782,7 +2932,7 @@ void MainWindow::Exit() {
 void MainWindow::AutoCompleteTags() {
   // Create the tag fetching stuff if it hasn't been already
   if (!tag_fetcher_) {
-    tag_fetcher_.reset(new TagFetcher);
+    tag_fetcher_.reset(new TagFetcher(app_->database()));
     track_selection_dialog_.reset(new TrackSelectionDialog);
     track_selection_dialog_->set_save_on_close(true);
 
@@ -52,6 +52,7 @@ class DeviceViewContainer;
 class EditTagDialog;
 class Equalizer;
 class ErrorDialog;
+class DuplicateSongsDialog;
 class FileView;
 class GlobalSearch;
 class GlobalSearchView;
@@ -180,10 +181,13 @@ signals:
 
   void SearchForArtist();
   void SearchForAlbum();
+  void PlaySimilar();
 
   void PlaylistCopyToLibrary();
   void PlaylistMoveToLibrary();
   void PlaylistCopyToDevice();
+  void PlaylistSyncToDevice();
+  void DeviceSyncFinished(const QStringList& files_with_errors);
   void PlaylistOrganiseSelected(bool copy);
   void PlaylistDelete();
   void PlaylistOpenInBrowser();
@@ -257,6 +261,7 @@ signals:
   void ShowTranscodeDialog();
   void ShowErrorDialog(const QString& message);
   void ShowQueueManager();
+  void ShowDuplicateSongsDialog();
   void ShowVisualisations();
   SettingsDialog* CreateSettingsDialog();
   EditTagDialog* CreateEditTagDialog();
@@ -333,6 +338,7 @@ signals:
   Lazy<ErrorDialog> error_dialog_;
   Lazy<OrganiseDialog> organise_dialog_;
   Lazy<QueueManager> queue_manager_;
+  Lazy<DuplicateSongsDialog> duplicate_songs_dialog_;
 
   std::unique_ptr<TagFetcher> tag_fetcher_;
   std::unique_ptr<TrackSelectionDialog> track_selection_dialog_;
@@ -359,6 +365,7 @@ signals:
   QAction* playlist_copy_to_library_;
   QAction* playlist_move_to_library_;
   QAction* playlist_copy_to_device_;
+  QAction* playlist_sync_to_device_;
   QAction* playlist_delete_;
   QAction* playlist_open_in_browser_;
   QAction* playlist_queue_;
@@ -371,6 +378,7 @@ signals:
 
   QAction* search_for_artist_;
   QAction* search_for_album_;
+  QAction* playlist_play_similar_;
 
   QSortFilterProxyModel* library_sort_model_;
 
@@ -26,6 +26,7 @@
 #include <QUrl>
 
 #include "core/application.h"
+#include "networkremote/audiostreamserver.h"
 #include "networkremote/networkremote.h"
 #include "networkremote/networkremotehelper.h"
 #include "transcoder/transcoder.h"
@@ -91,6 +92,18 @@ void NetworkRemoteSettingsPage::Load() {
   ui_->convert_lossless->setChecked(
       s.value("convert_lossless", false).toBool());
 
+  ui_->stream_audio->setChecked(s.value("stream_audio", false).toBool());
+  ui_->stream_port->setValue(
+      s.value("stream_port", AudioStreamServer::kDefaultPort).toInt());
+  ui_->stream_format->setCurrentIndex(
+      s.value("stream_format", GstEngine::StreamFormat_Mp3).toInt());
+  ui_->stream_bitrate->setValue(
+      s.value("stream_bitrate", AudioStreamServer::kDefaultBitrateKbps)
+          .toInt());
+  ui_->stream_max_clients->setValue(
+      s.value("stream_max_clients", AudioStreamServer::kDefaultMaxClients)
+          .toInt());
+
   // Load settings
   QString last_output_format =
       s.value("last_output_format", "audio/x-vorbis").toString();
@@ -141,6 +154,11 @@ void NetworkRemoteSettingsPage::Save() {
   s.setValue("auth_code", ui_->auth_code->value());
   s.setValue("allow_downloads", ui_->allow_downloads->isChecked());
   s.setValue("convert_lossless", ui_->convert_lossless->isChecked());
+  s.setValue("stream_audio", ui_->stream_audio->isChecked());
+  s.setValue("stream_port", ui_->stream_port->value());
+  s.setValue("stream_format", ui_->stream_format->currentIndex());
+  s.setValue("stream_bitrate", ui_->stream_bitrate->value());
+  s.setValue("stream_max_clients", ui_->stream_max_clients->value());
 
   TranscoderPreset preset = ui_->format->itemData(ui_->format->currentIndex())
                                 .value<TranscoderPreset>();
@@ -22,6 +22,7 @@
 
 #include <QDir>
 #include <QFileInfo>
+#include <QFutureWatcher>
 #include <QHash>
 #include <QMenu>
 #include <QPushButton>
@@ -33,15 +34,18 @@
 
 #include "iconloader.h"
 #include "organiseerrordialog.h"
+#include "core/closure.h"
 #include "core/musicstorage.h"
 #include "core/organise.h"
 #include "core/tagreaderclient.h"
+#include "core/threadpools.h"
 #include "core/utilities.h"
 #include "library/librarybackend.h"
 
 const char* OrganiseDialog::kDefaultFormat =
     "%artist/%album{ (Disc %disc)}/{%track - }%title.%extension";
 const char* OrganiseDialog::kSettingsGroup = "OrganiseDialog";
+const int OrganiseDialog::kAsyncPreviewThreshold = 200;
 
 OrganiseDialog::OrganiseDialog(
     TaskManager* task_manager, LibraryBackend* backend, QWidget* parent)
@@ -49,6 +53,7 @@ OrganiseDialog::OrganiseDialog(
       ui_(new Ui_OrganiseDialog),
       task_manager_(task_manager),
       backend_(backend),
+      preview_id_(0),
       total_size_(0),
       resized_by_user_(false) {
   ui_->setupUi(this);
@@ -175,8 +180,7 @@ void OrganiseDialog::SetLoadingSongs(bool loading) {
 }
 
 SongList OrganiseDialog::LoadSongsBlocking(const QStringList& filenames) {
-  SongList songs;
-  Song song;
+  QStringList files;
 
   QStringList filenames_copy = filenames;
   while (!filenames_copy.isEmpty()) {
@@ -193,7 +197,15 @@ SongList OrganiseDialog::LoadSongsBlocking(const QStringList& filenames) {
       continue;
     }
 
-    TagReaderClient::Instance()->ReadFileBlocking(filename, &song);
+    files << filename;
+  }
+
+  // Read all the tags in as few round-trips to the tagreader as possible.
+  SongList songs_on_disk;
+  TagReaderClient::Instance()->ReadFilesBlocking(files, &songs_on_disk);
+
+  SongList songs;
+  for (const Song& song : songs_on_disk) {
     if (song.is_valid()) songs << song;
   }
 
@@ -275,17 +287,49 @@ void OrganiseDialog::UpdatePreviews() {
   ui_->button_box->button(QDialogButtonBox::Ok)->setEnabled(ok);
   if (!format_valid) return;
 
-  new_songs_info_ = ComputeNewSongsFilenames(songs_, format_);
+  const QString local_path =
+      has_local_destination ? storage->LocalPath() : QString();
+  const int preview_id = ++preview_id_;
+
+  if (songs_.count() <= kAsyncPreviewThreshold) {
+    ShowPreviews(ComputeNewSongsFilenames(songs_, format_), local_path, ok);
+    return;
+  }
+
+  // The Ok button waits for the new filenames, since they're what gets used.
+  ui_->button_box->button(QDialogButtonBox::Ok)->setEnabled(false);
+
+  QFutureWatcher<Organise::NewSongInfoList>* watcher =
+      new QFutureWatcher<Organise::NewSongInfoList>(this);
+  NewClosure(watcher, SIGNAL(finished()), [=]() {
+    watcher->deleteLater();
+    if (preview_id == preview_id_) {
+      ShowPreviews(watcher->result(), local_path, ok);
+    }
+  });
+  watcher->setFuture(ThreadPools::Run<Organise::NewSongInfoList>(
+      ThreadPools::Pool_Interactive,
+      std::bind(&OrganiseDialog::ComputeNewSongsFilenames, songs_, format_)));
+}
+
+void OrganiseDialog::ShowPreviews(
+    const Organise::NewSongInfoList& new_songs_info, const QString& local_path,
+    bool ok) {
+  new_songs_info_ = new_songs_info;
+  ui_->button_box->button(QDialogButtonBox::Ok)->setEnabled(ok);
 
   // Update the previews
+  const bool has_local_destination = !local_path.isEmpty();
   ui_->preview->clear();
   ui_->preview_group->setVisible(has_local_destination);
   ui_->naming_group->setVisible(has_local_destination);
   if (has_local_destination) {
+    QStringList filenames;
     for (const Organise::NewSongInfo& song_info : new_songs_info_) {
-      QString filename = storage->LocalPath() + "/" + song_info.new_filename_;
-      ui_->preview->addItem(QDir::toNativeSeparators(filename));
+      filenames << QDir::toNativeSeparators(local_path + "/" +
+                                            song_info.new_filename_);
     }
+    ui_->preview->addItems(filenames);
   }
 
   if (!resized_by_user_) {
@@ -50,6 +50,8 @@ class OrganiseDialog : public QDialog {
 
   static const char* kDefaultFormat;
   static const char* kSettingsGroup;
+  // Previews for more songs than this are worked out in the background.
+  static const int kAsyncPreviewThreshold;
 
   QSize sizeHint() const;
 
@@ -64,6 +66,11 @@ class OrganiseDialog : public QDialog {
 
   void SetCopy(bool copy);
 
+  // Works out where each song goes, numbering songs that would end up with
+  // the same name.
+  static Organise::NewSongInfoList ComputeNewSongsFilenames(
+      const SongList& songs, const OrganiseFormat& format);
+
 signals:
   void FileCopied(int);
 
@@ -86,8 +93,9 @@ signals:
   SongList LoadSongsBlocking(const QStringList& filenames);
   void SetLoadingSongs(bool loading);
 
-  static Organise::NewSongInfoList ComputeNewSongsFilenames(
-      const SongList& songs, const OrganiseFormat& format);
+  // local_path is empty if the destination isn't on the local filesystem.
+  void ShowPreviews(const Organise::NewSongInfoList& new_songs_info,
+                    const QString& local_path, bool ok);
 
   Ui_OrganiseDialog* ui_;
   TaskManager* task_manager_;
@@ -98,6 +106,9 @@ signals:
   QFuture<SongList> songs_future_;
   SongList songs_;
   Organise::NewSongInfoList new_songs_info_;
+  // Incremented for each preview, so one worked out in the background can
+  // tell whether it's still wanted.
+  int preview_id_;
   quint64 total_size_;
 
   std::unique_ptr<OrganiseErrorDialog> error_dialog_;
@@ -44,6 +44,10 @@ PlaybackSettingsPage::PlaybackSettingsPage(SettingsDialog* dialog)
       QFontMetrics(ui_->replaygain_preamp_label->font()).width("-WW.W dB"));
   RgPreampChanged(ui_->replaygain_preamp->value());
 
+  connect(ui_->gst_output, SIGNAL(currentIndexChanged(int)),
+          SLOT(OutputChanged()));
+  connect(ui_->direct_output, SIGNAL(toggled(bool)), SLOT(OutputChanged()));
+
   ui_->sample_rate->setItemData(0, GstEngine::kAutoSampleRate);
   ui_->sample_rate->setItemData(1, 44100);
   ui_->sample_rate->setItemData(2, 48000);
@@ -116,7 +120,12 @@ void PlaybackSettingsPage::Load() {
   ui_->sample_rate->setCurrentIndex(ui_->sample_rate->findData(
       s.value("samplerate", GstEngine::kAutoSampleRate).toInt()));
   ui_->buffer_min_fill->setValue(s.value("bufferminfill", 33).toInt());
+  ui_->sink_buffer->setValue(s.value("sinkbuffer", 0).toInt());
+  ui_->direct_output->setChecked(s.value("directoutput", false).toBool());
+  ui_->fading_shared->setChecked(s.value("sharedcrossfade", false).toBool());
   s.endGroup();
+
+  OutputChanged();
 }
 
 void PlaybackSettingsPage::Save() {
@@ -153,6 +162,9 @@ void PlaybackSettingsPage::Save() {
       "samplerate",
       ui_->sample_rate->itemData(ui_->sample_rate->currentIndex()).toInt());
   s.setValue("bufferminfill", ui_->buffer_min_fill->value());
+  s.setValue("sinkbuffer", ui_->sink_buffer->value());
+  s.setValue("directoutput", ui_->direct_output->isChecked());
+  s.setValue("sharedcrossfade", ui_->fading_shared->isChecked());
   s.endGroup();
 }
 
@@ -172,3 +184,15 @@ void PlaybackSettingsPage::FadingOptionsChanged() {
                                   ui_->fading_cross->isChecked() ||
                                   ui_->fading_auto->isChecked());
 }
+
+void PlaybackSettingsPage::OutputChanged() {
+  const GstEngine::OutputDetails details =
+      ui_->gst_output->itemData(ui_->gst_output->currentIndex())
+          .value<GstEngine::OutputDetails>();
+  const bool direct =
+      GstEngine::SupportsDirectOutput(details.gstreamer_plugin_name);
+
+  ui_->direct_output->setEnabled(direct);
+  // The sample rate can't be changed without a resampler
+  ui_->sample_rate->setEnabled(!direct || !ui_->direct_output->isChecked());
+}
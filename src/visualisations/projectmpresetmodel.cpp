@@ -18,6 +18,7 @@
 #include "config.h"
 #include "projectmpresetmodel.h"
 #include "projectmvisualisation.h"
+#include "core/utilities.h"
 
 #ifdef USE_SYSTEM_PROJECTM
 #include <libprojectM/projectM.hpp>
@@ -25,24 +26,70 @@
 #include "projectM.hpp"
 #endif
 
-#include <QtDebug>
+#include <QDataStream>
+#include <QDateTime>
 #include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtDebug>
+
+namespace {
+// Bump this when the cache file format changes.
+const qint32 kCacheVersion = 1;
+}  // namespace
 
 ProjectMPresetModel::ProjectMPresetModel(ProjectMVisualisation* vis,
                                          QObject* parent)
-    : QAbstractItemModel(parent), vis_(vis) {
-  // Find presets
-  QDir preset_dir(vis_->preset_url());
-  QStringList presets(
-      preset_dir.entryList(QStringList() << "*.milk"
-                                         << "*.prjm",
-                           QDir::Files | QDir::NoDotAndDotDot | QDir::Readable,
-                           QDir::Name | QDir::IgnoreCase));
-
-  for (const QString& filename : presets) {
+    : QAbstractItemModel(parent), vis_(vis) {}
+
+QStringList ProjectMPresetModel::FindPresets(const QString& directory) {
+  const QString cache_dir =
+      Utilities::GetConfigPath(Utilities::Path_CacheRoot);
+  QFile cache(cache_dir + "/projectm-presets");
+
+  // Adding or removing a preset changes the directory's mtime.
+  const uint mtime = QFileInfo(directory).lastModified().toTime_t();
+
+  if (cache.open(QIODevice::ReadOnly)) {
+    QDataStream s(&cache);
+    qint32 version = 0;
+    QString cached_directory;
+    uint cached_mtime = 0;
+    QStringList filenames;
+    s >> version >> cached_directory >> cached_mtime >> filenames;
+
+    if (s.status() == QDataStream::Ok && version == kCacheVersion &&
+        cached_directory == directory && cached_mtime == mtime) {
+      return filenames;
+    }
+    cache.close();
+  }
+
+  QStringList filenames(QDir(directory).entryList(
+      QStringList() << "*.milk"
+                    << "*.prjm",
+      QDir::Files | QDir::NoDotAndDotDot | QDir::Readable,
+      QDir::Name | QDir::IgnoreCase));
+
+  if (QDir().mkpath(cache_dir) && cache.open(QIODevice::WriteOnly)) {
+    QDataStream s(&cache);
+    s << kCacheVersion << directory << mtime << filenames;
+  }
+
+  return filenames;
+}
+
+void ProjectMPresetModel::SetPresets(const QString& directory,
+                                     const QStringList& filenames) {
+  QDir preset_dir(directory);
+
+  beginResetModel();
+  all_presets_.clear();
+  for (const QString& filename : filenames) {
     all_presets_ << Preset(preset_dir.absoluteFilePath(filename), filename,
                            false);
   }
+  endResetModel();
 }
 
 int ProjectMPresetModel::rowCount(const QModelIndex&) const {
@@ -34,6 +34,12 @@ class ProjectMPresetModel : public QAbstractItemModel {
 
   void MarkSelected(const QString& path, bool selected);
 
+  // Lists the presets in directory.  The list is cached on disk and reused
+  // until the directory changes, so this is cheap after the first time.  Safe
+  // to call from any thread.
+  static QStringList FindPresets(const QString& directory);
+  void SetPresets(const QString& directory, const QStringList& filenames);
+
   // QAbstractItemModel
   QModelIndex index(int row, int column,
                     const QModelIndex& parent = QModelIndex()) const;
@@ -19,9 +19,13 @@
 #include "projectmpresetmodel.h"
 #include "projectmvisualisation.h"
 #include "visualisationcontainer.h"
+#include "core/closure.h"
+
+#include <algorithm>
 
 #include <QCoreApplication>
 #include <QDir>
+#include <QDirIterator>
 #include <QFile>
 #include <QGLWidget>
 #include <QGraphicsView>
@@ -30,6 +34,7 @@
 #include <QPainter>
 #include <QSettings>
 #include <QTemporaryFile>
+#include <QtConcurrentRun>
 #include <QtDebug>
 #include <QTimerEvent>
 
@@ -46,9 +51,23 @@
 #include <GL/gl.h>
 #endif
 
+class ProjectMVisualisation::ProjectMWrapper : public projectM {
+ public:
+  ProjectMWrapper(ProjectMVisualisation* vis, const Settings& settings)
+      : projectM(settings, FLAG_DISABLE_PLAYLIST_LOAD), vis_(vis) {}
+
+  void presetSwitchedEvent(bool, unsigned int index) const {
+    vis_->PresetSwitched(index);
+  }
+
+ private:
+  ProjectMVisualisation* vis_;
+};
+
 ProjectMVisualisation::ProjectMVisualisation(QObject* parent)
     : QGraphicsScene(parent),
       preset_model_(nullptr),
+      presets_found_(false),
       mode_(Random),
       duration_(15),
       texture_size_(512) {
@@ -85,7 +104,7 @@ void ProjectMVisualisation::InitProjectM() {
     if (!QFile::exists(path)) continue;
 
     // Don't use empty directories
-    if (QDir(path).entryList(QDir::Files | QDir::NoDotAndDotDot).isEmpty())
+    if (!QDirIterator(path, QDir::Files | QDir::NoDotAndDotDot).hasNext())
       continue;
 
     preset_path = path;
@@ -109,20 +128,22 @@ void ProjectMVisualisation::InitProjectM() {
   s.smoothPresetDuration = 5;
   s.presetDuration = duration_;
   s.presetURL = preset_path.toStdString();
-  s.shuffleEnabled = true;
+  // Load() shuffles the playlist instead, so the next preset is always known.
+  s.shuffleEnabled = false;
   s.easterEgg = 0;  // ??
   s.softCutRatingsEnabled = false;
   s.menuFontURL = font_path.toStdString();
   s.titleFontURL = font_path.toStdString();
 
-  projectm_.reset(new projectM(s));
+  // projectM would list the preset directory itself while we wait for it.
+  // Do it on another thread instead, projectM shows its idle preset until
+  // the playlist is filled in.
+  projectm_.reset(new ProjectMWrapper(this, s));
   preset_model_ = new ProjectMPresetModel(this, this);
-  Load();
 
-  // Start at a random preset.
-  if (projectm_->getPlaylistSize() > 0) {
-    projectm_->selectPreset(qrand() % projectm_->getPlaylistSize(), true);
-  }
+  QFuture<QStringList> future =
+      QtConcurrent::run(&ProjectMPresetModel::FindPresets, preset_path);
+  NewClosure(future, [=]() { PresetsFound(preset_path, future.result()); });
 
   if (font_path.isNull()) {
     qWarning("ProjectM presets could not be found, search path was:\n  %s",
@@ -134,6 +155,34 @@ void ProjectMVisualisation::InitProjectM() {
   }
 }
 
+void ProjectMVisualisation::PresetsFound(const QString& directory,
+                                         const QStringList& filenames) {
+  preset_model_->SetPresets(directory, filenames);
+  presets_found_ = true;
+  Load();
+
+  // Start at a random preset.
+  if (projectm_->getPlaylistSize() > 0) {
+    projectm_->selectPreset(qrand() % projectm_->getPlaylistSize(), true);
+  }
+}
+
+void ProjectMVisualisation::PresetSwitched(unsigned int index) {
+  const unsigned int count = projectm_->getPlaylistSize();
+  if (count < 2) return;
+
+  const QString next =
+      QString::fromStdString(projectm_->getPresetURL((index + 1) % count));
+  QtConcurrent::run(&ProjectMVisualisation::PreloadPreset, next);
+}
+
+void ProjectMVisualisation::PreloadPreset(const QString& path) {
+  // projectM still parses the preset on the render thread, but it won't have
+  // to wait for the disk as well.
+  QFile file(path);
+  if (file.open(QIODevice::ReadOnly)) file.readAll();
+}
+
 void ProjectMVisualisation::drawBackground(QPainter* p, const QRectF&) {
   p->beginNativePainting();
 
@@ -214,25 +263,30 @@ void ProjectMVisualisation::Load() {
 
   projectm_->changePresetDuration(duration_);
   projectm_->clearPlaylist();
+
+  QStringList paths;
   switch (mode_) {
     case Random:
       for (int i = 0; i < preset_model_->all_presets_.count(); ++i) {
-        projectm_->addPresetURL(
-            preset_model_->all_presets_[i].path_.toStdString(), std::string(),
-            default_rating_list_);
+        paths << preset_model_->all_presets_[i].path_;
         preset_model_->all_presets_[i].selected_ = true;
       }
       break;
 
     case FromList: {
-      QStringList paths(s.value("preset_paths").toStringList());
+      paths = s.value("preset_paths").toStringList();
       for (const QString& path : paths) {
-        projectm_->addPresetURL(path.toStdString(), std::string(),
-                                default_rating_list_);
         preset_model_->MarkSelected(path, true);
       }
     }
   }
+
+  // projectM plays the playlist in order.
+  std::random_shuffle(paths.begin(), paths.end());
+  for (const QString& path : paths) {
+    projectm_->addPresetURL(path.toStdString(), std::string(),
+                            default_rating_list_);
+  }
 }
 
 void ProjectMVisualisation::Save() {
@@ -245,7 +299,8 @@ void ProjectMVisualisation::Save() {
 
   QSettings s;
   s.beginGroup(VisualisationContainer::kSettingsGroup);
-  s.setValue("preset_paths", paths);
+  // Don't forget the selection while the presets are still being listed.
+  if (presets_found_) s.setValue("preset_paths", paths);
   s.setValue("mode", mode_);
   s.setValue("duration", duration_);
 }
@@ -68,15 +68,24 @@ class ProjectMVisualisation : public QGraphicsScene, public BufferConsumer {
   void SceneRectChanged(const QRectF& rect);
 
  private:
+  class ProjectMWrapper;
+
   void InitProjectM();
+  void PresetsFound(const QString& directory, const QStringList& filenames);
   void Load();
   void Save();
 
+  // Called by projectM when it switches preset.  Reads ahead the preset that
+  // comes after it.
+  void PresetSwitched(unsigned int index);
+  static void PreloadPreset(const QString& path);
+
   int IndexOfPreset(const QString& path) const;
 
  private:
   std::unique_ptr<projectM> projectm_;
   ProjectMPresetModel* preset_model_;
+  bool presets_found_;
   Mode mode_;
   int duration_;
 
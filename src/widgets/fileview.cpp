@@ -19,12 +19,13 @@
 #include "core/filesystemmusicstorage.h"
 #include "core/mimedata.h"
 #include "fileview.h"
+#include "fileviewmodel.h"
 #include "ui/iconloader.h"
 #include "ui/mainwindow.h"  // for filter information
 #include "ui/organiseerrordialog.h"
 #include "ui_fileview.h"
 
-#include <QFileSystemModel>
+#include <QDir>
 #include <QKeyEvent>
 #include <QMessageBox>
 #include <QScrollBar>
@@ -41,6 +42,7 @@ FileView::FileView(QWidget* parent)
       model_(nullptr),
       undo_stack_(new QUndoStack(this)),
       task_manager_(nullptr),
+      library_backend_(nullptr),
       storage_(new FilesystemMusicStorage("/")) {
   ui_->setupUi(this);
 
@@ -97,8 +99,13 @@ void FileView::SetTaskManager(TaskManager* task_manager) {
   task_manager_ = task_manager;
 }
 
+void FileView::SetLibraryBackend(LibraryBackendInterface* backend) {
+  library_backend_ = backend;
+  if (model_) model_->SetLibraryBackend(backend);
+}
+
 void FileView::FileUp() {
-  QDir dir(model_->rootDirectory());
+  QDir dir(model_->root_path());
   dir.cdUp();
 
   // Is this the same as going back?  If so just go back, so we can keep the
@@ -123,14 +130,14 @@ void FileView::ChangeFilePath(const QString& new_path_native) {
   QFileInfo info(new_path);
   if (!info.exists() || !info.isDir()) return;
 
-  QString old_path(model_->rootPath());
+  QString old_path(model_->root_path());
   if (old_path == new_path) return;
 
   undo_stack_->push(new UndoCommand(this, new_path));
 }
 
 void FileView::ChangeFilePathWithoutUndo(const QString& new_path) {
-  ui_->list->setRootIndex(model_->setRootPath(new_path));
+  model_->SetRootPath(new_path);
   ui_->path->setText(QDir::toNativeSeparators(new_path));
 
   QDir dir(new_path);
@@ -140,15 +147,17 @@ void FileView::ChangeFilePathWithoutUndo(const QString& new_path) {
 }
 
 void FileView::ItemActivated(const QModelIndex& index) {
-  if (model_->isDir(index)) ChangeFilePath(model_->filePath(index));
+  if (model_->IsDir(index)) ChangeFilePath(model_->FilePath(index));
 }
 
 void FileView::ItemDoubleClick(const QModelIndex& index) {
-  if (model_->isDir(index)) return;
+  if (!index.isValid() || model_->IsDir(index)) return;
 
-  QString file_path = model_->filePath(index);
+  QString file_path = model_->FilePath(index);
 
-  MimeData* data = new MimeData;
+  // Songs that are in the library are added without reading the file again.
+  MimeData* data =
+      qobject_cast<MimeData*>(model_->mimeData(QModelIndexList() << index));
   data->from_doubleclick_ = true;
   data->setUrls(QList<QUrl>() << QUrl::fromLocalFile(file_path));
   data->name_for_new_playlist_ = file_path;
@@ -158,9 +167,9 @@ void FileView::ItemDoubleClick(const QModelIndex& index) {
 
 FileView::UndoCommand::UndoCommand(FileView* view, const QString& new_path)
     : view_(view) {
-  old_state_.path = view->model_->rootPath();
+  old_state_.path = view->model_->root_path();
   old_state_.scroll_pos = view_->ui_->list->verticalScrollBar()->value();
-  old_state_.index = view_->ui_->list->currentIndex();
+  old_state_.row = view_->ui_->list->currentIndex().row();
 
   new_state_.path = new_path;
 }
@@ -168,17 +177,17 @@ FileView::UndoCommand::UndoCommand(FileView* view, const QString& new_path)
 void FileView::UndoCommand::redo() {
   view_->ChangeFilePathWithoutUndo(new_state_.path);
   if (new_state_.scroll_pos != -1) {
-    view_->ui_->list->setCurrentIndex(new_state_.index);
+    view_->ui_->list->setCurrentIndex(view_->model_->index(new_state_.row));
     view_->ui_->list->verticalScrollBar()->setValue(new_state_.scroll_pos);
   }
 }
 
 void FileView::UndoCommand::undo() {
   new_state_.scroll_pos = view_->ui_->list->verticalScrollBar()->value();
-  new_state_.index = view_->ui_->list->currentIndex();
+  new_state_.row = view_->ui_->list->currentIndex().row();
 
   view_->ChangeFilePathWithoutUndo(old_state_.path);
-  view_->ui_->list->setCurrentIndex(old_state_.index);
+  view_->ui_->list->setCurrentIndex(view_->model_->index(old_state_.row));
   view_->ui_->list->verticalScrollBar()->setValue(old_state_.scroll_pos);
 }
 
@@ -211,11 +220,9 @@ void FileView::showEvent(QShowEvent* e) {
 
   if (model_) return;
 
-  model_ = new QFileSystemModel(this);
-
-  model_->setNameFilters(filter_list_);
-  // if an item fails the filter, hide it
-  model_->setNameFilterDisables(false);
+  model_ = new FileViewModel(this);
+  model_->SetLibraryBackend(library_backend_);
+  model_->SetNameFilters(filter_list_);
 
   ui_->list->setModel(model_);
   ChangeFilePathWithoutUndo(QDir::homePath());
@@ -27,12 +27,13 @@
 
 #include "core/song.h"
 
+class FileViewModel;
 class FilesystemMusicStorage;
+class LibraryBackendInterface;
 class MusicStorage;
 class TaskManager;
 class Ui_FileView;
 
-class QFileSystemModel;
 class QUndoStack;
 
 class FileView : public QWidget {
@@ -46,6 +47,7 @@ class FileView : public QWidget {
 
   void SetPath(const QString& path);
   void SetTaskManager(TaskManager* task_manager);
+  void SetLibraryBackend(LibraryBackendInterface* backend);
 
   void showEvent(QShowEvent*);
   void keyPressEvent(QKeyEvent* e);
@@ -84,10 +86,12 @@ signals:
 
    private:
     struct State {
-      State() : scroll_pos(-1) {}
+      State() : row(-1), scroll_pos(-1) {}
 
       QString path;
-      QModelIndex index;
+      // The model is reset when the directory changes, so only the row of
+      // the current item is kept.
+      int row;
       int scroll_pos;
     };
 
@@ -98,10 +102,11 @@ signals:
 
   Ui_FileView* ui_;
 
-  QFileSystemModel* model_;
+  FileViewModel* model_;
   QUndoStack* undo_stack_;
 
   TaskManager* task_manager_;
+  LibraryBackendInterface* library_backend_;
   std::shared_ptr<MusicStorage> storage_;
 
   QString lazy_set_path_;
@@ -16,12 +16,12 @@
 */
 
 #include "fileviewlist.h"
+#include "fileviewmodel.h"
 #include "core/mimedata.h"
 #include "core/utilities.h"
 #include "ui/iconloader.h"
 
 #include <QContextMenuEvent>
-#include <QFileSystemModel>
 #include <QMenu>
 #include <QtDebug>
 
@@ -66,16 +66,17 @@ QList<QUrl> FileViewList::UrlListFromSelection() const {
   QList<QUrl> urls;
   for (const QModelIndex& index : menu_selection_.indexes()) {
     if (index.column() == 0)
-      urls << QUrl::fromLocalFile(static_cast<QFileSystemModel*>(model())
-                                      ->fileInfo(index)
+      urls << QUrl::fromLocalFile(static_cast<FileViewModel*>(model())
+                                      ->FileInfo(index)
                                       .canonicalFilePath());
   }
   return urls;
 }
 
 MimeData* FileViewList::MimeDataFromSelection() const {
-  MimeData* data = new MimeData;
-  data->setUrls(UrlListFromSelection());
+  // Songs that are in the library are added without reading the files again.
+  MimeData* data = qobject_cast<MimeData*>(
+      model()->mimeData(menu_selection_.indexes()));
 
   QList<QString> filenames = FilenamesFromSelection();
   // if just one folder selected - use it's path as the new playlist's name
@@ -84,7 +85,7 @@ MimeData* FileViewList::MimeDataFromSelection() const {
     // otherwise, use the current root path
   } else {
     data->name_for_new_playlist_ =
-        static_cast<QFileSystemModel*>(model())->rootPath();
+        static_cast<FileViewModel*>(model())->root_path();
   }
 
   return data;
@@ -94,7 +95,7 @@ QStringList FileViewList::FilenamesFromSelection() const {
   QStringList filenames;
   for (const QModelIndex& index : menu_selection_.indexes()) {
     if (index.column() == 0)
-      filenames << static_cast<QFileSystemModel*>(model())->filePath(index);
+      filenames << static_cast<FileViewModel*>(model())->FilePath(index);
   }
   return filenames;
 }
@@ -146,8 +147,8 @@ void FileViewList::mousePressEvent(QMouseEvent* e) {
       // we need to update the menu selection
       menu_selection_ = selectionModel()->selection();
 
-      MimeData* data = new MimeData;
-      data->setUrls(UrlListFromSelection());
+      MimeData* data = qobject_cast<MimeData*>(
+          model()->mimeData(menu_selection_.indexes()));
       data->enqueue_now_ = true;
       emit AddToPlaylist(data);
       break;
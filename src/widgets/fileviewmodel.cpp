@@ -0,0 +1,262 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "fileviewmodel.h"
+
+#include <QDir>
+#include <QFutureWatcher>
+#include <QUrl>
+
+#include "core/closure.h"
+#include "core/filesystemwatcherinterface.h"
+#include "core/mimedata.h"
+#include "core/threadpools.h"
+#include "library/librarybackend.h"
+#include "playlist/songmimedata.h"
+
+const int FileViewModel::kCacheSize = 16;
+
+FileViewModel::FileViewModel(QObject* parent)
+    : QAbstractListModel(parent),
+      backend_(nullptr),
+      watcher_(FileSystemWatcherInterface::Create(this)) {
+  connect(watcher_, SIGNAL(PathChanged(QString)),
+          SLOT(DirectoryChanged(QString)));
+}
+
+void FileViewModel::SetLibraryBackend(LibraryBackendInterface* backend) {
+  backend_ = backend;
+}
+
+void FileViewModel::SetNameFilters(const QStringList& filters) {
+  name_filters_ = filters;
+
+  // The cached listings were filtered with the old ones.
+  for (const QString& path : cache_order_) {
+    watcher_->RemovePath(path);
+  }
+  cache_.clear();
+  cache_order_.clear();
+
+  if (!root_path_.isEmpty()) StartListing(root_path_);
+}
+
+void FileViewModel::SetRootPath(const QString& path) {
+  if (path == root_path_) return;
+  root_path_ = path;
+
+  beginResetModel();
+  if (cache_.contains(path)) {
+    entries_ = cache_[path];
+    cache_order_.removeAll(path);
+    cache_order_ << path;
+  } else {
+    entries_.clear();
+    StartListing(path);
+  }
+  endResetModel();
+}
+
+void FileViewModel::StartListing(const QString& path) {
+  QFutureWatcher<Listing>* watcher = new QFutureWatcher<Listing>(this);
+  NewClosure(watcher, SIGNAL(finished()), [=]() {
+    ListingFinished(path, watcher->result());
+    watcher->deleteLater();
+  });
+  watcher->setFuture(ThreadPools::Run<Listing>(
+      ThreadPools::Pool_Interactive,
+      std::bind(&FileViewModel::ListDirectory, path, name_filters_,
+                backend_)));
+}
+
+FileViewModel::Listing FileViewModel::ListDirectory(
+    const QString& path, const QStringList& filters,
+    LibraryBackendInterface* backend) {
+  // The same entries and order as QFileSystemModel: directories first, and
+  // no hidden files.
+  QDir dir(path);
+  dir.setNameFilters(filters);
+  const QFileInfoList infos = dir.entryInfoList(
+      QDir::AllDirs | QDir::Files | QDir::NoDotAndDotDot,
+      QDir::DirsFirst | QDir::Name | QDir::IgnoreCase);
+
+  Listing ret;
+  QList<QUrl> urls;
+  for (const QFileInfo& info : infos) {
+    Entry entry;
+    entry.info_ = info;
+    ret << entry;
+
+    if (!info.isDir()) urls << QUrl::fromLocalFile(info.absoluteFilePath());
+  }
+
+  // Everything the library knows about these files comes from one query.
+  if (backend && !urls.isEmpty()) {
+    QHash<QString, Song> songs;
+    for (const Song& song : backend->GetSongsByUrls(urls)) {
+      // Only whole files, not the sections of a cue sheet.
+      if (song.beginning_nanosec() == 0) {
+        songs[song.url().toLocalFile()] = song;
+      }
+    }
+
+    if (!songs.isEmpty()) {
+      for (Entry& entry : ret) {
+        entry.song_ = songs.value(entry.info_.absoluteFilePath());
+      }
+    }
+  }
+
+  return ret;
+}
+
+void FileViewModel::ListingFinished(const QString& path,
+                                    const Listing& listing) {
+  AddToCache(path, listing);
+
+  if (path != root_path_) return;
+
+  beginResetModel();
+  entries_ = listing;
+  endResetModel();
+}
+
+void FileViewModel::AddToCache(const QString& path, const Listing& listing) {
+  if (!cache_.contains(path)) watcher_->AddPath(path);
+
+  cache_[path] = listing;
+  cache_order_.removeAll(path);
+  cache_order_ << path;
+
+  while (cache_order_.count() > kCacheSize) {
+    RemoveFromCache(cache_order_.first());
+  }
+}
+
+void FileViewModel::RemoveFromCache(const QString& path) {
+  watcher_->RemovePath(path);
+  cache_.remove(path);
+  cache_order_.removeAll(path);
+}
+
+void FileViewModel::DirectoryChanged(const QString& path) {
+  // It'll be listed again the next time it's shown.
+  RemoveFromCache(path);
+
+  if (path == root_path_) StartListing(path);
+}
+
+const FileViewModel::Entry* FileViewModel::EntryAt(
+    const QModelIndex& index) const {
+  if (!index.isValid() || index.row() >= entries_.count()) return nullptr;
+  return &entries_[index.row()];
+}
+
+bool FileViewModel::IsDir(const QModelIndex& index) const {
+  const Entry* entry = EntryAt(index);
+  return entry && entry->info_.isDir();
+}
+
+QString FileViewModel::FilePath(const QModelIndex& index) const {
+  const Entry* entry = EntryAt(index);
+  return entry ? entry->info_.absoluteFilePath() : QString();
+}
+
+QFileInfo FileViewModel::FileInfo(const QModelIndex& index) const {
+  const Entry* entry = EntryAt(index);
+  return entry ? entry->info_ : QFileInfo();
+}
+
+Song FileViewModel::LibrarySong(const QModelIndex& index) const {
+  const Entry* entry = EntryAt(index);
+  return entry ? entry->song_ : Song();
+}
+
+int FileViewModel::rowCount(const QModelIndex& parent) const {
+  if (parent.isValid()) return 0;
+  return entries_.count();
+}
+
+QVariant FileViewModel::data(const QModelIndex& index, int role) const {
+  const Entry* entry = EntryAt(index);
+  if (!entry) return QVariant();
+
+  switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+      return entry->info_.fileName();
+
+    case Qt::DecorationRole:
+      return icon_provider_.icon(entry->info_.isDir()
+                                     ? QFileIconProvider::Folder
+                                     : QFileIconProvider::File);
+
+    case Qt::ToolTipRole:
+      if (!entry->song_.is_valid()) return QVariant();
+      return QString("%1 (%2)").arg(entry->song_.PrettyTitleWithArtist(),
+                                    entry->song_.PrettyLength());
+
+    case Role_Song:
+      if (!entry->song_.is_valid()) return QVariant();
+      return QVariant::fromValue(entry->song_);
+
+    default:
+      return QVariant();
+  }
+}
+
+Qt::ItemFlags FileViewModel::flags(const QModelIndex& index) const {
+  if (!EntryAt(index)) return 0;
+  return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsDragEnabled;
+}
+
+QStringList FileViewModel::mimeTypes() const {
+  return QStringList() << "text/uri-list";
+}
+
+QMimeData* FileViewModel::mimeData(const QModelIndexList& indexes) const {
+  QList<QUrl> urls;
+  SongList songs;
+  bool all_in_library = backend_ != nullptr;
+
+  for (const QModelIndex& index : indexes) {
+    const Entry* entry = EntryAt(index);
+    if (!entry || index.column() != 0) continue;
+
+    urls << QUrl::fromLocalFile(entry->info_.canonicalFilePath());
+    if (entry->song_.is_valid()) {
+      songs << entry->song_;
+    } else {
+      all_in_library = false;
+    }
+  }
+
+  // If the library has all of them the playlist can take the songs as they
+  // are, without loading the files again.
+  MimeData* data = nullptr;
+  if (all_in_library && !songs.isEmpty()) {
+    SongMimeData* song_data = new SongMimeData;
+    song_data->backend = backend_;
+    song_data->songs = songs;
+    data = song_data;
+  } else {
+    data = new MimeData;
+  }
+
+  data->setUrls(urls);
+  return data;
+}
@@ -0,0 +1,104 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FILEVIEWMODEL_H
+#define FILEVIEWMODEL_H
+
+#include <QAbstractListModel>
+#include <QFileIconProvider>
+#include <QFileInfo>
+#include <QHash>
+#include <QStringList>
+
+#include "core/song.h"
+
+class FileSystemWatcherInterface;
+class LibraryBackendInterface;
+
+// Lists the files in one directory for the FileView.  Listings are made on a
+// worker thread, and the files that are in the library come with their songs
+// so they don't have to be read again when they're added to a playlist.  The
+// last few directories are kept, and watched for changes, so going back to
+// one of them is instant.
+class FileViewModel : public QAbstractListModel {
+  Q_OBJECT
+
+ public:
+  explicit FileViewModel(QObject* parent = nullptr);
+
+  // How many directory listings are kept.
+  static const int kCacheSize;
+
+  enum Role {
+    Role_Song = Qt::UserRole + 1,
+  };
+
+  void SetLibraryBackend(LibraryBackendInterface* backend);
+  // Files that don't match any of these are hidden.  Directories are always
+  // shown.
+  void SetNameFilters(const QStringList& filters);
+
+  const QString& root_path() const { return root_path_; }
+  void SetRootPath(const QString& path);
+
+  bool IsDir(const QModelIndex& index) const;
+  QString FilePath(const QModelIndex& index) const;
+  QFileInfo FileInfo(const QModelIndex& index) const;
+  // Returns an invalid song if the file isn't in the library.
+  Song LibrarySong(const QModelIndex& index) const;
+
+  // QAbstractListModel
+  int rowCount(const QModelIndex& parent = QModelIndex()) const;
+  QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const;
+  Qt::ItemFlags flags(const QModelIndex& index) const;
+  QStringList mimeTypes() const;
+  QMimeData* mimeData(const QModelIndexList& indexes) const;
+
+ private slots:
+  void DirectoryChanged(const QString& path);
+
+ private:
+  struct Entry {
+    QFileInfo info_;
+    Song song_;
+  };
+  typedef QList<Entry> Listing;
+
+  static Listing ListDirectory(const QString& path, const QStringList& filters,
+                               LibraryBackendInterface* backend);
+
+  void StartListing(const QString& path);
+  void ListingFinished(const QString& path, const Listing& listing);
+  void AddToCache(const QString& path, const Listing& listing);
+  void RemoveFromCache(const QString& path);
+  const Entry* EntryAt(const QModelIndex& index) const;
+
+ private:
+  LibraryBackendInterface* backend_;
+  FileSystemWatcherInterface* watcher_;
+  QFileIconProvider icon_provider_;
+  QStringList name_filters_;
+
+  QString root_path_;
+  Listing entries_;
+
+  QHash<QString, Listing> cache_;
+  // Most recently used last.
+  QStringList cache_order_;
+};
+
+#endif  // FILEVIEWMODEL_H
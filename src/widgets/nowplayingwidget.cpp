@@ -73,6 +73,8 @@ NowPlayingWidget::NowPlayingWidget(QWidget* parent)
       fit_width_(false),
       show_hide_animation_(new QTimeLine(500, this)),
       fade_animation_(new QTimeLine(1000, this)),
+      cover_key_(0),
+      cover_height_(-1),
       details_(new QTextDocument(this)),
       previous_track_opacity_(0.0),
       bask_in_his_glory_action_(nullptr),
@@ -183,8 +185,8 @@ void NowPlayingWidget::SetApplication(Application* app) {
   app_ = app;
 
   album_cover_choice_controller_->SetApplication(app_);
-  connect(app_->current_art_loader(), SIGNAL(ArtLoaded(Song, QString, QImage)),
-          SLOT(AlbumArtLoaded(Song, QString, QImage)));
+  connect(app_->current_art_loader(), SIGNAL(ImageLoaded(Song, QImage)),
+          SLOT(AlbumArtLoaded(Song, QImage)));
 }
 
 void NowPlayingWidget::CreateModeAction(Mode mode, const QString& text,
@@ -298,6 +300,7 @@ void NowPlayingWidget::UpdateDetailsText() {
 
   html += "</p>";
   details_->setHtml(html);
+  current_track_ = QPixmap();
 
   // if something spans multiple lines the height needs to change
   if (mode_ == LargeSongDetailsBelow) {
@@ -306,8 +309,14 @@ void NowPlayingWidget::UpdateDetailsText() {
 }
 
 void NowPlayingWidget::ScaleCover() {
-  cover_ = QPixmap::fromImage(
-      AlbumCoverLoader::ScaleAndPad(cover_loader_options_, original_));
+  if (original_.cacheKey() != cover_key_ ||
+      cover_loader_options_.desired_height_ != cover_height_) {
+    cover_ = QPixmap::fromImage(
+        AlbumCoverLoader::ScaleAndPad(cover_loader_options_, original_));
+    cover_key_ = original_.cacheKey();
+    cover_height_ = cover_loader_options_.desired_height_;
+    current_track_ = QPixmap();
+  }
   update();
 }
 
@@ -317,7 +326,7 @@ void NowPlayingWidget::KittenLoaded(quint64 id, const QImage& image) {
   }
 }
 
-void NowPlayingWidget::AlbumArtLoaded(const Song& metadata, const QString& uri,
+void NowPlayingWidget::AlbumArtLoaded(const Song& metadata,
                                       const QImage& image) {
   metadata_ = metadata;
   downloading_covers_ = false;
@@ -371,13 +380,22 @@ void NowPlayingWidget::SetVisible(bool visible) {
 void NowPlayingWidget::paintEvent(QPaintEvent* e) {
   QPainter p(this);
 
-  DrawContents(&p);
+  if (previous_track_.isNull()) {
+    DrawContents(&p);
+    return;
+  }
 
-  // Draw the previous track's image if we're fading
-  if (!previous_track_.isNull()) {
-    p.setOpacity(previous_track_opacity_);
-    p.drawPixmap(0, 0, previous_track_);
+  // Draw the previous track's image on top if we're fading
+  if (current_track_.size() != size()) {
+    current_track_ = QPixmap(size());
+    current_track_.fill(palette().background().color());
+    QPainter current_painter(&current_track_);
+    DrawContents(&current_painter);
   }
+  p.drawPixmap(0, 0, current_track_);
+
+  p.setOpacity(previous_track_opacity_);
+  p.drawPixmap(0, 0, previous_track_);
 }
 
 void NowPlayingWidget::DrawContents(QPainter* p) {
@@ -506,6 +524,7 @@ void NowPlayingWidget::FadePreviousTrack(qreal value) {
   previous_track_opacity_ = value;
   if (qFuzzyCompare(previous_track_opacity_, qreal(0.0))) {
     previous_track_ = QPixmap();
+    current_track_ = QPixmap();
   }
 
   update();
@@ -89,8 +89,7 @@ signals:
   void ShowAboveStatusBar(bool above);
   void FitCoverWidth(bool fit);
 
-  void AlbumArtLoaded(const Song& metadata, const QString& uri,
-                      const QImage& image);
+  void AlbumArtLoaded(const Song& metadata, const QImage& image);
   void KittenLoaded(quint64 id, const QImage& image);
 
   void SetVisible(bool visible);
@@ -144,11 +143,18 @@ signals:
   QPixmap cover_;
   // A copy of the original, unscaled album cover.
   QImage original_;
+  // What cover_ was scaled from, so resizes that don't change the size of the
+  // cover don't scale it again.
+  qint64 cover_key_;
+  int cover_height_;
   QTextDocument* details_;
 
   // Holds the last track while we're fading to the new track
   QPixmap previous_track_;
   qreal previous_track_opacity_;
+  // The new track, drawn once at the start of the fade so each step only
+  // blends the two pixmaps.
+  QPixmap current_track_;
 
   static const char* kHypnotoadPath;
   QAction* bask_in_his_glory_action_;
@@ -295,6 +295,12 @@ void OSD::ShuffleModeChanged(PlaylistSequence::ShuffleMode mode) {
       case PlaylistSequence::Shuffle_Albums:
         current_mode = tr("Shuffle albums");
         break;
+      case PlaylistSequence::Shuffle_ByRating:
+        current_mode = tr("Shuffle, favouring highly rated tracks");
+        break;
+      case PlaylistSequence::Shuffle_ByPlayCount:
+        current_mode = tr("Shuffle, favouring often played tracks");
+        break;
     }
     ShowMessage(QCoreApplication::applicationName(), current_mode);
   }
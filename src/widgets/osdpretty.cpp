@@ -24,6 +24,7 @@
 #include <QDesktopWidget>
 #include <QLayout>
 #include <QMouseEvent>
+#include <QPaintEvent>
 #include <QPainter>
 #include <QSettings>
 #include <QTimer>
@@ -60,6 +61,7 @@ OSDPretty::OSDPretty(Mode mode, QWidget* parent)
       popup_display_(0),
       font_(QFont()),
       disable_duration_(false),
+      icon_cache_key_(0),
       timeout_(new QTimer(this)),
       fading_enabled_(false),
       fader_(new QTimeLine(300, this)),
@@ -161,6 +163,7 @@ void OSDPretty::Load() {
 
 void OSDPretty::ReloadSettings() {
   Load();
+  frame_ = QPixmap();
   if (isVisible()) update();
 }
 
@@ -169,8 +172,20 @@ QRect OSDPretty::BoxBorder() const {
                          -kDropShadowSize);
 }
 
-void OSDPretty::paintEvent(QPaintEvent*) {
+void OSDPretty::paintEvent(QPaintEvent* e) {
+  // Changing the text only repaints the labels, so usually only part of the
+  // frame is copied.
+  if (frame_.size() != size()) RenderFrame();
+
   QPainter p(this);
+  p.drawPixmap(e->rect(), frame_, e->rect());
+}
+
+void OSDPretty::RenderFrame() {
+  frame_ = QPixmap(size());
+  frame_.fill(Qt::transparent);
+
+  QPainter p(&frame_);
   p.setRenderHint(QPainter::Antialiasing);
   p.setRenderHint(QPainter::HighQualityAntialiasing);
 
@@ -226,19 +241,22 @@ void OSDPretty::paintEvent(QPaintEvent*) {
 
 void OSDPretty::SetMessage(const QString& summary, const QString& message,
                            const QImage& image) {
-
   if (!image.isNull()) {
-    QImage scaled_image =
-        image.scaled(kMaxIconSize, kMaxIconSize, Qt::KeepAspectRatio,
-                     Qt::SmoothTransformation);
-    ui_->icon->setPixmap(QPixmap::fromImage(scaled_image));
+    // The same cover is shown for every message about the same song.
+    if (image.cacheKey() != icon_cache_key_) {
+      QImage scaled_image =
+          image.scaled(kMaxIconSize, kMaxIconSize, Qt::KeepAspectRatio,
+                       Qt::SmoothTransformation);
+      ui_->icon->setPixmap(QPixmap::fromImage(scaled_image));
+      icon_cache_key_ = image.cacheKey();
+    }
     ui_->icon->show();
   } else {
     ui_->icon->hide();
   }
 
-  ui_->summary->setText(summary);
-  ui_->message->setText(message);
+  if (ui_->summary->text() != summary) ui_->summary->setText(summary);
+  if (ui_->message->text() != message) ui_->message->setText(message);
 
   if (isVisible()) Reposition();
 }
@@ -326,6 +344,10 @@ void OSDPretty::Reposition() {
 
   move(x, y);
 
+  // Messages like the volume are usually the same size as the last one.
+  if (size() == mask_size_) return;
+  mask_size_ = size();
+
   // Create a mask for the actual area of the OSD
   QBitmap mask(size());
   mask.clear();
@@ -412,11 +434,13 @@ int OSDPretty::current_display() const {
 
 void OSDPretty::set_background_color(QRgb color) {
   background_color_ = color;
+  frame_ = QPixmap();
   if (isVisible()) update();
 }
 
 void OSDPretty::set_background_opacity(qreal opacity) {
   background_opacity_ = opacity;
+  frame_ = QPixmap();
   if (isVisible()) update();
 }
 
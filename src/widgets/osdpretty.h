@@ -100,6 +100,8 @@ class OSDPretty : public QWidget {
   void Load();
 
   QRect BoxBorder() const;
+  // Draws the shadow, background and border into frame_.
+  void RenderFrame();
 
  private slots:
   void FaderValueChanged(qreal value);
@@ -124,6 +126,13 @@ class OSDPretty : public QWidget {
   QPixmap shadow_edge_[4];
   QPixmap shadow_corner_[4];
   QPixmap background_;
+  // Everything but the labels, drawn once for each size and colour instead of
+  // on every paint.
+  QPixmap frame_;
+  // The size the window mask was last made for.
+  QSize mask_size_;
+  // QImage::cacheKey() of the image the icon was scaled from.
+  qint64 icon_cache_key_;
 
   // For dragging the OSD
   QPoint original_window_pos_;
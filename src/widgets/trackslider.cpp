@@ -60,6 +60,10 @@ void TrackSlider::SetApplication(Application* app) {
 #endif
 }
 
+void TrackSlider::SetWaveformData(const QByteArray& data) {
+  ui_->slider->SetWaveformData(data);
+}
+
 void TrackSlider::UpdateLabelWidth() {
   // We set the label's minimum size so it won't resize itself when the user
   // is dragging the slider.
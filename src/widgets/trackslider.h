@@ -50,6 +50,8 @@ class TrackSlider : public QWidget {
   void SetStopped();
   void SetCanSeek(bool can_seek);
   void Seek(int gap);
+  // See TrackSliderSlider::SetWaveformData
+  void SetWaveformData(const QByteArray& data);
 
 signals:
   void ValueChanged(int value);
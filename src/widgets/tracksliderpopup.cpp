@@ -56,6 +56,10 @@ void TrackSliderPopup::SetSmallText(const QString& text) {
   UpdatePixmap();
 }
 
+void TrackSliderPopup::SetThumbnail(const QPixmap& thumbnail) {
+  thumbnail_ = thumbnail;
+}
+
 void TrackSliderPopup::SetPopupPosition(const QPoint& pos) {
   pos_ = pos;
   UpdatePosition();
@@ -67,9 +71,14 @@ void TrackSliderPopup::paintEvent(QPaintEvent*) {
 }
 
 void TrackSliderPopup::UpdatePixmap() {
-  const int text_width =
-      qMax(font_metrics_.width(text_), small_font_metrics_.width(small_text_));
-  const QRect text_rect1(kBlurRadius + kTextMargin, kBlurRadius + kTextMargin,
+  const int text_width = qMax(
+      qMax(font_metrics_.width(text_), small_font_metrics_.width(small_text_)),
+      thumbnail_.width() - 2);
+  const QRect thumbnail_rect(
+      kBlurRadius + kTextMargin, kBlurRadius + kTextMargin,
+      text_width + 2, thumbnail_.isNull() ? 0 : thumbnail_.height());
+  const QRect text_rect1(kBlurRadius + kTextMargin,
+                         kBlurRadius + kTextMargin + thumbnail_rect.height(),
                          text_width + 2, font_metrics_.height());
   const QRect text_rect2(kBlurRadius + kTextMargin, text_rect1.bottom(),
                          text_width, small_font_metrics_.height());
@@ -153,6 +162,12 @@ void TrackSliderPopup::UpdatePixmap() {
   // Background
   p.drawPixmap(total_rect.topLeft(), background_cache_);
 
+  // Thumbnail
+  if (!thumbnail_.isNull()) {
+    p.drawPixmap(thumbnail_rect.center().x() - thumbnail_.width() / 2,
+                 thumbnail_rect.top(), thumbnail_);
+  }
+
   // Text
   p.setPen(palette().color(QPalette::HighlightedText));
   p.setFont(font_);
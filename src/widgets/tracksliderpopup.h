@@ -29,6 +29,8 @@ class TrackSliderPopup : public QWidget {
  public slots:
   void SetText(const QString& text);
   void SetSmallText(const QString& small_text);
+  // Shown above the text from the next SetText, or nothing if it's null.
+  void SetThumbnail(const QPixmap& thumbnail);
   void SetPopupPosition(const QPoint& pos);
 
  protected:
@@ -48,6 +50,7 @@ class TrackSliderPopup : public QWidget {
  private:
   QString text_;
   QString small_text_;
+  QPixmap thumbnail_;
   QPoint pos_;
 
   QFont font_;
@@ -19,13 +19,21 @@
 #include "tracksliderslider.h"
 #include "core/timeconstants.h"
 #include "core/utilities.h"
+#include "moodbar/waveformbuilder.h"
+
+#include <cmath>
 
 #include <QMouseEvent>
+#include <QPainter>
 #include <QStyle>
 #include <QStyleOptionSlider>
 #include <QtDebug>
 #include <QWheelEvent>
 
+const int TrackSliderSlider::kThumbnailWidth = 96;
+const int TrackSliderSlider::kThumbnailHeight = 24;
+const int TrackSliderSlider::kThumbnailBuckets = 60;
+
 TrackSliderSlider::TrackSliderSlider(QWidget* parent)
     : QSlider(parent),
       popup_(new TrackSliderPopup(window())),
@@ -81,6 +89,14 @@ void TrackSliderSlider::mouseMoveEvent(QMouseEvent* e) {
       minimum() / kMsecPerSec, maximum() / kMsecPerSec,
       e->x() - slider_length / 2 - slider_min + 1, slider_max - slider_min);
 
+  const int length_seconds = maximum() / kMsecPerSec;
+  if (!waveform_.isEmpty() && length_seconds > 0) {
+    popup_->SetThumbnail(
+        WaveformThumbnail(qreal(mouse_hover_seconds_) / length_seconds));
+  } else {
+    popup_->SetThumbnail(QPixmap());
+  }
+
   popup_->SetText(Utilities::PrettyTime(mouse_hover_seconds_));
   UpdateDeltaTime();
   popup_->SetPopupPosition(
@@ -124,6 +140,44 @@ void TrackSliderSlider::keyPressEvent(QKeyEvent* event) {
   }
 }
 
+void TrackSliderSlider::SetWaveformData(const QByteArray& data) {
+  waveform_ = data;
+}
+
+QPixmap TrackSliderSlider::WaveformThumbnail(qreal position) const {
+  const int buckets = WaveformBuilder::BucketCount(waveform_);
+  const qreal first_bucket = position * buckets - kThumbnailBuckets / 2.0;
+  const int middle = kThumbnailHeight / 2;
+
+  QColor color = palette().color(QPalette::HighlightedText);
+  QColor peak_color = color;
+  peak_color.setAlphaF(0.4);
+
+  QPixmap ret(kThumbnailWidth, kThumbnailHeight);
+  ret.fill(Qt::transparent);
+  QPainter p(&ret);
+
+  // The peaks faintly, with the RMS level over the top
+  for (int x = 0; x < kThumbnailWidth; ++x) {
+    const int bucket = std::floor(first_bucket + qreal(x) * kThumbnailBuckets /
+                                                     kThumbnailWidth);
+    if (bucket < 0 || bucket >= buckets) continue;
+
+    const int peak = WaveformBuilder::Peak(waveform_, bucket) * middle;
+    const int rms = WaveformBuilder::Rms(waveform_, bucket) * middle;
+    p.setPen(peak_color);
+    p.drawLine(x, middle - peak, x, middle + peak);
+    p.setPen(color);
+    p.drawLine(x, middle - rms, x, middle + rms);
+  }
+
+  // Where the mouse is
+  p.setPen(color);
+  p.drawLine(kThumbnailWidth / 2, 0, kThumbnailWidth / 2, kThumbnailHeight);
+
+  return ret;
+}
+
 void TrackSliderSlider::UpdateDeltaTime() {
   if (popup_->isVisible()) {
     int delta_seconds = mouse_hover_seconds_ - (value() / kMsecPerSec);
@@ -29,6 +29,11 @@ class TrackSliderSlider : public QSlider {
  public:
   TrackSliderSlider(QWidget* parent = nullptr);
 
+ public slots:
+  // See WaveformBuilder.  While there's a waveform the popup shows the part
+  // of it around the mouse.  An empty array means there isn't one.
+  void SetWaveformData(const QByteArray& data);
+
 signals:
   void SeekForward();
   void SeekBackward();
@@ -45,8 +50,17 @@ signals:
  private slots:
   void UpdateDeltaTime();
 
+ private:
+  static const int kThumbnailWidth;
+  static const int kThumbnailHeight;
+  // How many of the waveform's buckets the thumbnail covers
+  static const int kThumbnailBuckets;
+
+  QPixmap WaveformThumbnail(qreal position) const;
+
  private:
   TrackSliderPopup* popup_;
+  QByteArray waveform_;
 
   int mouse_hover_seconds_;
 };
@@ -0,0 +1,521 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Times the library, playlist, tag reader and analyzer hot paths on
+// generated data.  This isn't part of the test target, build and run it on
+// its own:
+//
+//   make clementine_benchmarks
+//   ./clementine_benchmarks --gtest_output=xml:benchmarks.xml
+//
+// Each benchmark records how long it took ("msec") and how many items it
+// worked on ("items") as properties of its test case in the XML output, so
+// results can be compared between releases.
+//
+// Benchmarks that are about copying also record how many times they called
+// operator new ("allocations").  Qt allocates its strings and list arrays
+// with malloc, so those aren't counted, but Song data and list items are.
+//
+// CLEMENTINE_BENCHMARK_SONGS sets the number of generated songs (100000 by
+// default, try 1000000 too) and CLEMENTINE_BENCHMARK_CORPUS points at a
+// directory of music files for the tag reader benchmark.
+
+#include <memory>
+
+#include "test_utils.h"
+#include "gtest/gtest.h"
+
+#include "analyzers/fht.h"
+#include "core/database.h"
+#include "core/scopedtransaction.h"
+#include "core/timeconstants.h"
+#include "core/utilities.h"
+#include "library/library.h"
+#include "library/librarybackend.h"
+#include "library/librarymodel.h"
+#include "library/spellingindex.h"
+#include "library/sqlitequery.h"
+#include "playlist/playlist.h"
+#include "playlist/playlistsequence.h"
+#include "mock_settingsprovider.h"
+#include "tagreader.h"
+#include "tagreadermessages.pb.h"
+
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutexLocker>
+#include <QSortFilterProxyModel>
+#include <QSqlQuery>
+#include <QVector>
+#include <QtDebug>
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<qint64> sAllocations(0);
+}  // namespace
+
+void* operator new(std::size_t size) {
+  sAllocations.fetch_add(1, std::memory_order_relaxed);
+  void* ret = std::malloc(size ? size : 1);
+  if (!ret) throw std::bad_alloc();
+  return ret;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+namespace {
+
+const int kDefaultSongCount = 100000;
+
+int SongCount() {
+  bool ok = false;
+  const int count = qgetenv("CLEMENTINE_BENCHMARK_SONGS").toInt(&ok);
+  return ok && count > 0 ? count : kDefaultSongCount;
+}
+
+// 10 albums of 100 tracks for each artist.
+SongList MakeSongs(int count) {
+  SongList ret;
+  ret.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    Song song;
+    song.Init(QString("Title %1").arg(i), QString("Artist %1").arg(i / 1000),
+              QString("Album %1").arg(i / 100), 180 * kNsecPerSec);
+    song.set_track(i % 100 + 1);
+    song.set_directory_id(1);
+    song.set_url(QUrl::fromLocalFile(QString("/benchmark/%1.mp3").arg(i)));
+    song.set_filetype(Song::Type_Mpeg);
+    song.set_mtime(1);
+    song.set_ctime(1);
+    song.set_filesize(1);
+    ret << song;
+  }
+  return ret;
+}
+
+void Report(const QElapsedTimer& timer, int items) {
+  const qint64 msec = timer.elapsed();
+  ::testing::Test::RecordProperty("msec", static_cast<int>(msec));
+  ::testing::Test::RecordProperty("items", items);
+
+  const ::testing::TestInfo* info =
+      ::testing::UnitTest::GetInstance()->current_test_info();
+  qDebug() << info->test_case_name() << info->name() << items << "items in"
+           << msec << "ms";
+}
+
+class LibraryBenchmark : public ::testing::Test {
+ protected:
+  void SetUp() {
+    database_.reset(new MemoryDatabase(nullptr));
+    backend_.reset(new LibraryBackend);
+    backend_->Init(database_.get(), Library::kSongsTable, Library::kDirsTable,
+                   Library::kSubdirsTable, Library::kFtsTable);
+    backend_->AddDirectory("/benchmark");
+    songs_ = MakeSongs(SongCount());
+  }
+
+  std::unique_ptr<Database> database_;
+  std::unique_ptr<LibraryBackend> backend_;
+  SongList songs_;
+};
+
+TEST_F(LibraryBenchmark, AddOrUpdateSongs) {
+  QElapsedTimer timer;
+  timer.start();
+  backend_->AddOrUpdateSongs(songs_);
+  Report(timer, songs_.count());
+
+  EXPECT_EQ((songs_.count() + 999) / 1000, backend_->GetAllArtists().count());
+}
+
+TEST_F(LibraryBenchmark, ModelReset) {
+  backend_->AddOrUpdateSongs(songs_);
+  LibraryModel model(backend_.get(), nullptr);
+
+  QElapsedTimer timer;
+  timer.start();
+  model.Init(false);
+  Report(timer, songs_.count());
+
+  EXPECT_LT(0, model.rowCount(QModelIndex()));
+}
+
+// Inserting rows into the songs table with each column bound by name, as the
+// library used to, and by position with Song::BindToQuery.  The by-name
+// version binds the same string to every column, so it's a lower bound on
+// what it used to cost.
+class SongInsertBenchmark : public ::testing::Test {
+ protected:
+  void SetUp() {
+    database_.reset(new MemoryDatabase(nullptr));
+    songs_ = MakeSongs(SongCount());
+    sql_ = QString("INSERT INTO %1 (%2) VALUES (%3)")
+               .arg(Library::kSongsTable, Song::kColumnSpec, Song::kBindSpec);
+  }
+
+  std::unique_ptr<Database> database_;
+  SongList songs_;
+  QString sql_;
+};
+
+TEST_F(SongInsertBenchmark, BindByName) {
+  QMutexLocker l(database_->Mutex());
+  QSqlDatabase db(database_->Connect());
+  QSqlQuery q(db);
+  ASSERT_TRUE(q.prepare(sql_));
+  const QStringList placeholders = Utilities::Prepend(":", Song::kColumns);
+
+  ScopedTransaction transaction(&db);
+  QElapsedTimer timer;
+  timer.start();
+  for (const Song& song : songs_) {
+    for (const QString& placeholder : placeholders) {
+      q.bindValue(placeholder, song.title());
+    }
+    q.exec();
+  }
+  Report(timer, songs_.count());
+  transaction.Commit();
+}
+
+TEST_F(SongInsertBenchmark, BindByPosition) {
+  QMutexLocker l(database_->Mutex());
+  QSqlDatabase db(database_->Connect());
+  SqliteQuery q(db, sql_);
+
+  ScopedTransaction transaction(&db);
+  QElapsedTimer timer;
+  timer.start();
+  int inserted = 0;
+  for (const Song& song : songs_) {
+    song.BindToQuery(&q);
+    if (q.Run()) ++inserted;
+  }
+  Report(timer, songs_.count());
+  transaction.Commit();
+
+  EXPECT_EQ(songs_.count(), inserted);
+}
+
+class PlaylistBenchmark : public ::testing::Test {
+ protected:
+  PlaylistBenchmark()
+      : playlist_(nullptr, nullptr, nullptr, 1),
+        sequence_(nullptr, new DummySettingsProvider),
+        songs_(MakeSongs(SongCount())) {}
+
+  void SetUp() { playlist_.set_sequence(&sequence_); }
+
+  Playlist playlist_;
+  PlaylistSequence sequence_;
+  SongList songs_;
+};
+
+TEST_F(PlaylistBenchmark, InsertSongs) {
+  QElapsedTimer timer;
+  timer.start();
+  playlist_.InsertSongs(songs_);
+  Report(timer, songs_.count());
+
+  EXPECT_EQ(songs_.count(), playlist_.rowCount(QModelIndex()));
+}
+
+TEST_F(PlaylistBenchmark, Sort) {
+  playlist_.InsertSongs(songs_);
+
+  QElapsedTimer timer;
+  timer.start();
+  playlist_.sort(Playlist::Column_Artist, Qt::DescendingOrder);
+  playlist_.sort(Playlist::Column_Title, Qt::AscendingOrder);
+  Report(timer, songs_.count());
+
+  EXPECT_EQ(songs_.count(), playlist_.rowCount(QModelIndex()));
+}
+
+TEST_F(PlaylistBenchmark, Filter) {
+  playlist_.InsertSongs(songs_);
+
+  QElapsedTimer timer;
+  timer.start();
+  playlist_.proxy()->setFilterFixedString("Artist 1");
+  const int filtered = playlist_.proxy()->rowCount(QModelIndex());
+  playlist_.proxy()->setFilterFixedString(QString());
+  Report(timer, songs_.count());
+
+  EXPECT_LT(0, filtered);
+  EXPECT_EQ(songs_.count(), playlist_.proxy()->rowCount(QModelIndex()));
+}
+
+TEST(TagReaderBenchmark, ReadFile) {
+  const QString corpus = QString::fromLocal8Bit(
+      qgetenv("CLEMENTINE_BENCHMARK_CORPUS"));
+  if (corpus.isEmpty()) {
+    qDebug() << "Set CLEMENTINE_BENCHMARK_CORPUS to time the tag reader";
+    return;
+  }
+
+  QStringList files;
+  QDirIterator it(corpus, QDir::Files, QDirIterator::Subdirectories);
+  while (it.hasNext()) files << it.next();
+
+  TagReader reader;
+  int valid = 0;
+
+  QElapsedTimer timer;
+  timer.start();
+  for (const QString& file : files) {
+    pb::tagreader::SongMetadata metadata;
+    reader.ReadFile(file, &metadata);
+    if (metadata.valid()) ++valid;
+  }
+  Report(timer, files.count());
+
+  EXPECT_LT(0, valid);
+}
+
+TEST(FHTBenchmark, Spectrum) {
+  const int kSizeExp = 9;
+  const int kSize = 1 << kSizeExp;
+  const int kFrames = 100000;
+
+  FHT fht(kSizeExp);
+  QVector<float> input(kSize);
+  for (int i = 0; i < kSize; ++i) {
+    input[i] = std::sin(i * 0.3) + 0.5 * std::cos(i * 1.7);
+  }
+  QVector<float> scope(kSize);
+  QVector<float> spectrum(kSize);
+
+  QElapsedTimer timer;
+  timer.start();
+  for (int i = 0; i < kFrames; ++i) {
+    scope = input;
+    fht.logSpectrum(spectrum.data(), scope.data());
+    fht.scale(spectrum.data(), 1.0 / 20);
+    scope = input;
+    fht.spectrum(scope.data(), 1.0 / 20);
+  }
+  Report(timer, kFrames);
+}
+
+// LibraryWatcher's path from the tag reader's results to the new songs it
+// gives the backend.
+TEST(SongBenchmark, ScanNewFiles) {
+  QList<pb::tagreader::SongMetadata> metadata;
+  for (const Song& song : MakeSongs(SongCount())) {
+    pb::tagreader::SongMetadata pb;
+    song.ToProtobuf(&pb);
+    metadata << pb;
+  }
+  const QString image = "/benchmark/cover.jpg";
+
+  const qint64 allocations = sAllocations.load();
+  QElapsedTimer timer;
+  timer.start();
+
+  SongList new_songs;
+  for (const pb::tagreader::SongMetadata& pb : metadata) {
+    // ScanNewFile
+    SongList song_list;
+    Song song;
+    song.InitFromProtobuf(pb);
+    song_list << song;
+
+    // ScanSubdirectory
+    for (Song& scanned : song_list) {
+      scanned.set_directory_id(1);
+      if (scanned.art_automatic().isEmpty()) scanned.set_art_automatic(image);
+      new_songs << scanned;
+    }
+  }
+
+  // The NewOrUpdatedSongs signal is queued, so it takes a copy.
+  const SongList queued = new_songs;
+  new_songs.clear();
+
+  Report(timer, metadata.count());
+  ::testing::Test::RecordProperty(
+      "allocations", static_cast<int>(sAllocations.load() - allocations));
+
+  EXPECT_EQ(metadata.count(), queued.count());
+}
+
+// Correcting misspelled queries as they're typed into the global search.
+TEST(SpellingIndexBenchmark, Correct) {
+  const int kQueries = 10000;
+  const QStringList queries = QStringList() << "titel"
+                                            << "artsit 12"
+                                            << "albmu 345"
+                                            << "title 6789"
+                                            << "nothing like it";
+
+  SpellingIndex index;
+  index.AddSongs(MakeSongs(SongCount()));
+
+  QElapsedTimer timer;
+  timer.start();
+  for (int i = 0; i < kQueries; ++i) {
+    index.Correct(queries[i % queries.count()]);
+  }
+  Report(timer, kQueries);
+}
+
+// Reading the songs table from a database file, and searching it, with each
+// of Database's tuning profiles.  Tuning_Default is sqlite's own settings.
+// Each profile gets its own copy of the generated library, so the page size
+// applies too.
+class DatabaseTuningBenchmark
+    : public ::testing::TestWithParam<Database::TuningProfile> {
+ protected:
+  static void SetUpTestCase() {
+    sDatabase = new MemoryDatabase(nullptr);
+    LibraryBackend backend;
+    backend.Init(sDatabase, Library::kSongsTable, Library::kDirsTable,
+                 Library::kSubdirsTable, Library::kFtsTable);
+    backend.AddDirectory("/benchmark");
+    backend.AddOrUpdateSongs(MakeSongs(SongCount()));
+  }
+
+  static void TearDownTestCase() {
+    delete sDatabase;
+    sDatabase = nullptr;
+  }
+
+  void SetUp() {
+    const Database::Tuning tuning = Database::TuningForProfile(GetParam());
+    filename_ = Utilities::GetTemporaryFileName();
+
+    QSqlDatabase memory_db(sDatabase->Connect());
+    QSqlQuery attach("ATTACH DATABASE :filename AS benchmark", memory_db);
+    attach.bindValue(":filename", filename_);
+    ASSERT_TRUE(attach.exec());
+    if (tuning.page_size != -1) {
+      QSqlQuery(QString("PRAGMA benchmark.page_size = %1")
+                    .arg(tuning.page_size),
+                memory_db).exec();
+    }
+    QSqlQuery copy("CREATE TABLE benchmark.songs AS SELECT * FROM songs",
+                   memory_db);
+    EXPECT_TRUE(copy.exec());
+    copy.finish();
+    QSqlQuery("DETACH DATABASE benchmark", memory_db).exec();
+
+    db_ = QSqlDatabase::addDatabase("QSQLITE", "tuning_benchmark");
+    db_.setDatabaseName(filename_);
+    ASSERT_TRUE(db_.open());
+    Database::ApplyTuning(tuning, db_);
+  }
+
+  void TearDown() {
+    db_.close();
+    db_ = QSqlDatabase();
+    QSqlDatabase::removeDatabase("tuning_benchmark");
+    QFile::remove(filename_);
+  }
+
+  static Database* sDatabase;
+  QString filename_;
+  QSqlDatabase db_;
+};
+
+Database* DatabaseTuningBenchmark::sDatabase = nullptr;
+
+TEST_P(DatabaseTuningBenchmark, LoadLibrary) {
+  QElapsedTimer timer;
+  timer.start();
+
+  QSqlQuery q(db_);
+  q.setForwardOnly(true);
+  ASSERT_TRUE(q.exec("SELECT ROWID, " + Song::kColumnSpec + " FROM songs"));
+  int count = 0;
+  while (q.next()) {
+    Song song;
+    song.InitFromQuery(q, true);
+    count++;
+  }
+  Report(timer, count);
+
+  EXPECT_EQ(SongCount(), count);
+}
+
+TEST_P(DatabaseTuningBenchmark, Search) {
+  const int kRepeats = 10;
+  const QStringList terms = QStringList() << "Artist 1"
+                                          << "Album 23"
+                                          << "Title 45";
+
+  QElapsedTimer timer;
+  timer.start();
+
+  // LIKE can't use an index, so each search reads the whole table, like an
+  // FTS query with a prefix on every column does.
+  QSqlQuery q(db_);
+  q.setForwardOnly(true);
+  q.prepare(
+      "SELECT ROWID FROM songs"
+      " WHERE artist LIKE :artist OR album LIKE :album OR title LIKE :title");
+  int matches = 0;
+  for (int i = 0; i < kRepeats; ++i) {
+    for (const QString& term : terms) {
+      q.bindValue(":artist", "%" + term + "%");
+      q.bindValue(":album", "%" + term + "%");
+      q.bindValue(":title", "%" + term + "%");
+      ASSERT_TRUE(q.exec());
+      while (q.next()) matches++;
+    }
+  }
+  Report(timer, kRepeats * terms.count());
+
+  EXPECT_LT(0, matches);
+}
+
+INSTANTIATE_TEST_CASE_P(Profiles, DatabaseTuningBenchmark,
+                        ::testing::Values(Database::Tuning_Default,
+                                          Database::Tuning_LowMemory,
+                                          Database::Tuning_Balanced,
+                                          Database::Tuning_HighMemory));
+
+}  // namespace
+
+// Outside the anonymous namespace so Database can make it a friend.
+TEST(FTSBenchmark, Tokenize) {
+  QList<QByteArray> strings;
+  for (const Song& song : MakeSongs(SongCount())) {
+    strings << song.title().toUtf8() << song.artist().toUtf8()
+            << song.album().toUtf8();
+  }
+
+  int tokens = 0;
+  QElapsedTimer timer;
+  timer.start();
+  for (const QByteArray& string : strings) {
+    sqlite3_tokenizer_cursor* cursor = nullptr;
+    Database::FTSOpen(nullptr, string.constData(), string.size(), &cursor);
+    tokens += reinterpret_cast<Database::UnicodeTokenizerCursor*>(cursor)
+                  ->tokens.count();
+    Database::FTSClose(cursor);
+  }
+  Report(timer, strings.count());
+
+  EXPECT_EQ(strings.count() * 2, tokens);
+}
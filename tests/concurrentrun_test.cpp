@@ -4,6 +4,7 @@
 
 #include <QEventLoop>
 #include <QFutureWatcher>
+#include <QSemaphore>
 #include <QThreadPool>
 
 #include "core/concurrentrun.h"
@@ -152,6 +153,36 @@ TEST(ConcurrentRunTest, ConcurrentRunVoidBindFunctionStart) {
   EXPECT_EQ(11, nb);
 }
 
+void Block(QSemaphore* started, QSemaphore* release) {
+  started->release();
+  release->acquire();
+}
+
+TEST(ConcurrentRunTest, CancelledTaskIsNotRun) {
+  CountingThreadPool threadpool;
+  threadpool.setMaxThreadCount(1);
+
+  // Keep the only thread busy so the next task has to wait.
+  QSemaphore started;
+  QSemaphore release;
+  QFuture<void> blocker = ConcurrentRun::Run<void, QSemaphore*, QSemaphore*>(
+      &threadpool, &Block, &started, &release);
+  started.acquire();
+
+  int n = 10;
+  QFuture<void> future =
+      ConcurrentRun::Run<void, int*>(&threadpool, &aFunction, &n);
+  EXPECT_EQ(1, threadpool.queue_depth());
+
+  future.cancel();
+  release.release();
+  threadpool.waitForDone();
+
+  EXPECT_EQ(0, threadpool.queue_depth());
+  EXPECT_TRUE(future.isFinished());
+  EXPECT_EQ(10, n);
+}
+
 // TODO: add some more complex test cases? (e.g. with several CPU-consuming
 // tasks launched in parallel, with/without threadpool's threads numbers
 // decreased, etc.)
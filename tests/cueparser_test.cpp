@@ -23,6 +23,7 @@
 #include "core/timeconstants.h"
 #include "playlistparsers/cueparser.h"
 
+#include <QTemporaryFile>
 #include <QUrl>
 
 class CueParserTest : public ::testing::Test {
@@ -315,3 +316,35 @@ TEST_F(CueParserTest, SkipsDataFiles) {
 
   validate_songs(song_list);
 }
+
+TEST_F(CueParserTest, ParsesChangedFileAgain) {
+  QTemporaryFile file;
+  ASSERT_TRUE(file.open());
+  file.write(
+      "FILE a_file.mp3 WAVE\n"
+      "  TRACK 01 AUDIO\n"
+      "    TITLE \"First\"\n"
+      "    INDEX 01 00:01:00\n");
+  file.flush();
+  file.seek(0);
+
+  SongList song_list = parser_.Load(&file, file.fileName(), QDir(""));
+  ASSERT_EQ(1, song_list.size());
+  EXPECT_EQ("First", song_list[0].title());
+
+  // A different size is enough to notice the change even if the mtime is
+  // the same.
+  file.resize(0);
+  file.seek(0);
+  file.write(
+      "FILE a_file.mp3 WAVE\n"
+      "  TRACK 01 AUDIO\n"
+      "    TITLE \"Changed\"\n"
+      "    INDEX 01 00:01:00\n");
+  file.flush();
+  file.seek(0);
+
+  song_list = parser_.Load(&file, file.fileName(), QDir(""));
+  ASSERT_EQ(1, song_list.size());
+  EXPECT_EQ("Changed", song_list[0].title());
+}
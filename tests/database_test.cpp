@@ -24,6 +24,8 @@
 
 #include <QtDebug>
 #include <QSqlQuery>
+#include <QSqlRecord>
+#include <QStringList>
 #include <QVariant>
 
 class DatabaseTest : public ::testing::Test {
@@ -118,6 +120,31 @@ TEST_F(DatabaseTest, FTSOpenLeavesCyrillicQueries) {
   EXPECT_EQ(strlen(query), tokens[0].end_offset);
 }
 
+TEST_F(DatabaseTest, FTSOpenSplitsMixedInput) {
+  sqlite3_tokenizer_cursor* cursor = nullptr;
+  const char* query = "Foo, R\xc3\xb6yksopp\xe2\x80\x94" "Bar 42";
+  Database::FTSOpen(nullptr, query, strlen(query), &cursor);
+  ASSERT_TRUE(cursor);
+  Database::UnicodeTokenizerCursor* real_cursor = reinterpret_cast<Database::UnicodeTokenizerCursor*>(cursor);
+  QList<Database::Token> tokens = real_cursor->tokens;
+  ASSERT_EQ(4, tokens.length());
+
+  EXPECT_EQ("foo", tokens[0].token);
+  EXPECT_EQ(0, tokens[0].start_offset);
+  EXPECT_EQ(3, tokens[0].end_offset);
+
+  EXPECT_EQ("royksopp", tokens[1].token);
+  EXPECT_EQ(5, tokens[1].start_offset);
+
+  EXPECT_EQ("bar", tokens[2].token);
+  EXPECT_EQ(17, tokens[2].start_offset);
+  EXPECT_EQ(20, tokens[2].end_offset);
+
+  EXPECT_EQ("42", tokens[3].token);
+  EXPECT_EQ(21, tokens[3].start_offset);
+  EXPECT_EQ(23, tokens[3].end_offset);
+}
+
 TEST_F(DatabaseTest, FTSCursorWorks) {
   sqlite3_tokenizer_cursor* cursor = nullptr;
   Database::FTSOpen(nullptr, "Röyksopp foo", 13, &cursor);
@@ -148,3 +175,113 @@ TEST_F(DatabaseTest, FTSCursorWorks) {
   rc = Database::FTSNext(cursor, &token, &bytes, &start_offset, &end_offset, &position);
   EXPECT_EQ(SQLITE_DONE, rc);
 }
+
+TEST_F(DatabaseTest, LibraryQueriesUseIndexes) {
+  // The queries LibraryModel and LibraryBackend run while browsing the
+  // library.  None of them should have to read the whole songs table.
+  const QStringList queries = QStringList()
+      << "SELECT DISTINCT artist, sortartist FROM songs"
+         " WHERE +effective_compilation = 0 AND unavailable = 0"
+      << "SELECT DISTINCT effective_albumartist, sortalbumartist FROM songs"
+         " WHERE +effective_compilation = 0 AND unavailable = 0"
+      << "SELECT DISTINCT album, sortalbum FROM songs"
+         " WHERE +effective_compilation = 0 AND artist = ? AND unavailable = 0"
+      << "SELECT DISTINCT album, sortalbum FROM songs"
+         " WHERE +effective_compilation = 0 AND effective_albumartist = ?"
+         " AND unavailable = 0"
+      << "SELECT DISTINCT album, sortalbum FROM songs"
+         " WHERE +effective_compilation = 1 AND unavailable = 0"
+      << "SELECT ROWID, title FROM songs"
+         " WHERE +effective_compilation = 0 AND artist = ? AND album = ?"
+         " AND unavailable = 0"
+      << "SELECT DISTINCT artist, sortartist FROM songs"
+         " WHERE ctime > ? AND +effective_compilation = 0 AND unavailable = 0"
+      << "SELECT ROWID FROM songs WHERE directory = ?"
+      << "SELECT ROWID FROM songs WHERE album = ? AND unavailable = 0";
+
+  QSqlDatabase db(database_->Connect());
+  for (const QString& sql : queries) {
+    QSqlQuery q(db);
+    ASSERT_TRUE(q.prepare("EXPLAIN QUERY PLAN " + sql)) << sql.toStdString();
+    for (int i = 0; i < sql.count('?'); ++i) q.addBindValue(1);
+    ASSERT_TRUE(q.exec()) << sql.toStdString();
+
+    while (q.next()) {
+      // The last column is the description, eg. "SCAN TABLE songs" or
+      // "SEARCH songs USING INDEX idx_album (album=?)".
+      const QString detail = q.value(q.record().count() - 1).toString();
+      EXPECT_FALSE(detail.startsWith("SCAN"))
+          << sql.toStdString() << ": " << detail.toStdString();
+    }
+  }
+}
+
+TEST_F(DatabaseTest, ServiceCataloguesAreInAttachedDatabases) {
+  QSqlDatabase db(database_->Connect());
+  for (const QString& name : QStringList() << "jamendo"
+                                           << "magnatune"
+                                           << "subsonic") {
+    QSqlQuery q(QString("SELECT COUNT(*) FROM %1.songs").arg(name), db);
+    EXPECT_TRUE(q.exec()) << name.toStdString();
+  }
+
+  const QStringList tables = db.tables();
+  EXPECT_FALSE(tables.contains("magnatune_songs"));
+  EXPECT_FALSE(tables.contains("subsonic_songs"));
+}
+
+TEST_F(DatabaseTest, AttachedDatabasesHaveTheirOwnLocks) {
+  EXPECT_TRUE(Database::DatabaseForTable("songs").isEmpty());
+  EXPECT_TRUE(Database::DatabaseForTable("main.songs").isEmpty());
+  EXPECT_EQ(QString("jamendo"), Database::DatabaseForTable("jamendo.songs"));
+
+  QMutex* main = database_->Mutex();
+  QMutex* jamendo = database_->Mutex("jamendo");
+  EXPECT_EQ(main, database_->Mutex(QString()));
+  EXPECT_EQ(jamendo, database_->Mutex("jamendo"));
+  EXPECT_NE(main, jamendo);
+  EXPECT_NE(jamendo, database_->Mutex("magnatune"));
+}
+
+TEST_F(DatabaseTest, PicksTuningProfileFromMemory) {
+  const quint64 kGiB = Q_UINT64_C(1024) * 1024 * 1024;
+  EXPECT_EQ(Database::Tuning_LowMemory,
+            Database::ResolveTuningProfile(Database::Tuning_Auto, kGiB));
+  EXPECT_EQ(Database::Tuning_Balanced,
+            Database::ResolveTuningProfile(Database::Tuning_Auto, 4 * kGiB));
+  EXPECT_EQ(Database::Tuning_HighMemory,
+            Database::ResolveTuningProfile(Database::Tuning_Auto, 16 * kGiB));
+  EXPECT_EQ(Database::Tuning_Balanced,
+            Database::ResolveTuningProfile(Database::Tuning_Auto, 0));
+
+  // A profile that was chosen in the settings is kept
+  EXPECT_EQ(Database::Tuning_Default,
+            Database::ResolveTuningProfile(Database::Tuning_Default, kGiB));
+}
+
+TEST_F(DatabaseTest, AppliesTuningToConnections) {
+  QSqlDatabase db(database_->Connect());
+  QSqlQuery q("PRAGMA cache_size", db);
+  if (database_->tuning().cache_size_kib != -1) {
+    ASSERT_TRUE(q.exec());
+    ASSERT_TRUE(q.next());
+    EXPECT_EQ(-database_->tuning().cache_size_kib, q.value(0).toInt());
+    q.finish();
+  }
+
+  Database::Tuning tuning;
+  tuning.cache_size_kib = 1234;
+  tuning.temp_store_in_memory = true;
+  Database::ApplyTuning(tuning, db);
+
+  ASSERT_TRUE(q.exec());
+  ASSERT_TRUE(q.next());
+  EXPECT_EQ(-1234, q.value(0).toInt());
+  q.finish();
+
+  // 2 is MEMORY
+  QSqlQuery temp_store("PRAGMA temp_store", db);
+  ASSERT_TRUE(temp_store.exec());
+  ASSERT_TRUE(temp_store.next());
+  EXPECT_EQ(2, temp_store.value(0).toInt());
+}
@@ -0,0 +1,97 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <QUrl>
+
+#include "devices/devicesync.h"
+
+namespace {
+
+Song MakeSong(const QString& title, const QString& filename, int mtime) {
+  Song song;
+  song.Init(title, "Artist", "Album", 100);
+  song.set_url(QUrl::fromLocalFile(filename));
+  song.set_mtime(mtime);
+  return song;
+}
+
+QStringList Titles(const SongList& songs) {
+  QStringList ret;
+  for (const Song& song : songs) ret << song.title();
+  return ret;
+}
+
+TEST(DeviceSyncTest, KeyIgnoresFilenameAndCase) {
+  EXPECT_EQ(DeviceSync::Key(MakeSong("One", "/music/one.flac", 0)),
+            DeviceSync::Key(MakeSong("ONE", "/device/01 one.mp3", 0)));
+  EXPECT_NE(DeviceSync::Key(MakeSong("One", "/music/one.flac", 0)),
+            DeviceSync::Key(MakeSong("Two", "/music/one.flac", 0)));
+}
+
+TEST(DeviceSyncTest, CopiesOnlyMissingAndChangedSongs) {
+  const SongList wanted = SongList()
+                          << MakeSong("Missing", "/music/missing.flac", 10)
+                          << MakeSong("Unchanged", "/music/unchanged.flac", 10)
+                          << MakeSong("Changed", "/music/changed.flac", 30);
+  const SongList on_device =
+      SongList() << MakeSong("Unchanged", "/device/unchanged.mp3", 20)
+                 << MakeSong("Changed", "/device/changed.mp3", 20);
+
+  DeviceSync::Plan plan =
+      DeviceSync::Diff(wanted, on_device, QSet<QString>());
+
+  EXPECT_EQ(QStringList() << "Missing"
+                          << "Changed",
+            Titles(plan.copy_));
+  // The old copy of the changed song goes.
+  ASSERT_EQ(1, plan.remove_.count());
+  EXPECT_EQ(QUrl::fromLocalFile("/device/changed.mp3"), plan.remove_[0].url());
+  EXPECT_EQ(1, plan.unchanged_);
+  EXPECT_EQ(3, plan.keys_.count());
+}
+
+TEST(DeviceSyncTest, RemovesOnlySongsItSyncedBefore) {
+  const Song kept = MakeSong("Kept", "/device/kept.mp3", 20);
+  const Song dropped = MakeSong("Dropped", "/device/dropped.mp3", 20);
+  const Song someone_elses = MakeSong("Other", "/device/other.mp3", 20);
+
+  DeviceSync::Plan plan = DeviceSync::Diff(
+      SongList() << MakeSong("Kept", "/music/kept.flac", 10),
+      SongList() << kept << dropped << someone_elses,
+      QSet<QString>() << DeviceSync::Key(kept) << DeviceSync::Key(dropped));
+
+  EXPECT_TRUE(plan.copy_.isEmpty());
+  EXPECT_EQ(QStringList() << "Dropped", Titles(plan.remove_));
+  EXPECT_EQ(QStringList() << DeviceSync::Key(kept), plan.keys_);
+}
+
+TEST(DeviceSyncTest, SkipsStreamsAndDuplicates) {
+  Song stream;
+  stream.Init("Stream", "Artist", "Album", 100);
+  stream.set_url(QUrl("http://example.com/stream"));
+
+  DeviceSync::Plan plan = DeviceSync::Diff(
+      SongList() << stream << MakeSong("One", "/music/one.flac", 10)
+                 << MakeSong("One", "/music/one.flac", 10),
+      SongList(), QSet<QString>());
+
+  EXPECT_EQ(QStringList() << "One", Titles(plan.copy_));
+}
+
+}  // namespace
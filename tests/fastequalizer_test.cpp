@@ -0,0 +1,188 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <ctime>
+#include <vector>
+
+#include <gst/gst.h>
+
+#include <QString>
+#include <QtDebug>
+
+#include "gst/equalizer/biquadcascade.h"
+#include "gst/equalizer/plugin.h"
+
+namespace {
+
+const int kRate = 44100;
+const int kBands = 10;
+const int kFrequencies[kBands] = {60,   170,  310,   600,   1000,
+                                  3000, 6000, 12000, 14000, 16000};
+
+// The same bands as GstEnginePipeline uses.
+void SetBands(BiquadCascade* cascade, int boosted_band, double gain) {
+  int last = 0;
+  for (int i = 0; i < kBands; ++i) {
+    cascade->SetBand(i, kFrequencies[i], kFrequencies[i] - last,
+                     i == boosted_band ? gain : 0.0);
+    last = kFrequencies[i];
+  }
+}
+
+// A second of stereo, with a different frequency on each channel.
+std::vector<float> Sines(double left, double right) {
+  std::vector<float> ret(kRate * 2);
+  for (int i = 0; i < kRate; ++i) {
+    ret[i * 2] = 0.5 * std::sin(2 * M_PI * left * i / kRate);
+    ret[i * 2 + 1] = 0.5 * std::sin(2 * M_PI * right * i / kRate);
+  }
+  return ret;
+}
+
+// Leaves out the start, while the filters settle.
+double Rms(const std::vector<float>& samples, int channel) {
+  double sum = 0.0;
+  int count = 0;
+  for (size_t i = 4096 * 2 + channel; i < samples.size(); i += 2) {
+    sum += samples[i] * samples[i];
+    count++;
+  }
+  return std::sqrt(sum / count);
+}
+
+TEST(BiquadCascadeTest, FlatBandsLeaveSamplesAlone) {
+  BiquadCascade cascade(kBands);
+  SetBands(&cascade, -1, 0.0);
+  cascade.SetFormat(kRate, 2);
+
+  const std::vector<float> input = Sines(1000, 100);
+  std::vector<float> output = input;
+  cascade.Process(&output[0], kRate);
+
+  EXPECT_EQ(input, output);
+}
+
+TEST(BiquadCascadeTest, BoostsOneBandOnBothChannels) {
+  BiquadCascade cascade(kBands);
+  SetBands(&cascade, 4, 12.0);
+  cascade.SetFormat(kRate, 2);
+
+  const std::vector<float> input = Sines(1000, 100);
+  std::vector<float> output = input;
+  cascade.Process(&output[0], kRate);
+
+  // +12dB is about 4 times as loud at the centre of the band, and far from
+  // it nothing changes.
+  EXPECT_NEAR(4.0, Rms(output, 0) / Rms(input, 0), 0.1);
+  EXPECT_NEAR(1.0, Rms(output, 1) / Rms(input, 1), 0.05);
+}
+
+TEST(BiquadCascadeTest, FiltersOddChannelCounts) {
+  BiquadCascade cascade(kBands);
+  SetBands(&cascade, 4, 12.0);
+  cascade.SetFormat(kRate, 3);
+
+  std::vector<float> samples(kRate * 3);
+  for (int i = 0; i < kRate; ++i) {
+    for (int c = 0; c < 3; ++c) {
+      samples[i * 3 + c] = 0.5 * std::sin(2 * M_PI * 1000 * i / kRate);
+    }
+  }
+  cascade.Process(&samples[0], kRate);
+
+  EXPECT_EQ(samples[kRate * 3 - 3], samples[kRate * 3 - 1]);
+  EXPECT_EQ(samples[kRate * 3 - 2], samples[kRate * 3 - 1]);
+}
+
+TEST(BiquadCascadeTest, GainChangesAreRamped) {
+  BiquadCascade cascade(kBands);
+  SetBands(&cascade, -1, 0.0);
+  cascade.SetFormat(kRate, 2);
+
+  std::vector<float> samples = Sines(1000, 1000);
+  cascade.Process(&samples[0], 1000);
+  SetBands(&cascade, 4, 12.0);
+  cascade.Process(&samples[2000], 100);
+
+  // Only partway there after 100 frames
+  for (int i = 1000; i < 1100; ++i) {
+    EXPECT_LT(std::abs(samples[i * 2]), 1.0);
+  }
+}
+
+// Pushes kBuffers of stereo through |element| as fast as it will go and
+// returns the CPU time spent per buffer.
+double NsecPerBuffer(const char* element) {
+  const int kBuffers = 20000;
+  const QString description =
+      QString(
+          "audiotestsrc num-buffers=%1 samplesperbuffer=1024 "
+          "wave=white-noise ! "
+          "audio/x-raw,format=F32LE,rate=44100,channels=2 ! %2 ! "
+          "fakesink sync=false")
+          .arg(kBuffers)
+          .arg(element);
+
+  GError* error = nullptr;
+  GstElement* pipeline =
+      gst_parse_launch(description.toUtf8().constData(), &error);
+  if (error) {
+    ADD_FAILURE() << error->message;
+    g_error_free(error);
+    return 0;
+  }
+
+  GstBus* bus = gst_element_get_bus(pipeline);
+  const std::clock_t start = std::clock();
+  gst_element_set_state(pipeline, GST_STATE_PLAYING);
+  GstMessage* message = gst_bus_timed_pop_filtered(
+      bus, GST_CLOCK_TIME_NONE,
+      GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  const std::clock_t end = std::clock();
+
+  EXPECT_EQ(GST_MESSAGE_EOS, GST_MESSAGE_TYPE(message));
+  gst_message_unref(message);
+  gst_object_unref(bus);
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(pipeline);
+
+  return double(end - start) * 1e9 / CLOCKS_PER_SEC / kBuffers;
+}
+
+// Run with --gtest_also_run_disabled_tests to compare fastequalizer with
+// equalizer-nbands, with every band turned up.
+TEST(BiquadCascadeTest, DISABLED_Benchmark) {
+  gst_init(nullptr, nullptr);
+  gstfastequalizer_register_static();
+
+  QString nbands = "equalizer-nbands num-bands=10";
+  QString fast = "fastequalizer";
+  for (int i = 0; i < kBands; ++i) {
+    nbands += QString(" band%1::gain=3.0").arg(i);
+    fast += QString(" band%1=3.0").arg(i);
+  }
+
+  qDebug() << "equalizer-nbands:"
+           << NsecPerBuffer(nbands.toUtf8().constData()) << "ns/buffer";
+  qDebug() << "fastequalizer:" << NsecPerBuffer(fast.toUtf8().constData())
+           << "ns/buffer";
+}
+
+}  // namespace
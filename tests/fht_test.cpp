@@ -0,0 +1,146 @@
+
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "gtest/gtest.h"
+
+#include "analyzers/fht.h"
+
+#include <cmath>
+
+#include <QElapsedTimer>
+#include <QVector>
+#include <QtDebug>
+
+namespace {
+
+const int kSizeExp = 9;
+const int kSize = 1 << kSizeExp;
+
+QVector<float> MakeScope() {
+  QVector<float> ret(kSize);
+  for (int i = 0; i < kSize; ++i) {
+    ret[i] = std::sin(i * 0.3) + 0.5 * std::cos(i * 1.7);
+  }
+  return ret;
+}
+
+// A slow but obviously correct discrete Hartley transform.
+QVector<double> Hartley(const QVector<float>& scope) {
+  QVector<double> ret(kSize);
+  for (int k = 0; k < kSize; ++k) {
+    for (int i = 0; i < kSize; ++i) {
+      const double a = 2 * M_PI * i * k / kSize;
+      ret[k] += scope[i] * (std::cos(a) + std::sin(a));
+    }
+  }
+  return ret;
+}
+
+TEST(FHTTest, Power2) {
+  FHT fht(kSizeExp);
+  QVector<float> scope = MakeScope();
+  const QVector<double> expected = Hartley(scope);
+
+  fht.power2(scope.data());
+
+  EXPECT_NEAR(2 * expected[0] * expected[0], scope[0], 1e-2);
+  for (int i = 1; i < kSize / 2; ++i) {
+    const double power =
+        expected[i] * expected[i] + expected[kSize - i] * expected[kSize - i];
+    EXPECT_NEAR(power, scope[i], 1e-2 + power * 1e-4) << "at " << i;
+  }
+}
+
+TEST(FHTTest, ScaledSpectrum) {
+  FHT fht(kSizeExp);
+  QVector<float> scope = MakeScope();
+  QVector<float> scaled = scope;
+
+  fht.spectrum(scope.data());
+  fht.scale(scope.data(), 1.0 / 20);
+  fht.spectrum(scaled.data(), 1.0 / 20);
+
+  for (int i = 0; i < kSize / 2; ++i) {
+    EXPECT_NEAR(scope[i], scaled[i], 1e-4 + scope[i] * 1e-5) << "at " << i;
+  }
+}
+
+TEST(FHTTest, SpectraFromPower2) {
+  // Analyzers get power2's output from SpectrumService and finish it off
+  // themselves, which should come out the same as doing it all in one go.
+  FHT fht(kSizeExp);
+  const QVector<float> input = MakeScope();
+
+  QVector<float> scope = input;
+  QVector<float> power = input;
+  fht.spectrum(scope.data(), 1.0 / 20);
+  fht.power2(power.data());
+  fht.spectrumFromPower2(power.data(), 1.0 / 20);
+  for (int i = 0; i < kSize / 2; ++i) {
+    EXPECT_FLOAT_EQ(scope[i], power[i]) << "at " << i;
+  }
+
+  QVector<float> log_spectrum(kSize);
+  QVector<float> log_from_power(kSize);
+  scope = input;
+  power = input;
+  fht.logSpectrum(log_spectrum.data(), scope.data());
+  fht.power2(power.data());
+  fht.logSpectrumFromPower2(log_from_power.data(), power.data());
+  for (int i = 0; i < kSize / 2; ++i) {
+    EXPECT_FLOAT_EQ(log_spectrum[i], log_from_power[i]) << "at " << i;
+  }
+}
+
+TEST(FHTTest, Ewma) {
+  FHT fht(kSizeExp);
+  QVector<float> filtered(kSize, 1.0);
+  QVector<float> fresh(kSize, 3.0);
+
+  fht.ewma(filtered.data(), fresh.data(), 0.25);
+
+  for (int i = 0; i < kSize / 2; ++i) EXPECT_FLOAT_EQ(2.5, filtered[i]);
+  // Only the first half is touched
+  EXPECT_FLOAT_EQ(1.0, filtered[kSize / 2]);
+}
+
+// Run with --gtest_also_run_disabled_tests to time a frame's worth of work.
+TEST(FHTTest, DISABLED_Benchmark) {
+  const int kFrames = 100000;
+  FHT fht(kSizeExp);
+  const QVector<float> input = MakeScope();
+  QVector<float> scope(kSize);
+  QVector<float> spectrum(kSize);
+
+  QElapsedTimer timer;
+  timer.start();
+  for (int i = 0; i < kFrames; ++i) {
+    scope = input;
+    fht.logSpectrum(spectrum.data(), scope.data());
+    fht.scale(spectrum.data(), 1.0 / 20);
+  }
+  qDebug() << "logSpectrum:" << timer.nsecsElapsed() / kFrames << "ns/frame";
+
+  timer.restart();
+  for (int i = 0; i < kFrames; ++i) {
+    scope = input;
+    fht.spectrum(scope.data(), 1.0 / 20);
+  }
+  qDebug() << "spectrum:" << timer.nsecsElapsed() / kFrames << "ns/frame";
+}
+
+}  // namespace
@@ -0,0 +1,105 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <vector>
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryFile>
+
+#include "core/fileexistencechecker.h"
+
+namespace {
+
+class FileExistenceCheckerTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    // Enough files in one directory for it to be listed
+    for (int i = 0; i < FileExistenceChecker::kMinFilesForListing; ++i) {
+      std::unique_ptr<QTemporaryFile> file(new QTemporaryFile(
+          QDir::tempPath() + "/fileexistencecheckertest-XXXXXX"));
+      ASSERT_TRUE(file->open());
+      existing_ << file->fileName();
+      files_.push_back(std::move(file));
+    }
+    missing_ = existing_[0] + "-missing";
+  }
+
+  FileExistenceChecker checker_;
+  std::vector<std::unique_ptr<QTemporaryFile>> files_;
+  QStringList existing_;
+  QString missing_;
+};
+
+TEST_F(FileExistenceCheckerTest, FindsMissingFiles) {
+  const QSet<QString> missing =
+      checker_.Missing(QStringList() << existing_ << missing_);
+
+  ASSERT_EQ(1, missing.count());
+  EXPECT_TRUE(missing.contains(missing_));
+}
+
+TEST_F(FileExistenceCheckerTest, FewFiles) {
+  const QSet<QString> missing =
+      checker_.Missing(QStringList() << existing_[0] << missing_);
+
+  ASSERT_EQ(1, missing.count());
+  EXPECT_TRUE(missing.contains(missing_));
+}
+
+TEST_F(FileExistenceCheckerTest, MissingDirectory) {
+  const QString dir = missing_ + "-dir/";
+  const QStringList filenames = QStringList() << dir + "a.mp3" << dir + "b.mp3"
+                                              << dir + "c.mp3";
+
+  EXPECT_EQ(QSet<QString>::fromList(filenames), checker_.Missing(filenames));
+}
+
+TEST_F(FileExistenceCheckerTest, EmptyFilename) {
+  EXPECT_TRUE(checker_.Missing(QStringList() << QString()).contains(QString()));
+}
+
+TEST_F(FileExistenceCheckerTest, NewFileAfterListing) {
+  checker_.Missing(QStringList() << existing_ << missing_);
+
+  // The cached listing doesn't have it, but it's checked again anyway
+  QFile file(missing_);
+  ASSERT_TRUE(file.open(QIODevice::WriteOnly));
+  file.close();
+
+  EXPECT_TRUE(checker_.Missing(QStringList() << existing_ << missing_)
+                  .isEmpty());
+  QFile::remove(missing_);
+}
+
+TEST_F(FileExistenceCheckerTest, Clear) {
+  checker_.Missing(existing_);
+
+  // Still in the cached listing
+  QFile::remove(existing_[0]);
+  EXPECT_TRUE(checker_.Missing(existing_).isEmpty());
+
+  checker_.Clear();
+  const QSet<QString> missing = checker_.Missing(existing_);
+  ASSERT_EQ(1, missing.count());
+  EXPECT_TRUE(missing.contains(existing_[0]));
+}
+
+}  // namespace
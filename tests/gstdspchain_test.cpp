@@ -0,0 +1,83 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <ctime>
+
+#include <gst/gst.h>
+
+#include <QString>
+#include <QtDebug>
+
+namespace {
+
+const int kBuffers = 20000;
+
+// Runs the speaker half of GstEnginePipeline's audio bin as fast as it will
+// go, with |dsp| between the queue and the volume element, and returns the
+// CPU time spent per buffer.
+double NsecPerBuffer(const char* dsp) {
+  const QString description =
+      QString(
+          "audiotestsrc num-buffers=%1 samplesperbuffer=1024 ! "
+          "audio/x-raw,format=F32LE,rate=44100,channels=2 ! queue ! %2 "
+          "volume ! audioresample ! audioconvert ! fakesink sync=false")
+          .arg(kBuffers)
+          .arg(dsp);
+
+  GError* error = nullptr;
+  GstElement* pipeline =
+      gst_parse_launch(description.toUtf8().constData(), &error);
+  if (error) {
+    ADD_FAILURE() << error->message;
+    g_error_free(error);
+    return 0;
+  }
+
+  GstBus* bus = gst_element_get_bus(pipeline);
+  const std::clock_t start = std::clock();
+  gst_element_set_state(pipeline, GST_STATE_PLAYING);
+  GstMessage* message = gst_bus_timed_pop_filtered(
+      bus, GST_CLOCK_TIME_NONE,
+      GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  const std::clock_t end = std::clock();
+
+  EXPECT_EQ(GST_MESSAGE_EOS, GST_MESSAGE_TYPE(message));
+  gst_message_unref(message);
+  gst_object_unref(bus);
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(pipeline);
+
+  return double(end - start) * 1e9 / CLOCKS_PER_SEC / kBuffers;
+}
+
+// Run with --gtest_also_run_disabled_tests to compare the old chain, where
+// the equalizer and stereo panorama were always present, with the one that
+// leaves them out while they're disabled.
+TEST(GstDspChainTest, DISABLED_Benchmark) {
+  gst_init(nullptr, nullptr);
+
+  qDebug() << "static chain:"
+           << NsecPerBuffer(
+                  "volume ! equalizer-nbands num-bands=12 ! audiopanorama !")
+           << "ns/buffer";
+  qDebug() << "dynamic chain, DSP disabled:" << NsecPerBuffer("")
+           << "ns/buffer";
+}
+
+}  // namespace
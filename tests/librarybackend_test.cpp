@@ -20,15 +20,22 @@
 #include "test_utils.h"
 #include "gtest/gtest.h"
 
+#include <QCoreApplication>
 #include <QFileInfo>
 #include <QSignalSpy>
+#include <QSqlQuery>
 #include <QThread>
 #include <QtDebug>
 
+#include "library/duplicatefinder.h"
 #include "library/librarybackend.h"
+#include "library/libraryquery.h"
+#include "library/sqlitequery.h"
+#include "library/sqlrow.h"
 #include "library/library.h"
 #include "core/song.h"
 #include "core/database.h"
+#include "core/timeconstants.h"
 
 namespace {
 
@@ -98,6 +105,41 @@ TEST_F(LibraryBackendTest, RemoveDirectory) {
   EXPECT_EQ(1, dir.id);
 }
 
+TEST_F(LibraryBackendTest, StoresArtCandidates) {
+  backend_->AddDirectory("/tmp");
+
+  ArtCandidate cover;
+  cover.path = "/tmp/foo/cover.jpg";
+  cover.mtime = 123;
+  cover.size = QSize(500, 400);
+  ArtCandidate back;
+  back.path = "/tmp/foo/back.jpg";
+  back.mtime = 456;
+
+  Subdirectory subdir;
+  subdir.directory_id = 1;
+  subdir.path = "/tmp/foo";
+  subdir.mtime = 1;
+  subdir.art_candidates << cover << back;
+  backend_->AddOrUpdateSubdirs(SubdirectoryList() << subdir);
+
+  SubdirectoryList subdirs = backend_->SubdirsInDirectory(1);
+  ASSERT_EQ(1, subdirs.count());
+  ASSERT_EQ(2, subdirs[0].art_candidates.count());
+  EXPECT_EQ("/tmp/foo/cover.jpg", subdirs[0].art_candidates[0].path);
+  EXPECT_EQ(123u, subdirs[0].art_candidates[0].mtime);
+  EXPECT_EQ(QSize(500, 400), subdirs[0].art_candidates[0].size);
+  // Images whose size wasn't needed don't get one.
+  EXPECT_FALSE(subdirs[0].art_candidates[1].size.isValid());
+
+  // Updating the subdirectory replaces them.
+  subdir.art_candidates.clear();
+  backend_->AddOrUpdateSubdirs(SubdirectoryList() << subdir);
+  subdirs = backend_->SubdirsInDirectory(1);
+  ASSERT_EQ(1, subdirs.count());
+  EXPECT_TRUE(subdirs[0].art_candidates.isEmpty());
+}
+
 TEST_F(LibraryBackendTest, AddInvalidSong) {
   // Adding a song without certain fields set should fail
   backend_->AddDirectory("/tmp");
@@ -301,6 +343,34 @@ TEST_F(SingleSong, DeleteSongs) {
   EXPECT_EQ(0, albums.size());
 }
 
+TEST_F(SingleSong, CachesArtistsAndAlbumsUntilSongsChange) {
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  ASSERT_EQ(QStringList() << "Artist", backend_->GetAllArtists());
+  ASSERT_EQ(1, backend_->GetAlbumsByArtist("Artist").size());
+
+  // Change the song behind the backend's back.  The old results are still
+  // cached.
+  {
+    QSqlDatabase db(database_->Connect());
+    QSqlQuery q("UPDATE songs SET artist = 'Other'", db);
+    ASSERT_TRUE(q.exec());
+  }
+  EXPECT_EQ(QStringList() << "Artist", backend_->GetAllArtists());
+  EXPECT_EQ(1, backend_->GetAlbumsByArtist("Artist").size());
+
+  // Adding a song clears the cache.
+  Song other = MakeDummySong(1);
+  other.set_url(QUrl::fromLocalFile("bar.mp3"));
+  other.set_artist("Other");
+  other.set_album("Album");
+  backend_->AddOrUpdateSongs(SongList() << other);
+
+  EXPECT_EQ(QStringList() << "Other", backend_->GetAllArtists());
+  EXPECT_EQ(0, backend_->GetAlbumsByArtist("Artist").size());
+  EXPECT_EQ(1, backend_->GetAllAlbums().size());
+}
+
 TEST_F(SingleSong, MarkSongsUnavailable) {
   AddDummySong();  if (HasFatalFailure()) return;
 
@@ -331,4 +401,255 @@ TEST_F(SingleSong, MarkSongsUnavailable) {
   EXPECT_EQ(0, albums.size());
 }
 
+TEST_F(SingleSong, StoresSortText) {
+  song_.set_artist("The Artist");
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  QMutexLocker l(database_->Mutex());
+  QSqlDatabase db(database_->Connect());
+  QSqlQuery q("SELECT sortartist, sortalbumartist, sortalbum FROM songs", db);
+  ASSERT_TRUE(q.next());
+  EXPECT_EQ("artist, the", q.value(0).toString());
+  EXPECT_EQ("artist, the", q.value(1).toString());
+  EXPECT_EQ("album", q.value(2).toString());
+}
+
+TEST_F(SingleSong, UpdatesCompilationsOfChangedAlbums) {
+  song_.set_url(QUrl::fromLocalFile("/tmp/album/1.mp3"));
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  // A second artist in the same directory makes the album a compilation.
+  Song other(song_);
+  other.set_url(QUrl::fromLocalFile("/tmp/album/2.mp3"));
+  other.set_artist("Another artist");
+  backend_->AddOrUpdateSongs(SongList() << other);
+  backend_->UpdateCompilations();
+
+  EXPECT_TRUE(backend_->GetSongById(1).is_compilation());
+  EXPECT_TRUE(backend_->GetSongById(2).is_compilation());
+
+  // Nothing has changed since, so there's nothing to look at again.
+  QSignalSpy added_spy(backend_.get(), SIGNAL(SongsDiscovered(SongList)));
+  backend_->UpdateCompilations();
+  EXPECT_EQ(0, added_spy.count());
+}
+
+TEST_F(SingleSong, ReadsSongsFromStatement) {
+  song_.set_length_nanosec(123456789012LL);
+  song_.set_rating(0.5);
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  LibraryQuery query;
+  query.SetColumnSpec("ROWID, " + Song::kColumnSpec);
+  ASSERT_TRUE(backend_->ExecQuery(&query));
+  ASSERT_TRUE(query.Next());
+
+  Song song;
+  song.InitFromQuery(query, true);
+  SqlRow copy = SqlRow(query).Detached();
+  EXPECT_FALSE(query.Next());
+
+  EXPECT_EQ(1, song.id());
+  EXPECT_EQ("Title", song.title());
+  EXPECT_EQ("Album", song.album());
+  EXPECT_EQ(QUrl::fromLocalFile("foo.mp3"), song.url());
+  EXPECT_EQ(123456789012LL, song.length_nanosec());
+  EXPECT_FLOAT_EQ(0.5, song.rating());
+  EXPECT_EQ(0, song.playcount());
+  EXPECT_TRUE(qIsNaN(song.replaygain_track_gain()));
+
+  // The copy is still readable after the query has moved on.
+  EXPECT_EQ(1, copy.value(0).toInt());
+  EXPECT_EQ("Title", copy.value(1).toString());
+}
+
+TEST_F(SingleSong, LoadsTheRestOfProjectedSongs) {
+  song_.set_track(3);
+  song_.set_lyrics("Lyrics");
+  song_.set_rating(0.5);
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  LibraryQuery query;
+  query.SetColumnSpec("ROWID, " + Song::ColumnSpec(Song::Projection_TreeNode));
+  ASSERT_TRUE(backend_->ExecQuery(&query));
+  ASSERT_TRUE(query.Next());
+
+  Song song;
+  song.InitFromQuery(query, Song::Projection_TreeNode);
+  EXPECT_TRUE(song.is_partial());
+  EXPECT_EQ(1, song.id());
+  EXPECT_EQ("Title", song.title());
+  EXPECT_EQ(3, song.track());
+  EXPECT_EQ(QUrl::fromLocalFile("foo.mp3"), song.url());
+  EXPECT_EQ("", song.lyrics());
+  EXPECT_FLOAT_EQ(-1, song.rating());
+
+  Song other = MakeDummySong(1);
+  other.set_title("Not in the library");
+
+  SongList full = backend_->GetFullSongs(SongList() << other << song);
+  ASSERT_EQ(2, full.count());
+  EXPECT_EQ("Not in the library", full[0].title());
+  EXPECT_FALSE(full[1].is_partial());
+  EXPECT_EQ("Title", full[1].title());
+  EXPECT_EQ("Lyrics", full[1].lyrics());
+  EXPECT_FLOAT_EQ(0.5, full[1].rating());
+}
+
+TEST_F(SingleSong, FindsDuplicateCandidates) {
+  song_.set_url(QUrl::fromLocalFile("/tmp/1.mp3"));
+  song_.set_length_nanosec(200 * kNsecPerSec);
+  song_.set_bitrate(128);
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  Song other_case(song_);
+  other_case.set_url(QUrl::fromLocalFile("/tmp/2.mp3"));
+  other_case.set_title("TITLE");
+  other_case.set_length_nanosec(201 * kNsecPerSec);
+  other_case.set_bitrate(320);
+
+  Song other_length(song_);
+  other_length.set_url(QUrl::fromLocalFile("/tmp/3.mp3"));
+  other_length.set_length_nanosec(300 * kNsecPerSec);
+
+  Song other_title(song_);
+  other_title.set_url(QUrl::fromLocalFile("/tmp/4.mp3"));
+  other_title.set_title("Another title");
+
+  backend_->AddOrUpdateSongs(SongList() << other_case << other_length
+                                        << other_title);
+
+  SongList candidates = backend_->GetDuplicateCandidates(
+      DuplicateFinder::kLengthToleranceNanosec);
+  ASSERT_EQ(2, candidates.count());
+  EXPECT_EQ("/tmp/1.mp3", candidates[0].url().toLocalFile());
+  EXPECT_EQ("/tmp/2.mp3", candidates[1].url().toLocalFile());
+
+  // The highest bitrate comes first.
+  QList<SongList> groups = DuplicateFinder::GroupCandidates(candidates);
+  ASSERT_EQ(1, groups.count());
+  ASSERT_EQ(2, groups[0].count());
+  EXPECT_EQ("/tmp/2.mp3", groups[0][0].url().toLocalFile());
+}
+
+TEST_F(SingleSong, CancelledQueryReturnsNoRows) {
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  QueryCancelFlag cancel(new QAtomicInt(1));
+  LibraryQuery query;
+  query.SetColumnSpec("ROWID");
+  query.SetCancelFlag(cancel);
+  ASSERT_TRUE(backend_->ExecQuery(&query));
+
+  EXPECT_FALSE(query.Next());
+  EXPECT_TRUE(query.query().cancelled());
+  EXPECT_FALSE(query.query().has_error());
+}
+
+TEST_F(LibraryBackendTest, CancelScopeInterruptsStatement) {
+  QSqlDatabase db(database_->Connect());
+  const QString sql =
+      "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM n"
+      " WHERE x < 10000000) SELECT count(*) FROM n";
+
+  QueryCancelFlag cancel(new QAtomicInt(1));
+  {
+    SqliteCancelScope scope(db, cancel);
+    QSqlQuery q(db);
+    EXPECT_FALSE(q.exec(sql));
+  }
+
+  // The connection goes back to normal once the scope has gone.
+  QSqlQuery q(db);
+  ASSERT_TRUE(q.exec("SELECT 1"));
+  EXPECT_TRUE(q.next());
+}
+
+TEST_F(SingleSong, KeepsStatisticsUpToDate) {
+  song_.set_length_nanosec(1000);
+  song_.set_filesize(10);
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  LibraryBackend::Statistics statistics = backend_->statistics();
+  EXPECT_EQ(1, statistics.song_count);
+  EXPECT_EQ(1000, statistics.total_length_nanosec);
+  EXPECT_EQ(10, statistics.total_filesize);
+  EXPECT_EQ(1, statistics.artist_song_count["Artist"]);
+  EXPECT_EQ(1, statistics.album_song_count["Album"]);
+
+  Song new_song(song_);
+  new_song.set_id(1);
+  new_song.set_artist("Another artist");
+  backend_->AddOrUpdateSongs(SongList() << new_song);
+
+  statistics = backend_->statistics();
+  EXPECT_EQ(1, statistics.song_count);
+  EXPECT_FALSE(statistics.artist_song_count.contains("Artist"));
+  EXPECT_EQ(1, statistics.artist_song_count["Another artist"]);
+
+  backend_->MarkSongsUnavailable(SongList() << new_song);
+  statistics = backend_->statistics();
+  EXPECT_EQ(0, statistics.song_count);
+  EXPECT_EQ(0, statistics.total_length_nanosec);
+  EXPECT_TRUE(statistics.album_song_count.isEmpty());
+}
+
+TEST_F(SingleSong, KeepsSnapshotUpToDate) {
+  song_.set_year(2001);
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  LibrarySnapshot snapshot = backend_->snapshot();
+  ASSERT_EQ(1, snapshot.count());
+  EXPECT_EQ(1, snapshot.ids()[0]);
+  EXPECT_EQ(2001, snapshot.years()[0]);
+  EXPECT_EQ(QVector<int>() << 1,
+            snapshot.SongIdsByArtist(snapshot.ArtistId("Artist")));
+
+  Song other(song_);
+  other.set_url(QUrl::fromLocalFile("bar.mp3"));
+  other.set_artist("Another artist");
+  backend_->AddOrUpdateSongs(SongList() << other);
+  backend_->UpdateSongRating(2, 0.6);
+
+  snapshot = backend_->snapshot();
+  ASSERT_EQ(2, snapshot.count());
+  EXPECT_EQ(2, snapshot.SongCountByYear()[2001]);
+  EXPECT_FLOAT_EQ(0.6, snapshot.ratings()[snapshot.IndexOf(2)]);
+
+  Song first(song_);
+  first.set_id(1);
+  backend_->DeleteSongs(SongList() << first);
+
+  snapshot = backend_->snapshot();
+  ASSERT_EQ(1, snapshot.count());
+  EXPECT_EQ(2, snapshot.ids()[0]);
+  EXPECT_EQ(0, snapshot.IndexOf(2));
+  EXPECT_TRUE(snapshot.SongIdsByArtist(snapshot.ArtistId("Artist")).isEmpty());
+}
+
+TEST_F(SingleSong, BatchesAsyncStatistics) {
+  AddDummySong();  if (HasFatalFailure()) return;
+
+  QSignalSpy statistics_spy(backend_.get(),
+                            SIGNAL(SongsStatisticsChanged(SongList)));
+  QSignalSpy rating_spy(backend_.get(), SIGNAL(SongsRatingChanged(SongList)));
+
+  backend_->IncrementPlayCountAsync(1);
+  backend_->IncrementPlayCountAsync(1);
+  backend_->UpdateSongRatingAsync(1, 0.2);
+  backend_->UpdateSongRatingAsync(1, 0.8);
+  QCoreApplication::processEvents();
+
+  ASSERT_EQ(1, statistics_spy.count());
+  ASSERT_EQ(1, rating_spy.count());
+
+  SongList statistics =
+      *(reinterpret_cast<SongList*>(statistics_spy[0][0].data()));
+  SongList ratings = *(reinterpret_cast<SongList*>(rating_spy[0][0].data()));
+  ASSERT_EQ(1, statistics.size());
+  ASSERT_EQ(1, ratings.size());
+  EXPECT_EQ(2, ratings[0].playcount());
+  EXPECT_FLOAT_EQ(0.8, ratings[0].rating());
+}
+
 } // namespace
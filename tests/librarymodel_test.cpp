@@ -25,6 +25,7 @@
 #include "library/librarybackend.h"
 #include "library/library.h"
 
+#include <QElapsedTimer>
 #include <QtDebug>
 #include <QThread>
 #include <QSignalSpy>
@@ -304,4 +305,42 @@ TEST_F(LibraryModelTest, RemoveEmptyArtists) {
   ASSERT_EQ(0, model_->rowCount(QModelIndex()));
 }
 
+TEST_F(LibraryModelTest, SortText) {
+  EXPECT_EQ(" unknown", LibraryModel::SortText(""));
+  EXPECT_EQ("acdc", LibraryModel::SortText("AC/DC"));
+  EXPECT_EQ("foo_bar baz", LibraryModel::SortText("Foo_Bar Baz!"));
+  EXPECT_EQ("beatles, the", LibraryModel::SortTextForArtist("The Beatles"));
+}
+
+TEST_F(LibraryModelTest, BulkSongsDiscovered) {
+  model_->Init(false);
+  backend_->AddDirectory("/tmp");
+  added_dir_ = true;
+
+  // Lots of songs spread over a few hundred artists and albums, like a
+  // rescan of a big library would deliver.
+  SongList songs;
+  for (int i = 0; i < 10000; ++i) {
+    Song song;
+    song.Init("Title " + QString::number(i),
+              "Artist " + QString::number(i % 500),
+              "Album " + QString::number(i % 1000), 123);
+    song.set_directory_id(1);
+    song.set_mtime(1);
+    song.set_ctime(1);
+    song.set_filesize(1);
+    song.set_url(QUrl("file:///tmp/" + QString::number(i)));
+    songs << song;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  backend_->AddOrUpdateSongs(songs);
+  qDebug() << "Adding" << songs.count() << "songs took" << timer.elapsed()
+           << "ms";
+
+  // 500 artists plus the dividers for "A"
+  EXPECT_EQ(501, model_->rowCount(QModelIndex()));
+}
+
 } // namespace
@@ -26,6 +26,7 @@
 #include <QTemporaryFile>
 
 using ::testing::HasSubstr;
+using ::testing::Not;
 
 class M3UParserTest : public ::testing::Test {
  protected:
@@ -146,6 +147,29 @@ TEST_F(M3UParserTest, SavesSong) {
   EXPECT_THAT(data.constData(), HasSubstr("http://www.example.com/foo.mp3"));
 }
 
+TEST_F(M3UParserTest, StopsSavingWhenTheMonitorSaysSo) {
+  QByteArray data;
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::WriteOnly);
+  SongList songs;
+  for (int i = 0; i < 1000; ++i) {
+    Song song;
+    song.set_url(QUrl(QString("http://www.example.com/%1.mp3").arg(i)));
+    songs << song;
+  }
+
+  QList<int> progress;
+  M3UParser parser(nullptr);
+  EXPECT_FALSE(parser.Save(songs, &buffer, QDir(), Playlist::Path_Automatic,
+                           [&progress](int written) {
+                             progress << written;
+                             return written < 500;
+                           }));
+  EXPECT_EQ(QList<int>() << 0 << 250 << 500, progress);
+  EXPECT_THAT(data.constData(), HasSubstr("/499.mp3"));
+  EXPECT_THAT(data.constData(), Not(HasSubstr("/500.mp3")));
+}
+
 TEST_F(M3UParserTest, ParsesUTF8) {
   QByteArray data = "#EXTM3U\n"
                     "#EXTINF:123,Разные - исполнители\n"
@@ -19,8 +19,13 @@
 #include "test_utils.h"
 #include "core/mergedproxymodel.h"
 
+#include <QElapsedTimer>
 #include <QStandardItemModel>
 #include <QSignalSpy>
+#include <QtDebug>
+
+#include <memory>
+#include <vector>
 
 class MergedProxyModelTest : public ::testing::Test {
  protected:
@@ -160,3 +165,41 @@ TEST_F(MergedProxyModelTest, SubRemove) {
   EXPECT_EQ(0, after_spy[0][1].toInt());
   EXPECT_EQ(0, after_spy[0][2].toInt());
 }
+
+TEST_F(MergedProxyModelTest, ManySubModels) {
+  const int kParents = 100;
+  const int kChildren = 100;
+
+  std::vector<std::unique_ptr<QStandardItemModel>> submodels;
+  for (int i = 0; i < kParents; ++i) {
+    source_.appendRow(new QStandardItem(QString::number(i)));
+
+    QStandardItemModel* submodel = new QStandardItemModel;
+    for (int j = 0; j < kChildren; ++j) {
+      submodel->appendRow(new QStandardItem(QString::number(j)));
+    }
+    submodels.emplace_back(submodel);
+    merged_.AddSubModel(source_.index(i, 0), submodel);
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+
+  int children = 0;
+  ASSERT_EQ(kParents, merged_.rowCount(QModelIndex()));
+  for (int i = 0; i < kParents; ++i) {
+    QModelIndex parent = merged_.index(i, 0, QModelIndex());
+    ASSERT_EQ(kChildren, merged_.rowCount(parent));
+
+    for (int j = 0; j < kChildren; ++j) {
+      QModelIndex child = merged_.index(j, 0, parent);
+      EXPECT_EQ(parent, merged_.parent(child));
+      EXPECT_EQ(QString::number(j), child.data().toString());
+      ++children;
+    }
+  }
+
+  qDebug() << "Walked" << children << "merged rows in" << timer.elapsed()
+           << "ms";
+  EXPECT_EQ(kParents * kChildren, children);
+}
@@ -100,6 +100,20 @@ TEST_F(OrganiseFormatTest, Blocks) {
   EXPECT_EQ("BeforeInside123After", format_.GetFilenameForSong(song_));
 }
 
+TEST_F(OrganiseFormatTest, BracesThatAreNotBlocks) {
+  song_.set_title("title");
+  song_.set_year(123);
+
+  format_.set_format("{}%title");
+  EXPECT_EQ("{}title", format_.GetFilenameForSong(song_));
+
+  format_.set_format("{a{%year}b}");
+  EXPECT_EQ("{a123b}", format_.GetFilenameForSong(song_));
+
+  format_.set_format("%title{");
+  EXPECT_EQ("title{", format_.GetFilenameForSong(song_));
+}
+
 TEST_F(OrganiseFormatTest, ReplaceSpaces) {
   song_.set_title("The Song Title");
   format_.set_format("The Format String %title");
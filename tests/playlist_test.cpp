@@ -22,9 +22,11 @@
 
 #include "library/libraryplaylistitem.h"
 #include "playlist/playlist.h"
+#include "playlist/songplaylistitem.h"
 #include "mock_settingsprovider.h"
 #include "mock_playlistitem.h"
 
+#include <QSignalSpy>
 #include <QtDebug>
 #include <QUndoStack>
 
@@ -501,5 +503,101 @@ TEST_F(PlaylistTest, LibraryIdMapMulti) {
   EXPECT_EQ(0, playlist_.library_items_by_id(2).count());
 }
 
+TEST_F(PlaylistTest, SortByArtist) {
+  playlist_.InsertItems(PlaylistItemList()
+      << MakeMockItemP("One", "bravo") << MakeMockItemP("Two", "Alpha")
+      << MakeMockItemP("Three", "charlie") << MakeMockItemP("Four", "alpha"));
+
+  playlist_.sort(Playlist::Column_Artist, Qt::AscendingOrder);
+
+  // Case-insensitive, and equal keys keep their order
+  ASSERT_EQ(4, playlist_.rowCount(QModelIndex()));
+  EXPECT_EQ("Two", playlist_.item_at(0)->Metadata().title());
+  EXPECT_EQ("Four", playlist_.item_at(1)->Metadata().title());
+  EXPECT_EQ("One", playlist_.item_at(2)->Metadata().title());
+  EXPECT_EQ("Three", playlist_.item_at(3)->Metadata().title());
+
+  playlist_.sort(Playlist::Column_Length, Qt::DescendingOrder);
+  EXPECT_EQ("Two", playlist_.item_at(0)->Metadata().title());
+
+  // Undo puts back the original order
+  playlist_.undo_stack()->undo();
+  playlist_.undo_stack()->undo();
+  EXPECT_EQ("One", playlist_.item_at(0)->Metadata().title());
+  EXPECT_EQ("Four", playlist_.item_at(3)->Metadata().title());
+}
+
+TEST_F(PlaylistTest, SortLargePlaylist) {
+  // Enough rows for the sort to be split across threads
+  const int count = 20000;
+  PlaylistItemList items;
+  for (int i = 0; i < count; ++i) {
+    items << MakeMockItemP(QString::number(i), QString::number(i % 7),
+                           QString(), (i * 7919) % count);
+  }
+  playlist_.InsertItems(items);
+
+  playlist_.sort(Playlist::Column_Length, Qt::AscendingOrder);
+  for (int i = 0; i < count; ++i) {
+    ASSERT_EQ(i, playlist_.item_at(i)->Metadata().length_nanosec());
+  }
+
+  playlist_.sort(Playlist::Column_Artist, Qt::AscendingOrder);
+  for (int i = 1; i < count; ++i) {
+    const Song a = playlist_.item_at(i - 1)->Metadata();
+    const Song b = playlist_.item_at(i)->Metadata();
+    ASSERT_LE(a.artist(), b.artist());
+    // Stable, so each artist's songs are still ordered by length
+    if (a.artist() == b.artist()) {
+      ASSERT_LT(a.length_nanosec(), b.length_nanosec());
+    }
+  }
+
+  playlist_.undo_stack()->undo();
+  playlist_.undo_stack()->undo();
+  EXPECT_EQ("0", playlist_.item_at(0)->Metadata().title());
+  EXPECT_EQ("1", playlist_.item_at(1)->Metadata().title());
+
+  playlist_.undo_stack()->redo();
+  EXPECT_EQ(0, playlist_.item_at(0)->Metadata().length_nanosec());
+}
+
+
+TEST_F(PlaylistTest, ItemChangedAfterRemove) {
+  PlaylistItemPtr one = MakeMockItemP("One");
+  PlaylistItemPtr two = MakeMockItemP("Two");
+  PlaylistItemPtr three = MakeMockItemP("Three");
+  playlist_.InsertItems(PlaylistItemList() << one << two << three);
+
+  playlist_.ItemChanged(three);
+  playlist_.removeRow(0);
+
+  QSignalSpy spy(&playlist_, SIGNAL(dataChanged(QModelIndex, QModelIndex)));
+  playlist_.ItemChanged(three);
+  playlist_.ItemChanged(one);
+
+  ASSERT_EQ(1, spy.count());
+  EXPECT_EQ(1, spy[0][0].value<QModelIndex>().row());
+}
+
+TEST_F(PlaylistTest, UpdateItemsByUrl) {
+  Song a;
+  a.Init("a", "artist", "album", 123);
+  a.set_url(QUrl("file:///a.mp3"));
+  Song b;
+  b.Init("b", "artist", "album", 123);
+  b.set_url(QUrl("file:///b.mp3"));
+  playlist_.InsertItems(PlaylistItemList()
+                        << PlaylistItemPtr(new SongPlaylistItem(a))
+                        << PlaylistItemPtr(new SongPlaylistItem(b)));
+
+  Song updated = b;
+  updated.set_title("new b");
+  playlist_.UpdateItems(SongList() << updated);
+
+  EXPECT_EQ("a", playlist_.item_at(0)->Metadata().title());
+  EXPECT_EQ("new b", playlist_.item_at(1)->Metadata().title());
+}
+
 
 } // namespace
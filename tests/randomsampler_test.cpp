@@ -0,0 +1,79 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <QSet>
+
+#include "smartplaylists/randomsampler.h"
+
+using smart_playlists::RandomSampler;
+
+namespace {
+
+QVector<int> Range(int count) {
+  QVector<int> ret;
+  for (int i = 0; i < count; ++i) ret << i;
+  return ret;
+}
+
+TEST(RandomSamplerTest, TakesEveryIdOncePerPass) {
+  RandomSampler sampler;
+  sampler.SetIds(Range(100));
+
+  QSet<int> seen;
+  for (int i = 0; i < 10; ++i) {
+    for (int id : sampler.Take(10)) {
+      EXPECT_FALSE(seen.contains(id));
+      seen << id;
+    }
+  }
+  EXPECT_EQ(100, seen.count());
+}
+
+TEST(RandomSamplerTest, SkipsRecentlyUsedIds) {
+  RandomSampler sampler;
+  sampler.SetIds(Range(10));
+  sampler.set_history_size(8);
+
+  for (int id = 0; id < 8; ++id) sampler.MarkUsed(id);
+
+  QList<int> ids = sampler.Take(5);
+  ASSERT_EQ(2, ids.count());
+  EXPECT_TRUE(ids.contains(8));
+  EXPECT_TRUE(ids.contains(9));
+}
+
+TEST(RandomSamplerTest, ForgetsOldHistory) {
+  RandomSampler sampler;
+  sampler.set_history_size(2);
+
+  sampler.MarkUsed(1);
+  sampler.MarkUsed(2);
+  sampler.MarkUsed(3);
+
+  EXPECT_FALSE(sampler.WasUsedRecently(1));
+  EXPECT_TRUE(sampler.WasUsedRecently(2));
+  EXPECT_TRUE(sampler.WasUsedRecently(3));
+}
+
+TEST(RandomSamplerTest, EmptySet) {
+  RandomSampler sampler;
+  EXPECT_TRUE(sampler.Take(5).isEmpty());
+}
+
+}  // namespace
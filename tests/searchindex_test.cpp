@@ -0,0 +1,87 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include "globalsearch/searchindex.h"
+
+namespace {
+
+class SearchIndexTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    index_.Add(10, "Groove Salad");
+    index_.Add(11, "Drone Zone");
+    index_.Add(12, "Secret Agent");
+    index_.Add(13, "Salad Days Radio");
+    index_.Add(14, "Indie Pop Rocks!");
+  }
+
+  QList<int> Search(const QString& query, int limit = -1) {
+    return index_.Search(query.split(' ', QString::SkipEmptyParts), limit);
+  }
+
+  SearchIndex index_;
+};
+
+TEST_F(SearchIndexTest, EmptyQueryReturnsEverything) {
+  EXPECT_EQ(QList<int>() << 10 << 11 << 12 << 13 << 14, Search(""));
+  EXPECT_EQ(QList<int>() << 10 << 11, Search("", 2));
+}
+
+TEST_F(SearchIndexTest, MatchesSubstrings) {
+  EXPECT_EQ(QList<int>() << 11, Search("ron"));
+  EXPECT_EQ(QList<int>() << 11, Search("drone"));
+  EXPECT_EQ(QList<int>() << 14, Search("ocks!"));
+  EXPECT_EQ(QList<int>() << 12, Search("ecret"));
+  EXPECT_TRUE(Search("zzz").isEmpty());
+  EXPECT_TRUE(Search("dronezone").isEmpty());
+}
+
+TEST_F(SearchIndexTest, IsCaseInsensitive) {
+  EXPECT_EQ(QList<int>() << 12, Search("AGENT"));
+  EXPECT_EQ(QList<int>() << 12, Search("sEcReT"));
+}
+
+TEST_F(SearchIndexTest, RequiresEveryToken) {
+  EXPECT_EQ(QList<int>() << 13, Search("salad radio"));
+  EXPECT_TRUE(Search("salad zone").isEmpty());
+}
+
+TEST_F(SearchIndexTest, LongTokensAreVerified) {
+  // Every trigram of "salads" is in "Salad Days", but the token isn't.
+  index_.Add(15, "salad ads");
+  EXPECT_TRUE(Search("salads").isEmpty());
+}
+
+TEST_F(SearchIndexTest, RanksWordMatchesFirst) {
+  index_.Add(15, "Ambient Agents");
+  index_.Add(16, "Reagent FM");
+  index_.Add(17, "Agent");
+
+  // Whole words, then word prefixes, then everything else in insertion order.
+  EXPECT_EQ(QList<int>() << 12 << 17 << 15 << 16, Search("agent"));
+  EXPECT_EQ(QList<int>() << 12 << 17, Search("agent", 2));
+}
+
+TEST_F(SearchIndexTest, Clear) {
+  index_.Clear();
+  EXPECT_EQ(0, index_.count());
+  EXPECT_TRUE(Search("salad").isEmpty());
+}
+
+}  // namespace
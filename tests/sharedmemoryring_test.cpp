@@ -0,0 +1,70 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include "core/sharedmemoryring.h"
+
+namespace {
+
+class SharedMemoryRingTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    ASSERT_TRUE(writer_.Create("sharedmemoryring_test", 16));
+    ASSERT_TRUE(reader_.Attach(writer_.key()));
+  }
+
+  SharedMemoryRing writer_;
+  SharedMemoryRing reader_;
+};
+
+TEST_F(SharedMemoryRingTest, ReadsWhatWasWritten) {
+  EXPECT_EQ(16, reader_.capacity());
+
+  quint64 position = 0;
+  ASSERT_TRUE(writer_.Write("hello", &position));
+
+  QByteArray data;
+  ASSERT_TRUE(reader_.Read(position, 5, &data));
+  EXPECT_EQ(QByteArray("hello"), data);
+}
+
+TEST_F(SharedMemoryRingTest, WrapsAround) {
+  quint64 position = 0;
+  QByteArray data;
+  ASSERT_TRUE(writer_.Write("0123456789", &position));
+  ASSERT_TRUE(reader_.Read(position, 10, &data));
+
+  ASSERT_TRUE(writer_.Write("abcdefghij", &position));
+  EXPECT_EQ(10, position);
+  ASSERT_TRUE(reader_.Read(position, 10, &data));
+  EXPECT_EQ(QByteArray("abcdefghij"), data);
+}
+
+TEST_F(SharedMemoryRingTest, WriteFailsUntilSpaceIsFreed) {
+  quint64 first = 0;
+  quint64 second = 0;
+  ASSERT_TRUE(writer_.Write("0123456789", &first));
+  EXPECT_FALSE(writer_.Write("abcdefghij", &second));
+  EXPECT_FALSE(writer_.Write(QByteArray(17, 'x'), &second));
+
+  QByteArray data;
+  ASSERT_TRUE(reader_.Read(first, 10, &data));
+  EXPECT_TRUE(writer_.Write("abcdefghij", &second));
+}
+
+}  // namespace
@@ -0,0 +1,111 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <QSet>
+
+#include "playlist/shuffleorder.h"
+
+namespace {
+
+QSet<int> Rows(ShuffleOrder* order) {
+  QSet<int> ret;
+  for (int i = 0; i < order->count(); ++i) ret << order->at(i);
+  return ret;
+}
+
+TEST(ShuffleOrderTest, ShuffleKeepsEveryRow) {
+  ShuffleOrder order;
+  order.Resize(100);
+  order.Shuffle(0);
+
+  EXPECT_EQ(100, Rows(&order).count());
+  for (int i = 0; i < order.count(); ++i) {
+    EXPECT_EQ(i, order.indexOf(order.at(i)));
+  }
+}
+
+TEST(ShuffleOrderTest, ShuffleKeepsPlayedRows) {
+  ShuffleOrder order;
+  order.Resize(10);
+  order.Shuffle(0);
+  const int first = order.at(0);
+  const int second = order.at(1);
+
+  order.Shuffle(2);
+  EXPECT_EQ(first, order.at(0));
+  EXPECT_EQ(second, order.at(1));
+  EXPECT_EQ(10, Rows(&order).count());
+}
+
+TEST(ShuffleOrderTest, SortRestoresPlaylistOrder) {
+  ShuffleOrder order;
+  order.Resize(10);
+  order.Shuffle(0);
+  order.Sort();
+
+  for (int i = 0; i < order.count(); ++i) {
+    EXPECT_EQ(i, order.at(i));
+  }
+}
+
+TEST(ShuffleOrderTest, WeightedShuffleSkipsZeroWeights) {
+  ShuffleOrder order;
+  order.Resize(4);
+  order.Shuffle(0, QVector<double>() << 0.0 << 0.0 << 0.0 << 1.0);
+
+  // The only row with a weight always comes first
+  EXPECT_EQ(3, order.at(0));
+  EXPECT_EQ(4, Rows(&order).count());
+}
+
+TEST(ShuffleOrderTest, ShuffleGroupsKeepsGroupsTogether) {
+  ShuffleOrder order;
+  order.Resize(6);
+  order.ShuffleGroups(0, QVector<int>() << 0 << 1 << 0 << 2 << 1 << 2, 2);
+
+  EXPECT_EQ(3, order.at(0));
+  EXPECT_EQ(5, order.at(1));
+  for (int i = 2; i < 6; i += 2) {
+    EXPECT_LT(order.at(i), order.at(i + 1));
+  }
+}
+
+TEST(ShuffleOrderTest, ResizeDropsRemovedRows) {
+  ShuffleOrder order;
+  order.Resize(10);
+  order.Shuffle(0);
+  order.Resize(5);
+
+  EXPECT_EQ(5, order.count());
+  EXPECT_EQ(QSet<int>() << 0 << 1 << 2 << 3 << 4, Rows(&order));
+  EXPECT_EQ(-1, order.indexOf(7));
+}
+
+TEST(ShuffleOrderTest, MoveTo) {
+  ShuffleOrder order;
+  order.Resize(10);
+  order.Shuffle(0);
+  order.MoveTo(7, 0);
+
+  EXPECT_EQ(7, order.at(0));
+  EXPECT_EQ(0, order.indexOf(7));
+  EXPECT_EQ(10, Rows(&order).count());
+}
+
+}  // namespace
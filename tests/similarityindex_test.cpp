@@ -0,0 +1,85 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include "library/audiofeatureanalyser.h"
+#include "library/similarityindex.h"
+
+namespace {
+
+// Features that are all the given value, plus a little.
+QByteArray MakeFeatures(int value, int offset = 0) {
+  QByteArray ret(AudioFeatureAnalyser::kDimensions, 0);
+  for (int i = 0; i < ret.size(); ++i) {
+    ret[i] = quint8(qBound(0, value + (i % 3) * offset, 255));
+  }
+  return ret;
+}
+
+class SimilarityIndexTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    // Two clusters of ten songs each, far apart.
+    for (int i = 0; i < 10; ++i) {
+      index_.Add(i, MakeFeatures(20 + i, i));
+      index_.Add(100 + i, MakeFeatures(220 - i, i));
+    }
+    index_.Build();
+  }
+
+  SimilarityIndex index_;
+};
+
+TEST_F(SimilarityIndexTest, IgnoresBadFeatures) {
+  index_.Add(1000, QByteArray("short"));
+  EXPECT_FALSE(index_.Contains(1000));
+  EXPECT_EQ(20, index_.count());
+}
+
+TEST_F(SimilarityIndexTest, StoresFeatures) {
+  EXPECT_TRUE(index_.Contains(3));
+  EXPECT_EQ(MakeFeatures(23, 3), index_.Features(3));
+  EXPECT_TRUE(index_.Features(50).isEmpty());
+}
+
+TEST_F(SimilarityIndexTest, NearestIsItself) {
+  EXPECT_EQ(QList<int>() << 4, index_.Nearest(index_.Features(4), 1));
+  EXPECT_EQ(QList<int>() << 105, index_.Nearest(index_.Features(105), 1));
+}
+
+TEST_F(SimilarityIndexTest, FindsTheSameCluster) {
+  const QList<int> nearest = index_.Nearest(MakeFeatures(22), 5);
+  ASSERT_EQ(5, nearest.count());
+  for (int id : nearest) {
+    EXPECT_LT(id, 100);
+  }
+}
+
+TEST_F(SimilarityIndexTest, Excludes) {
+  const QSet<int> exclude = QSet<int>() << 4 << 5;
+  const QList<int> nearest = index_.Nearest(index_.Features(4), 3, exclude);
+  ASSERT_EQ(3, nearest.count());
+  EXPECT_FALSE(nearest.contains(4));
+  EXPECT_FALSE(nearest.contains(5));
+}
+
+TEST_F(SimilarityIndexTest, ReturnsEverythingWhenAskedForMore) {
+  EXPECT_EQ(20, index_.Nearest(MakeFeatures(128), 50).count());
+}
+
+}  // namespace
@@ -18,6 +18,7 @@
 #include "config.h"
 #include "tagreader.h"
 #include "core/song.h"
+#include "core/urlkey.h"
 #ifdef HAVE_LIBLASTFM
 #include "internet/lastfm/lastfmcompat.h"
 #endif
@@ -27,6 +28,7 @@
 
 #include "test_utils.h"
 
+#include <QFileInfo>
 #include <QStringList>
 #include <QTemporaryFile>
 #include <QTextCodec>
@@ -65,11 +67,12 @@ class SongTest : public ::testing::Test {
   }
 
   static void WriteSongStatisticsToFile(const Song& song,
-                                        const QString& filename) {
+                                        const QString& filename,
+                                        bool* rewrote_file = nullptr) {
     TagReader tag_reader;
     ::pb::tagreader::SongMetadata pb_song;
     song.ToProtobuf(&pb_song);
-    tag_reader.SaveSongStatisticsToFile(filename, pb_song);
+    tag_reader.SaveSongStatisticsToFile(filename, pb_song, rewrote_file);
   }
 
   static void WriteSongRatingToFile(const Song& song, const QString& filename) {
@@ -142,6 +145,27 @@ TEST_F(SongTest, FMPSPlayCount) {
   EXPECT_EQ(69, new_song.playcount());
 }
 
+TEST_F(SongTest, StatisticsFitInPlaceAfterFirstWrite) {
+  QStringList files_to_test;
+  files_to_test << ":/testdata/beep.mp3"
+                << ":/testdata/beep.flac";
+  for (const QString& test_filename : files_to_test) {
+    TemporaryResource r(test_filename);
+    Song song = ReadSongFromFile(r.fileName());
+
+    song.set_playcount(1);
+    WriteSongStatisticsToFile(song, r.fileName());
+    const qint64 size = QFileInfo(r.fileName()).size();
+
+    bool rewrote_file = true;
+    song.set_playcount(2);
+    WriteSongStatisticsToFile(song, r.fileName(), &rewrote_file);
+    EXPECT_FALSE(rewrote_file) << test_filename.toStdString();
+    EXPECT_EQ(size, QFileInfo(r.fileName()).size());
+    EXPECT_EQ(2, ReadSongFromFile(r.fileName()).playcount());
+  }
+}
+
 TEST_F(SongTest, FMPSPlayCountUser) {
   TemporaryResource r(":/testdata/fmpsplaycountuser.mp3");
   Song song = ReadSongFromFile(r.fileName());
@@ -423,4 +447,40 @@ TEST_F(SongTest, MergeUserSetDataTest) {
   EXPECT_EQ(song_file_with_no_rating.rating(), song_db_with_rating.rating());
 }
 
+TEST_F(SongTest, SharesRepeatedStrings) {
+  Song one;
+  one.set_artist(QString("Some ") + "artist");
+  one.set_genre(QString("Some ") + "genre");
+
+  Song two;
+  two.set_artist(QString("Some ") + "artist");
+  two.set_genre(QString("Some ") + "genre");
+
+  // The strings were built separately but both songs point at the same copy
+  EXPECT_EQ(one.artist().constData(), two.artist().constData());
+  EXPECT_EQ(one.genre().constData(), two.genre().constData());
+}
+
+TEST_F(SongTest, KeysUrls) {
+  Song one;
+  one.set_url(QUrl::fromLocalFile("/music/a b.mp3"));
+  Song two;
+  two.set_url(QUrl::fromEncoded("file:///music/a%20b.mp3"));
+  Song other;
+  other.set_url(QUrl::fromLocalFile("/music/c.mp3"));
+
+  EXPECT_EQ(one.url().toEncoded(), one.url_key().encoded());
+  EXPECT_TRUE(one.url_key() == two.url_key());
+  EXPECT_EQ(qHash(one.url_key()), qHash(two.url_key()));
+  EXPECT_TRUE(one.url_key() != other.url_key());
+  EXPECT_TRUE(one == two);
+  EXPECT_EQ(qHash(one), qHash(two));
+
+  // Changing the URL of a copy doesn't change the original's key
+  Song copy(one);
+  copy.set_url(QUrl::fromLocalFile("/music/c.mp3"));
+  EXPECT_TRUE(copy.url_key() == other.url_key());
+  EXPECT_TRUE(one.url_key() == two.url_key());
+}
+
 }  // namespace
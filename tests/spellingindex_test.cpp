@@ -0,0 +1,121 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include "library/spellingindex.h"
+
+namespace {
+
+Song MakeSong(const QString& title, const QString& artist,
+              const QString& album) {
+  Song song;
+  song.Init(title, artist, album, 100);
+  return song;
+}
+
+class SpellingIndexTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    index_.AddSongs(SongList()
+                    << MakeSong("Paranoid Android", "Radiohead", "OK Computer")
+                    << MakeSong("Karma Police", "Radiohead", "OK Computer")
+                    << MakeSong("Let Down", "Radiohead", "OK Computer")
+                    << MakeSong("Ramble On", "Led Zeppelin", "II")
+                    << MakeSong("Rumble", "Link Wray", "Rumble"));
+  }
+
+  SpellingIndex index_;
+};
+
+TEST_F(SpellingIndexTest, SplitsWords) {
+  EXPECT_EQ(QStringList() << "the" << "beatles" << "abbey" << "road",
+            SpellingIndex::Words("The Beatles - Abbey Road, 1 2"));
+}
+
+TEST_F(SpellingIndexTest, Distance) {
+  EXPECT_EQ(0, SpellingIndex::Distance("radio", "radio"));
+  EXPECT_EQ(1, SpellingIndex::Distance("radio", "radios"));
+  EXPECT_EQ(1, SpellingIndex::Distance("radio", "rodio"));
+  EXPECT_EQ(2, SpellingIndex::Distance("radio", "raido"));
+  EXPECT_EQ(3, SpellingIndex::Distance("kitten", "sitting"));
+  EXPECT_EQ(5, SpellingIndex::Distance("", "radio"));
+}
+
+TEST_F(SpellingIndexTest, IndexesWords) {
+  EXPECT_TRUE(index_.Contains("radiohead"));
+  EXPECT_TRUE(index_.Contains("computer"));
+  EXPECT_TRUE(index_.Contains("zeppelin"));
+  // Too short.
+  EXPECT_FALSE(index_.Contains("ok"));
+  EXPECT_FALSE(index_.Contains("ii"));
+}
+
+TEST_F(SpellingIndexTest, FindsNearest) {
+  EXPECT_EQ("radiohead", index_.Nearest("radiohed"));
+  EXPECT_EQ("radiohead", index_.Nearest("raidohead"));
+  EXPECT_EQ("zeppelin", index_.Nearest("zepelin"));
+  EXPECT_EQ("", index_.Nearest("metallica"));
+}
+
+TEST_F(SpellingIndexTest, PrefersCommonWords) {
+  // "ramble" and "rumble" are both one away, but there are two "rumble"s.
+  EXPECT_EQ("rumble", index_.Nearest("rimble"));
+}
+
+TEST_F(SpellingIndexTest, CorrectsQueries) {
+  EXPECT_EQ("radiohead karma", index_.Correct("Radiohed karma"));
+  EXPECT_EQ("paranoid android", index_.Correct("paranoid andriod"));
+}
+
+TEST_F(SpellingIndexTest, LeavesGoodQueriesAlone) {
+  EXPECT_EQ("", index_.Correct("radiohead"));
+  // Words still being typed.
+  EXPECT_EQ("", index_.Correct("radiohead kar"));
+  EXPECT_EQ("", index_.Correct("artist:radiohed"));
+  EXPECT_EQ("", index_.Correct("1997"));
+  EXPECT_EQ("", index_.Correct("metallica"));
+}
+
+TEST_F(SpellingIndexTest, RemovesSongs) {
+  index_.RemoveSongs(SongList()
+                     << MakeSong("Ramble On", "Led Zeppelin", "II"));
+  EXPECT_FALSE(index_.Contains("zeppelin"));
+  EXPECT_TRUE(index_.Contains("radiohead"));
+  EXPECT_EQ("", index_.Nearest("zepelin"));
+
+  // Removing a song that was never there doesn't go below zero.
+  index_.RemoveSongs(SongList()
+                     << MakeSong("Ramble On", "Led Zeppelin", "II"));
+  index_.AddSongs(SongList() << MakeSong("Ramble On", "Led Zeppelin", "II"));
+  EXPECT_TRUE(index_.Contains("zeppelin"));
+  EXPECT_EQ("zeppelin", index_.Nearest("zepelin"));
+}
+
+TEST_F(SpellingIndexTest, CountsLiveWords) {
+  const int count = index_.count();
+  index_.RemoveSongs(SongList()
+                     << MakeSong("Karma Police", "Radiohead", "OK Computer"));
+  // "karma" and "police" are gone, but the other words are in other songs.
+  EXPECT_EQ(count - 2, index_.count());
+
+  index_.Clear();
+  EXPECT_EQ(0, index_.count());
+  EXPECT_EQ("", index_.Nearest("radiohed"));
+}
+
+}  // namespace
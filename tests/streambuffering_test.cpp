@@ -0,0 +1,100 @@
+/* This file is part of Clementine.
+   Copyright 2010, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include "engines/streambuffering.h"
+#include "mock_settingsprovider.h"
+
+namespace {
+
+const qint64 kDuration = 4000;
+
+class StreamBufferingTest : public ::testing::Test {
+ protected:
+  StreamBufferingTest()
+      : buffering_(new DummySettingsProvider),
+        url_("http://example.com/station.mp3?key=1") {}
+
+  StreamBuffering buffering_;
+  QUrl url_;
+};
+
+TEST_F(StreamBufferingTest, OnlyNetworkStreams) {
+  EXPECT_TRUE(StreamBuffering::IsStream(url_));
+  EXPECT_TRUE(StreamBuffering::IsStream(QUrl("mms://example.com/station")));
+  EXPECT_FALSE(StreamBuffering::IsStream(QUrl("file:///music/song.mp3")));
+  EXPECT_FALSE(StreamBuffering::IsStream(QUrl("cdda:///1")));
+}
+
+TEST_F(StreamBufferingTest, NewStationUsesDefaults) {
+  const StreamBuffering::Params params =
+      buffering_.ParamsForUrl(url_, kDuration);
+  EXPECT_EQ(kDuration, params.duration_nanosec_);
+  EXPECT_EQ(StreamBuffering::kFullFill, params.high_fill_);
+}
+
+TEST_F(StreamBufferingTest, CleanPlaysStartFaster) {
+  for (int i = 0; i < StreamBuffering::kFastStartPlays; ++i) {
+    EXPECT_EQ(StreamBuffering::kFullFill,
+              buffering_.ParamsForUrl(url_, kDuration).high_fill_);
+    buffering_.PlayedCleanly(url_);
+  }
+  EXPECT_EQ(StreamBuffering::kFastStartFill,
+            buffering_.ParamsForUrl(url_, kDuration).high_fill_);
+
+  // Other stations are unaffected.
+  EXPECT_EQ(StreamBuffering::kFullFill,
+            buffering_.ParamsForUrl(QUrl("http://example.com/other.mp3"),
+                                    kDuration).high_fill_);
+}
+
+TEST_F(StreamBufferingTest, UnderrunsGrowTheBuffer) {
+  buffering_.Underrun(url_);
+  EXPECT_EQ(kDuration * 2, buffering_.ParamsForUrl(url_, kDuration)
+                               .duration_nanosec_);
+
+  for (int i = 0; i < 10; ++i) buffering_.Underrun(url_);
+  EXPECT_EQ(kDuration << StreamBuffering::kMaxGrowth,
+            buffering_.ParamsForUrl(url_, kDuration).duration_nanosec_);
+
+  // An underrun loses the fast start too.
+  for (int i = 0; i < StreamBuffering::kFastStartPlays; ++i) {
+    buffering_.PlayedCleanly(url_);
+  }
+  buffering_.Underrun(url_);
+  EXPECT_EQ(StreamBuffering::kFullFill,
+            buffering_.ParamsForUrl(url_, kDuration).high_fill_);
+}
+
+TEST_F(StreamBufferingTest, CleanPlaysShrinkTheBuffer) {
+  buffering_.Underrun(url_);
+  for (int i = 0; i < StreamBuffering::kFastStartPlays; ++i) {
+    buffering_.PlayedCleanly(url_);
+  }
+  EXPECT_EQ(kDuration,
+            buffering_.ParamsForUrl(url_, kDuration).duration_nanosec_);
+}
+
+TEST_F(StreamBufferingTest, QueryIsIgnored) {
+  const QUrl new_key("http://example.com/station.mp3?key=2");
+  buffering_.Underrun(url_);
+  EXPECT_EQ(kDuration * 2,
+            buffering_.ParamsForUrl(new_key, kDuration).duration_nanosec_);
+}
+
+}  // namespace
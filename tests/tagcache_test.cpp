@@ -0,0 +1,114 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include <QFile>
+#include <QTemporaryFile>
+
+#include "core/tagcache.h"
+
+namespace {
+
+class TagCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() {
+    ASSERT_TRUE(file_.open());
+    file_.write("some audio");
+    file_.flush();
+
+    metadata_.set_valid(true);
+    metadata_.set_title("Title");
+  }
+
+  bool Lookup(const TagCache& cache, pb::tagreader::SongMetadata* metadata) {
+    TagCache::FileKey key;
+    return cache.Lookup(file_.fileName(), &key, metadata);
+  }
+
+  void Insert(TagCache* cache) {
+    TagCache::FileKey key;
+    ASSERT_TRUE(TagCache::StatFile(file_.fileName(), &key));
+    cache->Insert(file_.fileName(), key, metadata_);
+  }
+
+  QTemporaryFile file_;
+  pb::tagreader::SongMetadata metadata_;
+};
+
+TEST_F(TagCacheTest, UnchangedFileIsCached) {
+  TagCache cache;
+  pb::tagreader::SongMetadata metadata;
+  EXPECT_FALSE(Lookup(cache, &metadata));
+
+  Insert(&cache);
+  ASSERT_TRUE(Lookup(cache, &metadata));
+  EXPECT_EQ("Title", metadata.title());
+}
+
+TEST_F(TagCacheTest, ChangedFileIsNotCached) {
+  TagCache cache;
+  Insert(&cache);
+
+  file_.write(" and some more");
+  file_.flush();
+
+  pb::tagreader::SongMetadata metadata;
+  EXPECT_FALSE(Lookup(cache, &metadata));
+}
+
+TEST_F(TagCacheTest, Remove) {
+  TagCache cache;
+  Insert(&cache);
+  cache.Remove(file_.fileName());
+
+  pb::tagreader::SongMetadata metadata;
+  EXPECT_FALSE(Lookup(cache, &metadata));
+  EXPECT_EQ(0, cache.count());
+}
+
+TEST_F(TagCacheTest, SaveAndLoad) {
+  QTemporaryFile cache_file;
+  ASSERT_TRUE(cache_file.open());
+  const QString path = cache_file.fileName();
+  cache_file.close();
+
+  TagCache cache;
+  Insert(&cache);
+  ASSERT_TRUE(cache.Save(path));
+
+  TagCache loaded;
+  ASSERT_TRUE(loaded.Load(path));
+  EXPECT_EQ(1, loaded.count());
+
+  pb::tagreader::SongMetadata metadata;
+  ASSERT_TRUE(Lookup(loaded, &metadata));
+  EXPECT_EQ("Title", metadata.title());
+}
+
+TEST_F(TagCacheTest, LoadIgnoresOtherFiles) {
+  QTemporaryFile cache_file;
+  ASSERT_TRUE(cache_file.open());
+  cache_file.write("not a tag cache");
+  cache_file.close();
+
+  TagCache cache;
+  EXPECT_FALSE(cache.Load(cache_file.fileName()));
+  EXPECT_EQ(0, cache.count());
+}
+
+}  // namespace
@@ -0,0 +1,64 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include "core/tracing.h"
+
+#include <QFile>
+#include <QTemporaryFile>
+
+namespace {
+
+class TracingTest : public ::testing::Test {
+ protected:
+  void SetUp() { ASSERT_TRUE(file_.open()); }
+
+  QByteArray ReadTrace() {
+    QFile file(file_.fileName());
+    if (!file.open(QIODevice::ReadOnly)) return QByteArray();
+    return file.readAll();
+  }
+
+  QTemporaryFile file_;
+};
+
+TEST_F(TracingTest, RecordsNothingWhenStopped) {
+  EXPECT_FALSE(tracing::IsEnabled());
+  { qTraceScope("TracingTest::Ignored"); }
+  tracing::Stop();
+  EXPECT_TRUE(ReadTrace().isEmpty());
+}
+
+TEST_F(TracingTest, WritesScopesAndCounters) {
+  tracing::Start(file_.fileName());
+  EXPECT_TRUE(tracing::IsEnabled());
+
+  { qTraceScope("TracingTest::Scope"); }
+  qTraceCounter("TracingTest::Counter", 42);
+
+  tracing::Stop();
+  EXPECT_FALSE(tracing::IsEnabled());
+
+  const QByteArray trace = ReadTrace();
+  EXPECT_TRUE(trace.startsWith("{\"traceEvents\":["));
+  EXPECT_TRUE(trace.contains("\"name\":\"TracingTest::Scope\",\"ph\":\"X\""));
+  EXPECT_TRUE(trace.contains("\"name\":\"TracingTest::Counter\",\"ph\":\"C\""));
+  EXPECT_TRUE(trace.contains("\"args\":{\"value\":42}"));
+}
+
+}  // namespace
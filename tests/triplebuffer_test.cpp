@@ -0,0 +1,91 @@
+/* This file is part of Clementine.
+   Copyright 2026, David Sansome <me@davidsansome.com>
+
+   Clementine is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   Clementine is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with Clementine.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gtest/gtest.h"
+
+#include "core/triplebuffer.h"
+
+#include <QThread>
+
+namespace {
+
+TEST(TripleBufferTest, ReaderSeesTheLatestValue) {
+  TripleBuffer<int> buffer;
+  buffer.back() = 0;
+  EXPECT_FALSE(buffer.Update());
+
+  buffer.back() = 1;
+  buffer.Publish();
+  buffer.back() = 2;
+  buffer.Publish();
+
+  EXPECT_TRUE(buffer.Update());
+  EXPECT_EQ(2, buffer.front());
+  EXPECT_FALSE(buffer.Update());
+  EXPECT_EQ(2, buffer.front());
+
+  buffer.back() = 3;
+  buffer.Publish();
+  EXPECT_TRUE(buffer.Update());
+  EXPECT_EQ(3, buffer.front());
+}
+
+struct Pair {
+  Pair() : a_(0), b_(0) {}
+  int a_;
+  int b_;
+};
+
+class PairWriter : public QThread {
+ public:
+  PairWriter(TripleBuffer<Pair>* buffer, int count)
+      : buffer_(buffer), count_(count) {}
+
+ protected:
+  void run() {
+    for (int i = 1; i <= count_; ++i) {
+      Pair& pair = buffer_->back();
+      pair.a_ = i;
+      pair.b_ = -i;
+      buffer_->Publish();
+    }
+  }
+
+ private:
+  TripleBuffer<Pair>* buffer_;
+  int count_;
+};
+
+TEST(TripleBufferTest, ReaderNeverSeesAHalfWrittenValue) {
+  const int kCount = 200000;
+  TripleBuffer<Pair> buffer;
+  PairWriter writer(&buffer, kCount);
+  writer.start();
+
+  int last = 0;
+  while (last < kCount) {
+    if (!buffer.Update()) continue;
+    const Pair& pair = buffer.front();
+    ASSERT_EQ(pair.a_, -pair.b_);
+    ASSERT_GT(pair.a_, last);
+    last = pair.a_;
+  }
+
+  writer.wait();
+}
+
+}  // namespace
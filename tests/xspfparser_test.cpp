@@ -75,6 +75,52 @@ TEST_F(XSPFParserTest, ParsesMoreThanOneTrackFromXML) {
   EXPECT_TRUE(songs[1].is_stream());
 }
 
+static QByteArray ManyTracks(int count) {
+  QByteArray data = "<playlist><trackList>";
+  for (int i = 0; i < count; ++i) {
+    data += "<track><location>http://example.com/" + QByteArray::number(i) +
+            ".mp3</location></track>";
+  }
+  data += "</trackList></playlist>";
+  return data;
+}
+
+TEST_F(XSPFParserTest, LoadsInChunks) {
+  QByteArray data = ManyTracks(1000);
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::ReadOnly);
+  XSPFParser parser(nullptr);
+
+  QList<SongList> chunks;
+  EXPECT_TRUE(parser.LoadChunked(&buffer, "", QDir(),
+                                 [&chunks](const SongList& songs) -> bool {
+                                   chunks << songs;
+                                   return true;
+                                 }));
+
+  ASSERT_LT(1, chunks.count());
+  SongList songs;
+  for (const SongList& chunk : chunks) songs << chunk;
+  ASSERT_EQ(1000, songs.count());
+  EXPECT_EQ(QUrl("http://example.com/0.mp3"), songs[0].url());
+  EXPECT_EQ(QUrl("http://example.com/999.mp3"), songs[999].url());
+}
+
+TEST_F(XSPFParserTest, StopsLoadingWhenCancelled) {
+  QByteArray data = ManyTracks(1000);
+  QBuffer buffer(&data);
+  buffer.open(QIODevice::ReadOnly);
+  XSPFParser parser(nullptr);
+
+  int chunks = 0;
+  EXPECT_FALSE(parser.LoadChunked(&buffer, "", QDir(),
+                                  [&chunks](const SongList&) -> bool {
+                                    ++chunks;
+                                    return false;
+                                  }));
+  EXPECT_EQ(1, chunks);
+}
+
 TEST_F(XSPFParserTest, IgnoresInvalidLength) {
   QByteArray data =
       "<playlist><trackList><track>"